@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-adaptive.h"
+#include "core-repeat.h"
+
+#include <math.h>
+
+#define ADAPTIVE_MAX		(100.0)	/* largest confidence interval, percent */
+#define ADAPTIVE_MIN_DEFAULT	(5)	/* default minimum run time, seconds */
+#define ADAPTIVE_INTERVAL	(0.25)	/* bogo-op rate sample interval, seconds */
+#define ADAPTIVE_MIN_SAMPLES	(8)	/* fewest rate samples for a verdict */
+
+static double adaptive_percent;		/* 95% CI half width target, 0 = off */
+static uint64_t adaptive_min = ADAPTIVE_MIN_DEFAULT;
+static pid_t adaptive_pid = -1;		/* rate sampler */
+
+/*
+ *  stress_set_adaptive()
+ *	set the 95% confidence interval half width, as a percentage
+ *	of the mean bogo-op rate, that ends a sequential stressor run
+ */
+int stress_set_adaptive(const char *opt)
+{
+	double percent;
+
+	if ((sscanf(opt, "%lf", &percent) != 1) ||
+	    (percent <= 0.0) || (percent > ADAPTIVE_MAX)) {
+		(void)fprintf(stderr, "adaptive must be a percentage "
+			"greater than 0 and no more than %.0f\n", ADAPTIVE_MAX);
+		return -1;
+	}
+	adaptive_percent = percent;
+	return 0;
+}
+
+/*
+ *  stress_set_adaptive_min()
+ *	set the minimum run time of each adaptive stressor run
+ */
+int stress_set_adaptive_min(const char *opt)
+{
+	adaptive_min = stress_get_uint64_time(opt);
+	return 0;
+}
+
+/*
+ *  stress_adaptive_count()
+ *	total bogo-ops of all the instances of a stressor
+ */
+static uint64_t stress_adaptive_count(const stress_stressor_t *ss)
+{
+	uint64_t count = 0;
+	int32_t j;
+
+	for (j = 0; j < ss->started_instances; j++)
+		count += ss->stats[j]->ci.counter;
+	return count;
+}
+
+/*
+ *  stress_adaptive_start()
+ *	with --adaptive in sequential mode, fork a process that samples
+ *	the bogo-op rate of the stressor every ADAPTIVE_INTERVAL seconds
+ *	and stops the stressor once the 95% confidence interval of the
+ *	rate is within the --adaptive percentage of the mean and it has
+ *	run for at least --adaptive-min seconds, otherwise the stressor
+ *	runs until the --timeout or bogo-op limit as usual
+ */
+void stress_adaptive_start(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss = stressors_list;
+	const char *name;
+	uint64_t count, prev_count;
+	double t_start, t_prev, mean = 0.0, m2 = 0.0;
+	size_t n = 0;
+	int32_t j;
+
+	adaptive_pid = -1;
+	if ((adaptive_percent <= 0.0) || !ss || ss->next ||
+	    !(g_opt_flags & OPT_FLAGS_SEQUENTIAL) || !ss->started_instances)
+		return;
+
+	adaptive_pid = fork();
+	if (adaptive_pid != 0)
+		return;
+
+	name = stress_munge_underscore(ss->stressor->name);
+	stress_set_proc_name("stat [adaptive]");
+	t_start = t_prev = stress_time_now();
+	prev_count = stress_adaptive_count(ss);
+
+	while (keep_stressing_flag()) {
+		double t_now, rate, delta, ci95;
+
+		(void)shim_nanosleep_uint64((uint64_t)(ADAPTIVE_INTERVAL * STRESS_DBL_NANOSECOND));
+		t_now = stress_time_now();
+		count = stress_adaptive_count(ss);
+		rate = (double)(count - prev_count) / (t_now - t_prev);
+		prev_count = count;
+		t_prev = t_now;
+
+		/* the first interval includes the stressor start up, skip it */
+		if (t_now - t_start < ADAPTIVE_INTERVAL * 1.5)
+			continue;
+
+		/* Welford's running mean and variance of the rates */
+		n++;
+		delta = rate - mean;
+		mean += delta / (double)n;
+		m2 += delta * (rate - mean);
+
+		if ((n < ADAPTIVE_MIN_SAMPLES) || (mean <= 0.0) ||
+		    (t_now - t_start < (double)adaptive_min))
+			continue;
+
+		ci95 = stress_repeat_t_value_95(n - 1) *
+			sqrt(m2 / (double)(n - 1)) / sqrt((double)n);
+		if (ci95 <= mean * adaptive_percent / 100.0) {
+			pr_inf("%s: adaptive run stopped after %.2f secs, %.2f bogo ops/s "
+				"+/- %.2f%% (95%% confidence, %zu samples)\n",
+				name, t_now - t_start, mean, 100.0 * ci95 / mean, n);
+			for (j = 0; j < ss->started_instances; j++) {
+				const pid_t pid = ss->stats[j]->pid;
+
+				if (pid > 0)
+					(void)kill(pid, SIGALRM);
+			}
+			break;
+		}
+	}
+	_exit(0);
+}
+
+/*
+ *  stress_adaptive_stop()
+ *	stop the adaptive rate sampler
+ */
+void stress_adaptive_stop(void)
+{
+	int status;
+
+	if (adaptive_pid <= 0)
+		return;
+
+	(void)kill(adaptive_pid, SIGKILL);
+	(void)shim_waitpid(adaptive_pid, &status, 0);
+	adaptive_pid = -1;
+}
@@ -19,8 +19,54 @@
  */
 #include "stress-ng.h"
 
+#if defined(HAVE_LINUX_MEMPOLICY_H)
+#include <linux/mempolicy.h>
+#endif
+
+#define PLACEMENT_NONE		(0)
+#define PLACEMENT_COMPACT	(1)
+#define PLACEMENT_SPREAD	(2)
+#define PLACEMENT_NODE_LOCAL	(3)
+
+typedef struct {
+	const char *name;	/* placement policy name */
+	const int policy;	/* placement policy */
+} stress_placement_policy_t;
+
+static const stress_placement_policy_t placement_policies[] = {
+	{ "compact",	PLACEMENT_COMPACT },
+	{ "spread",	PLACEMENT_SPREAD },
+	{ "node-local",	PLACEMENT_NODE_LOCAL },
+};
+
 static const char option[] = "taskset";
 
+/*
+ * stress_set_placement()
+ * @arg: placement policy name
+ *
+ * Returns: 0 - OK, -1 invalid policy
+ */
+int stress_set_placement(const char *arg)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(placement_policies); i++) {
+		if (!strcmp(arg, placement_policies[i].name)) {
+			int policy = placement_policies[i].policy;
+
+			return stress_set_setting_global("placement", TYPE_ID_INT, &policy);
+		}
+	}
+
+	(void)fprintf(stderr, "placement must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(placement_policies); i++)
+		(void)fprintf(stderr, " %s", placement_policies[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 #if defined(HAVE_SCHED_SETAFFINITY)
 
 /*
@@ -117,6 +163,249 @@ int stress_set_cpu_affinity(const char *arg)
 	return 0;
 }
 
+typedef struct {
+	int32_t cpu;		/* cpu number */
+	int32_t node;		/* NUMA node the cpu belongs to */
+} stress_placement_cpu_t;
+
+typedef struct {
+	int32_t node;		/* NUMA node number */
+	size_t start;		/* index of first cpu of node in placement_cpus */
+	size_t count;		/* number of cpus in node */
+} stress_placement_node_t;
+
+static int placement_policy = PLACEMENT_NONE;
+static stress_placement_cpu_t *placement_cpus;
+static size_t placement_cpus_num;
+static stress_placement_node_t *placement_nodes;
+static size_t placement_nodes_num;
+
+/*
+ *  stress_placement_cpulist()
+ *	parse a sysfs cpulist, e.g. 0-3,8,10-11 and tag each
+ *	cpu in the list in node_map with the given node
+ */
+static void stress_placement_cpulist(
+	char *str,
+	int32_t *node_map,
+	const int32_t max_cpus,
+	const int32_t node)
+{
+	char *ptr, *token;
+
+	for (ptr = str; (token = strtok(ptr, ",\n")) != NULL; ptr = NULL) {
+		int lo, hi, i;
+
+		if (sscanf(token, "%d-%d", &lo, &hi) != 2) {
+			if (sscanf(token, "%d", &lo) != 1)
+				continue;
+			hi = lo;
+		}
+		for (i = lo; (i <= hi) && (i < max_cpus); i++) {
+			if (i >= 0)
+				node_map[i] = node;
+		}
+	}
+}
+
+/*
+ *  stress_placement_node_map()
+ *	map each cpu to its NUMA node, cpus default to node 0
+ *	if the NUMA topology is not available
+ */
+static void stress_placement_node_map(int32_t *node_map, const int32_t max_cpus)
+{
+	DIR *dir;
+	struct dirent *d;
+
+	dir = opendir("/sys/devices/system/node");
+	if (!dir)
+		return;
+
+	while ((d = readdir(dir)) != NULL) {
+		char path[PATH_MAX];
+		char buf[4096];
+		int node;
+
+		if (strncmp(d->d_name, "node", 4))
+			continue;
+		if (sscanf(d->d_name + 4, "%d", &node) != 1)
+			continue;
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/node/%s/cpulist", d->d_name);
+		if (system_read(path, buf, sizeof(buf)) > 0)
+			stress_placement_cpulist(buf, node_map, max_cpus, (int32_t)node);
+	}
+	(void)closedir(dir);
+}
+
+/*
+ *  stress_placement_init()
+ *	build the cpu and NUMA node tables used to place stressor
+ *	instances, only cpus in the current affinity mask are used
+ */
+void stress_placement_init(void)
+{
+	cpu_set_t set;
+	int32_t *node_map;
+	int32_t cpu, node, max_node = 0;
+	const int32_t max_cpus = stress_get_processors_configured();
+
+	(void)stress_get_setting("placement", &placement_policy);
+	if (placement_policy == PLACEMENT_NONE)
+		return;
+	if (max_cpus < 1)
+		goto disable;
+
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		goto disable;
+
+	node_map = calloc((size_t)max_cpus, sizeof(*node_map));
+	if (!node_map)
+		goto disable;
+	stress_placement_node_map(node_map, max_cpus);
+	for (cpu = 0; cpu < max_cpus; cpu++) {
+		if (max_node < node_map[cpu])
+			max_node = node_map[cpu];
+	}
+
+	placement_cpus = calloc((size_t)max_cpus, sizeof(*placement_cpus));
+	placement_nodes = calloc((size_t)max_node + 1, sizeof(*placement_nodes));
+	if (!placement_cpus || !placement_nodes) {
+		free(node_map);
+		goto disable;
+	}
+
+	/* cpus ordered by node and then by cpu number */
+	for (node = 0; node <= max_node; node++) {
+		const size_t start = placement_cpus_num;
+
+		for (cpu = 0; (cpu < max_cpus) && (cpu < CPU_SETSIZE); cpu++) {
+			if ((node_map[cpu] == node) && CPU_ISSET(cpu, &set)) {
+				placement_cpus[placement_cpus_num].cpu = cpu;
+				placement_cpus[placement_cpus_num].node = node;
+				placement_cpus_num++;
+			}
+		}
+		if (placement_cpus_num > start) {
+			placement_nodes[placement_nodes_num].node = node;
+			placement_nodes[placement_nodes_num].start = start;
+			placement_nodes[placement_nodes_num].count = placement_cpus_num - start;
+			placement_nodes_num++;
+		}
+	}
+	free(node_map);
+
+	if (!placement_cpus_num)
+		goto disable;
+
+	pr_dbg("placement: %zu CPUs over %zu NUMA node%s\n",
+		placement_cpus_num, placement_nodes_num,
+		placement_nodes_num == 1 ? "" : "s");
+	return;
+
+disable:
+	pr_inf("placement: cannot determine CPU topology, disabling --placement\n");
+	stress_placement_free();
+}
+
+/*
+ *  stress_placement_free()
+ *	free placement tables
+ */
+void stress_placement_free(void)
+{
+	free(placement_cpus);
+	free(placement_nodes);
+	placement_cpus = NULL;
+	placement_nodes = NULL;
+	placement_cpus_num = 0;
+	placement_nodes_num = 0;
+	placement_policy = PLACEMENT_NONE;
+}
+
+/*
+ *  stress_placement_mbind()
+ *	bind memory allocations of the calling process to a NUMA node
+ */
+static void stress_placement_mbind(const char *name, const int32_t node)
+{
+#if defined(__NR_set_mempolicy) &&	\
+    defined(HAVE_LINUX_MEMPOLICY_H) &&	\
+    defined(MPOL_BIND)
+	unsigned long nodemask[1024 / (sizeof(unsigned long) * 8)];
+	const size_t nodemask_bits = sizeof(nodemask[0]) * 8;
+
+	/* All cpus are on node 0, no point in binding */
+	if (placement_nodes_num < 2)
+		return;
+	if ((size_t)node >= SIZEOF_ARRAY(nodemask) * nodemask_bits)
+		return;
+
+	(void)memset(nodemask, 0, sizeof(nodemask));
+	STRESS_SETBIT(nodemask, node);
+	if (shim_set_mempolicy(MPOL_BIND, nodemask, SIZEOF_ARRAY(nodemask) * nodemask_bits) < 0) {
+		pr_dbg("%s: cannot bind memory to NUMA node %" PRId32 ", errno=%d (%s)\n",
+			name, node, errno, strerror(errno));
+	}
+#else
+	(void)name;
+	(void)node;
+#endif
+}
+
+/*
+ *  stress_placement_apply()
+ *	place a stressor instance on a cpu (or node) according
+ *	to the placement policy and bind its memory allocations
+ *	to the NUMA node of the cpu
+ *	  compact - instances fill the cpus of a node before the next node
+ *	  spread  - instances are distributed round-robin across the nodes
+ *	  node-local - instances are distributed round-robin across the
+ *		nodes and may run on any cpu of the node
+ */
+void stress_placement_apply(const char *name, const uint32_t instance)
+{
+	const stress_placement_node_t *pn;
+	cpu_set_t set;
+	int32_t node;
+	size_t i;
+
+	if ((placement_policy == PLACEMENT_NONE) || (!placement_cpus_num))
+		return;
+
+	CPU_ZERO(&set);
+	switch (placement_policy) {
+	case PLACEMENT_COMPACT:
+		i = (size_t)instance % placement_cpus_num;
+		CPU_SET(placement_cpus[i].cpu, &set);
+		node = placement_cpus[i].node;
+		break;
+	case PLACEMENT_SPREAD:
+		pn = &placement_nodes[(size_t)instance % placement_nodes_num];
+		i = pn->start + (((size_t)instance / placement_nodes_num) % pn->count);
+		CPU_SET(placement_cpus[i].cpu, &set);
+		node = pn->node;
+		break;
+	case PLACEMENT_NODE_LOCAL:
+		pn = &placement_nodes[(size_t)instance % placement_nodes_num];
+		for (i = pn->start; i < pn->start + pn->count; i++)
+			CPU_SET(placement_cpus[i].cpu, &set);
+		node = pn->node;
+		break;
+	default:
+		return;
+	}
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("%s: cannot set placement CPU affinity, errno=%d (%s)\n",
+			name, errno, strerror(errno));
+	}
+	stress_placement_mbind(name, node);
+}
+
 #else
 int stress_set_cpu_affinity(const char *arg)
 {
@@ -125,4 +414,23 @@ int stress_set_cpu_affinity(const char *arg)
 	(void)fprintf(stderr, "%s: setting CPU affinity not supported\n", option);
 	_exit(EXIT_FAILURE);
 }
+
+void stress_placement_init(void)
+{
+	int policy = PLACEMENT_NONE;
+
+	(void)stress_get_setting("placement", &policy);
+	if (policy != PLACEMENT_NONE)
+		pr_inf("placement: setting CPU affinity not supported, ignoring --placement\n");
+}
+
+void stress_placement_free(void)
+{
+}
+
+void stress_placement_apply(const char *name, const uint32_t instance)
+{
+	(void)name;
+	(void)instance;
+}
 #endif
@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-anomaly.h"
+#include "core-thermal-zone.h"
+
+#define ANOMALY_SIGMA_MIN		(1.0)
+#define ANOMALY_SIGMA_MAX		(100.0)
+
+#define ANOMALY_MS_MIN			(100)
+#define ANOMALY_MS_MAX			(3600000)
+#define ANOMALY_MS_DEFAULT		(1000)
+
+#define ANOMALY_WARMUP_SAMPLES		(10)	/* samples before checking rates */
+#define ANOMALY_MIN_DROP		(0.05)	/* ignore drops of less than 5% */
+#define ANOMALY_EVENTS_MAX		(64)	/* events kept for the YAML dump */
+
+/* a rate drop or recovery */
+typedef struct {
+	double time;			/* wall clock time of the event */
+	char stressor[32];		/* stressor name */
+	int32_t instance;		/* instance, -1 = all instances */
+	bool recovered;			/* true if the rate has recovered */
+	double rate;			/* bogo-ops per second */
+	double mean;			/* mean rate before the drop */
+	double stddev;			/* standard deviation before the drop */
+} stress_anomaly_event_t;
+
+/* watchdog results shared with the parent */
+typedef struct {
+	uint32_t n_events;		/* drops and recoveries, may be > ANOMALY_EVENTS_MAX */
+	uint32_t drops;			/* rate drops */
+	bool aborted;			/* run aborted by --anomaly-abort */
+	stress_anomaly_event_t events[ANOMALY_EVENTS_MAX];
+} stress_anomaly_shared_t;
+
+/* rate statistics of a stressor or an instance */
+typedef struct {
+	uint64_t prev;			/* previous bogo-op counter */
+	uint32_t active;		/* active instances at the previous sample */
+	double n;			/* rate samples */
+	double mean;			/* running mean rate */
+	double m2;			/* running sum of squared differences */
+	bool anomalous;			/* rate is currently dropped */
+} stress_anomaly_track_t;
+
+static double anomaly_sigma;		/* 0.0 = disabled */
+static pid_t anomaly_pid;
+static stress_anomaly_shared_t *anomaly_shared;
+static bool anomaly_aborted;
+#if defined(STRESS_THERMAL_ZONES)
+static stress_tz_t anomaly_tz;
+#endif
+
+/*
+ *  stress_set_anomaly_sigma()
+ *	set the number of standard deviations below the mean
+ *	rate that is flagged as a throughput anomaly
+ */
+int stress_set_anomaly_sigma(const char *opt)
+{
+	double sigma;
+
+	if ((sscanf(opt, "%lf", &sigma) != 1) ||
+	    (sigma < ANOMALY_SIGMA_MIN) || (sigma > ANOMALY_SIGMA_MAX)) {
+		(void)fprintf(stderr, "anomaly-sigma must be in the range %.0f to %.0f\n",
+			ANOMALY_SIGMA_MIN, ANOMALY_SIGMA_MAX);
+		return -1;
+	}
+	anomaly_sigma = sigma;
+	return 0;
+}
+
+/*
+ *  stress_set_anomaly_abort()
+ *	stop the run on the first throughput drop
+ */
+int stress_set_anomaly_abort(const char *opt)
+{
+	bool anomaly_abort = true;
+
+	(void)opt;
+	return stress_set_setting_global("anomaly-abort", TYPE_ID_BOOL, &anomaly_abort);
+}
+
+/*
+ *  stress_set_anomaly_ms()
+ *	set interval between throughput samples in milliseconds
+ */
+int stress_set_anomaly_ms(const char *opt)
+{
+	uint32_t anomaly_ms;
+
+	anomaly_ms = stress_get_uint32(opt);
+	stress_check_range("anomaly-ms", (uint64_t)anomaly_ms,
+		ANOMALY_MS_MIN, ANOMALY_MS_MAX);
+	return stress_set_setting_global("anomaly-ms", TYPE_ID_UINT32, &anomaly_ms);
+}
+
+/*
+ *  stress_anomaly_context()
+ *	describe the system state at the time of an anomaly
+ */
+static void stress_anomaly_context(char *buf, const size_t len)
+{
+	double min1 = 0.0, min5, min15, avg_ghz, min_ghz, max_ghz;
+	size_t shmall, freemem, totalmem, freeswap, totalswap;
+	int ret;
+
+	if (stress_get_load_avg(&min1, &min5, &min15) < 0)
+		min1 = 0.0;
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap, &totalswap);
+	stress_get_cpu_ghz(&avg_ghz, &min_ghz, &max_ghz);
+
+	ret = snprintf(buf, len, "load %.2f, MemFree %zu MB, SwapFree %zu MB",
+		min1, freemem / (size_t)MB, freeswap / (size_t)MB);
+	if ((ret > 0) && ((size_t)ret < len) && (avg_ghz > 0.0)) {
+		const int n = snprintf(buf + ret, len - (size_t)ret, ", CPU %.2f GHz", avg_ghz);
+
+		if (n > 0)
+			ret += n;
+	}
+#if defined(STRESS_THERMAL_ZONES)
+	if ((ret > 0) && ((size_t)ret < len) && g_shared->tz_info &&
+	    (stress_tz_get_temperatures(&g_shared->tz_info, &anomaly_tz) == 0)) {
+		stress_tz_info_t *tz_info;
+
+		for (tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next) {
+			const int n = snprintf(buf + ret, len - (size_t)ret, ", %s %.2f C",
+				tz_info->type,
+				(double)anomaly_tz.tz_stat[tz_info->index].temperature / 1000.0);
+
+			if ((n < 0) || ((size_t)(ret + n) >= len))
+				break;
+			ret += n;
+		}
+	}
+#else
+	(void)ret;
+#endif
+}
+
+/*
+ *  stress_anomaly_event()
+ *	log a timestamped rate drop or recovery and keep it for
+ *	the YAML dump
+ */
+static void stress_anomaly_event(
+	const char *name,
+	const int32_t instance,
+	const bool recovered,
+	const double rate,
+	const double mean,
+	const double stddev)
+{
+	const time_t now = time(NULL);
+	struct tm *tm = localtime(&now);
+	char when[32], who[48], context[256];
+
+	if (!tm || !strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", tm))
+		(void)shim_strlcpy(when, "unknown", sizeof(when));
+	if (instance < 0)
+		(void)snprintf(who, sizeof(who), "%s", name);
+	else
+		(void)snprintf(who, sizeof(who), "%s instance %" PRId32, name, instance);
+
+	if (recovered) {
+		pr_inf("anomaly: %s %s rate recovered to %.2f bogo ops/s (mean %.2f)\n",
+			when, who, rate, mean);
+	} else {
+		stress_anomaly_context(context, sizeof(context));
+		pr_warn("anomaly: %s %s rate dropped to %.2f bogo ops/s, %.1f sigma "
+			"below mean %.2f (%.1f%% drop), %s\n", when, who, rate,
+			(stddev > 0.0) ? (mean - rate) / stddev : 0.0, mean,
+			100.0 * (mean - rate) / mean, context);
+		anomaly_shared->drops++;
+	}
+
+	if (anomaly_shared->n_events < ANOMALY_EVENTS_MAX) {
+		stress_anomaly_event_t *event = &anomaly_shared->events[anomaly_shared->n_events];
+
+		event->time = (double)now;
+		(void)shim_strlcpy(event->stressor, name, sizeof(event->stressor));
+		event->instance = instance;
+		event->recovered = recovered;
+		event->rate = rate;
+		event->mean = mean;
+		event->stddev = stddev;
+	}
+	anomaly_shared->n_events++;
+}
+
+/*
+ *  stress_anomaly_check()
+ *	compare a rate against the running mean and standard deviation,
+ *	returns true if this is the start of a rate drop. Rates during
+ *	a drop are not added to the statistics so a persistent drop
+ *	does not become the new normal.
+ */
+static bool stress_anomaly_check(
+	stress_anomaly_track_t *track,
+	const char *name,
+	const int32_t instance,
+	const double rate,
+	const double sigma)
+{
+	double delta, stddev;
+
+	if (track->n >= ANOMALY_WARMUP_SAMPLES) {
+		stddev = sqrt(track->m2 / (track->n - 1.0));
+		if ((rate < track->mean - (sigma * stddev)) &&
+		    (rate < track->mean * (1.0 - ANOMALY_MIN_DROP))) {
+			if (track->anomalous)
+				return false;
+			track->anomalous = true;
+			stress_anomaly_event(name, instance, false, rate, track->mean, stddev);
+			return true;
+		}
+		if (track->anomalous) {
+			track->anomalous = false;
+			stress_anomaly_event(name, instance, true, rate, track->mean, stddev);
+		}
+	}
+	/* Welford's running mean and variance */
+	track->n += 1.0;
+	delta = rate - track->mean;
+	track->mean += delta / track->n;
+	track->m2 += delta * (rate - track->mean);
+
+	return false;
+}
+
+/*
+ *  stress_anomaly_start()
+ *	fork a watchdog that samples the shared stressor counters and
+ *	flags per stressor and per instance bogo-op rate drops of more
+ *	than --anomaly-sigma standard deviations below the mean rate,
+ *	with --anomaly-abort the run is stopped on the first drop
+ */
+void stress_anomaly_start(stress_stressor_t *stressors_list)
+{
+	const double sigma = anomaly_sigma;
+	uint32_t anomaly_ms = ANOMALY_MS_DEFAULT;
+	bool anomaly_abort = false;
+	stress_stressor_t *ss;
+	stress_anomaly_track_t *tracks;
+	size_t n, num_tracks = 0;
+	double t_prev, t_next;
+
+	if (sigma <= 0.0)
+		return;
+	(void)stress_get_setting("anomaly-ms", &anomaly_ms);
+	(void)stress_get_setting("anomaly-abort", &anomaly_abort);
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		num_tracks += 1 + (size_t)ss->num_instances;
+	if (!num_tracks)
+		return;
+
+	anomaly_shared = (stress_anomaly_shared_t *)mmap(NULL, sizeof(*anomaly_shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (anomaly_shared == MAP_FAILED) {
+		pr_inf("anomaly: cannot mmap %zu bytes of shared state, disabling anomaly detection\n",
+			sizeof(*anomaly_shared));
+		anomaly_shared = NULL;
+		return;
+	}
+
+	anomaly_pid = fork();
+	if ((anomaly_pid < 0) || (anomaly_pid > 0))
+		return;
+
+	stress_set_proc_name("stat [anomaly]");
+
+	tracks = calloc(num_tracks, sizeof(*tracks));
+	if (!tracks) {
+		pr_err("anomaly: cannot allocate rate statistics\n");
+		_exit(EXIT_FAILURE);
+	}
+
+	t_prev = stress_time_now();
+	t_next = t_prev;
+
+	while (keep_stressing_flag()) {
+		double t_now, t_delta;
+		bool dropped = false;
+
+		t_next += (double)anomaly_ms / 1000.0;
+		t_delta = t_next - stress_time_now();
+		if (t_delta > 0.0)
+			(void)shim_nanosleep_uint64((uint64_t)(t_delta * STRESS_DBL_NANOSECOND));
+		if (!keep_stressing_flag())
+			break;
+
+		t_now = stress_time_now();
+		t_delta = t_now - t_prev;
+		t_prev = t_now;
+		if (t_delta <= 0.0)
+			continue;
+
+		for (n = 0, ss = stressors_list; ss; ss = ss->next) {
+			const char *munged = stress_munge_underscore(ss->stressor->name);
+			stress_anomaly_track_t *all = &tracks[n++];
+			uint64_t counter = 0;
+			uint32_t active = 0;
+			int32_t j;
+
+			if (!ss->stats) {
+				n += (size_t)ss->num_instances;
+				continue;
+			}
+			for (j = 0; j < ss->num_instances; j++) {
+				const stress_stats_t *const stats = ss->stats[j];
+				stress_anomaly_track_t *track = &tracks[n++];
+				const uint64_t c = stats->ci.counter;
+
+				/* only running instances, counters restart on a new run */
+				if ((stats->start <= 0.0) || (stats->finish > stats->start)) {
+					track->active = 0;
+					continue;
+				}
+				active++;
+				counter += c;
+				if (track->active && (c >= track->prev))
+					dropped |= stress_anomaly_check(track, munged, j,
+						(double)(c - track->prev) / t_delta, sigma);
+				track->prev = c;
+				track->active = 1;
+			}
+			/* aggregate rate only over samples with the same instances */
+			if (active && (active == all->active) && (counter >= all->prev))
+				dropped |= stress_anomaly_check(all, munged, -1,
+					(double)(counter - all->prev) / t_delta, sigma);
+			all->prev = counter;
+			all->active = active;
+		}
+
+		if (dropped && anomaly_abort) {
+			pr_warn("anomaly: aborting run on throughput drop\n");
+			anomaly_shared->aborted = true;
+			(void)kill(getppid(), SIGINT);
+			break;
+		}
+	}
+	free(tracks);
+	_exit(0);
+}
+
+/*
+ *  stress_anomaly_stop()
+ *	stop the watchdog before stressors finish and their rates fall
+ */
+void stress_anomaly_stop(void)
+{
+	if (anomaly_pid > 0) {
+		int status;
+
+		(void)kill(anomaly_pid, SIGKILL);
+		(void)waitpid(anomaly_pid, &status, 0);
+		anomaly_pid = 0;
+	}
+}
+
+/*
+ *  stress_anomaly_dump()
+ *	dump the rate drops and recoveries
+ */
+void stress_anomaly_dump(FILE *yaml)
+{
+	uint32_t i, n;
+
+	if (!anomaly_shared)
+		return;
+	n = STRESS_MINIMUM(anomaly_shared->n_events, ANOMALY_EVENTS_MAX);
+	pr_inf("anomaly: %" PRIu32 " throughput drop%s detected%s\n",
+		anomaly_shared->drops, (anomaly_shared->drops == 1) ? "" : "s",
+		anomaly_shared->aborted ? ", run aborted" : "");
+
+	pr_yaml(yaml, "anomalies:\n");
+	pr_yaml(yaml, "    drops: %" PRIu32 "\n", anomaly_shared->drops);
+	pr_yaml(yaml, "    aborted: %s\n", anomaly_shared->aborted ? "true" : "false");
+	if (n > 0)
+		pr_yaml(yaml, "    events:\n");
+	for (i = 0; i < n; i++) {
+		const stress_anomaly_event_t *event = &anomaly_shared->events[i];
+
+		pr_yaml(yaml, "      - stressor: %s\n", event->stressor);
+		if (event->instance >= 0)
+			pr_yaml(yaml, "        instance: %" PRId32 "\n", event->instance);
+		pr_yaml(yaml, "        event: %s\n", event->recovered ? "recovered" : "drop");
+		pr_yaml(yaml, "        epoch-secs: %.0f\n", event->time);
+		pr_yaml(yaml, "        bogo-ops-per-second: %f\n", event->rate);
+		pr_yaml(yaml, "        mean-bogo-ops-per-second: %f\n", event->mean);
+		pr_yaml(yaml, "        stddev-bogo-ops-per-second: %f\n", event->stddev);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_anomaly_free()
+ *	free the shared state, remembering if the run was aborted
+ */
+void stress_anomaly_free(void)
+{
+	if (!anomaly_shared)
+		return;
+	anomaly_aborted = anomaly_shared->aborted;
+	(void)munmap((void *)anomaly_shared, sizeof(*anomaly_shared));
+	anomaly_shared = NULL;
+}
+
+/*
+ *  stress_anomaly_aborted()
+ *	true if --anomaly-abort stopped the run
+ */
+bool stress_anomaly_aborted(void)
+{
+	return anomaly_aborted;
+}
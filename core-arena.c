@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arena.h"
+
+/* chunk header is padded so allocations stay STRESS_ARENA_ALIGN aligned */
+#define STRESS_ARENA_HDR_SIZE	\
+	((sizeof(stress_arena_chunk_t) + (STRESS_ARENA_ALIGN - 1)) & ~(size_t)(STRESS_ARENA_ALIGN - 1))
+
+/*
+ *  stress_arena_use_chunk()
+ *	make chunk the chunk being allocated from
+ */
+static inline void stress_arena_use_chunk(stress_arena_t *arena, stress_arena_chunk_t *chunk)
+{
+	arena->chunk = chunk;
+	arena->ptr = (uint8_t *)chunk + STRESS_ARENA_HDR_SIZE;
+	arena->end = (uint8_t *)chunk + chunk->size;
+}
+
+/*
+ *  stress_arena_chunk_new()
+ *	mmap a new chunk big enough for size bytes of allocations
+ */
+static stress_arena_chunk_t *stress_arena_chunk_new(stress_arena_t *arena, const size_t size)
+{
+	const size_t page_size = stress_get_page_size();
+	stress_arena_chunk_t *chunk;
+	size_t chunk_size = arena->chunk_size;
+
+	if (size > chunk_size - STRESS_ARENA_HDR_SIZE) {
+		if (size > SIZE_MAX - STRESS_ARENA_HDR_SIZE - page_size)
+			return NULL;
+		chunk_size = (size + STRESS_ARENA_HDR_SIZE + page_size - 1) & ~(page_size - 1);
+	}
+	chunk = (stress_arena_chunk_t *)mmap(NULL, chunk_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (chunk == MAP_FAILED)
+		return NULL;
+	stress_set_vma_anon_name(chunk, chunk_size, "arena");
+	chunk->next = NULL;
+	chunk->size = chunk_size;
+	arena->mapped += chunk_size;
+
+	return chunk;
+}
+
+/*
+ *  stress_arena_create()
+ *	create an arena that maps memory in chunk_size chunks,
+ *	a chunk_size of 0 uses the default STRESS_ARENA_CHUNK_SIZE
+ */
+stress_arena_t *stress_arena_create(const size_t chunk_size)
+{
+	const size_t page_size = stress_get_page_size();
+	stress_arena_t *arena;
+	stress_arena_chunk_t *chunk;
+
+	arena = (stress_arena_t *)calloc(1, sizeof(*arena));
+	if (!arena)
+		return NULL;
+
+	arena->chunk_size = chunk_size ? chunk_size : STRESS_ARENA_CHUNK_SIZE;
+	arena->chunk_size = (arena->chunk_size + page_size - 1) & ~(page_size - 1);
+
+	chunk = stress_arena_chunk_new(arena, 0);
+	if (!chunk) {
+		free(arena);
+		return NULL;
+	}
+	arena->head = chunk;
+	stress_arena_use_chunk(arena, chunk);
+
+	return arena;
+}
+
+/*
+ *  stress_arena_alloc_chunk()
+ *	slow path of stress_arena_alloc(), the current chunk is full
+ *	so move to the next chunk with enough space, chunks kept from
+ *	before a reset are re-used before new chunks are mapped
+ */
+void *stress_arena_alloc_chunk(stress_arena_t *arena, const size_t size)
+{
+	stress_arena_chunk_t *chunk;
+	void *ptr;
+
+	for (chunk = arena->chunk->next; chunk; chunk = chunk->next) {
+		if (size <= chunk->size - STRESS_ARENA_HDR_SIZE)
+			break;
+	}
+	if (!chunk) {
+		chunk = stress_arena_chunk_new(arena, size);
+		if (UNLIKELY(!chunk))
+			return NULL;
+		chunk->next = arena->chunk->next;
+		arena->chunk->next = chunk;
+	}
+	stress_arena_use_chunk(arena, chunk);
+	ptr = (void *)arena->ptr;
+	arena->ptr += size;
+
+	return ptr;
+}
+
+/*
+ *  stress_arena_reset()
+ *	free all the allocations in the arena in one go, the
+ *	chunks stay mapped for re-use
+ */
+void stress_arena_reset(stress_arena_t *arena)
+{
+	if (!arena)
+		return;
+	stress_arena_use_chunk(arena, arena->head);
+}
+
+/*
+ *  stress_arena_destroy()
+ *	free all the allocations and unmap the arena
+ */
+void stress_arena_destroy(stress_arena_t *arena)
+{
+	stress_arena_chunk_t *chunk;
+
+	if (!arena)
+		return;
+
+	chunk = arena->head;
+	while (chunk) {
+		stress_arena_chunk_t *next = chunk->next;
+
+		(void)munmap((void *)chunk, chunk->size);
+		chunk = next;
+	}
+	free(arena);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_ARENA_H
+#define CORE_ARENA_H
+
+#define STRESS_ARENA_ALIGN	(16)		/* allocation alignment */
+#define STRESS_ARENA_CHUNK_SIZE	(256 * KB)	/* default chunk size */
+
+/* mmap'd chunk of arena memory */
+typedef struct stress_arena_chunk {
+	struct stress_arena_chunk *next;	/* next chunk */
+	size_t size;				/* chunk size incl. header */
+} stress_arena_chunk_t;
+
+/* bump allocator arena, freed in bulk by reset or destroy */
+typedef struct {
+	stress_arena_chunk_t *head;	/* first chunk */
+	stress_arena_chunk_t *chunk;	/* chunk being allocated from */
+	uint8_t *ptr;			/* next free byte in chunk */
+	uint8_t *end;			/* end of chunk */
+	size_t chunk_size;		/* size of new chunks */
+	size_t mapped;			/* bytes of chunks mapped */
+} stress_arena_t;
+
+extern WARN_UNUSED stress_arena_t *stress_arena_create(const size_t chunk_size);
+extern WARN_UNUSED void *stress_arena_alloc_chunk(stress_arena_t *arena, const size_t size);
+extern void stress_arena_reset(stress_arena_t *arena);
+extern void stress_arena_destroy(stress_arena_t *arena);
+
+/*
+ *  stress_arena_alloc()
+ *	allocate size bytes from the arena, there is no per-object
+ *	free, memory is reclaimed by stress_arena_reset()
+ */
+static inline void * ALWAYS_INLINE stress_arena_alloc(stress_arena_t *arena, const size_t size)
+{
+	const size_t sz = (size + (STRESS_ARENA_ALIGN - 1)) & ~(size_t)(STRESS_ARENA_ALIGN - 1);
+	void *ptr;
+
+	if (UNLIKELY(sz > (size_t)(arena->end - arena->ptr)))
+		return stress_arena_alloc_chunk(arena, sz);
+	ptr = (void *)arena->ptr;
+	arena->ptr += sz;
+	return ptr;
+}
+
+/*
+ *  stress_arena_calloc()
+ *	allocate n zero'd objects of size bytes from the arena
+ */
+static inline void * ALWAYS_INLINE stress_arena_calloc(stress_arena_t *arena, const size_t n, const size_t size)
+{
+	void *ptr;
+
+	if (UNLIKELY((size != 0) && (n > (SIZE_MAX / size))))
+		return NULL;
+	ptr = stress_arena_alloc(arena, n * size);
+	if (LIKELY(ptr != NULL))
+		(void)memset(ptr, 0, n * size);
+	return ptr;
+}
+
+#endif
@@ -29,6 +29,95 @@ static inline void stress_asm_arm_yield(void)
 	__asm__ __volatile__("yield;\n");
 }
 
+#if defined(HAVE_ASM_ARM_RNDR)
+/*
+ *  stress_asm_arm_rndr()
+ *	read 64 bit random value, rndr sets the Z flag
+ *	if a random number could not be generated
+ */
+static inline uint64_t stress_asm_arm_rndr(void)
+{
+	uint64_t ret;
+
+	__asm__ __volatile__(
+	"1:;\n\
+		mrs %0, s3_3_c2_c4_0;\n\
+		b.eq 1b;\n"
+	: "=r"(ret) : : "cc");
+
+	return ret;
+}
+#endif
+
+#if defined(HAVE_ASM_ARM_DMB_ISH)
+static inline void stress_asm_arm_dmb_ish(void)
+{
+	__asm__ __volatile__("dmb ish" : : : "memory");
+}
+#endif
+
+#if defined(HAVE_ASM_ARM_DSB_ISH)
+static inline void stress_asm_arm_dsb_ish(void)
+{
+	__asm__ __volatile__("dsb ish" : : : "memory");
+}
+#endif
+
+#if defined(HAVE_ASM_ARM_ISB)
+static inline void stress_asm_arm_isb(void)
+{
+	__asm__ __volatile__("isb" : : : "memory");
+}
+#endif
+
+#if defined(__aarch64__)
+/*
+ *  stress_asm_arm_cntvct()
+ *	read the generic timer virtual count
+ */
+static inline uint64_t stress_asm_arm_cntvct(void)
+{
+	uint64_t val;
+
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (val));
+	return val;
+}
+
+/*
+ *  stress_asm_arm_cntfrq()
+ *	read the generic timer frequency in Hz
+ */
+static inline uint64_t stress_asm_arm_cntfrq(void)
+{
+	uint64_t val;
+
+	__asm__ __volatile__("mrs %0, cntfrq_el0" : "=r" (val));
+	return val;
+}
+
+/*
+ *  stress_asm_arm_ldaxr()
+ *	load acquire exclusive, arms the exclusive monitor so that
+ *	a store to addr by another cpu generates a wfe wake up event
+ */
+static inline uint64_t stress_asm_arm_ldaxr(uint64_t *addr)
+{
+	uint64_t val;
+
+	__asm__ __volatile__("ldaxr %0, [%1]" : "=r" (val) : "r" (addr) : "memory");
+	return val;
+}
+
+/*
+ *  stress_asm_arm_wfe()
+ *	wait for event
+ */
+static inline void stress_asm_arm_wfe(void)
+{
+	__asm__ __volatile__("wfe" : : : "memory");
+}
+#endif
+
 /* #if defined(STRESS_ARCH_ARM) */
 #endif
 
@@ -92,6 +92,20 @@ static inline uint64_t stress_asm_x86_rdtsc(void)
 #endif
 }
 
+#if defined(HAVE_ASM_X86_RDTSCP)
+/*
+ *  x86 read TSC and processor ID, waits for prior instructions
+ */
+static inline uint64_t stress_asm_x86_rdtscp(uint32_t *aux)
+{
+	uint32_t lo, hi, id;
+
+	__asm__ __volatile__("rdtscp" : "=a" (lo), "=d" (hi), "=c" (id));
+	*aux = id;
+	return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
 #if defined(STRESS_ARCH_X86_64) &&	\
     defined(HAVE_ASM_X86_RDRAND)
 /*
@@ -254,6 +268,13 @@ static inline void stress_asm_x86_mfence(void)
 }
 #endif
 
+#if defined(HAVE_ASM_X86_SFENCE)
+static inline void stress_asm_x86_sfence(void)
+{
+	__asm__ __volatile__("sfence" : : : "memory");
+}
+#endif
+
 #if defined(HAVE_ASM_X86_PREFETCHT0)
 static inline void stress_asm_x86_prefetcht0(void *p)
 {
@@ -282,6 +303,13 @@ static inline void stress_asm_x86_prefetchnta(void *p)
 }
 #endif
 
+#if defined(HAVE_ASM_X86_PREFETCHW)
+static inline void stress_asm_x86_prefetchw(void *p)
+{
+	__asm__ __volatile__("prefetchw (%0)\n" : : "r"(p) : "memory");
+}
+#endif
+
 #if !defined(__PCC__) && 	\
     defined(HAVE_ARCH_X86_64)
 static inline int stress_asm_x86_umwait__(int state, uint32_t hi, uint32_t lo)
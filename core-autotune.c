@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-autotune.h"
+#include "core-cache-probe.h"
+
+#include <sys/utsname.h>
+
+/*
+ *  --autotune probes the host once, measured cache sizes, memory
+ *  bandwidth and page size support, and keeps the results in a
+ *  host profile file. The profile is reused while the host name,
+ *  CPU count and memory size (within 1/16) match, and each stressor buffer size
+ *  that is not set on the command line is derived from it so the
+ *  stressor targets its intended cache level or DRAM rather than
+ *  the desktop class defaults.
+ */
+#define AUTOTUNE_PROFILE_NAME		".stress-ng-profile"
+#define AUTOTUNE_CACHE_LEVELS		(4)
+#define AUTOTUNE_HUGEPAGE_SIZES		(8)
+#define AUTOTUNE_BW_MIN			(64 * MB)
+#define AUTOTUNE_BW_MAX			(1 * GB)
+#define AUTOTUNE_BW_TIME		(0.25)
+#define AUTOTUNE_DRAM_DEFAULT		(256 * MB)	/* vm-bytes, memrate-bytes default */
+
+/* host profile */
+typedef struct {
+	char host[256];			/* host name */
+	int32_t cpus;			/* configured CPUs */
+	uint64_t memory;		/* physical memory in bytes */
+	uint64_t cache_size[AUTOTUNE_CACHE_LEVELS]; /* L1..L4 size, 0 = none */
+	uint64_t page_size;		/* base page size */
+	uint64_t hugepage_size[AUTOTUNE_HUGEPAGE_SIZES]; /* hugetlb page sizes */
+	size_t hugepage_sizes;		/* number of hugetlb page sizes */
+	char thp[16];			/* transparent huge page mode, "" = none */
+	double bandwidth;		/* memcpy bandwidth in MB per second */
+} stress_autotune_profile_t;
+
+/* a derived stressor default */
+typedef struct {
+	const char *name;		/* setting name */
+	const char *target;		/* intended cache level or DRAM */
+	stress_type_id_t type_id;	/* TYPE_ID_SIZE_T or TYPE_ID_UINT64 */
+	uint64_t value;			/* derived value, 0 = not derived */
+	bool applied;			/* false if set on the command line */
+} stress_autotune_default_t;
+
+static stress_autotune_profile_t autotune_profile;
+static char autotune_path[PATH_MAX];
+static bool autotune_probed;
+static bool autotune_done;
+
+static stress_autotune_default_t autotune_defaults[] = {
+	{ "matrix-size",	"L2",	TYPE_ID_SIZE_T,	0, false },
+	{ "matrix-3d-size",	"DRAM",	TYPE_ID_SIZE_T,	0, false },
+	{ "memrate-bytes",	"DRAM",	TYPE_ID_UINT64,	0, false },
+	{ "prefetch-L3-size",	"LLC",	TYPE_ID_SIZE_T,	0, false },
+	{ "stream-L3-size",	"LLC",	TYPE_ID_UINT64,	0, false },
+	{ "vm-bytes",		"DRAM",	TYPE_ID_SIZE_T,	0, false },
+};
+
+/*
+ *  stress_set_autotune()
+ *	enable --autotune
+ */
+int stress_set_autotune(const char *opt)
+{
+	bool autotune = true;
+
+	(void)opt;
+	return stress_set_setting_global("autotune", TYPE_ID_BOOL, &autotune);
+}
+
+/*
+ *  stress_autotune_host()
+ *	fill in the host identity of a profile
+ */
+static void stress_autotune_host(stress_autotune_profile_t *profile)
+{
+	struct utsname uts;
+
+	(void)memset(profile, 0, sizeof(*profile));
+	if (uname(&uts) == 0)
+		(void)shim_strlcpy(profile->host, uts.nodename, sizeof(profile->host));
+	profile->cpus = stress_get_processors_configured();
+	profile->memory = stress_get_phys_mem_size();
+}
+
+/*
+ *  stress_autotune_llc()
+ *	size of the last level cache of the profile, 0 if unknown
+ */
+static uint64_t stress_autotune_llc(const stress_autotune_profile_t *profile)
+{
+	int i;
+
+	for (i = AUTOTUNE_CACHE_LEVELS - 1; i >= 0; i--) {
+		if (profile->cache_size[i])
+			return profile->cache_size[i];
+	}
+	return 0;
+}
+
+/*
+ *  stress_autotune_bandwidth()
+ *	measure memcpy bandwidth over a buffer 4 times the
+ *	size of the last level cache
+ */
+static double stress_autotune_bandwidth(const stress_autotune_profile_t *profile)
+{
+	size_t size = (size_t)stress_autotune_llc(profile) * 4;
+	uint8_t *buf;
+	double t_start, t, bytes = 0.0;
+
+	size = STRESS_MAXIMUM(size, (size_t)AUTOTUNE_BW_MIN);
+	size = STRESS_MINIMUM(size, (size_t)AUTOTUNE_BW_MAX);
+	size = STRESS_MINIMUM(size, (size_t)(profile->memory / 8));
+	size &= ~(size_t)(profile->page_size - 1);
+	if (size < 2 * profile->page_size)
+		return 0.0;
+
+	buf = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return 0.0;
+	(void)memset(buf, 0xa5, size);
+
+	/* read one half and write the other half */
+	t_start = stress_time_now();
+	do {
+		(void)memcpy(buf + size / 2, buf, size / 2);
+		(void)memcpy(buf, buf + size / 2, size / 2);
+		bytes += (double)size * 2.0;
+		t = stress_time_now() - t_start;
+	} while ((t < AUTOTUNE_BW_TIME) && keep_stressing_flag());
+	(void)munmap((void *)buf, size);
+
+	return (t > 0.0) ? (bytes / t) / (double)MB : 0.0;
+}
+
+/*
+ *  stress_autotune_pages()
+ *	find the base page size, hugetlb page sizes and
+ *	transparent huge page mode
+ */
+static void stress_autotune_pages(stress_autotune_profile_t *profile)
+{
+	DIR *dir;
+	const struct dirent *d;
+	char buf[64], *ptr, *end;
+
+	profile->page_size = (uint64_t)stress_get_page_size();
+
+	dir = opendir("/sys/kernel/mm/hugepages");
+	if (dir) {
+		while ((d = readdir(dir)) != NULL) {
+			uint64_t kb;
+
+			if (profile->hugepage_sizes >= AUTOTUNE_HUGEPAGE_SIZES)
+				break;
+			if (sscanf(d->d_name, "hugepages-%" SCNu64 "kB", &kb) == 1)
+				profile->hugepage_size[profile->hugepage_sizes++] = kb * KB;
+		}
+		(void)closedir(dir);
+	}
+
+	(void)memset(buf, 0, sizeof(buf));
+	if (system_read("/sys/kernel/mm/transparent_hugepage/enabled", buf, sizeof(buf) - 1) > 0) {
+		ptr = strchr(buf, '[');
+		end = ptr ? strchr(ptr, ']') : NULL;
+		if (ptr && end) {
+			*end = '\0';
+			(void)shim_strlcpy(profile->thp, ptr + 1, sizeof(profile->thp));
+		}
+	}
+}
+
+/*
+ *  stress_autotune_probe()
+ *	probe the host for a new profile
+ */
+static void stress_autotune_probe(stress_autotune_profile_t *profile)
+{
+	uint16_t level;
+
+	pr_inf("autotune: probing host, this is done once and saved in %s\n", autotune_path);
+	stress_cache_probe_measure();
+	for (level = 1; level <= AUTOTUNE_CACHE_LEVELS; level++)
+		profile->cache_size[level - 1] = stress_cache_probe_size(level);
+	stress_autotune_pages(profile);
+	profile->bandwidth = stress_autotune_bandwidth(profile);
+	autotune_probed = true;
+}
+
+/*
+ *  stress_autotune_load()
+ *	load the host profile, returns -1 if it is missing or
+ *	was made on a different host
+ */
+static int stress_autotune_load(const stress_autotune_profile_t *host, stress_autotune_profile_t *profile)
+{
+	FILE *fp;
+	char buf[512];
+	uint64_t diff;
+
+	fp = fopen(autotune_path, "r");
+	if (!fp)
+		return -1;
+	(void)memset(profile, 0, sizeof(*profile));
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *val = strchr(buf, ':');
+		uint64_t u64;
+		unsigned int level;
+
+		if ((*buf == '#') || !val)
+			continue;
+		*val++ = '\0';
+		while (isspace((unsigned char)*val))
+			val++;
+		val[strcspn(val, "\n")] = '\0';
+
+		if (!strcmp(buf, "host")) {
+			(void)shim_strlcpy(profile->host, val, sizeof(profile->host));
+		} else if (!strcmp(buf, "cpus")) {
+			(void)sscanf(val, "%" SCNd32, &profile->cpus);
+		} else if (!strcmp(buf, "memory")) {
+			(void)sscanf(val, "%" SCNu64, &profile->memory);
+		} else if (sscanf(buf, "cache-l%u-size", &level) == 1) {
+			if ((level >= 1) && (level <= AUTOTUNE_CACHE_LEVELS) &&
+			    (sscanf(val, "%" SCNu64, &u64) == 1))
+				profile->cache_size[level - 1] = u64;
+		} else if (!strcmp(buf, "page-size")) {
+			(void)sscanf(val, "%" SCNu64, &profile->page_size);
+		} else if (!strcmp(buf, "hugepage-size")) {
+			if ((profile->hugepage_sizes < AUTOTUNE_HUGEPAGE_SIZES) &&
+			    (sscanf(val, "%" SCNu64, &u64) == 1))
+				profile->hugepage_size[profile->hugepage_sizes++] = u64;
+		} else if (!strcmp(buf, "thp")) {
+			(void)shim_strlcpy(profile->thp, val, sizeof(profile->thp));
+		} else if (!strcmp(buf, "memory-bandwidth")) {
+			(void)sscanf(val, "%lf", &profile->bandwidth);
+		}
+	}
+	(void)fclose(fp);
+
+	/* memory size drifts a little with ballooning and hotplug */
+	diff = (profile->memory > host->memory) ?
+		profile->memory - host->memory : host->memory - profile->memory;
+	if (strcmp(profile->host, host->host) || (profile->cpus != host->cpus) ||
+	    (diff > host->memory / 16)) {
+		pr_inf("autotune: %s was made on a different host configuration\n", autotune_path);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_autotune_save()
+ *	save the host profile
+ */
+static void stress_autotune_save(const stress_autotune_profile_t *profile)
+{
+	FILE *fp;
+	size_t i;
+
+	fp = fopen(autotune_path, "w");
+	if (!fp) {
+		pr_inf("autotune: cannot save host profile %s, errno=%d (%s)\n",
+			autotune_path, errno, strerror(errno));
+		return;
+	}
+	(void)fprintf(fp, "# stress-ng --autotune host profile, remove to re-probe the host\n");
+	(void)fprintf(fp, "host: %s\n", profile->host);
+	(void)fprintf(fp, "cpus: %" PRId32 "\n", profile->cpus);
+	(void)fprintf(fp, "memory: %" PRIu64 "\n", profile->memory);
+	for (i = 0; i < AUTOTUNE_CACHE_LEVELS; i++) {
+		if (profile->cache_size[i])
+			(void)fprintf(fp, "cache-l%zu-size: %" PRIu64 "\n", i + 1, profile->cache_size[i]);
+	}
+	(void)fprintf(fp, "page-size: %" PRIu64 "\n", profile->page_size);
+	for (i = 0; i < profile->hugepage_sizes; i++)
+		(void)fprintf(fp, "hugepage-size: %" PRIu64 "\n", profile->hugepage_size[i]);
+	if (*profile->thp)
+		(void)fprintf(fp, "thp: %s\n", profile->thp);
+	(void)fprintf(fp, "memory-bandwidth: %.1f\n", profile->bandwidth);
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_autotune_derive()
+ *	derive the stressor defaults from the host profile:
+ *	- matrix-size: the 3 matrices fill 3/4 of the L2 cache
+ *	- matrix-3d-size: the 3 matrices are twice the LLC size
+ *	- prefetch-L3-size, stream-L3-size: the LLC size
+ *	- vm-bytes, memrate-bytes: 4 times the LLC size when that
+ *	  is more than the default, at most a quarter of memory
+ */
+static void stress_autotune_derive(const stress_autotune_profile_t *profile)
+{
+	const uint64_t l2 = profile->cache_size[1];
+	const uint64_t llc = stress_autotune_llc(profile);
+	const uint64_t elem = sizeof(float);
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(autotune_defaults); i++) {
+		stress_autotune_default_t *def = &autotune_defaults[i];
+		uint64_t value = 0;
+
+		if (!strcmp(def->name, "matrix-size")) {
+			if (l2)
+				value = (uint64_t)sqrt((double)(l2 * 3 / 4) / (double)(3 * elem));
+			value = STRESS_MINIMUM(value, 8192);
+			if (value < 16)
+				value = 0;
+		} else if (!strcmp(def->name, "matrix-3d-size")) {
+			if (llc)
+				value = (uint64_t)cbrt((double)(llc * 2) / (double)(3 * elem));
+			value = STRESS_MINIMUM(value, 1024);
+			if (value < 16)
+				value = 0;
+		} else if (!strcmp(def->name, "vm-bytes") || !strcmp(def->name, "memrate-bytes")) {
+			value = llc * 4;
+			value = STRESS_MINIMUM(value, profile->memory / 4);
+			if (value <= AUTOTUNE_DRAM_DEFAULT)
+				value = 0;
+		} else {
+			value = llc;
+		}
+		def->value = value;
+	}
+}
+
+/*
+ *  stress_autotune()
+ *	load or probe the host profile and set the stressor
+ *	defaults that are not set on the command line
+ */
+void stress_autotune(void)
+{
+	stress_autotune_profile_t host;
+	bool autotune = false;
+	char *path = NULL;
+	size_t i;
+
+	(void)stress_get_setting("autotune", &autotune);
+	if (!autotune)
+		return;
+
+	if (stress_get_setting("autotune-profile", &path)) {
+		(void)shim_strlcpy(autotune_path, path, sizeof(autotune_path));
+	} else {
+		const char *home = getenv("HOME");
+
+		(void)snprintf(autotune_path, sizeof(autotune_path), "%s/%s",
+			home ? home : stress_get_temp_path(), AUTOTUNE_PROFILE_NAME);
+	}
+
+	stress_autotune_host(&host);
+	if (stress_autotune_load(&host, &autotune_profile) < 0) {
+		autotune_profile = host;
+		stress_autotune_probe(&autotune_profile);
+		stress_autotune_save(&autotune_profile);
+	}
+	autotune_done = true;
+
+	pr_inf("autotune: L1 %" PRIu64 "K, L2 %" PRIu64 "K, LLC %" PRIu64 "K, "
+		"%.1f MB/s memcpy, %" PRIu64 "K pages, %zu hugetlb page sizes, THP %s\n",
+		(uint64_t)(autotune_profile.cache_size[0] / KB),
+		(uint64_t)(autotune_profile.cache_size[1] / KB),
+		(uint64_t)(stress_autotune_llc(&autotune_profile) / KB), autotune_profile.bandwidth,
+		(uint64_t)(autotune_profile.page_size / KB), autotune_profile.hugepage_sizes,
+		*autotune_profile.thp ? autotune_profile.thp : "n/a");
+
+	stress_autotune_derive(&autotune_profile);
+	for (i = 0; i < SIZEOF_ARRAY(autotune_defaults); i++) {
+		stress_autotune_default_t *def = &autotune_defaults[i];
+		const size_t sz = (size_t)def->value;
+		int ret;
+
+		if (!def->value)
+			continue;
+		if (def->type_id == TYPE_ID_SIZE_T)
+			ret = stress_set_setting_default(def->name, def->type_id, &sz);
+		else
+			ret = stress_set_setting_default(def->name, def->type_id, &def->value);
+		def->applied = (ret == 0);
+		pr_inf("autotune: %-16s %12" PRIu64 " (%s)%s\n", def->name, def->value,
+			def->target, def->applied ? "" : ", already set, not changed");
+	}
+}
+
+/*
+ *  stress_autotune_dump()
+ *	dump the host profile and derived stressor defaults
+ */
+void stress_autotune_dump(FILE *yaml)
+{
+	size_t i;
+
+	if (!autotune_done)
+		return;
+
+	pr_yaml(yaml, "autotune:\n");
+	pr_yaml(yaml, "    profile: %s\n", autotune_path);
+	pr_yaml(yaml, "    probed: %s\n", autotune_probed ? "true" : "false");
+	for (i = 0; i < AUTOTUNE_CACHE_LEVELS; i++) {
+		if (autotune_profile.cache_size[i])
+			pr_yaml(yaml, "    cache-l%zu-size: %" PRIu64 "\n", i + 1, autotune_profile.cache_size[i]);
+	}
+	pr_yaml(yaml, "    page-size: %" PRIu64 "\n", autotune_profile.page_size);
+	for (i = 0; i < autotune_profile.hugepage_sizes; i++)
+		pr_yaml(yaml, "    hugepage-size: %" PRIu64 "\n", autotune_profile.hugepage_size[i]);
+	if (*autotune_profile.thp)
+		pr_yaml(yaml, "    thp: %s\n", autotune_profile.thp);
+	pr_yaml(yaml, "    memory-bandwidth-mb-per-sec: %f\n", autotune_profile.bandwidth);
+	pr_yaml(yaml, "    defaults:\n");
+	for (i = 0; i < SIZEOF_ARRAY(autotune_defaults); i++) {
+		const stress_autotune_default_t *def = &autotune_defaults[i];
+
+		if (!def->value)
+			continue;
+		pr_yaml(yaml, "      - setting: %s\n", def->name);
+		pr_yaml(yaml, "        value: %" PRIu64 "\n", def->value);
+		pr_yaml(yaml, "        target: %s\n", def->target);
+		pr_yaml(yaml, "        applied: %s\n", def->applied ? "true" : "false");
+	}
+	pr_yaml(yaml, "\n");
+}
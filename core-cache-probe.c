@@ -0,0 +1,528 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cache-probe.h"
+#include "core-cpu-cache.h"
+#include "core-put.h"
+
+/*
+ *  --cache-probe measures the cache geometry rather than trusting
+ *  sysfs/cpuid, which is frequently wrong inside virtual machines:
+ *
+ *  - sizes: latency of a random pointer chase against working set
+ *    size, a step up in latency marks the end of a cache level
+ *  - line size: random chase where each 512 byte block is visited
+ *    twice, at offset 0 and offset s, the second load only hits the
+ *    cache while s is less than the line size
+ *  - L1 associativity: chase k addresses that map to the same set,
+ *    latency steps up once k exceeds the number of ways
+ */
+#define STRESS_CACHE_PROBE_LEVELS	(4)
+#define STRESS_CACHE_PROBE_MIN		(2 * KB)
+#define STRESS_CACHE_PROBE_MAX		(256 * MB)
+#define STRESS_CACHE_PROBE_NODE		(64)
+#define STRESS_CACHE_PROBE_BLOCK	(512)
+#define STRESS_CACHE_PROBE_WAYS_MAX	(32)
+#define STRESS_CACHE_PROBE_TIME		(0.002)
+#define STRESS_CACHE_PROBE_STEP		(1.5)
+#define STRESS_CACHE_PROBE_SIZES	(64)
+#define STRESS_CACHE_PROBE_HUGE		(2 * MB)
+
+typedef struct {
+	uint64_t declared_size;		/* sysfs/cpuid size, 0 = unknown */
+	uint64_t measured_size;		/* measured size, 0 = not found */
+	uint32_t declared_line_size;	/* sysfs/cpuid line size, 0 = unknown */
+	uint32_t declared_ways;		/* sysfs/cpuid ways, 0 = unknown */
+	double latency;			/* load to use latency in nanosecs */
+} stress_cache_probe_level_t;
+
+static stress_cache_probe_level_t probe_levels[STRESS_CACHE_PROBE_LEVELS];
+static size_t probe_levels_measured;	/* levels found by measurement */
+static size_t probe_levels_declared;	/* levels declared by sysfs/cpuid */
+static uint32_t probe_line_size;	/* measured line size, 0 = unknown */
+static uint32_t probe_ways;		/* measured L1 ways, 0 = unknown */
+static double probe_memory_latency;	/* latency beyond the last level */
+static bool probe_done;
+
+/*
+ *  stress_set_cache_probe()
+ *	enable --cache-probe
+ */
+int stress_set_cache_probe(const char *opt)
+{
+	bool cache_probe = true;
+
+	(void)opt;
+	return stress_set_setting_global("cache-probe", TYPE_ID_BOOL, &cache_probe);
+}
+
+#define CHASE4	p = (void **)*p; p = (void **)*p; p = (void **)*p; p = (void **)*p;
+#define CHASE16	CHASE4 CHASE4 CHASE4 CHASE4
+
+/*
+ *  stress_cache_probe_chase()
+ *	follow a pointer chain for STRESS_CACHE_PROBE_TIME seconds,
+ *	return nanoseconds per dependent load
+ */
+static double OPTIMIZE3 stress_cache_probe_chase(void *start)
+{
+	register void **p = (void **)start;
+	const double t_start = stress_time_now();
+	double t;
+	uint64_t loads = 0;
+
+	do {
+		register int i;
+
+		for (i = 0; i < 16; i++) {
+			CHASE16
+		}
+		loads += 256;
+		t = stress_time_now() - t_start;
+	} while (t < STRESS_CACHE_PROBE_TIME);
+	stress_void_ptr_put((volatile void *)p);
+
+	return (t * STRESS_DBL_NANOSECOND) / (double)loads;
+}
+
+/*
+ *  stress_cache_probe_latency()
+ *	warm up the chain and return the best of three measurements
+ */
+static double stress_cache_probe_latency(void *start)
+{
+	double best;
+	int i;
+
+	(void)stress_cache_probe_chase(start);
+	best = stress_cache_probe_chase(start);
+	for (i = 0; i < 2; i++) {
+		const double latency = stress_cache_probe_chase(start);
+
+		best = STRESS_MINIMUM(best, latency);
+	}
+	return best;
+}
+
+/*
+ *  stress_cache_probe_link()
+ *	link offsets[0..n-1] within buf into a cyclic pointer chain
+ */
+static void stress_cache_probe_link(uint8_t *buf, const size_t *offsets, const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		*(void **)(buf + offsets[i]) = (void *)(buf + offsets[(i + 1) % n]);
+}
+
+/*
+ *  stress_cache_probe_shuffle()
+ *	Fisher-Yates shuffle of n offsets
+ */
+static void stress_cache_probe_shuffle(size_t *offsets, const size_t n)
+{
+	size_t i;
+
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = (size_t)stress_mwc32modn((uint32_t)(i + 1));
+		const size_t tmp = offsets[i];
+
+		offsets[i] = offsets[j];
+		offsets[j] = tmp;
+	}
+}
+
+/*
+ *  stress_cache_probe_sizes()
+ *	measure latency against working set sizes of 2^n and 1.5 * 2^n
+ *	bytes and find the latency steps that mark each cache level
+ */
+static void stress_cache_probe_sizes(uint8_t *buf, const size_t max_size, size_t *offsets)
+{
+	size_t sizes[STRESS_CACHE_PROBE_SIZES];
+	double latencies[STRESS_CACHE_PROBE_SIZES];
+	size_t i, n_sizes = 0, size;
+	double base;
+	bool prev_step = false;
+
+	for (size = STRESS_CACHE_PROBE_MIN; size <= max_size; size <<= 1) {
+		sizes[n_sizes++] = size;
+		if ((size + (size >> 1) <= max_size) && (n_sizes < STRESS_CACHE_PROBE_SIZES))
+			sizes[n_sizes++] = size + (size >> 1);
+		if (n_sizes >= STRESS_CACHE_PROBE_SIZES - 1)
+			break;
+	}
+
+	for (i = 0; (i < n_sizes) && keep_stressing_flag(); i++) {
+		const size_t n = sizes[i] / STRESS_CACHE_PROBE_NODE;
+		size_t j;
+
+		for (j = 0; j < n; j++)
+			offsets[j] = j * STRESS_CACHE_PROBE_NODE;
+		stress_cache_probe_shuffle(offsets, n);
+		stress_cache_probe_link(buf, offsets, n);
+		latencies[i] = stress_cache_probe_latency(buf + offsets[0]);
+		pr_dbg("cache-probe: working set %zuK, %.2f nanosecs per load\n",
+			sizes[i] >> 10, latencies[i]);
+	}
+	n_sizes = i;
+	if (n_sizes == 0)
+		return;
+
+	/*
+	 *  A step is a latency more than STRESS_CACHE_PROBE_STEP times
+	 *  the highest latency seen on the current plateau, consecutive
+	 *  steps are one transition
+	 */
+	base = latencies[0];
+	for (i = 1; i < n_sizes; i++) {
+		if (latencies[i] > base * STRESS_CACHE_PROBE_STEP) {
+			if (!prev_step) {
+				if (probe_levels_measured >= STRESS_CACHE_PROBE_LEVELS)
+					break;
+				probe_levels[probe_levels_measured].measured_size = sizes[i - 1];
+				probe_levels[probe_levels_measured].latency = base;
+				probe_levels_measured++;
+			}
+			base = latencies[i];
+			prev_step = true;
+		} else {
+			base = STRESS_MAXIMUM(base, latencies[i]);
+			prev_step = false;
+		}
+	}
+	probe_memory_latency = latencies[n_sizes - 1];
+}
+
+/*
+ *  stress_cache_probe_line_size()
+ *	visit random 512 byte blocks of a buffer larger than the L1
+ *	cache twice, at offset 0 and offset s, the second load is
+ *	a hit while s is less than the cache line size
+ */
+static void stress_cache_probe_line_size(uint8_t *buf, const size_t size, size_t *offsets)
+{
+	const size_t blocks = size / STRESS_CACHE_PROBE_BLOCK;
+	double latencies[6], mid;
+	size_t i, s;
+
+	if (blocks < 2)
+		return;
+
+	for (i = 0, s = 8; s < STRESS_CACHE_PROBE_BLOCK; i++, s <<= 1) {
+		size_t j;
+
+		for (j = 0; j < blocks; j++)
+			offsets[j] = j * STRESS_CACHE_PROBE_BLOCK;
+		stress_cache_probe_shuffle(offsets, blocks);
+		/* interleave offset 0 and offset s of each block */
+		for (j = blocks; j-- > 0; ) {
+			offsets[(j * 2) + 1] = offsets[j] + s;
+			offsets[j * 2] = offsets[j];
+		}
+		stress_cache_probe_link(buf, offsets, blocks * 2);
+		latencies[i] = stress_cache_probe_latency(buf + offsets[0]);
+		pr_dbg("cache-probe: line size test offset %zu, %.2f nanosecs per load\n",
+			s, latencies[i]);
+	}
+
+	/* first offset with a latency above the hit/miss midpoint */
+	mid = (latencies[0] + latencies[i - 1]) / 2.0;
+	if (latencies[i - 1] < latencies[0] * 1.2)
+		return;
+	for (i = 0, s = 8; s < STRESS_CACHE_PROBE_BLOCK; i++, s <<= 1) {
+		if (latencies[i] > mid) {
+			probe_line_size = (uint32_t)s;
+			break;
+		}
+	}
+}
+
+/*
+ *  stress_cache_probe_ways()
+ *	chase k addresses stride bytes apart that all map to the same
+ *	L1 set, the latency steps up when k exceeds the number of ways
+ */
+static void stress_cache_probe_ways(uint8_t *buf, const size_t stride, size_t *offsets)
+{
+	double base = 0.0;
+	size_t k;
+
+	for (k = 1; (k <= STRESS_CACHE_PROBE_WAYS_MAX) && keep_stressing_flag(); k++) {
+		size_t j;
+		double latency;
+
+		for (j = 0; j < k; j++)
+			offsets[j] = j * stride;
+		stress_cache_probe_link(buf, offsets, k);
+		latency = stress_cache_probe_latency(buf);
+		pr_dbg("cache-probe: %zu way conflict test, %.2f nanosecs per load\n",
+			k, latency);
+		if (k == 1) {
+			base = latency;
+		} else if (latency > base * STRESS_CACHE_PROBE_STEP) {
+			probe_ways = (uint32_t)(k - 1);
+			break;
+		}
+	}
+}
+
+/*
+ *  stress_cache_probe_declared()
+ *	fetch the sysfs/cpuid cache details of the current CPU
+ */
+static void stress_cache_probe_declared(void)
+{
+	stress_cpu_cache_cpus_t *cpus;
+	uint16_t level, max_level;
+
+	cpus = stress_cpu_cache_get_all_details();
+	if (!cpus)
+		return;
+	max_level = stress_cpu_cache_get_max_level(cpus);
+	for (level = 1; (level <= max_level) && (level <= STRESS_CACHE_PROBE_LEVELS); level++) {
+		const stress_cpu_cache_t *cache = stress_cpu_cache_get(cpus, level);
+
+		if (!cache)
+			continue;
+		probe_levels[level - 1].declared_size = cache->size;
+		probe_levels[level - 1].declared_line_size = cache->line_size;
+		probe_levels[level - 1].declared_ways = cache->ways;
+		probe_levels_declared = level;
+	}
+	stress_free_cpu_caches(cpus);
+}
+
+/*
+ *  stress_cache_probe_size_str()
+ *	cache size as a human readable string, "-" if unknown
+ */
+static char *stress_cache_probe_size_str(char *str, const size_t len, const uint64_t size)
+{
+	if (size)
+		return stress_uint64_to_str(str, len, size);
+	(void)shim_strlcpy(str, "-", len);
+	return str;
+}
+
+/*
+ *  stress_cache_probe_u32_str()
+ *	unsigned value as a string, "-" if unknown
+ */
+static char *stress_cache_probe_u32_str(char *str, const size_t len, const uint32_t val)
+{
+	if (val)
+		(void)snprintf(str, len, "%" PRIu32, val);
+	else
+		(void)shim_strlcpy(str, "-", len);
+	return str;
+}
+
+/*
+ *  stress_cache_probe_report()
+ *	report measured against declared cache geometry
+ */
+static void stress_cache_probe_report(void)
+{
+	const size_t levels = STRESS_MAXIMUM(probe_levels_measured, probe_levels_declared);
+	bool mismatch = false;
+	size_t i;
+
+	pr_inf("cache-probe: level  declared measured  line size (decl/meas)  ways (decl/meas)  latency (ns)\n");
+	for (i = 0; i < levels; i++) {
+		const stress_cache_probe_level_t *level = &probe_levels[i];
+		char decl[32], meas[32], decl_line[16], meas_line[16], decl_ways[16], meas_ways[16];
+		char latency[32];
+
+		if (level->measured_size)
+			(void)snprintf(latency, sizeof(latency), "%.2f", level->latency);
+		else
+			(void)shim_strlcpy(latency, "-", sizeof(latency));
+
+		pr_inf("cache-probe: L%-4zu %9s %8s  %10s %10s  %7s %8s  %12s\n", i + 1,
+			stress_cache_probe_size_str(decl, sizeof(decl), level->declared_size),
+			stress_cache_probe_size_str(meas, sizeof(meas), level->measured_size),
+			stress_cache_probe_u32_str(decl_line, sizeof(decl_line), level->declared_line_size),
+			stress_cache_probe_u32_str(meas_line, sizeof(meas_line), i == 0 ? probe_line_size : 0),
+			stress_cache_probe_u32_str(decl_ways, sizeof(decl_ways), level->declared_ways),
+			stress_cache_probe_u32_str(meas_ways, sizeof(meas_ways), i == 0 ? probe_ways : 0),
+			latency);
+		if (level->declared_size && level->measured_size &&
+		    ((level->measured_size * 2 < level->declared_size) ||
+		     (level->measured_size > level->declared_size * 2)))
+			mismatch = true;
+	}
+	pr_inf("cache-probe: memory %53s %12.2f\n", "", probe_memory_latency);
+	if (probe_levels_measured != probe_levels_declared)
+		mismatch = true;
+	if (mismatch)
+		pr_warn("cache-probe: measured cache geometry does not match sysfs/cpuid, "
+			"stressors that size buffers from the declared values may target "
+			"a different cache level than intended\n");
+}
+
+/*
+ *  stress_cache_probe_measure()
+ *	measure cache sizes, line size and L1 associativity
+ *	and compare with sysfs/cpuid
+ */
+void stress_cache_probe_measure(void)
+{
+	size_t max_size, mmap_size, l1_size, stride, *offsets;
+	uint8_t *mapping, *buf;
+#if defined(HAVE_SCHED_SETAFFINITY) &&	\
+    defined(HAVE_SCHED_GETAFFINITY)
+	cpu_set_t mask, pin;
+	bool pinned = false;
+#endif
+
+	if (probe_done)
+		return;
+
+	stress_cache_probe_declared();
+
+	/* probe up to 4 times the largest declared cache, at least 16MB */
+	max_size = 16 * MB;
+	if (probe_levels_declared > 0)
+		max_size = STRESS_MAXIMUM(max_size,
+			(size_t)probe_levels[probe_levels_declared - 1].declared_size * 4);
+	max_size = STRESS_MINIMUM(max_size, STRESS_CACHE_PROBE_MAX);
+
+	mmap_size = max_size + STRESS_CACHE_PROBE_HUGE;
+	mapping = (uint8_t *)mmap(NULL, mmap_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		pr_inf("cache-probe: cannot allocate %zu MB probe buffer, skipping probe\n",
+			mmap_size / (size_t)MB);
+		return;
+	}
+	/* huge page aligned and backed to avoid TLB misses looking like cache levels */
+	buf = (uint8_t *)(((uintptr_t)mapping + STRESS_CACHE_PROBE_HUGE - 1) &
+		~(uintptr_t)(STRESS_CACHE_PROBE_HUGE - 1));
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+	(void)madvise((void *)buf, max_size, MADV_HUGEPAGE);
+#endif
+	(void)memset(buf, 0, max_size);
+
+	offsets = (size_t *)calloc(max_size / STRESS_CACHE_PROBE_NODE, sizeof(*offsets));
+	if (!offsets) {
+		pr_inf("cache-probe: cannot allocate probe offsets, skipping probe\n");
+		(void)munmap((void *)mapping, mmap_size);
+		return;
+	}
+
+#if defined(HAVE_SCHED_SETAFFINITY) &&	\
+    defined(HAVE_SCHED_GETAFFINITY)
+	/* stay on one CPU so all measurements see the same caches */
+	if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+		CPU_ZERO(&pin);
+		CPU_SET((int)stress_get_cpu(), &pin);
+		pinned = (sched_setaffinity(0, sizeof(pin), &pin) == 0);
+	}
+#endif
+	pr_inf("cache-probe: measuring cache geometry with working sets up to %zu MB\n",
+		max_size / (size_t)MB);
+
+	stress_cache_probe_sizes(buf, max_size, offsets);
+
+	l1_size = probe_levels[0].measured_size ? (size_t)probe_levels[0].measured_size :
+		(size_t)probe_levels[0].declared_size;
+	if (l1_size == 0)
+		l1_size = 32 * KB;
+	if (keep_stressing_flag())
+		stress_cache_probe_line_size(buf, STRESS_MINIMUM(l1_size * 4, max_size), offsets);
+
+	/* any power of 2 multiple of sets * line size maps to the same set */
+	for (stride = 4 * KB; stride * 2 <= l1_size; stride <<= 1)
+		;
+	if (keep_stressing_flag() && (stride * STRESS_CACHE_PROBE_WAYS_MAX <= max_size))
+		stress_cache_probe_ways(buf, stride, offsets);
+
+#if defined(HAVE_SCHED_SETAFFINITY) &&	\
+    defined(HAVE_SCHED_GETAFFINITY)
+	if (pinned)
+		(void)sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+	free(offsets);
+	(void)munmap((void *)mapping, mmap_size);
+
+	probe_done = true;
+	stress_cache_probe_report();
+}
+
+/*
+ *  stress_cache_probe()
+ *	measure the cache geometry when --cache-probe is enabled
+ */
+void stress_cache_probe(void)
+{
+	bool cache_probe = false;
+
+	(void)stress_get_setting("cache-probe", &cache_probe);
+	if (cache_probe)
+		stress_cache_probe_measure();
+}
+
+/*
+ *  stress_cache_probe_size()
+ *	measured size of a cache level, the sysfs/cpuid size
+ *	if it was not measured, 0 if unknown
+ */
+uint64_t stress_cache_probe_size(const uint16_t level)
+{
+	const stress_cache_probe_level_t *probe_level;
+
+	if ((level < 1) || (level > STRESS_CACHE_PROBE_LEVELS))
+		return 0;
+	probe_level = &probe_levels[level - 1];
+	return probe_level->measured_size ? probe_level->measured_size : probe_level->declared_size;
+}
+
+/*
+ *  stress_cache_probe_dump()
+ *	dump measured vs declared cache geometry to yaml
+ */
+void stress_cache_probe_dump(FILE *yaml)
+{
+	const size_t levels = STRESS_MAXIMUM(probe_levels_measured, probe_levels_declared);
+	size_t i;
+
+	if (!probe_done)
+		return;
+
+	pr_yaml(yaml, "cache-probe:\n");
+	for (i = 0; i < levels; i++) {
+		const stress_cache_probe_level_t *level = &probe_levels[i];
+
+		pr_yaml(yaml, "    - level: %zu\n", i + 1);
+		pr_yaml(yaml, "      declared-size: %" PRIu64 "\n", level->declared_size);
+		pr_yaml(yaml, "      measured-size: %" PRIu64 "\n", level->measured_size);
+		pr_yaml(yaml, "      declared-line-size: %" PRIu32 "\n", level->declared_line_size);
+		pr_yaml(yaml, "      declared-ways: %" PRIu32 "\n", level->declared_ways);
+		if (i == 0) {
+			pr_yaml(yaml, "      measured-line-size: %" PRIu32 "\n", probe_line_size);
+			pr_yaml(yaml, "      measured-ways: %" PRIu32 "\n", probe_ways);
+		}
+		pr_yaml(yaml, "      latency-ns: %f\n", level->latency);
+	}
+	pr_yaml(yaml, "    - memory-latency-ns: %f\n", probe_memory_latency);
+	pr_yaml(yaml, "\n");
+}
@@ -0,0 +1,990 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cgroup.h"
+
+#define CGROUP_MODE_NONE	(0)
+#define CGROUP_MODE_STRESSOR	(1)	/* one cgroup per stressor */
+#define CGROUP_MODE_INSTANCE	(2)	/* one cgroup per stressor instance */
+
+#define CGROUP_CPU_PERIOD_DEFAULT	(100000)
+#define CGROUP_CPU_PERIOD_MIN		(1000)
+#define CGROUP_CPU_PERIOD_MAX		(1000000)
+#define CGROUP_CPU_QUOTA_MIN		(1000)
+#define CGROUP_CPU_QUOTA_UNLIMITED	(UINT64_MAX)
+#define CGROUP_MEMORY_MIN		(1 * MB)
+
+typedef struct {
+	const char *name;	/* mode name */
+	const int mode;		/* mode id */
+} stress_cgroup_mode_t;
+
+static const stress_cgroup_mode_t cgroup_modes[] = {
+	{ "stressor",	CGROUP_MODE_STRESSOR },
+	{ "instance",	CGROUP_MODE_INSTANCE },
+};
+
+/*
+ *  stress_set_cgroup()
+ *	set cgroup mode, a cgroup per stressor or per instance
+ */
+int stress_set_cgroup(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(cgroup_modes); i++) {
+		if (!strcmp(opt, cgroup_modes[i].name)) {
+			int mode = cgroup_modes[i].mode;
+
+			return stress_set_setting_global("cgroup", TYPE_ID_INT, &mode);
+		}
+	}
+	(void)fprintf(stderr, "cgroup must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(cgroup_modes); i++)
+		(void)fprintf(stderr, " %s", cgroup_modes[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_set_cgroup_cpu_max()
+ *	set the cgroup cpu.max bandwidth limit, either max, a percentage
+ *	of one CPU or a quota and optional period in microseconds
+ */
+int stress_set_cgroup_cpu_max(const char *opt)
+{
+	uint64_t quota, period = CGROUP_CPU_PERIOD_DEFAULT;
+	const size_t len = strlen(opt);
+
+	if (!strcmp(opt, "max")) {
+		quota = CGROUP_CPU_QUOTA_UNLIMITED;
+	} else if ((len > 1) && (opt[len - 1] == '%')) {
+		double percent;
+
+		if ((sscanf(opt, "%lf", &percent) != 1) || (percent <= 0.0)) {
+			(void)fprintf(stderr, "cgroup-cpu-max: invalid percentage '%s'\n", opt);
+			return -1;
+		}
+		quota = (uint64_t)((double)period * percent / 100.0);
+	} else {
+		char *end;
+
+		quota = (uint64_t)strtoull(opt, &end, 10);
+		if ((end == opt) || ((*end != '\0') && (*end != ','))) {
+			(void)fprintf(stderr, "cgroup-cpu-max must be max, N%% or "
+				"quota[,period] in microseconds\n");
+			return -1;
+		}
+		if (*end == ',')
+			period = stress_get_uint64(end + 1);
+	}
+	stress_check_range("cgroup-cpu-max period", period,
+		CGROUP_CPU_PERIOD_MIN, CGROUP_CPU_PERIOD_MAX);
+	if (quota < CGROUP_CPU_QUOTA_MIN) {
+		(void)fprintf(stderr, "cgroup-cpu-max quota must be at least %d microseconds\n",
+			CGROUP_CPU_QUOTA_MIN);
+		return -1;
+	}
+	(void)stress_set_setting_global("cgroup-cpu-max-period", TYPE_ID_UINT64, &period);
+	return stress_set_setting_global("cgroup-cpu-max-quota", TYPE_ID_UINT64, &quota);
+}
+
+/*
+ *  stress_set_cgroup_memory_high()
+ *	set the cgroup memory.high throttling limit
+ */
+int stress_set_cgroup_memory_high(const char *opt)
+{
+	uint64_t bytes;
+
+	bytes = stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range("cgroup-memory-high", bytes, CGROUP_MEMORY_MIN, UINT64_MAX);
+	return stress_set_setting_global("cgroup-memory-high", TYPE_ID_UINT64, &bytes);
+}
+
+/*
+ *  stress_set_cgroup_memory_max()
+ *	set the cgroup memory.max hard limit
+ */
+int stress_set_cgroup_memory_max(const char *opt)
+{
+	uint64_t bytes;
+
+	bytes = stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range("cgroup-memory-max", bytes, CGROUP_MEMORY_MIN, UINT64_MAX);
+	return stress_set_setting_global("cgroup-memory-max", TYPE_ID_UINT64, &bytes);
+}
+
+/*
+ *  stress_set_cgroup_io_max()
+ *	set the cgroup io.max limits, this is in the kernel format
+ *	MAJ:MIN followed by rbps, wbps, riops and wiops key=value pairs
+ */
+int stress_set_cgroup_io_max(const char *opt)
+{
+	unsigned int major, minor;
+	int n = 0;
+
+	if ((sscanf(opt, "%u:%u%n", &major, &minor, &n) != 2) ||
+	    (opt[n] != ' ') || !strchr(opt + n, '=')) {
+		(void)fprintf(stderr, "cgroup-io-max must be of the form "
+			"\"MAJ:MIN [rbps=N] [wbps=N] [riops=N] [wiops=N]\"\n");
+		return -1;
+	}
+	return stress_set_setting_global("cgroup-io-max", TYPE_ID_STR, (void *)opt);
+}
+
+/*
+ *  stress_set_cgroup_cpuset()
+ *	set the cgroup cpuset.cpus list
+ */
+int stress_set_cgroup_cpuset(const char *opt)
+{
+	const char *ptr;
+
+	for (ptr = opt; *ptr; ptr++) {
+		if (!isdigit((unsigned char)*ptr) && (*ptr != ',') && (*ptr != '-'))
+			break;
+	}
+	if (!*opt || *ptr) {
+		(void)fprintf(stderr, "cgroup-cpuset must be a list of CPUs, e.g. 0,2-5\n");
+		return -1;
+	}
+	return stress_set_setting_global("cgroup-cpuset", TYPE_ID_STR, (void *)opt);
+}
+
+#if defined(__linux__)
+
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor of this cgroup */
+	char path[PATH_MAX + 96];	/* cgroup directory */
+	int32_t instances;		/* number of per instance cgroups */
+	bool collected;			/* accounting has been read */
+	uint64_t usage_usec;		/* cpu.stat */
+	uint64_t user_usec;
+	uint64_t system_usec;
+	uint64_t nr_periods;
+	uint64_t nr_throttled;
+	uint64_t throttled_usec;
+	uint64_t memory_peak;		/* memory.peak */
+	uint64_t memory_high;		/* memory.events */
+	uint64_t memory_max;
+	uint64_t oom_kill;
+	uint64_t rbytes;		/* io.stat, summed over devices */
+	uint64_t wbytes;
+	uint64_t rios;
+	uint64_t wios;
+	bool memory_peak_valid;
+	bool io_valid;
+} stress_cgroup_t;
+
+static stress_cgroup_t *cgroups;
+static size_t cgroups_num;
+static int cgroup_mode = CGROUP_MODE_NONE;
+static char cgroup_top[PATH_MAX + 32];
+static char cgroup_cpu_max[64];
+static uint64_t cgroup_memory_high;
+static uint64_t cgroup_memory_max;
+static char *cgroup_io_max;
+static char *cgroup_cpuset;
+
+/*
+ *  stress_cgroup_find()
+ *	find the cgroup v2 directory of the stress-ng process
+ */
+static int stress_cgroup_find(char *path, const size_t path_len)
+{
+	FILE *fp;
+	char buffer[PATH_MAX], mount[PATH_MAX], cgroup[PATH_MAX];
+
+	*mount = '\0';
+	fp = fopen("/proc/self/mounts", "r");
+	if (!fp)
+		return -1;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char dir[PATH_MAX], type[32];
+
+		if (sscanf(buffer, "%*s %4095s %31s", dir, type) != 2)
+			continue;
+		if (!strcmp(type, "cgroup2")) {
+			shim_strlcpy(mount, dir, sizeof(mount));
+			break;
+		}
+	}
+	(void)fclose(fp);
+	if (!*mount)
+		return -1;
+
+	/* the cgroup v2 entry is 0::/path */
+	*cgroup = '\0';
+	fp = fopen("/proc/self/cgroup", "r");
+	if (!fp)
+		return -1;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		if (!strncmp(buffer, "0::", 3)) {
+			(void)sscanf(buffer + 3, "%4095s", cgroup);
+			break;
+		}
+	}
+	(void)fclose(fp);
+	if (!*cgroup)
+		return -1;
+
+	(void)snprintf(path, path_len, "%s%s", mount,
+		strcmp(cgroup, "/") ? cgroup : "");
+	return 0;
+}
+
+/*
+ *  stress_cgroup_write()
+ *	write a string to a cgroup control file
+ */
+static int stress_cgroup_write(const char *dir, const char *file, const char *str)
+{
+	char path[PATH_MAX + 192];
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	return (system_write(path, str, strlen(str)) < 0) ? -1 : 0;
+}
+
+/*
+ *  stress_cgroup_has_controller()
+ *	return true if a controller is available in a cgroup
+ */
+static bool stress_cgroup_has_controller(const char *dir, const char *controller)
+{
+	char path[PATH_MAX + 192], buf[256], *token, *ptr;
+
+	(void)snprintf(path, sizeof(path), "%s/cgroup.controllers", dir);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+	for (ptr = buf; (token = strtok(ptr, " \n")) != NULL; ptr = NULL) {
+		if (!strcmp(token, controller))
+			return true;
+	}
+	return false;
+}
+
+/*
+ *  stress_cgroup_enable()
+ *	enable the controllers for the child cgroups of a cgroup
+ */
+static void stress_cgroup_enable(const char *dir)
+{
+	static const char * const controllers[] = {
+		"+cpu", "+memory", "+io", "+cpuset"
+	};
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(controllers); i++) {
+		if (!strcmp(controllers[i], "+cpuset") && !cgroup_cpuset)
+			continue;
+		if (stress_cgroup_write(dir, "cgroup.subtree_control", controllers[i]) < 0) {
+			pr_dbg("cgroup: cannot enable %s controller in %s, errno=%d (%s)\n",
+				controllers[i] + 1, dir, errno, strerror(errno));
+		}
+	}
+}
+
+/*
+ *  stress_cgroup_limit()
+ *	apply the resource limits to a cgroup
+ */
+static void stress_cgroup_limit(const char *dir)
+{
+	char buf[32];
+
+	if (*cgroup_cpu_max &&
+	    (stress_cgroup_write(dir, "cpu.max", cgroup_cpu_max) < 0)) {
+		pr_inf("cgroup: cannot set cpu.max of %s, errno=%d (%s)\n",
+			dir, errno, strerror(errno));
+	}
+	if (cgroup_memory_high) {
+		(void)snprintf(buf, sizeof(buf), "%" PRIu64, cgroup_memory_high);
+		if (stress_cgroup_write(dir, "memory.high", buf) < 0)
+			pr_inf("cgroup: cannot set memory.high of %s, errno=%d (%s)\n",
+				dir, errno, strerror(errno));
+	}
+	if (cgroup_memory_max) {
+		(void)snprintf(buf, sizeof(buf), "%" PRIu64, cgroup_memory_max);
+		if (stress_cgroup_write(dir, "memory.max", buf) < 0)
+			pr_inf("cgroup: cannot set memory.max of %s, errno=%d (%s)\n",
+				dir, errno, strerror(errno));
+	}
+	if (cgroup_io_max &&
+	    (stress_cgroup_write(dir, "io.max", cgroup_io_max) < 0)) {
+		pr_inf("cgroup: cannot set io.max of %s, errno=%d (%s)\n",
+			dir, errno, strerror(errno));
+	}
+	if (cgroup_cpuset &&
+	    (stress_cgroup_write(dir, "cpuset.cpus", cgroup_cpuset) < 0)) {
+		pr_inf("cgroup: cannot set cpuset.cpus of %s, errno=%d (%s)\n",
+			dir, errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_cgroup_check_controllers()
+ *	drop the limits that cannot be applied because
+ *	the controller is not available
+ */
+static void stress_cgroup_check_controllers(void)
+{
+	if (*cgroup_cpu_max && !stress_cgroup_has_controller(cgroup_top, "cpu")) {
+		pr_inf("cgroup: cpu controller not available, ignoring --cgroup-cpu-max\n");
+		*cgroup_cpu_max = '\0';
+	}
+	if ((cgroup_memory_high || cgroup_memory_max) &&
+	    !stress_cgroup_has_controller(cgroup_top, "memory")) {
+		pr_inf("cgroup: memory controller not available, ignoring --cgroup-memory-high and --cgroup-memory-max\n");
+		cgroup_memory_high = 0;
+		cgroup_memory_max = 0;
+	}
+	if (cgroup_io_max && !stress_cgroup_has_controller(cgroup_top, "io")) {
+		pr_inf("cgroup: io controller not available, ignoring --cgroup-io-max\n");
+		cgroup_io_max = NULL;
+	}
+	if (cgroup_cpuset && !stress_cgroup_has_controller(cgroup_top, "cpuset")) {
+		pr_inf("cgroup: cpuset controller not available, ignoring --cgroup-cpuset\n");
+		cgroup_cpuset = NULL;
+	}
+}
+
+/*
+ *  stress_cgroup_init()
+ *	create a cgroup v2 subtree for the run with a cgroup per
+ *	stressor, and optionally per instance, with the resource
+ *	limits applied to the cgroups the instances run in
+ */
+void stress_cgroup_init(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	char self[PATH_MAX];
+	uint64_t quota = 0, period = CGROUP_CPU_PERIOD_DEFAULT;
+	size_t n;
+
+	cgroup_mode = CGROUP_MODE_NONE;
+	*cgroup_cpu_max = '\0';
+	(void)stress_get_setting("cgroup", &cgroup_mode);
+	(void)stress_get_setting("cgroup-cpu-max-quota", &quota);
+	(void)stress_get_setting("cgroup-cpu-max-period", &period);
+	(void)stress_get_setting("cgroup-memory-high", &cgroup_memory_high);
+	(void)stress_get_setting("cgroup-memory-max", &cgroup_memory_max);
+	(void)stress_get_setting("cgroup-io-max", &cgroup_io_max);
+	(void)stress_get_setting("cgroup-cpuset", &cgroup_cpuset);
+
+	if (quota == CGROUP_CPU_QUOTA_UNLIMITED)
+		(void)snprintf(cgroup_cpu_max, sizeof(cgroup_cpu_max), "max %" PRIu64, period);
+	else if (quota)
+		(void)snprintf(cgroup_cpu_max, sizeof(cgroup_cpu_max), "%" PRIu64 " %" PRIu64, quota, period);
+
+	/* Limits without --cgroup imply a cgroup per stressor */
+	if ((cgroup_mode == CGROUP_MODE_NONE) &&
+	    (*cgroup_cpu_max || cgroup_memory_high || cgroup_memory_max ||
+	     cgroup_io_max || cgroup_cpuset))
+		cgroup_mode = CGROUP_MODE_STRESSOR;
+	if (cgroup_mode == CGROUP_MODE_NONE)
+		return;
+
+	if (stress_cgroup_find(self, sizeof(self)) < 0) {
+		pr_inf("cgroup: cannot find cgroup v2 hierarchy, disabling --cgroup\n");
+		goto disable;
+	}
+	(void)snprintf(cgroup_top, sizeof(cgroup_top), "%s/stress-ng-%d", self, (int)getpid());
+
+	/*
+	 *  Controllers can only be enabled in the stress-ng cgroup if it is
+	 *  the root cgroup or has no other processes, without them the
+	 *  cgroups still provide the cpu.stat usage accounting
+	 */
+	stress_cgroup_enable(self);
+	if (mkdir(cgroup_top, S_IRWXU) < 0) {
+		pr_inf("cgroup: cannot create %s, errno=%d (%s), disabling --cgroup\n",
+			cgroup_top, errno, strerror(errno));
+		goto disable;
+	}
+	stress_cgroup_check_controllers();
+	stress_cgroup_enable(cgroup_top);
+
+	for (n = 0, ss = stressors_list; ss; ss = ss->next)
+		n++;
+	cgroups = calloc(n, sizeof(*cgroups));
+	if (!cgroups) {
+		pr_inf("cgroup: cannot allocate cgroup table, disabling --cgroup\n");
+		(void)rmdir(cgroup_top);
+		goto disable;
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_cgroup_t *cg = &cgroups[cgroups_num];
+		int32_t j;
+
+		if (ss->num_instances <= 0)
+			continue;
+		cg->ss = ss;
+		(void)snprintf(cg->path, sizeof(cg->path), "%s/%s", cgroup_top,
+			stress_munge_underscore(ss->stressor->name));
+		if (mkdir(cg->path, S_IRWXU) < 0) {
+			pr_inf("cgroup: cannot create %s, errno=%d (%s)\n",
+				cg->path, errno, strerror(errno));
+			continue;
+		}
+		cgroups_num++;
+		if (cgroup_mode == CGROUP_MODE_STRESSOR) {
+			stress_cgroup_limit(cg->path);
+			continue;
+		}
+
+		stress_cgroup_enable(cg->path);
+		for (j = 0; j < ss->num_instances; j++) {
+			char path[PATH_MAX + 128];
+
+			(void)snprintf(path, sizeof(path), "%s/instance-%" PRId32, cg->path, j);
+			if (mkdir(path, S_IRWXU) < 0) {
+				pr_inf("cgroup: cannot create %s, errno=%d (%s)\n",
+					path, errno, strerror(errno));
+				break;
+			}
+			stress_cgroup_limit(path);
+			cg->instances++;
+		}
+	}
+	pr_dbg("cgroup: created %zu cgroup%s in %s\n", cgroups_num,
+		cgroups_num == 1 ? "" : "s", cgroup_top);
+	return;
+
+disable:
+	cgroup_mode = CGROUP_MODE_NONE;
+	*cgroup_top = '\0';
+}
+
+/*
+ *  stress_cgroup_join()
+ *	move the calling stressor instance into its cgroup
+ */
+void stress_cgroup_join(const stress_stressor_t *ss, const int32_t instance)
+{
+	char path[PATH_MAX + 128], buf[32];
+	size_t i;
+
+	for (i = 0; i < cgroups_num; i++) {
+		const stress_cgroup_t *cg = &cgroups[i];
+
+		if (cg->ss != ss)
+			continue;
+		if (cgroup_mode == CGROUP_MODE_INSTANCE) {
+			if (instance >= cg->instances)
+				return;
+			(void)snprintf(path, sizeof(path), "%s/instance-%" PRId32, cg->path, instance);
+		} else {
+			shim_strlcpy(path, cg->path, sizeof(path));
+		}
+		(void)snprintf(buf, sizeof(buf), "%d", (int)getpid());
+		if (stress_cgroup_write(path, "cgroup.procs", buf) < 0) {
+			pr_dbg("cgroup: cannot move instance %" PRId32 " into %s, errno=%d (%s)\n",
+				instance, path, errno, strerror(errno));
+		}
+		return;
+	}
+}
+
+/*
+ *  stress_cgroup_memory_max()
+ *	get the memory.max limit of the cgroup of the calling
+ *	process, returns -1 if there is no limit
+ */
+int stress_cgroup_memory_max(uint64_t *max)
+{
+	char self[PATH_MAX], path[PATH_MAX + 16], buf[32];
+
+	if (stress_cgroup_find(self, sizeof(self)) < 0)
+		return -1;
+	(void)snprintf(path, sizeof(path), "%s/memory.max", self);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return -1;
+	if (sscanf(buf, "%" SCNu64, max) != 1)
+		return -1;	/* "max", no limit */
+	return 0;
+}
+
+/*
+ *  stress_cgroup_cpu_quota()
+ *	get the tightest cpu.max quota of the cgroup of the calling
+ *	process and its ancestors as a number of CPUs, returns -1
+ *	if there is no quota
+ */
+int stress_cgroup_cpu_quota(double *cpus)
+{
+	char self[PATH_MAX], path[PATH_MAX + 16], buf[64];
+	double quota_cpus = -1.0;
+
+	if (stress_cgroup_find(self, sizeof(self)) < 0)
+		return -1;
+
+	/* pod limits are often set on a parent cgroup, walk up to the root */
+	for (;;) {
+		char *ptr;
+		uint64_t quota, period;
+
+		(void)snprintf(path, sizeof(path), "%s/cpu.max", self);
+		if (system_read(path, buf, sizeof(buf)) <= 0)
+			break;		/* root cgroup has no cpu.max */
+		if ((sscanf(buf, "%" SCNu64 " %" SCNu64, &quota, &period) == 2) &&
+		    (period > 0)) {
+			const double q = (double)quota / (double)period;
+
+			if ((quota_cpus < 0.0) || (q < quota_cpus))
+				quota_cpus = q;
+		}
+		ptr = strrchr(self, '/');
+		if (!ptr || (ptr == self))
+			break;
+		*ptr = '\0';
+	}
+	if (quota_cpus < 0.0)
+		return -1;
+	*cpus = quota_cpus;
+	return 0;
+}
+
+/*
+ *  stress_cgroup_cpuset_cpus()
+ *	get the number of CPUs in cpuset.cpus.effective of the
+ *	cgroup of the calling process, returns -1 if unknown
+ */
+int stress_cgroup_cpuset_cpus(int32_t *cpus)
+{
+	char self[PATH_MAX], path[PATH_MAX + 32], buf[4096];
+	char *ptr;
+	int32_t n = 0;
+
+	if (stress_cgroup_find(self, sizeof(self)) < 0)
+		return -1;
+	(void)snprintf(path, sizeof(path), "%s/cpuset.cpus.effective", self);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return -1;
+
+	/* list of CPUs, e.g. 0-3,8,10-11 */
+	for (ptr = buf; *ptr && (*ptr != '\n'); ) {
+		char *end;
+		unsigned long lo, hi;
+
+		lo = strtoul(ptr, &end, 10);
+		if (end == ptr)
+			return -1;
+		hi = lo;
+		if (*end == '-') {
+			ptr = end + 1;
+			hi = strtoul(ptr, &end, 10);
+			if ((end == ptr) || (hi < lo))
+				return -1;
+		}
+		n += (int32_t)(hi - lo + 1);
+		ptr = end;
+		if (*ptr == ',')
+			ptr++;
+	}
+	if (n < 1)
+		return -1;
+	*cpus = n;
+	return 0;
+}
+
+/*
+ *  stress_cgroup_create()
+ *	create a cgroup named stress-ng-<pid>-<name> below the cgroup
+ *	of the calling process with the given controller enabled,
+ *	for stressors that compare resource control settings. Returns
+ *	-1 if it cannot be created or the controller is not available
+ */
+int stress_cgroup_create(
+	const char *name,
+	const char *controller,
+	char *path,
+	const size_t path_len)
+{
+	char self[PATH_MAX], enable[32];
+
+	if (stress_cgroup_find(self, sizeof(self)) < 0)
+		return -1;
+	(void)snprintf(enable, sizeof(enable), "+%s", controller);
+	(void)stress_cgroup_write(self, "cgroup.subtree_control", enable);
+	(void)snprintf(path, path_len, "%s/stress-ng-%d-%s", self, (int)getpid(), name);
+	if ((mkdir(path, S_IRWXU) < 0) && (errno != EEXIST))
+		return -1;
+	if (!stress_cgroup_has_controller(path, controller)) {
+		(void)rmdir(path);
+		errno = ENOTSUP;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cgroup_set()
+ *	write a value to a control file of a cgroup
+ */
+int stress_cgroup_set(const char *path, const char *file, const char *value)
+{
+	return stress_cgroup_write(path, file, value);
+}
+
+/*
+ *  stress_cgroup_move()
+ *	move a process into a cgroup
+ */
+int stress_cgroup_move(const char *path, const pid_t pid)
+{
+	char buf[32];
+
+	(void)snprintf(buf, sizeof(buf), "%d", (int)pid);
+	return stress_cgroup_write(path, "cgroup.procs", buf);
+}
+
+/*
+ *  stress_cgroup_remove()
+ *	remove a cgroup made by stress_cgroup_create(), it
+ *	must not have any processes in it
+ */
+void stress_cgroup_remove(const char *path)
+{
+	if (rmdir(path) < 0)
+		pr_dbg("cgroup: cannot remove %s, errno=%d (%s)\n",
+			path, errno, strerror(errno));
+}
+
+/*
+ *  stress_cgroup_add_key()
+ *	add a value to the value of a matching key
+ */
+static void stress_cgroup_add_key(
+	const char *key,
+	const uint64_t val,
+	const char * const keys[],
+	uint64_t *values[],
+	const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (!strcmp(key, keys[i])) {
+			*values[i] += val;
+			return;
+		}
+	}
+}
+
+/*
+ *  stress_cgroup_read_keys()
+ *	read space separated key value pairs from a cgroup file, the
+ *	values of keys that are found are added to the values
+ */
+static int stress_cgroup_read_keys(
+	const char *dir,
+	const char *file,
+	const char * const keys[],
+	uint64_t *values[],
+	const size_t n)
+{
+	FILE *fp;
+	char path[PATH_MAX + 192], buffer[512];
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char *token, *ptr, key[64];
+		uint64_t val;
+
+		/* cpu.stat and memory.events have a key and value per line */
+		if (!strchr(buffer, '=')) {
+			if (sscanf(buffer, "%63s %" SCNu64, key, &val) == 2)
+				stress_cgroup_add_key(key, val, keys, values, n);
+			continue;
+		}
+		/* io.stat has a line of key=value pairs per device */
+		for (ptr = buffer; (token = strtok(ptr, " \n")) != NULL; ptr = NULL) {
+			char *eq = strchr(token, '=');
+
+			if (!eq)
+				continue;
+			*eq = '\0';
+			if (sscanf(eq + 1, "%" SCNu64, &val) == 1)
+				stress_cgroup_add_key(token, val, keys, values, n);
+		}
+	}
+	(void)fclose(fp);
+	return 0;
+}
+
+/*
+ *  stress_cgroup_collect()
+ *	read the cgroup accounting of each stressor, the stressor
+ *	cgroup includes the per instance cgroups below it
+ */
+void stress_cgroup_collect(void)
+{
+	size_t i;
+
+	for (i = 0; i < cgroups_num; i++) {
+		stress_cgroup_t *cg = &cgroups[i];
+		char path[PATH_MAX + 192], buf[64];
+		const char * const cpu_keys[] = {
+			"usage_usec", "user_usec", "system_usec",
+			"nr_periods", "nr_throttled", "throttled_usec",
+		};
+		uint64_t *cpu_values[] = {
+			&cg->usage_usec, &cg->user_usec, &cg->system_usec,
+			&cg->nr_periods, &cg->nr_throttled, &cg->throttled_usec,
+		};
+		const char * const memory_keys[] = { "high", "max", "oom_kill" };
+		uint64_t *memory_values[] = {
+			&cg->memory_high, &cg->memory_max, &cg->oom_kill,
+		};
+		const char * const io_keys[] = { "rbytes", "wbytes", "rios", "wios" };
+		uint64_t *io_values[] = {
+			&cg->rbytes, &cg->wbytes, &cg->rios, &cg->wios,
+		};
+
+		cg->usage_usec = 0;
+		cg->user_usec = 0;
+		cg->system_usec = 0;
+		cg->nr_periods = 0;
+		cg->nr_throttled = 0;
+		cg->throttled_usec = 0;
+		cg->memory_high = 0;
+		cg->memory_max = 0;
+		cg->oom_kill = 0;
+		cg->rbytes = 0;
+		cg->wbytes = 0;
+		cg->rios = 0;
+		cg->wios = 0;
+
+		cg->collected = (stress_cgroup_read_keys(cg->path, "cpu.stat",
+			cpu_keys, cpu_values, SIZEOF_ARRAY(cpu_keys)) == 0);
+		(void)stress_cgroup_read_keys(cg->path, "memory.events",
+			memory_keys, memory_values, SIZEOF_ARRAY(memory_keys));
+		cg->io_valid = (stress_cgroup_read_keys(cg->path, "io.stat",
+			io_keys, io_values, SIZEOF_ARRAY(io_keys)) == 0);
+
+		(void)snprintf(path, sizeof(path), "%s/memory.peak", cg->path);
+		cg->memory_peak_valid = (system_read(path, buf, sizeof(buf)) > 0) &&
+			(sscanf(buf, "%" SCNu64, &cg->memory_peak) == 1);
+	}
+}
+
+/*
+ *  stress_cgroup_dump()
+ *	dump the cgroup accounted cpu, memory and io usage of
+ *	each stressor and the limits they were run with
+ */
+void stress_cgroup_dump(FILE *yaml)
+{
+	size_t i;
+
+	if (!cgroups_num)
+		return;
+
+	pr_inf("cgroup: %-13s %10s %10s %10s %10s %10s\n",
+		"stressor", "cpu secs", "throttled%", "mem peak", "io read", "io write");
+	pr_yaml(yaml, "cgroup:\n");
+	pr_yaml(yaml, "      path: %s\n", cgroup_top);
+	pr_yaml(yaml, "      mode: %s\n", cgroup_mode == CGROUP_MODE_INSTANCE ? "instance" : "stressor");
+	if (*cgroup_cpu_max)
+		pr_yaml(yaml, "      cpu-max: %s\n", cgroup_cpu_max);
+	if (cgroup_memory_high)
+		pr_yaml(yaml, "      memory-high: %" PRIu64 "\n", cgroup_memory_high);
+	if (cgroup_memory_max)
+		pr_yaml(yaml, "      memory-max: %" PRIu64 "\n", cgroup_memory_max);
+	if (cgroup_io_max)
+		pr_yaml(yaml, "      io-max: %s\n", cgroup_io_max);
+	if (cgroup_cpuset)
+		pr_yaml(yaml, "      cpuset: %s\n", cgroup_cpuset);
+	pr_yaml(yaml, "      stressors:\n");
+
+	for (i = 0; i < cgroups_num; i++) {
+		const stress_cgroup_t *cg = &cgroups[i];
+		const char *munged = stress_munge_underscore(cg->ss->stressor->name);
+		const double throttled = cg->nr_periods ?
+			100.0 * (double)cg->nr_throttled / (double)cg->nr_periods : 0.0;
+		char peak[32], rbytes[32], wbytes[32];
+
+		if (!cg->collected)
+			continue;
+		if (cg->memory_peak_valid)
+			(void)stress_uint64_to_str(peak, sizeof(peak), cg->memory_peak);
+		else
+			(void)shim_strlcpy(peak, "-", sizeof(peak));
+		if (cg->io_valid) {
+			(void)stress_uint64_to_str(rbytes, sizeof(rbytes), cg->rbytes);
+			(void)stress_uint64_to_str(wbytes, sizeof(wbytes), cg->wbytes);
+		} else {
+			(void)shim_strlcpy(rbytes, "-", sizeof(rbytes));
+			(void)shim_strlcpy(wbytes, "-", sizeof(wbytes));
+		}
+		pr_inf("cgroup: %-13s %10.2f %10.2f %10s %10s %10s\n",
+			munged, (double)cg->usage_usec / STRESS_DBL_MICROSECOND,
+			throttled, peak, rbytes, wbytes);
+
+		pr_yaml(yaml, "        - stressor: %s\n", munged);
+		pr_yaml(yaml, "          cpu-usage-usecs: %" PRIu64 "\n", cg->usage_usec);
+		pr_yaml(yaml, "          cpu-user-usecs: %" PRIu64 "\n", cg->user_usec);
+		pr_yaml(yaml, "          cpu-system-usecs: %" PRIu64 "\n", cg->system_usec);
+		pr_yaml(yaml, "          cpu-nr-periods: %" PRIu64 "\n", cg->nr_periods);
+		pr_yaml(yaml, "          cpu-nr-throttled: %" PRIu64 "\n", cg->nr_throttled);
+		pr_yaml(yaml, "          cpu-throttled-usecs: %" PRIu64 "\n", cg->throttled_usec);
+		if (cg->memory_peak_valid)
+			pr_yaml(yaml, "          memory-peak: %" PRIu64 "\n", cg->memory_peak);
+		pr_yaml(yaml, "          memory-high-events: %" PRIu64 "\n", cg->memory_high);
+		pr_yaml(yaml, "          memory-max-events: %" PRIu64 "\n", cg->memory_max);
+		pr_yaml(yaml, "          memory-oom-kills: %" PRIu64 "\n", cg->oom_kill);
+		if (cg->io_valid) {
+			pr_yaml(yaml, "          io-read-bytes: %" PRIu64 "\n", cg->rbytes);
+			pr_yaml(yaml, "          io-write-bytes: %" PRIu64 "\n", cg->wbytes);
+			pr_yaml(yaml, "          io-read-ops: %" PRIu64 "\n", cg->rios);
+			pr_yaml(yaml, "          io-write-ops: %" PRIu64 "\n", cg->wios);
+		}
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_cgroup_free()
+ *	remove the cgroups, this can only be done
+ *	once all the instances have exited
+ */
+void stress_cgroup_free(void)
+{
+	size_t i;
+
+	for (i = 0; i < cgroups_num; i++) {
+		const stress_cgroup_t *cg = &cgroups[i];
+		int32_t j;
+
+		for (j = 0; j < cg->instances; j++) {
+			char path[PATH_MAX + 128];
+
+			(void)snprintf(path, sizeof(path), "%s/instance-%" PRId32, cg->path, j);
+			(void)rmdir(path);
+		}
+		if (rmdir(cg->path) < 0)
+			pr_dbg("cgroup: cannot remove %s, errno=%d (%s)\n",
+				cg->path, errno, strerror(errno));
+	}
+	if (*cgroup_top)
+		(void)rmdir(cgroup_top);
+	free(cgroups);
+	cgroups = NULL;
+	cgroups_num = 0;
+	cgroup_mode = CGROUP_MODE_NONE;
+	*cgroup_top = '\0';
+}
+
+#else
+void stress_cgroup_init(stress_stressor_t *stressors_list)
+{
+	int mode = CGROUP_MODE_NONE;
+
+	(void)stressors_list;
+	(void)stress_get_setting("cgroup", &mode);
+	if (mode != CGROUP_MODE_NONE)
+		pr_inf("cgroup: cgroup v2 is not supported, ignoring --cgroup\n");
+}
+
+void stress_cgroup_join(const stress_stressor_t *ss, const int32_t instance)
+{
+	(void)ss;
+	(void)instance;
+}
+
+int stress_cgroup_memory_max(uint64_t *max)
+{
+	(void)max;
+
+	return -1;
+}
+
+int stress_cgroup_cpu_quota(double *cpus)
+{
+	(void)cpus;
+
+	return -1;
+}
+
+int stress_cgroup_cpuset_cpus(int32_t *cpus)
+{
+	(void)cpus;
+
+	return -1;
+}
+
+int stress_cgroup_create(
+	const char *name,
+	const char *controller,
+	char *path,
+	const size_t path_len)
+{
+	(void)name;
+	(void)controller;
+	(void)path;
+	(void)path_len;
+
+	errno = ENOSYS;
+	return -1;
+}
+
+int stress_cgroup_set(const char *path, const char *file, const char *value)
+{
+	(void)path;
+	(void)file;
+	(void)value;
+
+	errno = ENOSYS;
+	return -1;
+}
+
+int stress_cgroup_move(const char *path, const pid_t pid)
+{
+	(void)path;
+	(void)pid;
+
+	errno = ENOSYS;
+	return -1;
+}
+
+void stress_cgroup_remove(const char *path)
+{
+	(void)path;
+}
+
+void stress_cgroup_collect(void)
+{
+}
+
+void stress_cgroup_dump(FILE *yaml)
+{
+	(void)yaml;
+}
+
+void stress_cgroup_free(void)
+{
+}
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_CGROUP_H
+#define CORE_CGROUP_H
+
+/* cgroup v2 resource controlled runs */
+extern int stress_set_cgroup(const char *opt);
+extern int stress_set_cgroup_cpu_max(const char *opt);
+extern int stress_set_cgroup_memory_high(const char *opt);
+extern int stress_set_cgroup_memory_max(const char *opt);
+extern int stress_set_cgroup_io_max(const char *opt);
+extern int stress_set_cgroup_cpuset(const char *opt);
+extern void stress_cgroup_init(stress_stressor_t *stressors_list);
+extern void stress_cgroup_join(const stress_stressor_t *ss, const int32_t instance);
+extern int stress_cgroup_memory_max(uint64_t *max);
+extern int stress_cgroup_cpu_quota(double *cpus);
+extern int stress_cgroup_cpuset_cpus(int32_t *cpus);
+extern int stress_cgroup_create(const char *name, const char *controller,
+	char *path, const size_t path_len);
+extern int stress_cgroup_set(const char *path, const char *file, const char *value);
+extern int stress_cgroup_move(const char *path, const pid_t pid);
+extern void stress_cgroup_remove(const char *path);
+extern void stress_cgroup_collect(void);
+extern void stress_cgroup_dump(FILE *yaml);
+extern void stress_cgroup_free(void);
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-clocksource.h"
+#include "core-cpu.h"
+
+#define CLOCKSOURCE_CALIBRATE_NS	(20000000ULL)	/* 20ms calibration period */
+#define CLOCKSOURCE_READS		(10000)		/* reads to measure overhead */
+
+stress_clocksource_t g_clocksource;
+
+/*
+ *  stress_clocksource_usable()
+ *	check if the cycle counter runs at a constant rate and is
+ *	synchronized across the CPUs, on x86 the TSC must be invariant
+ *	and the kernel must trust it as its own clocksource
+ */
+static bool stress_clocksource_usable(void)
+{
+#if defined(STRESS_ARCH_X86)
+	char buf[64];
+
+	if (!stress_cpu_x86_has_tsc() || !stress_cpu_x86_has_invariant_tsc())
+		return false;
+	if (system_read("/sys/devices/system/clocksource/clocksource0/current_clocksource",
+			buf, sizeof(buf)) > 0) {
+		buf[strcspn(buf, "\n")] = '\0';
+		if (strcmp(buf, "tsc"))
+			return false;
+	}
+	return true;
+#elif defined(STRESS_ARCH_ARM) &&	\
+      defined(__aarch64__)
+	return stress_asm_arm_cntfrq() != 0;
+#else
+	return false;
+#endif
+}
+
+/*
+ *  stress_clocksource_calibrate()
+ *	find the nanoseconds per counter tick, returns false
+ *	if the counter does not look sane
+ */
+static bool stress_clocksource_calibrate(void)
+{
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(__aarch64__)
+	g_clocksource.ns_per_tick = STRESS_DBL_NANOSECOND / (double)stress_asm_arm_cntfrq();
+	g_clocksource.base_ns = stress_clocksource_monotonic_ns();
+	g_clocksource.base_ticks = stress_clocksource_ticks();
+	return true;
+#else
+	uint64_t t0, t1, c0, c1;
+
+	/* a counter read between two clock reads pins it to their midpoint */
+	t0 = stress_clocksource_monotonic_ns();
+	c0 = stress_clocksource_ticks();
+	t0 = (t0 + stress_clocksource_monotonic_ns()) / 2;
+
+	(void)shim_nanosleep_uint64(CLOCKSOURCE_CALIBRATE_NS);
+
+	t1 = stress_clocksource_monotonic_ns();
+	c1 = stress_clocksource_ticks();
+	t1 = (t1 + stress_clocksource_monotonic_ns()) / 2;
+
+	if ((c1 <= c0) || (t1 <= t0))
+		return false;
+	g_clocksource.ns_per_tick = (double)(t1 - t0) / (double)(c1 - c0);
+	g_clocksource.base_ns = t1;
+	g_clocksource.base_ticks = c1;
+
+	/* between 100 MHz and 100 GHz */
+	return (g_clocksource.ns_per_tick > 0.01) && (g_clocksource.ns_per_tick < 10.0);
+#endif
+}
+
+/*
+ *  stress_clocksource_overhead()
+ *	average time of a time source read in nanoseconds
+ */
+static double stress_clocksource_overhead(uint64_t (*now)(void))
+{
+	uint64_t t0, t1;
+	int i;
+
+	t0 = stress_clocksource_monotonic_ns();
+	for (i = 0; i < CLOCKSOURCE_READS; i++)
+		(void)now();
+	t1 = stress_clocksource_monotonic_ns();
+	return (double)(t1 - t0) / (double)CLOCKSOURCE_READS;
+}
+
+static uint64_t stress_clocksource_ns_read(void)
+{
+	return stress_clocksource_ns();
+}
+
+static uint64_t stress_clocksource_monotonic_ns_read(void)
+{
+	return stress_clocksource_monotonic_ns();
+}
+
+/*
+ *  stress_clocksource_name()
+ *	name of the time source in use
+ */
+const char *stress_clocksource_name(void)
+{
+	if (!g_clocksource.fast)
+		return "clock_gettime";
+#if defined(STRESS_ARCH_X86)
+	return "tsc";
+#else
+	return "cntvct";
+#endif
+}
+
+/*
+ *  stress_clocksource_init()
+ *	calibrate the cycle counter, this has to be done before the
+ *	stressors are forked so that they all use the same calibration
+ */
+void stress_clocksource_init(void)
+{
+	(void)memset(&g_clocksource, 0, sizeof(g_clocksource));
+
+	if (!stress_clocksource_usable() || !stress_clocksource_calibrate()) {
+		pr_dbg("clocksource: no invariant cycle counter, timing with clock_gettime\n");
+		return;
+	}
+	g_clocksource.fast = true;
+	pr_dbg("clocksource: using %s at %.3f MHz, %.1f ns per read (clock_gettime %.1f ns)\n",
+		stress_clocksource_name(), 1000.0 / g_clocksource.ns_per_tick,
+		stress_clocksource_overhead(stress_clocksource_ns_read),
+		stress_clocksource_overhead(stress_clocksource_monotonic_ns_read));
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_CLOCKSOURCE_H
+#define CORE_CLOCKSOURCE_H
+
+#include "core-arch.h"
+#include "core-asm-arm.h"
+#include "core-asm-x86.h"
+
+/* calibrated cycle counter time source for timing short operations */
+typedef struct {
+	double ns_per_tick;	/* nanoseconds per counter tick */
+	uint64_t base_ticks;	/* counter at calibration */
+	uint64_t base_ns;	/* CLOCK_MONOTONIC nanoseconds at base_ticks */
+	bool fast;		/* counter is used rather than clock_gettime */
+} stress_clocksource_t;
+
+extern stress_clocksource_t g_clocksource;
+
+extern void stress_clocksource_init(void);
+extern WARN_UNUSED const char *stress_clocksource_name(void);
+
+/*
+ *  stress_clocksource_ticks()
+ *	read the cpu cycle counter, x86 TSC or the arm64 generic timer
+ */
+static inline uint64_t ALWAYS_INLINE stress_clocksource_ticks(void)
+{
+#if defined(STRESS_ARCH_X86)
+	return stress_asm_x86_rdtsc();
+#elif defined(STRESS_ARCH_ARM) &&	\
+      defined(__aarch64__)
+	return stress_asm_arm_cntvct();
+#else
+	return 0;
+#endif
+}
+
+/*
+ *  stress_clocksource_monotonic_ns()
+ *	CLOCK_MONOTONIC time in nanoseconds
+ */
+static inline uint64_t ALWAYS_INLINE stress_clocksource_monotonic_ns(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (LIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) == 0))
+		return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+#endif
+	return (uint64_t)(stress_time_now() * STRESS_DBL_NANOSECOND);
+}
+
+/*
+ *  stress_clocksource_ns()
+ *	monotonic time in nanoseconds from the calibrated cycle
+ *	counter if it is usable, otherwise from clock_gettime
+ */
+static inline uint64_t ALWAYS_INLINE stress_clocksource_ns(void)
+{
+	if (LIKELY(g_clocksource.fast)) {
+		const uint64_t ticks = stress_clocksource_ticks() - g_clocksource.base_ticks;
+
+		return g_clocksource.base_ns + (uint64_t)((double)ticks * g_clocksource.ns_per_tick);
+	}
+	return stress_clocksource_monotonic_ns();
+}
+
+#endif
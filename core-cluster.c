@@ -0,0 +1,1039 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cluster.h"
+
+#include <netinet/in.h>
+
+#if defined(HAVE_NETDB_H)
+#include <netdb.h>
+#endif
+
+#define CLUSTER_NODES_MAX	(256)		/* coordinated agents */
+#define CLUSTER_STRESSORS_MAX	(64)		/* stressors in the merged report */
+#define CLUSTER_JOB_MAX		(1 * MB)	/* job file size */
+#define CLUSTER_YAML_MAX	(64 * MB)	/* agent YAML results size */
+#define CLUSTER_SYNC_ROUNDS	(8)		/* clock offset samples per agent */
+#define CLUSTER_START_DELAY_NS	(2000000000ULL)	/* start time after the barrier */
+#define CLUSTER_OUTLIER_PERCENT	(10.0)		/* outlier distance from the median */
+#define CLUSTER_KEY_MAX		(256)		/* shared secret length */
+#define CLUSTER_HANDSHAKE_SECS	(10)		/* agent wait for a coordinator handshake */
+
+/* an agent as seen by the coordinator */
+typedef struct {
+	char name[256];			/* host:port */
+	char hostname[64];		/* hostname reported in the agent YAML */
+	int fd;				/* connection to the agent, -1 if failed */
+	int64_t offset;			/* agent clock - coordinator clock, ns */
+	uint64_t rtt;			/* best clock sync round trip, ns */
+	int64_t late;			/* agent start after the start time, ns */
+	char *yaml;			/* YAML results of the agent */
+} stress_cluster_node_t;
+
+#if defined(HAVE_NETDB_H)
+/* agent state from receiving the job until the results are sent */
+static int cluster_agent_fd = -1;
+static int64_t cluster_agent_late;
+static bool cluster_agent_yaml_tmp;
+static char cluster_agent_job[PATH_MAX];
+static char cluster_agent_yaml[PATH_MAX];
+
+/*
+ *  options a received job may not use, they name files the agent
+ *  would write, read back to the coordinator or run, the match is
+ *  on unambiguous prefixes as getopt_long accepts those too
+ */
+static const char * const cluster_agent_forbidden[] = {
+	"autotune-profile",
+	"cluster",
+	"cluster-agent",
+	"cluster-key",
+	"compare",
+	"dev-file",
+	"fstat-dir",
+	"job",
+	"log-file",
+	"metrics-stream",
+	"replay-file",
+	"reproduce",
+	"results-bin",
+	"score",
+	"temp-path",
+	"yaml",
+};
+
+/*
+ *  stress_cluster_now()
+ *	wall clock time in nanoseconds, the start barrier
+ *	is a wall clock time corrected by each agent's offset
+ */
+static uint64_t stress_cluster_now(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_REALTIME)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_REALTIME, &ts) == 0)
+		return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+#endif
+	return (uint64_t)(stress_time_now() * STRESS_DBL_NANOSECOND);
+}
+
+/*
+ *  stress_cluster_write()
+ *	write all of buf, returns 0 or -1 on failure, a
+ *	closed peer is an error rather than a SIGPIPE
+ */
+static int stress_cluster_write(const int fd, const void *buf, const size_t len)
+{
+	const char *ptr = (const char *)buf;
+	size_t n = 0;
+
+	while (n < len) {
+#if defined(MSG_NOSIGNAL)
+		const ssize_t ret = send(fd, ptr + n, len - n, MSG_NOSIGNAL);
+#else
+		const ssize_t ret = write(fd, ptr + n, len - n);
+#endif
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		n += (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cluster_read()
+ *	read exactly len bytes, returns 0 or -1 on failure or EOF
+ */
+static int stress_cluster_read(const int fd, void *buf, const size_t len)
+{
+	char *ptr = (char *)buf;
+	size_t n = 0;
+
+	while (n < len) {
+		const ssize_t ret = read(fd, ptr + n, len - n);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			return -1;
+		n += (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cluster_read_line()
+ *	read a newline terminated protocol message, the
+ *	messages are short so they are read a byte at a time
+ */
+static int stress_cluster_read_line(const int fd, char *buf, const size_t len)
+{
+	size_t n;
+
+	for (n = 0; n < len - 1; n++) {
+		if (stress_cluster_read(fd, &buf[n], 1) < 0)
+			return -1;
+		if (buf[n] == '\n')
+			break;
+	}
+	buf[n] = '\0';
+	return 0;
+}
+
+/*
+ *  stress_cluster_send_line()
+ *	send a protocol message
+ */
+static int stress_cluster_send_line(const int fd, const char *fmt, ...) FORMAT(printf, 2, 3);
+
+static int stress_cluster_send_line(const int fd, const char *fmt, ...)
+{
+	char buf[CLUSTER_KEY_MAX + 64];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if ((len < 0) || ((size_t)len >= sizeof(buf)))
+		return -1;
+	return stress_cluster_write(fd, buf, (size_t)len);
+}
+
+/*
+ *  stress_cluster_key()
+ *	read the shared secret from the first line of the
+ *	--cluster-key file, returns 0 or -1 on failure
+ */
+static int stress_cluster_key(const char *who, char *key, const size_t len)
+{
+	const char *filename = NULL;
+	char *ptr;
+	FILE *fp;
+
+	if (!stress_get_setting("cluster-key", &filename)) {
+		(void)fprintf(stderr, "%s: a --cluster-key file with the shared secret is required\n", who);
+		return -1;
+	}
+	fp = fopen(filename, "r");
+	if (!fp) {
+		(void)fprintf(stderr, "%s: cannot open key file %s, errno=%d (%s)\n",
+			who, filename, errno, strerror(errno));
+		return -1;
+	}
+	(void)memset(key, 0, len);
+	ptr = fgets(key, (int)len, fp);
+	(void)fclose(fp);
+	if (ptr)
+		key[strcspn(key, "\r\n")] = '\0';
+	if (!ptr || (*key == '\0') || strpbrk(key, " \t")) {
+		(void)fprintf(stderr, "%s: key file %s must start with a non-empty "
+			"key without blanks of at most %d characters\n",
+			who, filename, CLUSTER_KEY_MAX - 2);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cluster_key_equal()
+ *	compare keys in a time that does not depend on
+ *	where they differ
+ */
+static bool stress_cluster_key_equal(const char *key, const char *received)
+{
+	const size_t len = strlen(key);
+	unsigned char diff = (strlen(received) != len);
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		diff |= (unsigned char)key[i] ^ (unsigned char)received[i];
+	return diff == 0;
+}
+
+/*
+ *  stress_cluster_job_check()
+ *	find a forbidden option in a received job, returns
+ *	the option or NULL if the job may be run
+ */
+static const char *stress_cluster_job_check(const char *job, const size_t len)
+{
+	const char *line = job, *end = job + len;
+
+	while (line < end) {
+		const char *eol = memchr(line, '\n', (size_t)(end - line));
+		const char *ptr = line;
+		size_t i, n;
+
+		if (!eol)
+			eol = end;
+		while ((ptr < eol) && (isblank((unsigned char)*ptr) || (*ptr == '-')))
+			ptr++;
+		for (n = 0; (ptr + n < eol) && !isblank((unsigned char)ptr[n]) &&
+			    (ptr[n] != '=') && (ptr[n] != '#'); n++)
+			;
+		if ((n == 1) && (*ptr == 'j'))
+			return "job";
+		for (i = 0; (n > 1) && (i < SIZEOF_ARRAY(cluster_agent_forbidden)); i++) {
+			if (!strncmp(cluster_agent_forbidden[i], ptr, n))
+				return cluster_agent_forbidden[i];
+		}
+		line = eol + 1;
+	}
+	return NULL;
+}
+
+/*
+ *  stress_cluster_addr()
+ *	split [host:]port, host is NULL if there is no host
+ */
+static int stress_cluster_addr(
+	const char *opt,
+	char *host,
+	const size_t host_len,
+	char *port,
+	const size_t port_len)
+{
+	const char *colon = strrchr(opt, ':');
+	size_t len;
+
+	if (!colon) {
+		*host = '\0';
+		(void)shim_strlcpy(port, opt, port_len);
+	} else {
+		len = (size_t)(colon - opt);
+		if (len >= host_len)
+			return -1;
+		(void)memcpy(host, opt, len);
+		host[len] = '\0';
+		/* allow [addr]:port for IPv6 addresses */
+		if ((len > 1) && (host[0] == '[') && (host[len - 1] == ']')) {
+			(void)memmove(host, host + 1, len - 2);
+			host[len - 2] = '\0';
+		}
+		(void)shim_strlcpy(port, colon + 1, port_len);
+	}
+	if ((*port == '\0') || (strspn(port, "0123456789") != strlen(port)))
+		return -1;
+	return 0;
+}
+
+/*
+ *  stress_cluster_connect()
+ *	connect to an agent at host:port, returns fd or -1
+ */
+static int stress_cluster_connect(const char *node)
+{
+	struct addrinfo hints, *res = NULL, *ai;
+	char host[256], port[16];
+	int fd = -1, ret;
+
+	if ((stress_cluster_addr(node, host, sizeof(host), port, sizeof(port)) < 0) ||
+	    (*host == '\0')) {
+		pr_err("cluster: node '%s' is not in host:port form\n", node);
+		return -1;
+	}
+	(void)memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	ret = getaddrinfo(host, port, &hints, &res);
+	if ((ret != 0) || !res) {
+		pr_err("cluster: cannot resolve '%s', %s\n", host, gai_strerror(ret));
+		return -1;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		(void)close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		pr_err("cluster: cannot connect to agent %s, errno=%d (%s)\n",
+			node, errno, strerror(errno));
+	return fd;
+}
+
+/*
+ *  stress_cluster_sync()
+ *	estimate the agent clock offset from the sample with the
+ *	shortest round trip, the offset error is at most rtt / 2
+ */
+static int stress_cluster_sync(stress_cluster_node_t *node)
+{
+	int i;
+
+	node->rtt = UINT64_MAX;
+	for (i = 0; i < CLUSTER_SYNC_ROUNDS; i++) {
+		char buf[64];
+		uint64_t t0, t1, agent;
+
+		t0 = stress_cluster_now();
+		if (stress_cluster_send_line(node->fd, "TIME\n") < 0)
+			return -1;
+		if (stress_cluster_read_line(node->fd, buf, sizeof(buf)) < 0)
+			return -1;
+		t1 = stress_cluster_now();
+		if (sscanf(buf, "TIME %" SCNu64, &agent) != 1)
+			return -1;
+		if (t1 - t0 < node->rtt) {
+			node->rtt = t1 - t0;
+			node->offset = (int64_t)(agent - (t0 + (t1 - t0) / 2));
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_cluster_node_fail()
+ *	drop a node that failed in the protocol
+ */
+static void stress_cluster_node_fail(stress_cluster_node_t *node, const char *what)
+{
+	pr_err("cluster: agent %s failed %s\n", node->name, what);
+	if (node->fd >= 0)
+		(void)close(node->fd);
+	node->fd = -1;
+}
+
+/*
+ *  stress_cluster_parse_yaml()
+ *	pick out the hostname and the per stressor real time bogo op
+ *	rates of an agent, rates are -1.0 if a stressor did not run
+ */
+static void stress_cluster_parse_yaml(
+	stress_cluster_node_t *node,
+	const size_t n,
+	const size_t n_nodes,
+	char stressors[][64],
+	size_t *n_stressors,
+	double *rates)
+{
+	char *line, *next;
+	bool metrics = false;
+	ssize_t s = -1;
+
+	for (line = node->yaml; line && *line; line = next) {
+		char name[64];
+		double rate;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		if (sscanf(line, "      hostname: %63s", node->hostname) == 1)
+			goto restore;
+		if (*line && !isspace((unsigned char)*line))
+			metrics = !strncmp(line, "metrics:", 8);
+		if (!metrics)
+			goto restore;
+		if (sscanf(line, "    - stressor: %63s", name) == 1) {
+			size_t i;
+
+			for (i = 0; i < *n_stressors; i++) {
+				if (!strcmp(stressors[i], name))
+					break;
+			}
+			if (i == *n_stressors) {
+				if (i == CLUSTER_STRESSORS_MAX) {
+					s = -1;
+					goto restore;
+				}
+				(void)shim_strlcpy(stressors[i], name, sizeof(stressors[i]));
+				(*n_stressors)++;
+			}
+			s = (ssize_t)i;
+		} else if ((s >= 0) &&
+			   (sscanf(line, "      bogo-ops-per-second-real-time: %lf", &rate) == 1)) {
+			rates[((size_t)s * n_nodes) + n] = rate;
+		}
+restore:
+		/* keep the YAML intact for the merged report */
+		if (next)
+			next[-1] = '\n';
+	}
+}
+
+/*
+ *  stress_cluster_cmp()
+ *	sort rates into ascending order
+ */
+static int stress_cluster_cmp(const void *p1, const void *p2)
+{
+	const double r1 = *(const double *)p1;
+	const double r2 = *(const double *)p2;
+
+	if (r1 < r2)
+		return -1;
+	return (r1 > r2) ? 1 : 0;
+}
+
+/*
+ *  stress_cluster_report()
+ *	print and dump the per node rates of each stressor, the mean,
+ *	median, spread and the nodes more than CLUSTER_OUTLIER_PERCENT
+ *	from the median
+ */
+static void stress_cluster_report(
+	FILE *yaml,
+	stress_cluster_node_t *nodes,
+	const size_t n_nodes,
+	char stressors[][64],
+	const size_t n_stressors,
+	const double *rates)
+{
+	double sorted[CLUSTER_NODES_MAX];
+	size_t s, i;
+
+	pr_inf("cluster: %-16s %5s %12s %12s %12s %12s %7s %8s\n",
+		"stressor", "nodes", "mean", "median", "min", "max", "cv %", "outliers");
+	pr_yaml(yaml, "cluster-metrics:\n");
+
+	for (s = 0; s < n_stressors; s++) {
+		const double *r = &rates[s * n_nodes];
+		double sum = 0.0, sum2 = 0.0, mean, median, stddev;
+		size_t n = 0, outliers = 0;
+
+		for (i = 0; i < n_nodes; i++) {
+			if (r[i] < 0.0)
+				continue;
+			sorted[n++] = r[i];
+			sum += r[i];
+			sum2 += r[i] * r[i];
+		}
+		if (n == 0)
+			continue;
+		qsort(sorted, n, sizeof(sorted[0]), stress_cluster_cmp);
+		median = (n & 1) ? sorted[n / 2] : (sorted[(n / 2) - 1] + sorted[n / 2]) / 2.0;
+		mean = sum / (double)n;
+		stddev = sum2 / (double)n - mean * mean;
+		stddev = (stddev > 0.0) ? sqrt(stddev) : 0.0;
+		for (i = 0; i < n_nodes; i++) {
+			if ((r[i] >= 0.0) && (median > 0.0) &&
+			    (fabs(r[i] - median) * 100.0 / median > CLUSTER_OUTLIER_PERCENT))
+				outliers++;
+		}
+
+		pr_inf("cluster: %-16s %5zu %12.2f %12.2f %12.2f %12.2f %7.2f %8zu\n",
+			stressors[s], n, mean, median, sorted[0], sorted[n - 1],
+			(mean > 0.0) ? 100.0 * stddev / mean : 0.0, outliers);
+		pr_yaml(yaml, "    - stressor: %s\n", stressors[s]);
+		pr_yaml(yaml, "      nodes: %zu\n", n);
+		pr_yaml(yaml, "      mean: %f\n", mean);
+		pr_yaml(yaml, "      median: %f\n", median);
+		pr_yaml(yaml, "      min: %f\n", sorted[0]);
+		pr_yaml(yaml, "      max: %f\n", sorted[n - 1]);
+		pr_yaml(yaml, "      stddev: %f\n", stddev);
+		pr_yaml(yaml, "      per-node:\n");
+		for (i = 0; i < n_nodes; i++) {
+			const double delta = (median > 0.0) ? 100.0 * (r[i] - median) / median : 0.0;
+			const bool outlier = fabs(delta) > CLUSTER_OUTLIER_PERCENT;
+
+			if (r[i] < 0.0)
+				continue;
+			pr_yaml(yaml, "        - node: %s\n", nodes[i].name);
+			pr_yaml(yaml, "          bogo-ops-per-second-real-time: %f\n", r[i]);
+			pr_yaml(yaml, "          percent-from-median: %.2f\n", delta);
+			pr_yaml(yaml, "          outlier: %s\n", outlier ? "true" : "false");
+			if (outlier)
+				pr_inf("cluster: %s outlier %s (%s) %.2f bogo ops/s, %+.1f%% from the median\n",
+					stressors[s], nodes[i].name, nodes[i].hostname, r[i], delta);
+		}
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_cluster_coordinate()
+ *	send the job file to each agent in the comma separated nodes
+ *	list, wait for all agents to be ready, synchronise their start
+ *	to a common time, then collect and merge their YAML results
+ */
+int stress_cluster_coordinate(
+	const char *nodes_list,
+	const char *job_filename,
+	const char *yaml_filename)
+{
+	stress_cluster_node_t *nodes;
+	char (*stressors)[64] = NULL;
+	double *rates = NULL;
+	char *list, *token, *saveptr = NULL, *job = NULL;
+	size_t i, n_nodes = 0, n_stressors = 0, job_len;
+	uint64_t start, sync_err = 0;
+	struct stat statbuf;
+	int fd, rc = EXIT_FAILURE;
+	FILE *yaml = NULL;
+	char key[CLUSTER_KEY_MAX];
+
+	if (stress_cluster_key("cluster", key, sizeof(key)) < 0)
+		return EXIT_FAILURE;
+	if (!job_filename) {
+		(void)fprintf(stderr, "cluster: a --job file is required to run on the cluster\n");
+		return EXIT_FAILURE;
+	}
+	fd = open(job_filename, O_RDONLY);
+	if (fd < 0) {
+		(void)fprintf(stderr, "cluster: cannot open job file %s, errno=%d (%s)\n",
+			job_filename, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if ((fstat(fd, &statbuf) < 0) || (statbuf.st_size > (off_t)CLUSTER_JOB_MAX)) {
+		(void)fprintf(stderr, "cluster: job file %s is larger than %zu bytes\n",
+			job_filename, (size_t)CLUSTER_JOB_MAX);
+		(void)close(fd);
+		return EXIT_FAILURE;
+	}
+	job_len = (size_t)statbuf.st_size;
+	job = malloc(job_len + 1);
+	if (!job || (stress_cluster_read(fd, job, job_len) < 0)) {
+		(void)fprintf(stderr, "cluster: cannot read job file %s\n", job_filename);
+		(void)close(fd);
+		free(job);
+		return EXIT_FAILURE;
+	}
+	(void)close(fd);
+
+	nodes = calloc(CLUSTER_NODES_MAX, sizeof(*nodes));
+	list = strdup(nodes_list);
+	if (!nodes || !list) {
+		(void)fprintf(stderr, "cluster: out of memory allocating nodes\n");
+		goto free_nodes;
+	}
+	for (token = strtok_r(list, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+		if (n_nodes == CLUSTER_NODES_MAX) {
+			(void)fprintf(stderr, "cluster: more than %d nodes\n", CLUSTER_NODES_MAX);
+			goto free_nodes;
+		}
+		(void)shim_strlcpy(nodes[n_nodes].name, token, sizeof(nodes[n_nodes].name));
+		(void)shim_strlcpy(nodes[n_nodes].hostname, "unknown", sizeof(nodes[n_nodes].hostname));
+		nodes[n_nodes].fd = -1;
+		n_nodes++;
+	}
+	if (n_nodes == 0) {
+		(void)fprintf(stderr, "cluster: no nodes specified\n");
+		goto free_nodes;
+	}
+
+	/* all agents must accept the job before any of them start */
+	for (i = 0; i < n_nodes; i++) {
+		stress_cluster_node_t *node = &nodes[i];
+
+		node->fd = stress_cluster_connect(node->name);
+		if (node->fd < 0)
+			goto close_nodes;
+		if ((stress_cluster_send_line(node->fd, "KEY %s\n", key) < 0) ||
+		    (stress_cluster_send_line(node->fd, "JOB %zu\n", job_len) < 0) ||
+		    (stress_cluster_write(node->fd, job, job_len) < 0)) {
+			stress_cluster_node_fail(node, "to receive the job");
+			goto close_nodes;
+		}
+	}
+	pr_inf("cluster: sent job %s to %zu agents, waiting for the start barrier\n",
+		job_filename, n_nodes);
+
+	/* barrier, agents are READY when set up and about to run */
+	for (i = 0; i < n_nodes; i++) {
+		stress_cluster_node_t *node = &nodes[i];
+		char buf[64];
+
+		if (stress_cluster_read_line(node->fd, buf, sizeof(buf)) < 0) {
+			stress_cluster_node_fail(node, "to set up the job");
+			goto close_nodes;
+		}
+		if (!strncmp(buf, "REJECT ", 7)) {
+			pr_err("cluster: agent %s rejected the job, %s\n", node->name, buf + 7);
+			stress_cluster_node_fail(node, "to accept the job");
+			goto close_nodes;
+		}
+		if (strcmp(buf, "READY")) {
+			stress_cluster_node_fail(node, "to set up the job");
+			goto close_nodes;
+		}
+		if (stress_cluster_sync(node) < 0) {
+			stress_cluster_node_fail(node, "to synchronise clocks");
+			goto close_nodes;
+		}
+		if (node->rtt / 2 > sync_err)
+			sync_err = node->rtt / 2;
+	}
+
+	/* each agent gets the common start time in its own clock */
+	start = stress_cluster_now() + CLUSTER_START_DELAY_NS;
+	for (i = 0; i < n_nodes; i++) {
+		stress_cluster_node_t *node = &nodes[i];
+
+		if (stress_cluster_send_line(node->fd, "START %" PRIu64 "\n",
+				(uint64_t)((int64_t)start + node->offset)) < 0) {
+			stress_cluster_node_fail(node, "to receive the start time");
+			goto close_nodes;
+		}
+	}
+	pr_inf("cluster: %zu agents start in %.1f seconds, clock sync error at most %.1f us\n",
+		n_nodes, (double)CLUSTER_START_DELAY_NS / STRESS_DBL_NANOSECOND,
+		(double)sync_err / 1000.0);
+
+	/* collect results, a failed agent does not stop the others */
+	rc = EXIT_SUCCESS;
+	for (i = 0; i < n_nodes; i++) {
+		stress_cluster_node_t *node = &nodes[i];
+		char buf[64];
+		size_t len;
+
+		if ((stress_cluster_read_line(node->fd, buf, sizeof(buf)) < 0) ||
+		    (sscanf(buf, "YAML %zu %" SCNd64, &len, &node->late) != 2) ||
+		    (len > CLUSTER_YAML_MAX)) {
+			stress_cluster_node_fail(node, "to return results");
+			rc = EXIT_NOT_SUCCESS;
+			continue;
+		}
+		node->yaml = malloc(len + 1);
+		if (!node->yaml || (stress_cluster_read(node->fd, node->yaml, len) < 0)) {
+			free(node->yaml);
+			node->yaml = NULL;
+			stress_cluster_node_fail(node, "to return results");
+			rc = EXIT_NOT_SUCCESS;
+			continue;
+		}
+		node->yaml[len] = '\0';
+	}
+
+	stressors = calloc(CLUSTER_STRESSORS_MAX, sizeof(*stressors));
+	rates = calloc(CLUSTER_STRESSORS_MAX * n_nodes, sizeof(*rates));
+	if (!stressors || !rates) {
+		pr_err("cluster: out of memory merging results\n");
+		rc = EXIT_FAILURE;
+		goto close_nodes;
+	}
+	for (i = 0; i < CLUSTER_STRESSORS_MAX * n_nodes; i++)
+		rates[i] = -1.0;
+	for (i = 0; i < n_nodes; i++) {
+		if (nodes[i].yaml)
+			stress_cluster_parse_yaml(&nodes[i], i, n_nodes, stressors, &n_stressors, rates);
+	}
+
+	if (yaml_filename) {
+		yaml = fopen(yaml_filename, "w");
+		if (!yaml)
+			pr_err("cluster: cannot output YAML data to %s\n", yaml_filename);
+	}
+	pr_yaml(yaml, "---\n");
+	pr_yaml_runinfo(yaml);
+
+	pr_inf("cluster: %-24s %-16s %10s %12s %10s\n",
+		"node", "hostname", "status", "offset us", "late us");
+	pr_yaml(yaml, "cluster:\n");
+	pr_yaml(yaml, "    clock-sync-error-usec: %.3f\n", (double)sync_err / 1000.0);
+	pr_yaml(yaml, "    nodes:\n");
+	for (i = 0; i < n_nodes; i++) {
+		const stress_cluster_node_t *node = &nodes[i];
+		const char *status = node->yaml ? "ok" : "failed";
+
+		pr_inf("cluster: %-24s %-16s %10s %12.1f %10.1f\n", node->name,
+			node->hostname, status, (double)node->offset / 1000.0,
+			(double)node->late / 1000.0);
+		pr_yaml(yaml, "      - node: %s\n", node->name);
+		pr_yaml(yaml, "        hostname: %s\n", node->hostname);
+		pr_yaml(yaml, "        status: %s\n", status);
+		pr_yaml(yaml, "        clock-offset-usec: %.3f\n", (double)node->offset / 1000.0);
+		pr_yaml(yaml, "        round-trip-usec: %.3f\n", (double)node->rtt / 1000.0);
+		pr_yaml(yaml, "        start-late-usec: %.3f\n", (double)node->late / 1000.0);
+		if (node->yaml) {
+			const char *line, *next;
+
+			/* nest the agent YAML document under the node */
+			pr_yaml(yaml, "        results:\n");
+			for (line = node->yaml; *line; line = next) {
+				int len;
+
+				next = strchr(line, '\n');
+				next = next ? next + 1 : line + strlen(line);
+				len = (int)(next - line);
+				if (!strncmp(line, "---", 3) || !strncmp(line, "...", 3) ||
+				    (len <= 1))
+					continue;
+				pr_yaml(yaml, "          %.*s", len, line);
+			}
+		}
+	}
+	pr_yaml(yaml, "\n");
+
+	stress_cluster_report(yaml, nodes, n_nodes, stressors, n_stressors, rates);
+
+	if (yaml) {
+		pr_yaml(yaml, "...\n");
+		(void)fclose(yaml);
+	}
+
+close_nodes:
+	for (i = 0; i < n_nodes; i++) {
+		if (nodes[i].fd >= 0)
+			(void)close(nodes[i].fd);
+		free(nodes[i].yaml);
+	}
+free_nodes:
+	free(rates);
+	free(stressors);
+	free(list);
+	free(nodes);
+	free(job);
+
+	return rc;
+}
+
+/*
+ *  stress_cluster_agent_handshake()
+ *	check the key and receive the job of a connection, a job
+ *	with a forbidden option is rejected, returns the job or NULL
+ *	if the connection is not a valid coordinator
+ */
+static char *stress_cluster_agent_handshake(const int fd, const char *key, size_t *len)
+{
+	const struct timeval tv = { CLUSTER_HANDSHAKE_SECS, 0 };
+	const struct timeval tv_none = { 0, 0 };
+	char buf[CLUSTER_KEY_MAX + 16];
+	const char *forbidden;
+	char *job;
+
+	/* a silent connection must not hold up the coordinator */
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if ((stress_cluster_read_line(fd, buf, sizeof(buf)) < 0) ||
+	    strncmp(buf, "KEY ", 4) || !stress_cluster_key_equal(key, buf + 4)) {
+		(void)stress_cluster_send_line(fd, "REJECT invalid key\n");
+		pr_inf("cluster-agent: rejected a connection with an invalid key\n");
+		return NULL;
+	}
+	if ((stress_cluster_read_line(fd, buf, sizeof(buf)) < 0) ||
+	    (sscanf(buf, "JOB %zu", len) != 1) || (*len > CLUSTER_JOB_MAX)) {
+		pr_inf("cluster-agent: coordinator did not send a job\n");
+		return NULL;
+	}
+	job = malloc(*len);
+	if (!job)
+		return NULL;
+	if (stress_cluster_read(fd, job, *len) < 0) {
+		pr_inf("cluster-agent: coordinator did not send a job\n");
+		free(job);
+		return NULL;
+	}
+	forbidden = stress_cluster_job_check(job, *len);
+	if (forbidden) {
+		(void)stress_cluster_send_line(fd, "REJECT job uses the %s option\n", forbidden);
+		pr_inf("cluster-agent: rejected a job that uses the %s option\n", forbidden);
+		free(job);
+		return NULL;
+	}
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv_none, sizeof(tv_none));
+	return job;
+}
+
+/*
+ *  stress_cluster_agent_job()
+ *	wait on [addr:]port for a coordinator, receive the job file
+ *	and make it the job to run with YAML metrics output, the
+ *	agent listens on 127.0.0.1 unless addr is given
+ */
+int stress_cluster_agent_job(const char *opt)
+{
+	struct addrinfo hints, *res = NULL;
+	char host[256], port[16], key[CLUSTER_KEY_MAX];
+	const char *yaml_filename = NULL;
+	char *job = NULL;
+	size_t len = 0;
+	int fd, ret, one = 1;
+	FILE *fp;
+
+	if (stress_cluster_key("cluster-agent", key, sizeof(key)) < 0)
+		return -1;
+	if (stress_cluster_addr(opt, host, sizeof(host), port, sizeof(port)) < 0) {
+		(void)fprintf(stderr, "cluster-agent: '%s' is not in [addr:]port form\n", opt);
+		return -1;
+	}
+	(void)memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	ret = getaddrinfo(*host ? host : "127.0.0.1", port, &hints, &res);
+	if ((ret != 0) || !res) {
+		(void)fprintf(stderr, "cluster-agent: cannot resolve '%s', %s\n",
+			opt, gai_strerror(ret));
+		return -1;
+	}
+	fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (fd < 0) {
+		(void)fprintf(stderr, "cluster-agent: socket failed, errno=%d (%s)\n",
+			errno, strerror(errno));
+		freeaddrinfo(res);
+		return -1;
+	}
+	(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if ((bind(fd, res->ai_addr, res->ai_addrlen) < 0) || (listen(fd, 1) < 0)) {
+		(void)fprintf(stderr, "cluster-agent: cannot listen on %s, errno=%d (%s)\n",
+			opt, errno, strerror(errno));
+		freeaddrinfo(res);
+		(void)close(fd);
+		return -1;
+	}
+	freeaddrinfo(res);
+
+	pr_inf("cluster-agent: waiting for a coordinator on %s%s\n", opt,
+		*host ? "" : " (127.0.0.1 only)");
+
+	/* keep waiting until a coordinator sends the key and a valid job */
+	while (!job) {
+		cluster_agent_fd = accept(fd, NULL, NULL);
+		if (cluster_agent_fd < 0) {
+			if (errno == EINTR)
+				continue;
+			(void)fprintf(stderr, "cluster-agent: accept failed, errno=%d (%s)\n",
+				errno, strerror(errno));
+			(void)close(fd);
+			return -1;
+		}
+		job = stress_cluster_agent_handshake(cluster_agent_fd, key, &len);
+		if (!job) {
+			(void)close(cluster_agent_fd);
+			cluster_agent_fd = -1;
+		}
+	}
+	(void)close(fd);
+	(void)memset(key, 0, sizeof(key));
+
+	(void)snprintf(cluster_agent_job, sizeof(cluster_agent_job),
+		"%s/stress-ng-cluster-%" PRIdMAX ".job", stress_get_temp_path(),
+		(intmax_t)getpid());
+	fp = fopen(cluster_agent_job, "w");
+	if (!fp || (fwrite(job, 1, len, fp) != len)) {
+		(void)fprintf(stderr, "cluster-agent: cannot write job to %s\n", cluster_agent_job);
+		if (fp)
+			(void)fclose(fp);
+		free(job);
+		goto err;
+	}
+	(void)fclose(fp);
+	free(job);
+	stress_set_setting_global("job", TYPE_ID_STR, (void *)cluster_agent_job);
+
+	/* results go back to the coordinator as YAML metrics */
+	(void)stress_get_setting("yaml", &yaml_filename);
+	if (!yaml_filename) {
+		(void)snprintf(cluster_agent_yaml, sizeof(cluster_agent_yaml),
+			"%s/stress-ng-cluster-%" PRIdMAX ".yaml", stress_get_temp_path(),
+			(intmax_t)getpid());
+		stress_set_setting_global("yaml", TYPE_ID_STR, (void *)cluster_agent_yaml);
+		cluster_agent_yaml_tmp = true;
+	}
+	g_opt_flags |= OPT_FLAGS_METRICS;
+
+	return 0;
+err:
+	(void)close(cluster_agent_fd);
+	cluster_agent_fd = -1;
+	return -1;
+}
+
+/*
+ *  stress_cluster_agent_barrier()
+ *	tell the coordinator the agent is ready, answer clock sync
+ *	requests and wait until the start time
+ */
+void stress_cluster_agent_barrier(const char *yaml_filename)
+{
+	char buf[64];
+	uint64_t start = 0, now;
+
+	if (cluster_agent_fd < 0)
+		return;
+	if (yaml_filename)
+		(void)shim_strlcpy(cluster_agent_yaml, yaml_filename, sizeof(cluster_agent_yaml));
+	if (stress_cluster_send_line(cluster_agent_fd, "READY\n") < 0)
+		goto err;
+	for (;;) {
+		if (stress_cluster_read_line(cluster_agent_fd, buf, sizeof(buf)) < 0)
+			goto err;
+		if (!strcmp(buf, "TIME")) {
+			if (stress_cluster_send_line(cluster_agent_fd, "TIME %" PRIu64 "\n",
+					stress_cluster_now()) < 0)
+				goto err;
+			continue;
+		}
+		if (sscanf(buf, "START %" SCNu64, &start) == 1)
+			break;
+		goto err;
+	}
+
+	/* sleep until close to the start time then spin */
+	while ((now = stress_cluster_now()) < start) {
+		const uint64_t delta = start - now;
+
+		if (delta > 2000000ULL)
+			(void)shim_nanosleep_uint64(delta - 1000000ULL);
+	}
+	cluster_agent_late = (int64_t)(now - start);
+	pr_inf("cluster-agent: started %.1f us after the cluster start time\n",
+		(double)cluster_agent_late / 1000.0);
+	return;
+err:
+	pr_err("cluster-agent: lost the coordinator before the start barrier\n");
+	(void)close(cluster_agent_fd);
+	cluster_agent_fd = -1;
+}
+
+/*
+ *  stress_cluster_agent_finish()
+ *	send the YAML results to the coordinator and remove the
+ *	temporary job and results files
+ */
+void stress_cluster_agent_finish(void)
+{
+	struct stat statbuf;
+	char *yaml = NULL;
+	size_t len = 0;
+	int fd;
+
+	if (cluster_agent_fd < 0)
+		return;
+	fd = open(cluster_agent_yaml, O_RDONLY);
+	if ((fd >= 0) && (fstat(fd, &statbuf) == 0) &&
+	    (statbuf.st_size <= (off_t)CLUSTER_YAML_MAX)) {
+		len = (size_t)statbuf.st_size;
+		yaml = malloc(len);
+		if (yaml && (stress_cluster_read(fd, yaml, len) < 0)) {
+			free(yaml);
+			yaml = NULL;
+		}
+	}
+	if (fd >= 0)
+		(void)close(fd);
+	if (!yaml)
+		len = 0;
+
+	if ((stress_cluster_send_line(cluster_agent_fd, "YAML %zu %" PRId64 "\n",
+			len, cluster_agent_late) < 0) ||
+	    (stress_cluster_write(cluster_agent_fd, yaml, len) < 0))
+		pr_err("cluster-agent: cannot send results to the coordinator\n");
+	free(yaml);
+	(void)close(cluster_agent_fd);
+	cluster_agent_fd = -1;
+
+	(void)shim_unlink(cluster_agent_job);
+	if (cluster_agent_yaml_tmp)
+		(void)shim_unlink(cluster_agent_yaml);
+}
+#else
+int stress_cluster_coordinate(
+	const char *nodes_list,
+	const char *job_filename,
+	const char *yaml_filename)
+{
+	(void)nodes_list;
+	(void)job_filename;
+	(void)yaml_filename;
+
+	(void)fprintf(stderr, "cluster: not supported, netdb.h not available\n");
+	return EXIT_FAILURE;
+}
+
+int stress_cluster_agent_job(const char *opt)
+{
+	(void)opt;
+
+	(void)fprintf(stderr, "cluster-agent: not supported, netdb.h not available\n");
+	return -1;
+}
+
+void stress_cluster_agent_barrier(const char *yaml_filename)
+{
+	(void)yaml_filename;
+}
+
+void stress_cluster_agent_finish(void)
+{
+}
+#endif
@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-compare.h"
+#include "core-perf.h"
+
+#define COMPARE_THRESHOLD_DEFAULT	(5.0)	/* percent */
+#define COMPARE_THRESHOLD_MAX		(1000.0)
+#define COMPARE_NONE			(-1.0)	/* value not available */
+
+/* raw values read from the yaml or gathered from this run */
+#define RAW_BOGO_OPS		(0)
+#define RAW_BOGO_RATE		(1)
+#define RAW_USER_TIME		(2)
+#define RAW_SYSTEM_TIME		(3)
+#define RAW_CPU_CYCLES		(4)
+#define RAW_INSTRUCTIONS	(5)
+#define RAW_CACHE_MISSES	(6)
+#define RAW_MAX			(7)
+
+typedef struct stress_compare_entry {
+	struct stress_compare_entry *next;	/* next baseline stressor */
+	char stressor[64];			/* stressor name */
+	double raw[RAW_MAX];			/* raw values, COMPARE_NONE = not found */
+} stress_compare_entry_t;
+
+typedef struct {
+	const char *section;	/* yaml section */
+	const char *key;	/* yaml key in the section */
+	const int raw;		/* raw value index */
+} stress_compare_key_t;
+
+typedef struct {
+	const char *name;	/* derived metric name */
+	const char *yaml;	/* yaml label */
+	const bool higher_is_better;
+} stress_compare_metric_t;
+
+static const stress_compare_key_t compare_keys[] = {
+	{ "metrics",	"bogo-ops",			RAW_BOGO_OPS },
+	{ "metrics",	"bogo-ops-per-second-real-time", RAW_BOGO_RATE },
+	{ "metrics",	"user-time",			RAW_USER_TIME },
+	{ "metrics",	"system-time",			RAW_SYSTEM_TIME },
+	{ "perfstats",	"cpu_cycles_total",		RAW_CPU_CYCLES },
+	{ "perfstats",	"instructions_total",		RAW_INSTRUCTIONS },
+	{ "perfstats",	"cache_misses_total",		RAW_CACHE_MISSES },
+};
+
+#define METRIC_THROUGHPUT	(0)
+#define METRIC_CPU_PER_OP	(1)
+#define METRIC_IPC		(2)
+#define METRIC_MISSES_PER_OP	(3)
+#define METRIC_MAX		(4)
+
+static const stress_compare_metric_t compare_metrics[METRIC_MAX] = {
+	{ "bogo ops/s (real time)",	"bogo-ops-per-second-real-time",	true },
+	{ "CPU secs per bogo op",	"cpu-time-per-bogo-op",			false },
+	{ "instructions per cycle",	"instructions-per-cycle",		true },
+	{ "cache misses per bogo op",	"cache-misses-per-bogo-op",		false },
+};
+
+static double compare_threshold = COMPARE_THRESHOLD_DEFAULT;
+
+/*
+ *  stress_set_compare_threshold()
+ *	set the percentage change that is flagged as a regression
+ */
+int stress_set_compare_threshold(const char *opt)
+{
+	double threshold;
+
+	if ((sscanf(opt, "%lf", &threshold) != 1) ||
+	    (threshold < 0.0) || (threshold > COMPARE_THRESHOLD_MAX)) {
+		(void)fprintf(stderr, "compare-threshold must be a percentage "
+			"in the range 0 to %.0f\n", COMPARE_THRESHOLD_MAX);
+		return -1;
+	}
+	compare_threshold = threshold;
+	return 0;
+}
+
+/*
+ *  stress_compare_entry_get()
+ *	find or add baseline entry for a stressor
+ */
+static stress_compare_entry_t *stress_compare_entry_get(
+	stress_compare_entry_t **head,
+	const char *stressor)
+{
+	stress_compare_entry_t *entry;
+	size_t i;
+
+	for (entry = *head; entry; entry = entry->next) {
+		if (!strcmp(entry->stressor, stressor))
+			return entry;
+	}
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return NULL;
+	(void)shim_strlcpy(entry->stressor, stressor, sizeof(entry->stressor));
+	for (i = 0; i < RAW_MAX; i++)
+		entry->raw[i] = COMPARE_NONE;
+	entry->next = *head;
+	*head = entry;
+
+	return entry;
+}
+
+/*
+ *  stress_compare_entries_free()
+ *	free baseline entries
+ */
+static void stress_compare_entries_free(stress_compare_entry_t *head)
+{
+	while (head) {
+		stress_compare_entry_t *next = head->next;
+
+		free(head);
+		head = next;
+	}
+}
+
+/*
+ *  stress_compare_load()
+ *	load the metrics and perfstats sections of a stress-ng
+ *	yaml file, returns NULL if nothing could be loaded, errors
+ *	are prefixed with tag
+ */
+static stress_compare_entry_t *stress_compare_load(const char *tag, const char *filename)
+{
+	FILE *fp;
+	char buf[256];
+	char section[32];
+	stress_compare_entry_t *head = NULL, *entry = NULL;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		pr_err("%s: cannot open baseline %s, errno=%d (%s)\n",
+			tag, filename, errno, strerror(errno));
+		return NULL;
+	}
+
+	*section = '\0';
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *key, *value, *ptr;
+		size_t i;
+
+		buf[strcspn(buf, "\r\n")] = '\0';
+		if (!*buf)
+			continue;
+
+		/* top level key starts a new section */
+		if (!isspace((int)*buf)) {
+			ptr = strchr(buf, ':');
+			if (ptr)
+				*ptr = '\0';
+			(void)shim_strlcpy(section, buf, sizeof(section));
+			entry = NULL;
+			continue;
+		}
+
+		for (key = buf; isspace((int)*key); key++)
+			;
+		if (!strncmp(key, "- ", 2)) {
+			key += 2;
+			entry = NULL;
+		}
+		value = strchr(key, ':');
+		if (!value)
+			continue;
+		*value++ = '\0';
+		while (isspace((int)*value))
+			value++;
+
+		if (!strcmp(key, "stressor")) {
+			if (!strcmp(section, "metrics") || !strcmp(section, "perfstats"))
+				entry = stress_compare_entry_get(&head, value);
+			continue;
+		}
+		if (!entry)
+			continue;
+
+		for (i = 0; i < SIZEOF_ARRAY(compare_keys); i++) {
+			if (!strcmp(section, compare_keys[i].section) &&
+			    !strcmp(key, compare_keys[i].key)) {
+				entry->raw[compare_keys[i].raw] = strtod(value, NULL);
+				break;
+			}
+		}
+	}
+	(void)fclose(fp);
+
+	if (!head)
+		pr_err("%s: no stressor metrics found in baseline %s\n", tag, filename);
+	return head;
+}
+
+/*
+ *  stress_compare_baseline_load()
+ *	load a baseline yaml file for use outside of --compare
+ */
+stress_compare_baseline_t *stress_compare_baseline_load(const char *tag, const char *filename)
+{
+	return stress_compare_load(tag, filename);
+}
+
+/*
+ *  stress_compare_baseline_rate()
+ *	bogo ops per second (real time) of a stressor in a baseline,
+ *	returns a value <= 0.0 if it is not available
+ */
+double stress_compare_baseline_rate(const stress_compare_baseline_t *baseline, const char *stressor)
+{
+	const stress_compare_entry_t *entry;
+
+	for (entry = baseline; entry; entry = entry->next) {
+		if (!strcmp(entry->stressor, stressor))
+			return entry->raw[RAW_BOGO_RATE];
+	}
+	return COMPARE_NONE;
+}
+
+/*
+ *  stress_compare_baseline_free()
+ *	free a baseline loaded by stress_compare_baseline_load()
+ */
+void stress_compare_baseline_free(stress_compare_baseline_t *baseline)
+{
+	stress_compare_entries_free(baseline);
+}
+
+/*
+ *  stress_compare_current()
+ *	gather the raw values of this run for a stressor
+ */
+static void stress_compare_current(
+	const stress_stressor_t *ss,
+	double raw[RAW_MAX],
+	const int32_t ticks_per_sec)
+{
+	double u_total = 0.0, s_total = 0.0, r_time;
+	uint64_t c_total = 0;
+	int32_t j;
+	size_t i;
+
+	for (i = 0; i < RAW_MAX; i++)
+		raw[i] = COMPARE_NONE;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		c_total += stats->ci.counter;
+#if defined(HAVE_GETRUSAGE)
+		u_total += stats->rusage_utime;
+		s_total += stats->rusage_stime;
+#else
+		u_total += (double)(stats->tms.tms_utime + stats->tms.tms_cutime);
+		s_total += (double)(stats->tms.tms_stime + stats->tms.tms_cstime);
+#endif
+	}
+#if defined(HAVE_GETRUSAGE)
+	(void)ticks_per_sec;
+#else
+	u_total = (ticks_per_sec > 0) ? u_total / (double)ticks_per_sec : 0.0;
+	s_total = (ticks_per_sec > 0) ? s_total / (double)ticks_per_sec : 0.0;
+#endif
+	raw[RAW_BOGO_OPS] = (double)c_total;
+	raw[RAW_BOGO_RATE] = stress_bogo_rate_real_time(ss, &r_time);
+	raw[RAW_USER_TIME] = u_total;
+	raw[RAW_SYSTEM_TIME] = s_total;
+
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
+		uint64_t counter_totals[STRESS_PERF_MAX];
+		int p;
+
+		if (!stress_perf_stat_sum(ss, counter_totals))
+			return;
+
+		for (p = 0; p < STRESS_PERF_MAX; p++) {
+			char yaml_label[128];
+			char key[160];
+
+			if (!stress_perf_stat_label(p, yaml_label, sizeof(yaml_label)))
+				break;
+			if (counter_totals[p] == STRESS_PERF_INVALID)
+				continue;
+			(void)snprintf(key, sizeof(key), "%s_total", yaml_label);
+			for (i = 0; i < SIZEOF_ARRAY(compare_keys); i++) {
+				if (!strcmp(compare_keys[i].section, "perfstats") &&
+				    !strcmp(compare_keys[i].key, key))
+					raw[compare_keys[i].raw] = (double)counter_totals[p];
+			}
+		}
+	}
+#endif
+}
+
+/*
+ *  stress_compare_derive()
+ *	derive the compared metrics from raw values
+ */
+static void stress_compare_derive(const double raw[RAW_MAX], double metric[METRIC_MAX])
+{
+	const double ops = raw[RAW_BOGO_OPS];
+
+	metric[METRIC_THROUGHPUT] = raw[RAW_BOGO_RATE];
+
+	metric[METRIC_CPU_PER_OP] = ((ops > 0.0) &&
+				     (raw[RAW_USER_TIME] >= 0.0) &&
+				     (raw[RAW_SYSTEM_TIME] >= 0.0)) ?
+		(raw[RAW_USER_TIME] + raw[RAW_SYSTEM_TIME]) / ops : COMPARE_NONE;
+
+	metric[METRIC_IPC] = ((raw[RAW_CPU_CYCLES] > 0.0) &&
+			      (raw[RAW_INSTRUCTIONS] >= 0.0)) ?
+		raw[RAW_INSTRUCTIONS] / raw[RAW_CPU_CYCLES] : COMPARE_NONE;
+
+	metric[METRIC_MISSES_PER_OP] = ((ops > 0.0) &&
+					(raw[RAW_CACHE_MISSES] >= 0.0)) ?
+		raw[RAW_CACHE_MISSES] / ops : COMPARE_NONE;
+}
+
+/*
+ *  stress_compare_dump()
+ *	compare the metrics of this run against a baseline yaml
+ *	file given by --compare and report the per stressor changes,
+ *	changes for the worse beyond the --compare-threshold percentage
+ *	are flagged as regressions and make the run unsuccessful, as
+ *	does a baseline that cannot be loaded or has no stressor in
+ *	common with this run
+ */
+void stress_compare_dump(FILE *yaml, stress_stressor_t *stressors_list, bool *success)
+{
+	char *filename = NULL;
+	stress_compare_entry_t *head;
+	stress_stressor_t *ss;
+	uint32_t regressions = 0, compared = 0;
+	const int32_t ticks_per_sec = stress_get_ticks_per_second();
+
+	if (!stress_get_setting("compare", &filename) || !filename)
+		return;
+
+	head = stress_compare_load("compare", filename);
+	if (!head) {
+		*success = false;
+		return;
+	}
+
+	pr_inf("comparison against baseline %s (threshold %.2f%%):\n",
+		filename, compare_threshold);
+	pr_inf("%-13s %-24s %13s %13s %9s\n",
+		"stressor", "metric", "baseline", "current", "change");
+	pr_yaml(yaml, "comparison:\n");
+	pr_yaml(yaml, "    baseline: %s\n", filename);
+	pr_yaml(yaml, "    threshold-percent: %f\n", compare_threshold);
+	pr_yaml(yaml, "    stressors:\n");
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		double raw[RAW_MAX];
+		double base_metric[METRIC_MAX], curr_metric[METRIC_MAX];
+		stress_compare_entry_t *entry;
+		bool regressed = false;
+		size_t i, n_metrics = 0;
+
+		if (!ss->stats || !ss->started_instances)
+			continue;
+		for (entry = head; entry; entry = entry->next) {
+			if (!strcmp(entry->stressor, munged))
+				break;
+		}
+		if (!entry) {
+			pr_inf("%-13s not in baseline\n", munged);
+			continue;
+		}
+
+		stress_compare_current(ss, raw, ticks_per_sec);
+		stress_compare_derive(entry->raw, base_metric);
+		stress_compare_derive(raw, curr_metric);
+
+		pr_yaml(yaml, "      - stressor: %s\n", munged);
+		for (i = 0; i < METRIC_MAX; i++) {
+			const double base = base_metric[i];
+			const double curr = curr_metric[i];
+			double change;
+			const char *verdict = "";
+
+			if ((base <= 0.0) || (curr < 0.0))
+				continue;
+
+			n_metrics++;
+			change = 100.0 * (curr - base) / base;
+			if (!compare_metrics[i].higher_is_better)
+				change = -change;
+			if (change < -compare_threshold) {
+				verdict = " REGRESSION";
+				regressed = true;
+			} else if (change > compare_threshold) {
+				verdict = " improved";
+			}
+			/* report the raw change, not the better/worse sense */
+			if (!compare_metrics[i].higher_is_better)
+				change = -change;
+
+			pr_inf("%-13s %-24s %13.6g %13.6g %+8.2f%%%s\n",
+				munged, compare_metrics[i].name,
+				base, curr, change, verdict);
+			pr_yaml(yaml, "        %s-baseline: %e\n", compare_metrics[i].yaml, base);
+			pr_yaml(yaml, "        %s-current: %e\n", compare_metrics[i].yaml, curr);
+			pr_yaml(yaml, "        %s-change-percent: %f\n", compare_metrics[i].yaml, change);
+		}
+		pr_yaml(yaml, "        regression: %s\n", regressed ? "true" : "false");
+		if (!n_metrics) {
+			pr_inf("%-13s no comparable metrics in baseline\n", munged);
+			continue;
+		}
+		compared++;
+		if (regressed)
+			regressions++;
+	}
+	pr_yaml(yaml, "\n");
+
+	if (compared == 0) {
+		pr_err("compare: no stressors could be compared with baseline %s\n", filename);
+		*success = false;
+	} else if (regressions) {
+		pr_inf("compare: %" PRIu32 " of %" PRIu32 " stressors regressed by more than %.2f%%\n",
+			regressions, compared, compare_threshold);
+		*success = false;
+	} else {
+		pr_inf("compare: no regressions in %" PRIu32 " stressor%s\n",
+			compared, compared == 1 ? "" : "s");
+	}
+	stress_compare_entries_free(head);
+}
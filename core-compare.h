@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_COMPARE_H
+#define CORE_COMPARE_H
+
+typedef struct stress_compare_entry stress_compare_baseline_t;
+
+extern int stress_set_compare_threshold(const char *opt);
+extern stress_compare_baseline_t *stress_compare_baseline_load(const char *tag,
+	const char *filename);
+extern double stress_compare_baseline_rate(const stress_compare_baseline_t *baseline,
+	const char *stressor);
+extern void stress_compare_baseline_free(stress_compare_baseline_t *baseline);
+extern void stress_compare_dump(FILE *yaml, stress_stressor_t *stressors_list,
+	bool *success);
+
+#endif
@@ -41,6 +41,8 @@ typedef enum {
 #define SYS_CPU_PREFIX               "/sys/devices/system/cpu"
 #define SYS_CPU_CACHE_DIR            "cache"
 
+static stress_cpu_cache_cpus_t *cpu_caches_cached;
+
 /*
  * stress_cpu_cache_get_cpu()
  *
@@ -993,6 +995,89 @@ static int stress_cpu_cache_filter(const struct dirent *d)
 	return ((strncmp(d->d_name, "cpu", 3) == 0) && isdigit(d->d_name[3]));
 }
 
+/*
+ *  stress_cpu_cache_get_topology_id()
+ *	read a topology id from a cpu sysfs topology file, -1 if unknown
+ */
+static int32_t stress_cpu_cache_get_topology_id(const char *cpu_path, const char *name)
+{
+	char path[PATH_MAX];
+	char tmp[64];
+	int32_t id;
+
+	(void)snprintf(path, sizeof(path), "%s/topology/%s", cpu_path, name);
+	if (stress_get_string_from_file(path, tmp, sizeof(tmp)) < 0)
+		return -1;
+	if (sscanf(tmp, "%" SCNd32, &id) != 1)
+		return -1;
+	return id;
+}
+
+/*
+ *  stress_cpu_cache_get_llc_id()
+ *	find the highest level cache of a cpu and return the
+ *	lowest numbered cpu that shares it, -1 if unknown
+ */
+static int32_t stress_cpu_cache_get_llc_id(const char *cpu_path)
+{
+	int i;
+	int32_t llc_id = -1, max_level = -1;
+
+	for (i = 0; i < 16; i++) {
+		char path[PATH_MAX + 32];
+		char tmp[64];
+		int32_t level, id;
+
+		(void)snprintf(path, sizeof(path), "%s/cache/index%d/level", cpu_path, i);
+		if (stress_get_string_from_file(path, tmp, sizeof(tmp)) < 0)
+			break;
+		if (sscanf(tmp, "%" SCNd32, &level) != 1)
+			continue;
+		if (level <= max_level)
+			continue;
+		(void)snprintf(path, sizeof(path), "%s/cache/index%d/shared_cpu_list", cpu_path, i);
+		if (stress_get_string_from_file(path, tmp, sizeof(tmp)) < 0)
+			continue;
+		/* list is in ascending order, so the first cpu is the lowest */
+		if (sscanf(tmp, "%" SCNd32, &id) != 1)
+			continue;
+		max_level = level;
+		llc_id = id;
+	}
+	return llc_id;
+}
+
+/*
+ *  stress_cpu_cache_get_topology()
+ *	get package, core, LLC and NUMA node of a cpu
+ */
+static void stress_cpu_cache_get_topology(stress_cpu_cache_cpu_t *cpu, const char *cpu_path)
+{
+	DIR *dir;
+	struct dirent *d;
+
+	cpu->package_id = stress_cpu_cache_get_topology_id(cpu_path, "physical_package_id");
+	cpu->core_id = stress_cpu_cache_get_topology_id(cpu_path, "core_id");
+	cpu->llc_id = stress_cpu_cache_get_llc_id(cpu_path);
+	cpu->node = -1;
+
+	/* cpu has a nodeN link to the NUMA node it belongs to */
+	dir = opendir(cpu_path);
+	if (!dir)
+		return;
+	while ((d = readdir(dir)) != NULL) {
+		int32_t node;
+
+		if (strncmp(d->d_name, "node", 4))
+			continue;
+		if (sscanf(d->d_name + 4, "%" SCNd32, &node) == 1) {
+			cpu->node = node;
+			break;
+		}
+	}
+	(void)closedir(dir);
+}
+
 /*
  *  cpu_sort()
  *	sort by CPU number (digits 3 onwards)
@@ -1006,12 +1091,12 @@ static int cpu_sort(const struct dirent **d1, const struct dirent **d2)
 }
 
 /*
- * stress_cpu_cache_get_all_details()
+ * stress_cpu_cache_read_all_details()
  * Obtain information on all cpus caches on the system.
  *
  * Returns: dynamically-allocated stress_cpu_cache_cpus_t object, or NULL on error.
  */
-stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void)
+static stress_cpu_cache_cpus_t *stress_cpu_cache_read_all_details(void)
 {
 	int i, cpu_count;
 	stress_cpu_cache_cpus_t *cpus = NULL;
@@ -1058,6 +1143,7 @@ stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void)
 				cpu->online = atoi(tmp);
 			}
 		}
+		stress_cpu_cache_get_topology(cpu, fullpath);
 		if (cpu->online)
 			stress_cpu_cache_get_details(&cpus->cpus[i], fullpath);
 	}
@@ -1068,12 +1154,12 @@ out:
 }
 #elif defined(__APPLE__)
 /*
- * stress_cpu_cache_get_all_details()
+ * stress_cpu_cache_read_all_details()
  * Obtain information on all cpus caches on the system.
  *
  * Returns: dynamically-allocated stress_cpu_cache_cpus_t object, or NULL on error.
  */
-stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void)
+static stress_cpu_cache_cpus_t *stress_cpu_cache_read_all_details(void)
 {
 	int32_t i, cpu_count;
 	stress_cpu_cache_cpus_t *cpus = NULL;
@@ -1104,7 +1190,7 @@ out:
 	return cpus;
 }
 #elif defined(STRESS_ARCH_X86)
-stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void)
+static stress_cpu_cache_cpus_t *stress_cpu_cache_read_all_details(void)
 {
 	uint32_t eax, ebx, ecx, edx;
 	int32_t i, cpu_count;
@@ -1140,12 +1226,53 @@ stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void)
 	return cpus;
 }
 #else
-stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void)
+static stress_cpu_cache_cpus_t *stress_cpu_cache_read_all_details(void)
 {
 	return NULL;
 }
 #endif
 
+/*
+ * stress_cpu_cache_init()
+ * Read the cpu cache and topology details just once in the parent
+ * before any stressors are forked, the children inherit a copy of
+ * these details and hence don't need to re-scan sysfs. The cached
+ * details must be treated as read-only.
+ */
+void stress_cpu_cache_init(void)
+{
+	if (!cpu_caches_cached)
+		cpu_caches_cached = stress_cpu_cache_read_all_details();
+}
+
+/*
+ * stress_cpu_cache_deinit()
+ * Free the cached cpu cache details
+ */
+void stress_cpu_cache_deinit(void)
+{
+	stress_cpu_cache_cpus_t *cpus = cpu_caches_cached;
+
+	cpu_caches_cached = NULL;
+	stress_free_cpu_caches(cpus);
+}
+
+/*
+ * stress_cpu_cache_get_all_details()
+ * Obtain information on all cpus caches on the system, this
+ * returns the cached details if stress_cpu_cache_init() has
+ * been called, otherwise they are read from the system.
+ *
+ * Returns: stress_cpu_cache_cpus_t object, or NULL on error, free with
+ *	    stress_free_cpu_caches().
+ */
+stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void)
+{
+	if (cpu_caches_cached)
+		return cpu_caches_cached;
+	return stress_cpu_cache_read_all_details();
+}
+
 /*
  * stress_free_cpu_caches()
  * @cpus: value returned by get_all_cpu_cache_details().
@@ -1157,7 +1284,8 @@ void stress_free_cpu_caches(stress_cpu_cache_cpus_t *cpus)
 {
 	uint32_t  i;
 
-	if (!cpus)
+	/* Cached details are freed by stress_cpu_cache_deinit() */
+	if (!cpus || (cpus == cpu_caches_cached))
 		return;
 
 	for (i = 0; i < cpus->count; i++) {
@@ -48,8 +48,12 @@ typedef struct stress_cpu {
 	stress_cpu_cache_t *caches;	/* CPU cache data */
 	uint32_t	num;		/* CPU # number */
 	uint32_t	cache_count;	/* CPU cache #  */
+	int32_t		package_id;	/* physical package id (Linux only) */
+	int32_t		core_id;	/* core id, SMT siblings share this (Linux only) */
+	int32_t		node;		/* NUMA node (Linux only) */
+	int32_t		llc_id;		/* lowest cpu sharing the LLC, -1 if unknown (Linux only) */
 	bool		online;		/* CPU online when true */
-	uint8_t		padding[7];	/* padding */
+	uint8_t		padding[3];	/* padding */
 } stress_cpu_cache_cpu_t;
 
 typedef struct stress_cpus {
@@ -59,6 +63,8 @@ typedef struct stress_cpus {
 } stress_cpu_cache_cpus_t;
 
 /* CPU cache helpers */
+extern void stress_cpu_cache_init(void);
+extern void stress_cpu_cache_deinit(void);
 extern stress_cpu_cache_cpus_t *stress_cpu_cache_get_all_details(void);
 extern uint16_t stress_cpu_cache_get_max_level(const stress_cpu_cache_cpus_t *cpus);
 extern stress_cpu_cache_t *stress_cpu_cache_get(const stress_cpu_cache_cpus_t *cpus,
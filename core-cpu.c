@@ -164,7 +164,11 @@
 #define CPUID_ia32_core_cap_EDX	(1U << 30)	/* EAX=0x7, ECX=0x0, -> EDX */
 #define CPUID_ssbd_EDX		(1U << 31)	/* EAX=0x7, ECX=0x0, -> EDX */
 
+#define CPUID_prefetchw_ECX	(1U << 8)	/* EAX=0x80000001  -> ECX */
 #define CPUID_syscall_EDX	(1U << 11)	/* EAX=0x80000001  -> EDX */
+#define CPUID_rdtscp_EDX	(1U << 27)	/* EAX=0x80000001  -> EDX */
+
+#define CPUID_invariant_tsc_EDX	(1U << 8)	/* EAX=0x80000007  -> EDX */
 
 /*
  *  stress_cpu_is_x86()
@@ -322,6 +326,26 @@ bool stress_cpu_x86_has_syscall(void)
 #endif
 }
 
+/*
+ *  stress_cpu_x86_has_prefetchw()
+ *	does x86 cpu support prefetchw?
+ */
+bool stress_cpu_x86_has_prefetchw(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t eax = 0x80000001, ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_asm_x86_cpuid(eax, ebx, ecx, edx);
+
+	return !!(ecx & CPUID_prefetchw_ECX);
+#else
+	return false;
+#endif
+}
+
 /*
  *  stress_cpu_x86_has_rdrand()
  *	does x86 cpu support rdrand?
@@ -481,3 +505,192 @@ bool stress_cpu_x86_has_serialize(void)
 	return false;
 #endif
 }
+
+/*
+ *  stress_cpu_x86_has_erms()
+ *	does x86 cpu support enhanced rep movsb/stosb?
+ */
+bool stress_cpu_x86_has_erms(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t eax = 0x7, ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_asm_x86_cpuid(eax, ebx, ecx, edx);
+
+	return !!(ebx & CPUID_erms_EBX);
+#else
+	return false;
+#endif
+}
+
+/*
+ *  stress_cpu_x86_has_fsrm()
+ *	does x86 cpu support fast short rep movsb?
+ */
+bool stress_cpu_x86_has_fsrm(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t eax = 0x7, ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_asm_x86_cpuid(eax, ebx, ecx, edx);
+
+	return !!(edx & CPUID_fsrm_EDX);
+#else
+	return false;
+#endif
+}
+
+/*
+ *  stress_cpu_x86_has_amx()
+ *	does x86 cpu support AMX tiles and int8 tile multiply?
+ */
+bool stress_cpu_x86_has_amx(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t eax = 0x7, ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_asm_x86_cpuid(eax, ebx, ecx, edx);
+
+	return ((edx & (CPUID_amx_tile_EDX | CPUID_amx_int8_EDX)) ==
+		(CPUID_amx_tile_EDX | CPUID_amx_int8_EDX));
+#else
+	return false;
+#endif
+}
+
+/*
+ *  stress_cpu_x86_has_rdtscp()
+ *	does x86 cpu support rdtscp?
+ */
+bool stress_cpu_x86_has_rdtscp(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t eax = 0x80000001, ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_asm_x86_cpuid(eax, ebx, ecx, edx);
+
+	return !!(edx & CPUID_rdtscp_EDX);
+#else
+	return false;
+#endif
+}
+
+/*
+ *  stress_cpu_x86_has_invariant_tsc()
+ *	does x86 cpu have a constant rate TSC that keeps
+ *	running in deep C-states?
+ */
+bool stress_cpu_x86_has_invariant_tsc(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t eax = 0x80000000, ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_asm_x86_cpuid(eax, ebx, ecx, edx);
+	if (eax < 0x80000007)
+		return false;
+
+	eax = 0x80000007;
+	ebx = 0;
+	ecx = 0;
+	edx = 0;
+	stress_asm_x86_cpuid(eax, ebx, ecx, edx);
+
+	return !!(edx & CPUID_invariant_tsc_EDX);
+#else
+	return false;
+#endif
+}
+
+#if defined(HAVE_SCHED_SETAFFINITY)
+/*
+ *  stress_cpu_cpulist_read()
+ *	read a sysfs cpulist, e.g. 0-3,8,10-11 into a cpu set,
+ *	returns the number of cpus in the list
+ */
+static int stress_cpu_cpulist_read(const char *path, cpu_set_t *set)
+{
+	char buf[4096];
+	char *ptr, *token;
+	int n = 0;
+
+	CPU_ZERO(set);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return 0;
+
+	for (ptr = buf; (token = strtok(ptr, ",\n")) != NULL; ptr = NULL) {
+		int lo, hi, i;
+
+		if (sscanf(token, "%d-%d", &lo, &hi) != 2) {
+			if (sscanf(token, "%d", &lo) != 1)
+				continue;
+			hi = lo;
+		}
+		for (i = STRESS_MAXIMUM(lo, 0); (i <= hi) && (i < CPU_SETSIZE); i++) {
+			CPU_SET(i, set);
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ *  stress_cpu_core_types()
+ *	find the performance (P) and efficiency (E) cores of a hybrid
+ *	CPU, from the Intel cpu_core and cpu_atom PMU cpu lists or
+ *	failing that from the sysfs cpu capacities of asymmetric systems
+ *	such as Arm big.LITTLE, the highest capacity cpus are the P cores.
+ *	Returns true if there are both P and E cores.
+ */
+bool stress_cpu_core_types(cpu_set_t *p_cores, cpu_set_t *e_cores)
+{
+	const int32_t cpus = stress_get_processors_configured();
+	uint64_t max_capacity = 0;
+	int32_t cpu;
+	int p_num, e_num;
+
+	p_num = stress_cpu_cpulist_read("/sys/devices/cpu_core/cpus", p_cores);
+	e_num = stress_cpu_cpulist_read("/sys/devices/cpu_atom/cpus", e_cores);
+	if ((p_num > 0) && (e_num > 0))
+		return true;
+
+	CPU_ZERO(p_cores);
+	CPU_ZERO(e_cores);
+	for (cpu = 0; (cpu < cpus) && (cpu < CPU_SETSIZE); cpu++) {
+		char path[PATH_MAX], buf[32];
+		uint64_t capacity;
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/cpu/cpu%" PRId32 "/cpu_capacity", cpu);
+		if (system_read(path, buf, sizeof(buf)) <= 0)
+			continue;
+		if (sscanf(buf, "%" SCNu64, &capacity) != 1)
+			continue;
+		if (capacity > max_capacity) {
+			/* all the cpus seen so far are now E cores */
+			CPU_OR(e_cores, e_cores, p_cores);
+			CPU_ZERO(p_cores);
+			max_capacity = capacity;
+		}
+		if (capacity == max_capacity)
+			CPU_SET(cpu, p_cores);
+		else
+			CPU_SET(cpu, e_cores);
+	}
+	return (CPU_COUNT(p_cores) > 0) && (CPU_COUNT(e_cores) > 0);
+}
+#endif
@@ -29,13 +29,22 @@ extern WARN_UNUSED bool stress_cpu_x86_has_cldemote(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_waitpkg(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_rdseed(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_syscall(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_prefetchw(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_rdrand(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_tsc(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_rdtscp(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_invariant_tsc(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_msr(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_clfsh(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_mmx(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_sse(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_sse2(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_serialize(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_amx(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_erms(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_fsrm(void);
+#if defined(HAVE_SCHED_SETAFFINITY)
+extern WARN_UNUSED bool stress_cpu_core_types(cpu_set_t *p_cores, cpu_set_t *e_cores);
+#endif
 
 #endif
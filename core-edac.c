@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-edac.h"
+
+#if defined(__linux__)
+
+#define EDAC_MC_PATH	"/sys/devices/system/edac/mc"
+
+/*
+ *  stress_edac_read_uint64()
+ *	read a decimal counter from a sysfs file, returns
+ *	false if it cannot be read
+ */
+static bool stress_edac_read_uint64(const char *path, uint64_t *val)
+{
+	char buf[32];
+
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+	if (sscanf(buf, "%" SCNu64, val) != 1)
+		return false;
+	return true;
+}
+
+/*
+ *  stress_edac_read_entry()
+ *	read the error counts of a dimmN, rankN or csrowN entry of
+ *	a memory controller, returns false if it has no counters
+ */
+static bool stress_edac_read_entry(
+	const char *mc_name,
+	const char *entry_name,
+	const bool csrow,
+	stress_edac_dimm_t *dimm)
+{
+	char path[PATH_MAX];
+	char label[64];
+	char *ptr;
+
+	(void)snprintf(path, sizeof(path), "%s/%s/%s/%s", EDAC_MC_PATH,
+		mc_name, entry_name, csrow ? "ce_count" : "dimm_ce_count");
+	if (!stress_edac_read_uint64(path, &dimm->ce_count))
+		return false;
+	(void)snprintf(path, sizeof(path), "%s/%s/%s/%s", EDAC_MC_PATH,
+		mc_name, entry_name, csrow ? "ue_count" : "dimm_ue_count");
+	if (!stress_edac_read_uint64(path, &dimm->ue_count))
+		return false;
+
+	(void)snprintf(dimm->name, sizeof(dimm->name), "%.15s/%.40s", mc_name, entry_name);
+	if (csrow)
+		return true;
+
+	/* prefer the DIMM slot label if the firmware provides one */
+	(void)snprintf(path, sizeof(path), "%s/%s/%s/dimm_label", EDAC_MC_PATH,
+		mc_name, entry_name);
+	if (system_read(path, label, sizeof(label)) <= 0)
+		return true;
+	ptr = strchr(label, '\n');
+	if (ptr)
+		*ptr = '\0';
+	if (*label)
+		(void)snprintf(dimm->name, sizeof(dimm->name), "%.15s/%.40s", mc_name, label);
+	return true;
+}
+
+/*
+ *  stress_edac_read_mc()
+ *	read the per DIMM error counts of memory controller mc_name,
+ *	falling back to the per csrow counts on older kernels
+ */
+static size_t stress_edac_read_mc(
+	const char *mc_name,
+	stress_edac_dimm_t *dimms,
+	const size_t max_dimms)
+{
+	struct dirent **dlist = NULL;
+	char path[PATH_MAX];
+	size_t n_dimms = 0;
+	int i, n;
+	bool csrow;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", EDAC_MC_PATH, mc_name);
+	n = scandir(path, &dlist, NULL, alphasort);
+	if (n <= 0)
+		return 0;
+
+	for (csrow = false; ; csrow = true) {
+		for (i = 0; (i < n) && (n_dimms < max_dimms); i++) {
+			const char *name = dlist[i]->d_name;
+
+			if (csrow) {
+				if (strncmp(name, "csrow", 5))
+					continue;
+			} else {
+				if (strncmp(name, "dimm", 4) && strncmp(name, "rank", 4))
+					continue;
+			}
+			if (stress_edac_read_entry(mc_name, name, csrow, &dimms[n_dimms]))
+				n_dimms++;
+		}
+		if (n_dimms || csrow)
+			break;
+	}
+	stress_dirent_list_free(dlist, n);
+
+	return n_dimms;
+}
+
+/*
+ *  stress_edac_read()
+ *	read the correctable and uncorrectable error counts of
+ *	up to max_dimms DIMMs of all the EDAC memory controllers,
+ *	returns the number of DIMMs read, 0 if there is no EDAC
+ */
+size_t stress_edac_read(stress_edac_dimm_t *dimms, const size_t max_dimms)
+{
+	struct dirent **dlist = NULL;
+	size_t n_dimms = 0;
+	int i, n;
+
+	n = scandir(EDAC_MC_PATH, &dlist, NULL, alphasort);
+	if (n <= 0)
+		return 0;
+
+	for (i = 0; (i < n) && (n_dimms < max_dimms); i++) {
+		if (strncmp(dlist[i]->d_name, "mc", 2))
+			continue;
+		n_dimms += stress_edac_read_mc(dlist[i]->d_name,
+			dimms + n_dimms, max_dimms - n_dimms);
+	}
+	stress_dirent_list_free(dlist, n);
+
+	return n_dimms;
+}
+
+#else
+
+size_t stress_edac_read(stress_edac_dimm_t *dimms, const size_t max_dimms)
+{
+	(void)dimms;
+	(void)max_dimms;
+
+	return 0;
+}
+
+#endif
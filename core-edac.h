@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_EDAC_H
+#define CORE_EDAC_H
+
+#define STRESS_EDAC_DIMMS_MAX	(64)	/* DIMMs or csrows tracked */
+
+/* EDAC memory error counts of a DIMM (or csrow on older kernels) */
+typedef struct {
+	char name[64];		/* label, or mcN/dimmM if unlabelled */
+	uint64_t ce_count;	/* correctable errors */
+	uint64_t ue_count;	/* uncorrectable errors */
+} stress_edac_dimm_t;
+
+extern size_t stress_edac_read(stress_edac_dimm_t *dimms, const size_t max_dimms);
+
+#endif
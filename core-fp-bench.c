@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-fp-bench.h"
+#include "core-perf.h"
+
+#include <math.h>
+
+#define FP_BENCH_LOOPS		(1024)	/* kernel loops per call */
+#define FP_BENCH_SLICE		(0.05)	/* seconds per benchmark turn */
+
+typedef struct {
+	uint64_t ops;			/* operations done */
+	uint64_t cycles;		/* CPU cycles taken */
+	double secs;			/* time taken */
+} stress_fp_bench_stat_t;
+
+typedef struct {
+	stress_fp_bench_stat_t latency;
+	stress_fp_bench_stat_t throughput;
+} stress_fp_bench_result_t;
+
+static const char * const fp_bench_ops[FP_BENCH_OP_MAX] = {
+	"add",
+	"mul",
+	"div",
+	"sqrt",
+	"fma",
+};
+
+/*
+ *  stress_fp_bench_inputs()
+ *	kernel inputs for an operation that keep the chains bounded,
+ *	denormal inputs stay subnormal for the whole chain
+ */
+static void stress_fp_bench_inputs(
+	const stress_fp_bench_t *bench,
+	const bool denormal,
+	long double *r,
+	long double *a,
+	long double *b)
+{
+	const long double s = bench->min / 64.0L;
+
+	switch (bench->op) {
+	case FP_BENCH_OP_ADD:
+		*r = denormal ? 4.0L * s : 1.0L;
+		*a = denormal ? s : 1.0L / 1024.0L;
+		*b = 0.0L;
+		break;
+	case FP_BENCH_OP_MUL:
+	case FP_BENCH_OP_DIV:
+		*r = denormal ? 4.0L * s : 1.0L;
+		*a = 1.5L;
+		*b = 1.0L / 1.5L;
+		break;
+	case FP_BENCH_OP_SQRT:
+		*r = 2.0L;
+		*a = 0.0L;
+		*b = 0.0L;
+		break;
+	case FP_BENCH_OP_FMA:
+	default:
+		*r = denormal ? 2.0L * s : 1.0L;
+		*a = 0.5L;
+		*b = denormal ? s : 0.5L;
+		break;
+	}
+}
+
+/*
+ *  stress_fp_bench_time()
+ *	run a kernel for at least secs seconds and account the
+ *	operations, cycles and time taken
+ */
+static void stress_fp_bench_time(
+	const stress_args_t *args,
+	const int perf_fd,
+	const stress_fp_bench_func_t func,
+	const long double r,
+	const long double a,
+	const long double b,
+	const double secs,
+	stress_fp_bench_stat_t *stat)
+{
+	const double t_start = stress_time_now();
+	uint64_t c0 = 0, c1 = 0, ops = 0;
+	double t;
+	bool has_cycles;
+
+	has_cycles = stress_perf_cycles_read(perf_fd, &c0);
+	do {
+		ops += func(r, a, b, FP_BENCH_LOOPS);
+		t = stress_time_now() - t_start;
+	} while ((t < secs) && keep_stressing(args));
+	if (has_cycles && stress_perf_cycles_read(perf_fd, &c1) && (c1 > c0))
+		stat->cycles += c1 - c0;
+	stat->ops += ops;
+	stat->secs += t;
+	add_counter(args, ops);
+}
+
+/*
+ *  stress_fp_bench_run()
+ *	benchmark the latency and throughput of n floating point kernels
+ *	with normal and, apart from sqrt, denormal inputs, report the
+ *	cycles per operation of a dependent chain and the operations per
+ *	cycle of independent chains
+ */
+int stress_fp_bench_run(
+	const stress_args_t *args,
+	const stress_fp_bench_t *benches,
+	const size_t n)
+{
+	stress_fp_bench_result_t *results;
+	size_t i, idx = 0;
+	int perf_fd;
+	uint64_t c;
+	bool has_cycles, ran;
+
+	/* normal inputs at [i * 2], denormal inputs at [i * 2 + 1] */
+	results = (stress_fp_bench_result_t *)calloc(n * 2, sizeof(*results));
+	if (!results) {
+		pr_inf_skip("%s: cannot allocate %zu benchmark results, "
+			"skipping stressor\n", args->name, n * 2);
+		return EXIT_NO_RESOURCE;
+	}
+
+	perf_fd = stress_perf_cycles_open();
+	has_cycles = stress_perf_cycles_read(perf_fd, &c);
+	if ((args->instance == 0) && has_cycles && (perf_fd < 0))
+		pr_dbg("%s: CPU cycles counter not available, using the TSC\n", args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		for (i = 0; (i < n * 2) && keep_stressing(args); i++) {
+			const stress_fp_bench_t *bench = &benches[i / 2];
+			const bool denormal = (i & 1);
+			long double r, a, b;
+
+			if (denormal && (bench->op == FP_BENCH_OP_SQRT))
+				continue;
+			stress_fp_bench_inputs(bench, denormal, &r, &a, &b);
+			stress_fp_bench_time(args, perf_fd, bench->latency, r, a, b,
+				FP_BENCH_SLICE, &results[i].latency);
+			stress_fp_bench_time(args, perf_fd, bench->throughput, r, a, b,
+				FP_BENCH_SLICE, &results[i].throughput);
+			ran = true;
+		}
+	} while (ran && keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (perf_fd >= 0)
+		(void)close(perf_fd);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: latency of %d dependent operations, throughput of %d "
+			"independent chains%s\n", args->name, 8, FP_BENCH_CHAINS,
+			has_cycles ? ((perf_fd < 0) ? ", cycles from the TSC" : "") :
+			", no cycle counter available");
+		pr_inf("%s: %-13s %-4s %-8s %12s %10s %12s %10s\n", args->name,
+			"type", "op", "input", "lat cyc/op", "lat ns/op",
+			"tput op/cyc", "tput op/ns");
+	}
+	for (i = 0; i < n * 2; i++) {
+		const stress_fp_bench_t *bench = &benches[i / 2];
+		const stress_fp_bench_result_t *result = &results[i];
+		const bool denormal = (i & 1);
+		const char *op = fp_bench_ops[bench->op];
+		char lat_cyc[16], tput_cyc[16], str[64];
+		double lat_ns, tput_ns;
+
+		if ((result->latency.ops == 0) || (result->throughput.ops == 0))
+			continue;
+
+		lat_ns = (result->latency.secs * STRESS_DBL_NANOSECOND) /
+			(double)result->latency.ops;
+		tput_ns = result->throughput.secs > 0.0 ?
+			(double)result->throughput.ops /
+			(result->throughput.secs * STRESS_DBL_NANOSECOND) : 0.0;
+		if (result->latency.cycles && result->throughput.cycles) {
+			const double lat = (double)result->latency.cycles /
+				(double)result->latency.ops;
+			const double tput = (double)result->throughput.ops /
+				(double)result->throughput.cycles;
+
+			(void)snprintf(lat_cyc, sizeof(lat_cyc), "%.3f", lat);
+			(void)snprintf(tput_cyc, sizeof(tput_cyc), "%.3f", tput);
+			if (!denormal) {
+				(void)snprintf(str, sizeof(str), "%s %s latency cycles per op",
+					bench->type, op);
+				stress_metrics_set(args, idx++, str, lat);
+				(void)snprintf(str, sizeof(str), "%s %s throughput ops per cycle",
+					bench->type, op);
+				stress_metrics_set(args, idx++, str, tput);
+			}
+		} else {
+			(void)shim_strlcpy(lat_cyc, "-", sizeof(lat_cyc));
+			(void)shim_strlcpy(tput_cyc, "-", sizeof(tput_cyc));
+			if (!denormal) {
+				(void)snprintf(str, sizeof(str), "%s %s latency ns per op",
+					bench->type, op);
+				stress_metrics_set(args, idx++, str, lat_ns);
+				(void)snprintf(str, sizeof(str), "%s %s throughput ops per ns",
+					bench->type, op);
+				stress_metrics_set(args, idx++, str, tput_ns);
+			}
+		}
+		if (denormal) {
+			const stress_fp_bench_stat_t *normal = &results[i - 1].latency;
+
+			if ((normal->ops > 0) && (normal->secs > 0.0)) {
+				const double slowdown = lat_ns /
+					((normal->secs * STRESS_DBL_NANOSECOND) / (double)normal->ops);
+
+				(void)snprintf(str, sizeof(str), "%s %s denormal latency slowdown",
+					bench->type, op);
+				stress_metrics_set(args, idx++, str, slowdown);
+			}
+		}
+		if (args->instance == 0)
+			pr_inf("%s: %-13s %-4s %-8s %12s %10.3f %12s %10.3f\n", args->name,
+				bench->type, op, denormal ? "denormal" : "normal",
+				lat_cyc, lat_ns, tput_cyc, tput_ns);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	free(results);
+
+	return EXIT_SUCCESS;
+}
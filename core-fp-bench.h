@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_FP_BENCH_H
+#define CORE_FP_BENCH_H
+
+/* operations, each sets the kernel r, a and b inputs */
+#define FP_BENCH_OP_ADD		(0)	/* r = r + a, r = r - a */
+#define FP_BENCH_OP_MUL		(1)	/* r = r * a, r = r * b, b = 1 / a */
+#define FP_BENCH_OP_DIV		(2)	/* r = r / a, r = r / b, b = 1 / a */
+#define FP_BENCH_OP_SQRT	(3)	/* r = sqrt(r) */
+#define FP_BENCH_OP_FMA		(4)	/* r = r * a + b, fixed point of r = 2b */
+#define FP_BENCH_OP_MAX		(5)
+
+#define FP_BENCH_CHAINS		(8)	/* independent chains of throughput kernels */
+
+/*
+ *  a kernel runs loops iterations of its operation, as one dependent
+ *  chain (latency) or FP_BENCH_CHAINS independent chains (throughput)
+ *  starting from r with operands a and b, returns the operations done
+ */
+typedef uint64_t (*stress_fp_bench_func_t)(const long double r,
+	const long double a, const long double b, const uint32_t loops);
+
+typedef struct {
+	const char *type;			/* type name for the results */
+	int op;					/* FP_BENCH_OP_* */
+	long double min;			/* smallest normal value of the type */
+	stress_fp_bench_func_t latency;		/* one dependent chain */
+	stress_fp_bench_func_t throughput;	/* independent chains */
+} stress_fp_bench_t;
+
+/* run n benchmarks in turn until the run ends then report them */
+extern int stress_fp_bench_run(const stress_args_t *args,
+	const stress_fp_bench_t *benches, const size_t n);
+
+#endif
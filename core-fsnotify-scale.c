@@ -0,0 +1,768 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-fsnotify-scale.h"
+#include "core-latency.h"
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
+#if defined(HAVE_SYS_INOTIFY_H)
+#include <sys/inotify.h>
+#endif
+
+#if defined(HAVE_SYS_FANOTIFY_H)
+#include <sys/fanotify.h>
+#endif
+
+#define FSNOTIFY_SCALE_PHASE_USEC	(250000)	/* duration of each writer count */
+#define FSNOTIFY_SCALE_POLL_MSEC	(10)		/* reader poll timeout while writing */
+#define FSNOTIFY_SCALE_DRAIN_MSEC	(20)		/* queue is drained once idle this long */
+#define FSNOTIFY_SCALE_SWEEP_MAX	(8)		/* 1, 2, 4 .. 64 and the maximum */
+#define FSNOTIFY_SCALE_SLOTS		(32)		/* files per writer in each directory */
+#define FSNOTIFY_SCALE_BUF_SIZE		(64 * KB)	/* event read buffer */
+
+#if defined(HAVE_INOTIFY1) &&		\
+    defined(HAVE_SYS_INOTIFY_H) &&	\
+    defined(IN_CLOSE_WRITE) &&		\
+    defined(IN_Q_OVERFLOW) &&		\
+    defined(IN_NONBLOCK)
+#define HAVE_FSNOTIFY_SCALE_INOTIFY
+#endif
+
+#if defined(HAVE_FANOTIFY) &&		\
+    defined(HAVE_SYS_FANOTIFY_H) &&	\
+    defined(FAN_CLASS_NOTIF) &&		\
+    defined(FAN_CLOSE_WRITE) &&		\
+    defined(FAN_EVENT_ON_CHILD) &&	\
+    defined(FAN_NONBLOCK) &&		\
+    defined(FAN_Q_OVERFLOW)
+#define HAVE_FSNOTIFY_SCALE_FANOTIFY
+#endif
+
+#if defined(HAVE_FSNOTIFY_SCALE_FANOTIFY) &&	\
+    defined(HAVE_NAME_TO_HANDLE_AT) &&		\
+    defined(FAN_REPORT_DFID_NAME) &&		\
+    defined(FAN_EVENT_INFO_TYPE_DFID_NAME) &&	\
+    defined(FAN_MARK_FILESYSTEM)
+#define HAVE_FSNOTIFY_SCALE_FANOTIFY_FID
+#endif
+
+static const char * const fsnotify_scale_apis[] = {
+	"inotify",
+	"fanotify-fd",
+	"fanotify-fid",
+	"fanotify-fs",
+};
+
+/* per writer results */
+typedef struct {
+	uint64_t events;		/* files closed after writing */
+	int err;			/* errno of a failed open or write */
+} stress_fsnotify_scale_result_t;
+
+/* state shared with the writer processes */
+typedef struct {
+	volatile bool start;		/* writers start writing */
+	volatile bool stop;		/* writers stop writing */
+	stress_fsnotify_scale_result_t results[MAX_FSNOTIFY_SCALE_WRITERS];
+	/* time each writer last wrote each of its files */
+	volatile uint64_t stamp[MAX_FSNOTIFY_SCALE_WRITERS][FSNOTIFY_SCALE_SLOTS];
+} stress_fsnotify_scale_shared_t;
+
+/* accumulated results for a writer count */
+typedef struct {
+	uint32_t writers;		/* number of writers */
+	double wall;			/* seconds writers were writing */
+	double generated;		/* events generated by the writers */
+	double delivered;		/* events read by the listener */
+	double overflows;		/* queue overflow events read */
+	double cpu;			/* listener user + system seconds */
+	stress_latency_t latency;	/* close to event read latencies */
+} stress_fsnotify_scale_stats_t;
+
+/* a listener */
+typedef struct {
+	int api;			/* STRESS_FSNOTIFY_* api */
+	int fd;				/* inotify or fanotify fd */
+	pid_t pid;			/* pid named in the file names */
+	uint32_t writers;		/* maximum number of writers */
+	stress_fsnotify_scale_shared_t *shared;
+	uint8_t *buf;			/* event read buffer */
+} stress_fsnotify_scale_listener_t;
+
+/*
+ *  stress_fsnotify_scale_supported()
+ *	true if the api is built in
+ */
+static bool stress_fsnotify_scale_supported(const int api)
+{
+	switch (api) {
+#if defined(HAVE_FSNOTIFY_SCALE_INOTIFY)
+	case STRESS_FSNOTIFY_INOTIFY:
+		return true;
+#endif
+#if defined(HAVE_FSNOTIFY_SCALE_FANOTIFY)
+	case STRESS_FSNOTIFY_FANOTIFY_FD:
+		return true;
+#endif
+#if defined(HAVE_FSNOTIFY_SCALE_FANOTIFY_FID)
+	case STRESS_FSNOTIFY_FANOTIFY_FID:
+	case STRESS_FSNOTIFY_FANOTIFY_FS:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+/*
+ *  stress_fsnotify_scale_open()
+ *	create the listener fd of the api watching the directories
+ *	d0 .. d(dirs - 1) of path, returns the fd or -errno
+ */
+static int stress_fsnotify_scale_open(
+	const int api,
+	const char *path,
+	const uint32_t dirs)
+{
+	char dirname[PATH_MAX];
+	uint32_t i;
+	int fd, err;
+
+	switch (api) {
+#if defined(HAVE_FSNOTIFY_SCALE_INOTIFY)
+	case STRESS_FSNOTIFY_INOTIFY:
+		fd = inotify_init1(IN_NONBLOCK);
+		if (fd < 0)
+			return -errno;
+		for (i = 0; i < dirs; i++) {
+			(void)snprintf(dirname, sizeof(dirname), "%s/d%" PRIu32, path, i);
+			if (inotify_add_watch(fd, dirname, IN_CLOSE_WRITE) < 0)
+				goto err_close;
+		}
+		return fd;
+#endif
+#if defined(HAVE_FSNOTIFY_SCALE_FANOTIFY)
+	case STRESS_FSNOTIFY_FANOTIFY_FD:
+		fd = fanotify_init(FAN_CLASS_NOTIF | FAN_NONBLOCK, O_RDONLY);
+		if (fd < 0)
+			return -errno;
+		for (i = 0; i < dirs; i++) {
+			(void)snprintf(dirname, sizeof(dirname), "%s/d%" PRIu32, path, i);
+			if (fanotify_mark(fd, FAN_MARK_ADD, FAN_CLOSE_WRITE | FAN_EVENT_ON_CHILD,
+					  AT_FDCWD, dirname) < 0)
+				goto err_close;
+		}
+		return fd;
+#endif
+#if defined(HAVE_FSNOTIFY_SCALE_FANOTIFY_FID)
+	case STRESS_FSNOTIFY_FANOTIFY_FID:
+		fd = fanotify_init(FAN_CLASS_NOTIF | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY);
+		if (fd < 0)
+			return -errno;
+		for (i = 0; i < dirs; i++) {
+			(void)snprintf(dirname, sizeof(dirname), "%s/d%" PRIu32, path, i);
+			if (fanotify_mark(fd, FAN_MARK_ADD, FAN_CLOSE_WRITE | FAN_EVENT_ON_CHILD,
+					  AT_FDCWD, dirname) < 0)
+				goto err_close;
+		}
+		return fd;
+	case STRESS_FSNOTIFY_FANOTIFY_FS:
+		fd = fanotify_init(FAN_CLASS_NOTIF | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY);
+		if (fd < 0)
+			return -errno;
+		if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FAN_CLOSE_WRITE,
+				  AT_FDCWD, path) < 0)
+			goto err_close;
+		return fd;
+#endif
+	default:
+		(void)path;
+		(void)dirs;
+		(void)dirname;
+		(void)i;
+		return -ENOSYS;
+	}
+
+err_close:
+	err = errno;
+	(void)close(fd);
+	return -err;
+}
+
+/*
+ *  stress_fsnotify_scale_event()
+ *	account an event for the file name of the form pid.writer.slot,
+ *	the latency is from the time the writer closed the file, names
+ *	of other processes are ignored as filesystem marks see them too
+ */
+static void stress_fsnotify_scale_event(
+	const stress_fsnotify_scale_listener_t *listener,
+	stress_fsnotify_scale_stats_t *stats,
+	const char *name,
+	const uint64_t now)
+{
+	int pid;
+	uint32_t writer, slot;
+	uint64_t stamp;
+
+	if (sscanf(name, "%d.%" SCNu32 ".%" SCNu32, &pid, &writer, &slot) != 3)
+		return;
+	if ((pid != (int)listener->pid) || (writer >= listener->writers) ||
+	    (slot >= FSNOTIFY_SCALE_SLOTS))
+		return;
+	stats->delivered += 1.0;
+	stamp = listener->shared->stamp[writer][slot];
+	if ((stamp > 0) && (now >= stamp))
+		stress_latency_add(&stats->latency, now - stamp);
+}
+
+/*
+ *  stress_fsnotify_scale_read()
+ *	read and account all the queued events, returns 0 or an errno
+ */
+static int stress_fsnotify_scale_read(
+	const stress_fsnotify_scale_listener_t *listener,
+	stress_fsnotify_scale_stats_t *stats)
+{
+	for (;;) {
+		const ssize_t len = read(listener->fd, listener->buf, FSNOTIFY_SCALE_BUF_SIZE);
+		const uint64_t now = stress_latency_now();
+
+		if (len <= 0) {
+			if ((len < 0) && (errno == EINTR))
+				continue;
+			if ((len < 0) && (errno != EAGAIN))
+				return errno;
+			return 0;
+		}
+
+		switch (listener->api) {
+#if defined(HAVE_FSNOTIFY_SCALE_INOTIFY)
+		case STRESS_FSNOTIFY_INOTIFY: {
+				ssize_t i = 0;
+
+				while (i + (ssize_t)sizeof(struct inotify_event) <= len) {
+					const struct inotify_event *event =
+						(struct inotify_event *)(listener->buf + i);
+
+					if (event->mask & IN_Q_OVERFLOW)
+						stats->overflows += 1.0;
+					else if (event->len > 0)
+						stress_fsnotify_scale_event(listener, stats, event->name, now);
+					i += (ssize_t)(sizeof(struct inotify_event) + event->len);
+				}
+			}
+			break;
+#endif
+#if defined(HAVE_FSNOTIFY_SCALE_FANOTIFY)
+		case STRESS_FSNOTIFY_FANOTIFY_FD:
+		case STRESS_FSNOTIFY_FANOTIFY_FID:
+		case STRESS_FSNOTIFY_FANOTIFY_FS: {
+				struct fanotify_event_metadata *metadata =
+					(struct fanotify_event_metadata *)listener->buf;
+				ssize_t n = len;
+
+				while (FAN_EVENT_OK(metadata, n)) {
+					if (metadata->mask & FAN_Q_OVERFLOW) {
+						stats->overflows += 1.0;
+					} else if (metadata->fd >= 0) {
+						uint64_t stamp;
+
+						/* the writer wrote its close time into the file */
+						if ((pread(metadata->fd, &stamp, sizeof(stamp), 0) == (ssize_t)sizeof(stamp)) &&
+						    (stamp > 0)) {
+							stats->delivered += 1.0;
+							if (now >= stamp)
+								stress_latency_add(&stats->latency, now - stamp);
+						}
+					}
+#if defined(HAVE_FSNOTIFY_SCALE_FANOTIFY_FID)
+					else {
+						const uint8_t *info = (uint8_t *)metadata + metadata->metadata_len;
+						const uint8_t *end = (uint8_t *)metadata + metadata->event_len;
+
+						while (info + sizeof(struct fanotify_event_info_header) <= end) {
+							const struct fanotify_event_info_header *hdr =
+								(const struct fanotify_event_info_header *)info;
+
+							if (hdr->len == 0)
+								break;
+							if (hdr->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+								const struct fanotify_event_info_fid *fid =
+									(const struct fanotify_event_info_fid *)info;
+								const struct file_handle *handle =
+									(const struct file_handle *)fid->handle;
+								const char *name = (const char *)handle->f_handle +
+									handle->handle_bytes;
+
+								stress_fsnotify_scale_event(listener, stats, name, now);
+								break;
+							}
+							info += hdr->len;
+						}
+					}
+#endif
+					if (metadata->fd >= 0)
+						(void)close(metadata->fd);
+					metadata = FAN_EVENT_NEXT(metadata, n);
+				}
+			}
+			break;
+#endif
+		default:
+			(void)now;
+			return ENOSYS;
+		}
+	}
+}
+
+/*
+ *  stress_fsnotify_scale_wait()
+ *	wait up to msec milliseconds for events, returns true if
+ *	events are queued
+ */
+static bool stress_fsnotify_scale_wait(const int fd, const int msec)
+{
+#if defined(HAVE_POLL_H)
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	return poll(&pfd, 1, msec) > 0;
+#else
+	(void)fd;
+	(void)shim_usleep((uint64_t)msec * 1000);
+
+	return true;
+#endif
+}
+
+/*
+ *  stress_fsnotify_scale_writer()
+ *	create or rewrite files, rotating over the directories and over
+ *	FSNOTIFY_SCALE_SLOTS names so that queued events are rarely for
+ *	the same file, the close time is written into the file and into
+ *	the shared stamp of the slot before the file is closed
+ */
+static void stress_fsnotify_scale_writer(
+	stress_fsnotify_scale_shared_t *shared,
+	const char *path,
+	const pid_t pid,
+	const uint32_t writer,
+	const uint32_t dirs)
+{
+	stress_fsnotify_scale_result_t *result = &shared->results[writer];
+	uint32_t d = writer % dirs, slot = 0;
+	uint64_t events = 0;
+
+	while (!shared->start && !shared->stop)
+		shim_sched_yield();
+
+	while (!shared->stop && keep_stressing_flag()) {
+		char filename[PATH_MAX];
+		uint64_t stamp;
+		int fd;
+
+		(void)snprintf(filename, sizeof(filename), "%s/d%" PRIu32 "/%d.%" PRIu32 ".%" PRIu32,
+			path, d, (int)pid, writer, slot);
+		fd = open(filename, O_CREAT | O_WRONLY, S_IRUSR | S_IWUSR);
+		if (UNLIKELY(fd < 0)) {
+			if (errno == EINTR)
+				continue;
+			result->err = errno;
+			break;
+		}
+		stamp = stress_latency_now();
+		shared->stamp[writer][slot] = stamp;
+		if (UNLIKELY(pwrite(fd, &stamp, sizeof(stamp), 0) != (ssize_t)sizeof(stamp))) {
+			result->err = errno ? errno : ENOSPC;
+			(void)close(fd);
+			break;
+		}
+		(void)close(fd);
+		events++;
+
+		d++;
+		if (d >= dirs)
+			d = 0;
+		slot++;
+		if (slot >= FSNOTIFY_SCALE_SLOTS)
+			slot = 0;
+	}
+	result->events = events;
+}
+
+/*
+ *  stress_fsnotify_scale_phase()
+ *	run the writers for FSNOTIFY_SCALE_PHASE_USEC while the listener
+ *	reads the events, drain the queue and add the results to stats,
+ *	returns the errno of a failed writer or read or 0
+ */
+static int stress_fsnotify_scale_phase(
+	const stress_args_t *args,
+	const stress_fsnotify_scale_listener_t *listener,
+	const char *path,
+	const uint32_t dirs,
+	stress_fsnotify_scale_stats_t *stats)
+{
+	stress_fsnotify_scale_shared_t *shared = listener->shared;
+	pid_t pids[MAX_FSNOTIFY_SCALE_WRITERS];
+	const uint32_t n = stats->writers;
+	uint32_t i, started = 0;
+	struct rusage usage;
+	double t, cpu;
+	int err = 0;
+
+	shared->start = false;
+	shared->stop = false;
+	(void)memset((void *)shared->stamp, 0, sizeof(shared->stamp));
+	for (i = 0; i < n; i++) {
+		shared->results[i].events = 0;
+		shared->results[i].err = 0;
+	}
+	for (i = 0; i < n; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			break;
+		if (pids[i] == 0) {
+			stress_parent_died_alarm();
+			(void)sched_settings_apply(true);
+
+			stress_fsnotify_scale_writer(shared, path, listener->pid, i, dirs);
+			_exit(EXIT_SUCCESS);
+		}
+		started++;
+	}
+
+	(void)getrusage(RUSAGE_SELF, &usage);
+	cpu = stress_timeval_to_double(&usage.ru_utime) +
+	      stress_timeval_to_double(&usage.ru_stime);
+	t = stress_time_now();
+	if (started == n) {
+		const double t_end = t + (double)FSNOTIFY_SCALE_PHASE_USEC / 1000000.0;
+
+		shared->start = true;
+		while ((stress_time_now() < t_end) && keep_stressing_flag()) {
+			if (stress_fsnotify_scale_wait(listener->fd, FSNOTIFY_SCALE_POLL_MSEC)) {
+				err = stress_fsnotify_scale_read(listener, stats);
+				if (err)
+					break;
+			}
+		}
+	}
+	shared->stop = true;
+	t = stress_time_now() - t;
+
+	for (i = 0; i < started; i++) {
+		int status;
+
+		(void)shim_waitpid(pids[i], &status, 0);
+	}
+	if (started != n) {
+		pr_dbg("%s: could only fork %" PRIu32 " of %" PRIu32 " writers\n",
+			args->name, started, n);
+		return 0;
+	}
+	while (!err && stress_fsnotify_scale_wait(listener->fd, FSNOTIFY_SCALE_DRAIN_MSEC))
+		err = stress_fsnotify_scale_read(listener, stats);
+	(void)getrusage(RUSAGE_SELF, &usage);
+	cpu = stress_timeval_to_double(&usage.ru_utime) +
+	      stress_timeval_to_double(&usage.ru_stime) - cpu;
+
+	for (i = 0; i < n; i++) {
+		const stress_fsnotify_scale_result_t *result = &shared->results[i];
+
+		if (result->err)
+			err = result->err;
+		stats->generated += (double)result->events;
+	}
+	stats->wall += t;
+	stats->cpu += cpu;
+
+	return err;
+}
+
+/*
+ *  stress_fsnotify_scale_report()
+ *	print the event rates, losses, listener cpu cost and latencies
+ *	over the writer counts
+ */
+static void stress_fsnotify_scale_report(
+	const stress_args_t *args,
+	const int api,
+	const char *path,
+	const uint32_t dirs,
+	const stress_fsnotify_scale_stats_t *stats,
+	const size_t n_counts)
+{
+	size_t i;
+
+	pr_lock();
+	pr_inf("%s: %s events over writers, %" PRIu32 " directories%s\n",
+		args->name, fsnotify_scale_apis[api], dirs, stress_fs_type(path));
+	pr_inf("%s: %7s %11s %11s %9s %11s %9s %9s %9s %9s\n", args->name,
+		"writers", "written/s", "events/s", "lost %", "overflows/s",
+		"cpu us/ev", "p50 us", "p99 us", "max us");
+	for (i = 0; i < n_counts; i++) {
+		const stress_fsnotify_scale_stats_t *s = &stats[i];
+		const stress_latency_t *l = &s->latency;
+		const double lost = (s->generated > s->delivered) ? s->generated - s->delivered : 0.0;
+
+		if ((s->wall <= 0.0) || (s->generated <= 0.0))
+			continue;
+		pr_inf("%s: %7" PRIu32 " %11.0f %11.0f %9.2f %11.2f %9.2f %9.1f %9.1f %9.1f\n",
+			args->name, s->writers, s->generated / s->wall,
+			s->delivered / s->wall, 100.0 * lost / s->generated,
+			s->overflows / s->wall,
+			(s->delivered > 0.0) ? 1000000.0 * s->cpu / s->delivered : 0.0,
+			(double)stress_latency_percentile(l, 50.0) / 1000.0,
+			(double)stress_latency_percentile(l, 99.0) / 1000.0,
+			(double)l->max / 1000.0);
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_fsnotify_scale_rm()
+ *	remove the files written to and the directories
+ *	d0 .. d(dirs - 1) of path
+ */
+static void stress_fsnotify_scale_rm(const char *path, const uint32_t dirs)
+{
+	uint32_t i;
+
+	for (i = 0; i < dirs; i++) {
+		char dirname[PATH_MAX];
+		struct dirent *d;
+		DIR *dir;
+
+		(void)snprintf(dirname, sizeof(dirname), "%s/d%" PRIu32, path, i);
+		dir = opendir(dirname);
+		if (dir) {
+			while ((d = readdir(dir)) != NULL) {
+				char filename[PATH_MAX + 256];
+
+				if (stress_is_dot_filename(d->d_name))
+					continue;
+				(void)snprintf(filename, sizeof(filename), "%s/%s", dirname, d->d_name);
+				(void)shim_unlink(filename);
+			}
+			(void)closedir(dir);
+		}
+		(void)shim_rmdir(dirname);
+	}
+}
+
+/*
+ *  stress_fsnotify_scale()
+ *	measure the rate events are delivered to a single listener
+ *	watching dirs directories with each of the apis as the number
+ *	of processes writing files in the directories grows, with the
+ *	events lost to queue overflows or merges, the listener cpu time
+ *	per event and the latency from file close to event read
+ */
+int stress_fsnotify_scale(
+	const stress_args_t *args,
+	const int *apis,
+	const size_t n_apis,
+	const uint32_t dirs,
+	const uint32_t writers)
+{
+	static stress_fsnotify_scale_stats_t stats[SIZEOF_ARRAY(fsnotify_scale_apis)][FSNOTIFY_SCALE_SWEEP_MAX];
+	stress_fsnotify_scale_listener_t listeners[SIZEOF_ARRAY(fsnotify_scale_apis)];
+	stress_fsnotify_scale_shared_t *shared;
+	char path[PATH_MAX - 64];
+	uint8_t *buf;
+	uint32_t n, n_dirs = 0;
+	size_t a, j, n_counts = 0, idx = 0;
+	int ret, rc = EXIT_SUCCESS;
+	bool supported = false;
+
+	for (a = 0; a < n_apis; a++) {
+		listeners[a].api = apis[a];
+		listeners[a].fd = -1;
+		if ((apis[a] >= 0) && (apis[a] < (int)SIZEOF_ARRAY(fsnotify_scale_apis)) &&
+		    stress_fsnotify_scale_supported(apis[a]))
+			supported = true;
+	}
+	if ((n_apis > SIZEOF_ARRAY(listeners)) || !supported) {
+		pr_inf_skip("%s: event scaling is not supported, skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (n = 1; (n < writers) && (n_counts < FSNOTIFY_SCALE_SWEEP_MAX - 1); n <<= 1)
+		stats[0][n_counts++].writers = n;
+	stats[0][n_counts++].writers = writers;
+	for (a = 0; a < n_apis; a++) {
+		for (j = 0; j < n_counts; j++) {
+			stats[a][j].writers = stats[0][j].writers;
+			stress_latency_reset(&stats[a][j].latency);
+		}
+	}
+
+	shared = (stress_fsnotify_scale_shared_t *)mmap(NULL, sizeof(*shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes of shared state, skipping stressor\n",
+			args->name, sizeof(*shared));
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (uint8_t *)mmap(NULL, FSNOTIFY_SCALE_BUF_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte event buffer, skipping stressor\n",
+			args->name, (size_t)FSNOTIFY_SCALE_BUF_SIZE);
+		rc = EXIT_NO_RESOURCE;
+		goto unmap_shared;
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto unmap_buf;
+	}
+	(void)stress_temp_dir_args(args, path, sizeof(path));
+	for (n_dirs = 0; n_dirs < dirs; n_dirs++) {
+		char dirname[PATH_MAX];
+
+		(void)snprintf(dirname, sizeof(dirname), "%s/d%" PRIu32, path, n_dirs);
+		if (mkdir(dirname, S_IRWXU) < 0) {
+			rc = stress_exit_status(errno);
+			pr_fail("%s: mkdir %s failed, errno=%d (%s)%s\n",
+				args->name, dirname, errno, strerror(errno),
+				stress_fs_type(path));
+			goto rm_dirs;
+		}
+	}
+
+	supported = false;
+	for (a = 0; a < n_apis; a++) {
+		stress_fsnotify_scale_listener_t *listener = &listeners[a];
+
+		listener->pid = args->pid;
+		listener->writers = writers;
+		listener->shared = shared;
+		listener->buf = buf;
+		if (!stress_fsnotify_scale_supported(listener->api))
+			continue;
+		listener->fd = stress_fsnotify_scale_open(listener->api, path, dirs);
+		if (listener->fd < 0) {
+			if (args->instance == 0)
+				pr_inf("%s: %s events cannot be watched, errno=%d (%s), skipping it\n",
+					args->name, fsnotify_scale_apis[listener->api],
+					-listener->fd, strerror(-listener->fd));
+			continue;
+		}
+		supported = true;
+	}
+	if (!supported) {
+		pr_inf_skip("%s: no event api could watch the directories, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto close_fds;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (a = 0; (rc == EXIT_SUCCESS) && (a < n_apis); a++) {
+			const stress_fsnotify_scale_listener_t *listener = &listeners[a];
+
+			if (listener->fd < 0)
+				continue;
+			for (j = 0; keep_stressing(args) && (j < n_counts); j++) {
+				stress_fsnotify_scale_stats_t *s = &stats[a][j];
+				const double delivered = s->delivered;
+
+				ret = stress_fsnotify_scale_phase(args, listener, path, dirs, s);
+				add_counter(args, (uint64_t)(s->delivered - delivered));
+				if (ret != 0) {
+					pr_fail("%s: %s events with %" PRIu32 " writers failed, "
+						"errno=%d (%s)%s\n", args->name,
+						fsnotify_scale_apis[listener->api], s->writers,
+						ret, strerror(ret), stress_fs_type(path));
+					rc = EXIT_FAILURE;
+					break;
+				}
+			}
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (a = 0; a < n_apis; a++) {
+		const int api = listeners[a].api;
+
+		if (listeners[a].fd < 0)
+			continue;
+		if (args->instance == 0)
+			stress_fsnotify_scale_report(args, api, path, dirs, stats[a], n_counts);
+
+		for (j = 0; j < n_counts; j++) {
+			const stress_fsnotify_scale_stats_t *s = &stats[a][j];
+			const stress_latency_t *l = &s->latency;
+			char str[64];
+
+			if ((s->wall <= 0.0) || (s->generated <= 0.0))
+				continue;
+			(void)snprintf(str, sizeof(str), "%s events per sec (%" PRIu32 " writers)",
+				fsnotify_scale_apis[api], s->writers);
+			stress_metrics_set(args, idx++, str, s->delivered / s->wall);
+			if (j < n_counts - 1)
+				continue;
+			(void)snprintf(str, sizeof(str), "%s events lost %% (%" PRIu32 " writers)",
+				fsnotify_scale_apis[api], s->writers);
+			stress_metrics_set(args, idx++, str, (s->generated > s->delivered) ?
+				100.0 * (s->generated - s->delivered) / s->generated : 0.0);
+			(void)snprintf(str, sizeof(str), "%s overflows per sec (%" PRIu32 " writers)",
+				fsnotify_scale_apis[api], s->writers);
+			stress_metrics_set(args, idx++, str, s->overflows / s->wall);
+			(void)snprintf(str, sizeof(str), "%s cpu usecs per event (%" PRIu32 " writers)",
+				fsnotify_scale_apis[api], s->writers);
+			stress_metrics_set(args, idx++, str, (s->delivered > 0.0) ?
+				1000000.0 * s->cpu / s->delivered : 0.0);
+			(void)snprintf(str, sizeof(str), "%s p99 event latency (ns) (%" PRIu32 " writers)",
+				fsnotify_scale_apis[api], s->writers);
+			stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 99.0));
+			if (args->latency)
+				stress_latency_merge(args->latency, l);
+		}
+	}
+
+close_fds:
+	for (a = 0; a < n_apis; a++) {
+		if (listeners[a].fd >= 0)
+			(void)close(listeners[a].fd);
+	}
+rm_dirs:
+	stress_fsnotify_scale_rm(path, n_dirs);
+	(void)stress_temp_dir_rm_args(args);
+unmap_buf:
+	(void)munmap((void *)buf, FSNOTIFY_SCALE_BUF_SIZE);
+unmap_shared:
+	(void)munmap((void *)shared, sizeof(*shared));
+
+	return rc;
+}
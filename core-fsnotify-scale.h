@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_FSNOTIFY_SCALE_H
+#define CORE_FSNOTIFY_SCALE_H
+
+/* file system notification apis */
+#define STRESS_FSNOTIFY_INOTIFY		(0)	/* inotify watch per directory */
+#define STRESS_FSNOTIFY_FANOTIFY_FD	(1)	/* fanotify mark per directory, events carry an fd */
+#define STRESS_FSNOTIFY_FANOTIFY_FID	(2)	/* fanotify mark per directory, FAN_REPORT_DFID_NAME */
+#define STRESS_FSNOTIFY_FANOTIFY_FS	(3)	/* fanotify FAN_MARK_FILESYSTEM, FAN_REPORT_DFID_NAME */
+
+#define MIN_FSNOTIFY_SCALE_DIRS		(1)
+#define MAX_FSNOTIFY_SCALE_DIRS		(4096)
+#define DEFAULT_FSNOTIFY_SCALE_DIRS	(16)
+
+#define MIN_FSNOTIFY_SCALE_WRITERS	(1)
+#define MAX_FSNOTIFY_SCALE_WRITERS	(64)
+#define DEFAULT_FSNOTIFY_SCALE_WRITERS	(4)
+
+/* event delivery rate, overflows and latency over the number of writers */
+extern int stress_fsnotify_scale(const stress_args_t *args, const int *apis,
+	const size_t n_apis, const uint32_t dirs, const uint32_t writers);
+
+#endif
@@ -33,6 +33,33 @@
 #include <bsd/sys/tree.h>
 #endif
 
+/*
+ *  stress_set_ftrace_top()
+ *	set number of kernel functions to report per stressor
+ */
+int stress_set_ftrace_top(const char *opt)
+{
+	uint32_t top;
+
+	top = stress_get_uint32(opt);
+	stress_check_range("ftrace-top", (uint64_t)top, 1, 10000);
+	g_opt_flags |= OPT_FLAGS_FTRACE;
+	return stress_set_setting_global("ftrace-top", TYPE_ID_UINT32, &top);
+}
+
+/*
+ *  stress_set_ftrace_pid()
+ *	restrict function profiling to the stress-ng processes
+ */
+int stress_set_ftrace_pid(const char *opt)
+{
+	bool pids = true;
+
+	(void)opt;
+	g_opt_flags |= OPT_FLAGS_FTRACE;
+	return stress_set_setting_global("ftrace-pid", TYPE_ID_BOOL, &pids);
+}
+
 #if defined(HAVE_LIB_BSD) &&	\
     defined(__linux__)
 
@@ -50,7 +77,26 @@ struct rb_node {
 	double	end_time_us;	/* end time used by func microsecs */
 };
 
+/* per stressor (or per parallel run) kernel function profile */
+typedef struct {
+	char *func_name;	/* ftrace'd kernel function name */
+	int64_t count;		/* number of calls during the step */
+	double time_us;		/* time used by func during the step */
+} stress_ftrace_func_t;
+
+typedef struct stress_ftrace_step {
+	struct stress_ftrace_step *next;	/* next step */
+	char *name;			/* stressor name or "parallel" */
+	int64_t func_calls;		/* number of functions called */
+	size_t n;			/* number of top functions */
+	stress_ftrace_func_t *funcs;	/* top n functions by time */
+} stress_ftrace_step_t;
+
 static bool tracing_enabled;
+static bool tracing_pids;		/* --ftrace-pid, restrict to stress-ng pids */
+static uint32_t ftrace_top = 10;	/* --ftrace-top, functions per step */
+static stress_ftrace_step_t *steps_head;
+static stress_ftrace_step_t *steps_tail;
 
 /*
  *  rb_node_cmp()
@@ -61,7 +107,8 @@ static int rb_node_cmp(struct rb_node *n1, struct rb_node *n2)
 	return strcmp(n1->func_name, n2->func_name);
 }
 
-static RB_HEAD(rb_tree, rb_node) rb_root;
+static RB_HEAD(rb_tree, rb_node) rb_root;	/* whole run */
+static struct rb_tree rb_step_root;		/* current step */
 RB_PROTOTYPE(rb_tree, rb_node, rb, rb_node_cmp);
 RB_GENERATE(rb_tree, rb_node, rb, rb_node_cmp);
 
@@ -98,31 +145,60 @@ static char *stress_ftrace_get_debugfs_path(void)
 	return NULL;
 }
 
+/*
+ *  stress_ftrace_tree_free()
+ *	free up a rb tree
+ */
+static void stress_ftrace_tree_free(struct rb_tree *root)
+{
+	struct rb_node *tn, *next;
+
+	for (tn = RB_MIN(rb_tree, root); tn; tn = next) {
+		free(tn->func_name);
+                next = RB_NEXT(rb_tree, root, tn);
+                RB_REMOVE(rb_tree, root, tn);
+		free(tn);
+	}
+	RB_INIT(root);
+}
+
 /*
  *  stress_ftrace_free()
- *	free up rb tree
+ *	free up rb trees and per step profiles
  */
 void stress_ftrace_free(void)
 {
-	struct rb_node *tn, *next;
+	stress_ftrace_step_t *step;
 
 	if (!(g_opt_flags & OPT_FLAGS_FTRACE))
 		return;
 
-	for (tn = RB_MIN(rb_tree, &rb_root); tn; tn = next) {
-		free(tn->func_name);
-                next = RB_NEXT(rb_tree, &rb_root, tn);
-                RB_REMOVE(rb_tree, &rb_root, tn);
-		free(tn);
+	stress_ftrace_tree_free(&rb_root);
+	stress_ftrace_tree_free(&rb_step_root);
+
+	for (step = steps_head; step; ) {
+		stress_ftrace_step_t *next = step->next;
+		size_t i;
+
+		for (i = 0; i < step->n; i++)
+			free(step->funcs[i].func_name);
+		free(step->funcs);
+		free(step->name);
+		free(step);
+		step = next;
 	}
-	RB_INIT(&rb_root);
+	steps_head = NULL;
+	steps_tail = NULL;
 }
 
 /*
  *  stress_ftrace_parse_trace_stat_file()
  *	parse the ftrace files for function timing stats
  */
-static int stress_ftrace_parse_trace_stat_file(const char *path, const bool start)
+static int stress_ftrace_parse_trace_stat_file(
+	struct rb_tree *root,
+	const char *path,
+	const bool start)
 {
 	FILE *fp;
 	char buffer[4096];
@@ -181,7 +257,7 @@ static int stress_ftrace_parse_trace_stat_file(const char *path, const bool star
 
 		node.func_name = func_name;
 
-		tn = RB_FIND(rb_tree, &rb_root, &node);
+		tn = RB_FIND(rb_tree, root, &node);
 		if (tn) {
 			if (start) {
 				tn->start_count += count;
@@ -212,8 +288,10 @@ static int stress_ftrace_parse_trace_stat_file(const char *path, const bool star
 				tn->end_time_us = time_us;
 			}
 			/* If we find an exiting matching, free the unused new tn */
-			if (RB_INSERT(rb_tree, &rb_root, tn) != NULL)
+			if (RB_INSERT(rb_tree, root, tn) != NULL) {
+				free(tn->func_name);
 				free(tn);
+			}
 		}
 	}
 	(void)fclose(fp);
@@ -222,6 +300,7 @@ static int stress_ftrace_parse_trace_stat_file(const char *path, const bool star
 memory_fail:
 	(void)fclose(fp);
 	pr_inf("ftrace: disabled, out of memory collecting function information\n");
+	tracing_enabled = false;
 	stress_ftrace_free();
 	return -1;
 }
@@ -230,7 +309,10 @@ memory_fail:
  *  stress_ftrace_parse_stat_files()
  *	read trace stat files and parse the data into the rb tree
  */
-static int stress_ftrace_parse_stat_files(const char *path, const bool start)
+static int stress_ftrace_parse_stat_files(
+	struct rb_tree *root,
+	const char *path,
+	const bool start)
 {
 	DIR *dp;
 	struct dirent *de;
@@ -246,7 +328,8 @@ static int stress_ftrace_parse_stat_files(const char *path, const bool start)
 
 			(void)snprintf(funcfile, sizeof(funcfile),
 				"%s/tracing/trace_stat/%s", path, de->d_name);
-			stress_ftrace_parse_trace_stat_file(funcfile, start);
+			if (stress_ftrace_parse_trace_stat_file(root, funcfile, start) < 0)
+				break;
 		}
 	}
 	(void)closedir(dp);
@@ -267,7 +350,7 @@ void stress_ftrace_add_pid(const pid_t pid)
 	char buffer[32];
 	int fd;
 
-	if (!(g_opt_flags & OPT_FLAGS_FTRACE))
+	if (!(g_opt_flags & OPT_FLAGS_FTRACE) || !tracing_pids)
 		return;
 
 	path = stress_ftrace_get_debugfs_path();
@@ -299,6 +382,9 @@ int stress_ftrace_start(void)
 		return 0;
 
 	RB_INIT(&rb_root);
+	RB_INIT(&rb_step_root);
+	(void)stress_get_setting("ftrace-pid", &tracing_pids);
+	(void)stress_get_setting("ftrace-top", &ftrace_top);
 
 	if (!stress_check_capability(SHIM_CAP_SYS_ADMIN)) {
 		pr_inf("ftrace: requires CAP_SYS_ADMIN capability for tracing\n");
@@ -325,7 +411,7 @@ int stress_ftrace_start(void)
 			errno, strerror(errno));
 		return -1;
 	}
-	if (stress_ftrace_parse_stat_files(path, true) < 0)
+	if (stress_ftrace_parse_stat_files(&rb_root, path, true) < 0)
 		return -1;
 
 	tracing_enabled = true;
@@ -406,17 +492,187 @@ void stress_ftrace_stop(void)
 	}
 
 	(void)snprintf(filename, sizeof(filename), "%s/tracing/trace_stat", path);
-	if (stress_ftrace_parse_stat_files(path, false) < 0)
+	if (stress_ftrace_parse_stat_files(&rb_root, path, false) < 0)
 		return;
 	stress_ftrace_analyze();
 }
 
+/*
+ *  stress_ftrace_step_begin()
+ *	snapshot the kernel function profile at the start of
+ *	a sequential stressor step or parallel run
+ */
+void stress_ftrace_step_begin(void)
+{
+	char *path;
+
+	if (!(g_opt_flags & OPT_FLAGS_FTRACE) || !tracing_enabled)
+		return;
+
+	path = stress_ftrace_get_debugfs_path();
+	if (!path)
+		return;
+
+	stress_ftrace_tree_free(&rb_step_root);
+	(void)stress_ftrace_parse_stat_files(&rb_step_root, path, true);
+}
+
+/*
+ *  stress_ftrace_func_cmp()
+ *	sort functions by most time used first
+ */
+static int stress_ftrace_func_cmp(const void *p1, const void *p2)
+{
+	const stress_ftrace_func_t *f1 = (const stress_ftrace_func_t *)p1;
+	const stress_ftrace_func_t *f2 = (const stress_ftrace_func_t *)p2;
+
+	if (f1->time_us < f2->time_us)
+		return 1;
+	if (f1->time_us > f2->time_us)
+		return -1;
+	return strcmp(f1->func_name, f2->func_name);
+}
+
+/*
+ *  stress_ftrace_step_end()
+ *	snapshot the kernel function profile at the end of a step
+ *	and keep the top functions by time used. The step is named
+ *	after the stressor if just one stressor was run.
+ */
+void stress_ftrace_step_end(const stress_stressor_t *stressors_list)
+{
+	struct rb_node *tn;
+	stress_ftrace_step_t *step;
+	stress_ftrace_func_t *funcs;
+	char *path;
+	size_t i, n = 0;
+
+	if (!(g_opt_flags & OPT_FLAGS_FTRACE) || !tracing_enabled)
+		return;
+
+	path = stress_ftrace_get_debugfs_path();
+	if (!path)
+		return;
+	if (stress_ftrace_parse_stat_files(&rb_step_root, path, false) < 0)
+		return;
+
+	RB_FOREACH(tn, rb_tree, &rb_step_root) {
+		if (tn->end_count > tn->start_count)
+			n++;
+	}
+	step = calloc(1, sizeof(*step));
+	if (!step)
+		goto memory_fail;
+	funcs = calloc(n ? n : 1, sizeof(*funcs));
+	if (!funcs) {
+		free(step);
+		goto memory_fail;
+	}
+	i = 0;
+	RB_FOREACH(tn, rb_tree, &rb_step_root) {
+		if (tn->end_count > tn->start_count) {
+			funcs[i].func_name = tn->func_name;
+			funcs[i].count = tn->end_count - tn->start_count;
+			funcs[i].time_us = tn->end_time_us - tn->start_time_us;
+			i++;
+		}
+	}
+	qsort(funcs, n, sizeof(*funcs), stress_ftrace_func_cmp);
+
+	step->func_calls = (int64_t)n;
+	step->n = STRESS_MINIMUM(n, (size_t)ftrace_top);
+	step->funcs = funcs;
+	step->name = strdup((stressors_list && !stressors_list->next) ?
+		stressors_list->stressor->name : "parallel");
+	if (!step->name)
+		step->n = 0;
+	/* the tree is about to be freed, keep copies of the top names */
+	for (i = 0; i < step->n; i++) {
+		funcs[i].func_name = strdup(funcs[i].func_name);
+		if (!funcs[i].func_name) {
+			step->n = i;
+			break;
+		}
+	}
+	if (steps_tail)
+		steps_tail->next = step;
+	else
+		steps_head = step;
+	steps_tail = step;
+	stress_ftrace_tree_free(&rb_step_root);
+
+	if (!step->name)
+		return;
+	pr_inf("ftrace: %s: top %zu of %" PRId64 " kernel functions by time:\n",
+		step->name, step->n, step->func_calls);
+	pr_inf("ftrace: %-30.30s %15.15s %16.16s %14.14s\n",
+		"Function", "Number of Calls", "Total Time (us)", "Avg Time (us)");
+	for (i = 0; i < step->n; i++) {
+		const stress_ftrace_func_t *f = &step->funcs[i];
+
+		pr_inf("ftrace: %-30.30s %15" PRId64 " %16.2f %14.3f\n",
+			f->func_name, f->count, f->time_us,
+			f->time_us / (double)f->count);
+	}
+	return;
+
+memory_fail:
+	stress_ftrace_tree_free(&rb_step_root);
+	pr_inf("ftrace: out of memory collecting per stressor function information\n");
+}
+
+/*
+ *  stress_ftrace_dump()
+ *	dump the per stressor top kernel functions to the yaml file
+ */
+void stress_ftrace_dump(FILE *yaml)
+{
+	const stress_ftrace_step_t *step;
+
+	if (!steps_head)
+		return;
+
+	pr_yaml(yaml, "ftrace:\n");
+	for (step = steps_head; step; step = step->next) {
+		size_t i;
+
+		if (!step->name)
+			continue;
+		pr_yaml(yaml, "    - stressor: %s\n", step->name);
+		pr_yaml(yaml, "      kernel-functions-called: %" PRId64 "\n", step->func_calls);
+		pr_yaml(yaml, "      functions:\n");
+		for (i = 0; i < step->n; i++) {
+			const stress_ftrace_func_t *f = &step->funcs[i];
+
+			pr_yaml(yaml, "        - function: %s\n", f->func_name);
+			pr_yaml(yaml, "          calls: %" PRId64 "\n", f->count);
+			pr_yaml(yaml, "          total-time-usecs: %f\n", f->time_us);
+			pr_yaml(yaml, "          avg-time-usecs: %f\n", f->time_us / (double)f->count);
+		}
+	}
+	pr_yaml(yaml, "\n");
+}
+
 #else
 void stress_ftrace_add_pid(const pid_t pid)
 {
 	(void)pid;
 }
 
+void stress_ftrace_step_begin(void)
+{
+}
+
+void stress_ftrace_step_end(const stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+}
+
+void stress_ftrace_dump(FILE *yaml)
+{
+	(void)yaml;
+}
+
 void stress_ftrace_free(void)
 {
 }
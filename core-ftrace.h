@@ -24,5 +24,10 @@ extern int stress_ftrace_start(void);
 extern void stress_ftrace_stop(void);
 extern void stress_ftrace_free(void);
 extern void stress_ftrace_add_pid(const pid_t pid);
+extern void stress_ftrace_step_begin(void);
+extern void stress_ftrace_step_end(const stress_stressor_t *stressors_list);
+extern void stress_ftrace_dump(FILE *yaml);
+extern int stress_set_ftrace_pid(const char *opt);
+extern int stress_set_ftrace_top(const char *opt);
 
 #endif
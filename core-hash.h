@@ -19,6 +19,8 @@
 #ifndef CORE_HASH_H
 #define CORE_HASH_H
 
+#include "core-arena.h"
+
 /* hash linked list type */
 typedef struct stress_hash {
 	struct stress_hash *next; 	/* next hash item */
@@ -28,6 +30,7 @@ typedef struct stress_hash {
 typedef struct {
 	stress_hash_t	**table;	/* hash table */
 	size_t		n;		/* number of hash items in table */
+	stress_arena_t	*arena;		/* --arena hash item arena */
 } stress_hash_table_t;
 
 /*
@@ -45,6 +48,11 @@ extern WARN_UNUSED uint32_t stress_hash_coffin(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_coffin32_be(const char *str, const size_t len);
 extern WARN_UNUSED uint32_t stress_hash_coffin32_le(const char *str, const size_t len);
 extern WARN_UNUSED uint32_t stress_hash_crc32c(const char *str);
+extern WARN_UNUSED uint32_t stress_hash_crc32c_update(uint32_t crc, const void *data,
+	const size_t len);
+extern WARN_UNUSED uint64_t stress_hash_crc64(const void *data, const size_t len);
+extern WARN_UNUSED uint64_t stress_hash_crc64_update(uint64_t crc, const void *data,
+	const size_t len);
 extern WARN_UNUSED uint32_t stress_hash_djb2a(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_fnv1a(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_jenkin(const uint8_t *data, const size_t len);
@@ -65,5 +73,7 @@ extern WARN_UNUSED uint32_t stress_hash_sdbm(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_x17(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_sedgwick(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_sobel(const char *str);
+extern WARN_UNUSED uint64_t stress_hash_wyhash(const void *data, const size_t len,
+	uint64_t seed);
 
 #endif
@@ -1624,10 +1624,7 @@ void stress_rndstr(char *str, size_t len)
  */
 void stress_rndbuf(void *buf, size_t len)
 {
-	size_t i;
-
-	for (i = 0; i < len; i++)
-		*(char *)buf++ = stress_mwc8();
+	stress_mwc_fill(buf, len);
 }
 
 /*
@@ -1661,7 +1658,9 @@ static inline uint32_t OPTIMIZE3 stress_swap32(uint32_t val)
 /*
  *  stress_uint8rnd4()
  *	fill a uint8_t buffer full of random data
- *	buffer *must* be multiple of 4 bytes in size
+ *	buffer *must* be multiple of 4 bytes in size,
+ *	the data is the endian independent stress_mwc32()
+ *	sequence that hash checksum verification relies on
  */
 void OPTIMIZE3 stress_uint8rnd4(uint8_t *data, const size_t len)
 {
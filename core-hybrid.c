@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cpu.h"
+#include "core-hybrid.h"
+#include "core-phase.h"
+#include "core-power.h"
+#include "core-resctrl.h"
+#include "core-search.h"
+
+#define CORE_TYPE_NONE		(0)
+#define CORE_TYPE_P		(1)	/* P cores only */
+#define CORE_TYPE_E		(2)	/* E cores only */
+#define CORE_TYPE_SEPARATELY	(3)	/* P cores then E cores */
+
+#define HYBRID_P		(0)
+#define HYBRID_E		(1)
+#define HYBRID_TYPES		(2)
+
+typedef struct {
+	const char *name;	/* --core-type name */
+	const int type;		/* CORE_TYPE_* */
+} stress_core_type_t;
+
+static const stress_core_type_t core_types[] = {
+	{ "p",			CORE_TYPE_P },
+	{ "e",			CORE_TYPE_E },
+	{ "all-separately",	CORE_TYPE_SEPARATELY },
+};
+
+/* per stressor throughput on each core type */
+typedef struct {
+	const stress_stressor_t *ss;
+	bool run[HYBRID_TYPES];		/* run on this core type */
+	double bogo_rate[HYBRID_TYPES];	/* real time bogo ops per second */
+	double ops_per_joule[HYBRID_TYPES]; /* < 0 if not measured */
+} stress_hybrid_t;
+
+static const char * const hybrid_names[HYBRID_TYPES] = { "P", "E" };
+
+/*
+ *  stress_set_core_type()
+ *	set --core-type p, e or all-separately
+ */
+int stress_set_core_type(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(core_types); i++) {
+		if (!strcmp(opt, core_types[i].name)) {
+			int type = core_types[i].type;
+
+			return stress_set_setting_global("core-type", TYPE_ID_INT, &type);
+		}
+	}
+	(void)fprintf(stderr, "core-type must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(core_types); i++)
+		(void)fprintf(stderr, " %s", core_types[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+#if defined(HAVE_SCHED_SETAFFINITY)
+
+static cpu_set_t hybrid_cpus[HYBRID_TYPES];
+static size_t hybrid_steps[HYBRID_TYPES];	/* core types to run, in order */
+static size_t hybrid_steps_num;
+static size_t hybrid_step_current;
+static int hybrid_type = -1;		/* core type being run, -1 = any */
+static stress_hybrid_t *hybrids;
+static size_t hybrids_num;
+
+/*
+ *  stress_hybrid_setup()
+ *	check the --core-type option and find the P and E cores
+ */
+int stress_hybrid_setup(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	int type = CORE_TYPE_NONE;
+	size_t i;
+
+	(void)stress_get_setting("core-type", &type);
+	if (type == CORE_TYPE_NONE)
+		return 0;
+	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+		pr_err("core-type: --core-type cannot be used with --sequential\n");
+		return -1;
+	}
+	if (stress_phase_count()) {
+		pr_err("core-type: --core-type cannot be used with job file phases\n");
+		return -1;
+	}
+	if (stress_search_enabled()) {
+		pr_err("core-type: --core-type cannot be used with --search\n");
+		return -1;
+	}
+	if (stress_resctrl_sweep_enabled()) {
+		pr_err("core-type: --core-type cannot be used with --resctrl-sweep\n");
+		return -1;
+	}
+	if (!stress_cpu_core_types(&hybrid_cpus[HYBRID_P], &hybrid_cpus[HYBRID_E])) {
+		pr_inf("core-type: no hybrid P and E cores found, ignoring --core-type\n");
+		return 0;
+	}
+
+	hybrid_steps_num = 0;
+	if (type != CORE_TYPE_E)
+		hybrid_steps[hybrid_steps_num++] = HYBRID_P;
+	if (type != CORE_TYPE_P)
+		hybrid_steps[hybrid_steps_num++] = HYBRID_E;
+
+	for (hybrids_num = 0, ss = stressors_list; ss; ss = ss->next)
+		hybrids_num++;
+	hybrids = calloc(hybrids_num, sizeof(*hybrids));
+	if (!hybrids) {
+		pr_err("core-type: cannot allocate %zu core type results\n", hybrids_num);
+		hybrids_num = 0;
+		hybrid_steps_num = 0;
+		return -1;
+	}
+	for (i = 0, ss = stressors_list; ss; ss = ss->next, i++)
+		hybrids[i].ss = ss;
+
+	pr_dbg("core-type: %d P cores, %d E cores\n",
+		CPU_COUNT(&hybrid_cpus[HYBRID_P]), CPU_COUNT(&hybrid_cpus[HYBRID_E]));
+	return 0;
+}
+
+/*
+ *  stress_hybrid_enabled()
+ *	true if stressors are run on selected core types
+ */
+bool stress_hybrid_enabled(void)
+{
+	return hybrid_steps_num > 0;
+}
+
+/*
+ *  stress_hybrid_step_begin()
+ *	select the next core type to run the stressors on,
+ *	returns false when all the core types have been run
+ */
+bool stress_hybrid_step_begin(void)
+{
+	if (hybrid_step_current >= hybrid_steps_num) {
+		hybrid_type = -1;
+		return false;
+	}
+	hybrid_type = (int)hybrid_steps[hybrid_step_current];
+	pr_inf("core-type: running stressors on the %d %s cores\n",
+		CPU_COUNT(&hybrid_cpus[hybrid_type]), hybrid_names[hybrid_type]);
+	return true;
+}
+
+/*
+ *  stress_hybrid_step_end()
+ *	record the throughput and energy efficiency
+ *	of each stressor on the core type just run
+ */
+void stress_hybrid_step_end(stress_stressor_t *stressors_list, const double duration)
+{
+	const double joules = stress_power_step_joules();
+	stress_stressor_t *ss;
+	size_t i;
+
+	(void)duration;
+
+	for (i = 0, ss = stressors_list; ss && (i < hybrids_num); ss = ss->next, i++) {
+		stress_hybrid_t *hybrid = &hybrids[i];
+		double r_time;
+		uint64_t ops = 0;
+		int32_t j;
+
+		if (!ss->stats || !ss->started_instances)
+			continue;
+		for (j = 0; j < ss->started_instances; j++)
+			ops += ss->stats[j]->ci.counter;
+
+		hybrid->run[hybrid_type] = true;
+		hybrid->bogo_rate[hybrid_type] = stress_bogo_rate_real_time(ss, &r_time);
+		hybrid->ops_per_joule[hybrid_type] = (joules > 0.0) ? (double)ops / joules : -1.0;
+	}
+	hybrid_step_current++;
+}
+
+/*
+ *  stress_hybrid_apply()
+ *	restrict a stressor instance to the core type being run,
+ *	keeping any --taskset or --placement CPUs of that type
+ */
+void stress_hybrid_apply(const char *name)
+{
+	cpu_set_t set;
+
+	if (hybrid_type < 0)
+		return;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		CPU_ZERO(&set);
+	CPU_AND(&set, &set, &hybrid_cpus[hybrid_type]);
+	if (CPU_COUNT(&set) == 0)
+		set = hybrid_cpus[hybrid_type];
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("%s: cannot set %s core CPU affinity, errno=%d (%s)\n",
+			name, hybrid_names[hybrid_type], errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_hybrid_dump()
+ *	dump the per core type throughput and energy efficiency
+ */
+void stress_hybrid_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	size_t i;
+
+	(void)stressors_list;
+
+	if (!hybrids || !hybrid_step_current)
+		return;
+
+	pr_yaml(yaml, "core-types:\n");
+	pr_metrics("core type throughput:\n");
+	pr_metrics("%-13s %4s %5s %13s %13s\n",
+		"stressor", "type", "CPUs", "bogo ops/s", "bogo ops/J");
+	for (i = 0; i < hybrids_num; i++) {
+		const stress_hybrid_t *hybrid = &hybrids[i];
+		const char *munged = stress_munge_underscore(hybrid->ss->stressor->name);
+		bool heading = false;
+		int t;
+
+		for (t = 0; t < HYBRID_TYPES; t++) {
+			char opj[32];
+
+			if (!hybrid->run[t])
+				continue;
+			if (hybrid->ops_per_joule[t] >= 0.0)
+				(void)snprintf(opj, sizeof(opj), "%.2f", hybrid->ops_per_joule[t]);
+			else
+				(void)shim_strlcpy(opj, "-", sizeof(opj));
+			pr_metrics("%-13s %4s %5d %13.2f %13s\n", munged, hybrid_names[t],
+				CPU_COUNT(&hybrid_cpus[t]), hybrid->bogo_rate[t], opj);
+
+			if (!heading) {
+				pr_yaml(yaml, "    - stressor: %s\n", munged);
+				heading = true;
+			}
+			pr_yaml(yaml, "      %s-cores: %d\n", t == HYBRID_P ? "p" : "e",
+				CPU_COUNT(&hybrid_cpus[t]));
+			pr_yaml(yaml, "      %s-cores-bogo-ops-per-second: %f\n",
+				t == HYBRID_P ? "p" : "e", hybrid->bogo_rate[t]);
+			if (hybrid->ops_per_joule[t] >= 0.0)
+				pr_yaml(yaml, "      %s-cores-bogo-ops-per-joule: %f\n",
+					t == HYBRID_P ? "p" : "e", hybrid->ops_per_joule[t]);
+		}
+		if (hybrid->run[HYBRID_P] && hybrid->run[HYBRID_E] &&
+		    (hybrid->bogo_rate[HYBRID_P] > 0.0)) {
+			const double ratio = hybrid->bogo_rate[HYBRID_E] / hybrid->bogo_rate[HYBRID_P];
+
+			pr_metrics("%-13s E/P core throughput ratio %.3f\n", munged, ratio);
+			pr_yaml(yaml, "      e-to-p-cores-bogo-ops-ratio: %f\n", ratio);
+		}
+		if (heading)
+			pr_yaml(yaml, "\n");
+	}
+}
+
+/*
+ *  stress_hybrid_free()
+ *	free the core type results
+ */
+void stress_hybrid_free(void)
+{
+	free(hybrids);
+	hybrids = NULL;
+	hybrids_num = 0;
+	hybrid_steps_num = 0;
+}
+
+#else
+
+int stress_hybrid_setup(stress_stressor_t *stressors_list)
+{
+	int type = CORE_TYPE_NONE;
+
+	(void)stressors_list;
+	(void)stress_get_setting("core-type", &type);
+	if (type != CORE_TYPE_NONE)
+		pr_inf("core-type: CPU affinity not supported, ignoring --core-type\n");
+	return 0;
+}
+
+bool stress_hybrid_enabled(void)
+{
+	return false;
+}
+
+bool stress_hybrid_step_begin(void)
+{
+	return false;
+}
+
+void stress_hybrid_step_end(stress_stressor_t *stressors_list, const double duration)
+{
+	(void)stressors_list;
+	(void)duration;
+}
+
+void stress_hybrid_apply(const char *name)
+{
+	(void)name;
+}
+
+void stress_hybrid_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	(void)yaml;
+	(void)stressors_list;
+}
+
+void stress_hybrid_free(void)
+{
+}
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_HYBRID_H
+#define CORE_HYBRID_H
+
+/* hybrid CPU P-core and E-core runs */
+extern int stress_set_core_type(const char *opt);
+extern int stress_hybrid_setup(stress_stressor_t *stressors_list);
+extern bool stress_hybrid_enabled(void);
+extern bool stress_hybrid_step_begin(void);
+extern void stress_hybrid_step_end(stress_stressor_t *stressors_list, const double duration);
+extern void stress_hybrid_apply(const char *name);
+extern void stress_hybrid_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_hybrid_free(void);
+
+#endif
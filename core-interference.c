@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cpu-cache.h"
+#include "core-hybrid.h"
+#include "core-interference.h"
+#include "core-phase.h"
+#include "core-resctrl.h"
+#include "core-scaling.h"
+#include "core-search.h"
+#include "core-smt.h"
+
+/*
+ *  --interference runs each stressor as a single instance alone and
+ *  then each pair of stressors (including a stressor with itself)
+ *  concurrently, one instance each. The throughput of both stressors
+ *  of a pair relative to running alone gives the interference matrix,
+ *  rows are the stressor measured and columns the stressor it was
+ *  co-located with. The placement selects the CPUs of the pair.
+ */
+#define INTERFERENCE_ANY	(0)	/* no pinning, scheduler decides */
+#define INTERFERENCE_SAME	(1)	/* both on the same logical CPU */
+#define INTERFERENCE_SMT	(2)	/* SMT siblings of one core */
+#define INTERFERENCE_CORE	(3)	/* different cores of one package */
+#define INTERFERENCE_PACKAGE	(4)	/* different physical packages */
+
+typedef struct {
+	const char *name;
+	const int placement;
+	const char *description;
+} stress_interference_placement_t;
+
+static const stress_interference_placement_t interference_placements[] = {
+	{ "any",	INTERFERENCE_ANY,	"unpinned" },
+	{ "same",	INTERFERENCE_SAME,	"same logical CPU" },
+	{ "smt",	INTERFERENCE_SMT,	"SMT sibling CPUs" },
+	{ "core",	INTERFERENCE_CORE,	"different cores of a package" },
+	{ "package",	INTERFERENCE_PACKAGE,	"different packages" },
+};
+
+typedef struct {
+	stress_stressor_t *ss;		/* stressor */
+	double alone;			/* bogo ops/s per instance running alone */
+	double *paired;			/* bogo ops/s per instance with each partner */
+	bool *paired_run;		/* paired run completed */
+	bool alone_run;			/* alone run completed */
+} stress_interference_t;
+
+/*
+ *  stress_set_interference()
+ *	set the --interference placement
+ */
+int stress_set_interference(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(interference_placements); i++) {
+		if (!strcmp(opt, interference_placements[i].name))
+			return stress_set_setting_global("interference", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "interference option '%s' not known, options are:", opt);
+	for (i = 0; i < SIZEOF_ARRAY(interference_placements); i++)
+		(void)fprintf(stderr, " %s", interference_placements[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static stress_interference_t *interferences;
+static size_t interferences_num;
+static size_t interference_step;	/* current step */
+static size_t interference_steps_num;	/* alone runs + pairs */
+static const stress_interference_placement_t *interference_placement;
+static stress_stressor_t *interference_a;	/* first stressor of current step */
+static stress_stressor_t *interference_b;	/* second stressor, NULL if alone */
+static int32_t interference_cpu_a = -1;	/* CPU of the first stressor */
+static int32_t interference_cpu_b = -1;	/* CPU of the second stressor */
+
+#if defined(HAVE_SCHED_SETAFFINITY)
+/*
+ *  stress_interference_cpus()
+ *	find two CPUs in the CPU affinity mask that match
+ *	the placement
+ */
+static bool stress_interference_cpus(const int placement, int32_t *cpu_a, int32_t *cpu_b)
+{
+	stress_cpu_cache_cpus_t *cpus;
+	cpu_set_t set;
+	uint32_t i, j;
+	bool found = false;
+
+	if (placement == INTERFERENCE_ANY)
+		return true;
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		return false;
+	cpus = stress_cpu_cache_get_all_details();
+	if (!cpus)
+		return false;
+
+	for (i = 0; (i < cpus->count) && !found; i++) {
+		const stress_cpu_cache_cpu_t *a = &cpus->cpus[i];
+
+		if (!a->online || (a->num >= CPU_SETSIZE) ||
+		    !CPU_ISSET((int)a->num, &set))
+			continue;
+		if (placement == INTERFERENCE_SAME) {
+			*cpu_a = (int32_t)a->num;
+			*cpu_b = (int32_t)a->num;
+			found = true;
+			break;
+		}
+		if (a->core_id < 0)
+			continue;
+		for (j = i + 1; j < cpus->count; j++) {
+			const stress_cpu_cache_cpu_t *b = &cpus->cpus[j];
+			bool match;
+
+			if (!b->online || (b->num >= CPU_SETSIZE) ||
+			    !CPU_ISSET((int)b->num, &set) || (b->core_id < 0))
+				continue;
+			switch (placement) {
+			case INTERFERENCE_SMT:
+				match = (a->package_id == b->package_id) &&
+					(a->core_id == b->core_id);
+				break;
+			case INTERFERENCE_CORE:
+				match = (a->package_id == b->package_id) &&
+					(a->core_id != b->core_id);
+				break;
+			default:
+				match = (a->package_id != b->package_id);
+				break;
+			}
+			if (match) {
+				*cpu_a = (int32_t)a->num;
+				*cpu_b = (int32_t)b->num;
+				found = true;
+				break;
+			}
+		}
+	}
+	stress_free_cpu_caches(cpus);
+	return found;
+}
+#else
+static bool stress_interference_cpus(const int placement, int32_t *cpu_a, int32_t *cpu_b)
+{
+	(void)cpu_a;
+	(void)cpu_b;
+
+	return placement == INTERFERENCE_ANY;
+}
+#endif
+
+/*
+ *  stress_interference_setup()
+ *	check the --interference option, find the CPUs for the
+ *	placement and set up the interference matrix
+ */
+int stress_interference_setup(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t i, placement = SIZEOF_ARRAY(interference_placements);
+
+	(void)stress_get_setting("interference", &placement);
+	if (placement >= SIZEOF_ARRAY(interference_placements))
+		return 0;
+	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+		pr_err("interference: --interference cannot be used with --sequential\n");
+		return -1;
+	}
+	if (stress_phase_count()) {
+		pr_err("interference: --interference cannot be used with job file phases\n");
+		return -1;
+	}
+	if (stress_search_enabled()) {
+		pr_err("interference: --interference cannot be used with --search\n");
+		return -1;
+	}
+	if (stress_resctrl_sweep_enabled() || stress_hybrid_enabled() ||
+	    stress_smt_enabled() || stress_scaling_enabled()) {
+		pr_err("interference: --interference cannot be used with --resctrl-sweep, "
+			"--core-type, --smt-interference or --scaling\n");
+		return -1;
+	}
+	interference_placement = &interference_placements[placement];
+	if (!stress_interference_cpus(interference_placement->placement,
+				      &interference_cpu_a, &interference_cpu_b)) {
+		pr_inf("interference: no CPUs found for %s placement, ignoring --interference\n",
+			interference_placement->name);
+		interference_placement = NULL;
+		return 0;
+	}
+
+	for (interferences_num = 0, ss = stressors_list; ss; ss = ss->next) {
+		if (ss->num_instances > 0)
+			interferences_num++;
+	}
+	if (!interferences_num)
+		return 0;
+
+	interferences = calloc(interferences_num, sizeof(*interferences));
+	if (!interferences)
+		goto err;
+	for (i = 0, ss = stressors_list; ss; ss = ss->next) {
+		if (ss->num_instances <= 0)
+			continue;
+		interferences[i].ss = ss;
+		interferences[i].paired = calloc(interferences_num, sizeof(*interferences[i].paired));
+		interferences[i].paired_run = calloc(interferences_num, sizeof(*interferences[i].paired_run));
+		if (!interferences[i].paired || !interferences[i].paired_run)
+			goto err;
+		i++;
+		/* at most two instances, when paired with itself */
+		ss->num_instances = 2;
+	}
+	/* each stressor alone then each unordered pair */
+	interference_steps_num = interferences_num + ((interferences_num * (interferences_num + 1)) / 2);
+	if (interference_placement->placement != INTERFERENCE_ANY) {
+		pr_dbg("interference: %s placement, CPU %" PRId32 " and CPU %" PRId32 "\n",
+			interference_placement->name, interference_cpu_a, interference_cpu_b);
+	}
+	return 0;
+err:
+	pr_err("interference: cannot allocate interference matrix\n");
+	stress_interference_free();
+	return -1;
+}
+
+/*
+ *  stress_interference_enabled()
+ *	true if the interference matrix is being measured
+ */
+bool stress_interference_enabled(void)
+{
+	return interference_steps_num > 0;
+}
+
+/*
+ *  stress_interference_pair()
+ *	map a step to the indices of the stressors run, b is
+ *	-1 for the steps that run a stressor alone
+ */
+static void stress_interference_pair(const size_t step, size_t *a, ssize_t *b)
+{
+	size_t i, n;
+
+	if (step < interferences_num) {
+		*a = step;
+		*b = -1;
+		return;
+	}
+	n = step - interferences_num;
+	for (i = 0; i < interferences_num; i++) {
+		const size_t row = interferences_num - i;
+
+		if (n < row) {
+			*a = i;
+			*b = (ssize_t)(i + n);
+			return;
+		}
+		n -= row;
+	}
+	*a = 0;
+	*b = -1;
+}
+
+/*
+ *  stress_interference_step_begin()
+ *	set up the instances of the next alone run or pair,
+ *	returns false when all steps have been run
+ */
+bool stress_interference_step_begin(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t a;
+	ssize_t b;
+	char name_a[64];
+
+	if (interference_step >= interference_steps_num) {
+		interference_a = NULL;
+		interference_b = NULL;
+		return false;
+	}
+	stress_interference_pair(interference_step, &a, &b);
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		ss->num_instances = 0;
+	interference_a = interferences[a].ss;
+	interference_a->num_instances = 1;
+	interference_b = (b >= 0) ? interferences[b].ss : NULL;
+	if (interference_b)
+		interference_b->num_instances++;
+
+	(void)shim_strlcpy(name_a, stress_munge_underscore(interference_a->stressor->name), sizeof(name_a));
+	if (interference_b) {
+		pr_inf("interference: %s with %s (%s)\n", name_a,
+			stress_munge_underscore(interference_b->stressor->name),
+			interference_placement->description);
+	} else {
+		pr_inf("interference: %s alone\n", name_a);
+	}
+	return true;
+}
+
+/*
+ *  stress_interference_rate()
+ *	bogo ops per second of an instance of a stressor
+ */
+static double stress_interference_rate(const stress_stressor_t *ss, const int32_t instance)
+{
+	const stress_stats_t *stats;
+
+	if (ss->started_instances <= instance)
+		return 0.0;
+	stats = ss->stats[instance];
+	if (stats->window.end > stats->window.begin)
+		return (double)(stats->window.counter_end - stats->window.counter_begin) /
+			(stats->window.end - stats->window.begin);
+	if (stats->finish > stats->start)
+		return (double)stats->ci.counter / (stats->finish - stats->start);
+	return 0.0;
+}
+
+/*
+ *  stress_interference_step_end()
+ *	record the throughput of the stressors of the step,
+ *	both stressors of a pair are measured
+ */
+void stress_interference_step_end(void)
+{
+	size_t a;
+	ssize_t b;
+
+	stress_interference_pair(interference_step, &a, &b);
+	if (b < 0) {
+		interferences[a].alone = stress_interference_rate(interferences[a].ss, 0);
+		interferences[a].alone_run = true;
+	} else if ((size_t)b == a) {
+		/* paired with itself, mean of both instances */
+		interferences[a].paired[a] =
+			(stress_interference_rate(interferences[a].ss, 0) +
+			 stress_interference_rate(interferences[a].ss, 1)) / 2.0;
+		interferences[a].paired_run[a] = true;
+	} else {
+		interferences[a].paired[b] = stress_interference_rate(interferences[a].ss, 0);
+		interferences[a].paired_run[b] = true;
+		interferences[b].paired[a] = stress_interference_rate(interferences[b].ss, 0);
+		interferences[b].paired_run[a] = true;
+	}
+	interference_step++;
+}
+
+/*
+ *  stress_interference_apply()
+ *	pin the first stressor instance of the step to the first
+ *	CPU and the other instance to the second CPU
+ */
+void stress_interference_apply(const char *name, const stress_stressor_t *ss, const int32_t instance)
+{
+#if defined(HAVE_SCHED_SETAFFINITY)
+	cpu_set_t set;
+	int32_t cpu;
+
+	if (!interference_a || !interference_placement ||
+	    (interference_placement->placement == INTERFERENCE_ANY))
+		return;
+
+	cpu = ((ss == interference_a) && (instance == 0)) ? interference_cpu_a : interference_cpu_b;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("%s: cannot set interference CPU %" PRId32 " affinity, errno=%d (%s)\n",
+			name, cpu, errno, strerror(errno));
+	}
+#else
+	(void)name;
+	(void)ss;
+	(void)instance;
+#endif
+}
+
+/*
+ *  stress_interference_dump()
+ *	dump the throughput ratio matrix, each row is the stressor
+ *	measured and each column the stressor it ran with, a ratio
+ *	of 1.0 is no slowdown compared to running alone
+ */
+void stress_interference_dump(FILE *yaml)
+{
+	char line[1024];
+	size_t i, j, len;
+
+	if (!interferences)
+		return;
+
+	pr_metrics("interference throughput ratio vs alone, stressors (rows) "
+		"with co-located stressors (columns), %s:\n",
+		interference_placement->description);
+	len = (size_t)snprintf(line, sizeof(line), "%-13s %12s", "stressor", "alone ops/s");
+	for (j = 0; j < interferences_num && len < sizeof(line); j++)
+		len += (size_t)snprintf(line + len, sizeof(line) - len, " %10.10s",
+			stress_munge_underscore(interferences[j].ss->stressor->name));
+	pr_metrics("%s\n", line);
+
+	pr_yaml(yaml, "interference:\n");
+	pr_yaml(yaml, "      placement: %s\n", interference_placement->name);
+	if (interference_placement->placement != INTERFERENCE_ANY) {
+		pr_yaml(yaml, "      cpu-a: %" PRId32 "\n", interference_cpu_a);
+		pr_yaml(yaml, "      cpu-b: %" PRId32 "\n", interference_cpu_b);
+	}
+	pr_yaml(yaml, "      stressors:\n");
+
+	for (i = 0; i < interferences_num; i++) {
+		const stress_interference_t *interference = &interferences[i];
+		char munged[64];
+
+		if (!interference->alone_run)
+			continue;
+		(void)shim_strlcpy(munged, stress_munge_underscore(interference->ss->stressor->name), sizeof(munged));
+
+		len = (size_t)snprintf(line, sizeof(line), "%-13s %12.2f", munged, interference->alone);
+		pr_yaml(yaml, "        - stressor: %s\n", munged);
+		pr_yaml(yaml, "          alone-bogo-ops-per-second: %f\n", interference->alone);
+
+		for (j = 0; j < interferences_num && len < sizeof(line); j++) {
+			const char *partner = stress_munge_underscore(interferences[j].ss->stressor->name);
+			double ratio;
+
+			if (!interference->paired_run[j] || (interference->alone <= 0.0)) {
+				len += (size_t)snprintf(line + len, sizeof(line) - len, " %10s", "-");
+				continue;
+			}
+			ratio = interference->paired[j] / interference->alone;
+			len += (size_t)snprintf(line + len, sizeof(line) - len, " %10.3f", ratio);
+			pr_yaml(yaml, "          with-%s-bogo-ops-per-second: %f\n", partner, interference->paired[j]);
+			pr_yaml(yaml, "          with-%s-throughput-ratio: %f\n", partner, ratio);
+		}
+		pr_metrics("%s\n", line);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_interference_free()
+ *	free the interference matrix
+ */
+void stress_interference_free(void)
+{
+	size_t i;
+
+	if (interferences) {
+		for (i = 0; i < interferences_num; i++) {
+			free(interferences[i].paired);
+			free(interferences[i].paired_run);
+		}
+		free(interferences);
+	}
+	interferences = NULL;
+	interferences_num = 0;
+	interference_steps_num = 0;
+	interference_placement = NULL;
+}
@@ -0,0 +1,429 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-io-sweep.h"
+#include "core-latency.h"
+#include "core-uring.h"
+#include "io-uring.h"
+
+#define IO_SWEEP_MAX_DEPTH	(256)		/* deepest queue swept */
+#define IO_SWEEP_BUF_SIZE	(16 * MB)	/* shared I/O buffer pool size */
+#define IO_SWEEP_MIN_SECS	(0.1)		/* shortest time per point */
+#define IO_SWEEP_MAX_SECS	(5.0)		/* longest time per point */
+
+static const char * const io_sweep_patterns[] = {
+	"none",		/* STRESS_IO_SWEEP_NONE */
+	"seq-read",	/* STRESS_IO_SWEEP_SEQ_READ */
+	"seq-write",	/* STRESS_IO_SWEEP_SEQ_WRITE */
+	"rand-read",	/* STRESS_IO_SWEEP_RAND_READ */
+	"rand-write",	/* STRESS_IO_SWEEP_RAND_WRITE */
+};
+
+/*
+ *  stress_io_sweep_writes()
+ *	return true if the sweep pattern writes to the file or device
+ */
+bool stress_io_sweep_writes(const size_t pattern)
+{
+	return (pattern == STRESS_IO_SWEEP_SEQ_WRITE) ||
+	       (pattern == STRESS_IO_SWEEP_RAND_WRITE);
+}
+
+/*
+ *  stress_set_io_sweep()
+ *	set the sweep pattern setting, write patterns are
+ *	rejected if allow_write is false
+ */
+int stress_set_io_sweep(const char *setting, const char *opt, const bool allow_write)
+{
+	size_t i;
+
+	for (i = STRESS_IO_SWEEP_SEQ_READ; i < SIZEOF_ARRAY(io_sweep_patterns); i++) {
+		if (!strcmp(io_sweep_patterns[i], opt)) {
+			if (!allow_write && stress_io_sweep_writes(i))
+				break;
+			return stress_set_setting(setting, TYPE_ID_SIZE_T, &i);
+		}
+	}
+
+	(void)fprintf(stderr, "%s must be one of:", setting);
+	for (i = STRESS_IO_SWEEP_SEQ_READ; i < SIZEOF_ARRAY(io_sweep_patterns); i++) {
+		if (allow_write || !stress_io_sweep_writes(i))
+			(void)fprintf(stderr, " %s", io_sweep_patterns[i]);
+	}
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+#if defined(STRESS_URING) &&		\
+    defined(HAVE_IORING_OP_READ) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+
+static const size_t io_sweep_block_sizes[] = {
+	4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB
+};
+
+static const unsigned int io_sweep_depths[] = {
+	1, 4, 16, 64, IO_SWEEP_MAX_DEPTH
+};
+
+#define IO_SWEEP_POINTS	\
+	(SIZEOF_ARRAY(io_sweep_block_sizes) * SIZEOF_ARRAY(io_sweep_depths))
+
+/*
+ *  per block size and queue depth results
+ */
+typedef struct {
+	uint64_t ops;			/* completed I/Os */
+	uint64_t bytes;			/* bytes transferred */
+	double duration;		/* time spent at this point */
+	stress_latency_t latency;	/* submit to completion latencies */
+} stress_io_sweep_point_t;
+
+/*
+ *  stress_io_sweep_continue()
+ *	keep_stressing() without --rate pacing, the sweep
+ *	is paced by the queue depth
+ */
+static inline bool stress_io_sweep_continue(const stress_args_t *args)
+{
+	if (!keep_stressing_flag())
+		return false;
+	return !(args->max_ops && (get_counter(args) >= args->max_ops));
+}
+
+/*
+ *  stress_io_sweep_point()
+ *	keep qd I/Os of block size bs in flight for secs seconds,
+ *	I/O buffers are shared round robin between the slots
+ */
+static int stress_io_sweep_point(
+	const stress_args_t *args,
+	stress_uring_t *ring,
+	const int fd,
+	uint8_t *buf,
+	const uint64_t size,
+	const size_t pattern,
+	const size_t bs,
+	const unsigned int qd,
+	const double secs,
+	stress_io_sweep_point_t *point,
+	uint64_t *t_submit,
+	unsigned int *free_slots)
+{
+	const uint8_t opcode = stress_io_sweep_writes(pattern) ?
+		IORING_OP_WRITE : IORING_OP_READ;
+	const bool random = (pattern == STRESS_IO_SWEEP_RAND_READ) ||
+			    (pattern == STRESS_IO_SWEEP_RAND_WRITE);
+	const uint64_t blocks = size / bs;
+	const size_t n_bufs = IO_SWEEP_BUF_SIZE / bs;
+	const double t_start = stress_time_now();
+	const double t_end = t_start + secs;
+	uint64_t block = 0;
+	unsigned int i, n_free = qd, in_flight = 0, pending = 0;
+	bool running = true;
+	int rc = EXIT_SUCCESS;
+
+	for (i = 0; i < qd; i++)
+		free_slots[i] = i;
+
+	do {
+		unsigned tail = *ring->sq_tail;
+		unsigned head;
+		int ret;
+
+		while (running && n_free) {
+			const unsigned int slot = free_slots[--n_free];
+			const unsigned idx = tail & *ring->sq_mask;
+			struct io_uring_sqe *sqe = &ring->sqes[idx];
+			uint64_t offset;
+
+			if (random) {
+				offset = stress_mwc64modn(blocks) * bs;
+			} else {
+				offset = block * bs;
+				block = (block + 1 >= blocks) ? 0 : block + 1;
+			}
+			(void)memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = opcode;
+			sqe->fd = fd;
+			sqe->addr = (uintptr_t)(buf + ((slot % n_bufs) * bs));
+			sqe->len = (uint32_t)bs;
+			sqe->off = offset;
+			sqe->user_data = (uint64_t)slot;
+			ring->sq_array[idx] = idx;
+			tail++;
+			pending++;
+			in_flight++;
+			t_submit[slot] = stress_latency_now();
+		}
+		shim_mb();
+		*ring->sq_tail = tail;
+		shim_mb();
+
+		if (!in_flight)
+			break;
+		ret = stress_uring_enter(ring, pending, 1);
+		if (ret < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)) {
+				if (!keep_stressing_flag())
+					running = false;
+				continue;
+			}
+			pr_fail("%s: io_uring_enter failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		pending -= ((unsigned int)ret > pending) ? pending : (unsigned int)ret;
+
+		head = *ring->cq_head;
+		for (;;) {
+			const struct io_uring_cqe *cqe;
+			uint64_t now;
+			unsigned int slot;
+
+			shim_mb();
+			if (head == *ring->cq_tail)
+				break;
+			now = stress_latency_now();
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			slot = (unsigned int)cqe->user_data;
+			if (cqe->res < 0) {
+				if (rc == EXIT_SUCCESS)
+					pr_fail("%s: %zd byte %s failed, errno=%d (%s)\n",
+						args->name, bs,
+						(opcode == IORING_OP_WRITE) ? "write" : "read",
+						-cqe->res, strerror(-cqe->res));
+				rc = EXIT_FAILURE;
+				running = false;
+			} else {
+				point->ops++;
+				point->bytes += (uint64_t)cqe->res;
+				stress_latency_add(&point->latency, now - t_submit[slot]);
+				inc_counter(args);
+			}
+			if (slot < qd)
+				free_slots[n_free++] = slot;
+			in_flight--;
+			head++;
+		}
+		*ring->cq_head = head;
+		shim_mb();
+
+		if (running && ((stress_time_now() >= t_end) ||
+				!stress_io_sweep_continue(args)))
+			running = false;
+	} while (running || in_flight);
+
+	point->duration += stress_time_now() - t_start;
+
+	return rc;
+}
+
+/*
+ *  stress_io_sweep_size_str()
+ *	block size in K or M units
+ */
+static void stress_io_sweep_size_str(char *str, const size_t len, const size_t bs)
+{
+	if (bs >= MB)
+		(void)snprintf(str, len, "%zuM", bs / (size_t)MB);
+	else
+		(void)snprintf(str, len, "%zuK", bs / (size_t)KB);
+}
+
+/*
+ *  stress_io_sweep_report()
+ *	log the grid and report IOPS, bandwidth and p99 latency
+ *	of each block size and queue depth point as metrics
+ */
+static void stress_io_sweep_report(
+	const stress_args_t *args,
+	const size_t pattern,
+	const double secs,
+	stress_io_sweep_point_t *points)
+{
+	size_t i, j, idx = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %s sweep, %.2f seconds per point\n",
+			args->name, io_sweep_patterns[pattern], secs);
+		pr_inf("%s: block    qd       IOPS    MB/sec  mean lat ns   p99 lat ns\n",
+			args->name);
+	}
+
+	for (i = 0; i < SIZEOF_ARRAY(io_sweep_block_sizes); i++) {
+		char size_str[16];
+
+		stress_io_sweep_size_str(size_str, sizeof(size_str), io_sweep_block_sizes[i]);
+		for (j = 0; j < SIZEOF_ARRAY(io_sweep_depths); j++) {
+			const stress_io_sweep_point_t *point =
+				&points[(i * SIZEOF_ARRAY(io_sweep_depths)) + j];
+			const unsigned int qd = io_sweep_depths[j];
+			char str[64];
+			double iops, rate, mean;
+			uint64_t p99;
+
+			if ((point->duration <= 0.0) || (point->ops == 0))
+				continue;
+
+			iops = (double)point->ops / point->duration;
+			rate = ((double)point->bytes / point->duration) / (double)MB;
+			mean = (double)point->latency.total / (double)point->latency.count;
+			p99 = stress_latency_percentile(&point->latency, 99.0);
+
+			if (args->instance == 0)
+				pr_inf("%s: %5s %5u %10.0f %9.2f %12.0f %12" PRIu64 "\n",
+					args->name, size_str, qd, iops, rate, mean, p99);
+
+			(void)snprintf(str, sizeof(str), "%s qd %u IOPS", size_str, qd);
+			stress_metrics_set(args, idx++, str, iops);
+			(void)snprintf(str, sizeof(str), "%s qd %u MB per sec", size_str, qd);
+			stress_metrics_set(args, idx++, str, rate);
+			(void)snprintf(str, sizeof(str), "%s qd %u p99 latency (ns)", size_str, qd);
+			stress_metrics_set(args, idx++, str, (double)p99);
+		}
+	}
+
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_io_sweep()
+ *	sweep the block sizes and queue depths over the first size
+ *	bytes of fd with the given access pattern using io_uring,
+ *	each sweep point runs for a slice of the run time and the
+ *	sweep repeats, accumulating results, until the run ends
+ */
+int stress_io_sweep(
+	const stress_args_t *args,
+	const int fd,
+	const uint64_t size,
+	const size_t pattern)
+{
+	stress_uring_t ring;
+	stress_io_sweep_point_t *points;
+	uint64_t *t_submit;
+	unsigned int *free_slots;
+	uint8_t *buf;
+	double secs;
+	size_t i, j;
+	int rc;
+
+	if (size < STRESS_IO_SWEEP_MIN_SIZE) {
+		pr_inf_skip("%s: sweep size of %" PRIu64 " bytes too small, need at "
+			"least %d bytes, skipping stressor\n",
+			args->name, size, STRESS_IO_SWEEP_MIN_SIZE);
+		return EXIT_NO_RESOURCE;
+	}
+
+	secs = (double)g_opt_timeout / (double)IO_SWEEP_POINTS;
+	if (secs < IO_SWEEP_MIN_SECS)
+		secs = IO_SWEEP_MIN_SECS;
+	if (secs > IO_SWEEP_MAX_SECS)
+		secs = IO_SWEEP_MAX_SECS;
+
+	points = calloc(IO_SWEEP_POINTS, sizeof(*points));
+	if (!points) {
+		pr_inf_skip("%s: cannot allocate sweep results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < IO_SWEEP_POINTS; i++)
+		stress_latency_reset(&points[i].latency);
+
+	t_submit = calloc(IO_SWEEP_MAX_DEPTH, sizeof(*t_submit));
+	free_slots = calloc(IO_SWEEP_MAX_DEPTH, sizeof(*free_slots));
+	if (!t_submit || !free_slots) {
+		pr_inf_skip("%s: cannot allocate sweep slots, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_slots;
+	}
+
+	buf = mmap(NULL, IO_SWEEP_BUF_SIZE, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %" PRIu64 " byte sweep buffer, "
+			"skipping stressor\n", args->name, (uint64_t)IO_SWEEP_BUF_SIZE);
+		rc = EXIT_NO_RESOURCE;
+		goto free_slots;
+	}
+	if (stress_io_sweep_writes(pattern)) {
+		uint32_t *ptr = (uint32_t *)buf;
+		const uint32_t *end = (uint32_t *)(buf + IO_SWEEP_BUF_SIZE);
+
+		while (ptr < end)
+			*ptr++ = stress_mwc32();
+	}
+
+	rc = stress_uring_setup(args, &ring, IO_SWEEP_MAX_DEPTH);
+	if (rc != EXIT_SUCCESS)
+		goto unmap_buf;
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(io_sweep_block_sizes); i++) {
+			for (j = 0; j < SIZEOF_ARRAY(io_sweep_depths); j++) {
+				stress_io_sweep_point_t *point =
+					&points[(i * SIZEOF_ARRAY(io_sweep_depths)) + j];
+
+				rc = stress_io_sweep_point(args, &ring, fd, buf, size,
+					pattern, io_sweep_block_sizes[i], io_sweep_depths[j],
+					secs, point, t_submit, free_slots);
+				if (rc != EXIT_SUCCESS)
+					goto close_ring;
+				if (!stress_io_sweep_continue(args))
+					goto close_ring;
+			}
+		}
+	} while (stress_io_sweep_continue(args));
+
+close_ring:
+	stress_uring_close(&ring);
+	if (rc == EXIT_SUCCESS)
+		stress_io_sweep_report(args, pattern, secs, points);
+unmap_buf:
+	(void)munmap((void *)buf, IO_SWEEP_BUF_SIZE);
+free_slots:
+	free(free_slots);
+	free(t_submit);
+	free(points);
+
+	return rc;
+}
+#else
+int stress_io_sweep(
+	const stress_args_t *args,
+	const int fd,
+	const uint64_t size,
+	const size_t pattern)
+{
+	(void)fd;
+	(void)size;
+	(void)pattern;
+
+	pr_inf_skip("%s: io_uring sweep is not supported on this system, "
+		"skipping stressor\n", args->name);
+	return EXIT_NOT_IMPLEMENTED;
+}
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_IO_SWEEP_H
+#define CORE_IO_SWEEP_H
+
+#define STRESS_IO_SWEEP_NONE		(0)
+#define STRESS_IO_SWEEP_SEQ_READ	(1)
+#define STRESS_IO_SWEEP_SEQ_WRITE	(2)
+#define STRESS_IO_SWEEP_RAND_READ	(3)
+#define STRESS_IO_SWEEP_RAND_WRITE	(4)
+
+#define STRESS_IO_SWEEP_MIN_SIZE	(1024 * 1024)	/* largest block size */
+
+extern int stress_set_io_sweep(const char *setting, const char *opt,
+	const bool allow_write);
+extern bool stress_io_sweep_writes(const size_t pattern);
+extern int stress_io_sweep(const stress_args_t *args, const int fd,
+	const uint64_t size, const size_t pattern);
+
+#endif
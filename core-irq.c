@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-irq.h"
+
+#define IRQ_PLACEMENT_NONE	(0)
+#define IRQ_PLACEMENT_NEAR	(1)	/* run on the device IRQ CPUs */
+#define IRQ_PLACEMENT_FAR	(2)	/* run away from the device IRQ CPUs */
+
+/* default /proc/interrupts action name patterns of NIC and storage devices */
+static const char irq_dev_default[] = "nvme,ahci,eth,enp,ens,eno,mlx,ixgbe,i40e,virtio";
+
+typedef struct {
+	const char *name;	/* irq placement name */
+	const int placement;	/* irq placement */
+} stress_irq_placement_t;
+
+static const stress_irq_placement_t irq_placements[] = {
+	{ "near",	IRQ_PLACEMENT_NEAR },
+	{ "far",	IRQ_PLACEMENT_FAR },
+};
+
+/*
+ *  stress_set_irq_placement()
+ *	set --irq-placement near or far
+ */
+int stress_set_irq_placement(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(irq_placements); i++) {
+		if (!strcmp(opt, irq_placements[i].name)) {
+			int placement = irq_placements[i].placement;
+
+			return stress_set_setting_global("irq-placement", TYPE_ID_INT, &placement);
+		}
+	}
+
+	(void)fprintf(stderr, "irq-placement must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(irq_placements); i++)
+		(void)fprintf(stderr, " %s", irq_placements[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_set_irq_dev()
+ *	set --irq-dev comma separated list of IRQ action name patterns
+ */
+int stress_set_irq_dev(const char *opt)
+{
+	if (!*opt || (*opt == ',')) {
+		(void)fprintf(stderr, "irq-dev must be a comma separated list of "
+			"device names, e.g. nvme,eth0\n");
+		return -1;
+	}
+	return stress_set_setting_global("irq-dev", TYPE_ID_STR, (void *)opt);
+}
+
+#if defined(__linux__) &&		\
+    defined(HAVE_SCHED_SETAFFINITY)
+
+/* softirqs that network and block devices raise */
+static const char * const irq_softirqs[] = {
+	"NET_RX",
+	"NET_TX",
+	"BLOCK",
+};
+
+typedef struct {
+	uint64_t softirq_ticks;		/* /proc/stat softirq time */
+	uint64_t softirqs[SIZEOF_ARRAY(irq_softirqs)];	/* /proc/softirqs counts */
+} stress_irq_cpu_stat_t;
+
+static int irq_placement = IRQ_PLACEMENT_NONE;
+static cpu_set_t irq_cpus;		/* CPUs the device IRQs are steered to */
+static cpu_set_t irq_run_cpus;		/* CPUs network and I/O stressors run on */
+static int32_t irq_max_cpus;
+static size_t irq_count;		/* number of matching device IRQs */
+static char irq_names[256];		/* matching IRQ action names */
+static stress_irq_cpu_stat_t *irq_stat_begin;
+static stress_irq_cpu_stat_t *irq_stat_end;
+
+/*
+ *  stress_irq_cpulist()
+ *	parse a cpu list, e.g. 0-3,8,10-11 and add the cpus to set
+ */
+static void stress_irq_cpulist(char *str, cpu_set_t *set)
+{
+	char *ptr, *token;
+
+	for (ptr = str; (token = strtok(ptr, ",\n")) != NULL; ptr = NULL) {
+		int lo, hi, i;
+
+		if (sscanf(token, "%d-%d", &lo, &hi) != 2) {
+			if (sscanf(token, "%d", &lo) != 1)
+				continue;
+			hi = lo;
+		}
+		for (i = STRESS_MAXIMUM(lo, 0); (i <= hi) && (i < CPU_SETSIZE); i++)
+			CPU_SET(i, set);
+	}
+}
+
+/*
+ *  stress_irq_cpus_str()
+ *	turn a cpu set into a cpu list string
+ */
+static void stress_irq_cpus_str(const cpu_set_t *set, char *str, const size_t len)
+{
+	int i;
+	size_t n = 0;
+
+	*str = '\0';
+	for (i = 0; (i < CPU_SETSIZE) && (n < len); i++) {
+		int j;
+
+		if (!CPU_ISSET(i, set))
+			continue;
+		for (j = i; (j + 1 < CPU_SETSIZE) && CPU_ISSET(j + 1, set); j++)
+			;
+		if (j > i)
+			n += (size_t)snprintf(str + n, len - n, "%s%d-%d", n ? "," : "", i, j);
+		else
+			n += (size_t)snprintf(str + n, len - n, "%s%d", n ? "," : "", i);
+		i = j;
+	}
+}
+
+/*
+ *  stress_irq_dev_match()
+ *	does an IRQ action name match any of the comma separated
+ *	device name patterns
+ */
+static bool stress_irq_dev_match(const char *action, const char *devs)
+{
+	const char *ptr = devs;
+
+	while (*ptr) {
+		const char *end = strchr(ptr, ',');
+		const size_t len = end ? (size_t)(end - ptr) : strlen(ptr);
+		const char *a;
+
+		for (a = action; len && *a; a++) {
+			if (!strncmp(a, ptr, len))
+				return true;
+		}
+		if (!end)
+			break;
+		ptr = end + 1;
+	}
+	return false;
+}
+
+/*
+ *  stress_irq_find()
+ *	find the device IRQs in /proc/interrupts that match the
+ *	device name patterns and the CPUs they are steered to
+ */
+static void stress_irq_find(const char *devs)
+{
+	FILE *fp;
+	char buf[4096];
+
+	fp = fopen("/proc/interrupts", "r");
+	if (!fp)
+		return;
+	while (fgets(buf, sizeof(buf), fp)) {
+		char path[PATH_MAX], list[4096], *action;
+		unsigned int irq;
+		size_t len;
+
+		if (sscanf(buf, " %u:", &irq) != 1)
+			continue;	/* header, NMI, LOC etc */
+		len = strlen(buf);
+		while (len && isspace((unsigned char)buf[len - 1]))
+			buf[--len] = '\0';
+		/* the action name is the last field */
+		action = strrchr(buf, ' ');
+		action = action ? action + 1 : buf;
+		if (!stress_irq_dev_match(action, devs))
+			continue;
+
+		/* prefer the CPUs the IRQ is actually delivered to */
+		(void)snprintf(path, sizeof(path), "/proc/irq/%u/effective_affinity_list", irq);
+		if (system_read(path, list, sizeof(list)) <= 0) {
+			(void)snprintf(path, sizeof(path), "/proc/irq/%u/smp_affinity_list", irq);
+			if (system_read(path, list, sizeof(list)) <= 0)
+				continue;
+		}
+		stress_irq_cpulist(list, &irq_cpus);
+
+		len = strlen(irq_names);
+		if (len + strlen(action) + 8 < sizeof(irq_names)) {
+			(void)snprintf(irq_names + len, sizeof(irq_names) - len,
+				"%s%s", len ? " " : "", action);
+		} else if (!strstr(irq_names, "...")) {
+			(void)shim_strlcat(irq_names, " ...", sizeof(irq_names));
+		}
+		irq_count++;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_irq_stat()
+ *	read the per CPU softirq time from /proc/stat and the
+ *	per CPU NET_RX, NET_TX and BLOCK softirq counts from
+ *	/proc/softirqs
+ */
+static void stress_irq_stat(stress_irq_cpu_stat_t *stat)
+{
+	FILE *fp;
+	char buf[8192];
+	int32_t *column_cpu;
+	size_t columns = 0;
+
+	(void)memset(stat, 0, sizeof(*stat) * (size_t)irq_max_cpus);
+
+	fp = fopen("/proc/stat", "r");
+	if (fp) {
+		while (fgets(buf, sizeof(buf), fp)) {
+			int cpu;
+			uint64_t softirq;
+
+			if (sscanf(buf, "cpu%d %*u %*u %*u %*u %*u %*u %" SCNu64,
+				   &cpu, &softirq) != 2)
+				continue;
+			if ((cpu >= 0) && (cpu < irq_max_cpus))
+				stat[cpu].softirq_ticks = softirq;
+		}
+		(void)fclose(fp);
+	}
+
+	column_cpu = calloc((size_t)irq_max_cpus, sizeof(*column_cpu));
+	if (!column_cpu)
+		return;
+	fp = fopen("/proc/softirqs", "r");
+	if (!fp) {
+		free(column_cpu);
+		return;
+	}
+	/* header maps columns to cpus, e.g. CPU0 CPU1 CPU2 */
+	if (fgets(buf, sizeof(buf), fp)) {
+		char *ptr = buf;
+		int cpu, n;
+
+		while ((columns < (size_t)irq_max_cpus) &&
+		       (sscanf(ptr, " CPU%d%n", &cpu, &n) == 1)) {
+			column_cpu[columns++] = cpu;
+			ptr += n;
+		}
+	}
+	while (fgets(buf, sizeof(buf), fp)) {
+		char name[32], *ptr;
+		size_t i, col;
+		int n;
+
+		if (sscanf(buf, " %31[^:]:%n", name, &n) != 1)
+			continue;
+		for (i = 0; i < SIZEOF_ARRAY(irq_softirqs); i++) {
+			if (!strcmp(name, irq_softirqs[i]))
+				break;
+		}
+		if (i == SIZEOF_ARRAY(irq_softirqs))
+			continue;
+		ptr = buf + n;
+		for (col = 0; col < columns; col++) {
+			uint64_t count;
+			int m;
+
+			if (sscanf(ptr, " %" SCNu64 "%n", &count, &m) != 1)
+				break;
+			ptr += m;
+			if ((column_cpu[col] >= 0) && (column_cpu[col] < irq_max_cpus))
+				stat[column_cpu[col]].softirqs[i] = count;
+		}
+	}
+	(void)fclose(fp);
+	free(column_cpu);
+}
+
+/*
+ *  stress_irq_init()
+ *	find the device IRQ CPUs and the CPUs network and I/O
+ *	stressors are placed on, then take the softirq baseline
+ */
+void stress_irq_init(void)
+{
+	const char *devs = irq_dev_default;
+	cpu_set_t set;
+	char cpus_str[256], run_str[256];
+	int i;
+
+	(void)stress_get_setting("irq-placement", &irq_placement);
+	if (irq_placement == IRQ_PLACEMENT_NONE)
+		return;
+	(void)stress_get_setting("irq-dev", &devs);
+
+	irq_max_cpus = STRESS_MINIMUM(stress_get_processors_configured(), CPU_SETSIZE);
+	if ((irq_max_cpus < 1) || (sched_getaffinity(0, sizeof(set), &set) < 0)) {
+		pr_inf("irq: cannot determine CPU affinity, disabling --irq-placement\n");
+		goto disable;
+	}
+
+	CPU_ZERO(&irq_cpus);
+	CPU_ZERO(&irq_run_cpus);
+	*irq_names = '\0';
+	irq_count = 0;
+	stress_irq_find(devs);
+	if (!irq_count) {
+		pr_inf("irq: no IRQs in /proc/interrupts match '%s', disabling --irq-placement\n", devs);
+		goto disable;
+	}
+
+	for (i = 0; i < irq_max_cpus; i++) {
+		const bool is_irq_cpu = CPU_ISSET(i, &irq_cpus);
+
+		if (!CPU_ISSET(i, &set))
+			continue;
+		if ((irq_placement == IRQ_PLACEMENT_NEAR) == is_irq_cpu)
+			CPU_SET(i, &irq_run_cpus);
+	}
+	stress_irq_cpus_str(&irq_cpus, cpus_str, sizeof(cpus_str));
+	if (CPU_COUNT(&irq_run_cpus) == 0) {
+		pr_inf("irq: no CPUs %s the IRQ CPUs %s in the CPU affinity mask, "
+			"disabling --irq-placement\n",
+			irq_placement == IRQ_PLACEMENT_NEAR ? "on" : "away from",
+			cpus_str);
+		goto disable;
+	}
+	stress_irq_cpus_str(&irq_run_cpus, run_str, sizeof(run_str));
+	pr_inf("irq: %zu device IRQ%s (%s) on CPUs %s, network and I/O "
+		"stressors placed %s on CPUs %s\n",
+		irq_count, irq_count == 1 ? "" : "s", irq_names, cpus_str,
+		irq_placement == IRQ_PLACEMENT_NEAR ? "near" : "far", run_str);
+
+	irq_stat_begin = calloc((size_t)irq_max_cpus, sizeof(*irq_stat_begin));
+	irq_stat_end = calloc((size_t)irq_max_cpus, sizeof(*irq_stat_end));
+	if (irq_stat_begin && irq_stat_end) {
+		stress_irq_stat(irq_stat_begin);
+	} else {
+		free(irq_stat_begin);
+		free(irq_stat_end);
+		irq_stat_begin = NULL;
+		irq_stat_end = NULL;
+	}
+	return;
+
+disable:
+	irq_placement = IRQ_PLACEMENT_NONE;
+}
+
+/*
+ *  stress_irq_apply()
+ *	place network and I/O stressor instances on or away
+ *	from the device IRQ CPUs
+ */
+void stress_irq_apply(const char *name, const stress_stressor_t *ss)
+{
+	cpu_set_t set;
+
+	if (irq_placement == IRQ_PLACEMENT_NONE)
+		return;
+	if (!(ss->stressor->info->class & (CLASS_NETWORK | CLASS_IO)))
+		return;
+
+	/* keep any --placement CPU if it is suitable */
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		CPU_ZERO(&set);
+	CPU_AND(&set, &set, &irq_run_cpus);
+	if (CPU_COUNT(&set) == 0)
+		set = irq_run_cpus;
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("%s: cannot set IRQ placement CPU affinity, errno=%d (%s)\n",
+			name, errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_irq_dump()
+ *	report softirq time and NET_RX, NET_TX and BLOCK softirqs
+ *	on the IRQ CPUs and the other CPUs during the run
+ */
+void stress_irq_dump(FILE *yaml)
+{
+	static const char * const groups[] = { "irq-cpus", "other-cpus" };
+	const double ticks_per_sec = (double)stress_get_ticks_per_second();
+	double softirq_secs[2] = { 0.0, 0.0 };
+	uint64_t softirqs[2][SIZEOF_ARRAY(irq_softirqs)];
+	size_t g, i;
+	int cpu;
+
+	if ((irq_placement == IRQ_PLACEMENT_NONE) || !irq_stat_begin || (ticks_per_sec <= 0.0))
+		return;
+
+	stress_irq_stat(irq_stat_end);
+	(void)memset(softirqs, 0, sizeof(softirqs));
+	for (cpu = 0; cpu < irq_max_cpus; cpu++) {
+		const stress_irq_cpu_stat_t *b = &irq_stat_begin[cpu];
+		const stress_irq_cpu_stat_t *e = &irq_stat_end[cpu];
+
+		g = CPU_ISSET(cpu, &irq_cpus) ? 0 : 1;
+		if (e->softirq_ticks >= b->softirq_ticks)
+			softirq_secs[g] += (double)(e->softirq_ticks - b->softirq_ticks) / ticks_per_sec;
+		for (i = 0; i < SIZEOF_ARRAY(irq_softirqs); i++) {
+			if (e->softirqs[i] >= b->softirqs[i])
+				softirqs[g][i] += e->softirqs[i] - b->softirqs[i];
+		}
+	}
+
+	pr_inf("irq: placement %s, softirq activity during the run:\n",
+		irq_placement == IRQ_PLACEMENT_NEAR ? "near" : "far");
+	pr_inf("irq: %-10s %10s %12s %12s %12s\n",
+		"CPUs", "softirq(s)", irq_softirqs[0], irq_softirqs[1], irq_softirqs[2]);
+	pr_yaml(yaml, "irq-placement:\n");
+	pr_yaml(yaml, "    placement: %s\n",
+		irq_placement == IRQ_PLACEMENT_NEAR ? "near" : "far");
+	pr_yaml(yaml, "    irqs: %zu\n", irq_count);
+	pr_yaml(yaml, "    softirqs:\n");
+	for (g = 0; g < SIZEOF_ARRAY(groups); g++) {
+		pr_inf("irq: %-10s %10.2f %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+			groups[g], softirq_secs[g],
+			softirqs[g][0], softirqs[g][1], softirqs[g][2]);
+		pr_yaml(yaml, "      - cpus: %s\n", groups[g]);
+		pr_yaml(yaml, "        softirq-secs: %.2f\n", softirq_secs[g]);
+		for (i = 0; i < SIZEOF_ARRAY(irq_softirqs); i++)
+			pr_yaml(yaml, "        %s: %" PRIu64 "\n", irq_softirqs[i], softirqs[g][i]);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_irq_free()
+ *	free IRQ placement data
+ */
+void stress_irq_free(void)
+{
+	free(irq_stat_begin);
+	free(irq_stat_end);
+	irq_stat_begin = NULL;
+	irq_stat_end = NULL;
+	irq_placement = IRQ_PLACEMENT_NONE;
+}
+
+#else
+void stress_irq_init(void)
+{
+	int placement = IRQ_PLACEMENT_NONE;
+
+	(void)stress_get_setting("irq-placement", &placement);
+	if (placement != IRQ_PLACEMENT_NONE)
+		pr_inf("irq: IRQ affinity is not supported, ignoring --irq-placement\n");
+}
+
+void stress_irq_apply(const char *name, const stress_stressor_t *ss)
+{
+	(void)name;
+	(void)ss;
+}
+
+void stress_irq_dump(FILE *yaml)
+{
+	(void)yaml;
+}
+
+void stress_irq_free(void)
+{
+}
+#endif
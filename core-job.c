@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-phase.h"
 
 #define MAX_ARGS	(64)
 #define RUN_SEQUENTIAL	(0x01)
@@ -80,6 +81,71 @@ err:
 	return -1;
 }
 
+/*
+ *  stress_parse_phase()
+ *	parse the special job file "phase" command that
+ *	starts a new phase of the run and the "ramp" command
+ *	that ramps the instances of a stressor over a phase
+ */
+static int stress_parse_phase(
+	const char *jobfile,
+	int argc,
+	char **argv)
+{
+	char opt[128], *opt_argv[4];
+	int32_t from, to;
+
+	if (argc < 2)
+		return 0;
+
+	if (!strcmp(argv[1], "phase")) {
+		if ((argc < 3) || (argc > 4)) {
+			(void)fprintf(stderr, "phase requires a duration and an "
+				"optional name in jobfile %s\n", jobfile);
+			return -1;
+		}
+		return (stress_phase_new(stress_get_uint64_time(argv[2]),
+			argc == 4 ? argv[3] : NULL) < 0) ? -1 : 1;
+	}
+	if (strcmp(argv[1], "ramp"))
+		return 0;
+
+	if (argc != 5) {
+		(void)fprintf(stderr, "ramp requires a stressor and the start "
+			"and end number of instances in jobfile %s\n", jobfile);
+		return -1;
+	}
+	if (!stress_phase_count()) {
+		(void)fprintf(stderr, "ramp can only be used in a phase in jobfile %s\n",
+			jobfile);
+		return -1;
+	}
+	from = stress_get_int32(argv[3]);
+	to = stress_get_int32(argv[4]);
+	if ((from < 0) || (to < 0)) {
+		(void)fprintf(stderr, "ramp instances must be 0 or more in jobfile %s\n",
+			jobfile);
+		return -1;
+	}
+
+	/* enable the stressor with the largest number of instances */
+	(void)snprintf(opt, sizeof(opt), "--%s", argv[2]);
+	opt_argv[0] = argv[0];
+	opt_argv[1] = opt;
+	opt_argv[2] = (from > to) ? argv[3] : argv[4];
+	opt_argv[3] = NULL;
+	g_stressor_current = NULL;
+	if (stress_parse_opts(3, opt_argv, true) != EXIT_SUCCESS)
+		return -1;
+	if (!g_stressor_current ||
+	    strcmp(argv[2], stress_munge_underscore(g_stressor_current->stressor->name))) {
+		(void)fprintf(stderr, "ramp %s is not a stressor in jobfile %s\n",
+			argv[2], jobfile);
+		return -1;
+	}
+	return (stress_phase_add(g_stressor_current->stressor, from, to) < 0) ? -1 : 1;
+}
+
 /*
  *  stress_parse_error()
  *	generic job error message
@@ -194,6 +260,16 @@ int stress_parse_jobfile(
 				continue;
 			}
 
+			/* Check for job phase and ramp options */
+			rc = stress_parse_phase(jobfile, new_argc, new_argv);
+			if (rc < 0) {
+				ret = -1;
+				stress_parse_error(lineno, txt);
+				goto err;
+			} else if (rc == 1) {
+				continue;
+			}
+
 			tmp = malloc(len);
 			if (!tmp) {
 				(void)fprintf(stderr, "Out of memory parsing '%s'\n", jobfile);
@@ -209,6 +285,18 @@ int stress_parse_jobfile(
 				free(tmp);
 				goto err;
 			}
+
+			/* stressor instances given in a phase only run in that phase */
+			if (stress_phase_count() && g_stressor_current &&
+			    !strcmp(new_argv[1] + 2, stress_munge_underscore(g_stressor_current->stressor->name)) &&
+			    (stress_phase_add(g_stressor_current->stressor,
+					      g_stressor_current->num_instances,
+					      g_stressor_current->num_instances) < 0)) {
+				stress_parse_error(lineno, txt);
+				ret = -1;
+				free(tmp);
+				goto err;
+			}
 			free(tmp);
 			new_argv[1] = NULL;
 		}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+
+/*
+ *  stress_latency_reset()
+ *	clear a latency histogram
+ */
+void stress_latency_reset(stress_latency_t *latency)
+{
+	if (!latency)
+		return;
+
+	(void)memset(latency, 0, sizeof(*latency));
+	latency->min = UINT64_MAX;
+}
+
+/*
+ *  stress_latency_merge()
+ *	accumulate histogram src into histogram dst
+ */
+void stress_latency_merge(stress_latency_t *dst, const stress_latency_t *src)
+{
+	size_t i;
+
+	if (!src->count)
+		return;
+
+	for (i = 0; i < STRESS_LATENCY_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+	dst->count += src->count;
+	dst->total += src->total;
+	if (dst->min > src->min)
+		dst->min = src->min;
+	if (dst->max < src->max)
+		dst->max = src->max;
+}
+
+/*
+ *  stress_latency_bucket_max()
+ *	upper bound in nanoseconds of the values held in bucket idx
+ */
+uint64_t stress_latency_bucket_max(const size_t idx)
+{
+	unsigned int shift;
+	uint64_t sub;
+
+	if (idx < STRESS_LATENCY_SUB_BUCKETS)
+		return (uint64_t)idx;
+
+	shift = (unsigned int)(idx >> STRESS_LATENCY_SUB_SHIFT) - 1;
+	sub = (uint64_t)(idx & (STRESS_LATENCY_SUB_BUCKETS - 1));
+
+	return ((STRESS_LATENCY_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/*
+ *  stress_latency_percentile()
+ *	return the latency in nanoseconds that percentile (0..100)
+ *	of the samples are less than or equal to, 0 if no samples
+ */
+uint64_t stress_latency_percentile(
+	const stress_latency_t *latency,
+	const double percentile)
+{
+	uint64_t threshold, sum = 0;
+	size_t i;
+
+	if (!latency->count)
+		return 0;
+
+	threshold = (uint64_t)(((double)latency->count * percentile) / 100.0);
+	if (threshold < 1)
+		threshold = 1;
+
+	for (i = 0; i < STRESS_LATENCY_BUCKETS; i++) {
+		sum += latency->bucket[i];
+		if (sum >= threshold) {
+			const uint64_t nsec = stress_latency_bucket_max(i);
+
+			/* bucket bounds are coarse, clamp to observed range */
+			if (nsec > latency->max)
+				return latency->max;
+			if (nsec < latency->min)
+				return latency->min;
+			return nsec;
+		}
+	}
+	return latency->max;
+}
+
+/*
+ *  stress_latency_sum()
+ *	merge the histograms of all the instances of a stressor,
+ *	returns false if there are no samples
+ */
+static bool stress_latency_sum(const stress_stressor_t *ss, stress_latency_t *latency)
+{
+	int32_t j;
+
+	stress_latency_reset(latency);
+	if (!ss->stats)
+		return false;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		if (stats->latency)
+			stress_latency_merge(latency, stats->latency);
+	}
+	return latency->count > 0;
+}
+
+/*
+ *  stress_latency_yaml()
+ *	add latency statistics of a stressor to the yaml metrics section
+ */
+void stress_latency_yaml(FILE *yaml, const stress_stressor_t *ss)
+{
+	static stress_latency_t latency;
+
+	if (!(g_opt_flags & OPT_FLAGS_LATENCY_HIST))
+		return;
+	if (!stress_latency_sum(ss, &latency))
+		return;
+
+	pr_yaml(yaml, "      latency-samples: %" PRIu64 "\n", latency.count);
+	pr_yaml(yaml, "      latency-min-nsec: %" PRIu64 "\n", latency.min);
+	pr_yaml(yaml, "      latency-mean-nsec: %" PRIu64 "\n", latency.total / latency.count);
+	pr_yaml(yaml, "      latency-p50-nsec: %" PRIu64 "\n", stress_latency_percentile(&latency, 50.0));
+	pr_yaml(yaml, "      latency-p90-nsec: %" PRIu64 "\n", stress_latency_percentile(&latency, 90.0));
+	pr_yaml(yaml, "      latency-p99-nsec: %" PRIu64 "\n", stress_latency_percentile(&latency, 99.0));
+	pr_yaml(yaml, "      latency-p99.9-nsec: %" PRIu64 "\n", stress_latency_percentile(&latency, 99.9));
+	pr_yaml(yaml, "      latency-max-nsec: %" PRIu64 "\n", latency.max);
+}
+
+/*
+ *  stress_latency_dump()
+ *	dump latency percentiles of all stressors that collected samples
+ */
+void stress_latency_dump(stress_stressor_t *stressors_list)
+{
+	static stress_latency_t latency;
+	stress_stressor_t *ss;
+	bool header = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_LATENCY_HIST))
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		if (!stress_latency_sum(ss, &latency))
+			continue;
+
+		if (!header) {
+			pr_metrics("latency (nanosecs):\n");
+			pr_metrics("%-13s %12s %10s %10s %10s %10s %10s %10s %12s\n",
+				"stressor", "samples", "min", "mean", "p50",
+				"p90", "p99", "p99.9", "max");
+			header = true;
+		}
+		pr_metrics("%-13s %12" PRIu64 " %10" PRIu64 " %10" PRIu64
+			" %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+			" %12" PRIu64 "\n",
+			stress_munge_underscore(ss->stressor->name),
+			latency.count, latency.min,
+			latency.total / latency.count,
+			stress_latency_percentile(&latency, 50.0),
+			stress_latency_percentile(&latency, 90.0),
+			stress_latency_percentile(&latency, 99.0),
+			stress_latency_percentile(&latency, 99.9),
+			latency.max);
+	}
+}
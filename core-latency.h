@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_LATENCY_H
+#define CORE_LATENCY_H
+
+#include "core-clocksource.h"
+
+/*
+ *  stress_latency_msb()
+ *	return index of most significant set bit, nsec must be non-zero
+ */
+static inline unsigned int ALWAYS_INLINE stress_latency_msb(const uint64_t nsec)
+{
+#if defined(HAVE_BUILTIN_CLZL)
+	if (sizeof(unsigned long int) == sizeof(uint64_t))
+		return 63 - (unsigned int)__builtin_clzl((unsigned long int)nsec);
+#endif
+	{
+		register unsigned int msb = 0;
+		register uint64_t n = nsec;
+
+		while (n >>= 1)
+			msb++;
+		return msb;
+	}
+}
+
+/*
+ *  stress_latency_index()
+ *	map a latency in nanoseconds to a histogram bucket index
+ */
+static inline size_t ALWAYS_INLINE stress_latency_index(const uint64_t nsec)
+{
+	register unsigned int msb;
+
+	if (nsec < STRESS_LATENCY_SUB_BUCKETS)
+		return (size_t)nsec;
+
+	msb = stress_latency_msb(nsec);
+	if (UNLIKELY(msb >= STRESS_LATENCY_MAX_SHIFT))
+		return STRESS_LATENCY_BUCKETS - 1;
+
+	return ((size_t)(msb - STRESS_LATENCY_SUB_SHIFT + 1) << STRESS_LATENCY_SUB_SHIFT) +
+		(size_t)((nsec >> (msb - STRESS_LATENCY_SUB_SHIFT)) & (STRESS_LATENCY_SUB_BUCKETS - 1));
+}
+
+/*
+ *  stress_latency_add()
+ *	add a latency sample to a histogram, each histogram has just
+ *	one writer (the stressor instance) so no locking is required
+ */
+static inline void ALWAYS_INLINE stress_latency_add(
+	stress_latency_t *latency,
+	const uint64_t nsec)
+{
+	latency->bucket[stress_latency_index(nsec)]++;
+	latency->count++;
+	latency->total += nsec;
+	if (nsec < latency->min)
+		latency->min = nsec;
+	if (nsec > latency->max)
+		latency->max = nsec;
+}
+
+/*
+ *  stress_latency_now()
+ *	monotonic time in nanoseconds, from the calibrated
+ *	cycle counter when there is a usable one
+ */
+static inline uint64_t ALWAYS_INLINE stress_latency_now(void)
+{
+	return stress_clocksource_ns();
+}
+
+/*
+ *  stress_latency_begin()
+ *	start timing a stressor operation, returns 0 if
+ *	latency histograms are not enabled. For --rate paced
+ *	stressors the first operation timed after each paced
+ *	bogo op is timed from when the op was due rather than
+ *	when it started so that the queuing delay of late ops
+ *	is not omitted from the latencies
+ */
+static inline uint64_t ALWAYS_INLINE stress_latency_begin(const stress_args_t *args)
+{
+	if (!args->latency)
+		return 0;
+	if (args->rate && args->rate->due_ns) {
+		const uint64_t due_ns = args->rate->due_ns;
+
+		args->rate->due_ns = 0;
+		return due_ns;
+	}
+	return stress_latency_now();
+}
+
+/*
+ *  stress_latency_end()
+ *	end timing a stressor operation started with
+ *	stress_latency_begin() and add it to the histogram
+ */
+static inline void ALWAYS_INLINE stress_latency_end(
+	const stress_args_t *args,
+	const uint64_t t_begin)
+{
+	if (args->latency)
+		stress_latency_add(args->latency, stress_latency_now() - t_begin);
+}
+
+extern void stress_latency_reset(stress_latency_t *latency);
+extern void stress_latency_merge(stress_latency_t *dst, const stress_latency_t *src);
+extern WARN_UNUSED uint64_t stress_latency_bucket_max(const size_t idx);
+extern WARN_UNUSED uint64_t stress_latency_percentile(const stress_latency_t *latency,
+	const double percentile);
+extern void stress_latency_yaml(FILE *yaml, const stress_stressor_t *ss);
+extern void stress_latency_dump(stress_stressor_t *stressors_list);
+
+#endif
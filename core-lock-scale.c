@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-lock-scale.h"
+
+#if defined(HAVE_SYS_FILE_H)
+#include <sys/file.h>
+#endif
+
+#define LOCK_SCALE_PHASE_USEC	(100000)	/* duration of each process count */
+#define LOCK_SCALE_SWEEP_MAX	(8)		/* 1, 2, 4 .. 64 and the maximum */
+#define LOCK_SCALE_RANGE	(4096)		/* bytes locked by each process */
+
+static const char * const lock_scale_apis[] = {
+	"flock",
+	"lockf",
+	"ofd",
+};
+
+/* per process results */
+typedef struct {
+	uint64_t ops;			/* lock and unlock pairs */
+	int err;			/* errno of a failed lock or unlock */
+	stress_latency_t latency;	/* lock and unlock latencies */
+} stress_lock_scale_result_t;
+
+/* state shared with the locking processes */
+typedef struct {
+	volatile bool start;		/* processes start locking */
+	volatile bool stop;		/* processes stop locking */
+	stress_lock_scale_result_t results[MAX_LOCK_SCALE_PROCS];
+} stress_lock_scale_shared_t;
+
+/* accumulated results for a process count */
+typedef struct {
+	uint32_t procs;			/* number of processes */
+	double wall;			/* seconds of phases */
+	double ops;			/* lock and unlock pairs of all processes */
+	double proc_rate;		/* sum of per process pairs per second */
+	double proc_phases;		/* number of process phases */
+	stress_latency_t latency;	/* latencies of all processes */
+} stress_lock_scale_stats_t;
+
+/*
+ *  stress_lock_scale_lock()
+ *	lock (lock true) or unlock the byte range of fd with the
+ *	api, flock locks the whole file, returns 0 or the errno
+ */
+static int stress_lock_scale_lock(
+	const int api,
+	const int fd,
+	const off_t start,
+	const bool lock)
+{
+	int ret;
+
+	switch (api) {
+#if defined(HAVE_FLOCK) &&	\
+    defined(LOCK_EX) &&		\
+    defined(LOCK_UN)
+	case STRESS_LOCK_SCALE_FLOCK:
+		(void)start;
+		ret = flock(fd, lock ? LOCK_EX : LOCK_UN);
+		break;
+#endif
+#if defined(HAVE_LOCKF) &&	\
+    defined(F_LOCK) &&		\
+    defined(F_ULOCK)
+	case STRESS_LOCK_SCALE_LOCKF:
+		/* lockf locks from the file offset, set once at open */
+		(void)start;
+		ret = lockf(fd, lock ? F_LOCK : F_ULOCK, LOCK_SCALE_RANGE);
+		break;
+#endif
+#if defined(F_OFD_SETLKW) &&	\
+    defined(F_WRLCK) &&		\
+    defined(F_UNLCK)
+	case STRESS_LOCK_SCALE_OFD: {
+			struct flock f;
+
+			(void)memset(&f, 0, sizeof(f));
+			f.l_type = lock ? F_WRLCK : F_UNLCK;
+			f.l_whence = SEEK_SET;
+			f.l_start = start;
+			f.l_len = LOCK_SCALE_RANGE;
+			ret = fcntl(fd, F_OFD_SETLKW, &f);
+		}
+		break;
+#endif
+	default:
+		(void)fd;
+		(void)start;
+		(void)lock;
+		errno = ENOSYS;
+		ret = -1;
+		break;
+	}
+	return (ret < 0) ? errno : 0;
+}
+
+/*
+ *  stress_lock_scale_child()
+ *	lock and unlock a byte range in each of the files in turn,
+ *	the files are opened by each process so that flock and OFD
+ *	locks are not shared through inherited file descriptions
+ */
+static void stress_lock_scale_child(
+	const int api,
+	stress_lock_scale_shared_t *shared,
+	const uint32_t proc,
+	char filenames[][PATH_MAX],
+	const uint32_t files,
+	const bool overlap)
+{
+	stress_lock_scale_result_t *result = &shared->results[proc];
+	const off_t start = overlap ? (off_t)proc * (LOCK_SCALE_RANGE / 2) :
+				      (off_t)proc * LOCK_SCALE_RANGE;
+	int fds[MAX_LOCK_SCALE_FILES];
+	uint32_t i, f = proc % files;
+	uint64_t ops = 0;
+
+	for (i = 0; i < files; i++) {
+		fds[i] = open(filenames[i], O_RDWR);
+		if (fds[i] < 0) {
+			result->err = errno;
+			goto close_fds;
+		}
+		if ((api == STRESS_LOCK_SCALE_LOCKF) && (lseek(fds[i], start, SEEK_SET) < 0)) {
+			result->err = errno;
+			i++;
+			goto close_fds;
+		}
+	}
+
+	while (!shared->start && !shared->stop)
+		shim_sched_yield();
+
+	while (!shared->stop && keep_stressing_flag()) {
+		const uint64_t t = stress_latency_now();
+		int err;
+
+		err = stress_lock_scale_lock(api, fds[f], start, true);
+		if (LIKELY(err == 0))
+			err = stress_lock_scale_lock(api, fds[f], start, false);
+		if (UNLIKELY(err != 0)) {
+			if (err == EINTR)
+				continue;
+			result->err = err;
+			break;
+		}
+		stress_latency_add(&result->latency, stress_latency_now() - t);
+		ops++;
+		f++;
+		if (f >= files)
+			f = 0;
+	}
+	result->ops = ops;
+
+close_fds:
+	while (i > 0)
+		(void)close(fds[--i]);
+}
+
+/*
+ *  stress_lock_scale_phase()
+ *	run n processes locking for LOCK_SCALE_PHASE_USEC and add
+ *	the results to stats, returns the errno of a failed lock
+ *	or unlock or 0
+ */
+static int stress_lock_scale_phase(
+	const stress_args_t *args,
+	const int api,
+	stress_lock_scale_shared_t *shared,
+	char filenames[][PATH_MAX],
+	const uint32_t files,
+	const bool overlap,
+	stress_lock_scale_stats_t *stats)
+{
+	pid_t pids[MAX_LOCK_SCALE_PROCS];
+	const uint32_t n = stats->procs;
+	uint32_t i, started = 0;
+	int err = 0;
+	double t;
+
+	shared->start = false;
+	shared->stop = false;
+	for (i = 0; i < n; i++) {
+		shared->results[i].ops = 0;
+		shared->results[i].err = 0;
+		stress_latency_reset(&shared->results[i].latency);
+	}
+	for (i = 0; i < n; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			break;
+		if (pids[i] == 0) {
+			stress_parent_died_alarm();
+			(void)sched_settings_apply(true);
+
+			stress_lock_scale_child(api, shared, i, filenames, files, overlap);
+			_exit(EXIT_SUCCESS);
+		}
+		started++;
+	}
+	if (started == n) {
+		t = stress_time_now();
+		shared->start = true;
+		(void)shim_usleep(LOCK_SCALE_PHASE_USEC);
+		shared->stop = true;
+		t = stress_time_now() - t;
+	} else {
+		shared->stop = true;
+		t = 0.0;
+	}
+	for (i = 0; i < started; i++) {
+		int status;
+
+		(void)shim_waitpid(pids[i], &status, 0);
+	}
+	if (started != n) {
+		pr_dbg("%s: could only fork %" PRIu32 " of %" PRIu32 " processes\n",
+			args->name, started, n);
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		const stress_lock_scale_result_t *result = &shared->results[i];
+
+		if (result->err)
+			err = result->err;
+		stats->ops += (double)result->ops;
+		if (t > 0.0)
+			stats->proc_rate += (double)result->ops / t;
+		stress_latency_merge(&stats->latency, &result->latency);
+	}
+	stats->wall += t;
+	stats->proc_phases += (double)n;
+
+	return err;
+}
+
+/*
+ *  stress_lock_scale_report()
+ *	print the lock and unlock rates and latencies over the
+ *	process counts
+ */
+static void stress_lock_scale_report(
+	const stress_args_t *args,
+	const int api,
+	const stress_lock_scale_stats_t *stats,
+	const size_t n_counts)
+{
+	const double base = (stats[0].proc_phases > 0.0) ? stats[0].proc_rate / stats[0].proc_phases : 0.0;
+	size_t i;
+
+	pr_lock();
+	pr_inf("%s: %s lock and unlock pairs over processes\n", args->name, lock_scale_apis[api]);
+	pr_inf("%s: %5s %12s %12s %9s %10s %10s %10s\n", args->name,
+		"procs", "pairs/sec", "pairs/s/proc", "scaling %",
+		"mean ns", "p50 ns", "p99 ns");
+	for (i = 0; i < n_counts; i++) {
+		const stress_lock_scale_stats_t *s = &stats[i];
+		const stress_latency_t *l = &s->latency;
+		const double per_proc = (s->proc_phases > 0.0) ? s->proc_rate / s->proc_phases : 0.0;
+
+		if ((s->wall <= 0.0) || (l->count == 0))
+			continue;
+		pr_inf("%s: %5" PRIu32 " %12.0f %12.0f %9.2f %10.0f %10" PRIu64 " %10" PRIu64 "\n",
+			args->name, s->procs, s->ops / s->wall, per_proc,
+			(base > 0.0) ? 100.0 * per_proc / base : 0.0,
+			(double)l->total / (double)l->count,
+			stress_latency_percentile(l, 50.0),
+			stress_latency_percentile(l, 99.0));
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_lock_scale()
+ *	measure lock and unlock throughput and latency of a file lock
+ *	api as the number of processes locking a set of files grows,
+ *	byte range locks are either disjoint or overlap the ranges of
+ *	the neighbouring processes
+ */
+int stress_lock_scale(
+	const stress_args_t *args,
+	const int api,
+	const uint32_t files,
+	const uint32_t procs,
+	const bool overlap)
+{
+	static stress_lock_scale_stats_t stats[LOCK_SCALE_SWEEP_MAX];
+	stress_lock_scale_shared_t *shared;
+	char (*filenames)[PATH_MAX];
+	uint32_t i, n, n_files = 0;
+	size_t j, n_counts = 0, idx = 0;
+	int ret, rc = EXIT_SUCCESS;
+
+	/* a bad fd gives EBADF for apis that are built in, ENOSYS otherwise */
+	if ((api < 0) || (api >= (int)SIZEOF_ARRAY(lock_scale_apis)) ||
+	    (stress_lock_scale_lock(api, -1, 0, false) == ENOSYS)) {
+		pr_inf_skip("%s: lock scaling is not supported, skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (n = 1; (n < procs) && (n_counts < LOCK_SCALE_SWEEP_MAX - 1); n <<= 1)
+		stats[n_counts++].procs = n;
+	stats[n_counts++].procs = procs;
+	for (j = 0; j < n_counts; j++)
+		stress_latency_reset(&stats[j].latency);
+
+	shared = (stress_lock_scale_shared_t *)mmap(NULL, sizeof(*shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes of shared state, skipping stressor\n",
+			args->name, sizeof(*shared));
+		return EXIT_NO_RESOURCE;
+	}
+	filenames = calloc(files, sizeof(*filenames));
+	if (!filenames) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " filenames, skipping stressor\n",
+			args->name, files);
+		rc = EXIT_NO_RESOURCE;
+		goto unmap_shared;
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto free_filenames;
+	}
+	for (n_files = 0; n_files < files; n_files++) {
+		int fd;
+
+		(void)stress_temp_filename_args(args, filenames[n_files],
+			sizeof(filenames[n_files]), (uint64_t)n_files);
+		fd = open(filenames[n_files], O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			rc = stress_exit_status(errno);
+			pr_fail("%s: open %s failed, errno=%d (%s)\n",
+				args->name, filenames[n_files], errno, strerror(errno));
+			goto rm_files;
+		}
+		(void)close(fd);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (j = 0; keep_stressing(args) && (j < n_counts); j++) {
+			const double ops = stats[j].ops;
+
+			ret = stress_lock_scale_phase(args, api, shared, filenames,
+				files, overlap, &stats[j]);
+			add_counter(args, (uint64_t)(stats[j].ops - ops));
+			if (ret != 0) {
+				pr_fail("%s: %s lock or unlock failed with %" PRIu32
+					" processes, errno=%d (%s)%s\n", args->name,
+					lock_scale_apis[api], stats[j].procs, ret,
+					strerror(ret), stress_fs_type(filenames[0]));
+				rc = EXIT_FAILURE;
+				break;
+			}
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_lock_scale_report(args, api, stats, n_counts);
+
+	for (j = 0; j < n_counts; j++) {
+		const stress_lock_scale_stats_t *s = &stats[j];
+		const stress_latency_t *l = &s->latency;
+		char str[64];
+
+		if ((s->wall <= 0.0) || (l->count == 0))
+			continue;
+		(void)snprintf(str, sizeof(str), "lock+unlock per sec (%" PRIu32 " procs)", s->procs);
+		stress_metrics_set(args, idx++, str, s->ops / s->wall);
+		(void)snprintf(str, sizeof(str), "p50 lock+unlock latency (ns) (%" PRIu32 " procs)", s->procs);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 50.0));
+		(void)snprintf(str, sizeof(str), "p99 lock+unlock latency (ns) (%" PRIu32 " procs)", s->procs);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 99.0));
+		if (args->latency)
+			stress_latency_merge(args->latency, l);
+	}
+
+rm_files:
+	for (i = 0; i < n_files; i++)
+		(void)shim_unlink(filenames[i]);
+	(void)stress_temp_dir_rm_args(args);
+free_filenames:
+	free(filenames);
+unmap_shared:
+	(void)munmap((void *)shared, sizeof(*shared));
+
+	return rc;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_LOCK_SCALE_H
+#define CORE_LOCK_SCALE_H
+
+/* file lock APIs */
+#define STRESS_LOCK_SCALE_FLOCK		(0)	/* flock(2) whole file locks */
+#define STRESS_LOCK_SCALE_LOCKF		(1)	/* lockf(3) process byte range locks */
+#define STRESS_LOCK_SCALE_OFD		(2)	/* fcntl(2) open file description byte range locks */
+
+#define MIN_LOCK_SCALE_FILES		(1)
+#define MAX_LOCK_SCALE_FILES		(256)
+#define DEFAULT_LOCK_SCALE_FILES	(1)
+
+#define MIN_LOCK_SCALE_PROCS		(1)
+#define MAX_LOCK_SCALE_PROCS		(64)
+#define DEFAULT_LOCK_SCALE_PROCS	(4)
+
+/* lock and unlock throughput and latency over the number of processes */
+extern int stress_lock_scale(const stress_args_t *args, const int api,
+	const uint32_t files, const uint32_t procs, const bool overlap);
+
+#endif
@@ -34,6 +34,22 @@
 
 #define STRESS_LOCK_MAGIC	(0x387cb9e5)
 
+#define ADAPTIVE_SPINS		(128)	/* PAUSE spins before yielding */
+#define ADAPTIVE_YIELDS		(4)	/* yields before parking on the futex */
+#define ADAPTIVE_WAIT_NS	(100000000)	/* futex wait timeout, 0.1 secs */
+
+#if defined(HAVE_LINUX_FUTEX_H) &&		\
+    defined(__NR_futex) &&			\
+    defined(FUTEX_WAIT) &&			\
+    defined(FUTEX_WAKE) &&			\
+    defined(HAVE_SYSCALL) &&			\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_LOAD)
+#define LOCK_METHOD_ADAPTIVE		(0x0040)
+#else
+#define LOCK_METHOD_ADAPTIVE		(0)
+#endif
+
 #if defined(HAVE_LIB_PTHREAD) &&		\
     defined(HAVE_LIB_PTHREAD_SPINLOCK) &&       \
     !defined(__DragonFly__) &&                  \
@@ -84,7 +100,8 @@
 #endif
 
 #define LOCK_METHOD_ALL			\
-	(LOCK_METHOD_ATOMIC_SPINLOCK |	\
+	(LOCK_METHOD_ADAPTIVE |		\
+	 LOCK_METHOD_ATOMIC_SPINLOCK |	\
 	 LOCK_METHOD_PTHREAD_SPINLOCK | \
 	 LOCK_METHOD_PTHREAD_MUTEX |	\
 	 LOCK_METHOD_FUTEX |		\
@@ -96,6 +113,9 @@ typedef struct stress_lock {
 	int		method;		/* Lock method */
 	char 		*type;		/* User readable lock type */
 	union {
+#if LOCK_METHOD_ADAPTIVE != 0
+		int	adaptive;	/* 0 unlocked, 1 locked, 2 locked with waiters */
+#endif
 #if LOCK_METHOD_ATOMIC_SPINLOCK != 0
 		bool	flag;		/* atomic spinlock flag */
 #endif
@@ -119,12 +139,105 @@ typedef struct stress_lock {
 	int (*deinit)(struct stress_lock *lock);
 	int (*acquire)(struct stress_lock *lock);
 	int (*release)(struct stress_lock *lock);
+	uint64_t	acquires;	/* Total acquires */
+	uint64_t	contended;	/* Acquires that had to wait */
+	uint64_t	spins;		/* Spins waiting for the lock */
+	uint64_t	parks;		/* Waits on the futex */
+	uint64_t	wakes;		/* Wakes of futex waiters */
 } stress_lock_t;
 
+/*
+ *  Locking via adaptive lock, spin for a short while and then
+ *  wait on a futex, the lock word states are as described in
+ *  "Futexes Are Tricky", Ulrich Drepper
+ */
+#if LOCK_METHOD_ADAPTIVE != 0
+static int stress_adaptive_lock_init(stress_lock_t *lock)
+{
+	lock->u.adaptive = 0;
+
+	return 0;
+}
+
+static int stress_adaptive_lock_deinit(stress_lock_t *lock)
+{
+	(void)lock;
+
+	return 0;
+}
+
+static inline bool stress_adaptive_lock_cas(stress_lock_t *lock, int old_val, const int new_val)
+{
+	return __atomic_compare_exchange_n(&lock->u.adaptive, &old_val, new_val,
+		false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static int stress_adaptive_lock_acquire(stress_lock_t *lock)
+{
+	if (lock) {
+		struct timespec ts;
+		double t;
+		uint32_t i, spins = 0, parks = 0;
+		int val;
+
+		/* uncontended fast path */
+		if (stress_adaptive_lock_cas(lock, 0, 1)) {
+			lock->acquires++;
+			return 0;
+		}
+
+		/* bounded spin in case the owner releases the lock soon */
+		for (i = 0; i < ADAPTIVE_SPINS + ADAPTIVE_YIELDS; i++) {
+			spins++;
+			if ((__atomic_load_n(&lock->u.adaptive, __ATOMIC_RELAXED) == 0) &&
+			    (stress_adaptive_lock_cas(lock, 0, 1)))
+				goto acquired;
+			if (i < ADAPTIVE_SPINS) {
+#if defined(HAVE_ASM_X86_PAUSE)
+				stress_asm_x86_pause();
+#endif
+				continue;
+			}
+			shim_sched_yield();
+		}
+
+		/* mark the lock as having waiters and park on the futex */
+		ts.tv_sec = 0;
+		ts.tv_nsec = ADAPTIVE_WAIT_NS;
+		t = stress_time_now();
+		while ((val = __atomic_exchange_n(&lock->u.adaptive, 2, __ATOMIC_ACQUIRE)) != 0) {
+			parks++;
+			(void)syscall(__NR_futex, &lock->u.adaptive, FUTEX_WAIT, 2, &ts, NULL, 0);
+			if (((stress_time_now() - t) > 5.0) && !keep_stressing_flag()) {
+				errno = EAGAIN;
+				return -1;
+			}
+		}
+acquired:
+		lock->acquires++;
+		lock->contended++;
+		lock->spins += spins;
+		lock->parks += parks;
+		return 0;
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+static int stress_adaptive_lock_release(stress_lock_t *lock)
+{
+	if (__atomic_load_n(&lock->u.adaptive, __ATOMIC_RELAXED) == 2)
+		lock->wakes++;
+	if (__atomic_exchange_n(&lock->u.adaptive, 0, __ATOMIC_RELEASE) == 2)
+		(void)syscall(__NR_futex, &lock->u.adaptive, FUTEX_WAKE, 1, NULL, NULL, 0);
+
+	return 0;
+}
+
 /*
  *  Locking via atomic spinlock
  */
-#if LOCK_METHOD_ATOMIC_SPINLOCK != 0
+#elif LOCK_METHOD_ATOMIC_SPINLOCK != 0
 static inline bool test_and_set(bool *addr)
 {
 	return __atomic_test_and_set((void *)addr, __ATOMIC_ACQ_REL);
@@ -401,11 +514,18 @@ void *stress_lock_create(void)
 		return NULL;
 
 	/*
-	 *  Select locking implementation, try to use fast atomic
-	 *  spinlock, then pthread spinlock, then pthread mutex
-	 *  and fall back on Linux futex
+	 *  Select locking implementation, try to use the adaptive
+	 *  spin then futex wait lock, then fast atomic spinlock,
+	 *  then pthread spinlock, then pthread mutex and fall back
+	 *  on Linux futex
 	 */
-#if LOCK_METHOD_ATOMIC_SPINLOCK != 0
+#if LOCK_METHOD_ADAPTIVE != 0
+	lock->init = stress_adaptive_lock_init;
+	lock->deinit = stress_adaptive_lock_deinit;
+	lock->acquire = stress_adaptive_lock_acquire;
+	lock->release = stress_adaptive_lock_release;
+	lock->type = "adaptive";
+#elif LOCK_METHOD_ATOMIC_SPINLOCK != 0
 	lock->init = stress_atomic_lock_init;
 	lock->deinit = stress_atomic_lock_deinit;
 	lock->acquire = stress_atomic_lock_acquire;
@@ -460,6 +580,27 @@ no_locks:
 	return NULL;
 }
 
+/*
+ *  stress_lock_report()
+ *	report lock contention statistics, these are only
+ *	gathered by the adaptive lock
+ */
+void stress_lock_report(void *lock_handle, const char *name)
+{
+	stress_lock_t *lock = (stress_lock_t *)lock_handle;
+
+	if (!stress_lock_valid(lock) || (lock->acquires == 0))
+		return;
+
+	pr_dbg("%s lock (%s): %" PRIu64 " acquires, %" PRIu64
+		" contended (%.2f%%), %.2f spins per contended acquire, %"
+		PRIu64 " futex waits, %" PRIu64 " wakes\n",
+		name, lock->type, lock->acquires, lock->contended,
+		100.0 * (double)lock->contended / (double)lock->acquires,
+		lock->contended ? (double)lock->spins / (double)lock->contended : 0.0,
+		lock->parks, lock->wakes);
+}
+
 /*
  *  stress_lock_destroy()
  *	generic lock destruction
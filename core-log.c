@@ -20,6 +20,8 @@
 #include "stress-ng.h"
 #include "core-syslog.h"
 
+#include <float.h>
+
 #define PR_TIMEOUT	(0.5)	/* pr_lock timeout in seconds */
 
 #if defined(HAVE_SYSLOG_H)
@@ -35,6 +37,8 @@ static inline FILE *pr_file(void)
 	return (g_opt_flags & OPT_FLAGS_STDOUT) ? stdout : stderr;
 }
 
+static void pr_async_exited(const pid_t pid);
+
 
 #if defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
     defined(HAVE_ATOMIC_STORE)
@@ -242,6 +246,7 @@ void pr_unlock(void)
  */
 void pr_lock_exited(const pid_t pid)
 {
+	pr_async_exited(pid);
 	if (g_opt_flags & OPT_FLAGS_LOG_LOCKLESS)
 		return;
 	if (!g_shared)
@@ -271,7 +276,7 @@ void pr_unlock(void)
 
 void pr_lock_exited(const pid_t pid)
 {
-	(void)pid;
+	pr_async_exited(pid);
 }
 
 #endif
@@ -338,6 +343,396 @@ void pr_openlog(const char *filename)
 	}
 }
 
+#if defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+
+#define PR_RING_SIZE	(16384)		/* per-process log ring size */
+#define PR_RING_EXTRA	(64)		/* rings for parent and helpers */
+#define PR_RINGS_MAX	(4096)		/* maximum number of rings */
+#define PR_RING_WAIT	(0.1)		/* wait on a full ring in seconds */
+#define PR_REORDER	(0.02)		/* drain reorder window in seconds */
+
+/*
+ *  log records are 16 byte aligned so the space left at the end
+ *  of a ring is always zero or large enough for a padding record
+ */
+typedef struct {
+	uint32_t len;			/* record length including header */
+	uint32_t text_len;		/* message text length, 0 = padding */
+	double whence;			/* time message was logged */
+} pr_ring_rec_t;
+
+typedef struct {
+	pid_t owner;			/* producer pid, 0 = free */
+	uint64_t head;			/* producer offset */
+	uint64_t tail;			/* consumer offset */
+	char data[PR_RING_SIZE] ALIGNED(16);
+} pr_ring_t;
+
+typedef struct {
+	bool running;			/* drainer is consuming records */
+	bool stop;			/* parent requests drainer to stop */
+	uint32_t rings_num;		/* number of rings */
+	pr_ring_t rings[];
+} pr_rings_t;
+
+static pr_rings_t *pr_rings;		/* shared rings, NULL = sync logging */
+static size_t pr_rings_size;
+static pr_ring_t *pr_ring;		/* ring owned by this process */
+static pid_t pr_ring_pid;		/* pid that owns pr_ring */
+static pid_t pr_async_pid;		/* drainer pid */
+static bool pr_async_drainer;		/* true in the drainer process */
+
+/*
+ *  pr_async_enabled()
+ *	true if messages can be queued on a ring
+ */
+static inline bool pr_async_enabled(void)
+{
+	return pr_rings && !pr_async_drainer &&
+	       __atomic_load_n(&pr_rings->running, __ATOMIC_ACQUIRE);
+}
+
+/*
+ *  pr_ring_get()
+ *	get the ring owned by the calling process, claim a free
+ *	ring or a ring left behind by a dead process if required.
+ */
+static pr_ring_t *pr_ring_get(void)
+{
+	const pid_t pid = getpid();
+	uint32_t i;
+
+	if (pr_ring_pid == pid)
+		return pr_ring;
+
+	/* new process, possibly forked with the parent's ring */
+	pr_ring_pid = pid;
+	pr_ring = NULL;
+
+	for (i = 0; i < pr_rings->rings_num; i++) {
+		pr_ring_t *ring = &pr_rings->rings[i];
+		pid_t owner = __atomic_load_n(&ring->owner, __ATOMIC_ACQUIRE);
+
+		if ((owner != 0) && ((kill(owner, 0) == 0) || (errno != ESRCH)))
+			continue;
+		/*
+		 *  A dead owner never published a partially written
+		 *  record, so the ring can be taken over as is
+		 */
+		if (__atomic_compare_exchange_n(&ring->owner, &owner, pid, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			pr_ring = ring;
+			break;
+		}
+	}
+	return pr_ring;
+}
+
+/*
+ *  pr_ring_put()
+ *	queue a "prefix: text" log record on the calling process' ring,
+ *	returns false if it could not be queued and needs writing directly.
+ */
+static bool pr_ring_put(const char *prefix, const char *text, const size_t text_len)
+{
+	pr_ring_t *ring;
+	pr_ring_rec_t *rec;
+	const size_t prefix_len = prefix ? strlen(prefix) + 2 : 0;
+	const size_t len = (sizeof(*rec) + prefix_len + text_len + 15) & ~(size_t)15;
+	size_t offset, to_end, need;
+	uint64_t head;
+	double timeout = 0.0;
+	char *ptr;
+
+	if (len > PR_RING_SIZE / 2)
+		return false;
+	ring = pr_ring_get();
+	if (!ring)
+		return false;
+
+	head = ring->head;
+	offset = (size_t)(head % PR_RING_SIZE);
+	to_end = PR_RING_SIZE - offset;
+	need = (len > to_end) ? len + to_end : len;
+
+	/* Ring full, give the drainer a short while to catch up */
+	while ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) + need > PR_RING_SIZE) {
+		const double now = stress_time_now();
+
+		if (!pr_async_enabled())
+			return false;
+		if (timeout == 0.0)
+			timeout = now + PR_RING_WAIT;
+		else if (now > timeout)
+			return false;
+		shim_sched_yield();
+	}
+
+	if (len > to_end) {
+		/* Pad to end of ring and wrap */
+		rec = (pr_ring_rec_t *)&ring->data[offset];
+		rec->len = (uint32_t)to_end;
+		rec->text_len = 0;
+		rec->whence = 0.0;
+		head += to_end;
+		offset = 0;
+	}
+	rec = (pr_ring_rec_t *)&ring->data[offset];
+	rec->len = (uint32_t)len;
+	rec->text_len = (uint32_t)(prefix_len + text_len);
+	rec->whence = stress_time_now();
+	ptr = (char *)(rec + 1);
+	if (prefix) {
+		(void)memcpy(ptr, prefix, prefix_len - 2);
+		ptr += prefix_len - 2;
+		*ptr++ = ':';
+		*ptr++ = ' ';
+	}
+	(void)memcpy(ptr, text, text_len);
+
+	__atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ *  pr_ring_peek()
+ *	return the oldest record on a ring, skipping padding,
+ *	NULL if the ring is empty
+ */
+static pr_ring_rec_t *pr_ring_peek(pr_ring_t *ring)
+{
+	const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = ring->tail;
+
+	while (tail != head) {
+		pr_ring_rec_t *rec = (pr_ring_rec_t *)&ring->data[tail % PR_RING_SIZE];
+
+		if (rec->text_len)
+			return rec;
+		tail += rec->len;
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/*
+ *  pr_async_drain()
+ *	merge records logged up to time cutoff from all the rings
+ *	in timestamp order and write them out
+ */
+static void pr_async_drain(const double cutoff)
+{
+	FILE *fp = pr_file();
+	bool locked = false;
+
+	for (;;) {
+		pr_ring_t *min_ring = NULL;
+		pr_ring_rec_t *min_rec = NULL;
+		double min_whence = cutoff;
+		uint32_t i;
+
+		for (i = 0; i < pr_rings->rings_num; i++) {
+			pr_ring_t *ring = &pr_rings->rings[i];
+			pr_ring_rec_t *rec;
+
+			if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_RELAXED))
+				continue;
+			rec = pr_ring_peek(ring);
+			if (rec && (rec->whence <= min_whence)) {
+				min_ring = ring;
+				min_rec = rec;
+				min_whence = rec->whence;
+			}
+		}
+		if (!min_ring)
+			break;
+
+		/* Don't intermix with messages written directly */
+		if (!locked) {
+			pr_lock();
+			locked = true;
+		}
+		VOID_RET(size_t, fwrite(min_rec + 1, 1, min_rec->text_len, fp));
+		if (log_file)
+			VOID_RET(size_t, fwrite(min_rec + 1, 1, min_rec->text_len, log_file));
+		__atomic_store_n(&min_ring->tail, min_ring->tail + min_rec->len, __ATOMIC_RELEASE);
+	}
+	if (locked) {
+		(void)fflush(fp);
+		if (log_file)
+			(void)fflush(log_file);
+		pr_unlock();
+	}
+}
+
+/*
+ *  pr_async_start()
+ *	with --log-async give each process a shared ring buffer for
+ *	log messages that a drainer process merges by timestamp and
+ *	writes out, so stressors don't serialize on the log lock and
+ *	stdio when logging at a high rate.
+ */
+void pr_async_start(const uint32_t num_instances)
+{
+	uint32_t rings_num;
+	pid_t parent_pid;
+	static char buf[65536];
+
+	if (!(g_opt_flags & OPT_FLAGS_LOG_ASYNC))
+		return;
+	if (pr_rings)
+		return;
+
+	rings_num = STRESS_MINIMUM(num_instances + PR_RING_EXTRA, PR_RINGS_MAX);
+	pr_rings_size = sizeof(*pr_rings) + ((size_t)rings_num * sizeof(pr_ring_t));
+	pr_rings = (pr_rings_t *)mmap(NULL, pr_rings_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (pr_rings == MAP_FAILED) {
+		pr_rings = NULL;
+		pr_inf("log-async: cannot mmap %zu bytes for log rings, "
+			"using synchronous logging\n", pr_rings_size);
+		return;
+	}
+	pr_rings->rings_num = rings_num;
+	pr_rings->running = true;
+
+	(void)fflush(pr_file());
+	if (log_file)
+		(void)fflush(log_file);
+
+	parent_pid = getpid();
+	pr_async_pid = fork();
+	if (pr_async_pid < 0) {
+		pr_rings->running = false;
+		pr_inf("log-async: cannot fork log drainer, errno=%d (%s), "
+			"using synchronous logging\n", errno, strerror(errno));
+		(void)munmap((void *)pr_rings, pr_rings_size);
+		pr_rings = NULL;
+		pr_async_pid = 0;
+		return;
+	} else if (pr_async_pid == 0) {
+		pr_async_drainer = true;
+		stress_set_proc_state_str("log", "draining");
+		VOID_RET(int, stress_sighandler("log", SIGINT, SIG_IGN, NULL));
+		VOID_RET(int, stress_sighandler("log", SIGALRM, SIG_IGN, NULL));
+		VOID_RET(int, stress_sighandler("log", SIGHUP, SIG_IGN, NULL));
+		/* Batch output, each drain pass is flushed */
+		(void)setvbuf(pr_file(), buf, _IOFBF, sizeof(buf));
+
+		while (!__atomic_load_n(&pr_rings->stop, __ATOMIC_ACQUIRE) &&
+		       (getppid() == parent_pid)) {
+			pr_async_drain(stress_time_now() - PR_REORDER);
+			(void)shim_usleep(5000);
+		}
+		__atomic_store_n(&pr_rings->running, false, __ATOMIC_RELEASE);
+		pr_async_drain(DBL_MAX);
+		_exit(0);
+	}
+	pr_dbg("log-async: %" PRIu32 " log rings of %d bytes, drainer PID %" PRIdMAX "\n",
+		rings_num, PR_RING_SIZE, (intmax_t)pr_async_pid);
+}
+
+/*
+ *  pr_async_stop()
+ *	flush pending log messages and stop the drainer
+ */
+void pr_async_stop(void)
+{
+	int status;
+
+	if (!pr_rings)
+		return;
+
+	__atomic_store_n(&pr_rings->stop, true, __ATOMIC_RELEASE);
+	if (pr_async_pid > 0) {
+		(void)shim_waitpid(pr_async_pid, &status, 0);
+		pr_async_pid = 0;
+	}
+	__atomic_store_n(&pr_rings->running, false, __ATOMIC_RELEASE);
+	(void)munmap((void *)pr_rings, pr_rings_size);
+	pr_rings = NULL;
+	pr_ring = NULL;
+	pr_ring_pid = 0;
+}
+
+/*
+ *  pr_async_exited()
+ *	release the ring owned by an exiting process
+ */
+static void pr_async_exited(const pid_t pid)
+{
+	pid_t owner = pid;
+
+	if (!pr_rings || !pr_ring || (pr_ring_pid != pid))
+		return;
+	__atomic_compare_exchange_n(&pr_ring->owner, &owner, 0, false,
+				    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	pr_ring = NULL;
+	pr_ring_pid = 0;
+}
+#else
+
+static inline bool pr_async_enabled(void)
+{
+	return false;
+}
+
+static bool pr_ring_put(const char *prefix, const char *text, const size_t text_len)
+{
+	(void)prefix;
+	(void)text;
+	(void)text_len;
+
+	return false;
+}
+
+void pr_async_start(const uint32_t num_instances)
+{
+	(void)num_instances;
+}
+
+void pr_async_stop(void)
+{
+}
+
+static void pr_async_exited(const pid_t pid)
+{
+	(void)pid;
+}
+#endif
+
+/*
+ *  pr_msg_write()
+ *	queue a message for the log drainer or write it
+ *	directly to fp and the log file
+ */
+static void pr_msg_write(FILE *fp, const char *prefix, const char *buf, const size_t n, const bool async)
+{
+	if (async) {
+		if (pr_ring_put(prefix, buf, n))
+			return;
+		pr_lock();
+	}
+	if (prefix) {
+		(void)fprintf(fp, "%s: %s", prefix, buf);
+		if (log_file) {
+			(void)fprintf(log_file, "%s: %s", prefix, buf);
+			(void)fflush(log_file);
+		}
+	} else {
+		if (log_file) {
+			VOID_RET(size_t, fwrite(buf, 1, n, log_file));
+			(void)fflush(log_file);
+		}
+		VOID_RET(size_t, fwrite(buf, 1, n, fp));
+	}
+	(void)fflush(fp);
+	if (async)
+		pr_unlock();
+}
+
 static int pr_msg(
 	FILE *fp,
 	const uint64_t flag,
@@ -355,8 +750,10 @@ static int pr_msg(
 {
 	int ret = 0;
 	char ts[32];
+	const bool async = pr_async_enabled();
 
-	pr_lock();
+	if (!async)
+		pr_lock();
 
 	if (g_opt_flags & OPT_FLAGS_TIMESTAMP) {
 		struct timeval tv;
@@ -400,22 +797,16 @@ static int pr_msg(
 
 		if (g_opt_flags & OPT_FLAGS_LOG_BRIEF) {
 			size_t n = (size_t)vsnprintf(buf, sizeof(buf), fmt, ap);
-			if (log_file) {
-				VOID_RET(size_t, fwrite(buf, 1, n, log_file));
-				(void)fflush(log_file);
-			}
-			VOID_RET(size_t, fwrite(buf, 1, n, fp));
+
+			if (n >= sizeof(buf))
+				n = sizeof(buf) - 1;
+			pr_msg_write(fp, NULL, buf, n, async);
 		} else {
 			size_t n = (size_t)snprintf(buf, sizeof(buf), "%s%s [%d] ",
 				ts, type, (int)getpid());
 			ret = vsnprintf(buf + n, sizeof(buf) - n, fmt, ap);
-			(void)fprintf(fp, "%s: %s", g_app_name, buf);
-			if (log_file) {
-				(void)fprintf(log_file, "%s: %s", g_app_name, buf);
-				(void)fflush(log_file);
-			}
+			pr_msg_write(fp, g_app_name, buf, strlen(buf), async);
 		}
-		(void)fflush(fp);
 
 		if (flag & PR_FAIL) {
 			abort_fails++;
@@ -439,7 +830,8 @@ static int pr_msg(
 		}
 #endif
 	}
-	pr_unlock();
+	if (!async)
+		pr_unlock();
 	return ret;
 }
 
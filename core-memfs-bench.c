@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-memfs-bench.h"
+#include "core-put.h"
+
+#if defined(HAVE_SYS_MOUNT_H)
+#include <sys/mount.h>
+#endif
+
+#define MEMFS_BENCH_SIZE	(64 * MB)	/* file size shared by the instances */
+#define MEMFS_BENCH_SIZE_MIN	(8 * MB)	/* room for a few 2MB huge pages */
+#define MEMFS_BENCH_CHUNK	(1 * MB)	/* pread and pwrite size */
+
+/*
+ *  stress_memfs_bench_size()
+ *	file size benchmarked by each instance
+ */
+size_t stress_memfs_bench_size(const stress_args_t *args)
+{
+	size_t size = MEMFS_BENCH_SIZE / args->num_instances;
+
+	if (size < MEMFS_BENCH_SIZE_MIN)
+		size = MEMFS_BENCH_SIZE_MIN;
+	return size & ~(size_t)(MEMFS_BENCH_CHUNK - 1);
+}
+
+/*
+ *  stress_memfs_pmd_mapped()
+ *	bytes of shared memory and file mappings of the process
+ *	that are mapped by PMD sized huge pages
+ */
+static double stress_memfs_pmd_mapped(void)
+{
+#if defined(__linux__)
+	FILE *fp;
+	char buffer[256];
+	double bytes = 0.0;
+
+	fp = fopen("/proc/self/smaps_rollup", "r");
+	if (!fp)
+		return 0.0;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		uint64_t kb;
+
+		if ((sscanf(buffer, "ShmemPmdMapped: %" SCNu64, &kb) == 1) ||
+		    (sscanf(buffer, "FilePmdMapped: %" SCNu64, &kb) == 1))
+			bytes += (double)kb * 1024.0;
+	}
+	(void)fclose(fp);
+
+	return bytes;
+#else
+	return 0.0;
+#endif
+}
+
+/*
+ *  stress_memfs_bench_fd()
+ *	write and read a file of size bytes with pwrite and pread,
+ *	then first touch each page of a shared mapping of the sparse
+ *	file and read the populated mapping, accumulating the times,
+ *	bytes and page faults, returns 0 or an errno
+ */
+int stress_memfs_bench_fd(
+	const stress_args_t *args,
+	const int fd,
+	const size_t size,
+	stress_memfs_bench_t *bench)
+{
+	const size_t page_size = args->page_size;
+	struct rusage usage;
+	uint8_t *buf, *mapping;
+	uint64_t sum = 0, *ptr, *end;
+	double t, huge;
+	long int faults;
+	size_t i;
+	int err = 0;
+
+	buf = (uint8_t *)mmap(NULL, MEMFS_BENCH_CHUNK, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return ENOMEM;
+	stress_uint8rnd4(buf, MEMFS_BENCH_CHUNK);
+
+	if (ftruncate(fd, 0) < 0) {
+		err = errno;
+		goto unmap_buf;
+	}
+
+	t = stress_time_now();
+	for (i = 0; i < size; i += MEMFS_BENCH_CHUNK) {
+		if (pwrite(fd, buf, MEMFS_BENCH_CHUNK, (off_t)i) != (ssize_t)MEMFS_BENCH_CHUNK) {
+			err = errno ? errno : ENOSPC;
+			goto truncate;
+		}
+	}
+	bench->write_secs += stress_time_now() - t;
+	bench->write_bytes += (double)size;
+
+	t = stress_time_now();
+	for (i = 0; i < size; i += MEMFS_BENCH_CHUNK) {
+		if (pread(fd, buf, MEMFS_BENCH_CHUNK, (off_t)i) != (ssize_t)MEMFS_BENCH_CHUNK) {
+			err = errno ? errno : EIO;
+			goto truncate;
+		}
+	}
+	bench->read_secs += stress_time_now() - t;
+	bench->read_bytes += (double)size;
+
+	/* free the pages so the mapping is populated by page faults */
+	if ((ftruncate(fd, 0) < 0) || (ftruncate(fd, (off_t)size) < 0)) {
+		err = errno;
+		goto truncate;
+	}
+	huge = stress_memfs_pmd_mapped();
+	mapping = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED) {
+		err = errno;
+		goto truncate;
+	}
+	(void)getrusage(RUSAGE_SELF, &usage);
+	faults = usage.ru_minflt + usage.ru_majflt;
+	t = stress_time_now();
+	for (i = 0; i < size; i += page_size)
+		*(volatile uint8_t *)(mapping + i) = (uint8_t)i;
+	bench->fault_secs += stress_time_now() - t;
+	(void)getrusage(RUSAGE_SELF, &usage);
+	/* pages filled by read_folio, as ramfs does, count as major faults */
+	bench->faults += (double)(usage.ru_minflt + usage.ru_majflt - faults);
+	bench->touch_bytes += (double)size;
+	huge = stress_memfs_pmd_mapped() - huge;
+	if (huge > 0.0)
+		bench->huge_bytes += huge;
+
+	end = (uint64_t *)(mapping + size);
+	t = stress_time_now();
+	for (ptr = (uint64_t *)mapping; ptr < end; ptr += 8) {
+		sum += ptr[0] + ptr[1] + ptr[2] + ptr[3] +
+		       ptr[4] + ptr[5] + ptr[6] + ptr[7];
+	}
+	bench->mmap_secs += stress_time_now() - t;
+	bench->mmap_bytes += (double)size;
+	stress_uint64_put(sum);
+
+	(void)munmap((void *)mapping, size);
+truncate:
+	VOID_RET(int, ftruncate(fd, 0));
+unmap_buf:
+	(void)munmap((void *)buf, MEMFS_BENCH_CHUNK);
+
+	return err;
+}
+
+/*
+ *  stress_memfs_bench_path()
+ *	benchmark an unlinked file created in the directory path,
+ *	returns 0 or an errno
+ */
+int stress_memfs_bench_path(
+	const stress_args_t *args,
+	const char *path,
+	const size_t size,
+	stress_memfs_bench_t *bench)
+{
+	char filename[PATH_MAX];
+	int fd, err;
+
+	(void)snprintf(filename, sizeof(filename), "%s/stress-memfs-%" PRIdMAX "-%" PRIu32,
+		path, (intmax_t)args->pid, args->instance);
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return errno;
+	(void)shim_unlink(filename);
+	err = stress_memfs_bench_fd(args, fd, size, bench);
+	(void)close(fd);
+
+	return err;
+}
+
+/*
+ *  stress_memfs_bench_mount()
+ *	mount a private fs with the options on a directory in the
+ *	temporary directory and benchmark it, the temporary directory
+ *	must exist, returns 0 or an errno
+ */
+int stress_memfs_bench_mount(
+	const stress_args_t *args,
+	const char *fs,
+	const char *options,
+	const size_t size,
+	stress_memfs_bench_t *bench)
+{
+#if defined(__linux__) &&	\
+    defined(HAVE_SYS_MOUNT_H)
+	char path[PATH_MAX - 64], mnt[PATH_MAX];
+	int err;
+
+	(void)stress_temp_dir_args(args, path, sizeof(path));
+	(void)snprintf(mnt, sizeof(mnt), "%s/memfs", path);
+	if ((mkdir(mnt, S_IRWXU) < 0) && (errno != EEXIST))
+		return errno;
+	if (mount("", mnt, fs, 0, options) < 0) {
+		err = errno;
+		(void)shim_rmdir(mnt);
+		return err;
+	}
+	err = stress_memfs_bench_path(args, mnt, size, bench);
+	(void)umount(mnt);
+	(void)shim_rmdir(mnt);
+
+	return err;
+#else
+	(void)args;
+	(void)fs;
+	(void)options;
+	(void)size;
+	(void)bench;
+
+	return ENOSYS;
+#endif
+}
+
+/*
+ *  stress_memfs_huge_option()
+ *	fill buf with the huge= mount option of the tmpfs mounted
+ *	on path, huge=never if not specified, empty if not tmpfs
+ */
+void stress_memfs_huge_option(const char *path, char *buf, const size_t len)
+{
+	FILE *fp;
+	char buffer[1024];
+
+	*buf = '\0';
+	fp = fopen("/proc/self/mounts", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char mnt[256], type[64], opts[512];
+		char *huge;
+
+		if (sscanf(buffer, "%*s %255s %63s %511s", mnt, type, opts) != 3)
+			continue;
+		if (strcmp(mnt, path) || strcmp(type, "tmpfs"))
+			continue;
+		huge = strstr(opts, "huge=");
+		if (huge) {
+			huge[strcspn(huge, ",")] = '\0';
+			(void)shim_strlcpy(buf, huge, len);
+		} else {
+			(void)shim_strlcpy(buf, "huge=never", len);
+		}
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_memfs_bench_report()
+ *	print the bandwidths, fault rates and huge page coverage of
+ *	the benchmarks and set the metrics
+ */
+void stress_memfs_bench_report(
+	const stress_args_t *args,
+	const stress_memfs_bench_t *bench,
+	const size_t n)
+{
+	size_t i, idx = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %-26s %10s %10s %12s %11s %10s %7s\n", args->name,
+			"file system", "write MB/s", "read MB/s", "faults/sec",
+			"fault MB/s", "mmap MB/s", "huge %");
+		for (i = 0; i < n; i++) {
+			const stress_memfs_bench_t *b = &bench[i];
+
+			if (b->err) {
+				pr_inf("%s: %-26s not available, errno=%d (%s)\n",
+					args->name, b->label, b->err, strerror(b->err));
+				continue;
+			}
+			if ((b->write_secs <= 0.0) || (b->fault_secs <= 0.0))
+				continue;
+			pr_inf("%s: %-26s %10.1f %10.1f %12.0f %11.1f %10.1f %7.1f\n",
+				args->name, b->label,
+				b->write_bytes / b->write_secs / (double)MB,
+				b->read_bytes / b->read_secs / (double)MB,
+				b->faults / b->fault_secs,
+				b->touch_bytes / b->fault_secs / (double)MB,
+				b->mmap_bytes / b->mmap_secs / (double)MB,
+				100.0 * b->huge_bytes / b->touch_bytes);
+		}
+		pr_unlock();
+	}
+
+	for (i = 0; i < n; i++) {
+		const stress_memfs_bench_t *b = &bench[i];
+		char str[64];
+
+		if (b->err || (b->write_secs <= 0.0) || (b->fault_secs <= 0.0))
+			continue;
+		(void)snprintf(str, sizeof(str), "%s write MB per sec", b->label);
+		stress_metrics_set(args, idx++, str, b->write_bytes / b->write_secs / (double)MB);
+		(void)snprintf(str, sizeof(str), "%s read MB per sec", b->label);
+		stress_metrics_set(args, idx++, str, b->read_bytes / b->read_secs / (double)MB);
+		(void)snprintf(str, sizeof(str), "%s mmap faults per sec", b->label);
+		stress_metrics_set(args, idx++, str, b->faults / b->fault_secs);
+		(void)snprintf(str, sizeof(str), "%s mmap read MB per sec", b->label);
+		stress_metrics_set(args, idx++, str, b->mmap_bytes / b->mmap_secs / (double)MB);
+		(void)snprintf(str, sizeof(str), "%s huge page mapped %%", b->label);
+		stress_metrics_set(args, idx++, str, 100.0 * b->huge_bytes / b->touch_bytes);
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_MEMFS_BENCH_H
+#define CORE_MEMFS_BENCH_H
+
+#define MEMFS_BENCH_LABEL_LEN	(48)
+
+/* accumulated memory file system bandwidth and fault results */
+typedef struct {
+	char label[MEMFS_BENCH_LABEL_LEN];	/* file system and mount options */
+	int err;			/* errno if the file system cannot be used */
+	double write_secs;		/* seconds writing with pwrite */
+	double write_bytes;		/* bytes written */
+	double read_secs;		/* seconds reading with pread */
+	double read_bytes;		/* bytes read */
+	double fault_secs;		/* seconds first touching a shared mapping */
+	double faults;			/* minor and major page faults first touching */
+	double touch_bytes;		/* bytes first touched */
+	double mmap_secs;		/* seconds reading the populated mapping */
+	double mmap_bytes;		/* bytes read from the mapping */
+	double huge_bytes;		/* bytes of the mapping mapped by huge pages */
+} stress_memfs_bench_t;
+
+/* bandwidth and fault rates of a file of size bytes on an fd or in a directory */
+extern int stress_memfs_bench_fd(const stress_args_t *args, const int fd,
+	const size_t size, stress_memfs_bench_t *bench);
+extern int stress_memfs_bench_path(const stress_args_t *args, const char *path,
+	const size_t size, stress_memfs_bench_t *bench);
+extern int stress_memfs_bench_mount(const stress_args_t *args, const char *fs,
+	const char *options, const size_t size, stress_memfs_bench_t *bench);
+
+/* huge= mount option of a tmpfs mount point */
+extern void stress_memfs_huge_option(const char *path, char *buf, const size_t len);
+
+/* results table and metrics of n benchmarks */
+extern void stress_memfs_bench_report(const stress_args_t *args,
+	const stress_memfs_bench_t *bench, const size_t n);
+extern size_t stress_memfs_bench_size(const stress_args_t *args);
+
+#endif
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-metrics-stream.h"
+#include "core-thermal-zone.h"
+
+#if defined(HAVE_SYS_UN_H)
+#include <sys/un.h>
+#endif
+
+#define METRICS_STREAM_MS_MIN		(10)
+#define METRICS_STREAM_MS_MAX		(3600000)
+#define METRICS_STREAM_MS_DEFAULT	(1000)
+
+#define METRICS_STREAM_FORMAT_JSON	(0)
+#define METRICS_STREAM_FORMAT_CSV	(1)
+
+typedef struct {
+	const char *name;	/* format name */
+	const int format;	/* format id */
+} stress_metrics_stream_format_t;
+
+static const stress_metrics_stream_format_t formats[] = {
+	{ "json",	METRICS_STREAM_FORMAT_JSON },
+	{ "csv",	METRICS_STREAM_FORMAT_CSV },
+};
+
+static pid_t metrics_stream_pid;
+#if defined(STRESS_THERMAL_ZONES)
+static stress_tz_t metrics_stream_tz;
+#endif
+
+/*
+ *  stress_set_metrics_stream_ms()
+ *	set interval between streamed metrics snapshots in milliseconds
+ */
+int stress_set_metrics_stream_ms(const char *opt)
+{
+	uint32_t metrics_stream_ms;
+
+	metrics_stream_ms = stress_get_uint32(opt);
+	stress_check_range("metrics-stream-ms", (uint64_t)metrics_stream_ms,
+		METRICS_STREAM_MS_MIN, METRICS_STREAM_MS_MAX);
+	return stress_set_setting_global("metrics-stream-ms", TYPE_ID_UINT32, &metrics_stream_ms);
+}
+
+/*
+ *  stress_set_metrics_stream_format()
+ *	set streamed metrics format, json or csv
+ */
+int stress_set_metrics_stream_format(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(formats); i++) {
+		if (!strcmp(opt, formats[i].name)) {
+			int format = formats[i].format;
+
+			return stress_set_setting_global("metrics-stream-format", TYPE_ID_INT, &format);
+		}
+	}
+	(void)fprintf(stderr, "metrics-stream-format must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(formats); i++)
+		(void)fprintf(stderr, " %s", formats[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_metrics_stream_open()
+ *	open the metrics stream, a filename prefixed with unix:
+ *	is the path of a UNIX domain socket to connect to
+ */
+static FILE *stress_metrics_stream_open(const char *filename)
+{
+	FILE *fp;
+	int fd;
+
+	if (!strncmp(filename, "unix:", 5)) {
+#if defined(HAVE_SYS_UN_H) &&	\
+    defined(AF_UNIX)
+		struct sockaddr_un addr;
+		const char *path = filename + 5;
+
+		if (strlen(path) >= sizeof(addr.sun_path)) {
+			pr_err("metrics-stream: socket path %s too long\n", path);
+			return NULL;
+		}
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0) {
+			pr_err("metrics-stream: socket failed, errno=%d (%s)\n",
+				errno, strerror(errno));
+			return NULL;
+		}
+		(void)memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		(void)shim_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			pr_err("metrics-stream: cannot connect to %s, errno=%d (%s)\n",
+				path, errno, strerror(errno));
+			(void)close(fd);
+			return NULL;
+		}
+#else
+		pr_err("metrics-stream: UNIX domain sockets not supported\n");
+		return NULL;
+#endif
+	} else {
+		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			pr_err("metrics-stream: cannot open %s, errno=%d (%s)\n",
+				filename, errno, strerror(errno));
+			return NULL;
+		}
+	}
+
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		pr_err("metrics-stream: fdopen failed, errno=%d (%s)\n",
+			errno, strerror(errno));
+		(void)close(fd);
+		return NULL;
+	}
+	return fp;
+}
+
+/*
+ *  stress_metrics_stream_thermal()
+ *	output the most recently sampled thermal zone temperatures
+ */
+static void stress_metrics_stream_thermal(FILE *fp, const int format)
+{
+#if defined(STRESS_THERMAL_ZONES)
+	stress_tz_info_t *tz_info;
+	bool first = true;
+
+	if (!g_shared->tz_info)
+		return;
+
+	if (format == METRICS_STREAM_FORMAT_JSON)
+		(void)fprintf(fp, ",\"thermal-zones\":{");
+	for (tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next) {
+		const double temp = (double)metrics_stream_tz.tz_stat[tz_info->index].temperature / 1000.0;
+
+		if (format == METRICS_STREAM_FORMAT_JSON)
+			(void)fprintf(fp, "%s\"%s\":%.2f", first ? "" : ",", tz_info->type, temp);
+		else
+			(void)fprintf(fp, ",%.2f", temp);
+		first = false;
+	}
+	if (format == METRICS_STREAM_FORMAT_JSON)
+		(void)fprintf(fp, "}");
+#else
+	(void)fp;
+	(void)format;
+#endif
+}
+
+/*
+ *  stress_metrics_stream_csv_header()
+ *	output the csv column names
+ */
+static void stress_metrics_stream_csv_header(FILE *fp)
+{
+#if defined(STRESS_THERMAL_ZONES)
+	stress_tz_info_t *tz_info;
+#endif
+
+	(void)fprintf(fp, "time,elapsed,stressor,instances,bogo-ops,bogo-ops-per-second");
+#if defined(STRESS_THERMAL_ZONES)
+	for (tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next)
+		(void)fprintf(fp, ",%s", tz_info->type);
+#endif
+	(void)fprintf(fp, "\n");
+}
+
+/*
+ *  stress_metrics_stream_start()
+ *	fork a process that periodically samples the shared stressor
+ *	counters and streams the per stressor bogo-op rates to a file
+ *	or UNIX domain socket. Counters are read directly from the
+ *	shared stats so the stressors are never paused.
+ */
+void stress_metrics_stream_start(stress_stressor_t *stressors_list)
+{
+	char *filename = NULL;
+	uint32_t metrics_stream_ms = METRICS_STREAM_MS_DEFAULT;
+	int format = METRICS_STREAM_FORMAT_JSON;
+	stress_stressor_t *ss;
+	size_t n, num_stressors = 0;
+	bool first;
+	uint64_t *prev_counter;
+	double t_start, t_prev, t_next;
+	FILE *fp;
+
+	if (!stress_get_setting("metrics-stream", &filename) || !filename)
+		return;
+	(void)stress_get_setting("metrics-stream-ms", &metrics_stream_ms);
+	(void)stress_get_setting("metrics-stream-format", &format);
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		num_stressors++;
+	if (!num_stressors)
+		return;
+
+	metrics_stream_pid = fork();
+	if ((metrics_stream_pid < 0) || (metrics_stream_pid > 0))
+		return;
+
+	stress_set_proc_name("stat [metrics-stream]");
+	/* a reader disconnecting must fail the write with EPIPE, not kill us */
+	if (stress_sighandler("metrics-stream", SIGPIPE, SIG_IGN, NULL) < 0)
+		_exit(EXIT_FAILURE);
+
+	fp = stress_metrics_stream_open(filename);
+	if (!fp)
+		_exit(EXIT_FAILURE);
+
+	prev_counter = calloc(num_stressors, sizeof(*prev_counter));
+	if (!prev_counter) {
+		pr_err("metrics-stream: cannot allocate counter buffer\n");
+		(void)fclose(fp);
+		_exit(EXIT_FAILURE);
+	}
+
+	if (format == METRICS_STREAM_FORMAT_CSV) {
+		stress_metrics_stream_csv_header(fp);
+		(void)fflush(fp);
+	}
+
+	t_start = stress_time_now();
+	t_prev = t_start;
+	t_next = t_start;
+
+	while (keep_stressing_flag()) {
+		double t_now, t_delta;
+
+		t_next += (double)metrics_stream_ms / 1000.0;
+		t_delta = t_next - stress_time_now();
+		if (t_delta > 0.0)
+			(void)shim_nanosleep_uint64((uint64_t)(t_delta * STRESS_DBL_NANOSECOND));
+		if (!keep_stressing_flag())
+			break;
+
+		t_now = stress_time_now();
+		t_delta = t_now - t_prev;
+		t_prev = t_now;
+#if defined(STRESS_THERMAL_ZONES)
+		if (g_shared->tz_info)
+			(void)stress_tz_get_temperatures(&g_shared->tz_info, &metrics_stream_tz);
+#endif
+
+		if (format == METRICS_STREAM_FORMAT_JSON)
+			(void)fprintf(fp, "{\"time\":%.3f,\"elapsed\":%.3f,\"stressors\":[",
+				t_now, t_now - t_start);
+
+		first = true;
+		for (n = 0, ss = stressors_list; ss; ss = ss->next, n++) {
+			const char *munged = stress_munge_underscore(ss->stressor->name);
+			uint64_t counter = 0;
+			uint32_t instances = 0;
+			int32_t j;
+			double rate;
+
+			if (!ss->stats)
+				continue;
+
+			for (j = 0; j < ss->num_instances; j++) {
+				const stress_stats_t *const stats = ss->stats[j];
+
+				if (stats->start > 0.0)
+					instances++;
+				counter += stats->ci.counter;
+			}
+			/* counters are reset when an instance is restarted */
+			rate = ((t_delta > 0.0) && (counter >= prev_counter[n])) ?
+				(double)(counter - prev_counter[n]) / t_delta : 0.0;
+			prev_counter[n] = counter;
+
+			if (format == METRICS_STREAM_FORMAT_JSON) {
+				(void)fprintf(fp, "%s{\"stressor\":\"%s\",\"instances\":%" PRIu32
+					",\"bogo-ops\":%" PRIu64 ",\"bogo-ops-per-second\":%.3f}",
+					first ? "" : ",", munged, instances, counter, rate);
+			} else {
+				(void)fprintf(fp, "%.3f,%.3f,%s,%" PRIu32 ",%" PRIu64 ",%.3f",
+					t_now, t_now - t_start, munged, instances, counter, rate);
+				stress_metrics_stream_thermal(fp, format);
+				(void)fprintf(fp, "\n");
+			}
+			first = false;
+		}
+		if (format == METRICS_STREAM_FORMAT_JSON) {
+			(void)fprintf(fp, "]");
+			stress_metrics_stream_thermal(fp, format);
+			(void)fprintf(fp, "}\n");
+		}
+		if ((fflush(fp) == EOF) && (errno == EPIPE)) {
+			pr_inf("metrics-stream: reader of %s disconnected, "
+				"stopping metrics stream\n", filename);
+			break;
+		}
+	}
+	free(prev_counter);
+	(void)fclose(fp);
+	_exit(0);
+}
+
+/*
+ *  stress_metrics_stream_stop()
+ *	stop metrics streaming
+ */
+void stress_metrics_stream_stop(void)
+{
+	if (metrics_stream_pid > 0) {
+		int status;
+
+		(void)kill(metrics_stream_pid, SIGKILL);
+		(void)waitpid(metrics_stream_pid, &status, 0);
+	}
+}
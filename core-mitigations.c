@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-mitigations.h"
+
+#if defined(__linux__)
+
+#define MITIGATIONS_VULN_MAX	(32)	/* vulnerability entries kept */
+#define MITIGATIONS_VULN_PATH	"/sys/devices/system/cpu/vulnerabilities"
+
+/* a CPU vulnerability and the kernel's mitigation status of it */
+typedef struct {
+	char name[64];		/* vulnerability, e.g. spectre_v2 */
+	char status[256];	/* status, e.g. Mitigation: Retpolines */
+} stress_mitigations_vuln_t;
+
+/*
+ *  stressors that measure the kernel entry/exit cost, each of
+ *  these reports a per call cost metric or are dominated by
+ *  the cost of simple system calls
+ */
+static const char * const mitigations_stressors[] = {
+	"syscall",
+	"switch",
+	"get",
+	"x86syscall",
+};
+
+static stress_mitigations_vuln_t mitigations_vulns[MITIGATIONS_VULN_MAX];
+static size_t mitigations_vulns_num;
+static char mitigations_cpu_model[128];
+static char mitigations_cmdline[128];
+
+/*
+ *  stress_mitigations_stressor()
+ *	return true if stressor name is one of the kernel
+ *	entry/exit cost stressors
+ */
+bool stress_mitigations_stressor(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(mitigations_stressors); i++) {
+		if (!strcmp(mitigations_stressors[i], name))
+			return true;
+	}
+	return false;
+}
+
+/*
+ *  stress_mitigations_read_line()
+ *	read the first line of a file without the trailing newline,
+ *	returns -1 if it cannot be read
+ */
+static int stress_mitigations_read_line(const char *path, char *buf, const size_t len)
+{
+	FILE *fp;
+	char *ptr;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (!fgets(buf, (int)len, fp)) {
+		(void)fclose(fp);
+		return -1;
+	}
+	(void)fclose(fp);
+	ptr = strchr(buf, '\n');
+	if (ptr)
+		*ptr = '\0';
+	return 0;
+}
+
+/*
+ *  stress_mitigations_cpu_model()
+ *	get the CPU model name from /proc/cpuinfo, falls
+ *	back to the machine architecture if not found
+ */
+static void stress_mitigations_cpu_model(char *buf, const size_t len)
+{
+	FILE *fp;
+	char line[256];
+
+	(void)shim_strlcpy(buf, "unknown", len);
+
+	fp = fopen("/proc/cpuinfo", "r");
+	if (!fp)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		char *ptr;
+
+		if (strncmp(line, "model name", 10) &&
+		    strncmp(line, "Processor", 9) &&
+		    strncmp(line, "cpu model", 9))
+			continue;
+		ptr = strchr(line, ':');
+		if (!ptr)
+			continue;
+		ptr++;
+		while (*ptr == ' ')
+			ptr++;
+		(void)shim_strlcpy(buf, ptr, len);
+		ptr = strchr(buf, '\n');
+		if (ptr)
+			*ptr = '\0';
+		break;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_mitigations_cmdline()
+ *	get the mitigations= kernel boot option, "auto" is
+ *	the kernel default if it is not set
+ */
+static void stress_mitigations_cmdline(char *buf, const size_t len)
+{
+	char cmdline[4096];
+	char *token, *saveptr = NULL;
+
+	(void)shim_strlcpy(buf, "auto", len);
+	if (stress_mitigations_read_line("/proc/cmdline", cmdline, sizeof(cmdline)) < 0)
+		return;
+	for (token = strtok_r(cmdline, " \t", &saveptr); token;
+	     token = strtok_r(NULL, " \t", &saveptr)) {
+		if (!strncmp(token, "mitigations=", 12))
+			(void)shim_strlcpy(buf, token + 12, len);
+	}
+}
+
+/*
+ *  stress_mitigations_vuln_cmp()
+ *	sort vulnerabilities by name
+ */
+static int stress_mitigations_vuln_cmp(const void *p1, const void *p2)
+{
+	const stress_mitigations_vuln_t *v1 = (const stress_mitigations_vuln_t *)p1;
+	const stress_mitigations_vuln_t *v2 = (const stress_mitigations_vuln_t *)p2;
+
+	return strcmp(v1->name, v2->name);
+}
+
+/*
+ *  stress_mitigations_init()
+ *	read the CPU vulnerability mitigation state of the system
+ */
+void stress_mitigations_init(void)
+{
+	DIR *dir;
+	const struct dirent *d;
+
+	if (!(g_opt_flags & OPT_FLAGS_MITIGATIONS))
+		return;
+
+	stress_mitigations_cpu_model(mitigations_cpu_model, sizeof(mitigations_cpu_model));
+	stress_mitigations_cmdline(mitigations_cmdline, sizeof(mitigations_cmdline));
+
+	mitigations_vulns_num = 0;
+	dir = opendir(MITIGATIONS_VULN_PATH);
+	if (!dir) {
+		pr_inf("mitigations: cannot read %s, CPU vulnerability "
+			"mitigations will not be reported\n", MITIGATIONS_VULN_PATH);
+		return;
+	}
+	while ((d = readdir(dir)) != NULL) {
+		stress_mitigations_vuln_t *vuln;
+		char path[PATH_MAX];
+
+		if (d->d_name[0] == '.')
+			continue;
+		if (mitigations_vulns_num >= MITIGATIONS_VULN_MAX)
+			break;
+		vuln = &mitigations_vulns[mitigations_vulns_num];
+		(void)snprintf(path, sizeof(path), "%s/%s", MITIGATIONS_VULN_PATH, d->d_name);
+		if (stress_mitigations_read_line(path, vuln->status, sizeof(vuln->status)) < 0)
+			continue;
+		(void)shim_strlcpy(vuln->name, d->d_name, sizeof(vuln->name));
+		mitigations_vulns_num++;
+	}
+	(void)closedir(dir);
+
+	qsort(mitigations_vulns, mitigations_vulns_num,
+		sizeof(*mitigations_vulns), stress_mitigations_vuln_cmp);
+}
+
+/*
+ *  stress_mitigations_cost()
+ *	get the mean run time per bogo op in nanoseconds of a stressor
+ *	and the geometric mean over the instances of the first per call
+ *	nanosecond cost metric it reports, description is NULL if
+ *	the stressor reports no such metric
+ */
+static void stress_mitigations_cost(
+	const stress_stressor_t *ss,
+	double *ns_per_op,
+	double *metric,
+	const char **description)
+{
+	int32_t j;
+	uint64_t ops = 0;
+	double duration = 0.0, log_metric = 0.0;
+	size_t i, n = 0;
+
+	*ns_per_op = 0.0;
+	*metric = 0.0;
+	*description = NULL;
+
+	for (j = 0; j < ss->num_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		ops += stats->ci.counter;
+		if (stats->finish > stats->start)
+			duration += stats->finish - stats->start;
+
+		for (i = 0; i < STRESS_MISC_METRICS_MAX; i++) {
+			const char *desc = stats->metrics[i].description;
+
+			if (!desc || (stats->metrics[i].value <= 0.0))
+				continue;
+			if (!strstr(desc, "nanosec") && !strstr(desc, "(ns)"))
+				continue;
+			if (!*description)
+				*description = desc;
+			if (!strcmp(*description, desc)) {
+				log_metric += log(stats->metrics[i].value);
+				n++;
+				break;
+			}
+		}
+	}
+	if (ops)
+		*ns_per_op = (duration * STRESS_DBL_NANOSECOND) / (double)ops;
+	if (n)
+		*metric = exp(log_metric / (double)n);
+}
+
+/*
+ *  stress_mitigations_dump()
+ *	report the mitigation state and the kernel entry/exit
+ *	cost of the stressors run under it
+ */
+void stress_mitigations_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t i;
+	bool costs = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_MITIGATIONS))
+		return;
+
+	pr_inf("mitigations: cpu '%s', mitigations=%s\n",
+		mitigations_cpu_model, mitigations_cmdline);
+	pr_yaml(yaml, "mitigations:\n");
+	pr_yaml(yaml, "      cpu-model: '%s'\n", mitigations_cpu_model);
+	pr_yaml(yaml, "      mitigations-boot-option: %s\n", mitigations_cmdline);
+
+	if (mitigations_vulns_num) {
+		pr_inf("mitigations: %-26s %s\n", "vulnerability", "status");
+		pr_yaml(yaml, "      vulnerabilities:\n");
+	}
+	for (i = 0; i < mitigations_vulns_num; i++) {
+		pr_inf("mitigations: %-26s %s\n",
+			mitigations_vulns[i].name, mitigations_vulns[i].status);
+		pr_yaml(yaml, "        %s: '%s'\n",
+			mitigations_vulns[i].name, mitigations_vulns[i].status);
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		double ns_per_op, metric;
+		const char *description;
+
+		if (!ss->num_instances || !stress_mitigations_stressor(ss->stressor->name))
+			continue;
+		stress_mitigations_cost(ss, &ns_per_op, &metric, &description);
+		if (ns_per_op <= 0.0)
+			continue;
+
+		if (!costs) {
+			pr_inf("mitigations: %-12s %14s %14s\n",
+				"stressor", "ns/bogo-op", "ns/call");
+			pr_yaml(yaml, "      kernel-entry-exit-costs:\n");
+			costs = true;
+		}
+		if (description) {
+			pr_inf("mitigations: %-12s %14.2f %14.2f (%s)\n",
+				ss->stressor->name, ns_per_op, metric, description);
+		} else {
+			pr_inf("mitigations: %-12s %14.2f %14s\n",
+				ss->stressor->name, ns_per_op, "-");
+		}
+		pr_yaml(yaml, "        - stressor: %s\n", ss->stressor->name);
+		pr_yaml(yaml, "          nanosecs-per-bogo-op: %f\n", ns_per_op);
+		if (description) {
+			pr_yaml(yaml, "          nanosecs-per-call: %f\n", metric);
+			pr_yaml(yaml, "          nanosecs-per-call-metric: '%s'\n", description);
+		}
+	}
+	if (!costs)
+		pr_inf("mitigations: none of the syscall, switch, get or x86syscall "
+			"stressors were run, no kernel entry/exit costs to report\n");
+	pr_yaml(yaml, "\n");
+}
+
+#else
+bool stress_mitigations_stressor(const char *name)
+{
+	(void)name;
+
+	return false;
+}
+
+void stress_mitigations_init(void)
+{
+	if (g_opt_flags & OPT_FLAGS_MITIGATIONS)
+		pr_inf("mitigations: CPU vulnerability mitigations are only "
+			"reported on Linux, ignoring --mitigations\n");
+}
+
+void stress_mitigations_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	(void)yaml;
+	(void)stressors_list;
+}
+#endif
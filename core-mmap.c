@@ -21,6 +21,14 @@
 #include "core-pragma.h"
 #include "core-cpu-cache.h"
 
+#if !defined(MAP_HUGE_2MB) && defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_2MB	(21 << MAP_HUGE_SHIFT)
+#endif
+
+#if !defined(MAP_HUGE_1GB) && defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_1GB	(30 << MAP_HUGE_SHIFT)
+#endif
+
 /*
  *  stress_mmap_set()
  *	set mmap'd data, touching pages in
@@ -146,3 +154,158 @@ int OPTIMIZE3 stress_mmap_check(
 	}
 	return 0;
 }
+
+/*
+ *  big buffer memory backings, flags are extra mmap flags or -1 if
+ *  the backing is not supported, advice is the madvise advice to
+ *  apply or -1 for none
+ */
+typedef struct {
+	const char *name;		/* --*-backing name */
+	const int flags;		/* mmap flags */
+	const int advice;		/* madvise advice */
+	const size_t page_size;		/* backing page size */
+} stress_mmap_backing_info_t;
+
+static const stress_mmap_backing_info_t mmap_backings[] = {
+#if defined(MADV_NOHUGEPAGE)
+	{ "4k",		0,	MADV_NOHUGEPAGE,	4 * KB },
+#else
+	{ "4k",		0,	-1,			4 * KB },
+#endif
+#if defined(MADV_HUGEPAGE)
+	{ "thp",	0,	MADV_HUGEPAGE,		2 * MB },
+#else
+	{ "thp",	-1,	-1,			2 * MB },
+#endif
+#if defined(MAP_HUGETLB) &&	\
+    defined(MAP_HUGE_2MB)
+	{ "2m",		MAP_HUGETLB | MAP_HUGE_2MB,	-1,	2 * MB },
+#else
+	{ "2m",		-1,	-1,			2 * MB },
+#endif
+#if defined(MAP_HUGETLB) &&	\
+    defined(MAP_HUGE_1GB)
+	{ "1g",		MAP_HUGETLB | MAP_HUGE_1GB,	-1,	1 * GB },
+#else
+	{ "1g",		-1,	-1,			1 * GB },
+#endif
+};
+
+/*
+ *  stress_set_mmap_backing()
+ *	parse a 4k, thp, 2m or 1g backing option and save
+ *	it as size_t setting name
+ */
+int stress_set_mmap_backing(const char *name, const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(mmap_backings); i++) {
+		if (!strcmp(opt, mmap_backings[i].name))
+			return stress_set_setting(name, TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "invalid %s option '%s', allowed backings are:", name, opt);
+	for (i = 0; i < SIZEOF_ARRAY(mmap_backings); i++)
+		(void)fprintf(stderr, " %s", mmap_backings[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_mmap_backing_name()
+ *	return name of a backing set by stress_set_mmap_backing()
+ */
+const char *stress_mmap_backing_name(const size_t backing)
+{
+	return (backing < SIZEOF_ARRAY(mmap_backings)) ?
+		mmap_backings[backing].name : "unknown";
+}
+
+/*
+ *  stress_mmap_backing_page_size()
+ *	return page size of a backing set by stress_set_mmap_backing()
+ */
+size_t stress_mmap_backing_page_size(const size_t backing)
+{
+	const size_t page_size = stress_get_page_size();
+
+	if (backing >= SIZEOF_ARRAY(mmap_backings))
+		return page_size;
+	return STRESS_MAXIMUM(mmap_backings[backing].page_size, page_size);
+}
+
+/*
+ *  stress_mmap_backing()
+ *	mmap *sz bytes with the given backing, *sz is rounded up to
+ *	a multiple of the backing page size and must be passed to
+ *	munmap. Transparent huge page mappings are aligned to the huge
+ *	page size so the whole mapping can be huge page backed. Returns
+ *	MAP_FAILED on failure, errno is ENOTSUP if the backing is not
+ *	supported.
+ */
+void *stress_mmap_backing(
+	const size_t backing,
+	size_t *sz,
+	const int prot,
+	const int flags)
+{
+	const stress_mmap_backing_info_t *info;
+	const size_t page_size = stress_get_page_size();
+	size_t len, align;
+	uint8_t *ptr;
+	int mmap_flags = flags;
+	bool populate = false;
+
+	if (backing >= SIZEOF_ARRAY(mmap_backings)) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	info = &mmap_backings[backing];
+	if (info->flags < 0) {
+		errno = ENOTSUP;
+		return MAP_FAILED;
+	}
+	align = stress_mmap_backing_page_size(backing);
+	len = (*sz + align - 1) & ~(align - 1);
+	if (len < *sz) {
+		errno = ENOMEM;
+		return MAP_FAILED;
+	}
+
+#if defined(MAP_POPULATE)
+	/* advice has to be applied before the pages are populated */
+	if ((info->advice >= 0) && (flags & MAP_POPULATE)) {
+		mmap_flags &= ~MAP_POPULATE;
+		populate = (prot & PROT_WRITE) != 0;
+	}
+#endif
+
+	if ((info->flags == 0) && (align > page_size)) {
+		/* over-allocate and trim to get an aligned mapping */
+		uint8_t *aligned;
+
+		ptr = (uint8_t *)mmap(NULL, len + align, prot, mmap_flags, -1, 0);
+		if (ptr == MAP_FAILED)
+			return MAP_FAILED;
+		aligned = (uint8_t *)stress_align_address(ptr, align);
+		if (aligned > ptr)
+			(void)munmap((void *)ptr, (size_t)(aligned - ptr));
+		(void)munmap((void *)(aligned + len), (size_t)((ptr + align) - aligned));
+		ptr = aligned;
+	} else {
+		ptr = (uint8_t *)mmap(NULL, len, prot, mmap_flags | info->flags, -1, 0);
+		if (ptr == MAP_FAILED)
+			return MAP_FAILED;
+	}
+	if (info->advice >= 0)
+		(void)shim_madvise((void *)ptr, len, info->advice);
+	if (populate) {
+		size_t i;
+
+		for (i = 0; i < len; i += page_size)
+			ptr[i] = 0;
+	}
+	*sz = len;
+	return (void *)ptr;
+}
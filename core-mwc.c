@@ -32,24 +32,42 @@
 #define STRESS_MWC_SEED_Z	(362436069UL)
 #define STRESS_MWC_SEED_W	(521288629UL)
 
+/* Parallel MWC generators used by stress_mwc_fill() */
+#define STRESS_MWC_LANES	(8)
+
 /* Fast random number generator state */
 typedef struct {
 	uint32_t w;
 	uint32_t z;
 } stress_mwc_t;
 
-static stress_mwc_t mwc = {
+/*
+ *  thread local state so that threads (e.g. vm --vm-threads)
+ *  can regenerate their own random sequences for verification
+ */
+static THREAD_LOCAL stress_mwc_t mwc = {
 	STRESS_MWC_SEED_W,
 	STRESS_MWC_SEED_Z
 };
 
-static uint8_t mwc_n1, mwc_n8, mwc_n16;
+static THREAD_LOCAL uint8_t mwc_n1, mwc_n8, mwc_n16;
+
+/*
+ *  per lane state for stress_mwc_fill(), the lanes are seeded
+ *  from mwc so they are reseeded whenever the mwc seed changes
+ */
+static THREAD_LOCAL struct {
+	uint32_t w[STRESS_MWC_LANES];
+	uint32_t z[STRESS_MWC_LANES];
+	bool seeded;
+} mwc_lanes;
 
 static inline void mwc_flush(void)
 {
 	mwc_n1 = 0;
 	mwc_n8 = 0;
 	mwc_n16 = 0;
+	mwc_lanes.seeded = false;
 }
 
 #if defined(HAVE_SYS_AUXV_H) && \
@@ -198,7 +216,7 @@ HOT OPTIMIZE3 uint64_t stress_mwc64(void)
  */
 HOT OPTIMIZE3 uint16_t stress_mwc16(void)
 {
-	static uint32_t mwc_saved;
+	static THREAD_LOCAL uint32_t mwc_saved;
 
 	if (LIKELY(mwc_n16)) {
 		mwc_n16--;
@@ -216,7 +234,7 @@ HOT OPTIMIZE3 uint16_t stress_mwc16(void)
  */
 HOT OPTIMIZE3 uint8_t stress_mwc8(void)
 {
-	static uint32_t mwc_saved;
+	static THREAD_LOCAL uint32_t mwc_saved;
 
 	if (LIKELY(mwc_n8)) {
 		mwc_n8--;
@@ -234,7 +252,7 @@ HOT OPTIMIZE3 uint8_t stress_mwc8(void)
  */
 HOT OPTIMIZE3 uint8_t stress_mwc1(void)
 {
-	static uint32_t mwc_saved;
+	static THREAD_LOCAL uint32_t mwc_saved;
 
 	if (LIKELY(mwc_n1)) {
 		mwc_n1--;
@@ -246,6 +264,61 @@ HOT OPTIMIZE3 uint8_t stress_mwc1(void)
 	return mwc_saved & 0x1;
 }
 
+/*
+ *  stress_mwc_lanes_seed()
+ *	seed the fill lanes from mwc, the seeds are kept in the
+ *	range 1..(multiplier * 65536 - 2) to avoid the stuck zero
+ *	and fixed point states of the generators
+ */
+static void stress_mwc_lanes_seed(void)
+{
+	size_t i;
+
+	for (i = 0; i < STRESS_MWC_LANES; i++) {
+		mwc_lanes.z[i] = stress_mwc32modn((36969UL << 16) - 2) + 1;
+		mwc_lanes.w[i] = stress_mwc32modn((18000UL << 16) - 2) + 1;
+	}
+	mwc_lanes.seeded = true;
+}
+
+/*
+ *  stress_mwc_fill()
+ *	fill a buffer with pseudo random data, this runs
+ *	STRESS_MWC_LANES independent multiply-with-carry
+ *	generators in parallel so the generator loop can be
+ *	vectorized and is much faster than filling a buffer
+ *	one stress_mwc8() or stress_mwc32() at a time
+ */
+void OPTIMIZE3 TARGET_CLONES stress_mwc_fill(void *buf, const size_t len)
+{
+	uint32_t w[STRESS_MWC_LANES], z[STRESS_MWC_LANES];
+	uint8_t *ptr = (uint8_t *)buf;
+	const uint8_t *end = ptr + len;
+	size_t i;
+
+	if (UNLIKELY(!mwc_lanes.seeded))
+		stress_mwc_lanes_seed();
+	(void)memcpy(w, mwc_lanes.w, sizeof(w));
+	(void)memcpy(z, mwc_lanes.z, sizeof(z));
+
+	while ((size_t)(end - ptr) >= sizeof(uint32_t) * STRESS_MWC_LANES) {
+		uint32_t v[STRESS_MWC_LANES];
+
+		for (i = 0; i < STRESS_MWC_LANES; i++) {
+			z[i] = 36969 * (z[i] & 65535) + (z[i] >> 16);
+			w[i] = 18000 * (w[i] & 65535) + (w[i] >> 16);
+			v[i] = (z[i] << 16) + w[i];
+		}
+		(void)memcpy(ptr, v, sizeof(v));
+		ptr += sizeof(v);
+	}
+	(void)memcpy(mwc_lanes.w, w, sizeof(w));
+	(void)memcpy(mwc_lanes.z, z, sizeof(z));
+
+	while (ptr < end)
+		*ptr++ = stress_mwc8();
+}
+
 /*
  *  stress_mwc8modn()
  *	see https://research.kudelskisecurity.com/2020/07/28/the-definitive-guide-to-modulo-bias-and-how-to-avoid-it/
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-net-bench.h"
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NET_BENCH_PROBE_SIZE	(64)		/* probe message size */
+#define NET_BENCH_PROBE_EVERY	(16)		/* bulk messages per probe */
+#define NET_BENCH_BUF_SIZE	(256 * KB)	/* receive buffer size */
+
+#define NET_BENCH_BULK		(1)
+#define NET_BENCH_PROBE		(2)
+
+const size_t stress_net_bench_sizes[NET_BENCH_SIZES] = {
+	1 * KB, 16 * KB, 64 * KB
+};
+
+/* header at the start of each message */
+typedef struct {
+	uint32_t len;			/* message length including the header */
+	uint32_t type;			/* NET_BENCH_BULK or NET_BENCH_PROBE */
+	uint64_t stamp;			/* probe send time, nanoseconds */
+} stress_net_bench_hdr_t;
+
+/* receive state of the message stream */
+typedef struct {
+	stress_net_bench_hdr_t hdr;	/* header being received */
+	size_t hdr_have;		/* header bytes received */
+	size_t body_left;		/* message bytes after the header still to come */
+} stress_net_bench_stream_t;
+
+/*
+ *  stress_net_bench_now()
+ *	monotonic time in nanoseconds that is comparable
+ *	between the sender and receiver processes
+ */
+static uint64_t stress_net_bench_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_net_bench_send_msg()
+ *	send a whole message, stream sockets may take part of it
+ *	at a time, returns 0 or -1 on error
+ */
+static int OPTIMIZE3 stress_net_bench_send_msg(
+	const int fd,
+	const uint8_t *buf,
+	const size_t len)
+{
+	size_t sent = 0;
+
+	while (sent < len) {
+		const ssize_t n = send(fd, buf + sent, len - sent, MSG_NOSIGNAL);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		sent += (size_t)n;
+	}
+	return 0;
+}
+
+/*
+ *  stress_net_bench_sender()
+ *	connect to the receiver and send bulk messages with a small
+ *	time stamped probe message after every NET_BENCH_PROBE_EVERY
+ *	bulk messages for secs seconds, the probes queue behind the
+ *	bulk messages in the same stream
+ */
+static void stress_net_bench_sender(
+	const stress_net_bench_transport_t *transport,
+	const struct sockaddr_in *addr,
+	const size_t msg_size,
+	const double secs)
+{
+	stress_net_bench_hdr_t hdr;
+	uint8_t probe[NET_BENCH_PROBE_SIZE];
+	uint8_t *buf;
+	uint64_t i;
+	double t_end;
+	int fd, retries;
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	buf = (uint8_t *)mmap(NULL, msg_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return;
+	(void)memset(buf, 'A', msg_size);
+	(void)memset(probe, 'P', sizeof(probe));
+
+	fd = socket(AF_INET, SOCK_STREAM, transport->protocol);
+	if (fd < 0)
+		goto unmap;
+	for (retries = 0; connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0; retries++) {
+		if (retries > 100)
+			goto close_fd;
+		(void)shim_usleep(10000);
+	}
+
+	hdr.len = (uint32_t)msg_size;
+	hdr.type = NET_BENCH_BULK;
+	hdr.stamp = 0;
+	(void)memcpy(buf, &hdr, sizeof(hdr));
+
+	t_end = stress_time_now() + secs;
+	for (i = 0; keep_stressing_flag() && (stress_time_now() < t_end); i++) {
+		if (stress_net_bench_send_msg(fd, buf, msg_size) < 0)
+			break;
+		if ((i % NET_BENCH_PROBE_EVERY) == 0) {
+			hdr.len = (uint32_t)sizeof(probe);
+			hdr.type = NET_BENCH_PROBE;
+			hdr.stamp = stress_net_bench_now();
+			(void)memcpy(probe, &hdr, sizeof(hdr));
+			if (stress_net_bench_send_msg(fd, probe, sizeof(probe)) < 0)
+				break;
+		}
+	}
+close_fd:
+	(void)close(fd);
+unmap:
+	(void)munmap((void *)buf, msg_size);
+}
+
+/*
+ *  stress_net_bench_parse()
+ *	walk the messages in a received buffer, adding
+ *	the probe latencies and returning the bulk bytes, or -1 if
+ *	a message header is corrupt
+ */
+static ssize_t OPTIMIZE3 stress_net_bench_parse(
+	stress_net_bench_stream_t *s,
+	const uint8_t *buf,
+	const size_t len,
+	const uint64_t now,
+	stress_latency_t *latency)
+{
+	size_t off = 0, bulk = 0;
+
+	while (off < len) {
+		size_t n;
+
+		if (s->body_left) {
+			n = STRESS_MINIMUM(s->body_left, len - off);
+			s->body_left -= n;
+			off += n;
+			continue;
+		}
+		n = STRESS_MINIMUM(sizeof(s->hdr) - s->hdr_have, len - off);
+		(void)memcpy((uint8_t *)&s->hdr + s->hdr_have, buf + off, n);
+		s->hdr_have += n;
+		off += n;
+		if (s->hdr_have < sizeof(s->hdr))
+			break;
+		s->hdr_have = 0;
+		if (s->hdr.len < sizeof(s->hdr))
+			return -1;
+		s->body_left = s->hdr.len - sizeof(s->hdr);
+		if (s->hdr.type == NET_BENCH_PROBE) {
+			if (now > s->hdr.stamp)
+				stress_latency_add(latency, now - s->hdr.stamp);
+		} else {
+			bulk += s->hdr.len;
+		}
+	}
+	return (ssize_t)bulk;
+}
+
+/*
+ *  stress_net_bench_run()
+ *	listen on loopback port, fork a sender and receive its bulk and
+ *	probe messages, accumulating the bulk bytes per second, the probe
+ *	latencies and the number of subflows in result
+ */
+void stress_net_bench_run(
+	const stress_args_t *args,
+	const stress_net_bench_transport_t *transport,
+	const int port,
+	const size_t msg_size,
+	const double secs,
+	stress_net_bench_result_t *result)
+{
+	stress_net_bench_stream_t stream;
+	struct sockaddr_in addr;
+	uint8_t *buf;
+	double t_start = 0.0, t_end = 0.0;
+	uint64_t recvs = 0;
+	pid_t pid;
+	int lfd, sfd, status, one = 1;
+	ssize_t n;
+
+	(void)shim_strlcpy(result->label, transport->name, sizeof(result->label));
+	result->msg_size = msg_size;
+
+	buf = (uint8_t *)mmap(NULL, NET_BENCH_BUF_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		result->err = ENOMEM;
+		return;
+	}
+
+	lfd = socket(AF_INET, SOCK_STREAM, transport->protocol);
+	if (lfd < 0) {
+		result->err = errno;
+		goto unmap;
+	}
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) ||
+	    (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+	    (listen(lfd, 1) < 0)) {
+		result->err = errno;
+		goto close_lfd;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		result->err = errno;
+		goto close_lfd;
+	} else if (pid == 0) {
+		(void)close(lfd);
+		stress_net_bench_sender(transport, &addr, msg_size, secs);
+		_exit(0);
+	}
+
+#if defined(HAVE_POLL_H)
+	{
+		struct pollfd pfd;
+
+		pfd.fd = lfd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 5000) <= 0) {
+			result->err = ETIMEDOUT;
+			goto reap;
+		}
+	}
+#endif
+	sfd = accept(lfd, NULL, NULL);
+	if (sfd < 0) {
+		result->err = errno;
+		goto reap;
+	}
+
+	(void)memset(&stream, 0, sizeof(stream));
+	for (;;) {
+		ssize_t bulk;
+
+		n = recv(sfd, buf, NET_BENCH_BUF_SIZE, 0);
+		if (n <= 0) {
+			if ((n < 0) && (errno == EINTR) && keep_stressing_flag())
+				continue;
+			break;
+		}
+		t_end = stress_time_now();
+		if (t_start == 0.0)
+			t_start = t_end;
+		bulk = stress_net_bench_parse(&stream, buf, (size_t)n,
+			stress_net_bench_now(), &result->latency);
+		if (bulk < 0) {
+			result->err = EBADMSG;
+			break;
+		}
+		result->bytes += (double)bulk;
+		if (transport->subflows && ((recvs++ & 1023) == 0)) {
+			const uint32_t subflows = transport->subflows(sfd);
+
+			if (subflows > result->subflows)
+				result->subflows = subflows;
+		}
+	}
+	result->secs += t_end - t_start;
+	add_counter(args, recvs);
+	(void)close(sfd);
+reap:
+	(void)kill(pid, SIGKILL);
+	(void)shim_waitpid(pid, &status, 0);
+close_lfd:
+	(void)close(lfd);
+unmap:
+	(void)munmap((void *)buf, NET_BENCH_BUF_SIZE);
+}
+
+/*
+ *  stress_net_bench_report()
+ *	print the bulk throughput and probe latencies of each transport
+ *	at each message size and set them as metrics, probes queue behind
+ *	bulk messages sent on the same stream (head of line blocking)
+ */
+void stress_net_bench_report(
+	const stress_args_t *args,
+	const stress_net_bench_result_t *results,
+	const size_t n)
+{
+	size_t i, idx = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %-20s %8s %10s %12s %12s %8s\n", args->name,
+			"transport", "msg size", "MB/sec", "probe p50us",
+			"probe p99us", "subflows");
+	}
+	for (i = 0; i < n; i++) {
+		const stress_net_bench_result_t *r = &results[i];
+		double p50, p99;
+		char str[64];
+
+		if (r->err) {
+			if ((args->instance == 0) && ((i == 0) || strcmp(r->label, results[i - 1].label)))
+				pr_inf("%s: %-20s not available, errno=%d (%s)\n",
+					args->name, r->label, r->err, strerror(r->err));
+			continue;
+		}
+		if (r->secs <= 0.0)
+			continue;
+		p50 = (double)stress_latency_percentile(&r->latency, 50.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		p99 = (double)stress_latency_percentile(&r->latency, 99.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		if (args->instance == 0) {
+			char subflows[16];
+
+			if (r->subflows)
+				(void)snprintf(subflows, sizeof(subflows), "%" PRIu32, r->subflows);
+			else
+				(void)shim_strlcpy(subflows, "-", sizeof(subflows));
+			pr_inf("%s: %-20s %8zu %10.1f %12.1f %12.1f %8s\n", args->name,
+				r->label, r->msg_size, r->bytes / r->secs / (double)MB,
+				p50, p99, subflows);
+		}
+		(void)snprintf(str, sizeof(str), "%s %zuK MB per sec", r->label, r->msg_size / (size_t)KB);
+		stress_metrics_set(args, idx++, str, r->bytes / r->secs / (double)MB);
+		(void)snprintf(str, sizeof(str), "%s %zuK probe p99 usec", r->label, r->msg_size / (size_t)KB);
+		stress_metrics_set(args, idx++, str, p99);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+}
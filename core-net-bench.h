@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_NET_BENCH_H
+#define CORE_NET_BENCH_H
+
+#define NET_BENCH_LABEL_LEN	(32)
+#define NET_BENCH_SIZES		(3)	/* message sizes benchmarked */
+
+/* message sizes, the same for each transport */
+extern const size_t stress_net_bench_sizes[NET_BENCH_SIZES];
+
+/* a transport to benchmark over loopback */
+typedef struct stress_net_bench_transport {
+	const char *name;		/* transport name for the results */
+	int protocol;			/* IPPROTO_TCP or IPPROTO_MPTCP */
+	/* optional number of subflows of a connection */
+	uint32_t (*subflows)(const int fd);
+} stress_net_bench_transport_t;
+
+/* accumulated results of a transport at a message size */
+typedef struct {
+	char label[NET_BENCH_LABEL_LEN];	/* transport name */
+	size_t msg_size;		/* bulk message size in bytes */
+	int err;			/* errno if the transport cannot be used */
+	double bytes;			/* bulk bytes received */
+	double secs;			/* seconds receiving */
+	uint32_t subflows;		/* subflows seen by the receiver */
+	stress_latency_t latency;	/* one way latencies of probe messages */
+} stress_net_bench_result_t;
+
+/* send bulk messages and probes for secs seconds and accumulate the results */
+extern void stress_net_bench_run(const stress_args_t *args,
+	const stress_net_bench_transport_t *transport, const int port,
+	const size_t msg_size, const double secs, stress_net_bench_result_t *result);
+
+/* results table and metrics of n results */
+extern void stress_net_bench_report(const stress_args_t *args,
+	const stress_net_bench_result_t *results, const size_t n);
+
+#endif
@@ -31,6 +31,9 @@ UNEXPECTED
 #if defined(HAVE_IFADDRS_H)
 #include <ifaddrs.h>
 #endif
+#if defined(HAVE_NETDB_H)
+#include <netdb.h>
+#endif
 #if defined(HAVE_NET_IF_H)
 #include <net/if.h>
 #endif
@@ -303,6 +306,55 @@ void HOT stress_set_sockaddr_port(
 	}
 }
 
+/*
+ *  stress_net_peer_addr()
+ *	resolve the host name or address of a remote peer in a domain
+ *	into a socket address with a port, returns -1 if failed
+ */
+int stress_net_peer_addr(
+	const char *name,
+	const char *host,
+	const int domain,
+	const int port,
+	struct sockaddr_storage *addr,
+	socklen_t *len)
+{
+#if defined(HAVE_NETDB_H)
+	struct addrinfo hints, *res = NULL;
+	int ret;
+
+	(void)memset(&hints, 0, sizeof(hints));
+	hints.ai_family = domain;
+	hints.ai_socktype = SOCK_STREAM;
+
+	ret = getaddrinfo(host, NULL, &hints, &res);
+	if ((ret != 0) || !res) {
+		pr_inf("%s: cannot resolve %s peer '%s', %s\n", name,
+			stress_net_domain(domain), host, gai_strerror(ret));
+		return -1;
+	}
+	if (res->ai_addrlen > sizeof(*addr)) {
+		freeaddrinfo(res);
+		return -1;
+	}
+	(void)memset(addr, 0, sizeof(*addr));
+	(void)memcpy(addr, res->ai_addr, res->ai_addrlen);
+	*len = res->ai_addrlen;
+	freeaddrinfo(res);
+	stress_set_sockaddr_port(domain, port, (struct sockaddr *)addr);
+
+	return 0;
+#else
+	(void)domain;
+	(void)port;
+	(void)addr;
+	(void)len;
+
+	pr_inf("%s: cannot resolve peer '%s', netdb.h not available\n", name, host);
+	return -1;
+#endif
+}
+
 /*
  *  stress_net_port_range_ok()
  *	port range sanity check, returns true if OK
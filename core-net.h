@@ -43,6 +43,8 @@ extern WARN_UNUSED int stress_set_sockaddr(const char *name, const uint32_t inst
 	struct sockaddr **sockaddr, socklen_t *len, const int net_addr);
 extern void stress_set_sockaddr_port(const int domain, const int port,
 	struct sockaddr *sockaddr);
+extern WARN_UNUSED int stress_net_peer_addr(const char *name, const char *host,
+	const int domain, const int port, struct sockaddr_storage *addr, socklen_t *len);
 extern int stress_net_interface_exists(const char *interface, const int domain, struct sockaddr *addr);
 extern WARN_UNUSED const char *stress_net_domain(const int domain);
 
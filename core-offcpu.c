@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-offcpu.h"
+
+/*
+ *  Off-CPU time of each stressor instance is derived from the
+ *  scheduler and delay accounting statistics of the instance:
+ *
+ *   on-CPU	sum of the task schedstat run times
+ *   runqueue	sum of the task schedstat run delays, time spent
+ *		runnable but waiting for a CPU
+ *   I/O	block I/O delay accounting, needs kernel.task_delayacct=1
+ *   sleep	the remaining off-CPU time, voluntary waits such as
+ *		futex, poll, sleep and socket waits
+ *
+ *  Major page faults are counted as the time waiting for them
+ *  is not split out by the kernel without tracing.
+ */
+
+/* totals of an instance's offcpu data */
+typedef struct {
+	double wall;
+	double oncpu;
+	double runq;
+	double io;
+	double sleep;
+	uint64_t vcsw;
+	uint64_t ivcsw;
+	uint64_t majflt;
+	int32_t n;
+} stress_offcpu_sum_t;
+
+/*
+ *  stress_offcpu_init()
+ *	note if I/O delay accounting is disabled
+ */
+void stress_offcpu_init(void)
+{
+	char buf[16];
+
+	if (!(g_opt_flags & OPT_FLAGS_OFFCPU))
+		return;
+#if defined(__linux__)
+	if ((system_read("/proc/sys/kernel/task_delayacct", buf, sizeof(buf)) > 0) &&
+	    (atoi(buf) == 0))
+		pr_inf("offcpu: I/O wait is not accounted, kernel.task_delayacct is disabled\n");
+#else
+	(void)buf;
+	pr_inf("offcpu: off-CPU accounting is only available on Linux\n");
+#endif
+}
+
+#if defined(__linux__)
+/*
+ *  stress_offcpu_schedstat()
+ *	sum the run and run delay times and the number of timeslices
+ *	of all the threads, and the CPU migrations if migrations is
+ *	not NULL
+ */
+static void stress_offcpu_schedstat(
+	double *oncpu,
+	double *runq,
+	uint64_t *slices,
+	uint64_t *migrations)
+{
+	DIR *dp;
+	const struct dirent *de;
+	uint64_t run_ns = 0, delay_ns = 0, n_slices = 0, n_migrations = 0;
+
+	dp = opendir("/proc/self/task");
+	if (dp) {
+		while ((de = readdir(dp)) != NULL) {
+			char path[PATH_MAX], buf[128];
+			uint64_t run, delay, n;
+
+			if (!isdigit((unsigned char)de->d_name[0]))
+				continue;
+			(void)snprintf(path, sizeof(path), "/proc/self/task/%s/schedstat", de->d_name);
+			if ((system_read(path, buf, sizeof(buf)) > 0) &&
+			    (sscanf(buf, "%" SCNu64 " %" SCNu64 " %" SCNu64, &run, &delay, &n) == 3)) {
+				run_ns += run;
+				delay_ns += delay;
+				n_slices += n;
+			}
+			if (migrations) {
+				FILE *fp;
+
+				(void)snprintf(path, sizeof(path), "/proc/self/task/%s/sched", de->d_name);
+				fp = fopen(path, "r");
+				if (!fp)
+					continue;
+				while (fgets(buf, sizeof(buf), fp)) {
+					if (!strncmp(buf, "se.nr_migrations", 16)) {
+						const char *ptr = strchr(buf, ':');
+
+						if (ptr && (sscanf(ptr + 1, "%" SCNu64, &n) == 1))
+							n_migrations += n;
+						break;
+					}
+				}
+				(void)fclose(fp);
+			}
+		}
+		(void)closedir(dp);
+	}
+	*oncpu = (double)run_ns / STRESS_DBL_NANOSECOND;
+	*runq = (double)delay_ns / STRESS_DBL_NANOSECOND;
+	if (slices)
+		*slices = n_slices;
+	if (migrations)
+		*migrations = n_migrations;
+}
+
+/*
+ *  stress_offcpu_blkio()
+ *	block I/O delay in seconds, field 42 of /proc/self/stat
+ */
+static double stress_offcpu_blkio(void)
+{
+	char buf[1024], *ptr;
+	unsigned long long ticks = 0;
+	long int clk_tck;
+	int field;
+
+	if (system_read("/proc/self/stat", buf, sizeof(buf)) <= 0)
+		return 0.0;
+	/* skip over the command name, it may contain spaces */
+	ptr = strrchr(buf, ')');
+	if (!ptr)
+		return 0.0;
+	/* field 3 (state) follows the command name */
+	for (field = 2; *ptr && (field < 42); ptr++) {
+		if (*ptr == ' ')
+			field++;
+	}
+	if ((field != 42) || (sscanf(ptr, "%llu", &ticks) != 1))
+		return 0.0;
+	clk_tck = sysconf(_SC_CLK_TCK);
+	return (clk_tck > 0) ? (double)ticks / (double)clk_tck : 0.0;
+}
+#endif
+
+/*
+ *  stress_offcpu_read()
+ *	read the current accounting of the calling stressor instance
+ */
+static void stress_offcpu_read(stress_offcpu_t *offcpu)
+{
+#if defined(HAVE_GETRUSAGE)
+	struct rusage usage;
+#endif
+
+	(void)memset(offcpu, 0, sizeof(*offcpu));
+#if defined(__linux__)
+	stress_offcpu_schedstat(&offcpu->oncpu, &offcpu->runq, NULL, NULL);
+	offcpu->io = stress_offcpu_blkio();
+#endif
+#if defined(HAVE_GETRUSAGE)
+	if (shim_getrusage(RUSAGE_SELF, &usage) == 0) {
+		offcpu->vcsw = (uint64_t)usage.ru_nvcsw;
+		offcpu->ivcsw = (uint64_t)usage.ru_nivcsw;
+		offcpu->majflt = (uint64_t)usage.ru_majflt;
+	}
+#endif
+}
+
+/*
+ *  stress_offcpu_begin()
+ *	snapshot the accounting at the start of a stressor instance
+ */
+void stress_offcpu_begin(stress_offcpu_t *offcpu)
+{
+	if (!(g_opt_flags & OPT_FLAGS_OFFCPU))
+		return;
+	stress_offcpu_read(offcpu);
+}
+
+/*
+ *  stress_offcpu_end()
+ *	turn the snapshot into the accounting of the stressor run
+ */
+void stress_offcpu_end(stress_offcpu_t *offcpu, const double wall_time)
+{
+	stress_offcpu_t now;
+	double offcpu_time;
+
+	if (!(g_opt_flags & OPT_FLAGS_OFFCPU))
+		return;
+	stress_offcpu_read(&now);
+
+	offcpu->wall = wall_time;
+	offcpu->oncpu = STRESS_MAXIMUM(0.0, now.oncpu - offcpu->oncpu);
+	offcpu->runq = STRESS_MAXIMUM(0.0, now.runq - offcpu->runq);
+	offcpu->io = STRESS_MAXIMUM(0.0, now.io - offcpu->io);
+	offcpu->vcsw = now.vcsw - offcpu->vcsw;
+	offcpu->ivcsw = now.ivcsw - offcpu->ivcsw;
+	offcpu->majflt = now.majflt - offcpu->majflt;
+
+	/*
+	 *  threads run in parallel so on-CPU time can exceed the
+	 *  wall clock time, the off-CPU time is what remains of the
+	 *  wall clock time of the instance
+	 */
+	offcpu_time = STRESS_MAXIMUM(0.0, wall_time - offcpu->oncpu);
+	offcpu->sleep = STRESS_MAXIMUM(0.0, offcpu_time - offcpu->runq - offcpu->io);
+	offcpu->valid = true;
+}
+
+/*
+ *  stress_offcpu_sum()
+ *	average the off-CPU accounting of the instances of a stressor
+ */
+static bool stress_offcpu_sum(const stress_stressor_t *ss, stress_offcpu_sum_t *sum)
+{
+	int32_t j;
+
+	(void)memset(sum, 0, sizeof(*sum));
+	if (!ss->stats)
+		return false;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_offcpu_t *offcpu = &ss->stats[j]->offcpu;
+
+		if (!offcpu->valid)
+			continue;
+		sum->wall += offcpu->wall;
+		sum->oncpu += offcpu->oncpu;
+		sum->runq += offcpu->runq;
+		sum->io += offcpu->io;
+		sum->sleep += offcpu->sleep;
+		sum->vcsw += offcpu->vcsw;
+		sum->ivcsw += offcpu->ivcsw;
+		sum->majflt += offcpu->majflt;
+		sum->n++;
+	}
+	if (!sum->n)
+		return false;
+
+	sum->wall /= (double)sum->n;
+	sum->oncpu /= (double)sum->n;
+	sum->runq /= (double)sum->n;
+	sum->io /= (double)sum->n;
+	sum->sleep /= (double)sum->n;
+	return true;
+}
+
+/*
+ *  stress_offcpu_yaml()
+ *	dump the off-CPU accounting of a stressor to the yaml file
+ */
+void stress_offcpu_yaml(FILE *yaml, const stress_stressor_t *ss)
+{
+	stress_offcpu_sum_t sum;
+
+	if (!(g_opt_flags & OPT_FLAGS_OFFCPU))
+		return;
+	if (!stress_offcpu_sum(ss, &sum))
+		return;
+
+	pr_yaml(yaml, "      on-cpu-time: %f\n", sum.oncpu);
+	pr_yaml(yaml, "      off-cpu-runqueue-time: %f\n", sum.runq);
+	pr_yaml(yaml, "      off-cpu-io-time: %f\n", sum.io);
+	pr_yaml(yaml, "      off-cpu-sleep-time: %f\n", sum.sleep);
+	pr_yaml(yaml, "      voluntary-context-switches: %" PRIu64 "\n", sum.vcsw);
+	pr_yaml(yaml, "      involuntary-context-switches: %" PRIu64 "\n", sum.ivcsw);
+	pr_yaml(yaml, "      major-page-faults: %" PRIu64 "\n", sum.majflt);
+}
+
+/*
+ *  stress_offcpu_dump()
+ *	dump the off-CPU accounting of all the stressors, times
+ *	are averaged per instance, counts are totals
+ */
+void stress_offcpu_dump(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool header = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_OFFCPU))
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_offcpu_sum_t sum;
+
+		if (!stress_offcpu_sum(ss, &sum))
+			continue;
+
+		if (!header) {
+			pr_metrics("off-CPU time per instance (secs):\n");
+			pr_metrics("%-13s %9s %9s %9s %9s %9s %6s %11s %11s %9s\n",
+				"stressor", "wall", "on-cpu", "runqueue", "I/O",
+				"sleep", "runq%", "vol-ctxsw", "invol-ctxsw", "maj-flt");
+			header = true;
+		}
+		pr_metrics("%-13s %9.2f %9.2f %9.2f %9.2f %9.2f %6.2f %11" PRIu64
+			" %11" PRIu64 " %9" PRIu64 "\n",
+			stress_munge_underscore(ss->stressor->name),
+			sum.wall, sum.oncpu, sum.runq, sum.io, sum.sleep,
+			sum.wall > 0.0 ? 100.0 * sum.runq / sum.wall : 0.0,
+			sum.vcsw, sum.ivcsw, sum.majflt);
+	}
+}
+
+/*
+ *  stress_schedstat_read()
+ *	read the scheduler statistics of the calling stressor instance
+ */
+static void stress_schedstat_read(stress_schedstat_t *schedstat)
+{
+	(void)memset(schedstat, 0, sizeof(*schedstat));
+#if defined(__linux__)
+	stress_offcpu_schedstat(&schedstat->run, &schedstat->wait,
+		&schedstat->timeslices, &schedstat->migrations);
+#endif
+}
+
+/*
+ *  stress_schedstat_begin()
+ *	snapshot the scheduler statistics at the start of a stressor instance
+ */
+void stress_schedstat_begin(stress_schedstat_t *schedstat)
+{
+	if (!(g_opt_flags & (OPT_FLAGS_SCHEDSTAT | OPT_FLAGS_METRICS_INSTANCES)))
+		return;
+	stress_schedstat_read(schedstat);
+}
+
+/*
+ *  stress_schedstat_end()
+ *	turn the snapshot into the scheduler statistics of the stressor run
+ */
+void stress_schedstat_end(stress_schedstat_t *schedstat, const double wall_time)
+{
+	stress_schedstat_t now;
+
+	if (!(g_opt_flags & (OPT_FLAGS_SCHEDSTAT | OPT_FLAGS_METRICS_INSTANCES)))
+		return;
+	stress_schedstat_read(&now);
+
+	schedstat->wall = wall_time;
+	schedstat->run = STRESS_MAXIMUM(0.0, now.run - schedstat->run);
+	schedstat->wait = STRESS_MAXIMUM(0.0, now.wait - schedstat->wait);
+	schedstat->timeslices = (now.timeslices > schedstat->timeslices) ?
+		now.timeslices - schedstat->timeslices : 0;
+	schedstat->migrations = (now.migrations > schedstat->migrations) ?
+		now.migrations - schedstat->migrations : 0;
+	schedstat->valid = (now.timeslices > 0);
+}
+
+/*
+ *  stress_schedstat_sum()
+ *	sum the scheduler statistics of the instances of a stressor, the
+ *	run, wait and wall times are averaged per instance
+ */
+static bool stress_schedstat_sum(const stress_stressor_t *ss, stress_schedstat_t *sum)
+{
+	int32_t j, n = 0;
+
+	(void)memset(sum, 0, sizeof(*sum));
+	if (!ss->stats)
+		return false;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_schedstat_t *schedstat = &ss->stats[j]->schedstat;
+
+		if (!schedstat->valid)
+			continue;
+		sum->wall += schedstat->wall;
+		sum->run += schedstat->run;
+		sum->wait += schedstat->wait;
+		sum->timeslices += schedstat->timeslices;
+		sum->migrations += schedstat->migrations;
+		n++;
+	}
+	if (!n)
+		return false;
+
+	sum->wall /= (double)n;
+	sum->run /= (double)n;
+	sum->wait /= (double)n;
+	sum->valid = true;
+	return true;
+}
+
+/*
+ *  stress_schedstat_wait_per_slice()
+ *	average runqueue wait per timeslice in microseconds
+ */
+static double stress_schedstat_wait_per_slice(const stress_stressor_t *ss, const stress_schedstat_t *sum)
+{
+	const double slices = (double)sum->timeslices / (double)ss->started_instances;
+
+	return (slices > 0.0) ? STRESS_DBL_MICROSECOND * sum->wait / slices : 0.0;
+}
+
+/*
+ *  stress_schedstat_yaml()
+ *	dump the scheduler statistics of a stressor to the yaml file
+ */
+void stress_schedstat_yaml(FILE *yaml, const stress_stressor_t *ss)
+{
+	stress_schedstat_t sum;
+
+	if (!(g_opt_flags & OPT_FLAGS_SCHEDSTAT))
+		return;
+	if (!stress_schedstat_sum(ss, &sum))
+		return;
+
+	pr_yaml(yaml, "      sched-run-time: %f\n", sum.run);
+	pr_yaml(yaml, "      sched-wait-time: %f\n", sum.wait);
+	pr_yaml(yaml, "      sched-timeslices: %" PRIu64 "\n", sum.timeslices);
+	pr_yaml(yaml, "      sched-wait-per-timeslice-usecs: %f\n",
+		stress_schedstat_wait_per_slice(ss, &sum));
+	pr_yaml(yaml, "      sched-migrations: %" PRIu64 "\n", sum.migrations);
+	pr_yaml(yaml, "      sched-migrations-per-second: %f\n",
+		sum.wall > 0.0 ? (double)sum.migrations / sum.wall : 0.0);
+}
+
+/*
+ *  stress_schedstat_dump()
+ *	dump the scheduler statistics of all the stressors, times
+ *	are averaged per instance, counts are totals
+ */
+void stress_schedstat_dump(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool header = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_SCHEDSTAT))
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_schedstat_t sum;
+
+		if (!stress_schedstat_sum(ss, &sum))
+			continue;
+
+		if (!header) {
+			pr_metrics("scheduler statistics (times per instance):\n");
+			pr_metrics("%-13s %9s %9s %12s %12s %11s %12s\n",
+				"stressor", "run (s)", "wait (s)", "timeslices",
+				"wait/slice", "migrations", "migrations/s");
+			header = true;
+		}
+		pr_metrics("%-13s %9.2f %9.2f %12" PRIu64 " %9.2f us %11" PRIu64 " %12.2f\n",
+			stress_munge_underscore(ss->stressor->name),
+			sum.run, sum.wait, sum.timeslices,
+			stress_schedstat_wait_per_slice(ss, &sum),
+			sum.migrations,
+			sum.wall > 0.0 ? (double)sum.migrations / sum.wall : 0.0);
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_OFFCPU_H
+#define CORE_OFFCPU_H
+
+/* per stressor off-CPU time accounting */
+extern void stress_offcpu_init(void);
+extern void stress_offcpu_begin(stress_offcpu_t *offcpu);
+extern void stress_offcpu_end(stress_offcpu_t *offcpu, const double wall_time);
+extern void stress_offcpu_yaml(FILE *yaml, const stress_stressor_t *ss);
+extern void stress_offcpu_dump(stress_stressor_t *stressors_list);
+
+/* per stressor scheduler statistics */
+extern void stress_schedstat_begin(stress_schedstat_t *schedstat);
+extern void stress_schedstat_end(stress_schedstat_t *schedstat, const double wall_time);
+extern void stress_schedstat_yaml(FILE *yaml, const stress_stressor_t *ss);
+extern void stress_schedstat_dump(stress_stressor_t *stressors_list);
+
+#endif
@@ -18,9 +18,14 @@
  *
  */
 #include "stress-ng.h"
+#include "core-cpu.h"
 #include "core-perf.h"
 #include "core-perf-event.h"
 
+#if defined(STRESS_ARCH_X86)
+#include "core-asm-x86.h"
+#endif
+
 #if defined(HAVE_LINUX_PERF_EVENT_H)
 #include <linux/perf_event.h>
 #endif
@@ -29,6 +34,10 @@
 #include <locale.h>
 #endif
 
+#if defined(HAVE_LINK_H)
+#include <link.h>
+#endif
+
 #if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H) &&	\
     defined(HAVE_SYSCALL)
@@ -47,7 +56,7 @@
 
 /* used for table of perf events to gather */
 typedef struct {
-	const unsigned int type;	/* perf types */
+	unsigned int type;		/* perf types */
 	unsigned long config;		/* perf type specific config */
 	const char *path;		/* perf trace point path (only for trace points) */
 	const char *label;		/* human readable name for perf type */
@@ -370,21 +379,6 @@ static inline void stress_perf_type_tracepoint_resolve_config(stress_perf_info_t
 	pi->config = config;
 }
 
-/*
- *  stress_perf_init()
- *	perf initialize, resolve all configs
- */
-void stress_perf_init(void)
-{
-	size_t i;
-
-	for (i = 0; i < STRESS_PERF_MAX; i++) {
-		if (perf_info[i].type == PERF_TYPE_TRACEPOINT) {
-			stress_perf_type_tracepoint_resolve_config(&perf_info[i]);
-		}
-	}
-}
-
 /*
  *  stress_sys_perf_event_open()
  *	perf_event_open syscall wrapper
@@ -429,6 +423,429 @@ static char *stress_perf_yaml_label(char *dst, const char *src, const size_t n)
 	return dst;
 }
 
+/* perf(1) style event names that can be used with --perf-events */
+typedef struct {
+	const char		*name;		/* perf(1) event name */
+	const unsigned int	type;		/* perf type */
+	const unsigned long	config;		/* perf type specific config */
+} stress_perf_event_alias_t;
+
+static const stress_perf_event_alias_t perf_event_aliases[] = {
+	{ "cycles",		PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES },
+	{ "cpu-cycles",		PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES },
+	{ "instructions",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_INSTRUCTIONS },
+	{ "branches",		PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+	{ "branch-instructions",PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+	{ "branch-misses",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_MISSES },
+	{ "bus-cycles",		PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BUS_CYCLES },
+	{ "cache-references",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_REFERENCES },
+	{ "cache-misses",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES },
+	{ "L1-dcache-loads",	PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1D, READ, ACCESS) },
+	{ "L1-dcache-load-misses",PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1D, READ, MISS) },
+	{ "L1-icache-loads",	PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1I, READ, ACCESS) },
+	{ "L1-icache-load-misses",PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1I, READ, MISS) },
+	{ "LLC-loads",		PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, READ, ACCESS) },
+	{ "LLC-load-misses",	PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, READ, MISS) },
+	{ "LLC-stores",		PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, WRITE, ACCESS) },
+	{ "LLC-store-misses",	PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, WRITE, MISS) },
+	{ "dTLB-loads",		PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, READ, ACCESS) },
+	{ "dTLB-load-misses",	PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, READ, MISS) },
+	{ "iTLB-loads",		PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(ITLB, READ, ACCESS) },
+	{ "iTLB-load-misses",	PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(ITLB, READ, MISS) },
+	{ "cpu-clock",		PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_CPU_CLOCK },
+	{ "task-clock",		PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_TASK_CLOCK },
+	{ "page-faults",	PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_PAGE_FAULTS },
+	{ "minor-faults",	PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_PAGE_FAULTS_MIN },
+	{ "major-faults",	PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_PAGE_FAULTS_MAJ },
+	{ "context-switches",	PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_CONTEXT_SWITCHES },
+	{ "cpu-migrations",	PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_CPU_MIGRATIONS },
+};
+
+static bool perf_events_selected;			/* true if --perf-events used */
+static bool perf_event_selected[STRESS_PERF_MAX];	/* events chosen by --perf-events */
+
+/*
+ *  stress_perf_event_find()
+ *	find perf_info index of a perf(1) style event name or
+ *	of a yaml perf label, STRESS_PERF_MAX if not found
+ */
+static size_t stress_perf_event_find(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(perf_event_aliases); i++) {
+		if (!strcmp(name, perf_event_aliases[i].name))
+			return stress_perf_info_find(perf_event_aliases[i].type,
+						     perf_event_aliases[i].config);
+	}
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		char yaml_label[128];
+
+		*yaml_label = '\0';
+		stress_perf_yaml_label(yaml_label, perf_info[i].label, sizeof(yaml_label));
+		if (!strcmp(name, yaml_label))
+			return i;
+	}
+	return STRESS_PERF_MAX;
+}
+
+/*
+ *  stress_set_perf_events()
+ *	select a comma separated list of perf events to gather,
+ *	the selected hardware events are measured as one perf group
+ *	so that they are scheduled together and are not multiplexed
+ *	against each other
+ */
+int stress_set_perf_events(const char *opt)
+{
+	char *str, *token, *saveptr = NULL;
+	size_t i;
+
+	str = strdup(opt);
+	if (!str) {
+		(void)fprintf(stderr, "perf-events: out of memory parsing '%s'\n", opt);
+		return -1;
+	}
+
+	(void)memset(perf_event_selected, 0, sizeof(perf_event_selected));
+	for (token = strtok_r(str, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+		const size_t idx = stress_perf_event_find(token);
+
+		if (idx >= STRESS_PERF_MAX) {
+			(void)fprintf(stderr, "perf-events: unknown perf event '%s', "
+				"available events are:", token);
+			for (i = 0; i < SIZEOF_ARRAY(perf_event_aliases); i++)
+				(void)fprintf(stderr, " %s", perf_event_aliases[i].name);
+			(void)fprintf(stderr, "\nor any of the --perf yaml counter names\n");
+			free(str);
+			return -1;
+		}
+		perf_event_selected[idx] = true;
+	}
+	free(str);
+
+	perf_events_selected = true;
+	g_opt_flags |= OPT_FLAGS_PERF_STATS;
+	return 0;
+}
+
+/*
+ *  Top-down microarchitecture analysis events, these are exported
+ *  by the kernel for the processor PMU in sysfs. The first set is
+ *  for processors with the PERF_METRICS MSR (Ice Lake onwards) and
+ *  need to be grouped with the slots event as leader, the second
+ *  set is the older level 1 only set of events.
+ */
+#define TOPDOWN_SLOTS			(0)
+#define TOPDOWN_RETIRING		(1)
+#define TOPDOWN_BAD_SPEC		(2)
+#define TOPDOWN_FE_BOUND		(3)
+#define TOPDOWN_BE_BOUND		(4)
+#define TOPDOWN_HEAVY_OPS		(5)
+#define TOPDOWN_BR_MISPREDICT		(6)
+#define TOPDOWN_FETCH_LAT		(7)
+#define TOPDOWN_MEM_BOUND		(8)
+#define TOPDOWN_TOTAL_SLOTS		(9)
+#define TOPDOWN_SLOTS_ISSUED		(10)
+#define TOPDOWN_SLOTS_RETIRED		(11)
+#define TOPDOWN_FETCH_BUBBLES		(12)
+#define TOPDOWN_RECOVERY_BUBBLES	(13)
+#define TOPDOWN_MAX			(14)
+
+typedef struct {
+	const char *event;		/* sysfs event name */
+	const char *label;		/* human readable name for perf type */
+} stress_perf_topdown_event_t;
+
+static const stress_perf_topdown_event_t perf_topdown_events[TOPDOWN_MAX] = {
+	{ "slots",			"Topdown Slots" },
+	{ "topdown-retiring",		"Topdown Retiring" },
+	{ "topdown-bad-spec",		"Topdown Bad Speculation" },
+	{ "topdown-fe-bound",		"Topdown Frontend Bound" },
+	{ "topdown-be-bound",		"Topdown Backend Bound" },
+	{ "topdown-heavy-ops",		"Topdown Heavy Operations" },
+	{ "topdown-br-mispredict",	"Topdown Br Mispredict" },
+	{ "topdown-fetch-lat",		"Topdown Fetch Latency" },
+	{ "topdown-mem-bound",		"Topdown Memory Bound" },
+	{ "topdown-total-slots",	"Topdown Total Slots" },
+	{ "topdown-slots-issued",	"Topdown Slots Issued" },
+	{ "topdown-slots-retired",	"Topdown Slots Retired" },
+	{ "topdown-fetch-bubbles",	"Topdown Fetch Bubbles" },
+	{ "topdown-recovery-bubbles",	"Topdown Recovery Bubbles" },
+};
+
+static size_t perf_topdown_idx[TOPDOWN_MAX];		/* perf_info index of topdown events */
+static double perf_topdown_scale[TOPDOWN_MAX];		/* sysfs scale of topdown events */
+static size_t perf_topdown_first = STRESS_PERF_MAX;	/* first topdown event in perf_info */
+
+/*
+ *  stress_perf_pmu_format()
+ *	deposit value into the config using the bit ranges of the
+ *	sysfs PMU format field, only config: fields are supported
+ */
+static bool stress_perf_pmu_format(
+	const char *pmu,
+	const char *field,
+	const unsigned long value,
+	unsigned long *config)
+{
+	char path[PATH_MAX], buf[64];
+	char *ptr;
+	unsigned long v = value;
+
+	(void)snprintf(path, sizeof(path),
+		"/sys/bus/event_source/devices/%s/format/%s", pmu, field);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+	if (strncmp(buf, "config:", 7))
+		return false;
+
+	for (ptr = buf + 7; *ptr; ) {
+		unsigned int lo, hi, bit;
+		int n = 0;
+
+		if (sscanf(ptr, "%u-%u%n", &lo, &hi, &n) != 2) {
+			if (sscanf(ptr, "%u%n", &lo, &n) != 1)
+				return false;
+			hi = lo;
+		}
+		if ((hi < lo) || (hi >= sizeof(*config) * 8))
+			return false;
+		for (bit = lo; bit <= hi; bit++, v >>= 1)
+			*config |= (v & 1UL) << bit;
+		ptr += n;
+		if (*ptr != ',')
+			break;
+		ptr++;
+	}
+	return true;
+}
+
+/*
+ *  stress_perf_pmu_event()
+ *	resolve the type and config of a sysfs PMU event such
+ *	as event=0x00,umask=0x80 and its optional scale factor
+ */
+static bool stress_perf_pmu_event(
+	const char *pmu,
+	const char *event,
+	unsigned int *type,
+	unsigned long *config,
+	double *scale)
+{
+	char path[PATH_MAX], buf[256];
+	char *term, *saveptr = NULL;
+	unsigned long config_val = 0;
+
+	(void)snprintf(path, sizeof(path),
+		"/sys/bus/event_source/devices/%s/type", pmu);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+	if (sscanf(buf, "%u", type) != 1)
+		return false;
+
+	(void)snprintf(path, sizeof(path),
+		"/sys/bus/event_source/devices/%s/events/%s", pmu, event);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+
+	for (term = strtok_r(buf, ",\n", &saveptr); term; term = strtok_r(NULL, ",\n", &saveptr)) {
+		char *eq = strchr(term, '=');
+		unsigned long value = 1;
+
+		if (eq) {
+			*eq = '\0';
+			value = strtoul(eq + 1, NULL, 0);
+		}
+		if (!stress_perf_pmu_format(pmu, term, value, &config_val))
+			return false;
+	}
+	*config = config_val;
+
+	*scale = 1.0;
+	(void)snprintf(path, sizeof(path),
+		"/sys/bus/event_source/devices/%s/events/%s.scale", pmu, event);
+	if ((system_read(path, buf, sizeof(buf)) > 0) &&
+	    (sscanf(buf, "%lf", scale) != 1))
+		*scale = 1.0;
+	return true;
+}
+
+/*
+ *  stress_perf_topdown_init()
+ *	append the available top-down events to the perf event
+ *	table and only gather these and the cycle and instruction
+ *	counts unless events have been chosen with --perf-events
+ */
+static void stress_perf_topdown_init(void)
+{
+	static const char * const pmus[] = { "cpu", "cpu_core" };
+	size_t i, n, added = 0;
+
+	for (i = 0; i < TOPDOWN_MAX; i++)
+		perf_topdown_idx[i] = STRESS_PERF_MAX;
+
+	for (n = 0; (n < STRESS_PERF_MAX) && perf_info[n].label; n++)
+		;
+
+	for (i = 0; i < TOPDOWN_MAX; i++) {
+		unsigned int type = 0;
+		unsigned long config = 0;
+		size_t j;
+
+		/* newer metrics supersede the older level 1 only events */
+		if ((i >= TOPDOWN_TOTAL_SLOTS) &&
+		    (perf_topdown_idx[TOPDOWN_SLOTS] < STRESS_PERF_MAX))
+			break;
+		/* metrics can only be read when grouped with slots */
+		if ((i > TOPDOWN_SLOTS) && (i < TOPDOWN_TOTAL_SLOTS) &&
+		    (perf_topdown_idx[TOPDOWN_SLOTS] >= STRESS_PERF_MAX))
+			continue;
+		/* keep the zero terminating entry */
+		if (n >= STRESS_PERF_MAX - 1)
+			break;
+
+		for (j = 0; j < SIZEOF_ARRAY(pmus); j++) {
+			if (stress_perf_pmu_event(pmus[j], perf_topdown_events[i].event,
+						  &type, &config, &perf_topdown_scale[i]))
+				break;
+		}
+		if (j == SIZEOF_ARRAY(pmus))
+			continue;
+
+		perf_info[n].type = type;
+		perf_info[n].config = config;
+		perf_info[n].path = NULL;
+		perf_info[n].label = perf_topdown_events[i].label;
+		perf_topdown_idx[i] = n;
+		if (perf_topdown_first == STRESS_PERF_MAX)
+			perf_topdown_first = n;
+		n++;
+		added++;
+	}
+
+	if (!added) {
+		pr_inf("perf-topdown: top-down events are not available on this processor\n");
+		return;
+	}
+
+	if (!perf_events_selected) {
+		(void)memset(perf_event_selected, 0, sizeof(perf_event_selected));
+		i = stress_perf_info_find(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		if (i < STRESS_PERF_MAX)
+			perf_event_selected[i] = true;
+		i = stress_perf_info_find(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		if (i < STRESS_PERF_MAX)
+			perf_event_selected[i] = true;
+		perf_events_selected = true;
+	}
+	for (i = perf_topdown_first; i < n; i++)
+		perf_event_selected[i] = true;
+}
+
+/*
+ *  stress_perf_init()
+ *	perf initialize, resolve all configs
+ */
+void stress_perf_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < STRESS_PERF_MAX; i++) {
+		if (perf_info[i].type == PERF_TYPE_TRACEPOINT) {
+			stress_perf_type_tracepoint_resolve_config(&perf_info[i]);
+		}
+	}
+	if (g_opt_flags & OPT_FLAGS_PERF_TOPDOWN)
+		stress_perf_topdown_init();
+}
+
+/*
+ *  Compare type + config relative to another reference type and config
+ */
+typedef struct {
+	const unsigned int	type;
+	const unsigned long	config;
+	const unsigned int	ref_type;
+	const unsigned long	ref_config;
+	const bool		percent;	/* scale by 100.0 for percentages? */
+	const char 		*fmt;		/* snprintf format */
+} perf_relative_t;
+
+static const perf_relative_t perf_relatives[] = {
+	{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_INSTRUCTIONS,
+	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES,
+	  false, " (%.3f instr. per cycle)" },
+	{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES,
+	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_REFERENCES,
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_MISSES,
+	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1D, READ, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1D, READ, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, READ, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, READ, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, WRITE, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, WRITE, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, READ, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, READ, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, WRITE, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, WRITE, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(ITLB, READ, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(ITLB, READ, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(BPU, READ, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(BPU, READ, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, READ, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, READ, ACCESS),
+	  true, " (%6.3f%%)" },
+	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, WRITE, MISS),
+	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, WRITE, ACCESS),
+	  true, " (%6.3f%%)" },
+};
+
+/*
+ *  stress_perf_hardware()
+ *	true if the perf event is counted by the processor PMU
+ */
+static inline bool stress_perf_hardware(const stress_perf_info_t *pi)
+{
+	return (pi->type == PERF_TYPE_HARDWARE) ||
+	       (pi->type == PERF_TYPE_HW_CACHE);
+}
+
+/*
+ *  stress_perf_group_leader()
+ *	events that are reported relative to a reference event are
+ *	opened in a group led by the reference event so both are
+ *	scheduled onto the PMU at the same time, returns the fd of
+ *	the reference event or -1 if there is none
+ */
+static int stress_perf_group_leader(const stress_perf_t *sp, const size_t idx)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(perf_relatives); i++) {
+		if ((perf_info[idx].type == perf_relatives[i].type) &&
+		    (perf_info[idx].config == perf_relatives[i].config)) {
+			const size_t ref = stress_perf_info_find(
+						perf_relatives[i].ref_type,
+						perf_relatives[i].ref_config);
+
+			if ((ref < idx) && (sp->perf_stat[ref].fd > -1))
+				return sp->perf_stat[ref].fd;
+		}
+	}
+	return -1;
+}
+
 /*
  *  stress_perf_open()
  *	open perf, get leader and perf fd's
@@ -436,6 +853,7 @@ static char *stress_perf_yaml_label(char *dst, const char *src, const size_t n)
 int stress_perf_open(stress_perf_t *sp)
 {
 	size_t i;
+	int leader_fd = -1, topdown_leader_fd = -1;
 
 	if (!sp)
 		return -1;
@@ -448,11 +866,15 @@ int stress_perf_open(stress_perf_t *sp)
 	for (i = 0; i < STRESS_PERF_MAX; i++) {
 		sp->perf_stat[i].fd = -1;
 		sp->perf_stat[i].counter = 0;
+		sp->perf_stat[i].running_ppm = 0;
 	}
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if (perf_events_selected && !perf_event_selected[i])
+			continue;
 		if (perf_info[i].config != UNRESOLVED) {
 			struct perf_event_attr attr;
+			int group_fd = -1;
 
 			(void)memset(&attr, 0, sizeof(attr));
 			attr.type = perf_info[i].type;
@@ -462,10 +884,34 @@ int stress_perf_open(stress_perf_t *sp)
 			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
 					   PERF_FORMAT_TOTAL_TIME_RUNNING;
 			attr.size = sizeof(attr);
+
+			if (i >= perf_topdown_first)
+				group_fd = topdown_leader_fd;
+			else if (stress_perf_hardware(&perf_info[i]))
+				group_fd = perf_events_selected ?
+					leader_fd : stress_perf_group_leader(sp, i);
+
 			sp->perf_stat[i].fd =
-				stress_sys_perf_event_open(&attr, 0, -1, -1, 0);
-			if (sp->perf_stat[i].fd > -1)
+				stress_sys_perf_event_open(&attr, 0, -1, group_fd, 0);
+			/*
+			 *  group may be too large to be scheduled on the
+			 *  PMU, so fall back to a multiplexed counter
+			 */
+			if ((sp->perf_stat[i].fd < 0) && (group_fd > -1)) {
+				group_fd = -1;
+				sp->perf_stat[i].fd =
+					stress_sys_perf_event_open(&attr, 0, -1, -1, 0);
+			}
+			if (sp->perf_stat[i].fd > -1) {
 				sp->perf_opened++;
+				if (i >= perf_topdown_first) {
+					if (topdown_leader_fd < 0)
+						topdown_leader_fd = sp->perf_stat[i].fd;
+				} else if (stress_perf_hardware(&perf_info[i]) &&
+					   (leader_fd < 0) && (group_fd < 0)) {
+					leader_fd = sp->perf_stat[i].fd;
+				}
+			}
 		}
 	}
 	if (!sp->perf_opened) {
@@ -558,7 +1004,7 @@ int stress_perf_disable(stress_perf_t *sp)
  */
 int stress_perf_close(stress_perf_t *sp)
 {
-	size_t i = 0;
+	size_t i = 0, j;
 	stress_perf_data_t data;
 	ssize_t ret;
 	double scale;
@@ -568,9 +1014,14 @@ int stress_perf_close(stress_perf_t *sp)
 	if (!sp->perf_opened)
 		goto out_ok;
 
+	/*
+	 *  read all the counters before closing any so that group
+	 *  members are not orphaned from their leader mid-read
+	 */
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		const int fd = sp->perf_stat[i].fd;
 
+		sp->perf_stat[i].running_ppm = 0;
 		if (fd < 0 ) {
 			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
 			continue;
@@ -578,21 +1029,32 @@ int stress_perf_close(stress_perf_t *sp)
 
 		(void)memset(&data, 0, sizeof(data));
 		ret = read(fd, &data, sizeof(data));
-		if (ret != sizeof(data))
+		if (ret != sizeof(data)) {
 			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
-		else {
-			/* Ensure we don't get division by zero */
-			if (data.time_running == 0) {
-				scale = (data.time_enabled == 0) ? 1.0 : 0.0;
-			} else {
-				scale = (double)data.time_enabled /
-					(double)data.time_running;
-			}
+		} else if (data.time_enabled == 0) {
+			/* never enabled, nothing was counted */
+			sp->perf_stat[i].counter = 0;
+			sp->perf_stat[i].running_ppm = 1000000;
+		} else if (data.time_running == 0) {
+			/* enabled but never scheduled onto the PMU */
+			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
+		} else {
+			/* scale up multiplexed counters by the time not counted */
+			scale = (double)data.time_enabled /
+				(double)data.time_running;
 			sp->perf_stat[i].counter = (uint64_t)
 				((double)data.counter * scale);
+			sp->perf_stat[i].running_ppm = (uint32_t)
+				(1000000.0 / scale);
+		}
+	}
+	for (j = i; j > 0; j--) {
+		const int fd = sp->perf_stat[j - 1].fd;
+
+		if (fd > -1) {
+			(void)close(fd);
+			sp->perf_stat[j - 1].fd = -1;
 		}
-		(void)close(fd);
-		sp->perf_stat[i].fd = -1;
 	}
 
 out_ok:
@@ -608,7 +1070,29 @@ out_ok:
  */
 bool stress_perf_stat_succeeded(const stress_perf_t *sp)
 {
-	return sp->perf_opened > 0;
+	return sp && (sp->perf_opened > 0);
+}
+
+/*
+ *  stress_perf_stat_ipc()
+ *	instructions per cycle of a stressor instance,
+ *	returns false if the counters were not available
+ */
+bool stress_perf_stat_ipc(const stress_perf_t *sp, double *ipc)
+{
+	const size_t cycles = stress_perf_info_find(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	const size_t instructions = stress_perf_info_find(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+
+	if (!stress_perf_stat_succeeded(sp) ||
+	    (cycles >= STRESS_PERF_MAX) || (instructions >= STRESS_PERF_MAX))
+		return false;
+	if ((sp->perf_stat[cycles].counter == STRESS_PERF_INVALID) ||
+	    (sp->perf_stat[instructions].counter == STRESS_PERF_INVALID) ||
+	    (sp->perf_stat[cycles].counter == 0))
+		return false;
+	*ipc = (double)sp->perf_stat[instructions].counter /
+	       (double)sp->perf_stat[cycles].counter;
+	return true;
 }
 
 /*
@@ -642,100 +1126,270 @@ static const char *stress_perf_stat_scale(const uint64_t counter, const double d
 }
 
 /*
- *  Compare type + config relative to another reference type and config
+ *  Counters that are normalised by the number of bogo-ops, these
+ *  relate the cost of a bogo-op independently of the clock rate
  */
 typedef struct {
 	const unsigned int	type;
 	const unsigned long	config;
-	const unsigned int	ref_type;
-	const unsigned long	ref_config;
-	const bool		percent;	/* scale by 100.0 for percentages? */
-	const char 		*fmt;		/* snprintf format */
-} perf_relative_t;
+	const char		*label;		/* human readable label */
+	const char		*yaml_label;	/* yaml label */
+} perf_per_op_t;
 
-static const perf_relative_t perf_relatives[] = {
+static const perf_per_op_t perf_per_ops[] = {
+	{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES,
+	  "Cycles per bogo op",		"cpu_cycles_per_bogo_op" },
 	{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_INSTRUCTIONS,
-	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES,
-	  false, " (%.3f instr. per cycle)" },
+	  "Instructions per bogo op",	"instructions_per_bogo_op" },
 	{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES,
-	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_REFERENCES,
-	  true, " (%6.3f%%)" },
+	  "Cache Misses per bogo op",	"cache_misses_per_bogo_op" },
 	{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_MISSES,
-	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1D, READ, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(L1D, READ, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, READ, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, READ, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, WRITE, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(LL, WRITE, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, READ, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, READ, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, WRITE, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(DTLB, WRITE, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(ITLB, READ, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(ITLB, READ, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(BPU, READ, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(BPU, READ, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, READ, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, READ, ACCESS),
-	  true, " (%6.3f%%)" },
-	{ PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, WRITE, MISS),
-	  PERF_TYPE_HW_CACHE,	PERF_INFO_HW_CACHE_CONFIG(NODE, WRITE, ACCESS),
-	  true, " (%6.3f%%)" },
+	  "Branch Misses per bogo op",	"branch_misses_per_bogo_op" },
 };
 
 /*
- *  stress_perf_stat_dump()
- *	emit perf statistics
+ *  stress_perf_stat_per_op_dump()
+ *	emit perf counters normalised by the bogo-op count of the
+ *	stressor and the instructions per cycle
  */
-void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const double duration)
+static void stress_perf_stat_per_op_dump(
+	FILE *yaml,
+	const stress_stressor_t *ss,
+	const uint64_t *counter_totals)
 {
-	bool no_perf_stats = true;
-	stress_stressor_t *ss;
-
-#if defined(HAVE_LOCALE_H)
-	(void)setlocale(LC_ALL, "");
-#endif
+	uint64_t c_total = 0;
+	int32_t j;
+	size_t i, cycles, instructions;
+
+	cycles = stress_perf_info_find(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	instructions = stress_perf_info_find(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	if ((cycles < STRESS_PERF_MAX) && (instructions < STRESS_PERF_MAX) &&
+	    (counter_totals[cycles] != STRESS_PERF_INVALID) &&
+	    (counter_totals[instructions] != STRESS_PERF_INVALID) &&
+	    (counter_totals[cycles] > 0)) {
+		const double ipc = (double)counter_totals[instructions] /
+				   (double)counter_totals[cycles];
+
+		pr_inf("%26.3f %-24s\n", ipc, "Instructions per cycle");
+		pr_yaml(yaml, "      instructions_per_cycle: %f\n", ipc);
+	}
 
-	pr_yaml(yaml, "perfstats:\n");
+	for (j = 0; j < ss->started_instances; j++)
+		c_total += ss->stats[j]->ci.counter;
+	if (!c_total)
+		return;
 
-	for (ss = stressors_list; ss; ss = ss->next) {
-		int p;
-		uint64_t counter_totals[STRESS_PERF_MAX];
-		bool got_data = false;
-		char *munged;
+	for (i = 0; i < SIZEOF_ARRAY(perf_per_ops); i++) {
+		const size_t idx = stress_perf_info_find(perf_per_ops[i].type,
+							 perf_per_ops[i].config);
+		double per_op;
 
-		(void)memset(counter_totals, 0, sizeof(counter_totals));
+		if ((idx >= STRESS_PERF_MAX) ||
+		    (counter_totals[idx] == STRESS_PERF_INVALID) ||
+		    (counter_totals[idx] == 0))
+			continue;
 
-		/* Sum totals across all instances of the stressor */
-		for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
-			int32_t j;
-			stress_perf_t *sp = &ss->stats[0]->sp;
+		per_op = (double)counter_totals[idx] / (double)c_total;
+		pr_inf("%26.3f %-24s\n", per_op, perf_per_ops[i].label);
+		pr_yaml(yaml, "      %s: %f\n", perf_per_ops[i].yaml_label, per_op);
+	}
+}
+
+/*
+ *  stress_perf_topdown_value()
+ *	return the scaled total of a topdown event, -1.0 if not available
+ */
+static double stress_perf_topdown_value(const uint64_t *counter_totals, const int td)
+{
+	const size_t idx = perf_topdown_idx[td];
+
+	if ((idx >= STRESS_PERF_MAX) || (counter_totals[idx] == STRESS_PERF_INVALID))
+		return -1.0;
+	return (double)counter_totals[idx] * perf_topdown_scale[td];
+}
+
+/*
+ *  stress_perf_topdown_percent()
+ *	emit a top-down category as a percentage of the pipeline slots
+ */
+static void stress_perf_topdown_percent(
+	FILE *yaml,
+	const char *label,
+	const char *yaml_label,
+	const double value,
+	const double slots)
+{
+	const double percent = (value > 0.0) ? 100.0 * value / slots : 0.0;
+
+	pr_inf("%25.2f%% %-24s\n", percent, label);
+	pr_yaml(yaml, "      %s_percent: %f\n", yaml_label, percent);
+}
+
+/*
+ *  stress_perf_topdown_dump()
+ *	emit the top-down level 1 and where available level 2
+ *	breakdown of the pipeline slots of a stressor
+ */
+static void stress_perf_topdown_dump(FILE *yaml, const uint64_t *counter_totals)
+{
+	double retiring, bad_spec, fe_bound, be_bound, slots;
+
+	if (perf_topdown_first == STRESS_PERF_MAX)
+		return;
+
+	retiring = stress_perf_topdown_value(counter_totals, TOPDOWN_RETIRING);
+	bad_spec = stress_perf_topdown_value(counter_totals, TOPDOWN_BAD_SPEC);
+	fe_bound = stress_perf_topdown_value(counter_totals, TOPDOWN_FE_BOUND);
+	be_bound = stress_perf_topdown_value(counter_totals, TOPDOWN_BE_BOUND);
+
+	if ((retiring >= 0.0) && (bad_spec >= 0.0) &&
+	    (fe_bound >= 0.0) && (be_bound >= 0.0)) {
+		/* metrics are fractions of slots, normalise by their sum */
+		slots = retiring + bad_spec + fe_bound + be_bound;
+	} else {
+		const double issued = stress_perf_topdown_value(counter_totals, TOPDOWN_SLOTS_ISSUED);
+		const double recovery = stress_perf_topdown_value(counter_totals, TOPDOWN_RECOVERY_BUBBLES);
+
+		slots = stress_perf_topdown_value(counter_totals, TOPDOWN_TOTAL_SLOTS);
+		retiring = stress_perf_topdown_value(counter_totals, TOPDOWN_SLOTS_RETIRED);
+		fe_bound = stress_perf_topdown_value(counter_totals, TOPDOWN_FETCH_BUBBLES);
+		if ((slots <= 0.0) || (issued < 0.0) || (recovery < 0.0) ||
+		    (retiring < 0.0) || (fe_bound < 0.0))
+			return;
+		bad_spec = issued - retiring + recovery;
+		if (bad_spec < 0.0)
+			bad_spec = 0.0;
+		be_bound = slots - (retiring + bad_spec + fe_bound);
+		if (be_bound < 0.0)
+			be_bound = 0.0;
+	}
+	if (slots <= 0.0)
+		return;
+
+	stress_perf_topdown_percent(yaml, "Retiring", "topdown_retiring", retiring, slots);
+	stress_perf_topdown_percent(yaml, "Bad Speculation", "topdown_bad_speculation", bad_spec, slots);
+	stress_perf_topdown_percent(yaml, "Frontend Bound", "topdown_frontend_bound", fe_bound, slots);
+	stress_perf_topdown_percent(yaml, "Backend Bound", "topdown_backend_bound", be_bound, slots);
+
+	{
+		const double heavy = stress_perf_topdown_value(counter_totals, TOPDOWN_HEAVY_OPS);
+		const double br_mispredict = stress_perf_topdown_value(counter_totals, TOPDOWN_BR_MISPREDICT);
+		const double fetch_lat = stress_perf_topdown_value(counter_totals, TOPDOWN_FETCH_LAT);
+		const double mem_bound = stress_perf_topdown_value(counter_totals, TOPDOWN_MEM_BOUND);
+
+		if (heavy >= 0.0) {
+			stress_perf_topdown_percent(yaml, "  Heavy Operations", "topdown_heavy_operations", heavy, slots);
+			stress_perf_topdown_percent(yaml, "  Light Operations", "topdown_light_operations", retiring - heavy, slots);
+		}
+		if (br_mispredict >= 0.0) {
+			stress_perf_topdown_percent(yaml, "  Branch Mispredicts", "topdown_branch_mispredicts", br_mispredict, slots);
+			stress_perf_topdown_percent(yaml, "  Machine Clears", "topdown_machine_clears", bad_spec - br_mispredict, slots);
+		}
+		if (fetch_lat >= 0.0) {
+			stress_perf_topdown_percent(yaml, "  Fetch Latency", "topdown_fetch_latency", fetch_lat, slots);
+			stress_perf_topdown_percent(yaml, "  Fetch Bandwidth", "topdown_fetch_bandwidth", fe_bound - fetch_lat, slots);
+		}
+		if (mem_bound >= 0.0) {
+			stress_perf_topdown_percent(yaml, "  Memory Bound", "topdown_memory_bound", mem_bound, slots);
+			stress_perf_topdown_percent(yaml, "  Core Bound", "topdown_core_bound", be_bound - mem_bound, slots);
+		}
+	}
+}
+
+/*
+ *  stress_perf_stat_sum()
+ *	sum the perf counters across all the instances of a stressor,
+ *	a total is STRESS_PERF_INVALID if any instance could not read
+ *	the counter, returns true if any counter data was gathered
+ */
+bool stress_perf_stat_sum(const stress_stressor_t *ss, uint64_t *counter_totals)
+{
+	bool got_data = false;
+	int p;
+
+	(void)memset(counter_totals, 0, sizeof(*counter_totals) * STRESS_PERF_MAX);
+
+	for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+		int32_t j;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_perf_t *sp = ss->stats[j]->sp;
+			uint64_t counter;
 
 			if (!stress_perf_stat_succeeded(sp))
 				continue;
 
-			for (j = 0; j < ss->started_instances; j++) {
-				const uint64_t counter = sp->perf_stat[p].counter;
-
-				if (counter == STRESS_PERF_INVALID) {
-					counter_totals[p] = STRESS_PERF_INVALID;
-					break;
-				}
-				counter_totals[p] += counter;
-				got_data |= (counter > 0);
+			counter = sp->perf_stat[p].counter;
+			if (counter == STRESS_PERF_INVALID) {
+				counter_totals[p] = STRESS_PERF_INVALID;
+				break;
 			}
+			counter_totals[p] += counter;
+			got_data |= (counter > 0);
 		}
+	}
+	return got_data;
+}
 
-		if (!got_data)
+/*
+ *  stress_perf_stat_running()
+ *	return the mean fraction of the enabled time that perf
+ *	counter p was actually counting across the instances of
+ *	a stressor, less than 1.0 means the counter was multiplexed
+ */
+static double stress_perf_stat_running(const stress_stressor_t *ss, const int p)
+{
+	double running = 0.0;
+	int32_t j, n = 0;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_perf_t *sp = ss->stats[j]->sp;
+
+		if (!stress_perf_stat_succeeded(sp) ||
+		    (sp->perf_stat[p].counter == STRESS_PERF_INVALID))
+			continue;
+		running += (double)sp->perf_stat[p].running_ppm / 1000000.0;
+		n++;
+	}
+	return n ? running / (double)n : 1.0;
+}
+
+/*
+ *  stress_perf_stat_label()
+ *	return the label of perf counter p and its yaml compatible
+ *	form in yaml_label, NULL if there is no such counter
+ */
+const char *stress_perf_stat_label(const int p, char *yaml_label, const size_t len)
+{
+	if ((p < 0) || (p >= STRESS_PERF_MAX) || !perf_info[p].label)
+		return NULL;
+
+	*yaml_label = '\0';
+	stress_perf_yaml_label(yaml_label, perf_info[p].label, len);
+	return perf_info[p].label;
+}
+
+/*
+ *  stress_perf_stat_dump()
+ *	emit perf statistics
+ */
+void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const double duration)
+{
+	bool no_perf_stats = true, multiplexed = false;
+	stress_stressor_t *ss;
+
+#if defined(HAVE_LOCALE_H)
+	(void)setlocale(LC_ALL, "");
+#endif
+
+	pr_yaml(yaml, "perfstats:\n");
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int p;
+		uint64_t counter_totals[STRESS_PERF_MAX];
+		char *munged;
+
+		if (!stress_perf_stat_sum(ss, counter_totals))
 			continue;
 
 		munged = stress_munge_underscore(ss->stressor->name);
@@ -748,8 +1402,9 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 			const uint64_t ct = counter_totals[p];
 
 			if (l && (ct != STRESS_PERF_INVALID)) {
-				char extra[32];
+				char extra[32], mux[32];
 				char yaml_label[128];
+				double running;
 				*extra = '\0';
 				size_t i;
 
@@ -771,9 +1426,18 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 					}
 				}
 
-				pr_inf("%'26" PRIu64 " %-24s %s%s\n",
+				running = stress_perf_stat_running(ss, p);
+				if (running < 0.9999) {
+					(void)snprintf(mux, sizeof(mux),
+						" [%.2f%% counted]", running * 100.0);
+					multiplexed = true;
+				} else {
+					*mux = '\0';
+				}
+
+				pr_inf("%'26" PRIu64 " %-24s %s%s%s\n",
 					ct, l, stress_perf_stat_scale(ct, duration),
-					extra);
+					extra, mux);
 
 				*yaml_label = '\0';
 				stress_perf_yaml_label(yaml_label, l, sizeof(yaml_label));
@@ -781,10 +1445,19 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 					"\n", yaml_label, ct);
 				pr_yaml(yaml, "      %s_per_second: %f\n",
 					yaml_label, (double)ct / duration);
+				if (*mux)
+					pr_yaml(yaml, "      %s_running_percent: %f\n",
+						yaml_label, running * 100.0);
 			}
 		}
+		stress_perf_stat_per_op_dump(yaml, ss, counter_totals);
+		stress_perf_topdown_dump(yaml, counter_totals);
 		pr_yaml(yaml, "\n");
 	}
+	if (multiplexed) {
+		pr_inf("perf counters marked as partly counted were multiplexed and "
+			"have been scaled up, use --perf-events to select fewer events\n");
+	}
 	if (no_perf_stats) {
 		if (geteuid() != 0) {
 			char buffer[64];
@@ -810,4 +1483,947 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 		}
 	}
 }
+
+/*
+ *  --perf-sample sampling profiler, the parent opens a sampling perf
+ *  event on each stressor instance, the samples are drained from the
+ *  ring buffer when the instance is reaped and are attributed to the
+ *  user or kernel function symbols of the sampled instruction pointers.
+ *  Stressor instances are forked from the parent without an exec, so
+ *  user space addresses resolve using the parent's own mappings.
+ */
+#define PERF_SAMPLE_PAGES	(256)	/* ring buffer data pages per instance */
+#define PERF_SAMPLE_BYTES	(160)	/* rough size of a sample with a callchain */
+#define PERF_SAMPLE_FREQ_MIN	(10)	/* lowest sampling frequency, Hz */
+#define PERF_SAMPLE_FREQ_MAX	(999)	/* highest sampling frequency, Hz */
+#define PERF_SAMPLE_HASH_SIZE	(1021)	/* symbol hash table size */
+#define PERF_SAMPLE_CHAIN_MAX	(64)	/* maximum callchain depth used */
+
+/* function symbol */
+typedef struct {
+	uintptr_t addr;			/* start address */
+	uint64_t size;			/* size, 0 = unknown */
+	char *name;			/* symbol name */
+} stress_perf_sym_t;
+
+/* symbol table, sorted by address */
+typedef struct {
+	stress_perf_sym_t *syms;	/* symbols */
+	size_t n;			/* number of symbols */
+	size_t max;			/* allocated symbols */
+} stress_perf_symtab_t;
+
+/* samples attributed to a symbol */
+typedef struct stress_perf_hit {
+	struct stress_perf_hit *next;	/* next in hash chain */
+	const char *name;		/* symbol name */
+	bool kernel;			/* true if kernel symbol */
+	uint64_t self;			/* samples in the function */
+	uint64_t total;			/* samples in the function or its callees */
+} stress_perf_hit_t;
+
+/* per instance sampling event */
+typedef struct {
+	int fd;				/* perf event fd, -1 = not open */
+	void *base;			/* ring buffer mapping */
+	size_t len;			/* ring buffer mapping size */
+} stress_perf_ring_t;
+
+/* per stressor samples */
+typedef struct stress_perf_sampler {
+	struct stress_perf_sampler *next; /* next stressor */
+	const stress_stressor_t *ss;	/* stressor */
+	stress_perf_ring_t *rings;	/* per instance ring buffers */
+	int32_t num_rings;		/* number of rings */
+	uint64_t samples;		/* number of samples */
+	uint64_t lost;			/* number of samples lost */
+	stress_perf_hit_t *hits[PERF_SAMPLE_HASH_SIZE];
+} stress_perf_sampler_t;
+
+static stress_perf_sampler_t *perf_samplers;
+static stress_perf_symtab_t perf_user_syms;
+static stress_perf_symtab_t perf_user_objs;	/* loaded object address ranges */
+static stress_perf_symtab_t perf_kernel_syms;
+static bool perf_syms_loaded;
+static bool perf_sample_failed;
+static bool perf_sample_sw;		/* using cpu-clock, no cycles counter */
+static const char perf_unknown_user[] = "[unknown]";
+static const char perf_unknown_kernel[] = "[kernel]";
+
+/*
+ *  stress_set_perf_sample_top()
+ *	set number of hot functions to report per stressor
+ */
+int stress_set_perf_sample_top(const char *opt)
+{
+	uint32_t top;
+
+	top = stress_get_uint32(opt);
+	stress_check_range("perf-sample-top", (uint64_t)top, 1, 10000);
+	g_opt_flags |= OPT_FLAGS_PERF_SAMPLE;
+	return stress_set_setting_global("perf-sample-top", TYPE_ID_UINT32, &top);
+}
+
+/*
+ *  stress_perf_sym_add()
+ *	add a symbol to a symbol table
+ */
+static int stress_perf_sym_add(
+	stress_perf_symtab_t *symtab,
+	const uintptr_t addr,
+	const uint64_t size,
+	const char *name)
+{
+	stress_perf_sym_t *sym;
+
+	if (symtab->n >= symtab->max) {
+		const size_t max = symtab->max ? symtab->max * 2 : 4096;
+		stress_perf_sym_t *syms;
+
+		syms = realloc(symtab->syms, max * sizeof(*syms));
+		if (!syms)
+			return -1;
+		symtab->syms = syms;
+		symtab->max = max;
+	}
+	sym = &symtab->syms[symtab->n];
+	sym->name = strdup(name);
+	if (!sym->name)
+		return -1;
+	sym->addr = addr;
+	sym->size = size;
+	symtab->n++;
+	return 0;
+}
+
+/*
+ *  stress_perf_sym_cmp()
+ *	sort symbols by address
+ */
+static int stress_perf_sym_cmp(const void *p1, const void *p2)
+{
+	const stress_perf_sym_t *s1 = (const stress_perf_sym_t *)p1;
+	const stress_perf_sym_t *s2 = (const stress_perf_sym_t *)p2;
+
+	if (s1->addr < s2->addr)
+		return -1;
+	if (s1->addr > s2->addr)
+		return 1;
+	return 0;
+}
+
+/*
+ *  stress_perf_sym_find()
+ *	find the symbol containing addr, NULL if not found
+ */
+static const stress_perf_sym_t *stress_perf_sym_find(
+	const stress_perf_symtab_t *symtab,
+	const uintptr_t addr)
+{
+	size_t lo = 0, hi = symtab->n;
+	const stress_perf_sym_t *sym;
+
+	if (!symtab->n || (addr < symtab->syms[0].addr))
+		return NULL;
+
+	/* find the last symbol that starts at or below addr */
+	while (hi - lo > 1) {
+		const size_t mid = lo + (hi - lo) / 2;
+
+		if (symtab->syms[mid].addr <= addr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	sym = &symtab->syms[lo];
+	if (sym->size && (addr >= sym->addr + sym->size))
+		return NULL;
+	return sym;
+}
+
+/*
+ *  stress_perf_symtab_free()
+ *	free a symbol table
+ */
+static void stress_perf_symtab_free(stress_perf_symtab_t *symtab)
+{
+	size_t i;
+
+	for (i = 0; i < symtab->n; i++)
+		free(symtab->syms[i].name);
+	free(symtab->syms);
+	symtab->syms = NULL;
+	symtab->n = 0;
+	symtab->max = 0;
+}
+
+#if defined(HAVE_LINK_H)
+/*
+ *  stress_perf_elf_load()
+ *	load the function symbols of an ELF object loaded at base,
+ *	the full symbol table is used if the object is not stripped
+ */
+static void stress_perf_elf_load(const char *filename, const uintptr_t base)
+{
+	int fd;
+	struct stat statbuf;
+	uint8_t *elf;
+	const ElfW(Ehdr) *ehdr;
+	const ElfW(Shdr) *shdr, *symtab = NULL, *dynsym = NULL, *sh;
+	size_t i;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return;
+	if ((fstat(fd, &statbuf) < 0) ||
+	    ((size_t)statbuf.st_size < sizeof(ElfW(Ehdr)))) {
+		(void)close(fd);
+		return;
+	}
+	elf = (uint8_t *)mmap(NULL, (size_t)statbuf.st_size, PROT_READ,
+			MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (elf == MAP_FAILED)
+		return;
+
+	ehdr = (const ElfW(Ehdr) *)elf;
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+	    (ehdr->e_shoff == 0) ||
+	    (ehdr->e_shentsize != sizeof(ElfW(Shdr))) ||
+	    (ehdr->e_shoff + (ehdr->e_shnum * sizeof(ElfW(Shdr))) > (size_t)statbuf.st_size))
+		goto unmap;
+
+	shdr = (const ElfW(Shdr) *)(elf + ehdr->e_shoff);
+	for (i = 0; i < ehdr->e_shnum; i++) {
+		if (shdr[i].sh_type == SHT_SYMTAB)
+			symtab = &shdr[i];
+		else if (shdr[i].sh_type == SHT_DYNSYM)
+			dynsym = &shdr[i];
+	}
+	sh = symtab ? symtab : dynsym;
+	if (!sh || (sh->sh_link >= ehdr->e_shnum) ||
+	    (sh->sh_offset + sh->sh_size > (size_t)statbuf.st_size) ||
+	    (shdr[sh->sh_link].sh_offset + shdr[sh->sh_link].sh_size > (size_t)statbuf.st_size))
+		goto unmap;
+
+	{
+		const ElfW(Sym) *sym = (const ElfW(Sym) *)(elf + sh->sh_offset);
+		const size_t n = sh->sh_size / sizeof(ElfW(Sym));
+		const char *strtab = (const char *)(elf + shdr[sh->sh_link].sh_offset);
+		const size_t strtab_size = shdr[sh->sh_link].sh_size;
+
+		for (i = 0; i < n; i++) {
+			const int type = ELF64_ST_TYPE(sym[i].st_info);
+
+			if (((type != STT_FUNC) && (type != STT_GNU_IFUNC)) ||
+			    (sym[i].st_shndx == SHN_UNDEF) ||
+			    (sym[i].st_value == 0) ||
+			    (sym[i].st_name >= strtab_size))
+				continue;
+			if (stress_perf_sym_add(&perf_user_syms,
+					base + (uintptr_t)sym[i].st_value,
+					(uint64_t)sym[i].st_size,
+					strtab + sym[i].st_name) < 0)
+				break;
+		}
+	}
+unmap:
+	(void)munmap((void *)elf, (size_t)statbuf.st_size);
+}
+
+/*
+ *  stress_perf_elf_object()
+ *	dl_iterate_phdr callback, load symbols of each loaded object
+ */
+static int stress_perf_elf_object(struct dl_phdr_info *info, size_t size, void *data)
+{
+	const char *filename, *name;
+	char objname[64];
+	int i;
+
+	(void)size;
+	(void)data;
+
+	if (!info->dlpi_name || !*info->dlpi_name) {
+		/* the stress-ng executable */
+		filename = "/proc/self/exe";
+		name = g_app_name;
+	} else {
+		filename = info->dlpi_name;
+		name = strrchr(filename, '/');
+		name = name ? name + 1 : filename;
+	}
+
+	/* samples in functions without symbols are attributed to the object */
+	(void)snprintf(objname, sizeof(objname), "[%s]", name);
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+
+		if ((phdr->p_type == PT_LOAD) && (phdr->p_flags & PF_X))
+			(void)stress_perf_sym_add(&perf_user_objs,
+				(uintptr_t)(info->dlpi_addr + phdr->p_vaddr),
+				(uint64_t)phdr->p_memsz, objname);
+	}
+	if (*filename == '/')
+		stress_perf_elf_load(filename, (uintptr_t)info->dlpi_addr);
+	return 0;
+}
+#endif
+
+/*
+ *  stress_perf_kallsyms_load()
+ *	load the kernel text symbols, these are not available
+ *	if kernel pointers are restricted
+ */
+static void stress_perf_kallsyms_load(void)
+{
+	FILE *fp;
+	char buffer[512];
+
+	fp = fopen("/proc/kallsyms", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		unsigned long long addr;
+		char type, name[256];
+
+		if (sscanf(buffer, "%llx %c %255s", &addr, &type, name) != 3)
+			continue;
+		if (!addr)
+			continue;
+		if ((type != 't') && (type != 'T') && (type != 'w') && (type != 'W'))
+			continue;
+		if (stress_perf_sym_add(&perf_kernel_syms, (uintptr_t)addr, 0, name) < 0)
+			break;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_perf_syms_load()
+ *	load the user and kernel symbols once, on first use
+ */
+static void stress_perf_syms_load(void)
+{
+	if (perf_syms_loaded)
+		return;
+	perf_syms_loaded = true;
+
+#if defined(HAVE_LINK_H)
+	(void)dl_iterate_phdr(stress_perf_elf_object, NULL);
+#endif
+	stress_perf_kallsyms_load();
+	if (perf_user_syms.n)
+		qsort(perf_user_syms.syms, perf_user_syms.n,
+			sizeof(*perf_user_syms.syms), stress_perf_sym_cmp);
+	if (perf_user_objs.n)
+		qsort(perf_user_objs.syms, perf_user_objs.n,
+			sizeof(*perf_user_objs.syms), stress_perf_sym_cmp);
+	if (perf_kernel_syms.n)
+		qsort(perf_kernel_syms.syms, perf_kernel_syms.n,
+			sizeof(*perf_kernel_syms.syms), stress_perf_sym_cmp);
+}
+
+/*
+ *  stress_perf_sample_resolve()
+ *	map an instruction pointer to a symbol name, or to the
+ *	object it is in, NULL if it is not in any known object
+ */
+static const char *stress_perf_sample_resolve(const uint64_t ip, const bool kernel)
+{
+	const stress_perf_sym_t *sym;
+
+	if (kernel) {
+		sym = stress_perf_sym_find(&perf_kernel_syms, (uintptr_t)ip);
+		return sym ? sym->name : perf_unknown_kernel;
+	}
+	sym = stress_perf_sym_find(&perf_user_syms, (uintptr_t)ip);
+	if (sym)
+		return sym->name;
+	sym = stress_perf_sym_find(&perf_user_objs, (uintptr_t)ip);
+	return sym ? sym->name : NULL;
+}
+
+/*
+ *  stress_perf_sample_hit()
+ *	account a sample to a symbol, names are unique pointers
+ *	into the symbol tables so they are hashed by address
+ */
+static void stress_perf_sample_hit(
+	stress_perf_sampler_t *sampler,
+	const char *name,
+	const bool kernel,
+	const bool self)
+{
+	const size_t h = (size_t)(((uintptr_t)name >> 3) % PERF_SAMPLE_HASH_SIZE);
+	stress_perf_hit_t *hit;
+
+	for (hit = sampler->hits[h]; hit; hit = hit->next) {
+		if (hit->name == name)
+			break;
+	}
+	if (!hit) {
+		hit = calloc(1, sizeof(*hit));
+		if (!hit)
+			return;
+		hit->name = name;
+		hit->kernel = kernel;
+		hit->next = sampler->hits[h];
+		sampler->hits[h] = hit;
+	}
+	if (self)
+		hit->self++;
+	hit->total++;
+}
+
+/*
+ *  stress_perf_sample_record()
+ *	attribute a sample to the function it hit and,
+ *	once each, to the functions in its callchain
+ */
+static void stress_perf_sample_record(
+	stress_perf_sampler_t *sampler,
+	const uint64_t ip,
+	const uint64_t *ips,
+	const uint64_t nr)
+{
+	const char *names[PERF_SAMPLE_CHAIN_MAX];
+	size_t n = 0;
+	uint64_t i;
+	bool kernel = (ip >= (uint64_t)1 << 63);
+	const char *name = stress_perf_sample_resolve(ip, kernel);
+
+	sampler->samples++;
+	if (!name)
+		name = perf_unknown_user;
+	stress_perf_sample_hit(sampler, name, kernel, true);
+	names[n++] = name;
+
+	for (i = 0; (i < nr) && (n < PERF_SAMPLE_CHAIN_MAX); i++) {
+		size_t j;
+
+		/* context markers switch between kernel and user frames */
+		if (ips[i] >= (uint64_t)PERF_CONTEXT_MAX) {
+			kernel = (ips[i] == (uint64_t)PERF_CONTEXT_KERNEL);
+			continue;
+		}
+		/* without frame pointers user callchains may be garbage */
+		name = stress_perf_sample_resolve(ips[i], kernel);
+		if (!name)
+			continue;
+		for (j = 0; j < n; j++) {
+			if (names[j] == name)
+				break;
+		}
+		if (j < n)
+			continue;
+		names[n++] = name;
+		stress_perf_sample_hit(sampler, name, kernel, false);
+	}
+}
+
+/*
+ *  stress_perf_sample_drain()
+ *	read the samples in a ring buffer
+ */
+static void stress_perf_sample_drain(stress_perf_sampler_t *sampler, stress_perf_ring_t *ring)
+{
+	struct perf_event_mmap_page *meta = (struct perf_event_mmap_page *)ring->base;
+	const size_t page_size = stress_get_page_size();
+	const uint8_t *data = (uint8_t *)ring->base + page_size;
+	const uint64_t size = (uint64_t)(ring->len - page_size);
+	uint64_t head, tail;
+	uint64_t record[2 + 2 + PERF_SAMPLE_CHAIN_MAX + 64];
+
+	head = meta->data_head;
+	shim_mb();
+	tail = meta->data_tail;
+
+	while (tail < head) {
+		const struct perf_event_header *hdr;
+		const uint64_t offset = tail % size;
+		uint64_t len;
+
+		/* records are 8 byte aligned, so headers never wrap */
+		hdr = (const struct perf_event_header *)(data + offset);
+		len = hdr->size;
+		if ((len < sizeof(*hdr)) || (len > sizeof(record)))
+			break;
+		/* copy out records that wrap around the end of the buffer */
+		if (offset + len > size) {
+			const uint64_t first = size - offset;
+
+			(void)memcpy(record, data + offset, (size_t)first);
+			(void)memcpy((uint8_t *)record + first, data, (size_t)(len - first));
+			hdr = (const struct perf_event_header *)record;
+		}
+
+		if (hdr->type == PERF_RECORD_SAMPLE) {
+			const uint64_t *u64 = (const uint64_t *)(hdr + 1);
+			const uint64_t ip = u64[0];
+			uint64_t nr = u64[1];
+
+			if (sizeof(*hdr) + (2 + nr) * sizeof(uint64_t) > len)
+				nr = 0;
+			stress_perf_sample_record(sampler, ip, &u64[2], nr);
+		} else if (hdr->type == PERF_RECORD_LOST) {
+			const uint64_t *u64 = (const uint64_t *)(hdr + 1);
+
+			sampler->lost += u64[1];
+		}
+		tail += len;
+	}
+	shim_mb();
+	meta->data_tail = head;
+}
+
+/*
+ *  stress_perf_sampler_get()
+ *	find or create the sampler of a stressor
+ */
+static stress_perf_sampler_t *stress_perf_sampler_get(const stress_stressor_t *ss)
+{
+	stress_perf_sampler_t *sampler;
+
+	for (sampler = perf_samplers; sampler; sampler = sampler->next) {
+		if (sampler->ss == ss)
+			return sampler;
+	}
+	sampler = calloc(1, sizeof(*sampler));
+	if (!sampler)
+		return NULL;
+	sampler->ss = ss;
+	sampler->next = perf_samplers;
+	perf_samplers = sampler;
+	return sampler;
+}
+
+/*
+ *  stress_perf_sample_freq()
+ *	pick a sampling frequency so the ring buffer can hold the
+ *	samples of a whole run as the buffer is drained at the end
+ */
+static uint64_t stress_perf_sample_freq(const size_t data_len)
+{
+	const uint64_t budget = (uint64_t)data_len / PERF_SAMPLE_BYTES;
+	const uint64_t timeout = (g_opt_timeout && (g_opt_timeout != TIMEOUT_NOT_SET)) ?
+		g_opt_timeout : 60;
+	const uint64_t freq = budget / timeout;
+
+	return STRESS_MAXIMUM(PERF_SAMPLE_FREQ_MIN, STRESS_MINIMUM(PERF_SAMPLE_FREQ_MAX, freq));
+}
+
+/*
+ *  stress_perf_sample_open()
+ *	open a sampling perf event on a stressor instance, cycles
+ *	are sampled with callchains, cpu-clock is used if there is
+ *	no cycles counter. Called by the parent after forking.
+ */
+void stress_perf_sample_open(const stress_stressor_t *ss, const int32_t instance, const pid_t pid)
+{
+	stress_perf_sampler_t *sampler;
+	stress_perf_ring_t *ring;
+	struct perf_event_attr attr;
+	const size_t page_size = stress_get_page_size();
+	size_t pages;
+
+	if (!(g_opt_flags & OPT_FLAGS_PERF_SAMPLE) || perf_sample_failed)
+		return;
+
+	sampler = stress_perf_sampler_get(ss);
+	if (!sampler)
+		return;
+	if (!sampler->rings) {
+		int32_t i;
+
+		sampler->rings = calloc((size_t)ss->num_instances, sizeof(*sampler->rings));
+		if (!sampler->rings)
+			return;
+		sampler->num_rings = ss->num_instances;
+		for (i = 0; i < sampler->num_rings; i++)
+			sampler->rings[i].fd = -1;
+	}
+	if ((instance < 0) || (instance >= sampler->num_rings))
+		return;
+	ring = &sampler->rings[instance];
+	if (ring->fd >= 0)
+		return;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = perf_sample_sw ? PERF_TYPE_SOFTWARE : PERF_TYPE_HARDWARE;
+	attr.config = perf_sample_sw ? PERF_COUNT_SW_CPU_CLOCK : PERF_COUNT_HW_CPU_CYCLES;
+	attr.freq = 1;
+	attr.sample_freq = stress_perf_sample_freq(PERF_SAMPLE_PAGES * page_size);
+	attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN;
+	attr.exclude_hv = 1;
+	attr.sample_max_stack = PERF_SAMPLE_CHAIN_MAX;
+
+	ring->fd = stress_sys_perf_event_open(&attr, pid, -1, -1, 0);
+	if ((ring->fd < 0) && !perf_sample_sw) {
+		perf_sample_sw = true;
+		attr.type = PERF_TYPE_SOFTWARE;
+		attr.config = PERF_COUNT_SW_CPU_CLOCK;
+		ring->fd = stress_sys_perf_event_open(&attr, pid, -1, -1, 0);
+	}
+	if (ring->fd < 0) {
+		pr_inf("perf-sample: cannot open sampling perf event, errno=%d (%s), "
+			"disabling --perf-sample\n", errno, strerror(errno));
+		perf_sample_failed = true;
+		return;
+	}
+
+	/* locked memory is limited, so try smaller buffers if need be */
+	for (pages = PERF_SAMPLE_PAGES; pages >= 1; pages >>= 1) {
+		ring->len = (pages + 1) * page_size;
+		ring->base = mmap(NULL, ring->len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+		if (ring->base != MAP_FAILED)
+			return;
+	}
+	pr_dbg("perf-sample: cannot mmap perf ring buffer, errno=%d (%s)\n",
+		errno, strerror(errno));
+	ring->base = NULL;
+	(void)close(ring->fd);
+	ring->fd = -1;
+}
+
+/*
+ *  stress_perf_sample_close()
+ *	drain the samples of a reaped stressor instance
+ *	and close its sampling perf event
+ */
+void stress_perf_sample_close(const stress_stressor_t *ss, const int32_t instance)
+{
+	stress_perf_sampler_t *sampler;
+	stress_perf_ring_t *ring;
+
+	if (!(g_opt_flags & OPT_FLAGS_PERF_SAMPLE))
+		return;
+
+	for (sampler = perf_samplers; sampler; sampler = sampler->next) {
+		if (sampler->ss == ss)
+			break;
+	}
+	if (!sampler || !sampler->rings || (instance < 0) || (instance >= sampler->num_rings))
+		return;
+	ring = &sampler->rings[instance];
+	if (ring->fd < 0)
+		return;
+
+	if (ring->base) {
+		stress_perf_syms_load();
+		stress_perf_sample_drain(sampler, ring);
+		(void)munmap(ring->base, ring->len);
+		ring->base = NULL;
+	}
+	(void)close(ring->fd);
+	ring->fd = -1;
+}
+
+/*
+ *  stress_perf_hit_cmp()
+ *	sort hits by most self samples first
+ */
+static int stress_perf_hit_cmp(const void *p1, const void *p2)
+{
+	const stress_perf_hit_t *h1 = *(const stress_perf_hit_t * const *)p1;
+	const stress_perf_hit_t *h2 = *(const stress_perf_hit_t * const *)p2;
+
+	if (h1->self < h2->self)
+		return 1;
+	if (h1->self > h2->self)
+		return -1;
+	if (h1->total < h2->total)
+		return 1;
+	if (h1->total > h2->total)
+		return -1;
+	return strcmp(h1->name, h2->name);
+}
+
+/*
+ *  stress_perf_sample_dump()
+ *	report the hot functions of each stressor
+ */
+void stress_perf_sample_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	uint32_t top = 10;
+	bool yaml_header = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_PERF_SAMPLE))
+		return;
+	(void)stress_get_setting("perf-sample-top", &top);
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_perf_sampler_t *sampler;
+		stress_perf_hit_t **sorted, *hit;
+		size_t i, n = 0;
+		const char *munged;
+
+		for (sampler = perf_samplers; sampler; sampler = sampler->next) {
+			if (sampler->ss == ss)
+				break;
+		}
+		if (!sampler || !sampler->samples)
+			continue;
+
+		for (i = 0; i < PERF_SAMPLE_HASH_SIZE; i++)
+			for (hit = sampler->hits[i]; hit; hit = hit->next)
+				n++;
+		sorted = calloc(n, sizeof(*sorted));
+		if (!sorted)
+			continue;
+		n = 0;
+		for (i = 0; i < PERF_SAMPLE_HASH_SIZE; i++)
+			for (hit = sampler->hits[i]; hit; hit = hit->next)
+				sorted[n++] = hit;
+		qsort(sorted, n, sizeof(*sorted), stress_perf_hit_cmp);
+
+		munged = stress_munge_underscore(ss->stressor->name);
+		pr_inf("%s: perf samples of %s: %" PRIu64 " (%" PRIu64 " lost)\n",
+			munged, perf_sample_sw ? "cpu-clock" : "cycles",
+			sampler->samples, sampler->lost);
+		pr_inf("%s: %7s %7s %s\n", munged, "self%", "total%", "function");
+
+		if (!yaml_header) {
+			pr_yaml(yaml, "perf-sample:\n");
+			pr_yaml(yaml, "    event: %s\n", perf_sample_sw ? "cpu-clock" : "cycles");
+			pr_yaml(yaml, "    stressors:\n");
+			yaml_header = true;
+		}
+		pr_yaml(yaml, "      - stressor: %s\n", munged);
+		pr_yaml(yaml, "        samples: %" PRIu64 "\n", sampler->samples);
+		pr_yaml(yaml, "        lost: %" PRIu64 "\n", sampler->lost);
+		pr_yaml(yaml, "        functions:\n");
+
+		for (i = 0; (i < n) && (i < (size_t)top); i++) {
+			const double self = 100.0 * (double)sorted[i]->self / (double)sampler->samples;
+			const double total = 100.0 * (double)sorted[i]->total / (double)sampler->samples;
+
+			if (!sorted[i]->self)
+				break;
+			pr_inf("%s: %7.2f %7.2f %s%s\n", munged, self, total,
+				sorted[i]->name, sorted[i]->kernel ? " [k]" : "");
+			pr_yaml(yaml, "          - function: %s\n", sorted[i]->name);
+			pr_yaml(yaml, "            kernel: %s\n", sorted[i]->kernel ? "true" : "false");
+			pr_yaml(yaml, "            self-percent: %f\n", self);
+			pr_yaml(yaml, "            total-percent: %f\n", total);
+		}
+		free(sorted);
+	}
+	if (yaml_header)
+		pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_perf_sample_free()
+ *	free samples and symbol tables
+ */
+void stress_perf_sample_free(void)
+{
+	stress_perf_sampler_t *sampler = perf_samplers;
+
+	while (sampler) {
+		stress_perf_sampler_t *next = sampler->next;
+		size_t i;
+		int32_t j;
+
+		for (j = 0; j < sampler->num_rings; j++) {
+			stress_perf_ring_t *ring = &sampler->rings[j];
+
+			if (ring->base)
+				(void)munmap(ring->base, ring->len);
+			if (ring->fd >= 0)
+				(void)close(ring->fd);
+		}
+		for (i = 0; i < PERF_SAMPLE_HASH_SIZE; i++) {
+			stress_perf_hit_t *hit = sampler->hits[i];
+
+			while (hit) {
+				stress_perf_hit_t *hit_next = hit->next;
+
+				free(hit);
+				hit = hit_next;
+			}
+		}
+		free(sampler->rings);
+		free(sampler);
+		sampler = next;
+	}
+	perf_samplers = NULL;
+	stress_perf_symtab_free(&perf_user_syms);
+	stress_perf_symtab_free(&perf_user_objs);
+	stress_perf_symtab_free(&perf_kernel_syms);
+	perf_syms_loaded = false;
+}
 #endif
+
+/*
+ *  stress_perf_dtlb_open()
+ *	open a counter of the dTLB read misses of the calling
+ *	process and the threads it creates afterwards, returns
+ *	-1 if the counter is not available
+ */
+int stress_perf_dtlb_open(void)
+{
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_DTLB |
+		      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.inherit = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_perf_cycles_open()
+ *	open a counter of the user and kernel CPU cycles of the
+ *	calling process, returns -1 if the counter is not available
+ */
+int stress_perf_cycles_open(void)
+{
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_perf_branch_misses_open()
+ *	open a counter of the user space branch misses of the
+ *	calling process, returns -1 if the counter is not available
+ */
+int stress_perf_branch_misses_open(void)
+{
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_perf_itlb_open()
+ *	open a counter of the user space iTLB read misses of the
+ *	calling process, returns -1 if the counter is not available
+ */
+int stress_perf_itlb_open(void)
+{
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_ITLB |
+		      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_perf_l1i_open()
+ *	open a counter of the user space L1 instruction cache read
+ *	misses of the calling process, returns -1 if the counter is
+ *	not available
+ */
+int stress_perf_l1i_open(void)
+{
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_L1I |
+		      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_perf_counter_read()
+ *	read the value of a counter opened with stress_perf_dtlb_open(),
+ *	stress_perf_cycles_open(), stress_perf_branch_misses_open(),
+ *	stress_perf_itlb_open() or stress_perf_l1i_open()
+ */
+bool stress_perf_counter_read(const int fd, uint64_t *value)
+{
+	if (fd < 0)
+		return false;
+	return read(fd, value, sizeof(*value)) == (ssize_t)sizeof(*value);
+}
+
+/*
+ *  stress_perf_cycles_read()
+ *	read the CPU cycles of a counter opened with
+ *	stress_perf_cycles_open(), falling back to the x86 TSC if
+ *	the counter is not available, returns false if neither is
+ */
+bool stress_perf_cycles_read(const int fd, uint64_t *cycles)
+{
+	if (stress_perf_counter_read(fd, cycles))
+		return true;
+#if defined(STRESS_ARCH_X86)
+	if (stress_cpu_x86_has_tsc()) {
+		*cycles = stress_asm_x86_rdtsc();
+		return true;
+	}
+#endif
+	return false;
+}
@@ -26,9 +26,27 @@ extern int stress_perf_enable(stress_perf_t *sp);
 extern int stress_perf_disable(stress_perf_t *sp);
 extern int stress_perf_close(stress_perf_t *sp);
 extern bool stress_perf_stat_succeeded(const stress_perf_t *sp);
+extern bool stress_perf_stat_ipc(const stress_perf_t *sp, double *ipc);
+extern bool stress_perf_stat_sum(const stress_stressor_t *ss, uint64_t *counter_totals);
+extern const char *stress_perf_stat_label(const int p, char *yaml_label, const size_t len);
 extern void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *procs_head,
 	const double duration);
 extern void stress_perf_init(void);
+extern int stress_set_perf_events(const char *opt);
+extern int stress_set_perf_sample_top(const char *opt);
+extern void stress_perf_sample_open(const stress_stressor_t *ss, const int32_t instance,
+	const pid_t pid);
+extern void stress_perf_sample_close(const stress_stressor_t *ss, const int32_t instance);
+extern void stress_perf_sample_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_perf_sample_free(void);
 #endif
 
+extern int stress_perf_dtlb_open(void);
+extern int stress_perf_cycles_open(void);
+extern int stress_perf_branch_misses_open(void);
+extern int stress_perf_itlb_open(void);
+extern int stress_perf_l1i_open(void);
+extern bool stress_perf_counter_read(const int fd, uint64_t *value);
+extern bool stress_perf_cycles_read(const int fd, uint64_t *cycles);
+
 #endif
@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-phase.h"
+
+typedef struct {
+	const stress_t *stressor;	/* stressor run in the phase */
+	int32_t from;			/* instances at start of phase */
+	int32_t to;			/* instances at end of phase */
+	int32_t started;		/* instances started */
+	uint64_t bogo_ops;		/* bogo ops over the phase */
+} stress_phase_stressor_t;
+
+typedef struct {
+	char name[32];			/* phase name */
+	uint64_t duration;		/* phase duration in seconds */
+	double run_time;		/* measured phase run time */
+	bool ran;			/* phase has been run */
+	size_t stressors_num;		/* number of stressors in phase */
+	stress_phase_stressor_t *stressors;
+} stress_phase_t;
+
+static stress_phase_t *phases;		/* job file phases */
+static uint32_t phases_num;		/* number of phases */
+static uint32_t phase_current;		/* phase being run */
+static uint64_t phases_duration;	/* total duration of all phases */
+
+/*
+ *  stress_phase_new()
+ *	start a new job file phase that runs for duration seconds
+ */
+int stress_phase_new(const uint64_t duration, const char *name)
+{
+	stress_phase_t *new_phases, *phase;
+
+	if (duration == 0) {
+		(void)fprintf(stderr, "phase duration must be at least 1 second\n");
+		return -1;
+	}
+	new_phases = realloc(phases, sizeof(*phases) * (phases_num + 1));
+	if (!new_phases) {
+		(void)fprintf(stderr, "out of memory allocating phase\n");
+		return -1;
+	}
+	phases = new_phases;
+	phase = &phases[phases_num];
+	(void)memset(phase, 0, sizeof(*phase));
+	phases_num++;
+	if (name)
+		(void)shim_strlcpy(phase->name, name, sizeof(phase->name));
+	else
+		(void)snprintf(phase->name, sizeof(phase->name), "phase-%" PRIu32, phases_num);
+	phase->duration = duration;
+	phases_duration += duration;
+
+	return 0;
+}
+
+/*
+ *  stress_phase_add()
+ *	add a stressor to the current phase, the number of running
+ *	instances is ramped from from to to over the phase
+ */
+int stress_phase_add(const stress_t *stressor, const int32_t from, const int32_t to)
+{
+	stress_phase_t *phase;
+	stress_phase_stressor_t *ps;
+	size_t i;
+
+	if (!phases_num)
+		return -1;
+	if ((from < 0) || (to < 0)) {
+		(void)fprintf(stderr, "phase instances must be 0 or more\n");
+		return -1;
+	}
+	phase = &phases[phases_num - 1];
+	for (i = 0; i < phase->stressors_num; i++) {
+		if (phase->stressors[i].stressor == stressor)
+			break;
+	}
+	if (i == phase->stressors_num) {
+		ps = realloc(phase->stressors, sizeof(*ps) * (phase->stressors_num + 1));
+		if (!ps) {
+			(void)fprintf(stderr, "out of memory allocating phase stressor\n");
+			return -1;
+		}
+		phase->stressors = ps;
+		phase->stressors_num++;
+	}
+	ps = &phase->stressors[i];
+	(void)memset(ps, 0, sizeof(*ps));
+	ps->stressor = stressor;
+	ps->from = from;
+	ps->to = to;
+
+	return 0;
+}
+
+/*
+ *  stress_phase_count()
+ *	number of job file phases, 0 if there are none
+ */
+uint32_t stress_phase_count(void)
+{
+	return phases_num;
+}
+
+/*
+ *  stress_phase_find()
+ *	find a stressor in a phase, NULL if it is not in the phase
+ */
+static stress_phase_stressor_t *stress_phase_find(
+	const stress_phase_t *phase,
+	const stress_t *stressor)
+{
+	size_t i;
+
+	for (i = 0; i < phase->stressors_num; i++) {
+		if (phase->stressors[i].stressor == stressor)
+			return &phase->stressors[i];
+	}
+	return NULL;
+}
+
+/*
+ *  stress_phase_max_instances()
+ *	maximum number of instances of a stressor over all the phases,
+ *	-1 if the stressor is not named in any of the phases
+ */
+static int32_t stress_phase_max_instances(const stress_t *stressor)
+{
+	int32_t max = -1;
+	uint32_t i;
+
+	for (i = 0; i < phases_num; i++) {
+		const stress_phase_stressor_t *ps = stress_phase_find(&phases[i], stressor);
+
+		if (ps)
+			max = STRESS_MAXIMUM(max, STRESS_MAXIMUM(ps->from, ps->to));
+	}
+	return max;
+}
+
+/*
+ *  stress_phase_named()
+ *	return true if a stressor is named in any of the phases
+ */
+bool stress_phase_named(const stress_t *stressor)
+{
+	return stress_phase_max_instances(stressor) >= 0;
+}
+
+/*
+ *  stress_phase_setup()
+ *	size the stressors for the largest number of instances they
+ *	run in any phase, stressors that are not named in any phase
+ *	run in all the phases
+ */
+int stress_phase_setup(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	uint32_t repeat = 1, i;
+
+	if (!phases_num)
+		return 0;
+	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+		pr_err("job file phases cannot be used with run sequential\n");
+		return -1;
+	}
+	(void)stress_get_setting("repeat", &repeat);
+	if (repeat > 1)
+		pr_inf("phase: job file phases are run once, ignoring --repeat\n");
+	if ((g_opt_timeout != TIMEOUT_NOT_SET) && (g_opt_timeout != phases_duration))
+		pr_inf("phase: using the phase durations, ignoring --timeout\n");
+	g_opt_timeout = phases_duration;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const int32_t max = stress_phase_max_instances(ss->stressor);
+
+		if (max >= 0) {
+			ss->num_instances = max;
+			continue;
+		}
+		if (ss->num_instances <= 0)
+			continue;
+		for (i = 0; i < phases_num; i++) {
+			stress_phase_stressor_t *ps;
+
+			ps = realloc(phases[i].stressors, sizeof(*ps) * (phases[i].stressors_num + 1));
+			if (!ps) {
+				pr_err("phase: out of memory allocating phase stressor\n");
+				return -1;
+			}
+			phases[i].stressors = ps;
+			ps = &phases[i].stressors[phases[i].stressors_num++];
+			(void)memset(ps, 0, sizeof(*ps));
+			ps->stressor = ss->stressor;
+			ps->from = ss->num_instances;
+			ps->to = ss->num_instances;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_phase_begin()
+ *	set the number of instances of each stressor and
+ *	the run time for a phase
+ */
+void stress_phase_begin(stress_stressor_t *stressors_list, const uint32_t phase)
+{
+	stress_stressor_t *ss;
+	const stress_phase_t *p = &phases[phase];
+
+	phase_current = phase;
+	g_opt_timeout = p->duration;
+
+	pr_inf("phase %" PRIu32 " of %" PRIu32 " (%s), %" PRIu64 " second%s\n",
+		phase + 1, phases_num, p->name, p->duration,
+		p->duration == 1 ? "" : "s");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_phase_stressor_t *ps = stress_phase_find(p, ss->stressor);
+
+		if (!ps) {
+			ss->num_instances = 0;
+			continue;
+		}
+		ss->num_instances = STRESS_MAXIMUM(ps->from, ps->to);
+		if (ps->from != ps->to) {
+			pr_inf("phase: ramping %s from %" PRId32 " to %" PRId32 " instances\n",
+				stress_munge_underscore(ss->stressor->name), ps->from, ps->to);
+		}
+	}
+}
+
+/*
+ *  stress_phase_end()
+ *	record the bogo ops of each stressor over the phase
+ */
+void stress_phase_end(
+	stress_stressor_t *stressors_list,
+	const uint32_t phase,
+	const double duration)
+{
+	stress_stressor_t *ss;
+	stress_phase_t *p = &phases[phase];
+
+	p->run_time = duration;
+	p->ran = true;
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_phase_stressor_t *ps = stress_phase_find(p, ss->stressor);
+		int32_t j;
+
+		if (!ps)
+			continue;
+		ps->started = ss->started_instances;
+		ps->bogo_ops = 0;
+		for (j = 0; j < ss->started_instances; j++)
+			ps->bogo_ops += ss->stats[j]->ci.counter;
+	}
+}
+
+/*
+ *  stress_phase_finish()
+ *	restore the stressors to the largest number of instances
+ *	and the timeout to the duration of all the phases
+ */
+void stress_phase_finish(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const int32_t max = stress_phase_max_instances(ss->stressor);
+
+		if (max >= 0)
+			ss->num_instances = max;
+	}
+	g_opt_timeout = phases_duration;
+}
+
+/*
+ *  stress_phase_ramp()
+ *	ramp the number of running instances of a stressor over
+ *	a phase in equal steps, ramping up delays the start of
+ *	the extra instances, ramping down stops instances early
+ */
+void stress_phase_ramp(const stress_stressor_t *ss, const int32_t instance)
+{
+	const stress_phase_t *p;
+	const stress_phase_stressor_t *ps;
+	int32_t lo, hi;
+	double step, t_start;
+
+	if (!phases_num || (g_opt_flags & OPT_FLAGS_DRY_RUN))
+		return;
+	p = &phases[phase_current];
+	ps = stress_phase_find(p, ss->stressor);
+	if (!ps || (ps->from == ps->to))
+		return;
+
+	lo = STRESS_MINIMUM(ps->from, ps->to);
+	hi = STRESS_MAXIMUM(ps->from, ps->to);
+	if (instance < lo)
+		return;
+	step = (double)p->duration / (double)(hi - lo + 1);
+
+	if (ps->from > ps->to) {
+		const double t_stop = step * (double)(hi - instance);
+
+		(void)alarm((unsigned int)STRESS_MAXIMUM(1.0, ceil(t_stop)));
+		return;
+	}
+
+	t_start = stress_time_now() + step * (double)(instance - lo + 1);
+	while (keep_stressing_flag()) {
+		const double t_delta = t_start - stress_time_now();
+
+		if (t_delta <= 0.0)
+			break;
+		(void)shim_nanosleep_uint64((uint64_t)(STRESS_MINIMUM(t_delta, 0.1) * STRESS_DBL_NANOSECOND));
+	}
+}
+
+/*
+ *  stress_phase_dump()
+ *	dump the bogo ops of each stressor in each phase
+ */
+void stress_phase_dump(FILE *yaml)
+{
+	uint32_t i;
+
+	if (!phases_num)
+		return;
+
+	pr_lock();
+	pr_metrics("bogo ops per phase:\n");
+	pr_metrics("%-5s %-16s %-13s %9s %12s %12s\n",
+		"phase", "name", "stressor", "instances", "bogo ops", "bogo ops/s");
+	pr_yaml(yaml, "phases:\n");
+
+	for (i = 0; i < phases_num; i++) {
+		const stress_phase_t *p = &phases[i];
+		size_t j;
+
+		if (!p->ran)
+			continue;
+		pr_yaml(yaml, "    - phase: %" PRIu32 "\n", i + 1);
+		pr_yaml(yaml, "      name: %s\n", p->name);
+		pr_yaml(yaml, "      duration: %" PRIu64 "\n", p->duration);
+		pr_yaml(yaml, "      run-time: %f\n", p->run_time);
+		pr_yaml(yaml, "      stressors:\n");
+
+		for (j = 0; j < p->stressors_num; j++) {
+			const stress_phase_stressor_t *ps = &p->stressors[j];
+			const char *munged = stress_munge_underscore(ps->stressor->name);
+			const double rate = (p->run_time > 0.0) ?
+				(double)ps->bogo_ops / p->run_time : 0.0;
+			char instances[32];
+
+			if (ps->from == ps->to)
+				(void)snprintf(instances, sizeof(instances), "%" PRId32, ps->from);
+			else
+				(void)snprintf(instances, sizeof(instances), "%" PRId32 "->%" PRId32,
+					ps->from, ps->to);
+
+			if (g_opt_flags & OPT_FLAGS_SN) {
+				pr_metrics("%5" PRIu32 " %-16s %-13s %9s %12" PRIu64 " %12.5e\n",
+					i + 1, p->name, munged, instances, ps->bogo_ops, rate);
+			} else {
+				pr_metrics("%5" PRIu32 " %-16s %-13s %9s %12" PRIu64 " %12.2f\n",
+					i + 1, p->name, munged, instances, ps->bogo_ops, rate);
+			}
+			pr_yaml(yaml, "        - stressor: %s\n", munged);
+			pr_yaml(yaml, "          instances: %" PRId32 "\n", ps->from);
+			if (ps->from != ps->to)
+				pr_yaml(yaml, "          instances-end: %" PRId32 "\n", ps->to);
+			pr_yaml(yaml, "          instances-started: %" PRId32 "\n", ps->started);
+			pr_yaml(yaml, "          bogo-ops: %" PRIu64 "\n", ps->bogo_ops);
+			pr_yaml(yaml, "          bogo-ops-per-second-real-time: %f\n", rate);
+		}
+	}
+	pr_yaml(yaml, "\n");
+	pr_unlock();
+}
+
+/*
+ *  stress_phase_free()
+ *	free the job file phases
+ */
+void stress_phase_free(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < phases_num; i++)
+		free(phases[i].stressors);
+	free(phases);
+	phases = NULL;
+	phases_num = 0;
+	phases_duration = 0;
+}
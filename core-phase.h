@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_PHASE_H
+#define CORE_PHASE_H
+
+/* job file phases, time sequenced stressor sets */
+extern int stress_phase_new(const uint64_t duration, const char *name);
+extern int stress_phase_add(const stress_t *stressor, const int32_t from, const int32_t to);
+extern uint32_t stress_phase_count(void);
+extern bool stress_phase_named(const stress_t *stressor);
+extern int stress_phase_setup(stress_stressor_t *stressors_list);
+extern void stress_phase_begin(stress_stressor_t *stressors_list, const uint32_t phase);
+extern void stress_phase_end(stress_stressor_t *stressors_list, const uint32_t phase,
+	const double duration);
+extern void stress_phase_finish(stress_stressor_t *stressors_list);
+extern void stress_phase_ramp(const stress_stressor_t *ss, const int32_t instance);
+extern void stress_phase_dump(FILE *yaml);
+extern void stress_phase_free(void);
+
+#endif
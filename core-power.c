@@ -0,0 +1,624 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-power.h"
+
+#define POWER_CSTATES_MAX	(16)	/* maximum cpuidle states tracked */
+#define POWER_RAPL_MAX		(16)	/* maximum RAPL package and dram domains */
+
+#define MSR_IA32_TSC		(0x10)
+#define MSR_IA32_MPERF		(0xe7)
+#define MSR_IA32_APERF		(0xe8)
+
+#if defined(__linux__)
+
+typedef struct {
+	char path[PATH_MAX + 32];	/* energy_uj file */
+	uint64_t max_range;		/* max_energy_range_uj, counter wraps at this */
+	bool dram;			/* dram rather than package domain */
+} stress_power_rapl_t;
+
+/* a snapshot of the system wide counters */
+typedef struct {
+	double time;
+	uint64_t rapl_uj[POWER_RAPL_MAX];
+	uint64_t aperf;			/* summed over the CPUs */
+	uint64_t mperf;
+	uint64_t tsc;
+	uint64_t cstate_usecs[POWER_CSTATES_MAX];
+} stress_power_sample_t;
+
+/* per stressor accumulated power and frequency */
+typedef struct {
+	const stress_stressor_t *ss;
+	double duration;		/* time measured over, seconds */
+	double pkg_joules;
+	double dram_joules;
+	uint64_t ops;			/* bogo ops while measured */
+	uint64_t aperf;
+	uint64_t mperf;
+	uint64_t tsc;
+	uint64_t cstate_usecs[POWER_CSTATES_MAX];
+	bool shared;			/* run in parallel with other stressors */
+} stress_power_t;
+
+static stress_power_rapl_t power_rapl[POWER_RAPL_MAX];
+static size_t power_rapl_num;
+static bool power_rapl_dram;
+static int *power_msr_fds;		/* /dev/cpu/N/msr fds, -1 if not open */
+static int32_t power_cpus;
+static int32_t power_msr_cpus;		/* number of CPUs with an open msr fd */
+static bool power_msr;
+static char power_cstate_names[POWER_CSTATES_MAX][16];
+static size_t power_cstates_num;
+static stress_power_t *powers;
+static size_t powers_num;
+static stress_power_sample_t power_begin;
+static double power_step_joules = -1.0;	/* energy of last run step, < 0 unknown */
+
+/*
+ *  stress_power_read_uint64()
+ *	read a uint64_t value from a sysfs file
+ */
+static int stress_power_read_uint64(const char *path, uint64_t *val)
+{
+	char buf[64];
+
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return -1;
+	return (sscanf(buf, "%" SCNu64, val) == 1) ? 0 : -1;
+}
+
+/*
+ *  stress_power_rapl_add()
+ *	add a powercap RAPL domain if it is a package or dram domain
+ */
+static void stress_power_rapl_add(const char *dir)
+{
+	stress_power_rapl_t *rapl;
+	char path[PATH_MAX + 32], name[64];
+
+	if (power_rapl_num >= POWER_RAPL_MAX)
+		return;
+	(void)snprintf(path, sizeof(path), "%s/name", dir);
+	if (system_read(path, name, sizeof(name)) <= 0)
+		return;
+	name[strcspn(name, "\n")] = '\0';
+	/* core, uncore and psys overlap the package domains */
+	if (strncmp(name, "package", 7) && strcmp(name, "dram"))
+		return;
+
+	rapl = &power_rapl[power_rapl_num];
+	rapl->dram = !strcmp(name, "dram");
+	(void)snprintf(path, sizeof(path), "%s/max_energy_range_uj", dir);
+	if (stress_power_read_uint64(path, &rapl->max_range) < 0)
+		rapl->max_range = 0;
+	(void)snprintf(rapl->path, sizeof(rapl->path), "%s/energy_uj", dir);
+	if (access(rapl->path, R_OK) < 0)
+		return;
+	if (rapl->dram)
+		power_rapl_dram = true;
+	power_rapl_num++;
+}
+
+/*
+ *  stress_power_rapl_init()
+ *	find the RAPL package and dram energy counters, the zones
+ *	are intel-rapl:N for packages with intel-rapl:N:M subzones
+ */
+static void stress_power_rapl_init(void)
+{
+	DIR *dp;
+	const struct dirent *d;
+	static const char powercap[] = "/sys/class/powercap";
+
+	power_rapl_num = 0;
+	power_rapl_dram = false;
+	dp = opendir(powercap);
+	if (!dp)
+		return;
+	while ((d = readdir(dp)) != NULL) {
+		char dir[PATH_MAX];
+
+		if (strncmp(d->d_name, "intel-rapl:", 11))
+			continue;
+		(void)snprintf(dir, sizeof(dir), "%s/%s", powercap, d->d_name);
+		stress_power_rapl_add(dir);
+	}
+	(void)closedir(dp);
+}
+
+/*
+ *  stress_power_msr_init()
+ *	open the msr device of each CPU to read APERF, MPERF and
+ *	the TSC, this needs root and the msr driver to be loaded
+ */
+static void stress_power_msr_init(void)
+{
+	int32_t cpu;
+
+	power_msr = false;
+	power_msr_cpus = 0;
+#if defined(STRESS_ARCH_X86)
+	power_msr_fds = calloc((size_t)power_cpus, sizeof(*power_msr_fds));
+	if (!power_msr_fds)
+		return;
+	for (cpu = 0; cpu < power_cpus; cpu++) {
+		char path[64];
+
+		(void)snprintf(path, sizeof(path), "/dev/cpu/%" PRId32 "/msr", cpu);
+		power_msr_fds[cpu] = open(path, O_RDONLY);
+		if (power_msr_fds[cpu] >= 0)
+			power_msr_cpus++;
+	}
+	power_msr = (power_msr_cpus > 0);
+#else
+	(void)cpu;
+#endif
+}
+
+/*
+ *  stress_power_cstate_init()
+ *	get the names of the cpuidle states, these are
+ *	assumed to be the same on all the CPUs
+ */
+static void stress_power_cstate_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < POWER_CSTATES_MAX; i++) {
+		char path[PATH_MAX], name[32];
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/cpu/cpu0/cpuidle/state%zu/name", i);
+		if (system_read(path, name, sizeof(name)) <= 0)
+			break;
+		name[strcspn(name, "\n")] = '\0';
+		(void)shim_strlcpy(power_cstate_names[i], name, sizeof(power_cstate_names[i]));
+	}
+	power_cstates_num = i;
+}
+
+/*
+ *  stress_power_sample()
+ *	snapshot the energy, frequency and idle state counters
+ */
+static void stress_power_sample(stress_power_sample_t *sample)
+{
+	size_t i;
+	int32_t cpu;
+
+	(void)memset(sample, 0, sizeof(*sample));
+	sample->time = stress_time_now();
+
+	for (i = 0; i < power_rapl_num; i++)
+		(void)stress_power_read_uint64(power_rapl[i].path, &sample->rapl_uj[i]);
+
+	for (cpu = 0; cpu < power_cpus; cpu++) {
+		if (power_msr) {
+			const int fd = power_msr_fds[cpu];
+			uint64_t aperf, mperf, tsc;
+
+			if ((fd >= 0) &&
+			    (pread(fd, &aperf, sizeof(aperf), MSR_IA32_APERF) == sizeof(aperf)) &&
+			    (pread(fd, &mperf, sizeof(mperf), MSR_IA32_MPERF) == sizeof(mperf)) &&
+			    (pread(fd, &tsc, sizeof(tsc), MSR_IA32_TSC) == sizeof(tsc))) {
+				sample->aperf += aperf;
+				sample->mperf += mperf;
+				sample->tsc += tsc;
+			}
+		}
+		for (i = 0; i < power_cstates_num; i++) {
+			char path[PATH_MAX];
+			uint64_t usecs;
+
+			(void)snprintf(path, sizeof(path),
+				"/sys/devices/system/cpu/cpu%" PRId32 "/cpuidle/state%zu/time", cpu, i);
+			if (stress_power_read_uint64(path, &usecs) == 0)
+				sample->cstate_usecs[i] += usecs;
+		}
+	}
+}
+
+/*
+ *  stress_power_delta()
+ *	difference of two counter readings, RAPL counters
+ *	wrap around at their maximum energy range
+ */
+static inline uint64_t stress_power_delta(
+	const uint64_t begin,
+	const uint64_t end,
+	const uint64_t max_range)
+{
+	if (end >= begin)
+		return end - begin;
+	return max_range ? (max_range - begin) + end : 0;
+}
+
+/*
+ *  stress_power_init()
+ *	find the available power, frequency and idle state counters
+ */
+void stress_power_init(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t n;
+
+	if (!(g_opt_flags & OPT_FLAGS_POWER))
+		return;
+
+	power_cpus = stress_get_processors_configured();
+	if (power_cpus < 1)
+		power_cpus = 1;
+	stress_power_rapl_init();
+	stress_power_msr_init();
+	stress_power_cstate_init();
+
+	if (!power_rapl_num)
+		pr_inf("power: no RAPL package energy counters in /sys/class/powercap, "
+			"energy and ops per joule will not be reported\n");
+#if defined(STRESS_ARCH_X86)
+	if (!power_msr)
+		pr_inf("power: cannot read APERF/MPERF, the msr driver needs to be loaded "
+			"and stress-ng run as root, effective frequency will not be reported\n");
+#endif
+	if (!power_cstates_num)
+		pr_inf("power: no cpuidle states, C-state residency will not be reported\n");
+
+	for (n = 0, ss = stressors_list; ss; ss = ss->next)
+		n++;
+	powers = calloc(n, sizeof(*powers));
+	if (!powers) {
+		pr_inf("power: cannot allocate power table, disabling --power\n");
+		g_opt_flags &= ~OPT_FLAGS_POWER;
+		return;
+	}
+	for (powers_num = 0, ss = stressors_list; ss; ss = ss->next)
+		powers[powers_num++].ss = ss;
+}
+
+/*
+ *  stress_power_step_begin()
+ *	snapshot the counters before a run step
+ */
+void stress_power_step_begin(void)
+{
+	if (!(g_opt_flags & OPT_FLAGS_POWER))
+		return;
+	stress_power_sample(&power_begin);
+}
+
+/*
+ *  stress_power_step_end()
+ *	add the energy, frequency and idle state counts of a run step
+ *	to each of the stressors that were run, energy is system wide
+ *	so stressors run in parallel share the same energy
+ */
+void stress_power_step_end(const stress_stressor_t *list)
+{
+	stress_power_sample_t end;
+	const stress_stressor_t *ss;
+	size_t i, running = 0;
+	double duration;
+
+	if (!(g_opt_flags & OPT_FLAGS_POWER) || !powers)
+		return;
+	stress_power_sample(&end);
+	duration = end.time - power_begin.time;
+
+	power_step_joules = power_rapl_num ? 0.0 : -1.0;
+	for (i = 0; i < power_rapl_num; i++)
+		power_step_joules += (double)stress_power_delta(power_begin.rapl_uj[i],
+			end.rapl_uj[i], power_rapl[i].max_range) / STRESS_DBL_MICROSECOND;
+
+	for (ss = list; ss; ss = ss->next) {
+		if (ss->started_instances > 0)
+			running++;
+	}
+
+	for (ss = list; ss; ss = ss->next) {
+		stress_power_t *power = NULL;
+		int32_t j;
+
+		if (ss->started_instances <= 0)
+			continue;
+		for (i = 0; i < powers_num; i++) {
+			if (powers[i].ss == ss) {
+				power = &powers[i];
+				break;
+			}
+		}
+		if (!power)
+			continue;
+
+		power->duration += duration;
+		for (i = 0; i < power_rapl_num; i++) {
+			const double joules = (double)stress_power_delta(power_begin.rapl_uj[i],
+				end.rapl_uj[i], power_rapl[i].max_range) / STRESS_DBL_MICROSECOND;
+
+			if (power_rapl[i].dram)
+				power->dram_joules += joules;
+			else
+				power->pkg_joules += joules;
+		}
+		power->aperf += end.aperf - power_begin.aperf;
+		power->mperf += end.mperf - power_begin.mperf;
+		power->tsc += end.tsc - power_begin.tsc;
+		for (i = 0; i < power_cstates_num; i++)
+			power->cstate_usecs[i] += end.cstate_usecs[i] - power_begin.cstate_usecs[i];
+		for (j = 0; j < ss->started_instances; j++)
+			power->ops += ss->stats[j]->ci.counter;
+		if (running > 1)
+			power->shared = true;
+	}
+}
+
+/*
+ *  stress_power_step_joules()
+ *	package and dram energy used by the last run step,
+ *	negative if it was not measured
+ */
+double stress_power_step_joules(void)
+{
+	return power_step_joules;
+}
+
+/*
+ *  stress_power_rapl_joules()
+ *	current sum of the RAPL package energy counters in joules so
+ *	that stressors can measure the energy of a short phase without
+ *	--power, negative if there are no counters, the difference of
+ *	two readings is negative if a counter wrapped and is not valid
+ */
+double stress_power_rapl_joules(void)
+{
+	static bool probed = false;
+	uint64_t total = 0;
+	size_t i;
+
+	if (!power_rapl_num && !probed) {
+		probed = true;
+		stress_power_rapl_init();
+	}
+	if (!power_rapl_num)
+		return -1.0;
+	for (i = 0; i < power_rapl_num; i++) {
+		uint64_t uj;
+
+		if (power_rapl[i].dram)
+			continue;
+		if (stress_power_read_uint64(power_rapl[i].path, &uj) < 0)
+			return -1.0;
+		total += uj;
+	}
+	return (double)total / 1000000.0;
+}
+
+/*
+ *  stress_power_find()
+ *	find the measured power of a stressor
+ */
+static const stress_power_t *stress_power_find(const stress_stressor_t *ss)
+{
+	size_t i;
+
+	for (i = 0; i < powers_num; i++) {
+		if ((powers[i].ss == ss) && (powers[i].duration > 0.0))
+			return &powers[i];
+	}
+	return NULL;
+}
+
+/*
+ *  stress_power_ghz()
+ *	effective frequency of the CPUs when not idle, this is the
+ *	TSC frequency scaled by the APERF/MPERF ratio
+ */
+static double stress_power_ghz(const stress_power_t *power)
+{
+	double tsc_hz;
+
+	if (!power->mperf || !power->tsc)
+		return 0.0;
+	tsc_hz = (double)power->tsc / (power->duration * (double)power_msr_cpus);
+	return tsc_hz * ((double)power->aperf / (double)power->mperf) / 1.0E9;
+}
+
+/*
+ *  stress_power_yaml()
+ *	dump the energy, frequency and C-state residency
+ *	of a stressor to the yaml file
+ */
+void stress_power_yaml(FILE *yaml, const stress_stressor_t *ss)
+{
+	const stress_power_t *power;
+	size_t i;
+
+	if (!(g_opt_flags & OPT_FLAGS_POWER))
+		return;
+	power = stress_power_find(ss);
+	if (!power)
+		return;
+
+	if (power_rapl_num) {
+		const double joules = power->pkg_joules + power->dram_joules;
+
+		pr_yaml(yaml, "      energy-package-joules: %f\n", power->pkg_joules);
+		pr_yaml(yaml, "      power-package-watts: %f\n", power->pkg_joules / power->duration);
+		if (power_rapl_dram) {
+			pr_yaml(yaml, "      energy-dram-joules: %f\n", power->dram_joules);
+			pr_yaml(yaml, "      power-dram-watts: %f\n", power->dram_joules / power->duration);
+		}
+		if (joules > 0.0)
+			pr_yaml(yaml, "      bogo-ops-per-joule: %f\n", (double)power->ops / joules);
+		pr_yaml(yaml, "      energy-shared: %s\n", power->shared ? "true" : "false");
+	}
+	if (power->mperf && power->tsc) {
+		pr_yaml(yaml, "      effective-cpu-ghz: %f\n", stress_power_ghz(power));
+		pr_yaml(yaml, "      cpu-busy-percent: %f\n",
+			100.0 * (double)power->mperf / (double)power->tsc);
+	}
+	for (i = 0; i < power_cstates_num; i++) {
+		pr_yaml(yaml, "      cstate-%s-residency-percent: %f\n", power_cstate_names[i],
+			100.0 * (double)power->cstate_usecs[i] /
+			(power->duration * (double)power_cpus * STRESS_DBL_MICROSECOND));
+	}
+}
+
+/*
+ *  stress_power_dump()
+ *	dump the energy, ops per joule, effective frequency
+ *	and C-state residency of each stressor
+ */
+void stress_power_dump(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool header = false, shared = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_POWER))
+		return;
+	if (!power_rapl_num && !power_msr && !power_cstates_num)
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_power_t *power = stress_power_find(ss);
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		char pkg_w[16], dram_w[16], joules[16], ops_j[16], ghz[16], busy[16];
+		size_t i;
+
+		if (!power)
+			continue;
+		if (!header) {
+			pr_metrics("power and frequency (energy is system wide while the stressor ran):\n");
+			pr_metrics("%-13s %9s %9s %11s %12s %8s %6s\n",
+				"stressor", "pkg W", "dram W", "joules", "ops/joule", "eff GHz", "busy%");
+			header = true;
+		}
+		(void)shim_strlcpy(pkg_w, "-", sizeof(pkg_w));
+		(void)shim_strlcpy(dram_w, "-", sizeof(dram_w));
+		(void)shim_strlcpy(joules, "-", sizeof(joules));
+		(void)shim_strlcpy(ops_j, "-", sizeof(ops_j));
+		(void)shim_strlcpy(ghz, "-", sizeof(ghz));
+		(void)shim_strlcpy(busy, "-", sizeof(busy));
+		if (power_rapl_num) {
+			const double total = power->pkg_joules + power->dram_joules;
+
+			(void)snprintf(pkg_w, sizeof(pkg_w), "%.2f", power->pkg_joules / power->duration);
+			if (power_rapl_dram)
+				(void)snprintf(dram_w, sizeof(dram_w), "%.2f", power->dram_joules / power->duration);
+			(void)snprintf(joules, sizeof(joules), "%.2f", total);
+			if (total > 0.0)
+				(void)snprintf(ops_j, sizeof(ops_j), "%.2f", (double)power->ops / total);
+		}
+		if (power->mperf && power->tsc) {
+			(void)snprintf(ghz, sizeof(ghz), "%.2f", stress_power_ghz(power));
+			(void)snprintf(busy, sizeof(busy), "%.2f",
+				100.0 * (double)power->mperf / (double)power->tsc);
+		}
+		pr_metrics("%-13s %9s %9s %11s %12s %8s %6s%s\n",
+			munged, pkg_w, dram_w, joules, ops_j, ghz, busy,
+			power->shared ? " *" : "");
+		if (power->shared)
+			shared = true;
+
+		if (power_cstates_num) {
+			char buf[256];
+			size_t len = 0;
+
+			*buf = '\0';
+			for (i = 0; (i < power_cstates_num) && (len < sizeof(buf)); i++) {
+				const double pc = 100.0 * (double)power->cstate_usecs[i] /
+					(power->duration * (double)power_cpus * STRESS_DBL_MICROSECOND);
+
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %s %.2f%%",
+					power_cstate_names[i], pc);
+			}
+			pr_metrics("%-13s C-state residency:%s\n", "", buf);
+		}
+	}
+	if (shared)
+		pr_metrics("* energy is shared by the stressors run in parallel, use --seq "
+			"to measure the energy of each stressor\n");
+}
+
+/*
+ *  stress_power_free()
+ *	close the msr devices and free the power table
+ */
+void stress_power_free(void)
+{
+	int32_t cpu;
+
+	if (power_msr_fds) {
+		for (cpu = 0; cpu < power_cpus; cpu++) {
+			if (power_msr_fds[cpu] >= 0)
+				(void)close(power_msr_fds[cpu]);
+		}
+		free(power_msr_fds);
+		power_msr_fds = NULL;
+	}
+	free(powers);
+	powers = NULL;
+	powers_num = 0;
+}
+
+#else
+void stress_power_init(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+
+	if (g_opt_flags & OPT_FLAGS_POWER)
+		pr_inf("power: power telemetry is only supported on Linux, ignoring --power\n");
+}
+
+void stress_power_step_begin(void)
+{
+}
+
+void stress_power_step_end(const stress_stressor_t *list)
+{
+	(void)list;
+}
+
+double stress_power_step_joules(void)
+{
+	return -1.0;
+}
+
+double stress_power_rapl_joules(void)
+{
+	return -1.0;
+}
+
+void stress_power_yaml(FILE *yaml, const stress_stressor_t *ss)
+{
+	(void)yaml;
+	(void)ss;
+}
+
+void stress_power_dump(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+}
+
+void stress_power_free(void)
+{
+}
+#endif
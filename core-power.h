@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_POWER_H
+#define CORE_POWER_H
+
+/* RAPL energy, effective frequency and C-state residency */
+extern void stress_power_init(stress_stressor_t *stressors_list);
+extern void stress_power_step_begin(void);
+extern void stress_power_step_end(const stress_stressor_t *list);
+extern double stress_power_step_joules(void);
+extern double stress_power_rapl_joules(void);
+extern void stress_power_yaml(FILE *yaml, const stress_stressor_t *ss);
+extern void stress_power_dump(stress_stressor_t *stressors_list);
+extern void stress_power_free(void);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-rate.h"
+
+#define STRESS_RATE_SPIN	(0.0001)	/* busy-wait the last 100us before an op is due */
+#define STRESS_RATE_BACKLOG	(1.0)		/* maximum seconds of ops to catch up on */
+
+/*
+ *  stress_rate_init()
+ *	initialize open loop pacing of ops_rate bogo ops per second
+ */
+void stress_rate_init(stress_rate_t *rate, const double ops_rate)
+{
+	(void)memset(rate, 0, sizeof(*rate));
+	rate->ops_rate = ops_rate;
+	rate->period = 1.0 / ops_rate;
+}
+
+/*
+ *  stress_rate_pace()
+ *	delay the next bogo op until it is due, ops are due at a fixed
+ *	period from the first op independent of how long each op takes
+ *	so the offered load does not drop when ops are slow, ops that
+ *	are late run straight away to catch up with the schedule. Only
+ *	the first call after the op counter has changed is paced so
+ *	stressors may call keep_stressing() many times per op.
+ *	Sleeps with nanosleep and busy-waits the final STRESS_RATE_SPIN
+ *	seconds to keep the pacing jitter low. Returns false if the
+ *	stressor should stop. Processes that do not increment the
+ *	bogo op counter can be paced on their own op counter.
+ */
+bool stress_rate_pace_counter(const stress_args_t *args, const uint64_t counter)
+{
+	stress_rate_t *rate = args->rate;
+	double now, due;
+
+	if (LIKELY(counter == rate->counter) && (rate->t_start > 0.0))
+		return true;
+
+	now = stress_time_now();
+	if (UNLIKELY((rate->t_start <= 0.0) || (counter < rate->base))) {
+		/* first op or the counter was reset, restart the schedule */
+		rate->t_start = now;
+		rate->base = counter;
+		rate->counter = counter;
+		if (args->latency)
+			rate->due_ns = stress_latency_now();
+		return true;
+	}
+	rate->counter = counter;
+
+	due = rate->t_start + (double)(counter - rate->base) * rate->period;
+	if (now - due > STRESS_RATE_BACKLOG) {
+		/* too far behind, drop the backlog of ops */
+		const double behind = now - due - STRESS_RATE_BACKLOG;
+
+		rate->dropped += (uint64_t)(behind * rate->ops_rate);
+		rate->t_start += behind;
+		due += behind;
+	}
+
+	while (now < due) {
+		const double delta = due - now;
+
+		if (UNLIKELY(!keep_stressing_flag()))
+			return false;
+		if (delta > STRESS_RATE_SPIN)
+			(void)shim_nanosleep_uint64((uint64_t)((delta - STRESS_RATE_SPIN) * STRESS_DBL_NANOSECOND));
+		now = stress_time_now();
+	}
+
+	rate->late_total += now - due;
+	if (rate->late_max < now - due)
+		rate->late_max = now - due;
+	rate->paced++;
+	if (args->latency) {
+		/* time the op was due on the latency histogram clock */
+		const uint64_t now_ns = stress_latency_now();
+		const uint64_t late_ns = (uint64_t)((now - due) * STRESS_DBL_NANOSECOND);
+
+		rate->due_ns = (late_ns < now_ns) ? now_ns - late_ns : now_ns;
+	}
+	return keep_stressing_flag();
+}
+
+/*
+ *  stress_rate_pace()
+ *	pace on the bogo op counter, called by keep_stressing()
+ */
+bool stress_rate_pace(const stress_args_t *args)
+{
+	return stress_rate_pace_counter(args, args->ci->counter);
+}
+
+/*
+ *  stress_rate_report()
+ *	report the offered and achieved rates and the pacing lateness
+ */
+void stress_rate_report(const stress_args_t *args)
+{
+	const stress_rate_t *rate = args->rate;
+	double duration, achieved;
+
+	if (!rate || (rate->t_start <= 0.0))
+		return;
+
+	duration = stress_time_now() - rate->t_start;
+	if (duration <= 0.0)
+		return;
+	achieved = (double)(args->ci->counter - rate->base) / duration;
+
+	pr_dbg("%s: offered %.2f bogo ops/s, achieved %.2f bogo ops/s, "
+		"mean lateness %.2f us, max lateness %.2f us, %" PRIu64 " ops dropped "
+		"(instance %" PRIu32 ")\n",
+		args->name, rate->ops_rate, achieved,
+		rate->paced ? (rate->late_total / (double)rate->paced) * 1000000.0 : 0.0,
+		rate->late_max * 1000000.0, rate->dropped, args->instance);
+	if (achieved < rate->ops_rate * 0.9)
+		pr_inf("%s: only achieved %.2f of the offered %.2f bogo ops/s "
+			"(instance %" PRIu32 ")\n",
+			args->name, achieved, rate->ops_rate, args->instance);
+}
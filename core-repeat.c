@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-perf.h"
+#include "core-repeat.h"
+
+#define REPEAT_MIN	(1)
+#define REPEAT_MAX	(100000)
+
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+#define STRESS_REPEAT_PERF	(1)
+#endif
+
+typedef struct {
+	stress_stressor_t *ss;		/* stressor being repeated */
+	double *bogo_rate;		/* real time bogo-ops/s of each run */
+#if defined(STRESS_REPEAT_PERF)
+	double *perf_rate;		/* perf counters/s of each run, < 0 = invalid */
+#endif
+} stress_repeat_info_t;
+
+typedef struct {
+	double mean;			/* arithmetic mean */
+	double stddev;			/* sample standard deviation */
+	double min;			/* minimum */
+	double max;			/* maximum */
+	double ci95;			/* half width of 95% confidence interval */
+} stress_repeat_stats_t;
+
+/*
+ *  two tailed 95% critical values of Student's t distribution
+ *  for 1..30 degrees of freedom, larger sample sizes use 1.96
+ */
+static const double t_values_95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+/*
+ *  stress_repeat_t_value_95()
+ *	two tailed 95% critical value of Student's t distribution
+ */
+double stress_repeat_t_value_95(const size_t dof)
+{
+	return ((dof > 0) && (dof <= SIZEOF_ARRAY(t_values_95))) ?
+		t_values_95[dof - 1] : 1.96;
+}
+
+static stress_repeat_info_t *repeat_info;	/* per stressor run data */
+static size_t repeat_info_num;			/* number of stressors */
+static uint32_t repeat_runs;			/* number of runs to perform */
+static uint32_t repeat_recorded;		/* number of runs recorded */
+
+/*
+ *  stress_set_repeat()
+ *	set number of times to repeat the run
+ */
+int stress_set_repeat(const char *opt)
+{
+	uint32_t repeat;
+
+	repeat = stress_get_uint32(opt);
+	stress_check_range("repeat", (uint64_t)repeat, REPEAT_MIN, REPEAT_MAX);
+	return stress_set_setting_global("repeat", TYPE_ID_UINT32, &repeat);
+}
+
+/*
+ *  stress_repeat_init()
+ *	allocate per run result storage, returns the number
+ *	of times the stressors should be run
+ */
+uint32_t stress_repeat_init(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t i;
+
+	repeat_runs = 1;
+	repeat_recorded = 0;
+	(void)stress_get_setting("repeat", &repeat_runs);
+	if (repeat_runs < 2)
+		return 1;
+
+	for (repeat_info_num = 0, ss = stressors_list; ss; ss = ss->next)
+		repeat_info_num++;
+
+	repeat_info = calloc(repeat_info_num, sizeof(*repeat_info));
+	if (!repeat_info)
+		goto err;
+
+	for (i = 0, ss = stressors_list; ss; ss = ss->next, i++) {
+		repeat_info[i].ss = ss;
+		repeat_info[i].bogo_rate = calloc(repeat_runs, sizeof(*repeat_info[i].bogo_rate));
+		if (!repeat_info[i].bogo_rate)
+			goto err;
+#if defined(STRESS_REPEAT_PERF)
+		repeat_info[i].perf_rate = calloc((size_t)repeat_runs * STRESS_PERF_MAX,
+						  sizeof(*repeat_info[i].perf_rate));
+		if (!repeat_info[i].perf_rate)
+			goto err;
+#endif
+	}
+	return repeat_runs;
+err:
+	pr_inf("repeat: cannot allocate run statistics, running just once\n");
+	stress_repeat_free();
+	return 1;
+}
+
+/*
+ *  stress_repeat_record()
+ *	record the results of the run that has just completed
+ */
+void stress_repeat_record(void)
+{
+	size_t i;
+
+	if (!repeat_info || (repeat_recorded >= repeat_runs))
+		return;
+
+	for (i = 0; i < repeat_info_num; i++) {
+		const stress_stressor_t *ss = repeat_info[i].ss;
+		double r_time;
+
+		repeat_info[i].bogo_rate[repeat_recorded] = stress_bogo_rate_real_time(ss, &r_time);
+#if defined(STRESS_REPEAT_PERF)
+		{
+			uint64_t counter_totals[STRESS_PERF_MAX];
+			double *perf_rate = repeat_info[i].perf_rate + ((size_t)repeat_recorded * STRESS_PERF_MAX);
+			int p;
+
+			if (!stress_perf_stat_sum(ss, counter_totals) || (r_time <= 0.0)) {
+				for (p = 0; p < STRESS_PERF_MAX; p++)
+					perf_rate[p] = -1.0;
+				continue;
+			}
+			for (p = 0; p < STRESS_PERF_MAX; p++) {
+				perf_rate[p] = (counter_totals[p] == STRESS_PERF_INVALID) ?
+					-1.0 : (double)counter_totals[p] / r_time;
+			}
+		}
+#endif
+	}
+	repeat_recorded++;
+}
+
+/*
+ *  stress_repeat_stats()
+ *	compute statistics of n samples that are stride doubles apart,
+ *	returns false if there are no samples or any are invalid (< 0)
+ */
+static bool stress_repeat_stats(
+	const double *samples,
+	const size_t n,
+	const size_t stride,
+	stress_repeat_stats_t *stats)
+{
+	double sum = 0.0, sum_sq = 0.0;
+	size_t i;
+
+	if (!n)
+		return false;
+
+	stats->min = samples[0];
+	stats->max = samples[0];
+	for (i = 0; i < n; i++) {
+		const double v = samples[i * stride];
+
+		if (v < 0.0)
+			return false;
+		if (v < stats->min)
+			stats->min = v;
+		if (v > stats->max)
+			stats->max = v;
+		sum += v;
+	}
+	stats->mean = sum / (double)n;
+
+	for (i = 0; i < n; i++) {
+		const double d = samples[i * stride] - stats->mean;
+
+		sum_sq += d * d;
+	}
+	if (n > 1) {
+		const size_t dof = n - 1;
+		const double t = stress_repeat_t_value_95(dof);
+
+		stats->stddev = sqrt(sum_sq / (double)dof);
+		stats->ci95 = t * stats->stddev / sqrt((double)n);
+	} else {
+		stats->stddev = 0.0;
+		stats->ci95 = 0.0;
+	}
+	return true;
+}
+
+/*
+ *  stress_repeat_yaml_value()
+ *	emit a yaml label with name label + sep + suffix
+ */
+static void stress_repeat_yaml_value(
+	FILE *yaml,
+	const char *label,
+	const char *sep,
+	const char *suffix,
+	const double value)
+{
+	if (g_opt_flags & OPT_FLAGS_SN)
+		pr_yaml(yaml, "      %s%s%s: %e\n", label, sep, suffix, value);
+	else
+		pr_yaml(yaml, "      %s%s%s: %f\n", label, sep, suffix, value);
+}
+
+/*
+ *  stress_repeat_yaml()
+ *	emit the statistics of a metric as yaml, sep is the
+ *	separator used between the words in the label names
+ */
+static void stress_repeat_yaml(
+	FILE *yaml,
+	const char *label,
+	const char *sep,
+	const stress_repeat_stats_t *stats)
+{
+	char ci95_lower[16], ci95_upper[16];
+
+	(void)snprintf(ci95_lower, sizeof(ci95_lower), "ci95%slower", sep);
+	(void)snprintf(ci95_upper, sizeof(ci95_upper), "ci95%supper", sep);
+
+	stress_repeat_yaml_value(yaml, label, sep, "mean", stats->mean);
+	stress_repeat_yaml_value(yaml, label, sep, "stddev", stats->stddev);
+	stress_repeat_yaml_value(yaml, label, sep, "min", stats->min);
+	stress_repeat_yaml_value(yaml, label, sep, "max", stats->max);
+	stress_repeat_yaml_value(yaml, label, sep, ci95_lower, stats->mean - stats->ci95);
+	stress_repeat_yaml_value(yaml, label, sep, ci95_upper, stats->mean + stats->ci95);
+}
+
+/*
+ *  stress_repeat_dump()
+ *	dump the statistics of the bogo-op rates and perf
+ *	counter rates across all the repeated runs
+ */
+void stress_repeat_dump(FILE *yaml)
+{
+	size_t i;
+
+	if (!repeat_info || !repeat_recorded)
+		return;
+
+	pr_lock();
+	pr_metrics("bogo ops/s (real time) over %" PRIu32 " runs:\n", repeat_recorded);
+	pr_metrics("%-13s %12s %12s %12s %12s %12s %12s\n",
+		"stressor", "mean", "std.dev.", "min", "max",
+		"95% CI low", "95% CI high");
+	pr_yaml(yaml, "repeats:\n");
+
+	for (i = 0; i < repeat_info_num; i++) {
+		const stress_stressor_t *ss = repeat_info[i].ss;
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		stress_repeat_stats_t stats;
+
+		if (!stress_repeat_stats(repeat_info[i].bogo_rate, repeat_recorded, 1, &stats))
+			continue;
+
+		if (g_opt_flags & OPT_FLAGS_SN) {
+			pr_metrics("%-13s %12.5e %12.5e %12.5e %12.5e %12.5e %12.5e\n",
+				munged, stats.mean, stats.stddev, stats.min, stats.max,
+				stats.mean - stats.ci95, stats.mean + stats.ci95);
+		} else {
+			pr_metrics("%-13s %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n",
+				munged, stats.mean, stats.stddev, stats.min, stats.max,
+				stats.mean - stats.ci95, stats.mean + stats.ci95);
+		}
+
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      runs: %" PRIu32 "\n", repeat_recorded);
+		stress_repeat_yaml(yaml, "bogo-ops-per-second-real-time", "-", &stats);
+#if defined(STRESS_REPEAT_PERF)
+		if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
+			int p;
+
+			for (p = 0; p < STRESS_PERF_MAX; p++) {
+				char yaml_label[128];
+				char label[160];
+
+				if (!stress_perf_stat_label(p, yaml_label, sizeof(yaml_label)))
+					break;
+				if (!stress_repeat_stats(repeat_info[i].perf_rate + p,
+							 repeat_recorded, STRESS_PERF_MAX, &stats))
+					continue;
+				(void)snprintf(label, sizeof(label), "%s_per_second", yaml_label);
+				stress_repeat_yaml(yaml, label, "_", &stats);
+			}
+		}
+#endif
+		pr_yaml(yaml, "\n");
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_repeat_free()
+ *	free per run result storage
+ */
+void stress_repeat_free(void)
+{
+	size_t i;
+
+	if (!repeat_info)
+		return;
+
+	for (i = 0; i < repeat_info_num; i++) {
+		free(repeat_info[i].bogo_rate);
+#if defined(STRESS_REPEAT_PERF)
+		free(repeat_info[i].perf_rate);
+#endif
+	}
+	free(repeat_info);
+	repeat_info = NULL;
+	repeat_info_num = 0;
+}
@@ -0,0 +1,517 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-reproduce.h"
+
+#define REPRODUCE_ARGS_MAX		(4096)
+
+/* recorded per instance seed and placement */
+typedef struct {
+	char stressor[64];		/* munged stressor name */
+	int32_t instance;		/* instance number */
+	uint32_t seed_w;		/* mwc w seed at the stressor start */
+	uint32_t seed_z;		/* mwc z seed at the stressor start */
+	int32_t cpu;			/* CPU the instance started on, -1 = unknown */
+} stress_reproduce_instance_t;
+
+/* a system setting in the environment fingerprint */
+typedef struct {
+	const char *name;		/* YAML key */
+	const char *path;		/* /proc or /sys file, NULL = special */
+	const bool settable;		/* true if --reproduce writes it */
+	const bool per_cpu;		/* path is formatted with a CPU number */
+} stress_reproduce_env_t;
+
+/* a setting changed by --reproduce and its value to restore */
+typedef struct stress_reproduce_restore {
+	struct stress_reproduce_restore *next;
+	char path[PATH_MAX];
+	char value[128];
+} stress_reproduce_restore_t;
+
+static const stress_reproduce_env_t reproduce_env[] = {
+	{ "kernel-release",	"/proc/sys/kernel/osrelease",				false, false },
+	{ "kernel-cmdline",	"/proc/cmdline",					false, false },
+	{ "cpu-model",		NULL,							false, false },
+	{ "microcode",		NULL,							false, false },
+	{ "scaling-governor",	"/sys/devices/system/cpu/cpu%" PRId32 "/cpufreq/scaling_governor", true, true },
+	{ "cpufreq-boost",	"/sys/devices/system/cpu/cpufreq/boost",		true, false },
+	{ "intel-pstate-no-turbo", "/sys/devices/system/cpu/intel_pstate/no_turbo",	true, false },
+	{ "thp-enabled",	"/sys/kernel/mm/transparent_hugepage/enabled",		true, false },
+	{ "thp-defrag",		"/sys/kernel/mm/transparent_hugepage/defrag",		true, false },
+	{ "thp-shmem-enabled",	"/sys/kernel/mm/transparent_hugepage/shmem_enabled",	true, false },
+	{ "numa-balancing",	"/proc/sys/kernel/numa_balancing",			true, false },
+};
+
+static stress_reproduce_instance_t *reproduce_instances;
+static size_t reproduce_n_instances;
+static char *reproduce_args[REPRODUCE_ARGS_MAX];
+static int reproduce_argc;
+static stress_reproduce_restore_t *reproduce_restore;
+
+/*
+ *  stress_reproduce_cpuinfo()
+ *	get the first value of a /proc/cpuinfo field
+ */
+static int stress_reproduce_cpuinfo(const char *field, char *value, const size_t len)
+{
+	FILE *fp;
+	char buf[512];
+	const size_t field_len = strlen(field);
+	int ret = -1;
+
+	fp = fopen("/proc/cpuinfo", "r");
+	if (!fp)
+		return -1;
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *ptr;
+
+		if (strncmp(buf, field, field_len) || !isspace((unsigned char)buf[field_len]))
+			continue;
+		ptr = strchr(buf, ':');
+		if (!ptr)
+			continue;
+		for (ptr++; isspace((unsigned char)*ptr); ptr++)
+			;
+		(void)shim_strlcpy(value, ptr, len);
+		ret = 0;
+		break;
+	}
+	(void)fclose(fp);
+	return ret;
+}
+
+/*
+ *  stress_reproduce_env_get()
+ *	read a fingerprint setting, the selected [value] of sysfs
+ *	choice files, returns -1 if not available
+ */
+static int stress_reproduce_env_get(const stress_reproduce_env_t *env, char *value, const size_t len)
+{
+	char path[PATH_MAX], *ptr, *end;
+	ssize_t ret;
+
+	if (!env->path) {
+		if (!strcmp(env->name, "cpu-model"))
+			ret = stress_reproduce_cpuinfo("model name", value, len);
+		else
+			ret = stress_reproduce_cpuinfo("microcode", value, len);
+		if (ret < 0)
+			return -1;
+	} else {
+		if (env->per_cpu)
+			(void)snprintf(path, sizeof(path), env->path, (int32_t)0);
+		else
+			(void)shim_strlcpy(path, env->path, sizeof(path));
+		(void)memset(value, 0, len);
+		ret = system_read(path, value, len - 1);
+		if (ret <= 0)
+			return -1;
+	}
+	value[strcspn(value, "\n")] = '\0';
+
+	/* "always [madvise] never" style choices */
+	ptr = strchr(value, '[');
+	end = ptr ? strchr(ptr, ']') : NULL;
+	if (ptr && end) {
+		*end = '\0';
+		(void)memmove(value, ptr + 1, (size_t)(end - ptr));
+	}
+	return 0;
+}
+
+/*
+ *  stress_reproduce_env_set()
+ *	write a fingerprint setting, the original value is kept
+ *	so it can be restored at the end of the run
+ */
+static int stress_reproduce_env_set(const stress_reproduce_env_t *env, const char *value)
+{
+	const int32_t cpus = env->per_cpu ? stress_get_processors_configured() : 1;
+	int32_t cpu;
+
+	for (cpu = 0; cpu < cpus; cpu++) {
+		stress_reproduce_restore_t *restore;
+		char path[PATH_MAX], orig[128];
+		const stress_reproduce_env_t cpu_env = { env->name, path, false, false };
+
+		if (env->per_cpu)
+			(void)snprintf(path, sizeof(path), env->path, cpu);
+		else
+			(void)shim_strlcpy(path, env->path, sizeof(path));
+		if (stress_reproduce_env_get(&cpu_env, orig, sizeof(orig)) < 0)
+			continue;
+		if (!strcmp(orig, value))
+			continue;
+		if (system_write(path, value, strlen(value)) < 0)
+			return -1;
+		restore = calloc(1, sizeof(*restore));
+		if (restore) {
+			(void)shim_strlcpy(restore->path, path, sizeof(restore->path));
+			(void)shim_strlcpy(restore->value, orig, sizeof(restore->value));
+			restore->next = reproduce_restore;
+			reproduce_restore = restore;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_reproduce_quote()
+ *	output a YAML single quoted string
+ */
+static void stress_reproduce_quote(FILE *yaml, const char *prefix, const char *str)
+{
+	char buf[4096], *ptr = buf;
+	const char *end = buf + sizeof(buf) - 2;
+
+	while (*str && (ptr < end)) {
+		if (*str == '\'')
+			*ptr++ = '\'';
+		*ptr++ = *str++;
+	}
+	*ptr = '\0';
+	pr_yaml(yaml, "%s'%s'\n", prefix, buf);
+}
+
+/*
+ *  stress_reproduce_unquote()
+ *	strip the YAML single quotes of str in place
+ */
+static char *stress_reproduce_unquote(char *str)
+{
+	char *src, *dst;
+	size_t len;
+
+	str[strcspn(str, "\n")] = '\0';
+	len = strlen(str);
+	if ((len < 2) || (str[0] != '\'') || (str[len - 1] != '\''))
+		return str;
+	str[len - 1] = '\0';
+	for (src = str + 1, dst = str; *src; ) {
+		if ((src[0] == '\'') && (src[1] == '\''))
+			src++;
+		*dst++ = *src++;
+	}
+	*dst = '\0';
+	return str;
+}
+
+/*
+ *  stress_reproduce_skip_arg()
+ *	options of the recorded run that are not reproduced, the
+ *	output files of the original run must not be overwritten,
+ *	returns the number of arguments to skip
+ */
+static int stress_reproduce_skip_arg(const char *arg)
+{
+	static const char * const skip[] = {
+		"--reproduce", "--yaml", "-Y", "--log-file", "--results-bin",
+	};
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(skip); i++) {
+		const size_t len = strlen(skip[i]);
+
+		if (!strncmp(arg, skip[i], len)) {
+			if (arg[len] == '\0')
+				return 2;
+			if (arg[len] == '=')
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_reproduce_load()
+ *	load the reproduce section of a YAML file from an earlier run,
+ *	parse its command line, recreate the system settings and
+ *	keep the per instance seeds and CPUs
+ */
+int stress_reproduce_load(const int argc, char **argv, const char *filename)
+{
+	enum { NONE, ARGS, ENV, INSTANCES } section = NONE;
+	stress_reproduce_instance_t *inst = NULL;
+	char buf[4096], *new_argv[REPRODUCE_ARGS_MAX + 1];
+	bool reproduce = false;
+	int i, skip = 0, mismatches = 0, new_argc = 1;
+	FILE *fp;
+
+	(void)argc;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		(void)fprintf(stderr, "reproduce: cannot open %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *ptr;
+
+		if (!isspace((unsigned char)*buf)) {
+			reproduce = !strncmp(buf, "reproduce:", 10);
+			section = NONE;
+			continue;
+		}
+		if (!reproduce)
+			continue;
+		if (!strncmp(buf, "    command-line:", 17)) {
+			section = ARGS;
+			continue;
+		} else if (!strncmp(buf, "    environment:", 16)) {
+			section = ENV;
+			continue;
+		} else if (!strncmp(buf, "    instances:", 14)) {
+			section = INSTANCES;
+			continue;
+		}
+
+		switch (section) {
+		case ARGS:
+			if (strncmp(buf, "      - ", 8) || (reproduce_argc >= REPRODUCE_ARGS_MAX))
+				break;
+			reproduce_args[reproduce_argc] = strdup(stress_reproduce_unquote(buf + 8));
+			if (reproduce_args[reproduce_argc])
+				reproduce_argc++;
+			break;
+		case ENV:
+			ptr = strchr(buf, ':');
+			if (!ptr)
+				break;
+			*ptr = '\0';
+			ptr = stress_reproduce_unquote(ptr + 2);
+			for (i = 0; i < (int)SIZEOF_ARRAY(reproduce_env); i++) {
+				const stress_reproduce_env_t *env = &reproduce_env[i];
+				char value[4096];
+
+				if (strcmp(buf + 6, env->name))
+					continue;
+				if ((stress_reproduce_env_get(env, value, sizeof(value)) == 0) &&
+				    !strcmp(value, ptr))
+					break;
+				if (env->settable && (stress_reproduce_env_set(env, ptr) == 0)) {
+					pr_inf("reproduce: set %s to '%s'\n", env->name, ptr);
+					break;
+				}
+				pr_warn("reproduce: %s is '%s', the recorded run had '%s'\n",
+					env->name, value, ptr);
+				mismatches++;
+				break;
+			}
+			break;
+		case INSTANCES:
+			if (!strncmp(buf, "      - stressor: ", 18)) {
+				stress_reproduce_instance_t *tmp;
+
+				tmp = realloc(reproduce_instances, (reproduce_n_instances + 1) * sizeof(*tmp));
+				if (!tmp)
+					break;
+				reproduce_instances = tmp;
+				inst = &reproduce_instances[reproduce_n_instances++];
+				(void)memset(inst, 0, sizeof(*inst));
+				inst->cpu = -1;
+				(void)shim_strlcpy(inst->stressor,
+					stress_reproduce_unquote(buf + 18), sizeof(inst->stressor));
+			} else if (inst) {
+				(void)(sscanf(buf, "        instance: %" SCNd32, &inst->instance) ||
+				       sscanf(buf, "        seed-w: %" SCNu32, &inst->seed_w) ||
+				       sscanf(buf, "        seed-z: %" SCNu32, &inst->seed_z) ||
+				       sscanf(buf, "        cpu: %" SCNd32, &inst->cpu));
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	(void)fclose(fp);
+
+	if (reproduce_argc == 0) {
+		(void)fprintf(stderr, "reproduce: no recorded command line in %s\n", filename);
+		return -1;
+	}
+
+	/* recorded argv[0] is replaced by this stress-ng */
+	new_argv[0] = argv[0];
+	for (i = 1; i < reproduce_argc; i++) {
+		if (skip > 0) {
+			skip--;
+			continue;
+		}
+		skip = stress_reproduce_skip_arg(reproduce_args[i]);
+		if (skip > 0) {
+			skip--;
+			continue;
+		}
+		new_argv[new_argc++] = reproduce_args[i];
+	}
+	new_argv[new_argc] = NULL;
+	if (stress_parse_opts(new_argc, new_argv, true) != EXIT_SUCCESS) {
+		(void)fprintf(stderr, "reproduce: cannot parse the recorded command line\n");
+		return -1;
+	}
+	pr_inf("reproduce: %s, %d recorded arguments, %zu instance seeds, %d environment mismatch%s\n",
+		filename, reproduce_argc - 1, reproduce_n_instances, mismatches,
+		(mismatches == 1) ? "" : "es");
+	return 0;
+}
+
+/*
+ *  stress_reproduce_find()
+ *	find the recorded seed and placement of a stressor instance
+ */
+static const stress_reproduce_instance_t *stress_reproduce_find(const stress_stressor_t *ss, const int32_t instance)
+{
+	const char *munged;
+	size_t i;
+
+	if (!reproduce_instances)
+		return NULL;
+	munged = stress_munge_underscore(ss->stressor->name);
+	for (i = 0; i < reproduce_n_instances; i++) {
+		const stress_reproduce_instance_t *inst = &reproduce_instances[i];
+
+		if ((inst->instance == instance) && !strcmp(inst->stressor, munged))
+			return inst;
+	}
+	return NULL;
+}
+
+/*
+ *  stress_reproduce_apply()
+ *	pin a reproduced stressor instance to the CPU it
+ *	started on in the recorded run
+ */
+void stress_reproduce_apply(const char *name, const stress_stressor_t *ss, const int32_t instance)
+{
+#if defined(HAVE_SCHED_SETAFFINITY)
+	const stress_reproduce_instance_t *inst = stress_reproduce_find(ss, instance);
+	cpu_set_t set;
+
+	if (!inst || (inst->cpu < 0) || (inst->cpu >= CPU_SETSIZE))
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(inst->cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("%s: cannot set reproduced CPU %" PRId32 " affinity, errno=%d (%s)\n",
+			name, inst->cpu, errno, strerror(errno));
+	}
+#else
+	(void)name;
+	(void)ss;
+	(void)instance;
+#endif
+}
+
+/*
+ *  stress_reproduce_seed()
+ *	restore the recorded mwc seed of a reproduced stressor
+ *	instance and record the seed the stressor starts with
+ */
+void stress_reproduce_seed(const stress_stressor_t *ss, const int32_t instance, stress_stats_t *stats)
+{
+	const stress_reproduce_instance_t *inst = stress_reproduce_find(ss, instance);
+
+	if (inst)
+		stress_mwc_set_seed(inst->seed_w, inst->seed_z);
+	stress_mwc_get_seed(&stats->seed_w, &stats->seed_z);
+}
+
+/*
+ *  stress_reproduce_dump()
+ *	dump the command line, environment fingerprint and per
+ *	instance seeds and placement so the run can be reproduced
+ */
+void stress_reproduce_dump(FILE *yaml, const int argc, char **argv, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	size_t i;
+	int j;
+
+	if (!yaml)
+		return;
+
+	pr_yaml(yaml, "reproduce:\n");
+	/* a reproduced run records the original command line */
+	pr_yaml(yaml, "    command-line:\n");
+	if (reproduce_argc > 0) {
+		for (j = 0; j < reproduce_argc; j++)
+			stress_reproduce_quote(yaml, "      - ", reproduce_args[j]);
+	} else {
+		for (j = 0; j < argc; j++)
+			stress_reproduce_quote(yaml, "      - ", argv[j]);
+	}
+
+	pr_yaml(yaml, "    environment:\n");
+	for (i = 0; i < SIZEOF_ARRAY(reproduce_env); i++) {
+		char value[4096], prefix[64];
+
+		if (stress_reproduce_env_get(&reproduce_env[i], value, sizeof(value)) < 0)
+			continue;
+		(void)snprintf(prefix, sizeof(prefix), "      %s: ", reproduce_env[i].name);
+		stress_reproduce_quote(yaml, prefix, value);
+	}
+
+	pr_yaml(yaml, "    instances:\n");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		int32_t k;
+
+		if (!ss->stats)
+			continue;
+		for (k = 0; k < ss->num_instances; k++) {
+			const stress_stats_t *const stats = ss->stats[k];
+
+			pr_yaml(yaml, "      - stressor: %s\n", munged);
+			pr_yaml(yaml, "        instance: %" PRId32 "\n", k);
+			pr_yaml(yaml, "        seed-w: %" PRIu32 "\n", stats->seed_w);
+			pr_yaml(yaml, "        seed-z: %" PRIu32 "\n", stats->seed_z);
+			pr_yaml(yaml, "        cpu: %" PRId32 "\n", stats->cpu_begin);
+		}
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_reproduce_free()
+ *	restore the system settings changed by --reproduce
+ */
+void stress_reproduce_free(void)
+{
+	int i;
+
+	while (reproduce_restore) {
+		stress_reproduce_restore_t *next = reproduce_restore->next;
+
+		if (system_write(reproduce_restore->path, reproduce_restore->value,
+				 strlen(reproduce_restore->value)) < 0) {
+			pr_warn("reproduce: cannot restore %s to '%s'\n",
+				reproduce_restore->path, reproduce_restore->value);
+		}
+		free(reproduce_restore);
+		reproduce_restore = next;
+	}
+	for (i = 0; i < reproduce_argc; i++)
+		free(reproduce_args[i]);
+	reproduce_argc = 0;
+	free(reproduce_instances);
+	reproduce_instances = NULL;
+	reproduce_n_instances = 0;
+}
@@ -0,0 +1,885 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-phase.h"
+#include "core-resctrl.h"
+#include "core-search.h"
+
+#define RESCTRL_SWEEP_MAX	(64)	/* maximum --resctrl-sweep configurations */
+
+/*
+ *  stress_set_resctrl()
+ *	enable per stressor resctrl memory bandwidth and
+ *	LLC occupancy monitoring
+ */
+int stress_set_resctrl(const char *opt)
+{
+	bool resctrl = true;
+
+	(void)opt;
+	return stress_set_setting_global("resctrl", TYPE_ID_BOOL, &resctrl);
+}
+
+/*
+ *  stress_set_resctrl_cat()
+ *	set the resctrl schemata of the stressors, optionally prefixed
+ *	by a stressor name and a / to only apply it to that stressor
+ */
+int stress_set_resctrl_cat(const char *opt)
+{
+	const char *slash = strchr(opt, '/');
+	const char *schemata = slash ? slash + 1 : opt;
+
+	if (!*schemata || !strchr(schemata, ':') || !strchr(schemata, '=')) {
+		(void)fprintf(stderr, "resctrl-cat must be [S/]schemata, e.g. L3:0=f or stream/L3:0=f;MB:0=50\n");
+		return -1;
+	}
+	if (slash && (slash == opt)) {
+		(void)fprintf(stderr, "resctrl-cat: missing stressor name before '/'\n");
+		return -1;
+	}
+	return stress_set_setting_global("resctrl-cat", TYPE_ID_STR, (void *)opt);
+}
+
+/*
+ *  stress_set_resctrl_victim()
+ *	set the latency sensitive stressor of a --resctrl-sweep, the
+ *	other stressors are the aggressors
+ */
+int stress_set_resctrl_victim(const char *opt)
+{
+	g_opt_flags |= OPT_FLAGS_LATENCY_HIST;
+	return stress_set_setting_global("resctrl-victim", TYPE_ID_STR, (void *)opt);
+}
+
+/*
+ *  stress_set_resctrl_sweep()
+ *	set the comma separated list of aggressor[@victim] schemata
+ *	configurations to run the stressors with, default is the
+ *	unrestricted allocation
+ */
+int stress_set_resctrl_sweep(const char *opt)
+{
+	if (!*opt || (opt[strlen(opt) - 1] == ',')) {
+		(void)fprintf(stderr, "resctrl-sweep must be a comma separated list of "
+			"aggressor[@victim] schemata, e.g. default,L3:0=f0@L3:0=f\n");
+		return -1;
+	}
+	return stress_set_setting_global("resctrl-sweep", TYPE_ID_STR, (void *)opt);
+}
+
+typedef struct {
+	char aggressor[256];		/* aggressor schemata, empty = default */
+	char victim[256];		/* victim schemata, empty = default */
+	bool run;			/* configuration has been run */
+	double bogo_rate;		/* victim real time bogo ops per second */
+	double aggressor_rate;		/* aggressors real time bogo ops per second */
+	uint64_t p50;			/* victim latency percentiles, nanoseconds */
+	uint64_t p99;
+	bool mbm_valid;
+	double mbm_rate;		/* victim memory bandwidth, bytes per second */
+	bool llc_valid;
+	uint64_t llc_occupancy;		/* victim LLC occupancy at end of the run */
+} stress_resctrl_sweep_t;
+
+static stress_resctrl_sweep_t *resctrl_sweeps;
+static size_t resctrl_sweeps_num;
+static size_t resctrl_sweep_current;
+static const stress_stressor_t *resctrl_victim_ss;
+
+/*
+ *  stress_resctrl_setup()
+ *	check the --resctrl-sweep options and parse the configurations
+ */
+int stress_resctrl_setup(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	char *victim = NULL, *sweep = NULL, *cat = NULL, *str, *token, *saveptr = NULL;
+	size_t aggressors = 0;
+
+	(void)stress_get_setting("resctrl-victim", &victim);
+	(void)stress_get_setting("resctrl-sweep", &sweep);
+	(void)stress_get_setting("resctrl-cat", &cat);
+	if (!victim && !sweep)
+		return 0;
+	if (!victim || !sweep) {
+		pr_err("resctrl: --resctrl-sweep and --resctrl-victim must be used together\n");
+		return -1;
+	}
+	if (cat) {
+		pr_err("resctrl: --resctrl-sweep cannot be used with --resctrl-cat\n");
+		return -1;
+	}
+	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+		pr_err("resctrl: --resctrl-sweep cannot be used with --sequential\n");
+		return -1;
+	}
+	if (stress_phase_count()) {
+		pr_err("resctrl: --resctrl-sweep cannot be used with job file phases\n");
+		return -1;
+	}
+	if (stress_search_enabled()) {
+		pr_err("resctrl: --resctrl-sweep cannot be used with --search\n");
+		return -1;
+	}
+
+	resctrl_victim_ss = NULL;
+	for (ss = stressors_list; ss; ss = ss->next) {
+		if (ss->num_instances <= 0)
+			continue;
+		if (!strcmp(stress_munge_underscore(ss->stressor->name), victim))
+			resctrl_victim_ss = ss;
+		else
+			aggressors++;
+	}
+	if (!resctrl_victim_ss) {
+		pr_err("resctrl: --resctrl-victim stressor '%s' is not being run\n", victim);
+		return -1;
+	}
+	if (!aggressors) {
+		pr_err("resctrl: --resctrl-sweep needs one or more aggressor stressors "
+			"as well as the victim stressor\n");
+		return -1;
+	}
+
+	resctrl_sweeps = calloc(RESCTRL_SWEEP_MAX, sizeof(*resctrl_sweeps));
+	str = strdup(sweep);
+	if (!resctrl_sweeps || !str) {
+		pr_err("resctrl: cannot allocate --resctrl-sweep configurations\n");
+		free(resctrl_sweeps);
+		resctrl_sweeps = NULL;
+		free(str);
+		return -1;
+	}
+	resctrl_sweeps_num = 0;
+	for (token = strtok_r(str, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+		stress_resctrl_sweep_t *config;
+		char *at = strchr(token, '@');
+
+		if (resctrl_sweeps_num >= RESCTRL_SWEEP_MAX) {
+			pr_inf("resctrl: only the first %d --resctrl-sweep configurations will be run\n",
+				RESCTRL_SWEEP_MAX);
+			break;
+		}
+		config = &resctrl_sweeps[resctrl_sweeps_num++];
+		if (at) {
+			*at = '\0';
+			if (strcmp(at + 1, "default"))
+				(void)shim_strlcpy(config->victim, at + 1, sizeof(config->victim));
+		}
+		if (strcmp(token, "default"))
+			(void)shim_strlcpy(config->aggressor, token, sizeof(config->aggressor));
+	}
+	free(str);
+	resctrl_sweep_current = 0;
+	return 0;
+}
+
+#if defined(__linux__)
+
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor of this group */
+	char path[PATH_MAX + 96];	/* resctrl group directory */
+	bool cat;			/* control group with own schemata */
+	bool collected;			/* counters have been read */
+	bool mbm_total_valid;
+	bool mbm_local_valid;
+	bool llc_valid;
+	uint64_t mbm_total_start;	/* mbm_total_bytes at start of run */
+	uint64_t mbm_local_start;	/* mbm_local_bytes at start of run */
+	uint64_t mbm_total;		/* bytes read from and written to memory */
+	uint64_t mbm_local;		/* of which from the local NUMA node */
+	uint64_t llc_occupancy;		/* LLC bytes at the end of the run */
+} stress_resctrl_t;
+
+static stress_resctrl_t *resctrls;
+static size_t resctrls_num;
+static char resctrl_mount[PATH_MAX];
+static char resctrl_cat_stressor[64];	/* stressor the schemata applies to, empty for all */
+static const char *resctrl_cat_schemata;	/* schemata of the control groups */
+static double resctrl_t_start;
+static double resctrl_duration;
+static char resctrl_default_schemata[4096];	/* schemata of the default group */
+
+/*
+ *  stress_resctrl_find()
+ *	find where the resctrl filesystem is mounted
+ */
+static int stress_resctrl_find(char *path, const size_t path_len)
+{
+	FILE *fp;
+	char buffer[PATH_MAX];
+	int ret = -1;
+
+	fp = fopen("/proc/self/mounts", "r");
+	if (!fp)
+		return -1;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char dir[PATH_MAX], type[32];
+
+		if (sscanf(buffer, "%*s %4095s %31s", dir, type) != 2)
+			continue;
+		if (!strcmp(type, "resctrl")) {
+			shim_strlcpy(path, dir, path_len);
+			ret = 0;
+			break;
+		}
+	}
+	(void)fclose(fp);
+	return ret;
+}
+
+/*
+ *  stress_resctrl_write()
+ *	write a string to a resctrl group file
+ */
+static int stress_resctrl_write(const char *dir, const char *file, const char *str)
+{
+	char path[PATH_MAX + 192];
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	return (system_write(path, str, strlen(str)) < 0) ? -1 : 0;
+}
+
+/*
+ *  stress_resctrl_schemata()
+ *	write a schemata to a control group, resources may be separated
+ *	by a ; on the command line so these are split into the one
+ *	resource per line format, an empty schemata is the default
+ *	allocation. Returns -1 and the kernel's reason on failure.
+ */
+static int stress_resctrl_schemata(
+	const char *dir,
+	const char *schemata,
+	char *status,
+	const size_t status_len)
+{
+	char buf[sizeof(resctrl_default_schemata)], path[PATH_MAX + 64];
+	const char *ptr;
+	char *dst = buf;
+
+	if (!*schemata) {
+		(void)shim_strlcpy(buf, resctrl_default_schemata, sizeof(buf));
+	} else {
+		/* a ; followed by a resource name, e.g. MB:, starts a new line */
+		for (ptr = schemata; *ptr && (dst < buf + sizeof(buf) - 1); ptr++) {
+			if (*ptr == ';') {
+				const char *colon = strchr(ptr + 1, ':');
+				const char *eq = strchr(ptr + 1, '=');
+
+				*dst++ = (colon && eq && (colon < eq)) ? '\n' : ';';
+			} else {
+				*dst++ = *ptr;
+			}
+		}
+		*dst = '\0';
+	}
+	if (stress_resctrl_write(dir, "schemata", buf) == 0)
+		return 0;
+
+	/* the kernel explains rejected schemata in last_cmd_status */
+	(void)snprintf(path, sizeof(path), "%s/info/last_cmd_status", resctrl_mount);
+	if (system_read(path, status, status_len) <= 0)
+		(void)shim_strlcpy(status, strerror(errno), status_len);
+	status[strcspn(status, "\n")] = '\0';
+	return -1;
+}
+
+/*
+ *  stress_resctrl_has_feature()
+ *	return true if a L3 monitoring event is supported
+ */
+static bool stress_resctrl_has_feature(const char *feature)
+{
+	char path[PATH_MAX + 64], buf[512], *token, *ptr;
+
+	(void)snprintf(path, sizeof(path), "%s/info/L3_MON/mon_features", resctrl_mount);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+	for (ptr = buf; (token = strtok(ptr, " \n")) != NULL; ptr = NULL) {
+		if (!strcmp(token, feature))
+			return true;
+	}
+	return false;
+}
+
+/*
+ *  stress_resctrl_read()
+ *	sum a monitoring event of a group over all the L3
+ *	domains, returns -1 if the event cannot be read
+ */
+static int stress_resctrl_read(const char *dir, const char *event, uint64_t *value)
+{
+	DIR *dp;
+	const struct dirent *d;
+	char path[PATH_MAX + 192];
+	int domains = 0;
+
+	*value = 0;
+	(void)snprintf(path, sizeof(path), "%s/mon_data", dir);
+	dp = opendir(path);
+	if (!dp)
+		return -1;
+	while ((d = readdir(dp)) != NULL) {
+		char buf[64];
+		uint64_t val;
+
+		if (strncmp(d->d_name, "mon_L3_", 7))
+			continue;
+		(void)snprintf(path, sizeof(path), "%s/mon_data/%s/%s", dir, d->d_name, event);
+		/* counters read as "Unavailable" when the RMID is not being counted */
+		if ((system_read(path, buf, sizeof(buf)) <= 0) ||
+		    (sscanf(buf, "%" SCNu64, &val) != 1))
+			continue;
+		*value += val;
+		domains++;
+	}
+	(void)closedir(dp);
+	return domains ? 0 : -1;
+}
+
+/*
+ *  stress_resctrl_init()
+ *	create a resctrl monitoring group for each stressor, or a
+ *	control group with the --resctrl-cat schemata applied
+ */
+void stress_resctrl_init(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool resctrl = false;
+	char *cat = NULL, path[PATH_MAX + 64];
+	size_t n;
+
+	(void)stress_get_setting("resctrl", &resctrl);
+	(void)stress_get_setting("resctrl-cat", &cat);
+	if (!resctrl && !cat && !resctrl_sweeps_num)
+		return;
+
+	if (stress_resctrl_find(resctrl_mount, sizeof(resctrl_mount)) < 0) {
+		pr_inf("resctrl: resctrl filesystem not mounted, disabling --resctrl%s "
+			"(mount it with: mount -t resctrl resctrl /sys/fs/resctrl)\n",
+			resctrl_sweeps_num ? " and --resctrl-sweep" : "");
+		goto disable;
+	}
+	(void)snprintf(path, sizeof(path), "%s/schemata", resctrl_mount);
+	if (system_read(path, resctrl_default_schemata, sizeof(resctrl_default_schemata)) <= 0)
+		*resctrl_default_schemata = '\0';
+	if (!stress_resctrl_has_feature("mbm_total_bytes") &&
+	    !stress_resctrl_has_feature("llc_occupancy")) {
+		pr_inf("resctrl: no L3 memory bandwidth or occupancy monitoring "
+			"available, bandwidth and occupancy will not be reported\n");
+	}
+
+	*resctrl_cat_stressor = '\0';
+	if (cat) {
+		const char *slash = strchr(cat, '/');
+
+		resctrl_cat_schemata = cat;
+		if (slash) {
+			const size_t len = (size_t)(slash - cat) + 1;
+
+			(void)shim_strlcpy(resctrl_cat_stressor, cat,
+				STRESS_MINIMUM(len, sizeof(resctrl_cat_stressor)));
+			resctrl_cat_schemata = slash + 1;
+		}
+	}
+
+	for (n = 0, ss = stressors_list; ss; ss = ss->next)
+		n++;
+	resctrls = calloc(n, sizeof(*resctrls));
+	if (!resctrls) {
+		pr_inf("resctrl: cannot allocate resctrl group table, disabling --resctrl\n");
+		goto disable;
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_resctrl_t *rg = &resctrls[resctrls_num];
+		const char *munged;
+
+		if (ss->num_instances <= 0)
+			continue;
+		munged = stress_munge_underscore(ss->stressor->name);
+		rg->ss = ss;
+		rg->cat = (resctrl_sweeps_num > 0) || (resctrl_cat_schemata &&
+			(!*resctrl_cat_stressor || !strcmp(resctrl_cat_stressor, munged)));
+		/*
+		 *  Control groups need a free CLOSID and have their own
+		 *  monitoring, monitoring groups only need a free RMID
+		 *  and use the default allocation
+		 */
+		(void)snprintf(rg->path, sizeof(rg->path), "%s/%sstress-ng-%d-%s",
+			resctrl_mount, rg->cat ? "" : "mon_groups/", (int)getpid(), munged);
+		if (mkdir(rg->path, S_IRWXU) < 0) {
+			pr_inf("resctrl: cannot create %s, errno=%d (%s)%s\n",
+				rg->path, errno, strerror(errno),
+				errno == ENOSPC ? ", out of CLOSIDs or RMIDs" : "");
+			continue;
+		}
+		resctrls_num++;
+		if (rg->cat && resctrl_cat_schemata) {
+			char status[256];
+
+			if (stress_resctrl_schemata(rg->path, resctrl_cat_schemata,
+						    status, sizeof(status)) < 0)
+				pr_inf("resctrl: cannot set schemata '%s' for %s: %s\n",
+					resctrl_cat_schemata, munged, status);
+		}
+	}
+	if (*resctrl_cat_stressor) {
+		size_t i;
+
+		for (i = 0; i < resctrls_num; i++) {
+			if (resctrls[i].cat)
+				break;
+		}
+		if (i == resctrls_num)
+			pr_inf("resctrl: stressor '%s' is not being run, --resctrl-cat "
+				"schemata not applied\n", resctrl_cat_stressor);
+	}
+	pr_dbg("resctrl: created %zu resctrl group%s in %s\n", resctrls_num,
+		resctrls_num == 1 ? "" : "s", resctrl_mount);
+	return;
+
+disable:
+	*resctrl_mount = '\0';
+	resctrl_sweeps_num = 0;
+}
+
+/*
+ *  stress_resctrl_start()
+ *	snapshot the memory bandwidth counters at the start of the run,
+ *	the counters of a group are not reset when it is created
+ */
+void stress_resctrl_start(void)
+{
+	size_t i;
+
+	for (i = 0; i < resctrls_num; i++) {
+		stress_resctrl_t *rg = &resctrls[i];
+
+		rg->mbm_total_valid = (stress_resctrl_read(rg->path,
+			"mbm_total_bytes", &rg->mbm_total_start) == 0);
+		rg->mbm_local_valid = (stress_resctrl_read(rg->path,
+			"mbm_local_bytes", &rg->mbm_local_start) == 0);
+	}
+	resctrl_t_start = stress_time_now();
+}
+
+/*
+ *  stress_resctrl_join()
+ *	move the calling stressor instance into the resctrl group of
+ *	its stressor, processes and threads it creates inherit it
+ */
+void stress_resctrl_join(const stress_stressor_t *ss)
+{
+	size_t i;
+
+	for (i = 0; i < resctrls_num; i++) {
+		const stress_resctrl_t *rg = &resctrls[i];
+		char buf[32];
+
+		if (rg->ss != ss)
+			continue;
+		(void)snprintf(buf, sizeof(buf), "%d", (int)getpid());
+		if (stress_resctrl_write(rg->path, "tasks", buf) < 0) {
+			pr_dbg("resctrl: cannot move pid %s into %s, errno=%d (%s)\n",
+				buf, rg->path, errno, strerror(errno));
+		}
+		return;
+	}
+}
+
+/*
+ *  stress_resctrl_collect()
+ *	read the memory bandwidth and LLC occupancy of each group,
+ *	the occupancy is of the cache lines still tagged with the
+ *	group's RMID at the end of the run
+ */
+void stress_resctrl_collect(void)
+{
+	size_t i;
+
+	resctrl_duration = stress_time_now() - resctrl_t_start;
+	for (i = 0; i < resctrls_num; i++) {
+		stress_resctrl_t *rg = &resctrls[i];
+		uint64_t val;
+
+		if (rg->mbm_total_valid &&
+		    (stress_resctrl_read(rg->path, "mbm_total_bytes", &val) == 0))
+			rg->mbm_total = val - rg->mbm_total_start;
+		else
+			rg->mbm_total_valid = false;
+		if (rg->mbm_local_valid &&
+		    (stress_resctrl_read(rg->path, "mbm_local_bytes", &val) == 0))
+			rg->mbm_local = val - rg->mbm_local_start;
+		else
+			rg->mbm_local_valid = false;
+		rg->llc_valid = (stress_resctrl_read(rg->path,
+			"llc_occupancy", &rg->llc_occupancy) == 0);
+		rg->collected = true;
+	}
+}
+
+/*
+ *  stress_resctrl_sweep_enabled()
+ *	return true if the stressors are to be run once
+ *	for each of the --resctrl-sweep configurations
+ */
+bool stress_resctrl_sweep_enabled(void)
+{
+	return resctrl_sweeps_num > 0;
+}
+
+/*
+ *  stress_resctrl_group()
+ *	find the resctrl group of a stressor
+ */
+static stress_resctrl_t *stress_resctrl_group(const stress_stressor_t *ss)
+{
+	size_t i;
+
+	for (i = 0; i < resctrls_num; i++) {
+		if (resctrls[i].ss == ss)
+			return &resctrls[i];
+	}
+	return NULL;
+}
+
+/*
+ *  stress_resctrl_sweep_begin()
+ *	apply the schemata of the next configuration to the victim
+ *	and aggressor control groups, returns false when all the
+ *	configurations have been run
+ */
+bool stress_resctrl_sweep_begin(stress_stressor_t *stressors_list)
+{
+	const stress_resctrl_sweep_t *config;
+	stress_resctrl_t *victim;
+	size_t i;
+
+	(void)stressors_list;
+
+	if (resctrl_sweep_current >= resctrl_sweeps_num)
+		return false;
+	config = &resctrl_sweeps[resctrl_sweep_current];
+
+	pr_inf("resctrl: configuration %zu of %zu, aggressors %s, victim %s\n",
+		resctrl_sweep_current + 1, resctrl_sweeps_num,
+		*config->aggressor ? config->aggressor : "default",
+		*config->victim ? config->victim : "default");
+	for (i = 0; i < resctrls_num; i++) {
+		stress_resctrl_t *rg = &resctrls[i];
+		const char *schemata = (rg->ss == resctrl_victim_ss) ?
+			config->victim : config->aggressor;
+		char status[256];
+
+		if (stress_resctrl_schemata(rg->path, schemata, status, sizeof(status)) < 0)
+			pr_inf("resctrl: cannot set schemata '%s' for %s: %s\n",
+				*schemata ? schemata : "default",
+				stress_munge_underscore(rg->ss->stressor->name), status);
+	}
+
+	victim = stress_resctrl_group(resctrl_victim_ss);
+	if (victim) {
+		victim->mbm_total_valid = (stress_resctrl_read(victim->path,
+			"mbm_total_bytes", &victim->mbm_total_start) == 0);
+	}
+	return true;
+}
+
+/*
+ *  stress_resctrl_sweep_end()
+ *	record the victim throughput, latency, memory bandwidth and
+ *	LLC occupancy and the aggressor throughput of a configuration
+ */
+void stress_resctrl_sweep_end(stress_stressor_t *stressors_list, const double duration)
+{
+	stress_resctrl_sweep_t *config = &resctrl_sweeps[resctrl_sweep_current];
+	const stress_resctrl_t *victim = stress_resctrl_group(resctrl_victim_ss);
+	const stress_stressor_t *ss;
+	stress_latency_t *latency;
+	char p99[32];
+	double r_time;
+	uint64_t val;
+	int32_t j;
+
+	config->run = true;
+	config->bogo_rate = stress_bogo_rate_real_time(resctrl_victim_ss, &r_time);
+	config->aggressor_rate = 0.0;
+	for (ss = stressors_list; ss; ss = ss->next) {
+		if ((ss != resctrl_victim_ss) && (ss->num_instances > 0))
+			config->aggressor_rate += stress_bogo_rate_real_time(ss, &r_time);
+	}
+
+	latency = malloc(sizeof(*latency));
+	if (latency) {
+		stress_latency_reset(latency);
+		for (j = 0; j < resctrl_victim_ss->started_instances; j++) {
+			if (resctrl_victim_ss->stats[j]->latency)
+				stress_latency_merge(latency, resctrl_victim_ss->stats[j]->latency);
+		}
+		config->p50 = stress_latency_percentile(latency, 50.0);
+		config->p99 = stress_latency_percentile(latency, 99.0);
+		free(latency);
+	}
+
+	config->mbm_valid = false;
+	config->llc_valid = false;
+	if (victim) {
+		if (victim->mbm_total_valid && (duration > 0.0) &&
+		    (stress_resctrl_read(victim->path, "mbm_total_bytes", &val) == 0)) {
+			config->mbm_rate = (double)(val - victim->mbm_total_start) / duration;
+			config->mbm_valid = true;
+		}
+		config->llc_valid = (stress_resctrl_read(victim->path,
+			"llc_occupancy", &config->llc_occupancy) == 0);
+	}
+
+	if (config->p99)
+		(void)snprintf(p99, sizeof(p99), "%.2f", (double)config->p99 / 1000.0);
+	else
+		(void)shim_strlcpy(p99, "-", sizeof(p99));
+	pr_inf("resctrl: configuration %zu, victim %.2f bogo ops/s, p99 latency %s us, "
+		"aggressors %.2f bogo ops/s\n", resctrl_sweep_current + 1,
+		config->bogo_rate, p99, config->aggressor_rate);
+	resctrl_sweep_current++;
+}
+
+/*
+ *  stress_resctrl_sweep_dump()
+ *	dump the victim results of each configuration relative
+ *	to the first configuration
+ */
+static void stress_resctrl_sweep_dump(FILE *yaml)
+{
+	const char *victim = stress_munge_underscore(resctrl_victim_ss->stressor->name);
+	const double ref = resctrl_sweeps[0].bogo_rate;
+	bool latencies = false;
+	size_t i;
+
+	for (i = 0; i < resctrl_sweeps_num; i++) {
+		if (resctrl_sweeps[i].p99)
+			latencies = true;
+	}
+	if (!latencies)
+		pr_inf("resctrl: victim %s records no latencies, only its throughput is compared\n",
+			victim);
+
+	pr_inf("resctrl: victim %s\n", victim);
+	pr_inf("resctrl: %-16s %-16s %11s %7s %9s %9s %9s %10s\n",
+		"aggressors", "victim", "ops/s", "% ref", "p50 us", "p99 us",
+		"MB/s", "LLC occ");
+	pr_yaml(yaml, "resctrl-sweep:\n");
+	pr_yaml(yaml, "      victim: %s\n", victim);
+	pr_yaml(yaml, "      configurations:\n");
+
+	for (i = 0; i < resctrl_sweeps_num; i++) {
+		const stress_resctrl_sweep_t *config = &resctrl_sweeps[i];
+		const char *aggressor = *config->aggressor ? config->aggressor : "default";
+		const char *victim_schemata = *config->victim ? config->victim : "default";
+		char p50[32], p99[32], mbm[32], llc[32];
+
+		if (!config->run)
+			continue;
+		if (config->p99) {
+			(void)snprintf(p50, sizeof(p50), "%.2f", (double)config->p50 / 1000.0);
+			(void)snprintf(p99, sizeof(p99), "%.2f", (double)config->p99 / 1000.0);
+		} else {
+			(void)shim_strlcpy(p50, "-", sizeof(p50));
+			(void)shim_strlcpy(p99, "-", sizeof(p99));
+		}
+		if (config->mbm_valid)
+			(void)snprintf(mbm, sizeof(mbm), "%.2f", config->mbm_rate / (double)MB);
+		else
+			(void)shim_strlcpy(mbm, "-", sizeof(mbm));
+		if (config->llc_valid)
+			(void)stress_uint64_to_str(llc, sizeof(llc), config->llc_occupancy);
+		else
+			(void)shim_strlcpy(llc, "-", sizeof(llc));
+		pr_inf("resctrl: %-16.16s %-16.16s %11.2f %7.2f %9s %9s %9s %10s\n",
+			aggressor, victim_schemata, config->bogo_rate,
+			ref > 0.0 ? 100.0 * config->bogo_rate / ref : 0.0,
+			p50, p99, mbm, llc);
+
+		pr_yaml(yaml, "        - aggressor-schemata: \"%s\"\n", aggressor);
+		pr_yaml(yaml, "          victim-schemata: \"%s\"\n", victim_schemata);
+		pr_yaml(yaml, "          victim-bogo-ops-per-second-real-time: %f\n", config->bogo_rate);
+		pr_yaml(yaml, "          aggressor-bogo-ops-per-second-real-time: %f\n", config->aggressor_rate);
+		if (config->p99) {
+			pr_yaml(yaml, "          victim-latency-p50-ns: %" PRIu64 "\n", config->p50);
+			pr_yaml(yaml, "          victim-latency-p99-ns: %" PRIu64 "\n", config->p99);
+		}
+		if (config->mbm_valid)
+			pr_yaml(yaml, "          victim-mbm-bytes-per-sec: %.2f\n", config->mbm_rate);
+		if (config->llc_valid)
+			pr_yaml(yaml, "          victim-llc-occupancy-bytes: %" PRIu64 "\n", config->llc_occupancy);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_resctrl_dump()
+ *	dump the memory bandwidth and LLC occupancy of each stressor
+ */
+void stress_resctrl_dump(FILE *yaml)
+{
+	size_t i;
+
+	if (!resctrls_num)
+		return;
+
+	pr_inf("resctrl: %-13s %12s %12s %10s %4s\n",
+		"stressor", "MB/s total", "MB/s local", "LLC occ", "cat");
+	pr_yaml(yaml, "resctrl:\n");
+	pr_yaml(yaml, "      path: %s\n", resctrl_mount);
+	if (resctrl_cat_schemata)
+		pr_yaml(yaml, "      schemata: %s\n", resctrl_cat_schemata);
+	pr_yaml(yaml, "      duration: %.2f\n", resctrl_duration);
+	pr_yaml(yaml, "      stressors:\n");
+
+	for (i = 0; i < resctrls_num; i++) {
+		const stress_resctrl_t *rg = &resctrls[i];
+		const char *munged = stress_munge_underscore(rg->ss->stressor->name);
+		char total[32], local[32], llc[32];
+
+		if (!rg->collected)
+			continue;
+		if (rg->mbm_total_valid && (resctrl_duration > 0.0))
+			(void)snprintf(total, sizeof(total), "%.2f",
+				(double)rg->mbm_total / resctrl_duration / (double)MB);
+		else
+			(void)shim_strlcpy(total, "-", sizeof(total));
+		if (rg->mbm_local_valid && (resctrl_duration > 0.0))
+			(void)snprintf(local, sizeof(local), "%.2f",
+				(double)rg->mbm_local / resctrl_duration / (double)MB);
+		else
+			(void)shim_strlcpy(local, "-", sizeof(local));
+		if (rg->llc_valid)
+			(void)stress_uint64_to_str(llc, sizeof(llc), rg->llc_occupancy);
+		else
+			(void)shim_strlcpy(llc, "-", sizeof(llc));
+		pr_inf("resctrl: %-13s %12s %12s %10s %4s\n",
+			munged, total, local, llc, rg->cat ? "yes" : "no");
+
+		pr_yaml(yaml, "        - stressor: %s\n", munged);
+		pr_yaml(yaml, "          cat: %s\n", rg->cat ? "true" : "false");
+		if (rg->mbm_total_valid) {
+			pr_yaml(yaml, "          mbm-total-bytes: %" PRIu64 "\n", rg->mbm_total);
+			if (resctrl_duration > 0.0)
+				pr_yaml(yaml, "          mbm-total-bytes-per-sec: %.2f\n",
+					(double)rg->mbm_total / resctrl_duration);
+		}
+		if (rg->mbm_local_valid) {
+			pr_yaml(yaml, "          mbm-local-bytes: %" PRIu64 "\n", rg->mbm_local);
+			if (resctrl_duration > 0.0)
+				pr_yaml(yaml, "          mbm-local-bytes-per-sec: %.2f\n",
+					(double)rg->mbm_local / resctrl_duration);
+		}
+		if (rg->llc_valid)
+			pr_yaml(yaml, "          llc-occupancy-bytes: %" PRIu64 "\n", rg->llc_occupancy);
+	}
+	pr_yaml(yaml, "\n");
+
+	if (resctrl_sweeps_num)
+		stress_resctrl_sweep_dump(yaml);
+}
+
+/*
+ *  stress_resctrl_free()
+ *	remove the resctrl groups, any tasks left in a group
+ *	are moved back to the default group by the kernel
+ */
+void stress_resctrl_free(void)
+{
+	size_t i;
+
+	for (i = 0; i < resctrls_num; i++) {
+		const stress_resctrl_t *rg = &resctrls[i];
+
+		if (rmdir(rg->path) < 0)
+			pr_dbg("resctrl: cannot remove %s, errno=%d (%s)\n",
+				rg->path, errno, strerror(errno));
+	}
+	free(resctrls);
+	resctrls = NULL;
+	resctrls_num = 0;
+	free(resctrl_sweeps);
+	resctrl_sweeps = NULL;
+	resctrl_sweeps_num = 0;
+	*resctrl_cat_stressor = '\0';
+	resctrl_cat_schemata = NULL;
+	*resctrl_mount = '\0';
+}
+
+#else
+void stress_resctrl_init(stress_stressor_t *stressors_list)
+{
+	bool resctrl = false;
+	char *cat = NULL;
+
+	(void)stressors_list;
+	(void)stress_get_setting("resctrl", &resctrl);
+	(void)stress_get_setting("resctrl-cat", &cat);
+	if (resctrl || cat || resctrl_sweeps_num)
+		pr_inf("resctrl: resctrl is not supported, ignoring --resctrl\n");
+	free(resctrl_sweeps);
+	resctrl_sweeps = NULL;
+	resctrl_sweeps_num = 0;
+}
+
+bool stress_resctrl_sweep_enabled(void)
+{
+	return false;
+}
+
+bool stress_resctrl_sweep_begin(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+	return false;
+}
+
+void stress_resctrl_sweep_end(stress_stressor_t *stressors_list, const double duration)
+{
+	(void)stressors_list;
+	(void)duration;
+}
+
+void stress_resctrl_start(void)
+{
+}
+
+void stress_resctrl_join(const stress_stressor_t *ss)
+{
+	(void)ss;
+}
+
+void stress_resctrl_collect(void)
+{
+}
+
+void stress_resctrl_dump(FILE *yaml)
+{
+	(void)yaml;
+}
+
+void stress_resctrl_free(void)
+{
+}
+#endif
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_RESCTRL_H
+#define CORE_RESCTRL_H
+
+/* resctrl per stressor memory bandwidth monitoring and cache allocation */
+extern int stress_set_resctrl(const char *opt);
+extern int stress_set_resctrl_cat(const char *opt);
+extern int stress_set_resctrl_sweep(const char *opt);
+extern int stress_set_resctrl_victim(const char *opt);
+extern int stress_resctrl_setup(stress_stressor_t *stressors_list);
+extern void stress_resctrl_init(stress_stressor_t *stressors_list);
+extern void stress_resctrl_start(void);
+extern void stress_resctrl_join(const stress_stressor_t *ss);
+extern WARN_UNUSED bool stress_resctrl_sweep_enabled(void);
+extern bool stress_resctrl_sweep_begin(stress_stressor_t *stressors_list);
+extern void stress_resctrl_sweep_end(stress_stressor_t *stressors_list, const double duration);
+extern void stress_resctrl_collect(void);
+extern void stress_resctrl_dump(FILE *yaml);
+extern void stress_resctrl_free(void);
+
+#endif
@@ -0,0 +1,640 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-perf.h"
+#include "core-results.h"
+
+#if defined(HAVE_SYS_UTSNAME_H)
+#include <sys/utsname.h>
+#endif
+
+/*
+ *  Binary columnar results file, written with --results-bin. All
+ *  values are in host byte order, the endian marker allows readers
+ *  to detect and swap them. The file is a header followed by a
+ *  stream of tables terminated by a table with zero columns:
+ *
+ *  header:	char magic[8] "SNGCOLS\0", uint32 version, uint32 endian marker
+ *  table:	char name[16], uint32 columns, uint32 reserved, uint64 rows
+ *		column descriptors: char name[32], uint32 type, uint32 reserved
+ *		column data, for each column in order:
+ *		  uint64 byte length, then
+ *		  U64/I64/F64: rows x 8 byte values
+ *		  STR: (rows + 1) x uint32 offsets into the following
+ *		       string bytes (Arrow variable length layout)
+ *
+ *  Each table is complete once written, so readers can consume
+ *  the file table by table as it is streamed.
+ */
+#define STRESS_RESULTS_MAGIC	"SNGCOLS"
+#define STRESS_RESULTS_VERSION	(1)
+#define STRESS_RESULTS_ENDIAN	(0x01020304)
+#define STRESS_RESULTS_COLS_MAX	(16)
+
+#define STRESS_RESULTS_U64	(1)
+#define STRESS_RESULTS_I64	(2)
+#define STRESS_RESULTS_F64	(3)
+#define STRESS_RESULTS_STR	(4)
+
+typedef struct {
+	const char *name;		/* column name */
+	const uint32_t type;		/* STRESS_RESULTS_* type */
+} stress_results_col_info_t;
+
+typedef struct {
+	uint8_t *data;			/* column values or string bytes */
+	size_t len;			/* bytes used in data */
+	size_t size;			/* bytes allocated for data */
+	uint32_t *offsets;		/* string offsets, rows + 1 */
+	size_t offsets_size;		/* offsets allocated */
+} stress_results_col_t;
+
+typedef struct {
+	const char *name;		/* table name */
+	const stress_results_col_info_t *info; /* column names and types */
+	size_t cols_num;		/* number of columns */
+	uint64_t rows;			/* number of completed rows */
+	bool failed;			/* out of memory */
+	stress_results_col_t cols[STRESS_RESULTS_COLS_MAX];
+} stress_results_table_t;
+
+static const stress_results_col_info_t host_cols[] = {
+	{ "version",		STRESS_RESULTS_STR },
+	{ "sysname",		STRESS_RESULTS_STR },
+	{ "nodename",		STRESS_RESULTS_STR },
+	{ "release",		STRESS_RESULTS_STR },
+	{ "machine",		STRESS_RESULTS_STR },
+	{ "cpus-online",	STRESS_RESULTS_U64 },
+	{ "cpus-configured",	STRESS_RESULTS_U64 },
+	{ "memory-total",	STRESS_RESULTS_U64 },
+	{ "page-size",		STRESS_RESULTS_U64 },
+	{ "date",		STRESS_RESULTS_I64 },
+	{ "run-time",		STRESS_RESULTS_F64 },
+	{ "user-time",		STRESS_RESULTS_F64 },
+	{ "system-time",	STRESS_RESULTS_F64 },
+};
+
+static const stress_results_col_info_t instance_cols[] = {
+	{ "stressor",		STRESS_RESULTS_STR },
+	{ "instance",		STRESS_RESULTS_U64 },
+	{ "run-ok",		STRESS_RESULTS_U64 },
+	{ "bogo-ops",		STRESS_RESULTS_U64 },
+	{ "start",		STRESS_RESULTS_F64 },
+	{ "finish",		STRESS_RESULTS_F64 },
+	{ "user-time",		STRESS_RESULTS_F64 },
+	{ "system-time",	STRESS_RESULTS_F64 },
+	{ "max-rss",		STRESS_RESULTS_I64 },
+	{ "window-bogo-ops",	STRESS_RESULTS_U64 },
+	{ "window-time",	STRESS_RESULTS_F64 },
+	{ "cpu-begin",		STRESS_RESULTS_I64 },
+	{ "cpu-end",		STRESS_RESULTS_I64 },
+	{ "migrations",		STRESS_RESULTS_U64 },
+};
+
+static const stress_results_col_info_t metric_cols[] = {
+	{ "stressor",		STRESS_RESULTS_STR },
+	{ "instance",		STRESS_RESULTS_U64 },
+	{ "metric",		STRESS_RESULTS_STR },
+	{ "value",		STRESS_RESULTS_F64 },
+};
+
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+static const stress_results_col_info_t perf_cols[] = {
+	{ "stressor",		STRESS_RESULTS_STR },
+	{ "instance",		STRESS_RESULTS_U64 },
+	{ "counter",		STRESS_RESULTS_STR },
+	{ "value",		STRESS_RESULTS_U64 },
+	{ "running-ppm",	STRESS_RESULTS_U64 },
+};
+#endif
+
+#if defined(STRESS_THERMAL_ZONES)
+static const stress_results_col_info_t thermal_cols[] = {
+	{ "stressor",		STRESS_RESULTS_STR },
+	{ "instance",		STRESS_RESULTS_U64 },
+	{ "zone",		STRESS_RESULTS_STR },
+	{ "temperature",	STRESS_RESULTS_F64 },
+};
+#endif
+
+static const stress_results_col_info_t latency_cols[] = {
+	{ "stressor",		STRESS_RESULTS_STR },
+	{ "instance",		STRESS_RESULTS_U64 },
+	{ "bucket-max-nsec",	STRESS_RESULTS_U64 },
+	{ "count",		STRESS_RESULTS_U64 },
+};
+
+/*
+ *  stress_results_table_init()
+ *	initialize an empty table
+ */
+static void stress_results_table_init(
+	stress_results_table_t *table,
+	const char *name,
+	const stress_results_col_info_t *info,
+	const size_t cols_num)
+{
+	(void)memset(table, 0, sizeof(*table));
+	table->name = name;
+	table->info = info;
+	table->cols_num = STRESS_MINIMUM(cols_num, STRESS_RESULTS_COLS_MAX);
+}
+
+/*
+ *  stress_results_table_free()
+ *	free table column data
+ */
+static void stress_results_table_free(stress_results_table_t *table)
+{
+	size_t i;
+
+	for (i = 0; i < table->cols_num; i++) {
+		free(table->cols[i].data);
+		free(table->cols[i].offsets);
+	}
+	(void)memset(table->cols, 0, sizeof(table->cols));
+	table->rows = 0;
+}
+
+/*
+ *  stress_results_append()
+ *	append len bytes to a column's data
+ */
+static void stress_results_append(
+	stress_results_table_t *table,
+	const size_t col,
+	const void *data,
+	const size_t len)
+{
+	stress_results_col_t *c = &table->cols[col];
+
+	if (table->failed)
+		return;
+	if (c->len + len > c->size) {
+		size_t size = c->size ? c->size : 4096;
+		uint8_t *ptr;
+
+		while (c->len + len > size)
+			size <<= 1;
+		ptr = realloc(c->data, size);
+		if (!ptr) {
+			table->failed = true;
+			return;
+		}
+		c->data = ptr;
+		c->size = size;
+	}
+	(void)memcpy(c->data + c->len, data, len);
+	c->len += len;
+}
+
+static void stress_results_u64(stress_results_table_t *table, const size_t col, const uint64_t val)
+{
+	stress_results_append(table, col, &val, sizeof(val));
+}
+
+static void stress_results_i64(stress_results_table_t *table, const size_t col, const int64_t val)
+{
+	stress_results_append(table, col, &val, sizeof(val));
+}
+
+static void stress_results_f64(stress_results_table_t *table, const size_t col, const double val)
+{
+	stress_results_append(table, col, &val, sizeof(val));
+}
+
+/*
+ *  stress_results_str()
+ *	append a string, the offsets are the Arrow style start
+ *	offsets of each row followed by the end offset
+ */
+static void stress_results_str(stress_results_table_t *table, const size_t col, const char *str)
+{
+	stress_results_col_t *c = &table->cols[col];
+	const size_t rows = (size_t)table->rows;
+
+	if (table->failed)
+		return;
+	if (rows + 2 > c->offsets_size) {
+		size_t size = c->offsets_size ? c->offsets_size << 1 : 256;
+		uint32_t *ptr;
+
+		ptr = realloc(c->offsets, size * sizeof(*ptr));
+		if (!ptr) {
+			table->failed = true;
+			return;
+		}
+		c->offsets = ptr;
+		c->offsets_size = size;
+	}
+	if (!str)
+		str = "";
+	c->offsets[rows] = (uint32_t)c->len;
+	stress_results_append(table, col, str, strlen(str));
+	c->offsets[rows + 1] = (uint32_t)c->len;
+}
+
+/*
+ *  stress_results_write()
+ *	write a table and free its column data
+ */
+static void stress_results_write(FILE *fp, stress_results_table_t *table)
+{
+	char name[32];
+	uint32_t u32;
+	uint64_t u64;
+	size_t i;
+
+	if (table->failed) {
+		pr_inf("results-bin: out of memory building %s table, skipping it\n",
+			table->name);
+		stress_results_table_free(table);
+		table->failed = false;
+		return;
+	}
+
+	(void)memset(name, 0, sizeof(name));
+	(void)shim_strlcpy(name, table->name, 16);
+	VOID_RET(size_t, fwrite(name, 1, 16, fp));
+	u32 = (uint32_t)table->cols_num;
+	VOID_RET(size_t, fwrite(&u32, sizeof(u32), 1, fp));
+	u32 = 0;
+	VOID_RET(size_t, fwrite(&u32, sizeof(u32), 1, fp));
+	VOID_RET(size_t, fwrite(&table->rows, sizeof(table->rows), 1, fp));
+
+	for (i = 0; i < table->cols_num; i++) {
+		(void)memset(name, 0, sizeof(name));
+		(void)shim_strlcpy(name, table->info[i].name, sizeof(name));
+		VOID_RET(size_t, fwrite(name, 1, sizeof(name), fp));
+		u32 = table->info[i].type;
+		VOID_RET(size_t, fwrite(&u32, sizeof(u32), 1, fp));
+		u32 = 0;
+		VOID_RET(size_t, fwrite(&u32, sizeof(u32), 1, fp));
+	}
+
+	for (i = 0; i < table->cols_num; i++) {
+		stress_results_col_t *c = &table->cols[i];
+
+		if (table->info[i].type == STRESS_RESULTS_STR) {
+			const uint32_t zero = 0;
+			const size_t offsets_len = (size_t)(table->rows + 1) * sizeof(uint32_t);
+
+			u64 = (uint64_t)(offsets_len + c->len);
+			VOID_RET(size_t, fwrite(&u64, sizeof(u64), 1, fp));
+			if (c->offsets)
+				VOID_RET(size_t, fwrite(c->offsets, 1, offsets_len, fp));
+			else
+				VOID_RET(size_t, fwrite(&zero, sizeof(zero), 1, fp));
+		} else {
+			u64 = (uint64_t)c->len;
+			VOID_RET(size_t, fwrite(&u64, sizeof(u64), 1, fp));
+		}
+		if (c->len)
+			VOID_RET(size_t, fwrite(c->data, 1, c->len, fp));
+	}
+	stress_results_table_free(table);
+}
+
+/*
+ *  stress_results_host()
+ *	write the single row host information table
+ */
+static void stress_results_host(
+	FILE *fp,
+	stress_results_table_t *table,
+	const int32_t ticks_per_sec,
+	const double duration)
+{
+	struct tms buf;
+	double u_time = 0.0, s_time = 0.0;
+	const char *sysname = "", *nodename = "", *release = "", *machine = "";
+#if defined(HAVE_UNAME) &&	\
+    defined(HAVE_SYS_UTSNAME_H)
+	struct utsname uts;
+
+	if (uname(&uts) >= 0) {
+		sysname = uts.sysname;
+		nodename = uts.nodename;
+		release = uts.release;
+		machine = uts.machine;
+	}
+#endif
+	if ((times(&buf) != (clock_t)-1) && (ticks_per_sec > 0)) {
+		u_time = (double)buf.tms_cutime / (double)ticks_per_sec;
+		s_time = (double)buf.tms_cstime / (double)ticks_per_sec;
+	}
+
+	stress_results_table_init(table, "host", host_cols, SIZEOF_ARRAY(host_cols));
+	stress_results_str(table, 0, VERSION);
+	stress_results_str(table, 1, sysname);
+	stress_results_str(table, 2, nodename);
+	stress_results_str(table, 3, release);
+	stress_results_str(table, 4, machine);
+	stress_results_u64(table, 5, (uint64_t)stress_get_processors_online());
+	stress_results_u64(table, 6, (uint64_t)stress_get_processors_configured());
+	stress_results_u64(table, 7, stress_get_phys_mem_size());
+	stress_results_u64(table, 8, (uint64_t)stress_get_page_size());
+	stress_results_i64(table, 9, (int64_t)time(NULL));
+	stress_results_f64(table, 10, duration);
+	stress_results_f64(table, 11, u_time);
+	stress_results_f64(table, 12, s_time);
+	table->rows++;
+	stress_results_write(fp, table);
+}
+
+/*
+ *  stress_results_instances()
+ *	write the per stressor instance counters and rusage table
+ */
+static void stress_results_instances(
+	FILE *fp,
+	stress_results_table_t *table,
+	stress_stressor_t *stressors_list,
+	const int32_t ticks_per_sec)
+{
+	stress_stressor_t *ss;
+
+	stress_results_table_init(table, "instances", instance_cols, SIZEOF_ARRAY(instance_cols));
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		if (!ss->stats)
+			continue;
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+			double u_time, s_time;
+			long int maxrss = 0;
+
+#if defined(HAVE_GETRUSAGE)
+			(void)ticks_per_sec;
+			u_time = stats->rusage_utime;
+			s_time = stats->rusage_stime;
+#if defined(HAVE_RUSAGE_RU_MAXRSS)
+			maxrss = stats->rusage_maxrss;
+#endif
+#else
+			u_time = (ticks_per_sec > 0) ?
+				(double)(stats->tms.tms_utime + stats->tms.tms_cutime) / (double)ticks_per_sec : 0.0;
+			s_time = (ticks_per_sec > 0) ?
+				(double)(stats->tms.tms_stime + stats->tms.tms_cstime) / (double)ticks_per_sec : 0.0;
+#endif
+			stress_results_str(table, 0, ss->stressor->name);
+			stress_results_u64(table, 1, (uint64_t)j);
+			stress_results_u64(table, 2, (uint64_t)stats->ci.run_ok);
+			stress_results_u64(table, 3, stats->ci.counter);
+			stress_results_f64(table, 4, stats->start);
+			stress_results_f64(table, 5, stats->finish);
+			stress_results_f64(table, 6, u_time);
+			stress_results_f64(table, 7, s_time);
+			stress_results_i64(table, 8, (int64_t)maxrss);
+			if (stats->window.end > stats->window.begin) {
+				stress_results_u64(table, 9, stats->window.counter_end - stats->window.counter_begin);
+				stress_results_f64(table, 10, stats->window.end - stats->window.begin);
+			} else {
+				stress_results_u64(table, 9, 0);
+				stress_results_f64(table, 10, 0.0);
+			}
+			stress_results_i64(table, 11, (int64_t)stats->cpu_begin);
+			stress_results_i64(table, 12, (int64_t)stats->cpu_end);
+			stress_results_u64(table, 13, stats->schedstat.valid ? stats->schedstat.migrations : 0);
+			table->rows++;
+		}
+	}
+	stress_results_write(fp, table);
+}
+
+/*
+ *  stress_results_metrics()
+ *	write the per instance stressor specific metrics table
+ */
+static void stress_results_metrics(
+	FILE *fp,
+	stress_results_table_t *table,
+	stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+
+	stress_results_table_init(table, "metrics", metric_cols, SIZEOF_ARRAY(metric_cols));
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		if (!ss->stats)
+			continue;
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+			size_t i;
+
+			for (i = 0; i < SIZEOF_ARRAY(stats->metrics); i++) {
+				if (!stats->metrics[i].description)
+					continue;
+				stress_results_str(table, 0, ss->stressor->name);
+				stress_results_u64(table, 1, (uint64_t)j);
+				stress_results_str(table, 2, stats->metrics[i].description);
+				stress_results_f64(table, 3, stats->metrics[i].value);
+				table->rows++;
+			}
+		}
+	}
+	stress_results_write(fp, table);
+}
+
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+/*
+ *  stress_results_perf()
+ *	write the per instance perf counters table
+ */
+static void stress_results_perf(
+	FILE *fp,
+	stress_results_table_t *table,
+	stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+
+	stress_results_table_init(table, "perf", perf_cols, SIZEOF_ARRAY(perf_cols));
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		if (!ss->stats)
+			continue;
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_perf_t *sp = ss->stats[j]->sp;
+			int p;
+
+			if (!stress_perf_stat_succeeded(sp))
+				continue;
+			for (p = 0; p < STRESS_PERF_MAX; p++) {
+				const stress_perf_stat_t *ps = &sp->perf_stat[p];
+				char label[128];
+				const char *l;
+
+				l = stress_perf_stat_label(p, label, sizeof(label));
+				if (!l)
+					break;
+				if (ps->counter == STRESS_PERF_INVALID)
+					continue;
+				stress_results_str(table, 0, ss->stressor->name);
+				stress_results_u64(table, 1, (uint64_t)j);
+				stress_results_str(table, 2, l);
+				stress_results_u64(table, 3, ps->counter);
+				stress_results_u64(table, 4, (uint64_t)ps->running_ppm);
+				table->rows++;
+			}
+		}
+	}
+	stress_results_write(fp, table);
+}
+#endif
+
+#if defined(STRESS_THERMAL_ZONES)
+/*
+ *  stress_results_thermal()
+ *	write the per instance thermal zone temperatures table
+ */
+static void stress_results_thermal(
+	FILE *fp,
+	stress_results_table_t *table,
+	stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+
+	stress_results_table_init(table, "thermal", thermal_cols, SIZEOF_ARRAY(thermal_cols));
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		if (!ss->stats)
+			continue;
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+			const stress_tz_info_t *tz_info;
+
+			if (!stats->tz)
+				continue;
+			for (tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next) {
+				const uint64_t temp = stats->tz->tz_stat[tz_info->index].temperature;
+
+				/* Skip unread and crazy temperatures. e.g. > 250 C */
+				if ((temp == 0) || (temp > 250000))
+					continue;
+				stress_results_str(table, 0, ss->stressor->name);
+				stress_results_u64(table, 1, (uint64_t)j);
+				stress_results_str(table, 2, tz_info->type);
+				stress_results_f64(table, 3, (double)temp / 1000.0);
+				table->rows++;
+			}
+		}
+	}
+	stress_results_write(fp, table);
+}
+#endif
+
+/*
+ *  stress_results_latency()
+ *	write the non-empty per instance latency histogram buckets table
+ */
+static void stress_results_latency(
+	FILE *fp,
+	stress_results_table_t *table,
+	stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+
+	stress_results_table_init(table, "latency", latency_cols, SIZEOF_ARRAY(latency_cols));
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		if (!ss->stats)
+			continue;
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_latency_t *latency = ss->stats[j]->latency;
+			size_t i;
+
+			if (!latency || !latency->count)
+				continue;
+			for (i = 0; i < STRESS_LATENCY_BUCKETS; i++) {
+				if (!latency->bucket[i])
+					continue;
+				stress_results_str(table, 0, ss->stressor->name);
+				stress_results_u64(table, 1, (uint64_t)j);
+				stress_results_u64(table, 2, stress_latency_bucket_max(i));
+				stress_results_u64(table, 3, latency->bucket[i]);
+				table->rows++;
+			}
+		}
+	}
+	stress_results_write(fp, table);
+}
+
+/*
+ *  stress_results_dump()
+ *	write the run results to a binary columnar file
+ */
+void stress_results_dump(
+	const char *filename,
+	stress_stressor_t *stressors_list,
+	const int32_t ticks_per_sec,
+	const double duration)
+{
+	static stress_results_table_t table;
+	char magic[8];
+	uint32_t u32;
+	FILE *fp;
+
+	if (!filename)
+		return;
+
+	fp = fopen(filename, "w");
+	if (!fp) {
+		pr_err("results-bin: cannot create %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return;
+	}
+
+	(void)memset(magic, 0, sizeof(magic));
+	(void)memcpy(magic, STRESS_RESULTS_MAGIC, sizeof(STRESS_RESULTS_MAGIC) - 1);
+	VOID_RET(size_t, fwrite(magic, 1, sizeof(magic), fp));
+	u32 = STRESS_RESULTS_VERSION;
+	VOID_RET(size_t, fwrite(&u32, sizeof(u32), 1, fp));
+	u32 = STRESS_RESULTS_ENDIAN;
+	VOID_RET(size_t, fwrite(&u32, sizeof(u32), 1, fp));
+
+	stress_results_host(fp, &table, ticks_per_sec, duration);
+	stress_results_instances(fp, &table, stressors_list, ticks_per_sec);
+	stress_results_metrics(fp, &table, stressors_list);
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	stress_results_perf(fp, &table, stressors_list);
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES)
+		stress_results_thermal(fp, &table, stressors_list);
+#endif
+	stress_results_latency(fp, &table, stressors_list);
+
+	/* end of tables */
+	stress_results_table_init(&table, "end", NULL, 0);
+	stress_results_write(fp, &table);
+
+	if (fflush(fp) != 0)
+		pr_err("results-bin: failed to write %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+	(void)fclose(fp);
+}
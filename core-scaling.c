@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cpu-cache.h"
+#include "core-hybrid.h"
+#include "core-perf.h"
+#include "core-phase.h"
+#include "core-resctrl.h"
+#include "core-scaling.h"
+#include "core-search.h"
+#include "core-smt.h"
+
+/*
+ *  scaling stops (the knee) when adding instances gains less
+ *  than this fraction of a single instance throughput per
+ *  added instance
+ */
+#define SCALING_KNEE_MARGINAL	(0.5)
+
+/* throughput of a stressor at one instance count */
+typedef struct {
+	uint32_t instances;		/* instances run */
+	bool run;			/* step completed */
+	double bogo_rate;		/* real time bogo ops per second */
+	double ipc;			/* mean instructions per cycle, < 0 if unknown */
+} stress_scaling_point_t;
+
+/* scaling curve of a stressor */
+typedef struct {
+	stress_stressor_t *ss;
+	stress_scaling_point_t *points;	/* 1, 2, 4 .. N instances */
+	size_t points_num;
+} stress_scaling_t;
+
+/*
+ *  stress_set_scaling()
+ *	enable --scaling
+ */
+int stress_set_scaling(const char *opt)
+{
+	bool scaling = true;
+
+	(void)opt;
+	return stress_set_setting_global("scaling", TYPE_ID_BOOL, &scaling);
+}
+
+#if defined(HAVE_SCHED_SETAFFINITY)
+
+static stress_scaling_t *scalings;
+static size_t scalings_num;
+static size_t scaling_current;		/* stressor being run */
+static size_t scaling_point;		/* point of stressor being run */
+static bool scaling_steps;		/* true if there are steps to run */
+static const stress_stressor_t *scaling_ss;	/* stressor of current step */
+static int32_t *scaling_cpus;		/* cpus in placement order */
+static size_t scaling_cpus_num;
+
+/*
+ *  stress_scaling_cpu_order()
+ *	order the cpus in the affinity mask for placing instances,
+ *	on each physical package one logical cpu of each core is
+ *	used first, then the SMT siblings, then the next package
+ */
+static void stress_scaling_cpu_order(void)
+{
+	stress_cpu_cache_cpus_t *cpus;
+	cpu_set_t set;
+	bool *used;
+	int32_t cpu;
+	uint32_t i, j, k;
+
+	scaling_cpus_num = 0;
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		return;
+	scaling_cpus = calloc((size_t)CPU_COUNT(&set) + 1, sizeof(*scaling_cpus));
+	if (!scaling_cpus)
+		return;
+
+	cpus = stress_cpu_cache_get_all_details();
+	if (!cpus)
+		goto cpu_order;
+	used = calloc(cpus->count, sizeof(*used));
+	if (!used) {
+		stress_free_cpu_caches(cpus);
+		goto cpu_order;
+	}
+	for (i = 0; i < cpus->count; i++) {
+		const stress_cpu_cache_cpu_t *c = &cpus->cpus[i];
+
+		if (!c->online || (c->num >= CPU_SETSIZE) || !CPU_ISSET((int)c->num, &set))
+			used[i] = true;
+	}
+
+	for (i = 0; i < cpus->count; i++) {
+		const int32_t package_id = cpus->cpus[i].package_id;
+
+		if (used[i])
+			continue;
+		/* first logical cpu of each core in the package */
+		for (j = i; j < cpus->count; j++) {
+			const stress_cpu_cache_cpu_t *c = &cpus->cpus[j];
+			bool sibling = false;
+
+			if (used[j] || (c->package_id != package_id))
+				continue;
+			for (k = i; (k < j) && (c->core_id >= 0); k++) {
+				if (used[k] && (cpus->cpus[k].package_id == package_id) &&
+				    (cpus->cpus[k].core_id == c->core_id)) {
+					sibling = true;
+					break;
+				}
+			}
+			if (!sibling) {
+				scaling_cpus[scaling_cpus_num++] = (int32_t)c->num;
+				used[j] = true;
+			}
+		}
+		/* then the SMT siblings in the package */
+		for (j = i; j < cpus->count; j++) {
+			if (!used[j] && (cpus->cpus[j].package_id == package_id)) {
+				scaling_cpus[scaling_cpus_num++] = (int32_t)cpus->cpus[j].num;
+				used[j] = true;
+			}
+		}
+	}
+	free(used);
+	stress_free_cpu_caches(cpus);
+	if (scaling_cpus_num)
+		return;
+
+cpu_order:
+	/* no topology, use the cpus in number order */
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &set))
+			scaling_cpus[scaling_cpus_num++] = cpu;
+	}
+}
+
+/*
+ *  stress_scaling_setup()
+ *	check the --scaling option, work out the instance counts
+ *	of each stressor and the cpu placement order
+ */
+int stress_scaling_setup(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool scaling = false;
+	size_t i;
+
+	(void)stress_get_setting("scaling", &scaling);
+	if (!scaling)
+		return 0;
+	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+		pr_err("scaling: --scaling cannot be used with --sequential\n");
+		return -1;
+	}
+	if (stress_phase_count()) {
+		pr_err("scaling: --scaling cannot be used with job file phases\n");
+		return -1;
+	}
+	if (stress_search_enabled()) {
+		pr_err("scaling: --scaling cannot be used with --search\n");
+		return -1;
+	}
+	if (stress_resctrl_sweep_enabled() || stress_hybrid_enabled() || stress_smt_enabled()) {
+		pr_err("scaling: --scaling cannot be used with --resctrl-sweep, "
+			"--core-type or --smt-interference\n");
+		return -1;
+	}
+
+	for (scalings_num = 0, ss = stressors_list; ss; ss = ss->next) {
+		if (ss->num_instances > 0)
+			scalings_num++;
+	}
+	if (!scalings_num)
+		return 0;
+
+	scalings = calloc(scalings_num, sizeof(*scalings));
+	if (!scalings)
+		goto err;
+	for (i = 0, ss = stressors_list; ss; ss = ss->next) {
+		stress_scaling_t *scaling;
+		uint32_t n;
+		size_t j;
+
+		if (ss->num_instances <= 0)
+			continue;
+		scaling = &scalings[i++];
+		scaling->ss = ss;
+
+		/* 1, 2, 4 .. up to and including the instances requested */
+		for (n = 1; n < (uint32_t)ss->num_instances; n <<= 1)
+			scaling->points_num++;
+		scaling->points_num++;
+		scaling->points = calloc(scaling->points_num, sizeof(*scaling->points));
+		if (!scaling->points)
+			goto err;
+		for (n = 1, j = 0; j < scaling->points_num - 1; j++, n <<= 1)
+			scaling->points[j].instances = n;
+		scaling->points[j].instances = (uint32_t)ss->num_instances;
+	}
+
+	stress_scaling_cpu_order();
+	scaling_steps = true;
+	pr_dbg("scaling: placing instances over %zu CPUs\n", scaling_cpus_num);
+	return 0;
+err:
+	pr_err("scaling: cannot allocate scaling results\n");
+	stress_scaling_free();
+	return -1;
+}
+
+/*
+ *  stress_scaling_enabled()
+ *	true if the scaling curves are being measured
+ */
+bool stress_scaling_enabled(void)
+{
+	return scaling_steps;
+}
+
+/*
+ *  stress_scaling_step_begin()
+ *	set the instance count of the next stressor step, only
+ *	one stressor is run at a time, returns false when all
+ *	steps have been run
+ */
+bool stress_scaling_step_begin(stress_stressor_t *stressors_list)
+{
+	const stress_scaling_t *scaling;
+	stress_stressor_t *ss;
+
+	if (scaling_current >= scalings_num) {
+		scaling_ss = NULL;
+		return false;
+	}
+	scaling = &scalings[scaling_current];
+	for (ss = stressors_list; ss; ss = ss->next)
+		ss->num_instances = 0;
+	scaling->ss->num_instances = (int32_t)scaling->points[scaling_point].instances;
+	scaling_ss = scaling->ss;
+
+	pr_inf("scaling: running %" PRIu32 " %s instance%s\n",
+		scaling->points[scaling_point].instances,
+		stress_munge_underscore(scaling->ss->stressor->name),
+		scaling->points[scaling_point].instances == 1 ? "" : "s");
+	return true;
+}
+
+/*
+ *  stress_scaling_step_end()
+ *	record the throughput of the step just run
+ */
+void stress_scaling_step_end(void)
+{
+	stress_scaling_t *scaling = &scalings[scaling_current];
+	stress_scaling_point_t *point = &scaling->points[scaling_point];
+	const stress_stressor_t *ss = scaling->ss;
+	double r_time;
+
+	point->run = true;
+	point->bogo_rate = stress_bogo_rate_real_time(ss, &r_time);
+	point->ipc = -1.0;
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	if ((g_opt_flags & OPT_FLAGS_PERF_STATS) && ss->stats) {
+		double ipc_total = 0.0;
+		int32_t j, n = 0;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			double ipc;
+
+			if (stress_perf_stat_ipc(ss->stats[j]->sp, &ipc)) {
+				ipc_total += ipc;
+				n++;
+			}
+		}
+		if (n)
+			point->ipc = ipc_total / (double)n;
+	}
+#endif
+	scaling_point++;
+	if (scaling_point >= scaling->points_num) {
+		scaling_point = 0;
+		scaling_current++;
+	}
+}
+
+/*
+ *  stress_scaling_apply()
+ *	pin a stressor instance to the next cpu in the
+ *	topology aware placement order
+ */
+void stress_scaling_apply(const char *name, const stress_stressor_t *ss, const int32_t instance)
+{
+	cpu_set_t set;
+	int32_t cpu;
+
+	if ((ss != scaling_ss) || !scaling_cpus_num)
+		return;
+
+	cpu = scaling_cpus[(size_t)instance % scaling_cpus_num];
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("%s: cannot set scaling CPU %" PRId32 " affinity, errno=%d (%s)\n",
+			name, cpu, errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_scaling_dump()
+ *	dump the throughput and per instance efficiency of each
+ *	instance count, the knee is the last instance count before
+ *	the throughput gained per added instance drops below half
+ *	of the single instance throughput
+ */
+void stress_scaling_dump(FILE *yaml)
+{
+	size_t i, j;
+
+	if (!scalings || !scalings_num || !scalings[0].points[0].run)
+		return;
+
+	pr_yaml(yaml, "scaling:\n");
+	pr_metrics("scaling throughput vs instances:\n");
+	pr_metrics("%-13s %9s %13s %13s %10s %5s\n",
+		"stressor", "instances", "bogo ops/s", "per instance", "efficiency", "IPC");
+	for (i = 0; i < scalings_num; i++) {
+		const stress_scaling_t *scaling = &scalings[i];
+		const double rate1 = scaling->points[0].bogo_rate;
+		char munged[64];
+		uint32_t knee = 0;
+
+		if (!scaling->points[0].run)
+			continue;
+		for (j = 1; (j < scaling->points_num) && scaling->points[j].run && (rate1 > 0.0); j++) {
+			const stress_scaling_point_t *point = &scaling->points[j];
+			const stress_scaling_point_t *prev = &scaling->points[j - 1];
+			const double marginal = (point->bogo_rate - prev->bogo_rate) /
+				((double)(point->instances - prev->instances) * rate1);
+
+			if (marginal < SCALING_KNEE_MARGINAL) {
+				knee = prev->instances;
+				break;
+			}
+		}
+		(void)shim_strlcpy(munged, stress_munge_underscore(scaling->ss->stressor->name), sizeof(munged));
+
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      steps:\n");
+		for (j = 0; j < scaling->points_num; j++) {
+			const stress_scaling_point_t *point = &scaling->points[j];
+			const double per_instance = point->bogo_rate / (double)point->instances;
+			const double efficiency = (rate1 > 0.0) ? 100.0 * per_instance / rate1 : 0.0;
+			char ipc[16];
+
+			if (!point->run)
+				break;
+			if (point->ipc >= 0.0)
+				(void)snprintf(ipc, sizeof(ipc), "%.2f", point->ipc);
+			else
+				(void)shim_strlcpy(ipc, "-", sizeof(ipc));
+			pr_metrics("%-13s %9" PRIu32 " %13.2f %13.2f %9.1f%% %5s%s\n",
+				munged, point->instances, point->bogo_rate, per_instance,
+				efficiency, ipc, (point->instances == knee) ? " <- knee" : "");
+
+			pr_yaml(yaml, "        - instances: %" PRIu32 "\n", point->instances);
+			pr_yaml(yaml, "          bogo-ops-per-second: %f\n", point->bogo_rate);
+			pr_yaml(yaml, "          efficiency-percent: %f\n", efficiency);
+			if (point->ipc >= 0.0)
+				pr_yaml(yaml, "          ipc: %f\n", point->ipc);
+		}
+		if (knee) {
+			pr_metrics("%-13s scaling knee at %" PRIu32 " instance%s\n",
+				munged, knee, knee == 1 ? "" : "s");
+			pr_yaml(yaml, "      knee-instances: %" PRIu32 "\n", knee);
+		}
+		pr_yaml(yaml, "\n");
+	}
+}
+
+/*
+ *  stress_scaling_free()
+ *	free the scaling results
+ */
+void stress_scaling_free(void)
+{
+	size_t i;
+
+	if (scalings) {
+		for (i = 0; i < scalings_num; i++)
+			free(scalings[i].points);
+		free(scalings);
+	}
+	free(scaling_cpus);
+	scalings = NULL;
+	scalings_num = 0;
+	scaling_cpus = NULL;
+	scaling_cpus_num = 0;
+	scaling_steps = false;
+}
+
+#else
+
+int stress_scaling_setup(stress_stressor_t *stressors_list)
+{
+	bool scaling = false;
+
+	(void)stressors_list;
+	(void)stress_get_setting("scaling", &scaling);
+	if (scaling)
+		pr_inf("scaling: CPU affinity not supported, ignoring --scaling\n");
+	return 0;
+}
+
+bool stress_scaling_enabled(void)
+{
+	return false;
+}
+
+bool stress_scaling_step_begin(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+
+	return false;
+}
+
+void stress_scaling_step_end(void)
+{
+}
+
+void stress_scaling_apply(const char *name, const stress_stressor_t *ss, const int32_t instance)
+{
+	(void)name;
+	(void)ss;
+	(void)instance;
+}
+
+void stress_scaling_dump(FILE *yaml)
+{
+	(void)yaml;
+}
+
+void stress_scaling_free(void)
+{
+}
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_SCALING_H
+#define CORE_SCALING_H
+
+/* throughput vs instance count scaling curves */
+extern int stress_set_scaling(const char *opt);
+extern int stress_scaling_setup(stress_stressor_t *stressors_list);
+extern bool stress_scaling_enabled(void);
+extern bool stress_scaling_step_begin(stress_stressor_t *stressors_list);
+extern void stress_scaling_step_end(void);
+extern void stress_scaling_apply(const char *name, const stress_stressor_t *ss, const int32_t instance);
+extern void stress_scaling_dump(FILE *yaml);
+extern void stress_scaling_free(void);
+
+#endif
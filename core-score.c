@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-compare.h"
+#include "core-score.h"
+
+#include <math.h>
+
+#define SCORE_SCALE		(1000.0)	/* score of the baseline host */
+#define SCORE_CLASSES		(32)		/* bits in stress_class_t */
+
+typedef struct {
+	double log_sum;		/* sum of log(ratio) of the stressors */
+	uint32_t n;		/* stressors scored in the class */
+} stress_score_class_t;
+
+/*
+ *  stress_score_dump()
+ *	normalise the bogo ops per second (real time) of each stressor
+ *	against a --score baseline yaml file from a reference host and
+ *	report the geometric mean of the ratios per stress class and
+ *	overall, scaled so the reference host scores SCORE_SCALE. A
+ *	baseline that cannot be loaded or has no stressor that could be
+ *	scored makes the run unsuccessful
+ */
+void stress_score_dump(FILE *yaml, stress_stressor_t *stressors_list, bool *success)
+{
+	char *filename = NULL;
+	stress_compare_baseline_t *baseline;
+	stress_stressor_t *ss;
+	stress_score_class_t classes[SCORE_CLASSES];
+	double log_sum = 0.0;
+	uint32_t n = 0;
+	size_t i;
+
+	if (!stress_get_setting("score", &filename) || !filename)
+		return;
+
+	baseline = stress_compare_baseline_load("score", filename);
+	if (!baseline) {
+		*success = false;
+		return;
+	}
+
+	(void)memset(classes, 0, sizeof(classes));
+
+	/* first pass, the overall count is needed for the contributions */
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		double r_time;
+		double base, curr;
+
+		if (!ss->stats || !ss->started_instances)
+			continue;
+		base = stress_compare_baseline_rate(baseline, munged);
+		curr = stress_bogo_rate_real_time(ss, &r_time);
+		if ((base > 0.0) && (curr > 0.0))
+			n++;
+	}
+	if (!n) {
+		pr_err("score: no stressors of this run have a throughput in baseline %s\n",
+			filename);
+		stress_compare_baseline_free(baseline);
+		*success = false;
+		return;
+	}
+
+	pr_inf("score against baseline %s (%.0f = baseline host):\n",
+		filename, SCORE_SCALE);
+	pr_inf("%-13s %13s %13s %9s %12s\n",
+		"stressor", "baseline", "current", "score", "contribution");
+	pr_yaml(yaml, "score:\n");
+	pr_yaml(yaml, "    baseline: %s\n", filename);
+	pr_yaml(yaml, "    scale: %f\n", SCORE_SCALE);
+	pr_yaml(yaml, "    stressors:\n");
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		const stress_class_t class = ss->stressor->info->class;
+		double r_time, ratio, contribution;
+		double base, curr;
+
+		if (!ss->stats || !ss->started_instances)
+			continue;
+		base = stress_compare_baseline_rate(baseline, munged);
+		curr = stress_bogo_rate_real_time(ss, &r_time);
+		if (base <= 0.0) {
+			pr_inf("%-13s not in baseline\n", munged);
+			continue;
+		}
+		if (curr <= 0.0) {
+			pr_inf("%-13s no throughput to score\n", munged);
+			continue;
+		}
+
+		ratio = curr / base;
+		log_sum += log(ratio);
+		/* the overall score is the product of the contributions */
+		contribution = pow(ratio, 1.0 / (double)n);
+		for (i = 0; i < SCORE_CLASSES; i++) {
+			if ((class & STRESS_BIT_UL(i)) && stress_get_class_name(STRESS_BIT_UL(i))) {
+				classes[i].log_sum += log(ratio);
+				classes[i].n++;
+			}
+		}
+
+		pr_inf("%-13s %13.6g %13.6g %9.2f %12.4f\n",
+			munged, base, curr, SCORE_SCALE * ratio, contribution);
+		pr_yaml(yaml, "      - stressor: %s\n", munged);
+		pr_yaml(yaml, "        baseline-bogo-ops-per-second-real-time: %e\n", base);
+		pr_yaml(yaml, "        current-bogo-ops-per-second-real-time: %e\n", curr);
+		pr_yaml(yaml, "        score: %f\n", SCORE_SCALE * ratio);
+		pr_yaml(yaml, "        contribution: %f\n", contribution);
+	}
+
+	pr_inf("%-13s %9s %9s\n", "class", "stressors", "score");
+	pr_yaml(yaml, "    classes:\n");
+	for (i = 0; i < SCORE_CLASSES; i++) {
+		const char *name = stress_get_class_name(STRESS_BIT_UL(i));
+		double score;
+
+		if (!name || !classes[i].n)
+			continue;
+		score = SCORE_SCALE * exp(classes[i].log_sum / (double)classes[i].n);
+		pr_inf("%-13s %9" PRIu32 " %9.2f\n", name, classes[i].n, score);
+		pr_yaml(yaml, "      - class: %s\n", name);
+		pr_yaml(yaml, "        stressors: %" PRIu32 "\n", classes[i].n);
+		pr_yaml(yaml, "        score: %f\n", score);
+	}
+
+	pr_inf("score: %.2f, geometric mean of %" PRIu32 " stressor%s\n",
+		SCORE_SCALE * exp(log_sum / (double)n), n, n == 1 ? "" : "s");
+	pr_yaml(yaml, "    stressors-scored: %" PRIu32 "\n", n);
+	pr_yaml(yaml, "    score: %f\n", SCORE_SCALE * exp(log_sum / (double)n));
+	pr_yaml(yaml, "\n");
+
+	stress_compare_baseline_free(baseline);
+}
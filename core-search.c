@@ -0,0 +1,571 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-phase.h"
+#include "core-search.h"
+
+#define SEARCH_NONE		(0)
+#define SEARCH_INSTANCES	(1)	/* search over number of instances */
+#define SEARCH_RATE		(2)	/* search over --rate bogo ops per second */
+
+#define SEARCH_TRIALS_MAX	(64)
+#define SEARCH_GHZ_SAMPLE	(0.25)	/* seconds between cpu frequency samples */
+#define SEARCH_RATE_SUSTAINED	(0.95)	/* fraction of offered rate to achieve */
+
+typedef struct {
+	const char *name;	/* search mode name */
+	const int mode;		/* search mode id */
+} stress_search_mode_t;
+
+typedef struct {
+	uint64_t value;		/* instances or bogo ops per second */
+	bool pass;		/* trial within the limits */
+	uint64_t p99;		/* 99th percentile latency, nanoseconds */
+	double ghz;		/* average cpu frequency during the trial */
+	uint64_t throttles;	/* thermal throttle events during the trial */
+	double temp;		/* hottest thermal zone, Celsius */
+	double bogo_rate;	/* real time bogo ops per second */
+} stress_search_trial_t;
+
+typedef struct {
+	double ghz_total;	/* sum of sampled average cpu frequencies */
+	uint64_t samples;	/* number of samples */
+} stress_search_ghz_t;
+
+static const stress_search_mode_t search_modes[] = {
+	{ "instances",	SEARCH_INSTANCES },
+	{ "rate",	SEARCH_RATE },
+};
+
+static int search_mode = SEARCH_NONE;
+static stress_stressor_t *search_ss;		/* stressor being searched */
+static uint64_t search_lo;			/* highest passing value */
+static uint64_t search_hi;			/* lowest failing value */
+static uint64_t search_max;			/* largest value to try */
+static uint64_t search_p99;			/* p99 latency limit, nanoseconds */
+static uint32_t search_ghz_drop;		/* cpu frequency drop limit, percent */
+static uint32_t search_temp;			/* temperature limit, Celsius */
+static double search_ghz_ref;			/* reference frequency of first trial */
+static stress_search_trial_t search_trials[SEARCH_TRIALS_MAX];
+static size_t search_trials_num;
+static uint64_t search_throttles;		/* throttle count at trial start */
+static stress_search_ghz_t *search_ghz;		/* shared with the sampler */
+static pid_t search_ghz_pid;
+
+/*
+ *  stress_set_search()
+ *	set what to search over, instances or rate
+ */
+int stress_set_search(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(search_modes); i++) {
+		if (!strcmp(opt, search_modes[i].name)) {
+			int mode = search_modes[i].mode;
+
+			return stress_set_setting_global("search", TYPE_ID_INT, &mode);
+		}
+	}
+	(void)fprintf(stderr, "search must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(search_modes); i++)
+		(void)fprintf(stderr, " %s", search_modes[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_set_search_max()
+ *	set the largest number of instances or rate to search up to
+ */
+int stress_set_search_max(const char *opt)
+{
+	uint64_t max;
+
+	max = stress_get_uint64(opt);
+	stress_check_range("search-max", max, 1, UINT32_MAX);
+	return stress_set_setting_global("search-max", TYPE_ID_UINT64, &max);
+}
+
+/*
+ *  stress_set_search_p99()
+ *	set the 99th percentile latency limit in microseconds
+ */
+int stress_set_search_p99(const char *opt)
+{
+	uint64_t usecs;
+
+	usecs = stress_get_uint64(opt);
+	stress_check_range("search-p99", usecs, 1, 3600000000ULL);
+	g_opt_flags |= OPT_FLAGS_LATENCY_HIST;
+	return stress_set_setting_global("search-p99", TYPE_ID_UINT64, &usecs);
+}
+
+/*
+ *  stress_set_search_ghz_drop()
+ *	set the cpu frequency drop limit in percent
+ */
+int stress_set_search_ghz_drop(const char *opt)
+{
+	uint32_t percent;
+
+	percent = stress_get_uint32(opt);
+	stress_check_range("search-ghz-drop", (uint64_t)percent, 1, 99);
+	return stress_set_setting_global("search-ghz-drop", TYPE_ID_UINT32, &percent);
+}
+
+/*
+ *  stress_set_search_temp()
+ *	set the thermal zone temperature limit in Celsius
+ */
+int stress_set_search_temp(const char *opt)
+{
+	uint32_t temp;
+
+	temp = stress_get_uint32(opt);
+	stress_check_range("search-temp", (uint64_t)temp, 1, 200);
+#if defined(STRESS_THERMAL_ZONES)
+	g_opt_flags |= (OPT_FLAGS_THERMAL_ZONES | OPT_FLAGS_TZ_INFO);
+#endif
+	return stress_set_setting_global("search-temp", TYPE_ID_UINT32, &temp);
+}
+
+/*
+ *  stress_search_enabled()
+ *	return true if a search has been requested
+ */
+bool stress_search_enabled(void)
+{
+	return search_mode != SEARCH_NONE;
+}
+
+/*
+ *  stress_search_throttles()
+ *	total of the thermal throttle event counts of all the cpus
+ */
+static uint64_t stress_search_throttles(void)
+{
+	uint64_t total = 0;
+#if defined(__linux__)
+	static const char * const counts[] = {
+		"core_throttle_count",
+		"package_throttle_count",
+	};
+	const int32_t cpus = stress_get_processors_configured();
+	int32_t cpu;
+
+	for (cpu = 0; cpu < cpus; cpu++) {
+		size_t i;
+
+		for (i = 0; i < SIZEOF_ARRAY(counts); i++) {
+			char path[PATH_MAX], buf[32];
+			uint64_t count;
+
+			(void)snprintf(path, sizeof(path),
+				"/sys/devices/system/cpu/cpu%" PRId32 "/thermal_throttle/%s",
+				cpu, counts[i]);
+			if ((system_read(path, buf, sizeof(buf)) > 0) &&
+			    (sscanf(buf, "%" SCNu64, &count) == 1))
+				total += count;
+		}
+	}
+#endif
+	return total;
+}
+
+/*
+ *  stress_search_setup()
+ *	check the search options and size the stressor for
+ *	the largest number of instances that will be tried
+ */
+int stress_search_setup(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t n = 0;
+
+	search_mode = SEARCH_NONE;
+	(void)stress_get_setting("search", &search_mode);
+	if (search_mode == SEARCH_NONE)
+		return 0;
+
+	(void)stress_get_setting("search-max", &search_max);
+	(void)stress_get_setting("search-p99", &search_p99);
+	(void)stress_get_setting("search-ghz-drop", &search_ghz_drop);
+	(void)stress_get_setting("search-temp", &search_temp);
+	search_p99 *= 1000;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		if (ss->num_instances > 0) {
+			search_ss = ss;
+			n++;
+		}
+	}
+	if (n != 1) {
+		pr_err("search: --search requires just one stressor\n");
+		return -1;
+	}
+	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+		pr_err("search: --search cannot be used with --sequential\n");
+		return -1;
+	}
+	if (stress_phase_count()) {
+		pr_err("search: --search cannot be used with job file phases\n");
+		return -1;
+	}
+	if (!search_p99 && !search_ghz_drop && !search_temp) {
+		pr_err("search: --search requires a --search-p99, --search-ghz-drop "
+			"or --search-temp limit\n");
+		return -1;
+	}
+	if (search_mode == SEARCH_RATE) {
+		if (!search_max) {
+			pr_err("search: --search rate requires --search-max\n");
+			return -1;
+		}
+	} else {
+		if (!search_max)
+			search_max = (uint64_t)stress_get_processors_configured();
+		search_ss->num_instances = (int32_t)search_max;
+	}
+	search_lo = 0;
+	search_hi = search_max + 1;
+	search_trials_num = 0;
+	search_ghz_ref = 0.0;
+	return 0;
+}
+
+/*
+ *  stress_search_ghz_start()
+ *	fork a process that samples the average cpu
+ *	frequency while the stressors are running
+ */
+static void stress_search_ghz_start(void)
+{
+	search_ghz_pid = -1;
+	if (!search_ghz_drop)
+		return;
+
+	if (!search_ghz) {
+		search_ghz = (stress_search_ghz_t *)mmap(NULL, sizeof(*search_ghz),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+		if (search_ghz == MAP_FAILED) {
+			search_ghz = NULL;
+			return;
+		}
+	}
+	search_ghz->ghz_total = 0.0;
+	search_ghz->samples = 0;
+
+	search_ghz_pid = fork();
+	if (search_ghz_pid != 0)
+		return;
+
+	stress_set_proc_name("stat [search]");
+	for (;;) {
+		double avg_ghz, min_ghz, max_ghz;
+
+		(void)shim_nanosleep_uint64((uint64_t)(SEARCH_GHZ_SAMPLE * STRESS_DBL_NANOSECOND));
+		stress_get_cpu_ghz(&avg_ghz, &min_ghz, &max_ghz);
+		if (avg_ghz > 0.0) {
+			search_ghz->ghz_total += avg_ghz;
+			search_ghz->samples++;
+		}
+	}
+}
+
+/*
+ *  stress_search_ghz_stop()
+ *	stop the cpu frequency sampler, returns the
+ *	average cpu frequency or 0.0 if it is unknown
+ */
+static double stress_search_ghz_stop(void)
+{
+	int status;
+
+	if (search_ghz_pid <= 0)
+		return 0.0;
+	(void)kill(search_ghz_pid, SIGKILL);
+	(void)shim_waitpid(search_ghz_pid, &status, 0);
+	search_ghz_pid = -1;
+
+	return search_ghz->samples ?
+		search_ghz->ghz_total / (double)search_ghz->samples : 0.0;
+}
+
+/*
+ *  stress_search_value_str()
+ *	describe a search value
+ */
+static const char *stress_search_value_str(const uint64_t value)
+{
+	static char buf[64];
+
+	(void)snprintf(buf, sizeof(buf), "%" PRIu64 " %s", value,
+		search_mode == SEARCH_RATE ? "bogo ops/s" :
+		(value == 1 ? "instance" : "instances"));
+	return buf;
+}
+
+/*
+ *  stress_search_begin()
+ *	set up the next trial, the first trial runs at the lowest
+ *	load as a reference, then a binary search narrows down the
+ *	highest load that is within the limits. Returns false when
+ *	the search is complete.
+ */
+bool stress_search_begin(stress_stressor_t *stressors_list)
+{
+	uint64_t value;
+
+	(void)stressors_list;
+
+	if (search_trials_num >= SEARCH_TRIALS_MAX)
+		return false;
+	if (search_trials_num == 0) {
+		value = 1;
+	} else {
+		/* no load is sustainable or the range has been narrowed down */
+		if (search_lo == 0)
+			return false;
+		if (search_mode == SEARCH_RATE) {
+			if ((search_hi - search_lo) <= STRESS_MAXIMUM(1, search_hi / 100))
+				return false;
+		} else if (search_hi - search_lo <= 1) {
+			return false;
+		}
+		value = search_lo + (search_hi - search_lo) / 2;
+	}
+
+	search_trials[search_trials_num].value = value;
+	if (search_mode == SEARCH_RATE)
+		search_ss->ops_rate = (double)value;
+	else
+		search_ss->num_instances = (int32_t)value;
+
+	pr_inf("search: trial %zu, %s\n", search_trials_num + 1, stress_search_value_str(value));
+	search_throttles = stress_search_throttles();
+	stress_search_ghz_start();
+	return true;
+}
+
+/*
+ *  stress_search_p99_get()
+ *	99th percentile latency over all the instances, 0 if no samples
+ */
+static uint64_t stress_search_p99_get(const stress_stressor_t *ss)
+{
+	stress_latency_t *latency;
+	uint64_t p99;
+	int32_t j;
+
+	latency = malloc(sizeof(*latency));
+	if (!latency)
+		return 0;
+	stress_latency_reset(latency);
+	for (j = 0; j < ss->started_instances; j++) {
+		if (ss->stats[j]->latency)
+			stress_latency_merge(latency, ss->stats[j]->latency);
+	}
+	p99 = stress_latency_percentile(latency, 99.0);
+	free(latency);
+	return p99;
+}
+
+/*
+ *  stress_search_temp_get()
+ *	hottest thermal zone temperature seen by the instances in Celsius
+ */
+static double stress_search_temp_get(const stress_stressor_t *ss)
+{
+	double temp = 0.0;
+#if defined(STRESS_THERMAL_ZONES)
+	int32_t j;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_tz_t *tz = ss->stats[j]->tz;
+		size_t i;
+
+		if (!tz)
+			continue;
+		for (i = 0; i < STRESS_THERMAL_ZONES_MAX; i++) {
+			const double t = (double)tz->tz_stat[i].temperature / 1000.0;
+
+			if (t > temp)
+				temp = t;
+		}
+	}
+#else
+	(void)ss;
+#endif
+	return temp;
+}
+
+/*
+ *  stress_search_end()
+ *	check the trial that has just completed against the limits
+ *	and narrow down the range being searched
+ */
+void stress_search_end(stress_stressor_t *stressors_list, const double duration)
+{
+	stress_search_trial_t *trial = &search_trials[search_trials_num];
+	double r_time;
+	char reason[128];
+
+	(void)stressors_list;
+	(void)duration;
+
+	trial->ghz = stress_search_ghz_stop();
+	trial->throttles = stress_search_throttles() - search_throttles;
+	trial->p99 = stress_search_p99_get(search_ss);
+	trial->temp = stress_search_temp_get(search_ss);
+	trial->bogo_rate = stress_bogo_rate_real_time(search_ss, &r_time);
+	trial->pass = true;
+	*reason = '\0';
+
+	if (search_p99) {
+		if (!trial->p99) {
+			pr_inf("search: %s does not record latencies, ignoring --search-p99\n",
+				search_ss->stressor->name);
+			search_p99 = 0;
+		} else if (trial->p99 > search_p99) {
+			trial->pass = false;
+			(void)shim_strlcpy(reason, ", p99 latency over limit", sizeof(reason));
+		}
+	}
+	if (search_ghz_drop) {
+		if (search_trials_num == 0) {
+			search_ghz_ref = trial->ghz;
+			if (search_ghz_ref <= 0.0)
+				pr_inf("search: cpu frequency not available, only checking "
+					"for thermal throttling\n");
+		}
+		if (trial->throttles) {
+			trial->pass = false;
+			(void)shim_strlcat(reason, ", thermal throttling", sizeof(reason));
+		} else if ((search_ghz_ref > 0.0) &&
+			   (trial->ghz < search_ghz_ref * (100.0 - (double)search_ghz_drop) / 100.0)) {
+			trial->pass = false;
+			(void)shim_strlcat(reason, ", cpu frequency dropped", sizeof(reason));
+		}
+	}
+	/* a rate that cannot be sustained is past the knee */
+	if ((search_mode == SEARCH_RATE) &&
+	    (trial->bogo_rate < (double)trial->value * SEARCH_RATE_SUSTAINED)) {
+		trial->pass = false;
+		(void)shim_strlcat(reason, ", offered rate not sustained", sizeof(reason));
+	}
+	if (search_temp && (trial->temp > (double)search_temp)) {
+		trial->pass = false;
+		(void)shim_strlcat(reason, ", temperature over limit", sizeof(reason));
+	}
+
+	pr_inf("search: trial %zu, %s: p99 %.2f us, %.2f GHz, %" PRIu64
+		" throttles, %.1f C, %.2f bogo ops/s, %s%s\n",
+		search_trials_num + 1, stress_search_value_str(trial->value),
+		(double)trial->p99 / 1000.0, trial->ghz, trial->throttles,
+		trial->temp, trial->bogo_rate, trial->pass ? "pass" : "fail", reason);
+
+	if (trial->pass)
+		search_lo = trial->value;
+	else
+		search_hi = trial->value;
+	search_trials_num++;
+}
+
+/*
+ *  stress_search_finish()
+ *	restore the stressor to the largest number of instances
+ */
+void stress_search_finish(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+
+	if (search_mode == SEARCH_INSTANCES)
+		search_ss->num_instances = (int32_t)search_max;
+}
+
+/*
+ *  stress_search_dump()
+ *	report the knee point, the highest load within the limits
+ */
+void stress_search_dump(FILE *yaml)
+{
+	size_t i;
+	const char *mode = (search_mode == SEARCH_RATE) ? "rate" : "instances";
+
+	if (!search_trials_num)
+		return;
+
+	if (search_lo == 0) {
+		pr_inf("search: no %s was within the limits, even the lowest load failed\n", mode);
+	} else if (search_hi > search_max) {
+		pr_inf("search: all trials were within the limits, the knee is above %s\n",
+			stress_search_value_str(search_max));
+	} else {
+		char lo[64];
+
+		(void)shim_strlcpy(lo, stress_search_value_str(search_lo), sizeof(lo));
+		pr_inf("search: knee point at %s, first failure at %s\n",
+			lo, stress_search_value_str(search_hi));
+	}
+
+	pr_yaml(yaml, "search:\n");
+	pr_yaml(yaml, "      stressor: %s\n", stress_munge_underscore(search_ss->stressor->name));
+	pr_yaml(yaml, "      mode: %s\n", mode);
+	pr_yaml(yaml, "      knee: %" PRIu64 "\n", search_lo);
+	pr_yaml(yaml, "      first-fail: %" PRIu64 "\n", search_hi > search_max ? 0 : search_hi);
+	if (search_p99)
+		pr_yaml(yaml, "      p99-limit-nsec: %" PRIu64 "\n", search_p99);
+	if (search_ghz_drop)
+		pr_yaml(yaml, "      ghz-drop-limit-percent: %" PRIu32 "\n", search_ghz_drop);
+	if (search_temp)
+		pr_yaml(yaml, "      temp-limit-celsius: %" PRIu32 "\n", search_temp);
+	pr_yaml(yaml, "      trials:\n");
+	for (i = 0; i < search_trials_num; i++) {
+		const stress_search_trial_t *trial = &search_trials[i];
+
+		pr_yaml(yaml, "        - %s: %" PRIu64 "\n", mode, trial->value);
+		pr_yaml(yaml, "          pass: %s\n", trial->pass ? "true" : "false");
+		pr_yaml(yaml, "          bogo-ops-per-second-real-time: %f\n", trial->bogo_rate);
+		if (search_p99)
+			pr_yaml(yaml, "          p99-nsec: %" PRIu64 "\n", trial->p99);
+		if (search_ghz_drop) {
+			pr_yaml(yaml, "          cpu-ghz: %f\n", trial->ghz);
+			pr_yaml(yaml, "          thermal-throttles: %" PRIu64 "\n", trial->throttles);
+		}
+		if (search_temp)
+			pr_yaml(yaml, "          temp-celsius: %f\n", trial->temp);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_search_free()
+ *	free the cpu frequency sampler data
+ */
+void stress_search_free(void)
+{
+	if (search_ghz)
+		(void)munmap((void *)search_ghz, sizeof(*search_ghz));
+	search_ghz = NULL;
+	search_mode = SEARCH_NONE;
+	search_trials_num = 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_SEARCH_H
+#define CORE_SEARCH_H
+
+/* closed loop search for the maximum sustainable load */
+extern int stress_set_search(const char *opt);
+extern int stress_set_search_max(const char *opt);
+extern int stress_set_search_p99(const char *opt);
+extern int stress_set_search_ghz_drop(const char *opt);
+extern int stress_set_search_temp(const char *opt);
+extern bool stress_search_enabled(void);
+extern int stress_search_setup(stress_stressor_t *stressors_list);
+extern bool stress_search_begin(stress_stressor_t *stressors_list);
+extern void stress_search_end(stress_stressor_t *stressors_list, const double duration);
+extern void stress_search_finish(stress_stressor_t *stressors_list);
+extern void stress_search_dump(FILE *yaml);
+extern void stress_search_free(void);
+
+#endif
@@ -18,9 +18,28 @@
  *
  */
 #include "stress-ng.h"
+#include "core-hash.h"
+
+#define SETTING_HASH_SIZE	(1021)	/* prime, setting name hash buckets */
+#define SETTING_PROC_HASH_SIZE	(251)	/* prime, stressor hash buckets */
+
+/* index of the first setting made by a stressor */
+typedef struct stress_setting_proc {
+	struct stress_setting_proc *next;	/* next in hash bucket */
+	const struct stress_stressor_info *proc;/* stressor */
+	uint32_t index;				/* index of its first setting */
+} stress_setting_proc_t;
 
 static stress_setting_t *setting_head;	/* setting list head */
 static stress_setting_t *setting_tail;	/* setting list tail */
+static uint32_t setting_index;		/* number of settings made */
+
+/*
+ *  settings hashed by name, each bucket is ordered newest first so
+ *  a lookup only visits the settings that share the name hash
+ */
+static stress_setting_t *setting_hash[SETTING_HASH_SIZE];
+static stress_setting_proc_t *setting_proc_hash[SETTING_PROC_HASH_SIZE];
 
 #if defined(DEBUG_SETTINGS)
 #define	DBG(...)	pr_inf(__VA_ARGS__)
@@ -35,6 +54,7 @@ static stress_setting_t *setting_tail;	/* setting list tail */
 void stress_settings_free(void)
 {
 	stress_setting_t *setting = setting_head;
+	size_t i;
 
 	while (setting) {
 		stress_setting_t *next = setting->next;
@@ -47,6 +67,45 @@ void stress_settings_free(void)
 	}
 	setting_head = NULL;
 	setting_tail = NULL;
+	setting_index = 0;
+	(void)memset(setting_hash, 0, sizeof(setting_hash));
+
+	for (i = 0; i < SETTING_PROC_HASH_SIZE; i++) {
+		stress_setting_proc_t *sp = setting_proc_hash[i];
+
+		while (sp) {
+			stress_setting_proc_t *next = sp->next;
+
+			free(sp);
+			sp = next;
+		}
+		setting_proc_hash[i] = NULL;
+	}
+}
+
+/*
+ *  stress_setting_proc_hash()
+ *	hash a stressor pointer into the stressor hash table
+ */
+static inline size_t stress_setting_proc_hash(const struct stress_stressor_info *proc)
+{
+	return (size_t)(((uintptr_t)proc >> 4) % SETTING_PROC_HASH_SIZE);
+}
+
+/*
+ *  stress_setting_proc_first()
+ *	index of the first setting made by stressor proc,
+ *	UINT32_MAX if it has not made any settings
+ */
+static uint32_t stress_setting_proc_first(const struct stress_stressor_info *proc)
+{
+	const stress_setting_proc_t *sp;
+
+	for (sp = setting_proc_hash[stress_setting_proc_hash(proc)]; sp; sp = sp->next) {
+		if (sp->proc == proc)
+			return sp->index;
+	}
+	return UINT32_MAX;
 }
 
 
@@ -61,6 +120,7 @@ static int stress_set_setting_generic(
 	const bool global)
 {
 	stress_setting_t *setting;
+	size_t h;
 
 	if (!value) {
 		(void)fprintf(stderr, "invalid setting '%s' value address (null)\n", name);
@@ -165,6 +225,25 @@ static int stress_set_setting_generic(
 		break;
 	}
 
+	if (stress_setting_proc_first(setting->proc) == UINT32_MAX) {
+		stress_setting_proc_t *sp;
+		const size_t h = stress_setting_proc_hash(setting->proc);
+
+		sp = calloc(1, sizeof(*sp));
+		if (!sp) {
+			if (type_id == TYPE_ID_STR)
+				free(setting->u.str);
+			free(setting->name);
+			free(setting);
+			goto err;
+		}
+		sp->proc = setting->proc;
+		sp->index = setting_index;
+		sp->next = setting_proc_hash[h];
+		setting_proc_hash[h] = sp;
+	}
+	setting->index = setting_index++;
+
 	if (setting_tail) {
 		setting_tail->next = setting;
 	} else {
@@ -172,6 +251,10 @@ static int stress_set_setting_generic(
 	}
 	setting_tail = setting;
 
+	h = stress_hash_fnv1a(name) % SETTING_HASH_SIZE;
+	setting->hash_next = setting_hash[h];
+	setting_hash[h] = setting;
+
 	return 0;
 err:
 	(void)fprintf(stderr, "cannot allocate setting '%s'\n", name);
@@ -203,24 +286,55 @@ int stress_set_setting_global(
 	return stress_set_setting_generic(name, type_id, value, true);
 }
 
+/*
+ *  stress_set_setting_default()
+ *	set a new global setting if name has not been set,
+ *	returns 1 if it was already set
+ */
+int stress_set_setting_default(
+	const char *name,
+	const stress_type_id_t type_id,
+	const void *value)
+{
+	const stress_setting_t *setting;
+
+	for (setting = setting_hash[stress_hash_fnv1a(name) % SETTING_HASH_SIZE];
+	     setting; setting = setting->hash_next) {
+		if (!strcmp(setting->name, name))
+			return 1;
+	}
+	return stress_set_setting_generic(name, type_id, value, true);
+}
 
 /*
  *  stress_get_setting()
- *	get an existing setting
+ *	get an existing setting, the most recent one visible to the
+ *	current stressor. Global settings and the current stressor's
+ *	own settings are always visible. Local settings of other
+ *	stressors are only visible if they were made before the first
+ *	setting of the current stressor (or if it has made none), so
+ *	two stressors setting the same name each see their own value.
+ *	This is the same rule as the original ordered list walk.
  */
 bool stress_get_setting(const char *name, void *value)
 {
-	stress_setting_t *setting;
+	const stress_setting_t *setting;
+	const uint32_t first = stress_setting_proc_first(g_stressor_current);
 	bool set = false;
-	bool found = false;
 
 	DBG("%s: get %s\n", __func__, name);
 
-	for (setting = setting_head; setting; setting = setting->next) {
-		if (setting->proc == g_stressor_current)
-			found = true;
-		if (found && ((setting->proc != g_stressor_current) && (!setting->global)))
-			break;
+	/* newest first, so the first match is the most recent setting */
+	for (setting = setting_hash[stress_hash_fnv1a(name) % SETTING_HASH_SIZE];
+	     setting && !set; setting = setting->hash_next) {
+		/*
+		 *  skip local settings of other stressors made after the first
+		 *  setting of this stressor, keep walking as older settings,
+		 *  ours and global ones, still apply
+		 */
+		if ((setting->index > first) &&
+		    (setting->proc != g_stressor_current) && (!setting->global))
+			continue;
 
 		if (!strcmp(setting->name, name)) {
 			switch (setting->type_id) {
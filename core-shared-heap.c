@@ -37,11 +37,47 @@ enum {
         STRESS_MAX
 };
 
+/*
+ *  General purpose shared allocations, the heap is mmap'd shared
+ *  memory that is lazily populated on first touch, so this costs
+ *  little unless it is used
+ */
+#define STRESS_SHARED_HEAP_ALLOC_SIZE		(1 * MB)
+
+#define STRESS_SHARED_HEAP_MIN_BLOCK		(16)
+#define STRESS_SHARED_HEAP_MAX_BLOCK		(STRESS_SHARED_HEAP_MIN_BLOCK << (STRESS_SHARED_HEAP_CLASSES - 1))
+#define STRESS_SHARED_HEAP_ALIGN		(16)
+#define STRESS_SHARED_HEAP_CACHE_MAX		(16)	/* per process cached blocks per class */
+#define STRESS_SHARED_HEAP_BATCH_BYTES		(4096)	/* bytes moved to/from a cache per refill */
+
 typedef struct stress_shared_heap_str {
 	struct stress_shared_heap_str	*next;
 	char str[];
 } stress_shared_heap_str_t;
 
+/*
+ *  Every allocation is prefixed with a block header, the next
+ *  field is only used when the block is on a free list
+ */
+typedef struct stress_shared_heap_block {
+	struct stress_shared_heap_block *next;	/* next free block */
+	size_t size;				/* usable size of block */
+} ALIGNED(STRESS_SHARED_HEAP_ALIGN) stress_shared_heap_block_t;
+
+/*
+ *  Per process cache of free blocks, allocations and frees hit
+ *  this first so the heap lock is only taken to move a batch of
+ *  blocks to or from the shared free lists. The pid detects a
+ *  cache inherited over fork() that belongs to the parent.
+ */
+typedef struct {
+	pid_t pid;
+	stress_shared_heap_block_t *head[STRESS_SHARED_HEAP_CLASSES];
+	size_t count[STRESS_SHARED_HEAP_CLASSES];
+} stress_shared_heap_cache_t;
+
+static stress_shared_heap_cache_t heap_cache;
+
 void *stress_shared_heap_init(void)
 {
 	const size_t page_size = stress_get_page_size();
@@ -49,13 +85,14 @@ void *stress_shared_heap_init(void)
 	/* Allocate enough heap for all stressor descriptions with 50% metrics allocated */
 	size_t size = (STRESS_MISC_METRICS_MAX * (32 + sizeof(void *)) * STRESS_MAX) / 2;
 
-	size = STRESS_MINIMUM(size, STRESS_MAX_SHARED_HEAP_SIZE);
-	g_shared->shared_heap.out_of_memory = false;
+	size = STRESS_MINIMUM(size, STRESS_MAX_SHARED_HEAP_SIZE) + STRESS_SHARED_HEAP_ALLOC_SIZE;
+	(void)memset(&g_shared->shared_heap, 0, sizeof(g_shared->shared_heap));
+	(void)memset(&heap_cache, 0, sizeof(heap_cache));
 	g_shared->shared_heap.heap_size = (size + page_size - 1) & ~(page_size - 1);
-	g_shared->shared_heap.str_list_head = NULL;
-	g_shared->shared_heap.heap = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	g_shared->shared_heap.heap = mmap(NULL, g_shared->shared_heap.heap_size, PROT_READ | PROT_WRITE,
 					  MAP_ANONYMOUS | MAP_SHARED, -1, 0);
 	if (g_shared->shared_heap.heap == MAP_FAILED) {
+		g_shared->shared_heap.heap = NULL;
 		g_shared->shared_heap.lock = NULL;
 		return NULL;
 	}
@@ -81,37 +118,240 @@ void stress_shared_heap_deinit(void)
 		g_shared->shared_heap.heap = NULL;
 	}
 	if (g_shared->shared_heap.lock) {
+		stress_lock_report(g_shared->shared_heap.lock, "shared heap");
 		(void)stress_lock_destroy(g_shared->shared_heap.lock);
 		g_shared->shared_heap.lock = NULL;
 	}
 	g_shared->shared_heap.out_of_memory = false;
 }
 
+/*
+ *  stress_shared_heap_class()
+ *	size class of an allocation, -1 if it is too large
+ *	for the size classes
+ */
+static int stress_shared_heap_class(const size_t size)
+{
+	int i;
+	size_t block = STRESS_SHARED_HEAP_MIN_BLOCK;
+
+	for (i = 0; i < STRESS_SHARED_HEAP_CLASSES; i++, block <<= 1) {
+		if (size <= block)
+			return i;
+	}
+	return -1;
+}
+
+/*
+ *  stress_shared_heap_carve()
+ *	carve a new block from the unused end of the heap,
+ *	heap lock must be held
+ */
+static stress_shared_heap_block_t *stress_shared_heap_carve(const size_t size)
+{
+	const size_t len = sizeof(stress_shared_heap_block_t) + size;
+	stress_shared_heap_block_t *block;
+
+	if (g_shared->shared_heap.heap_size - g_shared->shared_heap.offset < len)
+		return NULL;
+	block = (stress_shared_heap_block_t *)((uintptr_t)g_shared->shared_heap.heap + g_shared->shared_heap.offset);
+	block->next = NULL;
+	block->size = size;
+	g_shared->shared_heap.offset += len;
+	return block;
+}
+
+/*
+ *  stress_shared_heap_cache_check()
+ *	drop a cache inherited from the parent, the parent
+ *	still owns those blocks
+ */
+static inline void stress_shared_heap_cache_check(void)
+{
+	const pid_t pid = getpid();
+
+	if (UNLIKELY(heap_cache.pid != pid)) {
+		(void)memset(&heap_cache, 0, sizeof(heap_cache));
+		heap_cache.pid = pid;
+	}
+}
+
+/*
+ *  stress_shared_heap_refill()
+ *	move a batch of blocks of size class cls into the
+ *	per process cache from the shared free list, or if that
+ *	is empty from the unused end of the heap, flags the heap
+ *	as out of memory if no block at all could be found
+ */
+static void stress_shared_heap_refill(const int cls)
+{
+	const size_t size = (size_t)STRESS_SHARED_HEAP_MIN_BLOCK << cls;
+	const size_t batch = STRESS_MAXIMUM(1, STRESS_SHARED_HEAP_BATCH_BYTES / size);
+	stress_shared_heap_block_t **free_list =
+		(stress_shared_heap_block_t **)&g_shared->shared_heap.free_list[cls];
+	size_t n;
+
+	if (stress_lock_acquire(g_shared->shared_heap.lock) < 0)
+		return;
+	for (n = 0; n < batch; n++) {
+		stress_shared_heap_block_t *block = *free_list;
+
+		if (block) {
+			*free_list = block->next;
+		} else {
+			block = stress_shared_heap_carve(size);
+			if (!block) {
+				if (n == 0)
+					g_shared->shared_heap.out_of_memory = true;
+				break;
+			}
+		}
+		block->next = heap_cache.head[cls];
+		heap_cache.head[cls] = block;
+		heap_cache.count[cls]++;
+	}
+	(void)stress_lock_release(g_shared->shared_heap.lock);
+}
+
+/*
+ *  stress_shared_heap_drain()
+ *	return all but keep blocks of size class cls from the
+ *	per process cache to the shared free list
+ */
+static void stress_shared_heap_drain(const int cls, const size_t keep)
+{
+	stress_shared_heap_block_t **free_list =
+		(stress_shared_heap_block_t **)&g_shared->shared_heap.free_list[cls];
+
+	if (stress_lock_acquire(g_shared->shared_heap.lock) < 0)
+		return;
+	while (heap_cache.count[cls] > keep) {
+		stress_shared_heap_block_t *block = heap_cache.head[cls];
+
+		heap_cache.head[cls] = block->next;
+		heap_cache.count[cls]--;
+		block->next = *free_list;
+		*free_list = block;
+	}
+	(void)stress_lock_release(g_shared->shared_heap.lock);
+}
+
+/*
+ *  stress_shared_heap_malloc_large()
+ *	allocate a block larger than the size classes, these
+ *	are expected to be rare so a first fit search of the large
+ *	free list under the heap lock is good enough
+ */
+static void *stress_shared_heap_malloc_large(const size_t size)
+{
+	stress_shared_heap_block_t **prev, *block;
+
+	if (stress_lock_acquire(g_shared->shared_heap.lock) < 0)
+		return NULL;
+	prev = (stress_shared_heap_block_t **)&g_shared->shared_heap.large_list;
+	for (block = *prev; block; prev = &block->next, block = block->next) {
+		if (block->size >= size) {
+			*prev = block->next;
+			break;
+		}
+	}
+	if (!block)
+		block = stress_shared_heap_carve(size);
+	if (!block)
+		g_shared->shared_heap.out_of_memory = true;
+	(void)stress_lock_release(g_shared->shared_heap.lock);
+
+	return block ? (void *)(block + 1) : NULL;
+}
+
 /*
  *  stress_shared_heap_malloc()
- *	Primitive non-free'ing heap allocator. Just return next allocated chunk from
- *	the shared memory heap. We don't use need a per-object free'ing, so no need
- *	to keep track of holes or do hole coalescing. Keep it simple for now.
+ *	Allocate from the shared memory heap. The heap is mmap'd before the
+ *	stressors are forked so allocations are visible to all stress-ng
+ *	processes at the same address. Small allocations are rounded up to
+ *	a power of 2 size class and served from a per process cache of free
+ *	blocks, larger ones come from a first fit list of large blocks.
  */
 void *stress_shared_heap_malloc(const size_t size)
 {
-	ssize_t heap_free;
-	void *ptr;
+	const size_t aligned = (STRESS_MAXIMUM(size, 1) + STRESS_SHARED_HEAP_ALIGN - 1) & ~(size_t)(STRESS_SHARED_HEAP_ALIGN - 1);
+	const int cls = stress_shared_heap_class(aligned);
+	stress_shared_heap_block_t *block;
 
-	if (stress_lock_acquire(g_shared->shared_heap.lock) < 0)
+	if (UNLIKELY(!g_shared->shared_heap.heap))
 		return NULL;
+	if (cls < 0)
+		return stress_shared_heap_malloc_large(aligned);
 
-	heap_free = g_shared->shared_heap.heap_size - g_shared->shared_heap.offset;
-	if (heap_free < (ssize_t)size) {
-		g_shared->shared_heap.out_of_memory = true;
+	stress_shared_heap_cache_check();
+	if (!heap_cache.head[cls]) {
+		stress_shared_heap_refill(cls);
+		if (!heap_cache.head[cls])
+			return NULL;
+	}
+	block = heap_cache.head[cls];
+	heap_cache.head[cls] = block->next;
+	heap_cache.count[cls]--;
+	block->next = NULL;
+
+	return (void *)(block + 1);
+}
+
+/*
+ *  stress_shared_heap_free()
+ *	free a block allocated by stress_shared_heap_malloc(), small
+ *	blocks go back to the per process cache and spill over to the
+ *	shared free list when the cache is full
+ */
+void stress_shared_heap_free(void *ptr)
+{
+	stress_shared_heap_block_t *block;
+	int cls;
+
+	if (!ptr)
+		return;
+	if (((uintptr_t)ptr <= (uintptr_t)g_shared->shared_heap.heap) ||
+	    ((uintptr_t)ptr >= (uintptr_t)g_shared->shared_heap.heap + g_shared->shared_heap.heap_size)) {
+		pr_dbg("shared heap: attempt to free %p that is not on the heap\n", ptr);
+		return;
+	}
+
+	block = (stress_shared_heap_block_t *)ptr - 1;
+	cls = (block->size <= STRESS_SHARED_HEAP_MAX_BLOCK) ?
+		stress_shared_heap_class(block->size) : -1;
+	if (cls < 0) {
+		if (stress_lock_acquire(g_shared->shared_heap.lock) < 0)
+			return;
+		block->next = (stress_shared_heap_block_t *)g_shared->shared_heap.large_list;
+		g_shared->shared_heap.large_list = (void *)block;
 		(void)stress_lock_release(g_shared->shared_heap.lock);
-		return NULL;
+		return;
 	}
-	ptr = (void *)((uintptr_t)g_shared->shared_heap.heap + g_shared->shared_heap.offset);
-	g_shared->shared_heap.offset += (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
-	(void)stress_lock_release(g_shared->shared_heap.lock);
 
-	return ptr;
+	stress_shared_heap_cache_check();
+	block->next = heap_cache.head[cls];
+	heap_cache.head[cls] = block;
+	heap_cache.count[cls]++;
+	if (heap_cache.count[cls] > STRESS_SHARED_HEAP_CACHE_MAX)
+		stress_shared_heap_drain(cls, STRESS_SHARED_HEAP_CACHE_MAX / 2);
+}
+
+/*
+ *  stress_shared_heap_flush()
+ *	return all the blocks in the per process cache to the
+ *	shared free lists, called before a process exits so its
+ *	cached blocks can be reused by other processes
+ */
+void stress_shared_heap_flush(void)
+{
+	int cls;
+
+	if (!g_shared->shared_heap.heap || (heap_cache.pid != getpid()))
+		return;
+	for (cls = 0; cls < STRESS_SHARED_HEAP_CLASSES; cls++) {
+		if (heap_cache.count[cls])
+			stress_shared_heap_drain(cls, 0);
+	}
 }
 
 /*
@@ -125,7 +365,7 @@ void *stress_shared_heap_malloc(const size_t size)
 char *stress_shared_heap_dup_const(const char *str)
 {
 	size_t len;
-	stress_shared_heap_str_t *heap_str;
+	stress_shared_heap_str_t *heap_str, *tmp;
 
 	if (stress_lock_acquire(g_shared->shared_heap.lock) < 0)
 		return NULL;
@@ -152,6 +392,18 @@ char *stress_shared_heap_dup_const(const char *str)
 	if (stress_lock_acquire(g_shared->shared_heap.lock) < 0)
 		return heap_str->str;
 
+	/*
+	 *  Another process may have added the same string while the
+	 *  lock was dropped, use that and free our copy
+	 */
+	for (tmp = (stress_shared_heap_str_t *)g_shared->shared_heap.str_list_head; tmp; tmp = tmp->next) {
+		if (strcmp(str, tmp->str) == 0) {
+			(void)stress_lock_release(g_shared->shared_heap.lock);
+			stress_shared_heap_free(heap_str);
+			return tmp->str;
+		}
+	}
+
 	/*
 	 *  Save a copy so it can be re-used
 	 */
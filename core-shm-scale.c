@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-shm-scale.h"
+
+#define SHM_SCALE_SWEEP_MAX	(10)		/* 1, 2, 4 .. 256 and the maximum */
+#define SHM_SCALE_BACKINGS_MAX	(4)
+
+/* per process results */
+typedef struct {
+	volatile bool forked;		/* process is waiting to attach */
+	volatile bool ready;		/* process attached and touched all pages */
+	int err;			/* errno of a failed attach */
+	double attach;			/* seconds to attach the segment */
+	double touch;			/* seconds to read fault every page */
+	uint64_t faults;		/* minor faults when touching */
+	uint64_t pte_kb;		/* growth of the process VmPTE, kB */
+} stress_shm_scale_result_t;
+
+/* state shared with the attaching processes */
+typedef struct {
+	volatile bool start;		/* processes attach */
+	volatile bool release;		/* processes detach and exit */
+	stress_shm_scale_result_t results[MAX_SHM_SCALE_PROCS];
+} stress_shm_scale_shared_t;
+
+/* accumulated results for a process count */
+typedef struct {
+	uint32_t procs;			/* number of processes */
+	double proc_phases;		/* number of process phases */
+	double attach;			/* sum of attach times */
+	double touch;			/* sum of touch times */
+	double faults;			/* sum of minor faults */
+	double pte_kb;			/* sum of process page table growth, kB */
+	double pt_kb;			/* sum of system PageTables growth, kB */
+} stress_shm_scale_stats_t;
+
+/*
+ *  stress_shm_scale_page_tables()
+ *	return the PageTables size in kB from /proc/meminfo, 0 if unknown
+ */
+static uint64_t stress_shm_scale_page_tables(void)
+{
+	FILE *fp;
+	char buffer[256];
+	uint64_t kb = 0;
+
+	fp = fopen("/proc/meminfo", "r");
+	if (!fp)
+		return 0;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		if (sscanf(buffer, "PageTables: %" SCNu64, &kb) == 1)
+			break;
+	}
+	(void)fclose(fp);
+
+	return kb;
+}
+
+/*
+ *  stress_shm_scale_vmpte()
+ *	return the page table size of the calling process in kB
+ *	from /proc/self/status, this is exact whereas the system
+ *	wide PageTables count is updated lazily from per cpu counters
+ */
+static uint64_t stress_shm_scale_vmpte(void)
+{
+	FILE *fp;
+	char buffer[256];
+	uint64_t kb = 0;
+
+	fp = fopen("/proc/self/status", "r");
+	if (!fp)
+		return 0;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		if (sscanf(buffer, "VmPTE: %" SCNu64, &kb) == 1)
+			break;
+	}
+	(void)fclose(fp);
+
+	return kb;
+}
+
+/*
+ *  stress_shm_scale_minflt()
+ *	minor page faults of the calling process
+ */
+static uint64_t stress_shm_scale_minflt(void)
+{
+	struct rusage usage;
+
+	(void)memset(&usage, 0, sizeof(usage));
+	(void)getrusage(RUSAGE_SELF, &usage);
+
+	return (uint64_t)usage.ru_minflt;
+}
+
+/*
+ *  stress_shm_scale_child()
+ *	attach the segment, read fault each page and hold the mapping
+ *	until the parent has sampled the page table size
+ */
+static void stress_shm_scale_child(
+	const stress_shm_scale_backing_t *backing,
+	stress_shm_scale_shared_t *shared,
+	const uint32_t proc,
+	const int id,
+	const size_t sz,
+	const size_t page_size)
+{
+	stress_shm_scale_result_t *result = &shared->results[proc];
+	volatile uint8_t *ptr;
+	uint8_t *addr;
+	uint64_t faults, pte_kb;
+	double t;
+	size_t i;
+
+	pte_kb = stress_shm_scale_vmpte();
+	result->forked = true;
+	while (!shared->start && !shared->release && keep_stressing_flag())
+		shim_sched_yield();
+
+	faults = stress_shm_scale_minflt();
+	t = stress_time_now();
+	addr = (uint8_t *)backing->attach(id, sz);
+	result->attach = stress_time_now() - t;
+	if (!addr) {
+		result->err = errno;
+		result->ready = true;
+		return;
+	}
+	t = stress_time_now();
+	for (ptr = addr, i = 0; i < sz; i += page_size)
+		(void)ptr[i];
+	result->touch = stress_time_now() - t;
+	result->faults = stress_shm_scale_minflt() - faults;
+	result->pte_kb = stress_shm_scale_vmpte() - pte_kb;
+	result->ready = true;
+
+	while (!shared->release && keep_stressing_flag())
+		(void)shim_usleep(1000);
+	backing->detach(id, addr, sz);
+}
+
+/*
+ *  stress_shm_scale_phase()
+ *	run n processes that attach and touch the segment, add the
+ *	results to stats, returns the errno of a failed attach or 0
+ */
+static int stress_shm_scale_phase(
+	const stress_args_t *args,
+	const stress_shm_scale_backing_t *backing,
+	stress_shm_scale_shared_t *shared,
+	const int id,
+	const size_t sz,
+	stress_shm_scale_stats_t *stats)
+{
+	pid_t pids[MAX_SHM_SCALE_PROCS];
+	const uint32_t n = stats->procs;
+	uint32_t i, started = 0, waiting;
+	uint64_t pt_base, pt_kb;
+	int err = 0;
+
+	shared->start = false;
+	shared->release = false;
+	(void)memset(shared->results, 0, sizeof(shared->results[0]) * n);
+	for (i = 0; i < n; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			break;
+		if (pids[i] == 0) {
+			stress_parent_died_alarm();
+			(void)sched_settings_apply(true);
+
+			stress_shm_scale_child(backing, shared, i, id, sz, args->page_size);
+			_exit(EXIT_SUCCESS);
+		}
+		started++;
+	}
+
+	/* baseline after fork so only the segment mappings are measured */
+	do {
+		for (waiting = 0, i = 0; i < started; i++)
+			waiting += !shared->results[i].forked;
+		if (waiting)
+			shim_sched_yield();
+	} while (waiting && keep_stressing_flag());
+	pt_base = stress_shm_scale_page_tables();
+
+	if (started == n) {
+		shared->start = true;
+		do {
+			for (waiting = 0, i = 0; i < n; i++)
+				waiting += !shared->results[i].ready;
+			if (waiting)
+				(void)shim_usleep(1000);
+		} while (waiting && keep_stressing_flag());
+	}
+	pt_kb = stress_shm_scale_page_tables();
+	shared->release = true;
+
+	for (i = 0; i < started; i++) {
+		int status;
+
+		(void)shim_waitpid(pids[i], &status, 0);
+	}
+	if ((started != n) || !keep_stressing_flag()) {
+		if (started != n)
+			pr_dbg("%s: could only fork %" PRIu32 " of %" PRIu32 " processes\n",
+				args->name, started, n);
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		const stress_shm_scale_result_t *result = &shared->results[i];
+
+		if (result->err) {
+			err = result->err;
+			continue;
+		}
+		stats->attach += result->attach;
+		stats->touch += result->touch;
+		stats->faults += (double)result->faults;
+		stats->pte_kb += (double)result->pte_kb;
+		stats->proc_phases += 1.0;
+	}
+	if (pt_kb > pt_base)
+		stats->pt_kb += (double)(pt_kb - pt_base);
+
+	return err;
+}
+
+/*
+ *  stress_shm_scale_report()
+ *	print attach latency, fault rate and page table overhead over
+ *	the process counts of a backing
+ */
+static void stress_shm_scale_report(
+	const stress_args_t *args,
+	const char *name,
+	const size_t sz,
+	const stress_shm_scale_stats_t *stats,
+	const size_t n_counts)
+{
+	const double gb = (double)sz / (double)GB;
+	size_t i;
+
+	pr_inf("%s: %s backed %zu MB segment attached by many processes\n",
+		args->name, name, sz / (size_t)MB);
+	pr_inf("%s: %5s %10s %10s %10s %12s %11s %11s %13s\n", args->name,
+		"procs", "attach us", "touch ms", "MB/s/proc",
+		"faults/proc", "PT kB/proc", "PT kB/GB/pr", "PageTables kB");
+	for (i = 0; i < n_counts; i++) {
+		const stress_shm_scale_stats_t *s = &stats[i];
+		double touch, pt_proc, phases;
+
+		if (s->proc_phases <= 0.0)
+			continue;
+		touch = s->touch / s->proc_phases;
+		pt_proc = s->pte_kb / s->proc_phases;
+		phases = s->proc_phases / (double)s->procs;
+		pr_inf("%s: %5" PRIu32 " %10.2f %10.3f %10.1f %12.0f %11.1f %11.1f %13.0f\n",
+			args->name, s->procs,
+			STRESS_DBL_MICROSECOND * s->attach / s->proc_phases,
+			STRESS_DBL_MILLISECOND * touch,
+			(touch > 0.0) ? ((double)sz / (double)MB) / touch : 0.0,
+			s->faults / s->proc_phases, pt_proc,
+			(gb > 0.0) ? pt_proc / gb : 0.0, s->pt_kb / phases);
+	}
+}
+
+/*
+ *  stress_shm_scale()
+ *	populate a shared segment of each backing and measure the
+ *	attach latency, shared page fault rate and page table memory
+ *	as the number of processes mapping the segment grows
+ */
+int stress_shm_scale(
+	const stress_args_t *args,
+	const stress_shm_scale_backing_t *backings,
+	const size_t n_backings,
+	const size_t sz,
+	const uint32_t procs)
+{
+	static stress_shm_scale_stats_t stats[SHM_SCALE_BACKINGS_MAX][SHM_SCALE_SWEEP_MAX];
+	int ids[SHM_SCALE_BACKINGS_MAX];
+	stress_shm_scale_shared_t *shared;
+	uint32_t n;
+	size_t b, j, n_counts = 0, idx = 0;
+	int rc = EXIT_SUCCESS;
+
+	if ((n_backings == 0) || (n_backings > SHM_SCALE_BACKINGS_MAX))
+		return EXIT_NOT_IMPLEMENTED;
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (n = 1; (n < procs) && (n_counts < SHM_SCALE_SWEEP_MAX - 1); n <<= 1) {
+		for (b = 0; b < n_backings; b++)
+			stats[b][n_counts].procs = n;
+		n_counts++;
+	}
+	for (b = 0; b < n_backings; b++)
+		stats[b][n_counts].procs = procs;
+	n_counts++;
+
+	shared = (stress_shm_scale_shared_t *)mmap(NULL, sizeof(*shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes of shared state, skipping stressor\n",
+			args->name, sizeof(*shared));
+		return EXIT_NO_RESOURCE;
+	}
+
+	/* create and populate each segment once, unsupported backings are skipped */
+	for (b = 0; b < n_backings; b++) {
+		void *addr;
+
+		ids[b] = backings[b].create(sz);
+		if (ids[b] < 0) {
+			if (args->instance == 0)
+				pr_inf("%s: cannot create %zu MB %s segment, errno=%d (%s), skipping it\n",
+					args->name, sz / (size_t)MB, backings[b].name,
+					errno, strerror(errno));
+			continue;
+		}
+		addr = backings[b].attach(ids[b], sz);
+		if (!addr) {
+			if (args->instance == 0)
+				pr_inf("%s: cannot attach %zu MB %s segment, errno=%d (%s), skipping it\n",
+					args->name, sz / (size_t)MB, backings[b].name,
+					errno, strerror(errno));
+			backings[b].destroy(ids[b], sz);
+			ids[b] = -1;
+			continue;
+		}
+		(void)memset(addr, 0x5a, sz);
+		backings[b].detach(ids[b], addr, sz);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (b = 0; b < n_backings; b++) {
+			if (ids[b] < 0)
+				continue;
+			for (j = 0; keep_stressing(args) && (j < n_counts); j++) {
+				const int ret = stress_shm_scale_phase(args, &backings[b],
+					shared, ids[b], sz, &stats[b][j]);
+
+				if (ret != 0) {
+					pr_fail("%s: %s attach failed with %" PRIu32
+						" processes, errno=%d (%s)\n", args->name,
+						backings[b].name, stats[b][j].procs,
+						ret, strerror(ret));
+					rc = EXIT_FAILURE;
+					break;
+				}
+				add_counter(args, stats[b][j].procs);
+			}
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		for (b = 0; b < n_backings; b++) {
+			if (ids[b] >= 0)
+				stress_shm_scale_report(args, backings[b].name, sz, stats[b], n_counts);
+			else
+				pr_inf("%s: %s backed segment not available\n",
+					args->name, backings[b].name);
+		}
+		pr_unlock();
+	}
+
+	for (b = 0; b < n_backings; b++) {
+		const stress_shm_scale_stats_t *s = &stats[b][n_counts - 1];
+		char str[64];
+
+		if (ids[b] < 0)
+			continue;
+		backings[b].destroy(ids[b], sz);
+		if (s->proc_phases <= 0.0)
+			continue;
+		(void)snprintf(str, sizeof(str), "%s attach usec (%" PRIu32 " procs)",
+			backings[b].name, s->procs);
+		stress_metrics_set(args, idx++, str,
+			STRESS_DBL_MICROSECOND * s->attach / s->proc_phases);
+		(void)snprintf(str, sizeof(str), "%s faults per proc (%" PRIu32 " procs)",
+			backings[b].name, s->procs);
+		stress_metrics_set(args, idx++, str, s->faults / s->proc_phases);
+		(void)snprintf(str, sizeof(str), "%s page table kB per proc (%" PRIu32 " procs)",
+			backings[b].name, s->procs);
+		stress_metrics_set(args, idx++, str, s->pte_kb / s->proc_phases);
+	}
+	(void)munmap((void *)shared, sizeof(*shared));
+
+	return rc;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_SHM_SCALE_H
+#define CORE_SHM_SCALE_H
+
+#define MIN_SHM_SCALE_PROCS		(1)
+#define MAX_SHM_SCALE_PROCS		(256)
+#define DEFAULT_SHM_SCALE_PROCS		(16)
+
+/* a shared memory segment backing, ids are fds or shm ids */
+typedef struct {
+	const char *name;		/* backing name, e.g. 4K or hugetlb */
+	int (*create)(const size_t sz);	/* create a segment, id or -1 */
+	void *(*attach)(const int id, const size_t sz);	/* map, NULL on failure */
+	void (*detach)(const int id, void *addr, const size_t sz);
+	void (*destroy)(const int id, const size_t sz);
+} stress_shm_scale_backing_t;
+
+/* attach latency, shared page faults and page table overhead over processes */
+extern int stress_shm_scale(const stress_args_t *args,
+	const stress_shm_scale_backing_t *backings, const size_t n_backings,
+	const size_t sz, const uint32_t procs);
+
+#endif
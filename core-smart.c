@@ -29,6 +29,10 @@
 #include <scsi/scsi_ioctl.h>
 #endif
 
+#if defined(HAVE_LINUX_NVME_IOCTL_H)
+#include <linux/nvme_ioctl.h>
+#endif
+
 #define DEVS_MAX      		(256)
 
 #define SENSE_BUF_SZ		(0x20)
@@ -39,6 +43,23 @@
 #define HAVE_SMART	(1)
 #endif
 
+#if defined(__linux__) &&		\
+    defined(HAVE_LINUX_NVME_IOCTL_H) &&	\
+    defined(NVME_IOCTL_ADMIN_CMD)
+#define HAVE_SMART_NVME	(1)
+#endif
+
+#define NVME_DEVS_MAX		(16)	/* NVMe controllers monitored */
+#define NVME_SAMPLE_MS		(1000)	/* health sampling interval */
+#define NVME_SAMPLES_MAX	(3600)	/* time series samples kept */
+#define NVME_DIP_PERCENT	(50.0)	/* throughput dip, % of median rate */
+
+#define NVME_ADMIN_GET_LOG_PAGE	(0x02)
+#define NVME_LOG_SMART		(0x02)	/* SMART / health information log */
+#define NVME_NSID_ALL		(0xffffffff)
+
+#define NVME_CRIT_WARN_TEMP	(0x02)	/* temperature above/below threshold */
+
 /*
  *  See https://www.t10.org/ftp/t10/document.04/04-262r8.pdf
  */
@@ -456,13 +477,543 @@ static void stress_smart_free_devs(void)
 }
 #endif
 
+#if defined(HAVE_SMART_NVME)
+/*
+ *  NVMe SMART / health information log page, see the NVM Express
+ *  Base Specification, Get Log Page, log identifier 02h
+ */
+typedef struct __attribute__ ((packed)) {
+	uint8_t		critical_warning;
+	uint16_t	temperature;		/* Kelvin */
+	uint8_t		avail_spare;
+	uint8_t		spare_thresh;
+	uint8_t		percent_used;
+	uint8_t		endu_grp_crit_warn;
+	uint8_t		rsvd7[25];
+	uint8_t		data_units_read[16];
+	uint8_t		data_units_written[16];
+	uint8_t		host_reads[16];
+	uint8_t		host_writes[16];
+	uint8_t		ctrl_busy_time[16];
+	uint8_t		power_cycles[16];
+	uint8_t		power_on_hours[16];
+	uint8_t		unsafe_shutdowns[16];
+	uint8_t		media_errors[16];
+	uint8_t		num_err_log_entries[16];
+	uint32_t	warning_temp_time;	/* minutes */
+	uint32_t	critical_comp_time;	/* minutes */
+	uint16_t	temp_sensor[8];
+	uint32_t	thm_temp1_trans_count;	/* thermal management transitions */
+	uint32_t	thm_temp2_trans_count;
+	uint32_t	thm_temp1_total_time;	/* seconds */
+	uint32_t	thm_temp2_total_time;
+	uint8_t		rsvd232[280];
+} stress_nvme_smart_log_t;
+
+/* decoded NVMe health, from the health log or just hwmon temperature */
+typedef struct {
+	bool		log_valid;		/* health log could be read */
+	double		temp;			/* composite temperature C, < -273 if unknown */
+	uint8_t		critical_warning;
+	uint8_t		percent_used;
+	uint64_t	host_reads;
+	uint64_t	host_writes;
+	uint64_t	media_errors;
+	uint64_t	ctrl_busy_time;		/* minutes */
+	uint32_t	warning_temp_time;
+	uint32_t	critical_comp_time;
+	uint32_t	tmt1_count;
+	uint32_t	tmt2_count;
+} stress_nvme_health_t;
+
+typedef struct {
+	char name[32];				/* e.g. nvme0 */
+	char hwmon[PATH_MAX];			/* hwmon temp1_input, empty if none */
+	stress_nvme_health_t begin;
+	stress_nvme_health_t end;
+	double temp_max;			/* max sampled temperature */
+} stress_nvme_dev_t;
+
+/* a sample of the NVMe temperature and I/O stressor throughput */
+typedef struct {
+	double		t;			/* seconds since sampling started */
+	double		temp;			/* max composite temperature C */
+	double		io_rate;		/* I/O class stressor bogo ops/s */
+	bool		io_running;		/* I/O class stressors were running */
+	bool		thermal;		/* thermal throttle or temperature warning */
+} stress_nvme_sample_t;
+
+/* shared between the sampler process and stress-ng */
+typedef struct {
+	uint32_t	samples_num;
+	uint32_t	samples_dropped;
+	double		temp_max[NVME_DEVS_MAX];
+	stress_nvme_sample_t samples[NVME_SAMPLES_MAX];
+} stress_nvme_samples_t;
+
+static stress_nvme_dev_t *nvme_devs;
+static size_t nvme_devs_num;
+static stress_nvme_samples_t *nvme_samples;
+static pid_t nvme_pid = -1;
+
+/*
+ *  stress_nvme_le128()
+ *	low 64 bits of a little endian 128 bit health log counter
+ */
+static uint64_t stress_nvme_le128(const uint8_t *val)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = 7; i >= 0; i--)
+		v = (v << 8) | val[i];
+	return v;
+}
+
+/*
+ *  stress_nvme_health_read()
+ *	read the SMART / health log of a NVMe controller, this
+ *	needs CAP_SYS_ADMIN, without it just the hwmon temperature
+ *	is read. Returns -1 if nothing could be read.
+ */
+static int stress_nvme_health_read(const stress_nvme_dev_t *dev, stress_nvme_health_t *health)
+{
+	char path[PATH_MAX];
+	stress_nvme_smart_log_t log;
+	struct nvme_admin_cmd cmd;
+	int fd, ret = -1;
+
+	(void)memset(health, 0, sizeof(*health));
+	health->temp = -300.0;
+
+	(void)snprintf(path, sizeof(path), "/dev/%s", dev->name);
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		(void)memset(&log, 0, sizeof(log));
+		(void)memset(&cmd, 0, sizeof(cmd));
+		cmd.opcode = NVME_ADMIN_GET_LOG_PAGE;
+		cmd.nsid = NVME_NSID_ALL;
+		cmd.addr = (uint64_t)(uintptr_t)&log;
+		cmd.data_len = (uint32_t)sizeof(log);
+		cmd.cdw10 = NVME_LOG_SMART | ((((uint32_t)sizeof(log) / 4) - 1) << 16);
+		if (ioctl(fd, NVME_IOCTL_ADMIN_CMD, &cmd) == 0) {
+			health->log_valid = true;
+			health->temp = (double)log.temperature - 273.15;
+			health->critical_warning = log.critical_warning;
+			health->percent_used = log.percent_used;
+			health->host_reads = stress_nvme_le128(log.host_reads);
+			health->host_writes = stress_nvme_le128(log.host_writes);
+			health->media_errors = stress_nvme_le128(log.media_errors);
+			health->ctrl_busy_time = stress_nvme_le128(log.ctrl_busy_time);
+			health->warning_temp_time = log.warning_temp_time;
+			health->critical_comp_time = log.critical_comp_time;
+			health->tmt1_count = log.thm_temp1_trans_count;
+			health->tmt2_count = log.thm_temp2_trans_count;
+			ret = 0;
+		}
+		(void)close(fd);
+	}
+	if (!health->log_valid && *dev->hwmon) {
+		char buf[32];
+		long int millidegrees;
+
+		if ((system_read(dev->hwmon, buf, sizeof(buf)) > 0) &&
+		    (sscanf(buf, "%ld", &millidegrees) == 1)) {
+			health->temp = (double)millidegrees / 1000.0;
+			ret = 0;
+		}
+	}
+	return ret;
+}
+
+/*
+ *  stress_nvme_hwmon()
+ *	find the hwmon temperature of a NVMe controller
+ */
+static void stress_nvme_hwmon(stress_nvme_dev_t *dev)
+{
+	char path[64];
+	DIR *dir;
+	const struct dirent *d;
+
+	*dev->hwmon = '\0';
+	(void)snprintf(path, sizeof(path), "/sys/class/nvme/%s", dev->name);
+	dir = opendir(path);
+	if (!dir)
+		return;
+	while ((d = readdir(dir)) != NULL) {
+		if (!strncmp(d->d_name, "hwmon", 5)) {
+			(void)snprintf(dev->hwmon, sizeof(dev->hwmon),
+				"%s/%s/temp1_input", path, d->d_name);
+			break;
+		}
+	}
+	(void)closedir(dir);
+}
+
+/*
+ *  stress_nvme_io_ops()
+ *	total bogo ops of the running I/O class stressor instances,
+ *	returns false if none are running
+ */
+static bool stress_nvme_io_ops(stress_stressor_t *stressors_list, uint64_t *ops)
+{
+	const stress_stressor_t *ss;
+	bool running = false;
+
+	*ops = 0;
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		if (!ss->stats || !(ss->stressor->info->class & CLASS_IO))
+			continue;
+		for (j = 0; j < ss->num_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+
+			if ((stats->start > 0.0) && (stats->finish <= stats->start))
+				running = true;
+			*ops += stats->ci.counter;
+		}
+	}
+	return running;
+}
+
+/*
+ *  stress_nvme_sampler()
+ *	sample the NVMe temperatures and thermal management state
+ *	and the I/O stressor throughput every NVME_SAMPLE_MS
+ */
+static void NORETURN stress_nvme_sampler(stress_stressor_t *stressors_list)
+{
+	stress_nvme_health_t prev[NVME_DEVS_MAX];
+	uint64_t ops_prev = 0;
+	double t_start, t_prev, t_next;
+	size_t i;
+
+	stress_set_proc_name("stat [nvme]");
+	for (i = 0; i < nvme_devs_num; i++)
+		prev[i] = nvme_devs[i].begin;
+	(void)stress_nvme_io_ops(stressors_list, &ops_prev);
+
+	t_start = stress_time_now();
+	t_prev = t_start;
+	t_next = t_start;
+	for (;;) {
+		stress_nvme_sample_t *sample;
+		double t_now, t_delta, temp = -300.0;
+		uint64_t ops;
+		bool thermal = false, running;
+
+		t_next += (double)NVME_SAMPLE_MS / 1000.0;
+		t_delta = t_next - stress_time_now();
+		if (t_delta > 0.0)
+			(void)shim_nanosleep_uint64((uint64_t)(t_delta * STRESS_DBL_NANOSECOND));
+
+		for (i = 0; i < nvme_devs_num; i++) {
+			stress_nvme_health_t health;
+
+			if (stress_nvme_health_read(&nvme_devs[i], &health) < 0)
+				continue;
+			if (health.temp > temp)
+				temp = health.temp;
+			if (health.temp > nvme_samples->temp_max[i])
+				nvme_samples->temp_max[i] = health.temp;
+			if (health.log_valid && prev[i].log_valid) {
+				/* thermal management kicked in or temperature above a threshold */
+				if ((health.tmt1_count != prev[i].tmt1_count) ||
+				    (health.tmt2_count != prev[i].tmt2_count) ||
+				    (health.warning_temp_time != prev[i].warning_temp_time) ||
+				    (health.critical_comp_time != prev[i].critical_comp_time) ||
+				    (health.critical_warning & NVME_CRIT_WARN_TEMP))
+					thermal = true;
+			}
+			prev[i] = health;
+		}
+
+		t_now = stress_time_now();
+		t_delta = t_now - t_prev;
+		running = stress_nvme_io_ops(stressors_list, &ops);
+		if (nvme_samples->samples_num < NVME_SAMPLES_MAX) {
+			sample = &nvme_samples->samples[nvme_samples->samples_num];
+			sample->t = t_now - t_start;
+			sample->temp = temp;
+			/* counters are reset when the stressors are run again */
+			sample->io_running = running && (ops >= ops_prev) && (t_delta > 0.0);
+			sample->io_rate = sample->io_running ? (double)(ops - ops_prev) / t_delta : 0.0;
+			sample->thermal = thermal;
+			nvme_samples->samples_num++;
+		} else {
+			nvme_samples->samples_dropped++;
+		}
+		ops_prev = ops;
+		t_prev = t_now;
+	}
+}
+
+/*
+ *  stress_nvme_start()
+ *	find the NVMe controllers, read the initial health and
+ *	start the sampler process
+ */
+static void stress_nvme_start(stress_stressor_t *stressors_list)
+{
+	DIR *dir;
+	const struct dirent *d;
+	size_t i;
+
+	dir = opendir("/sys/class/nvme");
+	if (!dir)
+		return;
+	nvme_devs = calloc(NVME_DEVS_MAX, sizeof(*nvme_devs));
+	if (!nvme_devs) {
+		(void)closedir(dir);
+		return;
+	}
+	while (((d = readdir(dir)) != NULL) && (nvme_devs_num < NVME_DEVS_MAX)) {
+		stress_nvme_dev_t *dev = &nvme_devs[nvme_devs_num];
+
+		if (strncmp(d->d_name, "nvme", 4))
+			continue;
+		(void)shim_strlcpy(dev->name, d->d_name, sizeof(dev->name));
+		stress_nvme_hwmon(dev);
+		if (stress_nvme_health_read(dev, &dev->begin) == 0)
+			nvme_devs_num++;
+	}
+	(void)closedir(dir);
+	if (!nvme_devs_num) {
+		free(nvme_devs);
+		nvme_devs = NULL;
+		return;
+	}
+
+	nvme_samples = (stress_nvme_samples_t *)mmap(NULL, sizeof(*nvme_samples),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+	if (nvme_samples == MAP_FAILED) {
+		pr_inf("smart: cannot mmap NVMe sample data, errno=%d (%s), "
+			"NVMe sampling disabled\n", errno, strerror(errno));
+		nvme_samples = NULL;
+		return;
+	}
+	(void)memset(nvme_samples, 0, sizeof(*nvme_samples));
+	for (i = 0; i < nvme_devs_num; i++)
+		nvme_samples->temp_max[i] = nvme_devs[i].begin.temp;
+
+	nvme_pid = fork();
+	if (nvme_pid < 0) {
+		pr_inf("smart: cannot fork NVMe sampler, errno=%d (%s)\n",
+			errno, strerror(errno));
+		return;
+	}
+	if (nvme_pid == 0)
+		stress_nvme_sampler(stressors_list);
+}
+
+/*
+ *  stress_nvme_cmp_double()
+ *	qsort comparison of doubles
+ */
+static int stress_nvme_cmp_double(const void *p1, const void *p2)
+{
+	const double d1 = *(const double *)p1;
+	const double d2 = *(const double *)p2;
+
+	if (d1 < d2)
+		return -1;
+	if (d1 > d2)
+		return 1;
+	return 0;
+}
+
+/*
+ *  stress_nvme_correlate()
+ *	correlate the NVMe temperature and thermal events with
+ *	dips in the I/O stressor throughput
+ */
+static void stress_nvme_correlate(FILE *yaml)
+{
+	double *rates, median, dip;
+	double sum_t = 0.0, sum_r = 0.0, sum_tt = 0.0, sum_rr = 0.0, sum_tr = 0.0;
+	double rate_thermal = 0.0, rate_normal = 0.0;
+	uint32_t i, n = 0, n_temp = 0, dips = 0, thermal = 0, dips_thermal = 0;
+
+	if (!nvme_samples || !nvme_samples->samples_num)
+		return;
+	rates = calloc(nvme_samples->samples_num, sizeof(*rates));
+	if (!rates)
+		return;
+	for (i = 0; i < nvme_samples->samples_num; i++) {
+		if (nvme_samples->samples[i].io_running)
+			rates[n++] = nvme_samples->samples[i].io_rate;
+	}
+	if (n < 2) {
+		free(rates);
+		pr_inf("smart: NVMe sampled, but no I/O stressors ran long enough "
+			"to correlate throughput with temperature\n");
+		return;
+	}
+	qsort(rates, n, sizeof(*rates), stress_nvme_cmp_double);
+	median = rates[n / 2];
+	free(rates);
+	dip = median * NVME_DIP_PERCENT / 100.0;
+
+	for (i = 0; i < nvme_samples->samples_num; i++) {
+		const stress_nvme_sample_t *sample = &nvme_samples->samples[i];
+		const bool is_dip = sample->io_rate < dip;
+
+		if (!sample->io_running)
+			continue;
+		if (sample->thermal) {
+			thermal++;
+			rate_thermal += sample->io_rate;
+		} else {
+			rate_normal += sample->io_rate;
+		}
+		if (is_dip) {
+			dips++;
+			if (sample->thermal)
+				dips_thermal++;
+			pr_dbg("smart: I/O throughput dip at %.1fs, %.2f ops/s, %.1f C%s\n",
+				sample->t, sample->io_rate, sample->temp,
+				sample->thermal ? ", NVMe thermal event" : "");
+		}
+		if (sample->temp > -273.0) {
+			sum_t += sample->temp;
+			sum_r += sample->io_rate;
+			sum_tt += sample->temp * sample->temp;
+			sum_rr += sample->io_rate * sample->io_rate;
+			sum_tr += sample->temp * sample->io_rate;
+			n_temp++;
+		}
+	}
+	rate_thermal = thermal ? rate_thermal / (double)thermal : 0.0;
+	rate_normal = (n > thermal) ? rate_normal / (double)(n - thermal) : 0.0;
+
+	pr_inf("smart: I/O throughput median %.2f ops/s, %" PRIu32 " of %" PRIu32
+		" samples dipped below %.0f%%, %" PRIu32 " of them during NVMe thermal events\n",
+		median, dips, n, NVME_DIP_PERCENT, dips_thermal);
+	if (thermal)
+		pr_inf("smart: I/O throughput %.2f ops/s during %" PRIu32 " NVMe thermal "
+			"event samples vs %.2f ops/s otherwise\n",
+			rate_thermal, thermal, rate_normal);
+	pr_yaml(yaml, "      io-throughput:\n");
+	pr_yaml(yaml, "        median-ops-per-sec: %f\n", median);
+	pr_yaml(yaml, "        samples: %" PRIu32 "\n", n);
+	pr_yaml(yaml, "        dips: %" PRIu32 "\n", dips);
+	pr_yaml(yaml, "        dips-during-thermal-events: %" PRIu32 "\n", dips_thermal);
+	pr_yaml(yaml, "        thermal-event-samples: %" PRIu32 "\n", thermal);
+	pr_yaml(yaml, "        thermal-event-ops-per-sec: %f\n", rate_thermal);
+	pr_yaml(yaml, "        normal-ops-per-sec: %f\n", rate_normal);
+
+	if (n_temp > 2) {
+		const double nt = (double)n_temp;
+		const double var_t = sum_tt - (sum_t * sum_t) / nt;
+		const double var_r = sum_rr - (sum_r * sum_r) / nt;
+
+		if ((var_t > 0.0) && (var_r > 0.0)) {
+			const double r = (sum_tr - (sum_t * sum_r) / nt) / sqrt(var_t * var_r);
+
+			pr_inf("smart: correlation of NVMe temperature with I/O throughput r = %.3f\n", r);
+			pr_yaml(yaml, "        temperature-correlation: %f\n", r);
+		}
+	}
+}
+
+/*
+ *  stress_nvme_stop()
+ *	stop the sampler, report the NVMe health changes and
+ *	the temperature vs I/O throughput correlation
+ */
+static void stress_nvme_stop(FILE *yaml)
+{
+	size_t i;
+
+	if (nvme_pid > 0) {
+		int status;
+
+		(void)kill(nvme_pid, SIGKILL);
+		(void)waitpid(nvme_pid, &status, 0);
+		nvme_pid = -1;
+	}
+	if (!nvme_devs_num)
+		return;
+
+	pr_inf("smart: %-8s %7s %7s %7s %6s %6s %6s %8s %8s %12s %12s\n",
+		"NVMe", "temp C", "max C", "end C", "media", "tmt1", "tmt2",
+		"warn min", "crit min", "host reads", "host writes");
+	pr_yaml(yaml, "smart-nvme:\n");
+	pr_yaml(yaml, "      devices:\n");
+	for (i = 0; i < nvme_devs_num; i++) {
+		stress_nvme_dev_t *dev = &nvme_devs[i];
+		const stress_nvme_health_t *b = &dev->begin;
+		stress_nvme_health_t *e = &dev->end;
+
+		(void)stress_nvme_health_read(dev, e);
+		dev->temp_max = nvme_samples ? nvme_samples->temp_max[i] : b->temp;
+		if (e->temp > dev->temp_max)
+			dev->temp_max = e->temp;
+
+		pr_yaml(yaml, "        - device: %s\n", dev->name);
+		pr_yaml(yaml, "          temperature-begin: %.1f\n", b->temp);
+		pr_yaml(yaml, "          temperature-max: %.1f\n", dev->temp_max);
+		pr_yaml(yaml, "          temperature-end: %.1f\n", e->temp);
+		if (!b->log_valid || !e->log_valid) {
+			pr_inf("smart: %-8s %7.1f %7.1f %7.1f %6s %6s %6s %8s %8s %12s %12s\n",
+				dev->name, b->temp, dev->temp_max, e->temp,
+				"-", "-", "-", "-", "-", "-", "-");
+			continue;
+		}
+		pr_inf("smart: %-8s %7.1f %7.1f %7.1f %6" PRIu64 " %6" PRIu32 " %6" PRIu32
+			" %8" PRIu32 " %8" PRIu32 " %12" PRIu64 " %12" PRIu64 "\n",
+			dev->name, b->temp, dev->temp_max, e->temp,
+			e->media_errors - b->media_errors,
+			e->tmt1_count - b->tmt1_count,
+			e->tmt2_count - b->tmt2_count,
+			e->warning_temp_time - b->warning_temp_time,
+			e->critical_comp_time - b->critical_comp_time,
+			e->host_reads - b->host_reads,
+			e->host_writes - b->host_writes);
+		pr_yaml(yaml, "          media-errors: %" PRIu64 "\n", e->media_errors - b->media_errors);
+		pr_yaml(yaml, "          thermal-transitions-1: %" PRIu32 "\n", e->tmt1_count - b->tmt1_count);
+		pr_yaml(yaml, "          thermal-transitions-2: %" PRIu32 "\n", e->tmt2_count - b->tmt2_count);
+		pr_yaml(yaml, "          warning-temp-minutes: %" PRIu32 "\n", e->warning_temp_time - b->warning_temp_time);
+		pr_yaml(yaml, "          critical-temp-minutes: %" PRIu32 "\n", e->critical_comp_time - b->critical_comp_time);
+		pr_yaml(yaml, "          host-read-commands: %" PRIu64 "\n", e->host_reads - b->host_reads);
+		pr_yaml(yaml, "          host-write-commands: %" PRIu64 "\n", e->host_writes - b->host_writes);
+		pr_yaml(yaml, "          percent-used: %" PRIu8 "\n", e->percent_used);
+		if (e->critical_warning)
+			pr_inf("smart: %s critical warning 0x%2.2x\n", dev->name, e->critical_warning);
+	}
+	if (!nvme_devs[0].begin.log_valid)
+		pr_inf("smart: NVMe health logs need CAP_SYS_ADMIN, only temperatures "
+			"are available (try running as root)\n");
+	stress_nvme_correlate(yaml);
+	if (nvme_samples && nvme_samples->samples_dropped)
+		pr_inf("smart: only the first %d NVMe samples were kept\n", NVME_SAMPLES_MAX);
+	pr_yaml(yaml, "\n");
+
+	if (nvme_samples) {
+		(void)munmap((void *)nvme_samples, sizeof(*nvme_samples));
+		nvme_samples = NULL;
+	}
+	free(nvme_devs);
+	nvme_devs = NULL;
+	nvme_devs_num = 0;
+}
+#endif
+
 /*
  *  stress_smart_start()
- *	fetch beginning smart data
+ *	fetch beginning smart data and start sampling
+ *	NVMe health
  */
-void stress_smart_start(void)
+void stress_smart_start(stress_stressor_t *stressors_list)
 {
 	if (g_opt_flags & OPT_FLAGS_SMART) {
+#if defined(HAVE_SMART_NVME)
+		stress_nvme_start(stressors_list);
+#else
+		(void)stressors_list;
+#endif
 #if defined(HAVE_SMART)
 		stress_smart_read_devs();
 #else
@@ -473,11 +1024,17 @@ void stress_smart_start(void)
 
 /*
  *  stress_smart_stop()
- *	fetch stop smart data and print any changes
+ *	fetch stop smart data and print any changes, and the
+ *	NVMe health changes and I/O throughput correlation
  */
-void stress_smart_stop(void)
+void stress_smart_stop(FILE *yaml)
 {
 	if (g_opt_flags & OPT_FLAGS_SMART) {
+#if defined(HAVE_SMART_NVME)
+		stress_nvme_stop(yaml);
+#else
+		(void)yaml;
+#endif
 #if defined(HAVE_SMART)
 		stress_smart_dev_t *dev;
 		size_t deltas = 0;
@@ -20,7 +20,7 @@
 #define CORE_SMART_H
 
 /* S.M.A.R.T. helpers */
-extern void stress_smart_start(void);
-extern void stress_smart_stop(void);
+extern void stress_smart_start(stress_stressor_t *stressors_list);
+extern void stress_smart_stop(FILE *yaml);
 
 #endif
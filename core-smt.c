@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cpu-cache.h"
+#include "core-hybrid.h"
+#include "core-phase.h"
+#include "core-resctrl.h"
+#include "core-search.h"
+#include "core-smt.h"
+
+/*
+ *  --smt-interference runs each stressor (the victim) as a single
+ *  instance on one logical CPU of an SMT core, first alone and then
+ *  with each of the stressors (the partners, including the victim
+ *  itself) running on the sibling logical CPU. The slowdown of the
+ *  victim compared to running alone gives the interference matrix.
+ */
+typedef struct {
+	stress_stressor_t *ss;		/* victim stressor */
+	double alone;			/* bogo ops/s running alone */
+	double *paired;			/* bogo ops/s with each partner on the sibling */
+	bool *paired_run;		/* partner run completed */
+	bool alone_run;			/* alone run completed */
+} stress_smt_victim_t;
+
+/*
+ *  stress_set_smt_interference()
+ *	enable --smt-interference
+ */
+int stress_set_smt_interference(const char *opt)
+{
+	bool smt_interference = true;
+
+	(void)opt;
+	return stress_set_setting_global("smt-interference", TYPE_ID_BOOL, &smt_interference);
+}
+
+#if defined(HAVE_SCHED_SETAFFINITY)
+
+static stress_smt_victim_t *smt_victims;
+static size_t smt_victims_num;
+static size_t smt_step;			/* current step */
+static size_t smt_steps_num;		/* victims * (partners + alone) */
+static const stress_stressor_t *smt_victim_ss;	/* victim of current step */
+static int32_t smt_cpu_victim = -1;	/* logical CPU the victim runs on */
+static int32_t smt_cpu_sibling = -1;	/* its SMT sibling */
+
+/*
+ *  stress_smt_siblings()
+ *	find the first SMT core with two logical CPUs that are both
+ *	in the current CPU affinity mask, SMT siblings have the same
+ *	physical package and core ids
+ */
+static bool stress_smt_siblings(int32_t *cpu_victim, int32_t *cpu_sibling)
+{
+	stress_cpu_cache_cpus_t *cpus;
+	cpu_set_t set;
+	uint32_t i, j;
+	bool found = false;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		return false;
+	cpus = stress_cpu_cache_get_all_details();
+	if (!cpus)
+		return false;
+
+	for (i = 0; (i < cpus->count) && !found; i++) {
+		const stress_cpu_cache_cpu_t *a = &cpus->cpus[i];
+
+		if (!a->online || (a->core_id < 0) || (a->num >= CPU_SETSIZE) ||
+		    !CPU_ISSET((int)a->num, &set))
+			continue;
+		for (j = i + 1; j < cpus->count; j++) {
+			const stress_cpu_cache_cpu_t *b = &cpus->cpus[j];
+
+			if (!b->online || (b->num >= CPU_SETSIZE) ||
+			    !CPU_ISSET((int)b->num, &set))
+				continue;
+			if ((a->package_id == b->package_id) && (a->core_id == b->core_id)) {
+				*cpu_victim = (int32_t)a->num;
+				*cpu_sibling = (int32_t)b->num;
+				found = true;
+				break;
+			}
+		}
+	}
+	stress_free_cpu_caches(cpus);
+	return found;
+}
+
+/*
+ *  stress_smt_setup()
+ *	check the --smt-interference option, find a pair of SMT
+ *	siblings and set up the victim and partner stressors
+ */
+int stress_smt_setup(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool smt_interference = false;
+	size_t i;
+
+	(void)stress_get_setting("smt-interference", &smt_interference);
+	if (!smt_interference)
+		return 0;
+	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+		pr_err("smt: --smt-interference cannot be used with --sequential\n");
+		return -1;
+	}
+	if (stress_phase_count()) {
+		pr_err("smt: --smt-interference cannot be used with job file phases\n");
+		return -1;
+	}
+	if (stress_search_enabled()) {
+		pr_err("smt: --smt-interference cannot be used with --search\n");
+		return -1;
+	}
+	if (stress_resctrl_sweep_enabled() || stress_hybrid_enabled()) {
+		pr_err("smt: --smt-interference cannot be used with --resctrl-sweep or --core-type\n");
+		return -1;
+	}
+	if (!stress_smt_siblings(&smt_cpu_victim, &smt_cpu_sibling)) {
+		pr_inf("smt: no SMT sibling CPUs found, ignoring --smt-interference\n");
+		return 0;
+	}
+
+	for (smt_victims_num = 0, ss = stressors_list; ss; ss = ss->next) {
+		if (ss->num_instances > 0)
+			smt_victims_num++;
+	}
+	if (!smt_victims_num)
+		return 0;
+
+	smt_victims = calloc(smt_victims_num, sizeof(*smt_victims));
+	if (!smt_victims)
+		goto err;
+	for (i = 0, ss = stressors_list; ss; ss = ss->next) {
+		if (ss->num_instances <= 0)
+			continue;
+		smt_victims[i].ss = ss;
+		smt_victims[i].paired = calloc(smt_victims_num, sizeof(*smt_victims[i].paired));
+		smt_victims[i].paired_run = calloc(smt_victims_num, sizeof(*smt_victims[i].paired_run));
+		if (!smt_victims[i].paired || !smt_victims[i].paired_run)
+			goto err;
+		i++;
+		/* at most two instances, when paired with itself */
+		ss->num_instances = 2;
+	}
+	smt_steps_num = smt_victims_num * (smt_victims_num + 1);
+	pr_dbg("smt: victims run on CPU %" PRId32 ", partners on sibling CPU %" PRId32 "\n",
+		smt_cpu_victim, smt_cpu_sibling);
+	return 0;
+err:
+	pr_err("smt: cannot allocate interference matrix\n");
+	stress_smt_free();
+	return -1;
+}
+
+/*
+ *  stress_smt_enabled()
+ *	true if the SMT interference matrix is being measured
+ */
+bool stress_smt_enabled(void)
+{
+	return smt_steps_num > 0;
+}
+
+/*
+ *  stress_smt_step_begin()
+ *	set up the instances of the next victim and partner
+ *	pairing, returns false when all pairings have been run
+ */
+bool stress_smt_step_begin(stress_stressor_t *stressors_list)
+{
+	const stress_smt_victim_t *victim;
+	const stress_stressor_t *partner_ss;
+	stress_stressor_t *ss;
+	size_t partner;
+	char victim_name[64];
+
+	if (smt_step >= smt_steps_num) {
+		smt_victim_ss = NULL;
+		return false;
+	}
+	victim = &smt_victims[smt_step / (smt_victims_num + 1)];
+	partner = smt_step % (smt_victims_num + 1);
+	partner_ss = partner ? smt_victims[partner - 1].ss : NULL;
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		ss->num_instances = 0;
+	victim->ss->num_instances = 1;
+	if (partner_ss)
+		smt_victims[partner - 1].ss->num_instances++;
+	smt_victim_ss = victim->ss;
+
+	(void)shim_strlcpy(victim_name, stress_munge_underscore(victim->ss->stressor->name), sizeof(victim_name));
+	if (partner_ss) {
+		pr_inf("smt: %s on CPU %" PRId32 " with %s on sibling CPU %" PRId32 "\n",
+			victim_name, smt_cpu_victim,
+			stress_munge_underscore(partner_ss->stressor->name), smt_cpu_sibling);
+	} else {
+		pr_inf("smt: %s on CPU %" PRId32 " alone\n",
+			victim_name, smt_cpu_victim);
+	}
+	return true;
+}
+
+/*
+ *  stress_smt_step_end()
+ *	record the throughput of the victim instance
+ */
+void stress_smt_step_end(void)
+{
+	stress_smt_victim_t *victim = &smt_victims[smt_step / (smt_victims_num + 1)];
+	const size_t partner = smt_step % (smt_victims_num + 1);
+	const stress_stats_t *stats;
+	double rate = 0.0;
+
+	if (victim->ss->started_instances > 0) {
+		stats = victim->ss->stats[0];
+		if (stats->window.end > stats->window.begin) {
+			rate = (double)(stats->window.counter_end - stats->window.counter_begin) /
+				(stats->window.end - stats->window.begin);
+		} else if (stats->finish > stats->start) {
+			rate = (double)stats->ci.counter / (stats->finish - stats->start);
+		}
+	}
+	if (partner) {
+		victim->paired[partner - 1] = rate;
+		victim->paired_run[partner - 1] = true;
+	} else {
+		victim->alone = rate;
+		victim->alone_run = true;
+	}
+	smt_step++;
+}
+
+/*
+ *  stress_smt_apply()
+ *	pin the victim instance to its CPU and the partner
+ *	instance to the SMT sibling CPU
+ */
+void stress_smt_apply(const char *name, const stress_stressor_t *ss, const int32_t instance)
+{
+	cpu_set_t set;
+	int32_t cpu;
+
+	if (!smt_victim_ss)
+		return;
+
+	cpu = ((ss == smt_victim_ss) && (instance == 0)) ? smt_cpu_victim : smt_cpu_sibling;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("%s: cannot set SMT CPU %" PRId32 " affinity, errno=%d (%s)\n",
+			name, cpu, errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_smt_dump()
+ *	dump the slowdown matrix, each row is a victim and each
+ *	column the partner run on the SMT sibling CPU
+ */
+void stress_smt_dump(FILE *yaml)
+{
+	char line[1024];
+	size_t i, j, len;
+
+	if (!smt_victims)
+		return;
+
+	pr_metrics("SMT sibling slowdown, victims (rows) on CPU %" PRId32
+		" with partners (columns) on CPU %" PRId32 ":\n",
+		smt_cpu_victim, smt_cpu_sibling);
+	len = (size_t)snprintf(line, sizeof(line), "%-13s %12s", "victim", "alone ops/s");
+	for (j = 0; j < smt_victims_num && len < sizeof(line); j++)
+		len += (size_t)snprintf(line + len, sizeof(line) - len, " %10.10s",
+			stress_munge_underscore(smt_victims[j].ss->stressor->name));
+	pr_metrics("%s\n", line);
+
+	pr_yaml(yaml, "smt-interference:\n");
+	pr_yaml(yaml, "      victim-cpu: %" PRId32 "\n", smt_cpu_victim);
+	pr_yaml(yaml, "      sibling-cpu: %" PRId32 "\n", smt_cpu_sibling);
+	pr_yaml(yaml, "      victims:\n");
+
+	for (i = 0; i < smt_victims_num; i++) {
+		const stress_smt_victim_t *victim = &smt_victims[i];
+		char munged[64];
+
+		if (!victim->alone_run)
+			continue;
+		(void)shim_strlcpy(munged, stress_munge_underscore(victim->ss->stressor->name), sizeof(munged));
+
+		len = (size_t)snprintf(line, sizeof(line), "%-13s %12.2f", munged, victim->alone);
+		pr_yaml(yaml, "        - stressor: %s\n", munged);
+		pr_yaml(yaml, "          alone-bogo-ops-per-second: %f\n", victim->alone);
+
+		for (j = 0; j < smt_victims_num && len < sizeof(line); j++) {
+			const char *partner = stress_munge_underscore(smt_victims[j].ss->stressor->name);
+			double slowdown;
+
+			if (!victim->paired_run[j] || (victim->alone <= 0.0)) {
+				len += (size_t)snprintf(line + len, sizeof(line) - len, " %10s", "-");
+				continue;
+			}
+			slowdown = 100.0 * (1.0 - (victim->paired[j] / victim->alone));
+			len += (size_t)snprintf(line + len, sizeof(line) - len, " %9.1f%%", slowdown);
+			pr_yaml(yaml, "          with-%s-bogo-ops-per-second: %f\n", partner, victim->paired[j]);
+			pr_yaml(yaml, "          with-%s-slowdown-percent: %f\n", partner, slowdown);
+		}
+		pr_metrics("%s\n", line);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_smt_free()
+ *	free the interference matrix
+ */
+void stress_smt_free(void)
+{
+	size_t i;
+
+	if (smt_victims) {
+		for (i = 0; i < smt_victims_num; i++) {
+			free(smt_victims[i].paired);
+			free(smt_victims[i].paired_run);
+		}
+		free(smt_victims);
+	}
+	smt_victims = NULL;
+	smt_victims_num = 0;
+	smt_steps_num = 0;
+}
+
+#else
+
+int stress_smt_setup(stress_stressor_t *stressors_list)
+{
+	bool smt_interference = false;
+
+	(void)stressors_list;
+	(void)stress_get_setting("smt-interference", &smt_interference);
+	if (smt_interference)
+		pr_inf("smt: CPU affinity not supported, ignoring --smt-interference\n");
+	return 0;
+}
+
+bool stress_smt_enabled(void)
+{
+	return false;
+}
+
+bool stress_smt_step_begin(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+
+	return false;
+}
+
+void stress_smt_step_end(void)
+{
+}
+
+void stress_smt_apply(const char *name, const stress_stressor_t *ss, const int32_t instance)
+{
+	(void)name;
+	(void)ss;
+	(void)instance;
+}
+
+void stress_smt_dump(FILE *yaml)
+{
+	(void)yaml;
+}
+
+void stress_smt_free(void)
+{
+}
+#endif
@@ -158,3 +158,306 @@ STRESS_SORT_CMP_REV(int64, int64_t)
 
 STRESS_SORT_CMP_FWD(int, int)
 STRESS_SORT_CMP_REV(int, int)
+
+STRESS_SORT_CMP_FWD(uint64, uint64_t)
+
+int OPTIMIZE3 stress_sort_cmp_fwd_record(const void *p1, const void *p2)
+{
+	register const uint64_t v1 = ((const stress_sort_record_t *)p1)->key;
+	register const uint64_t v2 = ((const stress_sort_record_t *)p2)->key;
+
+	stress_sort_compares++;
+	if (v1 > v2)
+		return 1;
+	else if (v1 < v2)
+		return -1;
+	else
+		return 0;
+}
+
+int OPTIMIZE3 stress_sort_cmp_fwd_string(const void *p1, const void *p2)
+{
+	stress_sort_compares++;
+	return strcmp(*(const char * const *)p1, *(const char * const *)p2);
+}
+
+#define STRESS_SORT_STR_DIGITS	(7)	/* base 26 digits, 26^7 > 2^31 */
+#define STRESS_SORT_STR_MAX	(32)	/* max string key size including the '\0' */
+#define STRESS_SORT_FEW_UNIQUE	(16)	/* distinct keys in the few-unique distribution */
+
+enum {
+	STRESS_SORT_TYPE_INT32,
+	STRESS_SORT_TYPE_UINT64,
+	STRESS_SORT_TYPE_RECORD,
+	STRESS_SORT_TYPE_STRING,
+	STRESS_SORT_TYPES,
+};
+
+enum {
+	STRESS_SORT_DIST_RANDOM,
+	STRESS_SORT_DIST_SORTED,
+	STRESS_SORT_DIST_REVERSE,
+	STRESS_SORT_DIST_ZIPF,
+	STRESS_SORT_DIST_FEW_UNIQUE,
+	STRESS_SORT_DIST_NEARLY_SORTED,
+	STRESS_SORT_DIST_ORGAN_PIPE,
+	STRESS_SORT_DISTS,
+};
+
+static const char * const stress_sort_type_names[STRESS_SORT_TYPES] = {
+	"int32", "uint64", "record", "string"
+};
+
+static const size_t stress_sort_type_sizes[STRESS_SORT_TYPES] = {
+	sizeof(int32_t), sizeof(uint64_t), sizeof(stress_sort_record_t), sizeof(char *)
+};
+
+static int (* const stress_sort_type_cmps[STRESS_SORT_TYPES])(const void *p1, const void *p2) = {
+	stress_sort_cmp_fwd_int32,
+	stress_sort_cmp_fwd_uint64,
+	stress_sort_cmp_fwd_record,
+	stress_sort_cmp_fwd_string,
+};
+
+static const char * const stress_sort_dist_names[STRESS_SORT_DISTS] = {
+	"random", "sorted", "reverse", "zipf", "few-unique", "nearly-sorted", "organ-pipe"
+};
+
+/*
+ *  stress_sort_dist_values()
+ *	fill values with n 31 bit values in the given distribution
+ */
+static void stress_sort_dist_values(uint32_t *values, const size_t n, const int dist)
+{
+	const uint32_t spacing = (uint32_t)(0x80000000UL / (n + 1));
+	const double log_n = log((double)n + 1.0);
+	size_t i;
+
+	switch (dist) {
+	case STRESS_SORT_DIST_RANDOM:
+		stress_mwc_fill(values, n * sizeof(*values));
+		for (i = 0; i < n; i++)
+			values[i] &= 0x7fffffff;
+		break;
+	case STRESS_SORT_DIST_SORTED:
+		for (i = 0; i < n; i++)
+			values[i] = (uint32_t)i * spacing;
+		break;
+	case STRESS_SORT_DIST_REVERSE:
+		for (i = 0; i < n; i++)
+			values[i] = (uint32_t)(n - 1 - i) * spacing;
+		break;
+	case STRESS_SORT_DIST_ZIPF:
+		/* rank r has probability ~ 1 / (r + 1), inverse of the continuous CDF */
+		for (i = 0; i < n; i++) {
+			const double u = (double)stress_mwc32() / 4294967296.0;
+			size_t r = (size_t)(exp(u * log_n) - 1.0);
+
+			if (r >= n)
+				r = n - 1;
+			values[i] = (uint32_t)r * spacing;
+		}
+		break;
+	case STRESS_SORT_DIST_FEW_UNIQUE:
+		for (i = 0; i < n; i++)
+			values[i] = stress_mwc32modn(STRESS_SORT_FEW_UNIQUE) * (0x80000000UL / STRESS_SORT_FEW_UNIQUE);
+		break;
+	case STRESS_SORT_DIST_NEARLY_SORTED:
+		/* sorted with 1% of the keys swapped with a key up to 8 places on */
+		for (i = 0; i < n; i++)
+			values[i] = (uint32_t)i * spacing;
+		for (i = 0; i < (n / 100) + 1; i++) {
+			const size_t j = stress_mwc32modn((uint32_t)n);
+			const size_t k = STRESS_MINIMUM(j + 1 + stress_mwc8modn(8), n - 1);
+			const uint32_t tmp = values[j];
+
+			values[j] = values[k];
+			values[k] = tmp;
+		}
+		break;
+	default:
+	case STRESS_SORT_DIST_ORGAN_PIPE:
+		for (i = 0; i < n; i++)
+			values[i] = (uint32_t)STRESS_MINIMUM(i, n - 1 - i) * (spacing << 1);
+		break;
+	}
+}
+
+/*
+ *  stress_sort_dist_data()
+ *	turn the 31 bit values into keys of the given type, the
+ *	order of the keys is the order of the values, strings are
+ *	fixed width base 26 digits of the value with a random length
+ *	random suffix
+ */
+static void stress_sort_dist_data(
+	void *data,
+	char *strs,
+	const uint32_t *values,
+	const size_t n,
+	const int type)
+{
+	size_t i;
+
+	switch (type) {
+	case STRESS_SORT_TYPE_INT32:
+		for (i = 0; i < n; i++)
+			((int32_t *)data)[i] = (int32_t)values[i] - 0x40000000;
+		break;
+	case STRESS_SORT_TYPE_UINT64:
+		for (i = 0; i < n; i++)
+			((uint64_t *)data)[i] = ((uint64_t)values[i] << 32) | (values[i] * 2654435761U);
+		break;
+	case STRESS_SORT_TYPE_RECORD:
+		for (i = 0; i < n; i++) {
+			stress_sort_record_t *record = &((stress_sort_record_t *)data)[i];
+
+			record->key = ((uint64_t)values[i] << 32) | (values[i] * 2654435761U);
+			record->payload = (uint64_t)i;
+		}
+		break;
+	default:
+	case STRESS_SORT_TYPE_STRING:
+		for (i = 0; i < n; i++) {
+			char *str = strs + (i * STRESS_SORT_STR_MAX);
+			const size_t len = stress_mwc8modn(STRESS_SORT_STR_MAX - STRESS_SORT_STR_DIGITS);
+			uint32_t v = values[i];
+			size_t j;
+
+			for (j = STRESS_SORT_STR_DIGITS; j > 0; j--) {
+				str[j - 1] = (char)('a' + (v % 26));
+				v /= 26;
+			}
+			for (j = 0; j < len; j++)
+				str[STRESS_SORT_STR_DIGITS + j] = (char)('a' + stress_mwc8modn(26));
+			str[STRESS_SORT_STR_DIGITS + len] = '\0';
+			((char **)data)[i] = str;
+		}
+		break;
+	}
+}
+
+/*
+ *  stress_sort_dists()
+ *	sort n int32, uint64, 16 byte record and variable length string
+ *	keys in random, sorted, reverse, zipf, few-unique, nearly-sorted
+ *	and organ-pipe distributions with sort_func until the run ends,
+ *	each sort is a bogo op, report the comparisons per key of each
+ *	type and distribution and the keys sorted per sec of each type
+ */
+int stress_sort_dists(
+	const stress_args_t *args,
+	const char *name,
+	stress_sort_func_t sort_func,
+	const size_t n)
+{
+	double compares[STRESS_SORT_TYPES][STRESS_SORT_DISTS];
+	double keys[STRESS_SORT_TYPES][STRESS_SORT_DISTS];
+	double durations[STRESS_SORT_TYPES];
+	uint32_t *values;
+	uint8_t *data;
+	char *strs;
+	size_t i;
+	int type, dist, rc = EXIT_SUCCESS;
+
+	values = calloc(n, sizeof(*values));
+	data = calloc(n, sizeof(stress_sort_record_t));
+	strs = calloc(n, STRESS_SORT_STR_MAX);
+	if (!values || !data || !strs) {
+		pr_inf_skip("%s: cannot allocate %zu sort keys, skipping stressor\n",
+			args->name, n);
+		free(strs);
+		free(data);
+		free(values);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(compares, 0, sizeof(compares));
+	(void)memset(keys, 0, sizeof(keys));
+	(void)memset(durations, 0, sizeof(durations));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	while ((rc == EXIT_SUCCESS) && keep_stressing(args)) {
+		for (dist = 0; dist < STRESS_SORT_DISTS; dist++) {
+			stress_sort_dist_values(values, n, dist);
+			for (type = 0; type < STRESS_SORT_TYPES; type++) {
+				const size_t size = stress_sort_type_sizes[type];
+				int (*cmp)(const void *p1, const void *p2) = stress_sort_type_cmps[type];
+				double t;
+
+				stress_sort_dist_data(data, strs, values, n, type);
+				stress_sort_compare_reset();
+				t = stress_time_now();
+				sort_func(data, n, size, cmp);
+				durations[type] += stress_time_now() - t;
+				compares[type][dist] += (double)stress_sort_compare_get();
+				keys[type][dist] += (double)n;
+
+				if (g_opt_flags & OPT_FLAGS_VERIFY) {
+					for (i = 1; i < n; i++) {
+						if (cmp(data + ((i - 1) * size), data + (i * size)) > 0) {
+							pr_fail("%s: %s sort error detected, incorrect "
+								"ordering of %s %s keys found\n",
+								args->name, name, stress_sort_dist_names[dist],
+								stress_sort_type_names[type]);
+							rc = EXIT_FAILURE;
+							break;
+						}
+					}
+				}
+				inc_counter(args);
+				if ((rc != EXIT_SUCCESS) || !keep_stressing(args))
+					goto done;
+			}
+		}
+	}
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %-13s %9s %9s %9s %9s  (%s comparisons per key)\n",
+			args->name, "distribution", stress_sort_type_names[0],
+			stress_sort_type_names[1], stress_sort_type_names[2],
+			stress_sort_type_names[3], name);
+		for (dist = 0; dist < STRESS_SORT_DISTS; dist++) {
+			char per_key[STRESS_SORT_TYPES][16];
+
+			for (type = 0; type < STRESS_SORT_TYPES; type++) {
+				if (keys[type][dist] > 0.0)
+					(void)snprintf(per_key[type], sizeof(per_key[type]), "%.2f",
+						compares[type][dist] / keys[type][dist]);
+				else
+					(void)shim_strlcpy(per_key[type], "-", sizeof(per_key[type]));
+			}
+			pr_inf("%s: %-13s %9s %9s %9s %9s\n", args->name,
+				stress_sort_dist_names[dist], per_key[0], per_key[1],
+				per_key[2], per_key[3]);
+		}
+		pr_unlock();
+	}
+
+	for (i = 0, type = 0; type < STRESS_SORT_TYPES; type++) {
+		double total = 0.0;
+		char str[64];
+
+		for (dist = 0; dist < STRESS_SORT_DISTS; dist++) {
+			if (keys[type][dist] <= 0.0)
+				continue;
+			total += keys[type][dist];
+			(void)snprintf(str, sizeof(str), "%s %s comparisons per key",
+				stress_sort_type_names[type], stress_sort_dist_names[dist]);
+			stress_metrics_set(args, i++, str, compares[type][dist] / keys[type][dist]);
+		}
+		if (durations[type] > 0.0) {
+			(void)snprintf(str, sizeof(str), "%s keys sorted per sec",
+				stress_sort_type_names[type]);
+			stress_metrics_set(args, i++, str, total / durations[type]);
+		}
+	}
+
+	free(strs);
+	free(data);
+	free(values);
+
+	return rc;
+}
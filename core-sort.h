@@ -21,6 +21,15 @@
 
 #include <inttypes.h>
 
+/* 16 byte sort record, ordered by key only */
+typedef struct {
+	uint64_t key;
+	uint64_t payload;
+} stress_sort_record_t;
+
+typedef void (*stress_sort_func_t)(void *base, size_t nmemb, size_t size,
+	int (*cmp)(const void *p1, const void *p2));
+
 extern void stress_sort_data_int32_init(int32_t *data, const size_t n);
 extern void stress_sort_data_int32_shuffle(int32_t *data, const size_t n);
 extern void stress_sort_data_int32_mangle(int32_t *data, const size_t n);
@@ -45,6 +54,13 @@ STRESS_SORT_CMP_REV(int64, int64_t)
 STRESS_SORT_CMP_FWD(int, int)
 STRESS_SORT_CMP_REV(int, int)
 
+STRESS_SORT_CMP_FWD(uint64, uint64_t)
+
+extern int stress_sort_cmp_fwd_record(const void *p1, const void *p2);
+extern int stress_sort_cmp_fwd_string(const void *p1, const void *p2);
+extern int stress_sort_dists(const stress_args_t *args, const char *name,
+	stress_sort_func_t sort_func, const size_t n);
+
 #undef STRESS_SORT_CMP_FWD
 #undef STRESS_SORT_CMP_REV
 
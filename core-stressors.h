@@ -51,12 +51,14 @@
 	MACRO(chroot)		\
 	MACRO(clock)		\
 	MACRO(clone)		\
+	MACRO(cmap)		\
 	MACRO(close)		\
 	MACRO(context)		\
 	MACRO(copy_file)	\
 	MACRO(cpu)		\
 	MACRO(cpu_online)	\
 	MACRO(crypt)		\
+	MACRO(cryptobench)	\
 	MACRO(cyclic)		\
 	MACRO(daemon)		\
 	MACRO(dccp)		\
@@ -67,6 +69,7 @@
 	MACRO(dir)		\
 	MACRO(dirdeep)		\
 	MACRO(dirmany)		\
+	MACRO(dirty)		\
 	MACRO(dnotify)		\
 	MACRO(dup)		\
 	MACRO(dynlib)		\
@@ -81,11 +84,14 @@
 	MACRO(fanotify)		\
 	MACRO(far_branch)	\
 	MACRO(fault)		\
+	MACRO(fault_scale)	\
 	MACRO(fcntl)		\
+	MACRO(fence)		\
 	MACRO(fiemap)		\
 	MACRO(fifo)		\
 	MACRO(file_ioctl)	\
 	MACRO(filename)		\
+	MACRO(filescan)		\
 	MACRO(flock)		\
 	MACRO(flushcache)	\
 	MACRO(fork)		\
@@ -106,6 +112,7 @@
 	MACRO(gpu)		\
 	MACRO(handle)		\
 	MACRO(hash)		\
+	MACRO(hashtable)	\
 	MACRO(hdd)		\
 	MACRO(heapsort)		\
 	MACRO(hrtimers)		\
@@ -126,8 +133,10 @@
 	MACRO(judy)		\
 	MACRO(kcmp)		\
 	MACRO(key)		\
+	MACRO(keysort)		\
 	MACRO(kill)		\
 	MACRO(klog)		\
+	MACRO(ktls)		\
 	MACRO(kvm)		\
 	MACRO(l1cache)		\
 	MACRO(landlock)		\
@@ -152,8 +161,10 @@
 	MACRO(memcpy)		\
 	MACRO(memfd)		\
 	MACRO(memhotplug)	\
+	MACRO(memlat)		\
 	MACRO(memrate)		\
 	MACRO(memthrash)	\
+	MACRO(memtier)		\
 	MACRO(mergesort)	\
 	MACRO(mincore)		\
 	MACRO(misaligned)	\
@@ -188,6 +199,7 @@
 	MACRO(open)		\
 	MACRO(pagemove)		\
 	MACRO(pageswap)		\
+	MACRO(pathwalk)		\
 	MACRO(pci)		\
 	MACRO(personality)	\
 	MACRO(peterson)		\
@@ -197,11 +209,13 @@
 	MACRO(pipe)		\
 	MACRO(pipeherd)		\
 	MACRO(pkey)		\
+	MACRO(pktring)		\
 	MACRO(plugin)		\
 	MACRO(poll)		\
 	MACRO(prctl)		\
 	MACRO(prefetch)		\
 	MACRO(priv_instr)	\
+	MACRO(proc_create)	\
 	MACRO(procfs)		\
 	MACRO(pthread)		\
 	MACRO(ptrace)		\
@@ -219,9 +233,11 @@
 	MACRO(rdrand)		\
 	MACRO(readahead)	\
 	MACRO(reboot)		\
+	MACRO(reclaim)		\
 	MACRO(regs)		\
 	MACRO(remap)		\
 	MACRO(rename)		\
+	MACRO(replay)		\
 	MACRO(resched)		\
 	MACRO(resources)	\
 	MACRO(revio)		\
@@ -245,6 +261,7 @@
 	MACRO(shellsort)	\
 	MACRO(shm)		\
 	MACRO(shm_sysv)		\
+	MACRO(shmring)		\
 	MACRO(sigabrt)		\
 	MACRO(sigchld)		\
 	MACRO(sigfd)		\
@@ -271,7 +288,9 @@
 	MACRO(softlockup)	\
 	MACRO(spawn)		\
 	MACRO(sparsematrix)	\
+	MACRO(spinlock)		\
 	MACRO(splice)		\
+	MACRO(spmv)		\
 	MACRO(stack)		\
 	MACRO(stackmmap)	\
 	MACRO(str)		\
@@ -282,6 +301,7 @@
 	MACRO(sync_file)	\
 	MACRO(syncload)		\
 	MACRO(sysbadaddr)	\
+	MACRO(sysbatch)		\
 	MACRO(syscall)		\
 	MACRO(sysinfo)		\
 	MACRO(sysinval)		\
@@ -307,6 +327,7 @@
 	MACRO(utime)		\
 	MACRO(vdso)		\
 	MACRO(vecfp)		\
+	MACRO(vecfreq)		\
 	MACRO(vecmath)		\
 	MACRO(vecshuf)		\
 	MACRO(vecwide)		\
@@ -320,8 +341,11 @@
 	MACRO(vm_splice)	\
 	MACRO(wait)		\
 	MACRO(waitcpu)		\
+	MACRO(wakelat)		\
+	MACRO(wal)		\
 	MACRO(watchdog)		\
 	MACRO(wcs)		\
+	MACRO(worksteal)	\
 	MACRO(x86cpuid)		\
 	MACRO(x86syscall)	\
 	MACRO(xattr)		\
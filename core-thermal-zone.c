@@ -261,8 +261,12 @@ void stress_tz_dump(FILE *yaml, stress_stressor_t *stressors_list)
 			tz_info = tz_infos[i];
 
 			for (j = 0; j < ss->started_instances; j++) {
-				const uint64_t temp =
-					ss->stats[j]->tz.tz_stat[tz_info->index].temperature;
+				const stress_tz_t *tz = ss->stats[j]->tz;
+				uint64_t temp;
+
+				if (!tz)
+					continue;
+				temp = tz->tz_stat[tz_info->index].temperature;
 				/* Avoid crazy temperatures. e.g. > 250 C */
 				if (temp <= 250000) {
 					total += temp;
@@ -452,3 +452,19 @@ int stress_pagein_self(const char *name)
 	return 0;
 }
 #endif
+
+/*
+ *  stress_drop_page_cache()
+ *	drop clean page cache pages system wide, needs root,
+ *	returns 0 if the page cache was dropped, -errno otherwise
+ */
+int stress_drop_page_cache(void)
+{
+#if defined(__linux__)
+	const ssize_t ret = system_write("/proc/sys/vm/drop_caches", "1", 1);
+
+	return (ret < 0) ? (int)ret : 0;
+#else
+	return -ENOSYS;
+#endif
+}
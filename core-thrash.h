@@ -23,4 +23,7 @@
 extern int  stress_thrash_start(void);
 extern void stress_thrash_stop(void);
 
+/* page cache dropping helper */
+extern int  stress_drop_page_cache(void);
+
 #endif
@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-throttle.h"
+
+#define THROTTLE_SAMPLE_MS	(100)	/* sampling interval */
+#define THROTTLE_EVENTS_MAX	(64)	/* time stamped throttle events kept */
+
+#define MSR_IA32_PACKAGE_THERM_STATUS	(0x1b1)
+#define PACKAGE_THERM_STATUS_PROCHOT	STRESS_BIT_ULL(0)	/* thermal throttling active */
+#define PACKAGE_THERM_STATUS_POWER_LIMIT STRESS_BIT_ULL(10)	/* power limit throttling active */
+
+#define THROTTLE_CAUSE_THERMAL		(0x01)	/* throttle count increased or PROCHOT */
+#define THROTTLE_CAUSE_POWER_LIMIT	(0x02)	/* package power limit active */
+
+/* a throttled sampling interval, merged with throttled intervals before it */
+typedef struct {
+	double begin;		/* seconds since the start of sampling */
+	double end;
+	uint64_t count;		/* throttle count increase */
+	int cause;		/* THROTTLE_CAUSE_* flags */
+} stress_throttle_event_t;
+
+/* bogo ops and time of a stressor before and during throttling */
+typedef struct {
+	uint64_t ops_before;	/* before the first throttle event */
+	double time_before;
+	uint64_t ops_during;	/* in throttled intervals */
+	double time_during;
+	uint64_t ops_after;	/* in unthrottled intervals after the first event */
+	double time_after;
+} stress_throttle_rate_t;
+
+/* shared between the sampler process and stress-ng */
+typedef struct {
+	double duration;			/* time sampled over */
+	double first;				/* time of first throttle, < 0 if none */
+	uint64_t count;				/* total throttle count increase */
+	uint32_t samples;
+	uint32_t throttled_samples;
+	uint32_t power_limited_samples;
+	uint32_t events_num;
+	uint32_t events_dropped;
+	stress_throttle_event_t events[THROTTLE_EVENTS_MAX];
+	stress_throttle_rate_t rates[];		/* per stressor */
+} stress_throttle_t;
+
+#if defined(__linux__)
+
+static stress_throttle_t *throttle;
+static size_t throttle_size;
+static pid_t throttle_pid = -1;
+static bool throttle_counts;		/* thermal_throttle counts are available */
+static bool throttle_msr;		/* package thermal status msr is readable */
+
+/*
+ *  stress_throttle_count()
+ *	total of the core and package thermal throttle counts
+ *	of all the cpus, returns false if there are none
+ */
+static bool stress_throttle_count(uint64_t *total)
+{
+	static const char * const counts[] = {
+		"core_throttle_count",
+		"package_throttle_count",
+	};
+	const int32_t cpus = stress_get_processors_configured();
+	int32_t cpu;
+	bool found = false;
+
+	*total = 0;
+	for (cpu = 0; cpu < cpus; cpu++) {
+		size_t i;
+
+		for (i = 0; i < SIZEOF_ARRAY(counts); i++) {
+			char path[PATH_MAX], buf[32];
+			uint64_t count;
+
+			(void)snprintf(path, sizeof(path),
+				"/sys/devices/system/cpu/cpu%" PRId32 "/thermal_throttle/%s",
+				cpu, counts[i]);
+			if ((system_read(path, buf, sizeof(buf)) > 0) &&
+			    (sscanf(buf, "%" SCNu64, &count) == 1)) {
+				*total += count;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+/*
+ *  stress_throttle_status()
+ *	read the thermal and power limit throttle status of the
+ *	package, returns THROTTLE_CAUSE_* flags of active throttling
+ *	or -1 if the status cannot be read
+ */
+static int stress_throttle_status(const int fd)
+{
+#if defined(STRESS_ARCH_X86)
+	uint64_t status;
+
+	if ((fd < 0) ||
+	    (pread(fd, &status, sizeof(status), MSR_IA32_PACKAGE_THERM_STATUS) != sizeof(status)))
+		return -1;
+	return ((status & PACKAGE_THERM_STATUS_PROCHOT) ? THROTTLE_CAUSE_THERMAL : 0) |
+	       ((status & PACKAGE_THERM_STATUS_POWER_LIMIT) ? THROTTLE_CAUSE_POWER_LIMIT : 0);
+#else
+	(void)fd;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_throttle_ops()
+ *	total bogo ops of the running instances of a stressor,
+ *	returns false if no instances are running
+ */
+static bool stress_throttle_ops(const stress_stressor_t *ss, uint64_t *ops)
+{
+	int32_t j;
+	bool running = false;
+
+	*ops = 0;
+	if (!ss->stats)
+		return false;
+	for (j = 0; j < ss->num_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		if ((stats->start > 0.0) && (stats->finish <= stats->start))
+			running = true;
+		*ops += stats->ci.counter;
+	}
+	return running;
+}
+
+/*
+ *  stress_throttle_event()
+ *	time stamp a throttled interval, intervals that follow
+ *	on from the previous event are merged into it
+ */
+static void stress_throttle_event(
+	const double begin,
+	const double end,
+	const uint64_t count,
+	const int cause)
+{
+	stress_throttle_event_t *event;
+
+	if (throttle->events_num) {
+		event = &throttle->events[throttle->events_num - 1];
+		if (event->end >= begin) {
+			event->end = end;
+			event->count += count;
+			event->cause |= cause;
+			return;
+		}
+	}
+	if (throttle->events_num >= THROTTLE_EVENTS_MAX) {
+		throttle->events_dropped++;
+		return;
+	}
+	event = &throttle->events[throttle->events_num++];
+	event->begin = begin;
+	event->end = end;
+	event->count = count;
+	event->cause = cause;
+}
+
+/*
+ *  stress_throttle_sampler()
+ *	sample the throttle counts, the package throttle status
+ *	and the bogo ops of each stressor every THROTTLE_SAMPLE_MS
+ */
+static void NORETURN stress_throttle_sampler(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	uint64_t *prev_ops, count_prev = 0;
+	double t_start, t_prev, t_next;
+	size_t n, num_stressors = 0;
+	int fd = -1;
+
+	stress_set_proc_name("stat [throttle]");
+	for (ss = stressors_list; ss; ss = ss->next)
+		num_stressors++;
+	prev_ops = calloc(num_stressors, sizeof(*prev_ops));
+	if (!prev_ops)
+		_exit(EXIT_FAILURE);
+	if (throttle_msr)
+		fd = open("/dev/cpu/0/msr", O_RDONLY);
+	(void)stress_throttle_count(&count_prev);
+
+	t_start = stress_time_now();
+	t_prev = t_start;
+	t_next = t_start;
+	for (;;) {
+		double t_now, t_delta;
+		uint64_t count = 0, count_delta;
+		int cause;
+
+		t_next += (double)THROTTLE_SAMPLE_MS / 1000.0;
+		t_delta = t_next - stress_time_now();
+		if (t_delta > 0.0)
+			(void)shim_nanosleep_uint64((uint64_t)(t_delta * STRESS_DBL_NANOSECOND));
+
+		t_now = stress_time_now();
+		t_delta = t_now - t_prev;
+		(void)stress_throttle_count(&count);
+		count_delta = (count >= count_prev) ? count - count_prev : 0;
+		count_prev = count;
+		cause = stress_throttle_status(fd);
+		if (cause < 0)
+			cause = 0;
+		if (count_delta)
+			cause |= THROTTLE_CAUSE_THERMAL;
+
+		throttle->samples++;
+		if (cause & THROTTLE_CAUSE_POWER_LIMIT)
+			throttle->power_limited_samples++;
+		if (cause) {
+			throttle->throttled_samples++;
+			throttle->count += count_delta;
+			if (throttle->first < 0.0)
+				throttle->first = t_prev - t_start;
+			stress_throttle_event(t_prev - t_start, t_now - t_start, count_delta, cause);
+		}
+
+		for (n = 0, ss = stressors_list; ss; ss = ss->next, n++) {
+			stress_throttle_rate_t *rate = &throttle->rates[n];
+			uint64_t ops;
+			const bool running = stress_throttle_ops(ss, &ops);
+
+			/* counters are reset when the stressors are run again */
+			if (running && (ops >= prev_ops[n])) {
+				const uint64_t ops_delta = ops - prev_ops[n];
+
+				if (cause) {
+					rate->ops_during += ops_delta;
+					rate->time_during += t_delta;
+				} else if (throttle->first < 0.0) {
+					rate->ops_before += ops_delta;
+					rate->time_before += t_delta;
+				} else {
+					rate->ops_after += ops_delta;
+					rate->time_after += t_delta;
+				}
+			}
+			prev_ops[n] = ops;
+		}
+		throttle->duration = t_now - t_start;
+		t_prev = t_now;
+	}
+}
+
+/*
+ *  stress_throttle_start()
+ *	start the throttle sampler process
+ */
+void stress_throttle_start(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t num_stressors = 0;
+	uint64_t count;
+	int fd;
+
+	if (!(g_opt_flags & OPT_FLAGS_THROTTLE))
+		return;
+
+	throttle_counts = stress_throttle_count(&count);
+	fd = open("/dev/cpu/0/msr", O_RDONLY);
+	throttle_msr = (stress_throttle_status(fd) >= 0);
+	if (fd >= 0)
+		(void)close(fd);
+	if (!throttle_counts && !throttle_msr) {
+		pr_inf("throttle: no thermal_throttle counts in sysfs and cannot read "
+			"the package thermal status msr, throttling cannot be detected\n");
+		return;
+	}
+	if (!throttle_msr)
+		pr_inf("throttle: cannot read the package thermal status msr, power limit "
+			"throttling will not be detected (load the msr driver and run as root)\n");
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		num_stressors++;
+	throttle_size = sizeof(*throttle) + num_stressors * sizeof(stress_throttle_rate_t);
+	throttle = (stress_throttle_t *)mmap(NULL, throttle_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANON, -1, 0);
+	if (throttle == MAP_FAILED) {
+		pr_inf("throttle: cannot mmap throttle data, errno=%d (%s), disabling --throttle\n",
+			errno, strerror(errno));
+		throttle = NULL;
+		return;
+	}
+	(void)memset(throttle, 0, throttle_size);
+	throttle->first = -1.0;
+
+	throttle_pid = fork();
+	if (throttle_pid < 0) {
+		pr_inf("throttle: cannot fork sampler, errno=%d (%s), disabling --throttle\n",
+			errno, strerror(errno));
+		return;
+	}
+	if (throttle_pid == 0)
+		stress_throttle_sampler(stressors_list);
+}
+
+/*
+ *  stress_throttle_stop()
+ *	stop the throttle sampler process
+ */
+void stress_throttle_stop(void)
+{
+	if (throttle_pid > 0) {
+		int status;
+
+		(void)kill(throttle_pid, SIGKILL);
+		(void)waitpid(throttle_pid, &status, 0);
+		throttle_pid = -1;
+	}
+}
+
+/*
+ *  stress_throttle_cause()
+ *	name of throttle causes
+ */
+static const char *stress_throttle_cause(const int cause)
+{
+	switch (cause) {
+	case THROTTLE_CAUSE_THERMAL:
+		return "thermal";
+	case THROTTLE_CAUSE_POWER_LIMIT:
+		return "power-limit";
+	case THROTTLE_CAUSE_THERMAL | THROTTLE_CAUSE_POWER_LIMIT:
+		return "thermal+power-limit";
+	default:
+		return "none";
+	}
+}
+
+/*
+ *  stress_throttle_dump()
+ *	dump the throttle events and the bogo ops rate of each
+ *	stressor before and during throttling
+ */
+void stress_throttle_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	size_t n;
+	uint32_t i;
+
+	if (!throttle || !throttle->samples)
+		return;
+
+	pr_yaml(yaml, "throttle:\n");
+	pr_yaml(yaml, "      duration: %f\n", throttle->duration);
+	pr_yaml(yaml, "      throttled-percent: %f\n",
+		100.0 * (double)throttle->throttled_samples / (double)throttle->samples);
+	pr_yaml(yaml, "      power-limited-percent: %f\n",
+		100.0 * (double)throttle->power_limited_samples / (double)throttle->samples);
+	pr_yaml(yaml, "      throttle-count: %" PRIu64 "\n", throttle->count);
+
+	if (throttle->first < 0.0) {
+		pr_inf("throttle: no throttling detected in %.2f seconds\n", throttle->duration);
+		pr_yaml(yaml, "\n");
+		return;
+	}
+
+	pr_inf("throttle: first throttled at %.2f seconds, throttled %.2f%% of "
+		"%.2f seconds (%.2f%% power limited), %" PRIu64 " throttle events\n",
+		throttle->first,
+		100.0 * (double)throttle->throttled_samples / (double)throttle->samples,
+		throttle->duration,
+		100.0 * (double)throttle->power_limited_samples / (double)throttle->samples,
+		throttle->count);
+	pr_yaml(yaml, "      first-throttle-time: %f\n", throttle->first);
+	pr_yaml(yaml, "      events:\n");
+	for (i = 0; i < throttle->events_num; i++) {
+		const stress_throttle_event_t *event = &throttle->events[i];
+
+		pr_dbg("throttle: %.2f - %.2f seconds, %s, %" PRIu64 " throttle events\n",
+			event->begin, event->end, stress_throttle_cause(event->cause), event->count);
+		pr_yaml(yaml, "        - begin: %f\n", event->begin);
+		pr_yaml(yaml, "          end: %f\n", event->end);
+		pr_yaml(yaml, "          cause: %s\n", stress_throttle_cause(event->cause));
+		pr_yaml(yaml, "          count: %" PRIu64 "\n", event->count);
+	}
+	if (throttle->events_dropped)
+		pr_inf("throttle: only the first %d throttle periods were time stamped\n",
+			THROTTLE_EVENTS_MAX);
+
+	pr_inf("throttle: %-13s %13s %13s %13s %8s\n",
+		"stressor", "before ops/s", "during ops/s", "after ops/s", "loss%");
+	pr_yaml(yaml, "      stressors:\n");
+	for (n = 0, ss = stressors_list; ss; ss = ss->next, n++) {
+		const stress_throttle_rate_t *rate = &throttle->rates[n];
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		const double before = rate->time_before > 0.0 ?
+			(double)rate->ops_before / rate->time_before : 0.0;
+		const double during = rate->time_during > 0.0 ?
+			(double)rate->ops_during / rate->time_during : 0.0;
+		const double after = rate->time_after > 0.0 ?
+			(double)rate->ops_after / rate->time_after : 0.0;
+		char loss[16];
+
+		if ((rate->time_before <= 0.0) && (rate->time_during <= 0.0))
+			continue;
+		if ((before > 0.0) && (rate->time_during > 0.0))
+			(void)snprintf(loss, sizeof(loss), "%.2f", 100.0 * (1.0 - during / before));
+		else
+			(void)shim_strlcpy(loss, "-", sizeof(loss));
+		pr_inf("throttle: %-13s %13.2f %13.2f %13.2f %8s\n",
+			munged, before, during, after, loss);
+
+		pr_yaml(yaml, "        - stressor: %s\n", munged);
+		pr_yaml(yaml, "          before-throttle-time: %f\n", rate->time_before);
+		pr_yaml(yaml, "          before-throttle-bogo-ops-per-second: %f\n", before);
+		pr_yaml(yaml, "          during-throttle-time: %f\n", rate->time_during);
+		pr_yaml(yaml, "          during-throttle-bogo-ops-per-second: %f\n", during);
+		pr_yaml(yaml, "          after-throttle-time: %f\n", rate->time_after);
+		pr_yaml(yaml, "          after-throttle-bogo-ops-per-second: %f\n", after);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_throttle_free()
+ *	unmap the throttle data
+ */
+void stress_throttle_free(void)
+{
+	if (throttle) {
+		(void)munmap((void *)throttle, throttle_size);
+		throttle = NULL;
+	}
+}
+
+#else
+void stress_throttle_start(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+
+	if (g_opt_flags & OPT_FLAGS_THROTTLE)
+		pr_inf("throttle: throttle detection is only supported on Linux, ignoring --throttle\n");
+}
+
+void stress_throttle_stop(void)
+{
+}
+
+void stress_throttle_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	(void)yaml;
+	(void)stressors_list;
+}
+
+void stress_throttle_free(void)
+{
+}
+#endif
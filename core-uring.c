@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-uring.h"
+
+#if defined(STRESS_URING)
+
+#define URING_ADDR_OFFSET(addr, offset)	\
+	((void *)(((uint8_t *)addr) + offset))
+
+static int shim_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int shim_io_uring_enter(
+	int fd,
+	unsigned int to_submit,
+	unsigned int min_complete,
+	unsigned int flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit,
+		min_complete, flags, NULL, 0);
+}
+
+/*
+ *  stress_uring_close()
+ *	unmap and close the rings
+ */
+void stress_uring_close(stress_uring_t *ring)
+{
+	if (ring->sqes)
+		(void)munmap((void *)ring->sqes, ring->sqes_size);
+	if (ring->cq_mmap && (ring->cq_mmap != ring->sq_mmap))
+		(void)munmap(ring->cq_mmap, ring->cq_size);
+	if (ring->sq_mmap)
+		(void)munmap(ring->sq_mmap, ring->sq_size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+	(void)memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*
+ *  stress_uring_setup()
+ *	create an io uring of the given number of entries
+ */
+int stress_uring_setup(
+	const stress_args_t *args,
+	stress_uring_t *ring,
+	const unsigned entries)
+{
+	struct io_uring_params p;
+
+	(void)memset(ring, 0, sizeof(*ring));
+	(void)memset(&p, 0, sizeof(p));
+	ring->fd = shim_io_uring_setup(entries, &p);
+	if (ring->fd < 0) {
+		if (errno == ENOSYS) {
+			pr_inf_skip("%s: io-uring not supported by the kernel, "
+				"skipping stressor\n", args->name);
+			return EXIT_NOT_IMPLEMENTED;
+		}
+		pr_inf_skip("%s: io-uring setup failed, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->sq_size)
+			ring->sq_size = ring->cq_size;
+		ring->cq_size = ring->sq_size;
+	}
+
+	ring->sq_mmap = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_mmap == MAP_FAILED) {
+		ring->sq_mmap = NULL;
+		goto err;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_mmap = ring->sq_mmap;
+	} else {
+		ring->cq_mmap = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_mmap == MAP_FAILED) {
+			ring->cq_mmap = NULL;
+			goto err;
+		}
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto err;
+	}
+
+	ring->sq_head = URING_ADDR_OFFSET(ring->sq_mmap, p.sq_off.head);
+	ring->sq_tail = URING_ADDR_OFFSET(ring->sq_mmap, p.sq_off.tail);
+	ring->sq_mask = URING_ADDR_OFFSET(ring->sq_mmap, p.sq_off.ring_mask);
+	ring->sq_array = URING_ADDR_OFFSET(ring->sq_mmap, p.sq_off.array);
+	ring->cq_head = URING_ADDR_OFFSET(ring->cq_mmap, p.cq_off.head);
+	ring->cq_tail = URING_ADDR_OFFSET(ring->cq_mmap, p.cq_off.tail);
+	ring->cq_mask = URING_ADDR_OFFSET(ring->cq_mmap, p.cq_off.ring_mask);
+	ring->cqes = URING_ADDR_OFFSET(ring->cq_mmap, p.cq_off.cqes);
+
+	return EXIT_SUCCESS;
+err:
+	pr_inf_skip("%s: could not mmap io-uring rings, errno=%d (%s), "
+		"skipping stressor\n", args->name, errno, strerror(errno));
+	stress_uring_close(ring);
+	return EXIT_NO_RESOURCE;
+}
+
+/*
+ *  stress_uring_enter()
+ *	submit to_submit queued sqes and wait for min_complete cqes
+ */
+int stress_uring_enter(
+	const stress_uring_t *ring,
+	const unsigned to_submit,
+	const unsigned min_complete)
+{
+	return shim_io_uring_enter(ring->fd, to_submit, min_complete,
+		min_complete ? IORING_ENTER_GETEVENTS : 0);
+}
+#endif
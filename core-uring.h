@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef CORE_URING_H
+#define CORE_URING_H
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) &&	\
+    defined(HAVE_SYSCALL) &&		\
+    defined(__NR_io_uring_enter) &&	\
+    defined(__NR_io_uring_setup) &&	\
+    defined(IORING_OFF_SQ_RING) &&	\
+    defined(IORING_OFF_CQ_RING) &&	\
+    defined(IORING_OFF_SQES) &&		\
+    defined(IORING_ENTER_GETEVENTS)
+#define STRESS_URING
+
+/*
+ *  minimal io uring for stressors that just need to queue
+ *  sqes and reap cqes without the full stress-io-uring setup
+ */
+typedef struct {
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	struct io_uring_sqe *sqes;
+	void *sq_mmap;
+	void *cq_mmap;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+	int fd;
+} stress_uring_t;
+
+extern int stress_uring_setup(const stress_args_t *args, stress_uring_t *ring,
+	const unsigned entries);
+extern void stress_uring_close(stress_uring_t *ring);
+extern int stress_uring_enter(const stress_uring_t *ring,
+	const unsigned to_submit, const unsigned min_complete);
+#endif
+
+#endif
@@ -101,9 +101,32 @@ typedef struct {
 	uint64_t	discard_ticks;	/* total wait time for discard requests */
 } stress_iostat_t;
 
+/* pressure stall information of one resource */
+typedef struct {
+	double		some_avg10;	/* % some tasks stalled, 10 sec avg */
+	double		full_avg10;	/* % all tasks stalled, 10 sec avg */
+	uint64_t	some_total;	/* usecs some tasks stalled */
+	uint64_t	full_total;	/* usecs all tasks stalled */
+	bool		some;		/* some row was read */
+	bool		full;		/* full row was read */
+} stress_psi_t;
+
+#define STRESS_PSI_MAX	(3)
+
+static const char * const psi_resources[STRESS_PSI_MAX] = {
+	"cpu", "memory", "io"
+};
+
 static int32_t vmstat_delay = 0;
 static int32_t thermalstat_delay = 0;
 static int32_t iostat_delay = 0;
+static int32_t psistat_delay = 0;
+
+static char psi_path[PATH_MAX];		/* directory of the pressure files */
+static bool psi_cgroup;			/* psi_path is a cgroup v2 directory */
+static stress_psi_t psi_begin[STRESS_PSI_MAX];
+static double psi_begin_time;
+static bool psi_begun;
 
 #if defined(__FreeBSD__)
 static void freebsd_get_cpu_time(
@@ -183,6 +206,11 @@ int stress_set_iostat(const char *const opt)
 	return stress_set_generic_stat(opt, "iostat", &iostat_delay);
 }
 
+int stress_set_psistat(const char *const opt)
+{
+	return stress_set_generic_stat(opt, "psistat", &psistat_delay);
+}
+
 /*
  *  stress_find_mount_dev()
  *	find the path of the device that the file is located on
@@ -283,8 +311,238 @@ char *stress_find_mount_dev(const char *name)
 #endif
 }
 
+/*
+ *  stress_get_interrupts()
+ *	sum the per CPU counts of the /proc/interrupts row
+ *	labelled name, e.g. "TLB", returns -1 if there is
+ *	no such row
+ */
+int stress_get_interrupts(const char *name, uint64_t *count)
+{
+#if defined(__linux__)
+	FILE *fp;
+	char label[64], want[64];
+	int rc = -1;
+
+	*count = 0;
+	(void)snprintf(want, sizeof(want), "%s:", name);
+	fp = fopen("/proc/interrupts", "r");
+	if (!fp)
+		return -1;
+
+	while (fscanf(fp, "%63s", label) == 1) {
+		if (!strcmp(label, want)) {
+			uint64_t val;
+
+			while (fscanf(fp, "%" SCNu64, &val) == 1)
+				*count += val;
+			rc = 0;
+			break;
+		}
+		/* skip the rest of the row */
+		if (fscanf(fp, "%*[^\n]") == EOF)
+			break;
+	}
+	(void)fclose(fp);
+
+	return rc;
+#else
+	(void)name;
+
+	*count = 0;
+	return -1;
+#endif
+}
+
 static pid_t vmstat_pid;
 
+#if defined(__linux__)
+/*
+ *  stress_psi_find_path()
+ *	find where the pressure files are, when running in a cgroup
+ *	other than the cgroup v2 root use the per cgroup pressure so
+ *	that the stalls seen are those of the cgroup stress-ng is in,
+ *	otherwise fall back to the system wide /proc/pressure
+ */
+static void stress_psi_find_path(void)
+{
+	FILE *fp;
+	char buffer[PATH_MAX], mount[PATH_MAX], cgroup[PATH_MAX];
+	char path[PATH_MAX + 16];
+
+	psi_cgroup = false;
+	shim_strlcpy(psi_path, "/proc/pressure", sizeof(psi_path));
+
+	*mount = '\0';
+	fp = fopen("/proc/self/mounts", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char dir[PATH_MAX], type[32];
+
+		if (sscanf(buffer, "%*s %4095s %31s", dir, type) != 2)
+			continue;
+		if (!strcmp(type, "cgroup2")) {
+			shim_strlcpy(mount, dir, sizeof(mount));
+			break;
+		}
+	}
+	(void)fclose(fp);
+	if (!*mount)
+		return;
+
+	/* the cgroup v2 entry is 0::/path */
+	*cgroup = '\0';
+	fp = fopen("/proc/self/cgroup", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		if (!strncmp(buffer, "0::", 3)) {
+			(void)sscanf(buffer + 3, "%4095s", cgroup);
+			break;
+		}
+	}
+	(void)fclose(fp);
+	if (!*cgroup || !strcmp(cgroup, "/"))
+		return;
+
+	(void)snprintf(path, sizeof(path), "%s%s/cpu.pressure", mount, cgroup);
+	if (access(path, R_OK) < 0)
+		return;
+	(void)snprintf(psi_path, sizeof(psi_path), "%s%s", mount, cgroup);
+	psi_cgroup = true;
+}
+
+/*
+ *  stress_read_psi()
+ *	read the pressure stall information of the cpu, memory and
+ *	io resources, returns the number of resources read
+ */
+static int stress_read_psi(stress_psi_t psi[STRESS_PSI_MAX])
+{
+	int i, n = 0;
+
+	(void)memset(psi, 0, sizeof(*psi) * STRESS_PSI_MAX);
+
+	for (i = 0; i < STRESS_PSI_MAX; i++) {
+		FILE *fp;
+		char path[PATH_MAX + 16];
+		char buffer[256];
+
+		(void)snprintf(path, sizeof(path), "%s/%s%s", psi_path,
+			psi_resources[i], psi_cgroup ? ".pressure" : "");
+		fp = fopen(path, "r");
+		if (!fp)
+			continue;
+		/* some avg10=0.00 avg60=0.00 avg300=0.00 total=0 */
+		while (fgets(buffer, sizeof(buffer), fp)) {
+			double avg10;
+			uint64_t total;
+
+			if (sscanf(buffer + 4, " avg10=%lf avg60=%*f avg300=%*f total=%" SCNu64,
+				   &avg10, &total) != 2)
+				continue;
+			if (!strncmp(buffer, "some", 4)) {
+				psi[i].some_avg10 = avg10;
+				psi[i].some_total = total;
+				psi[i].some = true;
+			} else if (!strncmp(buffer, "full", 4)) {
+				psi[i].full_avg10 = avg10;
+				psi[i].full_total = total;
+				psi[i].full = true;
+			}
+		}
+		(void)fclose(fp);
+		n++;
+	}
+	return n;
+}
+#else
+static void stress_psi_find_path(void)
+{
+	psi_cgroup = false;
+	*psi_path = '\0';
+}
+
+static int stress_read_psi(stress_psi_t psi[STRESS_PSI_MAX])
+{
+	(void)memset(psi, 0, sizeof(*psi) * STRESS_PSI_MAX);
+	return 0;
+}
+#endif
+
+/*
+ *  stress_psi_delta()
+ *	usecs stalled between the prev and current totals
+ */
+static inline uint64_t stress_psi_delta(const uint64_t current, const uint64_t prev)
+{
+	return (current > prev) ? current - prev : 0;
+}
+
+/*
+ *  stress_psi_start()
+ *	take the pressure stall totals at the start of the run
+ */
+void stress_psi_start(void)
+{
+	stress_psi_find_path();
+	psi_begun = (stress_read_psi(psi_begin) > 0);
+	psi_begin_time = stress_time_now();
+}
+
+/*
+ *  stress_psi_dump()
+ *	dump the pressure stall averages at the end of the run and
+ *	the stall times over the run
+ */
+void stress_psi_dump(FILE *yaml)
+{
+	stress_psi_t psi_end[STRESS_PSI_MAX];
+	double duration;
+	int i;
+
+	if (!psi_begun || (stress_read_psi(psi_end) == 0))
+		return;
+	duration = stress_time_now() - psi_begin_time;
+	if (duration <= 0.0)
+		return;
+
+	if (psistat_delay > 0) {
+		pr_inf("psi: pressure stalls over the %.2fs run (%s):\n",
+			duration, psi_path);
+		pr_inf("psi: %-8s %8s %8s %12s %12s\n",
+			"resource", "some %", "full %", "some usecs", "full usecs");
+	}
+	pr_yaml(yaml, "psi:\n");
+	pr_yaml(yaml, "      source: %s\n", psi_path);
+	pr_yaml(yaml, "      run-time: %f\n", duration);
+
+	for (i = 0; i < STRESS_PSI_MAX; i++) {
+		const uint64_t some = stress_psi_delta(psi_end[i].some_total, psi_begin[i].some_total);
+		const uint64_t full = stress_psi_delta(psi_end[i].full_total, psi_begin[i].full_total);
+		const double usecs = duration * STRESS_DBL_MICROSECOND;
+		const char *name = psi_resources[i];
+
+		if (!psi_end[i].some)
+			continue;
+		if (psistat_delay > 0) {
+			pr_inf("psi: %-8s %8.2f %8.2f %12" PRIu64 " %12" PRIu64 "\n",
+				name, 100.0 * (double)some / usecs,
+				100.0 * (double)full / usecs, some, full);
+		}
+		pr_yaml(yaml, "      %s-some-avg10: %f\n", name, psi_end[i].some_avg10);
+		pr_yaml(yaml, "      %s-some-stall-usecs: %" PRIu64 "\n", name, some);
+		pr_yaml(yaml, "      %s-some-stall-percent: %f\n", name, 100.0 * (double)some / usecs);
+		if (psi_end[i].full) {
+			pr_yaml(yaml, "      %s-full-avg10: %f\n", name, psi_end[i].full_avg10);
+			pr_yaml(yaml, "      %s-full-stall-usecs: %" PRIu64 "\n", name, full);
+			pr_yaml(yaml, "      %s-full-stall-percent: %f\n", name, 100.0 * (double)full / usecs);
+		}
+	}
+	pr_yaml(yaml, "\n");
+}
+
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
 
@@ -880,7 +1138,7 @@ static void stress_zero_cpu_ghz(
  *  stress_get_cpu_ghz()
  *	get CPU frequencies in GHz
  */
-static void stress_get_cpu_ghz(
+void stress_get_cpu_ghz(
 	double *avg_ghz,
 	double *min_ghz,
 	double *max_ghz)
@@ -933,7 +1191,7 @@ static void stress_get_cpu_ghz(
 }
 #elif defined(__FreeBSD__) ||	\
       defined(__APPLE__)
-static void stress_get_cpu_ghz(
+void stress_get_cpu_ghz(
 	double *avg_ghz,
 	double *min_ghz,
 	double *max_ghz)
@@ -975,7 +1233,7 @@ static void stress_get_cpu_ghz(
 	}
 }
 #else
-static void stress_get_cpu_ghz(
+void stress_get_cpu_ghz(
 	double *avg_ghz,
 	double *min_ghz,
 	double *max_ghz)
@@ -993,7 +1251,8 @@ void stress_vmstat_start(void)
 	stress_vmstat_t vmstat;
 	size_t tz_num = 0;
 	stress_tz_info_t *tz_info;
-	int32_t vmstat_sleep, thermalstat_sleep, iostat_sleep;
+	int32_t vmstat_sleep, thermalstat_sleep, iostat_sleep, psistat_sleep;
+	stress_psi_t psi_prev[STRESS_PSI_MAX];
 	double t1, t2;
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
@@ -1003,12 +1262,14 @@ void stress_vmstat_start(void)
 
 	if ((vmstat_delay == 0) &&
 	    (thermalstat_delay == 0) &&
-	    (iostat_delay == 0))
+	    (iostat_delay == 0) &&
+	    (psistat_delay == 0))
 		return;
 
 	vmstat_sleep = vmstat_delay;
 	thermalstat_sleep = thermalstat_delay;
 	iostat_sleep = iostat_delay;
+	psistat_sleep = psistat_delay;
 
 	vmstat_pid = fork();
 	if ((vmstat_pid < 0) || (vmstat_pid > 0))
@@ -1031,6 +1292,14 @@ void stress_vmstat_start(void)
 	if (iostat_delay)
 		stress_get_iostat(iostat_name, &iostat);
 #endif
+	if (psistat_delay) {
+		if (stress_read_psi(psi_prev) == 0) {
+			pr_inf("psi: pressure stall information not available, ignoring --psistat\n");
+			psistat_delay = 0;
+		} else {
+			pr_inf("psi: using pressure stall information in %s\n", psi_path);
+		}
+	}
 
 #if defined(SCHED_DEADLINE)
 	VOID_RET(int, stress_set_sched(getpid(), SCHED_DEADLINE, 99, true));
@@ -1052,6 +1321,8 @@ void stress_vmstat_start(void)
 		if (iostat_delay > 0)
 			sleep_delay = STRESS_MINIMUM(iostat_delay, sleep_delay);
 #endif
+		if (psistat_delay > 0)
+			sleep_delay = STRESS_MINIMUM(psistat_delay, sleep_delay);
 		t1 += sleep_delay;
 		t2 = stress_time_now();
 
@@ -1067,6 +1338,7 @@ void stress_vmstat_start(void)
 		vmstat_sleep -= sleep_delay;
 		thermalstat_sleep -= sleep_delay;
 		iostat_sleep -= sleep_delay;
+		psistat_sleep -= sleep_delay;
 
 		if ((vmstat_delay > 0) && (vmstat_sleep <= 0))
 			vmstat_sleep = vmstat_delay;
@@ -1074,6 +1346,8 @@ void stress_vmstat_start(void)
 			thermalstat_sleep = thermalstat_delay;
 		if ((iostat_delay > 0) && (iostat_sleep <= 0))
 			iostat_sleep = iostat_delay;
+		if ((psistat_delay > 0) && (psistat_sleep <= 0))
+			psistat_sleep = psistat_delay;
 
 		if (vmstat_sleep == vmstat_delay) {
 			double clk_tick_vmstat_delay = (double)clk_tick * (double)vmstat_delay;
@@ -1184,6 +1458,31 @@ void stress_vmstat_start(void)
 				(double)iostat.discard_io * clk_scale);
 		}
 #endif
+		if (psistat_delay == psistat_sleep) {
+			stress_psi_t psi[STRESS_PSI_MAX];
+			static uint32_t psistat_count = 0;
+			int i;
+
+			if ((psistat_count++ % 25) == 0)
+				pr_inf("psi: CPUs10 CPUf10 MEMs10 MEMf10  IOs10  IOf10 "
+					"  CPUs-us   CPUf-us   MEMs-us   MEMf-us    IOs-us    IOf-us\n");
+
+			(void)stress_read_psi(psi);
+			pr_inf("psi: %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f "
+				"%9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64
+				" %9" PRIu64 " %9" PRIu64 "\n",
+				psi[0].some_avg10, psi[0].full_avg10,
+				psi[1].some_avg10, psi[1].full_avg10,
+				psi[2].some_avg10, psi[2].full_avg10,
+				stress_psi_delta(psi[0].some_total, psi_prev[0].some_total),
+				stress_psi_delta(psi[0].full_total, psi_prev[0].full_total),
+				stress_psi_delta(psi[1].some_total, psi_prev[1].some_total),
+				stress_psi_delta(psi[1].full_total, psi_prev[1].full_total),
+				stress_psi_delta(psi[2].some_total, psi_prev[2].some_total),
+				stress_psi_delta(psi[2].full_total, psi_prev[2].full_total));
+			for (i = 0; i < STRESS_PSI_MAX; i++)
+				psi_prev[i] = psi[i];
+		}
 	}
 	_exit(0);
 }
@@ -0,0 +1 @@
+#define STRESS_GIT_COMMIT_ID "26e4729168d40b553bfcd96d18ece4f4f1ca5478"
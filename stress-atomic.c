@@ -19,8 +19,18 @@
  */
 #include "stress-ng.h"
 
-#define STRESS_ATOMIC_MAX_PROCS		(3)
+#define MIN_ATOMIC_PROCS		(1)
+#define MAX_ATOMIC_PROCS		(64)
+#define DEFAULT_ATOMIC_PROCS		(4)
+
 #define STRESS_ATOMIC_MAX_FUNCS		(SIZEOF_ARRAY(atomic_func_info))
+#define STRESS_ATOMIC_MAX_OP_FUNCS	(SIZEOF_ARRAY(atomic_op_func_info))
+#define STRESS_ATOMIC_OP_LOOPS		(1024)	/* ops per timed op function call */
+#define STRESS_ATOMIC_OP_ROUNDS		(4)	/* op function calls per bogo op */
+
+#define STRESS_ATOMIC_CONTENTION_PRIVATE	(0)	/* own cache line per process */
+#define STRESS_ATOMIC_CONTENTION_LINE		(1)	/* own word in a shared cache line */
+#define STRESS_ATOMIC_CONTENTION_WORD		(2)	/* one shared word */
 
 #define DO_NOTHING()	do { } while (0)
 
@@ -224,9 +234,49 @@ do {									\
 } while (0)
 
 static const stress_help_t help[] = {
-	{ NULL,	"atomic",	"start N workers exercising GCC atomic operations" },
-	{ NULL, "atomic-ops",	"stop after N bogo atomic bogo operations" },
-	{ NULL, NULL,		NULL }
+	{ NULL,	"atomic",		"start N workers exercising GCC atomic operations" },
+	{ NULL,	"atomic-contention C",	"select contention, one of private, line or word" },
+	{ NULL, "atomic-ops",		"stop after N bogo atomic bogo operations" },
+	{ NULL,	"atomic-procs N",	"number of processes per worker contending" },
+	{ NULL, NULL,			NULL }
+};
+
+static const char * const atomic_contentions[] = {
+	"private",
+	"line",
+	"word",
+};
+
+static int stress_set_atomic_contention(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(atomic_contentions); i++) {
+		if (!strcmp(opt, atomic_contentions[i]))
+			return stress_set_setting("atomic-contention", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "atomic-contention must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(atomic_contentions); i++)
+		(void)fprintf(stderr, " %s", atomic_contentions[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_atomic_procs(const char *opt)
+{
+	uint32_t atomic_procs;
+
+	atomic_procs = stress_get_uint32(opt);
+	stress_check_range("atomic-procs", (uint64_t)atomic_procs,
+		MIN_ATOMIC_PROCS, MAX_ATOMIC_PROCS);
+	return stress_set_setting("atomic-procs", TYPE_ID_UINT32, &atomic_procs);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_atomic_contention,	stress_set_atomic_contention },
+	{ OPT_atomic_procs,		stress_set_atomic_procs },
+	{ 0,				NULL }
 };
 
 #if defined(HAVE_ATOMIC_OPS)
@@ -242,45 +292,45 @@ static const stress_help_t help[] = {
 #define ATOMIC_OPTIMIZE
 #endif
 
-static void ATOMIC_OPTIMIZE stress_atomic_uint64(double *duration, double *count)
+static void ATOMIC_OPTIMIZE stress_atomic_uint64(stress_atomic_word_t *word, double *duration, double *count)
 {
 	static int idx = 0;
 
 	if (sizeof(long int) == sizeof(uint64_t))
-		DO_ATOMIC_OPS(uint64_t, &g_shared->atomic.val64[idx], duration, count);
+		DO_ATOMIC_OPS(uint64_t, &word->val64[idx], duration, count);
 	idx++;
-	idx &= (SIZEOF_ARRAY(g_shared->atomic.val64) - 1);
+	idx &= (SIZEOF_ARRAY(word->val64) - 1);
 }
 
-static void ATOMIC_OPTIMIZE stress_atomic_uint32(double *duration, double *count)
+static void ATOMIC_OPTIMIZE stress_atomic_uint32(stress_atomic_word_t *word, double *duration, double *count)
 {
 	static int idx = 0;
 
-	DO_ATOMIC_OPS(uint32_t, &g_shared->atomic.val32[idx], duration, count);
+	DO_ATOMIC_OPS(uint32_t, &word->val32[idx], duration, count);
 	idx++;
-	idx &= (SIZEOF_ARRAY(g_shared->atomic.val32) - 1);
+	idx &= (SIZEOF_ARRAY(word->val32) - 1);
 }
 
-static void ATOMIC_OPTIMIZE stress_atomic_uint16(double *duration, double *count)
+static void ATOMIC_OPTIMIZE stress_atomic_uint16(stress_atomic_word_t *word, double *duration, double *count)
 {
 	static int idx = 0;
 
-	DO_ATOMIC_OPS(uint16_t, &g_shared->atomic.val16[idx], duration, count);
+	DO_ATOMIC_OPS(uint16_t, &word->val16[idx], duration, count);
 	idx++;
-	idx &= (SIZEOF_ARRAY(g_shared->atomic.val16) - 1);
+	idx &= (SIZEOF_ARRAY(word->val16) - 1);
 }
 
-static void ATOMIC_OPTIMIZE stress_atomic_uint8(double *duration, double *count)
+static void ATOMIC_OPTIMIZE stress_atomic_uint8(stress_atomic_word_t *word, double *duration, double *count)
 {
 	static int idx = 0;
 
-	DO_ATOMIC_OPS(uint8_t, &g_shared->atomic.val8[idx], duration, count);
+	DO_ATOMIC_OPS(uint8_t, &word->val8[idx], duration, count);
 	idx++;
-	idx &= (SIZEOF_ARRAY(g_shared->atomic.val8) - 1);
+	idx &= (SIZEOF_ARRAY(word->val8) - 1);
 }
 
 typedef struct {
-	void (*func)(double *duration, double *count);
+	void (*func)(stress_atomic_word_t *word, double *duration, double *count);
 	char *name;
 } atomic_func_info_t;
 
@@ -291,14 +341,93 @@ static atomic_func_info_t atomic_func_info[] = {
 	{ stress_atomic_uint8,	"uint8"  },
 };
 
+#if defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+#define HAVE_ATOMIC_OP_FUNCS
+
+/*
+ *  STRESS_ATOMIC_OP_FUNC()
+ *	generate a function that times STRESS_ATOMIC_OP_LOOPS of one
+ *	64 bit atomic operation with a fixed memory order
+ */
+#define STRESS_ATOMIC_OP_FUNC(name, op)					\
+static void ATOMIC_OPTIMIZE name(uint64_t *ptr, double *duration, double *count)\
+{									\
+	register int i;							\
+	uint64_t val = 0, expected;					\
+	double t;							\
+									\
+	t = stress_time_now();						\
+	for (i = 0; i < STRESS_ATOMIC_OP_LOOPS; i++) {			\
+		op;							\
+	}								\
+	(*duration) += stress_time_now() - t;				\
+	(*count) += (double)STRESS_ATOMIC_OP_LOOPS;			\
+	(void)val;							\
+	(void)expected;							\
+}
+
+/* compare and swap, on failure retry with the value just seen */
+#define STRESS_ATOMIC_CAS(order)					\
+	expected = val;							\
+	val = __atomic_compare_exchange_n(ptr, &expected, val + 1,	\
+		false, order, __ATOMIC_RELAXED) ? val + 1 : expected
+
+STRESS_ATOMIC_OP_FUNC(stress_atomic_cas_relaxed, STRESS_ATOMIC_CAS(__ATOMIC_RELAXED))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_cas_acq_rel, STRESS_ATOMIC_CAS(__ATOMIC_ACQ_REL))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_cas_seq_cst, STRESS_ATOMIC_CAS(__ATOMIC_SEQ_CST))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_fetch_add_relaxed, val += __atomic_fetch_add(ptr, 1, __ATOMIC_RELAXED))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_fetch_add_acq_rel, val += __atomic_fetch_add(ptr, 1, __ATOMIC_ACQ_REL))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_fetch_add_seq_cst, val += __atomic_fetch_add(ptr, 1, __ATOMIC_SEQ_CST))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_exchange_relaxed, val = __atomic_exchange_n(ptr, val + 1, __ATOMIC_RELAXED))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_exchange_acq_rel, val = __atomic_exchange_n(ptr, val + 1, __ATOMIC_ACQ_REL))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_exchange_seq_cst, val = __atomic_exchange_n(ptr, val + 1, __ATOMIC_SEQ_CST))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_load_relaxed, val += __atomic_load_n(ptr, __ATOMIC_RELAXED))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_load_acquire, val += __atomic_load_n(ptr, __ATOMIC_ACQUIRE))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_load_seq_cst, val += __atomic_load_n(ptr, __ATOMIC_SEQ_CST))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_store_relaxed, __atomic_store_n(ptr, val++, __ATOMIC_RELAXED))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_store_release, __atomic_store_n(ptr, val++, __ATOMIC_RELEASE))
+STRESS_ATOMIC_OP_FUNC(stress_atomic_store_seq_cst, __atomic_store_n(ptr, val++, __ATOMIC_SEQ_CST))
+
 typedef struct {
+	void (*func)(uint64_t *ptr, double *duration, double *count);
+	char *name;
+} atomic_op_func_info_t;
+
+static atomic_op_func_info_t atomic_op_func_info[] = {
+	{ stress_atomic_cas_relaxed,		"cas relaxed" },
+	{ stress_atomic_cas_acq_rel,		"cas acq_rel" },
+	{ stress_atomic_cas_seq_cst,		"cas seq_cst" },
+	{ stress_atomic_fetch_add_relaxed,	"fetch-add relaxed" },
+	{ stress_atomic_fetch_add_acq_rel,	"fetch-add acq_rel" },
+	{ stress_atomic_fetch_add_seq_cst,	"fetch-add seq_cst" },
+	{ stress_atomic_exchange_relaxed,	"exchange relaxed" },
+	{ stress_atomic_exchange_acq_rel,	"exchange acq_rel" },
+	{ stress_atomic_exchange_seq_cst,	"exchange seq_cst" },
+	{ stress_atomic_load_relaxed,		"load relaxed" },
+	{ stress_atomic_load_acquire,		"load acquire" },
+	{ stress_atomic_load_seq_cst,		"load seq_cst" },
+	{ stress_atomic_store_relaxed,		"store relaxed" },
+	{ stress_atomic_store_release,		"store release" },
+	{ stress_atomic_store_seq_cst,		"store seq_cst" },
+};
+#endif
+
+typedef struct {
+	stress_atomic_word_t line[8] ALIGN64;	/* private cache line */
 	stress_metrics_t metrics[STRESS_ATOMIC_MAX_FUNCS];
+#if defined(HAVE_ATOMIC_OP_FUNCS)
+	stress_metrics_t op_metrics[STRESS_ATOMIC_MAX_OP_FUNCS];
+#endif
 	pid_t pid;
-} stress_atomic_info_t;
+} ALIGN64 stress_atomic_info_t;
 
 static void stress_atomic_exercise(
 	const stress_args_t *args,
-	stress_atomic_info_t *atomic_info)
+	stress_atomic_info_t *atomic_info,
+	stress_atomic_word_t *word)
 {
 	const int rounds = 1000;
 	do {
@@ -308,12 +437,45 @@ static void stress_atomic_exercise(
 			int j;
 
 			for (j = 0; j < rounds; j++)
-				atomic_func_info[i].func(&atomic_info->metrics[i].duration, &atomic_info->metrics[i].count);
+				atomic_func_info[i].func(word, &atomic_info->metrics[i].duration, &atomic_info->metrics[i].count);
 		}
+#if defined(HAVE_ATOMIC_OP_FUNCS)
+		for (i = 0; i < STRESS_ATOMIC_MAX_OP_FUNCS; i++) {
+			int j;
+
+			for (j = 0; j < STRESS_ATOMIC_OP_ROUNDS; j++)
+				atomic_op_func_info[i].func(&word->val64[0],
+					&atomic_info->op_metrics[i].duration,
+					&atomic_info->op_metrics[i].count);
+		}
+#endif
 		inc_counter(args);
 	} while (keep_stressing(args));
 }
 
+/*
+ *  stress_atomic_word()
+ *	select the word process n of this instance exercises
+ */
+static stress_atomic_word_t *stress_atomic_word(
+	const stress_args_t *args,
+	stress_atomic_info_t *atomic_info,
+	const size_t atomic_contention,
+	const uint32_t atomic_procs,
+	const size_t n)
+{
+	switch (atomic_contention) {
+	case STRESS_ATOMIC_CONTENTION_PRIVATE:
+		return &atomic_info[n].line[0];
+	case STRESS_ATOMIC_CONTENTION_LINE:
+		return &g_shared->atomic[((args->instance * atomic_procs) + n) %
+					 SIZEOF_ARRAY(g_shared->atomic)];
+	case STRESS_ATOMIC_CONTENTION_WORD:
+	default:
+		return &g_shared->atomic[0];
+	}
+}
+
 /*
  *  stress_atomic()
  *      stress gcc atomic memory ops
@@ -322,7 +484,13 @@ static int stress_atomic(const stress_args_t *args)
 {
 	size_t i, j, atomic_info_sz;
 	stress_atomic_info_t *atomic_info;
-	const size_t n_atomic_procs = STRESS_ATOMIC_MAX_PROCS + 1;
+	size_t atomic_contention = STRESS_ATOMIC_CONTENTION_WORD;
+	uint32_t atomic_procs = DEFAULT_ATOMIC_PROCS;
+	size_t n_atomic_procs, idx = 0;
+
+	(void)stress_get_setting("atomic-contention", &atomic_contention);
+	(void)stress_get_setting("atomic-procs", &atomic_procs);
+	n_atomic_procs = (size_t)atomic_procs;
 
 	atomic_info_sz = sizeof(*atomic_info) * n_atomic_procs;
 	atomic_info = (stress_atomic_info_t *)mmap(NULL, atomic_info_sz, PROT_READ | PROT_WRITE,
@@ -340,25 +508,37 @@ static int stress_atomic(const stress_args_t *args)
 			atomic_info[i].metrics[j].duration = 0.0;
 			atomic_info[i].metrics[j].count = 0.0;
 		}
+#if defined(HAVE_ATOMIC_OP_FUNCS)
+		for (j = 0; j < STRESS_ATOMIC_MAX_OP_FUNCS; j++) {
+			atomic_info[i].op_metrics[j].duration = 0.0;
+			atomic_info[i].op_metrics[j].count = 0.0;
+		}
+#endif
 	}
 
+	if (args->instance == 0)
+		pr_dbg("%s: %s contention, %" PRIu32 " processes per instance\n",
+			args->name, atomic_contentions[atomic_contention], atomic_procs);
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
-	for (i = 0; i < STRESS_ATOMIC_MAX_PROCS; i++) {
+	for (i = 0; i < n_atomic_procs - 1; i++) {
 		pid_t pid;
 
 		pid = fork();
 
 		if (pid == 0) {
-			stress_atomic_exercise(args, &atomic_info[i]);
+			stress_atomic_exercise(args, &atomic_info[i],
+				stress_atomic_word(args, atomic_info, atomic_contention, atomic_procs, i));
 			_exit(0);
 		}
 		atomic_info[i].pid = pid;
 	}
 
-	stress_atomic_exercise(args, &atomic_info[n_atomic_procs - 1]);
+	stress_atomic_exercise(args, &atomic_info[n_atomic_procs - 1],
+		stress_atomic_word(args, atomic_info, atomic_contention, atomic_procs, n_atomic_procs - 1));
 
-	for (i = 0; i < STRESS_ATOMIC_MAX_PROCS; i++) {
+	for (i = 0; i < n_atomic_procs - 1; i++) {
 		if (atomic_info[i].pid > 0) {
 			int status;
 
@@ -377,8 +557,22 @@ static int stress_atomic(const stress_args_t *args)
 		}
 		rate = (duration > 0.0) ? count / duration : 0.0;
 		(void)snprintf(str, sizeof(str), "%s atomic ops per sec", atomic_func_info[j].name);
-		stress_metrics_set(args, j, str, rate);
+		stress_metrics_set(args, idx++, str, rate);
 	}
+#if defined(HAVE_ATOMIC_OP_FUNCS)
+	for (j = 0; j < STRESS_ATOMIC_MAX_OP_FUNCS; j++) {
+		double duration = 0.0, count = 0.0, ns;
+		char str[60];
+
+		for (i = 0; i < n_atomic_procs; i++) {
+			duration += atomic_info[i].op_metrics[j].duration;
+			count += atomic_info[i].op_metrics[j].count;
+		}
+		ns = (count > 0.0) ? STRESS_DBL_NANOSECOND * duration / count : 0.0;
+		(void)snprintf(str, sizeof(str), "%s nanosecs per op", atomic_op_func_info[j].name);
+		stress_metrics_set(args, idx++, str, ns);
+	}
+#endif
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
@@ -390,6 +584,7 @@ static int stress_atomic(const stress_args_t *args)
 stressor_info_t stress_atomic_info = {
 	.stressor = stress_atomic,
 	.class = CLASS_CPU | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 
@@ -397,6 +592,7 @@ stressor_info_t stress_atomic_info = {
 stressor_info_t stress_atomic_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_CPU | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without gcc __atomic builtin functions"
 };
@@ -19,11 +19,55 @@
  */
 #include "stress-ng.h"
 #include "core-arch.h"
+#include "core-perf.h"
 
 static const stress_help_t help[] = {
-	{ NULL,	"branch N",	"start N workers that force branch misprediction" },
-	{ NULL,	"branch-ops N",	"stop after N branch misprediction branches" },
-	{ NULL,	NULL,		NULL }
+	{ NULL,	"branch N",		"start N workers that force branch misprediction" },
+	{ NULL,	"branch-method M",	"branch method: random, period, sites, indirect, return or all" },
+	{ NULL,	"branch-ops N",		"stop after N branch misprediction branches" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define STRESS_BRANCH_RANDOM	(0)
+#define STRESS_BRANCH_PERIOD	(1)
+#define STRESS_BRANCH_SITES	(2)
+#define STRESS_BRANCH_INDIRECT	(3)
+#define STRESS_BRANCH_RETURN	(4)
+#define STRESS_BRANCH_ALL	(5)
+
+typedef struct {
+	const char *name;
+	const int method;
+} stress_branch_method_t;
+
+static const stress_branch_method_t branch_methods[] = {
+	{ "random",	STRESS_BRANCH_RANDOM },
+	{ "period",	STRESS_BRANCH_PERIOD },
+	{ "sites",	STRESS_BRANCH_SITES },
+	{ "indirect",	STRESS_BRANCH_INDIRECT },
+	{ "return",	STRESS_BRANCH_RETURN },
+	{ "all",	STRESS_BRANCH_ALL },
+};
+
+static int stress_set_branch_method(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(branch_methods); i++) {
+		if (!strcmp(branch_methods[i].name, opt))
+			return stress_set_setting("branch-method", TYPE_ID_SIZE_T, &i);
+	}
+
+	(void)fprintf(stderr, "branch-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(branch_methods); i++)
+		(void)fprintf(stderr, " %s", branch_methods[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_branch_method,	stress_set_branch_method },
+	{ 0,			NULL }
 };
 
 #if defined(HAVE_LABEL_AS_VALUE) &&		\
@@ -41,10 +85,10 @@ static const stress_help_t help[] = {
 #define J(n) L ## n:	RESEED_JMP
 
 /*
- *  stress_branch()
+ *  stress_branch_random()
  *	stress instruction branch prediction
  */
-static int OPTIMIZE3 stress_branch(const stress_args_t *args)
+static int OPTIMIZE3 stress_branch_random(const stress_args_t *args)
 {
 	register uint32_t const a = 16843009;
 	register uint32_t const c = 826366247;
@@ -358,15 +402,488 @@ L0x000:
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  Characterisation sweeps, each point of a sweep executes
+ *  STRESS_BRANCH_COUNT branches once to train the predictors
+ *  and once more timed
+ */
+#define STRESS_BRANCH_COUNT	(1U << 20)
+#define STRESS_BRANCH_PATTERN	(1U << 16)
+#define STRESS_BRANCH_SITES_MAX	(1024)
+#define STRESS_BRANCH_TARGETS	(64)
+#define STRESS_BRANCH_SEQ	(256)
+#define STRESS_BRANCH_DEPTH	(64)
+#define STRESS_BRANCH_KNEE	(1.5)
+
+typedef struct {
+	const char *name;	/* sweep name */
+	const char *param;	/* swept parameter description */
+	const char *capacity;	/* capacity estimate description */
+	const size_t *params;	/* parameter values */
+	const size_t n_params;	/* number of parameter values */
+} stress_branch_sweep_t;
+
+typedef struct {
+	double duration;	/* total timed duration */
+	double branches;	/* total timed branches */
+	double misses;		/* total branch misses, from perf */
+} stress_branch_point_t;
+
+static const size_t branch_periods[] = {
+	1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536
+};
+
+static const size_t branch_sites[] = {
+	1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024
+};
+
+static const size_t branch_targets[] = {
+	1, 2, 4, 8, 16, 32, 64
+};
+
+static const size_t branch_depths[] = {
+	1, 2, 4, 8, 12, 16, 20, 24, 28, 32, 40, 48, 64
+};
+
+static const stress_branch_sweep_t branch_sweeps[] = {
+	{ "period",	"pattern period",	"longest predicted pattern period",
+	  branch_periods, SIZEOF_ARRAY(branch_periods) },
+	{ "sites",	"branch sites",		"branch sites before the BTB overflows",
+	  branch_sites, SIZEOF_ARRAY(branch_sites) },
+	{ "indirect",	"indirect targets",	"indirect targets predicted per site",
+	  branch_targets, SIZEOF_ARRAY(branch_targets) },
+	{ "return",	"call depth",		"return stack depth",
+	  branch_depths, SIZEOF_ARRAY(branch_depths) },
+};
+
+typedef struct {
+	volatile uint32_t taken;
+	volatile uint32_t not_taken;
+	volatile uint32_t targets[STRESS_BRANCH_TARGETS];
+	volatile uint32_t ret[2];
+} stress_branch_sink_t;
+
+static stress_branch_sink_t branch_sink;
+
+/*
+ *  stress_branch_period()
+ *	a single conditional branch following a random pattern that
+ *	repeats every period branches, predictable while the period
+ *	fits in the branch history
+ */
+static uint64_t OPTIMIZE3 stress_branch_period(const uint8_t *pattern, const size_t period)
+{
+	const size_t mask = period - 1;
+	register size_t i;
+
+	for (i = 0; i < STRESS_BRANCH_COUNT; i++) {
+		if (pattern[i & mask])
+			branch_sink.taken++;
+		else
+			branch_sink.not_taken++;
+	}
+	return STRESS_BRANCH_COUNT;
+}
+
+#define S(n)	S ## n: goto *site_next[n];
+#define S16(n)	S(n ## 0) S(n ## 1) S(n ## 2) S(n ## 3)		\
+		S(n ## 4) S(n ## 5) S(n ## 6) S(n ## 7)		\
+		S(n ## 8) S(n ## 9) S(n ## a) S(n ## b)		\
+		S(n ## c) S(n ## d) S(n ## e) S(n ## f)
+#define S256(n)	S16(n ## 0) S16(n ## 1) S16(n ## 2) S16(n ## 3)	\
+		S16(n ## 4) S16(n ## 5) S16(n ## 6) S16(n ## 7)	\
+		S16(n ## 8) S16(n ## 9) S16(n ## a) S16(n ## b)	\
+		S16(n ## c) S16(n ## d) S16(n ## e) S16(n ## f)
+
+#define A(n)	&&S ## n,
+#define A16(n)	A(n ## 0) A(n ## 1) A(n ## 2) A(n ## 3)		\
+		A(n ## 4) A(n ## 5) A(n ## 6) A(n ## 7)		\
+		A(n ## 8) A(n ## 9) A(n ## a) A(n ## b)		\
+		A(n ## c) A(n ## d) A(n ## e) A(n ## f)
+#define A256(n)	A16(n ## 0) A16(n ## 1) A16(n ## 2) A16(n ## 3)	\
+		A16(n ## 4) A16(n ## 5) A16(n ## 6) A16(n ## 7)	\
+		A16(n ## 8) A16(n ## 9) A16(n ## a) A16(n ## b)	\
+		A16(n ## c) A16(n ## d) A16(n ## e) A16(n ## f)
+
+/*
+ *  stress_branch_sites()
+ *	chain of n_sites indirect jumps spread across 1024 jump
+ *	sites, each site always jumps to the same target so the
+ *	jumps are predicted while all the sites fit in the BTB
+ */
+static uint64_t OPTIMIZE3 stress_branch_sites(const size_t n_sites)
+{
+	static const void ALIGN64 *sites[STRESS_BRANCH_SITES_MAX] = {
+		A256(0x0) A256(0x1) A256(0x2) A256(0x3)
+	};
+	const void *site_next[STRESS_BRANCH_SITES_MAX];
+	const size_t spacing = STRESS_BRANCH_SITES_MAX / n_sites;
+	const size_t loops = STRESS_BRANCH_COUNT / n_sites;
+	register size_t i = 0;
+	size_t j;
+
+	for (j = 0; j < STRESS_BRANCH_SITES_MAX; j++)
+		site_next[j] = &&done;
+	for (j = 0; j < n_sites - 1; j++)
+		site_next[j * spacing] = sites[(j + 1) * spacing];
+
+loop:
+	if (i++ >= loops)
+		return (uint64_t)loops * n_sites;
+	goto *sites[0];
+
+	S256(0x0) S256(0x1) S256(0x2) S256(0x3)
+done:
+	goto loop;
+}
+
+#undef S
+#undef S16
+#undef S256
+#undef A
+#undef A16
+#undef A256
+
+#define T(n)	T ## n: branch_sink.targets[n]++; goto dispatch;
+/* octal target numbers, T8(n) expands to targets 0n0 .. 0n7 */
+#define T8(n)	T(0 ## n ## 0) T(0 ## n ## 1) T(0 ## n ## 2) T(0 ## n ## 3)	\
+		T(0 ## n ## 4) T(0 ## n ## 5) T(0 ## n ## 6) T(0 ## n ## 7)
+#define A(n)	&&T ## n,
+#define A8(n)	A(0 ## n ## 0) A(0 ## n ## 1) A(0 ## n ## 2) A(0 ## n ## 3)	\
+		A(0 ## n ## 4) A(0 ## n ## 5) A(0 ## n ## 6) A(0 ## n ## 7)
+
+/*
+ *  stress_branch_indirect()
+ *	interpreter style dispatch, one indirect jump site jumping
+ *	to targets chosen by a repeating random sequence drawn from
+ *	seq, which holds target indices less than n_targets
+ */
+static uint64_t OPTIMIZE3 stress_branch_indirect(const uint8_t *seq)
+{
+	static const void ALIGN64 *targets[STRESS_BRANCH_TARGETS] = {
+		A8(0) A8(1) A8(2) A8(3) A8(4) A8(5) A8(6) A8(7)
+	};
+	register size_t i = 0;
+
+dispatch:
+	if (i >= STRESS_BRANCH_COUNT)
+		return STRESS_BRANCH_COUNT;
+	goto *targets[seq[i++ & (STRESS_BRANCH_SEQ - 1)]];
+
+	T8(0) T8(1) T8(2) T8(3) T8(4) T8(5) T8(6) T8(7)
+}
+
+#undef T
+#undef T8
+#undef A
+#undef A8
+
+typedef void (*stress_branch_ret_func_t)(const uint32_t sel);
+
+/*
+ *  Chain of functions each called from one of two call sites in
+ *  the previous function, the return addresses alternate so they
+ *  are only predicted correctly by the return stack buffer
+ */
+#define RET_LAST(n)							\
+static void NOINLINE stress_branch_ret ## n(const uint32_t sel)	\
+{									\
+	branch_sink.ret[sel & 1]++;					\
+}
+
+#define RET(n, next)							\
+static void NOINLINE stress_branch_ret ## n(const uint32_t sel)	\
+{									\
+	if (sel & 1) {							\
+		stress_branch_ret ## next(sel);				\
+		branch_sink.ret[1]++;					\
+	} else {							\
+		stress_branch_ret ## next(sel);				\
+		branch_sink.ret[0]++;					\
+	}								\
+}
+
+RET_LAST(63)
+RET(62, 63) RET(61, 62) RET(60, 61) RET(59, 60) RET(58, 59) RET(57, 58) RET(56, 57)
+RET(55, 56) RET(54, 55) RET(53, 54) RET(52, 53) RET(51, 52) RET(50, 51) RET(49, 50)
+RET(48, 49) RET(47, 48) RET(46, 47) RET(45, 46) RET(44, 45) RET(43, 44) RET(42, 43)
+RET(41, 42) RET(40, 41) RET(39, 40) RET(38, 39) RET(37, 38) RET(36, 37) RET(35, 36)
+RET(34, 35) RET(33, 34) RET(32, 33) RET(31, 32) RET(30, 31) RET(29, 30) RET(28, 29)
+RET(27, 28) RET(26, 27) RET(25, 26) RET(24, 25) RET(23, 24) RET(22, 23) RET(21, 22)
+RET(20, 21) RET(19, 20) RET(18, 19) RET(17, 18) RET(16, 17) RET(15, 16) RET(14, 15)
+RET(13, 14) RET(12, 13) RET(11, 12) RET(10, 11) RET(9, 10)  RET(8, 9)   RET(7, 8)
+RET(6, 7)   RET(5, 6)   RET(4, 5)   RET(3, 4)   RET(2, 3)   RET(1, 2)   RET(0, 1)
+
+#undef RET_LAST
+#undef RET
+
+static const stress_branch_ret_func_t branch_ret_funcs[STRESS_BRANCH_DEPTH] = {
+	stress_branch_ret0,  stress_branch_ret1,  stress_branch_ret2,  stress_branch_ret3,
+	stress_branch_ret4,  stress_branch_ret5,  stress_branch_ret6,  stress_branch_ret7,
+	stress_branch_ret8,  stress_branch_ret9,  stress_branch_ret10, stress_branch_ret11,
+	stress_branch_ret12, stress_branch_ret13, stress_branch_ret14, stress_branch_ret15,
+	stress_branch_ret16, stress_branch_ret17, stress_branch_ret18, stress_branch_ret19,
+	stress_branch_ret20, stress_branch_ret21, stress_branch_ret22, stress_branch_ret23,
+	stress_branch_ret24, stress_branch_ret25, stress_branch_ret26, stress_branch_ret27,
+	stress_branch_ret28, stress_branch_ret29, stress_branch_ret30, stress_branch_ret31,
+	stress_branch_ret32, stress_branch_ret33, stress_branch_ret34, stress_branch_ret35,
+	stress_branch_ret36, stress_branch_ret37, stress_branch_ret38, stress_branch_ret39,
+	stress_branch_ret40, stress_branch_ret41, stress_branch_ret42, stress_branch_ret43,
+	stress_branch_ret44, stress_branch_ret45, stress_branch_ret46, stress_branch_ret47,
+	stress_branch_ret48, stress_branch_ret49, stress_branch_ret50, stress_branch_ret51,
+	stress_branch_ret52, stress_branch_ret53, stress_branch_ret54, stress_branch_ret55,
+	stress_branch_ret56, stress_branch_ret57, stress_branch_ret58, stress_branch_ret59,
+	stress_branch_ret60, stress_branch_ret61, stress_branch_ret62, stress_branch_ret63,
+};
+
+/*
+ *  stress_branch_return()
+ *	call chains depth functions deep, returns are predicted while
+ *	depth fits in the return stack buffer
+ */
+static uint64_t stress_branch_return(const size_t depth)
+{
+	const stress_branch_ret_func_t func = branch_ret_funcs[STRESS_BRANCH_DEPTH - depth];
+	const uint32_t loops = STRESS_BRANCH_COUNT / (uint32_t)depth;
+	uint32_t i;
+
+	for (i = 0; i < loops; i++)
+		func(stress_mwc32());
+
+	return (uint64_t)loops * depth;
+}
+
+/*
+ *  stress_branch_point()
+ *	train and then time one point of a sweep
+ */
+static void stress_branch_point(
+	const int method,
+	const size_t param,
+	const uint8_t *pattern,
+	uint8_t *seq,
+	const int perf_fd,
+	stress_branch_point_t *point)
+{
+	double t;
+	uint64_t misses_begin = 0, misses_end = 0, branches = 0;
+	int pass;
+	size_t i;
+
+	if (method == STRESS_BRANCH_INDIRECT) {
+		for (i = 0; i < STRESS_BRANCH_SEQ; i++)
+			seq[i] = (uint8_t)stress_mwc32modn((uint32_t)param);
+	}
+
+	t = 0.0;
+	for (pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			(void)stress_perf_counter_read(perf_fd, &misses_begin);
+			t = stress_time_now();
+		}
+		switch (method) {
+		default:
+		case STRESS_BRANCH_PERIOD:
+			branches = stress_branch_period(pattern, param);
+			break;
+		case STRESS_BRANCH_SITES:
+			branches = stress_branch_sites(param);
+			break;
+		case STRESS_BRANCH_INDIRECT:
+			branches = stress_branch_indirect(seq);
+			break;
+		case STRESS_BRANCH_RETURN:
+			branches = stress_branch_return(param);
+			break;
+		}
+	}
+	point->duration += stress_time_now() - t;
+	point->branches += (double)branches;
+	if (stress_perf_counter_read(perf_fd, &misses_end))
+		point->misses += (double)(misses_end - misses_begin);
+}
+
+/*
+ *  stress_branch_ns()
+ *	nanoseconds per branch of a sweep point, 0 if not run
+ */
+static inline double stress_branch_ns(const stress_branch_point_t *point)
+{
+	return (point->branches > 0.0) ?
+		(point->duration * STRESS_DBL_NANOSECOND) / point->branches : 0.0;
+}
+
+/*
+ *  stress_branch_report()
+ *	report ns per branch and branch misses per branch for each
+ *	point of a sweep and estimate the predictor capacity as the
+ *	last point after the fastest point before ns per branch
+ *	exceeds STRESS_BRANCH_KNEE times the fastest, the first few
+ *	points are dominated by loop overhead so are skipped
+ */
+static void stress_branch_report(
+	const stress_args_t *args,
+	const stress_branch_sweep_t *sweep,
+	stress_branch_point_t *points,
+	const bool have_perf,
+	size_t *idx)
+{
+	double fastest = 0.0;
+	size_t i, i_fastest = 0, capacity = 0;
+	bool knee = false;
+
+	for (i = 0; i < sweep->n_params; i++) {
+		const double ns = stress_branch_ns(&points[i]);
+
+		if ((ns > 0.0) && ((fastest == 0.0) || (ns < fastest))) {
+			fastest = ns;
+			i_fastest = i;
+		}
+	}
+	for (i = i_fastest; i < sweep->n_params; i++) {
+		const double ns = stress_branch_ns(&points[i]);
+
+		if ((ns <= 0.0) || (ns > fastest * STRESS_BRANCH_KNEE)) {
+			knee = (ns > 0.0);
+			break;
+		}
+		capacity = sweep->params[i];
+	}
+
+	if (args->instance == 0)
+		pr_inf("%s: %s sweep: %16s  nanosecs per branch%s\n",
+			args->name, sweep->name, sweep->param,
+			have_perf ? "  misses per branch" : "");
+
+	for (i = 0; i < sweep->n_params; i++) {
+		const stress_branch_point_t *point = &points[i];
+		const double ns = stress_branch_ns(point);
+		const double miss_rate = (point->branches > 0.0) ?
+			point->misses / point->branches : 0.0;
+		char desc[64];
+
+		if (point->branches <= 0.0)
+			continue;
+
+		if (args->instance == 0) {
+			if (have_perf)
+				pr_inf("%s: %s sweep: %16zu  %19.3f  %18.4f\n", args->name,
+					sweep->name, sweep->params[i], ns, miss_rate);
+			else
+				pr_inf("%s: %s sweep: %16zu  %19.3f\n", args->name,
+					sweep->name, sweep->params[i], ns);
+		}
+		(void)snprintf(desc, sizeof(desc), "%s nanosecs per branch (%s %zu)",
+			sweep->name, sweep->param, sweep->params[i]);
+		stress_metrics_set(args, (*idx)++, desc, ns);
+		if (have_perf) {
+			(void)snprintf(desc, sizeof(desc), "%s misses per branch (%s %zu)",
+				sweep->name, sweep->param, sweep->params[i]);
+			stress_metrics_set(args, (*idx)++, desc, miss_rate);
+		}
+	}
+	if ((args->instance == 0) && (capacity > 0))
+		pr_inf("%s: %s sweep: estimated %s: %zu%s\n", args->name, sweep->name,
+			sweep->capacity, capacity, knee ? "" : " (or more)");
+}
+
+/*
+ *  stress_branch_sweep()
+ *	run the period, sites, indirect and return characterisation
+ *	sweeps selected by method
+ */
+static int stress_branch_sweep(const stress_args_t *args, const int method)
+{
+	stress_branch_point_t *points[SIZEOF_ARRAY(branch_sweeps)];
+	uint8_t *pattern, seq[STRESS_BRANCH_SEQ];
+	size_t i, j, idx = 0;
+	int perf_fd, rc = EXIT_SUCCESS;
+	bool have_perf;
+
+	pattern = (uint8_t *)malloc(STRESS_BRANCH_PATTERN);
+	if (!pattern) {
+		pr_inf_skip("%s: cannot allocate branch pattern, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < STRESS_BRANCH_PATTERN; i++)
+		pattern[i] = stress_mwc8() & 1;
+	(void)memset(seq, 0, sizeof(seq));
+
+	for (i = 0; i < SIZEOF_ARRAY(branch_sweeps); i++) {
+		points[i] = (stress_branch_point_t *)calloc(branch_sweeps[i].n_params, sizeof(*points[i]));
+		if (!points[i]) {
+			pr_inf_skip("%s: cannot allocate sweep data, skipping stressor\n", args->name);
+			rc = EXIT_NO_RESOURCE;
+			goto free_points;
+		}
+	}
+
+	perf_fd = stress_perf_branch_misses_open();
+	have_perf = (perf_fd >= 0);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(branch_sweeps); i++) {
+			const int sweep_method = STRESS_BRANCH_PERIOD + (int)i;
+
+			if ((method != STRESS_BRANCH_ALL) && (method != sweep_method))
+				continue;
+			for (j = 0; keep_stressing_flag() && (j < branch_sweeps[i].n_params); j++) {
+				stress_branch_point(sweep_method, branch_sweeps[i].params[j],
+					pattern, seq, perf_fd, &points[i][j]);
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (i = 0; i < SIZEOF_ARRAY(branch_sweeps); i++) {
+		const int sweep_method = STRESS_BRANCH_PERIOD + (int)i;
+
+		if ((method == STRESS_BRANCH_ALL) || (method == sweep_method))
+			stress_branch_report(args, &branch_sweeps[i], points[i], have_perf, &idx);
+	}
+	if (perf_fd >= 0)
+		(void)close(perf_fd);
+
+	i = SIZEOF_ARRAY(branch_sweeps);
+free_points:
+	while (i-- > 0)
+		free(points[i]);
+	free(pattern);
+
+	return rc;
+}
+
+/*
+ *  stress_branch()
+ *	stress branch prediction with random branches or
+ *	characterise the branch predictors
+ */
+static int stress_branch(const stress_args_t *args)
+{
+	size_t branch_method = STRESS_BRANCH_RANDOM;
+
+	(void)stress_get_setting("branch-method", &branch_method);
+
+	if (branch_methods[branch_method].method == STRESS_BRANCH_RANDOM)
+		return stress_branch_random(args);
+	return stress_branch_sweep(args, branch_methods[branch_method].method);
+}
+
 stressor_info_t stress_branch_info = {
 	.stressor = stress_branch,
 	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_branch_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without compiler support gcc style 'labels as values' feature"
 };
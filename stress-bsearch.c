@@ -18,18 +18,35 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arch.h"
+#include "core-cpu-cache.h"
 #include "core-sort.h"
 
 #if defined(HAVE_SEARCH_H)
 #include <search.h>
 #endif
 
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    defined(HAVE_BUILTIN_POPCOUNT) &&	\
+    !defined(__ICC) &&			\
+    NEED_GNUC(8, 0, 0)
+#include <immintrin.h>
+#define STRESS_BSEARCH_HAVE_AVX2
+#endif
+
 #define MIN_BSEARCH_SIZE	(1 * KB)
 #define MAX_BSEARCH_SIZE	(4 * MB)
 #define DEFAULT_BSEARCH_SIZE	(64 * KB)
 
+#define BSEARCH_KARY_B		(16)	/* keys per k-ary block, one cache line */
+#define BSEARCH_LANES		(16)	/* interleaved searches in flight */
+
 static const stress_help_t help[] = {
 	{ NULL,	"bsearch N",	  "start N workers that exercise a binary search" },
+	{ NULL,	"bsearch-method M", "select search method: all,libc,branchless,prefetch,eytzinger,kary,interleave" },
 	{ NULL,	"bsearch-ops N",  "stop after N binary search bogo operations" },
 	{ NULL,	"bsearch-size N", "number of 32 bit integers to bsearch" },
 	{ NULL,	NULL,		  NULL }
@@ -49,12 +66,350 @@ static int stress_set_bsearch_size(const char *opt)
 	return stress_set_setting("bsearch-size", TYPE_ID_UINT64, &bsearch_size);
 }
 
-static const stress_opt_set_func_t opt_set_funcs[] = {
-	{ OPT_bsearch_size,	stress_set_bsearch_size },
-	{ 0,			NULL },
+#if defined(HAVE_BSEARCH)
+
+/*
+ *  search context, the sorted data, the same data in Eytzinger
+ *  and k-ary block layouts and a shuffled copy of the data as the
+ *  keys to look up
+ */
+typedef struct {
+	const stress_args_t *args;
+	int32_t *data;		/* sorted data */
+	int32_t *queries;	/* keys to look up */
+	int32_t *eyt;		/* Eytzinger layout, 1 based */
+	int32_t *blocks;	/* k-ary search tree blocks */
+	size_t n;		/* number of items */
+	size_t n_blocks;	/* number of k-ary blocks */
+	size_t blocks_size;	/* size of blocks mapping in bytes */
+	bool kary_avx2;		/* true if the k-ary search uses AVX2 */
+} stress_bsearch_context_t;
+
+typedef size_t (*stress_bsearch_func_t)(const stress_bsearch_context_t *ctxt);
+
+typedef struct {
+	const char *name;		/* method name */
+	const stress_bsearch_func_t func;	/* lookups, returns the number found */
+} stress_bsearch_method_t;
+
+/*
+ *  stress_bsearch_libc()
+ *	libc bsearch with the counting comparator
+ */
+static size_t stress_bsearch_libc(const stress_bsearch_context_t *ctxt)
+{
+	const int32_t *ptr, *end = ctxt->queries + ctxt->n;
+	size_t found = 0;
+
+	for (ptr = ctxt->queries; ptr < end; ptr++) {
+		const int32_t *result;
+
+		result = bsearch(ptr, ctxt->data, ctxt->n, sizeof(*ptr), stress_sort_cmp_fwd_int32);
+		if (g_opt_flags & OPT_FLAGS_VERIFY) {
+			if (result == NULL)
+				pr_fail("%s: element %zu could not be found\n",
+					ctxt->args->name, (size_t)(ptr - ctxt->queries));
+			else if (*result != *ptr)
+				pr_fail("%s: element %zu "
+					"found %" PRIu32
+					", expecting %" PRIu32 "\n",
+					ctxt->args->name, (size_t)(ptr - ctxt->queries),
+					*result, *ptr);
+		}
+		found += (result != NULL);
+	}
+	return found;
+}
+
+/*
+ *  stress_bsearch_lower()
+ *	branchless lower bound, the loop trip count only depends on
+ *	n so there are no mispredicted branches, the compiler turns
+ *	the select into a conditional move
+ */
+static inline size_t OPTIMIZE3 stress_bsearch_lower(const int32_t *data, const size_t n, const int32_t key)
+{
+	register const int32_t *base = data;
+	register size_t len = n;
+
+	while (len > 1) {
+		const size_t half = len >> 1;
+
+		base = (base[half - 1] < key) ? base + half : base;
+		len -= half;
+	}
+	return (size_t)(base - data) + (*base < key);
+}
+
+static size_t OPTIMIZE3 stress_bsearch_branchless(const stress_bsearch_context_t *ctxt)
+{
+	const int32_t *data = ctxt->data;
+	const size_t n = ctxt->n;
+	register size_t i, found = 0;
+
+	for (i = 0; i < n; i++) {
+		const int32_t key = ctxt->queries[i];
+		const size_t j = stress_bsearch_lower(data, n, key);
+
+		found += (j < n) && (data[j] == key);
+	}
+	return found;
+}
+
+/*
+ *  stress_bsearch_prefetch()
+ *	branchless lower bound that prefetches both of the next
+ *	possible probes while the current compare resolves
+ */
+static size_t OPTIMIZE3 stress_bsearch_prefetch(const stress_bsearch_context_t *ctxt)
+{
+	const int32_t *data = ctxt->data;
+	const size_t n = ctxt->n;
+	register size_t i, found = 0;
+
+	for (i = 0; i < n; i++) {
+		const int32_t key = ctxt->queries[i];
+		register const int32_t *base = data;
+		register size_t len = n, j;
+
+		while (len > 1) {
+			const size_t half = len >> 1;
+
+			len -= half;
+			shim_builtin_prefetch(base + (len >> 1) - 1);
+			shim_builtin_prefetch(base + half + (len >> 1) - 1);
+			base = (base[half - 1] < key) ? base + half : base;
+		}
+		j = (size_t)(base - data) + (*base < key);
+		found += (j < n) && (data[j] == key);
+	}
+	return found;
+}
+
+/*
+ *  stress_bsearch_eytzinger_build()
+ *	lay out the sorted data in breadth first order of an implicit
+ *	complete binary tree, returns the next data index
+ */
+static size_t stress_bsearch_eytzinger_build(
+	int32_t *eyt,
+	const int32_t *data,
+	const size_t n,
+	size_t i,
+	const size_t k)
+{
+	if (k <= n) {
+		i = stress_bsearch_eytzinger_build(eyt, data, n, i, k << 1);
+		eyt[k] = data[i++];
+		i = stress_bsearch_eytzinger_build(eyt, data, n, i, (k << 1) + 1);
+	}
+	return i;
+}
+
+/*
+ *  stress_bsearch_eytzinger()
+ *	branchless descent of the Eytzinger layout, the 16 descendants
+ *	four levels down share a cache line which is prefetched
+ */
+static size_t OPTIMIZE3 stress_bsearch_eytzinger(const stress_bsearch_context_t *ctxt)
+{
+	const int32_t *eyt = ctxt->eyt;
+	const size_t n = ctxt->n;
+	register size_t i, found = 0;
+
+	for (i = 0; i < n; i++) {
+		const int32_t key = ctxt->queries[i];
+		register size_t k = 1;
+
+		while (k <= n) {
+			shim_builtin_prefetch(eyt + (k << 4));
+			k = (k << 1) + (eyt[k] < key);
+		}
+		/* strip the trailing right turns and the last left turn */
+		while (k & 1)
+			k >>= 1;
+		k >>= 1;
+		found += (k != 0) && (eyt[k] == key);
+	}
+	return found;
+}
+
+/*
+ *  k-ary search tree, blocks of BSEARCH_KARY_B sorted keys, block k
+ *  has children k * (B + 1) + i + 1 for i = 0..B, unused slots at the
+ *  end are padded with INT32_MAX which the data never reaches
+ */
+#define BSEARCH_KARY_CHILD(k, i)	((k) * (BSEARCH_KARY_B + 1) + (i) + 1)
+
+static size_t stress_bsearch_kary_build(
+	int32_t *blocks,
+	const size_t n_blocks,
+	const int32_t *data,
+	const size_t n,
+	const size_t k,
+	size_t t)
+{
+	if (k < n_blocks) {
+		size_t i;
+
+		for (i = 0; i < BSEARCH_KARY_B; i++) {
+			t = stress_bsearch_kary_build(blocks, n_blocks, data, n,
+				BSEARCH_KARY_CHILD(k, i), t);
+			blocks[(k * BSEARCH_KARY_B) + i] = (t < n) ? data[t++] : INT32_MAX;
+		}
+		t = stress_bsearch_kary_build(blocks, n_blocks, data, n,
+			BSEARCH_KARY_CHILD(k, BSEARCH_KARY_B), t);
+	}
+	return t;
+}
+
+static size_t OPTIMIZE3 stress_bsearch_kary_scalar(const stress_bsearch_context_t *ctxt)
+{
+	const int32_t *blocks = ctxt->blocks;
+	const size_t n = ctxt->n, n_blocks = ctxt->n_blocks;
+	register size_t i, found = 0;
+
+	for (i = 0; i < n; i++) {
+		const int32_t key = ctxt->queries[i];
+		register size_t k = 0;
+		int32_t result = INT32_MAX;
+
+		while (k < n_blocks) {
+			const int32_t *keys = blocks + (k * BSEARCH_KARY_B);
+			register size_t j, rank = 0;
+
+			for (j = 0; j < BSEARCH_KARY_B; j++)
+				rank += (keys[j] < key);
+			if (rank < BSEARCH_KARY_B)
+				result = keys[rank];
+			k = BSEARCH_KARY_CHILD(k, rank);
+		}
+		found += (result == key);
+	}
+	return found;
+}
+
+#if defined(STRESS_BSEARCH_HAVE_AVX2)
+/*
+ *  stress_bsearch_kary_avx2()
+ *	as the scalar k-ary search, the rank of the key in a block
+ *	is the popcount of two 8 way compares
+ */
+static size_t OPTIMIZE3 __attribute__((target("avx2"))) stress_bsearch_kary_avx2(const stress_bsearch_context_t *ctxt)
+{
+	const int32_t *blocks = ctxt->blocks;
+	const size_t n = ctxt->n, n_blocks = ctxt->n_blocks;
+	register size_t i, found = 0;
+
+	for (i = 0; i < n; i++) {
+		const int32_t key = ctxt->queries[i];
+		const __m256i vkey = _mm256_set1_epi32(key);
+		register size_t k = 0;
+		int32_t result = INT32_MAX;
+
+		while (k < n_blocks) {
+			const int32_t *keys = blocks + (k * BSEARCH_KARY_B);
+			const __m256i lt0 = _mm256_cmpgt_epi32(vkey, _mm256_load_si256((const __m256i *)keys));
+			const __m256i lt1 = _mm256_cmpgt_epi32(vkey, _mm256_load_si256((const __m256i *)(keys + 8)));
+			const unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(lt0)) |
+				((unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(lt1)) << 8);
+			const size_t rank = (size_t)__builtin_popcount(mask);
+
+			if (rank < BSEARCH_KARY_B)
+				result = keys[rank];
+			k = BSEARCH_KARY_CHILD(k, rank);
+		}
+		found += (result == key);
+	}
+	return found;
+}
+#endif
+
+static size_t stress_bsearch_kary(const stress_bsearch_context_t *ctxt)
+{
+#if defined(STRESS_BSEARCH_HAVE_AVX2)
+	if (ctxt->kary_avx2)
+		return stress_bsearch_kary_avx2(ctxt);
+#endif
+	return stress_bsearch_kary_scalar(ctxt);
+}
+
+/*
+ *  stress_bsearch_interleave()
+ *	BSEARCH_LANES branchless searches in lock step, every lane
+ *	has the same trip count so the independent loads of all the
+ *	lanes are in flight together
+ */
+static size_t OPTIMIZE3 stress_bsearch_interleave(const stress_bsearch_context_t *ctxt)
+{
+	const int32_t *data = ctxt->data;
+	const size_t n = ctxt->n;
+	register size_t i, found = 0;
+
+	for (i = 0; i + BSEARCH_LANES <= n; i += BSEARCH_LANES) {
+		const int32_t *base[BSEARCH_LANES];
+		const int32_t *keys = ctxt->queries + i;
+		register size_t len = n, l;
+
+		for (l = 0; l < BSEARCH_LANES; l++)
+			base[l] = data;
+		while (len > 1) {
+			const size_t half = len >> 1;
+
+			for (l = 0; l < BSEARCH_LANES; l++)
+				base[l] = (base[l][half - 1] < keys[l]) ? base[l] + half : base[l];
+			len -= half;
+		}
+		for (l = 0; l < BSEARCH_LANES; l++) {
+			const size_t j = (size_t)(base[l] - data) + (*base[l] < keys[l]);
+
+			found += (j < n) && (data[j] == keys[l]);
+		}
+	}
+	for (; i < n; i++) {
+		const int32_t key = ctxt->queries[i];
+		const size_t j = stress_bsearch_lower(data, n, key);
+
+		found += (j < n) && (data[j] == key);
+	}
+	return found;
+}
+
+static const stress_bsearch_method_t stress_bsearch_methods[] = {
+	{ "all",	NULL },
+	{ "libc",	stress_bsearch_libc },
+	{ "branchless",	stress_bsearch_branchless },
+	{ "prefetch",	stress_bsearch_prefetch },
+	{ "eytzinger",	stress_bsearch_eytzinger },
+	{ "kary",	stress_bsearch_kary },
+	{ "interleave",	stress_bsearch_interleave },
 };
 
-#if defined(HAVE_BSEARCH)
+#define BSEARCH_METHODS	(SIZEOF_ARRAY(stress_bsearch_methods))
+
+/*
+ *  stress_set_bsearch_method()
+ *	set the search method
+ */
+static int stress_set_bsearch_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < BSEARCH_METHODS; i++) {
+		if (!strcmp(stress_bsearch_methods[i].name, name)) {
+			stress_set_setting("bsearch-method", TYPE_ID_SIZE_T, &i);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "bsearch-method must be one of:");
+	for (i = 0; i < BSEARCH_METHODS; i++) {
+		(void)fprintf(stderr, " %s", stress_bsearch_methods[i].name);
+	}
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
 
 /*
  *  stress_bsearch()
@@ -62,10 +417,12 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
  */
 static int stress_bsearch(const stress_args_t *args)
 {
-	int32_t *data, *ptr;
-	size_t n, n8, i;
+	stress_bsearch_context_t ctxt;
+	size_t n, n8, i, m, bsearch_method = 0;
 	uint64_t bsearch_size = DEFAULT_BSEARCH_SIZE;
-	double rate, duration = 0.0, count = 0.0, sorted = 0.0;
+	double durations[BSEARCH_METHODS], lookups[BSEARCH_METHODS];
+	double count = 0.0, sorted = 0.0;
+	int rc = EXIT_SUCCESS;
 
 	if (!stress_get_setting("bsearch-size", &bsearch_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -73,55 +430,116 @@ static int stress_bsearch(const stress_args_t *args)
 		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
 			bsearch_size = MIN_BSEARCH_SIZE;
 	}
+	(void)stress_get_setting("bsearch-method", &bsearch_method);
 	n = (size_t)bsearch_size;
 	n8 = (n + 7) & ~7UL;
 
+	(void)memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.args = args;
+	ctxt.n = n;
+	ctxt.n_blocks = (n + BSEARCH_KARY_B - 1) / BSEARCH_KARY_B;
+	ctxt.blocks_size = ctxt.n_blocks * BSEARCH_KARY_B * sizeof(*ctxt.blocks);
+#if defined(STRESS_BSEARCH_HAVE_AVX2)
+	ctxt.kary_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
 	/* allocate in multiples of 8 */
-	if ((data = calloc(n8, sizeof(*data))) == NULL) {
+	ctxt.data = calloc(n8, sizeof(*ctxt.data));
+	ctxt.queries = calloc(n8, sizeof(*ctxt.queries));
+	ctxt.eyt = calloc(n + 1, sizeof(*ctxt.eyt));
+	if (!ctxt.data || !ctxt.queries || !ctxt.eyt) {
 		pr_inf_skip("%s: malloc of %zu bytes failed, out of memory\n",
-			args->name, n8 * sizeof(*data));
-		return EXIT_NO_RESOURCE;
+			args->name, (3 * n8 + 1) * sizeof(*ctxt.data));
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	/* k-ary blocks are cache line aligned for the aligned vector loads */
+	ctxt.blocks = (int32_t *)mmap(NULL, ctxt.blocks_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ctxt.blocks == MAP_FAILED) {
+		ctxt.blocks = NULL;
+		pr_inf_skip("%s: mmap of %zu bytes failed, out of memory\n",
+			args->name, ctxt.blocks_size);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	if ((args->instance == 0) && (bsearch_method == 0 ||
+	    stress_bsearch_methods[bsearch_method].func == stress_bsearch_kary))
+		pr_dbg("%s: kary search using %s block compares\n", args->name,
+			ctxt.kary_avx2 ? "AVX2" : "scalar");
+
+	for (m = 0; m < BSEARCH_METHODS; m++) {
+		durations[m] = 0.0;
+		lookups[m] = 0.0;
 	}
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
-		double t;
-
-		stress_sort_data_int32_init(data, n);
-		stress_sort_compare_reset();
-		t = stress_time_now();
-		for (ptr = data, i = 0; i < n; i++, ptr++) {
-			int32_t *result;
-
-			result = bsearch(ptr, data, n, sizeof(*ptr), stress_sort_cmp_fwd_int32);
-			if (g_opt_flags & OPT_FLAGS_VERIFY) {
-				if (result == NULL)
-					pr_fail("%s: element %zu could not be found\n",
-						args->name, i);
-				else if (*result != *ptr)
-					pr_fail("%s: element %zu "
-						"found %" PRIu32
-						", expecting %" PRIu32 "\n",
-						args->name, i, *result, *ptr);
+		stress_sort_data_int32_init(ctxt.data, n);
+		(void)memcpy(ctxt.queries, ctxt.data, n * sizeof(*ctxt.queries));
+		stress_sort_data_int32_shuffle(ctxt.queries, n);
+		(void)stress_bsearch_eytzinger_build(ctxt.eyt, ctxt.data, n, 0, 1);
+		(void)stress_bsearch_kary_build(ctxt.blocks, ctxt.n_blocks, ctxt.data, n, 0, 0);
+
+		for (m = 1; m < BSEARCH_METHODS; m++) {
+			double t;
+			size_t found;
+
+			if ((bsearch_method != 0) && (bsearch_method != m))
+				continue;
+			if (stress_bsearch_methods[m].func == stress_bsearch_libc)
+				stress_sort_compare_reset();
+			t = stress_time_now();
+			found = stress_bsearch_methods[m].func(&ctxt);
+			durations[m] += stress_time_now() - t;
+			lookups[m] += (double)n;
+			if (stress_bsearch_methods[m].func == stress_bsearch_libc) {
+				count += (double)stress_sort_compare_get();
+				sorted += (double)n;
 			}
+			if (found != n) {
+				pr_fail("%s: %s search found %zu of %zu elements\n",
+					args->name, stress_bsearch_methods[m].name, found, n);
+				rc = EXIT_FAILURE;
+			}
+			if (!keep_stressing(args))
+				break;
 		}
-		duration += stress_time_now() - t;
-		count += (double)stress_sort_compare_get();
-		sorted += (double)i;
 		inc_counter(args);
-	} while (keep_stressing(args));
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
-	rate = (duration > 0.0) ? count / duration : 0.0;
-	stress_metrics_set(args, 0, "bsearch comparisons per sec", rate);
-	stress_metrics_set(args, 1, "bsearch comparisons per item", count / sorted);
+	for (m = 1, i = 0; m < BSEARCH_METHODS; m++) {
+		char str[64];
 
-	free(data);
-	return EXIT_SUCCESS;
+		if (durations[m] <= 0.0)
+			continue;
+		if ((stress_bsearch_methods[m].func == stress_bsearch_libc) && (sorted > 0.0)) {
+			stress_metrics_set(args, i++, "bsearch comparisons per sec", count / durations[m]);
+			stress_metrics_set(args, i++, "bsearch comparisons per item", count / sorted);
+		}
+		(void)snprintf(str, sizeof(str), "%s lookups per sec at %zu items",
+			stress_bsearch_methods[m].name, n);
+		stress_metrics_set(args, i++, str, lookups[m] / durations[m]);
+	}
+
+tidy:
+	if (ctxt.blocks)
+		(void)munmap((void *)ctxt.blocks, ctxt.blocks_size);
+	free(ctxt.eyt);
+	free(ctxt.queries);
+	free(ctxt.data);
+	return rc;
 }
 
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_bsearch_method,	stress_set_bsearch_method },
+	{ OPT_bsearch_size,	stress_set_bsearch_size },
+	{ 0,			NULL },
+};
+
 stressor_info_t stress_bsearch_info = {
 	.stressor = stress_bsearch,
 	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
@@ -132,6 +550,18 @@ stressor_info_t stress_bsearch_info = {
 
 #else
 
+static int stress_set_bsearch_method(const char *name)
+{
+	(void)fprintf(stderr, "option --bsearch-method is not implemented, ignoring option '%s'\n", name);
+	return 0;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_bsearch_method,	stress_set_bsearch_method },
+	{ OPT_bsearch_size,	stress_set_bsearch_size },
+	{ 0,			NULL },
+};
+
 stressor_info_t stress_bsearch_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
@@ -17,11 +17,17 @@
  *
  */
 #include "stress-ng.h"
+#include "core-asm-x86.h"
 #include "core-builtin.h"
 #include "core-cpu-cache.h"
 
 #define DEFAULT_L1_SIZE		(64)
 
+#define CACHELINE_MATRIX_CPUS		(64)	/* max cpus in latency matrix, more are sampled */
+#define CACHELINE_MATRIX_ROUNDS		(1000)	/* ping-pong round trips per sample */
+#define CACHELINE_MATRIX_SAMPLES	(3)	/* samples per cpu pair, fastest is used */
+#define CACHELINE_MATRIX_YIELD		(1U << 16)	/* spins before yielding */
+
 #if defined(HAVE_ATOMIC_FETCH_ADD) &&	\
     defined(__ATOMIC_RELAXED)
 #define SHIM_ATOMIC_INC(ptr)       \
@@ -41,6 +47,7 @@ do {				\
 static const stress_help_t help[] = {
 	{ NULL,	"cacheline N",		"start N workers that exercise cachelines" },
 	{ NULL,	"cacheline-affinity",	"modify CPU affinity" },
+	{ NULL,	"cacheline-matrix",	"measure core to core cache line transfer latency matrix" },
 	{ NULL,	"cacheline-method M",	"use cacheline stressing method M" },
 	{ NULL,	"cacheline-ops N",	"stop after N cacheline bogo operations" },
 	{ NULL,	NULL,			NULL }
@@ -624,6 +631,343 @@ static inline void stress_cacheline_change_affinity(
 }
 #endif
 
+static int stress_set_cacheline_matrix(const char *opt)
+{
+	return stress_set_setting_true("cacheline-matrix", opt);
+}
+
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_SCHED_GETAFFINITY) &&		\
+    defined(HAVE_SCHED_SETAFFINITY) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+#define HAVE_CACHELINE_MATRIX
+
+/* core to core latency matrix, shared with the parent for the yaml output */
+typedef struct {
+	uint32_t n_cpus;				/* cpus in matrix */
+	int32_t cpus[CACHELINE_MATRIX_CPUS];		/* cpu numbers */
+	double ns[CACHELINE_MATRIX_CPUS][CACHELINE_MATRIX_CPUS];	/* one way latency, 0.0 = not measured */
+} stress_cacheline_matrix_t;
+
+/* cache line ping-ponged between a pair of threads */
+typedef struct {
+	uint64_t line ALIGN64;		/* ping-pong cache line */
+	bool stop ALIGN64;		/* tell the pong thread to stop */
+	int pinned;			/* 0 pinning, 1 pinned, -1 failed */
+	int32_t cpu;			/* pong thread cpu */
+} stress_cacheline_pingpong_t;
+
+static stress_cacheline_matrix_t *cacheline_matrix;
+
+/*
+ *  stress_cacheline_pin()
+ *	pin the calling thread to a cpu
+ */
+static int stress_cacheline_pin(const int32_t cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET((int)cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_cacheline_spin()
+ *	spin until the ping-pong line contains val with a compare and
+ *	swap to val + 1, returns false if the spin has to be abandoned
+ */
+static inline bool stress_cacheline_spin(
+	stress_cacheline_pingpong_t *pp,
+	const uint64_t val)
+{
+	uint32_t spins = 0;
+
+	for (;;) {
+		uint64_t expected = val;
+
+		if (__atomic_load_n(&pp->line, __ATOMIC_RELAXED) == val) {
+			if (__atomic_compare_exchange_n(&pp->line, &expected, val + 1,
+					false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+				return true;
+		}
+#if defined(HAVE_ASM_X86_PAUSE)
+		stress_asm_x86_pause();
+#endif
+		if (UNLIKELY(++spins >= CACHELINE_MATRIX_YIELD)) {
+			spins = 0;
+			if (__atomic_load_n(&pp->stop, __ATOMIC_RELAXED) ||
+			    !keep_stressing_flag())
+				return false;
+			(void)shim_sched_yield();
+		}
+	}
+}
+
+/*
+ *  stress_cacheline_pong()
+ *	pong thread, turn odd line values into the next even value
+ */
+static void *stress_cacheline_pong(void *arg)
+{
+	static void *nowt = NULL;
+	stress_cacheline_pingpong_t *pp = (stress_cacheline_pingpong_t *)arg;
+	uint64_t val = 1;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	__atomic_store_n(&pp->pinned, stress_cacheline_pin(pp->cpu) < 0 ? -1 : 1, __ATOMIC_RELEASE);
+
+	while (stress_cacheline_spin(pp, val))
+		val += 2;
+
+	return &nowt;
+}
+
+/*
+ *  stress_cacheline_pair()
+ *	ping-pong a cache line between this thread on cpu_a and a thread
+ *	on cpu_b with compare and swaps, return the fastest one way cache
+ *	line transfer latency in nanoseconds, 0.0 if it can't be measured
+ */
+static double stress_cacheline_pair(const int32_t cpu_a, const int32_t cpu_b)
+{
+	stress_cacheline_pingpong_t *pp;
+	pthread_t pthread;
+	double best = 0.0;
+	uint64_t val = 0;
+	int i, ret;
+
+	if (stress_cacheline_pin(cpu_a) < 0)
+		return 0.0;
+	pp = (stress_cacheline_pingpong_t *)mmap(NULL, sizeof(*pp), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pp == MAP_FAILED)
+		return 0.0;
+	pp->line = 0;
+	pp->stop = false;
+	pp->pinned = 0;
+	pp->cpu = cpu_b;
+
+	ret = pthread_create(&pthread, NULL, stress_cacheline_pong, (void *)pp);
+	if (ret) {
+		(void)munmap((void *)pp, sizeof(*pp));
+		return 0.0;
+	}
+	while (__atomic_load_n(&pp->pinned, __ATOMIC_ACQUIRE) == 0)
+		(void)shim_sched_yield();
+
+	if (pp->pinned > 0) {
+		/* warm up, get both threads running and the line in cache */
+		for (i = 0; i < CACHELINE_MATRIX_ROUNDS; i++, val += 2) {
+			if (!stress_cacheline_spin(pp, val))
+				goto stop;
+		}
+		for (i = 0; i < CACHELINE_MATRIX_SAMPLES; i++) {
+			double t, ns;
+			int j;
+
+			t = stress_time_now();
+			for (j = 0; j < CACHELINE_MATRIX_ROUNDS; j++, val += 2) {
+				if (!stress_cacheline_spin(pp, val))
+					goto stop;
+			}
+			ns = (stress_time_now() - t) * STRESS_DBL_NANOSECOND /
+				(2.0 * (double)CACHELINE_MATRIX_ROUNDS);
+			if ((best <= 0.0) || (ns < best))
+				best = ns;
+		}
+	}
+stop:
+	__atomic_store_n(&pp->stop, true, __ATOMIC_RELAXED);
+	(void)pthread_join(pthread, NULL);
+	(void)munmap((void *)pp, sizeof(*pp));
+
+	return best;
+}
+
+/*
+ *  stress_cacheline_matrix_report()
+ *	print the latency matrix and set min, mean and max metrics
+ */
+static void stress_cacheline_matrix_report(const stress_args_t *args)
+{
+	const uint32_t n = cacheline_matrix->n_cpus;
+	double min = 0.0, max = 0.0, sum = 0.0;
+	uint32_t i, j, pairs = 0;
+	char buf[16];
+
+	pr_lock();
+	pr_inf("%s: core to core one way cache line transfer latency (nanosecs):\n", args->name);
+	{
+		char line[8 + (CACHELINE_MATRIX_CPUS * 8)];
+		size_t len;
+
+		len = (size_t)snprintf(line, sizeof(line), "%5s", "cpu");
+		for (j = 0; j < n; j++)
+			len += (size_t)snprintf(line + len, sizeof(line) - len, " %6" PRId32, cacheline_matrix->cpus[j]);
+		pr_inf("%s: %s\n", args->name, line);
+		for (i = 0; i < n; i++) {
+			len = (size_t)snprintf(line, sizeof(line), "%5" PRId32, cacheline_matrix->cpus[i]);
+			for (j = 0; j < n; j++) {
+				const double ns = cacheline_matrix->ns[i][j];
+
+				if (i == j)
+					(void)shim_strlcpy(buf, "-", sizeof(buf));
+				else if (ns <= 0.0)
+					(void)shim_strlcpy(buf, "n/a", sizeof(buf));
+				else
+					(void)snprintf(buf, sizeof(buf), "%.1f", ns);
+				len += (size_t)snprintf(line + len, sizeof(line) - len, " %6s", buf);
+			}
+			pr_inf("%s: %s\n", args->name, line);
+		}
+	}
+	pr_unlock();
+
+	for (i = 0; i < n; i++) {
+		for (j = i + 1; j < n; j++) {
+			const double ns = cacheline_matrix->ns[i][j];
+
+			if (ns <= 0.0)
+				continue;
+			if ((pairs == 0) || (ns < min))
+				min = ns;
+			if (ns > max)
+				max = ns;
+			sum += ns;
+			pairs++;
+		}
+	}
+	if (pairs) {
+		stress_metrics_set(args, 0, "nanosecs min core to core latency", min);
+		stress_metrics_set(args, 1, "nanosecs mean core to core latency", sum / (double)pairs);
+		stress_metrics_set(args, 2, "nanosecs max core to core latency", max);
+	}
+}
+
+/*
+ *  stress_cacheline_matrix()
+ *	measure the cache line transfer latency between every pair
+ *	of cpus, sampling the cpus on systems with many cpus
+ */
+static int stress_cacheline_matrix(const stress_args_t *args)
+{
+	cpu_set_t allowed;
+	int32_t cpus[CPU_SETSIZE];
+	uint32_t i, j, n = 0;
+
+	if (args->instance > 0)
+		return EXIT_SUCCESS;
+	if (args->num_instances > 1)
+		pr_inf("%s: the latency matrix is only measured by instance 0\n", args->name);
+
+	if (!cacheline_matrix) {
+		pr_inf_skip("%s: cannot allocate latency matrix, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_inf_skip("%s: cannot get cpu affinity, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET((int)i, &allowed))
+			cpus[n++] = (int32_t)i;
+	}
+	if (n < 2) {
+		pr_inf_skip("%s: the latency matrix needs at least 2 cpus, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)memset(cacheline_matrix, 0, sizeof(*cacheline_matrix));
+	cacheline_matrix->n_cpus = STRESS_MINIMUM(n, CACHELINE_MATRIX_CPUS);
+	for (i = 0; i < cacheline_matrix->n_cpus; i++)
+		cacheline_matrix->cpus[i] = cpus[((uint64_t)i * n) / cacheline_matrix->n_cpus];
+	if (n > CACHELINE_MATRIX_CPUS)
+		pr_inf("%s: sampling %d of %" PRIu32 " cpus for the latency matrix\n",
+			args->name, CACHELINE_MATRIX_CPUS, n);
+	n = cacheline_matrix->n_cpus;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; keep_stressing(args) && (i < n); i++) {
+			for (j = i + 1; keep_stressing(args) && (j < n); j++) {
+				const double ns = stress_cacheline_pair(cacheline_matrix->cpus[i], cacheline_matrix->cpus[j]);
+				double *ns_ij = &cacheline_matrix->ns[i][j];
+
+				if ((ns > 0.0) && ((*ns_ij <= 0.0) || (ns < *ns_ij))) {
+					*ns_ij = ns;
+					cacheline_matrix->ns[j][i] = ns;
+				}
+				inc_counter(args);
+			}
+		}
+	} while (keep_stressing(args));
+
+	(void)sched_setaffinity(0, sizeof(allowed), &allowed);
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_cacheline_matrix_report(args);
+
+	return EXIT_SUCCESS;
+}
+
+static void stress_cacheline_init(void)
+{
+	bool cacheline_matrix_flag = false;
+
+	(void)stress_get_setting("cacheline-matrix", &cacheline_matrix_flag);
+	if (!cacheline_matrix_flag)
+		return;
+
+	cacheline_matrix = (stress_cacheline_matrix_t *)mmap(NULL, sizeof(*cacheline_matrix),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (cacheline_matrix == MAP_FAILED)
+		cacheline_matrix = NULL;
+	else
+		cacheline_matrix->n_cpus = 0;
+}
+
+static void stress_cacheline_deinit(void)
+{
+	if (cacheline_matrix) {
+		(void)munmap((void *)cacheline_matrix, sizeof(*cacheline_matrix));
+		cacheline_matrix = NULL;
+	}
+}
+
+/*
+ *  stress_cacheline_yaml()
+ *	add the latency matrix to the yaml metrics
+ */
+static void stress_cacheline_yaml(FILE *yaml)
+{
+	uint32_t i, j;
+
+	if (!cacheline_matrix || !cacheline_matrix->n_cpus)
+		return;
+
+	pr_yaml(yaml, "      core-to-core-latency-cpus: [");
+	for (i = 0; i < cacheline_matrix->n_cpus; i++)
+		pr_yaml(yaml, "%s%" PRId32, i ? ", " : "", cacheline_matrix->cpus[i]);
+	pr_yaml(yaml, "]\n");
+	pr_yaml(yaml, "      core-to-core-latency-nsec:\n");
+	for (i = 0; i < cacheline_matrix->n_cpus; i++) {
+		pr_yaml(yaml, "        - [");
+		for (j = 0; j < cacheline_matrix->n_cpus; j++)
+			pr_yaml(yaml, "%s%.2f", j ? ", " : "", cacheline_matrix->ns[i][j]);
+		pr_yaml(yaml, "]\n");
+	}
+}
+#endif
+
 static int stress_cacheline_child(
 	const stress_args_t *args,
 	const int index,
@@ -672,6 +1016,19 @@ static int stress_cacheline(const stress_args_t *args)
 	size_t cacheline_method = 0;
 	stress_cacheline_func func;
 	bool cacheline_affinity = false;
+	bool cacheline_matrix_flag = false;
+
+	(void)stress_get_setting("cacheline-matrix", &cacheline_matrix_flag);
+	if (cacheline_matrix_flag) {
+#if defined(HAVE_CACHELINE_MATRIX)
+		return stress_cacheline_matrix(args);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: latency matrix not supported on this system, "
+				"skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
 
 	(void)stress_get_setting("cacheline-affinity", &cacheline_affinity);
 	(void)stress_get_setting("cacheline-method", &cacheline_method);
@@ -722,12 +1079,18 @@ finish:
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cacheline_affinity,	stress_set_cacheline_affinity },
+	{ OPT_cacheline_matrix,		stress_set_cacheline_matrix },
 	{ OPT_cacheline_method,		stress_set_cacheline_method },
 	{ 0,				NULL },
 };
 
 stressor_info_t stress_cacheline_info = {
 	.stressor = stress_cacheline,
+#if defined(HAVE_CACHELINE_MATRIX)
+	.init = stress_cacheline_init,
+	.deinit = stress_cacheline_deinit,
+	.yaml = stress_cacheline_yaml,
+#endif
 	.class = CLASS_CPU_CACHE,
 	.verify = VERIFY_ALWAYS,
 	.opt_set_funcs = opt_set_funcs,
@@ -157,6 +157,102 @@ static inline bool check_invalid_clock_id(const clockid_t id) {
 
 #define FD_TO_CLOCKID(fd)	((~(clockid_t)(fd) << 3) | 3)
 
+#define CLOCK_COST_READS	(10000)	/* clock reads per read cost sample */
+#define CLOCK_COST_SAMPLES	(3)	/* read cost samples, fastest is used */
+
+/*
+ *  stress_clock_read_cost()
+ *	fastest nanoseconds per clock_gettime read of a clock via the
+ *	C library (vDSO where supported) or directly via the system
+ *	call, returns 0.0 if the clock cannot be read
+ */
+static double stress_clock_read_cost(const clockid_t id, const bool use_syscall)
+{
+	double best = 0.0;
+	int i, j;
+
+	for (i = 0; i < CLOCK_COST_SAMPLES; i++) {
+		struct timespec t;
+		double t_start, ns;
+
+		t_start = stress_time_now();
+		for (j = 0; j < CLOCK_COST_READS; j++) {
+			int ret;
+
+#if defined(__NR_clock_gettime) &&	\
+    defined(HAVE_SYSCALL)
+			if (use_syscall)
+				ret = (int)syscall(__NR_clock_gettime, id, &t);
+			else
+#else
+			(void)use_syscall;
+#endif
+				ret = clock_gettime(id, &t);
+			if (ret < 0)
+				return 0.0;
+		}
+		ns = (stress_time_now() - t_start) * STRESS_DBL_NANOSECOND / (double)CLOCK_COST_READS;
+		if ((best <= 0.0) || (ns < best))
+			best = ns;
+	}
+	return best;
+}
+
+/*
+ *  stress_clock_read_costs()
+ *	set metrics of the read cost of each clock via the vDSO and
+ *	the system call, a vDSO read of CLOCK_MONOTONIC that costs
+ *	about as much as a system call means the kernel clocksource
+ *	cannot be read from user space, e.g. hpet or acpi_pm rather
+ *	than tsc, and time stamping is far more expensive
+ */
+static void stress_clock_read_costs(const stress_args_t *args)
+{
+	size_t i, j, idx = 0;
+
+	for (i = 0; i < SIZEOF_ARRAY(clocks); i++) {
+		double ns_vdso, ns_syscall = 0.0;
+		char desc[64];
+
+		for (j = 0; j < i; j++) {
+			if (clocks[j].id == clocks[i].id)
+				break;
+		}
+		if (j < i)
+			continue;
+
+		ns_vdso = stress_clock_read_cost(clocks[i].id, false);
+		if (ns_vdso <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "nanosecs per %s vDSO read", clocks[i].name);
+		stress_metrics_set(args, idx++, desc, ns_vdso);
+#if defined(__NR_clock_gettime) &&	\
+    defined(HAVE_SYSCALL)
+		ns_syscall = stress_clock_read_cost(clocks[i].id, true);
+		if (ns_syscall > 0.0) {
+			(void)snprintf(desc, sizeof(desc), "nanosecs per %s syscall read", clocks[i].name);
+			stress_metrics_set(args, idx++, desc, ns_syscall);
+		}
+#endif
+#if defined(CLOCK_MONOTONIC)
+		if ((args->instance == 0) && (clocks[i].id == CLOCK_MONOTONIC)) {
+			char clocksource[64];
+
+			(void)shim_strlcpy(clocksource, "unknown", sizeof(clocksource));
+			if (system_read("/sys/devices/system/clocksource/clocksource0/current_clocksource",
+					clocksource, sizeof(clocksource)) > 0)
+				clocksource[strcspn(clocksource, "\n")] = '\0';
+			pr_dbg("%s: clocksource %s, CLOCK_MONOTONIC read %.1f ns, syscall %.1f ns\n",
+				args->name, clocksource, ns_vdso, ns_syscall);
+			if ((ns_syscall > 0.0) && (ns_vdso > ns_syscall * 0.75))
+				pr_inf("%s: CLOCK_MONOTONIC reads cost %.1f ns, about the same as a "
+					"%.1f ns system call, clocksource '%s' cannot be read via the vDSO\n",
+					args->name, ns_vdso, ns_syscall, clocksource);
+		}
+#endif
+	}
+}
+
 /*
  *  stress_clock()
  *	stress system by rapid clocking system calls
@@ -176,6 +272,8 @@ static int stress_clock(const stress_args_t *args)
 	 */
 	stress_mwc_set_seed(0xf238, 0x1872);
 
+	stress_clock_read_costs(args);
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
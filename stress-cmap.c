@@ -0,0 +1,1072 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-bitops.h"
+#include "core-builtin.h"
+#include "core-put.h"
+
+#define MIN_CMAP_KEYS		(1 * KB)
+#define MAX_CMAP_KEYS		(4 * MB)
+#define DEFAULT_CMAP_KEYS	(64 * KB)
+
+#define MIN_CMAP_READS		(0)
+#define MAX_CMAP_READS		(100)
+#define DEFAULT_CMAP_READS	(90)
+
+#define MIN_CMAP_THREADS	(1)
+#define MAX_CMAP_THREADS	(1024)
+
+#define CMAP_POINT_USECS	(250000)	/* run time of each method and thread count */
+#define CMAP_STRIPES		(256)		/* locks in the striped and rcu maps */
+#define CMAP_EPOCH_OPS		(32)		/* ops between epoch announcements */
+#define CMAP_RECLAIM_RETIRES	(64)		/* retires between reclaim scans */
+#define CMAP_SO_LOAD		(1)		/* split-ordered items per bucket before doubling */
+#define CMAP_MAX_POINTS		(16)		/* thread counts, 1, 2, 4 .. max */
+
+static const stress_help_t help[] = {
+	{ NULL,	"cmap N",		"start N workers exercising concurrent hash maps" },
+	{ NULL,	"cmap-keys N",		"number of distinct keys, a power of 2" },
+	{ NULL,	"cmap-method M",	"select map, one of all, striped, rcu or splitorder" },
+	{ NULL,	"cmap-ops N",		"stop after N concurrent map bogo operations" },
+	{ NULL,	"cmap-reads P",		"percentage of ops that are lookups, default 90" },
+	{ NULL,	"cmap-threads N",	"maximum number of threads, default is all CPUs" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_cmap_keys(const char *opt)
+{
+	uint64_t cmap_keys;
+
+	cmap_keys = stress_get_uint64_byte(opt);
+	stress_check_power_of_2("cmap-keys", cmap_keys, MIN_CMAP_KEYS, MAX_CMAP_KEYS);
+	return stress_set_setting("cmap-keys", TYPE_ID_UINT64, &cmap_keys);
+}
+
+static int stress_set_cmap_reads(const char *opt)
+{
+	uint32_t cmap_reads;
+
+	cmap_reads = stress_get_uint32(opt);
+	stress_check_range("cmap-reads", (uint64_t)cmap_reads, MIN_CMAP_READS, MAX_CMAP_READS);
+	return stress_set_setting("cmap-reads", TYPE_ID_UINT32, &cmap_reads);
+}
+
+static int stress_set_cmap_threads(const char *opt)
+{
+	uint32_t cmap_threads;
+
+	cmap_threads = stress_get_uint32(opt);
+	stress_check_range("cmap-threads", (uint64_t)cmap_threads, MIN_CMAP_THREADS, MAX_CMAP_THREADS);
+	return stress_set_setting("cmap-threads", TYPE_ID_UINT32, &cmap_threads);
+}
+
+static int stress_set_cmap_method(const char *opt);
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_cmap_keys,	stress_set_cmap_keys },
+	{ OPT_cmap_method,	stress_set_cmap_method },
+	{ OPT_cmap_reads,	stress_set_cmap_reads },
+	{ OPT_cmap_threads,	stress_set_cmap_threads },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE) &&		\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&		\
+    defined(HAVE_ATOMIC_FETCH_SUB) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(__ATOMIC_SEQ_CST)
+
+#define CMAP_LOAD(ptr)		__atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define CMAP_STORE(ptr, val)	__atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define CMAP_CAS(ptr, old, new)	\
+	__atomic_compare_exchange_n(ptr, old, new, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+/* split-ordered list deletion mark in bit 0 of next */
+#define CMAP_MARKED(ptr)	((uintptr_t)(ptr) & 1)
+#define CMAP_MARK(ptr)		((stress_cmap_node_t *)((uintptr_t)(ptr) | 1))
+#define CMAP_UNMARK(ptr)	((stress_cmap_node_t *)((uintptr_t)(ptr) & ~(uintptr_t)1))
+
+typedef struct stress_cmap_node {
+	struct stress_cmap_node *next;		/* next node in list */
+	struct stress_cmap_node *retire_next;	/* next node in retire list */
+	uint64_t retire_epoch;			/* epoch when retired */
+	uint64_t so_key;			/* split-order key */
+	uint64_t key;				/* key */
+	uint64_t value;				/* value */
+} stress_cmap_node_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+} ALIGN64 stress_cmap_stripe_t;
+
+struct stress_cmap;
+
+/*
+ *  per thread state, epoch is the last global epoch the thread
+ *  announced at a quiescent point between ops, nodes the thread
+ *  retires are freed once every thread has announced a later epoch
+ */
+typedef struct {
+	uint64_t epoch;				/* announced epoch */
+	uint64_t ops;				/* ops completed */
+	uint64_t rnd;				/* xorshift state */
+	int64_t delta;				/* inserts - deletes */
+	uint64_t retired;			/* nodes retired */
+	uint64_t freed;				/* retired nodes freed */
+	stress_cmap_node_t *retire_list;	/* nodes awaiting free */
+	uint32_t retires;			/* retires since last reclaim */
+	struct stress_cmap *map;
+	pthread_t pthread;
+	int ret;
+} ALIGN64 stress_cmap_thread_t;
+
+typedef struct {
+	const char *name;
+	bool (*lookup)(struct stress_cmap *map, stress_cmap_thread_t *thread, const uint64_t key, uint64_t *value);
+	bool (*insert)(struct stress_cmap *map, stress_cmap_thread_t *thread, const uint64_t key, const uint64_t value);
+	bool (*delete)(struct stress_cmap *map, stress_cmap_thread_t *thread, const uint64_t key);
+} stress_cmap_method_t;
+
+typedef struct stress_cmap {
+	uint64_t epoch ALIGN64;			/* global epoch */
+	uint64_t count ALIGN64;			/* split-ordered item count */
+	size_t so_size;				/* split-ordered buckets in use */
+	bool start ALIGN64;			/* threads start when true */
+	bool stop;				/* threads stop when true */
+	const stress_cmap_method_t *method ALIGN64;
+	stress_cmap_node_t **buckets;		/* bucket heads */
+	size_t n_buckets;			/* number of buckets, power of 2 */
+	stress_cmap_stripe_t *stripes;		/* bucket locks */
+	stress_cmap_thread_t *threads;		/* per thread state */
+	uint32_t n_threads;			/* threads in this run */
+	uint64_t keys;				/* key range, power of 2 */
+	uint32_t reads;				/* percentage of lookups */
+} stress_cmap_t;
+
+static sigset_t set;
+
+/*
+ *  stress_cmap_hash()
+ *	splitmix64 finalizer, the top bit is cleared to leave
+ *	room for the split-ordered regular node marker
+ */
+static inline uint64_t stress_cmap_hash(uint64_t key)
+{
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+
+	return key & ~(1ULL << 63);
+}
+
+static inline uint64_t stress_cmap_rnd(stress_cmap_thread_t *thread)
+{
+	register uint64_t x = thread->rnd;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	thread->rnd = x;
+
+	return x;
+}
+
+static stress_cmap_node_t *stress_cmap_node_alloc(const uint64_t key, const uint64_t value)
+{
+	stress_cmap_node_t *node;
+
+	node = malloc(sizeof(*node));
+	if (UNLIKELY(!node))
+		return NULL;
+	node->next = NULL;
+	node->key = key;
+	node->value = value;
+	node->so_key = stress_reverse64(stress_cmap_hash(key) | (1ULL << 63));
+
+	return node;
+}
+
+/*
+ *  stress_cmap_reclaim()
+ *	free the retired nodes that were retired before the
+ *	oldest epoch any thread has announced
+ */
+static void stress_cmap_reclaim(stress_cmap_t *map, stress_cmap_thread_t *thread)
+{
+	stress_cmap_node_t **prev, *node;
+	uint64_t min = ~0ULL;
+	uint32_t i;
+
+	for (i = 0; i < map->n_threads; i++) {
+		const uint64_t epoch = CMAP_LOAD(&map->threads[i].epoch);
+
+		if (epoch < min)
+			min = epoch;
+	}
+	prev = &thread->retire_list;
+	for (node = *prev; node; node = *prev) {
+		if (node->retire_epoch < min) {
+			*prev = node->retire_next;
+			free(node);
+			thread->freed++;
+		} else {
+			prev = &node->retire_next;
+		}
+	}
+}
+
+/*
+ *  stress_cmap_retire()
+ *	defer freeing an unlinked node, readers may still hold it
+ */
+static void stress_cmap_retire(stress_cmap_t *map, stress_cmap_thread_t *thread, stress_cmap_node_t *node)
+{
+	node->retire_epoch = __atomic_fetch_add(&map->epoch, 1, __ATOMIC_SEQ_CST);
+	node->retire_next = thread->retire_list;
+	thread->retire_list = node;
+	thread->retired++;
+	if (++thread->retires >= CMAP_RECLAIM_RETIRES) {
+		thread->retires = 0;
+		stress_cmap_reclaim(map, thread);
+	}
+}
+
+static inline pthread_mutex_t *stress_cmap_lock(stress_cmap_t *map, const size_t bucket)
+{
+	return &map->stripes[bucket & (CMAP_STRIPES - 1)].lock;
+}
+
+/*
+ *  striped lock map, every op takes the bucket's stripe lock
+ */
+static bool OPTIMIZE3 stress_cmap_striped_lookup(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key,
+	uint64_t *value)
+{
+	const size_t bucket = stress_cmap_hash(key) & (map->n_buckets - 1);
+	pthread_mutex_t *lock = stress_cmap_lock(map, bucket);
+	stress_cmap_node_t *node;
+	bool found = false;
+
+	(void)thread;
+
+	(void)pthread_mutex_lock(lock);
+	for (node = map->buckets[bucket]; node; node = node->next) {
+		if (node->key == key) {
+			*value = node->value;
+			found = true;
+			break;
+		}
+	}
+	(void)pthread_mutex_unlock(lock);
+
+	return found;
+}
+
+static bool OPTIMIZE3 stress_cmap_striped_insert(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key,
+	const uint64_t value)
+{
+	const size_t bucket = stress_cmap_hash(key) & (map->n_buckets - 1);
+	pthread_mutex_t *lock = stress_cmap_lock(map, bucket);
+	stress_cmap_node_t *node, *new_node;
+
+	new_node = stress_cmap_node_alloc(key, value);
+	if (UNLIKELY(!new_node))
+		return false;
+
+	(void)pthread_mutex_lock(lock);
+	for (node = map->buckets[bucket]; node; node = node->next) {
+		if (node->key == key) {
+			(void)pthread_mutex_unlock(lock);
+			free(new_node);
+			return false;
+		}
+	}
+	new_node->next = map->buckets[bucket];
+	map->buckets[bucket] = new_node;
+	(void)pthread_mutex_unlock(lock);
+	thread->delta++;
+
+	return true;
+}
+
+static bool OPTIMIZE3 stress_cmap_striped_delete(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key)
+{
+	const size_t bucket = stress_cmap_hash(key) & (map->n_buckets - 1);
+	pthread_mutex_t *lock = stress_cmap_lock(map, bucket);
+	stress_cmap_node_t **prev, *node;
+
+	(void)pthread_mutex_lock(lock);
+	prev = &map->buckets[bucket];
+	for (node = *prev; node; prev = &node->next, node = node->next) {
+		if (node->key == key) {
+			*prev = node->next;
+			(void)pthread_mutex_unlock(lock);
+			free(node);
+			thread->delta--;
+			return true;
+		}
+	}
+	(void)pthread_mutex_unlock(lock);
+
+	return false;
+}
+
+/*
+ *  rcu style read-mostly map, lookups walk the buckets without
+ *  locks, writers serialize on the stripe lock, publish nodes
+ *  with release stores and retire deleted nodes to the epochs
+ */
+static bool OPTIMIZE3 stress_cmap_rcu_lookup(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key,
+	uint64_t *value)
+{
+	const size_t bucket = stress_cmap_hash(key) & (map->n_buckets - 1);
+	stress_cmap_node_t *node;
+
+	(void)thread;
+
+	for (node = CMAP_LOAD(&map->buckets[bucket]); node; node = CMAP_LOAD(&node->next)) {
+		if (node->key == key) {
+			*value = node->value;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool OPTIMIZE3 stress_cmap_rcu_insert(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key,
+	const uint64_t value)
+{
+	const size_t bucket = stress_cmap_hash(key) & (map->n_buckets - 1);
+	pthread_mutex_t *lock = stress_cmap_lock(map, bucket);
+	stress_cmap_node_t *node, *new_node;
+
+	new_node = stress_cmap_node_alloc(key, value);
+	if (UNLIKELY(!new_node))
+		return false;
+
+	(void)pthread_mutex_lock(lock);
+	for (node = map->buckets[bucket]; node; node = node->next) {
+		if (node->key == key) {
+			(void)pthread_mutex_unlock(lock);
+			free(new_node);
+			return false;
+		}
+	}
+	new_node->next = map->buckets[bucket];
+	CMAP_STORE(&map->buckets[bucket], new_node);
+	(void)pthread_mutex_unlock(lock);
+	thread->delta++;
+
+	return true;
+}
+
+static bool OPTIMIZE3 stress_cmap_rcu_delete(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key)
+{
+	const size_t bucket = stress_cmap_hash(key) & (map->n_buckets - 1);
+	pthread_mutex_t *lock = stress_cmap_lock(map, bucket);
+	stress_cmap_node_t **prev, *node;
+
+	(void)pthread_mutex_lock(lock);
+	prev = &map->buckets[bucket];
+	for (node = *prev; node; prev = &node->next, node = node->next) {
+		if (node->key == key) {
+			CMAP_STORE(prev, node->next);
+			(void)pthread_mutex_unlock(lock);
+			stress_cmap_retire(map, thread, node);
+			thread->delta--;
+			return true;
+		}
+	}
+	(void)pthread_mutex_unlock(lock);
+
+	return false;
+}
+
+/*
+ *  lock-free split-ordered list map (Shalev and Shavit), all the
+ *  items are in one Harris-Michael lock-free list sorted by bit
+ *  reversed hash, buckets are pointers to dummy nodes in the list
+ *  that are added lazily as the bucket count doubles
+ */
+static inline int stress_cmap_so_cmp(
+	const stress_cmap_node_t *node,
+	const uint64_t so_key,
+	const uint64_t key)
+{
+	if (node->so_key != so_key)
+		return node->so_key < so_key ? -1 : 1;
+	if (node->key != key)
+		return node->key < key ? -1 : 1;
+	return 0;
+}
+
+/*
+ *  stress_cmap_so_find()
+ *	find the first node >= (so_key, key) after head, unlinking
+ *	and retiring any marked nodes on the way, *pprev is the link
+ *	to *pcur, returns true if *pcur matches
+ */
+static bool OPTIMIZE3 stress_cmap_so_find(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	stress_cmap_node_t *head,
+	const uint64_t so_key,
+	const uint64_t key,
+	stress_cmap_node_t ***pprev,
+	stress_cmap_node_t **pcur)
+{
+	stress_cmap_node_t **prev, *cur, *next;
+	int cmp;
+
+retry:
+	prev = &head->next;
+	cur = CMAP_UNMARK(CMAP_LOAD(prev));
+	for (;;) {
+		if (!cur) {
+			*pprev = prev;
+			*pcur = NULL;
+			return false;
+		}
+		next = CMAP_LOAD(&cur->next);
+		if (CMAP_MARKED(next)) {
+			stress_cmap_node_t *expected = cur;
+
+			if (!CMAP_CAS(prev, &expected, CMAP_UNMARK(next)))
+				goto retry;
+			stress_cmap_retire(map, thread, cur);
+			cur = CMAP_UNMARK(next);
+			continue;
+		}
+		cmp = stress_cmap_so_cmp(cur, so_key, key);
+		if (cmp >= 0) {
+			*pprev = prev;
+			*pcur = cur;
+			return cmp == 0;
+		}
+		prev = &cur->next;
+		cur = next;
+	}
+}
+
+static stress_cmap_node_t *stress_cmap_so_bucket(stress_cmap_t *map, stress_cmap_thread_t *thread, const size_t bucket);
+
+/*
+ *  stress_cmap_so_bucket_init()
+ *	add the dummy node of a bucket after the dummy of its parent,
+ *	the bucket with the top set bit cleared
+ */
+static stress_cmap_node_t *stress_cmap_so_bucket_init(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const size_t bucket)
+{
+	stress_cmap_node_t *head, *dummy, **prev, *cur, *expected = NULL;
+	size_t top = bucket;
+
+	while (top & (top - 1))
+		top &= top - 1;
+	head = stress_cmap_so_bucket(map, thread, bucket ^ top);
+	if (UNLIKELY(!head))
+		return NULL;
+	dummy = malloc(sizeof(*dummy));
+	if (UNLIKELY(!dummy))
+		return NULL;
+	dummy->key = 0;
+	dummy->value = 0;
+	dummy->so_key = stress_reverse64((uint64_t)bucket);
+
+	for (;;) {
+		if (stress_cmap_so_find(map, thread, head, dummy->so_key, 0, &prev, &cur)) {
+			/* another thread added it first */
+			free(dummy);
+			dummy = cur;
+			break;
+		}
+		dummy->next = cur;
+		expected = cur;
+		if (CMAP_CAS(prev, &expected, dummy))
+			break;
+	}
+	expected = NULL;
+	(void)CMAP_CAS(&map->buckets[bucket], &expected, dummy);
+
+	return dummy;
+}
+
+static inline stress_cmap_node_t *stress_cmap_so_bucket(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const size_t bucket)
+{
+	stress_cmap_node_t *head = CMAP_LOAD(&map->buckets[bucket]);
+
+	if (LIKELY(head != NULL))
+		return head;
+	return stress_cmap_so_bucket_init(map, thread, bucket);
+}
+
+static bool OPTIMIZE3 stress_cmap_so_lookup(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key,
+	uint64_t *value)
+{
+	const uint64_t hash = stress_cmap_hash(key);
+	const uint64_t so_key = stress_reverse64(hash | (1ULL << 63));
+	stress_cmap_node_t *cur, *next;
+
+	cur = stress_cmap_so_bucket(map, thread, hash & (CMAP_LOAD(&map->so_size) - 1));
+	if (UNLIKELY(!cur))
+		return false;
+
+	for (cur = CMAP_UNMARK(CMAP_LOAD(&cur->next)); cur; cur = CMAP_UNMARK(next)) {
+		const int cmp = stress_cmap_so_cmp(cur, so_key, key);
+
+		next = CMAP_LOAD(&cur->next);
+		if (cmp < 0)
+			continue;
+		if ((cmp > 0) || CMAP_MARKED(next))
+			return false;
+		*value = cur->value;
+		return true;
+	}
+	return false;
+}
+
+static bool OPTIMIZE3 stress_cmap_so_insert(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key,
+	const uint64_t value)
+{
+	const uint64_t hash = stress_cmap_hash(key);
+	const size_t size = CMAP_LOAD(&map->so_size);
+	stress_cmap_node_t *head, **prev, *cur, *node = NULL;
+	uint64_t count;
+
+	head = stress_cmap_so_bucket(map, thread, hash & (size - 1));
+	if (UNLIKELY(!head))
+		return false;
+
+	for (;;) {
+		stress_cmap_node_t *expected;
+
+		if (stress_cmap_so_find(map, thread, head, stress_reverse64(hash | (1ULL << 63)),
+					key, &prev, &cur)) {
+			free(node);
+			return false;
+		}
+		if (!node) {
+			node = stress_cmap_node_alloc(key, value);
+			if (UNLIKELY(!node))
+				return false;
+		}
+		node->next = cur;
+		expected = cur;
+		if (CMAP_CAS(prev, &expected, node))
+			break;
+	}
+	thread->delta++;
+
+	count = __atomic_fetch_add(&map->count, 1, __ATOMIC_RELAXED) + 1;
+	if ((count / size > CMAP_SO_LOAD) && (size < map->n_buckets)) {
+		size_t expected = size;
+
+		(void)CMAP_CAS(&map->so_size, &expected, size * 2);
+	}
+	return true;
+}
+
+static bool OPTIMIZE3 stress_cmap_so_delete(
+	stress_cmap_t *map,
+	stress_cmap_thread_t *thread,
+	const uint64_t key)
+{
+	const uint64_t hash = stress_cmap_hash(key);
+	const uint64_t so_key = stress_reverse64(hash | (1ULL << 63));
+	stress_cmap_node_t *head, **prev, *cur, *next, *expected;
+
+	head = stress_cmap_so_bucket(map, thread, hash & (CMAP_LOAD(&map->so_size) - 1));
+	if (UNLIKELY(!head))
+		return false;
+
+	for (;;) {
+		if (!stress_cmap_so_find(map, thread, head, so_key, key, &prev, &cur))
+			return false;
+		next = CMAP_LOAD(&cur->next);
+		if (CMAP_MARKED(next))
+			continue;
+		/* logical delete, the winner of the mark owns the delete */
+		if (CMAP_CAS(&cur->next, &next, CMAP_MARK(next)))
+			break;
+	}
+	expected = cur;
+	if (CMAP_CAS(prev, &expected, next))
+		stress_cmap_retire(map, thread, cur);
+	else
+		(void)stress_cmap_so_find(map, thread, head, so_key, key, &prev, &cur);
+
+	thread->delta--;
+	(void)__atomic_fetch_sub(&map->count, 1, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+static const stress_cmap_method_t cmap_methods[] = {
+	{ "striped",	stress_cmap_striped_lookup,	stress_cmap_striped_insert,	stress_cmap_striped_delete },
+	{ "rcu",	stress_cmap_rcu_lookup,		stress_cmap_rcu_insert,		stress_cmap_rcu_delete },
+	{ "splitorder",	stress_cmap_so_lookup,		stress_cmap_so_insert,		stress_cmap_so_delete },
+};
+
+#define CMAP_METHODS	(SIZEOF_ARRAY(cmap_methods))
+
+/*
+ *  stress_cmap_func()
+ *	map worker thread, a mix of lookups and equal numbers of
+ *	inserts and deletes of random keys, the epoch is announced
+ *	every CMAP_EPOCH_OPS ops
+ */
+static void *stress_cmap_func(void *arg)
+{
+	static void *nowt = NULL;
+	stress_cmap_thread_t *thread = (stress_cmap_thread_t *)arg;
+	stress_cmap_t *map = thread->map;
+	const stress_cmap_method_t *method = map->method;
+	const uint64_t key_mask = map->keys - 1;
+	const uint32_t reads = map->reads;
+	uint64_t sum = 0;
+
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	while (!CMAP_LOAD(&map->start))
+		(void)shim_sched_yield();
+
+	while (!CMAP_LOAD(&map->stop)) {
+		register int i;
+
+		for (i = 0; i < CMAP_EPOCH_OPS; i++) {
+			const uint64_t rnd = stress_cmap_rnd(thread);
+			const uint64_t key = (rnd >> 16) & key_mask;
+			uint64_t value;
+
+			if ((uint32_t)(rnd & 0xffff) % 100 < reads) {
+				if (method->lookup(map, thread, key, &value))
+					sum += value;
+			} else if (rnd & (1ULL << 63)) {
+				(void)method->insert(map, thread, key, key);
+			} else {
+				(void)method->delete(map, thread, key);
+			}
+		}
+		thread->ops += CMAP_EPOCH_OPS;
+		CMAP_STORE(&thread->epoch, CMAP_LOAD(&map->epoch));
+	}
+	stress_uint64_put(sum);
+
+	return &nowt;
+}
+
+/*
+ *  stress_cmap_clear()
+ *	free all the nodes, threads must be stopped
+ */
+static void stress_cmap_clear(stress_cmap_t *map)
+{
+	size_t i;
+
+	if (map->method->lookup == stress_cmap_so_lookup) {
+		stress_cmap_node_t *node = map->buckets[0];
+
+		while (node) {
+			stress_cmap_node_t *next = CMAP_UNMARK(node->next);
+
+			free(node);
+			node = next;
+		}
+	} else {
+		for (i = 0; i < map->n_buckets; i++) {
+			stress_cmap_node_t *node = map->buckets[i];
+
+			while (node) {
+				stress_cmap_node_t *next = node->next;
+
+				free(node);
+				node = next;
+			}
+		}
+	}
+	(void)memset(map->buckets, 0, map->n_buckets * sizeof(*map->buckets));
+}
+
+/*
+ *  stress_cmap_verify()
+ *	with the threads stopped, check the number of items matches
+ *	the successful inserts and deletes and that each item is in
+ *	the right bucket or, for the split-ordered list, in order
+ */
+static int stress_cmap_verify(const stress_args_t *args, stress_cmap_t *map, const int64_t expected)
+{
+	int64_t count = 0;
+	size_t i;
+
+	if (map->method->lookup == stress_cmap_so_lookup) {
+		const stress_cmap_node_t *node, *prev = NULL;
+
+		for (node = map->buckets[0]; node; prev = node, node = node->next) {
+			if (CMAP_MARKED(node->next)) {
+				pr_fail("%s: %s deleted node with key %" PRIu64 " is still linked\n",
+					args->name, map->method->name, node->key);
+				return EXIT_FAILURE;
+			}
+			if (prev && (stress_cmap_so_cmp(prev, node->so_key, node->key) >= 0)) {
+				pr_fail("%s: %s list is out of order at key %" PRIu64 "\n",
+					args->name, map->method->name, node->key);
+				return EXIT_FAILURE;
+			}
+			count += (node->so_key & 1);
+		}
+	} else {
+		for (i = 0; i < map->n_buckets; i++) {
+			const stress_cmap_node_t *node;
+
+			for (node = map->buckets[i]; node; node = node->next) {
+				if ((stress_cmap_hash(node->key) & (map->n_buckets - 1)) != i) {
+					pr_fail("%s: %s key %" PRIu64 " is in the wrong bucket\n",
+						args->name, map->method->name, node->key);
+					return EXIT_FAILURE;
+				}
+				count++;
+			}
+		}
+	}
+	if (count != expected) {
+		pr_fail("%s: %s map has %" PRId64 " items, expected %" PRId64 "\n",
+			args->name, map->method->name, count, expected);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_cmap_run()
+ *	fill half the keys and run n_threads of the method
+ *	for CMAP_POINT_USECS, returns the ops per second
+ */
+static int stress_cmap_run(
+	const stress_args_t *args,
+	stress_cmap_t *map,
+	const stress_cmap_method_t *method,
+	const uint32_t n_threads,
+	double *rate)
+{
+	stress_cmap_thread_t *fill = &map->threads[0];
+	uint64_t key, ops = 0, retired = 0, freed = 0;
+	int64_t expected = 0;
+	double t_start, duration;
+	uint32_t i, started = 0;
+	int rc = EXIT_SUCCESS;
+
+	*rate = 0.0;
+	map->method = method;
+	map->n_threads = n_threads;
+	map->start = false;
+	map->stop = false;
+	map->epoch = 0;
+	map->count = 0;
+	map->so_size = 2;
+	(void)memset(map->threads, 0, sizeof(*map->threads) * n_threads);
+	for (i = 0; i < n_threads; i++) {
+		map->threads[i].map = map;
+		map->threads[i].rnd = stress_mwc64() | 1;
+	}
+
+	if (method->lookup == stress_cmap_so_lookup) {
+		stress_cmap_node_t *dummy = calloc(1, sizeof(*dummy));
+
+		if (!dummy)
+			return EXIT_NO_RESOURCE;
+		map->buckets[0] = dummy;
+	}
+	for (key = 0; key < map->keys; key++) {
+		if ((stress_mwc8() & 1) && method->insert(map, fill, key, key))
+			expected++;
+	}
+	fill->delta = 0;
+
+	for (i = 0; i < n_threads; i++) {
+		map->threads[i].ret = pthread_create(&map->threads[i].pthread, NULL,
+			stress_cmap_func, (void *)&map->threads[i]);
+		if (map->threads[i].ret) {
+			if (map->threads[i].ret == EAGAIN)
+				continue;
+			pr_fail("%s: pthread create failed, errno=%d (%s)\n",
+				args->name, map->threads[i].ret, strerror(map->threads[i].ret));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		started++;
+	}
+
+	t_start = stress_time_now();
+	CMAP_STORE(&map->start, true);
+	if (rc == EXIT_SUCCESS)
+		(void)shim_usleep_interruptible(CMAP_POINT_USECS);
+	CMAP_STORE(&map->stop, true);
+	duration = stress_time_now() - t_start;
+
+	for (i = 0; i < n_threads; i++) {
+		stress_cmap_thread_t *thread = &map->threads[i];
+		stress_cmap_node_t *node, *next;
+
+		if (thread->ret)
+			continue;
+		thread->ret = pthread_join(thread->pthread, NULL);
+		if (thread->ret && (thread->ret != ESRCH)) {
+			pr_fail("%s: pthread join failed, errno=%d (%s)\n",
+				args->name, thread->ret, strerror(thread->ret));
+			rc = EXIT_FAILURE;
+		}
+		ops += thread->ops;
+		expected += thread->delta;
+		retired += thread->retired;
+		freed += thread->freed;
+		for (node = thread->retire_list; node; node = next) {
+			next = node->retire_next;
+			free(node);
+		}
+	}
+	if (started < n_threads)
+		pr_dbg("%s: only %" PRIu32 " of %" PRIu32 " threads started\n",
+			args->name, started, n_threads);
+	pr_dbg("%s: %s %" PRIu32 " threads, %" PRIu64 " nodes retired, %" PRIu64
+		" freed while running\n", args->name, method->name, n_threads, retired, freed);
+
+	if ((rc == EXIT_SUCCESS) && (g_opt_flags & OPT_FLAGS_VERIFY))
+		rc = stress_cmap_verify(args, map, expected);
+	stress_cmap_clear(map);
+
+	add_counter(args, ops);
+	if ((started == n_threads) && (duration > 0.0))
+		*rate = (double)ops / duration;
+
+	return rc;
+}
+
+/*
+ *  stress_set_cmap_method()
+ *	set the map method, index CMAP_METHODS is all
+ */
+static int stress_set_cmap_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = CMAP_METHODS;
+		return stress_set_setting("cmap-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < CMAP_METHODS; i++) {
+		if (!strcmp(opt, cmap_methods[i].name))
+			return stress_set_setting("cmap-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "cmap-method must be one of: all");
+	for (i = 0; i < CMAP_METHODS; i++)
+		(void)fprintf(stderr, " %s", cmap_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_cmap()
+ *	run each map method with 1, 2, 4 .. up to the maximum
+ *	number of threads, the sweep repeats, accumulating, until
+ *	the run ends, and report the throughput scaling
+ */
+static int stress_cmap(const stress_args_t *args)
+{
+	uint64_t cmap_keys = DEFAULT_CMAP_KEYS;
+	uint32_t cmap_reads = DEFAULT_CMAP_READS;
+	uint32_t cmap_threads = (uint32_t)stress_get_processors_online();
+	size_t cmap_method = CMAP_METHODS;
+	uint32_t thread_counts[CMAP_MAX_POINTS];
+	double rates[CMAP_METHODS][CMAP_MAX_POINTS];
+	uint32_t samples[CMAP_METHODS][CMAP_MAX_POINTS];
+	size_t i, j, n_points = 0, n = 0;
+	stress_cmap_t map;
+	int rc = EXIT_SUCCESS;
+
+	if (!stress_get_setting("cmap-keys", &cmap_keys)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			cmap_keys = MAX_CMAP_KEYS;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			cmap_keys = MIN_CMAP_KEYS;
+	}
+	(void)stress_get_setting("cmap-reads", &cmap_reads);
+	(void)stress_get_setting("cmap-threads", &cmap_threads);
+	(void)stress_get_setting("cmap-method", &cmap_method);
+	if (cmap_threads < MIN_CMAP_THREADS)
+		cmap_threads = MIN_CMAP_THREADS;
+	if (cmap_threads > MAX_CMAP_THREADS)
+		cmap_threads = MAX_CMAP_THREADS;
+
+	for (i = 1; (i < cmap_threads) && (n_points < CMAP_MAX_POINTS - 1); i <<= 1)
+		thread_counts[n_points++] = (uint32_t)i;
+	thread_counts[n_points++] = cmap_threads;
+
+	(void)memset(&map, 0, sizeof(map));
+	(void)memset(rates, 0, sizeof(rates));
+	(void)memset(samples, 0, sizeof(samples));
+	map.keys = cmap_keys;
+	map.reads = cmap_reads;
+	map.n_buckets = (size_t)cmap_keys;
+	map.buckets = calloc(map.n_buckets, sizeof(*map.buckets));
+	map.stripes = calloc(CMAP_STRIPES, sizeof(*map.stripes));
+	map.threads = calloc(cmap_threads, sizeof(*map.threads));
+	if (!map.buckets || !map.stripes || !map.threads) {
+		pr_inf_skip("%s: cannot allocate map, skipping stressor\n", args->name);
+		free(map.threads);
+		free(map.stripes);
+		free(map.buckets);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < CMAP_STRIPES; i++)
+		(void)pthread_mutex_init(&map.stripes[i].lock, NULL);
+
+	(void)sigfillset(&set);
+
+	if ((args->instance == 0) && (args->num_instances > 1))
+		pr_inf("%s: %" PRIu32 " instances each running up to %" PRIu32
+			" threads will oversubscribe the CPUs, try 1 instance\n",
+			args->name, args->num_instances, cmap_threads);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	while ((rc == EXIT_SUCCESS) && keep_stressing(args)) {
+		for (i = 0; i < CMAP_METHODS; i++) {
+			if ((cmap_method < CMAP_METHODS) && (cmap_method != i))
+				continue;
+			for (j = 0; j < n_points; j++) {
+				double rate;
+
+				rc = stress_cmap_run(args, &map, &cmap_methods[i], thread_counts[j], &rate);
+				if (rc != EXIT_SUCCESS)
+					goto tidy;
+				if (rate > 0.0) {
+					rates[i][j] += rate;
+					samples[i][j]++;
+				}
+				if (!keep_stressing(args))
+					goto tidy;
+			}
+		}
+	}
+tidy:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %-10s %7s %10s %8s %10s  (%" PRIu32 "%% lookups, %" PRIu64 " keys)\n",
+			args->name, "map", "threads", "Mops/sec", "speedup", "efficiency",
+			cmap_reads, cmap_keys);
+	}
+	for (i = 0; i < CMAP_METHODS; i++) {
+		const double base = samples[i][0] ? rates[i][0] / (double)samples[i][0] : 0.0;
+
+		for (j = 0; j < n_points; j++) {
+			char str[64];
+			double rate;
+
+			if (!samples[i][j])
+				continue;
+			rate = rates[i][j] / (double)samples[i][j];
+			if (args->instance == 0) {
+				if (base > 0.0)
+					pr_inf("%s: %-10s %7" PRIu32 " %10.2f %8.2f %9.1f%%\n",
+						args->name, cmap_methods[i].name, thread_counts[j],
+						rate / 1000000.0, rate / base,
+						(100.0 * rate) / (base * (double)thread_counts[j]));
+				else
+					pr_inf("%s: %-10s %7" PRIu32 " %10.2f %8s %10s\n",
+						args->name, cmap_methods[i].name, thread_counts[j],
+						rate / 1000000.0, "-", "-");
+			}
+			(void)snprintf(str, sizeof(str), "%s %" PRIu32 " thread ops per sec",
+				cmap_methods[i].name, thread_counts[j]);
+			stress_metrics_set(args, n++, str, rate);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	for (i = 0; i < CMAP_STRIPES; i++)
+		(void)pthread_mutex_destroy(&map.stripes[i].lock);
+	free(map.threads);
+	free(map.stripes);
+	free(map.buckets);
+
+	return rc;
+}
+
+stressor_info_t stress_cmap_info = {
+	.stressor = stress_cmap,
+	.class = CLASS_CPU_CACHE | CLASS_MEMORY | CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
+#else
+
+static int stress_set_cmap_method(const char *opt)
+{
+	(void)opt;
+
+	(void)pr_inf("warning: --cmap-method not available on this system\n");
+	return 0;
+}
+
+stressor_info_t stress_cmap_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_CPU_CACHE | CLASS_MEMORY | CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help,
+	.unimplemented_reason = "built without pthread support or gcc __atomic builtins"
+};
+#endif
@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arch.h"
 
 #if defined(HAVE_UCONTEXT_H)
 #include <ucontext.h>
@@ -25,10 +26,35 @@
 
 #define STRESS_CONTEXTS		(3)
 
+#define MIN_CONTEXT_COROUTINES	(0)
+#define MAX_CONTEXT_COROUTINES	(4096)
+
+#define CONTEXT_SWITCHES	(100000)	/* switches per method per round */
+
 static stress_help_t help[] = {
-	{ NULL,	"context N",	 "start N workers exercising user context" },
-	{ NULL,	"context-ops N", "stop context workers after N bogo operations" },
-	{ NULL,	NULL,		 NULL }
+	{ NULL,	"context N",		"start N workers exercising user context" },
+	{ NULL,	"context-coroutines N",	"schedule N coroutines from a ready queue" },
+	{ NULL,	"context-method M",	"select switch, one of all, swapcontext, setjmp or asm" },
+	{ NULL,	"context-ops N",	"stop context workers after N bogo operations" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_context_coroutines(const char *opt)
+{
+	uint32_t context_coroutines;
+
+	context_coroutines = stress_get_uint32(opt);
+	stress_check_range("context-coroutines", (uint64_t)context_coroutines,
+		MIN_CONTEXT_COROUTINES, MAX_CONTEXT_COROUTINES);
+	return stress_set_setting("context-coroutines", TYPE_ID_UINT32, &context_coroutines);
+}
+
+static int stress_set_context_method(const char *opt);
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_context_coroutines,	stress_set_context_coroutines },
+	{ OPT_context_method,		stress_set_context_method },
+	{ 0,				NULL }
 };
 
 #if defined(HAVE_SWAPCONTEXT) &&	\
@@ -36,9 +62,21 @@ static stress_help_t help[] = {
 
 #define CONTEXT_STACK_SIZE	(16384)
 
+/*
+ *  hand written register saving switch, x86-64 only, needs
+ *  naked functions so the compiler adds no prologue
+ */
+#if defined(STRESS_ARCH_X86_64) &&	\
+    (NEED_GNUC(8, 0, 0) || NEED_CLANG(4, 0, 0)) && \
+    !defined(__ICC)
+#define HAVE_CONTEXT_ASM
+#endif
+
 typedef struct {
 	uint32_t check0;	/* memory clobbering check canary */
 	ucontext_t uctx;	/* swapcontext context */
+	void *jmpbuf[5];	/* __builtin_setjmp context */
+	void *sp;		/* hand written switch saved stack pointer */
 	uint32_t check1;	/* memory clobbering check canary */
 } chk_ucontext_t;
 
@@ -47,111 +85,344 @@ typedef struct {
 	uint32_t check1;	/* copy of original check1 canary */
 } chk_canary_t;
 
-typedef struct {
+typedef struct context_data {
 	chk_ucontext_t	cu ALIGN64;	/* check ucontext */
+	struct context_data *next;	/* next context in the ring */
 	uint8_t		stack[CONTEXT_STACK_SIZE + STACK_ALIGNMENT]; /* stack */
 	chk_canary_t	canary;	/* copy of canary */
 } context_data_t;
 
-static ucontext_t uctx_main;
-static context_data_t *context;
-static uint64_t context_counter ALIGN64;
-static uint64_t stress_max_ops;
+typedef struct {
+	const char *name;
+	int (*init)(const stress_args_t *args, context_data_t *context_data, void (*func)(void));
+	void (*swap)(chk_ucontext_t *from, chk_ucontext_t *to);
+} stress_context_method_t;
+
+typedef struct {
+	uint64_t switches;	/* context switches */
+	double duration;	/* time spent switching */
+} stress_context_stats_t;
+
+static chk_ucontext_t cu_main;			/* main (scheduler) context */
+static ucontext_t uctx_boot;			/* setjmp bootstrap return */
+static context_data_t *context_self;		/* context being switched to */
+static void (*context_func)(void);		/* setjmp bootstrap entry */
+static void (*context_swap)(chk_ucontext_t *from, chk_ucontext_t *to);
+static uint64_t context_counter ALIGN64;	/* context switches */
+static uint64_t context_end;			/* end of the current round */
 
-static void OPTIMIZE3 stress_thread1(void)
+/*
+ *  stress_context_canary()
+ *	zero the context and set the memory clobbering check canaries
+ */
+static void stress_context_canary(context_data_t *context_data)
 {
-	register ucontext_t *uctx0 = &context[0].cu.uctx;
-	register ucontext_t *uctx1 = &context[1].cu.uctx;
-	register const uint64_t max_ops = stress_max_ops;
+	(void)memset(context_data, 0, sizeof(*context_data));
 
-	if (max_ops) {
-		do {
-			context_counter++;
-			(void)swapcontext(uctx0, uctx1);
-		} while (keep_stressing_flag() && (context_counter < max_ops));
-	} else {
-		do {
-			context_counter++;
-			(void)swapcontext(uctx0, uctx1);
-		} while (keep_stressing_flag());
-	}
+	context_data->canary.check0 = stress_mwc32();
+	context_data->canary.check1 = stress_mwc32();
 
-	(void)swapcontext(uctx0, &uctx_main);
+	context_data->cu.check0 = context_data->canary.check0;
+	context_data->cu.check1 = context_data->canary.check1;
 }
 
-static void OPTIMIZE3 stress_thread2(void)
+static int stress_context_init(
+	const stress_args_t *args,
+	context_data_t *context_data,
+	void (*func)(void))
 {
-	register ucontext_t *uctx1 = &context[1].cu.uctx;
-	register ucontext_t *uctx2 = &context[2].cu.uctx;
-	register const uint64_t max_ops = stress_max_ops;
+	stress_context_canary(context_data);
 
-	if (max_ops) {
-		do {
-			context_counter++;
-			(void)swapcontext(uctx1, uctx2);
-		} while (keep_stressing_flag() && (!max_ops || (context_counter < max_ops)));
-	} else {
-		do {
-			context_counter++;
-			(void)swapcontext(uctx1, uctx2);
-		} while (keep_stressing_flag());
+	if (getcontext(&context_data->cu.uctx) < 0) {
+		pr_fail("%s: getcontext failed: %d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
 	}
-	(void)swapcontext(uctx1, &uctx_main);
+
+	context_data->cu.uctx.uc_stack.ss_sp =
+		(void *)stress_align_address(context_data->stack, STACK_ALIGNMENT);
+	context_data->cu.uctx.uc_stack.ss_size = CONTEXT_STACK_SIZE;
+	context_data->cu.uctx.uc_link = &cu_main.uctx;
+	makecontext(&context_data->cu.uctx, func, 0);
+
+	return 0;
 }
 
-static void OPTIMIZE3 stress_thread3(void)
+/*
+ *  swapcontext: saves and restores the signal mask, one
+ *  sigprocmask system call per switch
+ */
+static void stress_context_swapcontext_swap(chk_ucontext_t *from, chk_ucontext_t *to)
 {
-	register ucontext_t *uctx2 = &context[2].cu.uctx;
-	register ucontext_t *uctx0 = &context[0].cu.uctx;
-	register const uint64_t max_ops = stress_max_ops;
+	(void)swapcontext(&from->uctx, &to->uctx);
+}
 
-	if (max_ops) {
-		do {
-			context_counter++;
-			(void)swapcontext(uctx2, uctx0);
-		} while (keep_stressing_flag() && (!max_ops || (context_counter < max_ops)));
-	} else {
-		do {
-			context_counter++;
-			(void)swapcontext(uctx2, uctx0);
-		} while (keep_stressing_flag());
-	}
-	(void)swapcontext(uctx2, &uctx_main);
+#if defined(HAVE_BUILTIN_SETJMP)
+static void NOINLINE stress_context_longjmp(void **jmpbuf)
+{
+	__builtin_longjmp(jmpbuf, 1);
 }
 
-static void (*stress_threads[STRESS_CONTEXTS])(void) = {
-	stress_thread1,
-	stress_thread2,
-	stress_thread3,
-};
+/*
+ *  setjmp: the compiler spills the live registers and
+ *  __builtin_setjmp saves just the frame, stack and resume
+ *  addresses, no system calls
+ */
+static void NOINLINE stress_context_setjmp_swap(chk_ucontext_t *from, chk_ucontext_t *to)
+{
+	if (__builtin_setjmp(from->jmpbuf) == 0)
+		stress_context_longjmp(to->jmpbuf);
+}
 
-static int stress_context_init(
+/*
+ *  stress_context_setjmp_start()
+ *	first run on the new stack, save a jmpbuf to resume at
+ *	and return to the creator, resuming runs context_func
+ */
+static void stress_context_setjmp_start(void)
+{
+	if (__builtin_setjmp(context_self->cu.jmpbuf) == 0)
+		(void)swapcontext(&context_self->cu.uctx, &uctx_boot);
+	context_func();
+}
+
+static int stress_context_setjmp_init(
 	const stress_args_t *args,
-	void (*func)(void),
-	ucontext_t *uctx_link,
-	context_data_t *context_data)
+	context_data_t *context_data,
+	void (*func)(void))
 {
-	(void)memset(context_data, 0, sizeof(*context_data));
+	if (stress_context_init(args, context_data, stress_context_setjmp_start) < 0)
+		return -1;
 
-	if (getcontext(&context_data->cu.uctx) < 0) {
-		pr_fail("%s: getcontext failed: %d (%s)\n",
+	/* bootstrap onto the context stack with swapcontext */
+	context_self = context_data;
+	context_func = func;
+	if (swapcontext(&uctx_boot, &context_data->cu.uctx) < 0) {
+		pr_fail("%s: swapcontext failed: %d (%s)\n",
 			args->name, errno, strerror(errno));
 		return -1;
 	}
+	return 0;
+}
+#endif
 
-	context_data->canary.check0 = stress_mwc32();
-	context_data->canary.check1 = stress_mwc32();
+#if defined(HAVE_CONTEXT_ASM)
+/*
+ *  asm: save the callee saved registers, MXCSR and the x87
+ *  control word on the current stack, swap stack pointers
+ *  and restore the same from the new stack
+ */
+static void __attribute__((naked)) NOINLINE stress_context_asm_switch(void **from_sp, void *to_sp)
+{
+	(void)from_sp;
+	(void)to_sp;
+
+	__asm__ __volatile__(
+		"pushq %rbp\n\t"
+		"pushq %rbx\n\t"
+		"pushq %r12\n\t"
+		"pushq %r13\n\t"
+		"pushq %r14\n\t"
+		"pushq %r15\n\t"
+		"subq $8, %rsp\n\t"
+		"stmxcsr (%rsp)\n\t"
+		"fnstcw 4(%rsp)\n\t"
+		"movq %rsp, (%rdi)\n\t"
+		"movq %rsi, %rsp\n\t"
+		"ldmxcsr (%rsp)\n\t"
+		"fldcw 4(%rsp)\n\t"
+		"addq $8, %rsp\n\t"
+		"popq %r15\n\t"
+		"popq %r14\n\t"
+		"popq %r13\n\t"
+		"popq %r12\n\t"
+		"popq %rbx\n\t"
+		"popq %rbp\n\t"
+		"ret\n\t");
+}
 
-	context_data->cu.check0 = context_data->canary.check0;
-	context_data->cu.check1 = context_data->canary.check1;
-	context_data->cu.uctx.uc_stack.ss_sp =
-		(void *)stress_align_address(context_data->stack, STACK_ALIGNMENT);
-	context_data->cu.uctx.uc_stack.ss_size = CONTEXT_STACK_SIZE;
-	context_data->cu.uctx.uc_link = uctx_link;
-	makecontext(&context_data->cu.uctx, func, 0);
+/*
+ *  stress_context_asm_start()
+ *	first switch to a context returns here with the
+ *	entry function in r12 and a 16 byte aligned stack
+ */
+static void __attribute__((naked)) NOINLINE stress_context_asm_start(void)
+{
+	__asm__ __volatile__(
+		"callq *%r12\n\t"
+		"ud2\n\t");
+}
+
+static void stress_context_asm_swap(chk_ucontext_t *from, chk_ucontext_t *to)
+{
+	stress_context_asm_switch(&from->sp, to->sp);
+}
+
+static int stress_context_asm_init(
+	const stress_args_t *args,
+	context_data_t *context_data,
+	void (*func)(void))
+{
+	uintptr_t top, *sp;
+	uint32_t mxcsr;
+	uint16_t fcw;
+
+	(void)args;
+
+	stress_context_canary(context_data);
+	top = (uintptr_t)stress_align_address(context_data->stack, STACK_ALIGNMENT) +
+		CONTEXT_STACK_SIZE;
+	top &= ~(uintptr_t)15;
+
+	__asm__ __volatile__("stmxcsr %0\n" : "=m" (mxcsr));
+	__asm__ __volatile__("fnstcw %0\n" : "=m" (fcw));
+
+	/* initial frame popped by stress_context_asm_switch */
+	sp = (uintptr_t *)top - 8;
+	sp[0] = (uintptr_t)mxcsr | ((uintptr_t)fcw << 32);
+	sp[1] = 0;				/* r15 */
+	sp[2] = 0;				/* r14 */
+	sp[3] = 0;				/* r13 */
+	sp[4] = (uintptr_t)func;		/* r12 */
+	sp[5] = 0;				/* rbx */
+	sp[6] = 0;				/* rbp */
+	sp[7] = (uintptr_t)stress_context_asm_start;
+	context_data->cu.sp = (void *)sp;
 
 	return 0;
 }
+#endif
+
+static const stress_context_method_t context_methods[] = {
+	{ "swapcontext",	stress_context_init,		stress_context_swapcontext_swap },
+#if defined(HAVE_BUILTIN_SETJMP)
+	{ "setjmp",		stress_context_setjmp_init,	stress_context_setjmp_swap },
+#endif
+#if defined(HAVE_CONTEXT_ASM)
+	{ "asm",		stress_context_asm_init,	stress_context_asm_swap },
+#endif
+};
+
+#define CONTEXT_METHODS	(SIZEOF_ARRAY(context_methods))
+
+static int stress_set_context_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = CONTEXT_METHODS;
+		return stress_set_setting("context-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < CONTEXT_METHODS; i++) {
+		if (!strcmp(opt, context_methods[i].name))
+			return stress_set_setting("context-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "context-method must be one of: all");
+	for (i = 0; i < CONTEXT_METHODS; i++)
+		(void)fprintf(stderr, " %s", context_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_context_ring()
+ *	switch to the next context in the ring, the last switch
+ *	of a round returns to main
+ */
+static void OPTIMIZE3 stress_context_ring(void)
+{
+	register context_data_t *self = context_self;
+
+	for (;;) {
+		register context_data_t *next = self->next;
+
+		context_counter++;
+		if (UNLIKELY(context_counter >= context_end))
+			context_swap(&self->cu, &cu_main);
+		context_self = next;
+		context_swap(&self->cu, &next->cu);
+	}
+}
+
+/*
+ *  stress_context_coroutine()
+ *	yield straight back to the scheduler
+ */
+static void OPTIMIZE3 stress_context_coroutine(void)
+{
+	register context_data_t *self = context_self;
+
+	for (;;)
+		context_swap(&self->cu, &cu_main);
+}
+
+/*
+ *  stress_context_round()
+ *	create n contexts and switch between them until the round
+ *	ends, either in a ring or resumed from a FIFO ready queue
+ *	by main, returns false on failure
+ */
+static bool stress_context_round(
+	const stress_args_t *args,
+	const stress_context_method_t *method,
+	context_data_t *contexts,
+	context_data_t **queue,
+	const size_t n,
+	const uint64_t switches,
+	stress_context_stats_t *stats)
+{
+	void (*func)(void) = queue ? stress_context_coroutine : stress_context_ring;
+	const uint64_t start = context_counter;
+	double t;
+	size_t i;
+	bool ok = true;
+
+	for (i = 0; i < n; i++) {
+		if (method->init(args, &contexts[i], func) < 0)
+			return false;
+		contexts[i].next = &contexts[(i + 1) % n];
+		if (queue)
+			queue[i] = &contexts[i];
+	}
+	context_swap = method->swap;
+	context_end = start + switches;
+
+	t = stress_time_now();
+	if (queue) {
+		size_t head = 0, tail = 0;
+
+		while (context_counter < context_end) {
+			context_data_t *c = queue[head];
+
+			head = (head + 1 == n) ? 0 : head + 1;
+			context_self = c;
+			context_swap(&cu_main, &c->cu);
+			context_counter += 2;
+			queue[tail] = c;
+			tail = (tail + 1 == n) ? 0 : tail + 1;
+		}
+	} else {
+		context_self = &contexts[0];
+		context_swap(&cu_main, &contexts[0].cu);
+	}
+	stats->duration += stress_time_now() - t;
+	stats->switches += context_counter - start;
+
+	for (i = 0; i < n; i++) {
+		if (contexts[i].canary.check0 != contexts[i].cu.check0) {
+			pr_fail("%s: %s clobbered data before context region\n",
+				args->name, method->name);
+			ok = false;
+		}
+		if (contexts[i].canary.check1 != contexts[i].cu.check1) {
+			pr_fail("%s: %s clobbered data after context region\n",
+				args->name, method->name);
+			ok = false;
+		}
+	}
+	return ok;
+}
 
 /*
  *  stress_context()
@@ -159,75 +430,109 @@ static int stress_context_init(
  */
 static int stress_context(const stress_args_t *args)
 {
-	size_t i;
-	const size_t context_size = 3 * sizeof(*context);
-	double duration, rate, t;
-	int rc = EXIT_FAILURE;
-
-	context = (context_data_t *)mmap(NULL, context_size,
+	stress_context_stats_t stats[CONTEXT_METHODS];
+	context_data_t *contexts;
+	context_data_t **queue = NULL;
+	uint32_t context_coroutines = 0;
+	size_t context_method = CONTEXT_METHODS;
+	size_t i, j, n, context_size;
+	const uint64_t max_switches = args->max_ops * 1000;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("context-coroutines", &context_coroutines);
+	(void)stress_get_setting("context-method", &context_method);
+
+	n = context_coroutines ? (size_t)context_coroutines : STRESS_CONTEXTS;
+	context_size = n * sizeof(*contexts);
+	contexts = (context_data_t *)mmap(NULL, context_size,
 					PROT_READ | PROT_WRITE,
 					MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-	if (context == MAP_FAILED) {
-		pr_inf("%s: failed to allocate %d x %zd byte context buffers, skipping stressor\n",
-			args->name, STRESS_CONTEXTS, sizeof(context_data_t));
+	if (contexts == MAP_FAILED) {
+		pr_inf("%s: failed to allocate %zd x %zd byte context buffers, skipping stressor\n",
+			args->name, n, sizeof(context_data_t));
 		return EXIT_NO_RESOURCE;
 	}
-	(void)memset(&uctx_main, 0, sizeof(uctx_main));
-
-	context_counter = 0;
-	stress_max_ops = args->max_ops * 1000;
-
-	/* Create 3 micro threads */
-	for (i = 0; i < STRESS_CONTEXTS; i++) {
-		if (stress_context_init(args, stress_threads[i], &uctx_main, &context[i]) < 0)
-			goto fail;
+	if (context_coroutines) {
+		queue = calloc(n, sizeof(*queue));
+		if (!queue) {
+			pr_inf("%s: failed to allocate %zd entry ready queue, skipping stressor\n",
+				args->name, n);
+			(void)munmap((void *)contexts, context_size);
+			return EXIT_NO_RESOURCE;
+		}
 	}
+	(void)memset(&cu_main, 0, sizeof(cu_main));
+	(void)memset(stats, 0, sizeof(stats));
+	context_counter = 0;
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
-	/* And start.. */
-	t = stress_time_now();
-	if (swapcontext(&uctx_main, &context[0].cu.uctx) < 0) {
-		pr_fail("%s: swapcontext failed: %d (%s)\n",
-			args->name, errno, strerror(errno));
-		goto fail;
-	}
-	duration = stress_time_now() - t;
-
-	set_counter(args, context_counter / 1000);
-
-	for (i = 0; i < STRESS_CONTEXTS; i++) {
-		if (context[i].canary.check0 != context[i].cu.check0) {
-			pr_fail("%s: swapcontext clobbered data before context region\n",
-				args->name);
+	do {
+		for (i = 0; i < CONTEXT_METHODS; i++) {
+			uint64_t switches = CONTEXT_SWITCHES;
+
+			if ((context_method < CONTEXT_METHODS) && (context_method != i))
+				continue;
+			if (max_switches) {
+				if (context_counter >= max_switches)
+					break;
+				switches = STRESS_MINIMUM(switches, max_switches - context_counter);
+			}
+			if (!stress_context_round(args, &context_methods[i], contexts,
+					queue, n, switches, &stats[i])) {
+				rc = EXIT_FAILURE;
+				break;
+			}
+			set_counter(args, context_counter / 1000);
+			if (!keep_stressing(args))
+				break;
 		}
-		if (context[i].canary.check1 != context[i].cu.check1) {
-			pr_fail("%s: swapcontext clobbered data after context region\n",
-				args->name);
-		}
-	}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
-	rate = (duration > 0.0) ? (double)context_counter / duration : 0.0;
-	stress_metrics_set(args, 0, "swapcontext calls per sec", rate);
+	for (i = 0, j = 0; i < CONTEXT_METHODS; i++) {
+		char str[64];
+		double rate;
 
-	rc = EXIT_SUCCESS;
+		if (stats[i].duration <= 0.0)
+			continue;
+		if (i == 0) {
+			rate = (double)stats[i].switches / stats[i].duration;
+			stress_metrics_set(args, j++, "swapcontext calls per sec", rate);
+		}
+		rate = (stats[i].switches > 0) ?
+			(stats[i].duration * STRESS_DBL_NANOSECOND) / (double)stats[i].switches : 0.0;
+		(void)snprintf(str, sizeof(str), "%s nanosecs per switch", context_methods[i].name);
+		stress_metrics_set(args, j++, str, rate);
+	}
 
-fail:
-	(void)munmap((void *)context, context_size);
+	free(queue);
+	(void)munmap((void *)contexts, context_size);
 	return rc;
 }
 
 stressor_info_t stress_context_info = {
 	.stressor = stress_context,
 	.class = CLASS_MEMORY | CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_ALWAYS,
 	.help = help
 };
 #else
+
+static int stress_set_context_method(const char *opt)
+{
+	(void)opt;
+
+	(void)pr_inf("warning: --context-method not available on this system\n");
+	return 0;
+}
+
 stressor_info_t stress_context_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_MEMORY | CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without ucontext.h"
 };
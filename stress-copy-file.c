@@ -18,6 +18,16 @@
  *
  */
 #include "stress-ng.h"
+#include "core-uring.h"
+#include "io-uring.h"
+
+#if defined(HAVE_LINUX_FS_H)
+#include <linux/fs.h>
+#endif
+
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
 
 #define MIN_COPY_FILE_BYTES	(128 * MB)
 #define MAX_COPY_FILE_BYTES	(MAX_FILE_LIMIT)
@@ -27,6 +37,7 @@
 static const stress_help_t help[] = {
 	{ NULL,	"copy-file N",		"start N workers that copy file data" },
 	{ NULL,	"copy-file-bytes N",	"specify size of file to be copied" },
+	{ NULL,	"copy-file-method M",	"compare whole file copy methods, M is all or a method name" },
 	{ NULL,	"copy-file-ops N",	"stop after N copy bogo operations" },
 	{ NULL,	NULL,			NULL }
 
@@ -42,8 +53,50 @@ static int stress_set_copy_file_bytes(const char *opt)
 	return stress_set_setting("copy-file-bytes", TYPE_ID_UINT64, &copy_file_bytes);
 }
 
+#define COPY_FILE_ENGINE_RW_4K		(0)
+#define COPY_FILE_ENGINE_RW_64K		(1)
+#define COPY_FILE_ENGINE_RW_1M		(2)
+#define COPY_FILE_ENGINE_SENDFILE	(3)
+#define COPY_FILE_ENGINE_SPLICE		(4)
+#define COPY_FILE_ENGINE_COPY_RANGE	(5)
+#define COPY_FILE_ENGINE_FICLONE	(6)
+#define COPY_FILE_ENGINE_FICLONERANGE	(7)
+#define COPY_FILE_ENGINE_URING		(8)
+#define COPY_FILE_ENGINE_MAX		(9)
+#define COPY_FILE_ENGINE_ALL		(COPY_FILE_ENGINE_MAX)
+
+static const char * const copy_file_engines[] = {
+	"rw-4k",
+	"rw-64k",
+	"rw-1m",
+	"sendfile",
+	"splice",
+	"copy-file-range",
+	"ficlone",
+	"ficlonerange",
+	"uring",
+	"all",
+};
+
+static int stress_set_copy_file_method(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(copy_file_engines); i++) {
+		if (!strcmp(opt, copy_file_engines[i]))
+			return stress_set_setting("copy-file-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "copy-file-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(copy_file_engines); i++)
+		(void)fprintf(stderr, " %s", copy_file_engines[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_copy_file_bytes,	stress_set_copy_file_bytes },
+	{ OPT_copy_file_method,	stress_set_copy_file_method },
 	{ 0,			NULL }
 };
 
@@ -147,6 +200,564 @@ static int stress_copy_file_range_verify(
 	return 0;
 }
 
+#define COPY_FILE_ENGINE_CHUNK		(1 * MB)	/* read, write, sendfile, splice and io_uring chunk */
+#define COPY_FILE_ENGINE_CLONE_CHUNK	(16 * MB)	/* FICLONERANGE chunk */
+#define COPY_FILE_URING_PAIRS		(4)		/* linked read and write pairs in flight */
+#define COPY_FILE_VERIFY_BLOCKS		(16)		/* blocks compared per copy for --verify */
+
+#if defined(STRESS_URING) &&		\
+    defined(HAVE_IORING_OP_READ) &&	\
+    defined(HAVE_IORING_OP_WRITE) &&	\
+    defined(IOSQE_IO_LINK)
+#define COPY_FILE_URING
+#endif
+
+/* copy engine comparison state */
+typedef struct {
+	int fd_in;			/* source file */
+	int fd_out;			/* destination file */
+	off_t size;			/* bytes to copy, MB multiple */
+	uint8_t *buf;			/* COPY_FILE_URING_PAIRS chunks */
+#if defined(COPY_FILE_URING)
+	stress_uring_t ring;		/* linked read and write ring */
+#endif
+} stress_copy_file_engine_t;
+
+/* accumulated results for a copy engine */
+typedef struct {
+	double duration;		/* seconds copying and syncing */
+	double cpu;			/* cpu seconds copying and syncing */
+	double bytes;			/* bytes copied */
+	bool unsupported;		/* engine can't copy on this filesystem */
+} stress_copy_file_engine_stats_t;
+
+/*
+ *  stress_copy_file_engine_rw()
+ *	copy with pread and pwrite of buf_size chunks
+ */
+static int stress_copy_file_engine_rw(
+	const stress_copy_file_engine_t *engine,
+	const size_t buf_size)
+{
+	off_t off = 0;
+
+	while (off < engine->size) {
+		const size_t sz = (size_t)STRESS_MINIMUM((off_t)buf_size, engine->size - off);
+		ssize_t n;
+
+		n = pread(engine->fd_in, engine->buf, sz, off);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		if (n == 0)
+			return EIO;
+		if (pwrite(engine->fd_out, engine->buf, (size_t)n, off) != n)
+			return errno ? errno : EIO;
+		off += n;
+		if (!keep_stressing_flag())
+			return EINTR;
+	}
+	return 0;
+}
+
+#if defined(HAVE_SYS_SENDFILE_H) &&	\
+    defined(HAVE_SENDFILE)
+/*
+ *  stress_copy_file_engine_sendfile()
+ *	copy with sendfile from the source to the destination
+ */
+static int stress_copy_file_engine_sendfile(const stress_copy_file_engine_t *engine)
+{
+	off_t off = 0;
+
+	if (lseek(engine->fd_out, 0, SEEK_SET) < 0)
+		return errno;
+	while (off < engine->size) {
+		const size_t sz = (size_t)STRESS_MINIMUM((off_t)COPY_FILE_ENGINE_CHUNK, engine->size - off);
+		ssize_t n;
+
+		n = sendfile(engine->fd_out, engine->fd_in, &off, sz);
+		if (n < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			return errno;
+		}
+		if (n == 0)
+			return EIO;
+		if (!keep_stressing_flag())
+			return EINTR;
+	}
+	return 0;
+}
+#endif
+
+#if defined(HAVE_SPLICE) &&	\
+    defined(SPLICE_F_MOVE)
+/*
+ *  stress_copy_file_engine_splice()
+ *	copy with splice from the source into a pipe and from
+ *	the pipe to the destination
+ */
+static int stress_copy_file_engine_splice(const stress_copy_file_engine_t *engine)
+{
+	shim_loff_t off_in = 0, off_out = 0;
+	int fds[2], err = 0;
+
+	if (pipe(fds) < 0)
+		return errno;
+#if defined(F_SETPIPE_SZ)
+	(void)fcntl(fds[1], F_SETPIPE_SZ, COPY_FILE_ENGINE_CHUNK);
+#endif
+	while (off_in < (shim_loff_t)engine->size) {
+		const size_t sz = (size_t)STRESS_MINIMUM((shim_loff_t)COPY_FILE_ENGINE_CHUNK,
+						(shim_loff_t)engine->size - off_in);
+		ssize_t n;
+
+		n = splice(engine->fd_in, &off_in, fds[1], NULL, sz, SPLICE_F_MOVE);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err = errno;
+			break;
+		}
+		if (n == 0) {
+			err = EIO;
+			break;
+		}
+		while (n > 0) {
+			const ssize_t m = splice(fds[0], NULL, engine->fd_out, &off_out, (size_t)n, SPLICE_F_MOVE);
+
+			if (m < 0) {
+				if (errno == EINTR)
+					continue;
+				err = errno;
+				break;
+			}
+			if (m == 0) {
+				err = EIO;
+				break;
+			}
+			n -= m;
+		}
+		if (err)
+			break;
+		if (!keep_stressing_flag()) {
+			err = EINTR;
+			break;
+		}
+	}
+	(void)close(fds[0]);
+	(void)close(fds[1]);
+
+	return err;
+}
+#endif
+
+/*
+ *  stress_copy_file_engine_copy_range()
+ *	copy with copy_file_range, in as few calls as the kernel allows
+ */
+static int stress_copy_file_engine_copy_range(const stress_copy_file_engine_t *engine)
+{
+	shim_loff_t off_in = 0, off_out = 0;
+
+	while (off_in < (shim_loff_t)engine->size) {
+		ssize_t n;
+
+		n = shim_copy_file_range(engine->fd_in, &off_in, engine->fd_out, &off_out,
+			(size_t)((shim_loff_t)engine->size - off_in), 0);
+		if (n < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			return errno;
+		}
+		if (n == 0)
+			return EIO;
+		if (!keep_stressing_flag())
+			return EINTR;
+	}
+	return 0;
+}
+
+#if defined(FICLONERANGE)
+/*
+ *  stress_copy_file_engine_ficlonerange()
+ *	reflink the source into the destination in chunks
+ */
+static int stress_copy_file_engine_ficlonerange(const stress_copy_file_engine_t *engine)
+{
+	off_t off;
+
+	for (off = 0; off < engine->size; off += COPY_FILE_ENGINE_CLONE_CHUNK) {
+		struct file_clone_range fcr;
+
+		(void)memset(&fcr, 0, sizeof(fcr));
+		fcr.src_fd = engine->fd_in;
+		fcr.src_offset = (uint64_t)off;
+		fcr.src_length = (uint64_t)STRESS_MINIMUM((off_t)COPY_FILE_ENGINE_CLONE_CHUNK, engine->size - off);
+		fcr.dest_offset = (uint64_t)off;
+		if (ioctl(engine->fd_out, FICLONERANGE, &fcr) < 0)
+			return errno;
+	}
+	return 0;
+}
+#endif
+
+#if defined(COPY_FILE_URING)
+/*
+ *  stress_copy_file_engine_uring()
+ *	copy with io_uring reads each linked to the write of the
+ *	data read, COPY_FILE_URING_PAIRS pairs submitted at a time
+ */
+static int stress_copy_file_engine_uring(stress_copy_file_engine_t *engine)
+{
+	stress_uring_t *ring = &engine->ring;
+	off_t off = 0;
+
+	while (off < engine->size) {
+		unsigned tail = *ring->sq_tail;
+		unsigned i, head, to_submit, n_sqes = 0, reaped = 0;
+		int err = 0;
+
+		for (i = 0; (i < COPY_FILE_URING_PAIRS) && (off < engine->size); i++) {
+			const uint32_t len = (uint32_t)STRESS_MINIMUM((off_t)COPY_FILE_ENGINE_CHUNK, engine->size - off);
+			uint8_t *buf = engine->buf + (i * COPY_FILE_ENGINE_CHUNK);
+			struct io_uring_sqe *sqe;
+			unsigned idx;
+
+			idx = tail & *ring->sq_mask;
+			sqe = &ring->sqes[idx];
+			(void)memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_READ;
+			sqe->flags = IOSQE_IO_LINK;
+			sqe->fd = engine->fd_in;
+			sqe->addr = (uintptr_t)buf;
+			sqe->len = len;
+			sqe->off = (uint64_t)off;
+			sqe->user_data = (uint64_t)len;
+			ring->sq_array[idx] = idx;
+			tail++;
+
+			idx = tail & *ring->sq_mask;
+			sqe = &ring->sqes[idx];
+			(void)memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_WRITE;
+			sqe->fd = engine->fd_out;
+			sqe->addr = (uintptr_t)buf;
+			sqe->len = len;
+			sqe->off = (uint64_t)off;
+			sqe->user_data = (uint64_t)len;
+			ring->sq_array[idx] = idx;
+			tail++;
+
+			off += len;
+			n_sqes += 2;
+		}
+		shim_mb();
+		*ring->sq_tail = tail;
+		shim_mb();
+
+		to_submit = n_sqes;
+		while (reaped < n_sqes) {
+			const int ret = stress_uring_enter(ring, to_submit, n_sqes - reaped);
+
+			if (ret < 0) {
+				if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+					continue;
+				return errno;
+			}
+			to_submit -= ((unsigned int)ret > to_submit) ? to_submit : (unsigned int)ret;
+
+			head = *ring->cq_head;
+			for (;;) {
+				const struct io_uring_cqe *cqe;
+
+				shim_mb();
+				if (head == *ring->cq_tail)
+					break;
+				cqe = &ring->cqes[head & *ring->cq_mask];
+				/* a short read cancels the linked write */
+				if (cqe->res < 0)
+					err = -cqe->res;
+				else if ((uint64_t)cqe->res != cqe->user_data)
+					err = EIO;
+				reaped++;
+				head++;
+			}
+			*ring->cq_head = head;
+			shim_mb();
+		}
+		if (err)
+			return err;
+		if (!keep_stressing_flag())
+			return EINTR;
+	}
+	return 0;
+}
+#endif
+
+/*
+ *  stress_copy_file_engine_copy()
+ *	copy the whole source to the destination with the engine,
+ *	returns 0 or the errno of the failure
+ */
+static int stress_copy_file_engine_copy(
+	stress_copy_file_engine_t *engine,
+	const size_t method)
+{
+	switch (method) {
+	case COPY_FILE_ENGINE_RW_4K:
+		return stress_copy_file_engine_rw(engine, 4 * KB);
+	case COPY_FILE_ENGINE_RW_64K:
+		return stress_copy_file_engine_rw(engine, 64 * KB);
+	case COPY_FILE_ENGINE_RW_1M:
+		return stress_copy_file_engine_rw(engine, COPY_FILE_ENGINE_CHUNK);
+#if defined(HAVE_SYS_SENDFILE_H) &&	\
+    defined(HAVE_SENDFILE)
+	case COPY_FILE_ENGINE_SENDFILE:
+		return stress_copy_file_engine_sendfile(engine);
+#endif
+#if defined(HAVE_SPLICE) &&	\
+    defined(SPLICE_F_MOVE)
+	case COPY_FILE_ENGINE_SPLICE:
+		return stress_copy_file_engine_splice(engine);
+#endif
+	case COPY_FILE_ENGINE_COPY_RANGE:
+		return stress_copy_file_engine_copy_range(engine);
+#if defined(FICLONE)
+	case COPY_FILE_ENGINE_FICLONE:
+		return (ioctl(engine->fd_out, FICLONE, engine->fd_in) < 0) ? errno : 0;
+#endif
+#if defined(FICLONERANGE)
+	case COPY_FILE_ENGINE_FICLONERANGE:
+		return stress_copy_file_engine_ficlonerange(engine);
+#endif
+#if defined(COPY_FILE_URING)
+	case COPY_FILE_ENGINE_URING:
+		return (engine->ring.fd >= 0) ? stress_copy_file_engine_uring(engine) : ENOSYS;
+#endif
+	default:
+		break;
+	}
+	return ENOSYS;
+}
+
+/*
+ *  stress_copy_file_engine_unsupported()
+ *	errors that mean the engine can't copy on this filesystem
+ */
+static bool stress_copy_file_engine_unsupported(const int err)
+{
+	switch (err) {
+	case ENOSYS:
+	case EINVAL:
+	case EXDEV:
+	case ENOTTY:
+	case EOPNOTSUPP:
+#if defined(ENOTSUP) &&	\
+    (ENOTSUP != EOPNOTSUPP)
+	case ENOTSUP:
+#endif
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+/*
+ *  stress_copy_file_engine_cpu()
+ *	cpu seconds used so far by the process
+ */
+static double stress_copy_file_engine_cpu(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return (double)usage.ru_utime.tv_sec + ((double)usage.ru_utime.tv_usec / 1000000.0) +
+	       (double)usage.ru_stime.tv_sec + ((double)usage.ru_stime.tv_usec / 1000000.0);
+}
+
+/*
+ *  stress_copy_file_engine_report()
+ *	print the copy rates and cpu cost of the engines
+ */
+static void stress_copy_file_engine_report(
+	const stress_args_t *args,
+	const stress_copy_file_engine_stats_t *stats,
+	const char *fs_type)
+{
+	size_t i;
+
+	pr_lock();
+	pr_inf("%s: whole file copy engines%s\n", args->name, fs_type);
+	pr_inf("%s: %-15s %10s %14s\n", args->name, "method", "GB/sec", "CPU secs/GB");
+	for (i = 0; i < COPY_FILE_ENGINE_MAX; i++) {
+		const stress_copy_file_engine_stats_t *s = &stats[i];
+
+		if (s->unsupported)
+			pr_inf("%s: %-15s %10s %14s\n", args->name, copy_file_engines[i], "n/a", "n/a");
+		else if ((s->duration > 0.0) && (s->bytes > 0.0))
+			pr_inf("%s: %-15s %10.3f %14.3f\n", args->name, copy_file_engines[i],
+				s->bytes / s->duration / (double)GB, s->cpu / (s->bytes / (double)GB));
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_copy_file_engine()
+ *	compare the rate and cpu cost of copying the whole source to
+ *	an emptied destination with each copy engine, the source is
+ *	dropped from the page cache and the copy is synced so that
+ *	each copy reads from and writes to the filesystem
+ */
+static int stress_copy_file_engine(
+	const stress_args_t *args,
+	const int fd_in,
+	const int fd_out,
+	const uint64_t copy_file_bytes,
+	const size_t copy_file_method,
+	const char *fs_type)
+{
+	static stress_copy_file_engine_stats_t stats[COPY_FILE_ENGINE_MAX];
+	stress_copy_file_engine_t engine;
+	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	const size_t buf_size = COPY_FILE_URING_PAIRS * COPY_FILE_ENGINE_CHUNK;
+	size_t m, idx = 0;
+	off_t off;
+	int rc = EXIT_SUCCESS;
+
+	(void)memset(&engine, 0, sizeof(engine));
+	(void)memset(stats, 0, sizeof(stats));
+	engine.fd_in = fd_in;
+	engine.fd_out = fd_out;
+	engine.size = (off_t)(copy_file_bytes & ~(uint64_t)(MB - 1));
+	engine.buf = (uint8_t *)mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (engine.buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte copy buffer, skipping stressor\n",
+			args->name, buf_size);
+		return EXIT_NO_RESOURCE;
+	}
+#if defined(COPY_FILE_URING)
+	engine.ring.fd = -1;
+	if ((copy_file_method == COPY_FILE_ENGINE_ALL) ||
+	    (copy_file_method == COPY_FILE_ENGINE_URING))
+		(void)stress_uring_setup(args, &engine.ring, COPY_FILE_URING_PAIRS * 2);
+#endif
+
+	/* fill the source with data, the default file is sparse */
+	for (off = 0; off < engine.size; off += COPY_FILE_ENGINE_CHUNK) {
+		stress_uint8rnd4(engine.buf, COPY_FILE_ENGINE_CHUNK);
+		if (pwrite(fd_in, engine.buf, COPY_FILE_ENGINE_CHUNK, off) != COPY_FILE_ENGINE_CHUNK) {
+			pr_inf_skip("%s: cannot write %jd MB source file%s, skipping stressor\n",
+				args->name, (intmax_t)(engine.size / MB), fs_type);
+			rc = EXIT_NO_RESOURCE;
+			goto tidy;
+		}
+		if (!keep_stressing(args))
+			goto tidy;
+	}
+	(void)shim_fsync(fd_in);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; keep_stressing(args) && (m < COPY_FILE_ENGINE_MAX); m++) {
+			stress_copy_file_engine_stats_t *s = &stats[m];
+			double t, cpu;
+			int ret;
+
+			if ((copy_file_method != COPY_FILE_ENGINE_ALL) && (copy_file_method != m))
+				continue;
+			if (s->unsupported)
+				continue;
+			if (ftruncate(fd_out, 0) < 0) {
+				pr_fail("%s: ftruncate failed, errno=%d (%s)%s\n",
+					args->name, errno, strerror(errno), fs_type);
+				rc = EXIT_FAILURE;
+				break;
+			}
+			(void)shim_fsync(fd_out);
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_DONTNEED)
+			(void)posix_fadvise(fd_in, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+			t = stress_time_now();
+			cpu = stress_copy_file_engine_cpu();
+			ret = stress_copy_file_engine_copy(&engine, m);
+			if ((ret == 0) && (shim_fdatasync(fd_out) < 0))
+				ret = errno;
+			if (ret == EINTR)
+				break;
+			if (ret != 0) {
+				if (stress_copy_file_engine_unsupported(ret)) {
+					pr_dbg("%s: %s copy failed, errno=%d (%s)%s, skipping method\n",
+						args->name, copy_file_engines[m], ret, strerror(ret), fs_type);
+					s->unsupported = true;
+					continue;
+				}
+				pr_fail("%s: %s copy failed, errno=%d (%s)%s\n",
+					args->name, copy_file_engines[m], ret, strerror(ret), fs_type);
+				rc = EXIT_FAILURE;
+				break;
+			}
+			s->cpu += stress_copy_file_engine_cpu() - cpu;
+			s->duration += stress_time_now() - t;
+			s->bytes += (double)engine.size;
+
+			if (verify) {
+				int i;
+
+				for (i = 0; i < COPY_FILE_VERIFY_BLOCKS; i++) {
+					off_t off_in, off_out;
+
+					off_in = (off_t)(stress_mwc64modn((uint64_t)engine.size / 4096) * 4096);
+					off_out = off_in;
+					if (stress_copy_file_range_verify(fd_in, &off_in, fd_out, &off_out, 4096) < 0) {
+						pr_fail("%s: %s copy verify failed at offset %jd\n",
+							args->name, copy_file_engines[m], (intmax_t)off_in);
+						rc = EXIT_FAILURE;
+						break;
+					}
+				}
+				if (rc != EXIT_SUCCESS)
+					break;
+			}
+			inc_counter(args);
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_copy_file_engine_report(args, stats, fs_type);
+
+	for (m = 0; m < COPY_FILE_ENGINE_MAX; m++) {
+		const stress_copy_file_engine_stats_t *s = &stats[m];
+		char str[64];
+
+		if ((s->duration <= 0.0) || (s->bytes <= 0.0))
+			continue;
+		(void)snprintf(str, sizeof(str), "%s GB per sec", copy_file_engines[m]);
+		stress_metrics_set(args, idx++, str, s->bytes / s->duration / (double)GB);
+		(void)snprintf(str, sizeof(str), "%s CPU secs per GB", copy_file_engines[m]);
+		stress_metrics_set(args, idx++, str, s->cpu / (s->bytes / (double)GB));
+	}
+
+tidy:
+#if defined(COPY_FILE_URING)
+	if (engine.ring.fd >= 0)
+		stress_uring_close(&engine.ring);
+#endif
+	(void)munmap((void *)engine.buf, buf_size);
+
+	return rc;
+}
+
 /*
  *  stress_copy_file
  *	stress reading chunks of file using copy_file_range()
@@ -157,6 +768,8 @@ static int stress_copy_file(const stress_args_t *args)
 	const int fd_bad = stress_get_bad_fd();
 	char filename[PATH_MAX - 5], tmp[PATH_MAX];
 	uint64_t copy_file_bytes = DEFAULT_COPY_FILE_BYTES;
+	size_t copy_file_method = COPY_FILE_ENGINE_ALL;
+	bool copy_file_engine;
 	double duration = 0.0, bytes = 0.0, rate;
 	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
 
@@ -166,6 +779,7 @@ static int stress_copy_file(const stress_args_t *args)
 		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
 			copy_file_bytes = MIN_COPY_FILE_BYTES;
 	}
+	copy_file_engine = stress_get_setting("copy-file-method", &copy_file_method);
 
 	copy_file_bytes /= args->num_instances;
 	if (copy_file_bytes < DEFAULT_COPY_FILE_SIZE)
@@ -204,6 +818,15 @@ static int stress_copy_file(const stress_args_t *args)
 	}
 	(void)shim_unlink(tmp);
 
+	if (copy_file_engine) {
+		char pathname[PATH_MAX];
+
+		(void)stress_temp_dir_args(args, pathname, sizeof(pathname));
+		rc = stress_copy_file_engine(args, fd_in, fd_out, copy_file_bytes,
+			copy_file_method, stress_fs_type(pathname));
+		goto tidy_out;
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
@@ -33,6 +33,17 @@
 #include <complex.h>
 #endif
 
+#if defined(STRESS_ARCH_X86) &&		\
+    defined(HAVE_IMMINTRIN_H)
+#include <immintrin.h>
+#endif
+
+#if defined(STRESS_ARCH_ARM) &&		\
+    defined(__aarch64__) &&		\
+    defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /*
  *  S390x on QEMU (and maybe H/W) trips SIGILL for decimal
  *  math with some compilers, so disable this for now
@@ -84,6 +95,8 @@ typedef struct {
 static const stress_help_t help[] = {
 	{ "c N", "cpu N",		"start N workers that perform CPU only loading" },
 	{ "l P", "cpu-load P",		"load CPU by P %, 0=sleep, 100=full load (see -c)" },
+	{ NULL,	 "cpu-calibrate",	"calibrate methods so each gets equal time with cpu-method all" },
+	{ NULL,	 "cpu-isa I",		"use vector ISA I for vectorizable methods, default is best supported" },
 	{ NULL,	 "cpu-load-slice S",	"specify time slice during busy load" },
 	{ NULL,  "cpu-method M",	"specify stress cpu method M, default is all" },
 	{ NULL,	 "cpu-old-metrics",	"use old CPU metrics instead of normalized metrics" },
@@ -101,6 +114,11 @@ static int stress_set_cpu_old_metrics(const char *opt)
 	return stress_set_setting_true("cpu-old-metrics", opt);
 }
 
+static int stress_set_cpu_calibrate(const char *opt)
+{
+	return stress_set_setting_true("cpu-calibrate", opt);
+}
+
 static int stress_set_cpu_load(const char *opt)
 {
 	int32_t cpu_load;
@@ -740,7 +758,7 @@ static void OPTIMIZE3 TARGET_CLONES stress_cpu_collatz(const char *name)
  *  stress_cpu_idct()
  *	compute 8x8 Inverse Discrete Cosine Transform
  */
-static void OPTIMIZE3 TARGET_CLONES stress_cpu_idct(const char *name)
+static inline void ALWAYS_INLINE stress_cpu_idct_kernel(const char *name)
 {
 #define IDCT_SIZE	(8)
 
@@ -1444,7 +1462,7 @@ static void HOT OPTIMIZE0 stress_cpu_jmp(const char *name)
  *  ccitt_crc16()
  *	perform naive CCITT CRC16
  */
-static uint16_t HOT OPTIMIZE3 ccitt_crc16(const uint8_t *data, size_t n)
+static inline uint16_t ALWAYS_INLINE ccitt_crc16(const uint8_t *data, size_t n)
 {
 	/*
 	 *  The CCITT CRC16 polynomial is
@@ -1483,7 +1501,7 @@ static uint16_t HOT OPTIMIZE3 ccitt_crc16(const uint8_t *data, size_t n)
  *   stress_cpu_crc16
  *	compute 1024 rounds of CCITT CRC16
  */
-static void stress_cpu_crc16(const char *name)
+static inline void ALWAYS_INLINE stress_cpu_crc16_kernel(const char *name)
 {
 	uint8_t buffer[1024];
 	size_t i;
@@ -1499,7 +1517,7 @@ static void stress_cpu_crc16(const char *name)
  *  fletcher16
  *	naive implementation of fletcher16 checksum
  */
-static uint16_t HOT OPTIMIZE3 fletcher16(const uint8_t *data, const size_t len)
+static inline uint16_t ALWAYS_INLINE fletcher16(const uint8_t *data, const size_t len)
 {
 	register uint16_t sum1 = 0, sum2 = 0;
 	register size_t i;
@@ -1515,7 +1533,7 @@ static uint16_t HOT OPTIMIZE3 fletcher16(const uint8_t *data, const size_t len)
  *   stress_cpu_fletcher16()
  *	compute 1024 rounds of fletcher16 checksum
  */
-static void stress_cpu_fletcher16(const char *name)
+static inline void ALWAYS_INLINE stress_cpu_fletcher16_kernel(const char *name)
 {
 	uint8_t buffer[1024];
 	size_t i;
@@ -1527,11 +1545,34 @@ static void stress_cpu_fletcher16(const char *name)
 		stress_uint16_put(fletcher16(buffer, i));
 }
 
+/*
+ *  ipv4_checksum()
+ *	inlined copy of stress_ipv4_checksum so that it is
+ *	compiled for the ISA of the method it is used by
+ */
+static inline uint16_t ALWAYS_INLINE ipv4_checksum(const uint16_t *ptr, const size_t sz)
+{
+	register uint32_t sum = 0;
+	register size_t n = sz;
+
+	while (n > 1) {
+		sum += *ptr++;
+		n -= 2;
+	}
+
+	if (n)
+		sum += *(const uint8_t *)ptr;
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += (sum >> 16);
+
+	return (uint16_t)~sum;
+}
+
 /*
  *   stress_cpu_ipv4checksum
  *	compute 1024 rounds of IPv4 checksum
  */
-static void stress_cpu_ipv4checksum(const char *name)
+static inline void ALWAYS_INLINE stress_cpu_ipv4checksum_kernel(const char *name)
 {
 	uint16_t buffer[512];
 	size_t i;
@@ -1540,7 +1581,7 @@ static void stress_cpu_ipv4checksum(const char *name)
 
 	random_buffer((uint8_t *)buffer, sizeof(buffer));
 	for (i = 1; i < sizeof(buffer); i++)
-		stress_uint16_put(stress_ipv4_checksum(buffer, i));
+		stress_uint16_put(ipv4_checksum(buffer, i));
 }
 
 #if defined(HAVE_COMPLEX_H) &&		\
@@ -1624,7 +1665,7 @@ static void HOT OPTIMIZE3 OPTIMIZE_FAST_MATH stress_cpu_gamma(const char *name)
  *  Introduction to Signal Processing,
  *  Prentice-Hall, 1995, ISBN: 0-13-209172-0.
  */
-static void HOT OPTIMIZE3 stress_cpu_correlate(const char *name)
+static inline void ALWAYS_INLINE stress_cpu_correlate_kernel(const char *name)
 {
 	size_t i, j;
 	double data_average = 0.0;
@@ -2067,7 +2108,7 @@ do {							\
  *  hamming84()
  *	compute Hamming (8,4) codes
  */
-static uint8_t HOT OPTIMIZE3 hamming84(const uint8_t nybble)
+static inline uint8_t ALWAYS_INLINE hamming84(const uint8_t nybble)
 {
 	/*
 	 * Hamming (8,4) Generator matrix
@@ -2115,7 +2156,7 @@ static uint8_t HOT OPTIMIZE3 hamming84(const uint8_t nybble)
  *  stress_cpu_hamming()
  *	compute hamming code on 65536 x 4 nybbles
  */
-static void OPTIMIZE3 TARGET_CLONES stress_cpu_hamming(const char *name)
+static inline void ALWAYS_INLINE stress_cpu_hamming_kernel(const char *name)
 {
 	uint32_t i;
 	uint32_t sum = 0;
@@ -2302,7 +2343,7 @@ static void stress_cpu_parity(const char *name)
  *	perform 8 bit to 1 bit gray scale
  *	Floyd-Steinberg dither
  */
-static void TARGET_CLONES stress_cpu_dither(const char *name)
+static inline void ALWAYS_INLINE stress_cpu_dither_kernel(const char *name)
 {
 	size_t x, y;
 
@@ -2738,6 +2779,931 @@ static HOT OPTIMIZE3 void stress_cpu_all(const char *name)
 	(void)name;
 }
 
+/*
+ *  ISA variants of the methods that can be vectorized. The correlate,
+ *  hamming, idct and ipv4checksum methods have hand-written vector
+ *  kernels using the intrinsics of each ISA. The serial crc16, dither
+ *  and fletcher16 kernels are inlined into a function per ISA that
+ *  the compiler builds for that ISA. The variant is chosen at run time,
+ *  either by --cpu-isa or by picking the best ISA the CPU supports.
+ */
+#define STRESS_CPU_ISA_SCALAR	(0)
+#define STRESS_CPU_ISA_SSE	(1)
+#define STRESS_CPU_ISA_AVX2	(2)
+#define STRESS_CPU_ISA_AVX512	(3)
+#define STRESS_CPU_ISA_NEON	(4)
+#define STRESS_CPU_ISA_MAX	(5)
+
+#if defined(__GNUC__) &&	\
+    !defined(__clang__) &&	\
+    !defined(__ICC) &&		\
+    NEED_GNUC(4, 6, 0)
+#define TARGET_ISA_SCALAR	__attribute__((optimize("-O3", "no-tree-vectorize", "no-tree-slp-vectorize")))
+#else
+#define TARGET_ISA_SCALAR
+#endif
+
+#if defined(STRESS_ARCH_X86) &&		\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    !defined(__ICC)
+#if defined(HAVE_TARGET_CLONES_SSE4_2)
+#define STRESS_CPU_ISA_HAVE_SSE
+#endif
+#if defined(HAVE_TARGET_CLONES_AVX2) &&	\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_CPU_ISA_HAVE_AVX2
+#endif
+#if defined(HAVE_TARGET_CLONES_SKYLAKE_AVX512) &&	\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_CPU_ISA_HAVE_AVX512
+#endif
+#endif
+
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(__aarch64__) &&	\
+    defined(__ARM_NEON)
+#define STRESS_CPU_ISA_HAVE_NEON
+#endif
+
+#if defined(STRESS_CPU_ISA_HAVE_SSE)
+#define STRESS_CPU_ISA_SSE_FUNC(method)					\
+static void OPTIMIZE3 __attribute__((target("sse4.2"))) method ## _sse(const char *name)\
+{									\
+	method ## _kernel(name);					\
+}
+#define STRESS_CPU_ISA_SSE_PTR(method)	method ## _sse
+#else
+#define STRESS_CPU_ISA_SSE_FUNC(method)
+#define STRESS_CPU_ISA_SSE_PTR(method)	method ## _scalar
+#endif
+
+#if defined(STRESS_CPU_ISA_HAVE_AVX2)
+#define STRESS_CPU_ISA_AVX2_FUNC(method)				\
+static void OPTIMIZE3 __attribute__((target("avx2"))) method ## _avx2(const char *name)\
+{									\
+	method ## _kernel(name);					\
+}
+#define STRESS_CPU_ISA_AVX2_PTR(method)	method ## _avx2
+#else
+#define STRESS_CPU_ISA_AVX2_FUNC(method)
+#define STRESS_CPU_ISA_AVX2_PTR(method)	method ## _scalar
+#endif
+
+#if defined(STRESS_CPU_ISA_HAVE_AVX512)
+#define STRESS_CPU_ISA_AVX512_FUNC(method)				\
+static void OPTIMIZE3 __attribute__((target("avx512f,avx512bw,avx512vl"))) method ## _avx512(const char *name)\
+{									\
+	method ## _kernel(name);					\
+}
+#define STRESS_CPU_ISA_AVX512_PTR(method)	method ## _avx512
+#else
+#define STRESS_CPU_ISA_AVX512_FUNC(method)
+#define STRESS_CPU_ISA_AVX512_PTR(method)	method ## _scalar
+#endif
+
+#if defined(STRESS_CPU_ISA_HAVE_NEON)
+#define STRESS_CPU_ISA_NEON_FUNC(method)				\
+static void OPTIMIZE3 method ## _neon(const char *name)			\
+{									\
+	method ## _kernel(name);					\
+}
+#define STRESS_CPU_ISA_NEON_PTR(method)	method ## _neon
+#else
+#define STRESS_CPU_ISA_NEON_FUNC(method)
+#define STRESS_CPU_ISA_NEON_PTR(method)	method ## _scalar
+#endif
+
+/*
+ *  Vector primitives of each ISA used by the hand-written vector
+ *  kernels of the correlate, hamming, idct and ipv4checksum methods,
+ *  vd is a vector of doubles and vu a vector of uint32_t
+ */
+#if defined(STRESS_CPU_ISA_HAVE_SSE)
+#define STRESS_CPU_TARGET_SSE	__attribute__((target("sse4.2")))
+#define SSE_VD_LANES		(2)
+#define SSE_VU_LANES		(4)
+
+typedef __m128d sse_vd_t;
+typedef __m128i sse_vu_t;
+
+static inline sse_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_set1(const double x)
+{
+	return _mm_set1_pd(x);
+}
+
+static inline sse_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_load(const double *ptr)
+{
+	return _mm_loadu_pd(ptr);
+}
+
+static inline sse_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_loadf(const float *ptr)
+{
+	return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)ptr)));
+}
+
+static inline void ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_store(double *ptr, const sse_vd_t a)
+{
+	_mm_storeu_pd(ptr, a);
+}
+
+static inline sse_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_add(const sse_vd_t a, const sse_vd_t b)
+{
+	return _mm_add_pd(a, b);
+}
+
+static inline sse_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_sub(const sse_vd_t a, const sse_vd_t b)
+{
+	return _mm_sub_pd(a, b);
+}
+
+static inline sse_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_mul(const sse_vd_t a, const sse_vd_t b)
+{
+	return _mm_mul_pd(a, b);
+}
+
+static inline sse_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_round(const sse_vd_t a)
+{
+	return _mm_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+static inline double ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vd_hsum(const sse_vd_t a)
+{
+	return _mm_cvtsd_f64(_mm_add_pd(a, _mm_unpackhi_pd(a, a)));
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_set1(const uint32_t x)
+{
+	return _mm_set1_epi32((int)x);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_load(const uint32_t *ptr)
+{
+	return _mm_loadu_si128((const __m128i *)ptr);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_add(const sse_vu_t a, const sse_vu_t b)
+{
+	return _mm_add_epi32(a, b);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_sub(const sse_vu_t a, const sse_vu_t b)
+{
+	return _mm_sub_epi32(a, b);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_and(const sse_vu_t a, const sse_vu_t b)
+{
+	return _mm_and_si128(a, b);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_or(const sse_vu_t a, const sse_vu_t b)
+{
+	return _mm_or_si128(a, b);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_xor(const sse_vu_t a, const sse_vu_t b)
+{
+	return _mm_xor_si128(a, b);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_shl(const sse_vu_t a, const int n)
+{
+	return _mm_slli_epi32(a, n);
+}
+
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_shr(const sse_vu_t a, const int n)
+{
+	return _mm_srli_epi32(a, n);
+}
+
+/* add the uint16_t words at ptr into the uint32_t lanes of a */
+static inline sse_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_add_u16(const sse_vu_t a, const uint16_t *ptr)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i *)ptr);
+
+	return _mm_add_epi32(a, _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0xffff)), _mm_srli_epi32(v, 16)));
+}
+
+static inline uint32_t ALWAYS_INLINE STRESS_CPU_TARGET_SSE sse_vu_hsum(const sse_vu_t a)
+{
+	__m128i v = _mm_add_epi32(a, _mm_shuffle_epi32(a, 0x4e));
+
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+	return (uint32_t)_mm_cvtsi128_si32(v);
+}
+#endif
+
+#if defined(STRESS_CPU_ISA_HAVE_AVX2)
+#define STRESS_CPU_TARGET_AVX2	__attribute__((target("avx2")))
+#define AVX2_VD_LANES		(4)
+#define AVX2_VU_LANES		(8)
+
+typedef __m256d avx2_vd_t;
+typedef __m256i avx2_vu_t;
+
+static inline avx2_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_set1(const double x)
+{
+	return _mm256_set1_pd(x);
+}
+
+static inline avx2_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_load(const double *ptr)
+{
+	return _mm256_loadu_pd(ptr);
+}
+
+static inline avx2_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_loadf(const float *ptr)
+{
+	return _mm256_cvtps_pd(_mm_loadu_ps(ptr));
+}
+
+static inline void ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_store(double *ptr, const avx2_vd_t a)
+{
+	_mm256_storeu_pd(ptr, a);
+}
+
+static inline avx2_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_add(const avx2_vd_t a, const avx2_vd_t b)
+{
+	return _mm256_add_pd(a, b);
+}
+
+static inline avx2_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_sub(const avx2_vd_t a, const avx2_vd_t b)
+{
+	return _mm256_sub_pd(a, b);
+}
+
+static inline avx2_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_mul(const avx2_vd_t a, const avx2_vd_t b)
+{
+	return _mm256_mul_pd(a, b);
+}
+
+static inline avx2_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_round(const avx2_vd_t a)
+{
+	return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+static inline double ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vd_hsum(const avx2_vd_t a)
+{
+	const __m128d v = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+
+	return _mm_cvtsd_f64(_mm_add_pd(v, _mm_unpackhi_pd(v, v)));
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_set1(const uint32_t x)
+{
+	return _mm256_set1_epi32((int)x);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_load(const uint32_t *ptr)
+{
+	return _mm256_loadu_si256((const __m256i *)ptr);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_add(const avx2_vu_t a, const avx2_vu_t b)
+{
+	return _mm256_add_epi32(a, b);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_sub(const avx2_vu_t a, const avx2_vu_t b)
+{
+	return _mm256_sub_epi32(a, b);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_and(const avx2_vu_t a, const avx2_vu_t b)
+{
+	return _mm256_and_si256(a, b);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_or(const avx2_vu_t a, const avx2_vu_t b)
+{
+	return _mm256_or_si256(a, b);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_xor(const avx2_vu_t a, const avx2_vu_t b)
+{
+	return _mm256_xor_si256(a, b);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_shl(const avx2_vu_t a, const int n)
+{
+	return _mm256_slli_epi32(a, n);
+}
+
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_shr(const avx2_vu_t a, const int n)
+{
+	return _mm256_srli_epi32(a, n);
+}
+
+/* add the uint16_t words at ptr into the uint32_t lanes of a */
+static inline avx2_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_add_u16(const avx2_vu_t a, const uint16_t *ptr)
+{
+	const __m256i v = _mm256_loadu_si256((const __m256i *)ptr);
+
+	return _mm256_add_epi32(a, _mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xffff)), _mm256_srli_epi32(v, 16)));
+}
+
+static inline uint32_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX2 avx2_vu_hsum(const avx2_vu_t a)
+{
+	__m128i v = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+	return (uint32_t)_mm_cvtsi128_si32(v);
+}
+#endif
+
+#if defined(STRESS_CPU_ISA_HAVE_AVX512)
+#define STRESS_CPU_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl")))
+#define AVX512_VD_LANES		(8)
+#define AVX512_VU_LANES		(16)
+
+typedef __m512d avx512_vd_t;
+typedef __m512i avx512_vu_t;
+
+static inline avx512_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_set1(const double x)
+{
+	return _mm512_set1_pd(x);
+}
+
+static inline avx512_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_load(const double *ptr)
+{
+	return _mm512_loadu_pd(ptr);
+}
+
+static inline avx512_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_loadf(const float *ptr)
+{
+	return _mm512_cvtps_pd(_mm256_loadu_ps(ptr));
+}
+
+static inline void ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_store(double *ptr, const avx512_vd_t a)
+{
+	_mm512_storeu_pd(ptr, a);
+}
+
+static inline avx512_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_add(const avx512_vd_t a, const avx512_vd_t b)
+{
+	return _mm512_add_pd(a, b);
+}
+
+static inline avx512_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_sub(const avx512_vd_t a, const avx512_vd_t b)
+{
+	return _mm512_sub_pd(a, b);
+}
+
+static inline avx512_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_mul(const avx512_vd_t a, const avx512_vd_t b)
+{
+	return _mm512_mul_pd(a, b);
+}
+
+static inline avx512_vd_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_round(const avx512_vd_t a)
+{
+	return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+static inline double ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vd_hsum(const avx512_vd_t a)
+{
+	return _mm512_reduce_add_pd(a);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_set1(const uint32_t x)
+{
+	return _mm512_set1_epi32((int)x);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_load(const uint32_t *ptr)
+{
+	return _mm512_loadu_si512((const void *)ptr);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_add(const avx512_vu_t a, const avx512_vu_t b)
+{
+	return _mm512_add_epi32(a, b);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_sub(const avx512_vu_t a, const avx512_vu_t b)
+{
+	return _mm512_sub_epi32(a, b);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_and(const avx512_vu_t a, const avx512_vu_t b)
+{
+	return _mm512_and_si512(a, b);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_or(const avx512_vu_t a, const avx512_vu_t b)
+{
+	return _mm512_or_si512(a, b);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_xor(const avx512_vu_t a, const avx512_vu_t b)
+{
+	return _mm512_xor_si512(a, b);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_shl(const avx512_vu_t a, const int n)
+{
+	return _mm512_slli_epi32(a, (unsigned int)n);
+}
+
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_shr(const avx512_vu_t a, const int n)
+{
+	return _mm512_srli_epi32(a, (unsigned int)n);
+}
+
+/* add the uint16_t words at ptr into the uint32_t lanes of a */
+static inline avx512_vu_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_add_u16(const avx512_vu_t a, const uint16_t *ptr)
+{
+	const __m512i v = _mm512_loadu_si512((const void *)ptr);
+
+	return _mm512_add_epi32(a, _mm512_add_epi32(_mm512_and_si512(v, _mm512_set1_epi32(0xffff)), _mm512_srli_epi32(v, 16)));
+}
+
+static inline uint32_t ALWAYS_INLINE STRESS_CPU_TARGET_AVX512 avx512_vu_hsum(const avx512_vu_t a)
+{
+	return (uint32_t)_mm512_reduce_add_epi32(a);
+}
+#endif
+
+#if defined(STRESS_CPU_ISA_HAVE_NEON)
+#define STRESS_CPU_TARGET_NEON
+#define NEON_VD_LANES		(2)
+#define NEON_VU_LANES		(4)
+
+typedef float64x2_t neon_vd_t;
+typedef uint32x4_t neon_vu_t;
+
+static inline neon_vd_t ALWAYS_INLINE neon_vd_set1(const double x)
+{
+	return vdupq_n_f64(x);
+}
+
+static inline neon_vd_t ALWAYS_INLINE neon_vd_load(const double *ptr)
+{
+	return vld1q_f64(ptr);
+}
+
+static inline neon_vd_t ALWAYS_INLINE neon_vd_loadf(const float *ptr)
+{
+	return vcvt_f64_f32(vld1_f32(ptr));
+}
+
+static inline void ALWAYS_INLINE neon_vd_store(double *ptr, const neon_vd_t a)
+{
+	vst1q_f64(ptr, a);
+}
+
+static inline neon_vd_t ALWAYS_INLINE neon_vd_add(const neon_vd_t a, const neon_vd_t b)
+{
+	return vaddq_f64(a, b);
+}
+
+static inline neon_vd_t ALWAYS_INLINE neon_vd_sub(const neon_vd_t a, const neon_vd_t b)
+{
+	return vsubq_f64(a, b);
+}
+
+static inline neon_vd_t ALWAYS_INLINE neon_vd_mul(const neon_vd_t a, const neon_vd_t b)
+{
+	return vmulq_f64(a, b);
+}
+
+static inline neon_vd_t ALWAYS_INLINE neon_vd_round(const neon_vd_t a)
+{
+	return vrndnq_f64(a);
+}
+
+static inline double ALWAYS_INLINE neon_vd_hsum(const neon_vd_t a)
+{
+	return vaddvq_f64(a);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_set1(const uint32_t x)
+{
+	return vdupq_n_u32(x);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_load(const uint32_t *ptr)
+{
+	return vld1q_u32(ptr);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_add(const neon_vu_t a, const neon_vu_t b)
+{
+	return vaddq_u32(a, b);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_sub(const neon_vu_t a, const neon_vu_t b)
+{
+	return vsubq_u32(a, b);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_and(const neon_vu_t a, const neon_vu_t b)
+{
+	return vandq_u32(a, b);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_or(const neon_vu_t a, const neon_vu_t b)
+{
+	return vorrq_u32(a, b);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_xor(const neon_vu_t a, const neon_vu_t b)
+{
+	return veorq_u32(a, b);
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_shl(const neon_vu_t a, const int n)
+{
+	return vshlq_u32(a, vdupq_n_s32(n));
+}
+
+static inline neon_vu_t ALWAYS_INLINE neon_vu_shr(const neon_vu_t a, const int n)
+{
+	return vshlq_u32(a, vdupq_n_s32(-n));
+}
+
+/* add the uint16_t words at ptr into the uint32_t lanes of a */
+static inline neon_vu_t ALWAYS_INLINE neon_vu_add_u16(const neon_vu_t a, const uint16_t *ptr)
+{
+	return vpadalq_u16(a, vld1q_u16(ptr));
+}
+
+static inline uint32_t ALWAYS_INLINE neon_vu_hsum(const neon_vu_t a)
+{
+	return vaddvq_u32(a);
+}
+#endif
+
+/*
+ *  Taylor series coefficients of cos(x) in x * x, highest power
+ *  first, the error is below 2e-12 for x in -PI..PI
+ */
+static const double stress_cpu_vec_cos_coeffs[] = {
+	-8.896791392450574e-22,		/* -1 / 22! */
+	4.110317623312165e-19,		/* +1 / 20! */
+	-1.5619206968586225e-16,	/* -1 / 18! */
+	4.779477332387385e-14,		/* +1 / 16! */
+	-1.1470745597729725e-11,	/* -1 / 14! */
+	2.08767569878681e-09,		/* +1 / 12! */
+	-2.755731922398589e-07,		/* -1 / 10! */
+	2.48015873015873e-05,		/* +1 / 8! */
+	-0.001388888888888889,		/* -1 / 6! */
+	0.041666666666666664,		/* +1 / 4! */
+	-0.5,				/* -1 / 2! */
+	1.0,				/* +1 / 0! */
+};
+
+static const double stress_cpu_vec_iota[8] = {
+	0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0
+};
+
+static const uint32_t stress_cpu_vec_iota_u32[16] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+/*
+ *  STRESS_CPU_VEC_KERNELS()
+ *	declare the hand-written vector kernels of the correlate,
+ *	hamming, idct and ipv4checksum methods for the isa using
+ *	the vector primitives above
+ */
+#define STRESS_CPU_VEC_KERNELS(isa, ISA, target)			\
+/* cos(x) of each lane, x is reduced to -PI..PI */			\
+static inline isa ## _vd_t ALWAYS_INLINE target isa ## _vd_cos(isa ## _vd_t x)	\
+{									\
+	const isa ## _vd_t two_pi = isa ## _vd_set1(2.0 * (double)PI);	\
+	const isa ## _vd_t inv_two_pi = isa ## _vd_set1(1.0 / (2.0 * (double)PI));	\
+	isa ## _vd_t x2, p;						\
+	size_t k;							\
+									\
+	x = isa ## _vd_sub(x, isa ## _vd_mul(two_pi, isa ## _vd_round(isa ## _vd_mul(x, inv_two_pi))));	\
+	x2 = isa ## _vd_mul(x, x);					\
+	p = isa ## _vd_set1(stress_cpu_vec_cos_coeffs[0]);		\
+	for (k = 1; k < SIZEOF_ARRAY(stress_cpu_vec_cos_coeffs); k++)	\
+		p = isa ## _vd_add(isa ## _vd_mul(p, x2), isa ## _vd_set1(stress_cpu_vec_cos_coeffs[k]));	\
+	return p;							\
+}									\
+									\
+/* bit k of each of the 4 nybbles of x as a 0x00 or 0xff byte */	\
+static inline isa ## _vu_t ALWAYS_INLINE target isa ## _vu_nybble_mask(const isa ## _vu_t x, const int k)	\
+{									\
+	const isa ## _vu_t y = isa ## _vu_shr(x, k);			\
+	const isa ## _vu_t s = isa ## _vu_or(				\
+		isa ## _vu_or(isa ## _vu_and(y, isa ## _vu_set1(0x1)),	\
+			      isa ## _vu_and(isa ## _vu_shl(y, 4), isa ## _vu_set1(0x100))),	\
+		isa ## _vu_or(isa ## _vu_and(isa ## _vu_shl(y, 8), isa ## _vu_set1(0x10000)),	\
+			      isa ## _vu_and(isa ## _vu_shl(y, 12), isa ## _vu_set1(0x1000000))));	\
+									\
+	return isa ## _vu_sub(isa ## _vu_shl(s, 8), s);			\
+}									\
+									\
+static void OPTIMIZE3 target stress_cpu_correlate_ ## isa(const char *name)	\
+{									\
+	size_t i, j;							\
+	double data_average = 0.0;					\
+	static double data[CORRELATE_DATA_LEN];				\
+	static double corr[CORRELATE_LEN + 1];				\
+	isa ## _vd_t average;						\
+									\
+	(void)name;							\
+									\
+	/* Generate some random data */					\
+	for (i = 0; i < CORRELATE_DATA_LEN; i++) {			\
+		const uint64_t r = stress_mwc64();			\
+									\
+		data[i] = (double)r;					\
+		data_average += data[i];				\
+	}								\
+	data_average /= (double)CORRELATE_DATA_LEN;			\
+	average = isa ## _vd_set1(data_average);			\
+									\
+	/* And correlate, a vector of products at a time */		\
+	for (i = 0; i <= CORRELATE_LEN; i++) {				\
+		const size_t n = CORRELATE_DATA_LEN - i;		\
+		isa ## _vd_t sum = isa ## _vd_set1(0.0);		\
+									\
+		for (j = 0; j + ISA ## _VD_LANES <= n; j += ISA ## _VD_LANES) {	\
+			const isa ## _vd_t a = isa ## _vd_sub(isa ## _vd_load(&data[i + j]), average);	\
+			const isa ## _vd_t b = isa ## _vd_sub(isa ## _vd_load(&data[j]), average);	\
+									\
+			sum = isa ## _vd_add(sum, isa ## _vd_mul(a, b));	\
+		}							\
+		corr[i] = isa ## _vd_hsum(sum);				\
+		for (; j < n; j++)					\
+			corr[i] += (data[i + j] - data_average) * (data[j] - data_average);	\
+		corr[i] /= (double)CORRELATE_LEN;			\
+		stress_double_put(corr[i]);				\
+	}								\
+}									\
+									\
+static void OPTIMIZE3 target stress_cpu_hamming_ ## isa(const char *name)	\
+{									\
+	/* the hamming84() generator matrix, replicated into each byte */	\
+	const isa ## _vu_t g0 = isa ## _vu_set1(0xf1f1f1f1);		\
+	const isa ## _vu_t g1 = isa ## _vu_set1(0xd2d2d2d2);		\
+	const isa ## _vu_t g2 = isa ## _vu_set1(0xb4b4b4b4);		\
+	const isa ## _vu_t g3 = isa ## _vu_set1(0x78787878);		\
+	const isa ## _vu_t step = isa ## _vu_set1(ISA ## _VU_LANES);	\
+	isa ## _vu_t v = isa ## _vu_load(stress_cpu_vec_iota_u32);	\
+	isa ## _vu_t sum = isa ## _vu_set1(0);				\
+	uint32_t i;							\
+									\
+	/* 4 x 4 bits to 4 x 8 bits hamming encoded, a vector at a time */	\
+	for (i = 0; i < 65536; i += ISA ## _VU_LANES) {			\
+		const isa ## _vu_t encoded = isa ## _vu_xor(		\
+			isa ## _vu_xor(isa ## _vu_and(isa ## _vu_nybble_mask(v, 0), g0),	\
+				       isa ## _vu_and(isa ## _vu_nybble_mask(v, 1), g1)),	\
+			isa ## _vu_xor(isa ## _vu_and(isa ## _vu_nybble_mask(v, 2), g2),	\
+				       isa ## _vu_and(isa ## _vu_nybble_mask(v, 3), g3)));	\
+									\
+		sum = isa ## _vu_add(sum, encoded);			\
+		v = isa ## _vu_add(v, step);				\
+	}								\
+									\
+	if ((g_opt_flags & OPT_FLAGS_VERIFY) && (isa ## _vu_hsum(sum) != 0xffff8000))	\
+		pr_fail("%s: hamming error detected, sum of 65536 "	\
+			"hamming codes not correct\n", name);		\
+}									\
+									\
+static void OPTIMIZE3 target stress_cpu_idct_ ## isa(const char *name)	\
+{									\
+	const double invsqrt2 = 1.0 / shim_sqrt(2.0);			\
+	const double pi_over_16 = (double)PI / 16.0;			\
+	int i, j, u, v;							\
+	float data[8][8];						\
+	float idct[8][8];						\
+	double scale[8], cos_i[8];					\
+									\
+	/*								\
+	 *  Set up DCT							\
+	 */								\
+	for (i = 0; i < 8; i++) {					\
+		for (j = 0; j < 8; j++) {				\
+			data[i][j] = (i + j == 0) ? 2040: 0;		\
+		}							\
+		scale[i] = i ? 1.0 : invsqrt2;				\
+	}								\
+	for (i = 0; i < 8; i++) {					\
+		const isa ## _vd_t pi_i = isa ## _vd_set1((i + i + 1) * pi_over_16);	\
+									\
+		for (u = 0; u < 8; u += ISA ## _VD_LANES) {		\
+			const isa ## _vd_t cos_pi_i_u = isa ## _vd_cos(isa ## _vd_mul(pi_i, isa ## _vd_load(&stress_cpu_vec_iota[u])));	\
+									\
+			isa ## _vd_store(&cos_i[u], isa ## _vd_mul(isa ## _vd_load(&scale[u]), cos_pi_i_u));	\
+		}							\
+		for (j = 0; j < 8; j++) {				\
+			const isa ## _vd_t pi_j = isa ## _vd_set1((j + j + 1) * pi_over_16);	\
+			isa ## _vd_t sum = isa ## _vd_set1(0.0);	\
+									\
+			for (u = 0; u < 8; u++) {			\
+				const isa ## _vd_t cu = isa ## _vd_set1(cos_i[u]);	\
+									\
+				for (v = 0; v < 8; v += ISA ## _VD_LANES) {	\
+					const isa ## _vd_t cos_pi_j_v = isa ## _vd_cos(isa ## _vd_mul(pi_j, isa ## _vd_load(&stress_cpu_vec_iota[v])));	\
+					const isa ## _vd_t cv = isa ## _vd_mul(isa ## _vd_load(&scale[v]), cos_pi_j_v);	\
+									\
+					sum = isa ## _vd_add(sum, isa ## _vd_mul(isa ## _vd_mul(isa ## _vd_loadf(&data[u][v]), cu), cv));	\
+				}					\
+			}						\
+			idct[i][j] = (float)(0.25 * isa ## _vd_hsum(sum));	\
+		}							\
+	}								\
+	/* Final output should be a 8x8 matrix of values 255 */		\
+	if (g_opt_flags & OPT_FLAGS_VERIFY) {				\
+		for (i = 0; i < 8; i++) {				\
+			for (j = 0; j < 8; j++) {			\
+				if ((int)idct[i][j] != 255) {		\
+					pr_fail("%s: IDCT error detected, "	\
+						"IDCT[%d][%d] was %d, "	\
+						"expecting 255\n",	\
+						name, i, j, (int)idct[i][j]);	\
+				}					\
+			}						\
+			if (!keep_stressing_flag())			\
+				return;					\
+		}							\
+	}								\
+}									\
+									\
+/* ipv4_checksum() of sz bytes at ptr, a vector of words at a time */	\
+static inline uint16_t ALWAYS_INLINE target isa ## _ipv4_checksum(const uint16_t *ptr, const size_t sz)	\
+{									\
+	const size_t words = sz >> 1;					\
+	isa ## _vu_t vsum = isa ## _vu_set1(0);				\
+	register uint32_t sum;						\
+	register size_t i;						\
+									\
+	for (i = 0; i + (ISA ## _VU_LANES * 2) <= words; i += ISA ## _VU_LANES * 2)	\
+		vsum = isa ## _vu_add_u16(vsum, ptr + i);		\
+	sum = isa ## _vu_hsum(vsum);					\
+	for (; i < words; i++)						\
+		sum += ptr[i];						\
+	if (sz & 1)							\
+		sum += *(const uint8_t *)(ptr + words);			\
+	sum = (sum >> 16) + (sum & 0xffff);				\
+	sum += (sum >> 16);						\
+									\
+	return (uint16_t)~sum;						\
+}									\
+									\
+static void OPTIMIZE3 target stress_cpu_ipv4checksum_ ## isa(const char *name)	\
+{									\
+	uint16_t buffer[512];						\
+	size_t i;							\
+									\
+	random_buffer((uint8_t *)buffer, sizeof(buffer));		\
+	for (i = 1; i < sizeof(buffer); i++) {				\
+		const uint16_t csum = isa ## _ipv4_checksum(buffer, i);	\
+									\
+		if ((g_opt_flags & OPT_FLAGS_VERIFY) && (csum != ipv4_checksum(buffer, i))) {	\
+			pr_fail("%s: ipv4checksum error detected, vector and "	\
+				"scalar checksums of %zu bytes differ\n", name, i);	\
+			break;						\
+		}							\
+		stress_uint16_put(csum);				\
+	}								\
+}
+
+#if defined(STRESS_CPU_ISA_HAVE_SSE)
+STRESS_CPU_VEC_KERNELS(sse, SSE, STRESS_CPU_TARGET_SSE)
+#endif
+#if defined(STRESS_CPU_ISA_HAVE_AVX2)
+STRESS_CPU_VEC_KERNELS(avx2, AVX2, STRESS_CPU_TARGET_AVX2)
+#endif
+#if defined(STRESS_CPU_ISA_HAVE_AVX512)
+STRESS_CPU_VEC_KERNELS(avx512, AVX512, STRESS_CPU_TARGET_AVX512)
+#endif
+#if defined(STRESS_CPU_ISA_HAVE_NEON)
+STRESS_CPU_VEC_KERNELS(neon, NEON, STRESS_CPU_TARGET_NEON)
+#endif
+
+static size_t stress_cpu_isa = STRESS_CPU_ISA_SCALAR;
+
+/*
+ *  STRESS_CPU_ISA_TABLE()
+ *	declare the scalar variant, the table of ISA variants and the
+ *	dispatcher of a method, the ISA variants must already exist
+ */
+#define STRESS_CPU_ISA_TABLE(method)					\
+static void TARGET_ISA_SCALAR method ## _scalar(const char *name)	\
+{									\
+	method ## _kernel(name);					\
+}									\
+									\
+static const stress_cpu_func method ## _isa[STRESS_CPU_ISA_MAX] = {	\
+	method ## _scalar,						\
+	STRESS_CPU_ISA_SSE_PTR(method),					\
+	STRESS_CPU_ISA_AVX2_PTR(method),				\
+	STRESS_CPU_ISA_AVX512_PTR(method),				\
+	STRESS_CPU_ISA_NEON_PTR(method),				\
+};									\
+									\
+static void method(const char *name)					\
+{									\
+	method ## _isa[stress_cpu_isa](name);				\
+}
+
+/*
+ *  STRESS_CPU_ISA_METHOD()
+ *	declare the ISA variants of a method by compiling its kernel
+ *	for each ISA, and its table and dispatcher
+ */
+#define STRESS_CPU_ISA_METHOD(method)					\
+STRESS_CPU_ISA_SSE_FUNC(method)						\
+STRESS_CPU_ISA_AVX2_FUNC(method)					\
+STRESS_CPU_ISA_AVX512_FUNC(method)					\
+STRESS_CPU_ISA_NEON_FUNC(method)					\
+STRESS_CPU_ISA_TABLE(method)
+
+/* hand-written vector kernels */
+STRESS_CPU_ISA_TABLE(stress_cpu_correlate)
+STRESS_CPU_ISA_TABLE(stress_cpu_hamming)
+STRESS_CPU_ISA_TABLE(stress_cpu_idct)
+STRESS_CPU_ISA_TABLE(stress_cpu_ipv4checksum)
+
+/* serial kernels, only compiled for each ISA */
+STRESS_CPU_ISA_METHOD(stress_cpu_crc16)
+STRESS_CPU_ISA_METHOD(stress_cpu_dither)
+STRESS_CPU_ISA_METHOD(stress_cpu_fletcher16)
+
+static bool stress_cpu_isa_scalar(void)
+{
+	return true;
+}
+
+static bool stress_cpu_isa_sse(void)
+{
+#if defined(STRESS_CPU_ISA_HAVE_SSE)
+	return __builtin_cpu_supports("sse4.2");
+#else
+	return false;
+#endif
+}
+
+static bool stress_cpu_isa_avx2(void)
+{
+#if defined(STRESS_CPU_ISA_HAVE_AVX2)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+static bool stress_cpu_isa_avx512(void)
+{
+#if defined(STRESS_CPU_ISA_HAVE_AVX512)
+	return __builtin_cpu_supports("avx512f") &&
+	       __builtin_cpu_supports("avx512bw") &&
+	       __builtin_cpu_supports("avx512vl");
+#else
+	return false;
+#endif
+}
+
+static bool stress_cpu_isa_neon(void)
+{
+#if defined(STRESS_CPU_ISA_HAVE_NEON)
+	return true;
+#else
+	return false;
+#endif
+}
+
+typedef struct {
+	const char *name;		/* --cpu-isa name */
+	bool (*supported)(void);	/* built and supported by the CPU? */
+} stress_cpu_isa_info_t;
+
+/* ordered by increasing vector width, index is STRESS_CPU_ISA_* */
+static const stress_cpu_isa_info_t cpu_isas[STRESS_CPU_ISA_MAX] = {
+	{ "scalar",	stress_cpu_isa_scalar },
+	{ "sse",	stress_cpu_isa_sse },
+	{ "avx2",	stress_cpu_isa_avx2 },
+	{ "avx512",	stress_cpu_isa_avx512 },
+	{ "neon",	stress_cpu_isa_neon },
+};
+
+/*
+ *  stress_set_cpu_isa()
+ *	set the ISA of the vectorized method variants
+ */
+static int stress_set_cpu_isa(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(cpu_isas); i++) {
+		if (!strcmp(opt, cpu_isas[i].name))
+			return stress_set_setting("cpu-isa", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "cpu-isa must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(cpu_isas); i++)
+		(void)fprintf(stderr, " %s", cpu_isas[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 /*
  * Table of cpu stress methods
  */
@@ -2890,23 +3856,91 @@ static const stress_cpu_method_info_t cpu_methods[] = {
 	{ NULL,			NULL,				1.0 }
 };
 
+#define STRESS_CPU_CALIBRATE_TIME	(0.001)	/* minimum time to measure a method */
+#define STRESS_CPU_CALIBRATE_SLICE	(0.005)	/* time given to each method in turn */
+
 static double stress_cpu_counter_scale[SIZEOF_ARRAY(cpu_methods)];
+static stress_metrics_t stress_cpu_metrics[SIZEOF_ARRAY(cpu_methods)];
+static uint32_t stress_cpu_method_calls[SIZEOF_ARRAY(cpu_methods)];
 
 static void stress_cpu_method(size_t method, const stress_args_t *args, double *counter)
 {
+	double t;
+
 	if (method == 0) {
 		static size_t i = 1;	/* Skip over stress_cpu_all */
+		static uint32_t calls;
 
 		method = i;
-		i++;
-		if (!cpu_methods[i].func)
-			i = 1;
+		calls++;
+		if (calls >= stress_cpu_method_calls[i]) {
+			calls = 0;
+			i++;
+			if (!cpu_methods[i].func)
+				i = 1;
+		}
 	}
+	t = stress_time_now();
 	cpu_methods[method].func(args->name);
+	stress_cpu_metrics[method].duration += stress_time_now() - t;
+	stress_cpu_metrics[method].count += 1.0;
 	*counter += stress_cpu_counter_scale[method];
 	set_counter(args, (uint64_t)*counter);
 }
 
+/*
+ *  stress_cpu_calibrate()
+ *	measure the cost of a call of each method and scale the
+ *	number of consecutive calls each method gets in the 'all'
+ *	method so that each method runs for about the same time
+ */
+static void stress_cpu_calibrate(const stress_args_t *args)
+{
+	const double t_start = stress_time_now();
+	size_t i;
+
+	for (i = 1; cpu_methods[i].func && keep_stressing_flag(); i++) {
+		uint32_t n = 0, calls = 1;
+		double t, duration;
+
+		t = stress_time_now();
+		do {
+			uint32_t j;
+
+			for (j = 0; j < calls; j++)
+				cpu_methods[i].func(args->name);
+			n += calls;
+			calls += calls;
+			duration = stress_time_now() - t;
+		} while ((duration < STRESS_CPU_CALIBRATE_TIME) && keep_stressing_flag());
+
+		calls = (uint32_t)((STRESS_CPU_CALIBRATE_SLICE * (double)n) / duration);
+		stress_cpu_method_calls[i] = (calls < 1) ? 1 : calls;
+	}
+	if (args->instance == 0)
+		pr_dbg("%s: calibrated %zu methods in %.3f seconds\n",
+			args->name, i - 1, stress_time_now() - t_start);
+}
+
+/*
+ *  stress_cpu_metrics_set()
+ *	set the per method rate metrics, except for the 'all' method
+ */
+static void stress_cpu_metrics_set(const stress_args_t *args)
+{
+	size_t i;
+
+	for (i = 1; cpu_methods[i].func; i++) {
+		if (stress_cpu_metrics[i].duration > 0.0) {
+			char msg[64];
+			const double rate = stress_cpu_metrics[i].count / stress_cpu_metrics[i].duration;
+
+			(void)snprintf(msg, sizeof(msg), "%s cpu ops per sec", cpu_methods[i].name);
+			stress_metrics_set(args, i - 1, msg, rate);
+		}
+	}
+}
+
 /*
  *  stress_set_cpu_method()
  *	set the default cpu stress method
@@ -2973,12 +4007,31 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 	int32_t cpu_load_slice = -64;
 	double counter = 0.0;
 	bool cpu_old_metrics = false;
+	bool cpu_calibrate = false;
+	size_t cpu_isa = STRESS_CPU_ISA_MAX;
 	size_t i;
 
 	(void)stress_get_setting("cpu-load", &cpu_load);
 	(void)stress_get_setting("cpu-load-slice", &cpu_load_slice);
 	(void)stress_get_setting("cpu-method", &cpu_method);
 	(void)stress_get_setting("cpu-old-metrics", &cpu_old_metrics);
+	(void)stress_get_setting("cpu-calibrate", &cpu_calibrate);
+	(void)stress_get_setting("cpu-isa", &cpu_isa);
+
+	if (cpu_isa >= STRESS_CPU_ISA_MAX) {
+		/* not specified, use the widest ISA the CPU supports */
+		for (cpu_isa = STRESS_CPU_ISA_MAX - 1; cpu_isa > STRESS_CPU_ISA_SCALAR; cpu_isa--) {
+			if (cpu_isas[cpu_isa].supported())
+				break;
+		}
+	} else if (!cpu_isas[cpu_isa].supported()) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: cpu-isa '%s' is not supported by this "
+				"processor or build, skipping stressor\n",
+				args->name, cpu_isas[cpu_isa].name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+	stress_cpu_isa = cpu_isa;
 
 	if (cpu_old_metrics) {
 		for (i = 0; i < SIZEOF_ARRAY(stress_cpu_counter_scale); i++)
@@ -2987,9 +4040,17 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 		for (i = 0; i < SIZEOF_ARRAY(stress_cpu_counter_scale); i++)
 			stress_cpu_counter_scale[i] = 1484.50 / cpu_methods[i].bogo_op_rate;
 	}
+	for (i = 0; i < SIZEOF_ARRAY(stress_cpu_metrics); i++) {
+		stress_cpu_metrics[i].duration = 0.0;
+		stress_cpu_metrics[i].count = 0.0;
+		stress_cpu_method_calls[i] = 1;
+	}
+	if (cpu_calibrate && (cpu_method == 0))
+		stress_cpu_calibrate(args);
 
 	if (args->instance == 0)
-		pr_dbg("%s: using method '%s'\n", args->name, cpu_methods[cpu_method].name);
+		pr_dbg("%s: using method '%s', %s ISA for vectorizable methods\n",
+			args->name, cpu_methods[cpu_method].name, cpu_isas[stress_cpu_isa].name);
 
 	/*
 	 * It is unlikely, but somebody may request to do a zero
@@ -3012,6 +4073,7 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 			stress_cpu_method(cpu_method, args, &counter);
 		} while (keep_stressing(args));
 
+		stress_cpu_metrics_set(args);
 		stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 		return EXIT_SUCCESS;
 	}
@@ -3097,6 +4159,7 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 			args->name);
 	}
 
+	stress_cpu_metrics_set(args);
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
 	return EXIT_SUCCESS;
@@ -3109,6 +4172,8 @@ static void stress_cpu_set_default(void)
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cpu_load,		stress_set_cpu_load },
+	{ OPT_cpu_calibrate,	stress_set_cpu_calibrate },
+	{ OPT_cpu_isa,		stress_set_cpu_isa },
 	{ OPT_cpu_load_slice,	stress_set_cpu_load_slice },
 	{ OPT_cpu_method,	stress_set_cpu_method },
 	{ OPT_cpu_old_metrics,	stress_set_cpu_old_metrics },
@@ -0,0 +1,1602 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-perf.h"
+
+#if defined(HAVE_LINUX_IF_ALG_H)
+#include <linux/if_alg.h>
+#endif
+
+#if defined(HAVE_LINUX_SOCKET_H)
+#include <linux/socket.h>
+#endif
+
+#if defined(HAVE_INTEL_IPSEC_MB_H)
+#include <intel-ipsec-mb.h>
+#endif
+
+#define CRYPTOBENCH_ALG_AES_GCM		(0)	/* AES-128-GCM encrypt and tag */
+#define CRYPTOBENCH_ALG_CHACHA20_POLY1305 (1)	/* RFC 8439 AEAD encrypt and tag */
+#define CRYPTOBENCH_ALG_SHA256		(2)
+#define CRYPTOBENCH_ALG_SHA512		(3)
+#define CRYPTOBENCH_ALG_MAX		(4)
+
+#define CRYPTOBENCH_BACKEND_USER	(0)	/* portable C, no CPU crypto extensions */
+#define CRYPTOBENCH_BACKEND_AF_ALG	(1)	/* kernel crypto API, may be offloaded */
+#define CRYPTOBENCH_BACKEND_IPSEC_SSE	(2)	/* intel-ipsec-mb SSE/AESNI */
+#define CRYPTOBENCH_BACKEND_IPSEC_AVX2	(3)	/* intel-ipsec-mb AVX2 */
+#define CRYPTOBENCH_BACKEND_IPSEC_AVX512 (4)	/* intel-ipsec-mb AVX512 */
+#define CRYPTOBENCH_BACKEND_MAX		(5)
+
+#define CRYPTOBENCH_ALL			(-1)	/* all algorithms or backends */
+
+#define CRYPTOBENCH_SIZE_MAX		(65536)	/* largest buffer size */
+#define CRYPTOBENCH_ROUND_BYTES		(256 * KB)	/* bytes per size per round */
+#define CRYPTOBENCH_TAG_LEN		(16)	/* AEAD tag length */
+#define CRYPTOBENCH_IV_LEN		(12)	/* AEAD nonce length */
+
+static const stress_help_t help[] = {
+	{ NULL,	"cryptobench N",		"start N workers benchmarking crypto implementations" },
+	{ NULL,	"cryptobench-alg A",		"select algorithm [ all | aes-gcm | chacha20-poly1305 | sha256 | sha512 ]" },
+	{ NULL,	"cryptobench-backend B",	"select backend [ all | user | af-alg | ipsec-mb-sse | ipsec-mb-avx2 | ipsec-mb-avx512 ]" },
+	{ NULL,	"cryptobench-ops N",		"stop after N cryptobench rounds" },
+	{ NULL,	NULL,				NULL }
+};
+
+static const char * const cryptobench_algs[CRYPTOBENCH_ALG_MAX] = {
+	"aes-gcm",
+	"chacha20-poly1305",
+	"sha256",
+	"sha512",
+};
+
+static const char * const cryptobench_backends[CRYPTOBENCH_BACKEND_MAX] = {
+	"user",
+	"af-alg",
+	"ipsec-mb-sse",
+	"ipsec-mb-avx2",
+	"ipsec-mb-avx512",
+};
+
+static const size_t cryptobench_sizes[] = {
+	16, 64, 256, 1024, 4096, 16384, CRYPTOBENCH_SIZE_MAX
+};
+
+/*
+ *  stress_set_cryptobench_name()
+ *	set setting name to the index of opt in names, or to
+ *	CRYPTOBENCH_ALL for "all"
+ */
+static int stress_set_cryptobench_name(
+	const char *opt,
+	const char *setting,
+	const char * const *names,
+	const int n)
+{
+	int i;
+
+	if (!strcmp(opt, "all")) {
+		i = CRYPTOBENCH_ALL;
+		return stress_set_setting(setting, TYPE_ID_INT, &i);
+	}
+	for (i = 0; i < n; i++) {
+		if (!strcmp(opt, names[i]))
+			return stress_set_setting(setting, TYPE_ID_INT, &i);
+	}
+	(void)fprintf(stderr, "%s must be one of: all", setting);
+	for (i = 0; i < n; i++)
+		(void)fprintf(stderr, " %s", names[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_cryptobench_alg(const char *opt)
+{
+	return stress_set_cryptobench_name(opt, "cryptobench-alg",
+		cryptobench_algs, CRYPTOBENCH_ALG_MAX);
+}
+
+static int stress_set_cryptobench_backend(const char *opt)
+{
+	return stress_set_cryptobench_name(opt, "cryptobench-backend",
+		cryptobench_backends, CRYPTOBENCH_BACKEND_MAX);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_cryptobench_alg,		stress_set_cryptobench_alg },
+	{ OPT_cryptobench_backend,	stress_set_cryptobench_backend },
+	{ 0,				NULL }
+};
+
+/* throughput of one backend, algorithm and buffer size */
+typedef struct {
+	double duration;		/* seconds */
+	double bytes;			/* bytes processed */
+	double cycles;			/* CPU cycles */
+} stress_cryptobench_result_t;
+
+struct stress_cryptobench_backend;
+
+/* run n operations on len bytes of in, leaving the result in out */
+typedef bool (*stress_cryptobench_run_t)(
+	struct stress_cryptobench_backend *backend,
+	const int alg,
+	const uint8_t *in,
+	uint8_t *out,
+	const size_t len,
+	const size_t n);
+
+typedef struct stress_cryptobench_backend {
+	int id;					/* CRYPTOBENCH_BACKEND_* */
+	bool (*open)(const stress_args_t *args, struct stress_cryptobench_backend *backend);
+	stress_cryptobench_run_t run;
+	void (*close)(struct stress_cryptobench_backend *backend);
+	bool supported[CRYPTOBENCH_ALG_MAX];	/* algorithms this backend can run */
+	int fds[CRYPTOBENCH_ALG_MAX];		/* AF_ALG operation sockets */
+	void *priv;				/* intel-ipsec-mb manager */
+	stress_cryptobench_result_t results[CRYPTOBENCH_ALG_MAX][SIZEOF_ARRAY(cryptobench_sizes)];
+} stress_cryptobench_backend_t;
+
+/* key and nonce shared by all the backends so the outputs can be compared */
+static uint8_t cryptobench_key[32] ALIGNED(16);
+static uint8_t cryptobench_iv[CRYPTOBENCH_IV_LEN] ALIGNED(16);
+
+static inline uint32_t stress_cb_le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	       ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void stress_cb_put_le32(uint8_t *p, const uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t stress_cb_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void stress_cb_put_be32(uint8_t *p, const uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static inline uint64_t stress_cb_be64(const uint8_t *p)
+{
+	return ((uint64_t)stress_cb_be32(p) << 32) | (uint64_t)stress_cb_be32(p + 4);
+}
+
+static inline void stress_cb_put_be64(uint8_t *p, const uint64_t v)
+{
+	stress_cb_put_be32(p, (uint32_t)(v >> 32));
+	stress_cb_put_be32(p + 4, (uint32_t)v);
+}
+
+static inline uint32_t stress_cb_ror32(const uint32_t x, const int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t stress_cb_rol32(const uint32_t x, const int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static inline uint64_t stress_cb_ror64(const uint64_t x, const int n)
+{
+	return (x >> n) | (x << (64 - n));
+}
+
+/*
+ *  User space baseline implementations, plain portable C with no
+ *  CPU crypto extensions, as a reference point for the accelerated
+ *  and offloaded backends.
+ */
+static const uint32_t sha256_k[64] = {
+	0x428a2f98U, 0x71374491U, 0xb5c0fbcfU, 0xe9b5dba5U,
+	0x3956c25bU, 0x59f111f1U, 0x923f82a4U, 0xab1c5ed5U,
+	0xd807aa98U, 0x12835b01U, 0x243185beU, 0x550c7dc3U,
+	0x72be5d74U, 0x80deb1feU, 0x9bdc06a7U, 0xc19bf174U,
+	0xe49b69c1U, 0xefbe4786U, 0x0fc19dc6U, 0x240ca1ccU,
+	0x2de92c6fU, 0x4a7484aaU, 0x5cb0a9dcU, 0x76f988daU,
+	0x983e5152U, 0xa831c66dU, 0xb00327c8U, 0xbf597fc7U,
+	0xc6e00bf3U, 0xd5a79147U, 0x06ca6351U, 0x14292967U,
+	0x27b70a85U, 0x2e1b2138U, 0x4d2c6dfcU, 0x53380d13U,
+	0x650a7354U, 0x766a0abbU, 0x81c2c92eU, 0x92722c85U,
+	0xa2bfe8a1U, 0xa81a664bU, 0xc24b8b70U, 0xc76c51a3U,
+	0xd192e819U, 0xd6990624U, 0xf40e3585U, 0x106aa070U,
+	0x19a4c116U, 0x1e376c08U, 0x2748774cU, 0x34b0bcb5U,
+	0x391c0cb3U, 0x4ed8aa4aU, 0x5b9cca4fU, 0x682e6ff3U,
+	0x748f82eeU, 0x78a5636fU, 0x84c87814U, 0x8cc70208U,
+	0x90befffaU, 0xa4506cebU, 0xbef9a3f7U, 0xc67178f2U
+};
+
+static const uint32_t sha256_h[8] = {
+	0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU,
+	0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U
+};
+
+static const uint64_t sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static const uint64_t sha512_h[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static void stress_cb_sha256_block(uint32_t h[8], const uint8_t *p)
+{
+	uint32_t w[64], a, b, c, d, e, f, g, hh;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = stress_cb_be32(p + (i * 4));
+	for (i = 16; i < 64; i++) {
+		const uint32_t s0 = stress_cb_ror32(w[i - 15], 7) ^
+				    stress_cb_ror32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const uint32_t s1 = stress_cb_ror32(w[i - 2], 17) ^
+				    stress_cb_ror32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	a = h[0]; b = h[1]; c = h[2]; d = h[3];
+	e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+	for (i = 0; i < 64; i++) {
+		const uint32_t s1 = stress_cb_ror32(e, 6) ^ stress_cb_ror32(e, 11) ^ stress_cb_ror32(e, 25);
+		const uint32_t ch = (e & f) ^ (~e & g);
+		const uint32_t t1 = hh + s1 + ch + sha256_k[i] + w[i];
+		const uint32_t s0 = stress_cb_ror32(a, 2) ^ stress_cb_ror32(a, 13) ^ stress_cb_ror32(a, 22);
+		const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		const uint32_t t2 = s0 + maj;
+
+		hh = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+	h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+static void stress_cb_sha256(const uint8_t *in, const size_t len, uint8_t digest[32])
+{
+	uint32_t h[8];
+	uint8_t last[128];
+	size_t i, rem = len & 63, n_last;
+
+	(void)memcpy(h, sha256_h, sizeof(h));
+	for (i = 0; i + 64 <= len; i += 64)
+		stress_cb_sha256_block(h, in + i);
+
+	(void)memset(last, 0, sizeof(last));
+	(void)memcpy(last, in + i, rem);
+	last[rem] = 0x80;
+	n_last = (rem < 56) ? 64 : 128;
+	stress_cb_put_be64(last + n_last - 8, (uint64_t)len * 8);
+	for (i = 0; i < n_last; i += 64)
+		stress_cb_sha256_block(h, last + i);
+	for (i = 0; i < 8; i++)
+		stress_cb_put_be32(digest + (i * 4), h[i]);
+}
+
+static void stress_cb_sha512_block(uint64_t h[8], const uint8_t *p)
+{
+	uint64_t w[80], a, b, c, d, e, f, g, hh;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = stress_cb_be64(p + (i * 8));
+	for (i = 16; i < 80; i++) {
+		const uint64_t s0 = stress_cb_ror64(w[i - 15], 1) ^
+				    stress_cb_ror64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+		const uint64_t s1 = stress_cb_ror64(w[i - 2], 19) ^
+				    stress_cb_ror64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	a = h[0]; b = h[1]; c = h[2]; d = h[3];
+	e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+	for (i = 0; i < 80; i++) {
+		const uint64_t s1 = stress_cb_ror64(e, 14) ^ stress_cb_ror64(e, 18) ^ stress_cb_ror64(e, 41);
+		const uint64_t ch = (e & f) ^ (~e & g);
+		const uint64_t t1 = hh + s1 + ch + sha512_k[i] + w[i];
+		const uint64_t s0 = stress_cb_ror64(a, 28) ^ stress_cb_ror64(a, 34) ^ stress_cb_ror64(a, 39);
+		const uint64_t maj = (a & b) ^ (a & c) ^ (b & c);
+		const uint64_t t2 = s0 + maj;
+
+		hh = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+	h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+static void stress_cb_sha512(const uint8_t *in, const size_t len, uint8_t digest[64])
+{
+	uint64_t h[8];
+	uint8_t last[256];
+	size_t i, rem = len & 127, n_last;
+
+	(void)memcpy(h, sha512_h, sizeof(h));
+	for (i = 0; i + 128 <= len; i += 128)
+		stress_cb_sha512_block(h, in + i);
+
+	/* 128 bit length, the top 64 bits are always zero here */
+	(void)memset(last, 0, sizeof(last));
+	(void)memcpy(last, in + i, rem);
+	last[rem] = 0x80;
+	n_last = (rem < 112) ? 128 : 256;
+	stress_cb_put_be64(last + n_last - 8, (uint64_t)len * 8);
+	for (i = 0; i < n_last; i += 128)
+		stress_cb_sha512_block(h, last + i);
+	for (i = 0; i < 8; i++)
+		stress_cb_put_be64(digest + (i * 8), h[i]);
+}
+
+/* AES-128 with T-tables generated at start up */
+static uint8_t aes_sbox[256];
+static uint32_t aes_te[4][256];
+
+typedef struct {
+	uint32_t rk[44];		/* AES-128 round keys */
+	uint64_t hh[16];		/* GHASH 4 bit table, high halves */
+	uint64_t hl[16];		/* GHASH 4 bit table, low halves */
+} stress_cb_gcm_t;
+
+static inline uint8_t stress_cb_xtime(const uint8_t x)
+{
+	return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+/*
+ *  stress_cb_aes_init()
+ *	generate the AES S-box and encryption T-tables
+ */
+static void stress_cb_aes_init(void)
+{
+	uint8_t p = 1, q = 1;
+	int i;
+
+	/* walk the multiplicative group with generator 3 to find inverses */
+	do {
+		uint8_t x;
+
+		p = p ^ stress_cb_xtime(p);
+		q ^= (uint8_t)(q << 1);
+		q ^= (uint8_t)(q << 2);
+		q ^= (uint8_t)(q << 4);
+		if (q & 0x80)
+			q ^= 0x09;
+		x = q ^ (uint8_t)((q << 1) | (q >> 7)) ^ (uint8_t)((q << 2) | (q >> 6)) ^
+		    (uint8_t)((q << 3) | (q >> 5)) ^ (uint8_t)((q << 4) | (q >> 4));
+		aes_sbox[p] = x ^ 0x63;
+	} while (p != 1);
+	aes_sbox[0] = 0x63;
+
+	for (i = 0; i < 256; i++) {
+		const uint8_t s = aes_sbox[i];
+		const uint8_t s2 = stress_cb_xtime(s);
+		const uint32_t t = ((uint32_t)s2 << 24) | ((uint32_t)s << 16) |
+				   ((uint32_t)s << 8) | (uint32_t)(s2 ^ s);
+
+		aes_te[0][i] = t;
+		aes_te[1][i] = stress_cb_ror32(t, 8);
+		aes_te[2][i] = stress_cb_ror32(t, 16);
+		aes_te[3][i] = stress_cb_ror32(t, 24);
+	}
+}
+
+static void stress_cb_aes128_expand(uint32_t rk[44], const uint8_t key[16])
+{
+	uint8_t rcon = 1;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		rk[i] = stress_cb_be32(key + (i * 4));
+	for (i = 4; i < 44; i++) {
+		uint32_t t = rk[i - 1];
+
+		if ((i & 3) == 0) {
+			t = ((uint32_t)aes_sbox[(t >> 16) & 0xff] << 24) |
+			    ((uint32_t)aes_sbox[(t >> 8) & 0xff] << 16) |
+			    ((uint32_t)aes_sbox[t & 0xff] << 8) |
+			    (uint32_t)aes_sbox[t >> 24];
+			t ^= (uint32_t)rcon << 24;
+			rcon = stress_cb_xtime(rcon);
+		}
+		rk[i] = rk[i - 4] ^ t;
+	}
+}
+
+static void stress_cb_aes128_encrypt(const uint32_t rk[44], const uint8_t in[16], uint8_t out[16])
+{
+	uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+	int r;
+
+	s0 = stress_cb_be32(in) ^ rk[0];
+	s1 = stress_cb_be32(in + 4) ^ rk[1];
+	s2 = stress_cb_be32(in + 8) ^ rk[2];
+	s3 = stress_cb_be32(in + 12) ^ rk[3];
+
+	for (r = 1; r < 10; r++) {
+		const uint32_t *k = rk + (r * 4);
+
+		t0 = aes_te[0][s0 >> 24] ^ aes_te[1][(s1 >> 16) & 0xff] ^
+		     aes_te[2][(s2 >> 8) & 0xff] ^ aes_te[3][s3 & 0xff] ^ k[0];
+		t1 = aes_te[0][s1 >> 24] ^ aes_te[1][(s2 >> 16) & 0xff] ^
+		     aes_te[2][(s3 >> 8) & 0xff] ^ aes_te[3][s0 & 0xff] ^ k[1];
+		t2 = aes_te[0][s2 >> 24] ^ aes_te[1][(s3 >> 16) & 0xff] ^
+		     aes_te[2][(s0 >> 8) & 0xff] ^ aes_te[3][s1 & 0xff] ^ k[2];
+		t3 = aes_te[0][s3 >> 24] ^ aes_te[1][(s0 >> 16) & 0xff] ^
+		     aes_te[2][(s1 >> 8) & 0xff] ^ aes_te[3][s2 & 0xff] ^ k[3];
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+
+	/* final round, no MixColumns */
+#define AES_FINAL(a, b, c, d, k)				\
+	(((uint32_t)aes_sbox[(a) >> 24] << 24) ^		\
+	 ((uint32_t)aes_sbox[((b) >> 16) & 0xff] << 16) ^	\
+	 ((uint32_t)aes_sbox[((c) >> 8) & 0xff] << 8) ^		\
+	 (uint32_t)aes_sbox[(d) & 0xff] ^ (k))
+
+	stress_cb_put_be32(out, AES_FINAL(s0, s1, s2, s3, rk[40]));
+	stress_cb_put_be32(out + 4, AES_FINAL(s1, s2, s3, s0, rk[41]));
+	stress_cb_put_be32(out + 8, AES_FINAL(s2, s3, s0, s1, rk[42]));
+	stress_cb_put_be32(out + 12, AES_FINAL(s3, s0, s1, s2, rk[43]));
+#undef AES_FINAL
+}
+
+/* GHASH reduction of the 4 bits shifted out, Shoup's method */
+static const uint64_t ghash_last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static void stress_cb_gcm_init(stress_cb_gcm_t *gcm, const uint8_t key[16])
+{
+	uint8_t h[16];
+	uint64_t vh, vl;
+	int i, j;
+
+	stress_cb_aes128_expand(gcm->rk, key);
+	(void)memset(h, 0, sizeof(h));
+	stress_cb_aes128_encrypt(gcm->rk, h, h);
+
+	vh = stress_cb_be64(h);
+	vl = stress_cb_be64(h + 8);
+	gcm->hl[8] = vl;
+	gcm->hh[8] = vh;
+	gcm->hl[0] = 0;
+	gcm->hh[0] = 0;
+	for (i = 4; i > 0; i >>= 1) {
+		const uint64_t t = (vl & 1) * 0xe1000000ULL;
+
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ (t << 32);
+		gcm->hl[i] = vl;
+		gcm->hh[i] = vh;
+	}
+	for (i = 2; i <= 8; i *= 2) {
+		vh = gcm->hh[i];
+		vl = gcm->hl[i];
+		for (j = 1; j < i; j++) {
+			gcm->hh[i + j] = vh ^ gcm->hh[j];
+			gcm->hl[i + j] = vl ^ gcm->hl[j];
+		}
+	}
+}
+
+/* x = x * H in GF(2^128) */
+static void stress_cb_gcm_mult(const stress_cb_gcm_t *gcm, uint8_t x[16])
+{
+	uint64_t zh, zl;
+	uint8_t lo = x[15] & 0xf;
+	int i;
+
+	zh = gcm->hh[lo];
+	zl = gcm->hl[lo];
+	for (i = 15; i >= 0; i--) {
+		const uint8_t hi = (x[i] >> 4) & 0xf;
+		uint8_t rem;
+
+		lo = x[i] & 0xf;
+		if (i != 15) {
+			rem = (uint8_t)(zl & 0xf);
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (ghash_last4[rem] << 48);
+			zh ^= gcm->hh[lo];
+			zl ^= gcm->hl[lo];
+		}
+		rem = (uint8_t)(zl & 0xf);
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (ghash_last4[rem] << 48);
+		zh ^= gcm->hh[hi];
+		zl ^= gcm->hl[hi];
+	}
+	stress_cb_put_be64(x, zh);
+	stress_cb_put_be64(x + 8, zl);
+}
+
+static void stress_cb_gcm_ghash(const stress_cb_gcm_t *gcm, uint8_t s[16], const uint8_t *data, const size_t len)
+{
+	size_t i, j;
+
+	for (i = 0; i < len; i += 16) {
+		const size_t n = STRESS_MINIMUM(16, len - i);
+
+		for (j = 0; j < n; j++)
+			s[j] ^= data[i + j];
+		stress_cb_gcm_mult(gcm, s);
+	}
+}
+
+/*
+ *  stress_cb_aes_gcm()
+ *	AES-128-GCM encrypt in to out with a 96 bit nonce, the
+ *	tag is written after the ciphertext
+ */
+static void stress_cb_aes_gcm(
+	const stress_cb_gcm_t *gcm,
+	const uint8_t iv[CRYPTOBENCH_IV_LEN],
+	const uint8_t *aad,
+	const size_t aad_len,
+	const uint8_t *in,
+	uint8_t *out,
+	const size_t len)
+{
+	uint8_t j0[16], ctr[16], ks[16], s[16], lens[16];
+	uint32_t c;
+	size_t i, j;
+
+	(void)memcpy(j0, iv, CRYPTOBENCH_IV_LEN);
+	stress_cb_put_be32(j0 + 12, 1);
+	(void)memcpy(ctr, j0, sizeof(ctr));
+	c = 1;
+
+	for (i = 0; i < len; i += 16) {
+		const size_t n = STRESS_MINIMUM(16, len - i);
+
+		stress_cb_put_be32(ctr + 12, ++c);
+		stress_cb_aes128_encrypt(gcm->rk, ctr, ks);
+		for (j = 0; j < n; j++)
+			out[i + j] = in[i + j] ^ ks[j];
+	}
+
+	(void)memset(s, 0, sizeof(s));
+	stress_cb_gcm_ghash(gcm, s, aad, aad_len);
+	stress_cb_gcm_ghash(gcm, s, out, len);
+	stress_cb_put_be64(lens, (uint64_t)aad_len * 8);
+	stress_cb_put_be64(lens + 8, (uint64_t)len * 8);
+	stress_cb_gcm_ghash(gcm, s, lens, sizeof(lens));
+
+	stress_cb_aes128_encrypt(gcm->rk, j0, ks);
+	for (j = 0; j < CRYPTOBENCH_TAG_LEN; j++)
+		out[len + j] = s[j] ^ ks[j];
+}
+
+#define CHACHA_QR(a, b, c, d)				\
+do {							\
+	a += b; d ^= a; d = stress_cb_rol32(d, 16);	\
+	c += d; b ^= c; b = stress_cb_rol32(b, 12);	\
+	a += b; d ^= a; d = stress_cb_rol32(d, 8);	\
+	c += d; b ^= c; b = stress_cb_rol32(b, 7);	\
+} while (0)
+
+static void stress_cb_chacha20_block(
+	const uint8_t key[32],
+	const uint32_t counter,
+	const uint8_t nonce[12],
+	uint8_t out[64])
+{
+	uint32_t in[16], x[16];
+	int i;
+
+	in[0] = 0x61707865U;
+	in[1] = 0x3320646eU;
+	in[2] = 0x79622d32U;
+	in[3] = 0x6b206574U;
+	for (i = 0; i < 8; i++)
+		in[4 + i] = stress_cb_le32(key + (i * 4));
+	in[12] = counter;
+	in[13] = stress_cb_le32(nonce);
+	in[14] = stress_cb_le32(nonce + 4);
+	in[15] = stress_cb_le32(nonce + 8);
+
+	(void)memcpy(x, in, sizeof(x));
+	for (i = 0; i < 10; i++) {
+		CHACHA_QR(x[0], x[4], x[8], x[12]);
+		CHACHA_QR(x[1], x[5], x[9], x[13]);
+		CHACHA_QR(x[2], x[6], x[10], x[14]);
+		CHACHA_QR(x[3], x[7], x[11], x[15]);
+		CHACHA_QR(x[0], x[5], x[10], x[15]);
+		CHACHA_QR(x[1], x[6], x[11], x[12]);
+		CHACHA_QR(x[2], x[7], x[8], x[13]);
+		CHACHA_QR(x[3], x[4], x[9], x[14]);
+	}
+	for (i = 0; i < 16; i++)
+		stress_cb_put_le32(out + (i * 4), x[i] + in[i]);
+}
+#undef CHACHA_QR
+
+/* Poly1305 with 26 bit limbs */
+typedef struct {
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+} stress_cb_poly1305_t;
+
+static void stress_cb_poly1305_init(stress_cb_poly1305_t *p, const uint8_t key[32])
+{
+	p->r[0] = (stress_cb_le32(key)) & 0x3ffffff;
+	p->r[1] = (stress_cb_le32(key + 3) >> 2) & 0x3ffff03;
+	p->r[2] = (stress_cb_le32(key + 6) >> 4) & 0x3ffc0ff;
+	p->r[3] = (stress_cb_le32(key + 9) >> 6) & 0x3f03fff;
+	p->r[4] = (stress_cb_le32(key + 12) >> 8) & 0x00fffff;
+	(void)memset(p->h, 0, sizeof(p->h));
+	p->pad[0] = stress_cb_le32(key + 16);
+	p->pad[1] = stress_cb_le32(key + 20);
+	p->pad[2] = stress_cb_le32(key + 24);
+	p->pad[3] = stress_cb_le32(key + 28);
+}
+
+/* process len bytes, a trailing partial block is zero padded */
+static void stress_cb_poly1305_update(stress_cb_poly1305_t *p, const uint8_t *m, const size_t len)
+{
+	const uint32_t r0 = p->r[0], r1 = p->r[1], r2 = p->r[2], r3 = p->r[3], r4 = p->r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4];
+	size_t i;
+
+	for (i = 0; i < len; i += 16) {
+		uint8_t block[16];
+		const uint8_t *b = m + i;
+		uint64_t d0, d1, d2, d3, d4;
+		uint32_t c;
+
+		if (len - i < 16) {
+			(void)memset(block, 0, sizeof(block));
+			(void)memcpy(block, m + i, len - i);
+			b = block;
+		}
+		h0 += (stress_cb_le32(b)) & 0x3ffffff;
+		h1 += (stress_cb_le32(b + 3) >> 2) & 0x3ffffff;
+		h2 += (stress_cb_le32(b + 6) >> 4) & 0x3ffffff;
+		h3 += (stress_cb_le32(b + 9) >> 6) & 0x3ffffff;
+		h4 += (stress_cb_le32(b + 12) >> 8) | (1U << 24);
+
+		d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) + ((uint64_t)h2 * s3) +
+		     ((uint64_t)h3 * s2) + ((uint64_t)h4 * s1);
+		d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) + ((uint64_t)h2 * s4) +
+		     ((uint64_t)h3 * s3) + ((uint64_t)h4 * s2);
+		d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) + ((uint64_t)h2 * r0) +
+		     ((uint64_t)h3 * s4) + ((uint64_t)h4 * s3);
+		d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) + ((uint64_t)h2 * r1) +
+		     ((uint64_t)h3 * r0) + ((uint64_t)h4 * s4);
+		d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) + ((uint64_t)h2 * r2) +
+		     ((uint64_t)h3 * r1) + ((uint64_t)h4 * r0);
+
+		c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+		d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+		d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+		d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+		d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+		h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+		h1 += c;
+	}
+	p->h[0] = h0; p->h[1] = h1; p->h[2] = h2; p->h[3] = h3; p->h[4] = h4;
+}
+
+static void stress_cb_poly1305_final(stress_cb_poly1305_t *p, uint8_t tag[16])
+{
+	uint32_t h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4];
+	uint32_t g0, g1, g2, g3, g4, c, mask;
+	uint64_t f;
+
+	c = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	/* compute h - p and select it if it did not underflow */
+	g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + c - (1U << 26);
+
+	mask = (g4 >> 31) - 1;
+	g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	h0 = (h0 | (h1 << 26));
+	h1 = ((h1 >> 6) | (h2 << 20));
+	h2 = ((h2 >> 12) | (h3 << 14));
+	h3 = ((h3 >> 18) | (h4 << 8));
+
+	f = (uint64_t)h0 + p->pad[0]; h0 = (uint32_t)f;
+	f = (uint64_t)h1 + p->pad[1] + (f >> 32); h1 = (uint32_t)f;
+	f = (uint64_t)h2 + p->pad[2] + (f >> 32); h2 = (uint32_t)f;
+	f = (uint64_t)h3 + p->pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+	stress_cb_put_le32(tag, h0);
+	stress_cb_put_le32(tag + 4, h1);
+	stress_cb_put_le32(tag + 8, h2);
+	stress_cb_put_le32(tag + 12, h3);
+}
+
+/*
+ *  stress_cb_chacha20_poly1305()
+ *	RFC 8439 AEAD encrypt in to out, the tag is written
+ *	after the ciphertext
+ */
+static void stress_cb_chacha20_poly1305(
+	const uint8_t key[32],
+	const uint8_t nonce[CRYPTOBENCH_IV_LEN],
+	const uint8_t *aad,
+	const size_t aad_len,
+	const uint8_t *in,
+	uint8_t *out,
+	const size_t len)
+{
+	stress_cb_poly1305_t poly;
+	uint8_t ks[64], lens[16];
+	uint32_t counter = 1;
+	size_t i, j;
+
+	stress_cb_chacha20_block(key, 0, nonce, ks);
+	stress_cb_poly1305_init(&poly, ks);
+
+	for (i = 0; i < len; i += 64) {
+		const size_t n = STRESS_MINIMUM(64, len - i);
+
+		stress_cb_chacha20_block(key, counter++, nonce, ks);
+		for (j = 0; j < n; j++)
+			out[i + j] = in[i + j] ^ ks[j];
+	}
+
+	stress_cb_poly1305_update(&poly, aad, aad_len);
+	stress_cb_poly1305_update(&poly, out, len);
+	stress_cb_put_le32(lens, (uint32_t)aad_len);
+	stress_cb_put_le32(lens + 4, 0);
+	stress_cb_put_le32(lens + 8, (uint32_t)len);
+	stress_cb_put_le32(lens + 12, 0);
+	stress_cb_poly1305_update(&poly, lens, sizeof(lens));
+	stress_cb_poly1305_final(&poly, out + len);
+}
+
+static stress_cb_gcm_t cryptobench_gcm;
+
+static bool stress_cryptobench_user_open(const stress_args_t *args, stress_cryptobench_backend_t *backend)
+{
+	int i;
+
+	(void)args;
+
+	stress_cb_gcm_init(&cryptobench_gcm, cryptobench_key);
+	for (i = 0; i < CRYPTOBENCH_ALG_MAX; i++)
+		backend->supported[i] = true;
+	return true;
+}
+
+static bool stress_cryptobench_user_run(
+	stress_cryptobench_backend_t *backend,
+	const int alg,
+	const uint8_t *in,
+	uint8_t *out,
+	const size_t len,
+	const size_t n)
+{
+	size_t i;
+
+	(void)backend;
+
+	for (i = 0; i < n; i++) {
+		switch (alg) {
+		case CRYPTOBENCH_ALG_AES_GCM:
+			stress_cb_aes_gcm(&cryptobench_gcm, cryptobench_iv, NULL, 0, in, out, len);
+			break;
+		case CRYPTOBENCH_ALG_CHACHA20_POLY1305:
+			stress_cb_chacha20_poly1305(cryptobench_key, cryptobench_iv, NULL, 0, in, out, len);
+			break;
+		case CRYPTOBENCH_ALG_SHA256:
+			stress_cb_sha256(in, len, out);
+			break;
+		case CRYPTOBENCH_ALG_SHA512:
+			stress_cb_sha512(in, len, out);
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+static void stress_cryptobench_user_close(stress_cryptobench_backend_t *backend)
+{
+	(void)backend;
+}
+
+#if defined(HAVE_LINUX_IF_ALG_H) &&	\
+    defined(HAVE_LINUX_SOCKET_H) &&	\
+    defined(AF_ALG) &&			\
+    defined(ALG_SET_KEY) &&		\
+    defined(ALG_SET_AEAD_AUTHSIZE) &&	\
+    defined(ALG_SET_AEAD_ASSOCLEN)
+#define STRESS_CRYPTOBENCH_AF_ALG
+
+#if !defined(SOL_ALG)
+#define SOL_ALG				(279)
+#endif
+
+/* kernel algorithm names and key sizes */
+static const struct {
+	const char *type;
+	const char *name;
+	const socklen_t key_len;
+} cryptobench_af_alg[CRYPTOBENCH_ALG_MAX] = {
+	{ "aead",	"gcm(aes)",			16 },
+	{ "aead",	"rfc7539(chacha20,poly1305)",	32 },
+	{ "hash",	"sha256",			0 },
+	{ "hash",	"sha512",			0 },
+};
+
+/*
+ *  stress_cryptobench_af_alg_open()
+ *	bind and accept an operation socket per algorithm, algorithms
+ *	the kernel does not provide are marked as unsupported
+ */
+static bool stress_cryptobench_af_alg_open(const stress_args_t *args, stress_cryptobench_backend_t *backend)
+{
+	int i;
+	bool any = false;
+
+	for (i = 0; i < CRYPTOBENCH_ALG_MAX; i++) {
+		struct sockaddr_alg sa;
+		int sfd;
+
+		backend->fds[i] = -1;
+		backend->supported[i] = false;
+
+		sfd = socket(AF_ALG, SOCK_SEQPACKET, 0);
+		if (sfd < 0)
+			continue;
+		(void)memset(&sa, 0, sizeof(sa));
+		sa.salg_family = AF_ALG;
+		(void)shim_strlcpy((char *)sa.salg_type, cryptobench_af_alg[i].type, sizeof(sa.salg_type));
+		(void)shim_strlcpy((char *)sa.salg_name, cryptobench_af_alg[i].name, sizeof(sa.salg_name));
+		if (bind(sfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+			pr_dbg("%s: af-alg: %s not available, errno=%d (%s)\n",
+				args->name, cryptobench_af_alg[i].name, errno, strerror(errno));
+			(void)close(sfd);
+			continue;
+		}
+		if ((cryptobench_af_alg[i].key_len > 0) &&
+		    ((setsockopt(sfd, SOL_ALG, ALG_SET_KEY, cryptobench_key, cryptobench_af_alg[i].key_len) < 0) ||
+		     (setsockopt(sfd, SOL_ALG, ALG_SET_AEAD_AUTHSIZE, NULL, CRYPTOBENCH_TAG_LEN) < 0))) {
+			(void)close(sfd);
+			continue;
+		}
+		backend->fds[i] = accept(sfd, NULL, 0);
+		(void)close(sfd);
+		if (backend->fds[i] < 0)
+			continue;
+		backend->supported[i] = true;
+		any = true;
+	}
+	return any;
+}
+
+static bool stress_cryptobench_af_alg_run(
+	stress_cryptobench_backend_t *backend,
+	const int alg,
+	const uint8_t *in,
+	uint8_t *out,
+	const size_t len,
+	const size_t n)
+{
+	const int fd = backend->fds[alg];
+	size_t i;
+
+	if (!strcmp(cryptobench_af_alg[alg].type, "hash")) {
+		const size_t digest_len = (alg == CRYPTOBENCH_ALG_SHA256) ? 32 : 64;
+
+		for (i = 0; i < n; i++) {
+			if (send(fd, in, len, 0) != (ssize_t)len)
+				return false;
+			if (read(fd, out, digest_len) != (ssize_t)digest_len)
+				return false;
+		}
+		return true;
+	}
+
+	for (i = 0; i < n; i++) {
+		char cbuf[CMSG_SPACE(sizeof(uint32_t)) +
+			  CMSG_SPACE(sizeof(struct af_alg_iv) + CRYPTOBENCH_IV_LEN) +
+			  CMSG_SPACE(sizeof(uint32_t))] ALIGNED(8);
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+		struct af_alg_iv *iv;
+		struct iovec iov;
+		uint32_t val;
+
+		(void)memset(&msg, 0, sizeof(msg));
+		(void)memset(cbuf, 0, sizeof(cbuf));
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		if (!cmsg)
+			return false;
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_OP;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+		val = ALG_OP_ENCRYPT;
+		(void)memcpy(CMSG_DATA(cmsg), &val, sizeof(val));
+
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+		if (!cmsg)
+			return false;
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_IV;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(struct af_alg_iv) + CRYPTOBENCH_IV_LEN);
+		iv = (struct af_alg_iv *)(void *)CMSG_DATA(cmsg);
+		iv->ivlen = CRYPTOBENCH_IV_LEN;
+		(void)memcpy(iv->iv, cryptobench_iv, CRYPTOBENCH_IV_LEN);
+
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+		if (!cmsg)
+			return false;
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_AEAD_ASSOCLEN;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+		val = 0;
+		(void)memcpy(CMSG_DATA(cmsg), &val, sizeof(val));
+
+		iov.iov_base = (void *)(uintptr_t)in;
+		iov.iov_len = len;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		if (sendmsg(fd, &msg, 0) != (ssize_t)len)
+			return false;
+		/* no associated data, so ciphertext followed by the tag */
+		if (read(fd, out, len + CRYPTOBENCH_TAG_LEN) != (ssize_t)(len + CRYPTOBENCH_TAG_LEN))
+			return false;
+	}
+	return true;
+}
+
+static void stress_cryptobench_af_alg_close(stress_cryptobench_backend_t *backend)
+{
+	int i;
+
+	for (i = 0; i < CRYPTOBENCH_ALG_MAX; i++) {
+		if (backend->fds[i] >= 0) {
+			(void)close(backend->fds[i]);
+			backend->fds[i] = -1;
+		}
+	}
+}
+#endif
+
+#if defined(HAVE_INTEL_IPSEC_MB_H) &&	\
+    defined(HAVE_LIB_IPSEC_MB) &&	\
+    defined(STRESS_ARCH_X86_64) &&	\
+    defined(IMB_FEATURE_SSE4_2) &&	\
+    defined(IMB_FEATURE_CMOV) &&	\
+    defined(IMB_FEATURE_AESNI) &&	\
+    defined(IMB_FEATURE_AVX2) &&	\
+    defined(IMB_FEATURE_AVX512_SKX)
+#define STRESS_CRYPTOBENCH_IPSEC_MB
+
+/* intel-ipsec-mb manager and expanded keys of one architecture */
+typedef struct {
+	MB_MGR *mb_mgr;
+	struct gcm_key_data gcm_key ALIGNED(64);
+	uint8_t digest[64];
+} stress_cryptobench_ipsec_t;
+
+static bool stress_cryptobench_ipsec_open(const stress_args_t *args, stress_cryptobench_backend_t *backend)
+{
+	const int arch = backend->id;
+	stress_cryptobench_ipsec_t *ipsec;
+	uint64_t need;
+	int i;
+
+	if (imb_get_version() < IMB_VERSION(0, 51, 0))
+		return false;
+
+	switch (arch) {
+	case CRYPTOBENCH_BACKEND_IPSEC_SSE:
+		need = IMB_FEATURE_SSE4_2 | IMB_FEATURE_CMOV | IMB_FEATURE_AESNI;
+		break;
+	case CRYPTOBENCH_BACKEND_IPSEC_AVX2:
+		need = IMB_FEATURE_AVX2 | IMB_FEATURE_AVX | IMB_FEATURE_CMOV | IMB_FEATURE_AESNI;
+		break;
+	case CRYPTOBENCH_BACKEND_IPSEC_AVX512:
+		need = IMB_FEATURE_AVX512_SKX | IMB_FEATURE_AVX2 | IMB_FEATURE_AVX |
+		       IMB_FEATURE_CMOV | IMB_FEATURE_AESNI;
+		break;
+	default:
+		return false;
+	}
+
+	ipsec = (stress_cryptobench_ipsec_t *)calloc(1, sizeof(*ipsec));
+	if (!ipsec)
+		return false;
+	ipsec->mb_mgr = alloc_mb_mgr(0);
+	if (!ipsec->mb_mgr) {
+		free(ipsec);
+		return false;
+	}
+	if ((ipsec->mb_mgr->features & need) != need) {
+		pr_dbg("%s: %s: CPU features not available\n", args->name, cryptobench_backends[arch]);
+		free_mb_mgr(ipsec->mb_mgr);
+		free(ipsec);
+		return false;
+	}
+	switch (arch) {
+	case CRYPTOBENCH_BACKEND_IPSEC_SSE:
+		init_mb_mgr_sse(ipsec->mb_mgr);
+		break;
+	case CRYPTOBENCH_BACKEND_IPSEC_AVX2:
+		init_mb_mgr_avx2(ipsec->mb_mgr);
+		break;
+	default:
+		init_mb_mgr_avx512(ipsec->mb_mgr);
+		break;
+	}
+	IMB_AES128_GCM_PRE(ipsec->mb_mgr, cryptobench_key, &ipsec->gcm_key);
+
+	for (i = 0; i < CRYPTOBENCH_ALG_MAX; i++)
+		backend->supported[i] = true;
+#if !defined(IMB_VERSION_NUM) ||	\
+    (IMB_VERSION_NUM < IMB_VERSION(1, 0, 0))
+	/* chacha20-poly1305 arrived in intel-ipsec-mb 1.0 */
+	backend->supported[CRYPTOBENCH_ALG_CHACHA20_POLY1305] = false;
+#endif
+	backend->priv = (void *)ipsec;
+	return true;
+}
+
+/*
+ *  stress_cryptobench_ipsec_run()
+ *	submit n jobs and flush them, the jobs are multi-buffered so
+ *	small sizes are processed in parallel lanes
+ */
+static bool stress_cryptobench_ipsec_run(
+	stress_cryptobench_backend_t *backend,
+	const int alg,
+	const uint8_t *in,
+	uint8_t *out,
+	const size_t len,
+	const size_t n)
+{
+	stress_cryptobench_ipsec_t *ipsec = (stress_cryptobench_ipsec_t *)backend->priv;
+	MB_MGR *mb_mgr = ipsec->mb_mgr;
+	JOB_AES_HMAC *job;
+	size_t i, done = 0;
+
+	for (i = 0; i < n; i++) {
+		job = IMB_GET_NEXT_JOB(mb_mgr);
+		(void)memset(job, 0, sizeof(*job));
+		job->cipher_direction = ENCRYPT;
+		job->src = in;
+		job->dst = out;
+		switch (alg) {
+		case CRYPTOBENCH_ALG_AES_GCM:
+			job->chain_order = CIPHER_HASH;
+			job->cipher_mode = GCM;
+			job->hash_alg = AES_GMAC;
+			job->aes_enc_key_expanded = &ipsec->gcm_key;
+			job->aes_dec_key_expanded = &ipsec->gcm_key;
+			job->aes_key_len_in_bytes = 16;
+			job->iv = cryptobench_iv;
+			job->iv_len_in_bytes = CRYPTOBENCH_IV_LEN;
+			job->msg_len_to_cipher_in_bytes = len;
+			job->msg_len_to_hash_in_bytes = len;
+			job->u.GCM.aad = NULL;
+			job->u.GCM.aad_len_in_bytes = 0;
+			job->auth_tag_output = out + len;
+			job->auth_tag_output_len_in_bytes = CRYPTOBENCH_TAG_LEN;
+			break;
+#if defined(IMB_VERSION_NUM) &&	\
+    (IMB_VERSION_NUM >= IMB_VERSION(1, 0, 0))
+		case CRYPTOBENCH_ALG_CHACHA20_POLY1305:
+			job->chain_order = IMB_ORDER_CIPHER_HASH;
+			job->cipher_mode = IMB_CIPHER_CHACHA20_POLY1305;
+			job->hash_alg = IMB_AUTH_CHACHA20_POLY1305;
+			job->enc_keys = cryptobench_key;
+			job->dec_keys = cryptobench_key;
+			job->key_len_in_bytes = 32;
+			job->iv = cryptobench_iv;
+			job->iv_len_in_bytes = CRYPTOBENCH_IV_LEN;
+			job->msg_len_to_cipher_in_bytes = len;
+			job->msg_len_to_hash_in_bytes = len;
+			job->u.CHACHA20_POLY1305.aad = NULL;
+			job->u.CHACHA20_POLY1305.aad_len_in_bytes = 0;
+			job->auth_tag_output = out + len;
+			job->auth_tag_output_len_in_bytes = CRYPTOBENCH_TAG_LEN;
+			break;
+#endif
+		case CRYPTOBENCH_ALG_SHA256:
+		case CRYPTOBENCH_ALG_SHA512:
+			job->chain_order = HASH_CIPHER;
+			job->cipher_mode = NULL_CIPHER;
+			job->hash_alg = (alg == CRYPTOBENCH_ALG_SHA256) ? PLAIN_SHA_256 : PLAIN_SHA_512;
+			job->msg_len_to_hash_in_bytes = len;
+			job->auth_tag_output = out;
+			job->auth_tag_output_len_in_bytes = (alg == CRYPTOBENCH_ALG_SHA256) ? 32 : 64;
+			break;
+		default:
+			return false;
+		}
+		job = IMB_SUBMIT_JOB(mb_mgr);
+		if (job) {
+			if (job->status != STS_COMPLETED)
+				return false;
+			done++;
+		}
+	}
+	while ((job = IMB_FLUSH_JOB(mb_mgr)) != NULL) {
+		if (job->status != STS_COMPLETED)
+			return false;
+		done++;
+	}
+	return done == n;
+}
+
+static void stress_cryptobench_ipsec_close(stress_cryptobench_backend_t *backend)
+{
+	stress_cryptobench_ipsec_t *ipsec = (stress_cryptobench_ipsec_t *)backend->priv;
+
+	if (ipsec) {
+		free_mb_mgr(ipsec->mb_mgr);
+		free(ipsec);
+		backend->priv = NULL;
+	}
+}
+#endif
+
+static stress_cryptobench_backend_t cryptobench_backends_table[CRYPTOBENCH_BACKEND_MAX] = {
+	{
+		.id = CRYPTOBENCH_BACKEND_USER,
+		.open = stress_cryptobench_user_open,
+		.run = stress_cryptobench_user_run,
+		.close = stress_cryptobench_user_close,
+	},
+#if defined(STRESS_CRYPTOBENCH_AF_ALG)
+	{
+		.id = CRYPTOBENCH_BACKEND_AF_ALG,
+		.open = stress_cryptobench_af_alg_open,
+		.run = stress_cryptobench_af_alg_run,
+		.close = stress_cryptobench_af_alg_close,
+	},
+#else
+	{ .id = CRYPTOBENCH_BACKEND_AF_ALG, .open = NULL },
+#endif
+#if defined(STRESS_CRYPTOBENCH_IPSEC_MB)
+	{
+		.id = CRYPTOBENCH_BACKEND_IPSEC_SSE,
+		.open = stress_cryptobench_ipsec_open,
+		.run = stress_cryptobench_ipsec_run,
+		.close = stress_cryptobench_ipsec_close,
+	},
+	{
+		.id = CRYPTOBENCH_BACKEND_IPSEC_AVX2,
+		.open = stress_cryptobench_ipsec_open,
+		.run = stress_cryptobench_ipsec_run,
+		.close = stress_cryptobench_ipsec_close,
+	},
+	{
+		.id = CRYPTOBENCH_BACKEND_IPSEC_AVX512,
+		.open = stress_cryptobench_ipsec_open,
+		.run = stress_cryptobench_ipsec_run,
+		.close = stress_cryptobench_ipsec_close,
+	},
+#else
+	{ .id = CRYPTOBENCH_BACKEND_IPSEC_SSE, .open = NULL },
+	{ .id = CRYPTOBENCH_BACKEND_IPSEC_AVX2, .open = NULL },
+	{ .id = CRYPTOBENCH_BACKEND_IPSEC_AVX512, .open = NULL },
+#endif
+};
+
+/*
+ *  stress_cryptobench_selftest()
+ *	check the user space baseline against known answers
+ */
+static bool stress_cryptobench_selftest(void)
+{
+	static const uint8_t sha256_abc[32] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+		0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+		0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+	};
+	/* AES-GCM spec test case 2, all zero key, nonce and plaintext */
+	static const uint8_t gcm_tc2[32] = {
+		0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92,
+		0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78,
+		0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd,
+		0xf5, 0x3a, 0x67, 0xb2, 0x12, 0x57, 0xbd, 0xdf,
+	};
+	/* RFC 8439 2.8.2 AEAD tag */
+	static const uint8_t rfc8439_tag[16] = {
+		0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a,
+		0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91,
+	};
+	static const uint8_t rfc8439_aad[12] = {
+		0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3,
+		0xc4, 0xc5, 0xc6, 0xc7,
+	};
+	static const uint8_t rfc8439_nonce[12] = {
+		0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43,
+		0x44, 0x45, 0x46, 0x47,
+	};
+	static const char rfc8439_text[] =
+		"Ladies and Gentlemen of the class of '99: If I could offer you "
+		"only one tip for the future, sunscreen would be it.";
+	uint8_t key[32], iv[CRYPTOBENCH_IV_LEN], out[sizeof(rfc8439_text) + CRYPTOBENCH_TAG_LEN];
+	stress_cb_gcm_t gcm;
+	size_t i;
+
+	stress_cb_sha256((const uint8_t *)"abc", 3, out);
+	if (memcmp(out, sha256_abc, sizeof(sha256_abc)))
+		return false;
+
+	(void)memset(key, 0, sizeof(key));
+	(void)memset(iv, 0, sizeof(iv));
+	stress_cb_gcm_init(&gcm, key);
+	stress_cb_aes_gcm(&gcm, iv, NULL, 0, key, out, 16);
+	if (memcmp(out, gcm_tc2, sizeof(gcm_tc2)))
+		return false;
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (uint8_t)(0x80 + i);
+	stress_cb_chacha20_poly1305(key, rfc8439_nonce, rfc8439_aad, sizeof(rfc8439_aad),
+		(const uint8_t *)rfc8439_text, out, sizeof(rfc8439_text) - 1);
+	return memcmp(out + sizeof(rfc8439_text) - 1, rfc8439_tag, sizeof(rfc8439_tag)) == 0;
+}
+
+/*
+ *  stress_cryptobench_output_len()
+ *	bytes of output to compare for an algorithm and input size
+ */
+static size_t stress_cryptobench_output_len(const int alg, const size_t len)
+{
+	switch (alg) {
+	case CRYPTOBENCH_ALG_SHA256:
+		return 32;
+	case CRYPTOBENCH_ALG_SHA512:
+		return 64;
+	default:
+		return len + CRYPTOBENCH_TAG_LEN;
+	}
+}
+
+/*
+ *  stress_cryptobench_report()
+ *	print a MB/s and cycles per byte table per algorithm and set
+ *	the MB/s at 16 bytes, 1K and 64K and the cycles per byte at
+ *	64K as metrics
+ */
+static void stress_cryptobench_report(const stress_args_t *args, const int alg_sel, const bool has_cycles)
+{
+	size_t idx = 0;
+	int a, b;
+
+	for (a = 0; a < CRYPTOBENCH_ALG_MAX; a++) {
+		size_t s;
+		char line[256];
+		int len;
+
+		if ((alg_sel != CRYPTOBENCH_ALL) && (alg_sel != a))
+			continue;
+
+		if (args->instance == 0) {
+			len = snprintf(line, sizeof(line), "%-17s", cryptobench_algs[a]);
+			for (b = 0; b < CRYPTOBENCH_BACKEND_MAX; b++) {
+				if (cryptobench_backends_table[b].supported[a])
+					len += snprintf(line + len, sizeof(line) - (size_t)len,
+						" %24s", cryptobench_backends[b]);
+			}
+			pr_inf("%s: %s\n", args->name, line);
+			for (s = 0; s < SIZEOF_ARRAY(cryptobench_sizes); s++) {
+				len = snprintf(line, sizeof(line), "%15zd B", cryptobench_sizes[s]);
+				for (b = 0; b < CRYPTOBENCH_BACKEND_MAX; b++) {
+					const stress_cryptobench_result_t *r =
+						&cryptobench_backends_table[b].results[a][s];
+
+					if (!cryptobench_backends_table[b].supported[a])
+						continue;
+					if (r->duration > 0.0) {
+						len += snprintf(line + len, sizeof(line) - (size_t)len,
+							" %9.1f MB/s", (r->bytes / r->duration) / (double)MB);
+						if (has_cycles)
+							len += snprintf(line + len, sizeof(line) - (size_t)len,
+								" %5.1f c/B", r->cycles / r->bytes);
+						else
+							len += snprintf(line + len, sizeof(line) - (size_t)len,
+								"%10s", "");
+					} else {
+						len += snprintf(line + len, sizeof(line) - (size_t)len,
+							" %24s", "-");
+					}
+				}
+				pr_inf("%s: %s\n", args->name, line);
+			}
+		}
+
+		for (b = 0; b < CRYPTOBENCH_BACKEND_MAX; b++) {
+			static const size_t metric_sizes[] = { 0, 3, SIZEOF_ARRAY(cryptobench_sizes) - 1 };
+			const stress_cryptobench_backend_t *backend = &cryptobench_backends_table[b];
+			char str[64];
+
+			if (!backend->supported[a])
+				continue;
+			for (s = 0; s < SIZEOF_ARRAY(metric_sizes); s++) {
+				const stress_cryptobench_result_t *r = &backend->results[a][metric_sizes[s]];
+
+				if ((r->duration <= 0.0) || (idx >= STRESS_MISC_METRICS_MAX))
+					continue;
+				(void)snprintf(str, sizeof(str), "MB per sec %s %s %zdB",
+					cryptobench_backends[b], cryptobench_algs[a],
+					cryptobench_sizes[metric_sizes[s]]);
+				stress_metrics_set(args, idx++, str, (r->bytes / r->duration) / (double)MB);
+			}
+			if (has_cycles && (idx < STRESS_MISC_METRICS_MAX)) {
+				const stress_cryptobench_result_t *r =
+					&backend->results[a][SIZEOF_ARRAY(cryptobench_sizes) - 1];
+
+				if (r->bytes > 0.0) {
+					(void)snprintf(str, sizeof(str), "cycles per byte %s %s %zdB",
+						cryptobench_backends[b], cryptobench_algs[a],
+						cryptobench_sizes[SIZEOF_ARRAY(cryptobench_sizes) - 1]);
+					stress_metrics_set(args, idx++, str, r->cycles / r->bytes);
+				}
+			}
+		}
+	}
+}
+
+/*
+ *  stress_cryptobench()
+ *	benchmark the crypto backends over a range of buffer sizes
+ */
+static int stress_cryptobench(const stress_args_t *args)
+{
+	int alg_sel = CRYPTOBENCH_ALL, backend_sel = CRYPTOBENCH_ALL;
+	int a, b, perf_fd, rc = EXIT_SUCCESS;
+	uint8_t *in, *out, *ref;
+	uint64_t c0;
+	bool any = false, has_cycles;
+	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	const size_t buf_len = CRYPTOBENCH_SIZE_MAX + 64;
+
+	(void)stress_get_setting("cryptobench-alg", &alg_sel);
+	(void)stress_get_setting("cryptobench-backend", &backend_sel);
+
+	stress_cb_aes_init();
+	if (!stress_cryptobench_selftest()) {
+		pr_fail("%s: user space crypto failed its known answer tests\n", args->name);
+		return EXIT_FAILURE;
+	}
+
+	in = (uint8_t *)malloc(buf_len);
+	out = (uint8_t *)malloc(buf_len);
+	ref = (uint8_t *)malloc(buf_len);
+	if (!in || !out || !ref) {
+		pr_inf_skip("%s: cannot allocate buffers, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_bufs;
+	}
+	stress_rndbuf(in, buf_len);
+	stress_rndbuf(cryptobench_key, sizeof(cryptobench_key));
+	stress_rndbuf(cryptobench_iv, sizeof(cryptobench_iv));
+
+	/* the user backend is always opened, it is the verify reference */
+	for (b = 0; b < CRYPTOBENCH_BACKEND_MAX; b++) {
+		stress_cryptobench_backend_t *backend = &cryptobench_backends_table[b];
+
+		(void)memset(backend->supported, 0, sizeof(backend->supported));
+		(void)memset(backend->results, 0, sizeof(backend->results));
+		backend->priv = NULL;
+		if (!backend->open) {
+			if (args->instance == 0)
+				pr_dbg("%s: %s backend not built in\n", args->name, cryptobench_backends[b]);
+			continue;
+		}
+		if ((b != CRYPTOBENCH_BACKEND_USER) && (backend_sel != CRYPTOBENCH_ALL) && (backend_sel != b))
+			continue;
+		if (!backend->open(args, backend)) {
+			if (args->instance == 0)
+				pr_inf("%s: %s backend not available\n", args->name, cryptobench_backends[b]);
+			continue;
+		}
+		if ((backend_sel == CRYPTOBENCH_ALL) || (backend_sel == b))
+			any = true;
+	}
+	if (!any) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s backend not available, skipping stressor\n",
+				args->name, cryptobench_backends[backend_sel]);
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto tidy_backends;
+	}
+
+	/* cross check each backend against the user space baseline */
+	if (verify) {
+		for (b = CRYPTOBENCH_BACKEND_USER + 1; b < CRYPTOBENCH_BACKEND_MAX; b++) {
+			stress_cryptobench_backend_t *backend = &cryptobench_backends_table[b];
+
+			for (a = 0; a < CRYPTOBENCH_ALG_MAX; a++) {
+				static const size_t len = 1000;	/* not a multiple of any block size */
+				const size_t out_len = stress_cryptobench_output_len(a, len);
+
+				if (!backend->supported[a])
+					continue;
+				(void)stress_cryptobench_user_run(&cryptobench_backends_table[CRYPTOBENCH_BACKEND_USER],
+					a, in, ref, len, 1);
+				if (!backend->run(backend, a, in, out, len, 1)) {
+					pr_dbg("%s: %s %s failed, errno=%d (%s), disabling it\n",
+						args->name, cryptobench_backends[b], cryptobench_algs[a],
+						errno, strerror(errno));
+					backend->supported[a] = false;
+					continue;
+				}
+				if (memcmp(ref, out, out_len)) {
+					pr_fail("%s: %s %s output differs from the user space output\n",
+						args->name, cryptobench_backends[b], cryptobench_algs[a]);
+					rc = EXIT_FAILURE;
+				}
+			}
+		}
+	}
+	/* the user backend only runs if it was selected */
+	if ((backend_sel != CRYPTOBENCH_ALL) && (backend_sel != CRYPTOBENCH_BACKEND_USER))
+		(void)memset(cryptobench_backends_table[CRYPTOBENCH_BACKEND_USER].supported, 0,
+			sizeof(cryptobench_backends_table[CRYPTOBENCH_BACKEND_USER].supported));
+
+	perf_fd = stress_perf_cycles_open();
+	has_cycles = stress_perf_cycles_read(perf_fd, &c0);
+	if ((args->instance == 0) && has_cycles && (perf_fd < 0))
+		pr_dbg("%s: CPU cycles counter not available, using the TSC\n", args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (b = 0; b < CRYPTOBENCH_BACKEND_MAX; b++) {
+			stress_cryptobench_backend_t *backend = &cryptobench_backends_table[b];
+
+			for (a = 0; a < CRYPTOBENCH_ALG_MAX; a++) {
+				size_t s;
+
+				if (!backend->supported[a])
+					continue;
+				if ((alg_sel != CRYPTOBENCH_ALL) && (alg_sel != a))
+					continue;
+				for (s = 0; keep_stressing_flag() && (s < SIZEOF_ARRAY(cryptobench_sizes)); s++) {
+					const size_t len = cryptobench_sizes[s];
+					const size_t n = CRYPTOBENCH_ROUND_BYTES / len;
+					stress_cryptobench_result_t *r = &backend->results[a][s];
+					uint64_t c1 = 0;
+					double t;
+
+					(void)stress_perf_cycles_read(perf_fd, &c0);
+					t = stress_time_now();
+					if (!backend->run(backend, a, in, out, len, n)) {
+						pr_dbg("%s: %s %s %zd bytes failed, errno=%d (%s), disabling it\n",
+							args->name, cryptobench_backends[b], cryptobench_algs[a],
+							len, errno, strerror(errno));
+						backend->supported[a] = false;
+						break;
+					}
+					r->duration += stress_time_now() - t;
+					(void)stress_perf_cycles_read(perf_fd, &c1);
+					r->cycles += (double)(c1 - c0);
+					r->bytes += (double)(n * len);
+				}
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_cryptobench_report(args, alg_sel, has_cycles);
+
+	if (perf_fd >= 0)
+		(void)close(perf_fd);
+tidy_backends:
+	for (b = 0; b < CRYPTOBENCH_BACKEND_MAX; b++) {
+		if (cryptobench_backends_table[b].open && cryptobench_backends_table[b].close)
+			cryptobench_backends_table[b].close(&cryptobench_backends_table[b]);
+	}
+tidy_bufs:
+	free(ref);
+	free(out);
+	free(in);
+
+	return rc;
+}
+
+stressor_info_t stress_cryptobench_info = {
+	.stressor = stress_cryptobench,
+	.class = CLASS_CPU | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
@@ -19,12 +19,26 @@
  */
 #include "stress-ng.h"
 #include "core-capabilities.h"
+#include "core-pthread.h"
 
 #define DEFAULT_DELAY_NS	(100000)
 #define MAX_SAMPLES		(100000000)
 #define DEFAULT_SAMPLES		(10000)
 #define MAX_BUCKETS		(250)
 
+#define CYCLIC_LOAD_NONE	(0)	/* no background load */
+#define CYCLIC_LOAD_CPU		(1)	/* floating point compute */
+#define CYCLIC_LOAD_MEMORY	(2)	/* cache and memory thrashing */
+#define CYCLIC_LOAD_SYSCALL	(3)	/* kernel entry and exit */
+#define CYCLIC_LOAD_PI		(4)	/* priority inheritance lock contention */
+
+#define CYCLIC_LOAD_MEMORY_SIZE	(16 * MB)
+#define CYCLIC_PI_HOLD_NS	(100000)	/* pi mutex hold time */
+#define CYCLIC_PI_IDLE_NS	(500000)	/* pi mutex holder idle time */
+#define CYCLIC_PI_HOG_NS	(1000000)	/* medium priority hog run/sleep time */
+#define CYCLIC_POLL_NS		(10000000)	/* per cpu mode bogo op poll time */
+#define CYCLIC_PERCPU_METRICS	(64)		/* max per cpu metrics */
+
 typedef struct {
 	const int	policy;		/* scheduler policy */
 	const char	*name;		/* name of scheduler policy */
@@ -45,6 +59,10 @@ typedef struct {
 	double		latency_mean;	/* average latency */
 	int64_t		latency_mode;	/* first mode */
 	double		std_dev;	/* standard deviation */
+	int32_t		cpu;		/* cpu the samples are taken on, -1 = any */
+	uint64_t	pi_count;	/* number of pi mutex lock waits */
+	double		pi_ns;		/* total pi mutex lock wait */
+	int64_t		pi_max_ns;	/* max pi mutex lock wait */
 } stress_rt_stats_t;
 
 typedef int (*stress_cyclic_func)(const stress_args_t *args, stress_rt_stats_t *rt_stats, uint64_t cyclic_sleep);
@@ -57,8 +75,10 @@ typedef struct {
 static const stress_help_t help[] = {
 	{ NULL,	"cyclic N",		"start N cyclic real time benchmark stressors" },
 	{ NULL,	"cyclic-dist N",	"calculate distribution of interval N nanosecs" },
+	{ NULL,	"cyclic-load L",	"run background load L: none, cpu, memory, syscall or pi" },
 	{ NULL,	"cyclic-method M",	"specify cyclic method M, default is clock_ns" },
 	{ NULL,	"cyclic-ops N",		"stop after N cyclic timing cycles" },
+	{ NULL,	"cyclic-percpu",	"run a cyclic real time thread on each cpu" },
 	{ NULL,	"cyclic-policy P",	"used rr or fifo scheduling policy" },
 	{ NULL,	"cyclic-prio N",	"real time scheduling priority 1..100" },
 	{ NULL, "cyclic-samples N",	"number of latency samples to take" },
@@ -80,6 +100,14 @@ static const stress_policy_t policies[] = {
 
 static const size_t num_policies = SIZEOF_ARRAY(policies);
 
+static const char * const cyclic_loads[] = {
+	"none",		/* CYCLIC_LOAD_NONE */
+	"cpu",		/* CYCLIC_LOAD_CPU */
+	"memory",	/* CYCLIC_LOAD_MEMORY */
+	"syscall",	/* CYCLIC_LOAD_SYSCALL */
+	"pi",		/* CYCLIC_LOAD_PI */
+};
+
 static int stress_set_cyclic_sleep(const char *opt)
 {
 	uint64_t cyclic_sleep;
@@ -108,6 +136,27 @@ static int stress_set_cyclic_policy(const char *opt)
 	return -1;
 }
 
+static int stress_set_cyclic_load(const char *opt)
+{
+	size_t load;
+
+	for (load = 0; load < SIZEOF_ARRAY(cyclic_loads); load++) {
+		if (!strcmp(opt, cyclic_loads[load]))
+			return stress_set_setting("cyclic-load", TYPE_ID_SIZE_T, &load);
+	}
+	(void)fprintf(stderr, "invalid cyclic-load '%s', loads allowed are:", opt);
+	for (load = 0; load < SIZEOF_ARRAY(cyclic_loads); load++) {
+		(void)fprintf(stderr, " %s", cyclic_loads[load]);
+	}
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_cyclic_percpu(const char *opt)
+{
+	return stress_set_setting_true("cyclic-percpu", opt);
+}
+
 static int stress_set_cyclic_prio(const char *opt)
 {
 	int32_t cyclic_prio;
@@ -609,6 +658,452 @@ static void stress_rt_dist(
 	free(dist);
 }
 
+/*
+ *  stress_cyclic_cpus()
+ *	get the cpus this process may run on, returns the number
+ *	of cpus, if the affinity is not known a single unpinned
+ *	cpu -1 is returned
+ */
+static size_t stress_cyclic_cpus(int32_t **cpus)
+{
+	size_t n = 0;
+#if defined(HAVE_SCHED_GETAFFINITY)
+	cpu_set_t mask;
+	int cpu;
+
+	CPU_ZERO(&mask);
+	if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+		n = (size_t)CPU_COUNT(&mask);
+	if (n > 0) {
+		*cpus = (int32_t *)calloc(n, sizeof(**cpus));
+		if (!*cpus)
+			return 0;
+		for (n = 0, cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &mask))
+				(*cpus)[n++] = (int32_t)cpu;
+		}
+		return n;
+	}
+#endif
+	*cpus = (int32_t *)calloc(1, sizeof(**cpus));
+	if (!*cpus)
+		return 0;
+	(*cpus)[0] = -1;
+	return 1;
+}
+
+/*
+ *  stress_cyclic_pin()
+ *	pin the calling thread to a cpu, -1 leaves it unpinned
+ */
+static void stress_cyclic_pin(const int32_t cpu)
+{
+#if defined(HAVE_SCHED_SETAFFINITY)
+	cpu_set_t mask;
+
+	if (cpu < 0)
+		return;
+	CPU_ZERO(&mask);
+	CPU_SET((int)cpu, &mask);
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+#else
+	(void)cpu;
+#endif
+}
+
+/*
+ *  stress_cyclic_spin()
+ *	busy wait for ns nanoseconds
+ */
+static void stress_cyclic_spin(const uint64_t ns)
+{
+	const double end = stress_time_now() + ((double)ns / STRESS_DBL_NANOSECOND);
+
+	while (stress_time_now() < end)
+		;
+}
+
+/*
+ *  stress_cyclic_load()
+ *	background interference load process, runs on a cpu
+ *	with the default scheduler policy until it is killed
+ */
+static void NORETURN stress_cyclic_load(const size_t load, const int32_t cpu)
+{
+	uint8_t *buf = MAP_FAILED;
+	volatile double x = 1.0;
+	volatile uint64_t sum = 0;
+
+	stress_parent_died_alarm();
+	stress_cyclic_pin(cpu);
+
+	if (load == CYCLIC_LOAD_MEMORY)
+		buf = (uint8_t *)mmap(NULL, CYCLIC_LOAD_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	while (keep_stressing_flag()) {
+		size_t i;
+
+		switch (load) {
+		case CYCLIC_LOAD_MEMORY:
+			if (buf == MAP_FAILED)
+				goto cpu;
+			(void)memset(buf, (int)sum, CYCLIC_LOAD_MEMORY_SIZE);
+			for (i = 0; i < CYCLIC_LOAD_MEMORY_SIZE; i += 64)
+				sum += buf[i];
+			break;
+		case CYCLIC_LOAD_SYSCALL:
+			for (i = 0; i < 1000; i++) {
+				(void)getppid();
+				(void)shim_sched_yield();
+			}
+			break;
+		default:
+cpu:
+			for (i = 0; i < 100000; i++)
+				x = sqrt(x + (double)i);
+			break;
+		}
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_cyclic_loads_start()
+ *	start a background load process on each cpu
+ */
+static void stress_cyclic_loads_start(
+	const stress_args_t *args,
+	const size_t load,
+	const int32_t *cpus,
+	pid_t *pids,
+	const size_t n_cpus)
+{
+	size_t i;
+
+	for (i = 0; i < n_cpus; i++) {
+		pids[i] = -1;
+		if (!keep_stressing_flag())
+			break;
+
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			pr_inf("%s: cannot fork %s load process, errno=%d (%s)\n",
+				args->name, cyclic_loads[load], errno, strerror(errno));
+		} else if (pids[i] == 0) {
+			stress_cyclic_load(load, cpus[i]);
+		}
+	}
+}
+
+/*
+ *  stress_cyclic_loads_stop()
+ *	kill and reap the background load processes
+ */
+static void stress_cyclic_loads_stop(pid_t *pids, const size_t n_cpus)
+{
+	size_t i;
+
+	for (i = 0; i < n_cpus; i++) {
+		int status;
+
+		if (pids[i] <= 0)
+			continue;
+		(void)kill(pids[i], SIGKILL);
+		(void)shim_waitpid(pids[i], &status, 0);
+		pids[i] = -1;
+	}
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  Per cpu cyclic threads and the priority inversion load,
+ *  each worker thread takes latency samples on one cpu. With
+ *  the pi load each worker has a SCHED_OTHER thread on the same
+ *  cpu that periodically holds a mutex that the worker takes
+ *  after each sample and a medium real time priority hog that
+ *  starves the holder unless the mutex boosts it by priority
+ *  inheritance
+ */
+typedef struct {
+	const stress_args_t *args;
+	stress_rt_stats_t *rt_stats;	/* samples of this worker */
+	stress_cyclic_func func;	/* cyclic method */
+	uint64_t cyclic_sleep;		/* cyclic sleep time */
+	volatile bool *stop;		/* set to stop all threads */
+	bool pi;			/* true for pi load */
+	int hog_prio;			/* SCHED_FIFO priority of the hog */
+	pthread_mutex_t pi_mutex;	/* pi mutex */
+	pthread_t pthread;		/* worker thread */
+	pthread_t pi_holder;		/* pi mutex holder thread */
+	pthread_t pi_hog;		/* medium priority hog thread */
+	int ret;			/* worker pthread_create return */
+	int pi_holder_ret;		/* holder pthread_create return */
+	int pi_hog_ret;			/* hog pthread_create return */
+} stress_cyclic_worker_t;
+
+/*
+ *  stress_cyclic_worker()
+ *	take latency samples on one cpu until stopped
+ */
+static void *stress_cyclic_worker(void *arg)
+{
+	static void *nowt = NULL;
+	stress_cyclic_worker_t *w = (stress_cyclic_worker_t *)arg;
+	stress_rt_stats_t *rt_stats = w->rt_stats;
+
+	stress_cyclic_pin(rt_stats->cpu);
+	while (!*w->stop) {
+		w->func(w->args, rt_stats, w->cyclic_sleep);
+		if (w->pi) {
+			struct timespec t1, t2;
+			int64_t delta_ns;
+
+			(void)clock_gettime(CLOCK_REALTIME, &t1);
+			(void)pthread_mutex_lock(&w->pi_mutex);
+			(void)clock_gettime(CLOCK_REALTIME, &t2);
+			(void)pthread_mutex_unlock(&w->pi_mutex);
+
+			delta_ns = ((int64_t)(t2.tv_sec - t1.tv_sec) * STRESS_NANOSECOND) +
+				   (t2.tv_nsec - t1.tv_nsec);
+			rt_stats->pi_count++;
+			rt_stats->pi_ns += (double)delta_ns;
+			if (delta_ns > rt_stats->pi_max_ns)
+				rt_stats->pi_max_ns = delta_ns;
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_cyclic_pi_holder()
+ *	SCHED_OTHER thread that periodically holds the pi mutex
+ */
+static void *stress_cyclic_pi_holder(void *arg)
+{
+	static void *nowt = NULL;
+	stress_cyclic_worker_t *w = (stress_cyclic_worker_t *)arg;
+	struct sched_param param;
+
+	stress_cyclic_pin(w->rt_stats->cpu);
+	(void)memset(&param, 0, sizeof(param));
+	(void)pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+	while (!*w->stop) {
+		(void)pthread_mutex_lock(&w->pi_mutex);
+		stress_cyclic_spin(CYCLIC_PI_HOLD_NS);
+		(void)pthread_mutex_unlock(&w->pi_mutex);
+		(void)shim_nanosleep_uint64(CYCLIC_PI_IDLE_NS);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_cyclic_pi_hog()
+ *	medium priority thread that runs and sleeps on the cpu
+ *	of the worker to starve the pi mutex holder
+ */
+static void *stress_cyclic_pi_hog(void *arg)
+{
+	static void *nowt = NULL;
+	stress_cyclic_worker_t *w = (stress_cyclic_worker_t *)arg;
+#if defined(SCHED_FIFO)
+	struct sched_param param;
+
+	stress_cyclic_pin(w->rt_stats->cpu);
+	(void)memset(&param, 0, sizeof(param));
+	param.sched_priority = w->hog_prio;
+	/* never hog at the inherited worker priority */
+	if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+		return &nowt;
+
+	while (!*w->stop) {
+		stress_cyclic_spin(CYCLIC_PI_HOG_NS);
+		(void)shim_nanosleep_uint64(CYCLIC_PI_HOG_NS);
+	}
+#else
+	(void)w;
+#endif
+	return &nowt;
+}
+
+/*
+ *  stress_cyclic_workers()
+ *	run a cyclic worker thread for each of the n rt_stats,
+ *	the bogo op counter is the total number of samples
+ */
+static int stress_cyclic_workers(
+	const stress_args_t *args,
+	stress_rt_stats_t *rt_stats,
+	const size_t n,
+	const stress_cyclic_func func,
+	const uint64_t cyclic_sleep,
+	const bool pi,
+	const double start,
+	const uint64_t timeout)
+{
+	stress_cyclic_worker_t *workers;
+	volatile bool stop = false;
+	size_t i, started = 0;
+	int hog_prio = 0;
+
+	workers = (stress_cyclic_worker_t *)calloc(n, sizeof(*workers));
+	if (!workers) {
+		pr_inf("%s: cannot allocate %zd cyclic thread information elements\n",
+			args->name, n);
+		return EXIT_NO_RESOURCE;
+	}
+
+#if defined(SCHED_FIFO) &&	\
+    defined(HAVE_SCHED_GET_PRIORITY_MIN) &&	\
+    defined(HAVE_SCHED_GET_PRIORITY_MAX)
+	{
+		const int min_prio = sched_get_priority_min(SCHED_FIFO);
+		const int max_prio = sched_get_priority_max(SCHED_FIFO);
+
+		/* just below the worker priority */
+		hog_prio = (rt_stats->max_prio > 0) ? rt_stats->max_prio - 1 : max_prio - 1;
+		if (hog_prio < min_prio)
+			hog_prio = min_prio;
+	}
+#endif
+
+	for (i = 0; i < n; i++) {
+		stress_cyclic_worker_t *w = &workers[i];
+
+		w->args = args;
+		w->rt_stats = &rt_stats[i];
+		w->func = func;
+		w->cyclic_sleep = cyclic_sleep;
+		w->stop = &stop;
+		w->pi = pi;
+		w->hog_prio = hog_prio;
+		w->ret = -1;
+		w->pi_holder_ret = -1;
+		w->pi_hog_ret = -1;
+
+		if (pi) {
+			pthread_mutexattr_t attr;
+
+			(void)pthread_mutexattr_init(&attr);
+#if defined(HAVE_PTHREAD_MUTEXATTR_SETPROTOCOL)
+			VOID_RET(int, pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT));
+#endif
+			(void)pthread_mutex_init(&w->pi_mutex, &attr);
+			(void)pthread_mutexattr_destroy(&attr);
+
+			w->pi_holder_ret = pthread_create(&w->pi_holder, NULL, stress_cyclic_pi_holder, (void *)w);
+			w->pi_hog_ret = pthread_create(&w->pi_hog, NULL, stress_cyclic_pi_hog, (void *)w);
+		}
+		w->ret = pthread_create(&w->pthread, NULL, stress_cyclic_worker, (void *)w);
+		if (w->ret) {
+			pr_inf("%s: pthread create failed for cpu %" PRId32 ", errno=%d (%s)\n",
+				args->name, rt_stats[i].cpu, w->ret, strerror(w->ret));
+		} else {
+			started++;
+		}
+	}
+
+	while (started) {
+		uint64_t total = 0;
+
+		(void)shim_nanosleep_uint64(CYCLIC_POLL_NS);
+		for (i = 0; i < n; i++)
+			total += (uint64_t)rt_stats[i].index_reqd;
+		set_counter(args, total);
+
+		/* Ensure we NEVER spin forever */
+		if ((stress_time_now() - start) > (double)timeout)
+			break;
+		if (!keep_stressing(args))
+			break;
+	}
+
+	stop = true;
+	for (i = 0; i < n; i++) {
+		stress_cyclic_worker_t *w = &workers[i];
+
+		if (w->ret == 0)
+			(void)pthread_join(w->pthread, NULL);
+		if (w->pi_holder_ret == 0)
+			(void)pthread_join(w->pi_holder, NULL);
+		if (w->pi_hog_ret == 0)
+			(void)pthread_join(w->pi_hog, NULL);
+		if (pi)
+			(void)pthread_mutex_destroy(&w->pi_mutex);
+	}
+	free(workers);
+
+	return started ? EXIT_SUCCESS : EXIT_NO_RESOURCE;
+}
+#endif
+
+/*
+ *  stress_cyclic_percpu_report()
+ *	report the per cpu latencies and add them as metrics
+ */
+static void stress_cyclic_percpu_report(
+	const stress_args_t *args,
+	stress_rt_stats_t *rt_stats,
+	const size_t n,
+	const char *policy_name,
+	const uint64_t cyclic_sleep,
+	const bool pi)
+{
+	size_t i, idx = 0;
+	int64_t max_ns = INT64_MIN;
+	double mean = 0.0;
+	size_t samples = 0;
+	char desc[64];
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: sched %s: %" PRIu64 " ns delay, per cpu latencies (ns):\n",
+			args->name, policy_name, cyclic_sleep);
+		pr_inf("%s: %4s %10s %10s %12s %10s %10s%s\n", args->name,
+			"cpu", "samples", "min", "mean", "99%", "max",
+			pi ? "     pi max" : "");
+	}
+
+	for (i = 0; i < n; i++) {
+		const stress_rt_stats_t *rts = &rt_stats[i];
+		const size_t j = (size_t)(((double)rts->index * 99.0) / 100.0);
+
+		if (!rts->index)
+			continue;
+		if (rts->max_ns > max_ns)
+			max_ns = rts->max_ns;
+		mean += rts->latency_mean * (double)rts->index;
+		samples += rts->index;
+
+		if (args->instance == 0) {
+			char pi_str[16];
+
+			if (pi)
+				(void)snprintf(pi_str, sizeof(pi_str), " %10" PRId64, rts->pi_max_ns);
+			else
+				*pi_str = '\0';
+			pr_inf("%s: %4" PRId32 " %10zd %10" PRId64 " %12.2f %10" PRId64 " %10" PRId64 "%s\n",
+				args->name, rts->cpu, rts->index, rts->min_ns,
+				rts->latency_mean, rts->latencies[j], rts->max_ns, pi_str);
+		}
+		if (idx < CYCLIC_PERCPU_METRICS) {
+			(void)snprintf(desc, sizeof(desc), "cpu %" PRId32 " max latency (ns)", rts->cpu);
+			stress_metrics_set(args, 2 + idx++, desc, (double)rts->max_ns);
+		}
+	}
+
+	if (args->instance == 0) {
+		if (!samples)
+			pr_inf("%s: no latency information available\n", args->name);
+		pr_unlock();
+	}
+	if (samples) {
+		stress_metrics_set(args, 0, "mean latency (ns)", mean / (double)samples);
+		stress_metrics_set(args, 1, "max latency (ns)", (double)max_ns);
+	}
+}
+
 /*
  *  stress_cyclic_supported()
  *      check if we can run this as root
@@ -638,10 +1133,15 @@ static int stress_cyclic(const stress_args_t *args)
 	size_t cyclic_samples = DEFAULT_SAMPLES;
 	int policy, rc = EXIT_SUCCESS;
 	size_t cyclic_policy = 0;
+	size_t cyclic_load = CYCLIC_LOAD_NONE;
+	bool cyclic_percpu = false;
 	const double start = stress_time_now();
 	stress_rt_stats_t *rt_stats;
 	const size_t page_size = args->page_size;
-	const size_t size = (sizeof(*rt_stats) + page_size - 1) & (~(page_size - 1));
+	size_t size, i, n_cpus, n_stats;
+	int32_t *cpus = NULL;
+	pid_t *load_pids = NULL;
+	bool threaded;
 	stress_cyclic_func func;
 #if defined(MAP_POPULATE)
 	const int mmap_flags = MAP_SHARED | MAP_ANONYMOUS | MAP_POPULATE;
@@ -651,7 +1151,9 @@ static int stress_cyclic(const stress_args_t *args)
 
 	timeout  = g_opt_timeout;
 	(void)stress_get_setting("cyclic-dist", &cyclic_dist);
+	(void)stress_get_setting("cyclic-load", &cyclic_load);
 	(void)stress_get_setting("cyclic-method", &cyclic_method);
+	(void)stress_get_setting("cyclic-percpu", &cyclic_percpu);
 	(void)stress_get_setting("cyclic-policy", &cyclic_policy);
 	(void)stress_get_setting("cyclic-prio", &cyclic_prio);
 	(void)stress_get_setting("cyclic-samples", &cyclic_samples);
@@ -680,26 +1182,61 @@ static int stress_cyclic(const stress_args_t *args)
 			"this stressor\n", args->name);
 	}
 
+#if !defined(HAVE_LIB_PTHREAD)
+	if ((cyclic_percpu || (cyclic_load == CYCLIC_LOAD_PI)) && (args->instance == 0)) {
+		pr_inf("%s: pthreads not supported, ignoring --cyclic-percpu "
+			"and --cyclic-load pi\n", args->name);
+	}
+	cyclic_percpu = false;
+	if (cyclic_load == CYCLIC_LOAD_PI)
+		cyclic_load = CYCLIC_LOAD_NONE;
+#endif
+	threaded = cyclic_percpu || (cyclic_load == CYCLIC_LOAD_PI);
+	if (threaded && !strcmp(cyclic_method->name, "itimer")) {
+		/* the itimer handler time is per process, not per thread */
+		if (args->instance == 0)
+			pr_inf("%s: itimer method cannot be used with cyclic threads, "
+				"using %s\n", args->name, cyclic_methods[0].name);
+		cyclic_method = &cyclic_methods[0];
+		func = cyclic_method->func;
+	}
+
+	n_cpus = stress_cyclic_cpus(&cpus);
+	if (!n_cpus) {
+		pr_inf_skip("%s: cannot allocate cpu list, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	n_stats = cyclic_percpu ? n_cpus : 1;
+	size = ((sizeof(*rt_stats) * n_stats) + page_size - 1) & (~(page_size - 1));
+
 	rt_stats = (stress_rt_stats_t *)mmap(NULL, size,
 						PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
 	if (rt_stats == MAP_FAILED) {
 		pr_inf_skip("%s: mmap of shared statistics data failed: %d (%s)\n",
 			args->name, errno, strerror(errno));
+		free(cpus);
 		return EXIT_NO_RESOURCE;
 	}
-	rt_stats->cyclic_samples = cyclic_samples;
-	rt_stats->latencies_size = cyclic_samples * sizeof(*rt_stats->latencies);
-	rt_stats->latencies = (int64_t *)mmap(NULL, rt_stats->latencies_size,
+	for (i = 0; i < n_stats; i++) {
+		rt_stats[i].cyclic_samples = cyclic_samples;
+		rt_stats[i].latencies_size = cyclic_samples * sizeof(*rt_stats->latencies);
+		rt_stats[i].latencies = (int64_t *)mmap(NULL, rt_stats[i].latencies_size,
 						PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
-	if (rt_stats->latencies == MAP_FAILED) {
-		pr_inf_skip("%s: mmap of %zd samples failed: %d (%s)\n",
-			args->name, cyclic_samples, errno, strerror(errno));
-		(void)munmap((void *)rt_stats, size);
-		return EXIT_NO_RESOURCE;
+		if (rt_stats[i].latencies == MAP_FAILED) {
+			pr_inf_skip("%s: mmap of %zd samples failed: %d (%s)\n",
+				args->name, cyclic_samples, errno, strerror(errno));
+			while (i-- > 0)
+				(void)munmap((void *)rt_stats[i].latencies, rt_stats[i].latencies_size);
+			(void)munmap((void *)rt_stats, size);
+			free(cpus);
+			return EXIT_NO_RESOURCE;
+		}
+		rt_stats[i].min_ns = INT64_MAX;
+		rt_stats[i].max_ns = INT64_MIN;
+		rt_stats[i].ns = 0.0;
+		/* the pi load needs the worker on the same cpu as the holder */
+		rt_stats[i].cpu = threaded ? cpus[i] : -1;
 	}
-	rt_stats->min_ns = INT64_MAX;
-	rt_stats->max_ns = INT64_MIN;
-	rt_stats->ns = 0.0;
 #if defined(HAVE_SCHED_GET_PRIORITY_MIN)
 	rt_stats->min_prio = sched_get_priority_min(policy);
 #else
@@ -718,9 +1255,20 @@ static int stress_cyclic(const stress_args_t *args)
 		}
 	}
 
+	for (i = 1; i < n_stats; i++) {
+		rt_stats[i].min_prio = rt_stats->min_prio;
+		rt_stats[i].max_prio = rt_stats->max_prio;
+	}
+
 	if (args->instance == 0)
 		pr_dbg("%s: using method '%s'\n", args->name, cyclic_method->name);
 
+	if (cyclic_load != CYCLIC_LOAD_NONE) {
+		load_pids = (pid_t *)calloc(n_cpus, sizeof(*load_pids));
+		if (load_pids && (cyclic_load != CYCLIC_LOAD_PI))
+			stress_cyclic_loads_start(args, cyclic_load, cpus, load_pids, n_cpus);
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 again:
@@ -732,7 +1280,8 @@ again:
 			goto finish;
 		pr_inf("%s: cannot fork, errno=%d (%s)\n",
 			args->name, errno, strerror(errno));
-		return EXIT_NO_RESOURCE;
+		rc = EXIT_NO_RESOURCE;
+		goto finish;
 	} else if (pid == 0) {
 #if defined(HAVE_SCHED_GET_PRIORITY_MIN) &&	\
     defined(HAVE_SCHED_GET_PRIORITY_MAX)
@@ -764,8 +1313,8 @@ again:
 		 * terminated with a SIGKILL and we can
 		 * catch that with the parent
 		 */
-		rlim.rlim_cur = timeout;
-		rlim.rlim_max = timeout;
+		rlim.rlim_cur = timeout * (threaded ? (n_stats * 3) : 1);
+		rlim.rlim_max = rlim.rlim_cur;
 		(void)setrlimit(RLIMIT_CPU, &rlim);
 
 #if defined(RLIMIT_RTTIME)
@@ -829,6 +1378,13 @@ redo_policy:
 			}
 			goto tidy;
 		}
+#endif
+#if defined(HAVE_LIB_PTHREAD)
+		if (threaded) {
+			ncrc = stress_cyclic_workers(args, rt_stats, n_stats, func, cyclic_sleep,
+				cyclic_load == CYCLIC_LOAD_PI, start, timeout);
+			goto tidy;
+		}
 #endif
 		do {
 			func(args, rt_stats, cyclic_sleep);
@@ -858,9 +1414,14 @@ tidy:
 		(void)shim_waitpid(pid, &status, 0);
 	}
 
-	stress_rt_stats(rt_stats);
+	for (i = 0; i < n_stats; i++)
+		stress_rt_stats(&rt_stats[i]);
 
-	if (args->instance == 0) {
+	if (cyclic_percpu) {
+		stress_cyclic_percpu_report(args, rt_stats, n_stats,
+			policies[cyclic_policy].name, cyclic_sleep,
+			cyclic_load == CYCLIC_LOAD_PI);
+	} else if (args->instance == 0) {
 		if (rt_stats->index) {
 			size_t i;
 
@@ -901,6 +1462,11 @@ tidy:
 			}
 			stress_rt_dist(args->name, rt_stats, (int64_t)cyclic_dist);
 
+			if (rt_stats->pi_count)
+				pr_inf("%s: pi mutex lock wait: mean: %.2f ns, max: %" PRId64 " ns\n",
+					args->name,
+					rt_stats->pi_ns / (double)rt_stats->pi_count,
+					rt_stats->pi_max_ns);
 			if (rt_stats->index < rt_stats->index_reqd)
 				pr_inf("%s: Note: --cyclic-samples needed to be %zd to capture all the data for this run\n",
 					args->name, rt_stats->index_reqd);
@@ -915,15 +1481,23 @@ tidy:
 finish:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
-	(void)munmap((void *)rt_stats->latencies, rt_stats->latencies_size);
+	if (load_pids) {
+		stress_cyclic_loads_stop(load_pids, n_cpus);
+		free(load_pids);
+	}
+	for (i = 0; i < n_stats; i++)
+		(void)munmap((void *)rt_stats[i].latencies, rt_stats[i].latencies_size);
 	(void)munmap((void *)rt_stats, size);
+	free(cpus);
 
 	return rc;
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cyclic_dist,	stress_set_cyclic_dist },
+	{ OPT_cyclic_load,	stress_set_cyclic_load },
 	{ OPT_cyclic_method,	stress_set_cyclic_method },
+	{ OPT_cyclic_percpu,	stress_set_cyclic_percpu },
 	{ OPT_cyclic_policy,	stress_set_cyclic_policy },
 	{ OPT_cyclic_prio, 	stress_set_cyclic_prio },
 	{ OPT_cyclic_sleep,	stress_set_cyclic_sleep },
@@ -18,13 +18,25 @@
  *
  */
 #include "stress-ng.h"
+#include "core-memfs-bench.h"
 
 static const stress_help_t help[] = {
 	{ NULL,	"dev-shm N",	"start N /dev/shm file and mmap stressors" },
+	{ NULL,	"dev-shm-bench","measure /dev/shm bandwidth and fault rates" },
 	{ NULL,	"dev-shm-ops N","stop after N /dev/shm bogo ops" },
 	{ NULL,	NULL,		NULL }
 };
 
+static int stress_set_dev_shm_bench(const char *opt)
+{
+	return stress_set_setting_true("dev-shm-bench", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_dev_shm_bench,	stress_set_dev_shm_bench },
+	{ 0,			NULL }
+};
+
 #if defined(__linux__)
 
 typedef struct {
@@ -165,6 +177,36 @@ finish:
 	return rc;
 }
 
+/*
+ *  stress_dev_shm_bench()
+ *	measure the read, write, page fault and mmap bandwidth of
+ *	a /dev/shm file
+ */
+static int stress_dev_shm_bench(const stress_args_t *args, const int fd)
+{
+	stress_memfs_bench_t bench;
+	const size_t size = stress_memfs_bench_size(args);
+	char option[32];
+
+	(void)memset(&bench, 0, sizeof(bench));
+	stress_memfs_huge_option("/dev/shm", option, sizeof(option));
+	(void)snprintf(bench.label, sizeof(bench.label), "/dev/shm (%s)",
+		*option ? option : "not tmpfs");
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		bench.err = stress_memfs_bench_fd(args, fd, size, &bench);
+		inc_counter(args);
+	} while (!bench.err && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_memfs_bench_report(args, &bench, 1);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_dev_shm()
  *	stress /dev/shm
@@ -174,6 +216,9 @@ static int stress_dev_shm(const stress_args_t *args)
 	int rc = EXIT_SUCCESS;
 	char path[PATH_MAX];
 	stress_dev_shm_context_t context;
+	bool dev_shm_bench = false;
+
+	(void)stress_get_setting("dev-shm-bench", &dev_shm_bench);
 
 	/*
 	 *  Sanity check for existence and r/w permissions
@@ -205,6 +250,12 @@ static int stress_dev_shm(const stress_args_t *args)
 	}
 	(void)shim_unlink(path);
 
+	if (dev_shm_bench) {
+		rc = stress_dev_shm_bench(args, context.fd);
+		(void)close(context.fd);
+		return rc;
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	rc = stress_oomable_child(args, &context, stress_dev_shm_oomable_child, STRESS_OOMABLE_NORMAL);
@@ -218,12 +269,14 @@ static int stress_dev_shm(const stress_args_t *args)
 stressor_info_t stress_dev_shm_info = {
 	.stressor = stress_dev_shm,
 	.class = CLASS_VM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_dev_shm_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_VM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "only supported on Linux"
 };
@@ -22,10 +22,23 @@
 #define MIN_DIRMANY_BYTES     (0)
 #define MAX_DIRMANY_BYTES     (MAX_FILE_LIMIT)
 
+#define MIN_DIRMANY_THREADS	(1)
+#define MAX_DIRMANY_THREADS	(64)
+#define DEFAULT_DIRMANY_THREADS	(4)
+
+#define MIN_DIRMANY_MAX		(1024)
+#define MAX_DIRMANY_MAX		(16 * 1024 * 1024)
+#define DEFAULT_DIRMANY_MAX	(64 * 1024)
+
+#define DIRMANY_MD_SIZES	(12)	/* 1K .. 16M entries in steps of x4 */
+
 static const stress_help_t help[] = {
 	{ NULL,	"dirmany N",		"start N directory file populating stressors" },
 	{ NULL, "dirmany-filsize" ,	"specify size of files (default 0" },
+	{ NULL,	"dirmany-max N",	"largest directory size of the metadata benchmark" },
+	{ NULL,	"dirmany-mdtest",	"create, stat, unlink benchmark over directory sizes" },
 	{ NULL,	"dirmany-ops N",	"stop after N directory file bogo operations" },
+	{ NULL,	"dirmany-threads N",	"threads per instance in the metadata benchmark" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -43,6 +56,43 @@ static int stress_set_dirmany_bytes(const char *opt)
 	return stress_set_setting("dirmany-bytes", TYPE_ID_OFF_T, &dirmany_bytes);
 }
 
+/*
+ *  stress_set_dirmany_mdtest()
+ *      enable the metadata benchmark mode
+ */
+static int stress_set_dirmany_mdtest(const char *opt)
+{
+	return stress_set_setting_true("dirmany-mdtest", opt);
+}
+
+/*
+ *  stress_set_dirmany_threads()
+ *      set number of threads of the metadata benchmark
+ */
+static int stress_set_dirmany_threads(const char *opt)
+{
+	uint32_t dirmany_threads;
+
+	dirmany_threads = stress_get_uint32(opt);
+	stress_check_range("dirmany-threads", (uint64_t)dirmany_threads,
+		MIN_DIRMANY_THREADS, MAX_DIRMANY_THREADS);
+	return stress_set_setting("dirmany-threads", TYPE_ID_UINT32, &dirmany_threads);
+}
+
+/*
+ *  stress_set_dirmany_max()
+ *      set largest directory size of the metadata benchmark
+ */
+static int stress_set_dirmany_max(const char *opt)
+{
+	uint64_t dirmany_max;
+
+	dirmany_max = stress_get_uint64(opt);
+	stress_check_range("dirmany-max", dirmany_max,
+		MIN_DIRMANY_MAX, MAX_DIRMANY_MAX);
+	return stress_set_setting("dirmany-max", TYPE_ID_UINT64, &dirmany_max);
+}
+
 static void stress_dirmany_filename(
 	const char *pathname,
 	const size_t pathname_len,
@@ -146,6 +196,247 @@ static void stress_dirmany_remove(
 	*remove_time += (stress_time_now() - t_now);
 }
 
+typedef enum {
+	DIRMANY_MD_CREATE = 0,
+	DIRMANY_MD_STAT,
+	DIRMANY_MD_UNLINK,
+	DIRMANY_MD_OPS,
+} stress_dirmany_md_op_t;
+
+static const char * const dirmany_md_op_names[DIRMANY_MD_OPS] = {
+	"create", "stat", "unlink",
+};
+
+/* per thread state of a metadata benchmark phase */
+typedef struct {
+	const char *pathname;		/* stressor temporary directory */
+	stress_dirmany_md_op_t op;	/* phase operation */
+	uint32_t thread;		/* thread number */
+	bool private_dir;		/* thread uses its own sub-directory */
+	uint64_t files;			/* files handled by this thread */
+	uint64_t done;			/* files successfully handled */
+} stress_dirmany_md_t;
+
+/*
+ *  stress_dirmany_md_filename()
+ *	name of file n of a thread, in a shared directory the thread
+ *	number makes the name unique
+ */
+static void stress_dirmany_md_filename(
+	const stress_dirmany_md_t *md,
+	const uint64_t n,
+	char *filename,
+	const size_t filename_sz)
+{
+	if (md->private_dir)
+		(void)snprintf(filename, filename_sz, "%s/t%" PRIu32 "/f%" PRIx64,
+			md->pathname, md->thread, n);
+	else
+		(void)snprintf(filename, filename_sz, "%s/t%" PRIu32 "-f%" PRIx64,
+			md->pathname, md->thread, n);
+}
+
+/*
+ *  stress_dirmany_md_worker()
+ *	create, stat or unlink the files of one thread
+ */
+static void *stress_dirmany_md_worker(void *arg)
+{
+	static void *nowt = NULL;
+	stress_dirmany_md_t *md = (stress_dirmany_md_t *)arg;
+	uint64_t i;
+
+	md->done = 0;
+	for (i = 0; i < md->files; i++) {
+		char filename[PATH_MAX + 40];
+		struct stat statbuf;
+		int fd;
+
+		/* always unlink all the files so none are left behind */
+		if (UNLIKELY((md->op != DIRMANY_MD_UNLINK) &&
+			     ((i & 0x3ff) == 0) && !keep_stressing_flag()))
+			break;
+		stress_dirmany_md_filename(md, i, filename, sizeof(filename));
+		switch (md->op) {
+		case DIRMANY_MD_CREATE:
+			fd = open(filename, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR);
+			if (fd < 0)
+				return &nowt;
+			(void)close(fd);
+			break;
+		case DIRMANY_MD_STAT:
+			if (stat(filename, &statbuf) < 0)
+				continue;
+			break;
+		default:
+		case DIRMANY_MD_UNLINK:
+			if (shim_unlink(filename) < 0)
+				continue;
+			break;
+		}
+		md->done++;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_dirmany_md_phase()
+ *	run one operation over all the files with n_threads threads,
+ *	returns the number of files handled and the phase duration
+ */
+static uint64_t stress_dirmany_md_phase(
+	stress_dirmany_md_t *mds,
+	const uint32_t n_threads,
+	const stress_dirmany_md_op_t op,
+	double *duration)
+{
+	uint64_t done = 0;
+	uint32_t i;
+	double t;
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t pthreads[MAX_DIRMANY_THREADS];
+	bool started[MAX_DIRMANY_THREADS];
+#endif
+
+	for (i = 0; i < n_threads; i++)
+		mds[i].op = op;
+
+	t = stress_time_now();
+#if defined(HAVE_LIB_PTHREAD)
+	for (i = 1; i < n_threads; i++)
+		started[i] = (pthread_create(&pthreads[i], NULL,
+			stress_dirmany_md_worker, (void *)&mds[i]) == 0);
+	/* the calling thread is thread 0 */
+	(void)stress_dirmany_md_worker((void *)&mds[0]);
+	for (i = 1; i < n_threads; i++) {
+		if (started[i])
+			(void)pthread_join(pthreads[i], NULL);
+		else
+			(void)stress_dirmany_md_worker((void *)&mds[i]);
+	}
+#else
+	for (i = 0; i < n_threads; i++)
+		(void)stress_dirmany_md_worker((void *)&mds[i]);
+#endif
+	*duration = stress_time_now() - t;
+
+	for (i = 0; i < n_threads; i++)
+		done += mds[i].done;
+	return done;
+}
+
+/*
+ *  stress_dirmany_mdtest()
+ *	mdtest like metadata benchmark, n threads create, stat and
+ *	unlink files in a directory shared by all the threads or in a
+ *	private directory per thread, sweeping the total number of
+ *	files from 1K to dirmany-max in steps of x4
+ */
+static int stress_dirmany_mdtest(
+	const stress_args_t *args,
+	const char *pathname)
+{
+	/* ops per second by private dir, directory size and op */
+	static double rates[2][DIRMANY_MD_SIZES][DIRMANY_MD_OPS];
+	stress_dirmany_md_t mds[MAX_DIRMANY_THREADS];
+	uint32_t dirmany_threads = DEFAULT_DIRMANY_THREADS, i;
+	uint64_t dirmany_max = DEFAULT_DIRMANY_MAX;
+	size_t n_sizes, j, idx = 0;
+	int p, op;
+
+	(void)stress_get_setting("dirmany-threads", &dirmany_threads);
+	(void)stress_get_setting("dirmany-max", &dirmany_max);
+
+	for (n_sizes = 0; n_sizes < DIRMANY_MD_SIZES; n_sizes++) {
+		if (((uint64_t)MIN_DIRMANY_MAX << (2 * n_sizes)) > dirmany_max)
+			break;
+	}
+	(void)memset(rates, 0, sizeof(rates));
+
+	for (i = 0; i < dirmany_threads; i++) {
+		char dirname[PATH_MAX + 20];
+
+		(void)snprintf(dirname, sizeof(dirname), "%s/t%" PRIu32, pathname, i);
+		if ((mkdir(dirname, S_IRWXU) < 0) && (errno != EEXIST)) {
+			pr_fail("%s: mkdir %s failed, errno=%d (%s)\n",
+				args->name, dirname, errno, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (args->instance == 0)
+		pr_inf("%s: metadata benchmark, %" PRIu32 " threads, 1K to %" PRIu64 " files%s\n",
+			args->name, dirmany_threads,
+			(uint64_t)MIN_DIRMANY_MAX << (2 * (n_sizes - 1)),
+			stress_fs_type(pathname));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (p = 0; p < 2; p++) {
+			for (j = 0; keep_stressing_flag() && (j < n_sizes); j++) {
+				const uint64_t files = (uint64_t)MIN_DIRMANY_MAX << (2 * j);
+
+				for (i = 0; i < dirmany_threads; i++) {
+					mds[i].pathname = pathname;
+					mds[i].thread = i;
+					mds[i].private_dir = (p == 1);
+					mds[i].files = (files / dirmany_threads) +
+						((i < (files % dirmany_threads)) ? 1 : 0);
+				}
+				for (op = 0; op < DIRMANY_MD_OPS; op++) {
+					double duration;
+					const uint64_t done = stress_dirmany_md_phase(mds,
+						dirmany_threads, (stress_dirmany_md_op_t)op, &duration);
+
+					if (op == DIRMANY_MD_CREATE)
+						add_counter(args, done);
+					/* keep the best rate of the directory size */
+					if ((done == files) && (duration > 0.0) &&
+					    ((double)done / duration > rates[p][j][op]))
+						rates[p][j][op] = (double)done / duration;
+				}
+			}
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (p = 0; p < 2; p++) {
+		const char *dir = p ? "private" : "shared";
+
+		if (args->instance == 0)
+			pr_inf("%s: %7s dir %10s %12s %12s %12s (ops per sec)\n", args->name,
+				dir, "files", dirmany_md_op_names[0],
+				dirmany_md_op_names[1], dirmany_md_op_names[2]);
+		for (j = 0; j < n_sizes; j++) {
+			const uint64_t files = (uint64_t)MIN_DIRMANY_MAX << (2 * j);
+
+			if (rates[p][j][DIRMANY_MD_CREATE] <= 0.0)
+				continue;
+			if (args->instance == 0)
+				pr_inf("%s: %7s dir %10" PRIu64 " %12.0f %12.0f %12.0f\n", args->name,
+					dir, files, rates[p][j][DIRMANY_MD_CREATE],
+					rates[p][j][DIRMANY_MD_STAT], rates[p][j][DIRMANY_MD_UNLINK]);
+			for (op = 0; op < DIRMANY_MD_OPS; op++) {
+				char msg[64];
+
+				(void)snprintf(msg, sizeof(msg), "%s per sec (%s dir, %" PRIu64 " files)",
+					dirmany_md_op_names[op], dir, files);
+				stress_metrics_set(args, idx++, msg, rates[p][j][op]);
+			}
+		}
+	}
+
+	for (i = 0; i < dirmany_threads; i++) {
+		char dirname[PATH_MAX + 20];
+
+		(void)snprintf(dirname, sizeof(dirname), "%s/t%" PRIu32, pathname, i);
+		(void)shim_rmdir(dirname);
+	}
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_dirmany
  *	stress directory with many empty files
@@ -159,6 +450,7 @@ static int stress_dirmany(const stress_args_t *args)
 	double create_time = 0.0, remove_time = 0.0, total_time = 0.0;
 	off_t dirmany_bytes = 0;
 	size_t pathname_len;
+	bool dirmany_mdtest = false;
 
 	stress_temp_dir(pathname, sizeof(pathname), args->name, args->pid, args->instance);
 	pathname_len = strlen(pathname);
@@ -168,6 +460,12 @@ static int stress_dirmany(const stress_args_t *args)
 		return stress_exit_status(-ret);
 
 	(void)stress_get_setting("dirmany-bytes", &dirmany_bytes);
+	(void)stress_get_setting("dirmany-mdtest", &dirmany_mdtest);
+	if (dirmany_mdtest) {
+		ret = stress_dirmany_mdtest(args, pathname);
+		(void)stress_temp_dir_rm_args(args);
+		return ret;
+	}
 
 	if (args->instance == 0) {
 		char sz[32];
@@ -209,6 +507,9 @@ static int stress_dirmany(const stress_args_t *args)
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_dirmany_bytes,	stress_set_dirmany_bytes },
+	{ OPT_dirmany_max,	stress_set_dirmany_max },
+	{ OPT_dirmany_mdtest,	stress_set_dirmany_mdtest },
+	{ OPT_dirmany_threads,	stress_set_dirmany_threads },
 	{ 0,			NULL }
 };
 
@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+
+#define MIN_DIRTY_BYTES		(16 * MB)
+#define MAX_DIRTY_BYTES		(MAX_FILE_LIMIT)
+#define DEFAULT_DIRTY_BYTES	(256 * MB)
+
+#define MIN_DIRTY_RATE		(0)		/* unthrottled */
+#define MAX_DIRTY_RATE		(1024 * 1024)	/* MB per second */
+
+#define DIRTY_CHUNK		(64 * KB)	/* bytes dirtied per write or memset */
+#define DIRTY_PHASE_USEC	(1000000)	/* duration of each method */
+#define DIRTY_SAMPLE_NSEC	(100000000)	/* /proc/vmstat sample interval */
+#define DIRTY_STALL_NSEC	(1000000)	/* chunks slower than this are stalls */
+
+#define DIRTY_METHOD_WRITE	(0)
+#define DIRTY_METHOD_MMAP	(1)
+#define DIRTY_METHOD_MAX	(2)
+#define DIRTY_METHOD_ALL	(DIRTY_METHOD_MAX)
+
+static const stress_help_t help[] = {
+	{ NULL,	"dirty N",		"start N workers measuring dirty page writeback throttling" },
+	{ NULL,	"dirty-bytes N",	"dirty pages of a file of N bytes" },
+	{ NULL,	"dirty-method M",	"dirty pages with method [all|write|mmap]" },
+	{ NULL,	"dirty-ops N",		"stop after N 64K chunks are dirtied" },
+	{ NULL,	"dirty-rate N",		"dirty pages at N MB per second, 0 is unthrottled" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const dirty_methods[] = {
+	"write",
+	"mmap",
+	"all",
+};
+
+static int stress_set_dirty_bytes(const char *opt)
+{
+	uint64_t dirty_bytes;
+
+	dirty_bytes = stress_get_uint64_byte_filesystem(opt, 1);
+	stress_check_range_bytes("dirty-bytes", dirty_bytes,
+		MIN_DIRTY_BYTES, MAX_DIRTY_BYTES);
+	return stress_set_setting("dirty-bytes", TYPE_ID_UINT64, &dirty_bytes);
+}
+
+static int stress_set_dirty_method(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(dirty_methods); i++) {
+		if (!strcmp(opt, dirty_methods[i]))
+			return stress_set_setting("dirty-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "dirty-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(dirty_methods); i++)
+		(void)fprintf(stderr, " %s", dirty_methods[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_dirty_rate(const char *opt)
+{
+	uint32_t dirty_rate;
+
+	dirty_rate = stress_get_uint32(opt);
+	stress_check_range("dirty-rate", (uint64_t)dirty_rate,
+		MIN_DIRTY_RATE, MAX_DIRTY_RATE);
+	return stress_set_setting("dirty-rate", TYPE_ID_UINT32, &dirty_rate);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_dirty_bytes,	stress_set_dirty_bytes },
+	{ OPT_dirty_method,	stress_set_dirty_method },
+	{ OPT_dirty_rate,	stress_set_dirty_rate },
+	{ 0,			NULL }
+};
+
+#if defined(__linux__)
+
+/* writeback counters from /proc/vmstat, in pages */
+typedef struct {
+	uint64_t nr_dirty;		/* pages dirty now */
+	uint64_t nr_writeback;		/* pages under writeback now */
+	uint64_t nr_dirtied;		/* pages dirtied so far */
+	uint64_t nr_written;		/* pages written back so far */
+	bool vmstat;			/* /proc/vmstat was read */
+} stress_dirty_stat_t;
+
+/* accumulated results for a method */
+typedef struct {
+	double duration;		/* seconds dirtying */
+	double bytes;			/* bytes dirtied */
+	double stall;			/* seconds of chunks slower than DIRTY_STALL_NSEC */
+	double written;			/* pages written back, system wide */
+	double samples;			/* number of /proc/vmstat samples */
+	double nr_dirty;		/* sum of sampled dirty pages */
+	double nr_writeback;		/* sum of sampled writeback pages */
+	uint64_t nr_dirty_max;		/* most dirty pages sampled */
+	stress_latency_t latency;	/* latency of dirtying each chunk */
+} stress_dirty_stats_t;
+
+/*
+ *  stress_dirty_read_stat()
+ *	read the dirty and writeback counters from /proc/vmstat
+ */
+static void stress_dirty_read_stat(stress_dirty_stat_t *stat)
+{
+	FILE *fp;
+	char buffer[256];
+
+	(void)memset(stat, 0, sizeof(*stat));
+
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char name[64];
+		uint64_t val;
+
+		if (sscanf(buffer, "%63s %" SCNu64, name, &val) != 2)
+			continue;
+		if (!strcmp(name, "nr_dirty"))
+			stat->nr_dirty = val;
+		else if (!strcmp(name, "nr_writeback"))
+			stat->nr_writeback = val;
+		else if (!strcmp(name, "nr_dirtied"))
+			stat->nr_dirtied = val;
+		else if (!strcmp(name, "nr_written"))
+			stat->nr_written = val;
+	}
+	(void)fclose(fp);
+	stat->vmstat = true;
+}
+
+/*
+ *  stress_dirty_sample()
+ *	add a /proc/vmstat sample of the dirty and writeback pages
+ */
+static void stress_dirty_sample(stress_dirty_stats_t *stats, const stress_dirty_stat_t *stat)
+{
+	if (!stat->vmstat)
+		return;
+	stats->samples += 1.0;
+	stats->nr_dirty += (double)stat->nr_dirty;
+	stats->nr_writeback += (double)stat->nr_writeback;
+	if (stat->nr_dirty > stats->nr_dirty_max)
+		stats->nr_dirty_max = stat->nr_dirty;
+}
+
+/*
+ *  stress_dirty_phase()
+ *	dirty the file a chunk at a time with the method for
+ *	DIRTY_PHASE_USEC, paced to dirty_rate MB per second if
+ *	non-zero, timing each chunk, returns 0 or the errno
+ *	of a failed write
+ */
+static int stress_dirty_phase(
+	const stress_args_t *args,
+	const size_t method,
+	const int fd,
+	uint8_t *mapping,
+	uint8_t *buf,
+	const off_t size,
+	off_t *off,
+	const uint32_t dirty_rate,
+	stress_dirty_stats_t *stats)
+{
+	const uint64_t t_start = stress_latency_now();
+	const uint64_t t_end = t_start + (uint64_t)DIRTY_PHASE_USEC * 1000;
+	const double ns_per_byte = dirty_rate ? STRESS_DBL_NANOSECOND / ((double)dirty_rate * (double)MB) : 0.0;
+	uint64_t t_sample = t_start, bytes = 0, stall_ns = 0, t_now = t_start;
+	stress_dirty_stat_t begin, end;
+	uint8_t val = stress_mwc8();
+
+	stress_dirty_read_stat(&begin);
+	stress_dirty_sample(stats, &begin);
+
+	while ((t_now < t_end) && keep_stressing(args)) {
+		uint64_t t, ns;
+
+		if (*off + (off_t)DIRTY_CHUNK > size)
+			*off = 0;
+		t = stress_latency_now();
+		if (method == DIRTY_METHOD_MMAP) {
+			(void)memset(mapping + *off, val++, DIRTY_CHUNK);
+		} else {
+			ssize_t ret;
+
+			buf[0] = val++;
+			ret = pwrite(fd, buf, DIRTY_CHUNK, *off);
+			if (ret != DIRTY_CHUNK) {
+				if ((ret < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+					continue;
+				return (ret < 0) ? errno : ENOSPC;
+			}
+		}
+		t_now = stress_latency_now();
+		ns = t_now - t;
+		stress_latency_add(&stats->latency, ns);
+		if (ns > DIRTY_STALL_NSEC)
+			stall_ns += ns;
+		*off += DIRTY_CHUNK;
+		bytes += DIRTY_CHUNK;
+		inc_counter(args);
+
+		if (t_now - t_sample >= DIRTY_SAMPLE_NSEC) {
+			stress_dirty_stat_t stat;
+
+			stress_dirty_read_stat(&stat);
+			stress_dirty_sample(stats, &stat);
+			t_sample = t_now;
+		}
+		if (dirty_rate) {
+			const uint64_t due = t_start + (uint64_t)((double)bytes * ns_per_byte);
+
+			if (due > t_now) {
+				(void)shim_nanosleep_uint64(due - t_now);
+				t_now = stress_latency_now();
+			}
+		}
+	}
+
+	stress_dirty_read_stat(&end);
+	stress_dirty_sample(stats, &end);
+	stats->duration += (double)(t_now - t_start) / STRESS_DBL_NANOSECOND;
+	stats->bytes += (double)bytes;
+	stats->stall += (double)stall_ns / STRESS_DBL_NANOSECOND;
+	if (begin.vmstat && end.vmstat && (end.nr_written >= begin.nr_written))
+		stats->written += (double)(end.nr_written - begin.nr_written);
+
+	return 0;
+}
+
+/*
+ *  stress_dirty_thresholds()
+ *	log the dirty page thresholds that drive writeback throttling
+ */
+static void stress_dirty_thresholds(const stress_args_t *args)
+{
+	static const char * const names[] = {
+		"dirty_ratio",
+		"dirty_bytes",
+		"dirty_background_ratio",
+		"dirty_background_bytes",
+		"dirty_expire_centisecs",
+	};
+	char str[256];
+	size_t i, len = 0;
+
+	str[0] = '\0';
+	for (i = 0; (i < SIZEOF_ARRAY(names)) && (len < sizeof(str)); i++) {
+		char path[64], buf[32];
+
+		(void)snprintf(path, sizeof(path), "/proc/sys/vm/%s", names[i]);
+		if (system_read(path, buf, sizeof(buf)) <= 0)
+			continue;
+		buf[strcspn(buf, "\n")] = '\0';
+		len += (size_t)snprintf(str + len, sizeof(str) - len, "%s%s=%s",
+			len ? ", " : "", names[i], buf);
+	}
+	if (len)
+		pr_inf("%s: %s\n", args->name, str);
+}
+
+/*
+ *  stress_dirty_report()
+ *	print the dirtying rates, chunk latencies, stall time and
+ *	dirty page counts of the methods
+ */
+static void stress_dirty_report(
+	const stress_args_t *args,
+	const stress_dirty_stats_t *stats,
+	const size_t page_size)
+{
+	const double mb_per_page = (double)page_size / (double)MB;
+	size_t i;
+
+	pr_lock();
+	stress_dirty_thresholds(args);
+	pr_inf("%s: %-6s %10s %10s %8s %8s %9s %9s %7s %9s %9s %9s\n", args->name,
+		"method", "dirty MB/s", "wback MB/s", "p50 us", "p99 us",
+		"p99.9 us", "max us", "stall %", "dirty MB", "max MB", "wback MB");
+	for (i = 0; i < DIRTY_METHOD_MAX; i++) {
+		const stress_dirty_stats_t *s = &stats[i];
+		const stress_latency_t *l = &s->latency;
+		const double samples = (s->samples > 0.0) ? s->samples : 1.0;
+
+		if ((s->duration <= 0.0) || (l->count == 0))
+			continue;
+		pr_inf("%s: %-6s %10.1f %10.1f %8.1f %8.1f %9.1f %9.1f %7.2f %9.1f %9.1f %9.1f\n",
+			args->name, dirty_methods[i],
+			s->bytes / s->duration / (double)MB,
+			s->written * mb_per_page / s->duration,
+			(double)stress_latency_percentile(l, 50.0) / 1000.0,
+			(double)stress_latency_percentile(l, 99.0) / 1000.0,
+			(double)stress_latency_percentile(l, 99.9) / 1000.0,
+			(double)l->max / 1000.0,
+			100.0 * s->stall / s->duration,
+			s->nr_dirty * mb_per_page / samples,
+			(double)s->nr_dirty_max * mb_per_page,
+			s->nr_writeback * mb_per_page / samples);
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_dirty()
+ *	dirty the page cache of a file with write() and with stores
+ *	to a shared mapping and measure how long dirtying stalls in
+ *	writeback throttling and the writeback rate achieved
+ */
+static int stress_dirty(const stress_args_t *args)
+{
+	static stress_dirty_stats_t stats[DIRTY_METHOD_MAX];
+	const size_t page_size = args->page_size;
+	uint64_t dirty_bytes = DEFAULT_DIRTY_BYTES;
+	uint32_t dirty_rate = 0;
+	size_t m, dirty_method = DIRTY_METHOD_ALL, idx = 0;
+	uint8_t *mapping, *buf;
+	char filename[PATH_MAX];
+	const char *fs_type;
+	off_t size, off = 0;
+	int fd, ret, rc = EXIT_SUCCESS;
+
+	if (!stress_get_setting("dirty-bytes", &dirty_bytes)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			dirty_bytes = MAX_DIRTY_BYTES;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			dirty_bytes = MIN_DIRTY_BYTES;
+	}
+	(void)stress_get_setting("dirty-method", &dirty_method);
+	(void)stress_get_setting("dirty-rate", &dirty_rate);
+
+	dirty_bytes /= args->num_instances;
+	if (dirty_bytes < MIN_DIRTY_BYTES)
+		dirty_bytes = MIN_DIRTY_BYTES;
+	size = (off_t)(dirty_bytes & ~(uint64_t)(DIRTY_CHUNK - 1));
+
+	buf = (uint8_t *)mmap(NULL, DIRTY_CHUNK, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte write buffer, skipping stressor\n",
+			args->name, (size_t)DIRTY_CHUNK);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_uint8rnd4(buf, DIRTY_CHUNK);
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto unmap_buf;
+	}
+	(void)stress_temp_filename_args(args, filename, sizeof(filename), stress_mwc32());
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto rm_dir;
+	}
+	fs_type = stress_fs_type(filename);
+	(void)shim_unlink(filename);
+
+	if (ftruncate(fd, size) < 0) {
+		pr_inf_skip("%s: ftruncate to %jd bytes failed, errno=%d (%s)%s, skipping stressor\n",
+			args->name, (intmax_t)size, errno, strerror(errno), fs_type);
+		rc = EXIT_NO_RESOURCE;
+		goto close_fd;
+	}
+	mapping = (uint8_t *)mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %jd byte file%s, skipping stressor\n",
+			args->name, (intmax_t)size, fs_type);
+		rc = EXIT_NO_RESOURCE;
+		goto close_fd;
+	}
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (m = 0; m < DIRTY_METHOD_MAX; m++)
+		stress_latency_reset(&stats[m].latency);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; keep_stressing(args) && (m < DIRTY_METHOD_MAX); m++) {
+			if ((dirty_method != DIRTY_METHOD_ALL) && (dirty_method != m))
+				continue;
+			ret = stress_dirty_phase(args, m, fd, mapping, buf, size, &off,
+				dirty_rate, &stats[m]);
+			if (ret != 0) {
+				if (ret == ENOSPC) {
+					pr_inf_skip("%s: out of space dirtying the file%s, "
+						"skipping stressor\n", args->name, fs_type);
+					rc = EXIT_NO_RESOURCE;
+				} else {
+					pr_fail("%s: write failed, errno=%d (%s)%s\n",
+						args->name, ret, strerror(ret), fs_type);
+					rc = EXIT_FAILURE;
+				}
+				break;
+			}
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_dirty_report(args, stats, page_size);
+
+	for (m = 0; m < DIRTY_METHOD_MAX; m++) {
+		const stress_dirty_stats_t *s = &stats[m];
+		const stress_latency_t *l = &s->latency;
+		const double mb_per_page = (double)page_size / (double)MB;
+		char str[64];
+
+		if ((s->duration <= 0.0) || (l->count == 0))
+			continue;
+		(void)snprintf(str, sizeof(str), "%s MB per sec dirtied", dirty_methods[m]);
+		stress_metrics_set(args, idx++, str, s->bytes / s->duration / (double)MB);
+		(void)snprintf(str, sizeof(str), "%s MB per sec written back (system)", dirty_methods[m]);
+		stress_metrics_set(args, idx++, str, s->written * mb_per_page / s->duration);
+		(void)snprintf(str, sizeof(str), "%s p50 64K dirty latency (ns)", dirty_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 50.0));
+		(void)snprintf(str, sizeof(str), "%s p99 64K dirty latency (ns)", dirty_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 99.0));
+		(void)snprintf(str, sizeof(str), "%s p99.9 64K dirty latency (ns)", dirty_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 99.9));
+		(void)snprintf(str, sizeof(str), "%s max 64K dirty latency (ns)", dirty_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)l->max);
+		(void)snprintf(str, sizeof(str), "%s stalled %% of time", dirty_methods[m]);
+		stress_metrics_set(args, idx++, str, 100.0 * s->stall / s->duration);
+		if (s->samples > 0.0) {
+			(void)snprintf(str, sizeof(str), "%s mean dirty MB (system)", dirty_methods[m]);
+			stress_metrics_set(args, idx++, str, s->nr_dirty * mb_per_page / s->samples);
+			(void)snprintf(str, sizeof(str), "%s mean writeback MB (system)", dirty_methods[m]);
+			stress_metrics_set(args, idx++, str, s->nr_writeback * mb_per_page / s->samples);
+		}
+		if (args->latency)
+			stress_latency_merge(args->latency, l);
+	}
+
+	(void)munmap((void *)mapping, (size_t)size);
+close_fd:
+	(void)close(fd);
+rm_dir:
+	(void)stress_temp_dir_rm_args(args);
+unmap_buf:
+	(void)munmap((void *)buf, DIRTY_CHUNK);
+
+	return rc;
+}
+
+stressor_info_t stress_dirty_info = {
+	.stressor = stress_dirty,
+	.class = CLASS_FILESYSTEM | CLASS_IO | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_dirty_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_FILESYSTEM | CLASS_IO | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "only supported on Linux"
+};
+#endif
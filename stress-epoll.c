@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
 #include "core-net.h"
 
 #if defined(HAVE_SYS_UN_H)
@@ -28,6 +29,10 @@
 #include <sys/epoll.h>
 #endif
 
+#if defined(HAVE_NETINET_TCP_H)
+#include <netinet/tcp.h>
+#endif
+
 #define MIN_EPOLL_PORT		(1024)
 #define MAX_EPOLL_PORT		(65535)
 #define DEFAULT_EPOLL_PORT	(6000)
@@ -38,12 +43,35 @@
 #define MAX_EPOLL_SOCKETS	(100000)
 #define DEFAULT_EPOLL_SOCKETS	(4096)
 
+#define MIN_EPOLL_CONNS		(1)
+#define MAX_EPOLL_CONNS		(65536)
+#define MIN_EPOLL_MSG_SIZE	(1)
+#define MAX_EPOLL_MSG_SIZE	(65536)
+#define DEFAULT_EPOLL_REQ_SIZE	(128)
+#define DEFAULT_EPOLL_RESP_SIZE	(1024)
+
+#define EPOLL_TRIGGER_LEVEL	(0)
+#define EPOLL_TRIGGER_EDGE	(1)
+
+#define EPOLL_ACCEPTOR_EXCLUSIVE (0)
+#define EPOLL_ACCEPTOR_REUSEPORT (1)
+
+typedef struct {
+	const char *name;	/* option name */
+	const int value;	/* EPOLL_TRIGGER_* or EPOLL_ACCEPTOR_* value */
+} stress_epoll_choice_t;
+
 static const stress_help_t help[] = {
 	{ NULL,	"epoll N",	  	"start N workers doing epoll handled socket activity" },
+	{ NULL,	"epoll-acceptor A",	"persistent mode acceptors, exclusive or reuseport" },
+	{ NULL,	"epoll-conns N",	"N persistent request/response connections per worker" },
 	{ NULL,	"epoll-domain D", 	"specify socket domain, default is unix" },
 	{ NULL,	"epoll-ops N",	  	"stop after N epoll bogo operations" },
 	{ NULL,	"epoll-port P",	  	"use socket ports P upwards" },
+	{ NULL,	"epoll-req-size N",	"persistent mode request size in bytes" },
+	{ NULL,	"epoll-resp-size N",	"persistent mode response size in bytes" },
 	{ NULL, "epoll-sockets N",	"specify maximum number of open sockets" },
+	{ NULL,	"epoll-trigger T",	"persistent mode server trigger, level or edge" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -63,12 +91,46 @@ typedef void (stress_epoll_func_t)(
 	const int epoll_domain,
 	const int epoll_sockets);
 
+/*
+ *  persistent connection request/response mode settings,
+ *  filled in before the servers are forked
+ */
+typedef struct {
+	int conns;		/* persistent connections, 0 for churn mode */
+	int req_size;		/* request size in bytes */
+	int resp_size;		/* response size in bytes */
+	int trigger;		/* EPOLL_TRIGGER_* server trigger mode */
+	int acceptor;		/* EPOLL_ACCEPTOR_* acceptor variant */
+	int lfd;		/* shared listen socket, exclusive acceptor */
+} stress_epoll_rps_t;
+
+/*
+ *  persistent connection state
+ */
+typedef struct {
+	int fd;			/* connection socket */
+	int in;			/* bytes of request or response received */
+	int out;		/* bytes of request or response left to send */
+	uint64_t t_start;	/* client request start time in ns */
+} stress_epoll_conn_t;
+
 static timer_t epoll_timerid;
+static stress_epoll_rps_t epoll_rps;
 
 #endif
 
 static int max_servers = 1;
 
+static const stress_epoll_choice_t epoll_triggers[] = {
+	{ "level",	EPOLL_TRIGGER_LEVEL },
+	{ "edge",	EPOLL_TRIGGER_EDGE },
+};
+
+static const stress_epoll_choice_t epoll_acceptors[] = {
+	{ "exclusive",	EPOLL_ACCEPTOR_EXCLUSIVE },
+	{ "reuseport",	EPOLL_ACCEPTOR_REUSEPORT },
+};
+
 /*
  *  stress_set_epoll_port()
  *	set the default port base
@@ -120,10 +182,94 @@ static int stress_set_epoll_sockets(const char *opt)
         return stress_set_setting("epoll-sockets", TYPE_ID_INT, &epoll_sockets);
 }
 
+/*
+ *  stress_set_epoll_choice()
+ *	set setting to the value of the named choice
+ */
+static int stress_set_epoll_choice(
+	const char *setting,
+	const stress_epoll_choice_t *choices,
+	const size_t n_choices,
+	const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < n_choices; i++) {
+		if (!strcmp(choices[i].name, opt)) {
+			int value = choices[i].value;
+
+			return stress_set_setting(setting, TYPE_ID_INT, &value);
+		}
+	}
+	(void)fprintf(stderr, "%s must be one of:", setting);
+	for (i = 0; i < n_choices; i++)
+		(void)fprintf(stderr, " %s", choices[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_set_epoll_conns()
+ *	set the number of persistent connections, enables
+ *	the request/response mode
+ */
+static int stress_set_epoll_conns(const char *opt)
+{
+	int epoll_conns;
+
+	epoll_conns = (int)stress_get_uint32(opt);
+	stress_check_range("epoll-conns", (uint64_t)epoll_conns, MIN_EPOLL_CONNS, MAX_EPOLL_CONNS);
+	return stress_set_setting("epoll-conns", TYPE_ID_INT, &epoll_conns);
+}
+
+/*
+ *  stress_set_epoll_req_size()
+ *	set the persistent mode request size
+ */
+static int stress_set_epoll_req_size(const char *opt)
+{
+	int epoll_req_size;
+
+	epoll_req_size = (int)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("epoll-req-size", (uint64_t)epoll_req_size, MIN_EPOLL_MSG_SIZE, MAX_EPOLL_MSG_SIZE);
+	return stress_set_setting("epoll-req-size", TYPE_ID_INT, &epoll_req_size);
+}
+
+/*
+ *  stress_set_epoll_resp_size()
+ *	set the persistent mode response size
+ */
+static int stress_set_epoll_resp_size(const char *opt)
+{
+	int epoll_resp_size;
+
+	epoll_resp_size = (int)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("epoll-resp-size", (uint64_t)epoll_resp_size, MIN_EPOLL_MSG_SIZE, MAX_EPOLL_MSG_SIZE);
+	return stress_set_setting("epoll-resp-size", TYPE_ID_INT, &epoll_resp_size);
+}
+
+static int stress_set_epoll_trigger(const char *opt)
+{
+	return stress_set_epoll_choice("epoll-trigger", epoll_triggers,
+		SIZEOF_ARRAY(epoll_triggers), opt);
+}
+
+static int stress_set_epoll_acceptor(const char *opt)
+{
+	return stress_set_epoll_choice("epoll-acceptor", epoll_acceptors,
+		SIZEOF_ARRAY(epoll_acceptors), opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_epoll_acceptor,	stress_set_epoll_acceptor },
+	{ OPT_epoll_conns,	stress_set_epoll_conns },
 	{ OPT_epoll_domain,	stress_set_epoll_domain },
 	{ OPT_epoll_port,	stress_set_epoll_port },
+	{ OPT_epoll_req_size,	stress_set_epoll_req_size },
+	{ OPT_epoll_resp_size,	stress_set_epoll_resp_size },
 	{ OPT_epoll_sockets,	stress_set_epoll_sockets },
+	{ OPT_epoll_trigger,	stress_set_epoll_trigger },
 	{ 0,			NULL }
 };
 
@@ -996,6 +1142,565 @@ die:
 	_exit(rc);
 }
 
+/*
+ *  epoll_rps_continue()
+ *	keep_stressing() without --rate pacing, the persistent
+ *	mode is a closed loop so is paced by the responses
+ */
+static inline bool epoll_rps_continue(const stress_args_t *args)
+{
+	if (!keep_stressing_flag())
+		return false;
+	return !(args->max_ops && (get_counter(args) >= args->max_ops));
+}
+
+/*
+ *  epoll_rps_ctl()
+ *	add or modify fd in the epoll set, conn is NULL
+ *	for the listening socket
+ */
+static int epoll_rps_ctl(
+	const int efd,
+	const int op,
+	const int fd,
+	stress_epoll_conn_t *conn,
+	const uint32_t events)
+{
+	struct epoll_event event;
+
+	(void)memset(&event, 0, sizeof(event));
+	event.data.ptr = conn;
+	event.events = events;
+
+	return epoll_ctl(efd, op, fd, &event);
+}
+
+/*
+ *  epoll_rps_nodelay()
+ *	disable Nagle so small requests and responses go out immediately
+ */
+static void epoll_rps_nodelay(const int fd, const int epoll_domain)
+{
+#if defined(IPPROTO_TCP) &&	\
+    defined(TCP_NODELAY)
+	if ((epoll_domain == AF_INET) || (epoll_domain == AF_INET6)) {
+		int one = 1;
+
+		VOID_RET(int, setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)));
+	}
+#else
+	(void)fd;
+	(void)epoll_domain;
+#endif
+}
+
+/*
+ *  epoll_rps_send()
+ *	send the remaining conn->out bytes, returns -1 on error,
+ *	0 if everything has been sent or 1 if the send would block
+ */
+static int epoll_rps_send(stress_epoll_conn_t *conn, const char *buf)
+{
+	while (conn->out > 0) {
+		const ssize_t n = send(conn->fd, buf, (size_t)conn->out, 0);
+
+		if (UNLIKELY(n < 0)) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return 1;
+			if ((errno == EINTR) && keep_stressing_flag())
+				continue;
+			return -1;
+		}
+		conn->out -= (int)n;
+	}
+	return 0;
+}
+
+/*
+ *  epoll_rps_listen()
+ *	create a non-blocking listening socket on port
+ */
+static int epoll_rps_listen(
+	const stress_args_t *args,
+	const pid_t mypid,
+	const int port,
+	const int epoll_domain,
+	const bool reuseport)
+{
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	int fd, one = 1;
+
+	if ((fd = socket(epoll_domain, SOCK_STREAM, 0)) < 0) {
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) {
+		pr_fail("%s: setsockopt SO_REUSEADDR failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+#if defined(SO_REUSEPORT)
+	if (reuseport && (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)) {
+		pr_fail("%s: setsockopt SO_REUSEPORT failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+#else
+	(void)reuseport;
+#endif
+	if (stress_set_sockaddr(args->name, args->instance, mypid,
+		epoll_domain, port, &addr, &addr_len, NET_ADDR_ANY) < 0)
+		goto err;
+	if (bind(fd, addr, addr_len) < 0) {
+		pr_fail("%s: bind failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	if (epoll_set_fd_nonblock(fd) < 0) {
+		pr_fail("%s: setting socket to non-blocking failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	if (listen(fd, SOMAXCONN) < 0) {
+		pr_fail("%s: listen failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	return fd;
+err:
+	(void)close(fd);
+	return -1;
+}
+
+/*
+ *  epoll_rps_accept()
+ *	accept all pending connections and add them to the epoll set
+ */
+static void epoll_rps_accept(
+	const stress_args_t *args,
+	const int efd,
+	const int lfd,
+	const int epoll_domain,
+	const uint32_t conn_events)
+{
+	for (;;) {
+		stress_epoll_conn_t *conn;
+		const int fd = accept(lfd, NULL, NULL);
+
+		if (fd < 0) {
+			/* EAGAIN is normal, another acceptor may have won */
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+			    (errno != EINTR) && (errno != ECONNABORTED))
+				pr_dbg("%s: accept failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+			return;
+		}
+		if (epoll_set_fd_nonblock(fd) < 0) {
+			(void)close(fd);
+			continue;
+		}
+		epoll_rps_nodelay(fd, epoll_domain);
+		conn = calloc(1, sizeof(*conn));
+		if (!conn) {
+			(void)close(fd);
+			continue;
+		}
+		conn->fd = fd;
+		if (epoll_rps_ctl(efd, EPOLL_CTL_ADD, fd, conn, conn_events) < 0) {
+			(void)close(fd);
+			free(conn);
+		}
+	}
+}
+
+/*
+ *  epoll_rps_server_recv()
+ *	read request data and answer each complete request,
+ *	edge triggered mode must drain the socket until EAGAIN
+ */
+static int epoll_rps_server_recv(
+	const int efd,
+	stress_epoll_conn_t *conn,
+	char *buf,
+	const uint32_t conn_events)
+{
+	do {
+		const ssize_t n = recv(conn->fd, buf,
+			(size_t)(epoll_rps.req_size - conn->in), 0);
+
+		if (n == 0)
+			return -1;
+		if (n < 0)
+			return ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+				(errno == EINTR)) ? 0 : -1;
+
+		conn->in += (int)n;
+		if (conn->in >= epoll_rps.req_size) {
+			int ret;
+
+			conn->in = 0;
+			conn->out = epoll_rps.resp_size;
+			ret = epoll_rps_send(conn, buf);
+			if (ret < 0)
+				return -1;
+			if (ret > 0)
+				return epoll_rps_ctl(efd, EPOLL_CTL_MOD, conn->fd,
+					conn, conn_events | EPOLLOUT);
+		}
+	} while (conn_events & EPOLLET);
+
+	return 0;
+}
+
+/*
+ *  epoll_rps_server()
+ *	accept persistent connections and respond to each request,
+ *	the acceptors either share one listening socket added with
+ *	EPOLLEXCLUSIVE or each have their own SO_REUSEPORT socket
+ */
+static void NORETURN epoll_rps_server(
+	const stress_args_t *args,
+	const int child,
+	const pid_t mypid,
+	const int epoll_port,
+	const int epoll_domain,
+	const int epoll_sockets)
+{
+	const uint32_t conn_events = EPOLLIN |
+		((epoll_rps.trigger == EPOLL_TRIGGER_EDGE) ? EPOLLET : 0);
+	uint32_t lfd_events = EPOLLIN;
+	struct epoll_event *events = NULL;
+	char *buf = NULL;
+	int efd = -1, lfd = epoll_rps.lfd, rc = EXIT_SUCCESS;
+
+	(void)child;
+	(void)epoll_sockets;
+
+	if (epoll_rps.acceptor == EPOLL_ACCEPTOR_REUSEPORT) {
+		lfd = epoll_rps_listen(args, mypid, epoll_port, epoll_domain, true);
+		if (lfd < 0) {
+			rc = EXIT_FAILURE;
+			goto die;
+		}
+	} else {
+#if defined(EPOLLEXCLUSIVE)
+		lfd_events |= EPOLLEXCLUSIVE;
+#endif
+	}
+
+	buf = calloc(1, MAX_EPOLL_MSG_SIZE);
+	events = calloc(MAX_EPOLL_EVENTS, sizeof(*events));
+	if (!buf || !events) {
+		pr_fail("%s: calloc failed, out of memory\n", args->name);
+		rc = EXIT_FAILURE;
+		goto die;
+	}
+	efd = epoll_create(1);
+	if (efd < 0) {
+		pr_fail("%s: epoll_create failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto die;
+	}
+	if (epoll_rps_ctl(efd, EPOLL_CTL_ADD, lfd, NULL, lfd_events) < 0) {
+		pr_fail("%s: epoll_ctl_add failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto die;
+	}
+
+	while (keep_stressing_flag()) {
+		int i, n;
+
+		n = epoll_wait(efd, events, MAX_EPOLL_EVENTS, 100);
+		if (UNLIKELY(n < 0)) {
+			if (errno == EINTR)
+				continue;
+			pr_fail("%s: epoll_wait failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			stress_epoll_conn_t *conn = (stress_epoll_conn_t *)events[i].data.ptr;
+			const uint32_t ev = events[i].events;
+
+			if (!conn) {
+				epoll_rps_accept(args, efd, lfd, epoll_domain, conn_events);
+				continue;
+			}
+			if (ev & (EPOLLERR | EPOLLHUP))
+				goto close_conn;
+			if (ev & EPOLLOUT) {
+				const int ret = epoll_rps_send(conn, buf);
+
+				if (ret < 0)
+					goto close_conn;
+				if ((ret == 0) &&
+				    (epoll_rps_ctl(efd, EPOLL_CTL_MOD, conn->fd, conn, conn_events) < 0))
+					goto close_conn;
+			}
+			if ((ev & EPOLLIN) &&
+			    (epoll_rps_server_recv(efd, conn, buf, conn_events) < 0))
+				goto close_conn;
+			continue;
+close_conn:
+			(void)close(conn->fd);
+			free(conn);
+		}
+	}
+die:
+	if (efd >= 0)
+		(void)close(efd);
+	if ((lfd >= 0) && (lfd != epoll_rps.lfd))
+		(void)close(lfd);
+	free(events);
+	free(buf);
+
+	_exit(rc);
+}
+
+/*
+ *  epoll_rps_client_recv()
+ *	read response data, on a complete response account the
+ *	latency and send the next request
+ */
+static int epoll_rps_client_recv(
+	const stress_args_t *args,
+	const int efd,
+	stress_epoll_conn_t *conn,
+	char *buf,
+	stress_latency_t *latency,
+	uint64_t *requests)
+{
+	for (;;) {
+		const ssize_t n = recv(conn->fd, buf,
+			(size_t)(epoll_rps.resp_size - conn->in), 0);
+
+		if (n == 0)
+			return -1;
+		if (n < 0)
+			return ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+				(errno == EINTR)) ? 0 : -1;
+
+		conn->in += (int)n;
+		if (conn->in >= epoll_rps.resp_size) {
+			const uint64_t now = stress_latency_now();
+			int ret;
+
+			stress_latency_add(latency, now - conn->t_start);
+			conn->in = 0;
+			(*requests)++;
+			inc_counter(args);
+			if (!epoll_rps_continue(args))
+				return 0;
+
+			conn->out = epoll_rps.req_size;
+			conn->t_start = now;
+			ret = epoll_rps_send(conn, buf);
+			if (ret < 0)
+				return -1;
+			if (ret > 0)
+				return epoll_rps_ctl(efd, EPOLL_CTL_MOD, conn->fd,
+					conn, EPOLLIN | EPOLLOUT);
+			return 0;
+		}
+	}
+}
+
+/*
+ *  epoll_rps_client()
+ *	open the persistent connections and run closed loop
+ *	request/response cycles on all of them, each response
+ *	is a bogo op
+ */
+static int epoll_rps_client(
+	const stress_args_t *args,
+	const pid_t mypid,
+	const int port,
+	const int epoll_domain)
+{
+	stress_epoll_conn_t *conns;
+	stress_latency_t *latency;
+	struct epoll_event *events;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	char *buf;
+	int i, n_conns = 0, efd = -1, rc = EXIT_FAILURE;
+	double t_conn_start = 0.0, t_conn_end, t_start, duration;
+	uint64_t requests = 0;
+	size_t idx = 0;
+
+	conns = calloc((size_t)epoll_rps.conns, sizeof(*conns));
+	latency = malloc(sizeof(*latency));
+	events = calloc(MAX_EPOLL_EVENTS, sizeof(*events));
+	buf = calloc(1, MAX_EPOLL_MSG_SIZE);
+	if (!conns || !latency || !events || !buf) {
+		pr_inf_skip("%s: cannot allocate connection state, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_state;
+	}
+	stress_latency_reset(latency);
+	(void)memset(buf, 'A' + (args->instance % 26), MAX_EPOLL_MSG_SIZE);
+
+	if (stress_set_sockaddr(args->name, args->instance, mypid,
+		epoll_domain, port, &addr, &addr_len, NET_ADDR_ANY) < 0)
+		goto free_state;
+	efd = epoll_create(1);
+	if (efd < 0) {
+		pr_fail("%s: epoll_create failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto free_state;
+	}
+
+	for (i = 0; (i < epoll_rps.conns) && keep_stressing_flag(); i++) {
+		int fd, retries = 0;
+retry:
+		if ((fd = socket(epoll_domain, SOCK_STREAM, 0)) < 0) {
+			if ((errno == EMFILE) || (errno == ENFILE) ||
+			    (errno == ENOMEM) || (errno == ENOBUFS))
+				break;
+			pr_fail("%s: socket failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto close_conns;
+		}
+		if (connect(fd, addr, addr_len) < 0) {
+			const int saved_errno = errno;
+
+			(void)close(fd);
+			/* servers may not be listening yet */
+			if (((saved_errno == ECONNREFUSED) || (saved_errno == ENOENT) ||
+			     (saved_errno == EINTR)) && (retries++ < 100) &&
+			    keep_stressing_flag()) {
+				(void)shim_usleep(100000);
+				goto retry;
+			}
+			if ((saved_errno == EAGAIN) || (saved_errno == EADDRNOTAVAIL))
+				break;
+			if (!keep_stressing_flag())
+				break;
+			pr_fail("%s: connect failed, errno=%d (%s)\n",
+				args->name, saved_errno, strerror(saved_errno));
+			goto close_conns;
+		}
+		if (n_conns == 0)
+			t_conn_start = stress_time_now();
+		(void)epoll_set_fd_nonblock(fd);
+		epoll_rps_nodelay(fd, epoll_domain);
+		conns[i].fd = fd;
+		n_conns++;
+		if (epoll_rps_ctl(efd, EPOLL_CTL_ADD, fd, &conns[i], EPOLLIN) < 0) {
+			pr_fail("%s: epoll_ctl_add failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto close_conns;
+		}
+	}
+	t_conn_end = stress_time_now();
+	if (!keep_stressing_flag()) {
+		rc = EXIT_SUCCESS;
+		goto close_conns;
+	}
+	if (n_conns == 0) {
+		pr_inf_skip("%s: cannot open any connections, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto close_conns;
+	}
+	if (n_conns < epoll_rps.conns)
+		pr_inf("%s: only %d of %d connections could be opened\n",
+			args->name, n_conns, epoll_rps.conns);
+
+	t_start = stress_time_now();
+	for (i = 0; i < n_conns; i++) {
+		int ret;
+
+		conns[i].out = epoll_rps.req_size;
+		conns[i].t_start = stress_latency_now();
+		ret = epoll_rps_send(&conns[i], buf);
+		if ((ret < 0) ||
+		    ((ret > 0) && (epoll_rps_ctl(efd, EPOLL_CTL_MOD, conns[i].fd,
+				&conns[i], EPOLLIN | EPOLLOUT) < 0))) {
+			pr_fail("%s: send failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto close_conns;
+		}
+	}
+
+	while (epoll_rps_continue(args)) {
+		int n;
+
+		n = epoll_wait(efd, events, MAX_EPOLL_EVENTS, 100);
+		if (UNLIKELY(n < 0)) {
+			if (errno == EINTR)
+				continue;
+			pr_fail("%s: epoll_wait failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto close_conns;
+		}
+		for (i = 0; i < n; i++) {
+			stress_epoll_conn_t *conn = (stress_epoll_conn_t *)events[i].data.ptr;
+			const uint32_t ev = events[i].events;
+			int ret = 0;
+
+			if (ev & EPOLLOUT) {
+				ret = epoll_rps_send(conn, buf);
+				if (ret == 0)
+					ret = epoll_rps_ctl(efd, EPOLL_CTL_MOD, conn->fd, conn, EPOLLIN);
+			}
+			if ((ret >= 0) && (ev & EPOLLIN))
+				ret = epoll_rps_client_recv(args, efd, conn, buf, latency, &requests);
+			if ((ret < 0) || (ev & (EPOLLERR | EPOLLHUP))) {
+				if (!keep_stressing_flag())
+					break;
+				pr_fail("%s: connection failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				goto close_conns;
+			}
+		}
+	}
+	duration = stress_time_now() - t_start;
+	rc = EXIT_SUCCESS;
+
+	if (duration > 0.0)
+		stress_metrics_set(args, idx++, "requests per sec", (double)requests / duration);
+	if ((n_conns > 1) && (t_conn_end > t_conn_start))
+		stress_metrics_set(args, idx++, "connections per sec",
+			(double)(n_conns - 1) / (t_conn_end - t_conn_start));
+	if (latency->count) {
+		stress_metrics_set(args, idx++, "p50 latency (ns)",
+			(double)stress_latency_percentile(latency, 50.0));
+		stress_metrics_set(args, idx++, "p99 latency (ns)",
+			(double)stress_latency_percentile(latency, 99.0));
+		stress_metrics_set(args, idx++, "p99.9 latency (ns)",
+			(double)stress_latency_percentile(latency, 99.9));
+		if (args->latency)
+			stress_latency_merge(args->latency, latency);
+	}
+
+close_conns:
+	for (i = 0; i < n_conns; i++)
+		(void)close(conns[i].fd);
+	(void)close(efd);
+#if defined(AF_UNIX) &&		\
+    defined(HAVE_SOCKADDR_UN)
+	if (addr && (epoll_domain == AF_UNIX)) {
+		struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
+
+		(void)shim_unlink(addr_un->sun_path);
+	}
+#endif
+free_state:
+	free(buf);
+	free(events);
+	free(latency);
+	free(conns);
+
+	return rc;
+}
+
 /*
  *  stress_epoll
  *	stress by heavy socket I/O
@@ -1013,6 +1718,18 @@ static int stress_epoll(const stress_args_t *args)
 	(void)stress_get_setting("epoll-port", &epoll_port);
 	(void)stress_get_setting("epoll-sockets", &epoll_sockets);
 
+	epoll_rps.conns = 0;
+	epoll_rps.req_size = DEFAULT_EPOLL_REQ_SIZE;
+	epoll_rps.resp_size = DEFAULT_EPOLL_RESP_SIZE;
+	epoll_rps.trigger = EPOLL_TRIGGER_LEVEL;
+	epoll_rps.acceptor = EPOLL_ACCEPTOR_EXCLUSIVE;
+	epoll_rps.lfd = -1;
+	(void)stress_get_setting("epoll-conns", &epoll_rps.conns);
+	(void)stress_get_setting("epoll-req-size", &epoll_rps.req_size);
+	(void)stress_get_setting("epoll-resp-size", &epoll_rps.resp_size);
+	(void)stress_get_setting("epoll-trigger", &epoll_rps.trigger);
+	(void)stress_get_setting("epoll-acceptor", &epoll_rps.acceptor);
+
 	if (stress_sighandler(args->name, SIGPIPE, SIG_IGN, NULL) < 0)
 		return EXIT_NO_RESOURCE;
 
@@ -1068,6 +1785,42 @@ static int stress_epoll(const stress_args_t *args)
 	 *  on a default Linux configuration.
 	 */
 	(void)memset(pids, 0, sizeof(pids));
+
+	/*
+	 *  Persistent connection mode, all the acceptors
+	 *  serve the one port start_port
+	 */
+	if (epoll_rps.conns > 0) {
+#if defined(SO_REUSEPORT)
+		if ((epoll_rps.acceptor == EPOLL_ACCEPTOR_REUSEPORT) &&
+		    (epoll_domain == AF_UNIX)) {
+#else
+		if (epoll_rps.acceptor == EPOLL_ACCEPTOR_REUSEPORT) {
+#endif
+			if (args->instance == 0)
+				pr_inf("%s: reuseport acceptor needs the ipv4 or ipv6 "
+					"domain, using the exclusive acceptor\n", args->name);
+			epoll_rps.acceptor = EPOLL_ACCEPTOR_EXCLUSIVE;
+		}
+		if (epoll_rps.acceptor == EPOLL_ACCEPTOR_EXCLUSIVE) {
+			epoll_rps.lfd = epoll_rps_listen(args, mypid, start_port, epoll_domain, false);
+			if (epoll_rps.lfd < 0) {
+				rc = EXIT_FAILURE;
+				goto reap;
+			}
+		}
+		for (i = 0; i < max_servers; i++) {
+			pids[i] = epoll_spawn(args, epoll_rps_server, i, mypid, start_port, epoll_domain, epoll_sockets);
+			if (pids[i] < 0) {
+				pr_fail("%s: fork failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				goto reap;
+			}
+		}
+		rc = epoll_rps_client(args, mypid, start_port, epoll_domain);
+		goto reap;
+	}
+
 	for (i = 0; i < max_servers; i++) {
 		pids[i] = epoll_spawn(args, epoll_server, i, mypid, epoll_port, epoll_domain, epoll_sockets);
 		if (pids[i] < 0) {
@@ -1081,6 +1834,10 @@ static int stress_epoll(const stress_args_t *args)
 reap:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 	stress_net_release_ports(start_port, end_port);
+	if (epoll_rps.lfd >= 0) {
+		(void)close(epoll_rps.lfd);
+		epoll_rps.lfd = -1;
+	}
 
 	for (i = 0; i < max_servers; i++) {
 		int status;
@@ -19,6 +19,7 @@
  */
 #include "stress-ng.h"
 #include "core-capabilities.h"
+#include "core-fsnotify-scale.h"
 
 #if defined(HAVE_SYS_FANOTIFY_H)
 #include <sys/fanotify.h>
@@ -29,9 +30,44 @@
 #endif
 
 static const stress_help_t help[] = {
-	{ NULL,	"fanotify N",	  "start N workers exercising fanotify events" },
-	{ NULL,	"fanotify-ops N", "stop fanotify workers after N bogo operations" },
-	{ NULL,	NULL,		  NULL }
+	{ NULL,	"fanotify N",		"start N workers exercising fanotify events" },
+	{ NULL,	"fanotify-dirs N",	"watch N directories in scaling mode" },
+	{ NULL,	"fanotify-ops N",	"stop fanotify workers after N bogo operations" },
+	{ NULL,	"fanotify-scale",	"measure event throughput and latency over writers" },
+	{ NULL,	"fanotify-writers N",	"sweep from 1 up to N writer processes in scaling mode" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_fanotify_dirs(const char *opt)
+{
+	uint32_t fanotify_dirs;
+
+	fanotify_dirs = stress_get_uint32(opt);
+	stress_check_range("fanotify-dirs", (uint64_t)fanotify_dirs,
+		MIN_FSNOTIFY_SCALE_DIRS, MAX_FSNOTIFY_SCALE_DIRS);
+	return stress_set_setting("fanotify-dirs", TYPE_ID_UINT32, &fanotify_dirs);
+}
+
+static int stress_set_fanotify_scale(const char *opt)
+{
+	return stress_set_setting_true("fanotify-scale", opt);
+}
+
+static int stress_set_fanotify_writers(const char *opt)
+{
+	uint32_t fanotify_writers;
+
+	fanotify_writers = stress_get_uint32(opt);
+	stress_check_range("fanotify-writers", (uint64_t)fanotify_writers,
+		MIN_FSNOTIFY_SCALE_WRITERS, MAX_FSNOTIFY_SCALE_WRITERS);
+	return stress_set_setting("fanotify-writers", TYPE_ID_UINT32, &fanotify_writers);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_fanotify_dirs,	stress_set_fanotify_dirs },
+	{ OPT_fanotify_scale,	stress_set_fanotify_scale },
+	{ OPT_fanotify_writers,	stress_set_fanotify_writers },
+	{ 0,			NULL }
 };
 
 #if defined(HAVE_MNTENT_H) &&		\
@@ -480,6 +516,23 @@ static int stress_fanotify(const stress_args_t *args)
 	pid_t pid;
 	int ret, rc = EXIT_SUCCESS;
 	stress_fanotify_account_t account;
+	uint32_t fanotify_dirs = DEFAULT_FSNOTIFY_SCALE_DIRS;
+	uint32_t fanotify_writers = DEFAULT_FSNOTIFY_SCALE_WRITERS;
+	bool fanotify_scale = false;
+
+	(void)stress_get_setting("fanotify-scale", &fanotify_scale);
+	if (fanotify_scale) {
+		static const int apis[] = {
+			STRESS_FSNOTIFY_FANOTIFY_FD,
+			STRESS_FSNOTIFY_FANOTIFY_FID,
+			STRESS_FSNOTIFY_FANOTIFY_FS,
+		};
+
+		(void)stress_get_setting("fanotify-dirs", &fanotify_dirs);
+		(void)stress_get_setting("fanotify-writers", &fanotify_writers);
+		return stress_fsnotify_scale(args, apis, SIZEOF_ARRAY(apis),
+			fanotify_dirs, fanotify_writers);
+	}
 
 	(void)memset(&account, 0, sizeof(account));
 
@@ -742,12 +795,14 @@ stressor_info_t stress_fanotify_info = {
 	.supported = stress_fanotify_supported,
 	.class = CLASS_FILESYSTEM | CLASS_SCHEDULER | CLASS_OS,
 	.verify = VERIFY_ALWAYS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_fanotify_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_FILESYSTEM | CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without sys/fanotify.h"
 };
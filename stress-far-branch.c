@@ -18,15 +18,30 @@
  */
 #include "stress-ng.h"
 #include "core-arch.h"
+#include "core-perf.h"
 
 static const stress_help_t help[] = {
 	{ NULL,	"far-branch N",		"start N far branching workers" },
 	{ NULL,	"far-branch-ops N",	"stop after N far branching bogo operations" },
+	{ NULL,	"far-branch-sweep",	"sweep code footprint and layout, report iTLB/icache costs" },
 	{ NULL,	NULL,			NULL }
 };
 
 #define PAGE_MULTIPLES	(8)
 
+static int stress_set_far_branch_sweep(const char *opt)
+{
+	bool far_branch_sweep = true;
+
+	(void)opt;
+	return stress_set_setting("far-branch-sweep", TYPE_ID_BOOL, &far_branch_sweep);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_far_branch_sweep,	stress_set_far_branch_sweep },
+	{ 0,			NULL },
+};
+
 #if defined(__BYTE_ORDER__) &&		\
     defined(__ORDER_LITTLE_ENDIAN__)
 #if __BYTE_ORDER__  == __ORDER_LITTLE_ENDIAN__
@@ -271,6 +286,370 @@ use_page:
 	return ptr;
 }
 
+#if (defined(STRESS_ARCH_ARM) && defined(__aarch64__)) ||	\
+    defined(STRESS_ARCH_X86)
+#define HAVE_FAR_BRANCH_SWEEP
+
+#define STRESS_FAR_SWEEP_LINE	(64)		/* Bytes between sequential jumps */
+#define STRESS_FAR_SWEEP_PAGE	(4096)		/* Bytes between scattered jumps */
+#define STRESS_FAR_SWEEP_HUGE	(2 * MB)	/* Transparent huge page size */
+#define STRESS_FAR_SWEEP_MIN	(4 * KB)
+#if defined(STRESS_ARCH_X86)
+#define STRESS_FAR_SWEEP_MAX	(256 * MB)
+#else
+/* aarch64 b instruction can only reach +/- 128MB */
+#define STRESS_FAR_SWEEP_MAX	(128 * MB)
+#endif
+#define STRESS_FAR_SWEEP_TIME	(0.02)		/* Minimum seconds per point */
+#define STRESS_FAR_SWEEP_POINTS	(9)		/* 4K .. 256MB in steps of x4 */
+#define STRESS_FAR_SWEEP_METRIC	(1 * MB)	/* Min footprint for miss metrics */
+#define STRESS_FAR_SWEEP_BATCH	(65536)		/* Min jumps between timer reads */
+
+typedef struct {
+	const char *name;	/* Layout name */
+	const bool scatter;	/* One jump per 4K page in random order */
+	const bool huge;	/* Text mapping backed by 2MB pages */
+} stress_far_sweep_layout_t;
+
+typedef struct {
+	double duration;	/* Total time of timed chain runs */
+	double jumps;		/* Total jumps executed in timed runs */
+	double itlb_misses;	/* iTLB read misses */
+	double l1i_misses;	/* L1 icache read misses */
+} stress_far_sweep_point_t;
+
+static const stress_far_sweep_layout_t far_sweep_layouts[] = {
+	{ "seq-4K",	false,	false },
+	{ "scatter-4K",	true,	false },
+	{ "seq-2M",	false,	true },
+	{ "scatter-2M",	true,	true },
+};
+
+/*
+ *  stress_far_sweep_jmp()
+ *	write an unconditional direct jump at from to the code at to
+ */
+static inline void stress_far_sweep_jmp(uint8_t *from, const uint8_t *to)
+{
+#if defined(STRESS_ARCH_X86)
+	const int32_t rel = (int32_t)(to - (from + 5));
+
+	from[0] = 0xe9;		/* jmp rel32 */
+	(void)memcpy(from + 1, &rel, sizeof(rel));
+#else
+	const uint32_t insn = 0x14000000U |	/* b imm26 */
+		((uint32_t)((to - from) / 4) & 0x03ffffffU);
+
+	(void)memcpy(from, &insn, sizeof(insn));
+#endif
+}
+
+/*
+ *  stress_far_sweep_build()
+ *	write a chain of jumps over footprint bytes of the text
+ *	mapping ending with a return, either one jump per cache line
+ *	in address order or one jump per 4K page at a random cache
+ *	line in a random page order, returns the chain entry point
+ *	and the number of jumps in the chain
+ */
+static uint8_t *stress_far_sweep_build(
+	uint8_t *text,
+	const size_t text_size,
+	const size_t footprint,
+	const bool scatter,
+	size_t *order,
+	size_t *n_jumps)
+{
+	const size_t lines_per_page = STRESS_FAR_SWEEP_PAGE / STRESS_FAR_SWEEP_LINE;
+	size_t i, n;
+	uint8_t *entry, *ptr;
+
+	(void)mprotect((void *)text, text_size, PROT_READ | PROT_WRITE);
+
+	if (scatter) {
+		n = footprint / STRESS_FAR_SWEEP_PAGE;
+		for (i = 0; i < n; i++)
+			order[i] = i;
+		for (i = n - 1; i > 0; i--) {
+			const size_t j = (size_t)stress_mwc32modn((uint32_t)i + 1);
+			const size_t tmp = order[i];
+
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+		for (i = 0; i < n; i++) {
+			order[i] = (order[i] * STRESS_FAR_SWEEP_PAGE) +
+				((size_t)stress_mwc32modn((uint32_t)lines_per_page) * STRESS_FAR_SWEEP_LINE);
+		}
+		for (i = 0; i < n - 1; i++)
+			stress_far_sweep_jmp(text + order[i], text + order[i + 1]);
+		entry = text + order[0];
+		ptr = text + order[n - 1];
+	} else {
+		n = footprint / STRESS_FAR_SWEEP_LINE;
+		for (i = 0; i < n - 1; i++) {
+			ptr = text + (i * STRESS_FAR_SWEEP_LINE);
+			stress_far_sweep_jmp(ptr, ptr + STRESS_FAR_SWEEP_LINE);
+		}
+		entry = text;
+		ptr = text + ((n - 1) * STRESS_FAR_SWEEP_LINE);
+	}
+	(void)memcpy(ptr, ret_opcode.opcodes, ret_opcode.len);
+
+	(void)mprotect((void *)text, text_size, PROT_READ | PROT_EXEC);
+	shim_flush_icache((void *)text, (void *)(text + footprint));
+
+	*n_jumps = n;
+	return entry;
+}
+
+/*
+ *  stress_far_sweep_point()
+ *	run a chain once to warm it up and then time batches of
+ *	runs for at least STRESS_FAR_SWEEP_TIME seconds
+ */
+static void stress_far_sweep_point(
+	const ret_func_t chain,
+	const size_t n_jumps,
+	const int itlb_fd,
+	const int l1i_fd,
+	stress_far_sweep_point_t *point)
+{
+	uint64_t itlb_begin = 0, itlb_end = 0, l1i_begin = 0, l1i_end = 0;
+	/* batch short chains so the timer is not the dominant cost */
+	const size_t batch = STRESS_MAXIMUM(1, STRESS_FAR_SWEEP_BATCH / n_jumps);
+	double t, duration;
+	size_t i, runs = 0;
+
+	chain();
+
+	(void)stress_perf_counter_read(itlb_fd, &itlb_begin);
+	(void)stress_perf_counter_read(l1i_fd, &l1i_begin);
+	t = stress_time_now();
+	do {
+		for (i = 0; i < batch; i++)
+			chain();
+		runs += batch;
+		duration = stress_time_now() - t;
+	} while (duration < STRESS_FAR_SWEEP_TIME);
+	if (stress_perf_counter_read(itlb_fd, &itlb_end))
+		point->itlb_misses += (double)(itlb_end - itlb_begin);
+	if (stress_perf_counter_read(l1i_fd, &l1i_end))
+		point->l1i_misses += (double)(l1i_end - l1i_begin);
+
+	point->duration += duration;
+	point->jumps += (double)runs * (double)n_jumps;
+}
+
+/*
+ *  stress_far_sweep_mmap()
+ *	mmap a 2MB aligned text area of text_size bytes and advise
+ *	the kernel to back it with huge or small pages
+ */
+static uint8_t *stress_far_sweep_mmap(
+	const stress_args_t *args,
+	const size_t text_size,
+	const bool huge,
+	void **map,
+	size_t *map_size)
+{
+	uintptr_t addr;
+
+	*map_size = text_size + STRESS_FAR_SWEEP_HUGE;
+	*map = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (*map == MAP_FAILED)
+		return NULL;
+	addr = ((uintptr_t)*map + STRESS_FAR_SWEEP_HUGE - 1) &
+		~(uintptr_t)(STRESS_FAR_SWEEP_HUGE - 1);
+
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	if (madvise((void *)addr, text_size, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) < 0) {
+		if (args->instance == 0)
+			pr_dbg("%s: madvise %s failed, errno=%d (%s)\n", args->name,
+				huge ? "MADV_HUGEPAGE" : "MADV_NOHUGEPAGE",
+				errno, strerror(errno));
+	}
+#else
+	(void)args;
+	(void)huge;
+#endif
+	return (uint8_t *)addr;
+}
+
+/*
+ *  stress_far_sweep_ns()
+ *	nanoseconds per jump of a sweep point, 0 if not run
+ */
+static inline double stress_far_sweep_ns(const stress_far_sweep_point_t *point)
+{
+	return (point->jumps > 0.0) ?
+		(point->duration * STRESS_DBL_NANOSECOND) / point->jumps : 0.0;
+}
+
+/*
+ *  stress_far_sweep_report()
+ *	report ns per jump and iTLB and L1 icache misses per jump
+ *	for each layout and footprint of the sweep
+ */
+static void stress_far_sweep_report(
+	const stress_args_t *args,
+	stress_far_sweep_point_t points[][STRESS_FAR_SWEEP_POINTS],
+	const size_t n_points,
+	const bool have_perf)
+{
+	size_t i, j, idx = 0;
+	char buf[256];
+
+	if (args->instance == 0) {
+		int len = snprintf(buf, sizeof(buf), "%10s", "footprint");
+
+		for (i = 0; i < SIZEOF_ARRAY(far_sweep_layouts); i++)
+			len += snprintf(buf + len, sizeof(buf) - (size_t)len, " %12s", far_sweep_layouts[i].name);
+		pr_inf("%s: sweep (nanosecs per jump): %s\n", args->name, buf);
+		for (j = 0; j < n_points; j++) {
+			char str[32];
+
+			len = snprintf(buf, sizeof(buf), "%10s",
+				stress_uint64_to_str(str, sizeof(str), (uint64_t)STRESS_FAR_SWEEP_MIN << (2 * j)));
+			for (i = 0; i < SIZEOF_ARRAY(far_sweep_layouts); i++)
+				len += snprintf(buf + len, sizeof(buf) - (size_t)len, " %12.3f",
+					stress_far_sweep_ns(&points[i][j]));
+			pr_inf("%s: sweep (nanosecs per jump): %s\n", args->name, buf);
+		}
+		if (have_perf) {
+			pr_inf("%s: sweep (iTLB/L1i misses per 1000 jumps):\n", args->name);
+			for (j = 0; j < n_points; j++) {
+				char str[32];
+
+				len = snprintf(buf, sizeof(buf), "%10s",
+					stress_uint64_to_str(str, sizeof(str), (uint64_t)STRESS_FAR_SWEEP_MIN << (2 * j)));
+				for (i = 0; i < SIZEOF_ARRAY(far_sweep_layouts); i++) {
+					const stress_far_sweep_point_t *point = &points[i][j];
+					const double scale = (point->jumps > 0.0) ? 1000.0 / point->jumps : 0.0;
+
+					len += snprintf(buf + len, sizeof(buf) - (size_t)len, " %6.1f/%-6.1f",
+						point->itlb_misses * scale, point->l1i_misses * scale);
+				}
+				pr_inf("%s: sweep (iTLB/L1i misses per 1000 jumps): %s\n", args->name, buf);
+			}
+		} else {
+			pr_inf("%s: sweep: iTLB and L1i miss counters not available\n", args->name);
+		}
+	}
+
+	for (i = 0; i < SIZEOF_ARRAY(far_sweep_layouts); i++) {
+		for (j = 0; j < n_points; j++) {
+			const stress_far_sweep_point_t *point = &points[i][j];
+			const size_t footprint = (size_t)STRESS_FAR_SWEEP_MIN << (2 * j);
+			char str[32], desc[64];
+
+			if (point->jumps <= 0.0)
+				continue;
+			(void)stress_uint64_to_str(str, sizeof(str), (uint64_t)footprint);
+			(void)snprintf(desc, sizeof(desc), "nanosecs per jump (%s %s)",
+				far_sweep_layouts[i].name, str);
+			stress_metrics_set(args, idx++, desc, stress_far_sweep_ns(point));
+			if (have_perf && (footprint >= STRESS_FAR_SWEEP_METRIC)) {
+				(void)snprintf(desc, sizeof(desc), "iTLB misses per jump (%s %s)",
+					far_sweep_layouts[i].name, str);
+				stress_metrics_set(args, idx++, desc, point->itlb_misses / point->jumps);
+				(void)snprintf(desc, sizeof(desc), "L1i misses per jump (%s %s)",
+					far_sweep_layouts[i].name, str);
+				stress_metrics_set(args, idx++, desc, point->l1i_misses / point->jumps);
+			}
+		}
+	}
+}
+
+/*
+ *  stress_far_branch_sweep()
+ *	sweep code footprints from 4K to 256MB (128MB on aarch64)
+ *	as chains of direct jumps laid out sequentially or scattered
+ *	one per 4K page in 4K and 2MB page backed text mappings to
+ *	measure the iTLB and instruction cache costs
+ */
+static int stress_far_branch_sweep(const stress_args_t *args)
+{
+	static stress_far_sweep_point_t points[SIZEOF_ARRAY(far_sweep_layouts)][STRESS_FAR_SWEEP_POINTS];
+	size_t text_size, n_points, i, j;
+	size_t *order;
+	int itlb_fd, l1i_fd;
+	bool have_perf;
+
+	/* Find the largest text mapping that can be allocated */
+	for (text_size = STRESS_FAR_SWEEP_MAX; text_size > STRESS_FAR_SWEEP_HUGE; text_size >>= 2) {
+		void *map;
+		size_t map_size;
+
+		if (stress_far_sweep_mmap(args, text_size, false, &map, &map_size)) {
+			(void)munmap(map, map_size);
+			break;
+		}
+	}
+	for (n_points = 0; n_points < STRESS_FAR_SWEEP_POINTS; n_points++) {
+		if (((size_t)STRESS_FAR_SWEEP_MIN << (2 * n_points)) > text_size)
+			break;
+	}
+
+	order = (size_t *)calloc(text_size / STRESS_FAR_SWEEP_PAGE, sizeof(*order));
+	if (!order) {
+		pr_inf_skip("%s: cannot allocate sweep jump order, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(points, 0, sizeof(points));
+
+	itlb_fd = stress_perf_itlb_open();
+	l1i_fd = stress_perf_l1i_open();
+	have_perf = (itlb_fd >= 0) || (l1i_fd >= 0);
+
+	if (args->instance == 0)
+		pr_inf("%s: sweeping code footprints from 4K to %zuMB\n",
+			args->name, (size_t)(text_size / MB));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; keep_stressing_flag() && (i < SIZEOF_ARRAY(far_sweep_layouts)); i++) {
+			const stress_far_sweep_layout_t *layout = &far_sweep_layouts[i];
+			void *map;
+			size_t map_size;
+			uint8_t *text;
+
+			text = stress_far_sweep_mmap(args, text_size, layout->huge, &map, &map_size);
+			if (!text)
+				continue;
+			for (j = 0; keep_stressing_flag() && (j < n_points); j++) {
+				const size_t footprint = (size_t)STRESS_FAR_SWEEP_MIN << (2 * j);
+				size_t n_jumps;
+				uint8_t *entry;
+
+				entry = stress_far_sweep_build(text, text_size, footprint,
+					layout->scatter, order, &n_jumps);
+				stress_far_sweep_point((ret_func_t)entry, n_jumps,
+					itlb_fd, l1i_fd, &points[i][j]);
+			}
+			(void)munmap(map, map_size);
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_far_sweep_report(args, points, n_points, have_perf);
+
+	if (l1i_fd >= 0)
+		(void)close(l1i_fd);
+	if (itlb_fd >= 0)
+		(void)close(itlb_fd);
+	free(order);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_far_branch()
  *	exercise a broad randomized set of branches to functions
@@ -293,6 +672,9 @@ static int stress_far_branch(const stress_args_t *args)
 	NOCLOBBER void **pages = NULL;
 	NOCLOBBER size_t total_funcs = 0;
 	NOCLOBBER double calls = 0.0;
+	bool far_branch_sweep = false;
+
+	(void)stress_get_setting("far-branch-sweep", &far_branch_sweep);
 
 	ret = sigsetjmp(jmp_env, 1);
 	if (ret) {
@@ -348,6 +730,16 @@ static int stress_far_branch(const stress_args_t *args)
 		}
 	}
 
+	if (far_branch_sweep) {
+#if defined(HAVE_FAR_BRANCH_SWEEP)
+		return stress_far_branch_sweep(args);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --far-branch-sweep is only supported on x86 and aarch64, "
+				"using default far branch stressor\n", args->name);
+#endif
+	}
+
 	funcs = calloc(max_funcs, sizeof(*funcs));
 	if (!funcs) {
 		pr_inf_skip("%s: cannot allocate %zu function "
@@ -449,12 +841,14 @@ cleanup:
 stressor_info_t stress_far_branch_info = {
 	.stressor = stress_far_branch,
 	.class = CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_far_branch_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without mprotect() support or architecture not supported"
 };
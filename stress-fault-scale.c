@@ -0,0 +1,632 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#if defined(HAVE_SYS_PRCTL_H)
+#include <sys/prctl.h>
+#endif
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#include <linux/perf_event.h>
+#endif
+
+#define MIN_FAULT_SCALE_THREADS		(1)
+#define MAX_FAULT_SCALE_THREADS		(256)
+
+#define FAULT_SCALE_REGION_SIZE		(4 * MB)	/* per thread region, huge page multiple */
+#define FAULT_SCALE_HUGE_SIZE		(2 * MB)	/* huge page alignment */
+#define FAULT_SCALE_PHASE_USEC		(100000)	/* duration of each thread count */
+#define FAULT_SCALE_SWEEP_MAX		(10)		/* 1, 2, 4 .. 256 and the maximum */
+
+#define FAULT_SCALE_BACKING_ANON	(0)
+#define FAULT_SCALE_BACKING_FILE	(1)
+#define FAULT_SCALE_BACKING_SHMEM	(2)
+
+#define FAULT_SCALE_POPULATE_TOUCH	(0)
+#define FAULT_SCALE_POPULATE_MAP	(1)
+#define FAULT_SCALE_POPULATE_MADV	(2)
+
+static const stress_help_t help[] = {
+	{ NULL,	"fault-scale N",		"start N workers measuring page fault scaling over threads" },
+	{ NULL,	"fault-scale-backing B",	"select backing: anon, file, shmem" },
+	{ NULL,	"fault-scale-ops N",		"stop after N fault-scale thread sweep bogo operations" },
+	{ NULL,	"fault-scale-populate P",	"select fault method: touch, map-populate, madv-populate" },
+	{ NULL,	"fault-scale-thp",		"use transparent huge pages" },
+	{ NULL,	"fault-scale-threads N",	"sweep from 1 up to N threads" },
+	{ NULL,	NULL,				NULL }
+};
+
+static const char * const fault_scale_backings[] = {
+	"anon",
+	"file",
+	"shmem",
+};
+
+typedef struct {
+	const char *name;	/* populate method name */
+	const size_t populate;	/* populate method */
+} stress_fault_scale_populate_t;
+
+static const stress_fault_scale_populate_t fault_scale_populates[] = {
+	{ "touch",		FAULT_SCALE_POPULATE_TOUCH },
+#if defined(MAP_POPULATE)
+	{ "map-populate",	FAULT_SCALE_POPULATE_MAP },
+#endif
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_POPULATE_WRITE)
+	{ "madv-populate",	FAULT_SCALE_POPULATE_MADV },
+#endif
+};
+
+static int stress_set_fault_scale_backing(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(fault_scale_backings); i++) {
+		if (!strcmp(opt, fault_scale_backings[i]))
+			return stress_set_setting("fault-scale-backing", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "fault-scale-backing must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(fault_scale_backings); i++)
+		(void)fprintf(stderr, " %s", fault_scale_backings[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_fault_scale_populate(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(fault_scale_populates); i++) {
+		if (!strcmp(opt, fault_scale_populates[i].name)) {
+			size_t populate = fault_scale_populates[i].populate;
+
+			return stress_set_setting("fault-scale-populate", TYPE_ID_SIZE_T, &populate);
+		}
+	}
+	(void)fprintf(stderr, "fault-scale-populate must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(fault_scale_populates); i++)
+		(void)fprintf(stderr, " %s", fault_scale_populates[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_fault_scale_thp(const char *opt)
+{
+	return stress_set_setting_true("fault-scale-thp", opt);
+}
+
+static int stress_set_fault_scale_threads(const char *opt)
+{
+	uint32_t fault_scale_threads;
+
+	fault_scale_threads = stress_get_uint32(opt);
+	stress_check_range("fault-scale-threads", (uint64_t)fault_scale_threads,
+		MIN_FAULT_SCALE_THREADS, MAX_FAULT_SCALE_THREADS);
+	return stress_set_setting("fault-scale-threads", TYPE_ID_UINT32, &fault_scale_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_fault_scale_backing,	stress_set_fault_scale_backing },
+	{ OPT_fault_scale_populate,	stress_set_fault_scale_populate },
+	{ OPT_fault_scale_thp,		stress_set_fault_scale_thp },
+	{ OPT_fault_scale_threads,	stress_set_fault_scale_threads },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD)
+
+/* state shared by the fault threads */
+typedef struct {
+	const stress_args_t *args;	/* stressor args */
+	size_t backing;			/* anon, file or shmem */
+	size_t populate;		/* touch, map-populate or madv-populate */
+	bool thp;			/* use transparent huge pages */
+	bool verify;			/* check fresh pages are zero */
+	int fd;				/* file backing fd */
+	volatile bool start;		/* threads start faulting */
+	volatile bool stop;		/* threads stop faulting */
+} stress_fault_scale_ctxt_t;
+
+/* per thread state and results */
+typedef struct {
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	stress_fault_scale_ctxt_t *ctxt;/* shared state */
+	size_t slot;			/* file backing slot */
+	double duration;		/* seconds faulting */
+	double cpu_time;		/* cpu seconds faulting */
+	uint64_t faults;		/* page faults */
+	uint64_t cycles;		/* cpu cycles faulting, 0 if not available */
+	bool failed;			/* mapping or verify failed */
+} stress_fault_scale_thread_t;
+
+/* accumulated results for a thread count */
+typedef struct {
+	uint32_t threads;		/* number of threads */
+	double wall;			/* seconds of phases */
+	double cpu_time;		/* cpu seconds of all threads */
+	double faults;			/* page faults of all threads */
+	double thread_rate;		/* sum of per thread faults per second */
+	double thread_phases;		/* number of thread phases */
+	double cycles;			/* cpu cycles of all threads */
+	double cycles_faults;		/* faults of threads with cycles */
+} stress_fault_scale_stats_t;
+
+/*
+ *  stress_fault_scale_perf_open()
+ *	count the user and kernel cpu cycles of the calling thread,
+ *	the kernel cycles are where the fault handling happens so
+ *	no count is used if only user cycles can be counted
+ */
+static int stress_fault_scale_perf_open(void)
+{
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static inline uint64_t stress_fault_scale_perf_read(const int fd)
+{
+	uint64_t count = 0;
+
+	if ((fd < 0) || (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)))
+		return 0;
+	return count;
+}
+
+/*
+ *  stress_fault_scale_faults()
+ *	page faults of the calling thread
+ */
+static uint64_t stress_fault_scale_faults(void)
+{
+#if defined(RUSAGE_THREAD)
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_THREAD, &usage) == 0)
+		return (uint64_t)usage.ru_minflt + (uint64_t)usage.ru_majflt;
+#endif
+	return 0;
+}
+
+/*
+ *  stress_fault_scale_cpu_time()
+ *	cpu time of the calling thread, falls back to the wall
+ *	clock if there is no per thread cpu clock
+ */
+static double stress_fault_scale_cpu_time(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return (double)ts.tv_sec + ((double)ts.tv_nsec / STRESS_DBL_NANOSECOND);
+#endif
+	return stress_time_now();
+}
+
+/*
+ *  stress_fault_scale_map()
+ *	map a fresh region for the thread, huge page regions are
+ *	mapped at a huge page aligned address inside a reservation
+ */
+static uint8_t *stress_fault_scale_map(
+	stress_fault_scale_thread_t *thread,
+	void **map,
+	size_t *map_size)
+{
+	const stress_fault_scale_ctxt_t *ctxt = thread->ctxt;
+	int flags, fd = -1;
+	off_t offset = 0;
+	uint8_t *ptr;
+
+	switch (ctxt->backing) {
+	case FAULT_SCALE_BACKING_FILE:
+		flags = MAP_SHARED;
+		fd = ctxt->fd;
+		offset = (off_t)(thread->slot * FAULT_SCALE_REGION_SIZE);
+		break;
+	case FAULT_SCALE_BACKING_SHMEM:
+		flags = MAP_SHARED | MAP_ANONYMOUS;
+		break;
+	default:
+		flags = MAP_PRIVATE | MAP_ANONYMOUS;
+		break;
+	}
+#if defined(MAP_POPULATE)
+	if (ctxt->populate == FAULT_SCALE_POPULATE_MAP)
+		flags |= MAP_POPULATE;
+#endif
+
+	if (!ctxt->thp) {
+		*map_size = FAULT_SCALE_REGION_SIZE;
+		*map = mmap(NULL, *map_size, PROT_READ | PROT_WRITE, flags, fd, offset);
+		if (*map == MAP_FAILED)
+			return NULL;
+		ptr = (uint8_t *)*map;
+	} else {
+#if defined(MAP_FIXED)
+		*map_size = FAULT_SCALE_REGION_SIZE + FAULT_SCALE_HUGE_SIZE;
+		*map = mmap(NULL, *map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (*map == MAP_FAILED)
+			return NULL;
+		ptr = (uint8_t *)(((uintptr_t)*map + FAULT_SCALE_HUGE_SIZE - 1) &
+			~(uintptr_t)(FAULT_SCALE_HUGE_SIZE - 1));
+		if (mmap((void *)ptr, FAULT_SCALE_REGION_SIZE, PROT_READ | PROT_WRITE,
+			 flags | MAP_FIXED, fd, offset) == MAP_FAILED) {
+			(void)munmap(*map, *map_size);
+			return NULL;
+		}
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+		(void)shim_madvise((void *)ptr, FAULT_SCALE_REGION_SIZE, MADV_HUGEPAGE);
+#endif
+#else
+		return NULL;
+#endif
+	}
+
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_POPULATE_WRITE)
+	if ((ctxt->populate == FAULT_SCALE_POPULATE_MADV) &&
+	    (shim_madvise((void *)ptr, FAULT_SCALE_REGION_SIZE, MADV_POPULATE_WRITE) < 0)) {
+		(void)munmap(*map, *map_size);
+		return NULL;
+	}
+#endif
+	return ptr;
+}
+
+/*
+ *  stress_fault_scale_thread()
+ *	repeatedly map a fresh region, fault in all the pages and
+ *	unmap it until told to stop
+ */
+static void *stress_fault_scale_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_fault_scale_thread_t *thread = (stress_fault_scale_thread_t *)arg;
+	stress_fault_scale_ctxt_t *ctxt = thread->ctxt;
+	const size_t page_size = ctxt->args->page_size;
+	uint64_t faults, cycles, pages = 0;
+	int fd;
+	double t, t_cpu;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	fd = stress_fault_scale_perf_open();
+	while (!ctxt->start && !ctxt->stop)
+		shim_sched_yield();
+
+	cycles = stress_fault_scale_perf_read(fd);
+	faults = stress_fault_scale_faults();
+	t_cpu = stress_fault_scale_cpu_time();
+	t = stress_time_now();
+	while (!ctxt->stop) {
+		void *map;
+		size_t map_size;
+		uint8_t *ptr, *end;
+
+		ptr = stress_fault_scale_map(thread, &map, &map_size);
+		if (UNLIKELY(!ptr)) {
+			thread->failed = true;
+			break;
+		}
+		end = ptr + FAULT_SCALE_REGION_SIZE;
+		if (ctxt->verify) {
+			for (; ptr < end; ptr += page_size) {
+				if (UNLIKELY(*(volatile uint8_t *)ptr != 0))
+					thread->failed = true;
+				*(volatile uint8_t *)ptr = 1;
+			}
+		} else {
+			for (; ptr < end; ptr += page_size)
+				*(volatile uint8_t *)ptr = 1;
+		}
+		(void)munmap(map, map_size);
+		pages += FAULT_SCALE_REGION_SIZE / page_size;
+#if defined(FALLOC_FL_KEEP_SIZE) &&	\
+    defined(FALLOC_FL_PUNCH_HOLE)
+		/* drop the page cache pages so the next pages are fresh */
+		if (ctxt->backing == FAULT_SCALE_BACKING_FILE)
+			(void)shim_fallocate(ctxt->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				(off_t)(thread->slot * FAULT_SCALE_REGION_SIZE),
+				(off_t)FAULT_SCALE_REGION_SIZE);
+#endif
+	}
+	thread->duration = stress_time_now() - t;
+	thread->cpu_time = stress_fault_scale_cpu_time() - t_cpu;
+	thread->faults = stress_fault_scale_faults() - faults;
+	/* no per thread fault counts, assume a fault per page */
+	if (thread->faults == 0)
+		thread->faults = pages;
+	thread->cycles = (fd >= 0) ? stress_fault_scale_perf_read(fd) - cycles : 0;
+	if (fd >= 0)
+		(void)close(fd);
+
+	return &nowt;
+}
+
+/*
+ *  stress_fault_scale_phase()
+ *	run n threads faulting for FAULT_SCALE_PHASE_USEC and add
+ *	the results to stats, returns false if a thread failed
+ */
+static bool stress_fault_scale_phase(
+	stress_fault_scale_ctxt_t *ctxt,
+	stress_fault_scale_thread_t *threads,
+	const uint32_t n,
+	stress_fault_scale_stats_t *stats)
+{
+	uint32_t i, started = 0;
+	bool ok = true;
+	double t;
+
+	ctxt->start = false;
+	ctxt->stop = false;
+	for (i = 0; i < n; i++) {
+		threads[i].ctxt = ctxt;
+		threads[i].slot = i;
+		threads[i].duration = 0.0;
+		threads[i].cpu_time = 0.0;
+		threads[i].faults = 0;
+		threads[i].cycles = 0;
+		threads[i].failed = false;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_fault_scale_thread, (void *)&threads[i]);
+		if (threads[i].ret == 0)
+			started++;
+	}
+	if (started == n) {
+		t = stress_time_now();
+		ctxt->start = true;
+		(void)shim_usleep(FAULT_SCALE_PHASE_USEC);
+		ctxt->stop = true;
+		t = stress_time_now() - t;
+	} else {
+		ctxt->stop = true;
+		t = 0.0;
+	}
+	for (i = 0; i < n; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	if (started != n)
+		return true;
+
+	for (i = 0; i < n; i++) {
+		const stress_fault_scale_thread_t *thread = &threads[i];
+
+		if (thread->failed)
+			ok = false;
+		stats->cpu_time += thread->cpu_time;
+		stats->faults += (double)thread->faults;
+		if (thread->duration > 0.0)
+			stats->thread_rate += (double)thread->faults / thread->duration;
+		if (thread->cycles > 0) {
+			stats->cycles += (double)thread->cycles;
+			stats->cycles_faults += (double)thread->faults;
+		}
+	}
+	stats->wall += t;
+	stats->thread_phases += (double)n;
+
+	return ok;
+}
+
+/*
+ *  stress_fault_scale_report()
+ *	print the fault rates and costs over the thread counts
+ */
+static void stress_fault_scale_report(
+	const stress_args_t *args,
+	const stress_fault_scale_stats_t *stats,
+	const size_t n_counts)
+{
+	const double base = (stats[0].thread_phases > 0.0) ? stats[0].thread_rate / stats[0].thread_phases : 0.0;
+	size_t i;
+
+	pr_lock();
+	pr_inf("%s: %7s %14s %14s %9s %10s %12s\n", args->name,
+		"threads", "faults/sec", "faults/sec/thr", "scaling %",
+		"ns/fault", "cycles/fault");
+	for (i = 0; i < n_counts; i++) {
+		const stress_fault_scale_stats_t *s = &stats[i];
+		const double per_thread = (s->thread_phases > 0.0) ? s->thread_rate / s->thread_phases : 0.0;
+		char cycles[16];
+
+		if ((s->wall <= 0.0) || (s->faults <= 0.0))
+			continue;
+		if (s->cycles_faults > 0.0)
+			(void)snprintf(cycles, sizeof(cycles), "%12.1f", s->cycles / s->cycles_faults);
+		else
+			shim_strlcpy(cycles, "n/a", sizeof(cycles));
+		pr_inf("%s: %7" PRIu32 " %14.0f %14.0f %9.2f %10.1f %12s\n", args->name,
+			s->threads, s->faults / s->wall, per_thread,
+			(base > 0.0) ? 100.0 * per_thread / base : 0.0,
+			STRESS_DBL_NANOSECOND * s->cpu_time / s->faults, cycles);
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_fault_scale()
+ *	measure page fault throughput as the number of threads
+ *	faulting in one address space grows
+ */
+static int stress_fault_scale(const stress_args_t *args)
+{
+	stress_fault_scale_stats_t stats[FAULT_SCALE_SWEEP_MAX];
+	stress_fault_scale_thread_t *threads;
+	stress_fault_scale_ctxt_t context, *ctxt = &context;
+	uint32_t fault_scale_threads, n;
+	size_t i, n_counts = 0, idx = 0;
+	char filename[PATH_MAX];
+	int rc = EXIT_SUCCESS;
+	bool fault_scale_thp = false;
+
+	(void)memset(ctxt, 0, sizeof(*ctxt));
+	ctxt->args = args;
+	ctxt->backing = FAULT_SCALE_BACKING_ANON;
+	ctxt->populate = FAULT_SCALE_POPULATE_TOUCH;
+	ctxt->fd = -1;
+	ctxt->verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	(void)stress_get_setting("fault-scale-backing", &ctxt->backing);
+	(void)stress_get_setting("fault-scale-populate", &ctxt->populate);
+	(void)stress_get_setting("fault-scale-thp", &fault_scale_thp);
+	ctxt->thp = fault_scale_thp;
+
+	fault_scale_threads = (uint32_t)STRESS_MAXIMUM(stress_get_processors_online(), 1);
+	if (!stress_get_setting("fault-scale-threads", &fault_scale_threads)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			fault_scale_threads = MAX_FAULT_SCALE_THREADS;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			fault_scale_threads = MIN_FAULT_SCALE_THREADS;
+	}
+	fault_scale_threads = STRESS_MINIMUM(fault_scale_threads, MAX_FAULT_SCALE_THREADS);
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (n = 1; (n < fault_scale_threads) && (n_counts < FAULT_SCALE_SWEEP_MAX - 1); n <<= 1)
+		stats[n_counts++].threads = n;
+	stats[n_counts++].threads = fault_scale_threads;
+
+	threads = (stress_fault_scale_thread_t *)calloc(fault_scale_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " threads, skipping stressor\n",
+			args->name, fault_scale_threads);
+		return EXIT_NO_RESOURCE;
+	}
+
+	if (ctxt->backing == FAULT_SCALE_BACKING_FILE) {
+		int ret;
+
+		ret = stress_temp_dir_mk_args(args);
+		if (ret < 0) {
+			rc = stress_exit_status(-ret);
+			goto free_threads;
+		}
+		(void)stress_temp_filename_args(args, filename, sizeof(filename), stress_mwc32());
+		ctxt->fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+		if (ctxt->fd < 0) {
+			rc = stress_exit_status(errno);
+			pr_fail("%s: open %s failed, errno=%d (%s)\n",
+				args->name, filename, errno, strerror(errno));
+			(void)stress_temp_dir_rm_args(args);
+			goto free_threads;
+		}
+		(void)shim_unlink(filename);
+		if (ftruncate(ctxt->fd, (off_t)(fault_scale_threads * FAULT_SCALE_REGION_SIZE)) < 0) {
+			pr_inf_skip("%s: ftruncate failed, errno=%d (%s), skipping stressor\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_NO_RESOURCE;
+			goto close_file;
+		}
+	}
+
+#if defined(HAVE_SYS_PRCTL_H) &&	\
+    defined(PR_SET_THP_DISABLE)
+	/* keep small page runs on small pages if THP is always enabled */
+	if (!ctxt->thp)
+		(void)prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0);
+#endif
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; keep_stressing(args) && (i < n_counts); i++) {
+			if (!stress_fault_scale_phase(ctxt, threads, stats[i].threads, &stats[i])) {
+				pr_fail("%s: %s mapping failed or a fresh page was not zero "
+					"with %" PRIu32 " threads\n", args->name,
+					fault_scale_backings[ctxt->backing], stats[i].threads);
+				rc = EXIT_FAILURE;
+				break;
+			}
+		}
+		inc_counter(args);
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_fault_scale_report(args, stats, n_counts);
+
+	for (i = 0; i < n_counts; i++) {
+		const stress_fault_scale_stats_t *s = &stats[i];
+		char str[64];
+
+		if ((s->wall <= 0.0) || (s->faults <= 0.0))
+			continue;
+		(void)snprintf(str, sizeof(str), "faults per sec (%" PRIu32 " threads)", s->threads);
+		stress_metrics_set(args, idx++, str, s->faults / s->wall);
+		(void)snprintf(str, sizeof(str), "faults per sec per thread (%" PRIu32 " threads)", s->threads);
+		stress_metrics_set(args, idx++, str, s->thread_rate / s->thread_phases);
+		(void)snprintf(str, sizeof(str), "nanosecs per fault (%" PRIu32 " threads)", s->threads);
+		stress_metrics_set(args, idx++, str, STRESS_DBL_NANOSECOND * s->cpu_time / s->faults);
+		if (s->cycles_faults > 0.0) {
+			(void)snprintf(str, sizeof(str), "cycles per fault (%" PRIu32 " threads)", s->threads);
+			stress_metrics_set(args, idx++, str, s->cycles / s->cycles_faults);
+		}
+	}
+
+close_file:
+	if (ctxt->fd >= 0) {
+		(void)close(ctxt->fd);
+		(void)stress_temp_dir_rm_args(args);
+	}
+free_threads:
+	free(threads);
+
+	return rc;
+}
+
+stressor_info_t stress_fault_scale_info = {
+	.stressor = stress_fault_scale,
+	.class = CLASS_VM | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
+#else
+stressor_info_t stress_fault_scale_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_VM | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help,
+	.unimplemented_reason = "built without pthread support"
+};
+#endif
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-asm-arm.h"
+#include "core-asm-ppc64.h"
+#include "core-asm-riscv.h"
+#include "core-asm-x86.h"
+#include "core-put.h"
+
+#if defined(HAVE_LINUX_MEMBARRIER_H)
+#include <linux/membarrier.h>
+#endif
+
+#define FENCE_LOOPS		(4096)		/* barriers per timed loop */
+#define FENCE_ROUNDS		(16)		/* timed loops per barrier per bogo op */
+#define FENCE_DATA_SIZE		(64)		/* words of loop data, power of 2 */
+#define FENCE_DATA_MASK		(FENCE_DATA_SIZE - 1)
+#define FENCE_ASYM_USEC		(20000)		/* duration of asymmetric sync phases */
+
+static const stress_help_t help[] = {
+	{ NULL,	"fence N",	"start N workers measuring memory barrier costs" },
+	{ NULL,	"fence-ops N",	"stop after N fence bogo operations" },
+	{ NULL,	NULL,		NULL }
+};
+
+#if defined(HAVE_ATOMIC) &&		\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE)
+
+/* atomic operation target, on its own cache line */
+static uint64_t fence_atomic ALIGN64;
+
+#define FENCE_NONE()		do { } while (0)
+#define FENCE_COMPILER()	__asm__ __volatile__("" : : : "memory")
+
+/*
+ *  STRESS_FENCE_FUNCS()
+ *	generate functions that time FENCE_LOOPS iterations with a
+ *	barrier in a dependent stream, where each load address depends
+ *	on the previous load, and in an independent stream of loads and
+ *	stores that the cpu can overlap
+ */
+#define STRESS_FENCE_FUNCS(name, barrier)				\
+static uint64_t OPTIMIZE3 stress_fence_ ## name ## _dep(		\
+	volatile uint64_t *data, double *duration)			\
+{									\
+	register uint64_t val = 0;					\
+	register uint32_t i;						\
+	double t;							\
+									\
+	t = stress_time_now();						\
+	for (i = 0; i < FENCE_LOOPS; i++) {				\
+		val = data[val & FENCE_DATA_MASK] + i;			\
+		barrier;						\
+	}								\
+	(*duration) += stress_time_now() - t;				\
+	return val;							\
+}									\
+									\
+static uint64_t OPTIMIZE3 stress_fence_ ## name ## _indep(		\
+	volatile uint64_t *data, double *duration)			\
+{									\
+	register uint64_t val = 0;					\
+	register uint32_t i;						\
+	double t;							\
+									\
+	t = stress_time_now();						\
+	for (i = 0; i < FENCE_LOOPS; i++) {				\
+		val += data[i & FENCE_DATA_MASK];			\
+		data[(i + (FENCE_DATA_SIZE / 2)) & FENCE_DATA_MASK] = i;\
+		barrier;						\
+	}								\
+	(*duration) += stress_time_now() - t;				\
+	return val;							\
+}
+
+STRESS_FENCE_FUNCS(none, FENCE_NONE())
+STRESS_FENCE_FUNCS(compiler, FENCE_COMPILER())
+STRESS_FENCE_FUNCS(fence_acq_rel, __atomic_thread_fence(__ATOMIC_ACQ_REL))
+STRESS_FENCE_FUNCS(fence_seq_cst, __atomic_thread_fence(__ATOMIC_SEQ_CST))
+STRESS_FENCE_FUNCS(fetch_add_relaxed, (void)__atomic_fetch_add(&fence_atomic, 1, __ATOMIC_RELAXED))
+STRESS_FENCE_FUNCS(fetch_add_acq_rel, (void)__atomic_fetch_add(&fence_atomic, 1, __ATOMIC_ACQ_REL))
+STRESS_FENCE_FUNCS(fetch_add_seq_cst, (void)__atomic_fetch_add(&fence_atomic, 1, __ATOMIC_SEQ_CST))
+STRESS_FENCE_FUNCS(store_release, __atomic_store_n(&fence_atomic, i, __ATOMIC_RELEASE))
+STRESS_FENCE_FUNCS(store_seq_cst, __atomic_store_n(&fence_atomic, i, __ATOMIC_SEQ_CST))
+#if defined(HAVE_ASM_X86_LFENCE)
+STRESS_FENCE_FUNCS(lfence, stress_asm_x86_lfence())
+#endif
+#if defined(HAVE_ASM_X86_SFENCE)
+STRESS_FENCE_FUNCS(sfence, stress_asm_x86_sfence())
+#endif
+#if defined(HAVE_ASM_X86_MFENCE)
+STRESS_FENCE_FUNCS(mfence, stress_asm_x86_mfence())
+#endif
+#if defined(STRESS_ARCH_X86)
+/* locked add of zero, a full barrier that is often cheaper than mfence */
+static int fence_lock_add ALIGN64;
+
+STRESS_FENCE_FUNCS(lock_add, stress_asm_x86_lock_add(&fence_lock_add, 0); FENCE_COMPILER())
+#endif
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(HAVE_ASM_ARM_DMB_ISH)
+STRESS_FENCE_FUNCS(dmb_ish, stress_asm_arm_dmb_ish())
+#endif
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(HAVE_ASM_ARM_DSB_ISH)
+STRESS_FENCE_FUNCS(dsb_ish, stress_asm_arm_dsb_ish())
+#endif
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(HAVE_ASM_ARM_ISB)
+STRESS_FENCE_FUNCS(isb, stress_asm_arm_isb())
+#endif
+#if defined(STRESS_ARCH_PPC64) &&	\
+    defined(HAVE_ASM_PPC64_MSYNC)
+STRESS_FENCE_FUNCS(msync, stress_asm_ppc64_msync())
+#endif
+#if defined(STRESS_ARCH_RISCV) &&	\
+    defined(HAVE_ASM_RISCV_FENCE)
+STRESS_FENCE_FUNCS(riscv_fence, stress_asm_riscv_fence())
+#endif
+
+typedef uint64_t (*stress_fence_func_t)(volatile uint64_t *data, double *duration);
+
+typedef struct {
+	const char *name;		/* barrier name */
+	stress_fence_func_t dep;	/* dependent stream */
+	stress_fence_func_t indep;	/* independent stream */
+} stress_fence_t;
+
+#define STRESS_FENCE(name, str)	\
+	{ str, stress_fence_ ## name ## _dep, stress_fence_ ## name ## _indep }
+
+static const stress_fence_t fences[] = {
+	STRESS_FENCE(none, "none"),	/* baseline, must be first */
+	STRESS_FENCE(compiler, "compiler"),
+	STRESS_FENCE(fence_acq_rel, "fence-acq-rel"),
+	STRESS_FENCE(fence_seq_cst, "fence-seq-cst"),
+	STRESS_FENCE(fetch_add_relaxed, "fetch-add-relaxed"),
+	STRESS_FENCE(fetch_add_acq_rel, "fetch-add-acq-rel"),
+	STRESS_FENCE(fetch_add_seq_cst, "fetch-add-seq-cst"),
+	STRESS_FENCE(store_release, "store-release"),
+	STRESS_FENCE(store_seq_cst, "store-seq-cst"),
+#if defined(HAVE_ASM_X86_LFENCE)
+	STRESS_FENCE(lfence, "lfence"),
+#endif
+#if defined(HAVE_ASM_X86_SFENCE)
+	STRESS_FENCE(sfence, "sfence"),
+#endif
+#if defined(HAVE_ASM_X86_MFENCE)
+	STRESS_FENCE(mfence, "mfence"),
+#endif
+#if defined(STRESS_ARCH_X86)
+	STRESS_FENCE(lock_add, "lock-add"),
+#endif
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(HAVE_ASM_ARM_DMB_ISH)
+	STRESS_FENCE(dmb_ish, "dmb-ish"),
+#endif
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(HAVE_ASM_ARM_DSB_ISH)
+	STRESS_FENCE(dsb_ish, "dsb-ish"),
+#endif
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(HAVE_ASM_ARM_ISB)
+	STRESS_FENCE(isb, "isb"),
+#endif
+#if defined(STRESS_ARCH_PPC64) &&	\
+    defined(HAVE_ASM_PPC64_MSYNC)
+	STRESS_FENCE(msync, "msync"),
+#endif
+#if defined(STRESS_ARCH_RISCV) &&	\
+    defined(HAVE_ASM_RISCV_FENCE)
+	STRESS_FENCE(riscv_fence, "fence"),
+#endif
+};
+
+#define FENCE_MAX	(SIZEOF_ARRAY(fences))
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_LINUX_MEMBARRIER_H) &&	\
+    defined(__NR_membarrier)
+#define HAVE_FENCE_ASYM
+
+/*
+ *  asymmetric synchronization, the fast path reader publishes that it
+ *  is in a read side section and then reads shared data, Dekker style,
+ *  so the store must be ordered before the load. The reader either
+ *  pays for a full fence in every section, or uses a compiler barrier
+ *  and the rare writer forces the ordering with a membarrier() that
+ *  IPIs the cpus running the reader threads
+ */
+typedef struct {
+	uint64_t in_section ALIGN64;	/* reader is in a read side section */
+	uint64_t data ALIGN64;		/* data read in the section */
+	bool stop ALIGN64;		/* stop the reader */
+	bool fence;			/* reader uses a full fence */
+	double duration;		/* reader time */
+	uint64_t sections;		/* read side sections */
+} stress_fence_asym_t;
+
+static void *stress_fence_asym_reader(void *arg)
+{
+	static void *nowt = NULL;
+	stress_fence_asym_t *asym = (stress_fence_asym_t *)arg;
+	uint64_t sections = 0, val = 0;
+	double t;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	t = stress_time_now();
+	if (asym->fence) {
+		while (!__atomic_load_n(&asym->stop, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&asym->in_section, 1, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			val += __atomic_load_n(&asym->data, __ATOMIC_RELAXED);
+			__atomic_store_n(&asym->in_section, 0, __ATOMIC_RELEASE);
+			sections++;
+		}
+	} else {
+		while (!__atomic_load_n(&asym->stop, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&asym->in_section, 1, __ATOMIC_RELAXED);
+			FENCE_COMPILER();
+			val += __atomic_load_n(&asym->data, __ATOMIC_RELAXED);
+			__atomic_store_n(&asym->in_section, 0, __ATOMIC_RELEASE);
+			sections++;
+		}
+	}
+	asym->duration = stress_time_now() - t;
+	asym->sections = sections;
+	stress_uint64_put(val);
+
+	return &nowt;
+}
+
+/*
+ *  stress_fence_asym()
+ *	run a reader thread for FENCE_ASYM_USEC, with membarrier the
+ *	writer (this thread) issues membarrier calls for the duration,
+ *	returns false if the reader could not be run
+ */
+static bool stress_fence_asym(
+	stress_fence_asym_t *asym,
+	const bool membarrier,
+	double *mb_duration,
+	double *mb_count)
+{
+	pthread_t pthread;
+	double t, t_end;
+
+	asym->in_section = 0;
+	asym->data = 0;
+	asym->stop = false;
+	asym->fence = !membarrier;
+	asym->duration = 0.0;
+	asym->sections = 0;
+
+	if (pthread_create(&pthread, NULL, stress_fence_asym_reader, (void *)asym))
+		return false;
+
+	t = stress_time_now();
+	t_end = t + ((double)FENCE_ASYM_USEC / STRESS_DBL_MICROSECOND);
+	if (membarrier) {
+		double count = 0.0;
+
+		do {
+			/* writer update, then wait for readers to see it */
+			__atomic_store_n(&asym->data, (uint64_t)count, __ATOMIC_RELAXED);
+			if (shim_membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0) < 0)
+				break;
+			count += 1.0;
+		} while (stress_time_now() < t_end);
+		*mb_duration += stress_time_now() - t;
+		*mb_count += count;
+	} else {
+		(void)shim_usleep(FENCE_ASYM_USEC);
+	}
+	__atomic_store_n(&asym->stop, true, __ATOMIC_RELAXED);
+	(void)pthread_join(pthread, NULL);
+
+	return true;
+}
+#endif
+
+/*
+ *  stress_fence()
+ *	measure the cost of memory barriers
+ */
+static int stress_fence(const stress_args_t *args)
+{
+	static uint64_t data[FENCE_DATA_SIZE] ALIGN64;
+	double dep[FENCE_MAX], indep[FENCE_MAX];
+	size_t i, j, idx = 0;
+	double loops = 0.0;
+	char str[64];
+#if defined(HAVE_FENCE_ASYM)
+	stress_fence_asym_t *asym;
+	double fence_duration = 0.0, fence_sections = 0.0;
+	double compiler_duration = 0.0, compiler_sections = 0.0;
+	double mb_duration = 0.0, mb_count = 0.0;
+	bool asym_ok;
+#endif
+
+	for (i = 0; i < FENCE_DATA_SIZE; i++)
+		data[i] = i;
+	for (i = 0; i < FENCE_MAX; i++) {
+		dep[i] = 0.0;
+		indep[i] = 0.0;
+	}
+
+#if defined(HAVE_FENCE_ASYM)
+	asym = (stress_fence_asym_t *)mmap(NULL, sizeof(*asym), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	asym_ok = (asym != MAP_FAILED) &&
+		  (shim_membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0);
+	if (!asym_ok && (args->instance == 0))
+		pr_inf("%s: membarrier MEMBARRIER_CMD_PRIVATE_EXPEDITED not available, "
+			"skipping asymmetric synchronization measurements\n", args->name);
+#endif
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (j = 0; j < FENCE_ROUNDS; j++) {
+			for (i = 0; i < FENCE_MAX; i++) {
+				stress_uint64_put(fences[i].dep(data, &dep[i]));
+				stress_uint64_put(fences[i].indep(data, &indep[i]));
+			}
+		}
+		loops += (double)(FENCE_ROUNDS * FENCE_LOOPS);
+#if defined(HAVE_FENCE_ASYM)
+		if (asym_ok) {
+			if (stress_fence_asym(asym, false, &mb_duration, &mb_count)) {
+				fence_duration += asym->duration;
+				fence_sections += (double)asym->sections;
+			}
+			if (stress_fence_asym(asym, true, &mb_duration, &mb_count)) {
+				compiler_duration += asym->duration;
+				compiler_sections += (double)asym->sections;
+			}
+		}
+#endif
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	/* barrier cost over the no barrier baseline */
+	for (i = 1; i < FENCE_MAX; i++) {
+		const double ns_dep = STRESS_DBL_NANOSECOND * (dep[i] - dep[0]) / loops;
+		const double ns_indep = STRESS_DBL_NANOSECOND * (indep[i] - indep[0]) / loops;
+
+		(void)snprintf(str, sizeof(str), "%s ns (dependent)", fences[i].name);
+		stress_metrics_set(args, idx++, str, STRESS_MAXIMUM(ns_dep, 0.0));
+		(void)snprintf(str, sizeof(str), "%s ns (independent)", fences[i].name);
+		stress_metrics_set(args, idx++, str, STRESS_MAXIMUM(ns_indep, 0.0));
+	}
+
+#if defined(HAVE_FENCE_ASYM)
+	if (asym_ok) {
+		if (fence_sections > 0.0)
+			stress_metrics_set(args, idx++, "reader fence ns per section",
+				STRESS_DBL_NANOSECOND * fence_duration / fence_sections);
+		if (compiler_sections > 0.0)
+			stress_metrics_set(args, idx++, "reader compiler ns per section",
+				STRESS_DBL_NANOSECOND * compiler_duration / compiler_sections);
+		if (mb_count > 0.0)
+			stress_metrics_set(args, idx++, "membarrier ns per call",
+				STRESS_DBL_NANOSECOND * mb_duration / mb_count);
+	}
+	if (asym != MAP_FAILED)
+		(void)munmap((void *)asym, sizeof(*asym));
+#endif
+
+	return EXIT_SUCCESS;
+}
+
+stressor_info_t stress_fence_info = {
+	.stressor = stress_fence,
+	.class = CLASS_CPU | CLASS_MEMORY,
+	.help = help
+};
+#else
+stressor_info_t stress_fence_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_CPU | CLASS_MEMORY,
+	.help = help,
+	.unimplemented_reason = "built without gcc __atomic builtin functions"
+};
+#endif
@@ -0,0 +1,772 @@
+/*
+ * Copyright (C) 2023 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-uring.h"
+#include "io-uring.h"
+
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define MIN_FILESCAN_BYTES	(1 * MB)
+#define MAX_FILESCAN_BYTES	(MAX_FILE_LIMIT)
+#define DEFAULT_FILESCAN_BYTES	(256 * MB)
+
+#define MIN_FILESCAN_CHUNK	(4 * KB)
+#define MAX_FILESCAN_CHUNK	(64 * MB)
+#define DEFAULT_FILESCAN_CHUNK	(1 * MB)
+
+#define MIN_FILESCAN_THREADS	(1)
+#define MAX_FILESCAN_THREADS	(64)
+#define DEFAULT_FILESCAN_THREADS (1)
+
+#define FILESCAN_URING_DEPTH	(4)	/* io_uring reads in flight per thread */
+
+#define FILESCAN_METHOD_MMAP	(0)
+#define FILESCAN_METHOD_READ	(1)
+#define FILESCAN_METHOD_DIRECT	(2)
+#define FILESCAN_METHOD_URING	(3)
+#define FILESCAN_METHODS	(4)
+#define FILESCAN_METHOD_ALL	(-1)
+
+typedef struct {
+	const char *name;
+	const int method;
+} stress_filescan_method_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"filescan N",		"start N workers scanning a file with mmap, read, direct I/O and io_uring" },
+	{ NULL,	"filescan-bytes N",	"size of file to scan" },
+	{ NULL,	"filescan-chunk N",	"size of each read or mmap scan step" },
+	{ NULL,	"filescan-method M",	"scan method [all|mmap|read|direct|uring]" },
+	{ NULL,	"filescan-ops N",	"stop after N chunks are scanned" },
+	{ NULL,	"filescan-threads N",	"number of threads scanning the file" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const stress_filescan_method_t filescan_methods[] = {
+	{ "all",	FILESCAN_METHOD_ALL },
+	{ "mmap",	FILESCAN_METHOD_MMAP },
+	{ "read",	FILESCAN_METHOD_READ },
+	{ "direct",	FILESCAN_METHOD_DIRECT },
+	{ "uring",	FILESCAN_METHOD_URING },
+};
+
+static int stress_set_filescan_bytes(const char *opt)
+{
+	uint64_t filescan_bytes;
+
+	filescan_bytes = stress_get_uint64_byte_filesystem(opt, 1);
+	stress_check_range_bytes("filescan-bytes", filescan_bytes,
+		MIN_FILESCAN_BYTES, MAX_FILESCAN_BYTES);
+	return stress_set_setting("filescan-bytes", TYPE_ID_UINT64, &filescan_bytes);
+}
+
+static int stress_set_filescan_chunk(const char *opt)
+{
+	uint64_t filescan_chunk;
+	size_t chunk;
+
+	filescan_chunk = stress_get_uint64_byte(opt);
+	stress_check_power_of_2("filescan-chunk", filescan_chunk,
+		MIN_FILESCAN_CHUNK, MAX_FILESCAN_CHUNK);
+	chunk = (size_t)filescan_chunk;
+	return stress_set_setting("filescan-chunk", TYPE_ID_SIZE_T, &chunk);
+}
+
+/*
+ *  stress_set_filescan_method()
+ *	set the scan method
+ */
+static int stress_set_filescan_method(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(filescan_methods); i++) {
+		if (!strcmp(opt, filescan_methods[i].name))
+			return stress_set_setting("filescan-method", TYPE_ID_INT, &filescan_methods[i].method);
+	}
+	(void)fprintf(stderr, "filescan-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(filescan_methods); i++)
+		(void)fprintf(stderr, " %s", filescan_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_filescan_threads(const char *opt)
+{
+	int filescan_threads;
+
+	filescan_threads = (int)stress_get_uint32(opt);
+	stress_check_range("filescan-threads", (uint64_t)filescan_threads,
+		MIN_FILESCAN_THREADS, MAX_FILESCAN_THREADS);
+	return stress_set_setting("filescan-threads", TYPE_ID_INT, &filescan_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_filescan_bytes,	stress_set_filescan_bytes },
+	{ OPT_filescan_chunk,	stress_set_filescan_chunk },
+	{ OPT_filescan_method,	stress_set_filescan_method },
+	{ OPT_filescan_threads,	stress_set_filescan_threads },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_DONTNEED)
+
+#if defined(STRESS_URING) &&		\
+    defined(HAVE_IORING_OP_READ)
+#define FILESCAN_URING
+#endif
+
+/*
+ *  per method accumulated results
+ */
+typedef struct {
+	double bytes;		/* bytes scanned */
+	double duration;	/* wall clock scan time */
+	double faults;		/* minor and major page faults */
+	double cpu;		/* user and system time */
+	bool unsupported;	/* method not available */
+} stress_filescan_result_t;
+
+/*
+ *  state shared by all the scanning threads of a pass
+ */
+typedef struct {
+	const stress_args_t *args;
+	int method;		/* FILESCAN_METHOD_* */
+	int fd;			/* buffered I/O fd */
+	int dfd;		/* O_DIRECT fd, -1 if not supported */
+	const uint8_t *map;	/* mmap'd file for the mmap method */
+	size_t chunk;		/* scan step size */
+	bool verify;		/* check the data */
+} stress_filescan_ctx_t;
+
+/*
+ *  per thread state, each thread scans its own region
+ */
+typedef struct {
+	const stress_filescan_ctx_t *ctx;
+	pthread_t pthread;
+	uint64_t start;		/* region start offset */
+	uint64_t end;		/* region end offset */
+	uint64_t chunks;	/* chunks scanned */
+	uint64_t bytes;		/* bytes scanned */
+	uint64_t errors;	/* chunks with bad data */
+	uint64_t sum;		/* data sum, keeps the scan from being optimized out */
+	uint8_t *buf;		/* read buffer(s), page aligned */
+	size_t buf_size;
+#if defined(FILESCAN_URING)
+	stress_uring_t ring;
+#endif
+	int ret;		/* thread exit status */
+} stress_filescan_thread_t;
+
+static const char * const filescan_method_names[FILESCAN_METHODS] = {
+	"mmap", "read", "direct", "uring"
+};
+
+/*
+ *  stress_filescan_continue()
+ *	keep_stressing() without --rate pacing, pacing the
+ *	scans would skew the bandwidth measurements
+ */
+static inline bool stress_filescan_continue(const stress_args_t *args)
+{
+	if (!keep_stressing_flag())
+		return false;
+	return !(args->max_ops && (get_counter(args) >= args->max_ops));
+}
+
+/*
+ *  stress_filescan_sum()
+ *	sum the 64 bit words of a chunk starting at file word index k,
+ *	the file holds each word's index so the expected sum is
+ *	n * k + n * (n - 1) / 2 (modulo 2^64)
+ */
+static void OPTIMIZE3 stress_filescan_sum(
+	stress_filescan_thread_t *thread,
+	const uint8_t *data,
+	const size_t len,
+	const uint64_t offset)
+{
+	register const uint64_t *ptr = (const uint64_t *)data;
+	register const uint64_t *end = (const uint64_t *)(data + len);
+	register uint64_t sum = 0;
+
+	while (ptr < end)
+		sum += *(ptr++);
+
+	if (thread->ctx->verify) {
+		const uint64_t n = len / sizeof(uint64_t);
+		const uint64_t k = offset / sizeof(uint64_t);
+
+		if (UNLIKELY(sum != (n * k) + ((n * (n - 1)) / 2)))
+			thread->errors++;
+	}
+	thread->sum += sum;
+	thread->chunks++;
+	thread->bytes += len;
+}
+
+/*
+ *  stress_filescan_mmap()
+ *	scan the region by touching the mapped file
+ */
+static int stress_filescan_mmap(stress_filescan_thread_t *thread)
+{
+	const stress_filescan_ctx_t *ctx = thread->ctx;
+	uint64_t off;
+
+	for (off = thread->start; off < thread->end; off += ctx->chunk) {
+		if (!keep_stressing_flag())
+			break;
+		stress_filescan_sum(thread, ctx->map + off, ctx->chunk, off);
+	}
+	return 0;
+}
+
+/*
+ *  stress_filescan_read()
+ *	scan the region with pread, buffered or O_DIRECT
+ */
+static int stress_filescan_read(stress_filescan_thread_t *thread, const int fd)
+{
+	const stress_filescan_ctx_t *ctx = thread->ctx;
+	uint64_t off;
+
+	for (off = thread->start; off < thread->end; ) {
+		ssize_t ret;
+
+		if (!keep_stressing_flag())
+			break;
+		ret = pread(fd, thread->buf, ctx->chunk, (off_t)off);
+		if (UNLIKELY(ret <= 0)) {
+			if ((ret < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+				continue;
+			if (ret == 0)
+				break;
+			pr_fail("%s: %s pread failed, errno=%d (%s)\n",
+				ctx->args->name, filescan_method_names[ctx->method],
+				errno, strerror(errno));
+			return -1;
+		}
+		stress_filescan_sum(thread, thread->buf, (size_t)ret, off);
+		off += (uint64_t)ret;
+	}
+	return 0;
+}
+
+#if defined(FILESCAN_URING)
+/*
+ *  stress_filescan_uring()
+ *	scan the region keeping FILESCAN_URING_DEPTH buffered
+ *	reads in flight, each completed chunk is summed and
+ *	its buffer reused for the next read
+ */
+static int stress_filescan_uring(stress_filescan_thread_t *thread)
+{
+	const stress_filescan_ctx_t *ctx = thread->ctx;
+	stress_uring_t *ring = &thread->ring;
+	uint64_t off = thread->start;
+	unsigned int free_slots[FILESCAN_URING_DEPTH];
+	uint64_t offsets[FILESCAN_URING_DEPTH];
+	unsigned int i, n_free = FILESCAN_URING_DEPTH, in_flight = 0, pending = 0;
+
+	for (i = 0; i < FILESCAN_URING_DEPTH; i++)
+		free_slots[i] = i;
+
+	for (;;) {
+		unsigned tail = *ring->sq_tail;
+		unsigned head;
+		int ret;
+
+		while (n_free && (off < thread->end) && keep_stressing_flag()) {
+			const unsigned int slot = free_slots[--n_free];
+			const unsigned idx = tail & *ring->sq_mask;
+			struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+			(void)memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = ctx->fd;
+			sqe->addr = (uintptr_t)(thread->buf + (slot * ctx->chunk));
+			sqe->len = (uint32_t)ctx->chunk;
+			sqe->off = off;
+			sqe->user_data = (uint64_t)slot;
+			ring->sq_array[idx] = idx;
+			offsets[slot] = off;
+			off += ctx->chunk;
+			tail++;
+			pending++;
+			in_flight++;
+		}
+		shim_mb();
+		*ring->sq_tail = tail;
+		shim_mb();
+
+		if (!in_flight)
+			break;
+		ret = stress_uring_enter(ring, pending, 1);
+		if (ret < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+				continue;
+			pr_fail("%s: io_uring_enter failed, errno=%d (%s)\n",
+				ctx->args->name, errno, strerror(errno));
+			return -1;
+		}
+		pending -= ((unsigned int)ret > pending) ? pending : (unsigned int)ret;
+
+		head = *ring->cq_head;
+		for (;;) {
+			const struct io_uring_cqe *cqe;
+			unsigned int slot;
+
+			shim_mb();
+			if (head == *ring->cq_tail)
+				break;
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			slot = (unsigned int)cqe->user_data;
+			if (cqe->res < 0) {
+				pr_fail("%s: io_uring read failed, errno=%d (%s)\n",
+					ctx->args->name, -cqe->res, strerror(-cqe->res));
+				*ring->cq_head = head + 1;
+				return -1;
+			}
+			stress_filescan_sum(thread, thread->buf + (slot * ctx->chunk),
+				(size_t)cqe->res, offsets[slot]);
+			free_slots[n_free++] = slot;
+			in_flight--;
+			head++;
+		}
+		*ring->cq_head = head;
+		shim_mb();
+	}
+	return 0;
+}
+#endif
+
+/*
+ *  stress_filescan_thread()
+ *	scan a region of the file with the pass method
+ */
+static void *stress_filescan_thread(void *arg)
+{
+	stress_filescan_thread_t *thread = (stress_filescan_thread_t *)arg;
+	const stress_filescan_ctx_t *ctx = thread->ctx;
+
+	switch (ctx->method) {
+	case FILESCAN_METHOD_MMAP:
+		thread->ret = stress_filescan_mmap(thread);
+		break;
+	case FILESCAN_METHOD_READ:
+		thread->ret = stress_filescan_read(thread, ctx->fd);
+		break;
+	case FILESCAN_METHOD_DIRECT:
+		thread->ret = stress_filescan_read(thread, ctx->dfd);
+		break;
+#if defined(FILESCAN_URING)
+	case FILESCAN_METHOD_URING:
+		thread->ret = stress_filescan_uring(thread);
+		break;
+#endif
+	default:
+		thread->ret = -1;
+		break;
+	}
+	return NULL;
+}
+
+/*
+ *  stress_filescan_rusage()
+ *	get page faults and cpu time used so far by the process
+ */
+static void stress_filescan_rusage(double *faults, double *cpu)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0) {
+		*faults = 0.0;
+		*cpu = 0.0;
+		return;
+	}
+	*faults = (double)usage.ru_minflt + (double)usage.ru_majflt;
+	*cpu = (double)usage.ru_utime.tv_sec + ((double)usage.ru_utime.tv_usec / 1000000.0) +
+	       (double)usage.ru_stime.tv_sec + ((double)usage.ru_stime.tv_usec / 1000000.0);
+}
+
+/*
+ *  stress_filescan_pass()
+ *	evict the file from the page cache and scan it once with
+ *	all the threads, accumulating the bandwidth, page faults
+ *	and cpu time of the pass
+ */
+static int stress_filescan_pass(
+	stress_filescan_ctx_t *ctx,
+	stress_filescan_thread_t *threads,
+	const int n_threads,
+	const uint64_t size,
+	stress_filescan_result_t *result)
+{
+	const stress_args_t *args = ctx->args;
+	double t_start, duration, faults_start, faults_end, cpu_start, cpu_end;
+	uint64_t bytes = 0;
+	void *map = NULL;
+	int i, started = 0, rc = EXIT_SUCCESS;
+
+	(void)shim_fdatasync(ctx->fd);
+	VOID_RET(int, posix_fadvise(ctx->fd, 0, (off_t)size, POSIX_FADV_DONTNEED));
+
+	stress_filescan_rusage(&faults_start, &cpu_start);
+	t_start = stress_time_now();
+
+	if (ctx->method == FILESCAN_METHOD_MMAP) {
+		map = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, ctx->fd, 0);
+		if (map == MAP_FAILED) {
+			pr_inf("%s: cannot mmap %" PRIu64 " byte file, errno=%d (%s), "
+				"skipping mmap method\n", args->name, size,
+				errno, strerror(errno));
+			result->unsupported = true;
+			return EXIT_SUCCESS;
+		}
+		ctx->map = (const uint8_t *)map;
+	}
+
+	for (i = 0; i < n_threads; i++) {
+		stress_filescan_thread_t *thread = &threads[i];
+
+		thread->chunks = 0;
+		thread->bytes = 0;
+		thread->ret = 0;
+		if (pthread_create(&thread->pthread, NULL, stress_filescan_thread, thread) != 0) {
+			pr_inf("%s: pthread_create failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_NO_RESOURCE;
+			break;
+		}
+		started++;
+	}
+	for (i = 0; i < started; i++) {
+		stress_filescan_thread_t *thread = &threads[i];
+
+		(void)pthread_join(thread->pthread, NULL);
+		if (thread->ret < 0)
+			rc = EXIT_FAILURE;
+		bytes += thread->bytes;
+		add_counter(args, thread->chunks);
+	}
+
+	duration = stress_time_now() - t_start;
+	if (map)
+		(void)munmap(map, (size_t)size);
+	ctx->map = NULL;
+	stress_filescan_rusage(&faults_end, &cpu_end);
+
+	/* only account complete passes */
+	if ((rc == EXIT_SUCCESS) && (bytes == size)) {
+		result->bytes += (double)bytes;
+		result->duration += duration;
+		result->faults += faults_end - faults_start;
+		result->cpu += cpu_end - cpu_start;
+	}
+	return rc;
+}
+
+/*
+ *  stress_filescan_report()
+ *	log the per method results and report the GB per sec,
+ *	page faults per GB and cpu seconds per GB as metrics
+ */
+static void stress_filescan_report(
+	const stress_args_t *args,
+	const size_t chunk,
+	const int n_threads,
+	const stress_filescan_result_t *results)
+{
+	int i;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %zuK chunks, %d thread%s\n", args->name,
+			chunk / 1024, n_threads, n_threads > 1 ? "s" : "");
+		pr_inf("%s: method     GB/sec    faults/GB  CPU secs/GB\n", args->name);
+	}
+
+	for (i = 0; i < FILESCAN_METHODS; i++) {
+		const stress_filescan_result_t *result = &results[i];
+		double gb, rate, faults, cpu;
+		char str[64];
+
+		if (result->unsupported || (result->bytes <= 0.0) || (result->duration <= 0.0))
+			continue;
+
+		gb = result->bytes / (double)GB;
+		rate = gb / result->duration;
+		faults = result->faults / gb;
+		cpu = result->cpu / gb;
+
+		if (args->instance == 0)
+			pr_inf("%s: %-7s %9.3f %12.1f %12.3f\n", args->name,
+				filescan_method_names[i], rate, faults, cpu);
+
+		(void)snprintf(str, sizeof(str), "%s GB per sec", filescan_method_names[i]);
+		stress_metrics_set(args, i * 3, str, rate);
+		(void)snprintf(str, sizeof(str), "%s page faults per GB", filescan_method_names[i]);
+		stress_metrics_set(args, (i * 3) + 1, str, faults);
+		(void)snprintf(str, sizeof(str), "%s CPU seconds per GB", filescan_method_names[i]);
+		stress_metrics_set(args, (i * 3) + 2, str, cpu);
+	}
+
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_filescan_write()
+ *	fill the file with 64 bit words holding their own word index
+ */
+static int stress_filescan_write(
+	const stress_args_t *args,
+	const int fd,
+	const char *fs_type,
+	uint8_t *buf,
+	const size_t chunk,
+	const uint64_t size)
+{
+	uint64_t off;
+
+	for (off = 0; off < size; off += chunk) {
+		uint64_t *ptr = (uint64_t *)buf;
+		const uint64_t k = off / sizeof(uint64_t);
+		size_t i;
+		ssize_t ret;
+
+		if (!keep_stressing_flag())
+			return -1;
+		for (i = 0; i < chunk / sizeof(uint64_t); i++)
+			ptr[i] = k + i;
+retry:
+		ret = pwrite(fd, buf, chunk, (off_t)off);
+		if (ret < (ssize_t)chunk) {
+			if ((ret < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+				goto retry;
+			if ((ret >= 0) || (errno == ENOSPC) || (errno == EFBIG)) {
+				pr_inf_skip("%s: cannot write %" PRIu64 " byte file%s, "
+					"skipping stressor\n", args->name, size, fs_type);
+				return -1;
+			}
+			pr_fail("%s: pwrite failed, errno=%d (%s)%s\n",
+				args->name, errno, strerror(errno), fs_type);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_filescan
+ *	compare mmap, buffered read, direct I/O and io_uring
+ *	file scan bandwidth on the same file
+ */
+static int stress_filescan(const stress_args_t *args)
+{
+	uint64_t filescan_bytes = DEFAULT_FILESCAN_BYTES;
+	size_t filescan_chunk = DEFAULT_FILESCAN_CHUNK;
+	int filescan_method = FILESCAN_METHOD_ALL;
+	int filescan_threads = DEFAULT_FILESCAN_THREADS;
+	stress_filescan_result_t results[FILESCAN_METHODS];
+	stress_filescan_thread_t *threads;
+	stress_filescan_ctx_t ctx;
+	char filename[PATH_MAX];
+	const char *fs_type;
+	uint64_t size, region, errors = 0;
+	int i, ret, rc = EXIT_SUCCESS;
+
+	if (!stress_get_setting("filescan-bytes", &filescan_bytes)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			filescan_bytes = MAXIMIZED_FILE_SIZE;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			filescan_bytes = MIN_FILESCAN_BYTES;
+	}
+	(void)stress_get_setting("filescan-chunk", &filescan_chunk);
+	(void)stress_get_setting("filescan-method", &filescan_method);
+	(void)stress_get_setting("filescan-threads", &filescan_threads);
+
+	/* each thread scans a whole number of chunks */
+	filescan_bytes /= args->num_instances;
+	region = filescan_bytes / (uint64_t)filescan_threads;
+	region -= region % filescan_chunk;
+	if (region < filescan_chunk)
+		region = filescan_chunk;
+	size = region * (uint64_t)filescan_threads;
+
+	(void)memset(results, 0, sizeof(results));
+	(void)memset(&ctx, 0, sizeof(ctx));
+	ctx.args = args;
+	ctx.chunk = filescan_chunk;
+	ctx.verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	ctx.dfd = -1;
+
+	threads = calloc((size_t)filescan_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %d thread states, skipping stressor\n",
+			args->name, filescan_threads);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < filescan_threads; i++) {
+		stress_filescan_thread_t *thread = &threads[i];
+
+		thread->ctx = &ctx;
+		thread->start = region * (uint64_t)i;
+		thread->end = thread->start + region;
+		thread->buf_size = filescan_chunk * FILESCAN_URING_DEPTH;
+		thread->buf = (uint8_t *)mmap(NULL, thread->buf_size, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (thread->buf == MAP_FAILED) {
+			thread->buf = NULL;
+			pr_inf_skip("%s: cannot mmap %zu byte scan buffer, skipping stressor\n",
+				args->name, thread->buf_size);
+			rc = EXIT_NO_RESOURCE;
+			goto free_threads;
+		}
+#if defined(FILESCAN_URING)
+		thread->ring.fd = -1;
+#endif
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto free_threads;
+	}
+	(void)stress_temp_filename_args(args, filename, sizeof(filename), stress_mwc32());
+	ctx.fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (ctx.fd < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto rm_dir;
+	}
+	fs_type = stress_fs_type(filename);
+#if defined(O_DIRECT)
+	ctx.dfd = open(filename, O_RDONLY | O_DIRECT);
+#endif
+	(void)shim_unlink(filename);
+
+	if (stress_filescan_write(args, ctx.fd, fs_type, threads[0].buf, filescan_chunk, size) < 0) {
+		rc = keep_stressing_flag() ? EXIT_NO_RESOURCE : EXIT_SUCCESS;
+		goto close_fds;
+	}
+
+	/* some filesystems allow O_DIRECT opens but fail the reads */
+	if ((ctx.dfd >= 0) && (pread(ctx.dfd, threads[0].buf, filescan_chunk, 0) < 0)) {
+		pr_dbg("%s: O_DIRECT read failed, errno=%d (%s)%s, skipping direct method\n",
+			args->name, errno, strerror(errno), fs_type);
+		(void)close(ctx.dfd);
+		ctx.dfd = -1;
+	}
+	if (ctx.dfd < 0)
+		results[FILESCAN_METHOD_DIRECT].unsupported = true;
+#if defined(FILESCAN_URING)
+	if ((filescan_method == FILESCAN_METHOD_ALL) ||
+	    (filescan_method == FILESCAN_METHOD_URING)) {
+		for (i = 0; i < filescan_threads; i++) {
+			if (stress_uring_setup(args, &threads[i].ring, FILESCAN_URING_DEPTH) != EXIT_SUCCESS) {
+				results[FILESCAN_METHOD_URING].unsupported = true;
+				break;
+			}
+		}
+	}
+#else
+	results[FILESCAN_METHOD_URING].unsupported = true;
+#endif
+	if ((filescan_method != FILESCAN_METHOD_ALL) && results[filescan_method].unsupported) {
+		pr_inf_skip("%s: %s method not supported%s, skipping stressor\n",
+			args->name, filescan_method_names[filescan_method], fs_type);
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto close_rings;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (i = 0; i < FILESCAN_METHODS; i++) {
+			if ((filescan_method != FILESCAN_METHOD_ALL) && (filescan_method != i))
+				continue;
+			if (results[i].unsupported)
+				continue;
+			ctx.method = i;
+			rc = stress_filescan_pass(&ctx, threads, filescan_threads, size, &results[i]);
+			if (rc != EXIT_SUCCESS)
+				goto report;
+			if (!stress_filescan_continue(args))
+				goto report;
+		}
+	} while (stress_filescan_continue(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_filescan_report(args, filescan_chunk, filescan_threads, results);
+
+	for (i = 0; i < filescan_threads; i++)
+		errors += threads[i].errors;
+	if (errors) {
+		pr_fail("%s: %" PRIu64 " chunks contained unexpected data\n",
+			args->name, errors);
+		rc = EXIT_FAILURE;
+	}
+close_rings:
+#if defined(FILESCAN_URING)
+	for (i = 0; i < filescan_threads; i++) {
+		if (threads[i].ring.fd >= 0)
+			stress_uring_close(&threads[i].ring);
+	}
+#endif
+close_fds:
+	if (ctx.dfd >= 0)
+		(void)close(ctx.dfd);
+	(void)close(ctx.fd);
+rm_dir:
+	(void)stress_temp_dir_rm_args(args);
+free_threads:
+	for (i = 0; i < filescan_threads; i++) {
+		if (threads[i].buf)
+			(void)munmap((void *)threads[i].buf, threads[i].buf_size);
+	}
+	free(threads);
+
+	return rc;
+}
+
+stressor_info_t stress_filescan_info = {
+	.stressor = stress_filescan,
+	.class = CLASS_IO | CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
+#else
+stressor_info_t stress_filescan_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_IO | CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without pthread or posix_fadvise support"
+};
+#endif
@@ -18,11 +18,47 @@
  *
  */
 #include "stress-ng.h"
+#include "core-lock-scale.h"
 
 static const stress_help_t help[] = {
-	{ NULL,	"flock N",	"start N workers locking a single file" },
-	{ NULL,	"flock-ops N",	"stop after N flock bogo operations" },
-	{ NULL,	NULL,		NULL }
+	{ NULL,	"flock N",		"start N workers locking a single file" },
+	{ NULL,	"flock-files N",	"lock N files in scaling mode" },
+	{ NULL,	"flock-ops N",		"stop after N flock bogo operations" },
+	{ NULL,	"flock-procs N",	"sweep from 1 up to N locking processes in scaling mode" },
+	{ NULL,	"flock-scale",		"measure lock and unlock scaling over processes" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_flock_files(const char *opt)
+{
+	uint32_t flock_files;
+
+	flock_files = stress_get_uint32(opt);
+	stress_check_range("flock-files", (uint64_t)flock_files,
+		MIN_LOCK_SCALE_FILES, MAX_LOCK_SCALE_FILES);
+	return stress_set_setting("flock-files", TYPE_ID_UINT32, &flock_files);
+}
+
+static int stress_set_flock_procs(const char *opt)
+{
+	uint32_t flock_procs;
+
+	flock_procs = stress_get_uint32(opt);
+	stress_check_range("flock-procs", (uint64_t)flock_procs,
+		MIN_LOCK_SCALE_PROCS, MAX_LOCK_SCALE_PROCS);
+	return stress_set_setting("flock-procs", TYPE_ID_UINT32, &flock_procs);
+}
+
+static int stress_set_flock_scale(const char *opt)
+{
+	return stress_set_setting_true("flock-scale", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_flock_files,	stress_set_flock_files },
+	{ OPT_flock_procs,	stress_set_flock_procs },
+	{ OPT_flock_scale,	stress_set_flock_scale },
+	{ 0,			NULL }
 };
 
 #if defined(HAVE_FLOCK) &&	\
@@ -263,6 +299,16 @@ static int stress_flock(const stress_args_t *args)
 	size_t i;
 	pid_t pids[MAX_FLOCK_STRESSORS];
 	char filename[PATH_MAX];
+	uint32_t flock_files = DEFAULT_LOCK_SCALE_FILES;
+	uint32_t flock_procs = DEFAULT_LOCK_SCALE_PROCS;
+	bool flock_scale = false;
+
+	(void)stress_get_setting("flock-scale", &flock_scale);
+	if (flock_scale) {
+		(void)stress_get_setting("flock-files", &flock_files);
+		(void)stress_get_setting("flock-procs", &flock_procs);
+		return stress_lock_scale(args, STRESS_LOCK_SCALE_FLOCK, flock_files, flock_procs, false);
+	}
 
 	ret = stress_temp_dir_mk_args(args);
 	if (ret < 0)
@@ -320,12 +366,14 @@ err:
 stressor_info_t stress_flock_info = {
 	.stressor = stress_flock,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_flock_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without flock() or LOCK_EX/LOCK_UN support"
 };
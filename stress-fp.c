@@ -18,9 +18,13 @@
  */
 #include "stress-ng.h"
 #include "core-arch.h"
+#include "core-builtin.h"
+#include "core-fp-bench.h"
 #include "core-put.h"
 #include "core-target-clones.h"
 
+#include <float.h>
+
 #define LOOPS_PER_CALL	(65536)
 #define FP_ELEMENTS	(8)
 
@@ -34,6 +38,7 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"fp N",	 	"start N workers performing floating point math ops" },
+	{ NULL,	"fp-bench",	"characterise floating point op latency and throughput" },
 	{ NULL,	"fp-method M",	"select the floating point method to operate with" },
 	{ NULL,	"fp-ops N",	"stop after N floating point math bogo operations" },
 	{ NULL,	NULL,		 NULL }
@@ -376,11 +381,148 @@ static int stress_set_fp_method(const char *name)
 	return -1;
 }
 
+/*
+ *  kernel operations, the first and second of each pair are applied
+ *  alternately so the chains stay bounded, see stress_fp_bench_inputs()
+ */
+#define FP_BENCH_ADD1(x)	((x) + a)
+#define FP_BENCH_ADD2(x)	((x) - a)
+#define FP_BENCH_MUL1(x)	((x) * a)
+#define FP_BENCH_MUL2(x)	((x) * b)
+#define FP_BENCH_DIV1(x)	((x) / a)
+#define FP_BENCH_DIV2(x)	((x) / b)
+#define FP_BENCH_FMA1(x)	((x) * a + b)
+#define FP_BENCH_FMA2(x)	((x) * a + b)
+
+#define FP_BENCH_SQRTF(x)	sqrtf(x)
+#define FP_BENCH_SQRT(x)	shim_sqrt(x)
+#define FP_BENCH_SQRTL(x)	shim_sqrtl(x)
+
+/*
+ *  STRESS_FP_BENCH()
+ *	latency kernel of 8 dependent operations per loop and throughput
+ *	kernel of FP_BENCH_CHAINS independent chains, 16 operations per
+ *	loop. OPTIMIZE1 stops the independent chains being vectorized
+ */
+#define STRESS_FP_BENCH(type, name, X1, X2, put)			\
+static uint64_t TARGET_CLONES OPTIMIZE1 name ## _latency(		\
+	const long double r_init,					\
+	const long double a_init,					\
+	const long double b_init,					\
+	const uint32_t loops)						\
+{									\
+	register type r = (type)r_init;					\
+	const type a = (type)a_init;					\
+	const type b = (type)b_init;					\
+	register uint32_t i;						\
+									\
+	(void)a;							\
+	(void)b;							\
+	for (i = 0; i < loops; i++) {					\
+		r = X1(r);						\
+		r = X2(r);						\
+		r = X1(r);						\
+		r = X2(r);						\
+		r = X1(r);						\
+		r = X2(r);						\
+		r = X1(r);						\
+		r = X2(r);						\
+	}								\
+	put(r);								\
+	return (uint64_t)loops * 8;					\
+}									\
+									\
+static uint64_t TARGET_CLONES OPTIMIZE1 name ## _throughput(		\
+	const long double r_init,					\
+	const long double a_init,					\
+	const long double b_init,					\
+	const uint32_t loops)						\
+{									\
+	volatile type init = (type)r_init;				\
+	type r0 = init, r1 = init, r2 = init, r3 = init;		\
+	type r4 = init, r5 = init, r6 = init, r7 = init;		\
+	const type a = (type)a_init;					\
+	const type b = (type)b_init;					\
+	register uint32_t i;						\
+									\
+	(void)a;							\
+	(void)b;							\
+	for (i = 0; i < loops; i++) {					\
+		r0 = X1(r0);						\
+		r1 = X1(r1);						\
+		r2 = X1(r2);						\
+		r3 = X1(r3);						\
+		r4 = X1(r4);						\
+		r5 = X1(r5);						\
+		r6 = X1(r6);						\
+		r7 = X1(r7);						\
+		r0 = X2(r0);						\
+		r1 = X2(r1);						\
+		r2 = X2(r2);						\
+		r3 = X2(r3);						\
+		r4 = X2(r4);						\
+		r5 = X2(r5);						\
+		r6 = X2(r6);						\
+		r7 = X2(r7);						\
+	}								\
+	put(r0 + r1 + r2 + r3 + r4 + r5 + r6 + r7);			\
+	return (uint64_t)loops * 2 * FP_BENCH_CHAINS;			\
+}
+
+STRESS_FP_BENCH(float, stress_fp_bench_float_add, FP_BENCH_ADD1, FP_BENCH_ADD2, stress_float_put)
+STRESS_FP_BENCH(float, stress_fp_bench_float_mul, FP_BENCH_MUL1, FP_BENCH_MUL2, stress_float_put)
+STRESS_FP_BENCH(float, stress_fp_bench_float_div, FP_BENCH_DIV1, FP_BENCH_DIV2, stress_float_put)
+STRESS_FP_BENCH(float, stress_fp_bench_float_sqrt, FP_BENCH_SQRTF, FP_BENCH_SQRTF, stress_float_put)
+STRESS_FP_BENCH(float, stress_fp_bench_float_fma, FP_BENCH_FMA1, FP_BENCH_FMA2, stress_float_put)
+
+STRESS_FP_BENCH(double, stress_fp_bench_double_add, FP_BENCH_ADD1, FP_BENCH_ADD2, stress_double_put)
+STRESS_FP_BENCH(double, stress_fp_bench_double_mul, FP_BENCH_MUL1, FP_BENCH_MUL2, stress_double_put)
+STRESS_FP_BENCH(double, stress_fp_bench_double_div, FP_BENCH_DIV1, FP_BENCH_DIV2, stress_double_put)
+STRESS_FP_BENCH(double, stress_fp_bench_double_sqrt, FP_BENCH_SQRT, FP_BENCH_SQRT, stress_double_put)
+STRESS_FP_BENCH(double, stress_fp_bench_double_fma, FP_BENCH_FMA1, FP_BENCH_FMA2, stress_double_put)
+
+STRESS_FP_BENCH(long double, stress_fp_bench_ldouble_add, FP_BENCH_ADD1, FP_BENCH_ADD2, stress_long_double_put)
+STRESS_FP_BENCH(long double, stress_fp_bench_ldouble_mul, FP_BENCH_MUL1, FP_BENCH_MUL2, stress_long_double_put)
+STRESS_FP_BENCH(long double, stress_fp_bench_ldouble_div, FP_BENCH_DIV1, FP_BENCH_DIV2, stress_long_double_put)
+STRESS_FP_BENCH(long double, stress_fp_bench_ldouble_sqrt, FP_BENCH_SQRTL, FP_BENCH_SQRTL, stress_long_double_put)
+STRESS_FP_BENCH(long double, stress_fp_bench_ldouble_fma, FP_BENCH_FMA1, FP_BENCH_FMA2, stress_long_double_put)
+
+#define FP_BENCH(type, name, op, min)	\
+	{ type, op, min, name ## _latency, name ## _throughput }
+
+static const stress_fp_bench_t stress_fp_benches[] = {
+	FP_BENCH("float", stress_fp_bench_float_add, FP_BENCH_OP_ADD, FLT_MIN),
+	FP_BENCH("float", stress_fp_bench_float_mul, FP_BENCH_OP_MUL, FLT_MIN),
+	FP_BENCH("float", stress_fp_bench_float_div, FP_BENCH_OP_DIV, FLT_MIN),
+	FP_BENCH("float", stress_fp_bench_float_sqrt, FP_BENCH_OP_SQRT, FLT_MIN),
+	FP_BENCH("float", stress_fp_bench_float_fma, FP_BENCH_OP_FMA, FLT_MIN),
+	FP_BENCH("double", stress_fp_bench_double_add, FP_BENCH_OP_ADD, DBL_MIN),
+	FP_BENCH("double", stress_fp_bench_double_mul, FP_BENCH_OP_MUL, DBL_MIN),
+	FP_BENCH("double", stress_fp_bench_double_div, FP_BENCH_OP_DIV, DBL_MIN),
+	FP_BENCH("double", stress_fp_bench_double_sqrt, FP_BENCH_OP_SQRT, DBL_MIN),
+	FP_BENCH("double", stress_fp_bench_double_fma, FP_BENCH_OP_FMA, DBL_MIN),
+	FP_BENCH("long double", stress_fp_bench_ldouble_add, FP_BENCH_OP_ADD, LDBL_MIN),
+	FP_BENCH("long double", stress_fp_bench_ldouble_mul, FP_BENCH_OP_MUL, LDBL_MIN),
+	FP_BENCH("long double", stress_fp_bench_ldouble_div, FP_BENCH_OP_DIV, LDBL_MIN),
+	FP_BENCH("long double", stress_fp_bench_ldouble_sqrt, FP_BENCH_OP_SQRT, LDBL_MIN),
+	FP_BENCH("long double", stress_fp_bench_ldouble_fma, FP_BENCH_OP_FMA, LDBL_MIN),
+};
+
+static int stress_set_fp_bench(const char *opt)
+{
+	return stress_set_setting_true("fp-bench", opt);
+}
+
 static int stress_fp(const stress_args_t *args)
 {
 	size_t i, mmap_size;
 	fp_data_t *fp_data;
 	size_t fp_method = 0;	/* "all" */
+	bool fp_bench = false;
+
+	(void)stress_get_setting("fp-bench", &fp_bench);
+	if (fp_bench)
+		return stress_fp_bench_run(args, stress_fp_benches, SIZEOF_ARRAY(stress_fp_benches));
 
 	mmap_size = FP_ELEMENTS * sizeof(*fp_data);
 	fp_data = (fp_data_t *)mmap(NULL, mmap_size, PROT_READ | PROT_WRITE,
@@ -512,7 +654,9 @@ static int stress_fp(const stress_args_t *args)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_fp_bench,		stress_set_fp_bench },
         { OPT_fp_method,	stress_set_fp_method },
+	{ 0,			NULL }
 };
 
 stressor_info_t stress_fp_info = {
@@ -18,22 +18,597 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
 
 #if defined(HAVE_LINUX_FUTEX_H)
 #include <linux/futex.h>
 #endif
 
+#define MIN_FUTEX_WAITERS	(1)
+#define MAX_FUTEX_WAITERS	(1024)
+#define DEFAULT_FUTEX_WAITERS	(16)
+
 static const stress_help_t help[] = {
 	{ NULL,	"futex N",	"start N workers exercising a fast mutex" },
+	{ NULL,	"futex-bench",	"compare futex wake and handover latencies of N waiters" },
 	{ NULL,	"futex-ops N",	"stop after N fast mutex bogo operations" },
+	{ NULL,	"futex-waiters N", "number of waiter threads for --futex-bench" },
 	{ NULL,	NULL,		NULL }
 };
 
+static int stress_set_futex_bench(const char *opt)
+{
+	return stress_set_setting_true("futex-bench", opt);
+}
+
+static int stress_set_futex_waiters(const char *opt)
+{
+	uint32_t futex_waiters;
+
+	futex_waiters = stress_get_uint32(opt);
+	stress_check_range("futex-waiters", (uint64_t)futex_waiters,
+		MIN_FUTEX_WAITERS, MAX_FUTEX_WAITERS);
+	return stress_set_setting("futex-waiters", TYPE_ID_UINT32, &futex_waiters);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_futex_bench,	stress_set_futex_bench },
+	{ OPT_futex_waiters,	stress_set_futex_waiters },
+	{ 0,			NULL }
+};
+
 #if defined(HAVE_LINUX_FUTEX_H) &&	\
     defined(__NR_futex)
 
 #define THRESHOLD	(100000)
 
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(FUTEX_PRIVATE_FLAG) &&		\
+    defined(FUTEX_CMP_REQUEUE) &&		\
+    defined(FUTEX_LOCK_PI) &&			\
+    defined(FUTEX_UNLOCK_PI) &&			\
+    defined(CLOCK_MONOTONIC)
+#define STRESS_FUTEX_BENCH
+
+#define FUTEX_BENCH_SLICE	(0.5)		/* seconds per test */
+#define FUTEX_BENCH_TIMEOUT_NS	(100000000)	/* waits time out so a stop is seen */
+#define FUTEX_BENCH_WAITV	(8)		/* futexes per futex_waitv */
+
+#if defined(FUTEX_32)
+#define FUTEX_BENCH_32		FUTEX_32
+#else
+#define FUTEX_BENCH_32		(2)
+#endif
+
+#define FUTEX_BENCH_WAKE_ONE	(0)
+#define FUTEX_BENCH_WAKE_ALL	(1)
+#define FUTEX_BENCH_REQUEUE	(2)
+#define FUTEX_BENCH_PI		(3)
+#define FUTEX_BENCH_WAITV_TEST	(4)
+#define FUTEX_BENCH_TESTS	(5)
+
+#define FUTEX_BENCH_LOAD(ptr)		__atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define FUTEX_BENCH_STORE(ptr, val)	__atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define FUTEX_BENCH_ADD(ptr, val)	__atomic_fetch_add(ptr, val, __ATOMIC_ACQ_REL)
+#define FUTEX_BENCH_CAS(ptr, exp, val)	\
+	__atomic_compare_exchange_n(ptr, exp, val, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+static const char * const stress_futex_bench_tests[FUTEX_BENCH_TESTS] = {
+	"wake-one",
+	"wake-all",
+	"cmp-requeue",
+	"pi-handover",
+	"futex_waitv",
+};
+
+/* state shared by the waker and the waiters of a test */
+typedef struct {
+	uint32_t word;			/* wake tokens, generation or PI lock */
+	uint32_t target;		/* cmp-requeue target */
+	uint32_t words[FUTEX_BENCH_WAITV]; /* futex_waitv wake tokens */
+	uint32_t acks;			/* waiter acknowledgements */
+	uint32_t stop;			/* waiters stop when set */
+	int test;			/* FUTEX_BENCH_* test */
+	int err;			/* errno if the test cannot run */
+	uint64_t stamp;			/* ns time of the last wake or unlock */
+	uint64_t syscalls;		/* futex calls on the wait and wake paths */
+} stress_futex_bench_ctx_t;
+
+/* a waiter thread and its wake latencies */
+typedef struct {
+	stress_futex_bench_ctx_t *ctx;
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	uint64_t last_ns;		/* latency of the last wake */
+	stress_latency_t latency;	/* wake latencies */
+} stress_futex_bench_waiter_t;
+
+/* accumulated results of a test */
+typedef struct {
+	int err;			/* errno if the test cannot run */
+	double secs;			/* seconds run */
+	uint64_t wakes;			/* wakes (or kernel lock handovers) */
+	uint64_t syscalls;		/* futex calls on the wait and wake paths */
+	stress_latency_t latency;	/* wake to running latencies */
+	stress_latency_t herd;		/* wake-all to last waiter running latencies */
+} stress_futex_bench_t;
+
+/*
+ *  stress_futex_bench_call()
+ *	process private futex system call
+ */
+static inline long stress_futex_bench_call(
+	uint32_t *uaddr,
+	const int op,
+	const uint32_t val,
+	const void *timeout,
+	uint32_t *uaddr2,
+	const uint32_t val3)
+{
+	return syscall(__NR_futex, uaddr, op | FUTEX_PRIVATE_FLAG, val, timeout, uaddr2, val3);
+}
+
+/*
+ *  stress_futex_bench_now()
+ *	CLOCK_MONOTONIC time in nanoseconds
+ */
+static inline uint64_t stress_futex_bench_now(void)
+{
+	struct timespec ts;
+
+	if (UNLIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) < 0))
+		return 0;
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_futex_bench_wait()
+ *	counted futex wait with a timeout so waiters notice a stop,
+ *	returns true if the wait timed out
+ */
+static inline bool stress_futex_bench_wait(
+	stress_futex_bench_ctx_t *ctx,
+	uint32_t *uaddr,
+	const uint32_t val)
+{
+	static const struct timespec timeout = { 0, FUTEX_BENCH_TIMEOUT_NS };
+
+	FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+	if (stress_futex_bench_call(uaddr, FUTEX_WAIT, val, &timeout, NULL, 0) < 0)
+		return errno == ETIMEDOUT;
+	return false;
+}
+
+/*
+ *  stress_futex_bench_ack()
+ *	tell the waker a waiter is ready or has woken
+ */
+static inline void stress_futex_bench_ack(stress_futex_bench_ctx_t *ctx)
+{
+	FUTEX_BENCH_ADD(&ctx->acks, 1);
+	(void)stress_futex_bench_call(&ctx->acks, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/*
+ *  stress_futex_bench_acks()
+ *	wait for the waiters to have acknowledged acks times in total,
+ *	returns false if the run is ending
+ */
+static bool stress_futex_bench_acks(stress_futex_bench_ctx_t *ctx, const uint32_t acks)
+{
+	static const struct timespec timeout = { 0, FUTEX_BENCH_TIMEOUT_NS };
+	uint32_t val;
+
+	while ((val = FUTEX_BENCH_LOAD(&ctx->acks)) < acks) {
+		if (!keep_stressing_flag() || FUTEX_BENCH_LOAD(&ctx->err))
+			return false;
+		(void)stress_futex_bench_call(&ctx->acks, FUTEX_WAIT, val, &timeout, NULL, 0);
+	}
+	return true;
+}
+
+/*
+ *  stress_futex_bench_woken()
+ *	add the latency from the last wake (or unlock) to now
+ */
+static inline uint64_t stress_futex_bench_woken(
+	stress_futex_bench_ctx_t *ctx,
+	stress_futex_bench_waiter_t *w)
+{
+	const uint64_t now = stress_futex_bench_now();
+	const uint64_t stamp = FUTEX_BENCH_LOAD(&ctx->stamp);
+
+	if (UNLIKELY(now < stamp))
+		return 0;
+	stress_latency_add(&w->latency, now - stamp);
+	return now - stamp;
+}
+
+/*
+ *  stress_futex_bench_waiter()
+ *	waiter thread, waits and acknowledges each wake until stopped
+ */
+static void *stress_futex_bench_waiter(void *arg)
+{
+	static void *nowt = NULL;
+	stress_futex_bench_waiter_t *w = (stress_futex_bench_waiter_t *)arg;
+	stress_futex_bench_ctx_t *ctx = w->ctx;
+	uint32_t gen, t;
+	bool timed_out = false;
+	size_t k;
+
+	switch (ctx->test) {
+	case FUTEX_BENCH_WAKE_ONE:
+		/* the word counts wake tokens, a waiter takes one per wake */
+		stress_futex_bench_ack(ctx);
+		while (!FUTEX_BENCH_LOAD(&ctx->stop)) {
+			t = FUTEX_BENCH_LOAD(&ctx->word);
+			if (t > 0) {
+				if (FUTEX_BENCH_CAS(&ctx->word, &t, t - 1)) {
+					(void)stress_futex_bench_woken(ctx, w);
+					stress_futex_bench_ack(ctx);
+				}
+				continue;
+			}
+			(void)stress_futex_bench_wait(ctx, &ctx->word, 0);
+		}
+		break;
+	case FUTEX_BENCH_WAKE_ALL:
+	case FUTEX_BENCH_REQUEUE:
+		/* the word is a generation, all waiters wake on each change */
+		gen = FUTEX_BENCH_LOAD(&ctx->word);
+		stress_futex_bench_ack(ctx);
+		while (!FUTEX_BENCH_LOAD(&ctx->stop)) {
+			if (FUTEX_BENCH_LOAD(&ctx->word) == gen) {
+				/* a requeued waiter that times out was never woken */
+				timed_out |= stress_futex_bench_wait(ctx, &ctx->word, gen);
+				continue;
+			}
+			if (!timed_out)
+				w->last_ns = stress_futex_bench_woken(ctx, w);
+			timed_out = false;
+			gen = FUTEX_BENCH_LOAD(&ctx->word);
+			stress_futex_bench_ack(ctx);
+		}
+		break;
+	case FUTEX_BENCH_PI: {
+			/* hand the lock over, only kernel handovers are timed */
+			const uint32_t tid = (uint32_t)shim_gettid();
+
+			while (!FUTEX_BENCH_LOAD(&ctx->stop)) {
+				t = 0;
+				if (!FUTEX_BENCH_CAS(&ctx->word, &t, tid)) {
+					FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+					if (stress_futex_bench_call(&ctx->word, FUTEX_LOCK_PI, 0, NULL, NULL, 0) < 0) {
+						if (errno == EINTR)
+							continue;
+						FUTEX_BENCH_STORE(&ctx->err, errno);
+						break;
+					}
+					(void)stress_futex_bench_woken(ctx, w);
+				}
+				FUTEX_BENCH_STORE(&ctx->stamp, stress_futex_bench_now());
+				t = tid;
+				if (!FUTEX_BENCH_CAS(&ctx->word, &t, 0)) {
+					FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+					(void)stress_futex_bench_call(&ctx->word, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0);
+				}
+			}
+		}
+		break;
+	case FUTEX_BENCH_WAITV_TEST:
+		/* each word counts wake tokens, wait on all of them at once */
+		stress_futex_bench_ack(ctx);
+		while (!FUTEX_BENCH_LOAD(&ctx->stop)) {
+			struct shim_futex_waitv waitv[FUTEX_BENCH_WAITV];
+			struct timespec timeout;
+			bool woken = false;
+			uint64_t ns;
+
+			for (k = 0; (k < FUTEX_BENCH_WAITV) && !woken; k++) {
+				t = FUTEX_BENCH_LOAD(&ctx->words[k]);
+				woken = (t > 0) && FUTEX_BENCH_CAS(&ctx->words[k], &t, t - 1);
+			}
+			if (woken) {
+				(void)stress_futex_bench_woken(ctx, w);
+				stress_futex_bench_ack(ctx);
+				continue;
+			}
+			(void)memset(waitv, 0, sizeof(waitv));
+			for (k = 0; k < FUTEX_BENCH_WAITV; k++) {
+				waitv[k].val = 0;
+				waitv[k].uaddr = (uint64_t)(uintptr_t)&ctx->words[k];
+				waitv[k].flags = FUTEX_BENCH_32 | FUTEX_PRIVATE_FLAG;
+			}
+			ns = stress_futex_bench_now() + FUTEX_BENCH_TIMEOUT_NS;
+			timeout.tv_sec = (time_t)(ns / STRESS_NANOSECOND);
+			timeout.tv_nsec = (long)(ns % STRESS_NANOSECOND);
+			FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+			if ((shim_futex_waitv(waitv, FUTEX_BENCH_WAITV, 0, &timeout, CLOCK_MONOTONIC) < 0) &&
+			    (errno == ENOSYS)) {
+				FUTEX_BENCH_STORE(&ctx->err, ENOSYS);
+				break;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_futex_bench_waker()
+ *	wake the waiters for secs seconds, one at a time, all at once,
+ *	one then requeueing the rest and waking those one at a time,
+ *	or one on one of the futex_waitv futexes. PI lock handover
+ *	needs no waker, the waiters hand the lock to each other
+ */
+static void stress_futex_bench_waker(
+	const stress_args_t *args,
+	stress_futex_bench_ctx_t *ctx,
+	stress_futex_bench_waiter_t *waiters,
+	const uint32_t n,
+	const double secs,
+	stress_futex_bench_t *result)
+{
+	const double t_end = stress_time_now() + secs;
+	uint32_t acks = n, i, k = 0;
+
+	/* all waiters are ready */
+	if (!stress_futex_bench_acks(ctx, acks))
+		return;
+
+	while (keep_stressing(args) && (stress_time_now() < t_end) && !FUTEX_BENCH_LOAD(&ctx->err)) {
+		uint64_t herd = 0;
+		uint32_t gen, now_acks;
+
+		switch (ctx->test) {
+		case FUTEX_BENCH_WAKE_ONE:
+			FUTEX_BENCH_STORE(&ctx->stamp, stress_futex_bench_now());
+			FUTEX_BENCH_ADD(&ctx->word, 1);
+			FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+			(void)stress_futex_bench_call(&ctx->word, FUTEX_WAKE, 1, NULL, NULL, 0);
+			acks++;
+			break;
+		case FUTEX_BENCH_WAKE_ALL:
+			for (i = 0; i < n; i++)
+				waiters[i].last_ns = 0;
+			FUTEX_BENCH_STORE(&ctx->stamp, stress_futex_bench_now());
+			FUTEX_BENCH_ADD(&ctx->word, 1);
+			FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+			(void)stress_futex_bench_call(&ctx->word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+			acks += n;
+			if (!stress_futex_bench_acks(ctx, acks))
+				return;
+			/* the herd has all woken when the last waiter runs */
+			for (i = 0; i < n; i++) {
+				if (waiters[i].last_ns > herd)
+					herd = waiters[i].last_ns;
+			}
+			if (herd)
+				stress_latency_add(&result->herd, herd);
+			break;
+		case FUTEX_BENCH_REQUEUE:
+			/* wake one, move the rest to the target then wake them one by one */
+			FUTEX_BENCH_STORE(&ctx->stamp, stress_futex_bench_now());
+			gen = FUTEX_BENCH_ADD(&ctx->word, 1) + 1;
+			FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+			if (stress_futex_bench_call(&ctx->word, FUTEX_CMP_REQUEUE, 1,
+					(const void *)(uintptr_t)INT_MAX, &ctx->target, gen) < 0) {
+				result->err = errno;
+				return;
+			}
+			acks += n;
+			while ((now_acks = FUTEX_BENCH_LOAD(&ctx->acks)) < acks) {
+				if (!keep_stressing_flag())
+					return;
+				FUTEX_BENCH_STORE(&ctx->stamp, stress_futex_bench_now());
+				FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+				if (stress_futex_bench_call(&ctx->target, FUTEX_WAKE, 1, NULL, NULL, 0) > 0) {
+					if (!stress_futex_bench_acks(ctx, now_acks + 1))
+						return;
+				} else {
+					/* the rest were not asleep when requeued */
+					if (!stress_futex_bench_acks(ctx, acks))
+						return;
+				}
+			}
+			break;
+		case FUTEX_BENCH_WAITV_TEST:
+			FUTEX_BENCH_STORE(&ctx->stamp, stress_futex_bench_now());
+			FUTEX_BENCH_ADD(&ctx->words[k], 1);
+			FUTEX_BENCH_ADD(&ctx->syscalls, 1);
+			(void)stress_futex_bench_call(&ctx->words[k], FUTEX_WAKE, 1, NULL, NULL, 0);
+			k = (k + 1) % FUTEX_BENCH_WAITV;
+			acks++;
+			break;
+		default:
+			(void)shim_usleep(10000);
+			continue;
+		}
+		if (!stress_futex_bench_acks(ctx, acks))
+			return;
+	}
+}
+
+/*
+ *  stress_futex_bench_run()
+ *	run a test with n waiter threads for secs seconds
+ */
+static void stress_futex_bench_run(
+	const stress_args_t *args,
+	const int test,
+	stress_futex_bench_waiter_t *waiters,
+	const uint32_t n,
+	const double secs,
+	stress_futex_bench_t *result)
+{
+	static stress_futex_bench_ctx_t ctx ALIGN64;
+	double t_start;
+	uint32_t i, started = 0;
+	size_t k;
+
+	(void)memset(&ctx, 0, sizeof(ctx));
+	ctx.test = test;
+	for (i = 0; i < n; i++) {
+		waiters[i].ctx = &ctx;
+		waiters[i].last_ns = 0;
+		stress_latency_reset(&waiters[i].latency);
+		waiters[i].ret = pthread_create(&waiters[i].pthread, NULL,
+			stress_futex_bench_waiter, &waiters[i]);
+		if (waiters[i].ret == 0)
+			started++;
+	}
+	if (started < n) {
+		result->err = EAGAIN;
+		FUTEX_BENCH_STORE(&ctx.stop, 1);
+		goto join;
+	}
+
+	t_start = stress_time_now();
+	if (test == FUTEX_BENCH_PI) {
+		while (keep_stressing(args) && (stress_time_now() < t_start + secs) &&
+		       !FUTEX_BENCH_LOAD(&ctx.err))
+			(void)shim_usleep(10000);
+	} else {
+		stress_futex_bench_waker(args, &ctx, waiters, n, secs, result);
+	}
+	result->secs += stress_time_now() - t_start;
+
+	/* wake everything so the waiters see the stop */
+	FUTEX_BENCH_STORE(&ctx.stop, 1);
+	(void)stress_futex_bench_call(&ctx.word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	(void)stress_futex_bench_call(&ctx.target, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	for (k = 0; k < FUTEX_BENCH_WAITV; k++)
+		(void)stress_futex_bench_call(&ctx.words[k], FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+join:
+	for (i = 0; i < n; i++) {
+		if (waiters[i].ret == 0) {
+			(void)pthread_join(waiters[i].pthread, NULL);
+			stress_latency_merge(&result->latency, &waiters[i].latency);
+			result->wakes += waiters[i].latency.count;
+		}
+	}
+	if (ctx.err && !result->err)
+		result->err = ctx.err;
+	result->syscalls += ctx.syscalls;
+	add_counter(args, result->wakes);
+}
+
+/*
+ *  stress_futex_bench_report()
+ *	print and set the metrics of each test
+ */
+static void stress_futex_bench_report(
+	const stress_args_t *args,
+	const stress_futex_bench_t *results,
+	const uint32_t n)
+{
+	size_t i, idx = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %" PRIu32 " waiter threads\n", args->name, n);
+		pr_inf("%s: %-12s %12s %10s %10s %10s %12s\n", args->name,
+			"test", "wakes/sec", "p50 usec", "p99 usec", "max usec", "calls/wake");
+	}
+	for (i = 0; i < FUTEX_BENCH_TESTS; i++) {
+		const stress_futex_bench_t *r = &results[i];
+		double rate, p50, p99, max, calls;
+		char str[64];
+
+		if (r->err) {
+			if (args->instance == 0)
+				pr_inf("%s: %-12s not available, errno=%d (%s)\n",
+					args->name, stress_futex_bench_tests[i], r->err, strerror(r->err));
+			continue;
+		}
+		if ((r->secs <= 0.0) || (r->wakes == 0))
+			continue;
+		rate = (double)r->wakes / r->secs;
+		p50 = (double)stress_latency_percentile(&r->latency, 50.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		p99 = (double)stress_latency_percentile(&r->latency, 99.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		max = (double)r->latency.max / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		calls = (double)r->syscalls / (double)r->wakes;
+		if (args->instance == 0)
+			pr_inf("%s: %-12s %12.1f %10.2f %10.2f %10.2f %12.2f\n",
+				args->name, stress_futex_bench_tests[i], rate, p50, p99, max, calls);
+
+		(void)snprintf(str, sizeof(str), "%s wakes per sec", stress_futex_bench_tests[i]);
+		stress_metrics_set(args, idx++, str, rate);
+		(void)snprintf(str, sizeof(str), "%s wake p50 usec", stress_futex_bench_tests[i]);
+		stress_metrics_set(args, idx++, str, p50);
+		(void)snprintf(str, sizeof(str), "%s wake p99 usec", stress_futex_bench_tests[i]);
+		stress_metrics_set(args, idx++, str, p99);
+		(void)snprintf(str, sizeof(str), "%s futex calls per wake", stress_futex_bench_tests[i]);
+		stress_metrics_set(args, idx++, str, calls);
+		if (r->herd.count) {
+			const double herd = (double)stress_latency_percentile(&r->herd, 99.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+
+			if (args->instance == 0)
+				pr_inf("%s: %-12s last waiter of the herd p50 %.2f usec, p99 %.2f usec\n",
+					args->name, stress_futex_bench_tests[i],
+					(double)stress_latency_percentile(&r->herd, 50.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND,
+					herd);
+			(void)snprintf(str, sizeof(str), "%s last waiter p99 usec", stress_futex_bench_tests[i]);
+			stress_metrics_set(args, idx++, str, herd);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_futex_bench()
+ *	compare wake one, wake all (thundering herd), compare and requeue,
+ *	PI lock handover and futex_waitv wake latencies and futex calls per
+ *	wake with futex_waiters threads, the tests take turns for a slice of
+ *	time so all see the same system conditions
+ */
+static int stress_futex_bench(const stress_args_t *args, const uint32_t futex_waiters)
+{
+	static stress_futex_bench_t results[FUTEX_BENCH_TESTS];
+	stress_futex_bench_waiter_t *waiters;
+	const size_t waiters_size = sizeof(*waiters) * futex_waiters;
+	int i;
+	bool ran;
+
+	waiters = (stress_futex_bench_waiter_t *)mmap(NULL, waiters_size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (waiters == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %" PRIu32 " waiters, skipping stressor\n",
+			args->name, futex_waiters);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(results, 0, sizeof(results));
+	for (i = 0; i < FUTEX_BENCH_TESTS; i++) {
+		stress_latency_reset(&results[i].latency);
+		stress_latency_reset(&results[i].herd);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		for (i = 0; (i < FUTEX_BENCH_TESTS) && keep_stressing(args); i++) {
+			if (results[i].err)
+				continue;
+			stress_futex_bench_run(args, i, waiters, futex_waiters,
+				FUTEX_BENCH_SLICE, &results[i]);
+			ran = true;
+		}
+	} while (ran && keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_futex_bench_report(args, results, futex_waiters);
+	(void)munmap((void *)waiters, waiters_size);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_futex_wait()
  *     exercise futex_wait and every 16th time futex_waitv
@@ -94,6 +669,21 @@ static int stress_futex(const stress_args_t *args)
 	uint64_t *timeout = &g_shared->futex.timeout[args->instance];
 	uint32_t *futex = &g_shared->futex.futex[args->instance];
 	pid_t pid;
+	bool futex_bench = false;
+	uint32_t futex_waiters = DEFAULT_FUTEX_WAITERS;
+
+	(void)stress_get_setting("futex-bench", &futex_bench);
+	(void)stress_get_setting("futex-waiters", &futex_waiters);
+
+	if (futex_bench) {
+#if defined(STRESS_FUTEX_BENCH)
+		return stress_futex_bench(args, futex_waiters);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --futex-bench is not supported on this system, "
+				"defaulting to futex stressing\n", args->name);
+#endif
+	}
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 again:
@@ -142,11 +732,13 @@ again:
 		do {
 			/* Small timeout to force rapid timer wakeups */
 			int ret;
+			uint64_t t_lat;
 
 			/* Break early before potential long wait */
 			if (!keep_stressing_flag())
 				break;
 
+			t_lat = stress_latency_begin(args);
 			ret = stress_futex_wait(futex, 0, 5000);
 
 			/* timeout, re-do, stress on stupid fast polling */
@@ -167,6 +759,7 @@ again:
 							args->name, errno, strerror(errno));
 					}
 				}
+				stress_latency_end(args, t_lat);
 				inc_counter(args);
 			}
 		} while (keep_stressing(args));
@@ -180,6 +773,7 @@ finish:
 stressor_info_t stress_futex_info = {
 	.stressor = stress_futex,
 	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_OPTIONAL,
 	.help = help
 };
@@ -187,6 +781,7 @@ stressor_info_t stress_futex_info = {
 stressor_info_t stress_futex_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without linux/futex.h or futex() system call"
 };
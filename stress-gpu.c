@@ -28,15 +28,29 @@
 #if defined(HAVE_GLES2_H)
 #include <GLES2/gl2.h>
 #endif
+#if defined(HAVE_GLES31_H)
+#include <GLES3/gl31.h>
+#endif
 
 #if defined(HAVE_GBM_H)
 #include <gbm.h>
 #endif
 
+#define GPU_MODE_RENDER		(0)	/* GLES2 fragment shader rendering */
+#define GPU_MODE_COMPUTE	(1)	/* GLES 3.1 compute shader throughput */
+
+#define MIN_GPU_COMPUTE_BYTES	(1 * MB)
+#define MAX_GPU_COMPUTE_BYTES	(256 * MB)
+#define DEFAULT_GPU_COMPUTE_BYTES (64 * MB)
+#define DEFAULT_GPU_FMA		(1024)
+
 static const stress_help_t help[] = {
 	{ NULL,	"gpu N",		"start N GPU worker" },
+	{ NULL,	"gpu-compute-bytes N",	"specify compute mode bandwidth buffer size" },
 	{ NULL,	"gpu-devnode name",	"specify CPU device node name" },
+	{ NULL,	"gpu-fma N",		"specify compute mode multiply-adds per invocation" },
 	{ NULL,	"gpu-frag N",		"specify shader core usage per pixel" },
+	{ NULL,	"gpu-mode M",		"specify mode [ render | compute ]" },
 	{ NULL,	"gpu-ops N",		"stop after N gpu render bogo operations" },
 	{ NULL,	"gpu-tex-size N",	"specify upload texture NxN" },
 	{ NULL,	"gpu-upload N",		"specify upload texture N times per frame" },
@@ -95,9 +109,48 @@ static int stress_set_gpu_size(const char *opt)
 	return stress_set_gpu_gl(opt, "gpu-tex-size", INT_MAX);
 }
 
+static int stress_set_gpu_fma(const char *opt)
+{
+	return stress_set_gpu(opt, "gpu-fma", INT_MAX);
+}
+
+static int stress_set_gpu_compute_bytes(const char *opt)
+{
+	size_t gpu_compute_bytes;
+
+	gpu_compute_bytes = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("gpu-compute-bytes", gpu_compute_bytes,
+		MIN_GPU_COMPUTE_BYTES, MAX_GPU_COMPUTE_BYTES);
+	return stress_set_setting("gpu-compute-bytes", TYPE_ID_SIZE_T, &gpu_compute_bytes);
+}
+
+static const char * const gpu_modes[] = {
+	"render",
+	"compute",
+};
+
+static int stress_set_gpu_mode(const char *opt)
+{
+	int i;
+
+	for (i = 0; i < (int)SIZEOF_ARRAY(gpu_modes); i++) {
+		if (!strcmp(opt, gpu_modes[i]))
+			return stress_set_setting("gpu-mode", TYPE_ID_INT, &i);
+	}
+	(void)fprintf(stderr, "gpu-mode must be one of:");
+	for (i = 0; i < (int)SIZEOF_ARRAY(gpu_modes); i++)
+		(void)fprintf(stderr, " %s", gpu_modes[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_gpu_compute_bytes,stress_set_gpu_compute_bytes },
 	{ OPT_gpu_devnode,	stress_set_gpu_devnode },
+	{ OPT_gpu_fma,		stress_set_gpu_fma },
 	{ OPT_gpu_frag,		stress_set_gpu_frag },
+	{ OPT_gpu_mode,		stress_set_gpu_mode },
 	{ OPT_gpu_uploads,	stress_set_gpu_upload },
 	{ OPT_gpu_size,		stress_set_gpu_size },
 	{ OPT_gpu_xsize,	stress_set_gpu_xsize },
@@ -125,6 +178,66 @@ static struct gbm_surface *gs;
 static const char default_gpu_devnode[] = "/dev/dri/renderD128";
 static GLubyte *teximage = NULL;
 
+#if defined(HAVE_GLES31_H) &&		\
+    defined(GL_COMPUTE_SHADER) &&	\
+    defined(GL_SHADER_STORAGE_BUFFER) &&\
+    defined(EGL_OPENGL_ES3_BIT)
+#define STRESS_GPU_COMPUTE
+
+#define GPU_COMPUTE_LOCAL_SIZE	(256)	/* invocations per work group */
+#define GPU_FMA_GROUPS		(1024)	/* FMA kernel work groups */
+#define GPU_FMA_FLOPS		(32)	/* flops per FMA loop, 4 vec4 multiply-adds */
+
+static GLuint fma_program;
+static GLuint bw_program;
+static GLuint compute_buffers[3];	/* FMA data, bandwidth src and dst */
+
+/* FMA heavy, 4 independent vec4 multiply-add chains to fill the ALUs */
+static const char fma_shader[] =
+    "#version 310 es\n"
+    "layout(local_size_x = 256) in;\n"
+    "layout(std430, binding = 0) buffer Data { vec4 data[]; };\n"
+    "uniform int fma_n;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    vec4 b = vec4(0.9999, 1.0001, 0.9998, 1.0002);\n"
+    "    vec4 c = vec4(0.0001);\n"
+    "    vec4 x = data[i];\n"
+    "    vec4 y = x + 1.0;\n"
+    "    vec4 z = x + 2.0;\n"
+    "    vec4 w = x + 3.0;\n"
+    "    for (int j = 0; j < fma_n; j++) {\n"
+    "        x = x * b + c;\n"
+    "        y = y * b + c;\n"
+    "        z = z * b + c;\n"
+    "        w = w * b + c;\n"
+    "    }\n"
+    "    data[i] = x + y + z + w;\n"
+    "}\n";
+
+/* memory bound, read one vec4 and write one vec4 per invocation */
+static const char bw_shader[] =
+    "#version 310 es\n"
+    "layout(local_size_x = 256) in;\n"
+    "layout(std430, binding = 1) readonly buffer Src { vec4 src[]; };\n"
+    "layout(std430, binding = 2) writeonly buffer Dst { vec4 dst[]; };\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    dst[i] = src[i] * 1.0001;\n"
+    "}\n";
+
+/* compute mode throughput, duration and work done */
+typedef struct {
+	stress_metrics_t fma;		/* FMA kernel, count is flops */
+	stress_metrics_t bw;		/* bandwidth kernel, count is bytes */
+	stress_metrics_t upload;	/* texture uploads, count is bytes */
+} stress_gpu_compute_t;
+#endif
+
 static const char vert_shader[] =
     "attribute vec4 pos;\n"
     "attribute vec4 color;\n"
@@ -348,9 +461,9 @@ static void stress_gpu_run(const GLsizei texsize, const GLsizei uploads)
 	glFinish();
 }
 
-static int get_config(const stress_args_t *args, EGLConfig *config)
+static int get_config(const stress_args_t *args, EGLConfig *config, const EGLint es_version)
 {
-	static const EGLint egl_config_attribs[] = {
+	EGLint egl_config_attribs[] = {
 		EGL_BUFFER_SIZE, 32,
 		EGL_DEPTH_SIZE, EGL_DONT_CARE,
 		EGL_STENCIL_SIZE, EGL_DONT_CARE,
@@ -363,6 +476,13 @@ static int get_config(const stress_args_t *args, EGLConfig *config)
 	EGLint num_configs;
 	EGLConfig *configs;
 
+#if defined(EGL_OPENGL_ES3_BIT)
+	if (es_version >= 3)
+		egl_config_attribs[7] = EGL_OPENGL_ES3_BIT;
+#else
+	(void)es_version;
+#endif
+
 	if (eglGetConfigs(display, NULL, 0, &num_configs) == EGL_FALSE) {
 		pr_inf_skip("%s: EGL: no EGL configs found, skipping stressor\n", args->name);
 		return EXIT_NO_RESOURCE;
@@ -408,7 +528,8 @@ static int egl_init(
 	const stress_args_t *args,
 	const char *gpu_devnode,
 	const uint32_t size_x,
-	const uint32_t size_y)
+	const uint32_t size_y,
+	const EGLint es_version)
 {
 	int ret, fd;
 	EGLConfig config;
@@ -416,8 +537,8 @@ static int egl_init(
 	EGLint majorVersion;
 	EGLint minorVersion;
 
-	static const EGLint contextAttribs[] = {
-		EGL_CONTEXT_CLIENT_VERSION, 2,
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, es_version,
 		EGL_NONE
 	};
 
@@ -450,7 +571,7 @@ static int egl_init(
 		return EXIT_NO_RESOURCE;
 	}
 
-	ret = get_config(args, &config);
+	ret = get_config(args, &config, es_version);
 	if (ret != EXIT_SUCCESS)
 		return ret;
 
@@ -481,6 +602,177 @@ static int egl_init(
 	return EXIT_SUCCESS;
 }
 
+#if defined(STRESS_GPU_COMPUTE)
+static int load_compute_program(
+	const stress_args_t *args,
+	const char *text,
+	const int size,
+	GLuint *prog)
+{
+	GLint linked;
+	GLuint shader;
+
+	shader = compile_shader(args, text, size, GL_COMPUTE_SHADER);
+	if (shader == 0) {
+		pr_inf_skip("%s: failed to compile compute shader, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	*prog = glCreateProgram();
+	if (*prog == 0) {
+		pr_inf("%s: failed to create the compute shader program\n", args->name);
+		glDeleteShader(shader);
+		return EXIT_NO_RESOURCE;
+	}
+	glAttachShader(*prog, shader);
+	glLinkProgram(*prog);
+	glDeleteShader(shader);
+	glGetProgramiv(*prog, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		pr_fail("%s: failed to link compute shader program\n", args->name);
+		glDeleteProgram(*prog);
+		*prog = 0;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+static int gles31_compute_init(
+	const stress_args_t *args,
+	const int fma_n,
+	const size_t compute_bytes,
+	const GLsizei texsize)
+{
+	int ret, major = 0, minor = 0;
+	const char *version = (const char *)glGetString(GL_VERSION);
+	GLint ufma_n;
+	const GLsizeiptr fma_bytes = (GLsizeiptr)(GPU_FMA_GROUPS * GPU_COMPUTE_LOCAL_SIZE * 4 * sizeof(GLfloat));
+
+	if (args->instance == 0) {
+		pr_inf("%s: GL_VENDOR: %s\n", args->name, (const char *)glGetString(GL_VENDOR));
+		pr_inf("%s: GL_VERSION: %s\n", args->name, version ? version : "unknown");
+		pr_inf("%s: GL_RENDERER: %s\n", args->name, (const char *)glGetString(GL_RENDERER));
+	}
+	if (!version ||
+	    (sscanf(version, "OpenGL ES %d.%d", &major, &minor) != 2) ||
+	    ((major * 10) + minor < 31)) {
+		pr_inf_skip("%s: compute mode requires OpenGL ES 3.1, skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+
+	ret = load_compute_program(args, fma_shader, sizeof(fma_shader), &fma_program);
+	if (ret != EXIT_SUCCESS)
+		return ret;
+	ret = load_compute_program(args, bw_shader, sizeof(bw_shader), &bw_program);
+	if (ret != EXIT_SUCCESS)
+		return ret;
+
+	glUseProgram(fma_program);
+	ufma_n = glGetUniformLocation(fma_program, "fma_n");
+	glUniform1i(ufma_n, fma_n);
+
+	glGenBuffers(3, compute_buffers);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, compute_buffers[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, fma_bytes, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, compute_buffers[1]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)compute_bytes, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, compute_buffers[2]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)compute_bytes, NULL, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, compute_buffers[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, compute_buffers[1]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, compute_buffers[2]);
+	if (glGetError() != GL_NO_ERROR) {
+		pr_inf_skip("%s: cannot allocate %zd byte compute buffers, skipping stressor\n",
+			args->name, compute_bytes);
+		return EXIT_NO_RESOURCE;
+	}
+
+	if (texsize > 0) {
+		GLint maxsize;
+		GLuint texobj = 0;
+
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxsize);
+		if (texsize > maxsize) {
+			pr_inf("%s: image size %u exceeds maximum texture size %u\n",
+				args->name, (unsigned int)texsize, (unsigned int)maxsize);
+			return EXIT_FAILURE;
+		}
+		glGenTextures(1, &texobj);
+		glBindTexture(GL_TEXTURE_2D, texobj);
+		teximage = malloc((size_t)texsize * (size_t)texsize * 4);
+		if (!teximage) {
+			pr_inf_skip("%s: failed to allocate teximage, skipping stressor\n", args->name);
+			return EXIT_NO_RESOURCE;
+		}
+		(void)memset(teximage, 0x5a, (size_t)texsize * (size_t)texsize * 4);
+	}
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_gpu_compute_run()
+ *	run the FMA and bandwidth kernels and the texture uploads,
+ *	each to completion so they can be timed separately
+ */
+static void stress_gpu_compute_run(
+	const int fma_n,
+	const size_t compute_bytes,
+	const GLsizei texsize,
+	const GLsizei uploads,
+	stress_gpu_compute_t *compute)
+{
+	const GLuint bw_groups = (GLuint)(compute_bytes / (4 * sizeof(GLfloat) * GPU_COMPUTE_LOCAL_SIZE));
+	double t;
+
+	glUseProgram(fma_program);
+	t = stress_time_now();
+	glDispatchCompute(GPU_FMA_GROUPS, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	glFinish();
+	compute->fma.duration += stress_time_now() - t;
+	compute->fma.count += (double)GPU_FMA_GROUPS * GPU_COMPUTE_LOCAL_SIZE *
+			      (double)fma_n * GPU_FMA_FLOPS;
+
+	glUseProgram(bw_program);
+	t = stress_time_now();
+	glDispatchCompute(bw_groups, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	glFinish();
+	compute->bw.duration += stress_time_now() - t;
+	compute->bw.count += 2.0 * (double)bw_groups * GPU_COMPUTE_LOCAL_SIZE * 4 * sizeof(GLfloat);
+
+	if (texsize > 0) {
+		int i;
+
+		t = stress_time_now();
+		for (i = 0; keep_stressing_flag() && (i < uploads); i++) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texsize,
+				     texsize, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+				     teximage);
+		}
+		glFinish();
+		compute->upload.duration += stress_time_now() - t;
+		compute->upload.count += (double)i * (double)texsize * (double)texsize * 4.0;
+	}
+}
+
+/*
+ *  stress_gpu_compute_metrics()
+ *	report the compute mode throughput
+ */
+static void stress_gpu_compute_metrics(const stress_args_t *args, const stress_gpu_compute_t *compute)
+{
+	if (compute->fma.duration > 0.0)
+		stress_metrics_set(args, 0, "GFLOP per sec FMA kernel",
+			compute->fma.count / (compute->fma.duration * 1.0E9));
+	if (compute->bw.duration > 0.0)
+		stress_metrics_set(args, 1, "GB per sec buffer copy kernel",
+			compute->bw.count / (compute->bw.duration * 1.0E9));
+	if (compute->upload.duration > 0.0)
+		stress_metrics_set(args, 2, "GB per sec texture upload",
+			compute->upload.count / (compute->upload.duration * 1.0E9));
+}
+#endif
+
 static int stress_gpu_supported(const char *name)
 {
 	const char *gpu_devnode = default_gpu_devnode;
@@ -517,9 +809,27 @@ static int stress_gpu_child(const stress_args_t *args, void *context)
 	GLsizei uploads = 1;
 	const char *gpu_devnode = default_gpu_devnode;
 	struct sigaction old_action;
+	int gpu_mode = GPU_MODE_RENDER;
+#if defined(STRESS_GPU_COMPUTE)
+	int fma_n = DEFAULT_GPU_FMA;
+	size_t compute_bytes = DEFAULT_GPU_COMPUTE_BYTES;
+	stress_gpu_compute_t compute;
+
+	(void)memset(&compute, 0, sizeof(compute));
+#endif
 
 	(void)context;
 
+	(void)stress_get_setting("gpu-mode", &gpu_mode);
+#if !defined(STRESS_GPU_COMPUTE)
+	if (gpu_mode == GPU_MODE_COMPUTE) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: compute mode requires GLES3/gl31.h and EGL 1.5, "
+				"skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+#endif
+
 	if (stress_sighandler(args->name, SIGALRM, stress_gpu_alarm_handler, &old_action) < 0)
 		return EXIT_NO_RESOURCE;
 
@@ -531,12 +841,22 @@ static int stress_gpu_child(const stress_args_t *args, void *context)
 	(void)stress_get_setting("gpu-ysize", &size_y);
 	(void)stress_get_setting("gpu-tex-size", &texsize);
 	(void)stress_get_setting("gpu-upload", &uploads);
+#if defined(STRESS_GPU_COMPUTE)
+	(void)stress_get_setting("gpu-fma", &fma_n);
+	(void)stress_get_setting("gpu-compute-bytes", &compute_bytes);
+#endif
 
-	ret = egl_init(args, gpu_devnode, size_x, size_y);
+	ret = egl_init(args, gpu_devnode, size_x, size_y,
+		(gpu_mode == GPU_MODE_COMPUTE) ? 3 : 2);
 	if (ret != EXIT_SUCCESS)
 		goto deinit;
 
-	ret = gles2_init(args, size_x, size_y, frag_n, texsize);
+#if defined(STRESS_GPU_COMPUTE)
+	if (gpu_mode == GPU_MODE_COMPUTE)
+		ret = gles31_compute_init(args, fma_n, compute_bytes, texsize);
+	else
+#endif
+		ret = gles2_init(args, size_x, size_y, frag_n, texsize);
 	if (ret != EXIT_SUCCESS)
 		goto deinit;
 
@@ -551,7 +871,12 @@ static int stress_gpu_child(const stress_args_t *args, void *context)
 	}
 
 	do {
-		stress_gpu_run(texsize, uploads);
+#if defined(STRESS_GPU_COMPUTE)
+		if (gpu_mode == GPU_MODE_COMPUTE)
+			stress_gpu_compute_run(fma_n, compute_bytes, texsize, uploads, &compute);
+		else
+#endif
+			stress_gpu_run(texsize, uploads);
 		if (glGetError() != GL_NO_ERROR)
 			return EXIT_NO_RESOURCE;
 		inc_counter(args);
@@ -560,6 +885,10 @@ static int stress_gpu_child(const stress_args_t *args, void *context)
 finish:
 	do_jmp = false;
 	(void)stress_sigrestore(args->name, SIGALRM, &old_action);
+#if defined(STRESS_GPU_COMPUTE)
+	if (gpu_mode == GPU_MODE_COMPUTE)
+		stress_gpu_compute_metrics(args, &compute);
+#endif
 
 	ret = EXIT_SUCCESS;
 deinit:
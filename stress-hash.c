@@ -17,11 +17,30 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arch.h"
 #include "core-hash.h"
+#include "core-put.h"
 #if defined(HAVE_XXHASH_H)
 #include <xxhash.h>
 #endif
 
+#if defined(HAVE_IMMINTRIN_H)
+#include <immintrin.h>
+#endif
+
+#define HASH_BULK_BUF_SIZE	(4 * MB)	/* random key buffer */
+#define HASH_BULK_BYTES		(4 * MB)	/* bytes hashed per point per sweep */
+#define HASH_BULK_MIN_CALLS	(256)		/* minimum calls per point per sweep */
+
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    !defined(__ICC) &&			\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_HASH_HAVE_X86_VEC
+#endif
+
 typedef struct {
 	double_t	duration;
 	double		chi_squared;
@@ -50,6 +69,7 @@ typedef struct stress_hash_method_info {
 
 static const stress_help_t help[] = {
 	{ NULL,  "hash N",		"start N workers that exercise various hash functions" },
+	{ NULL,  "hash-bulk",		"benchmark bulk hashing, report GB/s and ns per hash by key length" },
 	{ NULL,  "hash-method M",	"specify stress hash method M, default is all" },
 	{ NULL,  "hash-ops N",		"stop after N hash bogo operations" },
 	{ NULL,	 NULL,			NULL }
@@ -57,6 +77,11 @@ static const stress_help_t help[] = {
 
 static stress_hash_method_info_t hash_methods[];
 
+static int stress_set_hash_bulk(const char *opt)
+{
+	return stress_set_setting_true("hash-bulk", opt);
+}
+
 /*
  *  stress_hash_generic()
  *	stress test generic string hash function
@@ -289,6 +314,23 @@ static void stress_hash_method_crc32c(
 	stress_hash_generic(name, hmi, bucket, stress_hash_crc32c_wrapper, 0x923ab2b3, 0x923ab2b3);
 }
 
+static uint32_t stress_hash_crc64_wrapper(const char *str, const size_t len)
+{
+	return (uint32_t)stress_hash_crc64(str, len);
+}
+
+/*
+ *  stress_hash_method_crc64()
+ *	stress test hash crc64 (CRC-64/XZ)
+ */
+static void stress_hash_method_crc64(
+	const char *name,
+	const struct stress_hash_method_info *hmi,
+	const stress_bucket_t *bucket)
+{
+	stress_hash_generic(name, hmi, bucket, stress_hash_crc64_wrapper, 0xe519bc55, 0xe519bc55);
+}
+
 static uint32_t OPTIMIZE3 stress_hash_xor(const char *str, const size_t len)
 {
 	register uint32_t sum = 0;
@@ -408,6 +450,23 @@ static void stress_hash_method_coffin32(
 	stress_hash_generic(name, hmi, bucket, wrapper, 0xdc02e07b, 0xdc02e07b);
 }
 
+static uint32_t stress_hash_wyhash_wrapper(const char *str, const size_t len)
+{
+	return (uint32_t)stress_hash_wyhash(str, len, 0xa0761d6478bd642fULL);
+}
+
+/*
+ *  stress_hash_method_wyhash()
+ *	stress test hash wyhash
+ */
+static void stress_hash_method_wyhash(
+	const char *name,
+	const struct stress_hash_method_info *hmi,
+	const stress_bucket_t *bucket)
+{
+	stress_hash_generic(name, hmi, bucket, stress_hash_wyhash_wrapper, 0x25b8425b, 0x25b8425b);
+}
+
 static uint32_t stress_hash_x17_wrapper(const char *str, const size_t len)
 {
 	(void)len;
@@ -598,6 +657,7 @@ static stress_hash_method_info_t hash_methods[] = {
 	{ "coffin",		stress_hash_method_coffin,	NULL },
 	{ "coffin32",		stress_hash_method_coffin32,	NULL },
 	{ "crc32c",		stress_hash_method_crc32c,	NULL },
+	{ "crc64",		stress_hash_method_crc64,	NULL },
 	{ "djb2a",		stress_hash_method_djb2a,	NULL },
 	{ "fnv1a",		stress_hash_method_fnv1a,	NULL },
 	{ "jenkin",		stress_hash_method_jenkin,	NULL },
@@ -615,6 +675,7 @@ static stress_hash_method_info_t hash_methods[] = {
 	{ "sdbm",		stress_hash_method_sdbm,	NULL },
 	{ "sedgwick",		stress_hash_method_sedgwick,	NULL },
 	{ "sobel",		stress_hash_method_sobel,	NULL },
+	{ "wyhash",		stress_hash_method_wyhash,	NULL },
 	{ "x17",		stress_hash_method_x17,		NULL },
 	{ "xor",		stress_hash_method_xor,		NULL },
 	{ "xorror32",		stress_hash_method_xorror32,	NULL },
@@ -652,6 +713,535 @@ static int stress_set_hash_method(const char *name)
 	return -1;
 }
 
+typedef uint64_t (*stress_hash_bulk_func_t)(const void *data, const size_t len);
+
+static uint64_t stress_hash_bulk_jenkin(const void *data, const size_t len)
+{
+	return (uint64_t)stress_hash_jenkin((const uint8_t *)data, len);
+}
+
+static uint64_t stress_hash_bulk_murmur3_32(const void *data, const size_t len)
+{
+	return (uint64_t)stress_hash_murmur3_32((const uint8_t *)data, len, 0xf12b35e1);
+}
+
+/*
+ *  stress_hash_bulk_adler32()
+ *	stress_hash_adler32() stops at the first zero byte, so
+ *	for binary keys use a length bound version
+ */
+static uint64_t OPTIMIZE3 stress_hash_bulk_adler32(const void *data, const size_t len)
+{
+	register const uint8_t *ptr = (const uint8_t *)data;
+	register const uint8_t *end = ptr + len;
+	register uint32_t a = 1, b = 0;
+
+	while (ptr < end) {
+		register const uint8_t *chunk_end = ptr + 5552;
+
+		if (chunk_end > end)
+			chunk_end = end;
+		while (ptr < chunk_end) {
+			a += *(ptr++);
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (uint64_t)((b << 16) | a);
+}
+
+static uint64_t stress_hash_bulk_crc32c(const void *data, const size_t len)
+{
+	return (uint64_t)~stress_hash_crc32c_update(~0U, data, len);
+}
+
+static uint64_t stress_hash_bulk_crc64(const void *data, const size_t len)
+{
+	return stress_hash_crc64(data, len);
+}
+
+static uint64_t stress_hash_bulk_wyhash(const void *data, const size_t len)
+{
+	return stress_hash_wyhash(data, len, 0xa0761d6478bd642fULL);
+}
+
+#if defined(HAVE_XXHASH_H) &&	\
+    defined(HAVE_LIB_XXHASH)
+static uint64_t stress_hash_bulk_xxh64(const void *data, const size_t len)
+{
+	return (uint64_t)XXH64(data, len, 0xf261eab7);
+}
+
+#if defined(XXH_VERSION_NUMBER) &&	\
+    (XXH_VERSION_NUMBER >= 800)
+#define STRESS_HASH_HAVE_XXH3
+static uint64_t stress_hash_bulk_xxh3(const void *data, const size_t len)
+{
+	return (uint64_t)XXH3_64bits(data, len);
+}
+#endif
+#endif
+
+static bool stress_hash_bulk_always(void)
+{
+	return true;
+}
+
+#if defined(STRESS_HASH_HAVE_X86_VEC)
+/*
+ *  stress_hash_bulk_crc32c_sse42()
+ *	crc32c using the SSE4.2 crc32 instruction, 8 bytes at a time
+ */
+static uint64_t OPTIMIZE3 __attribute__((target("sse4.2"))) stress_hash_bulk_crc32c_sse42(
+	const void *data,
+	const size_t len)
+{
+	register const uint8_t *ptr = (const uint8_t *)data;
+	register const uint8_t *end = ptr + len;
+	register uint64_t crc = 0xffffffffULL;
+
+	while (ptr + 8 <= end) {
+		uint64_t v;
+
+		(void)memcpy(&v, ptr, sizeof(v));
+		crc = _mm_crc32_u64(crc, v);
+		ptr += 8;
+	}
+	while (ptr < end)
+		crc = (uint64_t)_mm_crc32_u8((uint32_t)crc, *(ptr++));
+
+	return (uint64_t)(~(uint32_t)crc);
+}
+
+/*
+ *  CLMUL folding constants, each pair folds a 128 bit lane over
+ *  a distance of D bits in the reflected domain, the low 64 bits
+ *  of the lane are multiplied by rev64(x^(D+63) mod P) and the high
+ *  64 bits by rev64(x^(D-1) mod P), generated for D = 128, 256, 384
+ *  and 512 by 64 bit shift and xor reductions on P
+ */
+typedef struct {
+	uint64_t	lo;
+	uint64_t	hi;
+} stress_hash_fold_t;
+
+static const stress_hash_fold_t crc32c_folds[4] = {
+	{ 0x3743f7bd00000000ULL, 0x3171d43000000000ULL },	/* 128 */
+	{ 0x33ccbbbc00000000ULL, 0xa2158b3400000000ULL },	/* 256 */
+	{ 0xa46ef4aa00000000ULL, 0x6051243f00000000ULL },	/* 384 */
+	{ 0x1c19243b00000000ULL, 0x75bba45b00000000ULL },	/* 512 */
+};
+
+static const stress_hash_fold_t crc64_folds[4] = {
+	{ 0xe05dd497ca393ae4ULL, 0xdabe95afc7875f40ULL },	/* 128 */
+	{ 0x60095b008a9efa44ULL, 0x3be653a30fe1af51ULL },	/* 256 */
+	{ 0xb5ea1af9c013aca4ULL, 0x69a35d91c3730254ULL },	/* 384 */
+	{ 0x6ae3efbb9dd441f3ULL, 0x081f6054a7842df4ULL },	/* 512 */
+};
+
+static inline __m128i __attribute__((target("pclmul,sse4.1"))) stress_hash_fold(
+	const __m128i x,
+	const __m128i k,
+	const __m128i block)
+{
+	const __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+	const __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+
+	return _mm_xor_si128(_mm_xor_si128(lo, hi), block);
+}
+
+/*
+ *  stress_hash_clmul_fold()
+ *	fold len bytes (a multiple of 16, at least 64) into a 128 bit
+ *	remainder with four parallel accumulators, init is the crc
+ *	initial value and is xor'd into the first bytes of the data,
+ *	the result is congruent to the message so feeding it through
+ *	the table update from a zero state yields the crc register
+ */
+static __m128i OPTIMIZE3 __attribute__((target("pclmul,sse4.1"))) stress_hash_clmul_fold(
+	const uint8_t *ptr,
+	const size_t len,
+	const uint64_t init,
+	const stress_hash_fold_t *folds)
+{
+	const uint8_t *end = ptr + len;
+	const __m128i k128 = _mm_set_epi64x((long long)folds[0].hi, (long long)folds[0].lo);
+	const __m128i k256 = _mm_set_epi64x((long long)folds[1].hi, (long long)folds[1].lo);
+	const __m128i k384 = _mm_set_epi64x((long long)folds[2].hi, (long long)folds[2].lo);
+	const __m128i k512 = _mm_set_epi64x((long long)folds[3].hi, (long long)folds[3].lo);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i x0, x1, x2, x3;
+
+	x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)ptr), _mm_set_epi64x(0, (long long)init));
+	x1 = _mm_loadu_si128((const __m128i *)(ptr + 16));
+	x2 = _mm_loadu_si128((const __m128i *)(ptr + 32));
+	x3 = _mm_loadu_si128((const __m128i *)(ptr + 48));
+	ptr += 64;
+
+	while (ptr + 64 <= end) {
+		x0 = stress_hash_fold(x0, k512, _mm_loadu_si128((const __m128i *)ptr));
+		x1 = stress_hash_fold(x1, k512, _mm_loadu_si128((const __m128i *)(ptr + 16)));
+		x2 = stress_hash_fold(x2, k512, _mm_loadu_si128((const __m128i *)(ptr + 32)));
+		x3 = stress_hash_fold(x3, k512, _mm_loadu_si128((const __m128i *)(ptr + 48)));
+		ptr += 64;
+	}
+	x0 = _mm_xor_si128(stress_hash_fold(x0, k384, zero), stress_hash_fold(x1, k256, zero));
+	x0 = _mm_xor_si128(x0, stress_hash_fold(x2, k128, x3));
+
+	while (ptr < end) {
+		x0 = stress_hash_fold(x0, k128, _mm_loadu_si128((const __m128i *)ptr));
+		ptr += 16;
+	}
+	return x0;
+}
+
+/*
+ *  stress_hash_bulk_crc32c_clmul()
+ *	crc32c by carry-less multiply folding, short keys and
+ *	the final reduction use the lookup table
+ */
+static uint64_t OPTIMIZE3 __attribute__((target("pclmul,sse4.1"))) stress_hash_bulk_crc32c_clmul(
+	const void *data,
+	const size_t len)
+{
+	const uint8_t *ptr = (const uint8_t *)data;
+	const size_t n = len & ~(size_t)15;
+	uint8_t ALIGN64 rem[16];
+	uint32_t crc;
+
+	if (len < 64)
+		return (uint64_t)~stress_hash_crc32c_update(~0U, data, len);
+
+	_mm_store_si128((__m128i *)rem, stress_hash_clmul_fold(ptr, n, 0xffffffffULL, crc32c_folds));
+	crc = stress_hash_crc32c_update(0, rem, sizeof(rem));
+	crc = stress_hash_crc32c_update(crc, ptr + n, len - n);
+
+	return (uint64_t)~crc;
+}
+
+/*
+ *  stress_hash_bulk_crc64_clmul()
+ *	crc64 by carry-less multiply folding, short keys and
+ *	the final reduction use the lookup table
+ */
+static uint64_t OPTIMIZE3 __attribute__((target("pclmul,sse4.1"))) stress_hash_bulk_crc64_clmul(
+	const void *data,
+	const size_t len)
+{
+	const uint8_t *ptr = (const uint8_t *)data;
+	const size_t n = len & ~(size_t)15;
+	uint8_t ALIGN64 rem[16];
+	uint64_t crc;
+
+	if (len < 64)
+		return stress_hash_crc64(data, len);
+
+	_mm_store_si128((__m128i *)rem, stress_hash_clmul_fold(ptr, n, ~0ULL, crc64_folds));
+	crc = stress_hash_crc64_update(0, rem, sizeof(rem));
+	crc = stress_hash_crc64_update(crc, ptr + n, len - n);
+
+	return ~crc;
+}
+
+/*
+ *  stress_hash_bulk_aeshash()
+ *	a simple AES-NI hash, one aesenc round per 16 byte block
+ *	into two interleaved lanes and three finalizing rounds,
+ *	a throughput reference rather than a standard algorithm
+ */
+static uint64_t OPTIMIZE3 __attribute__((target("aes,sse4.1"))) stress_hash_bulk_aeshash(
+	const void *data,
+	const size_t len)
+{
+	register const uint8_t *ptr = (const uint8_t *)data;
+	const uint8_t *end = ptr + len;
+	const __m128i key = _mm_set_epi64x(0x2d358dccaa6c78a5LL, (long long)0x8bb84b93962eacc9ULL);
+	__m128i h0 = _mm_set_epi64x((long long)len, 0x4b33a62ed433d4a3LL);
+	__m128i h1 = _mm_set_epi64x(0x4d5a2da51de1aa47LL, (long long)len);
+	uint8_t ALIGN64 tail[16];
+
+	while (ptr + 32 <= end) {
+		h0 = _mm_aesenc_si128(_mm_xor_si128(h0, _mm_loadu_si128((const __m128i *)ptr)), key);
+		h1 = _mm_aesenc_si128(_mm_xor_si128(h1, _mm_loadu_si128((const __m128i *)(ptr + 16))), key);
+		ptr += 32;
+	}
+	if (ptr + 16 <= end) {
+		h0 = _mm_aesenc_si128(_mm_xor_si128(h0, _mm_loadu_si128((const __m128i *)ptr)), key);
+		ptr += 16;
+	}
+	if (ptr < end) {
+		(void)memset(tail, 0, sizeof(tail));
+		(void)memcpy(tail, ptr, (size_t)(end - ptr));
+		h1 = _mm_aesenc_si128(_mm_xor_si128(h1, _mm_load_si128((const __m128i *)tail)), key);
+	}
+	h0 = _mm_aesenc_si128(h0, h1);
+	h0 = _mm_aesenc_si128(h0, key);
+	h0 = _mm_aesenc_si128(h0, key);
+
+	return (uint64_t)_mm_cvtsi128_si64(h0) ^ (uint64_t)_mm_extract_epi64(h0, 1);
+}
+
+static bool stress_hash_bulk_has_sse42(void)
+{
+	return __builtin_cpu_supports("sse4.2");
+}
+
+static bool stress_hash_bulk_has_pclmul(void)
+{
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+static bool stress_hash_bulk_has_aes(void)
+{
+	return __builtin_cpu_supports("aes") && __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+typedef struct {
+	const char *name;			/* hash name */
+	const stress_hash_bulk_func_t func;	/* bulk hash function */
+	bool (*supported)(void);		/* true if usable on this CPU */
+} stress_hash_bulk_method_t;
+
+static const stress_hash_bulk_method_t hash_bulk_methods[] = {
+	{ "jenkin",		stress_hash_bulk_jenkin,	stress_hash_bulk_always },
+	{ "murmur3_32",		stress_hash_bulk_murmur3_32,	stress_hash_bulk_always },
+	{ "adler32",		stress_hash_bulk_adler32,	stress_hash_bulk_always },
+	{ "crc32c",		stress_hash_bulk_crc32c,	stress_hash_bulk_always },
+	{ "crc64",		stress_hash_bulk_crc64,		stress_hash_bulk_always },
+	{ "wyhash",		stress_hash_bulk_wyhash,	stress_hash_bulk_always },
+#if defined(HAVE_XXHASH_H) &&	\
+    defined(HAVE_LIB_XXHASH)
+	{ "xxh64",		stress_hash_bulk_xxh64,		stress_hash_bulk_always },
+#if defined(STRESS_HASH_HAVE_XXH3)
+	{ "xxh3",		stress_hash_bulk_xxh3,		stress_hash_bulk_always },
+#endif
+#endif
+#if defined(STRESS_HASH_HAVE_X86_VEC)
+	{ "crc32c_sse42",	stress_hash_bulk_crc32c_sse42,	stress_hash_bulk_has_sse42 },
+	{ "crc32c_clmul",	stress_hash_bulk_crc32c_clmul,	stress_hash_bulk_has_pclmul },
+	{ "crc64_clmul",	stress_hash_bulk_crc64_clmul,	stress_hash_bulk_has_pclmul },
+	{ "aeshash",		stress_hash_bulk_aeshash,	stress_hash_bulk_has_aes },
+#endif
+};
+
+static const size_t hash_bulk_lengths[] = {
+	8, 16, 64, 256, 1 * KB, 4 * KB, 64 * KB, 1 * MB
+};
+
+#define HASH_BULK_METHODS	(SIZEOF_ARRAY(hash_bulk_methods))
+#define HASH_BULK_LENGTHS	(SIZEOF_ARRAY(hash_bulk_lengths))
+
+typedef struct {
+	double duration;	/* time spent hashing */
+	double hashes;		/* number of hashes */
+} stress_hash_bulk_point_t;
+
+/*
+ *  stress_hash_bulk_continue()
+ *	keep_stressing() without --rate pacing, pacing the
+ *	hashing would skew the measurements
+ */
+static inline bool stress_hash_bulk_continue(const stress_args_t *args)
+{
+	if (!keep_stressing_flag())
+		return false;
+	return !(args->max_ops && (get_counter(args) >= args->max_ops));
+}
+
+/*
+ *  stress_hash_bulk_verify()
+ *	check the hardware accelerated crcs against the table
+ *	implementations over a range of lengths and offsets and
+ *	that aeshash is deterministic
+ */
+static int stress_hash_bulk_verify(const stress_args_t *args, const uint8_t *buf)
+{
+#if defined(STRESS_HASH_HAVE_X86_VEC)
+	size_t len, offset;
+
+	for (len = 0; len < 1100; len += (len < 160) ? 1 : 37) {
+		for (offset = 0; offset < 4; offset++) {
+			const uint8_t *ptr = buf + offset;
+			const uint64_t crc32c = stress_hash_bulk_crc32c(ptr, len);
+			const uint64_t crc64 = stress_hash_bulk_crc64(ptr, len);
+
+			if (stress_hash_bulk_has_sse42() &&
+			    (stress_hash_bulk_crc32c_sse42(ptr, len) != crc32c)) {
+				pr_fail("%s: crc32c_sse42 of %zu bytes is different from the table crc32c\n",
+					args->name, len);
+				return EXIT_FAILURE;
+			}
+			if (stress_hash_bulk_has_pclmul()) {
+				if (stress_hash_bulk_crc32c_clmul(ptr, len) != crc32c) {
+					pr_fail("%s: crc32c_clmul of %zu bytes is different from the table crc32c\n",
+						args->name, len);
+					return EXIT_FAILURE;
+				}
+				if (stress_hash_bulk_crc64_clmul(ptr, len) != crc64) {
+					pr_fail("%s: crc64_clmul of %zu bytes is different from the table crc64\n",
+						args->name, len);
+					return EXIT_FAILURE;
+				}
+			}
+			if (stress_hash_bulk_has_aes() &&
+			    (stress_hash_bulk_aeshash(ptr, len) != stress_hash_bulk_aeshash(ptr, len))) {
+				pr_fail("%s: aeshash of %zu bytes is not deterministic\n",
+					args->name, len);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+#else
+	(void)args;
+	(void)buf;
+#endif
+	/* CRC-64/XZ check value */
+	if (stress_hash_crc64("123456789", 9) != 0x995dc9bbdf1939faULL) {
+		pr_fail("%s: crc64 check value is different than expected\n", args->name);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_hash_bulk_report()
+ *	log ns per hash and GB/sec of each method and key length,
+ *	metrics are ns per hash for keys under 4K where per call
+ *	overhead dominates and GB per sec for the larger keys
+ */
+static void stress_hash_bulk_report(
+	const stress_args_t *args,
+	stress_hash_bulk_point_t points[HASH_BULK_METHODS][HASH_BULK_LENGTHS])
+{
+	size_t i, j, n = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %-12s %6s %12s %8s\n", args->name,
+			"hash", "length", "ns/hash", "GB/sec");
+	}
+
+	for (i = 0; i < HASH_BULK_METHODS; i++) {
+		for (j = 0; j < HASH_BULK_LENGTHS; j++) {
+			const stress_hash_bulk_point_t *point = &points[i][j];
+			const size_t len = hash_bulk_lengths[j];
+			double ns, rate;
+			char len_str[16], str[64];
+
+			if ((point->duration <= 0.0) || (point->hashes <= 0.0))
+				continue;
+			ns = (point->duration * STRESS_DBL_NANOSECOND) / point->hashes;
+			rate = ((point->hashes * (double)len) / point->duration) / (double)GB;
+
+			if (len >= MB)
+				(void)snprintf(len_str, sizeof(len_str), "%zuM", len / (size_t)MB);
+			else if (len >= KB)
+				(void)snprintf(len_str, sizeof(len_str), "%zuK", len / (size_t)KB);
+			else
+				(void)snprintf(len_str, sizeof(len_str), "%zu", len);
+
+			if (args->instance == 0)
+				pr_inf("%s: %-12s %6s %12.2f %8.2f\n", args->name,
+					hash_bulk_methods[i].name, len_str, ns, rate);
+
+			if (len < 4 * KB) {
+				(void)snprintf(str, sizeof(str), "%s %s byte ns per hash",
+					hash_bulk_methods[i].name, len_str);
+				stress_metrics_set(args, n, str, ns);
+			} else {
+				(void)snprintf(str, sizeof(str), "%s %s GB per sec",
+					hash_bulk_methods[i].name, len_str);
+				stress_metrics_set(args, n, str, rate);
+			}
+			n++;
+		}
+	}
+
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_hash_bulk()
+ *	hash binary keys of each length with each bulk method, keys
+ *	are walked through a random buffer larger than the L2 cache,
+ *	each point hashes about HASH_BULK_BYTES per sweep and the
+ *	sweep repeats, accumulating, until the run ends
+ */
+static int stress_hash_bulk(const stress_args_t *args)
+{
+	stress_hash_bulk_point_t (*points)[HASH_BULK_LENGTHS];
+	bool supported[HASH_BULK_METHODS];
+	uint8_t *buf;
+	size_t i, j;
+	int rc = EXIT_SUCCESS;
+	uint64_t sum = 0;
+
+	points = calloc(HASH_BULK_METHODS, sizeof(*points));
+	if (!points) {
+		pr_inf_skip("%s: cannot allocate bulk hash results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (uint8_t *)mmap(NULL, HASH_BULK_BUF_SIZE, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte key buffer, skipping stressor\n",
+			args->name, (size_t)HASH_BULK_BUF_SIZE);
+		free(points);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_rndbuf(buf, HASH_BULK_BUF_SIZE);
+
+	for (i = 0; i < HASH_BULK_METHODS; i++)
+		supported[i] = hash_bulk_methods[i].supported();
+
+	if (g_opt_flags & OPT_FLAGS_VERIFY)
+		rc = stress_hash_bulk_verify(args, buf);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	while ((rc == EXIT_SUCCESS) && stress_hash_bulk_continue(args)) {
+		for (i = 0; i < HASH_BULK_METHODS; i++) {
+			const stress_hash_bulk_func_t func = hash_bulk_methods[i].func;
+
+			if (!supported[i])
+				continue;
+			for (j = 0; j < HASH_BULK_LENGTHS; j++) {
+				const size_t len = hash_bulk_lengths[j];
+				const size_t calls = STRESS_MAXIMUM(HASH_BULK_MIN_CALLS, HASH_BULK_BYTES / len);
+				const size_t keys = HASH_BULK_BUF_SIZE / len;
+				register size_t c, k = 0;
+				double t;
+
+				t = stress_time_now();
+				for (c = 0; c < calls; c++) {
+					sum += func(buf + (k * len), len);
+					k++;
+					if (k >= keys)
+						k = 0;
+				}
+				points[i][j].duration += stress_time_now() - t;
+				points[i][j].hashes += (double)calls;
+				add_counter(args, calls);
+
+				if (!stress_hash_bulk_continue(args))
+					goto report;
+			}
+		}
+	}
+report:
+	stress_uint64_put(sum);
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_hash_bulk_report(args, points);
+
+	(void)munmap((void *)buf, HASH_BULK_BUF_SIZE);
+	free(points);
+
+	return rc;
+}
+
 /*
  *  stress_hash()
  *	stress CPU by doing floating point math ops
@@ -663,6 +1253,11 @@ static int HOT OPTIMIZE3 stress_hash(const stress_args_t *args)
 	size_t hash_method = 0;
 	stress_bucket_t bucket;
 	void *buffer;
+	bool hash_bulk = false;
+
+	(void)stress_get_setting("hash-bulk", &hash_bulk);
+	if (hash_bulk)
+		return stress_hash_bulk(args);
 
 	bucket.n_keys = 128;
 	bucket.n_buckets = 256;
@@ -702,6 +1297,18 @@ static int HOT OPTIMIZE3 stress_hash(const stress_args_t *args)
 		inc_counter(args);
 	} while (keep_stressing(args));
 
+	for (i = 1; hash_methods[i].name; i++) {
+		const stress_hash_stats_t *stats = hash_methods[i].stats;
+
+		if ((stats->duration > 0.0) && (stats->total > 0)) {
+			char msg[64];
+			const double rate = (double)stats->total / stats->duration;
+
+			(void)snprintf(msg, sizeof(msg), "%s hashes per sec", hash_methods[i].name);
+			stress_metrics_set(args, i - 1, msg, rate);
+		}
+	}
+
 	if (args->instance == 0) {
 		pr_lock();
 		pr_inf("%s: %12.12s %15s %10s\n",
@@ -734,6 +1341,7 @@ static void stress_hash_set_default(void)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_hash_bulk,	stress_set_hash_bulk },
 	{ OPT_hash_method,	stress_set_hash_method },
 	{ 0,			NULL },
 };
@@ -0,0 +1,832 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-builtin.h"
+#include "core-hash.h"
+#include "core-put.h"
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#include <linux/perf_event.h>
+#endif
+
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H)
+#include <immintrin.h>
+#define STRESS_HASHTABLE_SSE2
+#endif
+
+#define MIN_HASHTABLE_SIZE	(1 * KB)
+#define MAX_HASHTABLE_SIZE	(4 * MB)
+#define DEFAULT_HASHTABLE_SIZE	(64 * KB)
+
+#define HASHTABLE_GROUP		(16)	/* control bytes per swiss table group */
+#define HASHTABLE_SEED		(0x9e3779b97f4a7c15ULL)
+
+/* swiss table control byte states, full slots hold the 7 bit h2 hash */
+#define CTRL_EMPTY		((uint8_t)0x80)
+#define CTRL_DELETED		((uint8_t)0xfe)
+
+#define HASHTABLE_OP_INSERT	(0)
+#define HASHTABLE_OP_HIT	(1)
+#define HASHTABLE_OP_MISS	(2)
+#define HASHTABLE_OP_DELETE	(3)
+#define HASHTABLE_OPS		(4)
+
+static const stress_help_t help[] = {
+	{ NULL,	"hashtable N",		"start N workers benchmarking chained and swiss hash tables" },
+	{ NULL,	"hashtable-method M",	"select hash table, one of all, chain or swiss" },
+	{ NULL,	"hashtable-ops N",	"stop after N hash table bogo operations" },
+	{ NULL,	"hashtable-size N",	"number of hash table slots, a power of 2" },
+	{ NULL,	NULL,			NULL }
+};
+
+/* chained table node, malloc'd per entry as in core-hash */
+typedef struct stress_hashtable_node {
+	struct stress_hashtable_node *next;	/* next node in bucket */
+	uint64_t value;				/* value */
+	uint8_t key[];				/* key_size bytes of key */
+} stress_hashtable_node_t;
+
+typedef struct {
+	stress_hashtable_node_t **buckets;	/* bucket heads */
+	size_t mask;				/* buckets - 1 */
+} stress_hashtable_chain_t;
+
+/*
+ *  swiss table, slots are in groups of HASHTABLE_GROUP, each with
+ *  a control byte, lookups match the 7 bit h2 hash against all the
+ *  control bytes of a group at once and only compare keys on a match
+ */
+typedef struct {
+	uint8_t *ctrl;				/* control bytes */
+	uint8_t *slots;				/* value then key per slot */
+	size_t slot_size;			/* bytes per slot */
+	size_t group_mask;			/* groups - 1 */
+	size_t ctrl_size;			/* mmap'd sizes */
+	size_t slots_size;
+} stress_hashtable_swiss_t;
+
+typedef struct {
+	stress_hashtable_chain_t chain;
+	stress_hashtable_swiss_t swiss;
+	size_t size;				/* slots / buckets */
+	size_t key_size;			/* bytes per key */
+} stress_hashtable_t;
+
+typedef struct {
+	double duration;			/* time spent in ops */
+	double ops;				/* number of ops */
+	double misses;				/* cache misses */
+} stress_hashtable_point_t;
+
+typedef struct {
+	const char *name;
+	int (*init)(stress_hashtable_t *table);
+	void (*reset)(stress_hashtable_t *table);
+	void (*deinit)(stress_hashtable_t *table);
+	bool (*insert)(stress_hashtable_t *table, const uint8_t *key, const uint64_t value);
+	bool (*lookup)(stress_hashtable_t *table, const uint8_t *key, uint64_t *value);
+	bool (*delete)(stress_hashtable_t *table, const uint8_t *key);
+} stress_hashtable_method_t;
+
+static const char * const hashtable_op_names[HASHTABLE_OPS] = {
+	"insert",
+	"lookup-hit",
+	"lookup-miss",
+	"delete",
+};
+
+static const size_t hashtable_key_sizes[] = {
+	8, 16, 32, 64
+};
+
+/* load factors in 1/8ths */
+static const size_t hashtable_loads[] = {
+	2, 4, 6, 7
+};
+
+#define HASHTABLE_KEY_SIZES	(SIZEOF_ARRAY(hashtable_key_sizes))
+#define HASHTABLE_LOADS		(SIZEOF_ARRAY(hashtable_loads))
+
+static inline uint64_t stress_hashtable_hash(const stress_hashtable_t *table, const uint8_t *key)
+{
+	return stress_hash_wyhash(key, table->key_size, HASHTABLE_SEED);
+}
+
+static int stress_hashtable_chain_init(stress_hashtable_t *table)
+{
+	table->chain.buckets = calloc(table->size, sizeof(*table->chain.buckets));
+	if (!table->chain.buckets)
+		return -1;
+	table->chain.mask = table->size - 1;
+	return 0;
+}
+
+static void stress_hashtable_chain_reset(stress_hashtable_t *table)
+{
+	size_t i;
+
+	for (i = 0; i < table->size; i++) {
+		stress_hashtable_node_t *node = table->chain.buckets[i];
+
+		while (node) {
+			stress_hashtable_node_t *next = node->next;
+
+			free(node);
+			node = next;
+		}
+		table->chain.buckets[i] = NULL;
+	}
+}
+
+static void stress_hashtable_chain_deinit(stress_hashtable_t *table)
+{
+	stress_hashtable_chain_reset(table);
+	free(table->chain.buckets);
+	table->chain.buckets = NULL;
+}
+
+static bool OPTIMIZE3 stress_hashtable_chain_insert(
+	stress_hashtable_t *table,
+	const uint8_t *key,
+	const uint64_t value)
+{
+	const size_t key_size = table->key_size;
+	stress_hashtable_node_t **head =
+		&table->chain.buckets[stress_hashtable_hash(table, key) & table->chain.mask];
+	stress_hashtable_node_t *node;
+
+	for (node = *head; node; node = node->next) {
+		if (!memcmp(node->key, key, key_size)) {
+			node->value = value;
+			return true;
+		}
+	}
+	node = malloc(sizeof(*node) + key_size);
+	if (UNLIKELY(!node))
+		return false;
+	node->value = value;
+	(void)memcpy(node->key, key, key_size);
+	node->next = *head;
+	*head = node;
+
+	return true;
+}
+
+static bool OPTIMIZE3 stress_hashtable_chain_lookup(
+	stress_hashtable_t *table,
+	const uint8_t *key,
+	uint64_t *value)
+{
+	const size_t key_size = table->key_size;
+	stress_hashtable_node_t *node;
+
+	node = table->chain.buckets[stress_hashtable_hash(table, key) & table->chain.mask];
+	for (; node; node = node->next) {
+		if (!memcmp(node->key, key, key_size)) {
+			*value = node->value;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool OPTIMIZE3 stress_hashtable_chain_delete(
+	stress_hashtable_t *table,
+	const uint8_t *key)
+{
+	const size_t key_size = table->key_size;
+	stress_hashtable_node_t **prev =
+		&table->chain.buckets[stress_hashtable_hash(table, key) & table->chain.mask];
+	stress_hashtable_node_t *node;
+
+	for (node = *prev; node; prev = &node->next, node = node->next) {
+		if (!memcmp(node->key, key, key_size)) {
+			*prev = node->next;
+			free(node);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ *  stress_hashtable_ctz()
+ *	index of the lowest set bit of a non-zero group mask
+ */
+static inline size_t stress_hashtable_ctz(uint32_t mask)
+{
+#if defined(HAVE_BUILTIN_CTZ)
+	return (size_t)__builtin_ctz(mask);
+#else
+	size_t n = 0;
+
+	while (!(mask & 1)) {
+		mask >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/*
+ *  stress_hashtable_match()
+ *	bitmask of the control bytes in a group equal to h,
+ *	the SWAR fallback may flag false positives after a
+ *	true match, these are weeded out by the key compare
+ */
+static inline uint32_t stress_hashtable_match(const uint8_t *ctrl, const uint8_t h)
+{
+#if defined(STRESS_HASHTABLE_SSE2)
+	const __m128i group = _mm_load_si128((const __m128i *)ctrl);
+
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h)));
+#else
+	const uint64_t lsbs = 0x0101010101010101ULL;
+	const uint64_t msbs = 0x8080808080808080ULL;
+	uint32_t mask = 0;
+	size_t i, j;
+
+	for (i = 0; i < HASHTABLE_GROUP; i += 8) {
+		uint64_t v, x, m;
+
+		(void)memcpy(&v, ctrl + i, sizeof(v));
+		x = v ^ (lsbs * h);
+		m = (x - lsbs) & ~x & msbs;
+		for (j = 0; j < 8; j++)
+			mask |= (uint32_t)((m >> ((j * 8) + 7)) & 1) << (i + j);
+	}
+	return mask;
+#endif
+}
+
+/*
+ *  stress_hashtable_match_empty()
+ *	bitmask of the empty control bytes in a group
+ */
+static inline uint32_t stress_hashtable_match_empty(const uint8_t *ctrl)
+{
+	return stress_hashtable_match(ctrl, CTRL_EMPTY);
+}
+
+/*
+ *  stress_hashtable_match_free()
+ *	bitmask of the empty or deleted control bytes in a group
+ */
+static inline uint32_t stress_hashtable_match_free(const uint8_t *ctrl)
+{
+#if defined(STRESS_HASHTABLE_SSE2)
+	return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+#else
+	uint32_t mask = 0;
+	size_t i;
+
+	for (i = 0; i < HASHTABLE_GROUP; i++)
+		mask |= (uint32_t)(ctrl[i] >> 7) << i;
+	return mask;
+#endif
+}
+
+static inline uint8_t *stress_hashtable_swiss_slot(const stress_hashtable_swiss_t *swiss, const size_t slot)
+{
+	return swiss->slots + (slot * swiss->slot_size);
+}
+
+/*
+ *  stress_hashtable_swiss_find()
+ *	find the slot holding key, returns -1 if not found
+ */
+static inline ssize_t OPTIMIZE3 stress_hashtable_swiss_find(
+	const stress_hashtable_t *table,
+	const uint8_t *key,
+	const uint64_t hash)
+{
+	const stress_hashtable_swiss_t *swiss = &table->swiss;
+	const uint8_t h2 = (uint8_t)(hash & 0x7f);
+	register size_t group = (size_t)(hash >> 7) & swiss->group_mask;
+	register size_t probe = 0;
+
+	for (;;) {
+		const uint8_t *ctrl = swiss->ctrl + (group * HASHTABLE_GROUP);
+		uint32_t match = stress_hashtable_match(ctrl, h2);
+
+		while (match) {
+			const size_t slot = (group * HASHTABLE_GROUP) + stress_hashtable_ctz(match);
+
+			if (LIKELY(ctrl[slot & (HASHTABLE_GROUP - 1)] == h2) &&
+			    !memcmp(stress_hashtable_swiss_slot(swiss, slot) + sizeof(uint64_t),
+				    key, table->key_size))
+				return (ssize_t)slot;
+			match &= match - 1;
+		}
+		if (LIKELY(stress_hashtable_match_empty(ctrl)))
+			return -1;
+		/* triangular probing visits every group */
+		probe++;
+		if (UNLIKELY(probe > swiss->group_mask))
+			return -1;
+		group = (group + probe) & swiss->group_mask;
+	}
+}
+
+static int stress_hashtable_swiss_init(stress_hashtable_t *table)
+{
+	stress_hashtable_swiss_t *swiss = &table->swiss;
+
+	swiss->slot_size = sizeof(uint64_t) + table->key_size;
+	swiss->group_mask = (table->size / HASHTABLE_GROUP) - 1;
+	swiss->ctrl_size = table->size;
+	swiss->slots_size = table->size * swiss->slot_size;
+
+	swiss->ctrl = (uint8_t *)mmap(NULL, swiss->ctrl_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (swiss->ctrl == MAP_FAILED)
+		return -1;
+	swiss->slots = (uint8_t *)mmap(NULL, swiss->slots_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (swiss->slots == MAP_FAILED) {
+		(void)munmap((void *)swiss->ctrl, swiss->ctrl_size);
+		return -1;
+	}
+	(void)memset(swiss->ctrl, CTRL_EMPTY, swiss->ctrl_size);
+	/* fault in the slots so first inserts are not page fault bound */
+	(void)memset(swiss->slots, 0, swiss->slots_size);
+	return 0;
+}
+
+static void stress_hashtable_swiss_reset(stress_hashtable_t *table)
+{
+	(void)memset(table->swiss.ctrl, CTRL_EMPTY, table->swiss.ctrl_size);
+}
+
+static void stress_hashtable_swiss_deinit(stress_hashtable_t *table)
+{
+	(void)munmap((void *)table->swiss.slots, table->swiss.slots_size);
+	(void)munmap((void *)table->swiss.ctrl, table->swiss.ctrl_size);
+}
+
+static bool OPTIMIZE3 stress_hashtable_swiss_insert(
+	stress_hashtable_t *table,
+	const uint8_t *key,
+	const uint64_t value)
+{
+	stress_hashtable_swiss_t *swiss = &table->swiss;
+	const uint64_t hash = stress_hashtable_hash(table, key);
+	register size_t group = (size_t)(hash >> 7) & swiss->group_mask;
+	register size_t probe = 0;
+	ssize_t slot;
+	uint8_t *ptr;
+
+	slot = stress_hashtable_swiss_find(table, key, hash);
+	if (slot >= 0) {
+		(void)memcpy(stress_hashtable_swiss_slot(swiss, (size_t)slot), &value, sizeof(value));
+		return true;
+	}
+
+	/* first empty or deleted slot along the probe sequence */
+	for (;;) {
+		const uint32_t match = stress_hashtable_match_free(swiss->ctrl + (group * HASHTABLE_GROUP));
+
+		if (LIKELY(match)) {
+			slot = (ssize_t)((group * HASHTABLE_GROUP) + stress_hashtable_ctz(match));
+			break;
+		}
+		probe++;
+		if (UNLIKELY(probe > swiss->group_mask))
+			return false;
+		group = (group + probe) & swiss->group_mask;
+	}
+	swiss->ctrl[slot] = (uint8_t)(hash & 0x7f);
+	ptr = stress_hashtable_swiss_slot(swiss, (size_t)slot);
+	(void)memcpy(ptr, &value, sizeof(value));
+	(void)memcpy(ptr + sizeof(value), key, table->key_size);
+
+	return true;
+}
+
+static bool OPTIMIZE3 stress_hashtable_swiss_lookup(
+	stress_hashtable_t *table,
+	const uint8_t *key,
+	uint64_t *value)
+{
+	const ssize_t slot = stress_hashtable_swiss_find(table, key, stress_hashtable_hash(table, key));
+
+	if (slot < 0)
+		return false;
+	(void)memcpy(value, stress_hashtable_swiss_slot(&table->swiss, (size_t)slot), sizeof(*value));
+	return true;
+}
+
+/*
+ *  stress_hashtable_swiss_delete()
+ *	a probe for any key stops at the first group with an empty
+ *	slot, so if the slot's group has one the slot can be made
+ *	empty again, otherwise it has to become a tombstone
+ */
+static bool OPTIMIZE3 stress_hashtable_swiss_delete(
+	stress_hashtable_t *table,
+	const uint8_t *key)
+{
+	stress_hashtable_swiss_t *swiss = &table->swiss;
+	const ssize_t slot = stress_hashtable_swiss_find(table, key, stress_hashtable_hash(table, key));
+	const uint8_t *ctrl;
+
+	if (slot < 0)
+		return false;
+	ctrl = swiss->ctrl + ((size_t)slot & ~(size_t)(HASHTABLE_GROUP - 1));
+	swiss->ctrl[slot] = stress_hashtable_match_empty(ctrl) ? CTRL_EMPTY : CTRL_DELETED;
+
+	return true;
+}
+
+static const stress_hashtable_method_t hashtable_methods[] = {
+	{ "chain",	stress_hashtable_chain_init,	stress_hashtable_chain_reset,
+			stress_hashtable_chain_deinit,	stress_hashtable_chain_insert,
+			stress_hashtable_chain_lookup,	stress_hashtable_chain_delete },
+	{ "swiss",	stress_hashtable_swiss_init,	stress_hashtable_swiss_reset,
+			stress_hashtable_swiss_deinit,	stress_hashtable_swiss_insert,
+			stress_hashtable_swiss_lookup,	stress_hashtable_swiss_delete },
+};
+
+#define HASHTABLE_METHODS	(SIZEOF_ARRAY(hashtable_methods))
+
+/*
+ *  stress_set_hashtable_method()
+ *	set the hash table method, index HASHTABLE_METHODS is all
+ */
+static int stress_set_hashtable_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = HASHTABLE_METHODS;
+		return stress_set_setting("hashtable-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < HASHTABLE_METHODS; i++) {
+		if (!strcmp(opt, hashtable_methods[i].name))
+			return stress_set_setting("hashtable-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "hashtable-method must be one of: all");
+	for (i = 0; i < HASHTABLE_METHODS; i++)
+		(void)fprintf(stderr, " %s", hashtable_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_hashtable_size(const char *opt)
+{
+	uint64_t hashtable_size;
+
+	hashtable_size = stress_get_uint64_byte(opt);
+	stress_check_power_of_2("hashtable-size", hashtable_size,
+		MIN_HASHTABLE_SIZE, MAX_HASHTABLE_SIZE);
+	return stress_set_setting("hashtable-size", TYPE_ID_UINT64, &hashtable_size);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_hashtable_method,	stress_set_hashtable_method },
+	{ OPT_hashtable_size,	stress_set_hashtable_size },
+	{ 0,			NULL }
+};
+
+/*
+ *  stress_hashtable_perf_open()
+ *	open a user space cache miss counter for this process,
+ *	returns -1 if there is none
+ */
+static int stress_hashtable_perf_open(void)
+{
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static inline uint64_t stress_hashtable_perf_read(const int fd)
+{
+	uint64_t count = 0;
+
+	if ((fd < 0) || (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)))
+		return 0;
+	return count;
+}
+
+/*
+ *  stress_hashtable_run()
+ *	run one op over keys, returns the number of ops that
+ *	succeeded, lookup values are summed into *sum
+ */
+static size_t OPTIMIZE3 stress_hashtable_run(
+	const stress_hashtable_method_t *method,
+	stress_hashtable_t *table,
+	const int op,
+	const uint8_t *keys,
+	const size_t n,
+	uint64_t *sum)
+{
+	const size_t key_size = table->key_size;
+	register size_t i, ok = 0;
+	uint64_t value = 0;
+
+	switch (op) {
+	case HASHTABLE_OP_INSERT:
+		for (i = 0; i < n; i++)
+			ok += method->insert(table, keys + (i * key_size), (uint64_t)i);
+		break;
+	case HASHTABLE_OP_HIT:
+		for (i = 0; i < n; i++) {
+			if (method->lookup(table, keys + (i * key_size), &value)) {
+				ok += (value == (uint64_t)i);
+				*sum += value;
+			}
+		}
+		break;
+	case HASHTABLE_OP_MISS:
+		for (i = 0; i < n; i++) {
+			if (!method->lookup(table, keys + (i * key_size), &value))
+				ok++;
+			else
+				*sum += value;
+		}
+		break;
+	case HASHTABLE_OP_DELETE:
+		for (i = 0; i < n; i++)
+			ok += method->delete(table, keys + (i * key_size));
+		break;
+	default:
+		break;
+	}
+	return ok;
+}
+
+/*
+ *  stress_hashtable_keys()
+ *	fill the key buffer with n distinct random keys, the first 8
+ *	bytes of each are a bijection of the key index so keys never
+ *	collide, the remaining bytes are random
+ */
+static void stress_hashtable_keys(uint8_t *keys, const size_t n, const size_t key_size)
+{
+	const uint64_t salt = stress_mwc64();
+	size_t i;
+
+	stress_rndbuf(keys, n * key_size);
+	for (i = 0; i < n; i++) {
+		const uint64_t v = ((uint64_t)i * 0x9e3779b97f4a7c15ULL) ^ salt;
+
+		(void)memcpy(keys + (i * key_size), &v, sizeof(v));
+	}
+}
+
+/*
+ *  stress_hashtable_report()
+ *	log Mops/sec and cache misses per op of each method, key size,
+ *	load factor and op, metrics are the ops per second of each
+ *	method, op and load factor over all key sizes and the cache
+ *	misses per op of each method and op
+ */
+static void stress_hashtable_report(
+	const stress_args_t *args,
+	stress_hashtable_point_t points[HASHTABLE_METHODS][HASHTABLE_KEY_SIZES][HASHTABLE_LOADS][HASHTABLE_OPS],
+	const bool have_perf)
+{
+	size_t m, k, l;
+	int op;
+	size_t n = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %-5s %4s %5s %11s %11s %11s %11s  (Mops/sec%s)\n",
+			args->name, "table", "key", "load",
+			hashtable_op_names[0], hashtable_op_names[1],
+			hashtable_op_names[2], hashtable_op_names[3],
+			have_perf ? ", cache misses per op" : "");
+	}
+
+	for (m = 0; m < HASHTABLE_METHODS; m++) {
+		for (k = 0; k < HASHTABLE_KEY_SIZES; k++) {
+			for (l = 0; l < HASHTABLE_LOADS; l++) {
+				char rates[HASHTABLE_OPS][16], misses[HASHTABLE_OPS][16];
+				bool valid = false;
+
+				for (op = 0; op < HASHTABLE_OPS; op++) {
+					const stress_hashtable_point_t *point = &points[m][k][l][op];
+
+					(void)shim_strlcpy(rates[op], "-", sizeof(rates[op]));
+					(void)shim_strlcpy(misses[op], "-", sizeof(misses[op]));
+					if ((point->duration <= 0.0) || (point->ops <= 0.0))
+						continue;
+					valid = true;
+					(void)snprintf(rates[op], sizeof(rates[op]), "%.2f",
+						(point->ops / point->duration) / 1000000.0);
+					(void)snprintf(misses[op], sizeof(misses[op]), "%.3f",
+						point->misses / point->ops);
+				}
+				if (!valid || (args->instance != 0))
+					continue;
+				pr_inf("%s: %-5s %4zu %4.1f%% %11s %11s %11s %11s\n",
+					args->name, hashtable_methods[m].name,
+					hashtable_key_sizes[k], (double)hashtable_loads[l] * 12.5,
+					rates[0], rates[1], rates[2], rates[3]);
+				if (have_perf)
+					pr_inf("%s: %-5s %4s %5s %11s %11s %11s %11s\n",
+						args->name, "", "", "",
+						misses[0], misses[1], misses[2], misses[3]);
+			}
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	for (m = 0; m < HASHTABLE_METHODS; m++) {
+		for (op = 0; op < HASHTABLE_OPS; op++) {
+			double total_ops = 0.0, total_misses = 0.0;
+			char str[64];
+
+			for (l = 0; l < HASHTABLE_LOADS; l++) {
+				double duration = 0.0, ops = 0.0;
+
+				for (k = 0; k < HASHTABLE_KEY_SIZES; k++) {
+					duration += points[m][k][l][op].duration;
+					ops += points[m][k][l][op].ops;
+					total_misses += points[m][k][l][op].misses;
+				}
+				total_ops += ops;
+				if (duration <= 0.0)
+					continue;
+				(void)snprintf(str, sizeof(str), "%s %s ops per sec at %.1f%% load",
+					hashtable_methods[m].name, hashtable_op_names[op],
+					(double)hashtable_loads[l] * 12.5);
+				stress_metrics_set(args, n++, str, ops / duration);
+			}
+			if (have_perf && (total_ops > 0.0)) {
+				(void)snprintf(str, sizeof(str), "%s %s cache misses per op",
+					hashtable_methods[m].name, hashtable_op_names[op]);
+				stress_metrics_set(args, n++, str, total_misses / total_ops);
+			}
+		}
+	}
+}
+
+/*
+ *  stress_hashtable()
+ *	for each table, key size and load factor fill the table,
+ *	look up all the keys, look up as many absent keys then
+ *	delete all the keys, timing each op, the sweep repeats,
+ *	accumulating, until the run ends
+ */
+static int stress_hashtable(const stress_args_t *args)
+{
+	stress_hashtable_point_t (*points)[HASHTABLE_KEY_SIZES][HASHTABLE_LOADS][HASHTABLE_OPS];
+	uint64_t hashtable_size = DEFAULT_HASHTABLE_SIZE;
+	size_t hashtable_method = HASHTABLE_METHODS;
+	stress_hashtable_t table;
+	size_t keys_size, m, k, l;
+	uint8_t *keys;
+	uint64_t sum = 0;
+	int rc = EXIT_SUCCESS, fd;
+
+	if (!stress_get_setting("hashtable-size", &hashtable_size)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			hashtable_size = MAX_HASHTABLE_SIZE;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			hashtable_size = MIN_HASHTABLE_SIZE;
+	}
+	(void)stress_get_setting("hashtable-method", &hashtable_method);
+
+	points = calloc(HASHTABLE_METHODS, sizeof(*points));
+	if (!points) {
+		pr_inf_skip("%s: cannot allocate results, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	/* present keys followed by as many absent keys for the largest key and load */
+	keys_size = 2 * ((size_t)hashtable_size * hashtable_loads[HASHTABLE_LOADS - 1] / 8) *
+		hashtable_key_sizes[HASHTABLE_KEY_SIZES - 1];
+	keys = (uint8_t *)mmap(NULL, keys_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (keys == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte key buffer, skipping stressor\n",
+			args->name, keys_size);
+		free(points);
+		return EXIT_NO_RESOURCE;
+	}
+
+	fd = stress_hashtable_perf_open();
+	if ((fd < 0) && (args->instance == 0))
+		pr_inf("%s: cannot open a hardware cache miss counter, "
+			"cache misses will not be reported\n", args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	while ((rc == EXIT_SUCCESS) && keep_stressing(args)) {
+		for (k = 0; k < HASHTABLE_KEY_SIZES; k++) {
+			const size_t key_size = hashtable_key_sizes[k];
+
+			stress_hashtable_keys(keys, 2 * ((size_t)hashtable_size *
+				hashtable_loads[HASHTABLE_LOADS - 1] / 8), key_size);
+
+			for (m = 0; m < HASHTABLE_METHODS; m++) {
+				const stress_hashtable_method_t *method = &hashtable_methods[m];
+
+				if ((hashtable_method < HASHTABLE_METHODS) && (hashtable_method != m))
+					continue;
+
+				(void)memset(&table, 0, sizeof(table));
+				table.size = (size_t)hashtable_size;
+				table.key_size = key_size;
+				if (method->init(&table) < 0) {
+					pr_inf_skip("%s: cannot allocate %s hash table, skipping stressor\n",
+						args->name, method->name);
+					rc = EXIT_NO_RESOURCE;
+					goto tidy;
+				}
+
+				for (l = 0; l < HASHTABLE_LOADS; l++) {
+					const size_t n = ((size_t)hashtable_size * hashtable_loads[l]) / 8;
+					int op;
+
+					for (op = 0; op < HASHTABLE_OPS; op++) {
+						stress_hashtable_point_t *point = &points[m][k][l][op];
+						const uint8_t *op_keys = (op == HASHTABLE_OP_MISS) ?
+							keys + (n * key_size) : keys;
+						const uint64_t misses = stress_hashtable_perf_read(fd);
+						const double t = stress_time_now();
+						const size_t ok = stress_hashtable_run(method, &table, op, op_keys, n, &sum);
+
+						point->duration += stress_time_now() - t;
+						point->misses += (double)(stress_hashtable_perf_read(fd) - misses);
+						point->ops += (double)n;
+						add_counter(args, n);
+
+						if (ok != n) {
+							pr_fail("%s: %s %s of %zu byte keys at %.1f%% load, "
+								"%zu of %zu ops failed\n",
+								args->name, method->name, hashtable_op_names[op],
+								key_size, (double)hashtable_loads[l] * 12.5, n - ok, n);
+							rc = EXIT_FAILURE;
+							method->deinit(&table);
+							goto tidy;
+						}
+					}
+					/* clear out swiss table tombstones */
+					method->reset(&table);
+
+					if (!keep_stressing(args)) {
+						method->deinit(&table);
+						goto tidy;
+					}
+				}
+				method->deinit(&table);
+			}
+		}
+	}
+tidy:
+	stress_uint64_put(sum);
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_hashtable_report(args, points, fd >= 0);
+
+	if (fd >= 0)
+		(void)close(fd);
+	(void)munmap((void *)keys, keys_size);
+	free(points);
+
+	return rc;
+}
+
+stressor_info_t stress_hashtable_info = {
+	.stressor = stress_hashtable,
+	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
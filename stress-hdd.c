@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-io-sweep.h"
 #include "core-pragma.h"
 
 #if defined(HAVE_SYS_UIO_H)
@@ -82,6 +83,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"hdd-bytes N",		"write N bytes per hdd worker (default is 1GB)" },
 	{ NULL,	"hdd-ops N",		"stop after N hdd bogo operations" },
 	{ NULL,	"hdd-opts list",	"specify list of various stressor options" },
+	{ NULL,	"hdd-qd-sweep M",	"io_uring block size and queue depth sweep with pattern M" },
 	{ NULL,	"hdd-write-size N",	"set the default write size to N bytes" },
 	{ NULL, NULL,			NULL }
 };
@@ -176,6 +178,11 @@ static int stress_set_hdd_write_size(const char *opt)
 	return stress_set_setting("hdd-write-size", TYPE_ID_UINT64, &hdd_write_size);
 }
 
+static int stress_set_hdd_qd_sweep(const char *opt)
+{
+	return stress_set_io_sweep("hdd-qd-sweep", opt, true);
+}
+
 #if defined(HAVE_FUTIMES)
 static void stress_hdd_utimes(const int fd)
 {
@@ -646,6 +653,80 @@ PRAGMA_UNROLL_N(4)
 	}
 }
 
+/*
+ *  stress_hdd_qd_sweep()
+ *	run the block size and queue depth sweep on a hdd_bytes
+ *	sized file, O_DIRECT is used where the file system allows
+ *	it so that the page cache does not hide the drive
+ */
+static int stress_hdd_qd_sweep(
+	const stress_args_t *args,
+	const char *filename,
+	const uint64_t hdd_bytes,
+	const size_t pattern)
+{
+	const int flags = O_CREAT | O_RDWR | O_TRUNC;
+	const uint64_t size = hdd_bytes & ~((uint64_t)STRESS_IO_SWEEP_MIN_SIZE - 1);
+	int fd, rc;
+
+#if defined(O_DIRECT)
+	fd = open(filename, flags | O_DIRECT, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		(void)shim_unlink(filename);
+		pr_dbg("%s: cannot open %s with O_DIRECT, using buffered I/O\n",
+			args->name, filename);
+		fd = open(filename, flags, S_IRUSR | S_IWUSR);
+	}
+#else
+	fd = open(filename, flags, S_IRUSR | S_IWUSR);
+#endif
+	if (fd < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		(void)shim_unlink(filename);
+		return rc;
+	}
+	(void)shim_unlink(filename);
+
+	/* Read sweeps need real data rather than holes */
+	if (!stress_io_sweep_writes(pattern)) {
+		uint8_t *buf;
+		uint64_t i;
+
+		buf = mmap(NULL, STRESS_IO_SWEEP_MIN_SIZE, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (buf == MAP_FAILED) {
+			pr_inf_skip("%s: cannot mmap fill buffer, skipping stressor\n",
+				args->name);
+			(void)close(fd);
+			return EXIT_NO_RESOURCE;
+		}
+		(void)memset(buf, stress_mwc8(), STRESS_IO_SWEEP_MIN_SIZE);
+		for (i = 0; keep_stressing_flag() && (i < size); i += STRESS_IO_SWEEP_MIN_SIZE) {
+			if (pwrite(fd, buf, STRESS_IO_SWEEP_MIN_SIZE, (off_t)i) < 0) {
+				rc = stress_exit_status(errno);
+				if (rc == EXIT_NO_RESOURCE)
+					pr_inf_skip("%s: cannot fill %s, errno=%d (%s), skipping stressor\n",
+						args->name, filename, errno, strerror(errno));
+				else
+					pr_fail("%s: pwrite failed, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+				(void)munmap((void *)buf, STRESS_IO_SWEEP_MIN_SIZE);
+				(void)close(fd);
+				return rc;
+			}
+		}
+		(void)munmap((void *)buf, STRESS_IO_SWEEP_MIN_SIZE);
+		(void)shim_fsync(fd);
+	}
+
+	rc = stress_io_sweep(args, fd, size, pattern);
+	(void)close(fd);
+
+	return rc;
+}
+
 /*
  *  stress_hdd
  *	stress I/O via writes
@@ -658,7 +739,7 @@ static int stress_hdd(const stress_args_t *args)
 	int rc = EXIT_FAILURE;
 	ssize_t ret;
 	char filename[PATH_MAX];
-	size_t opt_index = 0;
+	size_t opt_index = 0, hdd_qd_sweep = STRESS_IO_SWEEP_NONE;
 	uint64_t hdd_bytes = DEFAULT_HDD_BYTES;
 	uint64_t hdd_write_size = DEFAULT_HDD_WRITE_SIZE;
 	const uint32_t instance = args->instance;
@@ -673,6 +754,7 @@ static int stress_hdd(const stress_args_t *args)
 	(void)stress_get_setting("hdd-flags", &hdd_flags);
 	(void)stress_get_setting("hdd-oflags", &hdd_oflags);
 	(void)stress_get_setting("hdd-opts-set", &opts_set);
+	(void)stress_get_setting("hdd-qd-sweep", &hdd_qd_sweep);
 
 	flags = O_CREAT | O_RDWR | O_TRUNC | hdd_oflags;
 	fadvise_flags = hdd_flags & HDD_OPT_FADV_MASK;
@@ -730,6 +812,18 @@ static int stress_hdd(const stress_args_t *args)
 	if (ret < 0)
 		return stress_exit_status((int)-ret);
 
+	if (hdd_qd_sweep != STRESS_IO_SWEEP_NONE) {
+		if (hdd_bytes < STRESS_IO_SWEEP_MIN_SIZE)
+			hdd_bytes = STRESS_IO_SWEEP_MIN_SIZE;
+		(void)stress_temp_filename_args(args,
+			filename, sizeof(filename), stress_mwc32());
+		stress_set_proc_state(args->name, STRESS_STATE_RUN);
+		rc = stress_hdd_qd_sweep(args, filename, hdd_bytes, hdd_qd_sweep);
+		stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+		(void)stress_temp_dir_rm_args(args);
+		return rc;
+	}
+
 	/* Must have some write option */
 	if ((hdd_flags & HDD_OPT_WR_MASK) == 0)
 		hdd_flags |= HDD_OPT_WR_SEQ;
@@ -1082,6 +1176,7 @@ finish:
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_hdd_bytes,	stress_set_hdd_bytes },
 	{ OPT_hdd_opts,		stress_set_hdd_opts },
+	{ OPT_hdd_qd_sweep,	stress_set_hdd_qd_sweep },
 	{ OPT_hdd_write_size,	stress_set_hdd_write_size },
 	{ 0,			NULL },
 };
@@ -31,6 +31,7 @@ static sigjmp_buf jmp_env;
 
 static const stress_help_t help[] = {
 	{ NULL,	"heapsort N",	   "start N workers heap sorting 32 bit random integers" },
+	{ NULL,	"heapsort-dists",	"heapsort int32, uint64, record and string keys in 7 input distributions" },
 	{ NULL,	"heapsort-ops N",  "stop after N heap sort bogo operations" },
 	{ NULL,	"heapsort-size N", "number of 32 bit integers to sort" },
 	{ NULL,	NULL,		   NULL }
@@ -50,7 +51,13 @@ static int stress_set_heapsort_size(const char *opt)
 	return stress_set_setting("heapsort-size", TYPE_ID_UINT64, &heapsort_size);
 }
 
+static int stress_set_heapsort_dists(const char *opt)
+{
+	return stress_set_setting_true("heapsort-dists", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_heapsort_dists,		stress_set_heapsort_dists },
 	{ OPT_heapsort_integers,	stress_set_heapsort_size },
 	{ 0,				NULL }
 };
@@ -71,6 +78,12 @@ static void MLOCKED_TEXT stress_heapsort_handler(int signum)
 	}
 }
 
+static void stress_heapsort_func(void *base, size_t nmemb, size_t size,
+	int (*cmp)(const void *p1, const void *p2))
+{
+	(void)heapsort(base, nmemb, size, cmp);
+}
+
 /*
  *  stress_heapsort()
  *	stress heapsort
@@ -84,7 +97,9 @@ static int stress_heapsort(const stress_args_t *args)
 	int ret;
 	double rate;
 	NOCLOBBER double duration = 0.0, count = 0.0, sorted = 0.0;
+	bool heapsort_dists = false;
 
+	(void)stress_get_setting("heapsort-dists", &heapsort_dists);
 	if (!stress_get_setting("heapsort-size", &heapsort_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
 			heapsort_size = MAX_HEAPSORT_SIZE;
@@ -93,6 +108,9 @@ static int stress_heapsort(const stress_args_t *args)
 	}
 	n = (size_t)heapsort_size;
 
+	if (heapsort_dists)
+		return stress_sort_dists(args, "heapsort", stress_heapsort_func, n);
+
 	if ((data = calloc(n, sizeof(*data))) == NULL) {
 		pr_inf_skip("%s: failed to allocate %zu integers, skipping stressor\n",
 			args->name, n);
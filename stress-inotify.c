@@ -19,6 +19,7 @@
  */
 
 #include "stress-ng.h"
+#include "core-fsnotify-scale.h"
 
 #if defined(HAVE_SYS_EPOLL_H)
 #include <sys/epoll.h>
@@ -29,9 +30,44 @@
 #endif
 
 static const stress_help_t help[] = {
-	{ NULL,	"inotify N",	 "start N workers exercising inotify events" },
-	{ NULL,	"inotify-ops N", "stop inotify workers after N bogo operations" },
-	{ NULL, NULL,		 NULL }
+	{ NULL,	"inotify N",		"start N workers exercising inotify events" },
+	{ NULL,	"inotify-dirs N",	"watch N directories in scaling mode" },
+	{ NULL,	"inotify-ops N",	"stop inotify workers after N bogo operations" },
+	{ NULL,	"inotify-scale",	"measure event throughput and latency over writers" },
+	{ NULL,	"inotify-writers N",	"sweep from 1 up to N writer processes in scaling mode" },
+	{ NULL, NULL,			NULL }
+};
+
+static int stress_set_inotify_dirs(const char *opt)
+{
+	uint32_t inotify_dirs;
+
+	inotify_dirs = stress_get_uint32(opt);
+	stress_check_range("inotify-dirs", (uint64_t)inotify_dirs,
+		MIN_FSNOTIFY_SCALE_DIRS, MAX_FSNOTIFY_SCALE_DIRS);
+	return stress_set_setting("inotify-dirs", TYPE_ID_UINT32, &inotify_dirs);
+}
+
+static int stress_set_inotify_scale(const char *opt)
+{
+	return stress_set_setting_true("inotify-scale", opt);
+}
+
+static int stress_set_inotify_writers(const char *opt)
+{
+	uint32_t inotify_writers;
+
+	inotify_writers = stress_get_uint32(opt);
+	stress_check_range("inotify-writers", (uint64_t)inotify_writers,
+		MIN_FSNOTIFY_SCALE_WRITERS, MAX_FSNOTIFY_SCALE_WRITERS);
+	return stress_set_setting("inotify-writers", TYPE_ID_UINT32, &inotify_writers);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_inotify_dirs,	stress_set_inotify_dirs },
+	{ OPT_inotify_scale,	stress_set_inotify_scale },
+	{ OPT_inotify_writers,	stress_set_inotify_writers },
+	{ 0,			NULL }
 };
 
 #if defined(HAVE_INOTIFY) &&		\
@@ -940,6 +976,19 @@ static int stress_inotify(const stress_args_t *args)
 	char pathname[PATH_MAX - 16];
 	int ret, i;
 	const int bad_fd = stress_get_bad_fd();
+	uint32_t inotify_dirs = DEFAULT_FSNOTIFY_SCALE_DIRS;
+	uint32_t inotify_writers = DEFAULT_FSNOTIFY_SCALE_WRITERS;
+	bool inotify_scale = false;
+
+	(void)stress_get_setting("inotify-scale", &inotify_scale);
+	if (inotify_scale) {
+		static const int apis[] = { STRESS_FSNOTIFY_INOTIFY };
+
+		(void)stress_get_setting("inotify-dirs", &inotify_dirs);
+		(void)stress_get_setting("inotify-writers", &inotify_writers);
+		return stress_fsnotify_scale(args, apis, SIZEOF_ARRAY(apis),
+			inotify_dirs, inotify_writers);
+	}
 
 	stress_temp_dir_args(args, pathname, sizeof(pathname));
 	ret = stress_temp_dir_mk_args(args);
@@ -964,12 +1013,14 @@ stressor_info_t stress_inotify_info = {
 	.stressor = stress_inotify,
 	.class = CLASS_FILESYSTEM | CLASS_SCHEDULER | CLASS_OS,
 	.verify = VERIFY_OPTIONAL,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_inotify_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_FILESYSTEM | CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without sys/epoll.h, sys/inotify.h, inotify(), inotify1() or select() support"
 };
@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
 #include "io-uring.h"
 
 #if defined(HAVE_LINUX_IO_URING_H)
@@ -28,12 +29,87 @@
 #define O_DSYNC		(0)
 #endif
 
+#define MIN_IO_URING_DEPTH	(1)
+#define MAX_IO_URING_DEPTH	(4096)
+
+#define IO_URING_BLOCK_SIZE	(4096)		/* batched mode I/O size */
+#define IO_URING_FILE_BLOCKS	(4096)		/* batched mode file size in blocks */
+#define IO_URING_SQ_THREAD_IDLE	(100)		/* SQPOLL thread idle time, ms */
+
+#define IO_URING_RW_READ	(0)
+#define IO_URING_RW_WRITE	(1)
+#define IO_URING_RW_MIX		(2)
+
+/* io_uring_register(2) opcodes, enums in newer kernel headers */
+#define SHIM_IORING_REGISTER_BUFFERS	(0)
+#define SHIM_IORING_REGISTER_FILES	(2)
+
 static const stress_help_t help[] = {
 	{ NULL,	"io-uring N",		"start N workers that issue io-uring I/O requests" },
+	{ NULL,	"io-uring-depth N",	"batched random block I/O with N requests in flight" },
+	{ NULL,	"io-uring-fixed",	"use registered buffers and files in batched mode" },
+	{ NULL,	"io-uring-iopoll",	"use IORING_SETUP_IOPOLL and O_DIRECT in batched mode" },
 	{ NULL,	"io-uring-ops N",	"stop after N bogo io-uring I/O requests" },
+	{ NULL,	"io-uring-rw M",	"batched mode I/O, one of read, write or mix" },
+	{ NULL,	"io-uring-sqpoll",	"use IORING_SETUP_SQPOLL kernel submission thread" },
 	{ NULL,	NULL,		NULL }
 };
 
+static const char * const io_uring_rws[] = {
+	"read",		/* IO_URING_RW_READ */
+	"write",	/* IO_URING_RW_WRITE */
+	"mix",		/* IO_URING_RW_MIX */
+};
+
+static int stress_set_io_uring_depth(const char *opt)
+{
+	uint32_t io_uring_depth;
+
+	io_uring_depth = stress_get_uint32(opt);
+	stress_check_range("io-uring-depth", (uint64_t)io_uring_depth,
+		MIN_IO_URING_DEPTH, MAX_IO_URING_DEPTH);
+	return stress_set_setting("io-uring-depth", TYPE_ID_UINT32, &io_uring_depth);
+}
+
+static int stress_set_io_uring_fixed(const char *opt)
+{
+	return stress_set_setting_true("io-uring-fixed", opt);
+}
+
+static int stress_set_io_uring_iopoll(const char *opt)
+{
+	return stress_set_setting_true("io-uring-iopoll", opt);
+}
+
+static int stress_set_io_uring_sqpoll(const char *opt)
+{
+	return stress_set_setting_true("io-uring-sqpoll", opt);
+}
+
+static int stress_set_io_uring_rw(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(io_uring_rws); i++) {
+		if (!strcmp(opt, io_uring_rws[i]))
+			return stress_set_setting("io-uring-rw", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "io-uring-rw must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(io_uring_rws); i++)
+		(void)fprintf(stderr, " %s", io_uring_rws[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_io_uring_depth,	stress_set_io_uring_depth },
+	{ OPT_io_uring_fixed,	stress_set_io_uring_fixed },
+	{ OPT_io_uring_iopoll,	stress_set_io_uring_iopoll },
+	{ OPT_io_uring_rw,	stress_set_io_uring_rw },
+	{ OPT_io_uring_sqpoll,	stress_set_io_uring_sqpoll },
+	{ 0,			NULL }
+};
+
 #if defined(HAVE_LINUX_IO_URING_H) &&	\
     defined(HAVE_SYSCALL) &&		\
     defined(__NR_io_uring_enter) &&	\
@@ -145,6 +221,21 @@ static int shim_io_uring_enter(
 		min_complete, flags, NULL, 0);
 }
 
+#if defined(__NR_io_uring_register)
+/*
+ *  shim_io_uring_register
+ *	wrapper for io_uring_register()
+ */
+static int shim_io_uring_register(
+	int fd,
+	unsigned int opcode,
+	void *arg,
+	unsigned int nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+#endif
+
 /*
  *  stress_io_uring_unmap_iovecs()
  *	free uring file iovecs
@@ -178,15 +269,28 @@ static void stress_io_uring_unmap_iovecs(stress_io_uring_file_t *io_uring_file)
  */
 static int stress_setup_io_uring(
 	const stress_args_t *args,
-	stress_io_uring_submit_t *submit)
+	stress_io_uring_submit_t *submit,
+	const unsigned entries,
+	const unsigned flags)
 {
 	stress_uring_io_sq_ring_t *sring = &submit->sq_ring;
 	stress_uring_io_cq_ring_t *cring = &submit->cq_ring;
 	struct io_uring_params p;
 
 	(void)memset(&p, 0, sizeof(p));
-	submit->io_uring_fd = shim_io_uring_setup(256, &p);
+	p.flags = flags;
+#if defined(IORING_SETUP_SQPOLL)
+	if (flags & IORING_SETUP_SQPOLL)
+		p.sq_thread_idle = IO_URING_SQ_THREAD_IDLE;
+#endif
+	submit->io_uring_fd = shim_io_uring_setup(entries, &p);
 	if (submit->io_uring_fd < 0) {
+		if (flags && ((errno == EINVAL) || (errno == EPERM) || (errno == EOPNOTSUPP))) {
+			pr_inf_skip("%s: io-uring setup flags 0x%x not supported, "
+				"errno=%d (%s), skipping stressor\n",
+				args->name, flags, errno, strerror(errno));
+			return EXIT_NO_RESOURCE;
+		}
 		if (errno == ENOSYS) {
 			pr_inf_skip("%s: io-uring not supported by the kernel, skipping stressor\n",
 				args->name);
@@ -359,6 +463,7 @@ static int stress_io_uring_submit(
 	struct io_uring_sqe *sqe;
 	int ret;
 	uint8_t opcode;
+	const uint64_t t_lat = stress_latency_begin(args);
 
 	next_tail = tail = *sring->tail;
 	next_tail++;
@@ -393,7 +498,10 @@ static int stress_io_uring_submit(
 		return EXIT_FAILURE;
 	}
 
-	return stress_io_uring_complete(args, submit, opcode, supported);
+	ret = stress_io_uring_complete(args, submit, opcode, supported);
+	stress_latency_end(args, t_lat);
+
+	return ret;
 }
 
 #if defined(HAVE_IORING_OP_READV)
@@ -722,6 +830,333 @@ static const char *stress_io_uring_opcode_name(const uint8_t opcode)
 }
 
 
+#if defined(HAVE_IORING_OP_READ) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+/*
+ *  stress_io_uring_batched_reap()
+ *	reap the completed requests, the submit times of the
+ *	requests are in t_submit indexed by the slot in user_data
+ *	and the completed slots are pushed back onto free_slots
+ */
+static int stress_io_uring_batched_reap(
+	const stress_args_t *args,
+	stress_io_uring_submit_t *submit,
+	const uint64_t *t_submit,
+	uint32_t *free_slots,
+	uint32_t *n_free,
+	stress_latency_t *latency,
+	const bool iopoll)
+{
+	stress_uring_io_cq_ring_t *cring = &submit->cq_ring;
+	unsigned head = *cring->head;
+	int ret = EXIT_SUCCESS;
+	uint64_t now = 0;
+
+	for (;;) {
+		const struct io_uring_cqe *cqe;
+		uint32_t slot;
+
+		shim_mb();
+		if (head == *cring->tail)
+			break;
+
+		cqe = &cring->cqes[head & *cring->ring_mask];
+		slot = (uint32_t)cqe->user_data;
+		if (!now)
+			now = stress_latency_now();
+		stress_latency_add(latency, now - t_submit[slot]);
+		if (args->latency)
+			stress_latency_add(args->latency, now - t_submit[slot]);
+
+		if (cqe->res < 0) {
+			const int err = -cqe->res;
+
+			if (ret != EXIT_SUCCESS) {
+				/* already reported */
+			} else if (iopoll && ((err == EOPNOTSUPP) || (err == EINVAL))) {
+				pr_inf_skip("%s: IORING_SETUP_IOPOLL not supported on "
+					"this file system, skipping stressor\n", args->name);
+				ret = EXIT_NO_RESOURCE;
+			} else {
+				pr_fail("%s: batched completion error=%d (%s)\n",
+					args->name, err, strerror(err));
+				ret = EXIT_FAILURE;
+			}
+		} else {
+			inc_counter(args);
+		}
+		free_slots[(*n_free)++] = slot;
+		head++;
+	}
+	*cring->head = head;
+	shim_mb();
+
+	return ret;
+}
+
+/*
+ *  stress_io_uring_batched()
+ *	keep depth random block reads and/or writes in flight and
+ *	submit them in batches, optionally with a kernel SQ polling
+ *	thread, polled completions and registered buffers and files
+ */
+static int stress_io_uring_batched(
+	const stress_args_t *args,
+	const char *filename,
+	const uint32_t depth)
+{
+	stress_io_uring_submit_t submit;
+	stress_uring_io_sq_ring_t *sring = &submit.sq_ring;
+	stress_latency_t *latency = NULL;
+	struct iovec *iovecs = NULL;
+	uint64_t *t_submit = NULL;
+	uint32_t *free_slots = NULL;
+	uint32_t n_free, i;
+	uint8_t *bufs = NULL;
+	bool io_uring_fixed = false;
+	bool io_uring_iopoll = false;
+	bool io_uring_sqpoll = false;
+	size_t io_uring_rw = IO_URING_RW_MIX;
+	unsigned flags = 0;
+	int fd = -1, ret, rc, open_flags = O_CREAT | O_RDWR;
+	double t_start, duration;
+	const size_t bufs_size = (size_t)depth * IO_URING_BLOCK_SIZE;
+
+	(void)stress_get_setting("io-uring-fixed", &io_uring_fixed);
+	(void)stress_get_setting("io-uring-iopoll", &io_uring_iopoll);
+	(void)stress_get_setting("io-uring-rw", &io_uring_rw);
+	(void)stress_get_setting("io-uring-sqpoll", &io_uring_sqpoll);
+
+	(void)memset(&submit, 0, sizeof(submit));
+	submit.io_uring_fd = -1;
+
+#if defined(IORING_SETUP_SQPOLL)
+	if (io_uring_sqpoll)
+		flags |= IORING_SETUP_SQPOLL;
+#endif
+#if defined(IORING_SETUP_IOPOLL)
+	if (io_uring_iopoll) {
+		flags |= IORING_SETUP_IOPOLL;
+#if defined(O_DIRECT)
+		/* polled completions need direct I/O */
+		open_flags |= O_DIRECT;
+#endif
+	}
+#endif
+#if !defined(HAVE_IORING_OP_READ_FIXED) ||	\
+    !defined(HAVE_IORING_OP_WRITE_FIXED) ||	\
+    !defined(__NR_io_uring_register)
+	if (io_uring_fixed && (args->instance == 0))
+		pr_inf("%s: registered buffers not supported, ignoring --io-uring-fixed\n",
+			args->name);
+	io_uring_fixed = false;
+#endif
+
+	t_submit = calloc((size_t)depth, sizeof(*t_submit));
+	free_slots = calloc((size_t)depth, sizeof(*free_slots));
+	iovecs = calloc((size_t)depth, sizeof(*iovecs));
+	latency = malloc(sizeof(*latency));
+	if (!t_submit || !free_slots || !iovecs || !latency ||
+	    (posix_memalign((void **)&bufs, IO_URING_BLOCK_SIZE, bufs_size) != 0)) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " I/O request buffers, "
+			"skipping stressor\n", args->name, depth);
+		rc = EXIT_NO_RESOURCE;
+		goto free_bufs;
+	}
+	stress_latency_reset(latency);
+	(void)memset(bufs, stress_mwc8(), bufs_size);
+	for (i = 0; i < depth; i++) {
+		iovecs[i].iov_base = (void *)(bufs + ((size_t)i * IO_URING_BLOCK_SIZE));
+		iovecs[i].iov_len = IO_URING_BLOCK_SIZE;
+		free_slots[i] = i;
+	}
+	n_free = depth;
+
+	fd = open(filename, open_flags, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		if (io_uring_iopoll && (errno == EINVAL)) {
+			pr_inf_skip("%s: O_DIRECT not supported on this file system, "
+				"skipping stressor\n", args->name);
+			rc = EXIT_NO_RESOURCE;
+		} else {
+			rc = stress_exit_status(errno);
+			pr_fail("%s: open on %s failed, errno=%d (%s)\n",
+				args->name, filename, errno, strerror(errno));
+		}
+		goto free_bufs;
+	}
+	(void)shim_unlink(filename);
+
+	/* fill the file so that reads hit allocated blocks */
+	for (i = 0; i < IO_URING_FILE_BLOCKS; i += depth) {
+		const off_t off = (off_t)i * IO_URING_BLOCK_SIZE;
+		const size_t n = STRESS_MINIMUM(bufs_size,
+			(size_t)(IO_URING_FILE_BLOCKS - i) * IO_URING_BLOCK_SIZE);
+
+		if (pwrite(fd, bufs, n, off) < 0) {
+			rc = stress_exit_status(errno);
+			if (rc == EXIT_NO_RESOURCE)
+				pr_inf_skip("%s: cannot fill %s, errno=%d (%s), skipping stressor\n",
+					args->name, filename, errno, strerror(errno));
+			else
+				pr_fail("%s: pwrite on %s failed, errno=%d (%s)\n",
+					args->name, filename, errno, strerror(errno));
+			goto close_fd;
+		}
+	}
+
+	rc = stress_setup_io_uring(args, &submit, depth, flags);
+	if (rc != EXIT_SUCCESS)
+		goto close_fd;
+
+#if defined(HAVE_IORING_OP_READ_FIXED) &&	\
+    defined(HAVE_IORING_OP_WRITE_FIXED) &&	\
+    defined(__NR_io_uring_register)
+	if (io_uring_fixed) {
+		if ((shim_io_uring_register(submit.io_uring_fd, SHIM_IORING_REGISTER_BUFFERS,
+					    iovecs, depth) < 0) ||
+		    (shim_io_uring_register(submit.io_uring_fd, SHIM_IORING_REGISTER_FILES,
+					    &fd, 1) < 0)) {
+			if (args->instance == 0)
+				pr_inf("%s: cannot register buffers and files, errno=%d (%s), "
+					"using unregistered buffers and files\n",
+					args->name, errno, strerror(errno));
+			io_uring_fixed = false;
+		}
+	}
+#endif
+
+	if (args->instance == 0)
+		pr_dbg("%s: queue depth %" PRIu32 ", %s I/O,%s%s%s\n",
+			args->name, depth, io_uring_rws[io_uring_rw],
+			io_uring_sqpoll ? " SQPOLL" : "",
+			io_uring_iopoll ? " IOPOLL" : "",
+			io_uring_fixed ? " registered buffers" : " unregistered buffers");
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_start = stress_time_now();
+	do {
+		unsigned tail = *sring->tail;
+		unsigned to_submit = 0;
+		unsigned enter_flags = IORING_ENTER_GETEVENTS;
+
+		/* queue up a request in each free slot */
+		while (n_free > 0) {
+			const uint32_t slot = free_slots[--n_free];
+			const unsigned index = tail & *sring->ring_mask;
+			struct io_uring_sqe *sqe = &submit.sqes_mmap[index];
+			const bool write = (io_uring_rw == IO_URING_RW_WRITE) ||
+				((io_uring_rw == IO_URING_RW_MIX) && stress_mwc1());
+
+			(void)memset(sqe, 0, sizeof(*sqe));
+			sqe->addr = (uintptr_t)iovecs[slot].iov_base;
+			sqe->len = IO_URING_BLOCK_SIZE;
+			sqe->off = (uint64_t)stress_mwc32modn(IO_URING_FILE_BLOCKS) * IO_URING_BLOCK_SIZE;
+			sqe->user_data = (uint64_t)slot;
+#if defined(HAVE_IORING_OP_READ_FIXED) &&	\
+    defined(HAVE_IORING_OP_WRITE_FIXED) &&	\
+    defined(__NR_io_uring_register)
+			if (io_uring_fixed) {
+				sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+				sqe->fd = 0;
+				sqe->flags = IOSQE_FIXED_FILE;
+				sqe->buf_index = (uint16_t)slot;
+			} else
+#endif
+			{
+				sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+				sqe->fd = fd;
+			}
+			sring->array[index] = index;
+			t_submit[slot] = stress_latency_now();
+			tail++;
+			to_submit++;
+		}
+		shim_mb();
+		*sring->tail = tail;
+		shim_mb();
+
+#if defined(IORING_SETUP_SQPOLL)
+		if (io_uring_sqpoll) {
+			/* the kernel thread submits, only wake it if it is idle */
+			to_submit = 0;
+			if (*sring->flags & IORING_SQ_NEED_WAKEUP)
+				enter_flags |= IORING_ENTER_SQ_WAKEUP;
+		}
+#endif
+		ret = shim_io_uring_enter(submit.io_uring_fd, to_submit, 1, enter_flags);
+		if ((ret < 0) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+			pr_fail("%s: io_uring_enter failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		rc = stress_io_uring_batched_reap(args, &submit, t_submit,
+			free_slots, &n_free, latency, io_uring_iopoll);
+		if (rc != EXIT_SUCCESS)
+			break;
+	} while (keep_stressing(args));
+	duration = stress_time_now() - t_start;
+
+	/* wait for the requests still in flight */
+	while (n_free < depth) {
+		const int reap_rc = stress_io_uring_batched_reap(args, &submit, t_submit,
+			free_slots, &n_free, latency, io_uring_iopoll);
+
+		if ((reap_rc != EXIT_SUCCESS) && (rc == EXIT_SUCCESS))
+			rc = reap_rc;
+		if (n_free >= depth)
+			break;
+		if ((shim_io_uring_enter(submit.io_uring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) &&
+		    (errno != EINTR) && (errno != EAGAIN))
+			break;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if ((rc == EXIT_SUCCESS) && (duration > 0.0) && latency->count) {
+		const double iops = (double)latency->count / duration;
+
+		stress_metrics_set(args, 0, "IOPS", iops);
+		stress_metrics_set(args, 1, "MB per sec",
+			(iops * IO_URING_BLOCK_SIZE) / (double)MB);
+		stress_metrics_set(args, 2, "mean completion latency (ns)",
+			(double)latency->total / (double)latency->count);
+		stress_metrics_set(args, 3, "p50 completion latency (ns)",
+			(double)stress_latency_percentile(latency, 50.0));
+		stress_metrics_set(args, 4, "p99 completion latency (ns)",
+			(double)stress_latency_percentile(latency, 99.0));
+	}
+
+	stress_close_io_uring(&submit);
+close_fd:
+	(void)close(fd);
+free_bufs:
+	free(bufs);
+	free(latency);
+	free(iovecs);
+	free(free_slots);
+	free(t_submit);
+
+	return rc;
+}
+#else
+static int stress_io_uring_batched(
+	const stress_args_t *args,
+	const char *filename,
+	const uint32_t depth)
+{
+	(void)filename;
+	(void)depth;
+
+	if (args->instance == 0)
+		pr_inf_skip("%s: IORING_OP_READ and IORING_OP_WRITE are not supported, "
+			"skipping stressor\n", args->name);
+	return EXIT_NOT_IMPLEMENTED;
+}
+#endif
+
 /*
  *  stress_io_uring
  *	stress asynchronous I/O
@@ -738,8 +1173,12 @@ static int stress_io_uring(const stress_args_t *args)
 	stress_io_uring_submit_t submit;
 	const pid_t self = getpid();
 	bool supported[SIZEOF_ARRAY(stress_io_uring_setups)];
+	uint32_t io_uring_depth = 0;
+
+	(void)stress_get_setting("io-uring-depth", &io_uring_depth);
 
 	(void)memset(&submit, 0, sizeof(submit));
+	submit.io_uring_fd = -1;
 	(void)memset(&io_uring_file, 0, sizeof(io_uring_file));
 
 	io_uring_file.file_size = file_size;
@@ -788,7 +1227,12 @@ static int stress_io_uring(const stress_args_t *args)
 
 	io_uring_file.filename = filename;
 
-	rc = stress_setup_io_uring(args, &submit);
+	if (io_uring_depth > 0) {
+		rc = stress_io_uring_batched(args, filename, io_uring_depth);
+		goto clean;
+	}
+
+	rc = stress_setup_io_uring(args, &submit, 256, 0);
 	if (rc != EXIT_SUCCESS)
 		goto clean;
 
@@ -843,6 +1287,7 @@ clean:
 stressor_info_t stress_io_uring_info = {
 	.stressor = stress_io_uring,
 	.class = CLASS_IO | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_ALWAYS,
 	.help = help
 };
@@ -850,6 +1295,7 @@ stressor_info_t stress_io_uring_info = {
 stressor_info_t stress_io_uring_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_IO | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without linux/io_uring.h or syscall() support"
 };
@@ -37,6 +37,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"iomix N",	 "start N workers that have a mix of I/O operations" },
 	{ NULL,	"iomix-bytes N", "write N bytes per iomix worker (default is 1GB)" },
 	{ NULL,	"iomix-ops N",	 "stop iomix workers after N iomix bogo operations" },
+	{ NULL,	"iomix-profile P", "run workload profile P, kafka, rocksdb, log-shipping or a job file" },
 	{ NULL, NULL,		 NULL }
 };
 
@@ -52,6 +53,329 @@ static int stress_set_iomix_bytes(const char *opt)
 	return stress_set_setting("iomix-bytes", TYPE_ID_OFF_T, &iomix_bytes);
 }
 
+#define IOMIX_JOBS_MAX		(16)	/* job sections in a profile */
+#define IOMIX_PROCS_MAX		(64)	/* processes over all jobs */
+#define IOMIX_BS_MAX		(8)	/* bssplit entries */
+#define IOMIX_HIST		(32)	/* log2 usec latency buckets */
+#define IOMIX_JOB_SIZE		(64 * MB)	/* default file size per job */
+
+#define IOMIX_RW_READ		(0)	/* access patterns, as fio rw= */
+#define IOMIX_RW_WRITE		(1)
+#define IOMIX_RW_RANDREAD	(2)
+#define IOMIX_RW_RANDWRITE	(3)
+#define IOMIX_RW_READWRITE	(4)
+#define IOMIX_RW_RANDRW		(5)
+
+/* a job section of a workload profile, modelled on fio job files */
+typedef struct {
+	char name[32];
+	int rw;				/* IOMIX_RW_* */
+	int rwmixread;			/* % reads of mixed rw */
+	size_t bs_num;
+	uint64_t bs[IOMIX_BS_MAX];	/* block sizes */
+	uint32_t bs_pct[IOMIX_BS_MAX];	/* % of I/Os of each block size */
+	uint32_t numjobs;		/* processes running the job */
+	uint32_t iodepth;		/* synchronous submitters per process */
+	uint32_t fsync;			/* fsync every N writes, 0 never */
+	uint32_t fdatasync;		/* fdatasync every N writes, 0 never */
+	bool direct;			/* O_DIRECT */
+	uint64_t size;			/* file size */
+} stress_iomix_job_t;
+
+typedef struct {
+	size_t jobs_num;
+	stress_iomix_job_t jobs[IOMIX_JOBS_MAX];
+} stress_iomix_profile_t;
+
+/* per job results, updated by the job processes under the counter lock */
+typedef struct {
+	uint64_t read_ops;
+	uint64_t write_ops;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint64_t syncs;
+	uint64_t lat_ns;
+	uint64_t hist[IOMIX_HIST];
+	uint64_t errors;
+} stress_iomix_job_result_t;
+
+typedef struct {
+	const char *name;
+	const char *profile;
+} stress_iomix_builtin_t;
+
+/*
+ *  Built in profiles of common application I/O patterns
+ */
+static const stress_iomix_builtin_t iomix_builtins[] = {
+	{ "kafka",
+		"[producer-append]\nrw=write\nbs=64k\nfdatasync=16\nnumjobs=2\n"
+		"[consumer-tail]\nrw=read\nbs=256k\nnumjobs=2\n"
+		"[replica-fetch]\nrw=read\nbs=1m\n" },
+	{ "rocksdb",
+		"[compaction-read]\nrw=read\nbs=1m\niodepth=2\ndirect=1\n"
+		"[compaction-write]\nrw=write\nbs=1m\nfdatasync=64\ndirect=1\n"
+		"[point-lookup]\nrw=randread\nbssplit=4k/80:16k/20\nnumjobs=4\ndirect=1\n"
+		"[wal]\nrw=write\nbs=4k\nfdatasync=1\n" },
+	{ "log-shipping",
+		"[log-append]\nrw=write\nbs=4k\nfdatasync=32\nnumjobs=4\n"
+		"[shipper]\nrw=read\nbs=128k\n" },
+};
+
+static const char * const iomix_rw_names[] = {
+	"read", "write", "randread", "randwrite", "readwrite", "randrw"
+};
+
+/*
+ *  stress_iomix_size()
+ *	parse a size with an optional k, m or g suffix
+ */
+static int stress_iomix_size(const char *str, uint64_t *size)
+{
+	char *end;
+	const unsigned long long val = strtoull(str, &end, 10);
+
+	if (end == str)
+		return -1;
+	switch (tolower((unsigned char)*end)) {
+	case '\0':
+		*size = (uint64_t)val;
+		return 0;
+	case 'k':
+		*size = (uint64_t)val * KB;
+		break;
+	case 'm':
+		*size = (uint64_t)val * MB;
+		break;
+	case 'g':
+		*size = (uint64_t)val * GB;
+		break;
+	default:
+		return -1;
+	}
+	return end[1] ? -1 : 0;
+}
+
+/*
+ *  stress_iomix_job_set()
+ *	set a key=value of a job, returns -1 if it is not valid
+ */
+static int stress_iomix_job_set(stress_iomix_job_t *job, const char *key, const char *val)
+{
+	uint64_t v;
+	size_t i;
+
+	if (!strcmp(key, "rw") || !strcmp(key, "readwrite")) {
+		for (i = 0; i < SIZEOF_ARRAY(iomix_rw_names); i++) {
+			if (!strcmp(val, iomix_rw_names[i])) {
+				job->rw = (int)i;
+				return 0;
+			}
+		}
+		if (!strcmp(val, "rw")) {
+			job->rw = IOMIX_RW_READWRITE;
+			return 0;
+		}
+		return -1;
+	}
+	if (!strcmp(key, "bs")) {
+		if ((stress_iomix_size(val, &v) < 0) || (v < 512) || (v > 64 * MB))
+			return -1;
+		job->bs_num = 1;
+		job->bs[0] = v;
+		job->bs_pct[0] = 100;
+		return 0;
+	}
+	if (!strcmp(key, "bssplit")) {
+		/* e.g. 4k/50:64k/40:1m/10 */
+		char buf[256], *ptr, *token;
+		uint32_t total = 0;
+
+		(void)shim_strlcpy(buf, val, sizeof(buf));
+		job->bs_num = 0;
+		for (ptr = buf; (token = strtok(ptr, ":")) != NULL; ptr = NULL) {
+			char *pct = strchr(token, '/');
+
+			if (!pct || (job->bs_num >= IOMIX_BS_MAX))
+				return -1;
+			*pct++ = '\0';
+			if ((stress_iomix_size(token, &v) < 0) || (v < 512) || (v > 64 * MB))
+				return -1;
+			job->bs[job->bs_num] = v;
+			job->bs_pct[job->bs_num] = (uint32_t)atoi(pct);
+			total += job->bs_pct[job->bs_num];
+			job->bs_num++;
+		}
+		return ((total == 100) && job->bs_num) ? 0 : -1;
+	}
+	if (!strcmp(key, "size")) {
+		if ((stress_iomix_size(val, &v) < 0) || (v < MB))
+			return -1;
+		job->size = v;
+		return 0;
+	}
+	if (!strcmp(key, "direct")) {
+		job->direct = (atoi(val) != 0);
+		return 0;
+	}
+
+	if ((stress_iomix_size(val, &v) < 0) || (v > UINT32_MAX))
+		return -1;
+	if (!strcmp(key, "rwmixread") && (v <= 100))
+		job->rwmixread = (int)v;
+	else if (!strcmp(key, "numjobs") && (v >= 1))
+		job->numjobs = (uint32_t)v;
+	else if (!strcmp(key, "iodepth") && (v >= 1))
+		job->iodepth = (uint32_t)v;
+	else if (!strcmp(key, "fsync"))
+		job->fsync = (uint32_t)v;
+	else if (!strcmp(key, "fdatasync"))
+		job->fdatasync = (uint32_t)v;
+	else
+		return -1;
+	return 0;
+}
+
+/*
+ *  stress_iomix_profile_parse()
+ *	parse a profile of fio style job sections, returns -1
+ *	and an error message on a parse error
+ */
+static int stress_iomix_profile_parse(
+	const char *text,
+	stress_iomix_profile_t *profile,
+	char *err,
+	const size_t err_len)
+{
+	const char *ptr = text;
+	stress_iomix_job_t *job = NULL;
+	size_t i, procs = 0;
+	int line = 0;
+
+	(void)memset(profile, 0, sizeof(*profile));
+	while (*ptr) {
+		char buf[512], *str, *eq, *end;
+		const char *nl = strchr(ptr, '\n');
+		const size_t len = nl ? (size_t)(nl - ptr) : strlen(ptr);
+
+		line++;
+		(void)snprintf(buf, sizeof(buf), "%.*s", (int)STRESS_MINIMUM(len, sizeof(buf) - 1), ptr);
+		ptr += len + (nl ? 1 : 0);
+
+		for (str = buf; isspace((unsigned char)*str); str++)
+			;
+		for (end = str + strlen(str); (end > str) && isspace((unsigned char)end[-1]); end--)
+			*(end - 1) = '\0';
+		if (!*str || (*str == '#') || (*str == ';'))
+			continue;
+		if (*str == '[') {
+			end = strchr(str, ']');
+			if (!end || (end == str + 1)) {
+				(void)snprintf(err, err_len, "line %d: invalid job section '%s'", line, str);
+				return -1;
+			}
+			if (profile->jobs_num >= IOMIX_JOBS_MAX) {
+				(void)snprintf(err, err_len, "line %d: more than %d jobs", line, IOMIX_JOBS_MAX);
+				return -1;
+			}
+			*end = '\0';
+			job = &profile->jobs[profile->jobs_num++];
+			(void)shim_strlcpy(job->name, str + 1, sizeof(job->name));
+			job->rw = IOMIX_RW_READ;
+			job->rwmixread = 50;
+			job->bs_num = 1;
+			job->bs[0] = 4 * KB;
+			job->bs_pct[0] = 100;
+			job->numjobs = 1;
+			job->iodepth = 1;
+			job->size = IOMIX_JOB_SIZE;
+			continue;
+		}
+		eq = strchr(str, '=');
+		if (!job || !eq) {
+			(void)snprintf(err, err_len, "line %d: expected a [job] or key=value, got '%s'", line, str);
+			return -1;
+		}
+		*eq = '\0';
+		for (end = eq; (end > str) && isspace((unsigned char)end[-1]); end--)
+			*(end - 1) = '\0';
+		for (eq++; isspace((unsigned char)*eq); eq++)
+			;
+		if (stress_iomix_job_set(job, str, eq) < 0) {
+			(void)snprintf(err, err_len, "line %d: invalid %s=%s", line, str, eq);
+			return -1;
+		}
+	}
+	if (!profile->jobs_num) {
+		(void)snprintf(err, err_len, "no [job] sections");
+		return -1;
+	}
+	for (i = 0; i < profile->jobs_num; i++)
+		procs += (size_t)profile->jobs[i].numjobs * profile->jobs[i].iodepth;
+	if (procs > IOMIX_PROCS_MAX) {
+		(void)snprintf(err, err_len, "%zu processes (numjobs x iodepth) is more than %d",
+			procs, IOMIX_PROCS_MAX);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_iomix_profile_load()
+ *	load a built in profile or a profile job file, the returned
+ *	text must be free'd
+ */
+static char *stress_iomix_profile_load(const char *name)
+{
+	size_t i;
+	FILE *fp;
+	char *text;
+	long int len;
+
+	for (i = 0; i < SIZEOF_ARRAY(iomix_builtins); i++) {
+		if (!strcmp(name, iomix_builtins[i].name))
+			return strdup(iomix_builtins[i].profile);
+	}
+	fp = fopen(name, "r");
+	if (!fp)
+		return NULL;
+	if ((fseek(fp, 0, SEEK_END) < 0) || ((len = ftell(fp)) < 0) ||
+	    (len > 64 * (long int)KB) || (fseek(fp, 0, SEEK_SET) < 0)) {
+		(void)fclose(fp);
+		return NULL;
+	}
+	text = calloc((size_t)len + 1, 1);
+	if (text && (fread(text, 1, (size_t)len, fp) != (size_t)len)) {
+		free(text);
+		text = NULL;
+	}
+	(void)fclose(fp);
+	return text;
+}
+
+static int stress_set_iomix_profile(const char *opt)
+{
+	stress_iomix_profile_t profile;
+	char *text, err[256];
+	size_t i;
+
+	text = stress_iomix_profile_load(opt);
+	if (!text) {
+		(void)fprintf(stderr, "iomix-profile must be one of:");
+		for (i = 0; i < SIZEOF_ARRAY(iomix_builtins); i++)
+			(void)fprintf(stderr, " %s", iomix_builtins[i].name);
+		(void)fprintf(stderr, " or a readable job file, cannot load '%s'\n", opt);
+		return -1;
+	}
+	if (stress_iomix_profile_parse(text, &profile, err, sizeof(err)) < 0) {
+		(void)fprintf(stderr, "iomix-profile %s: %s\n", opt, err);
+		free(text);
+		return -1;
+	}
+	free(text);
+	return stress_set_setting("iomix-profile", TYPE_ID_STR, (void *)opt);
+}
+
 /*
  *  stress_iomix_rnd_offset()
  *	generate a random offset between 0..max-1
@@ -946,6 +1270,363 @@ static stress_iomix_func iomix_funcs[] = {
 #endif
 };
 
+/*
+ *  stress_iomix_job_proc()
+ *	run the I/O of a job until the end of the run, process k of
+ *	procs processes of the job starts sequential I/O at its own
+ *	part of the file
+ */
+static void stress_iomix_job_proc(
+	const stress_args_t *args,
+	const stress_iomix_job_t *job,
+	const char *filename,
+	const uint32_t k,
+	const uint32_t procs,
+	stress_iomix_job_result_t *result)
+{
+	const bool random = (job->rw == IOMIX_RW_RANDREAD) ||
+			    (job->rw == IOMIX_RW_RANDWRITE) ||
+			    (job->rw == IOMIX_RW_RANDRW);
+	uint64_t bs_max = 0, pos, writes = 0;
+	uint8_t *buf;
+	size_t i;
+	int fd = -1;
+
+	for (i = 0; i < job->bs_num; i++)
+		bs_max = STRESS_MAXIMUM(bs_max, job->bs[i]);
+	buf = (uint8_t *)mmap(NULL, (size_t)bs_max, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return;
+	stress_uint8rnd4(buf, (size_t)bs_max);
+
+#if defined(O_DIRECT)
+	if (job->direct)
+		fd = open(filename, O_RDWR | O_DIRECT);
+#endif
+	if (fd < 0)
+		fd = open(filename, O_RDWR);
+	if (fd < 0) {
+		result->errors++;
+		(void)munmap((void *)buf, (size_t)bs_max);
+		return;
+	}
+
+	pos = ((job->size / procs) * k) & ~(uint64_t)4095;
+	do {
+		uint64_t bs = job->bs[0], us, ns;
+		uint32_t pct = stress_mwc32modn(100);
+		off_t offset;
+		ssize_t ret;
+		bool is_read;
+		double t;
+		int bucket = 0;
+
+		for (i = 0; i < job->bs_num; i++) {
+			if (pct < job->bs_pct[i]) {
+				bs = job->bs[i];
+				break;
+			}
+			pct -= job->bs_pct[i];
+		}
+		switch (job->rw) {
+		case IOMIX_RW_READ:
+		case IOMIX_RW_RANDREAD:
+			is_read = true;
+			break;
+		case IOMIX_RW_WRITE:
+		case IOMIX_RW_RANDWRITE:
+			is_read = false;
+			break;
+		default:
+			is_read = (int)stress_mwc8modn(100) < job->rwmixread;
+			break;
+		}
+		if (random) {
+			offset = (off_t)(stress_mwc64modn(job->size / bs) * bs);
+		} else {
+			if (pos + bs > job->size)
+				pos = 0;
+			offset = (off_t)pos;
+			pos += bs;
+		}
+
+		t = stress_time_now();
+		if (is_read)
+			ret = pread(fd, buf, (size_t)bs, offset);
+		else
+			ret = pwrite(fd, buf, (size_t)bs, offset);
+		if (ret < 0) {
+			result->errors++;
+			if (errno == ENOSPC)
+				break;
+			continue;
+		}
+		if (is_read) {
+			result->read_ops++;
+			result->read_bytes += (uint64_t)ret;
+		} else {
+			result->write_ops++;
+			result->write_bytes += (uint64_t)ret;
+			writes++;
+			if (job->fsync && ((writes % job->fsync) == 0)) {
+				(void)shim_fsync(fd);
+				result->syncs++;
+			} else if (job->fdatasync && ((writes % job->fdatasync) == 0)) {
+				(void)shim_fdatasync(fd);
+				result->syncs++;
+			}
+		}
+		/* latency includes any sync that completed the write */
+		ns = (uint64_t)((stress_time_now() - t) * STRESS_DBL_NANOSECOND);
+		result->lat_ns += ns;
+		for (us = ns / 1000; us && (bucket < IOMIX_HIST - 1); us >>= 1)
+			bucket++;
+		result->hist[bucket]++;
+	} while (inc_counter_lock(args, counter_lock, true));
+
+	(void)close(fd);
+	(void)munmap((void *)buf, (size_t)bs_max);
+}
+
+/*
+ *  stress_iomix_job_file()
+ *	create the file of a job, jobs that read need it
+ *	written so reads are not of unwritten extents
+ */
+static int stress_iomix_job_file(
+	const stress_args_t *args,
+	const stress_iomix_job_t *job,
+	const char *filename)
+{
+	int fd;
+	uint64_t sz;
+	uint8_t *buf;
+
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return -errno;
+	if ((job->rw == IOMIX_RW_WRITE) || (job->rw == IOMIX_RW_RANDWRITE)) {
+		if (shim_fallocate(fd, 0, 0, (off_t)job->size) < 0) {
+			const int err = errno;
+
+			(void)close(fd);
+			return -err;
+		}
+		(void)close(fd);
+		return 0;
+	}
+	buf = (uint8_t *)mmap(NULL, MB, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		(void)close(fd);
+		return -ENOMEM;
+	}
+	stress_uint8rnd4(buf, MB);
+	for (sz = 0; (sz < job->size) && keep_stressing(args); sz += MB) {
+		if (write(fd, buf, (size_t)STRESS_MINIMUM(MB, job->size - sz)) < 0) {
+			const int err = errno;
+
+			(void)munmap((void *)buf, MB);
+			(void)close(fd);
+			return -err;
+		}
+	}
+	(void)munmap((void *)buf, MB);
+	(void)shim_fsync(fd);
+	stress_iomix_fadvise_random_dontneed(fd, 0, (off_t)job->size);
+	(void)close(fd);
+	return 0;
+}
+
+/*
+ *  stress_iomix_p99()
+ *	99th percentile latency in usecs from a log2 histogram,
+ *	the upper bound of the bucket
+ */
+static uint64_t stress_iomix_p99(const uint64_t *hist, const uint64_t ops)
+{
+	const uint64_t target = ops - (ops / 100);
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < IOMIX_HIST; i++) {
+		sum += hist[i];
+		if (sum >= target)
+			return (uint64_t)1 << i;
+	}
+	return (uint64_t)1 << (IOMIX_HIST - 1);
+}
+
+/*
+ *  stress_iomix_profile()
+ *	run the jobs of a workload profile concurrently and report
+ *	the throughput and latency of each job
+ */
+static int stress_iomix_profile(const stress_args_t *args, const char *profile_name)
+{
+	stress_iomix_profile_t profile;
+	stress_iomix_job_result_t *results;
+	char filenames[IOMIX_JOBS_MAX][PATH_MAX], err[256], *text;
+	pid_t pids[IOMIX_PROCS_MAX];
+	size_t procs = 0, results_size, i, j, idx = 0;
+	const pid_t parent = getpid();
+	double t_begin, duration;
+	int ret = EXIT_SUCCESS;
+
+	text = stress_iomix_profile_load(profile_name);
+	if (!text) {
+		pr_fail("%s: cannot load profile %s\n", args->name, profile_name);
+		return EXIT_FAILURE;
+	}
+	if (stress_iomix_profile_parse(text, &profile, err, sizeof(err)) < 0) {
+		pr_fail("%s: profile %s: %s\n", args->name, profile_name, err);
+		free(text);
+		return EXIT_FAILURE;
+	}
+	free(text);
+
+	for (i = 0; i < profile.jobs_num; i++)
+		procs += (size_t)profile.jobs[i].numjobs * profile.jobs[i].iodepth;
+	results_size = procs * sizeof(*results);
+	results = (stress_iomix_job_result_t *)mmap(NULL, results_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (results == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap job results, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(results, 0, results_size);
+	(void)memset(pids, 0, sizeof(pids));
+
+	for (i = 0; i < profile.jobs_num; i++) {
+		int rc;
+
+		(void)stress_temp_filename_args(args, filenames[i], sizeof(filenames[i]), (uint64_t)i);
+		rc = stress_iomix_job_file(args, &profile.jobs[i], filenames[i]);
+		if (rc < 0) {
+			if (rc == -ENOSPC) {
+				pr_inf_skip("%s: no space for the %s job file, skipping stressor\n",
+					args->name, profile.jobs[i].name);
+				ret = EXIT_NO_RESOURCE;
+			} else {
+				pr_fail("%s: cannot create %s job file %s, errno=%d (%s)\n",
+					args->name, profile.jobs[i].name, filenames[i],
+					-rc, strerror(-rc));
+				ret = EXIT_FAILURE;
+			}
+			while (i > 0)
+				(void)shim_unlink(filenames[--i]);
+			goto unmap;
+		}
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_begin = stress_time_now();
+	for (idx = 0, i = 0; i < profile.jobs_num; i++) {
+		const stress_iomix_job_t *job = &profile.jobs[i];
+		const uint32_t job_procs = job->numjobs * job->iodepth;
+		uint32_t k;
+
+		for (k = 0; k < job_procs; k++, idx++) {
+			pids[idx] = fork();
+			if (pids[idx] < 0) {
+				pids[idx] = 0;
+				goto reap;
+			} else if (pids[idx] == 0) {
+				(void)sched_settings_apply(true);
+				stress_iomix_job_proc(args, job, filenames[i], k, job_procs, &results[idx]);
+				(void)kill(parent, SIGALRM);
+				_exit(EXIT_SUCCESS);
+			}
+		}
+	}
+
+	do {
+		pause();
+	} while (inc_counter_lock(args, counter_lock, false));
+
+reap:
+	for (i = 0; i < procs; i++) {
+		if (pids[i]) {
+			(void)kill(pids[i], SIGALRM);
+			(void)kill(pids[i], SIGKILL);
+		}
+	}
+	for (i = 0; i < procs; i++) {
+		if (pids[i]) {
+			int status;
+
+			(void)shim_waitpid(pids[i], &status, 0);
+		}
+	}
+	duration = stress_time_now() - t_begin;
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: profile %s, %zu jobs, %zu processes, %.2f seconds\n",
+			args->name, profile_name, profile.jobs_num, procs, duration);
+		pr_inf("%s: %-16s %-9s %5s %10s %10s %10s %10s %10s %9s\n",
+			args->name, "job", "rw", "procs", "IOPS", "rd MB/s",
+			"wr MB/s", "mean usec", "p99 usec", "syncs/s");
+	}
+	for (idx = 0, i = 0; i < profile.jobs_num; i++) {
+		const stress_iomix_job_t *job = &profile.jobs[i];
+		const uint32_t job_procs = job->numjobs * job->iodepth;
+		stress_iomix_job_result_t total;
+		uint64_t ops;
+		double iops, rd_mbs, wr_mbs, mean, syncs;
+		char str[64];
+
+		(void)memset(&total, 0, sizeof(total));
+		for (j = 0; j < job_procs; j++, idx++) {
+			const stress_iomix_job_result_t *r = &results[idx];
+			int b;
+
+			total.read_ops += r->read_ops;
+			total.write_ops += r->write_ops;
+			total.read_bytes += r->read_bytes;
+			total.write_bytes += r->write_bytes;
+			total.syncs += r->syncs;
+			total.lat_ns += r->lat_ns;
+			total.errors += r->errors;
+			for (b = 0; b < IOMIX_HIST; b++)
+				total.hist[b] += r->hist[b];
+		}
+		ops = total.read_ops + total.write_ops;
+		iops = (duration > 0.0) ? (double)ops / duration : 0.0;
+		rd_mbs = (duration > 0.0) ? (double)total.read_bytes / duration / (double)MB : 0.0;
+		wr_mbs = (duration > 0.0) ? (double)total.write_bytes / duration / (double)MB : 0.0;
+		mean = ops ? (double)total.lat_ns / (double)ops / 1000.0 : 0.0;
+		syncs = (duration > 0.0) ? (double)total.syncs / duration : 0.0;
+
+		if (args->instance == 0)
+			pr_inf("%s: %-16s %-9s %5" PRIu32 " %10.1f %10.2f %10.2f %10.1f %10" PRIu64 " %9.1f\n",
+				args->name, job->name, iomix_rw_names[job->rw], job_procs,
+				iops, rd_mbs, wr_mbs, mean,
+				ops ? stress_iomix_p99(total.hist, ops) : 0, syncs);
+		if (total.errors)
+			pr_dbg("%s: %s job had %" PRIu64 " I/O errors\n",
+				args->name, job->name, total.errors);
+		(void)snprintf(str, sizeof(str), "%s IOPS", job->name);
+		stress_metrics_set(args, i * 3, str, iops);
+		(void)snprintf(str, sizeof(str), "%s MB per sec", job->name);
+		stress_metrics_set(args, (i * 3) + 1, str, rd_mbs + wr_mbs);
+		(void)snprintf(str, sizeof(str), "%s p99 latency usec", job->name);
+		stress_metrics_set(args, (i * 3) + 2, str,
+			ops ? (double)stress_iomix_p99(total.hist, ops) : 0.0);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	for (i = 0; i < profile.jobs_num; i++)
+		(void)shim_unlink(filenames[i]);
+unmap:
+	(void)munmap((void *)results, results_size);
+	return ret;
+}
+
 /*
  *  stress_iomix
  *	stress I/O via random mix of io ops
@@ -961,6 +1642,7 @@ static int stress_iomix(const stress_args_t *args)
 	const char *fs_type;
 	int oflags = O_CREAT | O_RDWR;
 	const pid_t parent = getpid();
+	const char *iomix_profile = NULL;
 
 #if defined(O_SYNC)
 	oflags |= O_SYNC;
@@ -990,6 +1672,13 @@ static int stress_iomix(const stress_args_t *args)
 		goto lock_destroy;
 	}
 
+	(void)stress_get_setting("iomix-profile", &iomix_profile);
+	if (iomix_profile) {
+		ret = stress_iomix_profile(args, iomix_profile);
+		(void)stress_temp_dir_rm_args(args);
+		goto lock_destroy;
+	}
+
 	(void)stress_temp_filename_args(args,
 		filename, sizeof(filename), stress_mwc32());
 	if ((fd = open(filename, oflags, S_IRUSR | S_IWUSR)) < 0) {
@@ -1069,6 +1758,7 @@ lock_destroy:
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_iomix_bytes,	stress_set_iomix_bytes },
+	{ OPT_iomix_profile,	stress_set_iomix_profile },
 	{ 0,			NULL }
 };
 
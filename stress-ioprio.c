@@ -18,8 +18,13 @@
  *
  */
 #include "stress-ng.h"
+#include "core-cgroup.h"
 #include "core-io-priority.h"
 
+#if defined(HAVE_SYS_SYSMACROS_H)
+#include <sys/sysmacros.h>
+#endif
+
 #if defined(HAVE_SYS_UIO_H)
 #include <sys/uio.h>
 #endif
@@ -34,10 +39,21 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"ioprio N",	"start N workers exercising set/get iopriority" },
+	{ NULL,	"ioprio-bench",	"measure bandwidth share and latency of competing I/O priorities" },
 	{ NULL,	"ioprio-ops N",	"stop after N io bogo iopriority operations" },
 	{ NULL, NULL,		NULL }
 };
 
+static int stress_set_ioprio_bench(const char *opt)
+{
+	return stress_set_setting_true("ioprio-bench", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_ioprio_bench,	stress_set_ioprio_bench },
+	{ 0,			NULL }
+};
+
 #if defined(HAVE_IOPRIO_GET) &&	\
     defined(HAVE_IOPRIO_SET) && \
     defined(HAVE_PWRITEV)
@@ -45,6 +61,479 @@ static const stress_help_t help[] = {
 #define MAX_IOV		(4)
 #define BUF_SIZE	(32)
 
+#define IOPRIO_BENCH_FILE_SIZE	(32 * MB)	/* per worker file */
+#define IOPRIO_BENCH_BLOCK	(4096)		/* random read size */
+#define IOPRIO_BENCH_WORKERS	(3)		/* max competing workers */
+#define IOPRIO_BENCH_SLICE	(1.0)		/* seconds per config run */
+#define IOPRIO_BENCH_HIST	(32)		/* log2 usec latency buckets */
+#define IOPRIO_BENCH_LATENCY_US	(5000)		/* io.latency target */
+
+#define IOPRIO_BENCH_CG_NONE	(0)
+#define IOPRIO_BENCH_CG_WEIGHT	(1)		/* io.weight and io.bfq.weight */
+#define IOPRIO_BENCH_CG_LATENCY	(2)		/* io.latency target */
+
+/* a competing worker of a benchmark configuration */
+typedef struct {
+	const char *label;
+	const int ioprio_class;		/* -1 leaves the default ioprio */
+	const int ioprio_level;
+	const int cg_type;		/* IOPRIO_BENCH_CG_* */
+	const int cg_value;		/* weight or latency target usecs, 0 none */
+} stress_ioprio_worker_t;
+
+typedef struct {
+	const char *name;
+	const size_t workers_num;
+	const stress_ioprio_worker_t workers[IOPRIO_BENCH_WORKERS];
+} stress_ioprio_config_t;
+
+/* results of a worker, written by the worker process */
+typedef struct {
+	uint64_t ops;
+	uint64_t lat_ns;		/* total latency */
+	uint64_t hist[IOPRIO_BENCH_HIST];
+	double duration;
+	bool prio_failed;		/* ioprio_set failed */
+	bool cg_failed;			/* cgroup could not be used */
+} stress_ioprio_result_t;
+
+static const stress_ioprio_config_t ioprio_configs[] = {
+	{ "classes", 3, {
+		{ "rt/4",	IOPRIO_CLASS_RT,   4, IOPRIO_BENCH_CG_NONE, 0 },
+		{ "be/4",	IOPRIO_CLASS_BE,   4, IOPRIO_BENCH_CG_NONE, 0 },
+		{ "idle",	IOPRIO_CLASS_IDLE, 0, IOPRIO_BENCH_CG_NONE, 0 } } },
+	{ "be-levels", 2, {
+		{ "be/0",	IOPRIO_CLASS_BE,   0, IOPRIO_BENCH_CG_NONE, 0 },
+		{ "be/7",	IOPRIO_CLASS_BE,   7, IOPRIO_BENCH_CG_NONE, 0 } } },
+	{ "io.weight", 2, {
+		{ "weight-1000", -1, 0, IOPRIO_BENCH_CG_WEIGHT, 1000 },
+		{ "weight-100",	-1, 0, IOPRIO_BENCH_CG_WEIGHT, 100 } } },
+	{ "io.latency", 2, {
+		{ "latency-5ms", -1, 0, IOPRIO_BENCH_CG_LATENCY, IOPRIO_BENCH_LATENCY_US },
+		{ "no-target",	-1, 0, IOPRIO_BENCH_CG_LATENCY, 0 } } },
+};
+
+#define IOPRIO_BENCH_RESULTS	(SIZEOF_ARRAY(ioprio_configs) * IOPRIO_BENCH_WORKERS)
+
+/*
+ *  stress_ioprio_bench_device()
+ *	find the whole disk major:minor and the active I/O scheduler
+ *	of the device a file is on
+ */
+static void stress_ioprio_bench_device(
+	const int fd,
+	char *devnum,
+	const size_t devnum_len,
+	char *sched,
+	const size_t sched_len)
+{
+#if defined(major) &&	\
+    defined(minor)
+	struct stat statbuf;
+	char path[PATH_MAX], buf[256], *ptr, *end;
+#endif
+
+	(void)shim_strlcpy(devnum, "", devnum_len);
+	(void)shim_strlcpy(sched, "unknown", sched_len);
+#if defined(major) &&	\
+    defined(minor)
+	if (fstat(fd, &statbuf) < 0)
+		return;
+	(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/partition",
+		major(statbuf.st_dev), minor(statbuf.st_dev));
+	if (access(path, R_OK) == 0) {
+		/* a partition, use the whole disk */
+		(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../dev",
+			major(statbuf.st_dev), minor(statbuf.st_dev));
+		if (system_read(path, buf, sizeof(buf)) <= 0)
+			return;
+		(void)sscanf(buf, "%31s", devnum);
+		(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/scheduler",
+			major(statbuf.st_dev), minor(statbuf.st_dev));
+	} else {
+		(void)snprintf(devnum, devnum_len, "%u:%u",
+			major(statbuf.st_dev), minor(statbuf.st_dev));
+		(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/scheduler",
+			major(statbuf.st_dev), minor(statbuf.st_dev));
+	}
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return;
+	/* the active scheduler is in square brackets */
+	ptr = strchr(buf, '[');
+	end = ptr ? strchr(ptr, ']') : NULL;
+	if (ptr && end) {
+		*end = '\0';
+		(void)shim_strlcpy(sched, ptr + 1, sched_len);
+	}
+#else
+	(void)fd;
+#endif
+}
+
+/*
+ *  stress_ioprio_bench_worker()
+ *	random block reads on a file until the stop flag is set,
+ *	the latency of each read is recorded
+ */
+static void NORETURN stress_ioprio_bench_worker(
+	const stress_args_t *args,
+	const stress_ioprio_worker_t *worker,
+	const char *filename,
+	const char *cg_path,
+	stress_ioprio_result_t *result,
+	volatile bool *stop)
+{
+	const uint64_t blocks = IOPRIO_BENCH_FILE_SIZE / IOPRIO_BENCH_BLOCK;
+	uint8_t *buf;
+	int fd;
+	double t_begin;
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	if (worker->ioprio_class >= 0) {
+		if (shim_ioprio_set(IOPRIO_WHO_PROCESS, 0,
+			IOPRIO_PRIO_VALUE(worker->ioprio_class, worker->ioprio_level)) < 0)
+			result->prio_failed = true;
+	}
+	if (cg_path && (stress_cgroup_move(cg_path, getpid()) < 0))
+		result->cg_failed = true;
+
+	buf = (uint8_t *)mmap(NULL, IOPRIO_BENCH_BLOCK, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		_exit(EXIT_NO_RESOURCE);
+#if defined(O_DIRECT)
+	fd = open(filename, O_RDONLY | O_DIRECT);
+	if (fd < 0)
+		fd = open(filename, O_RDONLY);
+#else
+	fd = open(filename, O_RDONLY);
+#endif
+	if (fd < 0) {
+		pr_dbg("%s: cannot open %s, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		_exit(EXIT_FAILURE);
+	}
+
+	t_begin = stress_time_now();
+	while (!*stop && keep_stressing_flag()) {
+		const off_t offset = (off_t)(stress_mwc64modn(blocks) * IOPRIO_BENCH_BLOCK);
+		double t;
+		uint64_t ns, us;
+		int bucket = 0;
+
+		t = stress_time_now();
+		if (pread(fd, buf, IOPRIO_BENCH_BLOCK, offset) < 0)
+			break;
+		ns = (uint64_t)((stress_time_now() - t) * STRESS_DBL_NANOSECOND);
+		result->ops++;
+		result->lat_ns += ns;
+		for (us = ns / 1000; us && (bucket < IOPRIO_BENCH_HIST - 1); us >>= 1)
+			bucket++;
+		result->hist[bucket]++;
+	}
+	result->duration += stress_time_now() - t_begin;
+	(void)close(fd);
+	(void)munmap((void *)buf, IOPRIO_BENCH_BLOCK);
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_ioprio_bench_cgroup()
+ *	create the cgroup of a worker and apply its io.weight or
+ *	io.latency setting, returns -1 if this is not possible
+ */
+static int stress_ioprio_bench_cgroup(
+	const stress_ioprio_worker_t *worker,
+	const char *devnum,
+	char *path,
+	const size_t path_len)
+{
+	char value[64];
+	int ret = -1;
+
+	if (stress_cgroup_create(worker->label, "io", path, path_len) < 0)
+		return -1;
+	switch (worker->cg_type) {
+	case IOPRIO_BENCH_CG_WEIGHT:
+		/* io.weight is used by blk-iocost, io.bfq.weight by bfq */
+		(void)snprintf(value, sizeof(value), "default %d", worker->cg_value);
+		if (stress_cgroup_set(path, "io.weight", value) == 0)
+			ret = 0;
+		(void)snprintf(value, sizeof(value), "%d", worker->cg_value);
+		if (stress_cgroup_set(path, "io.bfq.weight", value) == 0)
+			ret = 0;
+		break;
+	case IOPRIO_BENCH_CG_LATENCY:
+		if (!*devnum)
+			break;
+		if (worker->cg_value)
+			(void)snprintf(value, sizeof(value), "%s target=%d", devnum, worker->cg_value);
+		else
+			(void)snprintf(value, sizeof(value), "%s target=max", devnum);
+		if (stress_cgroup_set(path, "io.latency", value) == 0)
+			ret = 0;
+		break;
+	default:
+		break;
+	}
+	if (ret < 0)
+		stress_cgroup_remove(path);
+	return ret;
+}
+
+/*
+ *  stress_ioprio_bench_run()
+ *	run the competing workers of a configuration for a time slice
+ */
+static int stress_ioprio_bench_run(
+	const stress_args_t *args,
+	const stress_ioprio_config_t *config,
+	char filenames[IOPRIO_BENCH_WORKERS][PATH_MAX],
+	const char *devnum,
+	stress_ioprio_result_t *results,
+	bool *unsupported,
+	volatile bool *stop)
+{
+	char cg_paths[IOPRIO_BENCH_WORKERS][PATH_MAX + 64];
+	bool cg_made[IOPRIO_BENCH_WORKERS];
+	pid_t pids[IOPRIO_BENCH_WORKERS];
+	size_t i;
+	int rc = 0;
+
+	*stop = false;
+	for (i = 0; i < config->workers_num; i++) {
+		const stress_ioprio_worker_t *worker = &config->workers[i];
+
+		cg_made[i] = false;
+		pids[i] = -1;
+		if (worker->cg_type == IOPRIO_BENCH_CG_NONE)
+			continue;
+		if (stress_ioprio_bench_cgroup(worker, devnum, cg_paths[i], sizeof(cg_paths[i])) < 0) {
+			/* without cgroups for every worker the config is meaningless */
+			*unsupported = true;
+			goto cleanup;
+		}
+		cg_made[i] = true;
+	}
+
+	for (i = 0; i < config->workers_num; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			rc = -1;
+			break;
+		}
+		if (pids[i] == 0) {
+			stress_ioprio_bench_worker(args, &config->workers[i], filenames[i],
+				cg_made[i] ? cg_paths[i] : NULL, &results[i], stop);
+		}
+	}
+	if (!rc)
+		(void)shim_nanosleep_uint64((uint64_t)(IOPRIO_BENCH_SLICE * STRESS_DBL_NANOSECOND));
+	*stop = true;
+	for (i = 0; i < config->workers_num; i++) {
+		int status;
+
+		if (pids[i] > 0)
+			(void)shim_waitpid(pids[i], &status, 0);
+	}
+cleanup:
+	for (i = 0; i < config->workers_num; i++) {
+		if (cg_made[i])
+			stress_cgroup_remove(cg_paths[i]);
+	}
+	return rc;
+}
+
+/*
+ *  stress_ioprio_bench_p99()
+ *	99th percentile latency in usecs from the log2 histogram,
+ *	the upper bound of the bucket
+ */
+static uint64_t stress_ioprio_bench_p99(const stress_ioprio_result_t *result)
+{
+	const uint64_t target = result->ops - (result->ops / 100);
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < IOPRIO_BENCH_HIST; i++) {
+		sum += result->hist[i];
+		if (sum >= target)
+			return (uint64_t)1 << i;
+	}
+	return (uint64_t)1 << (IOPRIO_BENCH_HIST - 1);
+}
+
+/*
+ *  stress_ioprio_bench()
+ *	run competing random reads with different ioprio classes,
+ *	io.weight and io.latency settings on the same device and
+ *	report the bandwidth share and latency of each
+ */
+static int stress_ioprio_bench(const stress_args_t *args)
+{
+	char filenames[IOPRIO_BENCH_WORKERS][PATH_MAX];
+	char devnum[32], sched[64];
+	const size_t results_size = sizeof(stress_ioprio_result_t) * IOPRIO_BENCH_RESULTS;
+	stress_ioprio_result_t *results;
+	bool unsupported[SIZEOF_ARRAY(ioprio_configs)];
+	volatile bool *stop;
+	uint8_t *buf;
+	size_t i, c, idx = 0;
+	int ret, rc = EXIT_SUCCESS;
+	bool direct = false;
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0)
+		return stress_exit_status(-ret);
+
+	results = (stress_ioprio_result_t *)mmap(NULL, results_size + args->page_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (results == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap results, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		(void)stress_temp_dir_rm_args(args);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(results, 0, results_size);
+	stop = (volatile bool *)((uintptr_t)results + results_size);
+	(void)memset(unsupported, 0, sizeof(unsupported));
+	*devnum = '\0';
+	(void)shim_strlcpy(sched, "unknown", sizeof(sched));
+
+	buf = (uint8_t *)mmap(NULL, MB, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		rc = EXIT_NO_RESOURCE;
+		goto unmap_results;
+	}
+	stress_uint8rnd4(buf, MB);
+
+	/* one file per worker so workers do not share cached blocks */
+	for (i = 0; i < IOPRIO_BENCH_WORKERS; i++) {
+		size_t sz;
+		int fd;
+
+		(void)stress_temp_filename_args(args, filenames[i],
+			sizeof(filenames[i]), (uint64_t)i);
+		fd = open(filenames[i], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			rc = stress_exit_status(errno);
+			pr_fail("%s: open %s failed, errno=%d (%s)\n",
+				args->name, filenames[i], errno, strerror(errno));
+			goto remove_files;
+		}
+		for (sz = 0; sz < IOPRIO_BENCH_FILE_SIZE; sz += MB) {
+			if (write(fd, buf, MB) < 0) {
+				rc = (errno == ENOSPC) ? EXIT_NO_RESOURCE : EXIT_FAILURE;
+				if (errno == ENOSPC)
+					pr_inf_skip("%s: out of disk space, skipping stressor\n", args->name);
+				else
+					pr_fail("%s: write failed, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+				(void)close(fd);
+				goto remove_files;
+			}
+		}
+		(void)shim_fsync(fd);
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_DONTNEED)
+		(void)posix_fadvise(fd, 0, IOPRIO_BENCH_FILE_SIZE, POSIX_FADV_DONTNEED);
+#endif
+		if (i == 0)
+			stress_ioprio_bench_device(fd, devnum, sizeof(devnum), sched, sizeof(sched));
+		(void)close(fd);
+	}
+#if defined(O_DIRECT)
+	{
+		const int fd = open(filenames[0], O_RDONLY | O_DIRECT);
+
+		if (fd >= 0) {
+			direct = true;
+			(void)close(fd);
+		}
+	}
+#endif
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (c = 0; (c < SIZEOF_ARRAY(ioprio_configs)) && keep_stressing(args); c++) {
+			if (unsupported[c])
+				continue;
+			if (stress_ioprio_bench_run(args, &ioprio_configs[c], filenames, devnum,
+					&results[c * IOPRIO_BENCH_WORKERS], &unsupported[c], stop) < 0) {
+				pr_fail("%s: fork failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_FAILURE;
+				goto remove_files;
+			}
+			inc_counter(args);
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: device %s, I/O scheduler %s, %s random %d byte reads\n",
+			args->name, *devnum ? devnum : "unknown", sched,
+			direct ? "O_DIRECT" : "buffered (O_DIRECT not supported)",
+			IOPRIO_BENCH_BLOCK);
+		pr_inf("%s: %-10s %-12s %10s %7s %10s %10s\n", args->name,
+			"config", "worker", "MB/sec", "share%", "mean usec", "p99 usec");
+	}
+	for (c = 0; c < SIZEOF_ARRAY(ioprio_configs); c++) {
+		const stress_ioprio_config_t *config = &ioprio_configs[c];
+		const stress_ioprio_result_t *r = &results[c * IOPRIO_BENCH_WORKERS];
+		double total = 0.0;
+
+		if (unsupported[c]) {
+			if (args->instance == 0)
+				pr_inf("%s: %-10s not supported, needs a cgroup v2 io "
+					"controller that can be delegated (try running as root)\n",
+					args->name, config->name);
+			continue;
+		}
+		for (i = 0; i < config->workers_num; i++) {
+			if (r[i].duration > 0.0)
+				total += (double)r[i].ops / r[i].duration;
+		}
+		for (i = 0; i < config->workers_num; i++) {
+			const stress_ioprio_worker_t *worker = &config->workers[i];
+			const double rate = (r[i].duration > 0.0) ? (double)r[i].ops / r[i].duration : 0.0;
+			const double mb = rate * IOPRIO_BENCH_BLOCK / (double)MB;
+			const double share = (total > 0.0) ? 100.0 * rate / total : 0.0;
+			const double mean = r[i].ops ? (double)r[i].lat_ns / (double)r[i].ops / 1000.0 : 0.0;
+			const uint64_t p99 = r[i].ops ? stress_ioprio_bench_p99(&r[i]) : 0;
+			char str[64];
+
+			if (args->instance == 0)
+				pr_inf("%s: %-10s %-12s %10.2f %7.2f %10.1f %10" PRIu64 "%s\n",
+					args->name, config->name, worker->label, mb, share, mean, p99,
+					r[i].prio_failed ? " (ioprio not permitted)" :
+					(r[i].cg_failed ? " (cgroup not joined)" : ""));
+			(void)snprintf(str, sizeof(str), "%s %s bandwidth share %%", config->name, worker->label);
+			stress_metrics_set(args, idx++, str, share);
+			(void)snprintf(str, sizeof(str), "%s %s p99 latency usec", config->name, worker->label);
+			stress_metrics_set(args, idx++, str, (double)p99);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+remove_files:
+	for (i = 0; i < IOPRIO_BENCH_WORKERS; i++)
+		(void)shim_unlink(filenames[i]);
+	(void)munmap((void *)buf, MB);
+unmap_results:
+	(void)munmap((void *)results, results_size + args->page_size);
+	(void)stress_temp_dir_rm_args(args);
+
+	return rc;
+}
+
 /*
  *  stress set/get io priorities
  *	stress system by rapid io priority changes
@@ -57,6 +546,11 @@ static int stress_ioprio(const stress_args_t *args)
 #endif
 	int fd, rc = EXIT_FAILURE, ret;
 	char filename[PATH_MAX];
+	bool ioprio_bench = false;
+
+	(void)stress_get_setting("ioprio-bench", &ioprio_bench);
+	if (ioprio_bench)
+		return stress_ioprio_bench(args);
 
 	ret = stress_temp_dir_mk_args(args);
 	if (ret < 0)
@@ -261,6 +755,7 @@ cleanup_dir:
 stressor_info_t stress_ioprio_info = {
 	.stressor = stress_ioprio,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_ALWAYS,
 	.help = help
 };
@@ -268,6 +763,7 @@ stressor_info_t stress_ioprio_info = {
 stressor_info_t stress_ioprio_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without sys/uio.h, ioprio_get(), ioprio_set() or pwritev() support"
 };
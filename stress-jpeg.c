@@ -30,6 +30,14 @@
 #define JPEG_IMAGE_XSTRIPES	(0x03)
 #define JPEG_IMAGE_FLAT		(0x04)
 #define JPEG_IMAGE_BROWN	(0x05)
+#define JPEG_IMAGE_MAX		(0x06)
+
+#define JPEG_BENCH_SLICE	(1.0)	/* seconds per SIMD mode turn */
+#define JPEG_BENCH_QUALITIES	(3)
+#define JPEG_BENCH_SUBSAMPS	(3)
+#define JPEG_BENCH_SIMD		(0)	/* libjpeg(-turbo) default code paths */
+#define JPEG_BENCH_NOSIMD	(1)	/* JSIMD_FORCENONE */
+#define JPEG_BENCH_MODES	(2)
 
 typedef struct {
 	const char *name;
@@ -38,8 +46,10 @@ typedef struct {
 
 static const stress_help_t help[] = {
 	{ NULL,	"jpeg N",		"start N workers that burn cycles with no-ops" },
+	{ NULL,	"jpeg-bench",		"measure encode and decode megapixels/sec of image types" },
 	{ NULL,	"jpeg-height N",	"image height in pixels "},
 	{ NULL,	"jpeg-image type",	"image type: one of brown, flat, gradient, noise, plasma or xstripes" },
+	{ NULL,	"jpeg-nosimd",		"force libjpeg-turbo SIMD code paths off" },
 	{ NULL,	"jpeg-ops N",		"stop after N jpeg bogo no-op operations" },
 	{ NULL,	"jpeg-quality Q",	"compression quality 1 (low) .. 100 (high)" },
 	{ NULL,	"jpeg-width N",		"image width in pixels "},
@@ -115,9 +125,21 @@ static int stress_set_jpeg_image(const char *opt)
 	return -1;
 }
 
+static int stress_set_jpeg_bench(const char *opt)
+{
+	return stress_set_setting_true("jpeg-bench", opt);
+}
+
+static int stress_set_jpeg_nosimd(const char *opt)
+{
+	return stress_set_setting_true("jpeg-nosimd", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_jpeg_bench,	stress_set_jpeg_bench },
 	{ OPT_jpeg_height,	stress_set_jpeg_height },
 	{ OPT_jpeg_image,	stress_set_jpeg_image },
+	{ OPT_jpeg_nosimd,	stress_set_jpeg_nosimd },
 	{ OPT_jpeg_width,	stress_set_jpeg_width },
 	{ OPT_jpeg_quality,	stress_set_jpeg_quality },
 	{ 0,			NULL }
@@ -202,7 +224,7 @@ static void OPTIMIZE3 stress_rgb_brown(
 	register uint8_t g = (val >> 16) & 0xff;
 	register uint8_t b = (val >> 8) & 0xff;
 
-	for (i = 0; i < size; i++) {
+	for (i = 0; i < size; i += 3) {
 		const uint8_t v = stress_mwc8();
 
 		*ptr++ = r;
@@ -280,6 +302,39 @@ static void OPTIMIZE3 stress_rgb_flat(
 	}
 }
 
+/*
+ *  stress_rgb_image()
+ *	generate an x_max by y_max RGB image of the given type
+ */
+static void stress_rgb_image(
+	uint8_t		*rgb,
+	const int	jpeg_image,
+	const int32_t	x_max,
+	const int32_t	y_max)
+{
+	switch (jpeg_image) {
+	default:
+	case JPEG_IMAGE_PLASMA:
+		stress_rgb_plasma(rgb, x_max, y_max);
+		break;
+	case JPEG_IMAGE_NOISE:
+		stress_rgb_noise(rgb, x_max, y_max);
+		break;
+	case JPEG_IMAGE_GRADIENT:
+		stress_rgb_gradient(rgb, x_max, y_max);
+		break;
+	case JPEG_IMAGE_XSTRIPES:
+		stress_rgb_xstripes(rgb, x_max, y_max);
+		break;
+	case JPEG_IMAGE_FLAT:
+		stress_rgb_flat(rgb, x_max, y_max);
+		break;
+	case JPEG_IMAGE_BROWN:
+		stress_rgb_brown(rgb, x_max, y_max);
+		break;
+	}
+}
+
 static int stress_rgb_compress_to_jpeg(
 	uint8_t		*rgb,
 	JSAMPROW 	*row_pointer,
@@ -340,6 +395,465 @@ PRAGMA_UNROLL_N(8)
 	return (int)size;
 }
 
+#if defined(MEM_SRCDST_SUPPORTED) ||	\
+    (JPEG_LIB_VERSION >= 80)
+#define STRESS_JPEG_BENCH
+
+static const int jpeg_bench_qualities[JPEG_BENCH_QUALITIES] = { 50, 75, 95 };
+
+/* chroma subsampling, luma sampling factors relative to the chroma */
+static const struct {
+	const char *name;
+	const int h_samp;
+	const int v_samp;
+} jpeg_bench_subsamps[JPEG_BENCH_SUBSAMPS] = {
+	{ "4:4:4", 1, 1 },
+	{ "4:2:2", 2, 1 },
+	{ "4:2:0", 2, 2 },
+};
+
+static const char * const jpeg_bench_modes[JPEG_BENCH_MODES] = {
+	"simd",
+	"nosimd",
+};
+
+/* encode and decode results of an image, quality and subsampling */
+typedef struct {
+	double encode_pixels;
+	double encode_secs;
+	double decode_pixels;
+	double decode_secs;
+	double jpeg_bytes;		/* compressed size of the encodes */
+	double rgb_bytes;		/* uncompressed size of the encodes */
+} stress_jpeg_bench_t;
+
+/* results shared with the per SIMD mode child processes, by jpeg_image_types index */
+typedef struct {
+	stress_jpeg_bench_t bench[JPEG_BENCH_MODES][JPEG_IMAGE_MAX][JPEG_BENCH_QUALITIES][JPEG_BENCH_SUBSAMPS];
+	size_t next[JPEG_BENCH_MODES];	/* next configuration of each mode */
+	bool failed;			/* encode or decode failed */
+} stress_jpeg_bench_results_t;
+
+/*
+ *  stress_jpeg_bench_encode()
+ *	encode an RGB image into a malloc'd JPEG buffer, returns the size,
+ *	the buffer must be free'd by the caller
+ */
+static unsigned long stress_jpeg_bench_encode(
+	const uint8_t	*rgb,
+	const int32_t	x_max,
+	const int32_t	y_max,
+	const int	quality,
+	const size_t	subsamp,
+	unsigned char	**jpeg)
+{
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	unsigned long size = 0;
+	const int row_stride = x_max * 3;
+
+	*jpeg = NULL;
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_mem_dest(&cinfo, jpeg, &size);
+
+	cinfo.image_width = (JDIMENSION)x_max;
+	cinfo.image_height = (JDIMENSION)y_max;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, quality, TRUE);
+	cinfo.comp_info[0].h_samp_factor = jpeg_bench_subsamps[subsamp].h_samp;
+	cinfo.comp_info[0].v_samp_factor = jpeg_bench_subsamps[subsamp].v_samp;
+	jpeg_start_compress(&cinfo, TRUE);
+
+	while (cinfo.next_scanline < cinfo.image_height) {
+		JSAMPROW row = (JSAMPROW)(uintptr_t)(rgb + (size_t)cinfo.next_scanline * (size_t)row_stride);
+
+		(void)jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	return size;
+}
+
+/*
+ *  stress_jpeg_bench_decode()
+ *	decode a JPEG image into rgb, returns false if the decoded
+ *	image is not x_max by y_max RGB
+ */
+static bool stress_jpeg_bench_decode(
+	unsigned char	*jpeg,
+	const unsigned long size,
+	uint8_t		*rgb,
+	const int32_t	x_max,
+	const int32_t	y_max)
+{
+	struct jpeg_decompress_struct dinfo;
+	struct jpeg_error_mgr jerr;
+	const int row_stride = x_max * 3;
+	bool ok;
+
+	dinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_decompress(&dinfo);
+	jpeg_mem_src(&dinfo, jpeg, size);
+	(void)jpeg_read_header(&dinfo, TRUE);
+	dinfo.out_color_space = JCS_RGB;
+	(void)jpeg_start_decompress(&dinfo);
+
+	ok = (dinfo.output_width == (JDIMENSION)x_max) &&
+	     (dinfo.output_height == (JDIMENSION)y_max) &&
+	     (dinfo.output_components == 3);
+	if (ok) {
+		while (dinfo.output_scanline < dinfo.output_height) {
+			JSAMPROW row = (JSAMPROW)(rgb + (size_t)dinfo.output_scanline * (size_t)row_stride);
+
+			(void)jpeg_read_scanlines(&dinfo, &row, 1);
+		}
+		(void)jpeg_finish_decompress(&dinfo);
+	}
+	jpeg_destroy_decompress(&dinfo);
+
+	return ok;
+}
+
+/*
+ *  stress_jpeg_bench_mode()
+ *	child process, encode and decode the configurations in turn for a
+ *	slice of time with the SIMD code paths on or forced off. libjpeg-turbo
+ *	reads JSIMD_FORCENONE once, on first use in a process, hence a
+ *	child per mode
+ */
+static void stress_jpeg_bench_mode(
+	const stress_args_t *args,
+	stress_jpeg_bench_results_t *results,
+	const size_t mode,
+	uint8_t * const *images,
+	const bool *image_used,
+	const size_t *qualities,
+	const size_t n_qualities,
+	uint8_t *decoded,
+	const int32_t x_max,
+	const int32_t y_max)
+{
+	const size_t configs = JPEG_IMAGE_MAX * JPEG_BENCH_QUALITIES * JPEG_BENCH_SUBSAMPS;
+	const double pixels = (double)x_max * (double)y_max;
+	const double t_end = stress_time_now() + JPEG_BENCH_SLICE;
+	size_t config = results->next[mode];
+
+	if (mode == JPEG_BENCH_NOSIMD)
+		(void)setenv("JSIMD_FORCENONE", "1", 1);
+	else
+		(void)unsetenv("JSIMD_FORCENONE");
+
+	while (keep_stressing(args) && (stress_time_now() < t_end)) {
+		const size_t image = config / (JPEG_BENCH_QUALITIES * JPEG_BENCH_SUBSAMPS);
+		const size_t quality = (config / JPEG_BENCH_SUBSAMPS) % JPEG_BENCH_QUALITIES;
+		const size_t subsamp = config % JPEG_BENCH_SUBSAMPS;
+		stress_jpeg_bench_t *bench = &results->bench[mode][image][quality][subsamp];
+		unsigned char *jpeg;
+		unsigned long size;
+		double t1, t2, t3;
+		size_t i;
+		bool used = false;
+
+		config = (config + 1) % configs;
+		for (i = 0; i < n_qualities; i++)
+			used |= (qualities[i] == quality);
+		if (!image_used[image] || !used)
+			continue;
+
+		t1 = stress_time_now();
+		size = stress_jpeg_bench_encode(images[image], x_max, y_max,
+			jpeg_bench_qualities[quality], subsamp, &jpeg);
+		t2 = stress_time_now();
+		if (!jpeg || (size == 0)) {
+			free(jpeg);
+			results->failed = true;
+			pr_fail("%s: %s %s encode failed\n", args->name,
+				jpeg_image_types[image].name, jpeg_bench_modes[mode]);
+			break;
+		}
+		if (!stress_jpeg_bench_decode(jpeg, size, decoded, x_max, y_max)) {
+			free(jpeg);
+			results->failed = true;
+			pr_fail("%s: %s %s decode gave the wrong image size\n", args->name,
+				jpeg_image_types[image].name, jpeg_bench_modes[mode]);
+			break;
+		}
+		t3 = stress_time_now();
+		free(jpeg);
+
+		bench->encode_pixels += pixels;
+		bench->encode_secs += t2 - t1;
+		bench->decode_pixels += pixels;
+		bench->decode_secs += t3 - t2;
+		bench->jpeg_bytes += (double)size;
+		bench->rgb_bytes += pixels * 3.0;
+		inc_counter(args);
+	}
+	results->next[mode] = config;
+}
+
+/*
+ *  stress_jpeg_bench_rate()
+ *	encode and decode megapixels per second summed over the
+ *	configurations of a mode matching image, quality and subsamp,
+ *	where -1 matches any
+ */
+static void stress_jpeg_bench_rate(
+	const stress_jpeg_bench_results_t *results,
+	const size_t mode,
+	const int image,
+	const int quality,
+	const int subsamp,
+	double *encode,
+	double *decode)
+{
+	double encode_pixels = 0.0, encode_secs = 0.0;
+	double decode_pixels = 0.0, decode_secs = 0.0;
+	int i, q, s;
+
+	for (i = 0; i < JPEG_IMAGE_MAX; i++) {
+		if ((image >= 0) && (i != image))
+			continue;
+		for (q = 0; q < JPEG_BENCH_QUALITIES; q++) {
+			if ((quality >= 0) && (q != quality))
+				continue;
+			for (s = 0; s < JPEG_BENCH_SUBSAMPS; s++) {
+				const stress_jpeg_bench_t *bench = &results->bench[mode][i][q][s];
+
+				if ((subsamp >= 0) && (s != subsamp))
+					continue;
+				encode_pixels += bench->encode_pixels;
+				encode_secs += bench->encode_secs;
+				decode_pixels += bench->decode_pixels;
+				decode_secs += bench->decode_secs;
+			}
+		}
+	}
+	*encode = (encode_secs > 0.0) ? encode_pixels / encode_secs / 1000000.0 : 0.0;
+	*decode = (decode_secs > 0.0) ? decode_pixels / decode_secs / 1000000.0 : 0.0;
+}
+
+/*
+ *  stress_jpeg_bench_report()
+ *	print the results table and set the per image, quality and
+ *	subsampling metrics
+ */
+static void stress_jpeg_bench_report(
+	const stress_args_t *args,
+	const stress_jpeg_bench_results_t *results,
+	const bool *modes)
+{
+	size_t i, q, s, m, idx = 0;
+	char str[64];
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: megapixels/sec, %s\n", args->name,
+			modes[JPEG_BENCH_SIMD] && modes[JPEG_BENCH_NOSIMD] ?
+			"simd and with JSIMD_FORCENONE (nosimd)" :
+			(modes[JPEG_BENCH_SIMD] ? "simd" : "with JSIMD_FORCENONE (nosimd)"));
+		pr_inf("%s: %-8s %7s %6s %9s %10s %7s %9s %10s %7s %6s\n", args->name,
+			"image", "quality", "subsmp", "enc simd", "enc nosimd", "speedup",
+			"dec simd", "dec nosimd", "speedup", "size%");
+	}
+	for (i = 0; i < JPEG_IMAGE_MAX; i++) {
+		for (q = 0; q < JPEG_BENCH_QUALITIES; q++) {
+			for (s = 0; s < JPEG_BENCH_SUBSAMPS; s++) {
+				double enc[JPEG_BENCH_MODES], dec[JPEG_BENCH_MODES];
+				double jpeg_bytes = 0.0, rgb_bytes = 0.0;
+
+				for (m = 0; m < JPEG_BENCH_MODES; m++) {
+					stress_jpeg_bench_rate(results, m, (int)i, (int)q, (int)s, &enc[m], &dec[m]);
+					jpeg_bytes += results->bench[m][i][q][s].jpeg_bytes;
+					rgb_bytes += results->bench[m][i][q][s].rgb_bytes;
+				}
+				if ((rgb_bytes <= 0.0) || (args->instance != 0))
+					continue;
+				pr_inf("%s: %-8s %7d %6s %9.2f %10.2f %6.2fx %9.2f %10.2f %6.2fx %6.2f\n",
+					args->name, jpeg_image_types[i].name,
+					jpeg_bench_qualities[q], jpeg_bench_subsamps[s].name,
+					enc[JPEG_BENCH_SIMD], enc[JPEG_BENCH_NOSIMD],
+					enc[JPEG_BENCH_NOSIMD] > 0.0 ? enc[JPEG_BENCH_SIMD] / enc[JPEG_BENCH_NOSIMD] : 0.0,
+					dec[JPEG_BENCH_SIMD], dec[JPEG_BENCH_NOSIMD],
+					dec[JPEG_BENCH_NOSIMD] > 0.0 ? dec[JPEG_BENCH_SIMD] / dec[JPEG_BENCH_NOSIMD] : 0.0,
+					100.0 * jpeg_bytes / rgb_bytes);
+			}
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	/* metrics per image, per quality and per subsampling of each mode */
+	for (m = 0; m < JPEG_BENCH_MODES; m++) {
+		double enc, dec;
+
+		if (!modes[m])
+			continue;
+		for (i = 0; i < JPEG_IMAGE_MAX; i++) {
+			stress_jpeg_bench_rate(results, m, (int)i, -1, -1, &enc, &dec);
+			if (enc <= 0.0)
+				continue;
+			(void)snprintf(str, sizeof(str), "%s %s encode megapixels per sec",
+				jpeg_image_types[i].name, jpeg_bench_modes[m]);
+			stress_metrics_set(args, idx++, str, enc);
+			(void)snprintf(str, sizeof(str), "%s %s decode megapixels per sec",
+				jpeg_image_types[i].name, jpeg_bench_modes[m]);
+			stress_metrics_set(args, idx++, str, dec);
+		}
+		for (q = 0; q < JPEG_BENCH_QUALITIES; q++) {
+			stress_jpeg_bench_rate(results, m, -1, (int)q, -1, &enc, &dec);
+			if (enc <= 0.0)
+				continue;
+			(void)snprintf(str, sizeof(str), "quality %d %s encode megapixels per sec",
+				jpeg_bench_qualities[q], jpeg_bench_modes[m]);
+			stress_metrics_set(args, idx++, str, enc);
+			(void)snprintf(str, sizeof(str), "quality %d %s decode megapixels per sec",
+				jpeg_bench_qualities[q], jpeg_bench_modes[m]);
+			stress_metrics_set(args, idx++, str, dec);
+		}
+		for (s = 0; s < JPEG_BENCH_SUBSAMPS; s++) {
+			stress_jpeg_bench_rate(results, m, -1, -1, (int)s, &enc, &dec);
+			if (enc <= 0.0)
+				continue;
+			(void)snprintf(str, sizeof(str), "%s %s encode megapixels per sec",
+				jpeg_bench_subsamps[s].name, jpeg_bench_modes[m]);
+			stress_metrics_set(args, idx++, str, enc);
+			(void)snprintf(str, sizeof(str), "%s %s decode megapixels per sec",
+				jpeg_bench_subsamps[s].name, jpeg_bench_modes[m]);
+			stress_metrics_set(args, idx++, str, dec);
+		}
+	}
+}
+
+/*
+ *  stress_jpeg_bench()
+ *	encode and decode megapixels per second of each image type (or just
+ *	--jpeg-image), quality 50, 75 and 95 (or just --jpeg-quality) and
+ *	4:4:4, 4:2:2 and 4:2:0 chroma subsampling, with the SIMD code paths
+ *	and with them forced off (or just forced off with --jpeg-nosimd).
+ *	The modes take turns for a slice of time in child processes
+ */
+static int stress_jpeg_bench(
+	const stress_args_t *args,
+	const int32_t x_max,
+	const int32_t y_max,
+	const bool set_image,
+	const int jpeg_image,
+	const bool set_quality,
+	const int32_t jpeg_quality,
+	const bool jpeg_nosimd)
+{
+	stress_jpeg_bench_results_t *results;
+	uint8_t *images[JPEG_IMAGE_MAX], *decoded;
+	bool image_used[JPEG_IMAGE_MAX], modes[JPEG_BENCH_MODES];
+	size_t qualities[JPEG_BENCH_QUALITIES], n_qualities = 0;
+	const size_t rgb_size = (size_t)x_max * (size_t)y_max * 3;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	modes[JPEG_BENCH_SIMD] = !jpeg_nosimd;
+	modes[JPEG_BENCH_NOSIMD] = true;
+
+	/* an explicit --jpeg-quality is benchmarked as the nearest quality */
+	if (set_quality) {
+		size_t nearest = 0;
+
+		for (i = 1; i < JPEG_BENCH_QUALITIES; i++) {
+			if (abs(jpeg_bench_qualities[i] - jpeg_quality) <
+			    abs(jpeg_bench_qualities[nearest] - jpeg_quality))
+				nearest = i;
+		}
+		qualities[n_qualities++] = nearest;
+	} else {
+		for (i = 0; i < JPEG_BENCH_QUALITIES; i++)
+			qualities[n_qualities++] = i;
+	}
+
+	results = (stress_jpeg_bench_results_t *)mmap(NULL, sizeof(*results),
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (results == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes for results, skipping stressor\n",
+			args->name, sizeof(*results));
+		return EXIT_NO_RESOURCE;
+	}
+	decoded = (uint8_t *)mmap(NULL, rgb_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (decoded == MAP_FAILED) {
+		pr_inf_skip("%s: cannot allocate RGB buffer of %zu bytes, skipping stressor\n",
+			args->name, rgb_size);
+		(void)munmap((void *)results, sizeof(*results));
+		return EXIT_NO_RESOURCE;
+	}
+
+	stress_mwc_set_seed(0xf1379ab2, 0x679ce25d);
+	for (i = 0; i < JPEG_IMAGE_MAX; i++) {
+		images[i] = NULL;
+		image_used[i] = !set_image || (jpeg_image_types[i].type == jpeg_image);
+		if (!image_used[i])
+			continue;
+		images[i] = (uint8_t *)mmap(NULL, rgb_size, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (images[i] == MAP_FAILED) {
+			images[i] = NULL;
+			pr_inf_skip("%s: cannot allocate RGB buffer of %zu bytes, skipping stressor\n",
+				args->name, rgb_size);
+			rc = EXIT_NO_RESOURCE;
+			goto tidy;
+		}
+		stress_rgb_image(images[i], jpeg_image_types[i].type, x_max, y_max);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	while (keep_stressing(args) && !results->failed) {
+		for (i = 0; (i < JPEG_BENCH_MODES) && keep_stressing(args); i++) {
+			pid_t pid;
+
+			if (!modes[i])
+				continue;
+again:
+			pid = fork();
+			if (pid < 0) {
+				if (stress_redo_fork(errno))
+					goto again;
+				if (!keep_stressing(args))
+					break;
+				pr_inf_skip("%s: fork failed, errno=%d (%s), skipping stressor\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_NO_RESOURCE;
+				goto deinit;
+			} else if (pid == 0) {
+				stress_parent_died_alarm();
+				stress_jpeg_bench_mode(args, results, i, images, image_used,
+					qualities, n_qualities, decoded, x_max, y_max);
+				_exit(0);
+			} else {
+				int status;
+
+				(void)shim_waitpid(pid, &status, 0);
+			}
+		}
+	}
+	stress_jpeg_bench_report(args, results, modes);
+	if (results->failed)
+		rc = EXIT_FAILURE;
+deinit:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+tidy:
+	for (i = 0; i < JPEG_IMAGE_MAX; i++) {
+		if (images[i])
+			(void)munmap((void *)images[i], rgb_size);
+	}
+	(void)munmap((void *)decoded, rgb_size);
+	(void)munmap((void *)results, sizeof(*results));
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_jpeg()
  *	stress jpeg compression
@@ -358,11 +872,28 @@ static int stress_jpeg(const stress_args_t *args)
 	size_t rgb_size, row_pointer_size;
 	int jpeg_image = JPEG_IMAGE_PLASMA;
 	double total_pixels = 0.0, t_start, duration, rate, ratio;
+	bool jpeg_bench = false, jpeg_nosimd = false, set_quality, set_image;
 
 	(void)stress_get_setting("jpeg-width", &x_max);
 	(void)stress_get_setting("jpeg-height", &y_max);
-	(void)stress_get_setting("jpeg-quality", &jpeg_quality);
-	(void)stress_get_setting("jpeg-image", &jpeg_image);
+	set_quality = stress_get_setting("jpeg-quality", &jpeg_quality);
+	set_image = stress_get_setting("jpeg-image", &jpeg_image);
+	(void)stress_get_setting("jpeg-bench", &jpeg_bench);
+	(void)stress_get_setting("jpeg-nosimd", &jpeg_nosimd);
+
+	if (jpeg_bench) {
+#if defined(STRESS_JPEG_BENCH)
+		return stress_jpeg_bench(args, x_max, y_max, set_image, jpeg_image,
+			set_quality, jpeg_quality, jpeg_nosimd);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --jpeg-bench needs libjpeg memory source and destination "
+				"support, defaulting to jpeg compression\n", args->name);
+#endif
+	}
+	/* libjpeg-turbo reads this on first use */
+	if (jpeg_nosimd)
+		(void)setenv("JSIMD_FORCENONE", "1", 1);
 
 	rgb_size = (size_t)x_max * (size_t)y_max * 3;
 	rgb = mmap(NULL, rgb_size, PROT_READ | PROT_WRITE,
@@ -385,27 +916,7 @@ static int stress_jpeg(const stress_args_t *args)
 
 	stress_mwc_set_seed(0xf1379ab2, 0x679ce25d);
 
-	switch (jpeg_image) {
-	default:
-	case JPEG_IMAGE_PLASMA:
-		stress_rgb_plasma(rgb, x_max, y_max);
-		break;
-	case JPEG_IMAGE_NOISE:
-		stress_rgb_noise(rgb, x_max, y_max);
-		break;
-	case JPEG_IMAGE_GRADIENT:
-		stress_rgb_gradient(rgb, x_max, y_max);
-		break;
-	case JPEG_IMAGE_XSTRIPES:
-		stress_rgb_xstripes(rgb, x_max, y_max);
-		break;
-	case JPEG_IMAGE_FLAT:
-		stress_rgb_flat(rgb, x_max, y_max);
-		break;
-	case JPEG_IMAGE_BROWN:
-		stress_rgb_brown(rgb, x_max, y_max);
-		break;
-	}
+	stress_rgb_image(rgb, jpeg_image, x_max, y_max);
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
@@ -32,10 +32,29 @@
 #define JUDY_OP_DELETE		(2)
 #define JUDY_OP_MAX		(3)
 
+#define MIN_JUDY_THREADS	(1)
+#define MAX_JUDY_THREADS	(64)
+#define DEFAULT_JUDY_THREADS	(4)
+
+/* --judy-bench key distributions */
+#define JUDY_DIST_ALL		(0)
+#define JUDY_DIST_UNIFORM	(1)
+#define JUDY_DIST_ZIPF		(2)
+#define JUDY_DIST_MAX		(3)
+
+static const char * const judy_dists[JUDY_DIST_MAX] = {
+	"all",
+	"uniform",
+	"zipf",
+};
+
 static const stress_help_t help[] = {
 	{ NULL,	"judy N",	"start N workers that exercise a judy array search" },
+	{ NULL,	"judy-bench",	"measure reader-writer locked judy array scaling over threads" },
+	{ NULL,	"judy-dist D",	"judy-bench key distribution: all, uniform, zipf" },
 	{ NULL,	"judy-ops N",	"stop after N judy array search bogo operations" },
 	{ NULL,	"judy-size N",	"number of 32 bit integers to insert into judy array" },
+	{ NULL,	"judy-threads N", "maximum threads for judy-bench" },
 	{ NULL,	NULL,		NULL }
 };
 
@@ -53,8 +72,50 @@ static int stress_set_judy_size(const char *opt)
 	return stress_set_setting("judy-size", TYPE_ID_UINT64, &judy_size);
 }
 
+static int stress_set_judy_bench(const char *opt)
+{
+	return stress_set_setting_true("judy-bench", opt);
+}
+
+/*
+ *  stress_set_judy_threads()
+ *	set maximum number of judy-bench threads
+ */
+static int stress_set_judy_threads(const char *opt)
+{
+	size_t judy_threads;
+
+	judy_threads = (size_t)stress_get_uint32(opt);
+	stress_check_range("judy-threads", (uint64_t)judy_threads,
+		MIN_JUDY_THREADS, MAX_JUDY_THREADS);
+	return stress_set_setting("judy-threads", TYPE_ID_SIZE_T, &judy_threads);
+}
+
+/*
+ *  stress_set_judy_dist()
+ *	set judy-bench key distribution
+ */
+static int stress_set_judy_dist(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(judy_dists); i++) {
+		if (!strcmp(judy_dists[i], opt))
+			return stress_set_setting("judy-dist", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "judy-dist must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(judy_dists); i++)
+		(void)fprintf(stderr, " %s", judy_dists[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_judy_bench,	stress_set_judy_bench },
+	{ OPT_judy_dist,	stress_set_judy_dist },
 	{ OPT_judy_size,	stress_set_judy_size },
+	{ OPT_judy_threads,	stress_set_judy_threads },
 	{ 0,			NULL }
 };
 
@@ -69,6 +130,308 @@ static inline OPTIMIZE3 Word_t gen_index(const Word_t idx)
 	return ((~idx & 0xff) << 24) | (idx & 0x00ffffff);
 }
 
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE)
+#define STRESS_JUDY_BENCH
+
+#define JUDY_BENCH_SLICE	(0.25)	/* seconds per benchmark configuration */
+#define JUDY_BENCH_WRITE_PCT	(10)	/* percentage of insert and delete operations */
+
+/* a judy array shared by the threads behind a reader-writer lock */
+typedef struct {
+	Pvoid_t array;
+	pthread_rwlock_t rwlock;
+	Word_t n;			/* keys are ranks 0..n-1 */
+	int dist;			/* JUDY_DIST_* key distribution */
+	bool start;			/* threads start when set */
+	bool stop;			/* threads stop when set */
+} judy_bench_t;
+
+/* a benchmark thread and its counts */
+typedef struct {
+	judy_bench_t *judy;
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	uint64_t rnd;			/* per thread xorshift state */
+	uint64_t reads;			/* lookups */
+	uint64_t writes;		/* inserts and deletes */
+	int64_t added;			/* keys inserted less keys deleted */
+} judy_bench_thread_t;
+
+/* accumulated results of a thread count and key distribution */
+typedef struct {
+	double reads;
+	double writes;
+	double secs;
+} judy_bench_result_t;
+
+/*
+ *  judy_bench_rand()
+ *	per thread xorshift64, a shared generator would be a
+ *	contended cache line and skew the scaling measured
+ */
+static inline uint64_t judy_bench_rand(uint64_t *state)
+{
+	register uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+/*
+ *  judy_bench_index()
+ *	random sparse index of a rank 0..n-1, uniform or zipf where
+ *	rank r has a probability of ~ 1 / (r + 1)
+ */
+static inline Word_t judy_bench_index(uint64_t *state, const Word_t n, const int dist)
+{
+	const uint64_t r = judy_bench_rand(state);
+	Word_t rank;
+
+	if (dist == JUDY_DIST_UNIFORM) {
+		rank = (Word_t)((r >> 32) % n);
+	} else {
+		rank = (Word_t)(exp(((double)(r >> 11) / 9007199254740992.0) * log((double)n + 1.0)) - 1.0);
+		if (rank >= n)
+			rank = n - 1;
+	}
+	return gen_index(rank);
+}
+
+/*
+ *  judy_bench_thread()
+ *	lookups under the read lock, inserts and deletes under the
+ *	write lock, until stopped
+ */
+static void *judy_bench_thread(void *arg)
+{
+	static void *nowt = NULL;
+	judy_bench_thread_t *thread = (judy_bench_thread_t *)arg;
+	judy_bench_t *judy = thread->judy;
+
+	while (!__atomic_load_n(&judy->start, __ATOMIC_ACQUIRE)) {
+		if (__atomic_load_n(&judy->stop, __ATOMIC_ACQUIRE))
+			return &nowt;
+		shim_sched_yield();
+	}
+	while (!__atomic_load_n(&judy->stop, __ATOMIC_RELAXED)) {
+		register int i;
+
+		for (i = 0; i < 64; i++) {
+			const uint64_t r = judy_bench_rand(&thread->rnd);
+			const Word_t idx = judy_bench_index(&thread->rnd, judy->n, judy->dist);
+			Word_t *pvalue;
+			int rc;
+
+			if ((r % 100) < JUDY_BENCH_WRITE_PCT) {
+				(void)pthread_rwlock_wrlock(&judy->rwlock);
+				if (r & 0x100) {
+					JLI(pvalue, judy->array, idx);
+					if (pvalue && (pvalue != PJERR) && (*pvalue == 0)) {
+						*pvalue = idx;
+						thread->added++;
+					}
+				} else {
+					JLD(rc, judy->array, idx);
+					thread->added -= (rc == 1);
+				}
+				(void)pthread_rwlock_unlock(&judy->rwlock);
+				thread->writes++;
+			} else {
+				(void)pthread_rwlock_rdlock(&judy->rwlock);
+				JLG(pvalue, judy->array, idx);
+				if (UNLIKELY(pvalue && (*pvalue != idx)))
+					thread->added = INT64_MIN;	/* corrupt value, fails the verify */
+				(void)pthread_rwlock_unlock(&judy->rwlock);
+				thread->reads++;
+			}
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  judy_bench_run()
+ *	fill a new judy array with the even ranks and run nthreads
+ *	threads on it for secs seconds
+ */
+static int judy_bench_run(
+	const stress_args_t *args,
+	judy_bench_thread_t *threads,
+	const size_t nthreads,
+	const Word_t n,
+	const int dist,
+	const double secs,
+	judy_bench_result_t *result)
+{
+	judy_bench_t judy;
+	Word_t i, count, bytes;
+	Word_t *pvalue;
+	int64_t expected = 0;
+	size_t j;
+	double t_start;
+	bool corrupt = false;
+
+	(void)memset(&judy, 0, sizeof(judy));
+	judy.array = (Pvoid_t)NULL;
+	judy.n = n;
+	judy.dist = dist;
+	if (pthread_rwlock_init(&judy.rwlock, NULL) != 0)
+		return -1;
+	for (i = 0; i < n; i += 2) {
+		const Word_t idx = gen_index(i);
+
+		JLI(pvalue, judy.array, idx);
+		if (UNLIKELY((pvalue == NULL) || (pvalue == PJERR)))
+			break;
+		*pvalue = idx;
+		expected++;
+	}
+
+	for (j = 0; j < nthreads; j++) {
+		threads[j].judy = &judy;
+		threads[j].rnd = stress_mwc64() | 1;
+		threads[j].reads = 0;
+		threads[j].writes = 0;
+		threads[j].added = 0;
+		threads[j].ret = pthread_create(&threads[j].pthread, NULL, judy_bench_thread, &threads[j]);
+		if (threads[j].ret) {
+			__atomic_store_n(&judy.stop, true, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+	t_start = stress_time_now();
+	__atomic_store_n(&judy.start, true, __ATOMIC_RELEASE);
+	while (keep_stressing(args) && !__atomic_load_n(&judy.stop, __ATOMIC_ACQUIRE) &&
+	       (stress_time_now() < t_start + secs))
+		(void)shim_usleep(10000);
+	__atomic_store_n(&judy.stop, true, __ATOMIC_RELEASE);
+
+	for (j = 0; j < nthreads; j++) {
+		if (threads[j].ret)
+			break;
+		(void)pthread_join(threads[j].pthread, NULL);
+		result->reads += (double)threads[j].reads;
+		result->writes += (double)threads[j].writes;
+		if (threads[j].added == INT64_MIN)
+			corrupt = true;
+		else
+			expected += threads[j].added;
+		add_counter(args, threads[j].reads + threads[j].writes);
+	}
+	result->secs += stress_time_now() - t_start;
+
+	JLC(count, judy.array, 0, -1);
+	if (UNLIKELY(corrupt))
+		pr_fail("%s: judy array lookup found a corrupt value\n", args->name);
+	else if (UNLIKELY((int64_t)count != expected))
+		pr_fail("%s: judy array has %" PRIu64 " indexes, expected %" PRId64 "\n",
+			args->name, (uint64_t)count, expected);
+	JLFA(bytes, judy.array);
+	(void)bytes;
+	(void)pthread_rwlock_destroy(&judy.rwlock);
+
+	return (j < nthreads) ? -1 : 0;
+}
+
+/*
+ *  stress_judy_bench()
+ *	lookup, insert and delete throughput of a reader-writer locked
+ *	judy array with 1, 2, 4 .. max_threads threads and uniform and/or
+ *	zipf key distributions, the configurations take turns for a slice
+ *	of time so all see the same system conditions
+ */
+static int stress_judy_bench(
+	const stress_args_t *args,
+	const Word_t n,
+	const size_t max_threads,
+	const size_t judy_dist)
+{
+	static judy_bench_result_t results[JUDY_DIST_MAX][8];
+	judy_bench_thread_t *threads;
+	size_t nthreads[8], n_nthreads = 0, i, d, idx = 0;
+	bool ran;
+	int rc = EXIT_SUCCESS;
+
+	for (i = 1; (i <= max_threads) && (n_nthreads < SIZEOF_ARRAY(nthreads)); i *= 2)
+		nthreads[n_nthreads++] = i;
+	if (nthreads[n_nthreads - 1] != max_threads) {
+		if (n_nthreads == SIZEOF_ARRAY(nthreads))
+			n_nthreads--;
+		nthreads[n_nthreads++] = max_threads;
+	}
+
+	threads = (judy_bench_thread_t *)calloc(max_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %zu threads, skipping stressor\n",
+			args->name, max_threads);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(results, 0, sizeof(results));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		for (d = JUDY_DIST_UNIFORM; d < JUDY_DIST_MAX; d++) {
+			if ((judy_dist != JUDY_DIST_ALL) && (judy_dist != d))
+				continue;
+			for (i = 0; (i < n_nthreads) && keep_stressing(args); i++) {
+				if (judy_bench_run(args, threads, nthreads[i], n, (int)d,
+						   JUDY_BENCH_SLICE, &results[d][i]) < 0) {
+					pr_inf_skip("%s: cannot create %zu threads, skipping stressor\n",
+						args->name, nthreads[i]);
+					rc = EXIT_NO_RESOURCE;
+					goto tidy;
+				}
+				ran = true;
+			}
+		}
+	} while (ran && keep_stressing(args));
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %" PRIu64 " indexes, %d%% inserts and deletes, %d%% lookups\n",
+			args->name, (uint64_t)n, JUDY_BENCH_WRITE_PCT, 100 - JUDY_BENCH_WRITE_PCT);
+		pr_inf("%s: %-8s %7s %12s %8s %12s %12s\n", args->name,
+			"keys", "threads", "ops/sec", "scaling", "reads/sec", "writes/sec");
+	}
+	for (d = JUDY_DIST_UNIFORM; d < JUDY_DIST_MAX; d++) {
+		double rate1 = 0.0;
+
+		for (i = 0; i < n_nthreads; i++) {
+			const judy_bench_result_t *r = &results[d][i];
+			double rate;
+			char str[64];
+
+			if ((r->secs <= 0.0) || (r->reads + r->writes <= 0.0))
+				continue;
+			rate = (r->reads + r->writes) / r->secs;
+			if (i == 0)
+				rate1 = rate;
+			if (args->instance == 0)
+				pr_inf("%s: %-8s %7zu %12.1f %7.2fx %12.1f %12.1f\n", args->name,
+					judy_dists[d], nthreads[i], rate,
+					rate1 > 0.0 ? rate / rate1 : 0.0,
+					r->reads / r->secs, r->writes / r->secs);
+			(void)snprintf(str, sizeof(str), "%s keys %zu threads ops per sec",
+				judy_dists[d], nthreads[i]);
+			stress_metrics_set(args, idx++, str, rate);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+tidy:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	free(threads);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_judy()
  *	stress a judy array, exercises cache/memory
@@ -81,6 +444,7 @@ static int OPTIMIZE3 stress_judy(const stress_args_t *args)
 	double duration[JUDY_OP_MAX], count[JUDY_OP_MAX];
 	size_t k;
 	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	bool judy_bench = false;
 
 	static const char * const judy_ops[] = {
 		"insert",
@@ -88,6 +452,23 @@ static int OPTIMIZE3 stress_judy(const stress_args_t *args)
 		"delete",
 	};
 
+	(void)stress_get_setting("judy-bench", &judy_bench);
+	if (judy_bench) {
+#if defined(STRESS_JUDY_BENCH)
+		size_t judy_threads = DEFAULT_JUDY_THREADS;
+		size_t judy_dist = JUDY_DIST_ALL;
+
+		(void)stress_get_setting("judy-size", &judy_size);
+		(void)stress_get_setting("judy-threads", &judy_threads);
+		(void)stress_get_setting("judy-dist", &judy_dist);
+		return stress_judy_bench(args, (Word_t)judy_size, judy_threads, judy_dist);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --judy-bench is not supported on this system, "
+				"defaulting to judy stressing\n", args->name);
+#endif
+	}
+
 	if (!stress_get_setting("judy-size", &judy_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
 			judy_size = MAX_JUDY_SIZE;
@@ -0,0 +1,786 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-cpu-cache.h"
+#include "core-sort.h"
+
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    !defined(__ICC) &&			\
+    NEED_GNUC(8, 0, 0)
+#include <immintrin.h>
+#define STRESS_KEYSORT_HAVE_X86_VEC
+#endif
+
+#define MIN_KEYSORT_SIZE	(1 * KB)
+#define MAX_KEYSORT_SIZE	(16 * MB)
+#define DEFAULT_KEYSORT_SIZE	(1 * MB)
+
+#define MIN_KEYSORT_THREADS	(1)
+#define MAX_KEYSORT_THREADS	(1024)
+
+#define KEYSORT_RADIX		(256)	/* 8 bit radix digits */
+#define KEYSORT_PREFETCH	(16)	/* keys ahead to prefetch the scatter target of */
+#define KEYSORT_OVERSAMPLE	(64)	/* samplesort samples per bucket */
+#define KEYSORT_BLOCK		(256)	/* largest bitonic block, 16 x 16 keys */
+#define KEYSORT_SIGN		(0x80000000U)
+
+static const stress_help_t help[] = {
+	{ NULL,	"keysort N",		"start N workers sorting 32 and 64 bit integer keys" },
+	{ NULL,	"keysort-method M",	"select sort, one of all, libc, radix32, radix64, bitonic-avx2, bitonic-avx512 or samplesort" },
+	{ NULL,	"keysort-ops N",	"stop after N keysort bogo operations" },
+	{ NULL,	"keysort-size N",	"number of keys to sort" },
+	{ NULL,	"keysort-threads N",	"number of samplesort threads, default is all CPUs" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_keysort_size(const char *opt)
+{
+	uint64_t keysort_size;
+
+	keysort_size = stress_get_uint64_byte(opt);
+	stress_check_range("keysort-size", keysort_size,
+		MIN_KEYSORT_SIZE, MAX_KEYSORT_SIZE);
+	return stress_set_setting("keysort-size", TYPE_ID_UINT64, &keysort_size);
+}
+
+static int stress_set_keysort_threads(const char *opt)
+{
+	uint32_t keysort_threads;
+
+	keysort_threads = stress_get_uint32(opt);
+	stress_check_range("keysort-threads", (uint64_t)keysort_threads,
+		MIN_KEYSORT_THREADS, MAX_KEYSORT_THREADS);
+	return stress_set_setting("keysort-threads", TYPE_ID_UINT32, &keysort_threads);
+}
+
+static int stress_set_keysort_method(const char *opt);
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_keysort_method,	stress_set_keysort_method },
+	{ OPT_keysort_size,	stress_set_keysort_size },
+	{ OPT_keysort_threads,	stress_set_keysort_threads },
+	{ 0,			NULL }
+};
+
+typedef struct {
+	const stress_args_t *args;
+	int32_t *keys32;	/* 32 bit keys to sort, n_pad keys */
+	int32_t *tmp32;		/* 32 bit scratch, n_pad keys */
+	uint64_t *keys64;	/* 64 bit keys to sort */
+	uint64_t *tmp64;	/* 64 bit scratch */
+	size_t n;		/* number of keys */
+	size_t n_pad;		/* n rounded up to a multiple of KEYSORT_BLOCK */
+	uint32_t threads;	/* samplesort threads */
+	int32_t *splitters;	/* samplesort bucket splitters */
+	size_t *counts;		/* samplesort per thread bucket counts */
+	size_t *offsets;	/* samplesort per thread bucket offsets */
+	size_t *starts;		/* samplesort bucket starts */
+} stress_keysort_context_t;
+
+typedef struct {
+	const char *name;				/* method name */
+	bool (*supported)(void);			/* true if the CPU can run it */
+	void (*sort)(stress_keysort_context_t *ctxt);	/* sort the keys in place */
+	const bool keys64;				/* true if it sorts the 64 bit keys */
+} stress_keysort_method_t;
+
+static bool stress_keysort_supported(void)
+{
+	return true;
+}
+
+static void stress_keysort_libc(stress_keysort_context_t *ctxt)
+{
+	qsort(ctxt->keys32, ctxt->n, sizeof(*ctxt->keys32), stress_sort_cmp_fwd_int32);
+}
+
+/*
+ *  stress_keysort_radix32()
+ *	LSD radix sort of n signed 32 bit keys, 8 bits per pass, all the
+ *	digit histograms are counted in one pass and passes where every
+ *	key has the same digit are skipped, the scatter prefetches the
+ *	bucket slot of the key KEYSORT_PREFETCH keys ahead, returns
+ *	keys or tmp, whichever holds the sorted keys
+ */
+static int32_t * OPTIMIZE3 stress_keysort_radix32(int32_t *keys, int32_t *tmp, const size_t n)
+{
+	size_t hist[4][KEYSORT_RADIX];
+	int32_t *src = keys, *dst = tmp;
+	register size_t i;
+	int pass;
+
+	(void)memset(hist, 0, sizeof(hist));
+	for (i = 0; i < n; i++) {
+		register const uint32_t u = (uint32_t)keys[i] ^ KEYSORT_SIGN;
+
+		hist[0][u & 0xff]++;
+		hist[1][(u >> 8) & 0xff]++;
+		hist[2][(u >> 16) & 0xff]++;
+		hist[3][u >> 24]++;
+	}
+
+	for (pass = 0; pass < 4; pass++) {
+		const int shift = pass * 8;
+		size_t offsets[KEYSORT_RADIX], sum = 0;
+		int32_t *swap;
+
+		if (hist[pass][(((uint32_t)src[0] ^ KEYSORT_SIGN) >> shift) & 0xff] == n)
+			continue;
+		for (i = 0; i < KEYSORT_RADIX; i++) {
+			offsets[i] = sum;
+			sum += hist[pass][i];
+		}
+		for (i = 0; i < n; i++) {
+			register const int32_t key = src[i];
+
+			if (LIKELY(i + KEYSORT_PREFETCH < n))
+				shim_builtin_prefetch(dst + offsets[(((uint32_t)src[i + KEYSORT_PREFETCH] ^
+					KEYSORT_SIGN) >> shift) & 0xff], 1);
+			dst[offsets[(((uint32_t)key ^ KEYSORT_SIGN) >> shift) & 0xff]++] = key;
+		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	return src;
+}
+
+static void stress_keysort_radix32_sort(stress_keysort_context_t *ctxt)
+{
+	const int32_t *sorted = stress_keysort_radix32(ctxt->keys32, ctxt->tmp32, ctxt->n);
+
+	if (sorted != ctxt->keys32)
+		(void)memcpy(ctxt->keys32, sorted, ctxt->n * sizeof(*ctxt->keys32));
+}
+
+/*
+ *  stress_keysort_radix64()
+ *	LSD radix sort of the unsigned 64 bit keys, as radix32
+ *	but with 8 passes
+ */
+static void OPTIMIZE3 stress_keysort_radix64(stress_keysort_context_t *ctxt)
+{
+	size_t hist[8][KEYSORT_RADIX];
+	const size_t n = ctxt->n;
+	uint64_t *src = ctxt->keys64, *dst = ctxt->tmp64;
+	register size_t i;
+	int pass;
+
+	(void)memset(hist, 0, sizeof(hist));
+	for (i = 0; i < n; i++) {
+		register const uint64_t u = src[i];
+
+		hist[0][u & 0xff]++;
+		hist[1][(u >> 8) & 0xff]++;
+		hist[2][(u >> 16) & 0xff]++;
+		hist[3][(u >> 24) & 0xff]++;
+		hist[4][(u >> 32) & 0xff]++;
+		hist[5][(u >> 40) & 0xff]++;
+		hist[6][(u >> 48) & 0xff]++;
+		hist[7][u >> 56]++;
+	}
+
+	for (pass = 0; pass < 8; pass++) {
+		const int shift = pass * 8;
+		size_t offsets[KEYSORT_RADIX], sum = 0;
+		uint64_t *swap;
+
+		if (hist[pass][(src[0] >> shift) & 0xff] == n)
+			continue;
+		for (i = 0; i < KEYSORT_RADIX; i++) {
+			offsets[i] = sum;
+			sum += hist[pass][i];
+		}
+		for (i = 0; i < n; i++) {
+			register const uint64_t key = src[i];
+
+			if (LIKELY(i + KEYSORT_PREFETCH < n))
+				shim_builtin_prefetch(dst + offsets[(src[i + KEYSORT_PREFETCH] >> shift) & 0xff], 1);
+			dst[offsets[(key >> shift) & 0xff]++] = key;
+		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != ctxt->keys64)
+		(void)memcpy(ctxt->keys64, src, n * sizeof(*ctxt->keys64));
+}
+
+#if defined(STRESS_KEYSORT_HAVE_X86_VEC)
+/*
+ *  Bitonic sorts, blocks of W x W keys are sorted down the W lanes of
+ *  W vector registers by a bitonic sorting network and transposed to
+ *  W sorted runs, the runs are then merged bottom up, each merge step
+ *  takes the next W keys from the run with the smaller next key and
+ *  bitonic merges them in registers with the W largest keys so far,
+ *  the keys are padded to a multiple of KEYSORT_BLOCK with INT32_MAX
+ */
+static inline __m256i __attribute__((target("avx2"))) stress_keysort_reverse_avx2(const __m256i v)
+{
+	return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+/*
+ *  stress_keysort_clean_avx2()
+ *	sort a bitonic vector, compare exchange lanes 4, 2 then 1 apart
+ */
+static inline __m256i __attribute__((target("avx2"))) stress_keysort_clean_avx2(__m256i v)
+{
+	__m256i p;
+
+	p = _mm256_permute2x128_si256(v, v, 0x01);
+	v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xf0);
+	p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xcc);
+	p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xaa);
+	return v;
+}
+
+static inline __m512i __attribute__((target("avx512f"))) stress_keysort_reverse_avx512(const __m512i v)
+{
+	return _mm512_permutexvar_epi32(_mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0), v);
+}
+
+/*
+ *  stress_keysort_clean_avx512()
+ *	sort a bitonic vector, compare exchange lanes 8, 4, 2 then 1 apart
+ */
+static inline __m512i __attribute__((target("avx512f"))) stress_keysort_clean_avx512(__m512i v)
+{
+	__m512i p;
+
+	p = _mm512_shuffle_i32x4(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+	v = _mm512_mask_blend_epi32(0xff00, _mm512_min_epi32(v, p), _mm512_max_epi32(v, p));
+	p = _mm512_shuffle_i32x4(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm512_mask_blend_epi32(0xf0f0, _mm512_min_epi32(v, p), _mm512_max_epi32(v, p));
+	p = _mm512_shuffle_epi32(v, (_MM_PERM_ENUM)_MM_SHUFFLE(1, 0, 3, 2));
+	v = _mm512_mask_blend_epi32(0xcccc, _mm512_min_epi32(v, p), _mm512_max_epi32(v, p));
+	p = _mm512_shuffle_epi32(v, (_MM_PERM_ENUM)_MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm512_mask_blend_epi32(0xaaaa, _mm512_min_epi32(v, p), _mm512_max_epi32(v, p));
+	return v;
+}
+
+static inline __m256i __attribute__((target("avx2"))) stress_keysort_loadu_avx2(const int32_t *p)
+{
+	return _mm256_loadu_si256((const __m256i *)p);
+}
+
+static inline void __attribute__((target("avx2"))) stress_keysort_storeu_avx2(int32_t *p, const __m256i v)
+{
+	_mm256_storeu_si256((__m256i *)p, v);
+}
+
+static inline __m512i __attribute__((target("avx512f"))) stress_keysort_loadu_avx512(const int32_t *p)
+{
+	return _mm512_loadu_si512((const void *)p);
+}
+
+static inline void __attribute__((target("avx512f"))) stress_keysort_storeu_avx512(int32_t *p, const __m512i v)
+{
+	_mm512_storeu_si512((void *)p, v);
+}
+
+#define STRESS_KEYSORT_BITONIC(sfx, isa, W, vtype, vmin, vmax)			\
+static void OPTIMIZE3 __attribute__((target(isa))) stress_keysort_block_ ## sfx(int32_t *keys)	\
+{										\
+	vtype r[W];								\
+	int32_t lanes[W][W];							\
+	size_t i, j, k;								\
+										\
+	for (i = 0; i < W; i++)							\
+		r[i] = stress_keysort_loadu_ ## sfx(keys + (i * W));		\
+	for (k = 2; k <= W; k <<= 1) {						\
+		for (j = k >> 1; j > 0; j >>= 1) {				\
+			for (i = 0; i < W; i++) {				\
+				const size_t l = i ^ j;				\
+				vtype lo, hi;					\
+										\
+				if (l < i)					\
+					continue;				\
+				lo = vmin(r[i], r[l]);				\
+				hi = vmax(r[i], r[l]);				\
+				r[i] = (i & k) ? hi : lo;			\
+				r[l] = (i & k) ? lo : hi;			\
+			}							\
+		}								\
+	}									\
+	/* each lane is sorted down the registers, transpose to runs */	\
+	for (i = 0; i < W; i++)							\
+		stress_keysort_storeu_ ## sfx(lanes[i], r[i]);			\
+	for (i = 0; i < W; i++) {						\
+		for (j = 0; j < W; j++)						\
+			keys[(j * W) + i] = lanes[i][j];			\
+	}									\
+}										\
+										\
+static void OPTIMIZE3 __attribute__((target(isa))) stress_keysort_merge_ ## sfx(	\
+	const int32_t *a,							\
+	const size_t na,							\
+	const int32_t *b,							\
+	const size_t nb,							\
+	int32_t *out)								\
+{										\
+	vtype va = stress_keysort_loadu_ ## sfx(a);				\
+	vtype vb = stress_keysort_loadu_ ## sfx(b);				\
+	size_t ia = W, ib = W;							\
+										\
+	for (;;) {								\
+		const vtype rb = stress_keysort_reverse_ ## sfx(vb);		\
+										\
+		stress_keysort_storeu_ ## sfx(out,				\
+			stress_keysort_clean_ ## sfx(vmin(va, rb)));		\
+		va = stress_keysort_clean_ ## sfx(vmax(va, rb));		\
+		out += W;							\
+		if ((ia < na) && ((ib >= nb) || (a[ia] < b[ib]))) {		\
+			vb = stress_keysort_loadu_ ## sfx(a + ia);		\
+			ia += W;						\
+		} else if (ib < nb) {						\
+			vb = stress_keysort_loadu_ ## sfx(b + ib);		\
+			ib += W;						\
+		} else {							\
+			break;							\
+		}								\
+	}									\
+	stress_keysort_storeu_ ## sfx(out, va);					\
+}										\
+										\
+static void stress_keysort_bitonic_ ## sfx(stress_keysort_context_t *ctxt)	\
+{										\
+	const size_t n_pad = ctxt->n_pad;					\
+	int32_t *src = ctxt->keys32, *dst = ctxt->tmp32, *swap;			\
+	size_t i, run;								\
+										\
+	for (i = 0; i < n_pad; i += W * W)					\
+		stress_keysort_block_ ## sfx(src + i);				\
+	for (run = W; run < n_pad; run <<= 1) {					\
+		for (i = 0; i < n_pad; i += run << 1) {				\
+			const size_t na = STRESS_MINIMUM(run, n_pad - i);	\
+			const size_t nb = STRESS_MINIMUM(run, n_pad - i - na);	\
+										\
+			if (nb)							\
+				stress_keysort_merge_ ## sfx(src + i, na,	\
+					src + i + na, nb, dst + i);		\
+			else							\
+				(void)memcpy(dst + i, src + i, na * sizeof(*src));	\
+		}								\
+		swap = src;							\
+		src = dst;							\
+		dst = swap;							\
+	}									\
+	if (src != ctxt->keys32)						\
+		(void)memcpy(ctxt->keys32, src, n_pad * sizeof(*src));		\
+}
+
+STRESS_KEYSORT_BITONIC(avx2, "avx2", 8, __m256i, _mm256_min_epi32, _mm256_max_epi32)
+STRESS_KEYSORT_BITONIC(avx512, "avx512f", 16, __m512i, _mm512_min_epi32, _mm512_max_epi32)
+
+static bool stress_keysort_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static bool stress_keysort_has_avx512(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  Parallel samplesort, T threads, T - 1 splitters are picked from a
+ *  sorted random sample, each thread counts its share of the keys
+ *  into the T buckets, the counts give each thread its own slots in
+ *  each bucket so the scatter needs no locks, then each thread radix
+ *  sorts one bucket
+ */
+typedef struct {
+	stress_keysort_context_t *ctxt;	/* shared context */
+	pthread_t pthread;		/* thread handle */
+	int ret;			/* pthread_create return */
+	uint32_t id;			/* thread and bucket number */
+	int phase;			/* phase to run */
+} stress_keysort_thread_t;
+
+#define KEYSORT_PHASE_COUNT	(0)
+#define KEYSORT_PHASE_SCATTER	(1)
+#define KEYSORT_PHASE_SORT	(2)
+
+/*
+ *  stress_keysort_bucket()
+ *	number of splitters <= key, a branchless binary search
+ */
+static inline size_t OPTIMIZE3 stress_keysort_bucket(const int32_t *splitters, const size_t n, const int32_t key)
+{
+	register const int32_t *base = splitters;
+	register size_t len = n;
+
+	if (!len)
+		return 0;
+	while (len > 1) {
+		const size_t half = len >> 1;
+
+		base = (base[half - 1] <= key) ? base + half : base;
+		len -= half;
+	}
+	return (size_t)(base - splitters) + (*base <= key);
+}
+
+static void OPTIMIZE3 stress_keysort_phase(stress_keysort_thread_t *thread)
+{
+	stress_keysort_context_t *ctxt = thread->ctxt;
+	const size_t t = ctxt->threads, id = thread->id;
+	const size_t lo = (ctxt->n * id) / t, hi = (ctxt->n * (id + 1)) / t;
+	const int32_t *keys = ctxt->keys32;
+	size_t i;
+
+	switch (thread->phase) {
+	case KEYSORT_PHASE_COUNT:
+		for (i = lo; i < hi; i++)
+			ctxt->counts[(id * t) + stress_keysort_bucket(ctxt->splitters, t - 1, keys[i])]++;
+		break;
+	case KEYSORT_PHASE_SCATTER:
+		for (i = lo; i < hi; i++) {
+			const size_t b = stress_keysort_bucket(ctxt->splitters, t - 1, keys[i]);
+
+			ctxt->tmp32[ctxt->offsets[(id * t) + b]++] = keys[i];
+		}
+		break;
+	default: {
+			const size_t start = ctxt->starts[id];
+			const size_t len = ctxt->starts[id + 1] - start;
+			const int32_t *sorted;
+
+			if (!len)
+				break;
+			sorted = stress_keysort_radix32(ctxt->tmp32 + start, ctxt->keys32 + start, len);
+			if (sorted != ctxt->keys32 + start)
+				(void)memcpy(ctxt->keys32 + start, sorted, len * sizeof(*sorted));
+		}
+		break;
+	}
+}
+
+static void *stress_keysort_func(void *arg)
+{
+	static void *nowt = NULL;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+	stress_keysort_phase((stress_keysort_thread_t *)arg);
+
+	return &nowt;
+}
+
+/*
+ *  stress_keysort_run_phase()
+ *	run a phase on all the threads, a thread that cannot be
+ *	created has its share run inline
+ */
+static void stress_keysort_run_phase(stress_keysort_thread_t *threads, const uint32_t n, const int phase)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		threads[i].phase = phase;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_keysort_func, (void *)&threads[i]);
+		if (threads[i].ret)
+			stress_keysort_phase(&threads[i]);
+	}
+	for (i = 0; i < n; i++) {
+		if (!threads[i].ret)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+}
+
+static void stress_keysort_samplesort(stress_keysort_context_t *ctxt)
+{
+	stress_keysort_thread_t threads[MAX_KEYSORT_THREADS];
+	const size_t t = ctxt->threads, n_samples = t * KEYSORT_OVERSAMPLE;
+	int32_t *samples = ctxt->tmp32;
+	size_t i, b, pos;
+
+	if (t < 2) {
+		stress_keysort_radix32_sort(ctxt);
+		return;
+	}
+
+	/* the scratch keys are free until the scatter, sample into them */
+	for (i = 0; i < n_samples; i++)
+		samples[i] = ctxt->keys32[stress_mwc32modn((uint32_t)ctxt->n)];
+	qsort(samples, n_samples, sizeof(*samples), stress_sort_cmp_fwd_int32);
+	for (i = 0; i < t - 1; i++)
+		ctxt->splitters[i] = samples[(i + 1) * KEYSORT_OVERSAMPLE];
+
+	for (i = 0; i < t; i++) {
+		threads[i].ctxt = ctxt;
+		threads[i].id = (uint32_t)i;
+	}
+	(void)memset(ctxt->counts, 0, t * t * sizeof(*ctxt->counts));
+	stress_keysort_run_phase(threads, (uint32_t)t, KEYSORT_PHASE_COUNT);
+
+	for (pos = 0, b = 0; b < t; b++) {
+		ctxt->starts[b] = pos;
+		for (i = 0; i < t; i++) {
+			ctxt->offsets[(i * t) + b] = pos;
+			pos += ctxt->counts[(i * t) + b];
+		}
+	}
+	ctxt->starts[t] = pos;
+
+	stress_keysort_run_phase(threads, (uint32_t)t, KEYSORT_PHASE_SCATTER);
+	stress_keysort_run_phase(threads, (uint32_t)t, KEYSORT_PHASE_SORT);
+}
+#endif
+
+static const stress_keysort_method_t keysort_methods[] = {
+	{ "libc",		stress_keysort_supported,	stress_keysort_libc,		false },
+	{ "radix32",		stress_keysort_supported,	stress_keysort_radix32_sort,	false },
+	{ "radix64",		stress_keysort_supported,	stress_keysort_radix64,		true },
+#if defined(STRESS_KEYSORT_HAVE_X86_VEC)
+	{ "bitonic-avx2",	stress_keysort_has_avx2,	stress_keysort_bitonic_avx2,	false },
+	{ "bitonic-avx512",	stress_keysort_has_avx512,	stress_keysort_bitonic_avx512,	false },
+#endif
+#if defined(HAVE_LIB_PTHREAD)
+	{ "samplesort",		stress_keysort_supported,	stress_keysort_samplesort,	false },
+#endif
+};
+
+#define KEYSORT_METHODS	(SIZEOF_ARRAY(keysort_methods))
+
+static int stress_set_keysort_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = KEYSORT_METHODS;
+		return stress_set_setting("keysort-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < KEYSORT_METHODS; i++) {
+		if (!strcmp(opt, keysort_methods[i].name))
+			return stress_set_setting("keysort-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "keysort-method must be one of: all");
+	for (i = 0; i < KEYSORT_METHODS; i++)
+		(void)fprintf(stderr, " %s", keysort_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_keysort_verify()
+ *	check the keys are in order and that the key sum is unchanged
+ */
+static bool stress_keysort_verify(
+	const stress_args_t *args,
+	const stress_keysort_method_t *method,
+	const stress_keysort_context_t *ctxt,
+	const uint64_t sum)
+{
+	uint64_t check = 0;
+	size_t i;
+
+	if (method->keys64) {
+		for (i = 0; i < ctxt->n; i++) {
+			if ((i > 0) && (ctxt->keys64[i - 1] > ctxt->keys64[i]))
+				goto fail;
+			check += ctxt->keys64[i];
+		}
+	} else {
+		for (i = 0; i < ctxt->n; i++) {
+			if ((i > 0) && (ctxt->keys32[i - 1] > ctxt->keys32[i]))
+				goto fail;
+			check += (uint64_t)(uint32_t)ctxt->keys32[i];
+		}
+	}
+	if (check == sum)
+		return true;
+	pr_fail("%s: %s sort changed the keys, sum 0x%" PRIx64 ", expected 0x%" PRIx64 "\n",
+		args->name, method->name, check, sum);
+	return false;
+fail:
+	pr_fail("%s: %s sort error detected, incorrect ordering found at key %zu\n",
+		args->name, method->name, i);
+	return false;
+}
+
+/*
+ *  stress_keysort()
+ *	sort fresh random keys with each method each bogo op
+ *	and report the keys sorted per second for each method
+ */
+static int stress_keysort(const stress_args_t *args)
+{
+	uint64_t keysort_size = DEFAULT_KEYSORT_SIZE;
+	uint32_t keysort_threads = (uint32_t)stress_get_processors_online();
+	size_t keysort_method = KEYSORT_METHODS;
+	stress_keysort_context_t ctxt;
+	double durations[KEYSORT_METHODS], keys[KEYSORT_METHODS];
+	int32_t *orig32;
+	uint64_t *orig64, sum32, sum64;
+	size_t i, m, n;
+	int rc = EXIT_SUCCESS;
+
+	if (!stress_get_setting("keysort-size", &keysort_size)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			keysort_size = MAX_KEYSORT_SIZE;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			keysort_size = MIN_KEYSORT_SIZE;
+	}
+	(void)stress_get_setting("keysort-method", &keysort_method);
+	(void)stress_get_setting("keysort-threads", &keysort_threads);
+	if (keysort_threads < MIN_KEYSORT_THREADS)
+		keysort_threads = MIN_KEYSORT_THREADS;
+	if (keysort_threads > MAX_KEYSORT_THREADS)
+		keysort_threads = MAX_KEYSORT_THREADS;
+
+	if ((keysort_method < KEYSORT_METHODS) &&
+	    !keysort_methods[keysort_method].supported()) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s is not supported by this CPU, skipping stressor\n",
+				args->name, keysort_methods[keysort_method].name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	n = (size_t)keysort_size;
+	(void)memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.args = args;
+	ctxt.n = n;
+	ctxt.n_pad = (n + KEYSORT_BLOCK - 1) & ~(size_t)(KEYSORT_BLOCK - 1);
+	/* samples must fit in the scratch keys */
+	ctxt.threads = (uint32_t)STRESS_MINIMUM((size_t)keysort_threads, n / KEYSORT_OVERSAMPLE);
+
+	orig32 = calloc(n, sizeof(*orig32));
+	orig64 = calloc(n, sizeof(*orig64));
+	ctxt.keys32 = calloc(ctxt.n_pad, sizeof(*ctxt.keys32));
+	ctxt.tmp32 = calloc(ctxt.n_pad, sizeof(*ctxt.tmp32));
+	ctxt.keys64 = calloc(n, sizeof(*ctxt.keys64));
+	ctxt.tmp64 = calloc(n, sizeof(*ctxt.tmp64));
+	ctxt.splitters = calloc(ctxt.threads, sizeof(*ctxt.splitters));
+	ctxt.counts = calloc((size_t)ctxt.threads * ctxt.threads, sizeof(*ctxt.counts));
+	ctxt.offsets = calloc((size_t)ctxt.threads * ctxt.threads, sizeof(*ctxt.offsets));
+	ctxt.starts = calloc((size_t)ctxt.threads + 1, sizeof(*ctxt.starts));
+	if (!orig32 || !orig64 || !ctxt.keys32 || !ctxt.tmp32 || !ctxt.keys64 ||
+	    !ctxt.tmp64 || !ctxt.splitters || !ctxt.counts || !ctxt.offsets || !ctxt.starts) {
+		pr_inf_skip("%s: cannot allocate %zu keys, skipping stressor\n",
+			args->name, n);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+
+	for (m = 0; m < KEYSORT_METHODS; m++) {
+		durations[m] = 0.0;
+		keys[m] = 0.0;
+	}
+	if ((args->instance == 0) && (args->num_instances > 1) && (ctxt.threads > 1))
+		pr_inf("%s: %" PRIu32 " instances each running %" PRIu32
+			" samplesort threads will oversubscribe the CPUs, try 1 instance\n",
+			args->name, args->num_instances, ctxt.threads);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (sum32 = 0, sum64 = 0, i = 0; i < n; i++) {
+			orig32[i] = (int32_t)stress_mwc32();
+			orig64[i] = stress_mwc64();
+			sum32 += (uint64_t)(uint32_t)orig32[i];
+			sum64 += orig64[i];
+		}
+
+		for (m = 0; m < KEYSORT_METHODS; m++) {
+			const stress_keysort_method_t *method = &keysort_methods[m];
+			double t;
+
+			if ((keysort_method < KEYSORT_METHODS) && (keysort_method != m))
+				continue;
+			if (!method->supported())
+				continue;
+
+			if (method->keys64) {
+				(void)memcpy(ctxt.keys64, orig64, n * sizeof(*orig64));
+			} else {
+				(void)memcpy(ctxt.keys32, orig32, n * sizeof(*orig32));
+				for (i = n; i < ctxt.n_pad; i++)
+					ctxt.keys32[i] = INT32_MAX;
+			}
+			t = stress_time_now();
+			method->sort(&ctxt);
+			durations[m] += stress_time_now() - t;
+			keys[m] += (double)n;
+
+			if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+			    !stress_keysort_verify(args, method, &ctxt, method->keys64 ? sum64 : sum32)) {
+				rc = EXIT_FAILURE;
+				break;
+			}
+			if (!keep_stressing(args))
+				break;
+		}
+		inc_counter(args);
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (m = 0, i = 0; m < KEYSORT_METHODS; m++) {
+		char str[64];
+
+		if (durations[m] <= 0.0)
+			continue;
+		(void)snprintf(str, sizeof(str), "%s keys sorted per sec", keysort_methods[m].name);
+		stress_metrics_set(args, i++, str, keys[m] / durations[m]);
+#if defined(HAVE_LIB_PTHREAD)
+		if (keysort_methods[m].sort == stress_keysort_samplesort) {
+			(void)snprintf(str, sizeof(str), "%s keys sorted per sec per thread",
+				keysort_methods[m].name);
+			stress_metrics_set(args, i++, str,
+				keys[m] / (durations[m] * (double)STRESS_MAXIMUM(ctxt.threads, 1)));
+		}
+#endif
+	}
+
+tidy:
+	free(ctxt.starts);
+	free(ctxt.offsets);
+	free(ctxt.counts);
+	free(ctxt.splitters);
+	free(ctxt.tmp64);
+	free(ctxt.keys64);
+	free(ctxt.tmp32);
+	free(ctxt.keys32);
+	free(orig64);
+	free(orig32);
+
+	return rc;
+}
+
+stressor_info_t stress_keysort_info = {
+	.stressor = stress_keysort,
+	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
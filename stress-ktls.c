@@ -0,0 +1,659 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-perf.h"
+
+#if defined(HAVE_LINUX_TLS_H)
+#include <linux/tls.h>
+#endif
+
+#if defined(HAVE_NETINET_TCP_H)
+#include <netinet/tcp.h>
+#else
+UNEXPECTED
+#endif
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#if !defined(SOL_TLS)
+#define SOL_TLS			(282)
+#endif
+
+#if !defined(TCP_ULP)
+#define TCP_ULP			(31)
+#endif
+
+#define KTLS_MODE_SEND		(0)	/* send() from a user buffer */
+#define KTLS_MODE_SENDFILE	(1)	/* sendfile() from the page cache */
+#define KTLS_MODE_SPLICE	(2)	/* splice() file -> pipe -> socket */
+#define KTLS_MODE_MAX		(3)
+#define KTLS_MODE_ALL		(-1)
+
+#define KTLS_PLAIN		(0)
+#define KTLS_TLS		(1)
+
+#define MIN_KTLS_BYTES		(1 * MB)
+#define MAX_KTLS_BYTES		(4ULL * GB)
+#define DEFAULT_KTLS_BYTES	(64 * MB)
+
+#define KTLS_PATTERN_SIZE	(1 * MB)	/* size of the file and send data pattern */
+#define KTLS_CHUNK		(64 * KB)	/* maximum bytes per send or receive call */
+#define KTLS_IDLE_MAX		(50)		/* 100ms polls without progress before giving up */
+
+static const stress_help_t help[] = {
+	{ NULL,	"ktls N",	"start N workers measuring kernel TLS socket throughput" },
+	{ NULL,	"ktls-bytes N",	"number of bytes to transfer per mode per round" },
+	{ NULL,	"ktls-mode M",	"select mode [ all | send | sendfile | splice ]" },
+	{ NULL,	"ktls-ops N",	"stop after N ktls rounds" },
+	{ NULL,	NULL,		NULL }
+};
+
+static const char * const ktls_modes[KTLS_MODE_MAX] = {
+	"send",
+	"sendfile",
+	"splice",
+};
+
+static int stress_set_ktls_bytes(const char *opt)
+{
+	uint64_t ktls_bytes;
+
+	ktls_bytes = stress_get_uint64_byte(opt);
+	stress_check_range_bytes("ktls-bytes", ktls_bytes,
+		MIN_KTLS_BYTES, MAX_KTLS_BYTES);
+	return stress_set_setting("ktls-bytes", TYPE_ID_UINT64, &ktls_bytes);
+}
+
+static int stress_set_ktls_mode(const char *opt)
+{
+	int i;
+
+	if (!strcmp(opt, "all")) {
+		i = KTLS_MODE_ALL;
+		return stress_set_setting("ktls-mode", TYPE_ID_INT, &i);
+	}
+	for (i = 0; i < KTLS_MODE_MAX; i++) {
+		if (!strcmp(opt, ktls_modes[i]))
+			return stress_set_setting("ktls-mode", TYPE_ID_INT, &i);
+	}
+	(void)fprintf(stderr, "ktls-mode must be one of: all");
+	for (i = 0; i < KTLS_MODE_MAX; i++)
+		(void)fprintf(stderr, " %s", ktls_modes[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_ktls_bytes,	stress_set_ktls_bytes },
+	{ OPT_ktls_mode,	stress_set_ktls_mode },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LINUX_TLS_H) &&	\
+    defined(TLS_TX) &&			\
+    defined(TLS_RX) &&			\
+    defined(TLS_1_2_VERSION) &&		\
+    defined(TLS_CIPHER_AES_GCM_128) &&	\
+    defined(HAVE_SYS_SENDFILE_H) &&	\
+    defined(HAVE_SENDFILE) &&		\
+    defined(HAVE_SPLICE) &&		\
+    defined(HAVE_POLL_H)
+
+/* throughput of one mode, plaintext or kTLS */
+typedef struct {
+	double duration;		/* seconds */
+	double bytes;			/* bytes transferred */
+	double cycles;			/* CPU cycles */
+} stress_ktls_result_t;
+
+/*
+ *  stress_ktls_stat()
+ *	read a counter from /proc/net/tls_stat, returns false
+ *	if it cannot be read
+ */
+static bool stress_ktls_stat(const char *name, uint64_t *value)
+{
+	FILE *fp;
+	char buf[128];
+	const size_t len = strlen(name);
+	bool found = false;
+
+	fp = fopen("/proc/net/tls_stat", "r");
+	if (!fp)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (!strncmp(buf, name, len) && isspace((int)buf[len])) {
+			found = (sscanf(buf + len, "%" SCNu64, value) == 1);
+			break;
+		}
+	}
+	(void)fclose(fp);
+
+	return found;
+}
+
+/*
+ *  stress_ktls_connect()
+ *	create a connected non-blocking loopback TCP pair,
+ *	fds[0] is the sender and fds[1] the receiver
+ */
+static int stress_ktls_connect(int fds[2])
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int lfd, saved_errno;
+
+	fds[0] = -1;
+	fds[1] = -1;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0)
+		return -1;
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (bind(lfd, (struct sockaddr *)&addr, len) < 0)
+		goto err;
+	if (listen(lfd, 1) < 0)
+		goto err;
+	if (getsockname(lfd, (struct sockaddr *)&addr, &len) < 0)
+		goto err;
+	fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+	if (fds[0] < 0)
+		goto err;
+	if (connect(fds[0], (struct sockaddr *)&addr, len) < 0)
+		goto err;
+	fds[1] = accept(lfd, NULL, NULL);
+	if (fds[1] < 0)
+		goto err;
+	if ((stress_set_nonblock(fds[0]) < 0) ||
+	    (stress_set_nonblock(fds[1]) < 0))
+		goto err;
+	(void)close(lfd);
+	return 0;
+err:
+	saved_errno = errno;
+	if (fds[0] >= 0)
+		(void)close(fds[0]);
+	if (fds[1] >= 0)
+		(void)close(fds[1]);
+	fds[0] = -1;
+	fds[1] = -1;
+	(void)close(lfd);
+	errno = saved_errno;
+	return -1;
+}
+
+/*
+ *  stress_ktls_enable()
+ *	attach the tls ULP to fd and set the transmit (TLS_TX) or
+ *	receive (TLS_RX) AES-GCM-128 keys
+ */
+static int stress_ktls_enable(
+	const int fd,
+	const int dir,
+	const struct tls12_crypto_info_aes_gcm_128 *info)
+{
+	if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0)
+		return -1;
+	return setsockopt(fd, SOL_TLS, dir, info, sizeof(*info));
+}
+
+/*
+ *  stress_ktls_verify()
+ *	check len received bytes at stream offset pos match the pattern
+ */
+static bool stress_ktls_verify(
+	const uint8_t *pattern,
+	const uint8_t *buf,
+	size_t len,
+	const uint64_t pos)
+{
+	size_t off = (size_t)(pos % KTLS_PATTERN_SIZE);
+
+	while (len > 0) {
+		const size_t n = STRESS_MINIMUM(len, KTLS_PATTERN_SIZE - off);
+
+		if (memcmp(pattern + off, buf, n))
+			return false;
+		buf += n;
+		len -= n;
+		off = 0;
+	}
+	return true;
+}
+
+/*
+ *  stress_ktls_transfer()
+ *	send total bytes on fds[0] using the given mode and receive
+ *	them on fds[1]; both sockets are non-blocking so the sender
+ *	fills the socket buffers and the receiver drains them in turn.
+ *	Returns the number of bytes received or -1 on error.
+ */
+static int64_t stress_ktls_transfer(
+	const stress_args_t *args,
+	const int mode,
+	const int fds[2],
+	const int file_fd,
+	const int pipe_fds[2],
+	const uint8_t *pattern,
+	uint8_t *buf,
+	const uint64_t total,
+	const bool verify)
+{
+	uint64_t sent = 0, rcvd = 0;
+	size_t in_pipe = 0;
+	int idle = 0;
+
+	while (rcvd < total) {
+		bool progress = false;
+
+		if (UNLIKELY(!keep_stressing_flag()))
+			break;
+
+		while (sent < total) {
+			const size_t off = (size_t)(sent % KTLS_PATTERN_SIZE);
+			const size_t len = (size_t)STRESS_MINIMUM(total - sent,
+				(uint64_t)STRESS_MINIMUM(KTLS_CHUNK, KTLS_PATTERN_SIZE - off));
+			ssize_t n;
+			off_t offset;
+			loff_t loffset;
+
+			switch (mode) {
+			case KTLS_MODE_SEND:
+			default:
+				n = send(fds[0], pattern + off, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+				break;
+			case KTLS_MODE_SENDFILE:
+				offset = (off_t)off;
+				n = sendfile(fds[0], file_fd, &offset, len);
+				break;
+			case KTLS_MODE_SPLICE:
+				if (in_pipe == 0) {
+					loffset = (loff_t)off;
+					n = splice(file_fd, &loffset, pipe_fds[1], NULL, len, SPLICE_F_MOVE);
+					if (n <= 0) {
+						if (n == 0)
+							errno = EIO;
+						return -1;
+					}
+					in_pipe = (size_t)n;
+				}
+				n = splice(pipe_fds[0], NULL, fds[0], NULL, in_pipe,
+					SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+				if (n > 0)
+					in_pipe -= (size_t)n;
+				break;
+			}
+			if (n < 0) {
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+					break;
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			if (n == 0)
+				break;
+			sent += (uint64_t)n;
+			progress = true;
+		}
+
+		for (;;) {
+			const ssize_t n = recv(fds[1], buf, KTLS_CHUNK, MSG_DONTWAIT);
+
+			if (n < 0) {
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+					break;
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			if (n == 0) {
+				errno = ECONNRESET;
+				return -1;
+			}
+			if (verify && !stress_ktls_verify(pattern, buf, (size_t)n, rcvd)) {
+				pr_fail("%s: %s data received at offset %" PRIu64 " differs from data sent\n",
+					args->name, ktls_modes[mode], rcvd);
+				errno = 0;
+				return -1;
+			}
+			rcvd += (uint64_t)n;
+			progress = true;
+		}
+
+		if (progress) {
+			idle = 0;
+		} else {
+			struct pollfd pfds[2];
+
+			pfds[0].fd = fds[0];
+			pfds[0].events = (sent < total) ? POLLOUT : 0;
+			pfds[0].revents = 0;
+			pfds[1].fd = fds[1];
+			pfds[1].events = POLLIN;
+			pfds[1].revents = 0;
+			if ((poll(pfds, 2, 100) == 0) && (++idle > KTLS_IDLE_MAX)) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+		}
+	}
+	return (int64_t)rcvd;
+}
+
+/*
+ *  stress_ktls_report()
+ *	print a GB/s and cycles per byte table of plaintext vs
+ *	kTLS per mode and set the metrics
+ */
+static void stress_ktls_report(
+	const stress_args_t *args,
+	stress_ktls_result_t results[KTLS_MODE_MAX][2],
+	const bool has_cycles,
+	const bool offload)
+{
+	int m, idx = 0;
+
+	if (args->instance == 0) {
+		pr_inf("%s: %-8s %22s %22s %9s\n", args->name, "mode",
+			"plaintext", offload ? "kTLS (device)" : "kTLS (software)",
+			"kTLS cost");
+	}
+	for (m = 0; m < KTLS_MODE_MAX; m++) {
+		const stress_ktls_result_t *plain = &results[m][KTLS_PLAIN];
+		const stress_ktls_result_t *tls = &results[m][KTLS_TLS];
+		char str[64];
+		double plain_rate, tls_rate, plain_cpb, tls_cpb;
+
+		if ((plain->duration <= 0.0) && (tls->duration <= 0.0))
+			continue;
+
+		plain_rate = (plain->duration > 0.0) ? plain->bytes / plain->duration / (double)GB : 0.0;
+		tls_rate = (tls->duration > 0.0) ? tls->bytes / tls->duration / (double)GB : 0.0;
+		plain_cpb = (plain->bytes > 0.0) ? plain->cycles / plain->bytes : 0.0;
+		tls_cpb = (tls->bytes > 0.0) ? tls->cycles / tls->bytes : 0.0;
+
+		if (args->instance == 0) {
+			if (has_cycles && (plain_cpb > 0.0) && (tls_cpb > 0.0)) {
+				pr_inf("%s: %-8s %7.3f GB/s %5.2f c/B %7.3f GB/s %5.2f c/B %8.2fx\n",
+					args->name, ktls_modes[m],
+					plain_rate, plain_cpb, tls_rate, tls_cpb,
+					tls_cpb / plain_cpb);
+			} else {
+				pr_inf("%s: %-8s %7.3f GB/s %9s %7.3f GB/s %9s %9s\n",
+					args->name, ktls_modes[m],
+					plain_rate, "", tls_rate, "", "-");
+			}
+		}
+
+		(void)snprintf(str, sizeof(str), "GB per sec %s plaintext", ktls_modes[m]);
+		stress_metrics_set(args, idx++, str, plain_rate);
+		(void)snprintf(str, sizeof(str), "GB per sec %s kTLS", ktls_modes[m]);
+		stress_metrics_set(args, idx++, str, tls_rate);
+		if (has_cycles) {
+			(void)snprintf(str, sizeof(str), "cycles per byte %s plaintext", ktls_modes[m]);
+			stress_metrics_set(args, idx++, str, plain_cpb);
+			(void)snprintf(str, sizeof(str), "cycles per byte %s kTLS", ktls_modes[m]);
+			stress_metrics_set(args, idx++, str, tls_cpb);
+		}
+	}
+}
+
+/*
+ *  stress_ktls
+ *	measure plaintext vs kernel TLS throughput over a loopback
+ *	TCP connection using send, sendfile and splice
+ */
+static int stress_ktls(const stress_args_t *args)
+{
+	int mode_sel = KTLS_MODE_ALL, m, ret, perf_fd, rc = EXIT_SUCCESS;
+	int fds[2], pipe_fds[2], file_fd;
+	uint64_t ktls_bytes = DEFAULT_KTLS_BYTES, c0, dev0 = 0, dev1 = 0;
+	uint8_t *pattern, *buf;
+	char filename[PATH_MAX];
+	struct tls12_crypto_info_aes_gcm_128 info;
+	stress_ktls_result_t results[KTLS_MODE_MAX][2];
+	bool disabled[KTLS_MODE_MAX][2];
+	bool has_cycles, offload = false;
+	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+
+	(void)stress_get_setting("ktls-mode", &mode_sel);
+	if (!stress_get_setting("ktls-bytes", &ktls_bytes)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			ktls_bytes = MAX_KTLS_BYTES;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			ktls_bytes = MIN_KTLS_BYTES;
+	}
+
+	/* random preset keys, the same keys are used for transmit and receive */
+	(void)memset(&info, 0, sizeof(info));
+	info.info.version = TLS_1_2_VERSION;
+	info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+	stress_rndbuf(info.key, sizeof(info.key));
+	stress_rndbuf(info.iv, sizeof(info.iv));
+	stress_rndbuf(info.salt, sizeof(info.salt));
+
+	/* check the kernel supports the tls ULP before doing any setup */
+	if (stress_ktls_connect(fds) < 0) {
+		pr_inf_skip("%s: cannot create loopback TCP connection, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	(void)stress_ktls_stat("TlsTxDevice", &dev0);
+	if (stress_ktls_enable(fds[0], TLS_TX, &info) < 0) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: kernel TLS not available, errno=%d (%s), "
+				"skipping stressor\n", args->name, errno, strerror(errno));
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+	if (stress_ktls_stat("TlsTxDevice", &dev1) && (dev1 > dev0))
+		offload = true;
+	(void)close(fds[0]);
+	(void)close(fds[1]);
+	if (args->instance == 0)
+		pr_dbg("%s: kTLS transmit is using %s crypto\n", args->name,
+			offload ? "device offload" : "software");
+
+	pattern = (uint8_t *)mmap(NULL, KTLS_PATTERN_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pattern == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes, skipping stressor\n",
+			args->name, (size_t)KTLS_PATTERN_SIZE);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (uint8_t *)malloc(KTLS_CHUNK);
+	if (!buf) {
+		pr_inf_skip("%s: cannot allocate receive buffer, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_pattern;
+	}
+	stress_rndbuf(pattern, KTLS_PATTERN_SIZE);
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto tidy_buf;
+	}
+	(void)stress_temp_filename_args(args,
+		filename, sizeof(filename), stress_mwc32());
+	file_fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if (file_fd < 0) {
+		rc = stress_exit_status(errno);
+		pr_err("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto tidy_dir;
+	}
+	(void)shim_unlink(filename);
+	if (write(file_fd, pattern, KTLS_PATTERN_SIZE) != (ssize_t)KTLS_PATTERN_SIZE) {
+		pr_inf_skip("%s: cannot write %zu bytes to %s, skipping stressor\n",
+			args->name, (size_t)KTLS_PATTERN_SIZE, filename);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_file;
+	}
+	if (pipe(pipe_fds) < 0) {
+		pr_fail("%s: pipe failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto tidy_file;
+	}
+#if defined(F_SETPIPE_SZ)
+	(void)fcntl(pipe_fds[1], F_SETPIPE_SZ, KTLS_CHUNK);
+#endif
+
+	(void)memset(results, 0, sizeof(results));
+	(void)memset(disabled, 0, sizeof(disabled));
+	perf_fd = stress_perf_cycles_open();
+	has_cycles = stress_perf_cycles_read(perf_fd, &c0);
+	if ((args->instance == 0) && has_cycles && (perf_fd < 0))
+		pr_dbg("%s: CPU cycles counter not available, using the TSC\n", args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; m < KTLS_MODE_MAX; m++) {
+			int tls;
+
+			if ((mode_sel != KTLS_MODE_ALL) && (mode_sel != m))
+				continue;
+			for (tls = KTLS_PLAIN; keep_stressing_flag() && (tls <= KTLS_TLS); tls++) {
+				stress_ktls_result_t *r = &results[m][tls];
+				uint64_t c1 = 0;
+				int64_t rcvd;
+				double t;
+
+				if (disabled[m][tls])
+					continue;
+				if (stress_ktls_connect(fds) < 0) {
+					pr_fail("%s: cannot create loopback TCP connection, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+					rc = EXIT_FAILURE;
+					goto finish;
+				}
+				if ((tls == KTLS_TLS) &&
+				    ((stress_ktls_enable(fds[0], TLS_TX, &info) < 0) ||
+				     (stress_ktls_enable(fds[1], TLS_RX, &info) < 0))) {
+					pr_fail("%s: cannot enable kTLS, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+					(void)close(fds[0]);
+					(void)close(fds[1]);
+					rc = EXIT_FAILURE;
+					goto finish;
+				}
+
+				(void)stress_perf_cycles_read(perf_fd, &c0);
+				t = stress_time_now();
+				rcvd = stress_ktls_transfer(args, m, fds, file_fd, pipe_fds,
+					pattern, buf, ktls_bytes, verify);
+				if (rcvd == (int64_t)ktls_bytes) {
+					r->duration += stress_time_now() - t;
+					(void)stress_perf_cycles_read(perf_fd, &c1);
+					r->cycles += (double)(c1 - c0);
+					r->bytes += (double)ktls_bytes;
+				} else if (rcvd < 0) {
+					if ((tls == KTLS_TLS) && (m != KTLS_MODE_SEND) &&
+					    ((errno == EINVAL) || (errno == EOPNOTSUPP))) {
+						if (args->instance == 0)
+							pr_inf("%s: %s not supported with kTLS, disabling it\n",
+								args->name, ktls_modes[m]);
+						disabled[m][tls] = true;
+					} else {
+						if (errno)
+							pr_fail("%s: %s %s transfer failed, errno=%d (%s)\n",
+								args->name, ktls_modes[m],
+								tls ? "kTLS" : "plaintext",
+								errno, strerror(errno));
+						rc = EXIT_FAILURE;
+					}
+				}
+				(void)close(fds[0]);
+				(void)close(fds[1]);
+
+				/* discard anything left in the pipe from an aborted splice */
+				if (m == KTLS_MODE_SPLICE) {
+					(void)close(pipe_fds[0]);
+					(void)close(pipe_fds[1]);
+					if (pipe(pipe_fds) < 0) {
+						pr_fail("%s: pipe failed, errno=%d (%s)\n",
+							args->name, errno, strerror(errno));
+						rc = EXIT_FAILURE;
+						goto finish_pipe;
+					}
+				}
+				if (rc != EXIT_SUCCESS)
+					goto finish;
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+finish:
+	(void)close(pipe_fds[0]);
+	(void)close(pipe_fds[1]);
+finish_pipe:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_ktls_report(args, results, has_cycles, offload);
+
+	if (perf_fd >= 0)
+		(void)close(perf_fd);
+tidy_file:
+	(void)close(file_fd);
+tidy_dir:
+	(void)stress_temp_dir_rm_args(args);
+tidy_buf:
+	free(buf);
+tidy_pattern:
+	(void)munmap((void *)pattern, KTLS_PATTERN_SIZE);
+
+	return rc;
+}
+
+stressor_info_t stress_ktls_info = {
+	.stressor = stress_ktls,
+	.class = CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
+#else
+stressor_info_t stress_ktls_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help,
+	.unimplemented_reason = "built without linux/tls.h, sendfile() or splice() support"
+};
+#endif
@@ -23,12 +23,27 @@
 #include <linux/kvm.h>
 #endif
 
+#define KVM_EXIT_RUNS		(1024)		/* exits timed per pio/mmio op */
+#define KVM_HYPERCALL_RUNS	(16)		/* guest runs per hypercall op */
+#define KVM_HYPERCALLS		(1024)		/* hypercalls per guest run */
+#define KVM_BENCH_MEM_SIZE	(64 * KB)	/* benchmark guest code memory */
+#define KVM_POPULATE_GPA	(2 * MB)	/* huge page aligned guest address */
+#define KVM_POPULATE_SIZE	(64 * MB)	/* guest memory populated per op */
+
 static const stress_help_t help[] = {
 	{ NULL,	"kvm N",	"start N workers exercising /dev/kvm" },
+	{ NULL,	"kvm-method M",	"kvm method [all|create|hypercall|mmio|pio|populate|run]" },
 	{ NULL, "kvm-ops N",	"stop after N kvm create/run/destroy operations" },
 	{ NULL,	NULL,		NULL }
 };
 
+static int stress_set_kvm_method(const char *opt);
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_kvm_method,	stress_set_kvm_method },
+	{ 0,			NULL }
+};
+
 #if defined(__linux__)	&&			\
     defined(HAVE_LINUX_KVM_H) && 		\
     defined(KVM_CREATE_VM) &&			\
@@ -40,11 +55,14 @@ static const stress_help_t help[] = {
     defined(KVM_GET_VCPU_MMAP_SIZE) &&		\
     defined(KVM_RUN) &&				\
     defined(KVM_EXIT_IO) &&			\
+    defined(KVM_EXIT_MMIO) &&			\
     defined(KVM_EXIT_SHUTDOWN) &&		\
     defined(STRESS_ARCH_X86) &&			\
     !defined(__i386__) &&			\
     !defined(__i386)
 
+#define STRESS_KVM_SUPPORTED
+
 /*
  *  Minimal x86 kernel, read/increment/write port $80 loop
  */
@@ -60,94 +78,183 @@ static const uint8_t kvm_x86_kernel[] = {
 };
 
 /*
- *  stress_kvm
- *	stress /dev/kvm
+ *  32 bit flat protected mode benchmark kernels
  */
-static int stress_kvm(const stress_args_t *args)
-{
-	bool pr_version = false;
+static const uint8_t kvm_x86_pio_kernel[] = {
+	0xe6, 0x80,			/* out    %al,$0x80 */
+	0xeb, 0xfc,			/* jmp    0 <_start> */
+};
 
-	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+static const uint8_t kvm_x86_mmio_kernel[] = {
+	0xa2, 0x00, 0x00, 0x10, 0x00,	/* mov    %al,0x100000 (unmapped) */
+	0xeb, 0xf9,			/* jmp    0 <_start> */
+};
 
-	do {
-		int kvm_fd, vm_fd, vcpu_fd, version, ret, i;
-		void *vm_mem;
-		size_t vm_mem_size = (stress_mwc16() + 2) * args->page_size;
-		ssize_t run_size;
-		struct kvm_userspace_memory_region kvm_mem;
-		struct kvm_sregs sregs;
-		struct kvm_regs regs;
-		struct kvm_run *run;
-		bool run_ok = false;
-		uint8_t value = 0;
+static const uint8_t kvm_x86_hypercall_kernel[] = {
+	0xb9, 0x00, 0x04, 0x00, 0x00,	/* mov    $1024,%ecx */
+	0xb8, 0xff, 0xff, 0x00, 0x00,	/* mov    $0xffff,%eax (no such hypercall) */
+	0x0f, 0x01, 0xc1,		/* vmcall */
+	0x49,				/* dec    %ecx */
+	0x75, 0xf5,			/* jnz    5 */
+	0xe6, 0x80,			/* out    %al,$0x80 */
+	0xeb, 0xec,			/* jmp    0 <_start> */
+};
 
-		if ((kvm_fd = open("/dev/kvm", O_RDWR)) < 0) {
-			if (errno == ENOENT) {
-				if (args->instance == 0)
-					pr_inf_skip("%s: /dev/kvm not available, skipping stress test\n",
-						args->name);
-				return EXIT_NOT_IMPLEMENTED;
-			}
-			pr_fail("%s: open /dev/kvm failed, errno=%d (%s), skipping stress test\n",
-				args->name, errno, strerror(errno));
-			return EXIT_NOT_IMPLEMENTED;
-		}
+#define KVM_POPULATE_PAGES_OFFSET	(6)	/* offset of page count in kernel */
 
-#if defined(KVM_GET_API_VERSION)
-		version = ioctl(kvm_fd, KVM_GET_API_VERSION, 0);
-		if ((!pr_version) && (args->instance == 0)) {
-			pr_inf("%s: KVM kernel API version %d\n", args->name, version);
-			pr_version = true;
-		}
-#endif
+static const uint8_t kvm_x86_populate_kernel[] = {
+	0xbf, 0x00, 0x00, 0x20, 0x00,	/* mov    $0x200000,%edi */
+	0xb9, 0x00, 0x00, 0x00, 0x00,	/* mov    $pages,%ecx */
+	0xc6, 0x07, 0x01,		/* movb   $1,(%edi) */
+	0x81, 0xc7, 0x00, 0x10, 0x00, 0x00, /* add $0x1000,%edi */
+	0x49,				/* dec    %ecx */
+	0x75, 0xf4,			/* jnz    10 */
+	0xe6, 0x80,			/* out    %al,$0x80 */
+	0xeb, 0xfc,			/* jmp    22 */
+};
+
+/* a VM with one vCPU and its guest memory at guest physical address 0 */
+typedef struct {
+	int vm_fd;			/* VM file descriptor */
+	int vcpu_fd;			/* vCPU file descriptor */
+	void *mem;			/* guest memory */
+	size_t mem_size;		/* size of guest memory */
+	struct kvm_run *run;		/* mmap'd vCPU run state */
+	size_t run_size;		/* size of run state */
+} stress_kvm_vm_t;
 
-		vm_fd = ioctl(kvm_fd, KVM_CREATE_VM, 0);
-		if (vm_fd < 0) {
-			if (errno == EINTR)
-				goto tidy_kvm_fd;
+#define STRESS_KVM_MISSING	(-1)	/* method not supported by this host */
+#define STRESS_KVM_FAILED	(0)	/* method failed, try again */
+#define STRESS_KVM_OK		(1)	/* method completed a bogo-op */
+
+typedef int (*stress_kvm_func)(const stress_args_t *args, const int kvm_fd);
+
+typedef struct {
+	const char *name;
+	const stress_kvm_func func;
+} stress_kvm_method_t;
+
+static stress_metrics_t kvm_create_metrics;	/* VM create to destroy */
+static stress_metrics_t kvm_boot_metrics;	/* VM create to first guest exit */
+static stress_metrics_t kvm_pio_metrics;	/* PIO exit round-trips */
+static stress_metrics_t kvm_mmio_metrics;	/* MMIO exit round-trips */
+static stress_metrics_t kvm_hypercall_metrics;	/* hypercalls */
+static stress_metrics_t kvm_populate_metrics[2];/* 4K and huge page populates */
+
+/*
+ *  stress_kvm_flat_segment()
+ *	set a 4GB flat 32 bit protected mode segment
+ */
+static void stress_kvm_flat_segment(
+	struct kvm_segment *seg,
+	const uint16_t selector,
+	const uint8_t type)
+{
+	(void)memset(seg, 0, sizeof(*seg));
+	seg->base = 0;
+	seg->limit = 0xffffffff;
+	seg->selector = selector;
+	seg->type = type;
+	seg->present = 1;
+	seg->dpl = 0;
+	seg->db = 1;
+	seg->s = 1;
+	seg->g = 1;
+}
+
+/*
+ *  stress_kvm_vm_destroy()
+ *	tear down a VM created by stress_kvm_vm_create
+ */
+static void stress_kvm_vm_destroy(stress_kvm_vm_t *vm)
+{
+	if (vm->run != MAP_FAILED)
+		(void)munmap((void *)vm->run, vm->run_size);
+	if (vm->vcpu_fd >= 0)
+		(void)close(vm->vcpu_fd);
+	if (vm->mem != MAP_FAILED)
+		(void)munmap(vm->mem, vm->mem_size);
+	if (vm->vm_fd >= 0)
+		(void)close(vm->vm_fd);
+}
+
+/*
+ *  stress_kvm_vm_create()
+ *	create a VM of mem_size bytes of guest memory with a vCPU
+ *	ready to run the kernel at guest address 0, in real mode or
+ *	in 32 bit flat protected mode, returns -1 on failure
+ */
+static int stress_kvm_vm_create(
+	const stress_args_t *args,
+	const int kvm_fd,
+	stress_kvm_vm_t *vm,
+	const size_t mem_size,
+	const uint8_t *kernel,
+	const size_t kernel_size,
+	const bool protected_mode)
+{
+	struct kvm_userspace_memory_region kvm_mem;
+	struct kvm_sregs sregs;
+	struct kvm_regs regs;
+	ssize_t run_size;
+
+	vm->vcpu_fd = -1;
+	vm->mem = MAP_FAILED;
+	vm->mem_size = mem_size;
+	vm->run = MAP_FAILED;
+	vm->run_size = 0;
+
+	vm->vm_fd = ioctl(kvm_fd, KVM_CREATE_VM, 0);
+	if (vm->vm_fd < 0) {
+		if (errno != EINTR)
 			pr_fail("%s: ioctl KVM_CREATE_VM failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			goto tidy_kvm_fd;
-		}
-		vm_mem = mmap(NULL, vm_mem_size, PROT_READ | PROT_WRITE,
-			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
-			-1, 0);
-		if (vm_mem == MAP_FAILED)
-			goto tidy_vm_fd;
-
-		(void)memset(&kvm_mem, 0, sizeof(kvm_mem));
-		kvm_mem.slot = 0;
-		kvm_mem.guest_phys_addr = 0;
-		kvm_mem.memory_size = vm_mem_size;
-		kvm_mem.userspace_addr = (uintptr_t)vm_mem;
-
-		ret = ioctl(vm_fd, KVM_SET_USER_MEMORY_REGION, &kvm_mem);
-		if (ret < 0) {
-			if (errno == EINTR)
-				goto tidy_vm_mmap;
+		goto err;
+	}
+	vm->mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+		-1, 0);
+	if (vm->mem == MAP_FAILED)
+		goto err;
+
+	(void)memset(&kvm_mem, 0, sizeof(kvm_mem));
+	kvm_mem.slot = 0;
+	kvm_mem.guest_phys_addr = 0;
+	kvm_mem.memory_size = mem_size;
+	kvm_mem.userspace_addr = (uintptr_t)vm->mem;
+
+	if (ioctl(vm->vm_fd, KVM_SET_USER_MEMORY_REGION, &kvm_mem) < 0) {
+		if (errno != EINTR)
 			pr_fail("%s: ioctl KVM_SET_USER_MEMORY_REGION failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			goto tidy_vm_mmap;
-		}
+		goto err;
+	}
 
-		vcpu_fd = ioctl(vm_fd, KVM_CREATE_VCPU, 0);
-		if (vcpu_fd < 0) {
-			if (errno == EINTR)
-				goto tidy_vm_mmap;
+	vm->vcpu_fd = ioctl(vm->vm_fd, KVM_CREATE_VCPU, 0);
+	if (vm->vcpu_fd < 0) {
+		if (errno != EINTR)
 			pr_fail("%s: ioctl KVM_CREATE_VCPU failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			goto tidy_vm_mmap;
-		}
+		goto err;
+	}
 
-		(void)memcpy(vm_mem, &kvm_x86_kernel, sizeof(kvm_x86_kernel));
-		if (ioctl(vcpu_fd, KVM_GET_SREGS, &sregs) < 0) {
-			if (errno == EINTR)
-				goto tidy_vcpu_fd;
+	(void)memcpy(vm->mem, kernel, kernel_size);
+	if (ioctl(vm->vcpu_fd, KVM_GET_SREGS, &sregs) < 0) {
+		if (errno != EINTR)
 			pr_fail("%s: ioctl KVM_GET_SREGS failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			goto tidy_vcpu_fd;
-		}
+		goto err;
+	}
 
+	if (protected_mode) {
+		stress_kvm_flat_segment(&sregs.cs, 0x08, 11);	/* code, execute/read, accessed */
+		stress_kvm_flat_segment(&sregs.ds, 0x10, 3);	/* data, read/write, accessed */
+		sregs.es = sregs.ds;
+		sregs.fs = sregs.ds;
+		sregs.gs = sregs.ds;
+		sregs.ss = sregs.ds;
+		sregs.cr0 |= 1;					/* CR0.PE */
+	} else {
 		sregs.cs.selector = 0;
 		sregs.cs.base = 0;
 		sregs.ds.selector = 0;
@@ -160,133 +267,546 @@ static int stress_kvm(const stress_args_t *args)
 		sregs.gs.base = 0;
 		sregs.ss.selector = 0;
 		sregs.ss.base = 0;
+	}
 
-		if (ioctl(vcpu_fd, KVM_SET_SREGS, &sregs) < 0) {
-			pr_fail("%s: ioctl KVM_SET_SREGS failed, errno=%d (%s)\n",
-				args->name, errno, strerror(errno));
-			goto tidy_vcpu_fd;
-		}
+	if (ioctl(vm->vcpu_fd, KVM_SET_SREGS, &sregs) < 0) {
+		pr_fail("%s: ioctl KVM_SET_SREGS failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
 
-		(void)memset(&regs, 0, sizeof(regs));
-		regs.rflags = 2;
-		regs.rip = 0;
-		if (ioctl(vcpu_fd, KVM_SET_REGS, &regs) < 0) {
-			if (errno == EINTR)
-				goto tidy_vcpu_fd;
+	(void)memset(&regs, 0, sizeof(regs));
+	regs.rflags = 2;
+	regs.rip = 0;
+	if (ioctl(vm->vcpu_fd, KVM_SET_REGS, &regs) < 0) {
+		if (errno != EINTR)
 			pr_fail("%s: ioctl KVM_SET_REGS failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			goto tidy_vcpu_fd;
-		}
+		goto err;
+	}
 
-		run_size = (ssize_t)ioctl(kvm_fd, KVM_GET_VCPU_MMAP_SIZE, 0);
-		if (run_size < 0) {
-			if (errno == EINTR)
-				goto tidy_vcpu_fd;
+	run_size = (ssize_t)ioctl(kvm_fd, KVM_GET_VCPU_MMAP_SIZE, 0);
+	if (run_size < 0) {
+		if (errno != EINTR)
 			pr_fail("%s: ioctl KVM_GET_VCPU_MMAP_SIZE failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			goto tidy_vcpu_fd;
-		}
+		goto err;
+	}
 
-		run = (struct kvm_run *)mmap(NULL, (size_t)run_size,
-			PROT_READ | PROT_WRITE, MAP_SHARED, vcpu_fd, 0);
-		if (run == MAP_FAILED) {
-			pr_fail("%s: mmap on vcpu_fd failed, errno=%d (%s)\n",
+	vm->run_size = (size_t)run_size;
+	vm->run = (struct kvm_run *)mmap(NULL, vm->run_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED, vm->vcpu_fd, 0);
+	if (vm->run == MAP_FAILED) {
+		pr_fail("%s: mmap on vcpu_fd failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	return 0;
+
+err:
+	stress_kvm_vm_destroy(vm);
+	return -1;
+}
+
+/*
+ *  stress_kvm_vm_run()
+ *	run the vCPU until the next exit to user space,
+ *	returns the exit reason or -1 on failure
+ */
+static int stress_kvm_vm_run(const stress_args_t *args, stress_kvm_vm_t *vm)
+{
+	if (ioctl(vm->vcpu_fd, KVM_RUN, 0) < 0) {
+		if (errno != EINTR)
+			pr_fail("%s: ioctl KVM_RUN failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			goto tidy_vcpu_fd;
-		}
+		return -1;
+	}
+	return (int)vm->run->exit_reason;
+}
 
-		for (i = 0; i < 1000 && keep_stressing(args); i++) {
-			uint8_t *port;
+/*
+ *  stress_kvm_run()
+ *	create a VM of random size, run the port $80 loop
+ *	kernel until it writes 0xff and tear it down
+ */
+static int stress_kvm_run(const stress_args_t *args, const int kvm_fd)
+{
+	stress_kvm_vm_t vm;
+	const size_t vm_mem_size = (stress_mwc16() + 2) * args->page_size;
+	bool run_ok = false;
+	uint8_t value = 0;
+	int i;
 
-			ret = ioctl(vcpu_fd, KVM_RUN, 0);
-			if (ret < 0) {
-				if (errno != EINTR) {
-					pr_fail("%s: ioctl KVM_RUN failed, errno=%d (%s)\n",
-						args->name, errno, strerror(errno));
-				}
-				goto tidy_run;
+	if (stress_kvm_vm_create(args, kvm_fd, &vm, vm_mem_size,
+			kvm_x86_kernel, sizeof(kvm_x86_kernel), false) < 0)
+		return STRESS_KVM_FAILED;
+
+	for (i = 0; i < 1000 && keep_stressing(args); i++) {
+		uint8_t *port;
+
+		switch (stress_kvm_vm_run(args, &vm)) {
+		case KVM_EXIT_IO:
+			port = (uint8_t *)vm.run + vm.run->io.data_offset;
+			if (vm.run->io.direction == 0) {
+				/* Read */
+				*port = value;
+			} else {
+				/* Write */
+				value = *port;
 			}
-			switch (run->exit_reason) {
-			case KVM_EXIT_IO:
-				port = (uint8_t *)run + run->io.data_offset;
-				if (run->io.direction == 0) {
-					/* Read */
-					*port = value;
-				} else {
-					/* Write */
-					value = *port;
-				}
-				if (*port == 0xff) {
-					run_ok = true;
-					goto tidy_run;
-				}
-				break;
-			case KVM_EXIT_SHUTDOWN:
+			if (*port == 0xff) {
+				run_ok = true;
 				goto tidy_run;
-			default:
-				break;
 			}
+			break;
+		case KVM_EXIT_SHUTDOWN:
+		case -1:
+			goto tidy_run;
+		default:
+			break;
+		}
 #if defined(KVM_GET_REGS)
-			{
-				struct kvm_regs kregs;
+		{
+			struct kvm_regs kregs;
 
-				VOID_RET(int, ioctl(vcpu_fd, KVM_GET_REGS, &kregs));
-			}
+			VOID_RET(int, ioctl(vm.vcpu_fd, KVM_GET_REGS, &kregs));
+		}
 #endif
 #if defined(KVM_GET_FPU)
-			{
-				struct kvm_fpu fpu;
+		{
+			struct kvm_fpu fpu;
 
-				VOID_RET(int, ioctl(vcpu_fd, KVM_GET_FPU, &fpu));
-			}
+			VOID_RET(int, ioctl(vm.vcpu_fd, KVM_GET_FPU, &fpu));
+		}
 #endif
 #if defined(KVM_GET_MP_STATE)
-			{
-				struct kvm_mp_state state;
+		{
+			struct kvm_mp_state state;
 
-				VOID_RET(int, ioctl(vcpu_fd, KVM_GET_MP_STATE, &state));
-			}
+			VOID_RET(int, ioctl(vm.vcpu_fd, KVM_GET_MP_STATE, &state));
+		}
 #endif
 #if defined(KVM_GET_XSAVE)
-			{
-				struct kvm_xsave xsave;
+		{
+			struct kvm_xsave xsave;
 
-				VOID_RET(int, ioctl(vcpu_fd, KVM_GET_XSAVE, &xsave));
-			}
+			VOID_RET(int, ioctl(vm.vcpu_fd, KVM_GET_XSAVE, &xsave));
+		}
 #endif
 #if defined(KVM_GET_TSC_KHZ)
-			VOID_RET(int, ioctl(vcpu_fd, KVM_GET_TSC_KHZ, 0));
+		VOID_RET(int, ioctl(vm.vcpu_fd, KVM_GET_TSC_KHZ, 0));
 #endif
-		}
+	}
 tidy_run:
-		(void)munmap((void *)run, (size_t)run_size);
-tidy_vcpu_fd:
-		(void)close(vcpu_fd);
-tidy_vm_mmap:
-		(void)munmap((void *)vm_mem, vm_mem_size);
-tidy_vm_fd:
-		(void)close(vm_fd);
-tidy_kvm_fd:
+	stress_kvm_vm_destroy(&vm);
+
+	return run_ok ? STRESS_KVM_OK : STRESS_KVM_FAILED;
+}
+
+/*
+ *  stress_kvm_create()
+ *	time creating a VM, running it to its first exit (the
+ *	guest boot latency) and tearing it down again
+ */
+static int stress_kvm_create(const stress_args_t *args, const int kvm_fd)
+{
+	stress_kvm_vm_t vm;
+	double t_start, t_exit;
+	int reason;
+
+	t_start = stress_time_now();
+	if (stress_kvm_vm_create(args, kvm_fd, &vm, KVM_BENCH_MEM_SIZE,
+			kvm_x86_pio_kernel, sizeof(kvm_x86_pio_kernel), true) < 0)
+		return STRESS_KVM_FAILED;
+	reason = stress_kvm_vm_run(args, &vm);
+	t_exit = stress_time_now();
+	stress_kvm_vm_destroy(&vm);
+
+	if (reason < 0)
+		return STRESS_KVM_FAILED;
+	if (reason != KVM_EXIT_IO)
+		return STRESS_KVM_MISSING;
+
+	kvm_boot_metrics.duration += t_exit - t_start;
+	kvm_boot_metrics.count += 1.0;
+	kvm_create_metrics.duration += stress_time_now() - t_start;
+	kvm_create_metrics.count += 1.0;
+
+	return STRESS_KVM_OK;
+}
+
+/*
+ *  stress_kvm_exits()
+ *	time runs guest runs of kernel, each ending with an exit
+ *	of type exit_reason and covering calls round-trips
+ */
+static int stress_kvm_exits(
+	const stress_args_t *args,
+	const int kvm_fd,
+	const uint8_t *kernel,
+	const size_t kernel_size,
+	const int exit_reason,
+	const int runs,
+	const double calls,
+	stress_metrics_t *metrics)
+{
+	stress_kvm_vm_t vm;
+	double t;
+	int i, rc = STRESS_KVM_OK;
+
+	if (stress_kvm_vm_create(args, kvm_fd, &vm, KVM_BENCH_MEM_SIZE,
+			kernel, kernel_size, true) < 0)
+		return STRESS_KVM_FAILED;
+
+	/* first run faults in the guest code page, don't time it */
+	i = stress_kvm_vm_run(args, &vm);
+	if (i != exit_reason) {
+		rc = (i < 0) ? STRESS_KVM_FAILED : STRESS_KVM_MISSING;
+		goto tidy_vm;
+	}
+
+	t = stress_time_now();
+	for (i = 0; (i < runs) && keep_stressing_flag(); i++) {
+		const int reason = stress_kvm_vm_run(args, &vm);
+
+		if (reason != exit_reason) {
+			rc = (reason < 0) ? STRESS_KVM_FAILED : STRESS_KVM_MISSING;
+			break;
+		}
+	}
+	metrics->duration += stress_time_now() - t;
+	metrics->count += (double)i * calls;
+
+tidy_vm:
+	stress_kvm_vm_destroy(&vm);
+
+	return rc;
+}
+
+/*
+ *  stress_kvm_pio()
+ *	time port I/O exit round-trips
+ */
+static int stress_kvm_pio(const stress_args_t *args, const int kvm_fd)
+{
+	return stress_kvm_exits(args, kvm_fd, kvm_x86_pio_kernel,
+		sizeof(kvm_x86_pio_kernel), KVM_EXIT_IO,
+		KVM_EXIT_RUNS, 1.0, &kvm_pio_metrics);
+}
+
+/*
+ *  stress_kvm_mmio()
+ *	time MMIO exit round-trips, writes to unbacked guest memory
+ */
+static int stress_kvm_mmio(const stress_args_t *args, const int kvm_fd)
+{
+	return stress_kvm_exits(args, kvm_fd, kvm_x86_mmio_kernel,
+		sizeof(kvm_x86_mmio_kernel), KVM_EXIT_MMIO,
+		KVM_EXIT_RUNS, 1.0, &kvm_mmio_metrics);
+}
+
+/*
+ *  stress_kvm_hypercall_probe()
+ *	some hosts (e.g. some nested set ups) never complete a guest
+ *	vmcall and KVM_RUN spins forever, so try the hypercall kernel
+ *	in a child that is killed if it does not finish in a second
+ */
+static bool stress_kvm_hypercall_probe(const stress_args_t *args, const int kvm_fd)
+{
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	if (pid < 0)
+		return false;
+	if (pid == 0) {
+		stress_kvm_vm_t vm;
+		int reason;
+
+		stress_parent_died_alarm();
+		(void)signal(SIGALRM, SIG_DFL);
+		(void)alarm(1);
+		if (stress_kvm_vm_create(args, kvm_fd, &vm, KVM_BENCH_MEM_SIZE,
+				kvm_x86_hypercall_kernel, sizeof(kvm_x86_hypercall_kernel), true) < 0)
+			_exit(EXIT_FAILURE);
+		reason = stress_kvm_vm_run(args, &vm);
+		stress_kvm_vm_destroy(&vm);
+		_exit((reason == KVM_EXIT_IO) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if (shim_waitpid(pid, &status, 0) < 0) {
+		(void)kill(pid, SIGKILL);
+		(void)shim_waitpid(pid, &status, 0);
+		return false;
+	}
+	return WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS);
+}
+
+/*
+ *  stress_kvm_hypercall()
+ *	time hypercall round-trips, these are handled in the host
+ *	kernel so the guest makes many per port I/O exit
+ */
+static int stress_kvm_hypercall(const stress_args_t *args, const int kvm_fd)
+{
+	static int supported = -1;
+
+	if (supported < 0)
+		supported = stress_kvm_hypercall_probe(args, kvm_fd);
+	if (!supported)
+		return STRESS_KVM_MISSING;
+
+	return stress_kvm_exits(args, kvm_fd, kvm_x86_hypercall_kernel,
+		sizeof(kvm_x86_hypercall_kernel), KVM_EXIT_IO,
+		KVM_HYPERCALL_RUNS, (double)KVM_HYPERCALLS, &kvm_hypercall_metrics);
+}
+
+/*
+ *  stress_kvm_populate_pages()
+ *	time the guest touching each 4K page of KVM_POPULATE_SIZE
+ *	bytes of fresh guest memory, backed by small or huge pages
+ */
+static int stress_kvm_populate_pages(
+	const stress_args_t *args,
+	const int kvm_fd,
+	const bool hugepages)
+{
+	struct kvm_userspace_memory_region kvm_mem;
+	stress_kvm_vm_t vm;
+	uint8_t kernel[sizeof(kvm_x86_populate_kernel)];
+	const uint32_t pages = (uint32_t)(KVM_POPULATE_SIZE / 4096);
+	const size_t map_size = KVM_POPULATE_SIZE + KVM_POPULATE_GPA;
+	uint8_t *map, *mem;
+	double t;
+	int reason;
+
+	(void)memcpy(kernel, kvm_x86_populate_kernel, sizeof(kernel));
+	(void)memcpy(kernel + KVM_POPULATE_PAGES_OFFSET, &pages, sizeof(pages));
+
+	/* huge pages need the host and guest addresses equally aligned */
+	map = (uint8_t *)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (map == MAP_FAILED)
+		return STRESS_KVM_FAILED;
+	mem = (uint8_t *)(((uintptr_t)map + KVM_POPULATE_GPA - 1) & ~(uintptr_t)(KVM_POPULATE_GPA - 1));
+#if defined(MADV_HUGEPAGE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	(void)shim_madvise(mem, KVM_POPULATE_SIZE, hugepages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+
+	if (stress_kvm_vm_create(args, kvm_fd, &vm, KVM_BENCH_MEM_SIZE,
+			kernel, sizeof(kernel), true) < 0) {
+		(void)munmap((void *)map, map_size);
+		return STRESS_KVM_FAILED;
+	}
+
+	(void)memset(&kvm_mem, 0, sizeof(kvm_mem));
+	kvm_mem.slot = 1;
+	kvm_mem.guest_phys_addr = KVM_POPULATE_GPA;
+	kvm_mem.memory_size = KVM_POPULATE_SIZE;
+	kvm_mem.userspace_addr = (uintptr_t)mem;
+	if (ioctl(vm.vm_fd, KVM_SET_USER_MEMORY_REGION, &kvm_mem) < 0) {
+		if (errno != EINTR)
+			pr_fail("%s: ioctl KVM_SET_USER_MEMORY_REGION failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+		reason = -1;
+		goto tidy_vm;
+	}
+
+	t = stress_time_now();
+	reason = stress_kvm_vm_run(args, &vm);
+	if (reason == KVM_EXIT_IO) {
+		stress_metrics_t *metrics = &kvm_populate_metrics[hugepages ? 1 : 0];
+
+		metrics->duration += stress_time_now() - t;
+		metrics->count += (double)KVM_POPULATE_SIZE;
+	}
+tidy_vm:
+	stress_kvm_vm_destroy(&vm);
+	(void)munmap((void *)map, map_size);
+
+	if (reason < 0)
+		return STRESS_KVM_FAILED;
+	return (reason == KVM_EXIT_IO) ? STRESS_KVM_OK : STRESS_KVM_MISSING;
+}
+
+/*
+ *  stress_kvm_populate()
+ *	time guest memory population with and without huge pages
+ */
+static int stress_kvm_populate(const stress_args_t *args, const int kvm_fd)
+{
+	int rc;
+
+	rc = stress_kvm_populate_pages(args, kvm_fd, false);
+	if (rc != STRESS_KVM_OK)
+		return rc;
+#if defined(MADV_HUGEPAGE)
+	rc = stress_kvm_populate_pages(args, kvm_fd, true);
+#endif
+	return rc;
+}
+
+static const stress_kvm_method_t kvm_methods[] = {
+	{ "all",	NULL },
+	{ "create",	stress_kvm_create },
+	{ "hypercall",	stress_kvm_hypercall },
+	{ "mmio",	stress_kvm_mmio },
+	{ "pio",	stress_kvm_pio },
+	{ "populate",	stress_kvm_populate },
+	{ "run",	stress_kvm_run },
+};
+
+#define KVM_METHOD_RUN	(SIZEOF_ARRAY(kvm_methods) - 1)
+
+/*
+ *  stress_kvm_metrics()
+ *	set the metrics of the benchmark methods that ran
+ */
+static void stress_kvm_metrics(const stress_args_t *args)
+{
+	if (kvm_create_metrics.duration > 0.0)
+		stress_metrics_set(args, 0, "VMs created and destroyed per sec",
+			kvm_create_metrics.count / kvm_create_metrics.duration);
+	if (kvm_boot_metrics.count > 0.0)
+		stress_metrics_set(args, 1, "microsecs VM create to first guest exit",
+			STRESS_DBL_MICROSECOND * kvm_boot_metrics.duration / kvm_boot_metrics.count);
+	if (kvm_pio_metrics.count > 0.0)
+		stress_metrics_set(args, 2, "nanosecs per PIO exit round-trip",
+			STRESS_DBL_NANOSECOND * kvm_pio_metrics.duration / kvm_pio_metrics.count);
+	if (kvm_mmio_metrics.count > 0.0)
+		stress_metrics_set(args, 3, "nanosecs per MMIO exit round-trip",
+			STRESS_DBL_NANOSECOND * kvm_mmio_metrics.duration / kvm_mmio_metrics.count);
+	if (kvm_hypercall_metrics.count > 0.0)
+		stress_metrics_set(args, 4, "nanosecs per hypercall round-trip",
+			STRESS_DBL_NANOSECOND * kvm_hypercall_metrics.duration / kvm_hypercall_metrics.count);
+	if (kvm_populate_metrics[0].duration > 0.0)
+		stress_metrics_set(args, 5, "MB per sec guest memory populate (4K pages)",
+			kvm_populate_metrics[0].count / (kvm_populate_metrics[0].duration * (double)MB));
+	if (kvm_populate_metrics[1].duration > 0.0)
+		stress_metrics_set(args, 6, "MB per sec guest memory populate (huge pages)",
+			kvm_populate_metrics[1].count / (kvm_populate_metrics[1].duration * (double)MB));
+}
+
+/*
+ *  stress_kvm
+ *	stress /dev/kvm
+ */
+static int stress_kvm(const stress_args_t *args)
+{
+	bool pr_version = false;
+	bool missing[SIZEOF_ARRAY(kvm_methods)];
+	size_t kvm_method = KVM_METHOD_RUN, method, next = 1;
+
+	(void)memset(missing, 0, sizeof(missing));
+	(void)stress_get_setting("kvm-method", &kvm_method);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		int kvm_fd, version, rc;
+
+		if ((kvm_fd = open("/dev/kvm", O_RDWR)) < 0) {
+			if (errno == ENOENT) {
+				if (args->instance == 0)
+					pr_inf_skip("%s: /dev/kvm not available, skipping stress test\n",
+						args->name);
+				return EXIT_NOT_IMPLEMENTED;
+			}
+			pr_fail("%s: open /dev/kvm failed, errno=%d (%s), skipping stress test\n",
+				args->name, errno, strerror(errno));
+			return EXIT_NOT_IMPLEMENTED;
+		}
+
+#if defined(KVM_GET_API_VERSION)
+		version = ioctl(kvm_fd, KVM_GET_API_VERSION, 0);
+		if ((!pr_version) && (args->instance == 0)) {
+			pr_inf("%s: KVM kernel API version %d\n", args->name, version);
+			pr_version = true;
+		}
+#endif
+		/* 'all' method, work through the methods the host supports */
+		if (kvm_method == 0) {
+			size_t tries;
+
+			for (tries = 0; tries < SIZEOF_ARRAY(kvm_methods); tries++) {
+				method = next++;
+				if (next >= SIZEOF_ARRAY(kvm_methods))
+					next = 1;
+				if (!missing[method])
+					break;
+			}
+		} else {
+			method = kvm_method;
+		}
+
+		rc = kvm_methods[method].func(args, kvm_fd);
 		(void)close(kvm_fd);
-		if (run_ok)
+
+		if (rc == STRESS_KVM_OK) {
 			inc_counter(args);
+		} else if ((rc == STRESS_KVM_MISSING) && !missing[method]) {
+			missing[method] = true;
+			if (kvm_method) {
+				if (args->instance == 0)
+					pr_inf_skip("%s: %s method not supported by this host, "
+						"skipping stress test\n", args->name,
+						kvm_methods[method].name);
+				return EXIT_NOT_IMPLEMENTED;
+			}
+			if (args->instance == 0)
+				pr_inf("%s: %s method not supported by this host, skipping it\n",
+					args->name, kvm_methods[method].name);
+		}
 	} while (keep_stressing(args));
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
+	stress_kvm_metrics(args);
+
 	return EXIT_SUCCESS;
 }
 
 stressor_info_t stress_kvm_info = {
 	.stressor = stress_kvm,
 	.class = CLASS_DEV | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_ALWAYS,
 	.help = help
 };
+#endif
+
+/*
+ *  stress_set_kvm_method()
+ *	set the kvm method
+ */
+static int stress_set_kvm_method(const char *opt)
+{
+#if defined(STRESS_KVM_SUPPORTED)
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(kvm_methods); i++) {
+		if (!strcmp(opt, kvm_methods[i].name))
+			return stress_set_setting("kvm-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "kvm-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(kvm_methods); i++)
+		(void)fprintf(stderr, " %s", kvm_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
 #else
+	(void)opt;
+
+	(void)fprintf(stderr, "kvm-method not supported on this system\n");
+	return -1;
+#endif
+}
+
+#if !defined(STRESS_KVM_SUPPORTED)
 stressor_info_t stress_kvm_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_DEV | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built on non-x86-64 without linux/kvm.h"
 };
@@ -19,6 +19,7 @@
  */
 #include "stress-ng.h"
 #include "core-builtin.h"
+#include "core-cpu-cache.h"
 
 #if defined(HAVE_SYS_QUEUE_H)
 #include <sys/queue.h>
@@ -28,6 +29,52 @@
 #define MAX_LIST_SIZE		(1000000)
 #define DEFAULT_LIST_SIZE	(5000)
 
+#define LIST_BENCH_SLICE	(0.1)		/* seconds per benchmark configuration */
+#define LIST_BENCH_MIN_LENGTH	(1024)		/* shortest benchmarked list */
+#define LIST_BENCH_MAX_LENGTH	(1024 * 1024)	/* default longest benchmarked list */
+#define LIST_BENCH_LENGTHS	(8)		/* lengths, x4 apart */
+#define LIST_BENCH_JUMP		(8)		/* nodes ahead to prefetch */
+
+/* list node layouts */
+#define LIST_BENCH_ARENA	(0)
+#define LIST_BENCH_SCATTERED	(1)
+#define LIST_BENCH_MALLOC	(2)
+#define LIST_BENCH_PREFETCH	(3)
+#define LIST_BENCH_UNROLLED	(4)
+#define LIST_BENCH_LAYOUTS	(5)
+
+/* elements in a cache line sized unrolled list node */
+#define LIST_BENCH_UNROLL	((64 - sizeof(void *) - sizeof(uint32_t)) / sizeof(uint64_t))
+
+static const char * const stress_list_bench_layouts[LIST_BENCH_LAYOUTS] = {
+	"arena",
+	"scattered",
+	"malloc",
+	"prefetch",
+	"unrolled",
+};
+
+/* a singly linked list node with a jump pointer for prefetching */
+typedef struct stress_list_bench_node {
+	struct stress_list_bench_node *next;
+	struct stress_list_bench_node *jump;	/* LIST_BENCH_JUMP nodes ahead */
+	uint64_t value;
+} stress_list_bench_node_t;
+
+/* an unrolled list node, several elements per cache line */
+typedef struct stress_list_bench_unrolled {
+	struct stress_list_bench_unrolled *next;
+	uint32_t n;				/* elements used */
+	uint64_t values[LIST_BENCH_UNROLL];
+} ALIGN64 stress_list_bench_unrolled_t;
+
+/* accumulated traversal of a layout at a list length */
+typedef struct {
+	int err;				/* errno if the list cannot be built */
+	double elements;			/* elements traversed */
+	double secs;				/* seconds traversing */
+} stress_list_bench_t;
+
 struct list_entry;
 
 typedef void (*stress_list_func)(const stress_args_t *args,
@@ -44,6 +91,7 @@ static const stress_list_method_info_t list_methods[];
 
 static const stress_help_t help[] = {
 	{ NULL,	"list N",	 "start N workers that exercise list structures" },
+	{ NULL,	"list-bench",	 "compare traversal cost of list node layouts and lengths" },
 	{ NULL,	"list-method M", "select list method: all, circleq, list, slist, slistt, stailq, tailq" },
 	{ NULL,	"list-ops N",	 "stop after N bogo list operations" },
 	{ NULL,	"list-size N",	 "N is the number of items in the list" },
@@ -154,6 +202,11 @@ static int stress_set_list_size(const char *opt)
 	return stress_set_setting("list-size", TYPE_ID_UINT64, &list_size);
 }
 
+static int stress_set_list_bench(const char *opt)
+{
+	return stress_set_setting_true("list-bench", opt);
+}
+
 /*
  *  stress_list_handler()
  *	SIGALRM generic handler
@@ -427,6 +480,312 @@ static void OPTIMIZE3 stress_list_tailq(
 }
 #endif
 
+/*
+ *  stress_list_bench_shuffle()
+ *	fill order with a random permutation of 0..n-1
+ */
+static void stress_list_bench_shuffle(uint32_t *order, const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		order[i] = (uint32_t)i;
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = (size_t)stress_mwc32modn((uint32_t)(i + 1));
+		const uint32_t tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+}
+
+/*
+ *  stress_list_bench_link()
+ *	link n arena nodes in the given order, or in address order if
+ *	order is NULL, and set the jump pointers LIST_BENCH_JUMP nodes ahead
+ */
+static stress_list_bench_node_t *stress_list_bench_link(
+	stress_list_bench_node_t *nodes,
+	const uint32_t *order,
+	const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		stress_list_bench_node_t *node = &nodes[order ? order[i] : i];
+
+		node->next = (i + 1 < n) ? &nodes[order ? order[i + 1] : i + 1] : NULL;
+		node->jump = (i + LIST_BENCH_JUMP < n) ? &nodes[order ? order[i + LIST_BENCH_JUMP] : i + LIST_BENCH_JUMP] : NULL;
+	}
+	return &nodes[order ? order[0] : 0];
+}
+
+static uint64_t OPTIMIZE3 stress_list_bench_walk(register const stress_list_bench_node_t *node)
+{
+	register uint64_t sum = 0;
+
+	while (node) {
+		sum += node->value;
+		node = node->next;
+	}
+	return sum;
+}
+
+static uint64_t OPTIMIZE3 stress_list_bench_walk_prefetch(register const stress_list_bench_node_t *node)
+{
+	register uint64_t sum = 0;
+
+	while (node) {
+		shim_builtin_prefetch(node->jump);
+		sum += node->value;
+		node = node->next;
+	}
+	return sum;
+}
+
+static uint64_t OPTIMIZE3 stress_list_bench_walk_unrolled(register const stress_list_bench_unrolled_t *node)
+{
+	register uint64_t sum = 0;
+
+	while (node) {
+		register uint32_t i;
+
+		for (i = 0; i < node->n; i++)
+			sum += node->values[i];
+		node = node->next;
+	}
+	return sum;
+}
+
+/*
+ *  stress_list_bench_run()
+ *	build a list of n elements of the given layout and traverse it
+ *	repeatedly for secs seconds, accumulating elements and time
+ */
+static void stress_list_bench_run(
+	const stress_args_t *args,
+	const int layout,
+	const size_t n,
+	const double secs,
+	stress_list_bench_t *result)
+{
+	stress_list_bench_node_t *nodes = NULL, *head = NULL;
+	stress_list_bench_unrolled_t *unrolled = NULL, *uhead = NULL;
+	void **allocs = NULL;
+	uint32_t *order = NULL;
+	size_t i, nallocs = 0, size = 0;
+	const size_t nunrolled = (n + LIST_BENCH_UNROLL - 1) / LIST_BENCH_UNROLL;
+	uint64_t expected = 0, sum;
+	double t_start, t_end, t;
+
+	switch (layout) {
+	case LIST_BENCH_ARENA:
+	case LIST_BENCH_SCATTERED:
+	case LIST_BENCH_PREFETCH:
+		size = n * sizeof(*nodes);
+		nodes = (stress_list_bench_node_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (nodes == MAP_FAILED) {
+			nodes = NULL;
+			goto err;
+		}
+		for (i = 0; i < n; i++) {
+			nodes[i].value = stress_mwc64();
+			expected += nodes[i].value;
+		}
+		if (layout != LIST_BENCH_ARENA) {
+			order = (uint32_t *)calloc(n, sizeof(*order));
+			if (!order)
+				goto err;
+			stress_list_bench_shuffle(order, n);
+		}
+		head = stress_list_bench_link(nodes, order, n);
+		break;
+	case LIST_BENCH_MALLOC: {
+		stress_list_bench_node_t *tail = NULL;
+		void **fillers;
+		size_t nfillers = 0;
+
+		/*
+		 *  nodes interleaved with random sized allocations that
+		 *  are then freed, leaving the nodes scattered over the heap
+		 */
+		allocs = (void **)calloc(n, sizeof(*allocs));
+		fillers = (void **)calloc(n, sizeof(*fillers));
+		if (!allocs || !fillers) {
+			free(fillers);
+			goto err;
+		}
+		for (i = 0; i < n; i++) {
+			stress_list_bench_node_t *node = (stress_list_bench_node_t *)malloc(sizeof(*node));
+
+			if (!node)
+				break;
+			allocs[nallocs++] = node;
+			node->value = stress_mwc64();
+			node->next = NULL;
+			node->jump = NULL;
+			expected += node->value;
+			if (tail)
+				tail->next = node;
+			else
+				head = node;
+			tail = node;
+			if ((stress_mwc8() & 3) == 0) {
+				fillers[nfillers] = malloc(16 + (size_t)stress_mwc8modn(113));
+				if (fillers[nfillers])
+					nfillers++;
+			}
+		}
+		for (i = 0; i < nfillers; i++)
+			free(fillers[i]);
+		free(fillers);
+		if (nallocs < n)
+			goto err;
+		break;
+	}
+	case LIST_BENCH_UNROLLED:
+		size = nunrolled * sizeof(*unrolled);
+		unrolled = (stress_list_bench_unrolled_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (unrolled == MAP_FAILED) {
+			unrolled = NULL;
+			goto err;
+		}
+		order = (uint32_t *)calloc(nunrolled, sizeof(*order));
+		if (!order)
+			goto err;
+		stress_list_bench_shuffle(order, nunrolled);
+		for (i = 0; i < nunrolled; i++) {
+			stress_list_bench_unrolled_t *node = &unrolled[order[i]];
+			uint32_t j;
+
+			node->n = (uint32_t)STRESS_MINIMUM(n - (i * LIST_BENCH_UNROLL), LIST_BENCH_UNROLL);
+			for (j = 0; j < node->n; j++) {
+				node->values[j] = stress_mwc64();
+				expected += node->values[j];
+			}
+			node->next = (i + 1 < nunrolled) ? &unrolled[order[i + 1]] : NULL;
+		}
+		uhead = &unrolled[order[0]];
+		break;
+	default:
+		goto err;
+	}
+
+	t_start = stress_time_now();
+	t_end = t_start + secs;
+	t = t_start;
+	do {
+		switch (layout) {
+		case LIST_BENCH_PREFETCH:
+			sum = stress_list_bench_walk_prefetch(head);
+			break;
+		case LIST_BENCH_UNROLLED:
+			sum = stress_list_bench_walk_unrolled(uhead);
+			break;
+		default:
+			sum = stress_list_bench_walk(head);
+			break;
+		}
+		if (UNLIKELY(sum != expected)) {
+			pr_fail("%s: %s list of %zu elements sum 0x%" PRIx64 ", expected 0x%" PRIx64 "\n",
+				args->name, stress_list_bench_layouts[layout], n, sum, expected);
+			break;
+		}
+		result->elements += (double)n;
+		t = stress_time_now();
+	} while ((t < t_end) && keep_stressing(args));
+	result->secs += t - t_start;
+	inc_counter(args);
+	goto tidy;
+
+err:
+	result->err = ENOMEM;
+tidy:
+	if (nodes)
+		(void)munmap((void *)nodes, size);
+	if (unrolled)
+		(void)munmap((void *)unrolled, size);
+	if (allocs) {
+		for (i = 0; i < nallocs; i++)
+			free(allocs[i]);
+		free(allocs);
+	}
+	free(order);
+}
+
+/*
+ *  stress_list_bench()
+ *	compare the traversal cost per element of address ordered arena
+ *	nodes, randomly ordered (scattered) arena nodes, individually
+ *	malloc'd nodes, scattered nodes with jump pointer prefetching and
+ *	scattered unrolled nodes of LIST_BENCH_UNROLL elements per cache
+ *	line over a range of list lengths. The configurations take turns
+ *	for a slice of time so all see the same system conditions
+ */
+static int stress_list_bench(const stress_args_t *args, const size_t max_length)
+{
+	static stress_list_bench_t results[LIST_BENCH_LENGTHS][LIST_BENCH_LAYOUTS];
+	size_t lengths[LIST_BENCH_LENGTHS];
+	size_t i, j, n_lengths = 0, idx = 0;
+	bool ran;
+
+	for (i = LIST_BENCH_MIN_LENGTH; (i <= max_length) && (n_lengths < LIST_BENCH_LENGTHS); i *= 4)
+		lengths[n_lengths++] = i;
+	(void)memset(results, 0, sizeof(results));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		for (i = 0; i < n_lengths; i++) {
+			for (j = 0; (j < LIST_BENCH_LAYOUTS) && keep_stressing(args); j++) {
+				if (results[i][j].err)
+					continue;
+				stress_list_bench_run(args, (int)j, lengths[i], LIST_BENCH_SLICE, &results[i][j]);
+				ran = true;
+			}
+		}
+	} while (ran && keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: nanoseconds per element traversed, %zu elements per unrolled node\n",
+			args->name, (size_t)LIST_BENCH_UNROLL);
+		pr_inf("%s: %8s %9s %9s %9s %9s %9s\n", args->name, "length",
+			stress_list_bench_layouts[0], stress_list_bench_layouts[1],
+			stress_list_bench_layouts[2], stress_list_bench_layouts[3],
+			stress_list_bench_layouts[4]);
+	}
+	for (i = 0; i < n_lengths; i++) {
+		char buf[LIST_BENCH_LAYOUTS][16];
+
+		for (j = 0; j < LIST_BENCH_LAYOUTS; j++) {
+			const stress_list_bench_t *r = &results[i][j];
+
+			if (r->err || (r->elements <= 0.0)) {
+				(void)shim_strlcpy(buf[j], "-", sizeof(buf[j]));
+			} else {
+				const double ns = (r->secs * STRESS_DBL_NANOSECOND) / r->elements;
+				char str[64];
+
+				(void)snprintf(buf[j], sizeof(buf[j]), "%.3f", ns);
+				(void)snprintf(str, sizeof(str), "%s ns per element, length %zu",
+					stress_list_bench_layouts[j], lengths[i]);
+				stress_metrics_set(args, idx++, str, ns);
+			}
+		}
+		if (args->instance == 0)
+			pr_inf("%s: %8zu %9s %9s %9s %9s %9s\n", args->name, lengths[i],
+				buf[0], buf[1], buf[2], buf[3], buf[4]);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	return EXIT_SUCCESS;
+}
+
 static void stress_list_all(
 	const stress_args_t *args,
 	struct list_entry *entries,
@@ -496,6 +855,7 @@ static int stress_set_list_method(const char *name)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_list_bench,	stress_set_list_bench },
 	{ OPT_list_method,	stress_set_list_method },
 	{ OPT_list_size,	stress_set_list_size },
 	{ 0,			NULL }
@@ -514,6 +874,16 @@ static int stress_list(const stress_args_t *args)
 	int ret;
 	stress_metrics_t *metrics, list_metrics[SIZEOF_ARRAY(list_methods)];
 	stress_list_func func;
+	bool list_bench = false;
+
+	(void)stress_get_setting("list-bench", &list_bench);
+	if (list_bench) {
+		size_t max_length = LIST_BENCH_MAX_LENGTH;
+
+		if (stress_get_setting("list-size", &list_size))
+			max_length = STRESS_MAXIMUM((size_t)list_size, LIST_BENCH_MIN_LENGTH);
+		return stress_list_bench(args, max_length);
+	}
 
 	for (i = 0; i < SIZEOF_ARRAY(list_metrics); i++) {
 		list_metrics[i].duration = 0.0;
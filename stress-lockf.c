@@ -18,12 +18,17 @@
  *
  */
 #include "stress-ng.h"
+#include "core-lock-scale.h"
 
 static const stress_help_t help[] = {
-	{ NULL,	"lockf N",	  "start N workers locking a single file via lockf" },
-	{ NULL, "lockf-nonblock", "don't block if lock cannot be obtained, re-try" },
-	{ NULL,	"lockf-ops N",	  "stop after N lockf bogo operations" },
-	{ NULL, NULL,		NULL }
+	{ NULL,	"lockf N",		"start N workers locking a single file via lockf" },
+	{ NULL,	"lockf-files N",	"lock N files in scaling mode" },
+	{ NULL,	"lockf-nonblock",	"don't block if lock cannot be obtained, re-try" },
+	{ NULL,	"lockf-ops N",		"stop after N lockf bogo operations" },
+	{ NULL,	"lockf-overlap",	"lock byte ranges that overlap other processes in scaling mode" },
+	{ NULL,	"lockf-procs N",	"sweep from 1 up to N locking processes in scaling mode" },
+	{ NULL,	"lockf-scale",		"measure lock and unlock scaling over processes" },
+	{ NULL,	NULL,			NULL }
 };
 
 #if defined(HAVE_LOCKF)
@@ -52,8 +57,42 @@ static int stress_lockf_set_nonblock(const char *opt)
 	return stress_set_setting_true("lockf-nonblock", opt);
 }
 
+static int stress_set_lockf_files(const char *opt)
+{
+	uint32_t lockf_files;
+
+	lockf_files = stress_get_uint32(opt);
+	stress_check_range("lockf-files", (uint64_t)lockf_files,
+		MIN_LOCK_SCALE_FILES, MAX_LOCK_SCALE_FILES);
+	return stress_set_setting("lockf-files", TYPE_ID_UINT32, &lockf_files);
+}
+
+static int stress_set_lockf_overlap(const char *opt)
+{
+	return stress_set_setting_true("lockf-overlap", opt);
+}
+
+static int stress_set_lockf_procs(const char *opt)
+{
+	uint32_t lockf_procs;
+
+	lockf_procs = stress_get_uint32(opt);
+	stress_check_range("lockf-procs", (uint64_t)lockf_procs,
+		MIN_LOCK_SCALE_PROCS, MAX_LOCK_SCALE_PROCS);
+	return stress_set_setting("lockf-procs", TYPE_ID_UINT32, &lockf_procs);
+}
+
+static int stress_set_lockf_scale(const char *opt)
+{
+	return stress_set_setting_true("lockf-scale", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_lockf_files,	stress_set_lockf_files },
 	{ OPT_lockf_nonblock,   stress_lockf_set_nonblock },
+	{ OPT_lockf_overlap,	stress_set_lockf_overlap },
+	{ OPT_lockf_procs,	stress_set_lockf_procs },
+	{ OPT_lockf_scale,	stress_set_lockf_scale },
 	{ 0,			NULL }
 };
 
@@ -245,6 +284,18 @@ static int stress_lockf(const stress_args_t *args)
 	char buffer[4096];
 	off_t offset;
 	ssize_t rc;
+	uint32_t lockf_files = DEFAULT_LOCK_SCALE_FILES;
+	uint32_t lockf_procs = DEFAULT_LOCK_SCALE_PROCS;
+	bool lockf_scale = false;
+	bool lockf_overlap = false;
+
+	(void)stress_get_setting("lockf-scale", &lockf_scale);
+	if (lockf_scale) {
+		(void)stress_get_setting("lockf-files", &lockf_files);
+		(void)stress_get_setting("lockf-overlap", &lockf_overlap);
+		(void)stress_get_setting("lockf-procs", &lockf_procs);
+		return stress_lock_scale(args, STRESS_LOCK_SCALE_LOCKF, lockf_files, lockf_procs, lockf_overlap);
+	}
 
 	(void)memset(buffer, 0, sizeof(buffer));
 
@@ -18,11 +18,54 @@
  *
  */
 #include "stress-ng.h"
+#include "core-lock-scale.h"
 
 static const stress_help_t help[] = {
-	{ NULL, "lockofd N",	 "start N workers using open file description locking" },
-	{ NULL, "lockofd-ops N", "stop after N lockofd bogo operations" },
-	{ NULL, NULL,		 NULL }
+	{ NULL,	"lockofd N",		"start N workers using open file description locking" },
+	{ NULL,	"lockofd-files N",	"lock N files in scaling mode" },
+	{ NULL,	"lockofd-ops N",	"stop after N lockofd bogo operations" },
+	{ NULL,	"lockofd-overlap",	"lock byte ranges that overlap other processes in scaling mode" },
+	{ NULL,	"lockofd-procs N",	"sweep from 1 up to N locking processes in scaling mode" },
+	{ NULL,	"lockofd-scale",	"measure lock and unlock scaling over processes" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_lockofd_files(const char *opt)
+{
+	uint32_t lockofd_files;
+
+	lockofd_files = stress_get_uint32(opt);
+	stress_check_range("lockofd-files", (uint64_t)lockofd_files,
+		MIN_LOCK_SCALE_FILES, MAX_LOCK_SCALE_FILES);
+	return stress_set_setting("lockofd-files", TYPE_ID_UINT32, &lockofd_files);
+}
+
+static int stress_set_lockofd_overlap(const char *opt)
+{
+	return stress_set_setting_true("lockofd-overlap", opt);
+}
+
+static int stress_set_lockofd_procs(const char *opt)
+{
+	uint32_t lockofd_procs;
+
+	lockofd_procs = stress_get_uint32(opt);
+	stress_check_range("lockofd-procs", (uint64_t)lockofd_procs,
+		MIN_LOCK_SCALE_PROCS, MAX_LOCK_SCALE_PROCS);
+	return stress_set_setting("lockofd-procs", TYPE_ID_UINT32, &lockofd_procs);
+}
+
+static int stress_set_lockofd_scale(const char *opt)
+{
+	return stress_set_setting_true("lockofd-scale", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_lockofd_files,	stress_set_lockofd_files },
+	{ OPT_lockofd_overlap,	stress_set_lockofd_overlap },
+	{ OPT_lockofd_procs,	stress_set_lockofd_procs },
+	{ OPT_lockofd_scale,	stress_set_lockofd_scale },
+	{ 0,			NULL }
 };
 
 #if defined(F_OFD_GETLK) &&	\
@@ -220,6 +263,18 @@ static int stress_lockofd(const stress_args_t *args)
 	char buffer[4096];
 	off_t offset;
 	ssize_t rc;
+	uint32_t lockofd_files = DEFAULT_LOCK_SCALE_FILES;
+	uint32_t lockofd_procs = DEFAULT_LOCK_SCALE_PROCS;
+	bool lockofd_scale = false;
+	bool lockofd_overlap = false;
+
+	(void)stress_get_setting("lockofd-scale", &lockofd_scale);
+	if (lockofd_scale) {
+		(void)stress_get_setting("lockofd-files", &lockofd_files);
+		(void)stress_get_setting("lockofd-overlap", &lockofd_overlap);
+		(void)stress_get_setting("lockofd-procs", &lockofd_procs);
+		return stress_lock_scale(args, STRESS_LOCK_SCALE_OFD, lockofd_files, lockofd_procs, lockofd_overlap);
+	}
 
 	(void)memset(buffer, 0, sizeof(buffer));
 
@@ -320,6 +375,7 @@ tidy:
 stressor_info_t stress_lockofd_info = {
 	.stressor = stress_lockofd,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_ALWAYS,
 	.help = help
 };
@@ -327,6 +383,7 @@ stressor_info_t stress_lockofd_info = {
 stressor_info_t stress_lockofd_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without fcntl() F_OFD_GETLK, F_OFD_SETLK, F_OFD_SETLKW, F_WRLCK or F_UNLCK commands"
 };
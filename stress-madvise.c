@@ -19,12 +19,39 @@
  */
 #include "stress-ng.h"
 
+#define MIN_MADVISE_BENCH_BYTES		(16 * MB)
+#define MAX_MADVISE_BENCH_BYTES		(MAX_MEM_LIMIT)
+#define DEFAULT_MADVISE_BENCH_BYTES	(256 * MB)
+
 static const stress_help_t help[] = {
 	{ NULL,	"madvise N",	 "start N workers exercising madvise on memory" },
+	{ NULL,	"madvise-bench", "measure prefault strategies and huge page collapse" },
+	{ NULL,	"madvise-bench-bytes N", "size of each region made resident by --madvise-bench" },
 	{ NULL,	"madvise-ops N", "stop after N bogo madvise operations" },
 	{ NULL,	NULL,		 NULL }
 };
 
+static int stress_set_madvise_bench(const char *opt)
+{
+	return stress_set_setting_true("madvise-bench", opt);
+}
+
+static int stress_set_madvise_bench_bytes(const char *opt)
+{
+	size_t madvise_bench_bytes;
+
+	madvise_bench_bytes = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("madvise-bench-bytes", madvise_bench_bytes,
+		MIN_MADVISE_BENCH_BYTES, MAX_MADVISE_BENCH_BYTES);
+	return stress_set_setting("madvise-bench-bytes", TYPE_ID_SIZE_T, &madvise_bench_bytes);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_madvise_bench,		stress_set_madvise_bench },
+	{ OPT_madvise_bench_bytes,	stress_set_madvise_bench_bytes },
+	{ 0,				NULL }
+};
+
 #if defined(HAVE_MADVISE)
 
 #define NUM_MEM_RETRIES_MAX	(256)
@@ -443,6 +470,364 @@ static void stress_process_madvise(const pid_t pid, void *buf, const size_t sz)
 #endif
 }
 
+#if !defined(MADV_COLLAPSE) &&	\
+    defined(__linux__)
+#define MADV_COLLAPSE			(25)
+#endif
+
+#define MADVISE_BENCH_ALIGN		(2 * MB)
+#define MADVISE_BENCH_KHUGEPAGED_WAIT	(10.0)	/* max seconds waiting for khugepaged */
+
+#define MADVISE_BENCH_TOUCH		(0)
+#define MADVISE_BENCH_MAP_POPULATE	(1)
+#define MADVISE_BENCH_POPULATE_READ	(2)
+#define MADVISE_BENCH_POPULATE_WRITE	(3)
+#define MADVISE_BENCH_WILLNEED		(4)
+#define MADVISE_BENCH_COLLAPSE		(5)
+#define MADVISE_BENCH_PROCESS_COLLAPSE	(6)
+#define MADVISE_BENCH_KHUGEPAGED	(7)
+#define MADVISE_BENCH_METHODS		(8)
+
+/* prefault strategies are run with 4K pages and THP, collapses once */
+static const char * const madvise_bench_methods[] = {
+	"touch",
+	"map-populate",
+	"populate-read",
+	"populate-write",
+	"willneed+touch",
+	"collapse",
+	"process-collapse",
+	"khugepaged",
+};
+
+typedef struct {
+	double duration;	/* seconds to make the region resident */
+	double resident;	/* fraction of region resident */
+	double thp;		/* fraction of region in huge pages */
+	double runs;		/* runs measured */
+	bool failed;		/* not supported */
+} stress_madvise_bench_t;
+
+/*
+ *  stress_madvise_bench_smaps()
+ *	find the Rss and AnonHugePages in KB of the mapping at addr
+ */
+static void stress_madvise_bench_smaps(const void *addr, uint64_t *rss_kb, uint64_t *thp_kb)
+{
+	FILE *fp;
+	char buf[256];
+	bool found = false;
+
+	*rss_kb = 0;
+	*thp_kb = 0;
+	fp = fopen("/proc/self/smaps", "r");
+	if (!fp)
+		return;
+	while (fgets(buf, sizeof(buf), fp)) {
+		uintptr_t begin, end;
+		uint64_t kb;
+
+		if (sscanf(buf, "%" SCNxPTR "-%" SCNxPTR, &begin, &end) == 2) {
+			if (found)
+				break;
+			found = ((uintptr_t)addr >= begin) && ((uintptr_t)addr < end);
+			continue;
+		}
+		if (!found)
+			continue;
+		if (sscanf(buf, "Rss: %" SCNu64, &kb) == 1)
+			*rss_kb = kb;
+		else if (sscanf(buf, "AnonHugePages: %" SCNu64, &kb) == 1)
+			*thp_kb = kb;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_madvise_bench_map()
+ *	map a MADVISE_BENCH_ALIGN aligned region so it
+ *	can be fully backed by huge pages
+ */
+static void *stress_madvise_bench_map(const size_t sz, const int extra_flags, const bool thp)
+{
+	const size_t len = sz + MADVISE_BENCH_ALIGN;
+	uint8_t *ptr, *aligned;
+
+	ptr = (uint8_t *)mmap(NULL, len, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (ptr == MAP_FAILED)
+		return MAP_FAILED;
+	aligned = (uint8_t *)(((uintptr_t)ptr + MADVISE_BENCH_ALIGN - 1) & ~(uintptr_t)(MADVISE_BENCH_ALIGN - 1));
+	if (aligned > ptr)
+		(void)munmap((void *)ptr, (size_t)(aligned - ptr));
+	if ((size_t)(aligned - ptr) < MADVISE_BENCH_ALIGN)
+		(void)munmap((void *)(aligned + sz), MADVISE_BENCH_ALIGN - (size_t)(aligned - ptr));
+	if (extra_flags) {
+		/* populated by mmap, so THP advice is too late */
+		return mmap((void *)aligned, sz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | extra_flags, -1, 0);
+	}
+	ptr = (uint8_t *)mmap((void *)aligned, sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+	if (ptr == MAP_FAILED)
+		return MAP_FAILED;
+#if defined(MADV_HUGEPAGE)
+	if (thp)
+		(void)madvise((void *)ptr, sz, MADV_HUGEPAGE);
+#endif
+#if defined(MADV_NOHUGEPAGE)
+	if (!thp)
+		(void)madvise((void *)ptr, sz, MADV_NOHUGEPAGE);
+#endif
+	return (void *)ptr;
+}
+
+static void stress_madvise_bench_touch(uint8_t *ptr, const size_t sz, const size_t page_size)
+{
+	uint8_t *end = ptr + sz;
+
+	for (; ptr < end; ptr += page_size)
+		*(volatile uint8_t *)ptr = 1;
+}
+
+/*
+ *  stress_madvise_bench_prefault()
+ *	time making a region resident with a prefault strategy,
+ *	returns -1 if the strategy is not supported
+ */
+static int stress_madvise_bench_prefault(
+	const size_t sz,
+	const size_t page_size,
+	const int method,
+	const bool thp,
+	stress_madvise_bench_t *bench)
+{
+	uint8_t *ptr = MAP_FAILED;
+	uint64_t rss_kb, thp_kb;
+	double t;
+	int ret = 0;
+
+	t = stress_time_now();
+	switch (method) {
+	case MADVISE_BENCH_MAP_POPULATE:
+#if defined(MAP_POPULATE)
+		ptr = (uint8_t *)stress_madvise_bench_map(sz, MAP_POPULATE, thp);
+#endif
+		break;
+	default:
+		ptr = (uint8_t *)stress_madvise_bench_map(sz, 0, thp);
+		break;
+	}
+	if (ptr == MAP_FAILED)
+		return -1;
+
+	switch (method) {
+	case MADVISE_BENCH_TOUCH:
+		stress_madvise_bench_touch(ptr, sz, page_size);
+		break;
+	case MADVISE_BENCH_POPULATE_READ:
+#if defined(MADV_POPULATE_READ)
+		ret = madvise((void *)ptr, sz, MADV_POPULATE_READ);
+#else
+		ret = -1;
+#endif
+		break;
+	case MADVISE_BENCH_POPULATE_WRITE:
+#if defined(MADV_POPULATE_WRITE)
+		ret = madvise((void *)ptr, sz, MADV_POPULATE_WRITE);
+#else
+		ret = -1;
+#endif
+		break;
+	case MADVISE_BENCH_WILLNEED:
+#if defined(MADV_WILLNEED)
+		(void)madvise((void *)ptr, sz, MADV_WILLNEED);
+		stress_madvise_bench_touch(ptr, sz, page_size);
+#else
+		ret = -1;
+#endif
+		break;
+	default:
+		break;
+	}
+	t = stress_time_now() - t;
+	if (ret == 0) {
+		stress_madvise_bench_smaps(ptr, &rss_kb, &thp_kb);
+		bench->duration += t;
+		bench->resident += (double)(rss_kb * KB) / (double)sz;
+		bench->thp += (double)(thp_kb * KB) / (double)sz;
+		bench->runs += 1.0;
+	}
+	(void)munmap((void *)ptr, sz);
+	return ret;
+}
+
+/*
+ *  stress_madvise_bench_collapse()
+ *	make a region resident with 4K pages and time the collapse
+ *	into huge pages with MADV_COLLAPSE, process_madvise or by
+ *	waiting for khugepaged, returns -1 if not supported
+ */
+static int stress_madvise_bench_collapse(
+	const stress_args_t *args,
+	const size_t sz,
+	const int method,
+	stress_madvise_bench_t *bench)
+{
+	uint8_t *ptr;
+	uint64_t rss_kb, thp_kb = 0;
+	double t;
+	int ret = -1;
+
+	ptr = (uint8_t *)stress_madvise_bench_map(sz, 0, false);
+	if (ptr == MAP_FAILED)
+		return -1;
+	stress_madvise_bench_touch(ptr, sz, args->page_size);
+#if defined(MADV_HUGEPAGE)
+	/* allow huge pages now the region is resident with 4K pages */
+	(void)madvise((void *)ptr, sz, MADV_HUGEPAGE);
+#endif
+
+	t = stress_time_now();
+	switch (method) {
+	case MADVISE_BENCH_COLLAPSE:
+#if defined(MADV_COLLAPSE)
+		ret = madvise((void *)ptr, sz, MADV_COLLAPSE);
+#endif
+		break;
+	case MADVISE_BENCH_PROCESS_COLLAPSE:
+#if defined(MADV_COLLAPSE)
+		{
+			const int pidfd = shim_pidfd_open(getpid(), 0);
+			struct iovec vec;
+
+			if (pidfd >= 0) {
+				vec.iov_base = (void *)ptr;
+				vec.iov_len = sz;
+				ret = (shim_process_madvise(pidfd, &vec, 1, MADV_COLLAPSE, 0) == (ssize_t)sz) ? 0 : -1;
+				(void)close(pidfd);
+			}
+		}
+#endif
+		break;
+	default:
+#if defined(MADV_HUGEPAGE)
+		/* poll until fully collapsed or the wait is over */
+		ret = 0;
+		do {
+			(void)shim_usleep(100000);
+			stress_madvise_bench_smaps(ptr, &rss_kb, &thp_kb);
+		} while ((thp_kb * KB < sz) && keep_stressing(args) &&
+			 (stress_time_now() - t < MADVISE_BENCH_KHUGEPAGED_WAIT));
+#endif
+		break;
+	}
+	t = stress_time_now() - t;
+	if (ret == 0) {
+		stress_madvise_bench_smaps(ptr, &rss_kb, &thp_kb);
+		bench->duration += t;
+		bench->resident += (double)(rss_kb * KB) / (double)sz;
+		bench->thp += (double)(thp_kb * KB) / (double)sz;
+		bench->runs += 1.0;
+	}
+	(void)munmap((void *)ptr, sz);
+	return ret;
+}
+
+/*
+ *  stress_madvise_bench()
+ *	compare the time to make a region resident with each prefault
+ *	strategy with 4K pages and with THP, and the time and huge page
+ *	coverage of collapsing a 4K page region into huge pages
+ */
+static int stress_madvise_bench(const stress_args_t *args)
+{
+	stress_madvise_bench_t bench[MADVISE_BENCH_METHODS][2];
+	size_t sz = DEFAULT_MADVISE_BENCH_BYTES;
+	int method, thp;
+	size_t idx = 0;
+	bool khugepaged_done = false;
+
+	(void)stress_get_setting("madvise-bench-bytes", &sz);
+	sz = (sz / args->num_instances) & ~(size_t)(MADVISE_BENCH_ALIGN - 1);
+	if (sz < MADVISE_BENCH_ALIGN)
+		sz = MADVISE_BENCH_ALIGN;
+	(void)memset(bench, 0, sizeof(bench));
+
+	/* Make sure this is killable by OOM killer */
+	stress_set_oom_adjustment(args->name, true);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (method = 0; method < MADVISE_BENCH_COLLAPSE; method++) {
+			for (thp = 0; thp < 2; thp++) {
+				/* MAP_POPULATE uses the system THP setting */
+				if (bench[method][thp].failed ||
+				    ((method == MADVISE_BENCH_MAP_POPULATE) && thp))
+					continue;
+				if (stress_madvise_bench_prefault(sz, args->page_size, method, thp, &bench[method][thp]) < 0)
+					bench[method][thp].failed = true;
+				if (!keep_stressing(args))
+					goto deinit;
+			}
+		}
+		for (method = MADVISE_BENCH_COLLAPSE; method < MADVISE_BENCH_METHODS; method++) {
+			/* khugepaged is slow, it is only measured once */
+			if (bench[method][1].failed ||
+			    ((method == MADVISE_BENCH_KHUGEPAGED) && khugepaged_done))
+				continue;
+			if (stress_madvise_bench_collapse(args, sz, method, &bench[method][1]) < 0)
+				bench[method][1].failed = true;
+			if (method == MADVISE_BENCH_KHUGEPAGED)
+				khugepaged_done = true;
+			if (!keep_stressing(args))
+				goto deinit;
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+deinit:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: making %zu MB resident:\n", args->name, sz / (size_t)MB);
+		pr_inf("%s: %-16s %-5s %10s %9s %9s %7s\n", args->name,
+			"method", "pages", "seconds", "GB/sec", "resident", "THP");
+	}
+	for (method = 0; method < MADVISE_BENCH_METHODS; method++) {
+		for (thp = 0; thp < 2; thp++) {
+			const stress_madvise_bench_t *b = &bench[method][thp];
+			const char *pages = (method >= MADVISE_BENCH_COLLAPSE) ? "4K>2M" :
+				((method == MADVISE_BENCH_MAP_POPULATE) ? "sys" : (thp ? "THP" : "4K"));
+			double duration, rate;
+			char desc[64];
+
+			if (((method >= MADVISE_BENCH_COLLAPSE) && !thp) ||
+			    ((method == MADVISE_BENCH_MAP_POPULATE) && thp))
+				continue;
+			if (b->runs <= 0.0) {
+				if (args->instance == 0)
+					pr_inf("%s: %-16s %-5s %10s %9s %9s %7s\n", args->name,
+						madvise_bench_methods[method], pages, "-", "-", "-", "-");
+				continue;
+			}
+			duration = b->duration / b->runs;
+			rate = (duration > 0.0) ? ((double)sz / (double)GB) / duration : 0.0;
+			if (args->instance == 0)
+				pr_inf("%s: %-16s %-5s %10.4f %9.2f %8.1f%% %6.1f%%\n", args->name,
+					madvise_bench_methods[method], pages, duration, rate,
+					100.0 * b->resident / b->runs, 100.0 * b->thp / b->runs);
+			(void)snprintf(desc, sizeof(desc), "%s %s seconds", madvise_bench_methods[method], pages);
+			stress_metrics_set(args, idx++, desc, duration);
+			(void)snprintf(desc, sizeof(desc), "%s %s THP %%", madvise_bench_methods[method], pages);
+			stress_metrics_set(args, idx++, desc, 100.0 * b->thp / b->runs);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_madvise()
  *	stress madvise
@@ -461,12 +846,17 @@ static int stress_madvise(const stress_args_t *args)
 	char *page;
 	size_t n;
 	madvise_ctxt_t ctxt;
+	bool madvise_bench = false;
 #if defined(MADV_FREE)
 	NOCLOBBER uint64_t madv_frees_raced;
 	NOCLOBBER uint64_t madv_frees;
 	NOCLOBBER uint8_t madv_tries;
 #endif
 
+	(void)stress_get_setting("madvise-bench", &madvise_bench);
+	if (madvise_bench)
+		return stress_madvise_bench(args);
+
 	flags = MAP_PRIVATE;
 	num_mem_retries = 0;
 #if defined(MADV_FREE)
@@ -688,12 +1078,14 @@ madv_free_out:
 stressor_info_t stress_madvise_info = {
 	.stressor = stress_madvise,
 	.class = CLASS_VM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_madvise_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_VM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without madvise() system call"
 };
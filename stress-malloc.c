@@ -37,6 +37,9 @@
 
 #define MAX_MALLOC_PTHREADS	(32)
 
+#define MAX_MALLOC_SIZES	(4096)	/* size histogram entries */
+#define MALLOC_BATCH		(1024)	/* workload ops between counter updates */
+
 #define MK_ALIGN(x)	(1U << (3 + ((x) & 7)))
 
 typedef struct {
@@ -62,6 +65,15 @@ static sigjmp_buf jmp_env;		/* SIGSEGV jmp environment */
 
 static void (*free_func)(void *ptr, size_t len);
 
+/* size histogram, cumulative weights for binary search */
+static size_t *malloc_sizes;		/* allocation sizes */
+static uint64_t *malloc_weights;	/* cumulative weights */
+static size_t malloc_sizes_n;		/* number of histogram entries */
+
+static size_t malloc_rss_start;		/* RSS before any workload allocations */
+static size_t malloc_rss_end;		/* RSS at the end of the workload */
+static int64_t malloc_live_end;		/* live bytes at the end of the workload */
+
 #if defined(HAVE_LIB_PTHREAD)
 /* per pthread data */
 typedef struct {
@@ -73,7 +85,15 @@ typedef struct {
 typedef struct {
 	const stress_args_t *args;			/* args info */
 	size_t instance;				/* per thread instance number */
-} stress_malloc_args_t;
+	uint64_t allocs;				/* successful allocations */
+	int64_t live;					/* bytes allocated less bytes freed */
+	double duration;				/* workload run time */
+} ALIGN64 stress_malloc_args_t;
+
+typedef struct {
+	const char *name;
+	void (*func)(stress_malloc_args_t *malloc_args);
+} stress_malloc_workload_t;
 
 static const stress_help_t help[] = {
 	{ NULL,	"malloc N",		"start N workers exercising malloc/realloc/free" },
@@ -81,8 +101,10 @@ static const stress_help_t help[] = {
 	{ NULL,	"malloc-max N",		"keep up to N allocations at a time" },
 	{ NULL,	"malloc-ops N",		"stop after N malloc bogo operations" },
 	{ NULL, "malloc-pthreads N",	"number of pthreads to run concurrently" },
+	{ NULL,	"malloc-sizes F",	"read allocation size histogram from file F" },
 	{ NULL,	"malloc-thresh N",	"threshold where malloc uses mmap instead of sbrk" },
 	{ NULL, "malloc-touch",		"touch pages force pages to be populated" },
+	{ NULL,	"malloc-workload W",	"workload, one of random, lifo, fifo, larson or xmalloc" },
 	{ NULL,	"malloc-zerofree",	"zero free'd memory" },
 	{ NULL,	NULL,			NULL }
 };
@@ -127,11 +149,18 @@ static int stress_set_malloc_pthreads(const char *opt)
 	return stress_set_setting("malloc-pthreads", TYPE_ID_SIZE_T, &npthreads);
 }
 
+static int stress_set_malloc_sizes(const char *opt)
+{
+	return stress_set_setting("malloc-sizes", TYPE_ID_STR, opt);
+}
+
 static int stress_set_malloc_touch(const char *opt)
 {
 	return stress_set_setting_true("malloc-touch", opt);
 }
 
+static int stress_set_malloc_workload(const char *opt);
+
 static int stress_set_malloc_zerofree(const char *opt)
 {
 	return stress_set_setting_true("malloc-zerofree", opt);
@@ -172,6 +201,117 @@ static inline size_t stress_alloc_size(const size_t size)
 	return (len >= min_size) ? len : min_size;
 }
 
+/*
+ *  stress_malloc_size()
+ *	get a new allocation size from the size histogram,
+ *	or uniformly up to malloc_bytes if there is none
+ */
+static inline size_t stress_malloc_size(void)
+{
+	uint64_t w;
+	size_t lo, hi;
+
+	if (!malloc_sizes_n)
+		return stress_alloc_size(malloc_bytes);
+
+	w = stress_mwc64modn(malloc_weights[malloc_sizes_n - 1]);
+	lo = 0;
+	hi = malloc_sizes_n - 1;
+	while (lo < hi) {
+		const size_t mid = (lo + hi) / 2;
+
+		if (malloc_weights[mid] > w)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return malloc_sizes[lo];
+}
+
+/*
+ *  stress_malloc_sizes_load()
+ *	load the allocation size histogram, one size and optional
+ *	weight (default 1) per line, # starts a comment
+ */
+static int stress_malloc_sizes_load(const stress_args_t *args, const char *filename)
+{
+	FILE *fp;
+	char buf[256];
+	int line = 0, rc = EXIT_SUCCESS;
+	uint64_t total = 0;
+
+	malloc_sizes = calloc(MAX_MALLOC_SIZES, sizeof(*malloc_sizes));
+	malloc_weights = calloc(MAX_MALLOC_SIZES, sizeof(*malloc_weights));
+	if (!malloc_sizes || !malloc_weights) {
+		pr_inf_skip("%s: cannot allocate size histogram, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	fp = fopen(filename, "r");
+	if (!fp) {
+		pr_err("%s: cannot open malloc-sizes file %s, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	while (fgets(buf, sizeof(buf), fp)) {
+		unsigned long long int size, weight = 1;
+		char *ptr = strchr(buf, '#');
+		int n;
+
+		line++;
+		if (ptr)
+			*ptr = '\0';
+		n = sscanf(buf, "%llu %llu", &size, &weight);
+		if (n < 1)
+			continue;
+		if ((size < sizeof(uintptr_t)) || (size > MAX_MALLOC_BYTES)) {
+			pr_err("%s: %s line %d: size %llu out of range %zu..%zu bytes\n",
+				args->name, filename, line, size,
+				sizeof(uintptr_t), (size_t)MAX_MALLOC_BYTES);
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (weight == 0)
+			continue;
+		if (malloc_sizes_n >= MAX_MALLOC_SIZES) {
+			pr_err("%s: %s has more than %d sizes\n",
+				args->name, filename, MAX_MALLOC_SIZES);
+			rc = EXIT_FAILURE;
+			break;
+		}
+		total += (uint64_t)weight;
+		malloc_sizes[malloc_sizes_n] = (size_t)size;
+		malloc_weights[malloc_sizes_n] = total;
+		malloc_sizes_n++;
+	}
+	(void)fclose(fp);
+
+	if ((rc == EXIT_SUCCESS) && (malloc_sizes_n == 0)) {
+		pr_err("%s: %s contains no allocation sizes\n", args->name, filename);
+		rc = EXIT_FAILURE;
+	}
+	return rc;
+}
+
+/*
+ *  stress_malloc_rss()
+ *	current resident set size in bytes, 0 if not known
+ */
+static size_t stress_malloc_rss(const size_t page_size)
+{
+	FILE *fp;
+	unsigned long int size, resident;
+	int n;
+
+	fp = fopen("/proc/self/statm", "r");
+	if (!fp)
+		return 0;
+	n = fscanf(fp, "%lu %lu", &size, &resident);
+	(void)fclose(fp);
+
+	return (n == 2) ? (size_t)resident * page_size : 0;
+}
+
 static void stress_malloc_page_touch(
 	uint8_t *buffer,
 	const size_t size,
@@ -188,20 +328,43 @@ static void stress_malloc_page_touch(
 	}
 }
 
-static void *stress_malloc_loop(void *ptr)
+/*
+ *  stress_malloc_sample()
+ *	the main thread samples the RSS and live bytes at the end of
+ *	a workload while all the other threads are still running it
+ */
+static void stress_malloc_sample(const stress_malloc_args_t *malloc_args)
+{
+	const stress_malloc_args_t *all = malloc_args - malloc_args->instance;
+	size_t i;
+
+	if (malloc_args->instance)
+		return;
+	malloc_rss_end = stress_malloc_rss(malloc_args->args->page_size);
+	malloc_live_end = 0;
+	for (i = 0; i <= malloc_pthreads; i++)
+		malloc_live_end += all[i].live;
+}
+
+/*
+ *  stress_malloc_random()
+ *	random mix of allocations, reallocations and frees of slots
+ */
+static void stress_malloc_random(stress_malloc_args_t *malloc_args)
 {
-	const stress_malloc_args_t *malloc_args = (stress_malloc_args_t *)ptr;
 	const stress_args_t *args = malloc_args->args;
 	const size_t page_size = args->page_size;
-	static void *nowt = NULL;
 	size_t j;
 	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
 	stress_malloc_info_t *info = (stress_malloc_info_t *)calloc(malloc_max, sizeof(*info));
+	double t;
+
 	if (!info) {
 		pr_dbg("%s: cannot allocate address buffer: %d (%s)\n",
 			args->name, errno, strerror(errno));
-		return &nowt;
+		return;
 	}
+	t = stress_time_now();
 	for (;;) {
 		const unsigned int rnd = stress_mwc32();
 		const unsigned int i = rnd % malloc_max;
@@ -234,6 +397,7 @@ static void *stress_malloc_loop(void *ptr)
 						args->name, (void *)info[i].addr);
 				}
 				free_func(info[i].addr, info[i].len);
+				malloc_args->live -= (int64_t)info[i].len;
 				info[i].addr = NULL;
 				info[i].len = 0;
 
@@ -241,10 +405,12 @@ static void *stress_malloc_loop(void *ptr)
 					break;
 			} else {
 				void *tmp;
-				const size_t len = stress_alloc_size(malloc_bytes);
+				const size_t len = stress_malloc_size();
 
 				tmp = realloc(info[i].addr, len);
 				if (tmp) {
+					malloc_args->allocs++;
+					malloc_args->live += (int64_t)len - (int64_t)info[i].len;
 					info[i].addr = tmp;
 					info[i].len = len;
 
@@ -261,7 +427,7 @@ static void *stress_malloc_loop(void *ptr)
 		} else {
 			/* 50% free, 50% alloc */
 			if (action && !low_mem) {
-				size_t n, len = stress_alloc_size(malloc_bytes);
+				size_t n, len = stress_malloc_size();
 
 				switch (do_calloc) {
 				case 0:
@@ -297,6 +463,8 @@ static void *stress_malloc_loop(void *ptr)
 					stress_malloc_page_touch((void *)info[i].addr, len, page_size);
 					*info[i].addr = (uintptr_t)info[i].addr;	/* stash address */
 					info[i].len = len;
+					malloc_args->allocs++;
+					malloc_args->live += (int64_t)len;
 					if (!inc_counter_lock(args, counter_lock, true))
 						break;
 				} else {
@@ -309,6 +477,8 @@ static void *stress_malloc_loop(void *ptr)
 			(void)malloc_trim(0);
 #endif
 	}
+	malloc_args->duration = stress_time_now() - t;
+	stress_malloc_sample(malloc_args);
 
 	for (j = 0; j < malloc_max; j++) {
 		if (verify && info[j].addr && (uintptr_t)info[j].addr != *info[j].addr) {
@@ -318,6 +488,284 @@ static void *stress_malloc_loop(void *ptr)
 		free_func(info[j].addr, info[j].len);
 	}
 	free(info);
+}
+
+/*
+ *  stress_malloc_wl_alloc()
+ *	workload allocation of a size from the size distribution,
+ *	the first word holds the address for verification
+ */
+static inline void stress_malloc_wl_alloc(
+	stress_malloc_args_t *malloc_args,
+	stress_malloc_info_t *info)
+{
+	const size_t len = stress_malloc_size();
+
+	info->addr = malloc(len);
+	if (UNLIKELY(!info->addr)) {
+		info->len = 0;
+		return;
+	}
+	if (malloc_touch)
+		stress_malloc_page_touch((void *)info->addr, len, malloc_args->args->page_size);
+	*info->addr = (uintptr_t)info->addr;
+	info->len = len;
+	malloc_args->allocs++;
+	malloc_args->live += (int64_t)len;
+}
+
+/*
+ *  stress_malloc_wl_free()
+ *	workload free, the allocation may be from another thread
+ */
+static inline void stress_malloc_wl_free(
+	stress_malloc_args_t *malloc_args,
+	stress_malloc_info_t *info)
+{
+	if (!info->addr)
+		return;
+	if ((g_opt_flags & OPT_FLAGS_VERIFY) && ((uintptr_t)info->addr != *info->addr)) {
+		pr_fail("%s: allocation at %p does not contain correct value\n",
+			malloc_args->args->name, (void *)info->addr);
+	}
+	free_func(info->addr, info->len);
+	malloc_args->live -= (int64_t)info->len;
+	info->addr = NULL;
+	info->len = 0;
+}
+
+/*
+ *  stress_malloc_wl_continue()
+ *	account a batch of allocations and check if the workload
+ *	should keep running
+ */
+static inline bool stress_malloc_wl_continue(
+	stress_malloc_args_t *malloc_args,
+	uint64_t *allocs)
+{
+	const stress_args_t *args = malloc_args->args;
+
+	add_counter_lock(args, counter_lock, (int64_t)(malloc_args->allocs - *allocs));
+	*allocs = malloc_args->allocs;
+#if defined(HAVE_LIB_PTHREAD)
+	if (!keep_thread_running_flag)
+		return false;
+#endif
+	return inc_counter_lock(args, counter_lock, false);
+}
+
+static void stress_malloc_wl_free_all(
+	stress_malloc_args_t *malloc_args,
+	stress_malloc_info_t *info,
+	const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		stress_malloc_wl_free(malloc_args, &info[i]);
+}
+
+/*
+ *  stress_malloc_lifo()
+ *	allocate malloc-max blocks and free them in reverse order,
+ *	stack like lifetimes
+ */
+static void stress_malloc_lifo(stress_malloc_args_t *malloc_args)
+{
+	stress_malloc_info_t *info = (stress_malloc_info_t *)calloc(malloc_max, sizeof(*info));
+	uint64_t allocs = 0;
+	double t;
+	bool run = true;
+
+	if (!info)
+		return;
+	t = stress_time_now();
+	while (run) {
+		size_t i;
+
+		for (i = 0; run && (i < malloc_max); i++) {
+			stress_malloc_wl_alloc(malloc_args, &info[i]);
+			if ((i & (MALLOC_BATCH - 1)) == MALLOC_BATCH - 1)
+				run = stress_malloc_wl_continue(malloc_args, &allocs);
+		}
+		if (!run)
+			break;
+		while (i-- > 0)
+			stress_malloc_wl_free(malloc_args, &info[i]);
+		run = stress_malloc_wl_continue(malloc_args, &allocs);
+	}
+	malloc_args->duration = stress_time_now() - t;
+	stress_malloc_sample(malloc_args);
+	stress_malloc_wl_free_all(malloc_args, info, malloc_max);
+	free(info);
+}
+
+/*
+ *  stress_malloc_fifo()
+ *	keep malloc-max blocks live, each new allocation frees the
+ *	oldest, queue like lifetimes
+ */
+static void stress_malloc_fifo(stress_malloc_args_t *malloc_args)
+{
+	stress_malloc_info_t *info = (stress_malloc_info_t *)calloc(malloc_max, sizeof(*info));
+	uint64_t allocs = 0;
+	size_t i = 0;
+	double t;
+
+	if (!info)
+		return;
+	t = stress_time_now();
+	do {
+		size_t j;
+
+		for (j = 0; j < MALLOC_BATCH; j++) {
+			stress_malloc_wl_free(malloc_args, &info[i]);
+			stress_malloc_wl_alloc(malloc_args, &info[i]);
+			i = (i + 1 == malloc_max) ? 0 : i + 1;
+		}
+	} while (stress_malloc_wl_continue(malloc_args, &allocs));
+	malloc_args->duration = stress_time_now() - t;
+	stress_malloc_sample(malloc_args);
+	stress_malloc_wl_free_all(malloc_args, info, malloc_max);
+	free(info);
+}
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ATOMIC) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE)
+#define HAVE_MALLOC_CROSS_THREAD
+
+/* larson: a spare slot set threads swap their own set with */
+static stress_malloc_info_t *malloc_larson_spare;
+
+/*
+ *  xmalloc: single producer single consumer FIFO of allocations,
+ *  thread n produces into ring n, thread n + 1 consumes and frees
+ */
+typedef struct {
+	uint64_t head ALIGN64;		/* consumer index */
+	uint64_t tail ALIGN64;		/* producer index */
+	stress_malloc_info_t *info;	/* malloc-max allocations */
+} stress_malloc_ring_t;
+
+static stress_malloc_ring_t *malloc_rings;
+
+/*
+ *  stress_malloc_larson()
+ *	modelled on the larson server benchmark, replace a random
+ *	slot in a set of malloc-max slots and regularly exchange the
+ *	set with the spare set, so blocks are freed by a thread other
+ *	than the one that allocated them
+ */
+static void stress_malloc_larson(stress_malloc_args_t *malloc_args)
+{
+	stress_malloc_info_t *info = (stress_malloc_info_t *)calloc(malloc_max, sizeof(*info));
+	uint64_t allocs = 0;
+	size_t rounds = 0;
+	double t;
+
+	if (!info)
+		return;
+	t = stress_time_now();
+	do {
+		size_t j;
+
+		for (j = 0; j < MALLOC_BATCH; j++) {
+			const size_t i = (size_t)stress_mwc32modn((uint32_t)malloc_max);
+
+			stress_malloc_wl_free(malloc_args, &info[i]);
+			stress_malloc_wl_alloc(malloc_args, &info[i]);
+		}
+		/* hand over the set after about malloc-max replacements */
+		if (++rounds * MALLOC_BATCH >= malloc_max) {
+			rounds = 0;
+			info = __atomic_exchange_n(&malloc_larson_spare, info, __ATOMIC_ACQ_REL);
+		}
+	} while (stress_malloc_wl_continue(malloc_args, &allocs));
+	malloc_args->duration = stress_time_now() - t;
+	stress_malloc_sample(malloc_args);
+	stress_malloc_wl_free_all(malloc_args, info, malloc_max);
+	free(info);
+}
+
+/*
+ *  stress_malloc_xmalloc()
+ *	modelled on xmalloc-test, producer consumer pairs where each
+ *	thread allocates blocks for its successor to free and frees
+ *	blocks allocated by its predecessor
+ */
+static void stress_malloc_xmalloc(stress_malloc_args_t *malloc_args)
+{
+	const size_t n = malloc_pthreads + 1;
+	const size_t self = malloc_args->instance;
+	stress_malloc_ring_t *produce = &malloc_rings[self];
+	stress_malloc_ring_t *consume = &malloc_rings[(self + n - 1) % n];
+	uint64_t allocs = 0;
+	double t;
+
+	t = stress_time_now();
+	do {
+		size_t j;
+
+		for (j = 0; j < MALLOC_BATCH; j++) {
+			const uint64_t tail = __atomic_load_n(&produce->tail, __ATOMIC_RELAXED);
+			const uint64_t head = __atomic_load_n(&consume->head, __ATOMIC_RELAXED);
+
+			if (tail - __atomic_load_n(&produce->head, __ATOMIC_ACQUIRE) < malloc_max) {
+				stress_malloc_wl_alloc(malloc_args, &produce->info[tail % malloc_max]);
+				__atomic_store_n(&produce->tail, tail + 1, __ATOMIC_RELEASE);
+			} else {
+				/* consumer is not keeping up, free locally */
+				stress_malloc_info_t info;
+
+				stress_malloc_wl_alloc(malloc_args, &info);
+				stress_malloc_wl_free(malloc_args, &info);
+			}
+			if (head != __atomic_load_n(&consume->tail, __ATOMIC_ACQUIRE)) {
+				stress_malloc_wl_free(malloc_args, &consume->info[head % malloc_max]);
+				__atomic_store_n(&consume->head, head + 1, __ATOMIC_RELEASE);
+			}
+		}
+	} while (stress_malloc_wl_continue(malloc_args, &allocs));
+	malloc_args->duration = stress_time_now() - t;
+	stress_malloc_sample(malloc_args);
+}
+#endif
+
+static const stress_malloc_workload_t malloc_workloads[] = {
+	{ "random",	stress_malloc_random },
+	{ "lifo",	stress_malloc_lifo },
+	{ "fifo",	stress_malloc_fifo },
+#if defined(HAVE_MALLOC_CROSS_THREAD)
+	{ "larson",	stress_malloc_larson },
+	{ "xmalloc",	stress_malloc_xmalloc },
+#endif
+};
+
+static const stress_malloc_workload_t *malloc_workload = &malloc_workloads[0];
+
+static int stress_set_malloc_workload(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(malloc_workloads); i++) {
+		if (!strcmp(opt, malloc_workloads[i].name))
+			return stress_set_setting("malloc-workload", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "malloc-workload must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(malloc_workloads); i++)
+		(void)fprintf(stderr, " %s", malloc_workloads[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static void *stress_malloc_loop(void *ptr)
+{
+	static void *nowt = NULL;
+
+	malloc_workload->func((stress_malloc_args_t *)ptr);
 
 	return &nowt;
 }
@@ -332,6 +780,94 @@ static void MLOCKED_TEXT stress_malloc_sigsegv_handler(int signum)
 	}
 }
 
+#if defined(HAVE_MALLOC_CROSS_THREAD)
+/*
+ *  stress_malloc_cross_thread_init()
+ *	allocate the larson spare set and xmalloc rings
+ */
+static int stress_malloc_cross_thread_init(const stress_args_t *args)
+{
+	size_t i;
+
+	if (malloc_workload->func == stress_malloc_larson) {
+		malloc_larson_spare = calloc(malloc_max, sizeof(*malloc_larson_spare));
+		if (!malloc_larson_spare)
+			goto fail;
+	} else if (malloc_workload->func == stress_malloc_xmalloc) {
+		malloc_rings = calloc(malloc_pthreads + 1, sizeof(*malloc_rings));
+		if (!malloc_rings)
+			goto fail;
+		for (i = 0; i <= malloc_pthreads; i++) {
+			malloc_rings[i].info = calloc(malloc_max, sizeof(*malloc_rings[i].info));
+			if (!malloc_rings[i].info)
+				goto fail;
+		}
+	}
+	return 0;
+fail:
+	pr_inf_skip("%s: cannot allocate %s workload data, skipping stressor\n",
+		args->name, malloc_workload->name);
+	return -1;
+}
+
+/*
+ *  stress_malloc_cross_thread_deinit()
+ *	free the allocations left in the larson spare set and
+ *	xmalloc rings once all the threads have finished
+ */
+static void stress_malloc_cross_thread_deinit(stress_malloc_args_t *malloc_args)
+{
+	size_t i;
+
+	if (malloc_larson_spare) {
+		stress_malloc_wl_free_all(malloc_args, malloc_larson_spare, malloc_max);
+		free(malloc_larson_spare);
+		malloc_larson_spare = NULL;
+	}
+	if (malloc_rings) {
+		for (i = 0; i <= malloc_pthreads; i++) {
+			if (!malloc_rings[i].info)
+				continue;
+			stress_malloc_wl_free_all(malloc_args, malloc_rings[i].info, malloc_max);
+			free(malloc_rings[i].info);
+		}
+		free(malloc_rings);
+		malloc_rings = NULL;
+	}
+}
+#endif
+
+/*
+ *  stress_malloc_metrics()
+ *	report the workload rates, RSS growth and the fraction of
+ *	that growth not accounted for by live allocations
+ */
+static void stress_malloc_metrics(
+	const stress_args_t *args,
+	const stress_malloc_args_t *malloc_args,
+	const size_t n)
+{
+	uint64_t allocs = 0;
+	double duration = malloc_args[0].duration, rate;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		allocs += malloc_args[i].allocs;
+	rate = (duration > 0.0) ? (double)allocs / duration : 0.0;
+	stress_metrics_set(args, 0, "allocations per sec", rate);
+
+	if (malloc_rss_start && malloc_rss_end) {
+		const double growth = (malloc_rss_end > malloc_rss_start) ?
+			(double)(malloc_rss_end - malloc_rss_start) : 0.0;
+		const double live = (malloc_live_end > 0) ? (double)malloc_live_end : 0.0;
+
+		stress_metrics_set(args, 1, "RSS growth MB", growth / (double)MB);
+		stress_metrics_set(args, 2, "live allocations MB", live / (double)MB);
+		stress_metrics_set(args, 3, "RSS not live allocations %",
+			(growth > live) ? 100.0 * (growth - live) / growth : 0.0);
+	}
+}
+
 static int stress_malloc_child(const stress_args_t *args, void *context)
 {
 	int ret;
@@ -362,6 +898,15 @@ static int stress_malloc_child(const stress_args_t *args, void *context)
 
 	(void)context;
 
+#if defined(HAVE_MALLOC_CROSS_THREAD)
+	if (stress_malloc_cross_thread_init(args) < 0) {
+		stress_malloc_cross_thread_deinit(&malloc_args[0]);
+		return EXIT_NO_RESOURCE;
+	}
+#endif
+	malloc_rss_start = stress_malloc_rss(args->page_size);
+	malloc_rss_end = 0;
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 #if defined(HAVE_LIB_PTHREAD)
@@ -371,14 +916,14 @@ static int stress_malloc_child(const stress_args_t *args, void *context)
 		malloc_args[j + 1].args = args;
 		malloc_args[j + 1].instance = j + 1;
 		pthreads[j].ret = pthread_create(&pthreads[j].pthread, NULL,
-			stress_malloc_loop, (void *)&malloc_args);
+			stress_malloc_loop, (void *)&malloc_args[j + 1]);
 	}
 #else
 	if ((args->instance == 0) && (malloc_pthreads > 0))
 		pr_inf("%s: pthreads not supported, ignoring the "
 			"--malloc-pthreads option\n", args->name);
 #endif
-	stress_malloc_loop(&malloc_args);
+	stress_malloc_loop(&malloc_args[0]);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 #if defined(HAVE_LIB_PTHREAD)
@@ -396,6 +941,10 @@ static int stress_malloc_child(const stress_args_t *args, void *context)
 		}
 	}
 #endif
+#if defined(HAVE_MALLOC_CROSS_THREAD)
+	stress_malloc_cross_thread_deinit(&malloc_args[0]);
+#endif
+	stress_malloc_metrics(args, malloc_args, malloc_pthreads + 1);
 
 	return EXIT_SUCCESS;
 }
@@ -409,6 +958,8 @@ static int stress_malloc(const stress_args_t *args)
 {
 	int ret;
 	bool malloc_zerofree = false;
+	char *malloc_sizes_file = NULL;
+	size_t workload = 0;
 
 	counter_lock = stress_lock_create();
 	if (!counter_lock) {
@@ -449,9 +1000,23 @@ static int stress_malloc(const stress_args_t *args)
 	(void)stress_get_setting("malloc-touch", &malloc_touch);
 	(void)stress_get_setting("malloc-zerofree", &malloc_zerofree);
 	free_func = malloc_zerofree ? stress_malloc_zerofree : stress_malloc_free;
+	(void)stress_get_setting("malloc-workload", &workload);
+	if (workload < SIZEOF_ARRAY(malloc_workloads))
+		malloc_workload = &malloc_workloads[workload];
 
-	ret = stress_oomable_child(args, NULL, stress_malloc_child, STRESS_OOMABLE_NORMAL);
+	malloc_sizes_n = 0;
+	if (stress_get_setting("malloc-sizes", &malloc_sizes_file)) {
+		ret = stress_malloc_sizes_load(args, malloc_sizes_file);
+		if (ret != EXIT_SUCCESS)
+			goto done;
+	}
 
+	ret = stress_oomable_child(args, NULL, stress_malloc_child, STRESS_OOMABLE_NORMAL);
+done:
+	free(malloc_weights);
+	free(malloc_sizes);
+	malloc_weights = NULL;
+	malloc_sizes = NULL;
 	(void)stress_lock_destroy(counter_lock);
 
 	return ret;
@@ -461,8 +1026,10 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_malloc_max,	stress_set_malloc_max },
 	{ OPT_malloc_bytes,	stress_set_malloc_bytes },
 	{ OPT_malloc_pthreads,	stress_set_malloc_pthreads },
+	{ OPT_malloc_sizes,	stress_set_malloc_sizes },
 	{ OPT_malloc_threshold,	stress_set_malloc_threshold },
 	{ OPT_malloc_touch,	stress_set_malloc_touch },
+	{ OPT_malloc_workload,	stress_set_malloc_workload },
 	{ OPT_malloc_zerofree,	stress_set_malloc_zerofree },
 	{ 0,			NULL }
 };
@@ -20,11 +20,31 @@
 #include "stress-ng.h"
 #include "core-put.h"
 #include "core-target-clones.h"
+#include "core-vecmath.h"
 
 #define MIN_MATRIX3D_SIZE	(16)
 #define MAX_MATRIX3D_SIZE	(1024)
 #define DEFAULT_MATRIX3D_SIZE	(128)
 
+#define MATRIX3D_BLOCK		(64)	/* cache blocking tile size */
+
+/*
+ *  The half precision methods are only built when the compiler has
+ *  the type and the build targets an ISA with native half precision
+ *  vector arithmetic (bf16: conversions), e.g. -march=sapphirerapids,
+ *  otherwise the operations are emulated one element at a time
+ */
+#if defined(HAVE_FLOAT_FLOAT16) &&			\
+    ((defined(__AVX512FP16__) && defined(__AVX512VL__)) ||	\
+     defined(__ARM_FEATURE_FP16_VECTOR_ARITHMETIC))
+#define HAVE_MATRIX_F16
+#endif
+#if defined(HAVE_BFLOAT16) &&				\
+    (defined(__AVX512BF16__) ||				\
+     defined(__ARM_FEATURE_BF16))
+#define HAVE_MATRIX_BF16
+#endif
+
 static const stress_help_t help[] = {
 	{ NULL,	"matrix-3d N",		"start N workers exercising 3D matrix operations" },
 	{ NULL,	"matrix-3d-method M",	"specify 3D matrix stress method M, default is all" },
@@ -51,6 +71,8 @@ typedef void (*stress_matrix_3d_func)(
 typedef struct {
 	const char			*name;		/* human readable form of stressor */
 	const stress_matrix_3d_func	func[2];	/* method functions, x by y by z, z by y by x */
+	const bool			gemm;		/* true if N x (2 x N^3) flop matrix products */
+	const bool			typed;		/* true if using the typed matrix copies */
 } stress_matrix_3d_method_info_t;
 
 static const stress_matrix_3d_method_info_t matrix_3d_methods[];
@@ -772,6 +794,391 @@ static void OPTIMIZE3 TARGET_CLONES stress_matrix_3d_zyx_identity(
 	}
 }
 
+/*
+ *  stress_matrix_3d_xyz_prod()
+ *	matrix product of each of the N x N slices
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_3d_xyz_prod(
+	const size_t n,
+	stress_matrix_3d_type_t a[RESTRICT n][n][n],
+	stress_matrix_3d_type_t b[RESTRICT n][n][n],
+	stress_matrix_3d_type_t r[RESTRICT n][n][n])
+{
+	register size_t s;
+
+	for (s = 0; s < n; s++) {
+		register size_t i;
+
+		for (i = 0; i < n; i++) {
+			register size_t j;
+
+			for (j = 0; j < n; j++) {
+				register size_t k;
+
+				for (k = 0; k < n; k++) {
+					r[s][i][j] += a[s][i][k] * b[s][k][j];
+				}
+			}
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			return;
+	}
+}
+
+/*
+ *  stress_matrix_3d_zyx_prod()
+ *	matrix product of each of the N x N slices
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_3d_zyx_prod(
+	const size_t n,
+	stress_matrix_3d_type_t a[RESTRICT n][n][n],
+	stress_matrix_3d_type_t b[RESTRICT n][n][n],
+	stress_matrix_3d_type_t r[RESTRICT n][n][n])
+{
+	register size_t s;
+
+	for (s = 0; s < n; s++) {
+		register size_t j;
+
+		for (j = 0; j < n; j++) {
+			register size_t i;
+
+			for (i = 0; i < n; i++) {
+				register size_t k;
+
+				for (k = 0; k < n; k++) {
+					r[s][i][j] += a[s][i][k] * b[s][k][j];
+				}
+			}
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			return;
+	}
+}
+
+/*
+ *  The typed product methods operate on double, _Float16 and __bf16
+ *  copies of the matrices that are stored in the same mapping after
+ *  the float matrix, so the float methods are unaffected by them
+ */
+#define MATRIX3D_FLOAT_OFFSET(n)	((size_t)0)
+#define MATRIX3D_F64_OFFSET(n)		((n) * (n) * (n) * sizeof(stress_matrix_3d_type_t))
+#define MATRIX3D_F16_OFFSET(n)		(MATRIX3D_F64_OFFSET(n) + ((n) * (n) * (n) * sizeof(double)))
+#define MATRIX3D_BF16_OFFSET(n)		(MATRIX3D_F16_OFFSET(n) + ((n) * (n) * (n) * 2))
+#define MATRIX3D_TYPED_SIZE(n)		(MATRIX3D_BF16_OFFSET(n) + ((n) * (n) * (n) * 2))
+
+/*
+ *  STRESS_MATRIX_3D_PROD_METHOD()
+ *	declare a matrix method that runs a slice product kernel on
+ *	each N x N slice of the type copy of the matrices at offset
+ *	in the mapping
+ */
+#define STRESS_MATRIX_3D_PROD_METHOD(name, kernel, type, offset, yx)	\
+static void OPTIMIZE3 TARGET_CLONES name(				\
+	const size_t n,							\
+	stress_matrix_3d_type_t a[RESTRICT n][n][n],			\
+	stress_matrix_3d_type_t b[RESTRICT n][n][n],			\
+	stress_matrix_3d_type_t r[RESTRICT n][n][n])			\
+{									\
+	typedef type (*matrix_3d_typed_ptr_t)[n][n];			\
+	const matrix_3d_typed_ptr_t ta =				\
+		(matrix_3d_typed_ptr_t)(void *)((char *)a + offset(n));	\
+	const matrix_3d_typed_ptr_t tb =				\
+		(matrix_3d_typed_ptr_t)(void *)((char *)b + offset(n));	\
+	const matrix_3d_typed_ptr_t tr =				\
+		(matrix_3d_typed_ptr_t)(void *)((char *)r + offset(n));	\
+	register size_t s;						\
+									\
+	for (s = 0; s < n; s++) {					\
+		kernel(n, ta[s], tb[s], tr[s], yx);			\
+		if (UNLIKELY(!keep_stressing_flag()))			\
+			return;						\
+	}								\
+}
+
+/*
+ *  STRESS_MATRIX_3D_SLICE_PROD_BLOCKED()
+ *	declare a cache blocked product kernel of two N x N slices,
+ *	the inner loops operate on MATRIX3D_BLOCK x MATRIX3D_BLOCK tiles,
+ *	the tiles are traversed x by y or y by x
+ */
+#define STRESS_MATRIX_3D_SLICE_PROD_BLOCKED(name, type)			\
+static inline void ALWAYS_INLINE name(					\
+	const size_t n,							\
+	type a[RESTRICT n][n],						\
+	type b[RESTRICT n][n],						\
+	type r[RESTRICT n][n],						\
+	const bool yx)							\
+{									\
+	size_t oo;							\
+									\
+	for (oo = 0; oo < n; oo += MATRIX3D_BLOCK) {			\
+		size_t kk;						\
+									\
+		for (kk = 0; kk < n; kk += MATRIX3D_BLOCK) {		\
+			const size_t kmax = STRESS_MINIMUM(kk + MATRIX3D_BLOCK, n);\
+			size_t uu;					\
+									\
+			for (uu = 0; uu < n; uu += MATRIX3D_BLOCK) {	\
+				const size_t ii = yx ? uu : oo;		\
+				const size_t jj = yx ? oo : uu;		\
+				const size_t imax = STRESS_MINIMUM(ii + MATRIX3D_BLOCK, n);\
+				const size_t jmax = STRESS_MINIMUM(jj + MATRIX3D_BLOCK, n);\
+				register size_t i;			\
+									\
+				for (i = ii; i < imax; i++) {		\
+					register size_t k;		\
+									\
+					for (k = kk; k < kmax; k++) {	\
+						const type aik = a[i][k];\
+						register size_t j;	\
+									\
+						for (j = jj; j < jmax; j++)\
+							r[i][j] += aik * b[k][j];\
+					}				\
+				}					\
+			}						\
+		}							\
+	}								\
+}
+
+STRESS_MATRIX_3D_SLICE_PROD_BLOCKED(stress_matrix_3d_slice_prod_blocked, stress_matrix_3d_type_t)
+STRESS_MATRIX_3D_SLICE_PROD_BLOCKED(stress_matrix_3d_slice_prod_blocked_f64, double)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_3D_SLICE_PROD_BLOCKED(stress_matrix_3d_slice_prod_blocked_f16, _Float16)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_3D_SLICE_PROD_BLOCKED(stress_matrix_3d_slice_prod_blocked_bf16, __bf16)
+#endif
+
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_blocked, stress_matrix_3d_slice_prod_blocked,
+	stress_matrix_3d_type_t, MATRIX3D_FLOAT_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_blocked, stress_matrix_3d_slice_prod_blocked,
+	stress_matrix_3d_type_t, MATRIX3D_FLOAT_OFFSET, true)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_blocked_f64, stress_matrix_3d_slice_prod_blocked_f64,
+	double, MATRIX3D_F64_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_blocked_f64, stress_matrix_3d_slice_prod_blocked_f64,
+	double, MATRIX3D_F64_OFFSET, true)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_blocked_f16, stress_matrix_3d_slice_prod_blocked_f16,
+	_Float16, MATRIX3D_F16_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_blocked_f16, stress_matrix_3d_slice_prod_blocked_f16,
+	_Float16, MATRIX3D_F16_OFFSET, true)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_blocked_bf16, stress_matrix_3d_slice_prod_blocked_bf16,
+	__bf16, MATRIX3D_BF16_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_blocked_bf16, stress_matrix_3d_slice_prod_blocked_bf16,
+	__bf16, MATRIX3D_BF16_OFFSET, true)
+#endif
+
+#if defined(HAVE_VECMATH)
+
+#define MATRIX3D_SIMD_ROWS	(4)	/* rows in register block */
+#define MATRIX3D_SIMD_BYTES	(32)	/* bytes in a vector register */
+
+/* broadcast a scalar into all elements of a 32 byte vector */
+#define MATRIX3D_SIMD_SPLAT4(v)	{ v, v, v, v }
+#define MATRIX3D_SIMD_SPLAT8(v)	{ v, v, v, v, v, v, v, v }
+#define MATRIX3D_SIMD_SPLAT16(v)	{ v, v, v, v, v, v, v, v, v, v, v, v, v, v, v, v }
+
+/*
+ *  STRESS_MATRIX_3D_SLICE_PROD_SIMD()
+ *	declare a cache and register blocked product kernel of two
+ *	N x N slices, the micro kernel computes a 4 row x 2 vector block
+ *	of r at row i, column j over k = kk..kmax - 1 of a and b keeping
+ *	the results in 8 vector registers (4 x 16 for float, 4 x 8 for
+ *	double), splat broadcasts a scalar into a vector, the register
+ *	blocks are traversed x by y or y by x and the rows and columns
+ *	not covered by them are computed afterwards
+ */
+#define STRESS_MATRIX_3D_SLICE_PROD_SIMD(name, type, splat)		\
+typedef type name ## _vec_t __attribute__ ((vector_size(MATRIX3D_SIMD_BYTES)));\
+									\
+static inline void ALWAYS_INLINE name ## _block(			\
+	const size_t n,							\
+	type a[RESTRICT n][n],						\
+	type b[RESTRICT n][n],						\
+	type r[RESTRICT n][n],						\
+	const size_t i,							\
+	const size_t j,							\
+	const size_t k0,						\
+	const size_t kmax)						\
+{									\
+	const size_t lanes = sizeof(name ## _vec_t) / sizeof(type);	\
+	name ## _vec_t r00, r01, r10, r11, r20, r21, r30, r31;		\
+	register size_t k;						\
+									\
+	(void)memcpy(&r00, &r[i + 0][j], sizeof(r00));			\
+	(void)memcpy(&r01, &r[i + 0][j + lanes], sizeof(r01));		\
+	(void)memcpy(&r10, &r[i + 1][j], sizeof(r10));			\
+	(void)memcpy(&r11, &r[i + 1][j + lanes], sizeof(r11));		\
+	(void)memcpy(&r20, &r[i + 2][j], sizeof(r20));			\
+	(void)memcpy(&r21, &r[i + 2][j + lanes], sizeof(r21));		\
+	(void)memcpy(&r30, &r[i + 3][j], sizeof(r30));			\
+	(void)memcpy(&r31, &r[i + 3][j + lanes], sizeof(r31));		\
+									\
+	for (k = k0; k < kmax; k++) {					\
+		const name ## _vec_t a0 = splat(a[i + 0][k]);\
+		const name ## _vec_t a1 = splat(a[i + 1][k]);\
+		const name ## _vec_t a2 = splat(a[i + 2][k]);\
+		const name ## _vec_t a3 = splat(a[i + 3][k]);\
+		name ## _vec_t b0, b1;					\
+									\
+		(void)memcpy(&b0, &b[k][j], sizeof(b0));		\
+		(void)memcpy(&b1, &b[k][j + lanes], sizeof(b1));		\
+									\
+		r00 += a0 * b0;						\
+		r01 += a0 * b1;						\
+		r10 += a1 * b0;						\
+		r11 += a1 * b1;						\
+		r20 += a2 * b0;						\
+		r21 += a2 * b1;						\
+		r30 += a3 * b0;						\
+		r31 += a3 * b1;						\
+	}								\
+									\
+	(void)memcpy(&r[i + 0][j], &r00, sizeof(r00));			\
+	(void)memcpy(&r[i + 0][j + lanes], &r01, sizeof(r01));		\
+	(void)memcpy(&r[i + 1][j], &r10, sizeof(r10));			\
+	(void)memcpy(&r[i + 1][j + lanes], &r11, sizeof(r11));		\
+	(void)memcpy(&r[i + 2][j], &r20, sizeof(r20));			\
+	(void)memcpy(&r[i + 2][j + lanes], &r21, sizeof(r21));		\
+	(void)memcpy(&r[i + 3][j], &r30, sizeof(r30));			\
+	(void)memcpy(&r[i + 3][j + lanes], &r31, sizeof(r31));		\
+}									\
+									\
+static inline void ALWAYS_INLINE name(					\
+	const size_t n,							\
+	type a[RESTRICT n][n],						\
+	type b[RESTRICT n][n],						\
+	type r[RESTRICT n][n],						\
+	const bool yx)							\
+{									\
+	const size_t ni = n & ~(size_t)(MATRIX3D_SIMD_ROWS - 1);	\
+	const size_t cols = 2 * sizeof(name ## _vec_t) / sizeof(type);	\
+	const size_t nj = n & ~(size_t)(cols - 1);	\
+	register size_t i;						\
+	size_t kk;							\
+									\
+	for (kk = 0; kk < n; kk += MATRIX3D_BLOCK) {			\
+		const size_t kmax = STRESS_MINIMUM(kk + MATRIX3D_BLOCK, n);\
+									\
+		if (yx) {						\
+			register size_t j;				\
+									\
+			for (j = 0; j < nj; j += cols) {	\
+				for (i = 0; i < ni; i += MATRIX3D_SIMD_ROWS)\
+					name ## _block(n, a, b, r, i, j, kk, kmax);\
+			}						\
+		} else {						\
+			for (i = 0; i < ni; i += MATRIX3D_SIMD_ROWS) {	\
+				register size_t j;			\
+									\
+				for (j = 0; j < nj; j += cols)\
+					name ## _block(n, a, b, r, i, j, kk, kmax);\
+			}						\
+		}							\
+	}								\
+									\
+	for (i = 0; i < n; i++) {					\
+		const size_t j0 = (i < ni) ? nj : 0;			\
+		register size_t k;					\
+									\
+		for (k = 0; k < n; k++) {				\
+			const type aik = a[i][k];			\
+			register size_t j;				\
+									\
+			for (j = j0; j < n; j++)			\
+				r[i][j] += aik * b[k][j];		\
+		}							\
+	}								\
+}
+
+STRESS_MATRIX_3D_SLICE_PROD_SIMD(stress_matrix_3d_slice_prod_simd, stress_matrix_3d_type_t, MATRIX3D_SIMD_SPLAT8)
+STRESS_MATRIX_3D_SLICE_PROD_SIMD(stress_matrix_3d_slice_prod_simd_f64, double, MATRIX3D_SIMD_SPLAT4)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_3D_SLICE_PROD_SIMD(stress_matrix_3d_slice_prod_simd_f16, _Float16, MATRIX3D_SIMD_SPLAT16)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_3D_SLICE_PROD_SIMD(stress_matrix_3d_slice_prod_simd_bf16, __bf16, MATRIX3D_SIMD_SPLAT16)
+#endif
+
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_simd, stress_matrix_3d_slice_prod_simd,
+	stress_matrix_3d_type_t, MATRIX3D_FLOAT_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_simd, stress_matrix_3d_slice_prod_simd,
+	stress_matrix_3d_type_t, MATRIX3D_FLOAT_OFFSET, true)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_simd_f64, stress_matrix_3d_slice_prod_simd_f64,
+	double, MATRIX3D_F64_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_simd_f64, stress_matrix_3d_slice_prod_simd_f64,
+	double, MATRIX3D_F64_OFFSET, true)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_simd_f16, stress_matrix_3d_slice_prod_simd_f16,
+	_Float16, MATRIX3D_F16_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_simd_f16, stress_matrix_3d_slice_prod_simd_f16,
+	_Float16, MATRIX3D_F16_OFFSET, true)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_xyz_prod_simd_bf16, stress_matrix_3d_slice_prod_simd_bf16,
+	__bf16, MATRIX3D_BF16_OFFSET, false)
+STRESS_MATRIX_3D_PROD_METHOD(stress_matrix_3d_zyx_prod_simd_bf16, stress_matrix_3d_slice_prod_simd_bf16,
+	__bf16, MATRIX3D_BF16_OFFSET, true)
+#endif
+#endif
+
+/*
+ *  stress_matrix_3d_typed_init()
+ *	fill the double, _Float16 and __bf16 copies of the matrices,
+ *	the half precision copies are scaled down into 0..1 so the
+ *	products do not overflow immediately
+ */
+static void stress_matrix_3d_typed_init(
+	const size_t n,
+	stress_matrix_3d_type_t a[RESTRICT n][n][n],
+	stress_matrix_3d_type_t b[RESTRICT n][n][n],
+	stress_matrix_3d_type_t r[RESTRICT n][n][n])
+{
+	typedef double (*matrix_3d_f64_ptr_t)[n][n];
+	const matrix_3d_f64_ptr_t a64 = (matrix_3d_f64_ptr_t)(void *)((char *)a + MATRIX3D_F64_OFFSET(n));
+	const matrix_3d_f64_ptr_t b64 = (matrix_3d_f64_ptr_t)(void *)((char *)b + MATRIX3D_F64_OFFSET(n));
+	const matrix_3d_f64_ptr_t r64 = (matrix_3d_f64_ptr_t)(void *)((char *)r + MATRIX3D_F64_OFFSET(n));
+#if defined(HAVE_MATRIX_F16)
+	typedef _Float16 (*matrix_3d_f16_ptr_t)[n][n];
+	const matrix_3d_f16_ptr_t a16 = (matrix_3d_f16_ptr_t)(void *)((char *)a + MATRIX3D_F16_OFFSET(n));
+	const matrix_3d_f16_ptr_t b16 = (matrix_3d_f16_ptr_t)(void *)((char *)b + MATRIX3D_F16_OFFSET(n));
+	const matrix_3d_f16_ptr_t r16 = (matrix_3d_f16_ptr_t)(void *)((char *)r + MATRIX3D_F16_OFFSET(n));
+#endif
+#if defined(HAVE_MATRIX_BF16)
+	typedef __bf16 (*matrix_3d_bf16_ptr_t)[n][n];
+	const matrix_3d_bf16_ptr_t abf16 = (matrix_3d_bf16_ptr_t)(void *)((char *)a + MATRIX3D_BF16_OFFSET(n));
+	const matrix_3d_bf16_ptr_t bbf16 = (matrix_3d_bf16_ptr_t)(void *)((char *)b + MATRIX3D_BF16_OFFSET(n));
+	const matrix_3d_bf16_ptr_t rbf16 = (matrix_3d_bf16_ptr_t)(void *)((char *)r + MATRIX3D_BF16_OFFSET(n));
+#endif
+	register size_t i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++) {
+			register size_t k;
+
+			for (k = 0; k < n; k++) {
+				a64[i][j][k] = (double)a[i][j][k];
+				b64[i][j][k] = (double)b[i][j][k];
+				r64[i][j][k] = 0.0;
+#if defined(HAVE_MATRIX_F16)
+				a16[i][j][k] = (_Float16)(a[i][j][k] / 65536.0f);
+				b16[i][j][k] = (_Float16)(b[i][j][k] / 65536.0f);
+				r16[i][j][k] = (_Float16)0.0f;
+#endif
+#if defined(HAVE_MATRIX_BF16)
+				abf16[i][j][k] = (__bf16)(a[i][j][k] / 65536.0f);
+				bbf16[i][j][k] = (__bf16)(b[i][j][k] / 65536.0f);
+				rbf16[i][j][k] = (__bf16)0.0f;
+#endif
+			}
+		}
+	}
+}
+
 static void stress_matrix_3d_xyz_all(
 	const size_t n,
 	stress_matrix_3d_type_t a[RESTRICT n][n][n],
@@ -788,20 +1195,39 @@ static void stress_matrix_3d_zyx_all(
  * Table of cpu stress methods, ordered x by y by z and z by y by x
  */
 static const stress_matrix_3d_method_info_t matrix_3d_methods[] = {
-	{ "all",		{ stress_matrix_3d_xyz_all,		stress_matrix_3d_zyx_all } },/* Special "all" test */
-
-	{ "add",		{ stress_matrix_3d_xyz_add,		stress_matrix_3d_zyx_add } },
-	{ "copy",		{ stress_matrix_3d_xyz_copy,		stress_matrix_3d_zyx_copy } },
-	{ "div",		{ stress_matrix_3d_xyz_div,		stress_matrix_3d_zyx_div } },
-	{ "frobenius",		{ stress_matrix_3d_xyz_frobenius,	stress_matrix_3d_zyx_frobenius } },
-	{ "hadamard",		{ stress_matrix_3d_xyz_hadamard,	stress_matrix_3d_zyx_hadamard } },
-	{ "identity",		{ stress_matrix_3d_xyz_identity,	stress_matrix_3d_zyx_identity } },
-	{ "mean",		{ stress_matrix_3d_xyz_mean,		stress_matrix_3d_zyx_mean } },
-	{ "mult",		{ stress_matrix_3d_xyz_mult,		stress_matrix_3d_zyx_mult } },
-	{ "negate",		{ stress_matrix_3d_xyz_negate,		stress_matrix_3d_zyx_negate } },
-	{ "sub",		{ stress_matrix_3d_xyz_sub,		stress_matrix_3d_zyx_sub } },
-	{ "trans",		{ stress_matrix_3d_xyz_trans,		stress_matrix_3d_zyx_trans } },
-	{ "zero",		{ stress_matrix_3d_xyz_zero,		stress_matrix_3d_zyx_zero } },
+	{ "all",		{ stress_matrix_3d_xyz_all,		stress_matrix_3d_zyx_all }, false, true },/* Special "all" test */
+
+	{ "add",		{ stress_matrix_3d_xyz_add,		stress_matrix_3d_zyx_add }, false, false },
+	{ "copy",		{ stress_matrix_3d_xyz_copy,		stress_matrix_3d_zyx_copy }, false, false },
+	{ "div",		{ stress_matrix_3d_xyz_div,		stress_matrix_3d_zyx_div }, false, false },
+	{ "frobenius",		{ stress_matrix_3d_xyz_frobenius,	stress_matrix_3d_zyx_frobenius }, false, false },
+	{ "hadamard",		{ stress_matrix_3d_xyz_hadamard,	stress_matrix_3d_zyx_hadamard }, false, false },
+	{ "identity",		{ stress_matrix_3d_xyz_identity,	stress_matrix_3d_zyx_identity }, false, false },
+	{ "mean",		{ stress_matrix_3d_xyz_mean,		stress_matrix_3d_zyx_mean }, false, false },
+	{ "mult",		{ stress_matrix_3d_xyz_mult,		stress_matrix_3d_zyx_mult }, false, false },
+	{ "negate",		{ stress_matrix_3d_xyz_negate,		stress_matrix_3d_zyx_negate }, false, false },
+	{ "prod",		{ stress_matrix_3d_xyz_prod,		stress_matrix_3d_zyx_prod }, true, false },
+	{ "prod-blocked",	{ stress_matrix_3d_xyz_prod_blocked,	stress_matrix_3d_zyx_prod_blocked }, true, false },
+#if defined(HAVE_MATRIX_BF16)
+	{ "prod-blocked-bf16",	{ stress_matrix_3d_xyz_prod_blocked_bf16, stress_matrix_3d_zyx_prod_blocked_bf16 }, true, true },
+#endif
+#if defined(HAVE_MATRIX_F16)
+	{ "prod-blocked-f16",	{ stress_matrix_3d_xyz_prod_blocked_f16, stress_matrix_3d_zyx_prod_blocked_f16 }, true, true },
+#endif
+	{ "prod-blocked-f64",	{ stress_matrix_3d_xyz_prod_blocked_f64, stress_matrix_3d_zyx_prod_blocked_f64 }, true, true },
+#if defined(HAVE_VECMATH)
+	{ "prod-simd",		{ stress_matrix_3d_xyz_prod_simd,	stress_matrix_3d_zyx_prod_simd }, true, false },
+#if defined(HAVE_MATRIX_BF16)
+	{ "prod-simd-bf16",	{ stress_matrix_3d_xyz_prod_simd_bf16, stress_matrix_3d_zyx_prod_simd_bf16 }, true, true },
+#endif
+#if defined(HAVE_MATRIX_F16)
+	{ "prod-simd-f16",	{ stress_matrix_3d_xyz_prod_simd_f16, stress_matrix_3d_zyx_prod_simd_f16 }, true, true },
+#endif
+	{ "prod-simd-f64",	{ stress_matrix_3d_xyz_prod_simd_f64, stress_matrix_3d_zyx_prod_simd_f64 }, true, true },
+#endif
+	{ "sub",		{ stress_matrix_3d_xyz_sub,		stress_matrix_3d_zyx_sub }, false, false },
+	{ "trans",		{ stress_matrix_3d_xyz_trans,		stress_matrix_3d_zyx_trans }, false, false },
+	{ "zero",		{ stress_matrix_3d_xyz_zero,		stress_matrix_3d_zyx_zero }, false, false },
 };
 
 static stress_metrics_t matrix_3d_metrics[SIZEOF_ARRAY(matrix_3d_methods)];
@@ -900,7 +1326,9 @@ static inline int stress_matrix_3d_exercise(
 {
 	int ret = EXIT_NO_RESOURCE;
 	typedef stress_matrix_3d_type_t (*matrix_3d_ptr_t)[n][n];
-	size_t matrix_3d_size = round_up(args->page_size, (sizeof(stress_matrix_3d_type_t) * n * n * n));
+	const bool typed = matrix_3d_methods[matrix_3d_method].typed;
+	size_t matrix_3d_size = round_up(args->page_size,
+		typed ? MATRIX3D_TYPED_SIZE(n) : (sizeof(stress_matrix_3d_type_t) * n * n * n));
 	const size_t num_matrix_3d_methods = SIZEOF_ARRAY(matrix_3d_methods);
 	const stress_matrix_3d_func func = matrix_3d_methods[matrix_3d_method].func[matrix_3d_zyx];
 
@@ -950,6 +1378,8 @@ static inline int stress_matrix_3d_exercise(
 			}
 		}
 	}
+	if (typed)
+		stress_matrix_3d_typed_init(n, a, b, r);
 
 	/*
 	 * Normal use case, 100% load, simple spinning on CPU
@@ -973,6 +1403,13 @@ static inline int stress_matrix_3d_exercise(
 			(void)snprintf(msg, sizeof(msg), "%s matrix-3d ops per sec", matrix_3d_methods[i].name);
 			stress_metrics_set(args, j, msg, rate);
 			j++;
+			if (matrix_3d_methods[i].gemm) {
+				const double flops = 2.0 * (double)n * (double)n * (double)n * (double)n;
+
+				(void)snprintf(msg, sizeof(msg), "%s matrix-3d GFLOP/s", matrix_3d_methods[i].name);
+				stress_metrics_set(args, j, msg, rate * flops / STRESS_DBL_NANOSECOND);
+				j++;
+			}
 		}
 	}
 
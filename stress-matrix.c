@@ -19,18 +19,43 @@
  */
 #include "stress-ng.h"
 #include "core-pragma.h"
+#include "core-pthread.h"
 #include "core-put.h"
 #include "core-target-clones.h"
+#include "core-vecmath.h"
 
 #define MIN_MATRIX_SIZE		(16)
 #define MAX_MATRIX_SIZE		(8192)
 #define DEFAULT_MATRIX_SIZE	(128)
 
+#define MATRIX_BLOCK		(64)	/* cache blocking tile size */
+
+/*
+ *  The half precision methods are only built when the compiler has
+ *  the type and the build targets an ISA with native half precision
+ *  vector arithmetic (bf16: conversions), e.g. -march=sapphirerapids,
+ *  otherwise the operations are emulated one element at a time
+ */
+#if defined(HAVE_FLOAT_FLOAT16) &&			\
+    ((defined(__AVX512FP16__) && defined(__AVX512VL__)) ||	\
+     defined(__ARM_FEATURE_FP16_VECTOR_ARITHMETIC))
+#define HAVE_MATRIX_F16
+#endif
+#if defined(HAVE_BFLOAT16) &&				\
+    (defined(__AVX512BF16__) ||				\
+     defined(__ARM_FEATURE_BF16))
+#define HAVE_MATRIX_BF16
+#endif
+
+#define MIN_MATRIX_THREADS	(1)
+#define MAX_MATRIX_THREADS	(1024)
+
 static const stress_help_t help[] = {
 	{ NULL,	"matrix N",		"start N workers exercising matrix operations" },
 	{ NULL,	"matrix-method M",	"specify matrix stress method M, default is all" },
 	{ NULL,	"matrix-ops N",		"stop after N maxtrix bogo operations" },
 	{ NULL,	"matrix-size N",	"specify the size of the N x N matrix" },
+	{ NULL,	"matrix-threads N",	"compute one shared product with N pthreads per instance" },
 	{ NULL,	"matrix-yx",		"matrix operation is y by x instead of x by y" },
 	{ NULL,	NULL,			NULL }
 };
@@ -51,6 +76,8 @@ typedef void (*stress_matrix_func)(
 typedef struct {
 	const char			*name;		/* human readable form of stressor */
 	const stress_matrix_func	func[2];	/* method functions, x by y, y by x */
+	const bool			gemm;		/* true if 2 x N^3 flop matrix product */
+	const bool			typed;		/* true if using the typed matrix copies */
 } stress_matrix_method_info_t;
 
 static const stress_matrix_method_info_t matrix_methods[];
@@ -65,6 +92,16 @@ static int stress_set_matrix_size(const char *opt)
 	return stress_set_setting("matrix-size", TYPE_ID_SIZE_T, &matrix_size);
 }
 
+static int stress_set_matrix_threads(const char *opt)
+{
+	uint32_t matrix_threads;
+
+	matrix_threads = stress_get_uint32(opt);
+	stress_check_range("matrix-threads", (uint64_t)matrix_threads,
+		MIN_MATRIX_THREADS, MAX_MATRIX_THREADS);
+	return stress_set_setting("matrix-threads", TYPE_ID_UINT32, &matrix_threads);
+}
+
 static int stress_set_matrix_yx(const char *opt)
 {
 	size_t matrix_yx = 1;
@@ -748,6 +785,336 @@ static void OPTIMIZE3 TARGET_CLONES stress_matrix_yx_square(
 	}
 }
 
+/*
+ *  The typed product methods operate on double, _Float16 and __bf16
+ *  copies of the matrices that are stored in the same mapping after
+ *  the float matrix, so the float methods are unaffected by them
+ */
+#define MATRIX_FLOAT_OFFSET(n)	((size_t)0)
+#define MATRIX_F64_OFFSET(n)	((n) * (n) * sizeof(stress_matrix_type_t))
+#define MATRIX_F16_OFFSET(n)	(MATRIX_F64_OFFSET(n) + ((n) * (n) * sizeof(double)))
+#define MATRIX_BF16_OFFSET(n)	(MATRIX_F16_OFFSET(n) + ((n) * (n) * 2))
+#define MATRIX_TYPED_SIZE(n)	(MATRIX_BF16_OFFSET(n) + ((n) * (n) * 2))
+
+/*
+ *  STRESS_MATRIX_PROD_METHOD()
+ *	declare a matrix method that runs a product kernel on the
+ *	type copy of the matrices at offset in the mapping
+ */
+#define STRESS_MATRIX_PROD_METHOD(name, kernel, type, offset, yx)	\
+static void OPTIMIZE3 TARGET_CLONES name(				\
+	const size_t n,							\
+	stress_matrix_type_t a[RESTRICT n][n],				\
+	stress_matrix_type_t b[RESTRICT n][n],				\
+	stress_matrix_type_t r[RESTRICT n][n])				\
+{									\
+	typedef type (*matrix_typed_ptr_t)[n];				\
+									\
+	kernel(n, (matrix_typed_ptr_t)(void *)((char *)a + offset(n)),	\
+		(matrix_typed_ptr_t)(void *)((char *)b + offset(n)),	\
+		(matrix_typed_ptr_t)(void *)((char *)r + offset(n)), yx);\
+}
+
+/*
+ *  STRESS_MATRIX_PROD_BLOCKED()
+ *	declare a cache blocked matrix product kernel, the inner loops
+ *	operate on MATRIX_BLOCK x MATRIX_BLOCK tiles that fit into the
+ *	cache, the tiles are traversed x by y or y by x
+ */
+#define STRESS_MATRIX_PROD_BLOCKED(name, type)				\
+static inline void ALWAYS_INLINE name(					\
+	const size_t n,							\
+	type a[RESTRICT n][n],						\
+	type b[RESTRICT n][n],						\
+	type r[RESTRICT n][n],						\
+	const bool yx)							\
+{									\
+	size_t oo;							\
+									\
+	for (oo = 0; oo < n; oo += MATRIX_BLOCK) {			\
+		size_t kk;						\
+									\
+		for (kk = 0; kk < n; kk += MATRIX_BLOCK) {		\
+			const size_t kmax = STRESS_MINIMUM(kk + MATRIX_BLOCK, n);\
+			size_t uu;					\
+									\
+			for (uu = 0; uu < n; uu += MATRIX_BLOCK) {	\
+				const size_t ii = yx ? uu : oo;		\
+				const size_t jj = yx ? oo : uu;		\
+				const size_t imax = STRESS_MINIMUM(ii + MATRIX_BLOCK, n);\
+				const size_t jmax = STRESS_MINIMUM(jj + MATRIX_BLOCK, n);\
+				register size_t i;			\
+									\
+				for (i = ii; i < imax; i++) {		\
+					register size_t k;		\
+									\
+					for (k = kk; k < kmax; k++) {	\
+						const type aik = a[i][k];\
+						register size_t j;	\
+									\
+						for (j = jj; j < jmax; j++)\
+							r[i][j] += aik * b[k][j];\
+					}				\
+				}					\
+			}						\
+		}							\
+		if (UNLIKELY(!keep_stressing_flag()))			\
+			return;						\
+	}								\
+}
+
+STRESS_MATRIX_PROD_BLOCKED(stress_matrix_prod_blocked, stress_matrix_type_t)
+STRESS_MATRIX_PROD_BLOCKED(stress_matrix_prod_blocked_f64, double)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_PROD_BLOCKED(stress_matrix_prod_blocked_f16, _Float16)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_PROD_BLOCKED(stress_matrix_prod_blocked_bf16, __bf16)
+#endif
+
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_blocked, stress_matrix_prod_blocked,
+	stress_matrix_type_t, MATRIX_FLOAT_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_blocked, stress_matrix_prod_blocked,
+	stress_matrix_type_t, MATRIX_FLOAT_OFFSET, true)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_blocked_f64, stress_matrix_prod_blocked_f64,
+	double, MATRIX_F64_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_blocked_f64, stress_matrix_prod_blocked_f64,
+	double, MATRIX_F64_OFFSET, true)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_blocked_f16, stress_matrix_prod_blocked_f16,
+	_Float16, MATRIX_F16_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_blocked_f16, stress_matrix_prod_blocked_f16,
+	_Float16, MATRIX_F16_OFFSET, true)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_blocked_bf16, stress_matrix_prod_blocked_bf16,
+	__bf16, MATRIX_BF16_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_blocked_bf16, stress_matrix_prod_blocked_bf16,
+	__bf16, MATRIX_BF16_OFFSET, true)
+#endif
+
+#if defined(HAVE_VECMATH)
+
+#define MATRIX_SIMD_ROWS	(4)	/* rows in register block */
+#define MATRIX_SIMD_BYTES	(32)	/* bytes in a vector register */
+
+/* broadcast a scalar into all elements of a 32 byte vector */
+#define MATRIX_SIMD_SPLAT4(v)	{ v, v, v, v }
+#define MATRIX_SIMD_SPLAT8(v)	{ v, v, v, v, v, v, v, v }
+#define MATRIX_SIMD_SPLAT16(v)	{ v, v, v, v, v, v, v, v, v, v, v, v, v, v, v, v }
+
+/*
+ *  STRESS_MATRIX_PROD_SIMD()
+ *	declare a cache and register blocked matrix product kernel,
+ *	the micro kernel computes a 4 row x 2 vector block of r at row i,
+ *	column j over k = kk..kmax - 1 of a and b keeping the results in
+ *	8 vector registers (4 x 16 for float, 4 x 8 for double), splat
+ *	broadcasts a scalar into a vector, the rows and columns not covered
+ *	by the register blocks are computed afterwards
+ */
+#define STRESS_MATRIX_PROD_SIMD(name, type, splat)			\
+typedef type name ## _vec_t __attribute__ ((vector_size(MATRIX_SIMD_BYTES)));\
+									\
+static inline void ALWAYS_INLINE name ## _block(			\
+	const size_t n,							\
+	type a[RESTRICT n][n],						\
+	type b[RESTRICT n][n],						\
+	type r[RESTRICT n][n],						\
+	const size_t i,							\
+	const size_t j,							\
+	const size_t k0,						\
+	const size_t kmax)						\
+{									\
+	const size_t lanes = sizeof(name ## _vec_t) / sizeof(type);	\
+	name ## _vec_t r00, r01, r10, r11, r20, r21, r30, r31;		\
+	register size_t k;						\
+									\
+	(void)memcpy(&r00, &r[i + 0][j], sizeof(r00));			\
+	(void)memcpy(&r01, &r[i + 0][j + lanes], sizeof(r01));		\
+	(void)memcpy(&r10, &r[i + 1][j], sizeof(r10));			\
+	(void)memcpy(&r11, &r[i + 1][j + lanes], sizeof(r11));		\
+	(void)memcpy(&r20, &r[i + 2][j], sizeof(r20));			\
+	(void)memcpy(&r21, &r[i + 2][j + lanes], sizeof(r21));		\
+	(void)memcpy(&r30, &r[i + 3][j], sizeof(r30));			\
+	(void)memcpy(&r31, &r[i + 3][j + lanes], sizeof(r31));		\
+									\
+	for (k = k0; k < kmax; k++) {					\
+		const name ## _vec_t a0 = splat(a[i + 0][k]);\
+		const name ## _vec_t a1 = splat(a[i + 1][k]);\
+		const name ## _vec_t a2 = splat(a[i + 2][k]);\
+		const name ## _vec_t a3 = splat(a[i + 3][k]);\
+		name ## _vec_t b0, b1;					\
+									\
+		(void)memcpy(&b0, &b[k][j], sizeof(b0));		\
+		(void)memcpy(&b1, &b[k][j + lanes], sizeof(b1));		\
+									\
+		r00 += a0 * b0;						\
+		r01 += a0 * b1;						\
+		r10 += a1 * b0;						\
+		r11 += a1 * b1;						\
+		r20 += a2 * b0;						\
+		r21 += a2 * b1;						\
+		r30 += a3 * b0;						\
+		r31 += a3 * b1;						\
+	}								\
+									\
+	(void)memcpy(&r[i + 0][j], &r00, sizeof(r00));			\
+	(void)memcpy(&r[i + 0][j + lanes], &r01, sizeof(r01));		\
+	(void)memcpy(&r[i + 1][j], &r10, sizeof(r10));			\
+	(void)memcpy(&r[i + 1][j + lanes], &r11, sizeof(r11));		\
+	(void)memcpy(&r[i + 2][j], &r20, sizeof(r20));			\
+	(void)memcpy(&r[i + 2][j + lanes], &r21, sizeof(r21));		\
+	(void)memcpy(&r[i + 3][j], &r30, sizeof(r30));			\
+	(void)memcpy(&r[i + 3][j + lanes], &r31, sizeof(r31));		\
+}									\
+									\
+static inline void ALWAYS_INLINE name(					\
+	const size_t n,							\
+	type a[RESTRICT n][n],						\
+	type b[RESTRICT n][n],						\
+	type r[RESTRICT n][n],						\
+	const bool yx)							\
+{									\
+	const size_t ni = n & ~(size_t)(MATRIX_SIMD_ROWS - 1);		\
+	const size_t cols = 2 * sizeof(name ## _vec_t) / sizeof(type);	\
+	const size_t nj = n & ~(size_t)(cols - 1);		\
+	register size_t i;						\
+	size_t kk;							\
+									\
+	if (yx) {							\
+		size_t jj;						\
+									\
+		for (jj = 0; jj < nj; jj += MATRIX_BLOCK * 4) {		\
+			const size_t jmax = STRESS_MINIMUM(jj + (MATRIX_BLOCK * 4), nj);\
+									\
+			for (kk = 0; kk < n; kk += MATRIX_BLOCK) {	\
+				const size_t kmax = STRESS_MINIMUM(kk + MATRIX_BLOCK, n);\
+									\
+				for (i = 0; i < ni; i += MATRIX_SIMD_ROWS) {\
+					register size_t j;		\
+									\
+					for (j = jj; j < jmax; j += cols)\
+						name ## _block(n, a, b, r, i, j, kk, kmax);\
+				}					\
+			}						\
+			if (UNLIKELY(!keep_stressing_flag()))		\
+				return;					\
+		}							\
+	} else {							\
+		size_t ii;						\
+									\
+		for (ii = 0; ii < ni; ii += MATRIX_BLOCK) {		\
+			const size_t imax = STRESS_MINIMUM(ii + MATRIX_BLOCK, ni);\
+									\
+			for (kk = 0; kk < n; kk += MATRIX_BLOCK) {	\
+				const size_t kmax = STRESS_MINIMUM(kk + MATRIX_BLOCK, n);\
+									\
+				for (i = ii; i < imax; i += MATRIX_SIMD_ROWS) {\
+					register size_t j;		\
+									\
+					for (j = 0; j < nj; j += cols)\
+						name ## _block(n, a, b, r, i, j, kk, kmax);\
+				}					\
+			}						\
+			if (UNLIKELY(!keep_stressing_flag()))		\
+				return;					\
+		}							\
+	}								\
+									\
+	for (i = 0; i < n; i++) {					\
+		const size_t j0 = (i < ni) ? nj : 0;			\
+		register size_t k;					\
+									\
+		for (k = 0; k < n; k++) {				\
+			const type aik = a[i][k];			\
+			register size_t j;				\
+									\
+			for (j = j0; j < n; j++)			\
+				r[i][j] += aik * b[k][j];		\
+		}							\
+	}								\
+}
+
+STRESS_MATRIX_PROD_SIMD(stress_matrix_prod_simd, stress_matrix_type_t, MATRIX_SIMD_SPLAT8)
+STRESS_MATRIX_PROD_SIMD(stress_matrix_prod_simd_f64, double, MATRIX_SIMD_SPLAT4)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_PROD_SIMD(stress_matrix_prod_simd_f16, _Float16, MATRIX_SIMD_SPLAT16)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_PROD_SIMD(stress_matrix_prod_simd_bf16, __bf16, MATRIX_SIMD_SPLAT16)
+#endif
+
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_simd, stress_matrix_prod_simd,
+	stress_matrix_type_t, MATRIX_FLOAT_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_simd, stress_matrix_prod_simd,
+	stress_matrix_type_t, MATRIX_FLOAT_OFFSET, true)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_simd_f64, stress_matrix_prod_simd_f64,
+	double, MATRIX_F64_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_simd_f64, stress_matrix_prod_simd_f64,
+	double, MATRIX_F64_OFFSET, true)
+#if defined(HAVE_MATRIX_F16)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_simd_f16, stress_matrix_prod_simd_f16,
+	_Float16, MATRIX_F16_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_simd_f16, stress_matrix_prod_simd_f16,
+	_Float16, MATRIX_F16_OFFSET, true)
+#endif
+#if defined(HAVE_MATRIX_BF16)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_xy_prod_simd_bf16, stress_matrix_prod_simd_bf16,
+	__bf16, MATRIX_BF16_OFFSET, false)
+STRESS_MATRIX_PROD_METHOD(stress_matrix_yx_prod_simd_bf16, stress_matrix_prod_simd_bf16,
+	__bf16, MATRIX_BF16_OFFSET, true)
+#endif
+#endif
+
+/*
+ *  stress_matrix_typed_init()
+ *	fill the double, _Float16 and __bf16 copies of the matrices,
+ *	the half precision copies are scaled down into 0..1 so the
+ *	products do not overflow immediately
+ */
+static void stress_matrix_typed_init(
+	const size_t n,
+	stress_matrix_type_t a[RESTRICT n][n],
+	stress_matrix_type_t b[RESTRICT n][n],
+	stress_matrix_type_t r[RESTRICT n][n])
+{
+	typedef double (*matrix_f64_ptr_t)[n];
+	const matrix_f64_ptr_t a64 = (matrix_f64_ptr_t)(void *)((char *)a + MATRIX_F64_OFFSET(n));
+	const matrix_f64_ptr_t b64 = (matrix_f64_ptr_t)(void *)((char *)b + MATRIX_F64_OFFSET(n));
+	const matrix_f64_ptr_t r64 = (matrix_f64_ptr_t)(void *)((char *)r + MATRIX_F64_OFFSET(n));
+#if defined(HAVE_MATRIX_F16)
+	typedef _Float16 (*matrix_f16_ptr_t)[n];
+	const matrix_f16_ptr_t a16 = (matrix_f16_ptr_t)(void *)((char *)a + MATRIX_F16_OFFSET(n));
+	const matrix_f16_ptr_t b16 = (matrix_f16_ptr_t)(void *)((char *)b + MATRIX_F16_OFFSET(n));
+	const matrix_f16_ptr_t r16 = (matrix_f16_ptr_t)(void *)((char *)r + MATRIX_F16_OFFSET(n));
+#endif
+#if defined(HAVE_MATRIX_BF16)
+	typedef __bf16 (*matrix_bf16_ptr_t)[n];
+	const matrix_bf16_ptr_t abf16 = (matrix_bf16_ptr_t)(void *)((char *)a + MATRIX_BF16_OFFSET(n));
+	const matrix_bf16_ptr_t bbf16 = (matrix_bf16_ptr_t)(void *)((char *)b + MATRIX_BF16_OFFSET(n));
+	const matrix_bf16_ptr_t rbf16 = (matrix_bf16_ptr_t)(void *)((char *)r + MATRIX_BF16_OFFSET(n));
+#endif
+	register size_t i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++) {
+			a64[i][j] = (double)a[i][j];
+			b64[i][j] = (double)b[i][j];
+			r64[i][j] = 0.0;
+#if defined(HAVE_MATRIX_F16)
+			a16[i][j] = (_Float16)(a[i][j] / 65536.0f);
+			b16[i][j] = (_Float16)(b[i][j] / 65536.0f);
+			r16[i][j] = (_Float16)0.0f;
+#endif
+#if defined(HAVE_MATRIX_BF16)
+			abf16[i][j] = (__bf16)(a[i][j] / 65536.0f);
+			bbf16[i][j] = (__bf16)(b[i][j] / 65536.0f);
+			rbf16[i][j] = (__bf16)0.0f;
+#endif
+		}
+	}
+}
+
 /*
  *  stress_matrix_xy_all()
  *	iterate over all cpu stressors
@@ -772,22 +1139,40 @@ static void OPTIMIZE3 stress_matrix_yx_all(
  * Table of cpu stress methods, ordered x by y and y by x
  */
 static const stress_matrix_method_info_t matrix_methods[] = {
-	{ "all",		{ stress_matrix_xy_all,		stress_matrix_yx_all } },/* Special "all" test */
-
-	{ "add",		{ stress_matrix_xy_add,		stress_matrix_yx_add } },
-	{ "copy",		{ stress_matrix_xy_copy,	stress_matrix_yx_copy } },
-	{ "div",		{ stress_matrix_xy_div,		stress_matrix_yx_div } },
-	{ "frobenius",		{ stress_matrix_xy_frobenius,	stress_matrix_yx_frobenius } },
-	{ "hadamard",		{ stress_matrix_xy_hadamard,	stress_matrix_yx_hadamard } },
-	{ "identity",		{ stress_matrix_xy_identity,	stress_matrix_yx_identity } },
-	{ "mean",		{ stress_matrix_xy_mean,	stress_matrix_yx_mean } },
-	{ "mult",		{ stress_matrix_xy_mult,	stress_matrix_yx_mult } },
-	{ "negate",		{ stress_matrix_xy_negate,	stress_matrix_yx_negate } },
-	{ "prod",		{ stress_matrix_xy_prod,	stress_matrix_yx_prod } },
-	{ "sub",		{ stress_matrix_xy_sub,		stress_matrix_yx_sub } },
-	{ "square",		{ stress_matrix_xy_square,	stress_matrix_yx_square } },
-	{ "trans",		{ stress_matrix_xy_trans,	stress_matrix_yx_trans } },
-	{ "zero",		{ stress_matrix_xy_zero,	stress_matrix_yx_zero } },
+	{ "all",		{ stress_matrix_xy_all,		stress_matrix_yx_all }, false, true },/* Special "all" test */
+
+	{ "add",		{ stress_matrix_xy_add,		stress_matrix_yx_add }, false, false },
+	{ "copy",		{ stress_matrix_xy_copy,	stress_matrix_yx_copy }, false, false },
+	{ "div",		{ stress_matrix_xy_div,		stress_matrix_yx_div }, false, false },
+	{ "frobenius",		{ stress_matrix_xy_frobenius,	stress_matrix_yx_frobenius }, false, false },
+	{ "hadamard",		{ stress_matrix_xy_hadamard,	stress_matrix_yx_hadamard }, false, false },
+	{ "identity",		{ stress_matrix_xy_identity,	stress_matrix_yx_identity }, false, false },
+	{ "mean",		{ stress_matrix_xy_mean,	stress_matrix_yx_mean }, false, false },
+	{ "mult",		{ stress_matrix_xy_mult,	stress_matrix_yx_mult }, false, false },
+	{ "negate",		{ stress_matrix_xy_negate,	stress_matrix_yx_negate }, false, false },
+	{ "prod",		{ stress_matrix_xy_prod,	stress_matrix_yx_prod }, true, false },
+	{ "prod-blocked",	{ stress_matrix_xy_prod_blocked, stress_matrix_yx_prod_blocked }, true, false },
+#if defined(HAVE_MATRIX_BF16)
+	{ "prod-blocked-bf16",	{ stress_matrix_xy_prod_blocked_bf16, stress_matrix_yx_prod_blocked_bf16 }, true, true },
+#endif
+#if defined(HAVE_MATRIX_F16)
+	{ "prod-blocked-f16",	{ stress_matrix_xy_prod_blocked_f16, stress_matrix_yx_prod_blocked_f16 }, true, true },
+#endif
+	{ "prod-blocked-f64",	{ stress_matrix_xy_prod_blocked_f64, stress_matrix_yx_prod_blocked_f64 }, true, true },
+#if defined(HAVE_VECMATH)
+	{ "prod-simd",		{ stress_matrix_xy_prod_simd,	stress_matrix_yx_prod_simd }, true, false },
+#if defined(HAVE_MATRIX_BF16)
+	{ "prod-simd-bf16",	{ stress_matrix_xy_prod_simd_bf16, stress_matrix_yx_prod_simd_bf16 }, true, true },
+#endif
+#if defined(HAVE_MATRIX_F16)
+	{ "prod-simd-f16",	{ stress_matrix_xy_prod_simd_f16, stress_matrix_yx_prod_simd_f16 }, true, true },
+#endif
+	{ "prod-simd-f64",	{ stress_matrix_xy_prod_simd_f64, stress_matrix_yx_prod_simd_f64 }, true, true },
+#endif
+	{ "sub",		{ stress_matrix_xy_sub,		stress_matrix_yx_sub }, false, false },
+	{ "square",		{ stress_matrix_xy_square,	stress_matrix_yx_square }, true, false },
+	{ "trans",		{ stress_matrix_xy_trans,	stress_matrix_yx_trans }, false, false },
+	{ "zero",		{ stress_matrix_xy_zero,	stress_matrix_yx_zero }, false, false },
 };
 
 static stress_metrics_t matrix_metrics[SIZEOF_ARRAY(matrix_methods)];
@@ -877,15 +1262,324 @@ static inline stress_matrix_type_t stress_matrix_data(const stress_matrix_type_t
 	return v * (stress_matrix_type_t)r;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  Threaded mode, N pthreads cooperatively compute r += a * b on
+ *  the shared matrices. The product is split into MATRIX_BLOCK x
+ *  MATRIX_BLOCK tiles of r, each thread has a queue of tiles and
+ *  takes tiles from the head of its own queue and steals tiles
+ *  from the tail of the other queues once its own queue is empty.
+ */
+typedef struct {
+	shim_pthread_spinlock_t lock;	/* protects head and tail */
+	size_t head;			/* next tile for the queue owner */
+	size_t tail;			/* end of queue, tiles are stolen from here */
+} stress_matrix_queue_t;
+
+struct stress_matrix_threads;
+
+typedef struct {
+	pthread_t pthread;		/* pthread handle */
+	int ret;			/* pthread create return value */
+	size_t id;			/* thread and queue index */
+	struct stress_matrix_threads *mt; /* shared state */
+	double busy;			/* time spent computing tiles */
+	uint64_t tiles;			/* tiles computed */
+	uint64_t steals;		/* tiles stolen from other queues */
+} stress_matrix_thread_t;
+
+typedef struct stress_matrix_threads {
+	size_t n;			/* matrix size */
+	stress_matrix_type_t *a;	/* shared operand a */
+	stress_matrix_type_t *b;	/* shared operand b */
+	stress_matrix_type_t *r;	/* shared result */
+	size_t tiles_per_row;		/* tiles per row of r */
+	size_t num_tiles;		/* total tiles in r */
+	size_t num_threads;		/* number of pthreads */
+	stress_matrix_queue_t *queues;	/* per thread tile queues */
+	stress_matrix_thread_t *threads; /* per thread info */
+	pthread_mutex_t mutex;		/* protects the fields below */
+	pthread_cond_t start_cond;	/* signalled at start of a product */
+	pthread_cond_t done_cond;	/* signalled when all threads complete */
+	uint64_t generation;		/* product number */
+	size_t running;			/* threads still computing the product */
+	bool terminate;			/* tell threads to exit */
+} stress_matrix_threads_t;
+
+/*
+ *  stress_matrix_prod_tile()
+ *	compute the i0..i1-1 x j0..j1-1 tile of r += a * b
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_prod_tile(
+	const size_t n,
+	stress_matrix_type_t a[RESTRICT n][n],
+	stress_matrix_type_t b[RESTRICT n][n],
+	stress_matrix_type_t r[RESTRICT n][n],
+	const size_t i0,
+	const size_t i1,
+	const size_t j0,
+	const size_t j1)
+{
+	size_t kk;
+
+	for (kk = 0; kk < n; kk += MATRIX_BLOCK) {
+		const size_t kmax = STRESS_MINIMUM(kk + MATRIX_BLOCK, n);
+		register size_t i;
+
+		for (i = i0; i < i1; i++) {
+			register size_t k;
+
+			for (k = kk; k < kmax; k++) {
+				const stress_matrix_type_t aik = a[i][k];
+				register size_t j;
+
+				for (j = j0; j < j1; j++)
+					r[i][j] += aik * b[k][j];
+			}
+		}
+	}
+}
+
+/*
+ *  stress_matrix_tile_get()
+ *	get next tile from own queue, or steal one from
+ *	another queue, returns false if no tiles are left
+ */
+static bool stress_matrix_tile_get(
+	stress_matrix_threads_t *mt,
+	stress_matrix_thread_t *thread,
+	size_t *tile)
+{
+	stress_matrix_queue_t *q = &mt->queues[thread->id];
+	size_t i;
+	bool got = false;
+
+	if (UNLIKELY(!keep_stressing_flag()))
+		return false;
+
+	(void)shim_pthread_spin_lock(&q->lock);
+	if (q->head < q->tail) {
+		*tile = q->head++;
+		got = true;
+	}
+	(void)shim_pthread_spin_unlock(&q->lock);
+	if (got)
+		return true;
+
+	for (i = 1; i < mt->num_threads; i++) {
+		q = &mt->queues[(thread->id + i) % mt->num_threads];
+
+		(void)shim_pthread_spin_lock(&q->lock);
+		if (q->head < q->tail) {
+			*tile = --q->tail;
+			got = true;
+		}
+		(void)shim_pthread_spin_unlock(&q->lock);
+		if (got) {
+			thread->steals++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ *  stress_matrix_thread()
+ *	compute tiles of each product until told to terminate
+ */
+static void *stress_matrix_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_matrix_thread_t *thread = (stress_matrix_thread_t *)arg;
+	stress_matrix_threads_t *mt = thread->mt;
+	const size_t n = mt->n;
+	typedef stress_matrix_type_t (*matrix_ptr_t)[n];
+	const matrix_ptr_t a = (matrix_ptr_t)mt->a;
+	const matrix_ptr_t b = (matrix_ptr_t)mt->b;
+	const matrix_ptr_t r = (matrix_ptr_t)mt->r;
+	uint64_t generation = 0;
+
+	for (;;) {
+		size_t tile;
+		double t;
+
+		(void)pthread_mutex_lock(&mt->mutex);
+		while (!mt->terminate && (mt->generation == generation))
+			(void)pthread_cond_wait(&mt->start_cond, &mt->mutex);
+		if (mt->terminate) {
+			(void)pthread_mutex_unlock(&mt->mutex);
+			break;
+		}
+		generation = mt->generation;
+		(void)pthread_mutex_unlock(&mt->mutex);
+
+		t = stress_time_now();
+		while (stress_matrix_tile_get(mt, thread, &tile)) {
+			const size_t i0 = (tile / mt->tiles_per_row) * MATRIX_BLOCK;
+			const size_t j0 = (tile % mt->tiles_per_row) * MATRIX_BLOCK;
+
+			stress_matrix_prod_tile(n, a, b, r, i0,
+				STRESS_MINIMUM(i0 + MATRIX_BLOCK, n), j0,
+				STRESS_MINIMUM(j0 + MATRIX_BLOCK, n));
+			thread->tiles++;
+		}
+		thread->busy += stress_time_now() - t;
+
+		(void)pthread_mutex_lock(&mt->mutex);
+		mt->running--;
+		if (mt->running == 0)
+			(void)pthread_cond_signal(&mt->done_cond);
+		(void)pthread_mutex_unlock(&mt->mutex);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_matrix_threads_exercise()
+ *	repeatedly compute r += a * b with num_threads pthreads
+ */
+static int stress_matrix_threads_exercise(
+	const stress_args_t *args,
+	const size_t n,
+	stress_matrix_type_t *a,
+	stress_matrix_type_t *b,
+	stress_matrix_type_t *r,
+	const size_t num_threads)
+{
+	stress_matrix_threads_t mt;
+	size_t i, started = 0;
+	uint64_t products = 0, steals = 0;
+	double duration = 0.0, busy_max = 0.0, busy_total = 0.0;
+	int ret = EXIT_SUCCESS;
+
+	(void)memset(&mt, 0, sizeof(mt));
+	mt.n = n;
+	mt.a = a;
+	mt.b = b;
+	mt.r = r;
+	mt.tiles_per_row = (n + MATRIX_BLOCK - 1) / MATRIX_BLOCK;
+	mt.num_tiles = mt.tiles_per_row * mt.tiles_per_row;
+	mt.num_threads = num_threads;
+
+	mt.queues = calloc(num_threads, sizeof(*mt.queues));
+	if (!mt.queues) {
+		pr_inf_skip("%s: failed to allocate %zd tile queues, skipping stressor\n",
+			args->name, num_threads);
+		return EXIT_NO_RESOURCE;
+	}
+	mt.threads = calloc(num_threads, sizeof(*mt.threads));
+	if (!mt.threads) {
+		pr_inf_skip("%s: failed to allocate %zd pthread information elements, skipping stressor\n",
+			args->name, num_threads);
+		free(mt.queues);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < num_threads; i++)
+		(void)shim_pthread_spin_init(&mt.queues[i].lock, SHIM_PTHREAD_PROCESS_PRIVATE);
+	(void)pthread_mutex_init(&mt.mutex, NULL);
+	(void)pthread_cond_init(&mt.start_cond, NULL);
+	(void)pthread_cond_init(&mt.done_cond, NULL);
+
+	for (i = 0; i < num_threads; i++) {
+		mt.threads[i].id = i;
+		mt.threads[i].mt = &mt;
+		mt.threads[i].ret = pthread_create(&mt.threads[i].pthread, NULL,
+						   stress_matrix_thread, &mt.threads[i]);
+		if (mt.threads[i].ret) {
+			pr_inf("%s: pthread create failed, errno=%d (%s), using %zd threads\n",
+				args->name, mt.threads[i].ret, strerror(mt.threads[i].ret), started);
+			break;
+		}
+		started++;
+	}
+	if (started == 0) {
+		ret = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	/* tiles are only queued on the threads that started */
+	mt.num_threads = started;
+
+	do {
+		const double t = stress_time_now();
+
+		for (i = 0; i < started; i++) {
+			mt.queues[i].head = (i * mt.num_tiles) / started;
+			mt.queues[i].tail = ((i + 1) * mt.num_tiles) / started;
+		}
+		(void)pthread_mutex_lock(&mt.mutex);
+		mt.running = started;
+		mt.generation++;
+		(void)pthread_cond_broadcast(&mt.start_cond);
+		while (mt.running > 0)
+			(void)pthread_cond_wait(&mt.done_cond, &mt.mutex);
+		(void)pthread_mutex_unlock(&mt.mutex);
+
+		/* don't count products cut short by the end of the run */
+		if (!keep_stressing_flag())
+			break;
+		duration += stress_time_now() - t;
+		products++;
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	(void)pthread_mutex_lock(&mt.mutex);
+	mt.terminate = true;
+	(void)pthread_cond_broadcast(&mt.start_cond);
+	(void)pthread_mutex_unlock(&mt.mutex);
+
+	for (i = 0; i < started; i++) {
+		(void)pthread_join(mt.threads[i].pthread, NULL);
+		busy_total += mt.threads[i].busy;
+		busy_max = STRESS_MAXIMUM(busy_max, mt.threads[i].busy);
+		steals += mt.threads[i].steals;
+	}
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_dbg("%s: thread    tiles   stolen   busy (secs)\n", args->name);
+		for (i = 0; i < started; i++) {
+			pr_dbg("%s: %6zd %8" PRIu64 " %8" PRIu64 " %13.3f\n", args->name,
+				i, mt.threads[i].tiles, mt.threads[i].steals, mt.threads[i].busy);
+		}
+		pr_unlock();
+	}
+
+	if ((products > 0) && (duration > 0.0)) {
+		const double flops = 2.0 * (double)n * (double)n * (double)n;
+		const double busy_mean = busy_total / (double)started;
+
+		stress_metrics_set(args, 0, "threaded prod matrix GFLOP/s",
+			(double)products * flops / duration / STRESS_DBL_NANOSECOND);
+		stress_metrics_set(args, 1, "thread imbalance (max/mean busy time)",
+			busy_mean > 0.0 ? busy_max / busy_mean : 0.0);
+		stress_metrics_set(args, 2, "tiles stolen per product",
+			(double)steals / (double)products);
+	}
+tidy:
+	(void)pthread_cond_destroy(&mt.done_cond);
+	(void)pthread_cond_destroy(&mt.start_cond);
+	(void)pthread_mutex_destroy(&mt.mutex);
+	for (i = 0; i < num_threads; i++)
+		(void)shim_pthread_spin_destroy(&mt.queues[i].lock);
+	free(mt.threads);
+	free(mt.queues);
+
+	return ret;
+}
+#endif
+
 static inline int stress_matrix_exercise(
 	const stress_args_t *args,
 	const size_t matrix_method,
 	const size_t matrix_yx,
-	const size_t n)
+	const size_t n,
+	const uint32_t matrix_threads)
 {
 	int ret = EXIT_NO_RESOURCE;
 	typedef stress_matrix_type_t (*matrix_ptr_t)[n];
-	size_t matrix_size = round_up(args->page_size, (sizeof(stress_matrix_type_t) * n * n));
+	const bool typed = matrix_methods[matrix_method].typed;
+	size_t matrix_size = round_up(args->page_size,
+		typed ? MATRIX_TYPED_SIZE(n) : (sizeof(stress_matrix_type_t) * n * n));
 	const size_t num_matrix_methods = SIZEOF_ARRAY(matrix_methods);
 	const stress_matrix_func func = matrix_methods[matrix_method].func[matrix_yx];
 
@@ -931,6 +1625,18 @@ static inline int stress_matrix_exercise(
 			r[i][j] = 0.0;
 		}
 	}
+	if (typed)
+		stress_matrix_typed_init(n, a, b, r);
+
+#if defined(HAVE_LIB_PTHREAD)
+	if (matrix_threads > 1) {
+		ret = stress_matrix_threads_exercise(args, n, (stress_matrix_type_t *)a,
+			(stress_matrix_type_t *)b, (stress_matrix_type_t *)r, matrix_threads);
+		goto tidy_r;
+	}
+#else
+	(void)matrix_threads;
+#endif
 
 	/*
 	 * Normal use case, 100% load, simple spinning on CPU
@@ -954,11 +1660,20 @@ static inline int stress_matrix_exercise(
 			(void)snprintf(msg, sizeof(msg), "%s matrix ops per sec", matrix_methods[i].name);
 			stress_metrics_set(args, j, msg, rate);
 			j++;
+			if (matrix_methods[i].gemm) {
+				const double flops = 2.0 * (double)n * (double)n * (double)n;
+
+				(void)snprintf(msg, sizeof(msg), "%s matrix GFLOP/s", matrix_methods[i].name);
+				stress_metrics_set(args, j, msg, rate * flops / STRESS_DBL_NANOSECOND);
+				j++;
+			}
 		}
 	}
 
 	ret = EXIT_SUCCESS;
-
+#if defined(HAVE_LIB_PTHREAD)
+tidy_r:
+#endif
 	(void)munmap((void *)r, matrix_size);
 tidy_b:
 	(void)munmap((void *)b, matrix_size);
@@ -977,14 +1692,27 @@ static int stress_matrix(const stress_args_t *args)
 	size_t matrix_method = 0;	/* All method */
 	size_t matrix_size = DEFAULT_MATRIX_SIZE;
 	size_t matrix_yx = 0;
+	uint32_t matrix_threads = 1;
 	int rc;
 
 	(void)stress_get_setting("matrix-method", &matrix_method);
 	(void)stress_get_setting("matrix-yx", &matrix_yx);
+	(void)stress_get_setting("matrix-threads", &matrix_threads);
 
-	if (args->instance == 0)
-		pr_dbg("%s: using method '%s' (%s)\n", args->name, matrix_methods[matrix_method].name,
-			matrix_yx ? "y by x" : "x by y");
+#if !defined(HAVE_LIB_PTHREAD)
+	if ((matrix_threads > 1) && (args->instance == 0))
+		pr_inf("%s: pthreads not supported, ignoring matrix-threads option\n",
+			args->name);
+	matrix_threads = 1;
+#endif
+	if (args->instance == 0) {
+		if (matrix_threads > 1)
+			pr_dbg("%s: using %" PRIu32 " threads to compute a shared blocked product\n",
+				args->name, matrix_threads);
+		else
+			pr_dbg("%s: using method '%s' (%s)\n", args->name, matrix_methods[matrix_method].name,
+				matrix_yx ? "y by x" : "x by y");
+	}
 
 	if (!stress_get_setting("matrix-size", &matrix_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -995,7 +1723,7 @@ static int stress_matrix(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
-	rc = stress_matrix_exercise(args, matrix_method, matrix_yx, matrix_size);
+	rc = stress_matrix_exercise(args, matrix_method, matrix_yx, matrix_size, matrix_threads);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
@@ -1010,6 +1738,7 @@ static void stress_matrix_set_default(void)
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_matrix_method,	stress_set_matrix_method },
 	{ OPT_matrix_size,	stress_set_matrix_size },
+	{ OPT_matrix_threads,	stress_set_matrix_threads },
 	{ OPT_matrix_yx,	stress_set_matrix_yx },
 	{ 0,			NULL },
 };
@@ -18,14 +18,34 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arch.h"
+#include "core-cpu.h"
 #include "core-target-clones.h"
 
+#if defined(HAVE_IMMINTRIN_H)
+#include <immintrin.h>
+#endif
+
 #define ALIGN_SIZE	(64)
 
+#define MEMCPY_SWEEP_MAX_SIZE	(64 * MB)	/* largest copy swept */
+#define MEMCPY_SWEEP_MAX_OFFSET	(64)		/* largest alignment offset + 1 */
+#define MEMCPY_SWEEP_BYTES	(16 * MB)	/* bytes copied per point per sweep */
+
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    !defined(__ICC) &&			\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_MEMCPY_HAVE_X86_VEC
+#endif
+
 static const stress_help_t help[] = {
 	{ NULL,	"memcpy N",	   "start N workers performing memory copies" },
 	{ NULL,	"memcpy-method M", "set memcpy method (M = all, libc, builtin, naive..)" },
 	{ NULL,	"memcpy-ops N",	   "stop after N memcpy bogo operations" },
+	{ NULL,	"memcpy-sweep",	   "sweep copy sizes and alignments, report GB/s and ns per copy" },
 	{ NULL,	NULL,		   NULL }
 };
 
@@ -227,36 +247,21 @@ STRESS_MEMCPY_NAIVE("naive_o1", stress_memcpy_naive_o1, test_naive_memcpy_o1, te
 STRESS_MEMCPY_NAIVE("naive_o2", stress_memcpy_naive_o2, test_naive_memcpy_o2, test_naive_memmove_o2)
 STRESS_MEMCPY_NAIVE("naive_o3", stress_memcpy_naive_o3, test_naive_memcpy_o3, test_naive_memmove_o3)
 
+/*
+ *  stress_memcpy_all()
+ *	dummy function, not called, the 'all' method is
+ *	handled by stress_memcpy iterating over all methods
+ */
 static NOINLINE void stress_memcpy_all(
 	stress_buffer_t *b,
 	uint8_t *b_str,
 	uint8_t *str_shared,
 	uint8_t *aligned_buf)
 {
-	static int whence;
-
-	switch (whence) {
-	case 0:
-		whence++;
-		stress_memcpy_libc(b, b_str, str_shared, aligned_buf);
-		return;
-	case 1:
-		whence++;
-		stress_memcpy_builtin(b, b_str, str_shared, aligned_buf);
-		return;
-	case 2:
-		whence++;
-		stress_memcpy_naive(b, b_str, str_shared, aligned_buf);
-		return;
-	case 3:
-		whence++;
-		stress_memcpy_naive_o0(b, b_str, str_shared, aligned_buf);
-		return;
-	default:
-		stress_memcpy_naive_o3(b, b_str, str_shared, aligned_buf);
-		whence = 0;
-		return;
-	}
+	(void)b;
+	(void)b_str;
+	(void)str_shared;
+	(void)aligned_buf;
 }
 
 static const stress_memcpy_method_info_t stress_memcpy_methods[] = {
@@ -271,6 +276,8 @@ static const stress_memcpy_method_info_t stress_memcpy_methods[] = {
 	{ NULL,         NULL }
 };
 
+static stress_metrics_t stress_memcpy_metrics[SIZEOF_ARRAY(stress_memcpy_methods)];
+
 /*
  *  stress_set_memcpy_method()
  *      set default memcpy stress method
@@ -300,6 +307,332 @@ static void stress_memcpy_set_default(void)
 	stress_set_memcpy_method("all");
 }
 
+/*
+ *  stress_memcpy_small()
+ *	copy fewer bytes than a vector, using overlapping
+ *	8 or 4 byte moves where possible
+ */
+static inline void stress_memcpy_small(uint8_t *d, const uint8_t *s, size_t n)
+{
+	if (n >= 8) {
+		register size_t i;
+
+		for (i = 0; i + 8 <= n; i += 8)
+			__builtin_memcpy(d + i, s + i, 8);
+		__builtin_memcpy(d + n - 8, s + n - 8, 8);
+	} else if (n >= 4) {
+		__builtin_memcpy(d, s, 4);
+		__builtin_memcpy(d + n - 4, s + n - 4, 4);
+	} else {
+		while (n--)
+			*(d++) = *(s++);
+	}
+}
+
+#if defined(STRESS_ARCH_X86_64)
+/*
+ *  stress_memcpy_rep_movsb()
+ *	x86 string copy, fast when the cpu has ERMS and,
+ *	for short copies, FSRM
+ */
+static void *stress_memcpy_rep_movsb(void *dest, const void *src, size_t n)
+{
+	void *d = dest;
+
+	__asm__ __volatile__("rep movsb"
+		: "+D" (d), "+S" (src), "+c" (n)
+		:
+		: "memory");
+	return dest;
+}
+
+static bool stress_memcpy_has_rep_movsb(void)
+{
+	return true;
+}
+#endif
+
+/*
+ *  Hand written unaligned vector copies, the tail is copied by one
+ *  final vector that overlaps the previous one, unrolled 4 times
+ */
+#if defined(STRESS_MEMCPY_HAVE_X86_VEC)
+#define STRESS_MEMCPY_VEC(name, isa, vtype, load, store)		\
+static void * OPTIMIZE3 __attribute__((target(isa))) name(		\
+	void *dest,							\
+	const void *src,						\
+	size_t n)							\
+{									\
+	register uint8_t *d = (uint8_t *)dest;				\
+	register const uint8_t *s = (const uint8_t *)src;		\
+	const size_t vlen = sizeof(vtype);				\
+	vtype last;							\
+									\
+	if (n < vlen) {							\
+		stress_memcpy_small(d, s, n);				\
+		return dest;						\
+	}								\
+	last = load((const vtype *)(s + n - vlen));			\
+	while (n >= 4 * vlen) {						\
+		const vtype v0 = load((const vtype *)(s + (0 * vlen)));	\
+		const vtype v1 = load((const vtype *)(s + (1 * vlen)));	\
+		const vtype v2 = load((const vtype *)(s + (2 * vlen)));	\
+		const vtype v3 = load((const vtype *)(s + (3 * vlen)));	\
+									\
+		store((vtype *)(d + (0 * vlen)), v0);			\
+		store((vtype *)(d + (1 * vlen)), v1);			\
+		store((vtype *)(d + (2 * vlen)), v2);			\
+		store((vtype *)(d + (3 * vlen)), v3);			\
+		d += 4 * vlen;						\
+		s += 4 * vlen;						\
+		n -= 4 * vlen;						\
+	}								\
+	while (n > vlen) {						\
+		store((vtype *)d, load((const vtype *)s));		\
+		d += vlen;						\
+		s += vlen;						\
+		n -= vlen;						\
+	}								\
+	store((vtype *)(d + n - vlen), last);				\
+	return dest;							\
+}
+
+STRESS_MEMCPY_VEC(stress_memcpy_avx2, "avx2", __m256i, _mm256_loadu_si256, _mm256_storeu_si256)
+STRESS_MEMCPY_VEC(stress_memcpy_avx512, "avx512f", __m512i, _mm512_loadu_si512, _mm512_storeu_si512)
+
+static bool stress_memcpy_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static bool stress_memcpy_has_avx512(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+static bool stress_memcpy_has_always(void)
+{
+	return true;
+}
+
+typedef struct {
+	const char *name;
+	memcpy_func_t func;
+	bool (*supported)(void);
+} stress_memcpy_sweep_method_t;
+
+static void *stress_memcpy_sweep_builtin(void *dest, const void *src, size_t n)
+{
+	return __builtin_memcpy(dest, src, n);
+}
+
+static const stress_memcpy_sweep_method_t memcpy_sweep_methods[] = {
+	{ "libc",	memcpy,				stress_memcpy_has_always },
+	{ "builtin",	stress_memcpy_sweep_builtin,	stress_memcpy_has_always },
+#if defined(STRESS_ARCH_X86_64)
+	{ "rep_movsb",	stress_memcpy_rep_movsb,	stress_memcpy_has_rep_movsb },
+#endif
+#if defined(STRESS_MEMCPY_HAVE_X86_VEC)
+	{ "avx2",	stress_memcpy_avx2,		stress_memcpy_has_avx2 },
+	{ "avx512",	stress_memcpy_avx512,		stress_memcpy_has_avx512 },
+#endif
+};
+
+static const size_t memcpy_sweep_sizes[] = {
+	8, 16, 32, 64, 128, 256, 512, 1 * KB, 4 * KB, 16 * KB, 64 * KB,
+	256 * KB, 1 * MB, 4 * MB, 16 * MB, 64 * MB
+};
+
+/* source and destination offsets from a 64 byte boundary */
+static const struct {
+	const size_t src;
+	const size_t dst;
+} memcpy_sweep_offsets[] = {
+	{ 0, 0 }, { 1, 0 }, { 0, 1 }, { 7, 7 }, { 33, 0 }, { 0, 33 }
+};
+
+#define MEMCPY_SWEEP_METHODS	(SIZEOF_ARRAY(memcpy_sweep_methods))
+#define MEMCPY_SWEEP_SIZES	(SIZEOF_ARRAY(memcpy_sweep_sizes))
+#define MEMCPY_SWEEP_OFFSETS	(SIZEOF_ARRAY(memcpy_sweep_offsets))
+
+typedef struct {
+	double duration;	/* time spent copying */
+	double copies;		/* number of copies */
+} stress_memcpy_sweep_point_t;
+
+typedef stress_memcpy_sweep_point_t stress_memcpy_sweep_points_t[MEMCPY_SWEEP_METHODS][MEMCPY_SWEEP_SIZES][MEMCPY_SWEEP_OFFSETS];
+
+/*
+ *  stress_memcpy_sweep_continue()
+ *	keep_stressing() without --rate pacing, pacing the
+ *	copies would skew the measurements
+ */
+static inline bool stress_memcpy_sweep_continue(const stress_args_t *args)
+{
+	if (!keep_stressing_flag())
+		return false;
+	return !(args->max_ops && (get_counter(args) >= args->max_ops));
+}
+
+/*
+ *  stress_memcpy_sweep_report()
+ *	log the GB/s of each size and alignment and the ns per copy
+ *	of aligned copies, aligned copies are reported as metrics,
+ *	ns per copy for copies under 4K where dispatch overhead
+ *	dominates and GB per sec for the larger copies
+ */
+static void stress_memcpy_sweep_report(
+	const stress_args_t *args,
+	stress_memcpy_sweep_points_t *points)
+{
+	size_t i, j, k, n = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: memcpy sweep, ERMS %s, FSRM %s\n", args->name,
+			stress_cpu_x86_has_erms() ? "yes" : "no",
+			stress_cpu_x86_has_fsrm() ? "yes" : "no");
+		pr_inf("%s: method        size  ns/copy  GB/sec for src/dst offsets 0/0 1/0 0/1 7/7 33/0 0/33\n",
+			args->name);
+	}
+
+	for (i = 0; i < MEMCPY_SWEEP_METHODS; i++) {
+		for (j = 0; j < MEMCPY_SWEEP_SIZES; j++) {
+			const size_t size = memcpy_sweep_sizes[j];
+			double rates[MEMCPY_SWEEP_OFFSETS], ns = 0.0;
+			char size_str[16], str[64];
+			bool measured = false;
+
+			for (k = 0; k < MEMCPY_SWEEP_OFFSETS; k++) {
+				const stress_memcpy_sweep_point_t *point = &(*points)[i][j][k];
+
+				rates[k] = 0.0;
+				if ((point->duration <= 0.0) || (point->copies <= 0.0))
+					continue;
+				rates[k] = ((point->copies * (double)size) / point->duration) / (double)GB;
+				if (k == 0) {
+					ns = (point->duration * STRESS_DBL_NANOSECOND) / point->copies;
+					measured = true;
+				}
+			}
+			if (!measured)
+				continue;
+
+			if (size >= MB)
+				(void)snprintf(size_str, sizeof(size_str), "%zuM", size / (size_t)MB);
+			else if (size >= KB)
+				(void)snprintf(size_str, sizeof(size_str), "%zuK", size / (size_t)KB);
+			else
+				(void)snprintf(size_str, sizeof(size_str), "%zu", size);
+
+			if (args->instance == 0)
+				pr_inf("%s: %-9s %6s %10.2f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f\n",
+					args->name, memcpy_sweep_methods[i].name, size_str, ns,
+					rates[0], rates[1], rates[2], rates[3], rates[4], rates[5]);
+
+			if (size < 4 * KB) {
+				(void)snprintf(str, sizeof(str), "%s %s byte ns per copy",
+					memcpy_sweep_methods[i].name, size_str);
+				stress_metrics_set(args, n, str, ns);
+			} else {
+				(void)snprintf(str, sizeof(str), "%s %s GB per sec",
+					memcpy_sweep_methods[i].name, size_str);
+				stress_metrics_set(args, n, str, rates[0]);
+			}
+			n++;
+		}
+	}
+
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_memcpy_sweep()
+ *	copy each size at each source and destination alignment with
+ *	each method, each point copies about MEMCPY_SWEEP_BYTES per
+ *	sweep and the sweep repeats, accumulating, until the run ends
+ */
+static int stress_memcpy_sweep(const stress_args_t *args)
+{
+	const size_t buf_size = MEMCPY_SWEEP_MAX_SIZE + MEMCPY_SWEEP_MAX_OFFSET;
+	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	stress_memcpy_sweep_points_t *points;
+	bool supported[MEMCPY_SWEEP_METHODS];
+	uint8_t *src, *dst;
+	size_t i, j, k;
+	int rc = EXIT_SUCCESS;
+
+	points = (stress_memcpy_sweep_points_t *)calloc(1, sizeof(*points));
+	if (!points) {
+		pr_inf_skip("%s: cannot allocate sweep results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	src = (uint8_t *)mmap(NULL, buf_size * 2, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (src == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte sweep buffers, skipping stressor\n",
+			args->name, buf_size * 2);
+		free(points);
+		return EXIT_NO_RESOURCE;
+	}
+	dst = src + buf_size;
+	stress_rndbuf(src, buf_size);
+	(void)memset(dst, 0, buf_size);
+
+	for (i = 0; i < MEMCPY_SWEEP_METHODS; i++)
+		supported[i] = memcpy_sweep_methods[i].supported();
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (i = 0; i < MEMCPY_SWEEP_METHODS; i++) {
+			const memcpy_func_t func = memcpy_sweep_methods[i].func;
+
+			if (!supported[i])
+				continue;
+			for (j = 0; j < MEMCPY_SWEEP_SIZES; j++) {
+				const size_t size = memcpy_sweep_sizes[j];
+				const size_t copies = (size >= MEMCPY_SWEEP_BYTES) ?
+					1 : MEMCPY_SWEEP_BYTES / size;
+
+				for (k = 0; k < MEMCPY_SWEEP_OFFSETS; k++) {
+					stress_memcpy_sweep_point_t *point = &(*points)[i][j][k];
+					uint8_t *d = dst + memcpy_sweep_offsets[k].dst;
+					const uint8_t *s = src + memcpy_sweep_offsets[k].src;
+					register size_t c;
+					double t;
+
+					t = stress_time_now();
+					for (c = 0; c < copies; c++)
+						(void)func(d, s, size);
+					point->duration += stress_time_now() - t;
+					point->copies += (double)copies;
+					add_counter(args, copies);
+
+					if (verify && memcmp(d, s, size)) {
+						pr_fail("%s: %s: %zu byte copy at offsets %zu/%zu is different than expected\n",
+							args->name, memcpy_sweep_methods[i].name, size,
+							memcpy_sweep_offsets[k].src, memcpy_sweep_offsets[k].dst);
+						rc = EXIT_FAILURE;
+					}
+					if (!stress_memcpy_sweep_continue(args))
+						goto report;
+				}
+			}
+		}
+	} while (stress_memcpy_sweep_continue(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_memcpy_sweep_report(args, points);
+
+	(void)munmap((void *)src, buf_size * 2);
+	free(points);
+
+	return rc;
+}
+
 /*
  *  stress_memcpy()
  *	stress memory copies
@@ -311,9 +644,15 @@ static int stress_memcpy(const stress_args_t *args)
 	uint8_t *str_shared = g_shared->str_shared;
 	uint8_t *aligned_buf = stress_align_address(b.buffer, ALIGN_SIZE);
 	const stress_memcpy_method_info_t *memcpy_method = &stress_memcpy_methods[0];
+	size_t i, method, next = 1;
+	bool memcpy_sweep = false;
 
 	s_args_name = args->name;
 
+	(void)stress_get_setting("memcpy-sweep", &memcpy_sweep);
+	if (memcpy_sweep)
+		return stress_memcpy_sweep(args);
+
 	if (g_opt_flags & OPT_FLAGS_VERIFY) {
 		memcpy_check = memcpy_check_func;
 		memmove_check = memmove_check_func;
@@ -324,22 +663,58 @@ static int stress_memcpy(const stress_args_t *args)
 
 	(void)stress_get_setting("memcpy-method", &memcpy_method);
 
+	method = (size_t)(memcpy_method - stress_memcpy_methods);
+
+	for (i = 0; i < SIZEOF_ARRAY(stress_memcpy_metrics); i++) {
+		stress_memcpy_metrics[i].duration = 0.0;
+		stress_memcpy_metrics[i].count = 0.0;
+	}
+
 	stress_rndbuf(aligned_buf, ALIGN_SIZE);
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
-		memcpy_method->func(&b, b_str, str_shared, aligned_buf);
+		double t;
+
+		/* 'all' method, iterate over all the methods */
+		if (memcpy_method == &stress_memcpy_methods[0]) {
+			method = next;
+			next++;
+			if (!stress_memcpy_methods[next].func)
+				next = 1;
+		}
+		t = stress_time_now();
+		stress_memcpy_methods[method].func(&b, b_str, str_shared, aligned_buf);
+		stress_memcpy_metrics[method].duration += stress_time_now() - t;
+		stress_memcpy_metrics[method].count += 1.0;
 		inc_counter(args);
 	} while (keep_stressing(args));
 
+	/* dump metrics of methods except for first "all" method */
+	for (i = 1; stress_memcpy_methods[i].func; i++) {
+		if (stress_memcpy_metrics[i].duration > 0.0) {
+			char msg[64];
+			const double rate = stress_memcpy_metrics[i].count / stress_memcpy_metrics[i].duration;
+
+			(void)snprintf(msg, sizeof(msg), "%s memcpy ops per sec", stress_memcpy_methods[i].name);
+			stress_metrics_set(args, i - 1, msg, rate);
+		}
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
 	return EXIT_SUCCESS;
 }
 
+static int stress_set_memcpy_sweep(const char *opt)
+{
+	return stress_set_setting_true("memcpy-sweep", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_memcpy_method,	stress_set_memcpy_method },
+	{ OPT_memcpy_sweep,	stress_set_memcpy_sweep },
 	{ 0,			NULL }
 };
 
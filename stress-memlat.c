@@ -0,0 +1,530 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cpu-cache.h"
+#include "core-put.h"
+
+#define MIN_MEMLAT_MAX_SIZE	(16 * KB)
+#define MAX_MEMLAT_MAX_SIZE	(MAX_MEM_LIMIT)
+
+#define MIN_MEMLAT_SIZE		(4 * KB)	/* smallest working set */
+#define MEMLAT_LINE		(64)		/* chain node size in bytes */
+#define MEMLAT_LINE_PTRS	(MEMLAT_LINE / sizeof(uintptr_t))
+#define MEMLAT_LOADS		(4096)		/* loads between time checks */
+#define MEMLAT_SLICE		(0.05)		/* seconds per measurement */
+#define MEMLAT_HUGE_ALIGN	(2 * MB)	/* transparent huge page size */
+#define MEMLAT_SIZES_MAX	(48)
+
+#define MIN_MEMLAT_STEP_MS	(100)
+#define MAX_MEMLAT_STEP_MS	(60000)
+#define DEFAULT_MEMLAT_STEP_MS	(1000)
+
+#define MEMLAT_LOADED_PERIOD	(0.001)		/* load duty cycle period in seconds */
+#define MEMLAT_LOADED_CHUNK	(64 * KB)	/* bytes copied per load chunk */
+
+typedef struct {
+	const char *name;	/* page mode name */
+	const char *tag;	/* metric name tag */
+	const int advice;	/* madvise advice */
+} stress_memlat_mode_t;
+
+typedef struct {
+	uint64_t size;				/* working set size in bytes */
+	double loads[2];			/* loads per page mode */
+	double duration[2];			/* time taken per page mode */
+} stress_memlat_point_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"memlat N",		"start N workers measuring memory load latency" },
+	{ NULL,	"memlat-loaded",	"measure latency whilst other instances load memory" },
+	{ NULL,	"memlat-max-size N",	"maximum working set size to sweep up to" },
+	{ NULL,	"memlat-ops N",		"stop after N latency sweep bogo operations" },
+	{ NULL,	"memlat-step-ms N",	"loaded latency bandwidth step duration in milliseconds" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const stress_memlat_mode_t memlat_modes[] = {
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	{ "4K pages",	"",		MADV_NOHUGEPAGE },
+#else
+	{ "4K pages",	"",		0 },
+#endif
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+	{ "huge pages",	" THP",		MADV_HUGEPAGE },
+#endif
+};
+
+static int stress_set_memlat_max_size(const char *opt)
+{
+	uint64_t memlat_max_size;
+
+	memlat_max_size = stress_get_uint64_byte(opt);
+	stress_check_range_bytes("memlat-max-size", memlat_max_size,
+		MIN_MEMLAT_MAX_SIZE, MAX_MEMLAT_MAX_SIZE);
+	return stress_set_setting("memlat-max-size", TYPE_ID_UINT64, &memlat_max_size);
+}
+
+static int stress_set_memlat_loaded(const char *opt)
+{
+	return stress_set_setting_true("memlat-loaded", opt);
+}
+
+static int stress_set_memlat_step_ms(const char *opt)
+{
+	uint32_t memlat_step_ms;
+
+	memlat_step_ms = stress_get_uint32(opt);
+	stress_check_range("memlat-step-ms", (uint64_t)memlat_step_ms,
+		MIN_MEMLAT_STEP_MS, MAX_MEMLAT_STEP_MS);
+	return stress_set_setting("memlat-step-ms", TYPE_ID_UINT32, &memlat_step_ms);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_memlat_loaded,	stress_set_memlat_loaded },
+	{ OPT_memlat_max_size,	stress_set_memlat_max_size },
+	{ OPT_memlat_step_ms,	stress_set_memlat_step_ms },
+	{ 0,			NULL }
+};
+
+/*
+ *  stress_memlat_size_str()
+ *	size in human readable K, M or G units
+ */
+static void stress_memlat_size_str(char *str, const size_t len, const uint64_t size)
+{
+	if (size >= GB)
+		(void)snprintf(str, len, "%" PRIu64 "G", size / (uint64_t)GB);
+	else if (size >= MB)
+		(void)snprintf(str, len, "%" PRIu64 "M", size / (uint64_t)MB);
+	else
+		(void)snprintf(str, len, "%" PRIu64 "K", size / (uint64_t)KB);
+}
+
+/*
+ *  stress_memlat_level()
+ *	name of the smallest cache level the working set fits in
+ */
+static const char *stress_memlat_level(const uint64_t size, const size_t *cache_sizes)
+{
+	static const char * const names[] = { "L1", "L2", "L3" };
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(names); i++) {
+		if (cache_sizes[i] && (size <= (uint64_t)cache_sizes[i]))
+			return names[i];
+	}
+	return "DRAM";
+}
+
+/*
+ *  stress_memlat_chain()
+ *	link the cache lines of the first size bytes of buf into a
+ *	randomly ordered cyclic chain using Sattolo's algorithm so
+ *	that each load depends on the previous one and the hardware
+ *	prefetchers cannot predict the next line
+ */
+static void *stress_memlat_chain(void *buf, const uint64_t size)
+{
+	const uint32_t lines = (uint32_t)(size / MEMLAT_LINE);
+	uintptr_t *ptr = (uintptr_t *)buf;
+	uint32_t i;
+
+	for (i = 0; i < lines; i++)
+		ptr[i * MEMLAT_LINE_PTRS] = (uintptr_t)i;
+	for (i = lines - 1; i > 0; i--) {
+		const uint32_t j = stress_mwc32modn(i);
+		const uintptr_t tmp = ptr[i * MEMLAT_LINE_PTRS];
+
+		ptr[i * MEMLAT_LINE_PTRS] = ptr[j * MEMLAT_LINE_PTRS];
+		ptr[j * MEMLAT_LINE_PTRS] = tmp;
+	}
+	for (i = 0; i < lines; i++)
+		ptr[i * MEMLAT_LINE_PTRS] = (uintptr_t)&ptr[ptr[i * MEMLAT_LINE_PTRS] * MEMLAT_LINE_PTRS];
+
+	return buf;
+}
+
+/*
+ *  stress_memlat_chase()
+ *	follow the chain for MEMLAT_SLICE seconds, one pass over
+ *	the chain is made first to warm the caches and TLBs
+ */
+static void OPTIMIZE3 stress_memlat_chase(
+	void *head,
+	const uint64_t size,
+	double *loads,
+	double *duration)
+{
+	register void **ptr = (void **)head;
+	register uint64_t i, n = 0;
+	const uint64_t lines = size / MEMLAT_LINE;
+	double t1, t2;
+
+	for (i = 0; i < lines; i++)
+		ptr = (void **)*ptr;
+
+	t1 = stress_time_now();
+	do {
+		for (i = 0; i < MEMLAT_LOADS; i += 16) {
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+		}
+		n += MEMLAT_LOADS;
+		t2 = stress_time_now();
+	} while ((t2 - t1) < MEMLAT_SLICE);
+
+	stress_void_ptr_put((void *)ptr);
+	*loads += (double)n;
+	*duration += t2 - t1;
+}
+
+/*
+ *  stress_memlat_mmap()
+ *	mmap a buffer aligned to the huge page size and apply
+ *	the page mode advice, returns the aligned buffer
+ */
+static void *stress_memlat_mmap(
+	const stress_args_t *args,
+	const uint64_t sz,
+	const stress_memlat_mode_t *mode,
+	void **mapping)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, (size_t)(sz + MEMLAT_HUGE_ALIGN), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		pr_inf_skip("%s: cannot allocate %" PRIu64 " bytes, errno=%d (%s), "
+			"skipping stressor\n", args->name, sz, errno, strerror(errno));
+		return MAP_FAILED;
+	}
+	*mapping = ptr;
+	ptr = (void *)(((uintptr_t)ptr + MEMLAT_HUGE_ALIGN - 1) & ~(uintptr_t)(MEMLAT_HUGE_ALIGN - 1));
+#if defined(HAVE_MADVISE)
+	if (mode->advice)
+		(void)madvise(ptr, (size_t)sz, mode->advice);
+#else
+	(void)mode;
+#endif
+	return ptr;
+}
+
+/*
+ *  stress_memlat_loaded_step()
+ *	the loaded latency step all instances are currently in,
+ *	steps are timed from the shared start time so every
+ *	instance changes step at the same time
+ */
+static inline size_t stress_memlat_loaded_step(const double step_secs)
+{
+	const double t = stress_time_now() - g_shared->memlat.start_time;
+
+	if (t < 0.0)
+		return 0;
+	return (size_t)(t / step_secs) % STRESS_MEMLAT_STEPS;
+}
+
+/*
+ *  stress_memlat_loaded_generate()
+ *	generate memory traffic in 1 millisecond periods, the busy
+ *	part of each period increases with the step so the bandwidth
+ *	goes from idle to unthrottled over the steps
+ */
+static void stress_memlat_loaded_generate(
+	const stress_args_t *args,
+	const double step_secs,
+	const uint64_t sz)
+{
+	uint8_t *buf, *src, *dst;
+	const size_t half = (size_t)(sz / 2) & ~(size_t)(MEMLAT_LOADED_CHUNK - 1);
+	size_t offset = 0;
+
+	buf = (uint8_t *)mmap(NULL, (size_t)sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf("%s: cannot allocate %" PRIu64 " byte load buffer, errno=%d (%s), "
+			"no load will be generated\n", args->name, sz, errno, strerror(errno));
+		return;
+	}
+	(void)memset(buf, 0x5a, (size_t)sz);
+	src = buf;
+	dst = buf + half;
+
+	do {
+		const size_t step = stress_memlat_loaded_step(step_secs);
+		const double busy = MEMLAT_LOADED_PERIOD * (double)step / (double)(STRESS_MEMLAT_STEPS - 1);
+		const double t1 = stress_time_now();
+		double t2 = t1;
+		uint64_t bytes = 0;
+
+		while ((t2 - t1) < busy) {
+			(void)memcpy(dst + offset, src + offset, MEMLAT_LOADED_CHUNK);
+			bytes += 2 * MEMLAT_LOADED_CHUNK;
+			offset += MEMLAT_LOADED_CHUNK;
+			if (offset >= half)
+				offset = 0;
+			t2 = stress_time_now();
+		}
+#if defined(HAVE_ATOMIC_ADD_FETCH) &&	\
+    defined(__ATOMIC_RELAXED)
+		__atomic_add_fetch(&g_shared->memlat.bytes[step], bytes, __ATOMIC_RELAXED);
+#else
+		g_shared->memlat.bytes[step] += bytes;
+#endif
+		if (busy < MEMLAT_LOADED_PERIOD)
+			(void)shim_nanosleep_uint64((uint64_t)((MEMLAT_LOADED_PERIOD - (t2 - t1)) * STRESS_DBL_NANOSECOND));
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	(void)munmap((void *)buf, (size_t)sz);
+}
+
+/*
+ *  stress_memlat_loaded_probe()
+ *	chase a DRAM sized chain and attribute the loads to the step
+ *	the load generators are in, then report latency against the
+ *	total bandwidth of the load generators for each step
+ */
+static int stress_memlat_loaded_probe(
+	const stress_args_t *args,
+	const double step_secs,
+	const uint64_t sz)
+{
+	const stress_memlat_mode_t *mode = &memlat_modes[SIZEOF_ARRAY(memlat_modes) - 1];
+	double loads[STRESS_MEMLAT_STEPS], duration[STRESS_MEMLAT_STEPS];
+	void *mapping, *buf;
+	register void **ptr;
+	size_t i, idx = 0;
+
+	buf = stress_memlat_mmap(args, sz, mode, &mapping);
+	if (buf == MAP_FAILED)
+		return EXIT_NO_RESOURCE;
+	ptr = (void **)stress_memlat_chain(buf, sz);
+
+	(void)memset(loads, 0, sizeof(loads));
+	(void)memset(duration, 0, sizeof(duration));
+
+	do {
+		const size_t step = stress_memlat_loaded_step(step_secs);
+		const double t1 = stress_time_now();
+		register int j;
+
+		for (j = 0; j < MEMLAT_LOADS; j++)
+			ptr = (void **)*ptr;
+		loads[step] += (double)MEMLAT_LOADS;
+		duration[step] += stress_time_now() - t1;
+		inc_counter(args);
+	} while (keep_stressing(args));
+	stress_void_ptr_put((void *)ptr);
+
+	pr_lock();
+	pr_inf("%s: %4s %14s %14s\n", args->name, "step", "MB per sec", "ns per load");
+	for (i = 0; i < STRESS_MEMLAT_STEPS; i++) {
+		double mbs, ns;
+		char desc[64];
+
+		if (duration[i] <= 0.0)
+			continue;
+		mbs = ((double)g_shared->memlat.bytes[i] / (double)MB) / duration[i];
+		ns = (duration[i] * STRESS_DBL_NANOSECOND) / loads[i];
+		pr_inf("%s: %4zu %14.2f %14.2f\n", args->name, i, mbs, ns);
+
+		(void)snprintf(desc, sizeof(desc), "step %zu bandwidth (MB per sec)", i);
+		stress_metrics_set(args, idx++, desc, mbs);
+		(void)snprintf(desc, sizeof(desc), "step %zu latency (ns per load)", i);
+		stress_metrics_set(args, idx++, desc, ns);
+	}
+	pr_unlock();
+
+	(void)munmap(mapping, (size_t)(sz + MEMLAT_HUGE_ALIGN));
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_memlat_loaded()
+ *	instance 0 probes the latency whilst the other instances
+ *	generate stepped amounts of memory traffic
+ */
+static int stress_memlat_loaded(const stress_args_t *args, const uint64_t sz)
+{
+	uint32_t memlat_step_ms = DEFAULT_MEMLAT_STEP_MS;
+	double step_secs;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("memlat-step-ms", &memlat_step_ms);
+	step_secs = (double)memlat_step_ms / STRESS_DBL_MILLISECOND;
+
+	if (args->instance == 0) {
+		if (args->num_instances < 2)
+			pr_inf("%s: loaded latency needs more than 1 instance to generate "
+				"memory load, just measuring idle latency\n", args->name);
+		else
+			pr_inf("%s: measuring latency with %" PRIu32 " load generating instances, "
+				"%d steps of %.3f seconds\n", args->name, args->num_instances - 1,
+				STRESS_MEMLAT_STEPS, step_secs);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	if (args->instance == 0)
+		rc = stress_memlat_loaded_probe(args, step_secs, sz);
+	else
+		stress_memlat_loaded_generate(args, step_secs, sz / (args->num_instances - 1));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	return rc;
+}
+
+/*
+ *  stress_memlat_init()
+ *	set the loaded latency step time base and clear the
+ *	load generator byte counts
+ */
+static void stress_memlat_init(void)
+{
+	g_shared->memlat.start_time = stress_time_now();
+	(void)memset(g_shared->memlat.bytes, 0, sizeof(g_shared->memlat.bytes));
+}
+
+/*
+ *  stress_memlat()
+ *	stress memory with dependent loads and measure the load
+ *	to use latency over working sets from L1 to DRAM
+ */
+static int stress_memlat(const stress_args_t *args)
+{
+	stress_memlat_point_t points[MEMLAT_SIZES_MAX];
+	size_t cache_sizes[3], i, j, num_points = 0, idx = 0;
+	size_t cache_line_size;
+	uint64_t size, memlat_max_size = 0;
+	bool memlat_loaded = false;
+	void *bufs[SIZEOF_ARRAY(memlat_modes)], *mappings[SIZEOF_ARRAY(memlat_modes)];
+
+	for (i = 0; i < SIZEOF_ARRAY(cache_sizes); i++)
+		stress_cpu_cache_get_level_size((uint16_t)(i + 1), &cache_sizes[i], &cache_line_size);
+
+	/*
+	 *  Sweep power of 2 sizes up to 4 x the last level cache
+	 *  so the largest working sets have to be fetched from DRAM
+	 */
+	if (!stress_get_setting("memlat-max-size", &memlat_max_size)) {
+		uint64_t llc = MEM_CACHE_SIZE;
+
+		for (i = 0; i < SIZEOF_ARRAY(cache_sizes); i++) {
+			if (cache_sizes[i])
+				llc = cache_sizes[i];
+		}
+		memlat_max_size = llc * 4;
+	}
+
+	(void)stress_get_setting("memlat-loaded", &memlat_loaded);
+	if (memlat_loaded)
+		return stress_memlat_loaded(args, memlat_max_size);
+
+	(void)memset(points, 0, sizeof(points));
+	for (size = MIN_MEMLAT_SIZE; (size <= memlat_max_size) && (num_points < MEMLAT_SIZES_MAX); size <<= 1)
+		points[num_points++].size = size;
+	memlat_max_size = points[num_points - 1].size;
+
+	for (i = 0; i < SIZEOF_ARRAY(memlat_modes); i++) {
+		bufs[i] = stress_memlat_mmap(args, memlat_max_size, &memlat_modes[i], &mappings[i]);
+		if (bufs[i] == MAP_FAILED) {
+			while (i > 0) {
+				i--;
+				(void)munmap(mappings[i], (size_t)(memlat_max_size + MEMLAT_HUGE_ALIGN));
+			}
+			return EXIT_NO_RESOURCE;
+		}
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; i < num_points; i++) {
+			for (j = 0; j < SIZEOF_ARRAY(memlat_modes); j++) {
+				void *head = stress_memlat_chain(bufs[j], points[i].size);
+
+				stress_memlat_chase(head, points[i].size,
+					&points[i].loads[j], &points[i].duration[j]);
+			}
+			inc_counter(args);
+			if (!keep_stressing(args))
+				break;
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %8s %-5s %12s %12s\n", args->name, "size", "level",
+			"ns (4K)", "ns (THP)");
+	}
+	for (i = 0; i < num_points; i++) {
+		const stress_memlat_point_t *point = &points[i];
+		double ns[2] = { -1.0, -1.0 };
+		char str[16], desc[64];
+
+		stress_memlat_size_str(str, sizeof(str), point->size);
+		for (j = 0; j < SIZEOF_ARRAY(memlat_modes); j++) {
+			if (point->duration[j] <= 0.0)
+				continue;
+			ns[j] = (point->duration[j] * STRESS_DBL_NANOSECOND) / point->loads[j];
+			(void)snprintf(desc, sizeof(desc), "%s%s latency (ns per load)",
+				str, memlat_modes[j].tag);
+			stress_metrics_set(args, idx++, desc, ns[j]);
+		}
+		if ((args->instance == 0) && (ns[0] > 0.0)) {
+			pr_inf("%s: %8s %-5s %12.2f %12.2f\n", args->name, str,
+				stress_memlat_level(point->size, cache_sizes),
+				ns[0], ns[1]);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	for (i = 0; i < SIZEOF_ARRAY(memlat_modes); i++)
+		(void)munmap(mappings[i], (size_t)(memlat_max_size + MEMLAT_HUGE_ALIGN));
+
+	return EXIT_SUCCESS;
+}
+
+stressor_info_t stress_memlat_info = {
+	.stressor = stress_memlat,
+	.class = CLASS_MEMORY | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
+	.init = stress_memlat_init,
+	.help = help
+};
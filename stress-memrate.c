@@ -20,6 +20,7 @@
 #include "stress-ng.h"
 #include "core-cpu-cache.h"
 #include "core-nt-store.h"
+#include "core-perf.h"
 #include "core-target-clones.h"
 #include "core-vecmath.h"
 
@@ -33,13 +34,32 @@
 
 #define STRESS_PTR_MINIMUM(a, b)	STRESS_MINIMUM((uintptr_t)a, (uintptr_t)b)
 
+#define MIN_MEMRATE_TARGET_MBS	(1)
+#define MAX_MEMRATE_TARGET_MBS	(1000000)
+#define MEMRATE_TARGET_SLOTS	(3600)		/* per second achieved rates */
+#define MEMRATE_TARGET_PACE	(250000)		/* nanoseconds of I/O per chunk */
+#define MEMRATE_TARGET_LAG	(1000000)	/* max nanoseconds behind target */
+
+#define MR_TARGET_READ		(0)
+#define MR_TARGET_WRITE		(1)
+#define MR_TARGET_RDWR		(2)
+
+#if defined(HAVE_ATOMIC_FETCH_ADD) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_LOAD)
+#define HAVE_MEMRATE_TARGET
+#endif
+
 static const stress_help_t help[] = {
 	{ NULL,	"memrate N",		"start N workers exercised memory read/writes" },
+	{ NULL,	"memrate-backing B",	"specify buffer backing, 4k, thp, 2m or 1g pages" },
 	{ NULL,	"memrate-bytes N",	"size of memory buffer being exercised" },
 	{ NULL,	"memrate-ops N",	"stop after N memrate bogo operations" },
 	{ NULL,	"memrate-rd-mbs N",	"read rate from buffer in megabytes per second" },
 	{ NULL,	"memrate-wr-mbs N",	"write rate to buffer in megabytes per second" },
 	{ NULL,	"memrate-flush",	"flush cache before each iteration" },
+	{ NULL,	"memrate-target-mbs N",	"generate an aggregate N megabytes per second over all workers" },
+	{ NULL,	"memrate-target-op O",	"target bandwidth operation, read, write or rdwr" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -55,6 +75,7 @@ static sigjmp_buf jmpbuf;
 typedef struct {
 	double		duration;
 	double		kbytes;
+	double		dtlb_misses;
 	bool		valid;
 } stress_memrate_stats_t;
 
@@ -66,8 +87,30 @@ typedef struct {
 	void *start;
 	void *end;
 	bool memrate_flush;
+	bool has_backing;
+	size_t memrate_backing;
 } stress_memrate_context_t;
 
+/*
+ *  aggregate target bandwidth state shared by all instances, each
+ *  chunk claims the next bytes of the global byte stream and waits
+ *  until the time that byte offset is due at the target rate
+ */
+typedef struct {
+	uint64_t start_ns;		/* pacing start time, 0 = not started */
+	uint64_t claimed;		/* bytes claimed by all instances */
+	uint64_t lag_skipped;		/* bytes skipped when behind target */
+	uint64_t slot_bytes[MEMRATE_TARGET_SLOTS];	/* bytes done per second */
+	uint64_t target_mbs;		/* target MB per second */
+	size_t op;			/* MR_TARGET_* operation */
+} stress_memrate_target_t;
+
+static stress_memrate_target_t *memrate_target;
+
+static const char * const memrate_target_ops[] = {
+	"read", "write", "rdwr",
+};
+
 typedef uint64_t (*stress_memrate_func_t)(const stress_memrate_context_t *context, bool *valid);
 
 typedef struct {
@@ -77,6 +120,11 @@ typedef struct {
 	stress_memrate_func_t	func_rate;
 } stress_memrate_info_t;
 
+static int stress_set_memrate_backing(const char *opt)
+{
+	return stress_set_mmap_backing("memrate-backing", opt);
+}
+
 static int stress_set_memrate_bytes(const char *opt)
 {
 	uint64_t memrate_bytes;
@@ -107,6 +155,31 @@ static int stress_set_memrate_wr_mbs(const char *opt)
 	return stress_set_setting("memrate-wr-mbs", TYPE_ID_UINT64, &memrate_wr_mbs);
 }
 
+static int stress_set_memrate_target_mbs(const char *opt)
+{
+	uint64_t memrate_target_mbs;
+
+	memrate_target_mbs = stress_get_uint64(opt);
+	stress_check_range("memrate-target-mbs", memrate_target_mbs,
+		MIN_MEMRATE_TARGET_MBS, MAX_MEMRATE_TARGET_MBS);
+	return stress_set_setting("memrate-target-mbs", TYPE_ID_UINT64, &memrate_target_mbs);
+}
+
+static int stress_set_memrate_target_op(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(memrate_target_ops); i++) {
+		if (!strcmp(opt, memrate_target_ops[i]))
+			return stress_set_setting("memrate-target-op", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "memrate-target-op option '%s' not known, options are:", opt);
+	for (i = 0; i < SIZEOF_ARRAY(memrate_target_ops); i++)
+		(void)fprintf(stderr, " %s", memrate_target_ops[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
 static void NORETURN MLOCKED_TEXT stress_memrate_alarm_handler(int signum)
 {
         (void)signum;
@@ -949,10 +1022,34 @@ static void OPTIMIZE3 stress_memrate_init_data(
 		*ptr = stress_mwc32();
 }
 
-static inline void *stress_memrate_mmap(const stress_args_t *args, uint64_t sz)
+static NOINLINE void *stress_memrate_mmap(
+	const stress_args_t *args,
+	stress_memrate_context_t *context)
 {
+	const uint64_t sz = context->memrate_bytes;
 	void *ptr;
 
+	if (context->has_backing) {
+		size_t len = (size_t)sz;
+
+		ptr = stress_mmap_backing(context->memrate_backing, &len,
+			PROT_READ | PROT_WRITE,
+#if defined(MAP_POPULATE)
+			MAP_POPULATE |
+#endif
+			MAP_PRIVATE | MAP_ANONYMOUS);
+		if (ptr == MAP_FAILED) {
+			pr_inf_skip("%s: cannot allocate %" PRIu64 "K with %s backing, "
+				"errno=%d (%s), skipping stressor\n",
+				args->name, sz / 1024,
+				stress_mmap_backing_name(context->memrate_backing),
+				errno, strerror(errno));
+			return MAP_FAILED;
+		}
+		context->memrate_bytes = (uint64_t)len;
+		return ptr;
+	}
+
 	ptr = mmap(NULL, (size_t)sz, PROT_READ | PROT_WRITE,
 #if defined(MAP_POPULATE)
 		MAP_POPULATE |
@@ -990,14 +1087,205 @@ static inline uint64_t stress_memrate_dispatch(
 	return info->func_rate(context, valid);
 }
 
+#if defined(HAVE_MEMRATE_TARGET)
+static inline uint64_t stress_memrate_target_now_ns(void)
+{
+	return (uint64_t)(stress_time_now() * STRESS_DBL_NANOSECOND);
+}
+
+static uint64_t OPTIMIZE3 stress_memrate_target_read(const void *start, const size_t len)
+{
+	register const volatile uint64_t *ptr = (const volatile uint64_t *)start;
+	register const volatile uint64_t *end = (const volatile uint64_t *)((uintptr_t)start + len);
+	register uint64_t sum = 0;
+
+	while (ptr < end) {
+		sum += ptr[0];
+		sum += ptr[1];
+		sum += ptr[2];
+		sum += ptr[3];
+		sum += ptr[4];
+		sum += ptr[5];
+		sum += ptr[6];
+		sum += ptr[7];
+		ptr += 8;
+	}
+	return sum;
+}
+
+static void OPTIMIZE3 stress_memrate_target_write(void *start, const size_t len, const uint64_t val)
+{
+	register volatile uint64_t *ptr = (volatile uint64_t *)start;
+	register volatile uint64_t *end = (volatile uint64_t *)((uintptr_t)start + len);
+
+	while (ptr < end) {
+		ptr[0] = val;
+		ptr[1] = val;
+		ptr[2] = val;
+		ptr[3] = val;
+		ptr[4] = val;
+		ptr[5] = val;
+		ptr[6] = val;
+		ptr[7] = val;
+		ptr += 8;
+	}
+}
+
+/*
+ *  stress_memrate_target_skip()
+ *	when more than MEMRATE_TARGET_LAG behind the target move
+ *	the global byte stream forward rather than bursting to
+ *	catch up, returns the bytes skipped
+ */
+static uint64_t stress_memrate_target_skip(
+	stress_memrate_target_t *target,
+	const uint64_t start_ns,
+	const uint64_t now_ns,
+	const double bytes_per_ns)
+{
+	const uint64_t floor = (uint64_t)((double)(now_ns - start_ns - MEMRATE_TARGET_LAG) * bytes_per_ns);
+	uint64_t claimed = __atomic_load_n(&target->claimed, __ATOMIC_RELAXED);
+
+	while (claimed < floor) {
+		if (__atomic_compare_exchange_n(&target->claimed, &claimed, floor,
+						false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return floor - claimed;
+	}
+	return 0;
+}
+
+/*
+ *  stress_memrate_target_child()
+ *	generate the aggregate target bandwidth, chunks are sized
+ *	to take MEMRATE_TARGET_PACE at the target rate so pacing is
+ *	sub-millisecond, the wait for a chunk sleeps for the bulk of
+ *	the time and spins for the final part
+ */
+static void stress_memrate_target_child(
+	const stress_args_t *args,
+	const stress_memrate_context_t *context)
+{
+	stress_memrate_target_t *target = memrate_target;
+	const double bytes_per_ns = ((double)target->target_mbs * MB) / STRESS_DBL_NANOSECOND;
+	uint64_t chunk = (uint64_t)(bytes_per_ns * MEMRATE_TARGET_PACE) & ~(uint64_t)4095;
+	uint64_t start_ns, expected = 0, pos = 0, val = stress_mwc64(), n = 0;
+	uint8_t *buffer = (uint8_t *)context->start;
+
+	chunk = STRESS_MAXIMUM(chunk, 4 * KB);
+	chunk = STRESS_MINIMUM(chunk, MB);
+	chunk = STRESS_MINIMUM(chunk, context->memrate_bytes);
+
+	start_ns = stress_memrate_target_now_ns();
+	if (!__atomic_compare_exchange_n(&target->start_ns, &expected, start_ns,
+					 false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		start_ns = expected;
+
+	do {
+		const uint64_t offset = __atomic_fetch_add(&target->claimed, chunk, __ATOMIC_RELAXED);
+		const uint64_t due_ns = start_ns + (uint64_t)((double)(offset + chunk) / bytes_per_ns);
+		uint64_t now_ns = stress_memrate_target_now_ns();
+		uint64_t slot;
+		bool is_read;
+
+		if (now_ns < due_ns) {
+			if (due_ns - now_ns > 100000)
+				(void)shim_nanosleep_uint64(due_ns - now_ns - 60000);
+			while ((now_ns = stress_memrate_target_now_ns()) < due_ns)
+				;
+		} else if (now_ns - due_ns > MEMRATE_TARGET_LAG) {
+			const uint64_t skipped =
+				stress_memrate_target_skip(target, start_ns, now_ns, bytes_per_ns);
+
+			(void)__atomic_fetch_add(&target->lag_skipped, skipped, __ATOMIC_RELAXED);
+		}
+
+		if (pos + chunk > context->memrate_bytes)
+			pos = 0;
+		switch (target->op) {
+		case MR_TARGET_READ:
+			is_read = true;
+			break;
+		case MR_TARGET_WRITE:
+			is_read = false;
+			break;
+		default:
+			is_read = !(n & 1);
+			break;
+		}
+		if (is_read)
+			val += stress_memrate_target_read(buffer + pos, (size_t)chunk);
+		else
+			stress_memrate_target_write(buffer + pos, (size_t)chunk, val);
+		pos += chunk;
+		n++;
+
+		slot = (stress_memrate_target_now_ns() - start_ns) / STRESS_NANOSECOND;
+		if (slot < MEMRATE_TARGET_SLOTS)
+			(void)__atomic_fetch_add(&target->slot_bytes[slot], chunk, __ATOMIC_RELAXED);
+		inc_counter(args);
+	} while (keep_stressing(args));
+}
+
+/*
+ *  stress_memrate_target_report()
+ *	report the achieved vs target bandwidth of the complete
+ *	seconds of the run
+ */
+static void stress_memrate_target_report(const stress_args_t *args)
+{
+	const stress_memrate_target_t *target = memrate_target;
+	const double target_mbs = (double)target->target_mbs;
+	uint64_t slots, i, within = 0;
+	double sum = 0.0, sum_sq = 0.0, min = 0.0, max = 0.0, mean, stddev;
+
+	if (!target->start_ns)
+		return;
+	slots = (stress_memrate_target_now_ns() - target->start_ns) / STRESS_NANOSECOND;
+	slots = STRESS_MINIMUM(slots, MEMRATE_TARGET_SLOTS);
+	if (!slots) {
+		pr_inf("%s: run too short to measure the achieved bandwidth\n", args->name);
+		return;
+	}
+	for (i = 0; i < slots; i++) {
+		const double mbs = (double)target->slot_bytes[i] / (double)MB;
+
+		sum += mbs;
+		sum_sq += mbs * mbs;
+		min = (i == 0) ? mbs : STRESS_MINIMUM(min, mbs);
+		max = (i == 0) ? mbs : STRESS_MAXIMUM(max, mbs);
+		if (fabs(mbs - target_mbs) <= target_mbs * 0.05)
+			within++;
+		pr_dbg("%s: second %" PRIu64 ": %.2f MB/sec\n", args->name, i, mbs);
+	}
+	mean = sum / (double)slots;
+	stddev = sqrt(STRESS_MAXIMUM(0.0, (sum_sq / (double)slots) - (mean * mean)));
+
+	pr_inf("%s: %s target %.0f MB/sec, achieved mean %.2f MB/sec (%.1f%%), "
+		"min %.2f, max %.2f, stddev %.2f MB/sec\n",
+		args->name, memrate_target_ops[target->op], target_mbs, mean,
+		100.0 * mean / target_mbs, min, max, stddev);
+	pr_inf("%s: %" PRIu64 " of %" PRIu64 " seconds within 5%% of target, "
+		"%.2f MB skipped when behind target\n", args->name, within, slots,
+		(double)target->lag_skipped / (double)MB);
+
+	stress_metrics_set(args, 0, "MB per sec target", target_mbs);
+	stress_metrics_set(args, 1, "MB per sec achieved", mean);
+	stress_metrics_set(args, 2, "MB per sec stddev", stddev);
+	stress_metrics_set(args, 3, "% seconds within 5% of target",
+		100.0 * (double)within / (double)slots);
+}
+#endif
+
 static int stress_memrate_child(const stress_args_t *args, void *ctxt)
 {
 	stress_memrate_context_t *context = (stress_memrate_context_t *)ctxt;
 	void *buffer, *buffer_end;
+	int dtlb_fd;
 
-	buffer = stress_memrate_mmap(args, context->memrate_bytes);
+	buffer = stress_memrate_mmap(args, context);
 	if (buffer == MAP_FAILED)
 		return EXIT_NO_RESOURCE;
+	dtlb_fd = stress_perf_dtlb_open();
 
 	buffer_end = (uint8_t *)buffer + context->memrate_bytes;
 	stress_memrate_init_data(buffer, buffer_end);
@@ -1011,6 +1299,13 @@ static int stress_memrate_child(const stress_args_t *args, void *ctxt)
 	if (stress_sighandler(args->name, SIGALRM, stress_memrate_alarm_handler, NULL) < 0)
 		return EXIT_NO_RESOURCE;
 
+#if defined(HAVE_MEMRATE_TARGET)
+	if (memrate_target) {
+		stress_memrate_target_child(args, context);
+		goto tidy;
+	}
+#endif
+
 	do {
 		size_t i;
 
@@ -1019,13 +1314,17 @@ static int stress_memrate_child(const stress_args_t *args, void *ctxt)
 			uint64_t kbytes;
 			stress_memrate_info_t *info = &memrate_info[i];
 			bool valid = false;
+			uint64_t dtlb1 = 0, dtlb2 = 0;
 
 			if (context->memrate_flush)
 				stress_memrate_flush(context);
+			(void)stress_perf_counter_read(dtlb_fd, &dtlb1);
 			t1 = stress_time_now();
 			kbytes = stress_memrate_dispatch(info, context, &valid);
 			context->stats[i].kbytes += (double)kbytes;
 			t2 = stress_time_now();
+			if (stress_perf_counter_read(dtlb_fd, &dtlb2))
+				context->stats[i].dtlb_misses += (double)(dtlb2 - dtlb1);
 			context->stats[i].duration += (t2 - t1);
 			context->stats[i].valid = valid;
 
@@ -1036,6 +1335,8 @@ static int stress_memrate_child(const stress_args_t *args, void *ctxt)
 	} while (keep_stressing(args));
 
 tidy:
+	if (dtlb_fd >= 0)
+		(void)close(dtlb_fd);
 	(void)munmap((void *)buffer, context->memrate_bytes);
 	return EXIT_SUCCESS;
 }
@@ -1049,6 +1350,7 @@ static int stress_memrate(const stress_args_t *args)
 	int rc;
 	size_t i, stats_size;
 	stress_memrate_context_t context;
+	double dtlb_misses = 0.0, kbytes = 0.0;
 
 	context.memrate_bytes = DEFAULT_MEMRATE_BYTES;
 	context.memrate_rd_mbs = ~0ULL;
@@ -1059,6 +1361,7 @@ static int stress_memrate(const stress_args_t *args)
 	(void)stress_get_setting("memrate-flush", &context.memrate_flush);
 	(void)stress_get_setting("memrate-rd-mbs", &context.memrate_rd_mbs);
 	(void)stress_get_setting("memrate-wr-mbs", &context.memrate_wr_mbs);
+	context.has_backing = stress_get_setting("memrate-backing", &context.memrate_backing);
 
 	stats_size = memrate_items * sizeof(*context.stats);
 	stats_size = (stats_size + args->page_size - 1) & ~(args->page_size - 1);
@@ -1073,6 +1376,7 @@ static int stress_memrate(const stress_args_t *args)
 	for (i = 0; i < memrate_items; i++) {
 		context.stats[i].duration = 0.0;
 		context.stats[i].kbytes = 0.0;
+		context.stats[i].dtlb_misses = 0.0;
 		context.stats[i].valid = false;
 	}
 
@@ -1084,20 +1388,38 @@ static int stress_memrate(const stress_args_t *args)
 		if ((context.memrate_bytes > MB) && (context.memrate_bytes & MB)) {
 			pr_inf("%s: for optimial speed, use multiples of 1 MB for --memrate-bytes\n", args->name);
 		}
-		if (!context.memrate_flush)
+		if (!context.memrate_flush && !memrate_target)
 			pr_inf("%s: cache flushing can be enabled with --memrate-flush option\n", args->name);
 	}
 
+	if (memrate_target && (args->instance == 0)) {
+		pr_inf("%s: generating %" PRIu64 " MB/sec %s bandwidth over %" PRIu32 " instance%s\n",
+			args->name, memrate_target->target_mbs,
+			memrate_target_ops[memrate_target->op],
+			args->num_instances, (args->num_instances == 1) ? "" : "s");
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	rc = stress_oomable_child(args, &context, stress_memrate_child, STRESS_OOMABLE_NORMAL);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
+#if defined(HAVE_MEMRATE_TARGET)
+	if (memrate_target) {
+		if (args->instance == 0)
+			stress_memrate_target_report(args);
+		(void)munmap((void *)context.stats, stats_size);
+		return rc;
+	}
+#endif
+
 	pr_lock();
 	for (i = 0; i < memrate_items; i++) {
 		if (!context.stats[i].valid)
 			continue;
+		dtlb_misses += context.stats[i].dtlb_misses;
+		kbytes += context.stats[i].kbytes;
 		if (context.stats[i].duration > 0.0) {
 			char tmp[32];
 			const double rate = context.stats[i].kbytes / (context.stats[i].duration * KB);
@@ -1111,21 +1433,93 @@ static int stress_memrate(const stress_args_t *args)
 	}
 	pr_unlock();
 
+	if ((dtlb_misses > 0.0) && (kbytes > 0.0))
+		stress_metrics_set(args, memrate_items, "dTLB read misses per MB",
+			dtlb_misses / (kbytes / KB));
+
 	(void)munmap((void *)context.stats, stats_size);
 
 	return rc;
 }
 
+/*
+ *  stress_memrate_init()
+ *	allocate the shared aggregate target bandwidth state
+ */
+static void stress_memrate_init(void)
+{
+	uint64_t target_mbs = 0;
+	size_t op = MR_TARGET_RDWR;
+
+	(void)stress_get_setting("memrate-target-mbs", &target_mbs);
+	if (!target_mbs)
+		return;
+#if defined(HAVE_MEMRATE_TARGET)
+	(void)stress_get_setting("memrate-target-op", &op);
+	memrate_target = (stress_memrate_target_t *)mmap(NULL, sizeof(*memrate_target),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memrate_target == MAP_FAILED) {
+		pr_inf("memrate: cannot mmap target bandwidth state, ignoring --memrate-target-mbs\n");
+		memrate_target = NULL;
+		return;
+	}
+	(void)memset(memrate_target, 0, sizeof(*memrate_target));
+	memrate_target->target_mbs = target_mbs;
+	memrate_target->op = op;
+#else
+	(void)op;
+	pr_inf("memrate: atomic operations not available, ignoring --memrate-target-mbs\n");
+#endif
+}
+
+static void stress_memrate_deinit(void)
+{
+	if (memrate_target) {
+		(void)munmap((void *)memrate_target, sizeof(*memrate_target));
+		memrate_target = NULL;
+	}
+}
+
+/*
+ *  stress_memrate_yaml()
+ *	add the achieved per second target bandwidth to the yaml metrics
+ */
+static void stress_memrate_yaml(FILE *yaml)
+{
+	uint64_t i, slots;
+
+	if (!memrate_target || !memrate_target->start_ns)
+		return;
+	for (slots = MEMRATE_TARGET_SLOTS; slots > 0; slots--) {
+		if (memrate_target->slot_bytes[slots - 1])
+			break;
+	}
+	/* the last second is partial */
+	if (slots > 0)
+		slots--;
+	pr_yaml(yaml, "      target-mb-per-second: %" PRIu64 "\n", memrate_target->target_mbs);
+	pr_yaml(yaml, "      achieved-mb-per-second: [");
+	for (i = 0; i < slots; i++)
+		pr_yaml(yaml, "%s%.2f", i ? ", " : "", (double)memrate_target->slot_bytes[i] / (double)MB);
+	pr_yaml(yaml, "]\n");
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_memrate_backing,	stress_set_memrate_backing },
 	{ OPT_memrate_bytes,	stress_set_memrate_bytes },
 	{ OPT_memrate_flush,	stress_set_memrate_flush },
 	{ OPT_memrate_rd_mbs,	stress_set_memrate_rd_mbs },
+	{ OPT_memrate_target_mbs, stress_set_memrate_target_mbs },
+	{ OPT_memrate_target_op, stress_set_memrate_target_op },
 	{ OPT_memrate_wr_mbs,	stress_set_memrate_wr_mbs },
 	{ 0,			NULL }
 };
 
 stressor_info_t stress_memrate_info = {
 	.stressor = stress_memrate,
+	.init = stress_memrate_init,
+	.deinit = stress_memrate_deinit,
+	.yaml = stress_memrate_yaml,
 	.class = CLASS_MEMORY,
 	.opt_set_funcs = opt_set_funcs,
 	.help = help
@@ -0,0 +1,510 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-put.h"
+
+#define MIN_MEMTIER_BYTES	(4 * MB)
+#define MAX_MEMTIER_BYTES	(MAX_MEM_LIMIT)
+#define DEFAULT_MEMTIER_BYTES	(256 * MB)
+
+#define MIN_MEMTIER_HOT		(1)
+#define MAX_MEMTIER_HOT		(100)
+#define DEFAULT_MEMTIER_HOT	(10)
+
+#define MEMTIER_NODES_MAX	(64)		/* NUMA nodes tracked */
+#define MEMTIER_HOT_ACCESSES	(90)		/* % of accesses to the hot pages */
+#define MEMTIER_CHASE_MAX	(65536)		/* pointer chase steps per tier */
+#define MEMTIER_BW_MAX		(64 * MB)	/* bytes read per tier per round */
+
+#define MEMTIER_TOP		(0)		/* nodes with CPUs, DRAM */
+#define MEMTIER_LOWER		(1)		/* CPU-less nodes, e.g. CXL */
+#define MEMTIER_MAX		(2)
+
+static const stress_help_t help[] = {
+	{ NULL,	"memtier N",		"start N workers exercising memory tiering with hot/cold accesses" },
+	{ NULL,	"memtier-bytes N",	"size of the hot/cold region spread across the memory tiers" },
+	{ NULL,	"memtier-hot N",	"percentage of the region that is hot" },
+	{ NULL,	"memtier-ops N",	"stop after N memtier bogo rounds" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_memtier_bytes(const char *opt)
+{
+	size_t memtier_bytes;
+
+	memtier_bytes = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("memtier-bytes", memtier_bytes,
+		MIN_MEMTIER_BYTES, MAX_MEMTIER_BYTES);
+	return stress_set_setting("memtier-bytes", TYPE_ID_SIZE_T, &memtier_bytes);
+}
+
+static int stress_set_memtier_hot(const char *opt)
+{
+	uint32_t memtier_hot;
+
+	memtier_hot = stress_get_uint32(opt);
+	stress_check_range("memtier-hot", (uint64_t)memtier_hot,
+		MIN_MEMTIER_HOT, MAX_MEMTIER_HOT);
+	return stress_set_setting("memtier-hot", TYPE_ID_UINT32, &memtier_hot);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_memtier_bytes,	stress_set_memtier_bytes },
+	{ OPT_memtier_hot,	stress_set_memtier_hot },
+	{ 0,			NULL }
+};
+
+#if defined(__linux__) &&		\
+    defined(__NR_mbind) &&		\
+    defined(__NR_move_pages)
+
+#if !defined(MPOL_DEFAULT)
+#define MPOL_DEFAULT		(0)
+#endif
+#if !defined(MPOL_INTERLEAVE)
+#define MPOL_INTERLEAVE		(3)
+#endif
+
+#define NUMA_LONG_BITS		(sizeof(unsigned long) * 8)
+
+static const char * const memtier_names[MEMTIER_MAX] = {
+	"top tier",
+	"lower tier",
+};
+
+/* kernel promotion, demotion and NUMA balancing counters */
+typedef struct {
+	uint64_t pgpromote_success;	/* pages promoted to a faster tier */
+	uint64_t pgpromote_candidate;	/* pages considered for promotion */
+	uint64_t pgdemote;		/* pages demoted, kswapd, direct and khugepaged */
+	uint64_t numa_hint_faults;	/* NUMA balancing hinting faults */
+	uint64_t numa_pages_migrated;	/* pages migrated by NUMA balancing */
+} stress_memtier_stat_t;
+
+/* per tier access measurements */
+typedef struct {
+	size_t *pages;			/* indexes of pages now on this tier */
+	size_t n_pages;			/* number of pages on this tier */
+	stress_metrics_t chase;		/* dependent load latency */
+	stress_metrics_t bw;		/* sequential read bandwidth */
+	double chase_count;		/* chase loads timed */
+	double bw_bytes;		/* bytes read */
+} stress_memtier_tier_t;
+
+/*
+ *  stress_memtier_nodes()
+ *	map each memory node to the top tier if it has CPUs or to the
+ *	lower tier if it is CPU-less, returns the highest node + 1 or
+ *	0 if no nodes were found
+ */
+static int stress_memtier_nodes(int8_t node_tier[MEMTIER_NODES_MAX], unsigned long *nodemask)
+{
+	struct dirent **namelist = NULL;
+	int i, n, max_node = 0;
+
+	for (i = 0; i < MEMTIER_NODES_MAX; i++)
+		node_tier[i] = -1;
+
+	n = scandir("/sys/devices/system/node", &namelist, NULL, alphasort);
+	for (i = 0; i < n; i++) {
+		char path[PATH_MAX], buf[256];
+		int node;
+
+		if (sscanf(namelist[i]->d_name, "node%d", &node) != 1)
+			continue;
+		if ((node < 0) || (node >= MEMTIER_NODES_MAX))
+			continue;
+		/* skip nodes without memory */
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/node/node%d/meminfo", node);
+		if (access(path, R_OK) < 0)
+			continue;
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/node/node%d/cpulist", node);
+		(void)memset(buf, 0, sizeof(buf));
+		if (system_read(path, buf, sizeof(buf) - 1) < 0)
+			continue;
+		node_tier[node] = ((buf[0] == '\n') || (buf[0] == '\0')) ?
+			MEMTIER_LOWER : MEMTIER_TOP;
+		STRESS_SETBIT(nodemask, node);
+		if (node + 1 > max_node)
+			max_node = node + 1;
+	}
+	stress_dirent_list_free(namelist, n);
+
+	return max_node;
+}
+
+/*
+ *  stress_memtier_read_stat()
+ *	read the promotion and demotion counters from /proc/vmstat
+ */
+static void stress_memtier_read_stat(stress_memtier_stat_t *stat)
+{
+	FILE *fp;
+	char buffer[256];
+
+	(void)memset(stat, 0, sizeof(*stat));
+
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char name[64];
+		uint64_t val;
+
+		if (sscanf(buffer, "%63s %" SCNu64, name, &val) != 2)
+			continue;
+		if (!strcmp(name, "pgpromote_success"))
+			stat->pgpromote_success = val;
+		else if (!strcmp(name, "pgpromote_candidate"))
+			stat->pgpromote_candidate = val;
+		else if (!strncmp(name, "pgdemote_", 9))
+			stat->pgdemote += val;
+		else if (!strcmp(name, "numa_hint_faults"))
+			stat->numa_hint_faults = val;
+		else if (!strcmp(name, "numa_pages_migrated"))
+			stat->numa_pages_migrated = val;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_memtier_locate()
+ *	find the node of each page and sort the page indexes by tier,
+ *	returns the number of hot pages on the top tier
+ */
+static size_t stress_memtier_locate(
+	uint8_t *buf,
+	const size_t page_size,
+	const size_t n_pages,
+	const size_t n_hot,
+	void **addrs,
+	int *status,
+	const int8_t node_tier[MEMTIER_NODES_MAX],
+	stress_memtier_tier_t tiers[MEMTIER_MAX])
+{
+	size_t i, hot_top = 0;
+
+	for (i = 0; i < n_pages; i++) {
+		addrs[i] = (void *)(buf + (i * page_size));
+		status[i] = -1;
+	}
+	/* a NULL node list queries the current page nodes */
+	if (shim_move_pages(0, (unsigned long)n_pages, addrs, NULL, status, 0) < 0) {
+		for (i = 0; i < n_pages; i++)
+			status[i] = -1;
+	}
+
+	for (i = 0; i < MEMTIER_MAX; i++)
+		tiers[i].n_pages = 0;
+	for (i = 0; i < n_pages; i++) {
+		const int node = status[i];
+		int tier = MEMTIER_TOP;
+
+		if ((node >= 0) && (node < MEMTIER_NODES_MAX) && (node_tier[node] >= 0))
+			tier = node_tier[node];
+		tiers[tier].pages[tiers[tier].n_pages++] = i;
+		if ((tier == MEMTIER_TOP) && (i < n_hot))
+			hot_top++;
+	}
+	return hot_top;
+}
+
+/*
+ *  stress_memtier_skew()
+ *	touch random cache lines with a skewed hot/cold distribution,
+ *	MEMTIER_HOT_ACCESSES % of the accesses land on the hot pages
+ */
+static void stress_memtier_skew(
+	uint8_t *buf,
+	const size_t page_size,
+	const size_t n_pages,
+	const size_t n_hot)
+{
+	const uint32_t n_cold = (uint32_t)(n_pages - n_hot);
+	const uint32_t lines = (uint32_t)(page_size / 64);
+	size_t i;
+
+	for (i = 0; i < n_pages * 4; i++) {
+		size_t page;
+		volatile uint8_t *ptr;
+
+		if ((n_cold == 0) || (stress_mwc8modn(100) < MEMTIER_HOT_ACCESSES))
+			page = stress_mwc32modn((uint32_t)n_hot);
+		else
+			page = n_hot + stress_mwc32modn(n_cold);
+		ptr = buf + (page * page_size) + (stress_mwc32modn(lines) * 64);
+		(*ptr)++;
+	}
+}
+
+/*
+ *  stress_memtier_measure()
+ *	measure the dependent load latency by chasing pointers through
+ *	the pages on a tier in a random order and the bandwidth by reading
+ *	the pages on the tier sequentially
+ */
+static void stress_memtier_measure(
+	uint8_t *buf,
+	const size_t page_size,
+	stress_memtier_tier_t *tier)
+{
+	const size_t n = tier->n_pages;
+	const size_t steps = STRESS_MINIMUM(n, MEMTIER_CHASE_MAX);
+	const size_t bw_pages = STRESS_MINIMUM(n, MEMTIER_BW_MAX / page_size);
+	const uint32_t lines = (uint32_t)(page_size / 64);
+	void **first = NULL, **ptr;
+	uint64_t sum = 0;
+	size_t i;
+	double t;
+
+	if (n < 2)
+		return;
+
+	/* link a random cache line of each page into a randomly ordered ring */
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = stress_mwc32modn((uint32_t)(i + 1));
+		const size_t tmp = tier->pages[i];
+
+		tier->pages[i] = tier->pages[j];
+		tier->pages[j] = tmp;
+	}
+	for (i = 0; i < n; i++) {
+		void **link = (void **)(buf + (tier->pages[i] * page_size) +
+					(stress_mwc32modn(lines) * 64));
+
+		if (first)
+			*ptr = (void *)link;
+		else
+			first = link;
+		ptr = link;
+	}
+	*ptr = (void *)first;
+
+	ptr = first;
+	t = stress_time_now();
+	for (i = 0; i < steps; i++)
+		ptr = (void **)*ptr;
+	tier->chase.duration += stress_time_now() - t;
+	tier->chase_count += (double)steps;
+	stress_void_ptr_put((volatile void *)ptr);
+
+	t = stress_time_now();
+	for (i = 0; i < bw_pages; i++) {
+		const uint64_t *p64 = (uint64_t *)(buf + (tier->pages[i] * page_size));
+		const uint64_t *end = p64 + (page_size / sizeof(*p64));
+
+		while (p64 < end) {
+			sum += p64[0] + p64[1] + p64[2] + p64[3] +
+			       p64[4] + p64[5] + p64[6] + p64[7];
+			p64 += 8;
+		}
+	}
+	tier->bw.duration += stress_time_now() - t;
+	tier->bw_bytes += (double)(bw_pages * page_size);
+	stress_uint64_put(sum);
+}
+
+/*
+ *  stress_memtier()
+ *	spread a region over all the memory nodes, access it with a
+ *	skewed hot/cold pattern and measure the access costs of each
+ *	tier while tracking the kernel page promotions and demotions
+ */
+static int stress_memtier(const stress_args_t *args)
+{
+	const size_t page_size = args->page_size;
+	size_t memtier_bytes = DEFAULT_MEMTIER_BYTES;
+	uint32_t memtier_hot = DEFAULT_MEMTIER_HOT;
+	unsigned long nodemask[(MEMTIER_NODES_MAX + NUMA_LONG_BITS - 1) / NUMA_LONG_BITS];
+	int8_t node_tier[MEMTIER_NODES_MAX];
+	stress_memtier_tier_t tiers[MEMTIER_MAX];
+	stress_memtier_stat_t stat_begin, stat_prev, stat_end;
+	size_t n_pages, n_hot, sz, hot_top = 0, i;
+	uint8_t *buf;
+	void **addrs = NULL;
+	int *status = NULL;
+	int max_node, n_lower = 0, rc = EXIT_SUCCESS;
+	double t_begin, t_prev, duration;
+	char numa_balancing[16];
+
+	(void)stress_get_setting("memtier-bytes", &memtier_bytes);
+	(void)stress_get_setting("memtier-hot", &memtier_hot);
+
+	memtier_bytes /= args->num_instances;
+	if (memtier_bytes < MIN_MEMTIER_BYTES)
+		memtier_bytes = MIN_MEMTIER_BYTES;
+	n_pages = memtier_bytes / page_size;
+	sz = n_pages * page_size;
+	n_hot = (n_pages * memtier_hot) / 100;
+	if (n_hot < 1)
+		n_hot = 1;
+
+	(void)memset(nodemask, 0, sizeof(nodemask));
+	max_node = stress_memtier_nodes(node_tier, nodemask);
+	for (i = 0; i < MEMTIER_NODES_MAX; i++)
+		n_lower += (node_tier[i] == MEMTIER_LOWER);
+	if (args->instance == 0) {
+		(void)memset(numa_balancing, 0, sizeof(numa_balancing));
+		if (system_read("/proc/sys/kernel/numa_balancing",
+				numa_balancing, sizeof(numa_balancing) - 1) < 0)
+			numa_balancing[0] = '\0';
+		if (n_lower == 0)
+			pr_inf("%s: no CPU-less memory nodes found, only the top tier "
+				"can be measured\n", args->name);
+		/* mode 2 enables NUMA balancing memory tiering promotion */
+		if (!(atoi(numa_balancing) & 2))
+			pr_inf("%s: kernel.numa_balancing memory tiering mode (2) is not "
+				"enabled, hot pages will not be promoted\n", args->name);
+	}
+
+	(void)memset(tiers, 0, sizeof(tiers));
+	addrs = (void **)calloc(n_pages, sizeof(*addrs));
+	status = (int *)calloc(n_pages, sizeof(*status));
+	tiers[MEMTIER_TOP].pages = (size_t *)calloc(n_pages, sizeof(size_t));
+	tiers[MEMTIER_LOWER].pages = (size_t *)calloc(n_pages, sizeof(size_t));
+	if (!addrs || !status || !tiers[MEMTIER_TOP].pages || !tiers[MEMTIER_LOWER].pages) {
+		pr_inf_skip("%s: cannot allocate page tables, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_tables;
+	}
+
+	buf = (uint8_t *)mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zd bytes, skipping stressor\n", args->name, sz);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_tables;
+	}
+	stress_set_vma_anon_name(buf, sz, "memtier-region");
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	/* small pages so each page can be placed and migrated on its own */
+	(void)shim_madvise(buf, sz, MADV_NOHUGEPAGE);
+#endif
+
+	/*
+	 *  interleave the pages over all the memory nodes as they are
+	 *  first touched and then drop the policy so that the kernel is
+	 *  free to promote and demote them
+	 */
+	if (max_node > 0)
+		(void)shim_mbind(buf, sz, MPOL_INTERLEAVE, nodemask, (unsigned long)max_node + 1, 0);
+	for (i = 0; i < n_pages; i++)
+		(void)memset(buf + (i * page_size), (int)i, page_size);
+	(void)shim_mbind(buf, sz, MPOL_DEFAULT, NULL, 0, 0);
+
+	stress_memtier_read_stat(&stat_begin);
+	stat_prev = stat_begin;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_begin = stress_time_now();
+	t_prev = t_begin;
+	do {
+		double t_now;
+
+		stress_memtier_skew(buf, page_size, n_pages, n_hot);
+		hot_top = stress_memtier_locate(buf, page_size, n_pages, n_hot,
+			addrs, status, node_tier, tiers);
+		for (i = 0; i < MEMTIER_MAX; i++)
+			stress_memtier_measure(buf, page_size, &tiers[i]);
+		inc_counter(args);
+
+		/* trace the promotions and demotions over time */
+		t_now = stress_time_now();
+		if ((args->instance == 0) && (t_now - t_prev >= 1.0)) {
+			stress_memtier_stat_t stat_now;
+
+			stress_memtier_read_stat(&stat_now);
+			pr_dbg("%s: %.1fs promoted %" PRIu64 " (of %" PRIu64 " candidates), "
+				"demoted %" PRIu64 ", NUMA hint faults %" PRIu64
+				", hot pages on top tier %.1f%%\n", args->name,
+				t_now - t_begin,
+				stat_now.pgpromote_success - stat_prev.pgpromote_success,
+				stat_now.pgpromote_candidate - stat_prev.pgpromote_candidate,
+				stat_now.pgdemote - stat_prev.pgdemote,
+				stat_now.numa_hint_faults - stat_prev.numa_hint_faults,
+				100.0 * (double)hot_top / (double)n_hot);
+			stat_prev = stat_now;
+			t_prev = t_now;
+		}
+	} while (keep_stressing(args));
+	duration = stress_time_now() - t_begin;
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_memtier_read_stat(&stat_end);
+
+	for (i = 0; i < MEMTIER_MAX; i++) {
+		char str[64];
+
+		if (tiers[i].chase.duration > 0.0) {
+			(void)snprintf(str, sizeof(str), "nanosecs per load %s", memtier_names[i]);
+			stress_metrics_set(args, i * 2, str,
+				STRESS_DBL_NANOSECOND * tiers[i].chase.duration / tiers[i].chase_count);
+		}
+		if (tiers[i].bw.duration > 0.0) {
+			(void)snprintf(str, sizeof(str), "MB per sec read %s", memtier_names[i]);
+			stress_metrics_set(args, (i * 2) + 1, str,
+				(tiers[i].bw_bytes / tiers[i].bw.duration) / (double)MB);
+		}
+	}
+	stress_metrics_set(args, 4, "% hot pages on top tier",
+		100.0 * (double)hot_top / (double)n_hot);
+	stress_metrics_set(args, 5, "% lower tier pages",
+		100.0 * (double)tiers[MEMTIER_LOWER].n_pages / (double)n_pages);
+	if (duration > 0.0) {
+		/* vmstat counters are system wide */
+		stress_metrics_set(args, 6, "system pages promoted per sec",
+			(double)(stat_end.pgpromote_success - stat_begin.pgpromote_success) / duration);
+		stress_metrics_set(args, 7, "system pages demoted per sec",
+			(double)(stat_end.pgdemote - stat_begin.pgdemote) / duration);
+		stress_metrics_set(args, 8, "system NUMA pages migrated per sec",
+			(double)(stat_end.numa_pages_migrated - stat_begin.numa_pages_migrated) / duration);
+	}
+
+	(void)munmap((void *)buf, sz);
+tidy_tables:
+	free(tiers[MEMTIER_LOWER].pages);
+	free(tiers[MEMTIER_TOP].pages);
+	free(status);
+	free(addrs);
+
+	return rc;
+}
+
+stressor_info_t stress_memtier_info = {
+	.stressor = stress_memtier,
+	.class = CLASS_VM | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_NONE,
+	.help = help
+};
+#else
+stressor_info_t stress_memtier_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_VM | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_NONE,
+	.help = help,
+	.unimplemented_reason = "only supported on Linux with mbind and move_pages"
+};
+#endif
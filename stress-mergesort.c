@@ -26,6 +26,7 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"mergesort N",		"start N workers merge sorting 32 bit random integers" },
+	{ NULL,	"mergesort-dists",	"mergesort int32, uint64, record and string keys in 7 input distributions" },
 	{ NULL,	"mergesort-ops N",	"stop after N merge sort bogo operations" },
 	{ NULL,	"mergesort-size N",	"number of 32 bit integers to sort" },
 	{ NULL,	NULL,			NULL }
@@ -50,7 +51,13 @@ static int stress_set_mergesort_size(const char *opt)
 	return stress_set_setting("mergesort-size", TYPE_ID_UINT64, &mergesort_size);
 }
 
+static int stress_set_mergesort_dists(const char *opt)
+{
+	return stress_set_setting_true("mergesort-dists", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_mergesort_dists,		stress_set_mergesort_dists },
 	{ OPT_mergesort_integers,	stress_set_mergesort_size },
 	{ 0,				NULL }
 };
@@ -74,6 +81,12 @@ static void MLOCKED_TEXT stress_mergesort_handler(int signum)
 }
 #endif
 
+static void stress_mergesort_func(void *base, size_t nmemb, size_t size,
+	int (*cmp)(const void *p1, const void *p2))
+{
+	(void)mergesort(base, nmemb, size, cmp);
+}
+
 /*
  *  stress_mergesort()
  *	stress mergesort
@@ -87,7 +100,9 @@ static int stress_mergesort(const stress_args_t *args)
 	int ret;
 	double rate;
 	NOCLOBBER double duration = 0.0, count = 0.0, sorted = 0.0;
+	bool mergesort_dists = false;
 
+	(void)stress_get_setting("mergesort-dists", &mergesort_dists);
 	if (!stress_get_setting("mergesort-size", &mergesort_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
 			mergesort_size = MAX_MERGESORT_SIZE;
@@ -96,6 +111,9 @@ static int stress_mergesort(const stress_args_t *args)
 	}
 	n = (size_t)mergesort_size;
 
+	if (mergesort_dists)
+		return stress_sort_dists(args, "mergesort", stress_mergesort_func, n);
+
 	if ((data = calloc(n, sizeof(*data))) == NULL) {
 		pr_inf_skip("%s: malloc failed, allocating %zd integers, skipping stressor\n",
 			args->name, n);
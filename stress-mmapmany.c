@@ -21,12 +21,377 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"mmapmany N",	  "start N workers stressing many mmaps and munmaps" },
+	{ NULL,	"mmapmany-bench", "measure mmap, munmap, mprotect and fault rates as VMA count grows" },
+	{ NULL,	"mmapmany-bench-threads N", "number of threads for the multi-threaded measurements" },
 	{ NULL,	"mmapmany-ops N", "stop after N mmapmany bogo operations" },
 	{ NULL,	NULL,		  NULL }
 };
 
 #define MMAP_MAX	(256*1024)
 
+#define MIN_MMAPMANY_BENCH_THREADS	(1)
+#define MAX_MMAPMANY_BENCH_THREADS	(64)
+#define DEFAULT_MMAPMANY_BENCH_THREADS	(4)
+
+#define MMAPMANY_BENCH_OPS	(4096)		/* operations per measurement */
+#define MMAPMANY_BENCH_SLACK	(MMAPMANY_BENCH_OPS + 1024)	/* VMAs left free */
+
+#define MMAPMANY_OP_MMAP	(0)
+#define MMAPMANY_OP_MUNMAP	(1)
+#define MMAPMANY_OP_MPROTECT	(2)
+#define MMAPMANY_OP_FAULT	(3)
+#define MMAPMANY_OPS		(4)
+
+static const size_t mmapmany_bench_levels[] = {
+	10000, 20000, 50000, 100000, 200000, 500000, 1000000,
+};
+
+static const char * const mmapmany_op_names[] = {
+	"mmap", "munmap", "mprotect", "fault",
+};
+
+static int stress_set_mmapmany_bench(const char *opt)
+{
+	return stress_set_setting_true("mmapmany-bench", opt);
+}
+
+static int stress_set_mmapmany_bench_threads(const char *opt)
+{
+	uint32_t mmapmany_bench_threads;
+
+	mmapmany_bench_threads = stress_get_uint32(opt);
+	stress_check_range("mmapmany-bench-threads", (uint64_t)mmapmany_bench_threads,
+		MIN_MMAPMANY_BENCH_THREADS, MAX_MMAPMANY_BENCH_THREADS);
+	return stress_set_setting("mmapmany-bench-threads", TYPE_ID_UINT32, &mmapmany_bench_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_mmapmany_bench,		stress_set_mmapmany_bench },
+	{ OPT_mmapmany_bench_threads,	stress_set_mmapmany_bench_threads },
+	{ 0,				NULL }
+};
+
+/* state shared by the measurement threads */
+typedef struct {
+	uint8_t *region;		/* region split into VMAs */
+	size_t page_size;		/* page size */
+	void *maps[MMAPMANY_BENCH_OPS];	/* mmap'd pages */
+	size_t pages[MMAPMANY_BENCH_OPS];/* random VMA pages of the region */
+	int op;				/* MMAPMANY_OP_* */
+	volatile bool start;		/* threads start the operations */
+	bool failed;			/* an operation failed */
+} stress_mmapmany_bench_t;
+
+#if defined(HAVE_LIB_PTHREAD)
+/* per thread state */
+typedef struct {
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	stress_mmapmany_bench_t *bench;	/* shared state */
+	size_t lo;			/* first operation */
+	size_t hi;			/* end of operations */
+} stress_mmapmany_thread_t;
+#endif
+
+/*
+ *  stress_mmapmany_bench_ops()
+ *	perform operations lo..hi-1, mapped pages alternate between
+ *	read/write and read only so they are not merged into one VMA
+ */
+static void stress_mmapmany_bench_ops(stress_mmapmany_bench_t *bench, const size_t lo, const size_t hi)
+{
+	const size_t page_size = bench->page_size;
+	size_t i;
+
+	for (i = lo; i < hi; i++) {
+		uint8_t *page = bench->region + (bench->pages[i] * page_size);
+
+		switch (bench->op) {
+		case MMAPMANY_OP_MMAP:
+			bench->maps[i] = mmap(NULL, page_size,
+				(i & 1) ? PROT_READ : PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (UNLIKELY(bench->maps[i] == MAP_FAILED)) {
+				bench->maps[i] = NULL;
+				bench->failed = true;
+			}
+			break;
+		case MMAPMANY_OP_MUNMAP:
+			if (LIKELY(bench->maps[i] != NULL))
+				(void)munmap(bench->maps[i], page_size);
+			break;
+		case MMAPMANY_OP_MPROTECT:
+			if (UNLIKELY(mprotect((void *)page, page_size, PROT_READ) < 0))
+				bench->failed = true;
+			(void)mprotect((void *)page, page_size, PROT_READ | PROT_WRITE);
+			break;
+		default:
+			*(volatile uint8_t *)page = 1;
+			break;
+		}
+	}
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+static void *stress_mmapmany_bench_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_mmapmany_thread_t *thread = (stress_mmapmany_thread_t *)arg;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	while (!thread->bench->start)
+		shim_sched_yield();
+	stress_mmapmany_bench_ops(thread->bench, thread->lo, thread->hi);
+	return &nowt;
+}
+#endif
+
+/*
+ *  stress_mmapmany_bench_run()
+ *	time MMAPMANY_BENCH_OPS operations shared between n threads,
+ *	returns operations per second or 0.0 if not measured
+ */
+static double stress_mmapmany_bench_run(
+	stress_mmapmany_bench_t *bench,
+	const int op,
+	const uint32_t n)
+{
+	const double ops = (op == MMAPMANY_OP_MPROTECT) ?
+		2.0 * MMAPMANY_BENCH_OPS : (double)MMAPMANY_BENCH_OPS;
+	double t;
+
+	bench->op = op;
+	bench->start = false;
+	if (n == 1) {
+		t = stress_time_now();
+		stress_mmapmany_bench_ops(bench, 0, MMAPMANY_BENCH_OPS);
+		t = stress_time_now() - t;
+	} else {
+#if defined(HAVE_LIB_PTHREAD)
+		stress_mmapmany_thread_t threads[MAX_MMAPMANY_BENCH_THREADS];
+		uint32_t i, started = 0;
+
+		for (i = 0; i < n; i++) {
+			threads[i].bench = bench;
+			threads[i].lo = (MMAPMANY_BENCH_OPS * i) / n;
+			threads[i].hi = (MMAPMANY_BENCH_OPS * (i + 1)) / n;
+			threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+				stress_mmapmany_bench_thread, (void *)&threads[i]);
+			if (threads[i].ret == 0)
+				started++;
+		}
+		t = stress_time_now();
+		bench->start = true;
+		for (i = 0; i < n; i++) {
+			if (threads[i].ret == 0)
+				(void)pthread_join(threads[i].pthread, NULL);
+		}
+		t = stress_time_now() - t;
+		/* run the operations of threads that did not start */
+		for (i = 0; i < n; i++) {
+			if (threads[i].ret != 0)
+				stress_mmapmany_bench_ops(bench, threads[i].lo, threads[i].hi);
+		}
+		if (started != n)
+			return 0.0;
+#else
+		return 0.0;
+#endif
+	}
+	return (t > 0.0) ? ops / t : 0.0;
+}
+
+/*
+ *  stress_mmapmany_vmas()
+ *	number of VMAs of the process
+ */
+static size_t stress_mmapmany_vmas(void)
+{
+	FILE *fp;
+	size_t n = 0;
+	int ch;
+
+	fp = fopen("/proc/self/maps", "r");
+	if (!fp)
+		return 0;
+	while ((ch = fgetc(fp)) != EOF) {
+		if (ch == '\n')
+			n++;
+	}
+	(void)fclose(fp);
+	return n;
+}
+
+/*
+ *  stress_mmapmany_bench()
+ *	grow the number of VMAs by splitting a region with mprotect
+ *	and measure the mmap, munmap, mprotect and page fault rates at
+ *	each VMA count with 1 and with N threads
+ */
+static int stress_mmapmany_bench(const stress_args_t *args)
+{
+	const size_t page_size = args->page_size;
+	const size_t levels_num = SIZEOF_ARRAY(mmapmany_bench_levels);
+	double rates[SIZEOF_ARRAY(mmapmany_bench_levels)][2][MMAPMANY_OPS];
+	uint32_t counts[SIZEOF_ARRAY(mmapmany_bench_levels)];
+	size_t levels[SIZEOF_ARRAY(mmapmany_bench_levels)];
+	uint32_t threads = DEFAULT_MMAPMANY_BENCH_THREADS;
+	stress_mmapmany_bench_t *bench;
+	size_t i, cap, base, region_pages, n_levels = 0, idx = 0;
+	char buf[64];
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("mmapmany-bench-threads", &threads);
+#if !defined(HAVE_LIB_PTHREAD)
+	threads = 1;
+#endif
+	cap = mmapmany_bench_levels[levels_num - 1];
+	if (system_read("/proc/sys/vm/max_map_count", buf, sizeof(buf)) > 0) {
+		const size_t max_map_count = (size_t)atol(buf);
+
+		if (max_map_count > MMAPMANY_BENCH_SLACK)
+			cap = STRESS_MINIMUM(cap, max_map_count - MMAPMANY_BENCH_SLACK);
+	}
+	base = stress_mmapmany_vmas();
+	for (i = 0; i < levels_num; i++) {
+		if (mmapmany_bench_levels[i] <= cap)
+			levels[n_levels++] = mmapmany_bench_levels[i];
+	}
+	if ((n_levels < levels_num) && ((n_levels == 0) || (cap > levels[n_levels - 1])))
+		levels[n_levels++] = cap;
+	if ((n_levels == 0) || (levels[n_levels - 1] <= base)) {
+		pr_inf_skip("%s: vm.max_map_count too low for the benchmark, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	bench = (stress_mmapmany_bench_t *)mmap(NULL, sizeof(*bench),
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (bench == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap benchmark state, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	/* every other page made PROT_NONE gives two VMAs per page pair */
+	region_pages = (levels[n_levels - 1] - base) + 4;
+	bench->page_size = page_size;
+	(void)memset(rates, 0, sizeof(rates));
+	(void)memset(counts, 0, sizeof(counts));
+
+	if (args->instance == 0)
+		pr_inf("%s: measuring up to %zu VMAs with 1 and %" PRIu32 " threads\n",
+			args->name, levels[n_levels - 1], threads);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		size_t pairs = 0, level;
+
+		bench->region = (uint8_t *)mmap(NULL, region_pages * page_size,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (bench->region == MAP_FAILED) {
+			pr_inf_skip("%s: cannot mmap %zu pages, skipping stressor\n",
+				args->name, region_pages);
+			rc = EXIT_NO_RESOURCE;
+			break;
+		}
+		for (level = 0; (level < n_levels) && keep_stressing(args); level++) {
+			const size_t target = (levels[level] > base) ? (levels[level] - base) / 2 : 1;
+			int op;
+
+			for (; (pairs < target) && ((2 * pairs) + 2 < region_pages); pairs++) {
+				if (mprotect((void *)(bench->region + (((2 * pairs) + 1) * page_size)),
+					     page_size, PROT_NONE) < 0)
+					break;
+			}
+			if (pairs < target) {
+				pr_inf("%s: could only create %zu of %zu VMAs\n",
+					args->name, base + (2 * pairs), levels[level]);
+				break;
+			}
+			for (i = 0; i < MMAPMANY_BENCH_OPS; i++)
+				bench->pages[i] = 2 * (size_t)stress_mwc32modn((uint32_t)pairs);
+
+			for (op = 0; op < MMAPMANY_OPS; op++) {
+				uint32_t t;
+
+				for (t = 0; t < 2; t++) {
+					const uint32_t n = t ? threads : 1;
+
+					if ((n == 1) && t)
+						continue;
+#if defined(MADV_DONTNEED)
+					/* drop the pages so they fault again */
+					if (op == MMAPMANY_OP_FAULT) {
+						for (i = 0; i < MMAPMANY_BENCH_OPS; i++)
+							(void)shim_madvise((void *)(bench->region + (bench->pages[i] * page_size)),
+								page_size, MADV_DONTNEED);
+					}
+#endif
+					/* munmap measures the mappings of the mmap measurement */
+					if (op == MMAPMANY_OP_MMAP) {
+						rates[level][t][op] += stress_mmapmany_bench_run(bench, op, n);
+						rates[level][t][MMAPMANY_OP_MUNMAP] +=
+							stress_mmapmany_bench_run(bench, MMAPMANY_OP_MUNMAP, n);
+					} else if (op != MMAPMANY_OP_MUNMAP) {
+						rates[level][t][op] += stress_mmapmany_bench_run(bench, op, n);
+					}
+				}
+			}
+			if (bench->failed) {
+				pr_fail("%s: mmap or mprotect failed at %zu VMAs\n",
+					args->name, levels[level]);
+				rc = EXIT_FAILURE;
+				(void)munmap((void *)bench->region, region_pages * page_size);
+				goto deinit;
+			}
+			counts[level]++;
+		}
+		(void)munmap((void *)bench->region, region_pages * page_size);
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+deinit:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	(void)munmap((void *)bench, sizeof(*bench));
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %8s %7s %10s %10s %10s %10s  (operations per second)\n",
+			args->name, "VMAs", "threads", "mmap", "munmap", "mprotect", "fault");
+	}
+	for (i = 0; i < n_levels; i++) {
+		uint32_t t;
+
+		if (!counts[i])
+			continue;
+		for (t = 0; t < 2; t++) {
+			const uint32_t n = t ? threads : 1;
+			int op;
+
+			if ((n == 1) && t)
+				continue;
+			for (op = 0; op < MMAPMANY_OPS; op++) {
+				char desc[64];
+
+				rates[i][t][op] /= (double)counts[i];
+				(void)snprintf(desc, sizeof(desc), "%s per sec at %zu VMAs %" PRIu32 " thread%s",
+					mmapmany_op_names[op], levels[i], n, (n == 1) ? "" : "s");
+				stress_metrics_set(args, idx++, desc, rates[i][t][op]);
+			}
+			if (args->instance == 0)
+				pr_inf("%s: %8zu %7" PRIu32 " %10.0f %10.0f %10.0f %10.0f\n",
+					args->name, levels[i], n,
+					rates[i][t][MMAPMANY_OP_MMAP], rates[i][t][MMAPMANY_OP_MUNMAP],
+					rates[i][t][MMAPMANY_OP_MPROTECT], rates[i][t][MMAPMANY_OP_FAULT]);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+	return rc;
+}
+
 static int stress_mmapmany_child(const stress_args_t *args, void *context)
 {
 	const size_t page_size = args->page_size;
@@ -35,9 +400,14 @@ static int stress_mmapmany_child(const stress_args_t *args, void *context)
 	const uint64_t pattern0 = stress_mwc64();
 	const uint64_t pattern1 = stress_mwc64();
 	const size_t offset2pages = (page_size * 2) / sizeof(uint64_t);
+	bool mmapmany_bench = false;
 
 	(void)context;
 
+	(void)stress_get_setting("mmapmany-bench", &mmapmany_bench);
+	if (mmapmany_bench)
+		return stress_mmapmany_bench(args);
+
 	mappings = calloc((size_t)max, sizeof(*mappings));
 	if (!mappings) {
 		pr_fail("%s: malloc failed, out of memory\n", args->name);
@@ -110,5 +480,6 @@ stressor_info_t stress_mmapmany_info = {
 	.stressor = stress_mmapmany,
 	.class = CLASS_VM | CLASS_OS,
 	.verify = VERIFY_ALWAYS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
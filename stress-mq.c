@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
 
 #if defined(HAVE_MQUEUE_H)
 #include <mqueue.h>
@@ -417,6 +418,7 @@ again:
 
 		do {
 			int ret;
+			uint64_t t_lat;
 			unsigned int prio = stress_mwc8modn_maybe_pwr2(PRIOS_MAX);
 			const uint64_t timed = (msg.value & 1);
 
@@ -444,10 +446,12 @@ again:
 			/*
 			 * toggle between timedsend and send
 			 */
+			t_lat = stress_latency_begin(args);
 			if (do_timed && (timed))
 				ret = mq_timedsend(mq, (char *)&msg, sizeof(msg), prio, &abs_timeout);
 			else
 				ret = mq_send(mq, (char *)&msg, sizeof(msg), prio);
+			stress_latency_end(args, t_lat);
 			if (ret < 0) {
 				if ((errno != EINTR) && (errno != ETIMEDOUT))
 					pr_fail("%s: %s failed, errno=%d (%s)\n",
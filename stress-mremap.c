@@ -19,12 +19,19 @@
  */
 #include "stress-ng.h"
 
+#if defined(HAVE_SYS_UTSNAME_H)
+#include <sys/utsname.h>
+#endif
+
 #define DEFAULT_MREMAP_BYTES	(256 * MB)
 #define MIN_MREMAP_BYTES	(4 * KB)
 #define MAX_MREMAP_BYTES	(MAX_MEM_LIMIT)
 
+#define MREMAP_BENCH_ALIGN	(2 * MB)	/* PMD size on most systems */
+
 static const stress_help_t help[] = {
 	{ NULL,	"mremap N",	  "start N workers stressing mremap" },
+	{ NULL,	"mremap-bench",	  "measure GB/s of mremap range moves vs memcpy relocation" },
 	{ NULL,	"mremap-bytes N", "mremap N bytes maximum for each stress iteration" },
 	{ NULL, "mremap-lock",	  "mlock remap pages, force pages to be unswappable" },
 	{ NULL,	"mremap-ops N",	  "stop after N mremap bogo operations" },
@@ -46,7 +53,13 @@ static int stress_set_mremap_mlock(const char *opt)
 	return stress_set_setting_true("mremap-mlock", opt);
 }
 
+static int stress_set_mremap_bench(const char *opt)
+{
+	return stress_set_setting_true("mremap-bench", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_mremap_bench,	stress_set_mremap_bench },
 	{ OPT_mremap_bytes,	stress_set_mremap_bytes },
 	{ OPT_mremap_mlock,	stress_set_mremap_mlock },
 	{ 0,			NULL }
@@ -204,12 +217,295 @@ static int try_remap(
 	return -1;
 }
 
+#if defined(MREMAP_MAYMOVE) &&	\
+    defined(MREMAP_FIXED)
+
+#define MREMAP_BENCH_4K		(0)
+#define MREMAP_BENCH_THP	(1)
+#define MREMAP_BENCH_HUGETLB	(2)
+#define MREMAP_BENCH_BACKINGS	(3)
+
+#define MREMAP_BENCH_MREMAP	(0)
+#define MREMAP_BENCH_DONTUNMAP	(1)
+#define MREMAP_BENCH_MEMCPY	(2)
+#define MREMAP_BENCH_METHODS	(3)
+
+static const char * const mremap_bench_backings[] = {
+	"4K", "THP", "hugetlb",
+};
+
+static const char * const mremap_bench_methods[] = {
+	"mremap", "mremap-dontunmap", "memcpy",
+};
+
+typedef struct {
+	double bytes;		/* bytes moved */
+	double duration;	/* time taken */
+	bool failed;		/* method not supported on backing */
+} stress_mremap_bench_t;
+
+/*
+ *  stress_mremap_bench_reserve()
+ *	reserve an inaccessible MREMAP_BENCH_ALIGN aligned region so
+ *	moves are PMD aligned at both the source and destination
+ */
+static void *stress_mremap_bench_reserve(const size_t sz)
+{
+	const size_t len = sz + MREMAP_BENCH_ALIGN;
+	uint8_t *ptr, *aligned;
+	size_t head;
+
+	ptr = (uint8_t *)mmap(NULL, len, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (ptr == MAP_FAILED)
+		return MAP_FAILED;
+	aligned = (uint8_t *)(((uintptr_t)ptr + MREMAP_BENCH_ALIGN - 1) & ~(uintptr_t)(MREMAP_BENCH_ALIGN - 1));
+	head = (size_t)(aligned - ptr);
+	if (head)
+		(void)munmap((void *)ptr, head);
+	if (len - head > sz)
+		(void)munmap((void *)(aligned + sz), len - head - sz);
+	return (void *)aligned;
+}
+
+/*
+ *  stress_mremap_bench_map()
+ *	map an aligned read/write region of sz bytes with the backing
+ */
+static void *stress_mremap_bench_map(const size_t sz, const int backing)
+{
+	void *ptr;
+
+	if (backing == MREMAP_BENCH_HUGETLB) {
+#if defined(MAP_HUGETLB)
+		return mmap(NULL, sz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#else
+		return MAP_FAILED;
+#endif
+	}
+	ptr = stress_mremap_bench_reserve(sz);
+	if (ptr == MAP_FAILED)
+		return MAP_FAILED;
+	ptr = mmap(ptr, sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+	if (ptr == MAP_FAILED)
+		return MAP_FAILED;
+#if defined(HAVE_MADVISE)
+#if defined(MADV_HUGEPAGE)
+	if (backing == MREMAP_BENCH_THP)
+		(void)madvise(ptr, sz, MADV_HUGEPAGE);
+#endif
+#if defined(MADV_NOHUGEPAGE)
+	if (backing == MREMAP_BENCH_4K)
+		(void)madvise(ptr, sz, MADV_NOHUGEPAGE);
+#endif
+#endif
+	return ptr;
+}
+
+/*
+ *  stress_mremap_bench_check()
+ *	check the first byte of each page of a moved region
+ */
+static int stress_mremap_bench_check(
+	const stress_args_t *args,
+	const uint8_t *ptr,
+	const size_t sz,
+	const uint8_t val,
+	const char *method)
+{
+	size_t i;
+
+	for (i = 0; i < sz; i += args->page_size) {
+		if (ptr[i] != val) {
+			pr_fail("%s: %s moved region contains 0x%2.2x at offset %zu, expected 0x%2.2x\n",
+				args->name, method, ptr[i], i, val);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_mremap_bench_move()
+ *	populate a region and time moving it with the method,
+ *	returns -1 on a verify failure, 0 otherwise
+ */
+static int stress_mremap_bench_move(
+	const stress_args_t *args,
+	const size_t sz,
+	const int backing,
+	const int method,
+	stress_mremap_bench_t *bench)
+{
+	const uint8_t val = stress_mwc8() | 1;
+	uint8_t *src, *dst, *moved;
+	double t;
+	int ret = 0;
+
+	src = (uint8_t *)stress_mremap_bench_map(sz, backing);
+	if (src == MAP_FAILED) {
+		bench->failed = true;
+		return 0;
+	}
+	(void)memset(src, val, sz);
+
+	switch (method) {
+	case MREMAP_BENCH_MEMCPY:
+		dst = (uint8_t *)stress_mremap_bench_map(sz, backing);
+		if (dst == MAP_FAILED) {
+			bench->failed = true;
+			break;
+		}
+		t = stress_time_now();
+		(void)memcpy(dst, src, sz);
+		(void)munmap((void *)src, sz);
+		bench->duration += stress_time_now() - t;
+		bench->bytes += (double)sz;
+		src = NULL;
+		if (g_opt_flags & OPT_FLAGS_VERIFY)
+			ret = stress_mremap_bench_check(args, dst, sz, val, mremap_bench_methods[method]);
+		(void)munmap((void *)dst, sz);
+		break;
+	default:
+		if (backing == MREMAP_BENCH_HUGETLB) {
+			dst = (uint8_t *)stress_mremap_bench_map(sz, backing);
+		} else {
+			dst = (uint8_t *)stress_mremap_bench_reserve(sz);
+		}
+		if (dst == MAP_FAILED) {
+			bench->failed = true;
+			break;
+		}
+		t = stress_time_now();
+		if (method == MREMAP_BENCH_DONTUNMAP) {
+#if defined(MREMAP_DONTUNMAP)
+			moved = (uint8_t *)mremap((void *)src, sz, sz,
+				MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, (void *)dst);
+#else
+			moved = (uint8_t *)MAP_FAILED;
+#endif
+		} else {
+			moved = (uint8_t *)mremap((void *)src, sz, sz,
+				MREMAP_MAYMOVE | MREMAP_FIXED, (void *)dst);
+		}
+		if (moved == MAP_FAILED) {
+			(void)munmap((void *)dst, sz);
+			bench->failed = true;
+			break;
+		}
+		bench->duration += stress_time_now() - t;
+		bench->bytes += (double)sz;
+		/* the DONTUNMAP source stays mapped, now empty */
+		if (method == MREMAP_BENCH_MREMAP)
+			src = NULL;
+		if (g_opt_flags & OPT_FLAGS_VERIFY)
+			ret = stress_mremap_bench_check(args, moved, sz, val, mremap_bench_methods[method]);
+		(void)munmap((void *)moved, sz);
+		break;
+	}
+	if (src)
+		(void)munmap((void *)src, sz);
+	return ret;
+}
+
+/*
+ *  stress_mremap_bench()
+ *	measure the throughput of moving large aligned ranges with
+ *	mremap, mremap with MREMAP_DONTUNMAP and memcpy relocation
+ *	for 4K, THP and hugetlb backed ranges, round robin until the
+ *	end of the run
+ */
+static int stress_mremap_bench(const stress_args_t *args, size_t sz)
+{
+	stress_mremap_bench_t bench[MREMAP_BENCH_BACKINGS][MREMAP_BENCH_METHODS];
+	int backing, method, ret = EXIT_SUCCESS;
+	size_t idx = 0;
+#if defined(HAVE_UNAME) &&	\
+    defined(HAVE_SYS_UTSNAME_H)
+	struct utsname u;
+#endif
+
+	sz &= ~(size_t)(MREMAP_BENCH_ALIGN - 1);
+	if (sz < MREMAP_BENCH_ALIGN)
+		sz = MREMAP_BENCH_ALIGN;
+	(void)memset(bench, 0, sizeof(bench));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (backing = 0; backing < MREMAP_BENCH_BACKINGS; backing++) {
+			for (method = 0; method < MREMAP_BENCH_METHODS; method++) {
+				if (bench[backing][method].failed)
+					continue;
+				if (stress_mremap_bench_move(args, sz, backing, method, &bench[backing][method]) < 0) {
+					ret = EXIT_FAILURE;
+					goto deinit;
+				}
+				if (!keep_stressing(args))
+					goto deinit;
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+deinit:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+#if defined(HAVE_UNAME) &&	\
+    defined(HAVE_SYS_UTSNAME_H)
+		if (uname(&u) == 0)
+			pr_inf("%s: kernel %s, moving %zu MB aligned ranges\n",
+				args->name, u.release, (size_t)(sz / MB));
+#endif
+		pr_inf("%s: %-8s %12s %18s %12s %9s\n", args->name, "backing",
+			"mremap GB/s", "dontunmap GB/s", "memcpy GB/s", "speedup");
+	}
+	for (backing = 0; backing < MREMAP_BENCH_BACKINGS; backing++) {
+		double rate[MREMAP_BENCH_METHODS];
+		char str[MREMAP_BENCH_METHODS][16];
+
+		for (method = 0; method < MREMAP_BENCH_METHODS; method++) {
+			const stress_mremap_bench_t *b = &bench[backing][method];
+			char desc[64];
+
+			rate[method] = (b->duration > 0.0) ? b->bytes / b->duration / (double)GB : 0.0;
+			if (rate[method] > 0.0) {
+				(void)snprintf(str[method], sizeof(str[method]), "%.2f", rate[method]);
+				(void)snprintf(desc, sizeof(desc), "%s %s GB per sec",
+					mremap_bench_backings[backing], mremap_bench_methods[method]);
+				stress_metrics_set(args, idx++, desc, rate[method]);
+			} else {
+				(void)shim_strlcpy(str[method], "-", sizeof(str[method]));
+			}
+		}
+		if (args->instance == 0) {
+			char speedup[16];
+
+			if ((rate[MREMAP_BENCH_MREMAP] > 0.0) && (rate[MREMAP_BENCH_MEMCPY] > 0.0))
+				(void)snprintf(speedup, sizeof(speedup), "%.1fx",
+					rate[MREMAP_BENCH_MREMAP] / rate[MREMAP_BENCH_MEMCPY]);
+			else
+				(void)shim_strlcpy(speedup, "-", sizeof(speedup));
+			pr_inf("%s: %-8s %12s %18s %12s %9s\n", args->name,
+				mremap_bench_backings[backing],
+				str[MREMAP_BENCH_MREMAP], str[MREMAP_BENCH_DONTUNMAP],
+				str[MREMAP_BENCH_MEMCPY], speedup);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+	return ret;
+}
+#endif
+
 static int stress_mremap_child(const stress_args_t *args, void *context)
 {
 	size_t new_sz, sz, mremap_bytes = DEFAULT_MREMAP_BYTES;
 	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
 	const size_t page_size = args->page_size;
-	bool mremap_mlock = false;
+	bool mremap_mlock = false, mremap_bench = false;
 	double duration = 0.0, count = 0.0, rate;
 	int ret = EXIT_SUCCESS;
 
@@ -232,6 +528,17 @@ static int stress_mremap_child(const stress_args_t *args, void *context)
 	new_sz = sz = mremap_bytes & ~(page_size - 1);
 
 	(void)stress_get_setting("mremap-mlock", &mremap_mlock);
+	(void)stress_get_setting("mremap-bench", &mremap_bench);
+	if (mremap_bench) {
+#if defined(MREMAP_MAYMOVE) &&	\
+    defined(MREMAP_FIXED)
+		return stress_mremap_bench(args, sz);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: MREMAP_MAYMOVE or MREMAP_FIXED not defined, "
+				"ignoring --mremap-bench\n", args->name);
+#endif
+	}
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
@@ -18,17 +18,49 @@
  *
  */
 #include "stress-ng.h"
+#include "core-adaptive.h"
+#include "core-anomaly.h"
+#include "core-autotune.h"
 #include "core-ftrace.h"
+#include "core-cache-probe.h"
+#include "core-cgroup.h"
+#include "core-clocksource.h"
+#include "core-cluster.h"
+#include "core-compare.h"
+#include "core-cpu-cache.h"
 #include "core-hash.h"
+#include "core-hybrid.h"
+#include "core-interference.h"
+#include "core-irq.h"
+#include "core-latency.h"
+#include "core-metrics-stream.h"
+#include "core-mitigations.h"
+#include "core-offcpu.h"
 #include "core-perf.h"
+#include "core-phase.h"
+#include "core-power.h"
 #include "core-pragma.h"
 #include "core-put.h"
+#include "core-rate.h"
+#include "core-repeat.h"
+#include "core-reproduce.h"
+#include "core-resctrl.h"
+#include "core-scaling.h"
+#include "core-score.h"
+#include "core-results.h"
+#include "core-search.h"
 #include "core-smart.h"
+#include "core-smt.h"
 #include "core-stressors.h"
 #include "core-syslog.h"
 #include "core-thermal-zone.h"
+#include "core-throttle.h"
 #include "core-thrash.h"
 
+#if defined(HAVE_SYS_EPOLL_H)
+#include <sys/epoll.h>
+#endif
+
 #if defined(HAVE_SYS_UTSNAME_H)
 #include <sys/utsname.h>
 #endif
@@ -62,6 +94,8 @@ stress_stressor_t *g_stressor_current;
 static volatile bool wait_flag = true;		/* false = exit run wait loop */
 static int terminate_signum;			/* signal sent to process */
 static pid_t main_pid;				/* stress-ng main pid */
+static pid_t window_pid = -1;			/* --warmup/--cooldown sampler */
+static double window_t_end;			/* end of measurement window */
 
 /* Globals */
 int32_t g_opt_sequential = DEFAULT_SEQUENTIAL;	/* # of sequential stressors */
@@ -82,6 +116,7 @@ static void stress_kill_stressors(const int sig);
 static const stress_opt_flag_t opt_flags[] = {
 	{ OPT_abort,		OPT_FLAGS_ABORT },
 	{ OPT_aggressive,	OPT_FLAGS_AGGRESSIVE_MASK },
+	{ OPT_arena,		OPT_FLAGS_ARENA },
 	{ OPT_cpu_online_all,	OPT_FLAGS_CPU_ONLINE_ALL },
 	{ OPT_dry_run,		OPT_FLAGS_DRY_RUN },
 	{ OPT_ftrace,		OPT_FLAGS_FTRACE },
@@ -89,31 +124,43 @@ static const stress_opt_flag_t opt_flags[] = {
 	{ OPT_keep_files, 	OPT_FLAGS_KEEP_FILES },
 	{ OPT_keep_name, 	OPT_FLAGS_KEEP_NAME },
 	{ OPT_klog_check,	OPT_FLAGS_KLOG_CHECK },
+	{ OPT_latency_hist,	OPT_FLAGS_LATENCY_HIST | OPT_FLAGS_METRICS },
+	{ OPT_log_async,	OPT_FLAGS_LOG_ASYNC },
 	{ OPT_log_brief,	OPT_FLAGS_LOG_BRIEF },
 	{ OPT_log_lockless,	OPT_FLAGS_LOG_LOCKLESS },
 	{ OPT_maximize,		OPT_FLAGS_MAXIMIZE },
 	{ OPT_metrics,		OPT_FLAGS_METRICS },
 	{ OPT_metrics_brief,	OPT_FLAGS_METRICS_BRIEF | OPT_FLAGS_METRICS },
+	{ OPT_metrics_instances,OPT_FLAGS_METRICS_INSTANCES | OPT_FLAGS_METRICS },
 	{ OPT_minimize,		OPT_FLAGS_MINIMIZE },
+	{ OPT_mitigations,	OPT_FLAGS_MITIGATIONS | OPT_FLAGS_METRICS },
 	{ OPT_no_oom_adjust,	OPT_FLAGS_NO_OOM_ADJUST },
 	{ OPT_no_rand_seed,	OPT_FLAGS_NO_RAND_SEED },
+	{ OPT_offcpu,		OPT_FLAGS_OFFCPU | OPT_FLAGS_METRICS },
+	{ OPT_schedstat,	OPT_FLAGS_SCHEDSTAT | OPT_FLAGS_METRICS },
 	{ OPT_oomable,		OPT_FLAGS_OOMABLE },
 	{ OPT_oom_avoid,	OPT_FLAGS_OOM_AVOID },
 	{ OPT_page_in,		OPT_FLAGS_MMAP_MINCORE },
 	{ OPT_pathological,	OPT_FLAGS_PATHOLOGICAL },
+	{ OPT_power,		OPT_FLAGS_POWER | OPT_FLAGS_METRICS },
+	{ OPT_prefork,		OPT_FLAGS_PREFORK },
 #if defined(STRESS_PERF_STATS) && 	\
     defined(HAVE_LINUX_PERF_EVENT_H)
 	{ OPT_perf_stats,	OPT_FLAGS_PERF_STATS },
+	{ OPT_perf_topdown,	OPT_FLAGS_PERF_TOPDOWN | OPT_FLAGS_PERF_STATS },
+	{ OPT_perf_sample,	OPT_FLAGS_PERF_SAMPLE },
 #endif
 	{ OPT_skip_silent,	OPT_FLAGS_SKIP_SILENT },
 	{ OPT_smart,		OPT_FLAGS_SMART },
 	{ OPT_sn,		OPT_FLAGS_SN },
 	{ OPT_sock_nodelay,	OPT_FLAGS_SOCKET_NODELAY },
 	{ OPT_stdout,		OPT_FLAGS_STDOUT },
+	{ OPT_sync_start,	OPT_FLAGS_SYNC_START },
 #if defined(HAVE_SYSLOG_H)
 	{ OPT_syslog,		OPT_FLAGS_SYSLOG },
 #endif
 	{ OPT_thrash, 		OPT_FLAGS_THRASH },
+	{ OPT_throttle,		OPT_FLAGS_THROTTLE },
 	{ OPT_times,		OPT_FLAGS_TIMES },
 	{ OPT_timestamp,	OPT_FLAGS_TIMESTAMP },
 	{ OPT_thermal_zones,	OPT_FLAGS_THERMAL_ZONES | OPT_FLAGS_TZ_INFO },
@@ -239,6 +286,8 @@ static const struct option long_options[] = {
 	{ "abort",		0,	0,	OPT_abort },
 	{ "access",		1,	0,	OPT_access },
 	{ "access-ops",		1,	0,	OPT_access_ops },
+	{ "adaptive",		1,	0,	OPT_adaptive },
+	{ "adaptive-min",	1,	0,	OPT_adaptive_min },
 	{ "af-alg",		1,	0,	OPT_af_alg },
 	{ "af-alg-dump",	0,	0,	OPT_af_alg_dump },
 	{ "af-alg-ops",		1,	0,	OPT_af_alg_ops },
@@ -258,10 +307,18 @@ static const struct option long_options[] = {
 	{ "alarm",		1,	0,	OPT_alarm },
 	{ "alarm-ops",		1,	0,	OPT_alarm_ops },
 	{ "all",		1,	0,	OPT_all },
+	{ "anomaly-abort",	0,	0,	OPT_anomaly_abort },
+	{ "anomaly-ms",		1,	0,	OPT_anomaly_ms },
+	{ "anomaly-sigma",	1,	0,	OPT_anomaly_sigma },
 	{ "apparmor",		1,	0,	OPT_apparmor },
 	{ "apparmor-ops",	1,	0,	OPT_apparmor_ops },
+	{ "arena",		0,	0,	OPT_arena },
 	{ "atomic",		1,	0,	OPT_atomic },
+	{ "atomic-contention",1,	0,	OPT_atomic_contention },
 	{ "atomic-ops",		1,	0,	OPT_atomic_ops },
+	{ "atomic-procs",	1,	0,	OPT_atomic_procs },
+	{ "autotune",		0,	0,	OPT_autotune },
+	{ "autotune-profile",	1,	0,	OPT_autotune_profile },
 	{ "bad-altstack",	1,	0,	OPT_bad_altstack },
 	{ "bad-altstack-ops",	1,	0,	OPT_bad_altstack_ops },
 	{ "bad-ioctl",		1,	0,	OPT_bad_ioctl },
@@ -275,12 +332,14 @@ static const struct option long_options[] = {
 	{ "binderfs",		1,	0,	OPT_binderfs },
 	{ "binderfs-opts",	1,	0,	OPT_binderfs_ops },
 	{ "branch",		1,	0,	OPT_branch },
+	{ "branch-method",	1,	0,	OPT_branch_method },
 	{ "branch-ops",		1,	0,	OPT_branch_ops },
 	{ "brk",		1,	0,	OPT_brk },
 	{ "brk-mlock",		0,	0,	OPT_brk_mlock },
 	{ "brk-notouch",	0,	0,	OPT_brk_notouch },
 	{ "brk-ops",		1,	0,	OPT_brk_ops },
 	{ "bsearch",		1,	0,	OPT_bsearch },
+	{ "bsearch-method",	1,	0,	OPT_bsearch_method },
 	{ "bsearch-ops",	1,	0,	OPT_bsearch_ops },
 	{ "bsearch-size",	1,	0,	OPT_bsearch_size },
 	{ "cache",		1,	0, 	OPT_cache },
@@ -294,14 +353,22 @@ static const struct option long_options[] = {
 	{ "cache-no-affinity",	0,	0,	OPT_cache_no_affinity },
 	{ "cache-ops",		1,	0,	OPT_cache_ops },
 	{ "cache-prefetch",	0,	0,	OPT_cache_prefetch },
+	{ "cache-probe",	0,	0,	OPT_cache_probe },
 	{ "cache-sfence",	0,	0,	OPT_cache_sfence },
 	{ "cache-ways",		1,	0,	OPT_cache_ways },
 	{ "cacheline",		1,	0, 	OPT_cacheline },
 	{ "cacheline-affinity",	0,	0,	OPT_cacheline_affinity },
+	{ "cacheline-matrix",	0,	0,	OPT_cacheline_matrix },
 	{ "cacheline-method",	1,	0,	OPT_cacheline_method },
 	{ "cacheline-ops",	1,	0,	OPT_cacheline_ops },
 	{ "cap",		1,	0, 	OPT_cap },
 	{ "cap-ops",		1,	0, 	OPT_cap_ops },
+	{ "cgroup",		1,	0,	OPT_cgroup },
+	{ "cgroup-cpu-max",	1,	0,	OPT_cgroup_cpu_max },
+	{ "cgroup-cpuset",	1,	0,	OPT_cgroup_cpuset },
+	{ "cgroup-io-max",	1,	0,	OPT_cgroup_io_max },
+	{ "cgroup-memory-high",	1,	0,	OPT_cgroup_memory_high },
+	{ "cgroup-memory-max",	1,	0,	OPT_cgroup_memory_max },
 	{ "chattr",		1,	0, 	OPT_chattr },
 	{ "chattr-ops",		1,	0,	OPT_chattr_ops },
 	{ "chdir",		1,	0, 	OPT_chdir },
@@ -319,15 +386,33 @@ static const struct option long_options[] = {
 	{ "clone",		1,	0,	OPT_clone },
 	{ "clone-max",		1,	0,	OPT_clone_max },
 	{ "clone-ops",		1,	0,	OPT_clone_ops },
+	{ "cluster",		1,	0,	OPT_cluster },
+	{ "cluster-agent",	1,	0,	OPT_cluster_agent },
+	{ "cluster-key",	1,	0,	OPT_cluster_key },
+	{ "cmap",		1,	0,	OPT_cmap },
+	{ "cmap-keys",		1,	0,	OPT_cmap_keys },
+	{ "cmap-method",	1,	0,	OPT_cmap_method },
+	{ "cmap-ops",		1,	0,	OPT_cmap_ops },
+	{ "cmap-reads",		1,	0,	OPT_cmap_reads },
+	{ "cmap-threads",	1,	0,	OPT_cmap_threads },
 	{ "close",		1,	0,	OPT_close },
 	{ "close-ops",		1,	0,	OPT_close_ops },
+	{ "compare",		1,	0,	OPT_compare },
+	{ "compare-threshold",1,	0,	OPT_compare_threshold },
 	{ "context",		1,	0,	OPT_context },
+	{ "context-coroutines",1,	0,	OPT_context_coroutines },
+	{ "context-method",	1,	0,	OPT_context_method },
 	{ "context-ops",	1,	0,	OPT_context_ops },
+	{ "cooldown",		1,	0,	OPT_cooldown },
+	{ "core-type",		1,	0,	OPT_core_type },
 	{ "copy-file",		1,	0,	OPT_copy_file },
 	{ "copy-file-bytes",	1,	0,	OPT_copy_file_bytes },
+	{ "copy-file-method",	1,	0,	OPT_copy_file_method },
 	{ "copy-file-ops",	1,	0,	OPT_copy_file_ops },
 	{ "cpu",		1,	0,	OPT_cpu },
 	{ "cpu-ops",		1,	0,	OPT_cpu_ops },
+	{ "cpu-calibrate",	0,	0,	OPT_cpu_calibrate },
+	{ "cpu-isa",		1,	0,	OPT_cpu_isa },
 	{ "cpu-load",		1,	0,	OPT_cpu_load },
 	{ "cpu-load-slice",	1,	0,	OPT_cpu_load_slice },
 	{ "cpu-method",		1,	0,	OPT_cpu_method },
@@ -336,10 +421,16 @@ static const struct option long_options[] = {
 	{ "cpu-online-ops",	1,	0,	OPT_cpu_online_ops },
 	{ "crypt",		1,	0,	OPT_crypt },
 	{ "crypt-ops",		1,	0,	OPT_crypt_ops },
+	{ "cryptobench",	1,	0,	OPT_cryptobench },
+	{ "cryptobench-alg",	1,	0,	OPT_cryptobench_alg },
+	{ "cryptobench-backend",1,	0,	OPT_cryptobench_backend },
+	{ "cryptobench-ops",	1,	0,	OPT_cryptobench_ops },
 	{ "cyclic",		1,	0,	OPT_cyclic },
 	{ "cyclic-dist",	1,	0,	OPT_cyclic_dist },
+	{ "cyclic-load",	1,	0,	OPT_cyclic_load },
 	{ "cyclic-method",	1,	0,	OPT_cyclic_method },
 	{ "cyclic-ops",		1,	0,	OPT_cyclic_ops },
+	{ "cyclic-percpu",	0,	0,	OPT_cyclic_percpu },
 	{ "cyclic-policy",	1,	0,	OPT_cyclic_policy },
 	{ "cyclic-prio",	1,	0,	OPT_cyclic_prio },
 	{ "cyclic-samples",	1,	0,	OPT_cyclic_samples },
@@ -362,6 +453,7 @@ static const struct option long_options[] = {
 	{ "dev-file",		1,	0,	OPT_dev_file },
 	{ "dev-ops",		1,	0,	OPT_dev_ops },
 	{ "dev-shm",		1,	0,	OPT_dev_shm },
+	{ "dev-shm-bench",	0,	0,	OPT_dev_shm_bench },
 	{ "dev-shm-ops",	1,	0,	OPT_dev_shm_ops },
 	{ "dir",		1,	0,	OPT_dir },
 	{ "dir-dirs",		1,	0,	OPT_dir_dirs },
@@ -374,7 +466,15 @@ static const struct option long_options[] = {
 	{ "dirdeep-ops",	1,	0,	OPT_dirdeep_ops },
 	{ "dirmany",		1,	0,	OPT_dirmany },
 	{ "dirmany-bytes",	1,	0,	OPT_dirmany_bytes },
+	{ "dirmany-max",	1,	0,	OPT_dirmany_max },
+	{ "dirmany-mdtest",	0,	0,	OPT_dirmany_mdtest },
 	{ "dirmany-ops",	1,	0,	OPT_dirmany_ops },
+	{ "dirmany-threads",	1,	0,	OPT_dirmany_threads },
+	{ "dirty",		1,	0,	OPT_dirty },
+	{ "dirty-bytes",	1,	0,	OPT_dirty_bytes },
+	{ "dirty-method",	1,	0,	OPT_dirty_method },
+	{ "dirty-ops",		1,	0,	OPT_dirty_ops },
+	{ "dirty-rate",		1,	0,	OPT_dirty_rate },
 	{ "dry-run",		0,	0,	OPT_dry_run },
 	{ "dnotify",		1,	0,	OPT_dnotify },
 	{ "dnotify-ops",	1,	0,	OPT_dnotify_ops },
@@ -389,10 +489,15 @@ static const struct option long_options[] = {
 	{ "env",		1,	0,	OPT_env },
 	{ "env-ops",		1,	0,	OPT_env_ops },
 	{ "epoll",		1,	0,	OPT_epoll },
+	{ "epoll-acceptor",	1,	0,	OPT_epoll_acceptor },
+	{ "epoll-conns",	1,	0,	OPT_epoll_conns },
 	{ "epoll-domain",	1,	0,	OPT_epoll_domain },
 	{ "epoll-ops",		1,	0,	OPT_epoll_ops },
 	{ "epoll-port",		1,	0,	OPT_epoll_port },
+	{ "epoll-req-size",	1,	0,	OPT_epoll_req_size },
+	{ "epoll-resp-size",	1,	0,	OPT_epoll_resp_size },
 	{ "epoll-sockets",	1,	0,	OPT_epoll_sockets },
+	{ "epoll-trigger",	1,	0,	OPT_epoll_trigger },
 	{ "eventfd",		1,	0,	OPT_eventfd },
 	{ "eventfd-nonblock",	0,	0,	OPT_eventfd_nonblock },
 	{ "eventfd-ops",	1,	0,	OPT_eventfd_ops },
@@ -409,13 +514,25 @@ static const struct option long_options[] = {
 	{ "fallocate-bytes",	1,	0,	OPT_fallocate_bytes },
 	{ "fallocate-ops",	1,	0,	OPT_fallocate_ops },
 	{ "fanotify",		1,	0,	OPT_fanotify },
+	{ "fanotify-dirs",	1,	0,	OPT_fanotify_dirs },
 	{ "fanotify-ops",	1,	0,	OPT_fanotify_ops },
+	{ "fanotify-scale",	0,	0,	OPT_fanotify_scale },
+	{ "fanotify-writers",	1,	0,	OPT_fanotify_writers },
 	{ "far-branch",		1,	0,	OPT_far_branch },
 	{ "far-branch-ops",	1,	0,	OPT_far_branch_ops },
+	{ "far-branch-sweep",	0,	0,	OPT_far_branch_sweep },
 	{ "fault",		1,	0,	OPT_fault },
 	{ "fault-ops",		1,	0,	OPT_fault_ops },
+	{ "fault-scale",	1,	0,	OPT_fault_scale },
+	{ "fault-scale-backing",1,	0,	OPT_fault_scale_backing },
+	{ "fault-scale-ops",	1,	0,	OPT_fault_scale_ops },
+	{ "fault-scale-populate",1,	0,	OPT_fault_scale_populate },
+	{ "fault-scale-thp",	0,	0,	OPT_fault_scale_thp },
+	{ "fault-scale-threads",1,	0,	OPT_fault_scale_threads },
 	{ "fcntl",		1,	0,	OPT_fcntl},
 	{ "fcntl-ops",		1,	0,	OPT_fcntl_ops },
+	{ "fence",		1,	0,	OPT_fence },
+	{ "fence-ops",		1,	0,	OPT_fence_ops },
 	{ "fiemap",		1,	0,	OPT_fiemap },
 	{ "fiemap-bytes",	1,	0,	OPT_fiemap_bytes },
 	{ "fiemap-ops",		1,	0,	OPT_fiemap_ops },
@@ -428,8 +545,17 @@ static const struct option long_options[] = {
 	{ "filename",		1,	0,	OPT_filename },
 	{ "filename-ops",	1,	0,	OPT_filename_ops },
 	{ "filename-opts",	1,	0,	OPT_filename_opts },
+	{ "filescan",		1,	0,	OPT_filescan },
+	{ "filescan-bytes",	1,	0,	OPT_filescan_bytes },
+	{ "filescan-chunk",	1,	0,	OPT_filescan_chunk },
+	{ "filescan-method",	1,	0,	OPT_filescan_method },
+	{ "filescan-ops",	1,	0,	OPT_filescan_ops },
+	{ "filescan-threads",	1,	0,	OPT_filescan_threads },
 	{ "flock",		1,	0,	OPT_flock },
+	{ "flock-files",	1,	0,	OPT_flock_files },
 	{ "flock-ops",		1,	0,	OPT_flock_ops },
+	{ "flock-procs",	1,	0,	OPT_flock_procs },
+	{ "flock-scale",	0,	0,	OPT_flock_scale },
 	{ "flushcache",		1,	0,	OPT_flushcache },
 	{ "flushcache-ops",	1,	0,	OPT_flushcache_ops },
 	{ "fork",		1,	0,	OPT_fork },
@@ -441,6 +567,7 @@ static const struct option long_options[] = {
 	{ "forkheavy-ops",	1,	0,	OPT_forkheavy_ops },
 	{ "forkheavy-procs",	1,	0,	OPT_forkheavy_procs },
 	{ "fp",			1,	0,	OPT_fp },
+	{ "fp-bench",		0,	0,	OPT_fp_bench },
 	{ "fp-method",		1,	0,	OPT_fp_method },
 	{ "fp-ops",		1,	0,	OPT_fp_ops },
 	{ "fp-error",		1,	0,	OPT_fp_error},
@@ -453,6 +580,8 @@ static const struct option long_options[] = {
 	{ "fstat-dir",		1,	0,	OPT_fstat_dir },
 	{ "fstat-ops",		1,	0,	OPT_fstat_ops },
 	{ "ftrace",		0,	0,	OPT_ftrace },
+	{ "ftrace-pid",		0,	0,	OPT_ftrace_pid },
+	{ "ftrace-top",		1,	0,	OPT_ftrace_top },
 	{ "full",		1,	0,	OPT_full },
 	{ "full-ops",		1,	0,	OPT_full_ops },
 	{ "funccall",		1,	0,	OPT_funccall },
@@ -462,7 +591,9 @@ static const struct option long_options[] = {
 	{ "funcret-method",	1,	0,	OPT_funcret_method },
 	{ "funcret-ops",	1,	0,	OPT_funcret_ops },
 	{ "futex",		1,	0,	OPT_futex },
+	{ "futex-bench",	0,	0,	OPT_futex_bench },
 	{ "futex-ops",		1,	0,	OPT_futex_ops },
+	{ "futex-waiters",	1,	0,	OPT_futex_waiters },
 	{ "get",		1,	0,	OPT_get },
 	{ "get-ops",		1,	0,	OPT_get_ops },
 	{ "getrandom",		1,	0,	OPT_getrandom },
@@ -473,8 +604,11 @@ static const struct option long_options[] = {
 	{ "goto-direction", 	1,	0,	OPT_goto_direction },
 	{ "goto-ops",		1,	0,	OPT_goto_ops },
 	{ "gpu",		1,	0,	OPT_gpu },
+	{ "gpu-compute-bytes",1,	0,	OPT_gpu_compute_bytes },
 	{ "gpu-devnode",	1,	0,	OPT_gpu_devnode },
+	{ "gpu-fma",		1,	0,	OPT_gpu_fma },
 	{ "gpu-frag",		1,	0,	OPT_gpu_frag },
+	{ "gpu-mode",		1,	0,	OPT_gpu_mode },
 	{ "gpu-ops",		1,	0,	OPT_gpu_ops },
 	{ "gpu-tex-size",	1,	0,	OPT_gpu_size },
 	{ "gpu-upload",		1,	0,	OPT_gpu_uploads },
@@ -483,14 +617,21 @@ static const struct option long_options[] = {
 	{ "handle",		1,	0,	OPT_handle },
 	{ "handle-ops",		1,	0,	OPT_handle_ops },
 	{ "hash",		1,	0,	OPT_hash },
+	{ "hash-bulk",		0,	0,	OPT_hash_bulk },
 	{ "hash-method",	1,	0,	OPT_hash_method },
 	{ "hash-ops",		1,	0,	OPT_hash_ops },
+	{ "hashtable",		1,	0,	OPT_hashtable },
+	{ "hashtable-method",	1,	0,	OPT_hashtable_method },
+	{ "hashtable-ops",	1,	0,	OPT_hashtable_ops },
+	{ "hashtable-size",	1,	0,	OPT_hashtable_size },
 	{ "hdd",		1,	0,	OPT_hdd },
 	{ "hdd-bytes",		1,	0,	OPT_hdd_bytes },
 	{ "hdd-ops",		1,	0,	OPT_hdd_ops },
 	{ "hdd-opts",		1,	0,	OPT_hdd_opts },
+	{ "hdd-qd-sweep",	1,	0,	OPT_hdd_qd_sweep },
 	{ "hdd-write-size", 	1,	0,	OPT_hdd_write_size },
 	{ "heapsort",		1,	0,	OPT_heapsort },
+	{ "heapsort-dists",	0,	0,	OPT_heapsort_dists },
 	{ "heapsort-ops",	1,	0,	OPT_heapsort_ops },
 	{ "heapsort-size",	1,	0,	OPT_heapsort_integers },
 	{ "hrtimers",		1,	0,	OPT_hrtimers },
@@ -510,53 +651,81 @@ static const struct option long_options[] = {
 	{ "inode-flags",	1,	0,	OPT_inode_flags },
 	{ "inode-flags-ops",	1,	0,	OPT_inode_flags_ops },
 	{ "inotify",		1,	0,	OPT_inotify },
+	{ "inotify-dirs",	1,	0,	OPT_inotify_dirs },
 	{ "inotify-ops",	1,	0,	OPT_inotify_ops },
+	{ "inotify-scale",	0,	0,	OPT_inotify_scale },
+	{ "inotify-writers",	1,	0,	OPT_inotify_writers },
+	{ "interference",	1,	0,	OPT_interference },
 	{ "io",			1,	0,	OPT_io },
 	{ "io-ops",		1,	0,	OPT_io_ops },
 	{ "iomix",		1,	0,	OPT_iomix },
 	{ "iomix-bytes",	1,	0,	OPT_iomix_bytes },
 	{ "iomix-ops",		1,	0,	OPT_iomix_ops },
+	{ "iomix-profile",	1,	0,	OPT_iomix_profile },
 	{ "ionice-class",	1,	0,	OPT_ionice_class },
 	{ "ionice-level",	1,	0,	OPT_ionice_level },
 	{ "ioport",		1,	0,	OPT_ioport },
 	{ "ioport-ops",		1,	0,	OPT_ioport_ops },
 	{ "ioport-opts",	1,	0,	OPT_ioport_opts },
 	{ "ioprio",		1,	0,	OPT_ioprio },
+	{ "ioprio-bench",	0,	0,	OPT_ioprio_bench },
 	{ "ioprio-ops",		1,	0,	OPT_ioprio_ops },
 	{ "iostat",		1,	0,	OPT_iostat },
 	{ "io-uring",		1,	0,	OPT_io_uring },
+	{ "io-uring-depth",	1,	0,	OPT_io_uring_depth },
+	{ "io-uring-fixed",	0,	0,	OPT_io_uring_fixed },
+	{ "io-uring-iopoll",	0,	0,	OPT_io_uring_iopoll },
 	{ "io-uring-ops",	1,	0,	OPT_io_uring_ops },
+	{ "io-uring-rw",	1,	0,	OPT_io_uring_rw },
+	{ "io-uring-sqpoll",	0,	0,	OPT_io_uring_sqpoll },
 	{ "ipsec-mb",		1,	0,	OPT_ipsec_mb },
 	{ "ipsec-mb-feature",	1,	0,	OPT_ipsec_mb_feature },
 	{ "ipsec-mb-jobs",	1,	0,	OPT_ipsec_mb_jobs },
 	{ "ipsec-mb-method",	1,	0,	OPT_ipsec_mb_method },
 	{ "ipsec-mb-ops",	1,	0,	OPT_ipsec_mb_ops },
+	{ "irq-dev",		1,	0,	OPT_irq_dev },
+	{ "irq-placement",	1,	0,	OPT_irq_placement },
 	{ "itimer",		1,	0,	OPT_itimer },
 	{ "itimer-freq",	1,	0,	OPT_itimer_freq },
 	{ "itimer-ops",		1,	0,	OPT_itimer_ops },
 	{ "itimer-rand",	0,	0,	OPT_itimer_rand },
 	{ "job",		1,	0,	OPT_job },
 	{ "jpeg",		1,	0,	OPT_jpeg },
+	{ "jpeg-bench",		0,	0,	OPT_jpeg_bench },
 	{ "jpeg-height",	1,	0,	OPT_jpeg_height },
 	{ "jpeg-image",		1,	0,	OPT_jpeg_image },
+	{ "jpeg-nosimd",	0,	0,	OPT_jpeg_nosimd },
 	{ "jpeg-ops",		1,	0,	OPT_jpeg_ops },
 	{ "jpeg-quality",	1,	0,	OPT_jpeg_quality },
 	{ "jpeg-width",		1,	0,	OPT_jpeg_width },
 	{ "judy",		1,	0,	OPT_judy },
+	{ "judy-bench",		0,	0,	OPT_judy_bench },
+	{ "judy-dist",		1,	0,	OPT_judy_dist },
 	{ "judy-ops",		1,	0,	OPT_judy_ops },
 	{ "judy-size",		1,	0,	OPT_judy_size },
+	{ "judy-threads",	1,	0,	OPT_judy_threads },
 	{ "kcmp",		1,	0,	OPT_kcmp },
 	{ "kcmp-ops",		1,	0,	OPT_kcmp_ops },
 	{ "keep-files",		0,	0,	OPT_keep_files },
 	{ "keep-name",		0,	0,	OPT_keep_name },
 	{ "key",		1,	0,	OPT_key },
 	{ "key-ops",		1,	0,	OPT_key_ops },
+	{ "keysort",		1,	0,	OPT_keysort },
+	{ "keysort-method",	1,	0,	OPT_keysort_method },
+	{ "keysort-ops",	1,	0,	OPT_keysort_ops },
+	{ "keysort-size",	1,	0,	OPT_keysort_size },
+	{ "keysort-threads",	1,	0,	OPT_keysort_threads },
 	{ "kill",		1,	0,	OPT_kill },
 	{ "kill-ops",		1,	0,	OPT_kill_ops },
 	{ "klog",		1,	0,	OPT_klog },
 	{ "klog-check",		0,	0,	OPT_klog_check },
 	{ "klog-ops",		1,	0,	OPT_klog_ops },
+	{ "ktls",		1,	0,	OPT_ktls },
+	{ "ktls-bytes",		1,	0,	OPT_ktls_bytes },
+	{ "ktls-mode",		1,	0,	OPT_ktls_mode },
+	{ "ktls-ops",		1,	0,	OPT_ktls_ops },
 	{ "kvm",		1,	0,	OPT_kvm },
+	{ "kvm-method",	1,	0,	OPT_kvm_method },
 	{ "kvm-ops",		1,	0,	OPT_kvm_ops },
 	{ "l1cache",		1,	0, 	OPT_l1cache },
 	{ "l1cache-line-size",	1,	0,	OPT_l1cache_line_size },
@@ -567,6 +736,7 @@ static const struct option long_options[] = {
 	{ "l1cache-ways",	1,	0,	OPT_l1cache_ways},
 	{ "landlock",		1,	0,	OPT_landlock },
 	{ "landlock-ops",	1,	0,	OPT_landlock_ops },
+	{ "latency-hist",	0,	0,	OPT_latency_hist },
 	{ "lease",		1,	0,	OPT_lease },
 	{ "lease-breakers",	1,	0,	OPT_lease_breakers },
 	{ "lease-ops",		1,	0,	OPT_lease_ops },
@@ -574,6 +744,7 @@ static const struct option long_options[] = {
 	{ "link-ops",		1,	0,	OPT_link_ops },
 	{ "link-sync",		0,	0,	OPT_link_sync },
 	{ "list",		1,	0,	OPT_list },
+	{ "list-bench",		0,	0,	OPT_list_bench },
 	{ "list-method",	1,	0,	OPT_list_method },
 	{ "list-ops",		1,	0,	OPT_list_ops },
 	{ "list-size",		1,	0,	OPT_list_size },
@@ -588,10 +759,19 @@ static const struct option long_options[] = {
 	{ "lockbus-ops",	1,	0,	OPT_lockbus_ops },
 	{ "lockbus-nosplit",	0,	0,	OPT_lockbus_nosplit },
 	{ "lockf",		1,	0,	OPT_lockf },
+	{ "lockf-files",	1,	0,	OPT_lockf_files },
 	{ "lockf-nonblock", 	0,	0,	OPT_lockf_nonblock },
 	{ "lockf-ops",		1,	0,	OPT_lockf_ops },
+	{ "lockf-overlap",	0,	0,	OPT_lockf_overlap },
+	{ "lockf-procs",	1,	0,	OPT_lockf_procs },
+	{ "lockf-scale",	0,	0,	OPT_lockf_scale },
 	{ "lockofd",		1,	0,	OPT_lockofd },
+	{ "lockofd-files",	1,	0,	OPT_lockofd_files },
 	{ "lockofd-ops",	1,	0,	OPT_lockofd_ops },
+	{ "lockofd-overlap",	0,	0,	OPT_lockofd_overlap },
+	{ "lockofd-procs",	1,	0,	OPT_lockofd_procs },
+	{ "lockofd-scale",	0,	0,	OPT_lockofd_scale },
+	{ "log-async",		0,	0,	OPT_log_async },
 	{ "log-brief",		0,	0,	OPT_log_brief },
 	{ "log-file",		1,	0,	OPT_log_file },
 	{ "log-lockless",	0,	0,	OPT_log_lockless },
@@ -603,19 +783,24 @@ static const struct option long_options[] = {
 	{ "lsearch-ops",	1,	0,	OPT_lsearch_ops },
 	{ "lsearch-size",	1,	0,	OPT_lsearch_size },
 	{ "madvise",		1,	0,	OPT_madvise },
+	{ "madvise-bench",	0,	0,	OPT_madvise_bench },
+	{ "madvise-bench-bytes", 1,	0,	OPT_madvise_bench_bytes },
 	{ "madvise-ops",	1,	0,	OPT_madvise_ops },
 	{ "malloc",		1,	0,	OPT_malloc },
 	{ "malloc-bytes",	1,	0,	OPT_malloc_bytes },
 	{ "malloc-max",		1,	0,	OPT_malloc_max },
 	{ "malloc-ops",		1,	0,	OPT_malloc_ops },
 	{ "malloc-pthreads",	1,	0,	OPT_malloc_pthreads },
+	{ "malloc-sizes",	1,	0,	OPT_malloc_sizes },
 	{ "malloc-thresh",	1,	0,	OPT_malloc_threshold },
 	{ "malloc-touch",	0,	0,	OPT_malloc_touch },
+	{ "malloc-workload",	1,	0,	OPT_malloc_workload },
 	{ "malloc-zerofree",	0,	0,	OPT_malloc_zerofree },
 	{ "matrix",		1,	0,	OPT_matrix },
 	{ "matrix-method",	1,	0,	OPT_matrix_method },
 	{ "matrix-ops",		1,	0,	OPT_matrix_ops },
 	{ "matrix-size",	1,	0,	OPT_matrix_size },
+	{ "matrix-threads",	1,	0,	OPT_matrix_threads },
 	{ "matrix-yx",		0,	0,	OPT_matrix_yx },
 	{ "matrix-3d",		1,	0,	OPT_matrix_3d },
 	{ "matrix-3d-method",	1,	0,	OPT_matrix_3d_method },
@@ -632,26 +817,44 @@ static const struct option long_options[] = {
 	{ "memcpy",		1,	0,	OPT_memcpy },
 	{ "memcpy-method",	1,	0,	OPT_memcpy_method },
 	{ "memcpy-ops",		1,	0,	OPT_memcpy_ops },
+	{ "memcpy-sweep",	0,	0,	OPT_memcpy_sweep },
 	{ "memfd",		1,	0,	OPT_memfd },
 	{ "memfd-bytes",	1,	0,	OPT_memfd_bytes },
 	{ "memfd-fds",		1,	0,	OPT_memfd_fds },
 	{ "memfd-ops",		1,	0,	OPT_memfd_ops },
 	{ "memhotplug",		1,	0,	OPT_memhotplug },
 	{ "memhotplug-ops",	1,	0,	OPT_memhotplug_ops },
+	{ "memlat",		1,	0,	OPT_memlat },
+	{ "memlat-loaded",	0,	0,	OPT_memlat_loaded },
+	{ "memlat-max-size",	1,	0,	OPT_memlat_max_size },
+	{ "memlat-ops",		1,	0,	OPT_memlat_ops },
+	{ "memlat-step-ms",	1,	0,	OPT_memlat_step_ms },
 	{ "memrate",		1,	0,	OPT_memrate },
+	{ "memrate-backing",	1,	0,	OPT_memrate_backing },
 	{ "memrate-bytes",	1,	0,	OPT_memrate_bytes },
 	{ "memrate-flush",	0,	0,	OPT_memrate_flush },
 	{ "memrate-ops",	1,	0,	OPT_memrate_ops },
 	{ "memrate-rd-mbs",	1,	0,	OPT_memrate_rd_mbs },
+	{ "memrate-target-mbs",	1,	0,	OPT_memrate_target_mbs },
+	{ "memrate-target-op",	1,	0,	OPT_memrate_target_op },
 	{ "memrate-wr-mbs",	1,	0,	OPT_memrate_wr_mbs },
 	{ "memthrash",		1,	0,	OPT_memthrash },
 	{ "memthrash-method",	1,	0,	OPT_memthrash_method },
 	{ "memthrash-ops",	1,	0,	OPT_memthrash_ops },
+	{ "memtier",		1,	0,	OPT_memtier },
+	{ "memtier-bytes",	1,	0,	OPT_memtier_bytes },
+	{ "memtier-hot",	1,	0,	OPT_memtier_hot },
+	{ "memtier-ops",	1,	0,	OPT_memtier_ops },
 	{ "mergesort",		1,	0,	OPT_mergesort },
+	{ "mergesort-dists",	0,	0,	OPT_mergesort_dists },
 	{ "mergesort-ops",	1,	0,	OPT_mergesort_ops },
 	{ "mergesort-size",	1,	0,	OPT_mergesort_integers },
 	{ "metrics",		0,	0,	OPT_metrics },
 	{ "metrics-brief",	0,	0,	OPT_metrics_brief },
+	{ "metrics-instances",	0,	0,	OPT_metrics_instances },
+	{ "metrics-stream",	1,	0,	OPT_metrics_stream },
+	{ "metrics-stream-format",1,	0,	OPT_metrics_stream_format },
+	{ "metrics-stream-ms",	1,	0,	OPT_metrics_stream_ms },
 	{ "mincore",		1,	0,	OPT_mincore },
 	{ "mincore-ops",	1,	0,	OPT_mincore_ops },
 	{ "mincore-random",	0,	0,	OPT_mincore_rand },
@@ -659,6 +862,7 @@ static const struct option long_options[] = {
 	{ "misaligned-method",	1,	0,	OPT_misaligned_method },
 	{ "misaligned-ops",	1,	0,	OPT_misaligned_ops },
 	{ "minimize",		0,	0,	OPT_minimize },
+	{ "mitigations",	0,	0,	OPT_mitigations },
 	{ "mknod",		1,	0,	OPT_mknod },
 	{ "mknod-ops",		1,	0,	OPT_mknod_ops },
 	{ "mlock",		1,	0,	OPT_mlock },
@@ -685,6 +889,8 @@ static const struct option long_options[] = {
 	{ "mmaphuge-mmaps",	1,	0,	OPT_mmaphuge_mmaps },
 	{ "mmaphuge-ops",	1,	0,	OPT_mmaphuge_ops },
 	{ "mmapmany",		1,	0,	OPT_mmapmany },
+	{ "mmapmany-bench",	0,	0,	OPT_mmapmany_bench },
+	{ "mmapmany-bench-threads", 1,	0,	OPT_mmapmany_bench_threads },
 	{ "mmapmany-ops",	1,	0,	OPT_mmapmany_ops },
 	{ "module",		1,	0,	OPT_module},
 	{ "module-ops",		1,	0,	OPT_module_ops },
@@ -698,6 +904,7 @@ static const struct option long_options[] = {
 	{ "mq-ops",		1,	0,	OPT_mq_ops },
 	{ "mq-size",		1,	0,	OPT_mq_size },
 	{ "mremap",		1,	0,	OPT_mremap },
+	{ "mremap-bench",	0,	0,	OPT_mremap_bench },
 	{ "mremap-bytes",	1,	0,	OPT_mremap_bytes },
 	{ "mremap-mlock",	0,	0,	OPT_mremap_mlock },
 	{ "mremap-ops",		1,	0,	OPT_mremap_ops },
@@ -737,6 +944,7 @@ static const struct option long_options[] = {
 	{ "null-ops",		1,	0,	OPT_null_ops },
 	{ "numa",		1,	0,	OPT_numa },
 	{ "numa-ops",		1,	0,	OPT_numa_ops },
+	{ "offcpu",		0,	0,	OPT_offcpu },
 	{ "oomable",		0,	0,	OPT_oomable },
 	{ "oom-avoid",		0,	0,	OPT_oom_avoid },
 	{ "oom-avoid-bytes",	1,	0,	OPT_oom_avoid_bytes },
@@ -751,10 +959,16 @@ static const struct option long_options[] = {
 	{ "open-ops",		1,	0,	OPT_open_ops },
 	{ "page-in",		0,	0,	OPT_page_in },
 	{ "pagemove",		1,	0,	OPT_pagemove },
+	{ "pagemove-bench",	0,	0,	OPT_pagemove_bench },
 	{ "pagemove-bytes",	1,	0,	OPT_pagemove_bytes },
 	{ "pagemove-ops",	1,	0,	OPT_pagemove_ops },
 	{ "pageswap",		1,	0,	OPT_pageswap },
 	{ "pageswap-ops",	1,	0,	OPT_pageswap_ops },
+	{ "pathwalk",		1,	0,	OPT_pathwalk },
+	{ "pathwalk-depth",	1,	0,	OPT_pathwalk_depth },
+	{ "pathwalk-method",	1,	0,	OPT_pathwalk_method },
+	{ "pathwalk-ops",	1,	0,	OPT_pathwalk_ops },
+	{ "pathwalk-threads",	1,	0,	OPT_pathwalk_threads },
 	{ "parallel",		1,	0,	OPT_all },
 	{ "pathological",	0,	0,	OPT_pathological },
 	{ "pci",		1,	0,	OPT_pci},
@@ -762,6 +976,10 @@ static const struct option long_options[] = {
 #if defined(STRESS_PERF_STATS) && 	\
     defined(HAVE_LINUX_PERF_EVENT_H)
 	{ "perf",		0,	0,	OPT_perf_stats },
+	{ "perf-events",	1,	0,	OPT_perf_events },
+	{ "perf-sample",	0,	0,	OPT_perf_sample },
+	{ "perf-sample-top",	1,	0,	OPT_perf_sample_top },
+	{ "perf-topdown",	0,	0,	OPT_perf_topdown },
 #endif
 	{ "personality",	1,	0,	OPT_personality },
 	{ "personality-ops",	1,	0,	OPT_personality_ops },
@@ -778,29 +996,44 @@ static const struct option long_options[] = {
 	{ "pipe-ops",		1,	0,	OPT_pipe_ops },
 #if defined(F_SETPIPE_SZ)
 	{ "pipe-size",		1,	0,	OPT_pipe_size },
+	{ "pipe-sweep",		0,	0,	OPT_pipe_sweep },
 #endif
 	{ "pipeherd",		1,	0,	OPT_pipeherd },
 	{ "pipeherd-ops",	1,	0,	OPT_pipeherd_ops },
 	{ "pipeherd-yield", 	0,	0,	OPT_pipeherd_yield },
 	{ "pkey",		1,	0,	OPT_pkey },
 	{ "pkey-ops",		1,	0,	OPT_pkey_ops },
+	{ "pktring",		1,	0,	OPT_pktring },
+	{ "pktring-if",		1,	0,	OPT_pktring_if },
+	{ "pktring-ops",	1,	0,	OPT_pktring_ops },
+	{ "pktring-size",	1,	0,	OPT_pktring_size },
+	{ "placement",		1,	0,	OPT_placement },
 	{ "plugin",		1,	0,	OPT_plugin },
+	{ "plugin-batch",	1,	0,	OPT_plugin_batch },
 	{ "plugin-method",	1,	0,	OPT_plugin_method },
 	{ "plugin-ops",		1,	0,	OPT_plugin_ops },
 	{ "plugin-so",		1,	0,	OPT_plugin_so },
 	{ "poll",		1,	0,	OPT_poll },
 	{ "poll-ops",		1,	0,	OPT_poll_ops },
 	{ "poll-fds",		1,	0,	OPT_poll_fds },
+	{ "power",		0,	0,	OPT_power },
 	{ "prctl",		1,	0,	OPT_prctl },
 	{ "prctl-ops",		1,	0,	OPT_prctl_ops },
 	{ "prefetch",		1,	0,	OPT_prefetch },
 	{ "prefetch-l3-size",	1,	0,	OPT_prefetch_l3_size },
 	{ "prefetch-method",	1,	0,	OPT_prefetch_method },
 	{ "prefetch-ops",	1,	0,	OPT_prefetch_ops },
+	{ "prefetch-sweep",	0,	0,	OPT_prefetch_sweep },
+	{ "prefork",		0,	0,	OPT_prefork },
 	{ "priv-instr",		1,	0,	OPT_priv_instr },
 	{ "priv-instr-ops",	1,	0,	OPT_priv_instr_ops },
+	{ "proc-create",	1,	0,	OPT_proc_create },
+	{ "proc-create-method",	1,	0,	OPT_proc_create_method },
+	{ "proc-create-ops",	1,	0,	OPT_proc_create_ops },
+	{ "proc-create-rss-max",1,	0,	OPT_proc_create_rss_max },
 	{ "procfs",		1,	0,	OPT_procfs },
 	{ "procfs-ops",		1,	0,	OPT_procfs_ops },
+	{ "psistat",		1,	0,	OPT_psistat },
 	{ "pthread",		1,	0,	OPT_pthread },
 	{ "pthread-max",	1,	0,	OPT_pthread_max },
 	{ "pthread-ops",	1,	0,	OPT_pthread_ops },
@@ -810,6 +1043,7 @@ static const struct option long_options[] = {
 	{ "pty-max",		1,	0,	OPT_pty_max },
 	{ "pty-ops",		1,	0,	OPT_pty_ops },
 	{ "qsort",		1,	0,	OPT_qsort },
+	{ "qsort-dists",	0,	0,	OPT_qsort_dists },
 	{ "qsort-method",	1,	0,	OPT_qsort_method },
 	{ "qsort-ops",		1,	0,	OPT_qsort_ops },
 	{ "qsort-size",		1,	0,	OPT_qsort_integers },
@@ -823,6 +1057,7 @@ static const struct option long_options[] = {
 	{ "radixsort-ops",	1,	0,	OPT_radixsort_ops },
 	{ "radixsort-size",	1,	0,	OPT_radixsort_size },
 	{ "ramfs",		1,	0,	OPT_ramfs },
+	{ "ramfs-bench",	0,	0,	OPT_ramfs_bench },
 	{ "ramfs-fill",		0,	0,	OPT_ramfs_fill },
 	{ "ramfs-ops",		1,	0,	OPT_ramfs_ops },
 	{ "ramfs-size",		1,	0,	OPT_ramfs_size },
@@ -834,6 +1069,7 @@ static const struct option long_options[] = {
 	{ "random",		1,	0,	OPT_random },
 	{ "rawdev",		1,	0,	OPT_rawdev },
 	{ "rawdev-method",	1,	0,	OPT_rawdev_method },
+	{ "rawdev-qd-sweep",	1,	0,	OPT_rawdev_qd_sweep },
 	{ "rawdev-ops",		1,	0,	OPT_rawdev_ops },
 	{ "rawpkt",		1,	0,	OPT_rawpkt },
 	{ "rawpkt-ops",		1,	0,	OPT_rawpkt_ops },
@@ -852,18 +1088,37 @@ static const struct option long_options[] = {
 	{ "readahead",		1,	0,	OPT_readahead },
 	{ "readahead-bytes",	1,	0,	OPT_readahead_bytes },
 	{ "readahead-ops",	1,	0,	OPT_readahead_ops },
+	{ "readahead-sweep",	0,	0,	OPT_readahead_sweep },
 	{ "reboot",		1,	0,	OPT_reboot },
 	{ "reboot-ops",		1,	0,	OPT_reboot_ops },
+	{ "reclaim",		1,	0,	OPT_reclaim },
+	{ "reclaim-bytes",	1,	0,	OPT_reclaim_bytes },
+	{ "reclaim-ops",	1,	0,	OPT_reclaim_ops },
 	{ "regs",		1,	0,	OPT_regs },
 	{ "regs-ops",		1,	0,	OPT_regs_ops },
 	{ "remap",		1,	0,	OPT_remap },
 	{ "remap-ops",		1,	0,	OPT_remap_ops },
 	{ "rename",		1,	0,	OPT_rename },
 	{ "rename-ops",		1,	0,	OPT_rename_ops },
+	{ "rate",		1,	0,	OPT_rate },
+	{ "repeat",		1,	0,	OPT_repeat },
+	{ "replay",		1,	0,	OPT_replay },
+	{ "replay-file",	1,	0,	OPT_replay_file },
+	{ "replay-mode",	1,	0,	OPT_replay_mode },
+	{ "replay-ops",		1,	0,	OPT_replay_ops },
+	{ "replay-port",	1,	0,	OPT_replay_port },
+	{ "replay-speed",	1,	0,	OPT_replay_speed },
+	{ "replay-threads",	1,	0,	OPT_replay_threads },
+	{ "reproduce",		1,	0,	OPT_reproduce },
+	{ "resctrl",		0,	0,	OPT_resctrl },
+	{ "resctrl-cat",	1,	0,	OPT_resctrl_cat },
+	{ "resctrl-sweep",	1,	0,	OPT_resctrl_sweep },
+	{ "resctrl-victim",	1,	0,	OPT_resctrl_victim },
 	{ "resched",		1,	0,	OPT_resched },
 	{ "resched-ops",	1,	0,	OPT_resched_ops },
 	{ "resources",		1,	0,	OPT_resources },
 	{ "resources-ops",	1,	0,	OPT_resources_ops },
+	{ "results-bin",	1,	0,	OPT_results_bin },
 	{ "revio",		1,	0,	OPT_revio },
 	{ "revio-bytes",	1,	0,	OPT_revio_bytes },
 	{ "revio-ops",		1,	0,	OPT_revio_ops },
@@ -882,8 +1137,10 @@ static const struct option long_options[] = {
 	{ "rotate-ops",		1,	0,	OPT_rotate_ops },
 	{ "rseq",		1,	0,	OPT_rseq },
 	{ "rseq-ops",		1,	0,	OPT_rseq_ops },
+	{ "rseq-percpu",	0,	0,	OPT_rseq_percpu },
 	{ "rtc",		1,	0,	OPT_rtc },
 	{ "rtc-ops",		1,	0,	OPT_rtc_ops },
+	{ "scaling",		0,	0,	OPT_scaling },
 	{ "sched",		1,	0,	OPT_sched },
 	{ "sched-deadline",	1,	0,	OPT_sched_deadline },
 	{ "sched-period",	1,	0,	OPT_sched_period },
@@ -892,6 +1149,8 @@ static const struct option long_options[] = {
 	{ "sched-runtime",	1,	0,	OPT_sched_runtime },
 	{ "schedpolicy",	1,	0,	OPT_schedpolicy },
 	{ "schedpolicy-ops",	1,	0,	OPT_schedpolicy_ops },
+	{ "schedstat",		0,	0,	OPT_schedstat },
+	{ "score",		1,	0,	OPT_score },
 	{ "sctp",		1,	0,	OPT_sctp },
 	{ "sctp-domain",	1,	0,	OPT_sctp_domain },
 	{ "sctp-if",		1,	0,	OPT_sctp_if },
@@ -904,6 +1163,11 @@ static const struct option long_options[] = {
 	{ "seccomp-ops",	1,	0,	OPT_seccomp_ops },
 	{ "secretmem",		1,	0,	OPT_secretmem },
 	{ "secretmem-ops",	1,	0,	OPT_secretmem_ops },
+	{ "search",		1,	0,	OPT_search },
+	{ "search-ghz-drop",	1,	0,	OPT_search_ghz_drop },
+	{ "search-max",		1,	0,	OPT_search_max },
+	{ "search-p99",		1,	0,	OPT_search_p99 },
+	{ "search-temp",	1,	0,	OPT_search_temp },
 	{ "seed",		1,	0,	OPT_seed },
 	{ "seek",		1,	0,	OPT_seek },
 	{ "seek-ops",		1,	0,	OPT_seek_ops },
@@ -924,16 +1188,26 @@ static const struct option long_options[] = {
 	{ "set",		1,	0,	OPT_set },
 	{ "set-ops",		1,	0,	OPT_set_ops },
 	{ "shellsort",		1,	0,	OPT_shellsort },
+	{ "shellsort-dists",	0,	0,	OPT_shellsort_dists },
 	{ "shellsort-ops",	1,	0,	OPT_shellsort_ops },
 	{ "shellsort-size",	1,	0,	OPT_shellsort_size },
 	{ "shm",		1,	0,	OPT_shm },
 	{ "shm-bytes",		1,	0,	OPT_shm_bytes },
 	{ "shm-objs",		1,	0,	OPT_shm_objects },
 	{ "shm-ops",		1,	0,	OPT_shm_ops },
+	{ "shm-scale",		0,	0,	OPT_shm_scale },
+	{ "shm-scale-procs",	1,	0,	OPT_shm_scale_procs },
 	{ "shm-sysv",		1,	0,	OPT_shm_sysv },
 	{ "shm-sysv-bytes",	1,	0,	OPT_shm_sysv_bytes },
 	{ "shm-sysv-ops",	1,	0,	OPT_shm_sysv_ops },
+	{ "shm-sysv-scale",	0,	0,	OPT_shm_sysv_scale },
+	{ "shm-sysv-scale-procs",1,	0,	OPT_shm_sysv_scale_procs },
 	{ "shm-sysv-segs",	1,	0,	OPT_shm_sysv_segments },
+	{ "shmring",		1,	0,	OPT_shmring },
+	{ "shmring-mode",	1,	0,	OPT_shmring_mode },
+	{ "shmring-ops",	1,	0,	OPT_shmring_ops },
+	{ "shmring-procs",	1,	0,	OPT_shmring_procs },
+	{ "shmring-slots",	1,	0,	OPT_shmring_slots },
 	{ "sigabrt",		1,	0,	OPT_sigabrt },
 	{ "sigabrt-ops",	1,	0,	OPT_sigabrt_ops },
 	{ "sigchld",		1,	0,	OPT_sigchld },
@@ -945,6 +1219,7 @@ static const struct option long_options[] = {
 	{ "sigfpe",		1,	0,	OPT_sigfpe },
 	{ "sigfpe-ops",		1,	0,	OPT_sigfpe_ops },
 	{ "signal",		1,	0,	OPT_signal },
+	{ "signal-bench",	0,	0,	OPT_signal_bench },
 	{ "signal-ops",		1,	0,	OPT_signal_ops },
 	{ "signest",		1,	0,	OPT_signest },
 	{ "signest-ops",	1,	0,	OPT_signest_ops },
@@ -963,8 +1238,11 @@ static const struct option long_options[] = {
 	{ "sigtrap",		1,	0,	OPT_sigtrap },
 	{ "sigtrap-ops",	1,	0,	OPT_sigtrap_ops},
 	{ "skiplist",		1,	0,	OPT_skiplist },
+	{ "skiplist-bench",	0,	0,	OPT_skiplist_bench },
+	{ "skiplist-dist",	1,	0,	OPT_skiplist_dist },
 	{ "skiplist-ops",	1,	0,	OPT_skiplist_ops },
 	{ "skiplist-size",	1,	0,	OPT_skiplist_size },
+	{ "skiplist-threads",	1,	0,	OPT_skiplist_threads },
 	{ "skip-silent",	0,	0,	OPT_skip_silent },
 	{ "sleep",		1,	0,	OPT_sleep },
 	{ "sleep-max",		1,	0,	OPT_sleep_max },
@@ -972,15 +1250,21 @@ static const struct option long_options[] = {
 	{ "smart",		0,	0,	OPT_smart },
 	{ "smi",		1,	0,	OPT_smi },
 	{ "smi-ops",		1,	0,	OPT_smi_ops },
+	{ "smt-interference",	0,	0,	OPT_smt_interference },
 	{ "sn",			0,	0,	OPT_sn },
 	{ "sock",		1,	0,	OPT_sock },
 	{ "sock-domain",	1,	0,	OPT_sock_domain },
 	{ "sock-if",		1,	0,	OPT_sock_if },
+	{ "sock-mptcp-bench",	0,	0,	OPT_sock_mptcp_bench },
+	{ "sock-mptcp-subflows",1,	0,	OPT_sock_mptcp_subflows },
 	{ "sock-nodelay",	0,	0,	OPT_sock_nodelay },
 	{ "sock-ops",		1,	0,	OPT_sock_ops },
 	{ "sock-opts",		1,	0,	OPT_sock_opts },
+	{ "sock-peer",		1,	0,	OPT_sock_peer },
+	{ "sock-peers",		1,	0,	OPT_sock_peers },
 	{ "sock-port",		1,	0,	OPT_sock_port },
 	{ "sock-protocol",	1,	0,	OPT_sock_protocol },
+	{ "sock-server",	0,	0,	OPT_sock_server },
 	{ "sock-type",		1,	0,	OPT_sock_type },
 	{ "sock-zerocopy", 	0,	0,	OPT_sock_zerocopy },
 	{ "sockabuse",		1,	0,	OPT_sockabuse },
@@ -992,9 +1276,12 @@ static const struct option long_options[] = {
 	{ "sockfd-ops",		1,	0,	OPT_sockfd_ops },
 	{ "sockfd-port",	1,	0,	OPT_sockfd_port },
 	{ "sockmany",		1,	0,	OPT_sockmany },
+	{ "sockmany-acceptors",	1,	0,	OPT_sockmany_acceptors },
+	{ "sockmany-conns",	1,	0,	OPT_sockmany_conns },
 	{ "sockmany-if",	1,	0,	OPT_sockmany_if },
 	{ "sockmany-ops",	1,	0,	OPT_sockmany_ops },
 	{ "sockmany-port",	1,	0,	OPT_sockmany_port },
+	{ "sockmany-scale",	0,	0,	OPT_sockmany_scale },
 	{ "sockpair",		1,	0,	OPT_sockpair },
 	{ "sockpair-ops",	1,	0,	OPT_sockpair_ops },
 	{ "softlockup",		1,	0,	OPT_softlockup },
@@ -1004,11 +1291,24 @@ static const struct option long_options[] = {
 	{ "sparsematrix-method",1,	0,	OPT_sparsematrix_method },
 	{ "sparsematrix-ops",	1,	0,	OPT_sparsematrix_ops },
 	{ "sparsematrix-size",	1,	0,	OPT_sparsematrix_size },
+	{ "spinlock",		1,	0,	OPT_spinlock },
+	{ "spinlock-cs",	1,	0,	OPT_spinlock_cs },
+	{ "spinlock-method",	1,	0,	OPT_spinlock_method },
+	{ "spinlock-ops",	1,	0,	OPT_spinlock_ops },
+	{ "spinlock-sweep",	0,	0,	OPT_spinlock_sweep },
+	{ "spinlock-threads",	1,	0,	OPT_spinlock_threads },
 	{ "spawn",		1,	0,	OPT_spawn },
 	{ "spawn-ops",		1,	0,	OPT_spawn_ops },
 	{ "splice",		1,	0,	OPT_splice },
 	{ "splice-bytes",	1,	0,	OPT_splice_bytes },
 	{ "splice-ops",		1,	0,	OPT_splice_ops },
+	{ "spmv",		1,	0,	OPT_spmv },
+	{ "spmv-method",	1,	0,	OPT_spmv_method },
+	{ "spmv-nnz",		1,	0,	OPT_spmv_nnz },
+	{ "spmv-ops",		1,	0,	OPT_spmv_ops },
+	{ "spmv-pattern",	1,	0,	OPT_spmv_pattern },
+	{ "spmv-size",		1,	0,	OPT_spmv_size },
+	{ "spmv-threads",	1,	0,	OPT_spmv_threads },
 	{ "stack",		1,	0,	OPT_stack},
 	{ "stack-fill",		0,	0,	OPT_stack_fill },
 	{ "stack-mlock",	0,	0,	OPT_stack_mlock },
@@ -1019,15 +1319,25 @@ static const struct option long_options[] = {
 	{ "stackmmap-ops",	1,	0,	OPT_stackmmap_ops },
 	{ "stdout",		0,	0,	OPT_stdout },
 	{ "str",		1,	0,	OPT_str },
+	{ "str-bench",		0,	0,	OPT_str_bench },
+	{ "str-lengths",	1,	0,	OPT_str_lengths },
 	{ "str-method",		1,	0,	OPT_str_method },
 	{ "str-ops",		1,	0,	OPT_str_ops },
 	{ "stressors",		0,	0,	OPT_stressors },
 	{ "stream",		1,	0,	OPT_stream },
+	{ "stream-backing",	1,	0,	OPT_stream_backing },
 	{ "stream-index",	1,	0,	OPT_stream_index },
 	{ "stream-l3-size",	1,	0,	OPT_stream_l3_size },
 	{ "stream-madvise",	1,	0,	OPT_stream_madvise },
+	{ "stream-numa",	0,	0,	OPT_stream_numa },
 	{ "stream-ops",		1,	0,	OPT_stream_ops },
+	{ "stream-roofline",	0,	0,	OPT_stream_roofline },
+	{ "stream-store",	1,	0,	OPT_stream_store },
+	{ "stream-threads",	1,	0,	OPT_stream_threads },
 	{ "swap",		1,	0,	OPT_swap },
+	{ "swap-bench",		0,	0,	OPT_swap_bench },
+	{ "swap-bench-bytes",	1,	0,	OPT_swap_bench_bytes },
+	{ "swap-bench-fill",	1,	0,	OPT_swap_bench_fill },
 	{ "swap-ops",		1,	0,	OPT_swap_ops },
 	{ "switch",		1,	0,	OPT_switch },
 	{ "switch-freq",	1,	0,	OPT_switch_freq },
@@ -1039,15 +1349,21 @@ static const struct option long_options[] = {
 	{ "sync-file",		1,	0,	OPT_sync_file },
 	{ "sync-file-bytes", 	1,	0,	OPT_sync_file_bytes },
 	{ "sync-file-ops", 	1,	0,	OPT_sync_file_ops },
+	{ "sync-start",		0,	0,	OPT_sync_start },
 	{ "syncload",		1,	0,	OPT_syncload },
 	{ "syncload-msbusy",	1,	0,	OPT_syncload_msbusy },
 	{ "syncload-mssleep",	1,	0,	OPT_syncload_mssleep },
 	{ "syncload-ops",	1,	0,	OPT_syncload_ops },
 	{ "sysbadaddr",		1,	0,	OPT_sysbadaddr },
 	{ "sysbadaddr-ops",	1,	0,	OPT_sysbadaddr_ops },
+	{ "sysbatch",		1,	0,	OPT_sysbatch },
+	{ "sysbatch-op",	1,	0,	OPT_sysbatch_op },
+	{ "sysbatch-ops",	1,	0,	OPT_sysbatch_ops },
 	{ "syscall",		1,	0,	OPT_syscall },
+	{ "syscall-baseline",	1,	0,	OPT_syscall_baseline },
 	{ "syscall-method",	1,	0,	OPT_syscall_method },
 	{ "syscall-ops",	1,	0,	OPT_syscall_ops },
+	{ "syscall-table",	1,	0,	OPT_syscall_table },
 	{ "sysfs",		1,	0,	OPT_sysfs },
 	{ "sysfs-ops",		1,	0,	OPT_sysfs_ops },
 	{ "sysinfo",		1,	0,	OPT_sysinfo },
@@ -1071,10 +1387,12 @@ static const struct option long_options[] = {
 	{ "timerfd-freq",	1,	0,	OPT_timerfd_freq },
 	{ "timerfd-ops",	1,	0,	OPT_timerfd_ops },
 	{ "timerfd-rand",	0,	0,	OPT_timerfd_rand },
+	{ "timerfd-scale",	1,	0,	OPT_timerfd_scale },
 	{ "timer-slack"	,	1,	0,	OPT_timer_slack },
 	{ "tlb-shootdown",	1,	0,	OPT_tlb_shootdown },
 	{ "tlb-shootdown-ops",	1,	0,	OPT_tlb_shootdown_ops },
 	{ "tmpfs",		1,	0,	OPT_tmpfs },
+	{ "tmpfs-bench",	0,	0,	OPT_tmpfs_bench },
 	{ "tmpfs-mmap-async",	0,	0,	OPT_tmpfs_mmap_async },
 	{ "tmpfs-mmap-file",	0,	0,	OPT_tmpfs_mmap_file },
 	{ "tmpfs-ops",		1,	0,	OPT_tmpfs_ops },
@@ -1084,8 +1402,10 @@ static const struct option long_options[] = {
 	{ "touch-opts",		1,	0,	OPT_touch_opts },
 	{ "tree",		1,	0,	OPT_tree },
 	{ "tree-method",	1,	0,	OPT_tree_method },
+	{ "tree-node-size",	1,	0,	OPT_tree_node_size },
 	{ "tree-ops",		1,	0,	OPT_tree_ops },
 	{ "tree-size",		1,	0,	OPT_tree_size },
+	{ "tree-sweep",		0,	0,	OPT_tree_sweep },
 	{ "tsc",		1,	0,	OPT_tsc },
 	{ "tsc-lfence",		0,	0,	OPT_tsc_lfence },
 	{ "tsc-ops",		1,	0,	OPT_tsc_ops },
@@ -1094,17 +1414,24 @@ static const struct option long_options[] = {
 	{ "tsearch-size",	1,	0,	OPT_tsearch_size },
 	{ "thermalstat",	1,	0,	OPT_thermalstat },
 	{ "thrash",		0,	0,	OPT_thrash },
+	{ "throttle",		0,	0,	OPT_throttle },
 	{ "times",		0,	0,	OPT_times },
 	{ "timestamp",		0,	0,	OPT_timestamp },
 	{ "tz",			0,	0,	OPT_thermal_zones },
 	{ "tun",		1,	0,	OPT_tun},
+	{ "tun-batch",		1,	0,	OPT_tun_batch },
+	{ "tun-bench",		0,	0,	OPT_tun_bench },
+	{ "tun-bench-size",	1,	0,	OPT_tun_bench_size },
 	{ "tun-tap",		0,	0,	OPT_tun_tap },
 	{ "tun-ops",		1,	0,	OPT_tun_ops },
+	{ "tun-queues",		1,	0,	OPT_tun_queues },
 	{ "udp",		1,	0,	OPT_udp },
+	{ "udp-busy-poll",	1,	0,	OPT_udp_busy_poll },
 	{ "udp-domain",		1,	0,	OPT_udp_domain },
 	{ "udp-gro",		0,	0,	OPT_udp_gro },
 	{ "udp-if",		1,	0,	OPT_udp_if },
 	{ "udp-lite",		0,	0,	OPT_udp_lite },
+	{ "udp-mode",		1,	0,	OPT_udp_mode },
 	{ "udp-ops",		1,	0,	OPT_udp_ops },
 	{ "udp-port",		1,	0,	OPT_udp_port },
 	{ "udp-flood",		1,	0,	OPT_udp_flood },
@@ -1121,7 +1448,10 @@ static const struct option long_options[] = {
 	{ "urandom-ops",	1,	0,	OPT_urandom_ops },
 	{ "userfaultfd",	1,	0,	OPT_userfaultfd },
 	{ "userfaultfd-bytes",	1,	0,	OPT_userfaultfd_bytes },
+	{ "userfaultfd-handlers",1,	0,	OPT_userfaultfd_handlers },
+	{ "userfaultfd-mode",	1,	0,	OPT_userfaultfd_mode },
 	{ "userfaultfd-ops",	1,	0,	OPT_userfaultfd_ops },
+	{ "userfaultfd-threads",1,	0,	OPT_userfaultfd_threads },
 	{ "usersyscall",	1,	0,	OPT_usersyscall },
 	{ "usersyscall-ops",	1,	0,	OPT_usersyscall_ops },
 	{ "utime",		1,	0,	OPT_utime },
@@ -1131,11 +1461,16 @@ static const struct option long_options[] = {
 	{ "vdso-func",		1,	0,	OPT_vdso_func },
 	{ "vdso-ops",		1,	0,	OPT_vdso_ops },
 	{ "vecfp",		1,	0,	OPT_vecfp },
+	{ "vecfp-bench",	0,	0,	OPT_vecfp_bench },
 	{ "vecfp-method",	1,	0,	OPT_vecfp_method },
 	{ "vecfp-ops",		1,	0,	OPT_vecfp_ops },
+	{ "vecfreq",		1,	0,	OPT_vecfreq },
+	{ "vecfreq-ms",		1,	0,	OPT_vecfreq_ms },
+	{ "vecfreq-ops",	1,	0,	OPT_vecfreq_ops },
 	{ "vecmath",		1,	0,	OPT_vecmath },
 	{ "vecmath-ops",	1,	0,	OPT_vecmath_ops },
 	{ "vecshuf",		1,	0,	OPT_vecshuf },
+	{ "vecshuf-isa",	1,	0,	OPT_vecshuf_isa },
 	{ "vecshuf-method",	1,	0,	OPT_vecshuf_method },
 	{ "vecshuf-ops",	1,	0,	OPT_vecshuf_ops },
 	{ "vecwide",		1,	0,	OPT_vecwide},
@@ -1153,6 +1488,7 @@ static const struct option long_options[] = {
 	{ "vforkmany-ops", 	1,	0,	OPT_vforkmany_ops },
 	{ "vforkmany-vm", 	0,	0,	OPT_vforkmany_vm },
 	{ "vm",			1,	0,	OPT_vm },
+	{ "vm-backing",		1,	0,	OPT_vm_backing },
 	{ "vm-bytes",		1,	0,	OPT_vm_bytes },
 	{ "vm-hang",		1,	0,	OPT_vm_hang },
 	{ "vm-keep",		0,	0,	OPT_vm_keep },
@@ -1165,6 +1501,7 @@ static const struct option long_options[] = {
 #if defined(MAP_POPULATE)
 	{ "vm-populate",	0,	0,	OPT_vm_mmap_populate },
 #endif
+	{ "vm-threads",		1,	0,	OPT_vm_threads },
 	{ "vm-addr",		1,	0,	OPT_vm_addr },
 	{ "vm-addr-method",	1,	0,	OPT_vm_addr_method },
 	{ "vm-addr-ops",	1,	0,	OPT_vm_addr_ops },
@@ -1181,30 +1518,54 @@ static const struct option long_options[] = {
 	{ "wait-ops",		1,	0,	OPT_wait_ops },
 	{ "waitcpu",		1,	0,	OPT_waitcpu },
 	{ "waitcpu-ops",	1,	0,	OPT_waitcpu_ops },
+	{ "wakelat",		1,	0,	OPT_wakelat },
+	{ "wakelat-distance",	1,	0,	OPT_wakelat_distance },
+	{ "wakelat-method",	1,	0,	OPT_wakelat_method },
+	{ "wakelat-ops",	1,	0,	OPT_wakelat_ops },
+	{ "wakelat-policy",	1,	0,	OPT_wakelat_policy },
+	{ "wal",		1,	0,	OPT_wal },
+	{ "wal-method",	1,	0,	OPT_wal_method },
+	{ "wal-ops",		1,	0,	OPT_wal_ops },
+	{ "wal-record",	1,	0,	OPT_wal_record },
+	{ "wal-threads",	1,	0,	OPT_wal_threads },
+	{ "warmup",		1,	0,	OPT_warmup },
 	{ "watchdog",		1,	0,	OPT_watchdog },
 	{ "watchdog-ops",	1,	0,	OPT_watchdog_ops },
 	{ "wcs",		1,	0,	OPT_wcs},
 	{ "wcs-method",		1,	0,	OPT_wcs_method },
 	{ "wcs-ops",		1,	0,	OPT_wcs_ops },
+	{ "worksteal",		1,	0,	OPT_worksteal },
+	{ "worksteal-method",	1,	0,	OPT_worksteal_method },
+	{ "worksteal-ops",	1,	0,	OPT_worksteal_ops },
+	{ "worksteal-sweep",	0,	0,	OPT_worksteal_sweep },
+	{ "worksteal-threads",	1,	0,	OPT_worksteal_threads },
 	{ "x86cpuid",		1,	0,	OPT_x86cpuid },
 	{ "x86cpuid-ops",	1,	0,	OPT_x86cpuid_ops },
 	{ "x86syscall",		1,	0,	OPT_x86syscall },
 	{ "x86syscall-func",	1,	0,	OPT_x86syscall_func },
 	{ "x86syscall-ops",	1,	0,	OPT_x86syscall_ops },
 	{ "xattr",		1,	0,	OPT_xattr },
+	{ "xattr-count",	1,	0,	OPT_xattr_count },
+	{ "xattr-namespace",	1,	0,	OPT_xattr_namespace },
 	{ "xattr-ops",		1,	0,	OPT_xattr_ops },
+	{ "xattr-readers",	1,	0,	OPT_xattr_readers },
+	{ "xattr-scale",	0,	0,	OPT_xattr_scale },
+	{ "xattr-size",		1,	0,	OPT_xattr_size },
+	{ "xattr-writers",	1,	0,	OPT_xattr_writers },
 	{ "yaml",		1,	0,	OPT_yaml },
 	{ "yield",		1,	0,	OPT_yield },
 	{ "yield-ops",		1,	0,	OPT_yield_ops },
 	{ "zero",		1,	0,	OPT_zero },
 	{ "zero-ops",		1,	0,	OPT_zero_ops },
 	{ "zlib",		1,	0,	OPT_zlib },
+	{ "zlib-codec",		1,	0,	OPT_zlib_codec },
 	{ "zlib-level",		1,	0,	OPT_zlib_level },
 	{ "zlib-method",	1,	0,	OPT_zlib_method },
 	{ "zlib-mem-level",	1,	0,	OPT_zlib_mem_level },
 	{ "zlib-ops",		1,	0,	OPT_zlib_ops },
 	{ "zlib-strategy",	1,	0,	OPT_zlib_strategy, },
 	{ "zlib-stream-bytes",	1,	0,	OPT_zlib_stream_bytes, },
+	{ "zlib-threads",	1,	0,	OPT_zlib_threads },
 	{ "zlib-window-bits",	1,	0,	OPT_zlib_window_bits },
 	{ "zombie",		1,	0,	OPT_zombie },
 	{ "zombie-max",		1,	0,	OPT_zombie_max },
@@ -1217,20 +1578,49 @@ static const struct option long_options[] = {
  */
 static const stress_help_t help_generic[] = {
 	{ NULL,		"abort",		"abort all stressors if any stressor fails" },
+	{ NULL,		"adaptive P",		"end each sequential run once the bogo-op rate 95% CI is within P%" },
+	{ NULL,		"adaptive-min N",	"run each adaptive sequential stressor for at least N seconds" },
 	{ NULL,		"aggressive",		"enable all aggressive options" },
 	{ "a N",	"all N",		"start N workers of each stress test" },
+	{ NULL,		"anomaly-abort",	"abort the run with status 8 on a throughput drop" },
+	{ NULL,		"anomaly-ms N",		"sample throughput for anomalies every N milliseconds" },
+	{ NULL,		"anomaly-sigma N",	"flag bogo-op rate drops of more than N sigma below the mean" },
+	{ NULL,		"arena",		"use an arena allocator for per bogo-op data structures" },
+	{ NULL,		"autotune",		"derive stressor buffer sizes from a probed host profile" },
+	{ NULL,		"autotune-profile F",	"read and write the --autotune host profile in file F" },
 	{ "b N",	"backoff N",		"wait of N microseconds before work starts" },
+	{ NULL,		"cache-probe",		"measure cache sizes, line size and ways and compare with sysfs/cpuid" },
+	{ NULL,		"cgroup M",		"run each stressor (M = stressor) or instance (M = instance) in a cgroup" },
+	{ NULL,		"cgroup-cpu-max Q[,P]",	"set cgroup cpu.max quota and period in usecs, or N% of a CPU" },
+	{ NULL,		"cgroup-cpuset L",	"set cgroup cpuset.cpus to the CPU list L" },
+	{ NULL,		"cgroup-io-max S",	"set cgroup io.max to S, e.g. \"8:0 wbps=1048576\"" },
+	{ NULL,		"cgroup-memory-high N",	"set cgroup memory.high to N bytes" },
+	{ NULL,		"cgroup-memory-max N",	"set cgroup memory.max to N bytes" },
 	{ NULL,		"class name",		"specify a class of stressors, use with --sequential" },
+	{ NULL,		"cluster nodes",	"run the --job file on host:port agents with a synchronised start" },
+	{ NULL,		"cluster-agent [A:]P",	"wait on port P (loopback unless A is given) for a --cluster coordinator job" },
+	{ NULL,		"cluster-key F",	"read the --cluster shared secret from file F" },
+	{ NULL,		"compare file",		"compare metrics against a baseline YAML file" },
+	{ NULL,		"compare-threshold P",	"flag changes of more than P percent as regressions" },
+	{ NULL,		"cooldown N",		"exclude the last N seconds of the run from the metrics" },
+	{ NULL,		"core-type T",		"run stressors on hybrid CPU core types, T = p, e or all-separately" },
 	{ "n",		"dry-run",		"do not run" },
 	{ NULL,		"ftrace",		"enable kernel function call tracing" },
+	{ NULL,		"ftrace-pid",		"only trace kernel function calls of stress-ng processes" },
+	{ NULL,		"ftrace-top N",		"report top N kernel functions per stressor by time" },
 	{ "h",		"help",			"show help" },
 	{ NULL,		"ignite-cpu",		"alter kernel controls to make CPU run hot" },
+	{ NULL,		"interference P",	"measure slowdown of each pair of stressors co-located with placement P" },
 	{ NULL,		"ionice-class C",	"specify ionice class (idle, besteffort, realtime)" },
 	{ NULL,		"ionice-level L",	"specify ionice level (0 max, 7 min)" },
+	{ NULL,		"irq-dev D",		"IRQ device name patterns for --irq-placement, e.g. nvme,eth0" },
+	{ NULL,		"irq-placement P",	"place network and I/O stressors near or far from their device IRQ CPUs" },
 	{ "j",		"job jobfile",		"run the named jobfile" },
 	{ "k",		"keep-name",		"keep stress worker names to be 'stress-ng'" },
 	{ NULL,		"keep-files",		"do not remove files or directories" },
 	{ NULL,		"klog-check",		"check kernel message log for errors" },
+	{ NULL,		"latency-hist",		"collect per-operation latency histograms" },
+	{ NULL,		"log-async",		"queue log messages on per-process rings" },
 	{ NULL,		"log-brief",		"less verbose log messages" },
 	{ NULL,		"log-file filename",	"log messages to a log file" },
 	{ NULL,		"maximize",		"enable maximum stress options" },
@@ -1238,9 +1628,15 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"mbind",		"set NUMA memory binding to specific nodes" },
 	{ "M",		"metrics",		"print pseudo metrics of activity" },
 	{ NULL,		"metrics-brief",	"enable metrics and only show non-zero results" },
+	{ NULL,		"metrics-instances",	"enable metrics and show per instance rates and spread" },
+	{ NULL,		"metrics-stream file",	"stream periodic metrics to a file or unix:socket" },
+	{ NULL,		"metrics-stream-format F","set streamed metrics format, json or csv" },
+	{ NULL,		"metrics-stream-ms N",	"stream metrics every N milliseconds" },
 	{ NULL,		"minimize",		"enable minimal stress options" },
+	{ NULL,		"mitigations",		"report CPU mitigations and kernel entry/exit costs" },
 	{ NULL,		"no-madvise",		"don't use random madvise options for each mmap" },
 	{ NULL,		"no-rand-seed",		"seed random numbers with the same constant" },
+	{ NULL,		"offcpu",		"report on-CPU, runqueue, I/O and sleep time of stressors" },
 	{ NULL,		"oomable",		"Do not respawn a stressor if it gets OOM'd" },
 	{ NULL,		"oom-avoid",		"Try to avoid stressors from being OOM'" },
 	{ NULL,		"page-in",		"touch allocated pages that are not in core" },
@@ -1249,27 +1645,53 @@ static const stress_help_t help_generic[] = {
 #if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H)
 	{ NULL,		"perf",			"display perf statistics" },
+	{ NULL,		"perf-events E",	"select perf events E, e.g. cycles,instructions,LLC-load-misses" },
+	{ NULL,		"perf-sample",		"sample cycles and report the hot functions of each stressor" },
+	{ NULL,		"perf-sample-top N",	"report the top N hot functions of each stressor" },
+	{ NULL,		"perf-topdown",		"display top-down frontend/backend bound analysis" },
 #endif
+	{ NULL,		"placement P",		"set instance CPU/NUMA placement, P = compact, spread or node-local" },
+	{ NULL,		"power",		"report energy, ops per joule, effective GHz and C-state residency" },
+	{ NULL,		"prefork",		"pre-fork stressor processes ahead of time in --seq mode" },
 	{ "q",		"quiet",		"quiet output" },
 	{ "r",		"random N",		"start N random workers" },
+	{ NULL,		"rate [S:]R,..",	"pace stressors S (default all) at R bogo ops/s" },
+	{ NULL,		"repeat N",		"repeat the run N times and report run to run variation" },
+	{ NULL,		"reproduce F",		"rerun the recorded command line, seeds, CPUs and settings of YAML file F" },
+	{ NULL,		"resctrl",		"report per stressor memory bandwidth and LLC occupancy (Linux only)" },
+	{ NULL,		"resctrl-cat [S/]C",	"apply resctrl schemata C to stressor S (default all)" },
+	{ NULL,		"resctrl-sweep A[@V],..","run once per aggressor A and victim V resctrl schemata" },
+	{ NULL,		"resctrl-victim S",	"stressor S is the victim of the --resctrl-sweep aggressors" },
+	{ NULL,		"results-bin filename",	"output results to a binary columnar file" },
+	{ NULL,		"scaling",		"measure throughput running 1, 2, 4 .. N instances of each stressor" },
 	{ NULL,		"sched type",		"set scheduler type" },
 	{ NULL,		"sched-prio N",		"set scheduler priority level N" },
 	{ NULL,		"sched-period N",	"set period for SCHED_DEADLINE to N nanosecs (Linux only)" },
 	{ NULL,		"sched-runtime N",	"set runtime for SCHED_DEADLINE to N nanosecs (Linux only)" },
 	{ NULL,		"sched-deadline N",	"set deadline for SCHED_DEADLINE to N nanosecs (Linux only)" },
 	{ NULL,		"sched-reclaim",        "set reclaim cpu bandwidth for deadline scheduler (Linux only)" },
+	{ NULL,		"schedstat",		"report scheduler wait, timeslice and migration stats of stressors" },
+	{ NULL,		"score file",		"score throughput per class against a baseline YAML file" },
+	{ NULL,		"search M",		"search for the maximum sustainable M=instances or M=rate" },
+	{ NULL,		"search-ghz-drop P",	"search fails if cpu frequency drops by more than P percent" },
+	{ NULL,		"search-max N",		"largest number of instances or bogo ops/sec rate to search" },
+	{ NULL,		"search-p99 N",		"search fails if p99 latency is more than N microseconds" },
+	{ NULL,		"search-temp C",	"search fails if a thermal zone is hotter than C Celsius" },
 	{ NULL,		"seed N",		"set the random number generator seed with a 64 bit value" },
 	{ NULL,		"sequential N",		"run all stressors one by one, invoking N of them" },
 	{ NULL,		"skip-silent",		"silently skip unimplemented stressors" },
 	{ NULL,		"stressors",		"show available stress tests" },
 	{ NULL,		"smart",		"show changes in S.M.A.R.T. data" },
+	{ NULL,		"smt-interference",	"measure slowdown of stressors paired with each other on SMT siblings" },
 	{ NULL,		"sn",			"use scientific notation for metrics" },
+	{ NULL,		"sync-start",		"start all stressor instances at the same time" },
 #if defined(HAVE_SYSLOG_H)
 	{ NULL,		"syslog",		"log messages to the syslog" },
 #endif
 	{ NULL,		"taskset",		"use specific CPUs (set CPU affinity)" },
 	{ NULL,		"temp-path path",	"specify path for temporary directories and files" },
 	{ NULL,		"thrash",		"force all pages in causing swap thrashing" },
+	{ NULL,		"throttle",		"detect thermal and power limit throttling and its throughput cost" },
 	{ "t N",	"timeout T",		"timeout after T seconds" },
 	{ NULL,		"timer-slack",		"enable timer slack mode" },
 	{ NULL,		"times",		"show run time summary at end of the run" },
@@ -1281,6 +1703,7 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"verify",		"verify results (not available on all tests)" },
 	{ NULL,		"verifiable",		"show stressors that enable verification via --verify" },
 	{ "V",		"version",		"show version" },
+	{ NULL,		"warmup N",		"exclude the first N seconds of the run from the metrics" },
 	{ "Y",		"yaml file",		"output results to YAML formatted file" },
 	{ "x",		"exclude",		"list of stressors to exclude (not run)" },
 	{ NULL,		NULL,			NULL }
@@ -1337,6 +1760,47 @@ static void stress_remove_stressor(stress_stressor_t *ss)
 	free(ss);
 }
 
+/*
+ *  stress_phase_merge()
+ *	each stressor line in a job file phase adds another stressor,
+ *	keep just the first of the stressors named in the phases as
+ *	it is run with the instances given in each phase
+ */
+static void stress_phase_merge(void)
+{
+	stress_stressor_t *ss;
+
+	for (ss = stressors_head; ss; ss = ss->next) {
+		stress_stressor_t *dup, *next;
+
+		if (!stress_phase_named(ss->stressor))
+			continue;
+		for (dup = ss->next; dup; dup = next) {
+			next = dup->next;
+			if (dup->stressor != ss->stressor)
+				continue;
+			if (dup->bogo_ops)
+				ss->bogo_ops = dup->bogo_ops;
+			stress_remove_stressor(dup);
+		}
+	}
+}
+
+/*
+ *  stress_get_class_name()
+ *	find the name of a single class bit, NULL if it has no name
+ */
+const char *stress_get_class_name(const stress_class_t class)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(classes); i++) {
+		if (classes[i].class == class)
+			return classes[i].name;
+	}
+	return NULL;
+}
+
 /*
  *  stress_get_class_id()
  *	find the class id of a given class name
@@ -1432,6 +1896,62 @@ static int stress_exclude(void)
 	return 0;
 }
 
+/*
+ *  stress_setup_rate()
+ *	parse --rate list of [stressor:]rate pacing rates, a rate
+ *	without a stressor name applies to all the stressors
+ */
+static int stress_setup_rate(void)
+{
+	char *str, *token, *opt_rate, *rates;
+	int ret = 0;
+
+	if (!stress_get_setting("rate", &opt_rate))
+		return 0;
+	rates = strdup(opt_rate);
+	if (!rates) {
+		(void)fprintf(stderr, "Out of memory parsing rate option\n");
+		return -1;
+	}
+
+	for (str = rates; (token = strtok(str, ",")) != NULL; str = NULL) {
+		char *colon = strchr(token, ':');
+		const char *value = colon ? colon + 1 : token;
+		stress_stressor_t *ss;
+		unsigned int id = 0;
+		char *end;
+		double ops_rate;
+
+		if (colon) {
+			size_t i;
+
+			*colon = '\0';
+			i = stressor_name_find(token);
+			if (!stressors[i].name) {
+				(void)fprintf(stderr, "Unknown stressor: '%s', "
+					"invalid rate option\n", token);
+				ret = -1;
+				break;
+			}
+			id = stressors[i].id;
+		}
+		errno = 0;
+		ops_rate = strtod(value, &end);
+		if ((errno != 0) || (end == value) || (*end != '\0') || (ops_rate <= 0.0)) {
+			(void)fprintf(stderr, "Invalid rate '%s', rate must be "
+				"greater than 0 bogo ops per second\n", value);
+			ret = -1;
+			break;
+		}
+		for (ss = stressors_head; ss; ss = ss->next) {
+			if (!colon || (ss->stressor->id == id))
+				ss->ops_rate = ops_rate;
+		}
+	}
+	free(rates);
+	return ret;
+}
+
 /*
  *  stress_sigint_handler()
  *	catch signals and set flag to break out of stress loops
@@ -1673,18 +2193,76 @@ static const char *stress_opt_name(const int opt_val)
 	return "<unknown>";
 }
 
+/*
+ *  stress_get_processors_usable()
+ *	limit a CPU count to the CPUs the process can actually
+ *	use, namely the cgroup v2 cpu.max quota, the cgroup
+ *	cpuset and the sched affinity mask, this stops 0 instances
+ *	from oversubscribing a container and getting throttled
+ */
+static int32_t stress_get_processors_usable(const int32_t cpus)
+{
+	static bool reported = false;
+	int32_t usable = cpus, cpuset_cpus;
+	double quota_cpus;
+	const char *limit = NULL;
+
+#if defined(HAVE_SCHED_GETAFFINITY)
+	{
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			const int32_t affinity_cpus = (int32_t)CPU_COUNT(&set);
+
+			if ((affinity_cpus > 0) && (affinity_cpus < usable)) {
+				usable = affinity_cpus;
+				limit = "sched affinity";
+			}
+		}
+	}
+#endif
+	if ((stress_cgroup_cpuset_cpus(&cpuset_cpus) == 0) &&
+	    (cpuset_cpus < usable)) {
+		usable = cpuset_cpus;
+		limit = "cgroup cpuset.cpus.effective";
+	}
+	if (stress_cgroup_cpu_quota(&quota_cpus) == 0) {
+		int32_t quota = (int32_t)ceil(quota_cpus);
+
+		if (quota < 1)
+			quota = 1;
+		if (quota < usable) {
+			usable = quota;
+			limit = "cgroup cpu.max quota";
+		}
+	}
+	if (!reported) {
+		if (limit)
+			pr_inf("using %" PRId32 " of %" PRId32 " CPUs for 0 or "
+				"negative instances, limited by %s\n",
+				usable, cpus, limit);
+		else
+			pr_dbg("using %" PRId32 " CPUs for 0 or negative "
+				"instances\n", usable);
+		reported = true;
+	}
+	return usable;
+}
+
 /*
  *  stress_get_processors()
  *	get number of processors, set count if <=0 as:
  *		count = 0 -> number of CPUs in system
  *		count < 0 -> number of CPUs online
+ *	both are limited to the CPUs usable by the process
  */
 static void stress_get_processors(int32_t *count)
 {
 	if (*count == 0)
-		*count = stress_get_processors_configured();
+		*count = stress_get_processors_usable(stress_get_processors_configured());
 	else if (*count < 0)
-		*count = stress_get_processors_online();
+		*count = stress_get_processors_usable(stress_get_processors_online());
 }
 
 /*
@@ -1721,7 +2299,10 @@ static void stress_kill_stressors(const int sig)
 			const pid_t pid = stats->pid;
 
 			if (pid && !stats->signalled) {
-				(void)kill(pid, signum);
+				/* pidfd signals can't hit a recycled pid */
+				if ((stats->pidfd < 0) ||
+				    (shim_pidfd_send_signal(stats->pidfd, signum, NULL, 0) < 0))
+					(void)kill(pid, signum);
 				stats->signalled = true;
 			}
 		}
@@ -1748,6 +2329,7 @@ static const char *stress_exit_status_to_string(const int status)
 		{ EXIT_SIGNALED,		"killed by signal" },
 		{ EXIT_BY_SYS_EXIT,		"stressor terminated using _exit()" },
 		{ EXIT_METRICS_UNTRUSTWORTHY,	"metrics may be untrustworthy" },
+		{ EXIT_THROUGHPUT_ANOMALY,	"throughput anomaly" },
 	};
 	size_t i;
 
@@ -1918,6 +2500,28 @@ static void stress_clean_dir(
 
 #if defined(HAVE_SCHED_GETAFFINITY) &&	\
     NEED_GLIBC(2,3,0)
+/*
+ *  stress_wait_aggressive_move()
+ *	move a stressor to a random cpu in proc_mask,
+ *	returns false if the affinity cannot be changed
+ */
+static bool stress_wait_aggressive_move(
+	const pid_t pid,
+	const cpu_set_t *proc_mask,
+	const int32_t cpus)
+{
+	cpu_set_t mask;
+	int32_t cpu_num;
+
+	do {
+		cpu_num = (int32_t)stress_mwc32modn(cpus);
+	} while (!(CPU_ISSET(cpu_num, proc_mask)));
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu_num, &mask);
+	return sched_setaffinity(pid, sizeof(mask), &mask) == 0;
+}
+
 /*
  *  stress_wait_aggressive()
  *	while waiting for stressors to complete add some aggressive
@@ -1954,8 +2558,6 @@ static void stress_wait_aggressive(stress_stressor_t *stressors_list)
 				const pid_t pid = stats->pid;
 
 				if (pid) {
-					cpu_set_t mask;
-					int32_t cpu_num;
 					int status, ret;
 
 					ret = waitpid(pid, &status, WNOHANG);
@@ -1963,13 +2565,7 @@ static void stress_wait_aggressive(stress_stressor_t *stressors_list)
 						continue;
 					procs_alive = true;
 
-					do {
-						cpu_num = (int32_t)stress_mwc32modn(cpus);
-					} while (!(CPU_ISSET(cpu_num, &proc_mask)));
-
-					CPU_ZERO(&mask);
-					CPU_SET(cpu_num, &mask);
-					if (sched_setaffinity(pid, sizeof(mask), &mask) < 0)
+					if (!stress_wait_aggressive_move(pid, &proc_mask, cpus))
 						return;
 				}
 			}
@@ -2003,6 +2599,11 @@ redo:
 		if (WIFSIGNALED(status)) {
 #if defined(WTERMSIG)
 			const int wterm_signal = WTERMSIG(status);
+#endif
+			/* killed before it could record its finish time */
+			if (stats->finish <= stats->start)
+				stats->finish = stress_time_now();
+#if defined(WTERMSIG)
 
 			if (wterm_signal != SIGALRM) {
 #if NEED_GLIBC(2,1,0)
@@ -2096,6 +2697,170 @@ redo:
 	}
 }
 
+/*
+ *  stress_wait_instance()
+ *	wait for instance j of a stressor and clean up after it
+ */
+static void stress_wait_instance(
+	stress_stressor_t *ss,
+	const int32_t j,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	stress_stats_t *const stats = ss->stats[j];
+	const pid_t pid = stats->pid;
+	const char *stressor_name = stress_munge_underscore(ss->stressor->name);
+
+	stress_wait_pid(pid, stressor_name, stats, success, resource_success, metrics_success);
+	if (stats->pidfd >= 0) {
+		(void)close(stats->pidfd);
+		stats->pidfd = -1;
+	}
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	stress_perf_sample_close(ss, j);
+#endif
+	stress_clean_dir(stressor_name, pid, (uint32_t)j);
+}
+
+#if defined(HAVE_SYS_EPOLL_H) &&	\
+    defined(HAVE_EPOLL_CREATE1) &&	\
+    defined(EPOLL_CLOEXEC)
+typedef struct {
+	stress_stressor_t *ss;		/* stressor */
+	int32_t instance;		/* instance of stressor */
+} stress_wait_epoll_t;
+
+/*
+ *  stress_wait_epoll()
+ *	wait on the pidfds of the stressors with epoll and reap
+ *	them in the order they exit rather than in instance order,
+ *	any stressors that can't be waited on with a pidfd are
+ *	left for the caller
+ */
+static void stress_wait_epoll(
+	stress_stressor_t *stressors_list,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	stress_wait_epoll_t *waits;
+	stress_stressor_t *ss;
+	struct epoll_event events[64];
+	size_t n, waiting = 0;
+	int epfd, timeout = -1;
+#if defined(HAVE_SCHED_GETAFFINITY) &&	\
+    NEED_GLIBC(2,3,0)
+	bool aggressive = !!(g_opt_flags & OPT_FLAGS_AGGRESSIVE);
+	const int32_t ticks_per_sec = stress_get_ticks_per_second() * 5;
+
+	/* move the stressors around every 1/5th of a clock tick */
+	if (aggressive)
+		timeout = ticks_per_sec ? STRESS_MAXIMUM(1, 1000 / ticks_per_sec) : 1000 / 250;
+#endif
+
+	for (n = 0, ss = stressors_list; ss; ss = ss->next)
+		n += (size_t)ss->started_instances;
+	if (!n)
+		return;
+	waits = calloc(n, sizeof(*waits));
+	if (!waits)
+		return;
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		free(waits);
+		return;
+	}
+
+	/*
+	 *  pidfds are opened once all the stressors have been forked so
+	 *  that they are not inherited by the stressors, the stressors
+	 *  are not reaped until now so the pids cannot be recycled
+	 */
+	for (n = 0, ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			stress_stats_t *const stats = ss->stats[j];
+			struct epoll_event ev;
+
+			if (!stats->pid)
+				continue;
+			stats->pidfd = shim_pidfd_open(stats->pid, 0);
+			if (stats->pidfd < 0)
+				continue;
+			(void)memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.u64 = (uint64_t)n;
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, stats->pidfd, &ev) < 0) {
+				(void)close(stats->pidfd);
+				stats->pidfd = -1;
+				continue;
+			}
+			waits[n].ss = ss;
+			waits[n].instance = j;
+			n++;
+			waiting++;
+		}
+	}
+
+	while (waiting > 0) {
+		int i, ret;
+
+		ret = epoll_wait(epfd, events, (int)SIZEOF_ARRAY(events), timeout);
+		if (ret < 0) {
+			/* Somebody interrupted the wait */
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (i = 0; i < ret; i++) {
+			const stress_wait_epoll_t *w = &waits[events[i].data.u64];
+
+			/* closing the pidfd removes it from the epoll set */
+			stress_wait_instance(w->ss, w->instance,
+				success, resource_success, metrics_success);
+			waiting--;
+		}
+#if defined(HAVE_SCHED_GETAFFINITY) &&	\
+    NEED_GLIBC(2,3,0)
+		/*
+		 *  In aggressive mode keep on moving the running
+		 *  stressors between processors, the exited ones
+		 *  have already been reaped so no need to poll them
+		 */
+		if (aggressive && wait_flag) {
+			const int32_t cpus = stress_get_processors_configured();
+			cpu_set_t proc_mask;
+
+			if ((sched_getaffinity(0, sizeof(proc_mask), &proc_mask) < 0) ||
+			    !CPU_COUNT(&proc_mask)) {
+				aggressive = false;
+				timeout = -1;
+				continue;
+			}
+			for (ss = stressors_list; ss && aggressive; ss = ss->next) {
+				int32_t j;
+
+				for (j = 0; j < ss->started_instances; j++) {
+					const pid_t pid = ss->stats[j]->pid;
+
+					if (pid && !stress_wait_aggressive_move(pid, &proc_mask, cpus)) {
+						aggressive = false;
+						timeout = -1;
+						break;
+					}
+				}
+			}
+		}
+#endif
+	}
+	(void)close(epfd);
+	free(waits);
+}
+#endif
+
 /*
  *  stress_wait_stressors()
  * 	wait for stressor child processes
@@ -2108,6 +2873,16 @@ static void stress_wait_stressors(
 {
 	stress_stressor_t *ss;
 
+#if defined(HAVE_SYS_EPOLL_H) &&	\
+    defined(HAVE_EPOLL_CREATE1) &&	\
+    defined(EPOLL_CLOEXEC)
+	/*
+	 *  Reap stressors in exit order using their pidfds,
+	 *  this also handles the --aggressive CPU affinity
+	 *  changes
+	 */
+	stress_wait_epoll(stressors_list, success, resource_success, metrics_success);
+#endif
 #if defined(HAVE_SCHED_GETAFFINITY) &&	\
     NEED_GLIBC(2,3,0)
 	/*
@@ -2119,19 +2894,13 @@ static void stress_wait_stressors(
 	if (g_opt_flags & OPT_FLAGS_AGGRESSIVE)
 		stress_wait_aggressive(stressors_list);
 #endif
+	/* Wait for any stressors that could not be waited for on a pidfd */
 	for (ss = stressors_list; ss; ss = ss->next) {
 		int32_t j;
 
 		for (j = 0; j < ss->started_instances; j++) {
-			stress_stats_t *const stats = ss->stats[j];
-			const pid_t pid = stats->pid;
-
-			if (pid) {
-				const char *stressor_name = stress_munge_underscore(ss->stressor->name);
-
-				stress_wait_pid(pid, stressor_name, stats, success, resource_success, metrics_success);
-				stress_clean_dir(stressor_name, pid, (uint32_t)j);
-			}
+			if (ss->stats[j]->pid)
+				stress_wait_instance(ss, j, success, resource_success, metrics_success);
 		}
 	}
 	if (g_opt_flags & OPT_FLAGS_IGNITE_CPU)
@@ -2282,6 +3051,46 @@ void stress_metrics_set_const_check(
 		metrics[idx].value = value;
 }
 
+/*
+ *  stress_bogo_rate_real_time()
+ *	real time bogo-ops/s of a stressor as reported by the
+ *	bogo-ops-per-second-real-time metric, this is computed over
+ *	the --warmup/--cooldown window if one was measured. The
+ *	average wall clock run time of the instances is returned
+ *	in r_time
+ */
+double stress_bogo_rate_real_time(const stress_stressor_t *ss, double *r_time)
+{
+	uint64_t c_total = 0, c_window = 0;
+	double r_total = 0.0, r_window = 0.0;
+	int32_t j, n_window = 0;
+
+	*r_time = 0.0;
+	if (!ss->stats || !ss->started_instances)
+		return 0.0;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		c_total += stats->ci.counter;
+		r_total += stats->finish - stats->start;
+		if (stats->window.end > stats->window.begin) {
+			c_window += stats->window.counter_end - stats->window.counter_begin;
+			r_window += stats->window.end - stats->window.begin;
+			n_window++;
+		}
+	}
+	r_total /= (double)ss->started_instances;
+	*r_time = r_total;
+
+	if (n_window) {
+		r_window /= (double)n_window;
+		if (r_window > 0.0)
+			return (double)c_window / r_window;
+	}
+	return (r_total > 0.0) ? (double)c_total / r_total : 0.0;
+}
+
 #if defined(HAVE_GETRUSAGE)
 /*
  *  stress_getrusage()
@@ -2305,229 +3114,632 @@ static void stress_getrusage(const int who, stress_stats_t *stats)
 #endif
 
 /*
- *  stress_run()
- *	kick off and run stressors
+ *  stress_run_child_init()
+ *	stressor independent child process initialization
  */
-static void MLOCKED_TEXT stress_run(
-	stress_stressor_t *stressors_list,
-	double *duration,
-	bool *success,
-	bool *resource_success,
-	bool *metrics_success,
-	stress_checksum_t **checksum)
+static int MLOCKED_TEXT stress_run_child_init(
+	const char *name,
+	const int32_t ionice_class,
+	const int32_t ionice_level)
 {
-	double time_start, time_finish;
-	int32_t started_instances = 0;
-	const size_t page_size = stress_get_page_size();
-	int64_t backoff = DEFAULT_BACKOFF;
-	int32_t ionice_class = UNDEFINED;
-	int32_t ionice_level = UNDEFINED;
+	(void)sched_settings_apply(true);
+	(void)atexit(stress_child_atexit);
+	if (stress_set_handler(name, true) < 0)
+		return -1;
+	stress_parent_died_alarm();
+	stress_process_dumpable(false);
+	stress_set_timer_slack();
+	stress_mwc_reseed();
+	stress_set_oom_adjustment(name, false);
+	stress_set_max_limits();
+	stress_set_iopriority(ionice_class, ionice_level);
+	(void)umask(0077);
 
-	wait_flag = true;
-	time_start = stress_time_now();
-	pr_dbg("starting stressors\n");
+	return 0;
+}
 
-	(void)stress_get_setting("backoff", &backoff);
-	(void)stress_get_setting("ionice-class", &ionice_class);
-	(void)stress_get_setting("ionice-level", &ionice_level);
+/*
+ *  stress_start_barrier_wait()
+ *	with --sync-start, wait until the parent has started all
+ *	the instances of the stressors so that they all begin the
+ *	measured phase at the same time
+ */
+static void stress_start_barrier_wait(void)
+{
+	uint32_t *released = &g_shared->start_barrier.released;
 
-	/*
-	 *  Work through the list of stressors to run
-	 */
-	for (g_stressor_current = stressors_list; g_stressor_current; g_stressor_current = g_stressor_current->next) {
-		int32_t j;
+	if (!(g_opt_flags & OPT_FLAGS_SYNC_START))
+		return;
 
-		/*
-		 *  Each stressor has 1 or more instances to run
-		 */
-		for (j = 0; j < g_stressor_current->num_instances; j++, (*checksum)++) {
-			int rc = EXIT_SUCCESS;
-			size_t i;
-			pid_t pid, child_pid;
-			char name[64], *munged;
-			stress_stats_t *const stats = g_stressor_current->stats[j];
-			double run_duration, fork_time_start;
-			bool ok;
+	while (!*(volatile uint32_t *)released && keep_stressing_flag()) {
+		struct timespec timeout;
 
-			if (g_opt_timeout && (stress_time_now() - time_start > (double)g_opt_timeout))
-				goto abort;
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = 100000000;
+		if ((shim_futex_wait(released, 0, &timeout) < 0) &&
+		    (errno != EAGAIN) && (errno != EINTR) && (errno != ETIMEDOUT))
+			(void)shim_usleep(10000);	/* no futex, poll instead */
+	}
+}
 
-			stats->ci.counter_ready = true;
-			stats->ci.counter = 0;
-			stats->checksum = *checksum;
-			for (i = 0; i < SIZEOF_ARRAY(stats->metrics); i++) {
-				stats->metrics[i].value = -1.0;
-				stats->metrics[i].description = NULL;
-			}
-again:
-			if (!keep_stressing_flag())
-				break;
-			fork_time_start = stress_time_now();
-			pid = fork();
-			switch (pid) {
-			case -1:
-				if (errno == EAGAIN) {
-					(void)shim_usleep(100000);
-					goto again;
-				}
-				pr_err("Cannot fork: errno=%d (%s)\n",
-					errno, strerror(errno));
-				stress_kill_stressors(SIGALRM);
-				goto wait_for_stressors;
-			case 0:
-				/* Child */
-				child_pid = getpid();
-				munged = stress_munge_underscore(g_stressor_current->stressor->name);
+/*
+ *  stress_start_barrier_release()
+ *	release all the instances waiting on the start barrier
+ */
+static void stress_start_barrier_release(void)
+{
+	if (!(g_opt_flags & OPT_FLAGS_SYNC_START))
+		return;
 
-				shim_strlcpy(name, munged, sizeof(name));
-				stress_set_proc_state(name, STRESS_STATE_START);
+	g_shared->start_barrier.released = 1;
+	(void)shim_futex_wake(&g_shared->start_barrier.released, INT_MAX);
+}
 
-				(void)sched_settings_apply(true);
-				(void)atexit(stress_child_atexit);
-				if (stress_set_handler(name, true) < 0) {
-					rc = EXIT_FAILURE;
-					goto child_exit;
-				}
-				stress_parent_died_alarm();
-				stress_process_dumpable(false);
-				stress_set_timer_slack();
+/*
+ *  stress_window_sample()
+ *	snapshot the bogo-op counters of the running instances, instances
+ *	that have finished are frozen at their finish time
+ */
+static void stress_window_sample(stress_stressor_t *stressors_list, const bool begin)
+{
+	stress_stressor_t *ss;
+	const double now = stress_time_now();
 
-				if (g_opt_timeout)
-					(void)alarm((unsigned int)g_opt_timeout);
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
 
-				stress_set_proc_state(name, STRESS_STATE_INIT);
-				stress_mwc_reseed();
-				stress_set_oom_adjustment(name, false);
-				stress_set_max_limits();
-				stress_set_iopriority(ionice_class, ionice_level);
-				(void)umask(0077);
+		for (j = 0; j < ss->started_instances; j++) {
+			stress_stats_t *const stats = ss->stats[j];
+			const bool finished = (stats->finish > stats->start);
+
+			if (begin) {
+				if (finished)
+					continue;
+				stats->window.counter_begin = stats->ci.counter;
+				stats->window.counter_end = stats->window.counter_begin;
+				stats->window.begin = now;
+				stats->window.end = now;
+			} else if (stats->window.begin > 0.0) {
+				if (stats->window.end >= stats->finish && finished)
+					continue;
+				stats->window.counter_end = stats->ci.counter;
+				stats->window.end = finished ? stats->finish : now;
+			}
+		}
+	}
+}
 
-				pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
-					name, (int)child_pid, j);
+/*
+ *  stress_window_start()
+ *	with --warmup or --cooldown, fork a process that snapshots the
+ *	bogo-op counters once the warm-up period has elapsed and keeps
+ *	sampling them until the cool-down period starts so the metrics
+ *	can be computed over the steady state part of the run only
+ */
+static void stress_window_start(stress_stressor_t *stressors_list, const double time_start)
+{
+	uint64_t warmup = 0, cooldown = 0;
+	double t_begin, t_end;
 
-				stats->start = stats->finish = stress_time_now();
-#if defined(STRESS_PERF_STATS) &&	\
+	(void)stress_get_setting("warmup", &warmup);
+	(void)stress_get_setting("cooldown", &cooldown);
+	window_pid = -1;
+	if (!warmup && !cooldown)
+		return;
+
+	if (g_opt_timeout && (warmup + cooldown >= g_opt_timeout)) {
+		pr_inf("warm-up and cool-down times of %" PRIu64 " and %" PRIu64
+			" seconds exceed the run time, ignoring them\n",
+			warmup, cooldown);
+		return;
+	}
+	t_begin = stress_time_now() + (double)warmup;
+	t_end = g_opt_timeout ? time_start + (double)(g_opt_timeout - cooldown) : 0.0;
+	window_t_end = t_end;
+
+	window_pid = fork();
+	if (window_pid != 0)
+		return;
+
+	stress_set_proc_name("stat [window]");
+	while (keep_stressing_flag()) {
+		const double t_delta = t_begin - stress_time_now();
+
+		if (t_delta <= 0.0)
+			break;
+		(void)shim_nanosleep_uint64((uint64_t)(STRESS_MINIMUM(t_delta, 0.1) * STRESS_DBL_NANOSECOND));
+	}
+	if (!keep_stressing_flag())
+		_exit(0);
+	stress_window_sample(stressors_list, true);
+
+	while (keep_stressing_flag()) {
+		double t_delta = 0.1;
+
+		if (t_end > 0.0) {
+			t_delta = STRESS_MINIMUM(t_end - stress_time_now(), t_delta);
+			if (t_delta <= 0.0)
+				break;
+		}
+		(void)shim_nanosleep_uint64((uint64_t)(t_delta * STRESS_DBL_NANOSECOND));
+		stress_window_sample(stressors_list, false);
+	}
+	stress_window_sample(stressors_list, false);
+	_exit(0);
+}
+
+/*
+ *  stress_window_stop()
+ *	stop the measurement window sampler, if the window was still
+ *	open then freeze it at the finish times of the instances
+ */
+static void stress_window_stop(stress_stressor_t *stressors_list)
+{
+	int status;
+
+	if (window_pid <= 0)
+		return;
+
+	(void)kill(window_pid, SIGKILL);
+	(void)shim_waitpid(window_pid, &status, 0);
+	window_pid = -1;
+	if ((window_t_end <= 0.0) || (stress_time_now() < window_t_end))
+		stress_window_sample(stressors_list, false);
+}
+
+/*
+ *  stress_run_child()
+ *	run instance j of the current stressor in the child process,
+ *	if initialized is true then the stressor independent child
+ *	initialization has already been performed
+ */
+static void NORETURN MLOCKED_TEXT stress_run_child(
+	stress_checksum_t *checksum,
+	const int32_t j,
+	const int32_t started_instances,
+	const double fork_time_start,
+	const int64_t backoff,
+	const int32_t ionice_class,
+	const int32_t ionice_level,
+	const bool initialized)
+{
+	int rc = EXIT_SUCCESS;
+	const pid_t child_pid = getpid();
+	const size_t page_size = stress_get_page_size();
+	char name[64], *munged;
+	stress_stats_t *const stats = g_stressor_current->stats[j];
+	double run_duration;
+	bool ok;
+
+	munged = stress_munge_underscore(g_stressor_current->stressor->name);
+
+	shim_strlcpy(name, munged, sizeof(name));
+	stress_set_proc_state(name, STRESS_STATE_START);
+
+	if (!initialized &&
+	    (stress_run_child_init(name, ionice_class, ionice_level) < 0)) {
+		rc = EXIT_FAILURE;
+		goto child_exit;
+	}
+
+	if (g_opt_timeout)
+		(void)alarm((unsigned int)g_opt_timeout);
+
+	stress_set_proc_state(name, STRESS_STATE_INIT);
+	stress_cgroup_join(g_stressor_current, j);
+	stress_resctrl_join(g_stressor_current);
+	stress_placement_apply(name, (uint32_t)started_instances);
+	stress_hybrid_apply(name);
+	stress_irq_apply(name, g_stressor_current);
+	stress_smt_apply(name, g_stressor_current, (int32_t)j);
+	stress_interference_apply(name, g_stressor_current, (int32_t)j);
+	stress_scaling_apply(name, g_stressor_current, (int32_t)j);
+	stress_reproduce_apply(name, g_stressor_current, (int32_t)j);
+
+	pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
+		name, (int)child_pid, j);
+
+	stress_start_barrier_wait();
+	stress_phase_ramp(g_stressor_current, j);
+	stats->start = stats->finish = stress_time_now();
+	stats->cpu_begin = (int32_t)stress_get_cpu();
+	stress_offcpu_begin(&stats->offcpu);
+	stress_schedstat_begin(&stats->schedstat);
+#if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS)
-					(void)stress_perf_open(&stats->sp);
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS)
+		(void)stress_perf_open(stats->sp);
 #endif
-				(void)shim_usleep((useconds_t)(backoff * started_instances));
+	(void)shim_usleep((useconds_t)(backoff * started_instances));
 #if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS)
-					(void)stress_perf_enable(&stats->sp);
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS)
+		(void)stress_perf_enable(stats->sp);
 #endif
-				if (keep_stressing_flag() && !(g_opt_flags & OPT_FLAGS_DRY_RUN)) {
-					const stress_args_t args = {
-						.ci = &stats->ci,
-						.name = name,
-						.max_ops = g_stressor_current->bogo_ops,
-						.instance = (uint32_t)j,
-						.num_instances = (uint32_t)g_stressor_current->num_instances,
-						.pid = child_pid,
-						.page_size = page_size,
-						.mapped = &g_shared->mapped,
-						.metrics = stats->metrics,
-						.info = g_stressor_current->stressor->info
-					};
-
-					(void)memset(*checksum, 0, sizeof(**checksum));
-					rc = g_stressor_current->stressor->info->stressor(&args);
-					pr_fail_check(&rc);
-
-					ok = (rc == EXIT_SUCCESS);
-					stats->ci.run_ok = ok;
-					(*checksum)->data.ci.run_ok = ok;
-					/* Ensure reserved padding is zero to not confuse checksum */
-					(void)memset((*checksum)->data.reserved, 0, sizeof((*checksum)->data.reserved));
-
-					/*
-					 *  We're done, cancel SIGALRM
-					 */
-					(void)alarm(0);
-
-					stress_set_proc_state(name, STRESS_STATE_STOP);
-					/*
-					 *  Bogo ops counter should be OK for reading,
-					 *  if not then flag up that the counter may
-					 *  be untrustyworthy
-					 */
-					if (!stats->ci.counter_ready) {
-						pr_warn("%s: WARNING: bogo-ops counter in non-ready state, "
-							"metrics are untrustworthy (process may have been "
-							"terminated prematurely)\n",
-							name);
-						rc = EXIT_METRICS_UNTRUSTWORTHY;
-					}
-					(*checksum)->data.ci.counter = args.ci->counter;
-					stress_hash_checksum(*checksum);
-				}
+	if (keep_stressing_flag() && !(g_opt_flags & OPT_FLAGS_DRY_RUN)) {
+		stress_rate_t rate;
+		const double ops_rate = g_stressor_current->num_instances > 0 ?
+			g_stressor_current->ops_rate / (double)g_stressor_current->num_instances : 0.0;
+		const stress_args_t args = {
+			.ci = &stats->ci,
+			.name = name,
+			.max_ops = g_stressor_current->bogo_ops,
+			.instance = (uint32_t)j,
+			.num_instances = (uint32_t)g_stressor_current->num_instances,
+			.pid = child_pid,
+			.page_size = page_size,
+			.mapped = &g_shared->mapped,
+			.metrics = stats->metrics,
+			.latency = stats->latency,
+			.rate = ops_rate > 0.0 ? &rate : NULL,
+			.info = g_stressor_current->stressor->info
+		};
+
+		if (args.rate)
+			stress_rate_init(&rate, ops_rate);
+
+		stress_reproduce_seed(g_stressor_current, (int32_t)j, stats);
+		(void)memset(checksum, 0, sizeof(*checksum));
+		rc = g_stressor_current->stressor->info->stressor(&args);
+		pr_fail_check(&rc);
+		stress_rate_report(&args);
+
+		ok = (rc == EXIT_SUCCESS);
+		stats->ci.run_ok = ok;
+		checksum->data.ci.run_ok = ok;
+		/* Ensure reserved padding is zero to not confuse checksum */
+		(void)memset(checksum->data.reserved, 0, sizeof(checksum->data.reserved));
+
+		/*
+		 *  We're done, cancel SIGALRM
+		 */
+		(void)alarm(0);
+
+		stress_set_proc_state(name, STRESS_STATE_STOP);
+		/*
+		 *  Bogo ops counter should be OK for reading,
+		 *  if not then flag up that the counter may
+		 *  be untrustyworthy
+		 */
+		if (!stats->ci.counter_ready) {
+			pr_warn("%s: WARNING: bogo-ops counter in non-ready state, "
+				"metrics are untrustworthy (process may have been "
+				"terminated prematurely)\n",
+				name);
+			rc = EXIT_METRICS_UNTRUSTWORTHY;
+		}
+		checksum->data.ci.counter = args.ci->counter;
+		stress_hash_checksum(checksum);
+	}
 #if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
-					(void)stress_perf_disable(&stats->sp);
-					(void)stress_perf_close(&stats->sp);
-				}
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
+		(void)stress_perf_disable(stats->sp);
+		(void)stress_perf_close(stats->sp);
+	}
 #endif
 #if defined(STRESS_THERMAL_ZONES)
-				if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES)
-					(void)stress_tz_get_temperatures(&g_shared->tz_info, &stats->tz);
+	if ((g_opt_flags & OPT_FLAGS_THERMAL_ZONES) && stats->tz)
+		(void)stress_tz_get_temperatures(&g_shared->tz_info, stats->tz);
 #endif
-				stats->finish = stress_time_now();
+	stats->finish = stress_time_now();
+	stats->cpu_end = (int32_t)stress_get_cpu();
+	stress_offcpu_end(&stats->offcpu, stats->finish - stats->start);
+	stress_schedstat_end(&stats->schedstat, stats->finish - stats->start);
 #if defined(HAVE_GETRUSAGE)
-				stats->rusage_utime = 0.0;
-				stats->rusage_stime = 0.0;
-				stress_getrusage(RUSAGE_SELF, stats);
-				stress_getrusage(RUSAGE_CHILDREN, stats);
+	stats->rusage_utime = 0.0;
+	stats->rusage_stime = 0.0;
+	stress_getrusage(RUSAGE_SELF, stats);
+	stress_getrusage(RUSAGE_CHILDREN, stats);
 #else
-				(void)memset(&stats->tms, 0, sizeof(stats->tms));
-				if (times(&stats->tms) == (clock_t)-1) {
-					pr_dbg("times failed: errno=%d (%s)\n",
-						errno, strerror(errno));
-				}
+	(void)memset(&stats->tms, 0, sizeof(stats->tms));
+	if (times(&stats->tms) == (clock_t)-1) {
+		pr_dbg("times failed: errno=%d (%s)\n",
+			errno, strerror(errno));
+	}
 #endif
-				pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
-					name, (int)child_pid, j);
-
-				/* Allow for some slops of ~0.5 secs */
-				run_duration = (stats->finish - fork_time_start) + 0.5;
-
-				/*
-				 * Apparently succeeded but terminated early?
-				 * Could be a bug, so report a warning
-				 */
-				if (stats->ci.run_ok && !g_caught_signal &&
-				    (run_duration < (double)g_opt_timeout) &&
-				    (!(g_stressor_current->bogo_ops && stats->ci.counter >= g_stressor_current->bogo_ops))) {
-
-					pr_warn("%s: WARNING: finished prematurely after just %.2fs%s\n",
-						name, run_duration, stress_duration_to_str(run_duration));
-				}
+	pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
+		name, (int)child_pid, j);
+
+	/* Allow for some slops of ~0.5 secs */
+	run_duration = (stats->finish - fork_time_start) + 0.5;
+
+	/*
+	 * Apparently succeeded but terminated early?
+	 * Could be a bug, so report a warning
+	 */
+	if (stats->ci.run_ok && !g_caught_signal &&
+	    (run_duration < (double)g_opt_timeout) &&
+	    (!(g_stressor_current->bogo_ops && stats->ci.counter >= g_stressor_current->bogo_ops))) {
+
+		pr_warn("%s: WARNING: finished prematurely after just %.2fs%s\n",
+			name, run_duration, stress_duration_to_str(run_duration));
+	}
 
 child_exit:
-				stress_stressors_free();
-				stress_cache_free();
-				stress_settings_free();
-				stress_temp_path_free();
-				(void)stress_ftrace_free();
-
-				if ((rc != 0) && (g_opt_flags & OPT_FLAGS_ABORT)) {
-					keep_stressing_set_flag(false);
-					wait_flag = false;
-					(void)kill(getppid(), SIGALRM);
+	stress_shared_heap_flush();
+	stress_stressors_free();
+	stress_cache_free();
+	stress_settings_free();
+	stress_temp_path_free();
+	(void)stress_ftrace_free();
+
+	if ((rc != 0) && (g_opt_flags & OPT_FLAGS_ABORT)) {
+		keep_stressing_set_flag(false);
+		wait_flag = false;
+		(void)kill(getppid(), SIGALRM);
+	}
+	stress_set_proc_state(name, STRESS_STATE_EXIT);
+	if (terminate_signum)
+		rc = EXIT_SIGNALED;
+	pr_lock_exited(child_pid);
+	_exit(rc);
+}
+
+/*
+ *  Pre-forked worker pool, workers are forked and initialized
+ *  ahead of time and then wait for a command to run a specific
+ *  stressor instance. Each worker runs just one stressor instance
+ *  and then exits, so stressors always start in a clean process.
+ */
+typedef struct {
+	stress_stressor_t *ss;		/* stressor to run, NULL = exit */
+	stress_checksum_t *checksum;	/* checksum of the instance */
+	int32_t instance;		/* stressor instance # */
+	int32_t started_instances;	/* number of instances already started */
+	double fork_time_start;		/* time the instance was requested */
+} stress_prefork_cmd_t;
+
+typedef struct {
+	pid_t pid;			/* idle worker pid */
+	int fd;				/* command pipe write end */
+} stress_prefork_worker_t;
+
+static stress_prefork_worker_t *prefork_workers;/* idle workers */
+static size_t prefork_workers_max;		/* size of the pool */
+static size_t prefork_workers_num;		/* number of idle workers */
+
+/*
+ *  stress_prefork_worker()
+ *	initialize a worker and wait for a command
+ */
+static void NORETURN MLOCKED_TEXT stress_prefork_worker(
+	const int fd,
+	const int64_t backoff,
+	const int32_t ionice_class,
+	const int32_t ionice_level)
+{
+	stress_prefork_cmd_t cmd;
+	ssize_t ret;
+	size_t i;
+
+	/* Close the command pipes of the other idle workers */
+	for (i = 0; i < prefork_workers_num; i++)
+		(void)close(prefork_workers[i].fd);
+
+	stress_set_proc_name("prefork [idle]");
+	if (stress_run_child_init("prefork", ionice_class, ionice_level) < 0)
+		_exit(EXIT_FAILURE);
+
+	do {
+		ret = read(fd, &cmd, sizeof(cmd));
+	} while ((ret < 0) && (errno == EINTR) && keep_stressing_flag());
+	(void)close(fd);
+
+	if ((ret != (ssize_t)sizeof(cmd)) || (!cmd.ss))
+		_exit(EXIT_SUCCESS);
+
+	g_stressor_current = cmd.ss;
+	stress_run_child(cmd.checksum, cmd.instance, cmd.started_instances,
+		cmd.fork_time_start, backoff, ionice_class, ionice_level, true);
+}
+
+/*
+ *  stress_prefork_fill()
+ *	top up the pool with idle workers
+ */
+static void stress_prefork_fill(
+	const int64_t backoff,
+	const int32_t ionice_class,
+	const int32_t ionice_level)
+{
+	while (keep_stressing_flag() && (prefork_workers_num < prefork_workers_max)) {
+		int fds[2];
+		pid_t pid;
+
+		if (pipe(fds) < 0) {
+			pr_dbg("prefork: pipe failed, errno=%d (%s)\n",
+				errno, strerror(errno));
+			return;
+		}
+		pid = fork();
+		if (pid < 0) {
+			pr_dbg("prefork: fork failed, errno=%d (%s)\n",
+				errno, strerror(errno));
+			(void)close(fds[0]);
+			(void)close(fds[1]);
+			return;
+		} else if (pid == 0) {
+			(void)close(fds[1]);
+			stress_prefork_worker(fds[0], backoff, ionice_class, ionice_level);
+		}
+		(void)close(fds[0]);
+		prefork_workers[prefork_workers_num].pid = pid;
+		prefork_workers[prefork_workers_num].fd = fds[1];
+		prefork_workers_num++;
+	}
+}
+
+/*
+ *  stress_prefork_dispatch()
+ *	hand a stressor instance to an idle worker, returns the pid
+ *	of the worker or -1 if there are no workers available
+ */
+static pid_t stress_prefork_dispatch(
+	stress_checksum_t *checksum,
+	const int32_t j,
+	const int32_t started_instances,
+	const double fork_time_start)
+{
+	stress_prefork_worker_t *worker;
+	stress_prefork_cmd_t cmd;
+	ssize_t ret;
+
+	if (!prefork_workers_num)
+		return -1;
+
+	(void)memset(&cmd, 0, sizeof(cmd));
+	cmd.ss = g_stressor_current;
+	cmd.checksum = checksum;
+	cmd.instance = j;
+	cmd.started_instances = started_instances;
+	cmd.fork_time_start = fork_time_start;
+
+	worker = &prefork_workers[--prefork_workers_num];
+	ret = write(worker->fd, &cmd, sizeof(cmd));
+	(void)close(worker->fd);
+	if (ret != (ssize_t)sizeof(cmd)) {
+		int status;
+
+		/* worker has gone away, reap it and fall back to a fork */
+		(void)kill(worker->pid, SIGKILL);
+		(void)shim_waitpid(worker->pid, &status, 0);
+		return -1;
+	}
+	return worker->pid;
+}
+
+/*
+ *  stress_prefork_init()
+ *	allocate worker pool for up to max_instances workers
+ */
+static void stress_prefork_init(const int32_t max_instances)
+{
+	if (!(g_opt_flags & OPT_FLAGS_PREFORK) || (max_instances < 1))
+		return;
+
+	prefork_workers = calloc((size_t)max_instances, sizeof(*prefork_workers));
+	if (!prefork_workers) {
+		pr_inf("prefork: cannot allocate worker pool, disabling --prefork\n");
+		return;
+	}
+	prefork_workers_max = (size_t)max_instances;
+	prefork_workers_num = 0;
+}
+
+/*
+ *  stress_prefork_free()
+ *	tell idle workers to exit and free the pool
+ */
+static void stress_prefork_free(void)
+{
+	while (prefork_workers_num > 0) {
+		stress_prefork_worker_t *worker = &prefork_workers[--prefork_workers_num];
+		stress_prefork_cmd_t cmd;
+		int status;
+
+		(void)memset(&cmd, 0, sizeof(cmd));
+		if (write(worker->fd, &cmd, sizeof(cmd)) != (ssize_t)sizeof(cmd))
+			(void)kill(worker->pid, SIGKILL);
+		(void)close(worker->fd);
+		(void)shim_waitpid(worker->pid, &status, 0);
+	}
+	free(prefork_workers);
+	prefork_workers = NULL;
+	prefork_workers_max = 0;
+}
+
+/*
+ *  stress_run()
+ *	kick off and run stressors
+ */
+static void MLOCKED_TEXT stress_run(
+	stress_stressor_t *stressors_list,
+	double *duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success,
+	stress_checksum_t **checksum)
+{
+	double time_start, time_finish;
+	int32_t started_instances = 0;
+	int64_t backoff = DEFAULT_BACKOFF;
+	int32_t ionice_class = UNDEFINED;
+	int32_t ionice_level = UNDEFINED;
+
+	wait_flag = true;
+	time_start = stress_time_now();
+	pr_dbg("starting stressors\n");
+
+	(void)stress_get_setting("backoff", &backoff);
+	(void)stress_get_setting("ionice-class", &ionice_class);
+	(void)stress_get_setting("ionice-level", &ionice_level);
+	g_shared->start_barrier.released = 0;
+
+	/* Instances are counted afresh on each --repeat run */
+	for (g_stressor_current = stressors_list; g_stressor_current; g_stressor_current = g_stressor_current->next)
+		g_stressor_current->started_instances = 0;
+
+	/*
+	 *  Work through the list of stressors to run
+	 */
+	for (g_stressor_current = stressors_list; g_stressor_current; g_stressor_current = g_stressor_current->next) {
+		int32_t j;
+
+		/*
+		 *  Each stressor has 1 or more instances to run
+		 */
+		for (j = 0; j < g_stressor_current->num_instances; j++, (*checksum)++) {
+			size_t i;
+			pid_t pid;
+			stress_stats_t *const stats = g_stressor_current->stats[j];
+			double fork_time_start;
+
+			if (g_opt_timeout && (stress_time_now() - time_start > (double)g_opt_timeout))
+				goto abort;
+
+			stats->ci.counter_ready = true;
+			stats->ci.counter = 0;
+			stats->checksum = *checksum;
+			for (i = 0; i < SIZEOF_ARRAY(stats->metrics); i++) {
+				stats->metrics[i].value = -1.0;
+				stats->metrics[i].description = NULL;
+			}
+			stress_latency_reset(stats->latency);
+			(void)memset(&stats->window, 0, sizeof(stats->window));
+again:
+			if (!keep_stressing_flag())
+				break;
+			fork_time_start = stress_time_now();
+			pid = stress_prefork_dispatch(*checksum, j, started_instances, fork_time_start);
+			if (pid < 0)
+				pid = fork();
+			switch (pid) {
+			case -1:
+				if (errno == EAGAIN) {
+					(void)shim_usleep(100000);
+					goto again;
 				}
-				stress_set_proc_state(name, STRESS_STATE_EXIT);
-				if (terminate_signum)
-					rc = EXIT_SIGNALED;
-				pr_lock_exited(child_pid);
-				_exit(rc);
+				pr_err("Cannot fork: errno=%d (%s)\n",
+					errno, strerror(errno));
+				stress_kill_stressors(SIGALRM);
+				goto wait_for_stressors;
+			case 0:
+				/* Child */
+				stress_run_child(*checksum, j, started_instances, fork_time_start,
+					backoff, ionice_class, ionice_level, false);
 			default:
 				if (pid > -1) {
 					stats->pid = pid;
+					stats->pidfd = -1;
 					stats->signalled = false;
 					g_stressor_current->started_instances++;
 					started_instances++;
 					stress_ftrace_add_pid(pid);
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+					stress_perf_sample_open(g_stressor_current, j, pid);
+#endif
 				}
 
 				/* Forced early abort during startup? */
@@ -2544,15 +3756,23 @@ child_exit:
 	if (g_opt_timeout)
 		(void)alarm((unsigned int)g_opt_timeout);
 
+	/* Get idle workers ready for the next stressor while this one runs */
+	stress_prefork_fill(backoff, ionice_class, ionice_level);
+
 abort:
 	pr_dbg("%d stressor%s started\n", started_instances,
 		 started_instances == 1 ? "" : "s");
 
 wait_for_stressors:
+	stress_start_barrier_release();
+	stress_window_start(stressors_list, time_start);
+	stress_adaptive_start(stressors_list);
 	if (g_opt_flags & OPT_FLAGS_IGNITE_CPU)
 		stress_ignite_cpu_start();
 
 	stress_wait_stressors(stressors_list, success, resource_success, metrics_success);
+	stress_adaptive_stop();
+	stress_window_stop(stressors_list);
 	time_finish = stress_time_now();
 
 	*duration += time_finish - time_start;
@@ -2697,6 +3917,226 @@ static char *stess_description_yamlify(const char *description)
 	return yamlified;
 }
 
+/*
+ *  stress_start_skew()
+ *	time in seconds between the first and last started
+ *	instances of a stressor entering the measured phase
+ */
+static double stress_start_skew(const stress_stressor_t *ss)
+{
+	double start_min = 0.0, start_max = 0.0;
+	int32_t j;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const double start = ss->stats[j]->start;
+
+		if (start <= 0.0)
+			continue;
+		if ((start_min <= 0.0) || (start < start_min))
+			start_min = start;
+		if (start > start_max)
+			start_max = start;
+	}
+	return start_max - start_min;
+}
+
+/*
+ *  stress_start_skew_dump()
+ *	dump the start time skew of the stressors when --sync-start is used
+ */
+static void stress_start_skew_dump(void)
+{
+	stress_stressor_t *ss;
+
+	if (!(g_opt_flags & OPT_FLAGS_SYNC_START))
+		return;
+
+	pr_metrics("start time skew:\n");
+	for (ss = stressors_head; ss; ss = ss->next) {
+		if (!ss->stats || !ss->started_instances)
+			continue;
+		pr_metrics("%-13s %13.6f secs between first and last of %" PRId32 " instances\n",
+			stress_munge_underscore(ss->stressor->name),
+			stress_start_skew(ss), ss->started_instances);
+	}
+}
+
+/*
+ *  stress_instance_rate()
+ *	bogo ops per second of a stressor instance in real time,
+ *	over the --warmup/--cooldown window if one was measured
+ */
+static double stress_instance_rate(const stress_stats_t *stats)
+{
+	double duration;
+
+	if (stats->window.end > stats->window.begin) {
+		duration = stats->window.end - stats->window.begin;
+		return (double)(stats->window.counter_end - stats->window.counter_begin) / duration;
+	}
+	duration = stats->finish - stats->start;
+	return (duration > 0.0) ? (double)stats->ci.counter / duration : 0.0;
+}
+
+/*
+ *  stress_instance_spread()
+ *	mean and coefficient of variation of the instance bogo ops
+ *	per second rates and the slowest and fastest instances
+ */
+static void stress_instance_spread(
+	const stress_stressor_t *ss,
+	double *mean,
+	double *cov,
+	int32_t *slowest,
+	int32_t *fastest)
+{
+	double sum = 0.0, sum_sq = 0.0, variance;
+	int32_t j;
+
+	*slowest = 0;
+	*fastest = 0;
+	for (j = 0; j < ss->started_instances; j++) {
+		const double rate = stress_instance_rate(ss->stats[j]);
+
+		sum += rate;
+		sum_sq += rate * rate;
+		if (rate < stress_instance_rate(ss->stats[*slowest]))
+			*slowest = j;
+		if (rate > stress_instance_rate(ss->stats[*fastest]))
+			*fastest = j;
+	}
+	*mean = sum / (double)ss->started_instances;
+	variance = (sum_sq / (double)ss->started_instances) - (*mean * *mean);
+	*cov = (*mean > 0.0) ? 100.0 * sqrt(STRESS_MAXIMUM(0.0, variance)) / *mean : 0.0;
+}
+
+/*
+ *  stress_instance_ipc()
+ *	instructions per cycle of an instance, negative if unknown
+ */
+static double stress_instance_ipc(const stress_stats_t *stats)
+{
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	double ipc;
+
+	if ((g_opt_flags & OPT_FLAGS_PERF_STATS) &&
+	    stress_perf_stat_ipc(stats->sp, &ipc))
+		return ipc;
+#else
+	(void)stats;
+#endif
+	return -1.0;
+}
+
+/*
+ *  stress_instance_maxrss()
+ *	maximum RSS of an instance in KB, 0 if unknown
+ */
+static long int stress_instance_maxrss(const stress_stats_t *stats)
+{
+#if defined(HAVE_GETRUSAGE) &&	\
+    defined(HAVE_RUSAGE_RU_MAXRSS)
+	return stats->rusage_maxrss;
+#else
+	(void)stats;
+	return 0;
+#endif
+}
+
+/*
+ *  stress_metrics_instances_yaml()
+ *	add per instance metrics of a stressor to the yaml metrics section
+ */
+static void stress_metrics_instances_yaml(FILE *yaml, const stress_stressor_t *ss)
+{
+	double mean, cov;
+	int32_t j, slowest, fastest;
+
+	if (!(g_opt_flags & OPT_FLAGS_METRICS_INSTANCES))
+		return;
+	if (!ss->stats || !ss->started_instances)
+		return;
+
+	stress_instance_spread(ss, &mean, &cov, &slowest, &fastest);
+	pr_yaml(yaml, "      instance-bogo-ops-per-second-cov-percent: %f\n", cov);
+	pr_yaml(yaml, "      instances:\n");
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+		const double ipc = stress_instance_ipc(stats);
+
+		pr_yaml(yaml, "        - instance: %" PRId32 "\n", j);
+		pr_yaml(yaml, "          bogo-ops: %" PRIu64 "\n", stats->ci.counter);
+		pr_yaml(yaml, "          bogo-ops-per-second-real-time: %f\n", stress_instance_rate(stats));
+		pr_yaml(yaml, "          cpu-begin: %" PRId32 "\n", stats->cpu_begin);
+		pr_yaml(yaml, "          cpu-end: %" PRId32 "\n", stats->cpu_end);
+		if (stats->schedstat.valid)
+			pr_yaml(yaml, "          migrations: %" PRIu64 "\n", stats->schedstat.migrations);
+		pr_yaml(yaml, "          max-rss: %ld\n", stress_instance_maxrss(stats));
+		if (ipc >= 0.0)
+			pr_yaml(yaml, "          instructions-per-cycle: %f\n", ipc);
+	}
+}
+
+/*
+ *  stress_metrics_instances_dump()
+ *	dump per instance metrics and the instance to instance
+ *	variation of each stressor, useful for spotting slow cores
+ *	on heterogeneous systems
+ */
+static void stress_metrics_instances_dump(void)
+{
+	stress_stressor_t *ss;
+
+	if (!(g_opt_flags & OPT_FLAGS_METRICS_INSTANCES))
+		return;
+
+	pr_metrics("per instance metrics:\n");
+	pr_metrics("%-13s %5s %12s %7s %10s %13s %6s\n",
+		"stressor", "inst", "bogo ops/s", "CPU", "migrations",
+		"RSS Max (KB)", "IPC");
+	for (ss = stressors_head; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		double mean, cov;
+		int32_t j, slowest, fastest;
+
+		if (!ss->stats || !ss->started_instances)
+			continue;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+			const double ipc = stress_instance_ipc(stats);
+			char cpu[16], migrations[16], ipc_str[16];
+
+			if (stats->cpu_begin == stats->cpu_end)
+				(void)snprintf(cpu, sizeof(cpu), "%" PRId32, stats->cpu_end);
+			else
+				(void)snprintf(cpu, sizeof(cpu), "%" PRId32 "-%" PRId32,
+					stats->cpu_begin, stats->cpu_end);
+			if (stats->schedstat.valid)
+				(void)snprintf(migrations, sizeof(migrations), "%" PRIu64,
+					stats->schedstat.migrations);
+			else
+				(void)shim_strlcpy(migrations, "-", sizeof(migrations));
+			if (ipc >= 0.0)
+				(void)snprintf(ipc_str, sizeof(ipc_str), "%.2f", ipc);
+			else
+				(void)shim_strlcpy(ipc_str, "-", sizeof(ipc_str));
+
+			pr_metrics("%-13s %5" PRId32 " %12.2f %7s %10s %13ld %6s\n",
+				munged, j, stress_instance_rate(stats), cpu,
+				migrations, stress_instance_maxrss(stats), ipc_str);
+		}
+		if (ss->started_instances < 2)
+			continue;
+		stress_instance_spread(ss, &mean, &cov, &slowest, &fastest);
+		pr_metrics("%-13s bogo ops/s mean %.2f, CoV %.2f%%, slowest instance %" PRId32
+			" (%.2f), fastest instance %" PRId32 " (%.2f)\n",
+			munged, mean, cov, slowest, stress_instance_rate(ss->stats[slowest]),
+			fastest, stress_instance_rate(ss->stats[fastest]));
+	}
+}
+
 /*
  *  stress_metrics_dump()
  *	output metrics
@@ -2706,7 +4146,7 @@ static void stress_metrics_dump(
 	const int32_t ticks_per_sec)
 {
 	stress_stressor_t *ss;
-	bool misc_metrics = false;
+	bool misc_metrics = false, windowed = false;
 
 	pr_lock();
 	if (g_opt_flags & OPT_FLAGS_METRICS_BRIEF) {
@@ -2728,8 +4168,10 @@ static void stress_metrics_dump(
 	pr_yaml(yaml, "metrics:\n");
 
 	for (ss = stressors_head; ss; ss = ss->next) {
-		uint64_t c_total = 0;
+		uint64_t c_total = 0, c_window = 0;
 		double   r_total = 0.0, u_total = 0.0, s_total = 0.0;
+		double   r_window = 0.0;
+		int32_t  n_window = 0;
 		long int maxrss = 0;
 		int32_t  j;
 		size_t i;
@@ -2757,10 +4199,16 @@ static void stress_metrics_dump(
 			s_total += (double)(stats->tms.tms_stime + stats->tms.tms_cstime);
 #endif
 			r_total += stats->finish - stats->start;
+			if (stats->window.end > stats->window.begin) {
+				c_window += stats->window.counter_end - stats->window.counter_begin;
+				r_window += stats->window.end - stats->window.begin;
+				n_window++;
+			}
 		}
 		/* Real time in terms of average wall clock time of all procs */
 		r_total = ss->started_instances ?
 			r_total / (double)ss->started_instances : 0.0;
+		r_window = n_window ? r_window / (double)n_window : 0.0;
 
 		if ((g_opt_flags & OPT_FLAGS_METRICS_BRIEF) &&
 		    (c_total == 0) && (!run_ok))
@@ -2779,6 +4227,11 @@ static void stress_metrics_dump(
 
 		/* Total usr + sys time of all procs */
 		bogo_rate_r_time = (r_total > 0.0) ? (double)c_total / r_total : 0.0;
+		/* Real time rate over the --warmup/--cooldown window if one was measured */
+		if (r_window > 0.0) {
+			bogo_rate_r_time = (double)c_window / r_window;
+			windowed = true;
+		}
 		{
 			double us_total = u_time + s_time;
 
@@ -2845,6 +4298,11 @@ static void stress_metrics_dump(
 			pr_yaml(yaml, "      system-time: %e\n", s_time);
 			pr_yaml(yaml, "      cpu-usage-per-instance: %e\n", cpu_usage);
 			pr_yaml(yaml, "      max-rss: %ld\n", maxrss);
+			pr_yaml(yaml, "      start-time-skew: %e\n", stress_start_skew(ss));
+			if (r_window > 0.0) {
+				pr_yaml(yaml, "      steady-state-bogo-ops: %" PRIu64 "\n", c_window);
+				pr_yaml(yaml, "      steady-state-wall-clock-time: %e\n", r_window);
+			}
 		} else {
 			pr_yaml(yaml, "    - stressor: %s\n", munged);
 			pr_yaml(yaml, "      bogo-ops: %" PRIu64 "\n", c_total);
@@ -2855,6 +4313,11 @@ static void stress_metrics_dump(
 			pr_yaml(yaml, "      system-time: %f\n", s_time);
 			pr_yaml(yaml, "      cpu-usage-per-instance: %f\n", cpu_usage);
 			pr_yaml(yaml, "      max-rss: %ld\n", maxrss);
+			pr_yaml(yaml, "      start-time-skew: %f\n", stress_start_skew(ss));
+			if (r_window > 0.0) {
+				pr_yaml(yaml, "      steady-state-bogo-ops: %" PRIu64 "\n", c_window);
+				pr_yaml(yaml, "      steady-state-wall-clock-time: %f\n", r_window);
+			}
 		}
 
 		for (i = 0; i < SIZEOF_ARRAY(ss->stats[0]->metrics); i++) {
@@ -2862,14 +4325,19 @@ static void stress_metrics_dump(
 
 			if (description) {
 				double metric, total = 0.0;
+				int32_t n = 0;
 
 				misc_metrics = true;
 				for (j = 0; j < ss->started_instances; j++) {
 					const stress_stats_t *const stats = ss->stats[j];
 
+					/* skip instances that did not set this metric */
+					if (!stats->metrics[i].description)
+						continue;
 					total += stats->metrics[i].value;
+					n++;
 				}
-				metric = ss->started_instances ? total / ss->started_instances : 0.0;
+				metric = n ? total / n : 0.0;
 				if (g_opt_flags & OPT_FLAGS_SN) {
 					pr_yaml(yaml, "      %s: %e\n", stess_description_yamlify(description), metric);
 				} else {
@@ -2877,9 +4345,18 @@ static void stress_metrics_dump(
 				}
 			}
 		}
+		stress_metrics_instances_yaml(yaml, ss);
+		stress_latency_yaml(yaml, ss);
+		stress_offcpu_yaml(yaml, ss);
+		stress_schedstat_yaml(yaml, ss);
+		stress_power_yaml(yaml, ss);
+		if (ss->stressor->info->yaml)
+			ss->stressor->info->yaml(yaml);
 
 		pr_yaml(yaml, "\n");
 	}
+	if (windowed)
+		pr_metrics("bogo ops/s (real time) excludes the --warmup and --cooldown periods\n");
 
 	if (misc_metrics) {
 		pr_metrics("miscellaneous metrics:\n");
@@ -2888,7 +4365,7 @@ static void stress_metrics_dump(
 			int32_t j;
 			const char *munged = stress_munge_underscore(ss->stressor->name);
 
-			if (!ss->stats)
+			if (!ss->stats || !ss->started_instances)
 				continue;
 
 			for (i = 0; i < SIZEOF_ARRAY(ss->stats[0]->metrics); i++) {
@@ -2929,6 +4406,12 @@ static void stress_metrics_dump(
 			}
 		}
 	}
+	stress_start_skew_dump();
+	stress_metrics_instances_dump();
+	stress_latency_dump(stressors_head);
+	stress_offcpu_dump(stressors_head);
+	stress_schedstat_dump(stressors_head);
+	stress_power_dump(stressors_head);
 	pr_unlock();
 }
 
@@ -3101,6 +4584,58 @@ static void *stress_map_page(int prot, char *prot_str, size_t page_size)
 	return ptr;
 }
 
+/*
+ *  stress_shared_map_optional()
+ *	mmap a shared region of num_procs items of size bytes for
+ *	an option that has been enabled, the option flag is cleared
+ *	if the region cannot be mapped
+ */
+static void *stress_shared_map_optional(
+	const int32_t num_procs,
+	const size_t size,
+	size_t *length,
+	const uint64_t opt_flag,
+	const char *what,
+	const char *option)
+{
+	const size_t page_size = stress_get_page_size();
+	const size_t len = size * (size_t)num_procs;
+	const size_t sz = (len + page_size) & ~(page_size - 1);
+	void *ptr;
+
+	*length = 0;
+	if (!(g_opt_flags & opt_flag))
+		return NULL;
+
+	ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+	if (ptr == MAP_FAILED) {
+		pr_inf("cannot mmap %s, errno=%d (%s), disabling %s\n",
+			what, errno, strerror(errno), option);
+		g_opt_flags &= ~opt_flag;
+		return NULL;
+	}
+	*length = sz;
+	return ptr;
+}
+
+/*
+ *  stress_shared_unmap_optional()
+ *	unmap the regions mapped for enabled options
+ */
+static void stress_shared_unmap_optional(void)
+{
+	if (g_shared->latencies)
+		(void)munmap((void *)g_shared->latencies, g_shared->latencies_length);
+#if defined(STRESS_PERF_STATS)
+	if (g_shared->perfs)
+		(void)munmap((void *)g_shared->perfs, g_shared->perfs_length);
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (g_shared->tzs)
+		(void)munmap((void *)g_shared->tzs, g_shared->tzs_length);
+#endif
+}
+
 /*
  *  stress_shared_map()
  *	mmap shared region, with an extra page at the end
@@ -3113,6 +4648,8 @@ static inline void stress_shared_map(const int32_t num_procs)
 	size_t len = sizeof(stress_shared_t) +
 		     (sizeof(stress_stats_t) * (size_t)num_procs);
 	size_t sz = (len + (page_size << 1)) & ~(page_size - 1);
+	int32_t max_instances = 1;
+	const stress_stressor_t *ss;
 #if defined(HAVE_MPROTECT)
 	void *last_page;
 #endif
@@ -3126,8 +4663,10 @@ static inline void stress_shared_map(const int32_t num_procs)
 		exit(EXIT_FAILURE);
 	}
 
-	/* Paraniod */
-	(void)memset(g_shared, 0, sz);
+	/*
+	 *  Anonymous mappings are zero filled, so don't memset the
+	 *  segment, pages are only faulted in when they are used
+	 */
 	g_shared->length = sz;
 
 	/*
@@ -3181,6 +4720,47 @@ STRESS_PRAGMA_POP
 	(void)memset(g_shared->checksums, 0, sz);
 	g_shared->checksums_length = sz;
 
+	/*
+	 *  per instance futexes and timeouts for the futex stressor,
+	 *  sized by the largest number of instances of a stressor
+	 */
+	for (ss = stressors_head; ss; ss = ss->next) {
+		if (max_instances < ss->num_instances)
+			max_instances = ss->num_instances;
+	}
+	len = (sizeof(*g_shared->futex.timeout) + sizeof(*g_shared->futex.futex)) *
+	      (size_t)max_instances;
+	sz = (len + page_size) & ~(page_size - 1);
+	g_shared->futex.timeout = (uint64_t *)mmap(NULL, sz,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+	if (g_shared->futex.timeout == MAP_FAILED) {
+		pr_err("cannot mmap futexes, errno=%d (%s)\n",
+			errno, strerror(errno));
+		goto err_unmap_checksums;
+	}
+	/* futexes follow the 64 bit timeouts so are 4 byte aligned */
+	g_shared->futex.futex = (uint32_t *)(g_shared->futex.timeout + max_instances);
+	g_shared->futex.length = sz;
+
+	/*
+	 *  latency histograms, perf counters and thermal zone
+	 *  readings are large, so only map these when they
+	 *  have been requested
+	 */
+	g_shared->latencies = (stress_latency_t *)stress_shared_map_optional(num_procs,
+		sizeof(stress_latency_t), &g_shared->latencies_length,
+		OPT_FLAGS_LATENCY_HIST, "latency histograms", "--latency-hist");
+#if defined(STRESS_PERF_STATS)
+	g_shared->perfs = (stress_perf_t *)stress_shared_map_optional(num_procs,
+		sizeof(stress_perf_t), &g_shared->perfs_length,
+		OPT_FLAGS_PERF_STATS, "perf counters", "--perf");
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	g_shared->tzs = (stress_tz_t *)stress_shared_map_optional(num_procs,
+		sizeof(stress_tz_t), &g_shared->tzs_length,
+		OPT_FLAGS_THERMAL_ZONES, "thermal zone readings", "--tz");
+#endif
+
 	/*
 	 *  mmap some pages for testing invalid arguments in
 	 *  various stressors, get the allocations done early
@@ -3189,7 +4769,7 @@ STRESS_PRAGMA_POP
 	 */
 	g_shared->mapped.page_none = stress_map_page(PROT_NONE, "PROT_NONE", page_size);
 	if (g_shared->mapped.page_none == MAP_FAILED)
-		goto err_unmap_checksums;
+		goto err_unmap_futex;
 	g_shared->mapped.page_ro = stress_map_page(PROT_READ, "PROT_READ", page_size);
 	if (g_shared->mapped.page_ro == MAP_FAILED)
 		goto err_unmap_page_none;
@@ -3202,6 +4782,9 @@ err_unmap_page_ro:
 	(void)munmap((void *)g_shared->mapped.page_ro, page_size);
 err_unmap_page_none:
 	(void)munmap((void *)g_shared->mapped.page_none, page_size);
+err_unmap_futex:
+	stress_shared_unmap_optional();
+	(void)munmap((void *)g_shared->futex.timeout, g_shared->futex.length);
 err_unmap_checksums:
 	(void)munmap((void *)g_shared->checksums, g_shared->checksums_length);
 err_unmap_shared:
@@ -3222,6 +4805,8 @@ void stress_shared_unmap(void)
 	(void)munmap((void *)g_shared->mapped.page_wo, page_size);
 	(void)munmap((void *)g_shared->mapped.page_ro, page_size);
 	(void)munmap((void *)g_shared->mapped.page_none, page_size);
+	stress_shared_unmap_optional();
+	(void)munmap((void *)g_shared->futex.timeout, g_shared->futex.length);
 	(void)munmap((void *)g_shared->checksums, g_shared->checksums_length);
 	(void)munmap((void *)g_shared, g_shared->length);
 }
@@ -3414,12 +4999,33 @@ static inline void stress_setup_stats_buffers(void)
 {
 	stress_stressor_t *ss;
 	stress_stats_t *stats = g_shared->stats;
+	stress_latency_t *latency = g_shared->latencies;
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t *sp = g_shared->perfs;
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	stress_tz_t *tz = g_shared->tzs;
+#endif
 
 	for (ss = stressors_head; ss; ss = ss->next) {
 		int32_t j;
 
-		for (j = 0; j < ss->num_instances; j++, stats++)
+		for (j = 0; j < ss->num_instances; j++, stats++) {
 			ss->stats[j] = stats;
+			stats->latency = latency;
+			if (latency)
+				latency++;
+#if defined(STRESS_PERF_STATS)
+			stats->sp = sp;
+			if (sp)
+				sp++;
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+			stats->tz = tz;
+			if (tz)
+				tz++;
+#endif
+		}
 	}
 }
 
@@ -3487,6 +5093,37 @@ static void stress_enable_all_stressors(const int32_t instances)
 	}
 }
 
+/*
+ *  stress_enable_mitigations()
+ *	enable the kernel entry/exit cost stressors for --mitigations
+ *	if no stressors are set, these are run one after another
+ */
+static void stress_enable_mitigations(void)
+{
+	size_t i;
+
+	if (!(g_opt_flags & OPT_FLAGS_MITIGATIONS))
+		return;
+	if (g_opt_flags & (OPT_FLAGS_SET | OPT_FLAGS_SEQUENTIAL |
+			   OPT_FLAGS_ALL | OPT_FLAGS_RANDOM))
+		return;
+
+	g_opt_flags |= (OPT_FLAGS_SET | OPT_FLAGS_SEQUENTIAL);
+	g_opt_sequential = 1;
+
+	for (i = 0; stressors[i].id != STRESS_MAX; i++) {
+		if (stress_mitigations_stressor(stressors[i].name)) {
+			stress_stressor_t *ss = stress_find_proc_info(&stressors[i]);
+
+			if (!ss) {
+				(void)fprintf(stderr, "Cannot allocate stressor state info\n");
+				exit(EXIT_FAILURE);
+			}
+			ss->num_instances = 1;
+		}
+	}
+}
+
 /*
  *  stress_enable_classes()
  *	enable stressors based on class
@@ -3611,6 +5248,10 @@ next_opt:
 			u32 = stress_get_uint32(optarg);
 			stress_set_setting("cache-ways", TYPE_ID_UINT32, &u32);
 			break;
+		case OPT_cache_probe:
+			if (stress_set_cache_probe(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
 		case OPT_class:
 			ret = stress_get_class(optarg, &u32);
 			if (ret < 0)
@@ -3622,6 +5263,51 @@ next_opt:
 				stress_enable_classes(u32);
 			}
 			break;
+		case OPT_adaptive:
+			if (stress_set_adaptive(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_adaptive_min:
+			if (stress_set_adaptive_min(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cluster:
+			stress_set_setting_global("cluster", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_cluster_agent:
+			stress_set_setting_global("cluster-agent", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_cluster_key:
+			stress_set_setting_global("cluster-key", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_anomaly_abort:
+			(void)stress_set_anomaly_abort(optarg);
+			break;
+		case OPT_anomaly_ms:
+			if (stress_set_anomaly_ms(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_anomaly_sigma:
+			if (stress_set_anomaly_sigma(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_autotune:
+			(void)stress_set_autotune(optarg);
+			break;
+		case OPT_autotune_profile:
+			stress_set_setting_global("autotune-profile", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_compare:
+			stress_set_setting_global("compare", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_compare_threshold:
+			if (stress_set_compare_threshold(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cooldown:
+			u64 = stress_get_uint64_time(optarg);
+			stress_set_setting_global("cooldown", TYPE_ID_UINT64, &u64);
+			break;
 		case OPT_exclude:
 			stress_set_setting_global("exclude", TYPE_ID_STR, (void *)optarg);
 			break;
@@ -3636,12 +5322,31 @@ next_opt:
 			i32 = stress_get_int32(optarg);
 			stress_set_setting("ionice-level", TYPE_ID_INT32, &i32);
 			break;
+		case OPT_irq_dev:
+			if (stress_set_irq_dev(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_irq_placement:
+			if (stress_set_irq_placement(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_job:
 			stress_set_setting_global("job", TYPE_ID_STR, (void *)optarg);
 			break;
 		case OPT_log_file:
 			stress_set_setting_global("log-file", TYPE_ID_STR, (void *)optarg);
 			break;
+		case OPT_metrics_stream:
+			stress_set_setting_global("metrics-stream", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_metrics_stream_format:
+			if (stress_set_metrics_stream_format(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_metrics_stream_ms:
+			if (stress_set_metrics_stream_ms(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_max_fd:
 			max_fds = (uint64_t)stress_get_file_limit();
 			u64 = stress_get_uint64_percent(optarg, 1, max_fds,
@@ -3674,6 +5379,17 @@ next_opt:
 				g_opt_flags |= OPT_FLAGS_OOM_AVOID;
 			}
 			break;
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+		case OPT_perf_events:
+			if (stress_set_perf_events(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_perf_sample_top:
+			if (stress_set_perf_sample_top(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
 		case OPT_query:
 			if (!jobmode) {
 				(void)printf("Try '%s --help' for more information.\n", g_app_name);
@@ -3712,6 +5428,26 @@ next_opt:
 		case OPT_sched_reclaim:
 			g_opt_flags |= OPT_FLAGS_DEADLINE_GRUB;
 			break;
+		case OPT_search:
+			if (stress_set_search(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_search_ghz_drop:
+			if (stress_set_search_ghz_drop(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_search_max:
+			if (stress_set_search_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_search_p99:
+			if (stress_set_search_p99(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_search_temp:
+			if (stress_set_search_temp(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_seed:
 			u64 = stress_get_uint64(optarg);
 			g_opt_flags |= OPT_FLAGS_SEED;
@@ -3724,11 +5460,51 @@ next_opt:
 			stress_check_range("sequential", (uint64_t)g_opt_sequential,
 				MIN_SEQUENTIAL, MAX_SEQUENTIAL);
 			break;
-		case OPT_stressors:
-			stress_show_stressor_names();
-			exit(EXIT_SUCCESS);
-		case OPT_taskset:
-			if (stress_set_cpu_affinity(optarg) < 0)
+		case OPT_stressors:
+			stress_show_stressor_names();
+			exit(EXIT_SUCCESS);
+		case OPT_taskset:
+			if (stress_set_cpu_affinity(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_placement:
+			if (stress_set_placement(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_core_type:
+			if (stress_set_core_type(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_ftrace_pid:
+			if (stress_set_ftrace_pid(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_ftrace_top:
+			if (stress_set_ftrace_top(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup:
+			if (stress_set_cgroup(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_cpu_max:
+			if (stress_set_cgroup_cpu_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_cpuset:
+			if (stress_set_cgroup_cpuset(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_io_max:
+			if (stress_set_cgroup_io_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_memory_high:
+			if (stress_set_cgroup_memory_high(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_memory_max:
+			if (stress_set_cgroup_memory_max(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
 		case OPT_temp_path:
@@ -3747,10 +5523,58 @@ next_opt:
 		case OPT_verifiable:
 			stress_verifiable();
 			exit(EXIT_SUCCESS);
+		case OPT_rate:
+			stress_set_setting_global("rate", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_repeat:
+			if (stress_set_repeat(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_reproduce:
+			stress_set_setting_global("reproduce", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_resctrl:
+			if (stress_set_resctrl(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_scaling:
+			if (stress_set_scaling(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_score:
+			stress_set_setting_global("score", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_interference:
+			if (stress_set_interference(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_smt_interference:
+			if (stress_set_smt_interference(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_resctrl_cat:
+			if (stress_set_resctrl_cat(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_resctrl_sweep:
+			if (stress_set_resctrl_sweep(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_resctrl_victim:
+			if (stress_set_resctrl_victim(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_results_bin:
+			stress_set_setting_global("results-bin", TYPE_ID_STR, (void *)optarg);
+			break;
 		case OPT_vmstat:
 			if (stress_set_vmstat(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_warmup:
+			u64 = stress_get_uint64_time(optarg);
+			stress_set_setting_global("warmup", TYPE_ID_UINT64, &u64);
+			break;
 		case OPT_thermalstat:
 			if (stress_set_thermalstat(optarg) < 0)
 				exit(EXIT_FAILURE);
@@ -3759,6 +5583,10 @@ next_opt:
 			if (stress_set_iostat(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_psistat:
+			if (stress_set_psistat(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_yaml:
 			stress_set_setting_global("yaml", TYPE_ID_STR, (void *)optarg);
 			break;
@@ -3878,6 +5706,13 @@ static inline void stress_run_sequential(
 {
 	stress_stressor_t *ss;
 	stress_checksum_t *checksum = g_shared->checksums;
+	int32_t max_instances = 0;
+
+	for (ss = stressors_head; ss; ss = ss->next) {
+		if (max_instances < ss->num_instances)
+			max_instances = ss->num_instances;
+	}
+	stress_prefork_init(max_instances);
 
 	/*
 	 *  Step through each stressor one by one
@@ -3886,11 +5721,16 @@ static inline void stress_run_sequential(
 		stress_stressor_t *next = ss->next;
 
 		ss->next = NULL;
+		stress_ftrace_step_begin();
+		stress_power_step_begin();
 		stress_run(ss, duration, success, resource_success,
 			metrics_success, &checksum);
+		stress_power_step_end(ss);
+		stress_ftrace_step_end(ss);
 		ss->next = next;
 
 	}
+	stress_prefork_free();
 }
 
 /*
@@ -3908,8 +5748,234 @@ static inline void stress_run_parallel(
 	/*
 	 *  Run all stressors in parallel
 	 */
+	stress_ftrace_step_begin();
+	stress_power_step_begin();
 	stress_run(stressors_head, duration, success, resource_success,
 			metrics_success, &checksum);
+	stress_power_step_end(stressors_head);
+	stress_ftrace_step_end(stressors_head);
+}
+
+/*
+ *  stress_run_phased()
+ *	run the job file phases one after another, the stressors
+ *	of each phase are run in parallel for the phase duration
+ */
+static void NOINLINE stress_run_phased(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	uint32_t phase;
+	const uint32_t phases = stress_phase_count();
+
+	for (phase = 0; (phase < phases) && keep_stressing_flag(); phase++) {
+		stress_phase_begin(stressors_head, phase);
+		*run_duration = 0.0;
+		stress_run_parallel(run_duration,
+			success, resource_success, metrics_success);
+		*duration += *run_duration;
+		stress_phase_end(stressors_head, phase, *run_duration);
+	}
+	stress_phase_finish(stressors_head);
+}
+
+/*
+ *  stress_run_search()
+ *	run the stressor repeatedly at different loads to
+ *	find the highest load that is within the search limits
+ */
+static void NOINLINE stress_run_search(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	while (keep_stressing_flag() && stress_search_begin(stressors_head)) {
+		*run_duration = 0.0;
+		stress_run_parallel(run_duration,
+			success, resource_success, metrics_success);
+		*duration += *run_duration;
+		stress_search_end(stressors_head, *run_duration);
+	}
+	stress_search_finish(stressors_head);
+}
+
+/*
+ *  stress_run_resctrl_sweep()
+ *	run the victim and aggressor stressors once
+ *	for each resctrl schemata configuration
+ */
+static void NOINLINE stress_run_resctrl_sweep(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	while (keep_stressing_flag() && stress_resctrl_sweep_begin(stressors_head)) {
+		*run_duration = 0.0;
+		stress_run_parallel(run_duration,
+			success, resource_success, metrics_success);
+		*duration += *run_duration;
+		stress_resctrl_sweep_end(stressors_head, *run_duration);
+	}
+}
+
+/*
+ *  stress_run_hybrid()
+ *	run the stressors once on each selected
+ *	hybrid CPU core type
+ */
+static void NOINLINE stress_run_hybrid(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	while (keep_stressing_flag() && stress_hybrid_step_begin()) {
+		*run_duration = 0.0;
+		stress_run_parallel(run_duration,
+			success, resource_success, metrics_success);
+		*duration += *run_duration;
+		stress_hybrid_step_end(stressors_head, *run_duration);
+	}
+}
+
+/*
+ *  stress_run_smt()
+ *	run each victim stressor alone and then paired with
+ *	each partner stressor on the SMT sibling CPU
+ */
+static void NOINLINE stress_run_smt(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	while (keep_stressing_flag() && stress_smt_step_begin(stressors_head)) {
+		*run_duration = 0.0;
+		stress_run_parallel(run_duration,
+			success, resource_success, metrics_success);
+		*duration += *run_duration;
+		stress_smt_step_end();
+	}
+}
+
+/*
+ *  stress_run_interference()
+ *	run each stressor alone and then each pair
+ *	of stressors concurrently
+ */
+static void NOINLINE stress_run_interference(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	while (keep_stressing_flag() && stress_interference_step_begin(stressors_head)) {
+		*run_duration = 0.0;
+		stress_run_parallel(run_duration,
+			success, resource_success, metrics_success);
+		*duration += *run_duration;
+		stress_interference_step_end();
+	}
+}
+
+/*
+ *  stress_run_scaling()
+ *	run each stressor with 1, 2, 4 .. N instances
+ */
+static void NOINLINE stress_run_scaling(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	while (keep_stressing_flag() && stress_scaling_step_begin(stressors_head)) {
+		*run_duration = 0.0;
+		stress_run_parallel(run_duration,
+			success, resource_success, metrics_success);
+		*duration += *run_duration;
+		stress_scaling_step_end();
+	}
+}
+
+/*
+ *  stress_run_repeated()
+ *	run the stressors once, or --repeat N times, duration
+ *	is the total run time and run_duration the time of the
+ *	last run
+ */
+static void NOINLINE stress_run_repeated(
+	double *duration,
+	double *run_duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	uint32_t repeat, repeats;
+
+	if (stress_phase_count()) {
+		stress_run_phased(duration, run_duration,
+			success, resource_success, metrics_success);
+		return;
+	}
+	if (stress_search_enabled()) {
+		stress_run_search(duration, run_duration,
+			success, resource_success, metrics_success);
+		return;
+	}
+	if (stress_resctrl_sweep_enabled()) {
+		stress_run_resctrl_sweep(duration, run_duration,
+			success, resource_success, metrics_success);
+		return;
+	}
+	if (stress_hybrid_enabled()) {
+		stress_run_hybrid(duration, run_duration,
+			success, resource_success, metrics_success);
+		return;
+	}
+	if (stress_smt_enabled()) {
+		stress_run_smt(duration, run_duration,
+			success, resource_success, metrics_success);
+		return;
+	}
+	if (stress_scaling_enabled()) {
+		stress_run_scaling(duration, run_duration,
+			success, resource_success, metrics_success);
+		return;
+	}
+	if (stress_interference_enabled()) {
+		stress_run_interference(duration, run_duration,
+			success, resource_success, metrics_success);
+		return;
+	}
+
+	repeats = stress_repeat_init(stressors_head);
+
+	for (repeat = 0; (repeat < repeats) && keep_stressing_flag(); repeat++) {
+		if (repeats > 1)
+			pr_inf("run %" PRIu32 " of %" PRIu32 "\n", repeat + 1, repeats);
+
+		*run_duration = 0.0;
+		if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+			stress_run_sequential(run_duration,
+				success, resource_success, metrics_success);
+		} else {
+			stress_run_parallel(run_duration,
+				success, resource_success, metrics_success);
+		}
+		*duration += *run_duration;
+		stress_repeat_record();
+	}
 }
 
 /*
@@ -3961,18 +6027,24 @@ static void stress_yaml_close(FILE *yaml)
 int main(int argc, char **argv, char **envp)
 {
 	double duration = 0.0;			/* stressor run time in secs */
+	double run_duration = 0.0;		/* run time of the last repeat */
 	bool success = true;
 	bool resource_success = true;
 	bool metrics_success = true;
 	FILE *yaml;				/* YAML output file */
 	char *yaml_filename = NULL;		/* YAML file name */
+	char *results_filename = NULL;		/* binary results file name */
 	char *log_filename;			/* log filename */
 	char *job_filename = NULL;		/* job filename */
+	char *cluster_nodes = NULL;		/* --cluster agent list */
+	char *cluster_agent = NULL;		/* --cluster-agent address */
+	char *reproduce_filename = NULL;	/* --reproduce YAML file */
 	int32_t ticks_per_sec;			/* clock ticks per second (jiffies) */
 	int32_t ionice_class = UNDEFINED;	/* ionice class */
 	int32_t ionice_level = UNDEFINED;	/* ionice level */
 	size_t i;
 	uint32_t class = 0;
+	uint64_t cooldown = 0;			/* --cooldown seconds */
 	const uint32_t cpus_online = (uint32_t)stress_get_processors_online();
 	const uint32_t cpus_configured = (uint32_t)stress_get_processors_configured();
 	int ret;
@@ -4032,6 +6104,35 @@ int main(int argc, char **argv, char **envp)
 		goto exit_stressors_free;
 	}
 
+	/*
+	 *  Coordinate the job file over --cluster agents instead of running it
+	 */
+	(void)stress_get_setting("cluster", &cluster_nodes);
+	if (cluster_nodes) {
+		(void)stress_get_setting("job", &job_filename);
+		(void)stress_get_setting("yaml", &yaml_filename);
+		ret = stress_cluster_coordinate(cluster_nodes, job_filename, yaml_filename);
+		goto exit_stressors_free;
+	}
+
+	/*
+	 *  Receive the job file from a --cluster coordinator
+	 */
+	(void)stress_get_setting("cluster-agent", &cluster_agent);
+	if (cluster_agent && (stress_cluster_agent_job(cluster_agent) < 0)) {
+		ret = EXIT_FAILURE;
+		goto exit_stressors_free;
+	}
+
+	/*
+	 *  Load in the recorded run options, seeds and settings
+	 */
+	(void)stress_get_setting("reproduce", &reproduce_filename);
+	if (reproduce_filename && (stress_reproduce_load(argc, argv, reproduce_filename) < 0)) {
+		ret = EXIT_FAILURE;
+		goto exit_stressors_free;
+	}
+
 	/*
 	 *  Load in job file options
 	 */
@@ -4098,6 +6199,12 @@ int main(int argc, char **argv, char **envp)
 		cpus_online, cpus_online == 1 ? "" : "s",
 		cpus_configured, cpus_configured == 1 ? "" : "s");
 
+	/*
+	 *  Mitigations mode runs the kernel entry/exit cost stressors
+	 */
+	stress_enable_mitigations();
+	stress_mitigations_init();
+
 	/*
 	 *  For random mode the stressors must be available
 	 */
@@ -4129,7 +6236,9 @@ int main(int argc, char **argv, char **envp)
 	 */
 	stress_set_random_stressors();
 
+	stress_clocksource_init();
 	(void)stress_ftrace_start();
+	stress_offcpu_init();
 #if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H)
 	if (g_opt_flags & OPT_FLAGS_PERF_STATS)
@@ -4154,6 +6263,7 @@ int main(int argc, char **argv, char **envp)
 	(void)stress_get_setting("ionice-level", &ionice_level);
 	stress_set_iopriority(ionice_class, ionice_level);
 	(void)stress_get_setting("yaml", &yaml_filename);
+	(void)stress_get_setting("results-bin", &results_filename);
 
 	stress_mlock_executable();
 
@@ -4173,6 +6283,50 @@ int main(int argc, char **argv, char **envp)
 		VOID_RET(int, stress_sighandler("stress-ng", ignore_signals[i], SIG_IGN, NULL));
 	}
 
+	/*
+	 *  Size stressors for the job file phases
+	 */
+	stress_phase_merge();
+	if (stress_phase_setup(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+	/*
+	 *  --cooldown is measured back from the end of the --timeout
+	 *  (or job file phases), so an ops bounded or endless run has none
+	 */
+	(void)stress_get_setting("cooldown", &cooldown);
+	if (cooldown &&
+	    ((g_opt_timeout == TIMEOUT_NOT_SET) || (g_opt_timeout == 0))) {
+		pr_err("--cooldown requires a non-zero --timeout\n");
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+	if (stress_search_setup(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+	if (stress_resctrl_setup(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+	if (stress_hybrid_setup(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+	if (stress_smt_setup(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+	if (stress_scaling_setup(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+	if (stress_interference_setup(stressors_head) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+
 	/*
 	 *  Setup stressor proc info
 	 */
@@ -4188,6 +6342,11 @@ int main(int argc, char **argv, char **envp)
 	stress_exclude_unsupported(&unsupported);
 	stress_exclude_pathological();
 
+	if (stress_setup_rate() < 0) {
+		ret = EXIT_FAILURE;
+		goto exit_logging_close;
+	}
+
 	stress_set_proc_limits();
 
 	if (!stressors_head) {
@@ -4241,7 +6400,7 @@ int main(int argc, char **argv, char **envp)
 		goto exit_destroy_perf_lock;
 	}
 	g_shared->net_port_map.lock = stress_lock_create();
-	if (!g_shared->warn_once.lock) {
+	if (!g_shared->net_port_map.lock) {
 		pr_err("failed to create net_port_map lock\n");
 		goto exit_destroy_warn_once_lock;
 	}
@@ -4251,6 +6410,21 @@ int main(int argc, char **argv, char **envp)
 	 */
 	stress_setup_stats_buffers();
 
+	/*
+	 *  Read cpu cache and topology details once for all stressors
+	 */
+	stress_cpu_cache_init();
+
+	/*
+	 *  Measure cache geometry and compare with sysfs/cpuid
+	 */
+	stress_cache_probe();
+
+	/*
+	 *  Derive stressor buffer sizes from the host profile
+	 */
+	stress_autotune();
+
 	/*
 	 *  Allocate shared cache memory
 	 */
@@ -4273,22 +6447,34 @@ int main(int argc, char **argv, char **envp)
 
 	stress_clear_warn_once();
 	stress_stressors_init();
+	stress_placement_init();
+	stress_irq_init();
+	stress_cgroup_init(stressors_head);
+	stress_resctrl_init(stressors_head);
+	stress_power_init(stressors_head);
+	pr_async_start(stress_get_total_num_instances(stressors_head));
 
 	/* Start thrasher process if required */
 	if (g_opt_flags & OPT_FLAGS_THRASH)
 		stress_thrash_start();
 
+	stress_psi_start();
 	stress_vmstat_start();
-	stress_smart_start();
+	stress_metrics_stream_start(stressors_head);
+	stress_anomaly_start(stressors_head);
+	stress_throttle_start(stressors_head);
+	stress_smart_start(stressors_head);
 	stress_klog_start();
+	stress_resctrl_start();
+	stress_cluster_agent_barrier(yaml_filename);
 
-	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
-		stress_run_sequential(&duration,
-			&success, &resource_success, &metrics_success);
-	} else {
-		stress_run_parallel(&duration,
-			&success, &resource_success, &metrics_success);
-	}
+	stress_run_repeated(&duration, &run_duration,
+		&success, &resource_success, &metrics_success);
+	stress_anomaly_stop();
+	pr_async_stop();
+	stress_cgroup_collect();
+	stress_resctrl_collect();
+	stress_throttle_stop();
 
 	/* Stop thasher process */
 	if (g_opt_flags & OPT_FLAGS_THRASH)
@@ -4301,6 +6487,9 @@ int main(int argc, char **argv, char **envp)
 	 */
 	if (g_opt_flags & OPT_FLAGS_METRICS)
 		stress_metrics_dump(yaml, ticks_per_sec);
+	stress_repeat_dump(yaml);
+	stress_phase_dump(yaml);
+	stress_search_dump(yaml);
 
 	stress_metrics_check(&success);
 
@@ -4310,9 +6499,28 @@ int main(int argc, char **argv, char **envp)
 	 *  Dump perf statistics
 	 */
 	if (g_opt_flags & OPT_FLAGS_PERF_STATS)
-		stress_perf_stat_dump(yaml, stressors_head, duration);
+		stress_perf_stat_dump(yaml, stressors_head, run_duration);
+	/*
+	 *  Dump perf sampled hot functions
+	 */
+	stress_perf_sample_dump(yaml, stressors_head);
 #endif
 
+	/*
+	 *  Compare against a --compare baseline
+	 */
+	stress_compare_dump(yaml, stressors_head, &success);
+
+	/*
+	 *  Score per class against a --score baseline
+	 */
+	stress_score_dump(yaml, stressors_head, &success);
+
+	/*
+	 *  Binary columnar results, before thermal zone info is freed
+	 */
+	stress_results_dump(results_filename, stressors_head, ticks_per_sec, duration);
+
 #if defined(STRESS_THERMAL_ZONES)
 	/*
 	 *  Dump thermal zone measurements
@@ -4327,11 +6535,102 @@ int main(int argc, char **argv, char **envp)
 	 */
 	stress_times_dump(yaml, ticks_per_sec, duration);
 
+	/*
+	 *  Dump pressure stall information
+	 */
+	stress_psi_dump(yaml);
+
+	/*
+	 *  Dump cgroup resource accounting
+	 */
+	stress_cgroup_dump(yaml);
+
+	/*
+	 *  Dump softirq activity of --irq-placement
+	 */
+	stress_irq_dump(yaml);
+
+	/*
+	 *  Dump measured vs declared cache geometry
+	 */
+	stress_cache_probe_dump(yaml);
+
+	/*
+	 *  Dump the --autotune host profile and derived defaults
+	 */
+	stress_autotune_dump(yaml);
+
+	/*
+	 *  Dump resctrl memory bandwidth and LLC occupancy
+	 */
+	stress_resctrl_dump(yaml);
+
+	/*
+	 *  Dump per hybrid CPU core type throughput
+	 */
+	stress_hybrid_dump(yaml, stressors_head);
+
+	/*
+	 *  Dump SMT sibling interference slowdown matrix
+	 */
+	stress_smt_dump(yaml);
+
+	/*
+	 *  Dump throughput vs instance count scaling curves
+	 */
+	stress_scaling_dump(yaml);
+
+	/*
+	 *  Dump pairwise stressor interference matrix
+	 */
+	stress_interference_dump(yaml);
+
+	/*
+	 *  Dump throttling and throughput before and during throttling
+	 */
+	stress_throttle_dump(yaml, stressors_head);
+
+	/*
+	 *  Dump CPU mitigations and kernel entry/exit costs
+	 */
+	stress_mitigations_dump(yaml, stressors_head);
+
+	/*
+	 *  Dump throughput drops found by --anomaly-sigma
+	 */
+	stress_anomaly_dump(yaml);
+
+	/*
+	 *  Dump the seeds, placement and settings for --reproduce
+	 */
+	stress_reproduce_dump(yaml, argc, argv, stressors_head);
+
 	stress_klog_stop(&success);
-	stress_smart_stop();
+	stress_smart_stop(yaml);
+	stress_metrics_stream_stop();
+	stress_throttle_free();
 	stress_vmstat_stop();
 	stress_ftrace_stop();
+	stress_ftrace_dump(yaml);
 	stress_ftrace_free();
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	stress_perf_sample_free();
+#endif
+	stress_placement_free();
+	stress_irq_free();
+	stress_cgroup_free();
+	stress_resctrl_free();
+	stress_hybrid_free();
+	stress_smt_free();
+	stress_scaling_free();
+	stress_interference_free();
+	stress_anomaly_free();
+	stress_reproduce_free();
+	stress_power_free();
+	stress_repeat_free();
+	stress_phase_free();
+	stress_search_free();
 
 	pr_inf("%s run completed in %.2fs%s\n",
 		success ? "successful" : "unsuccessful",
@@ -4340,6 +6639,12 @@ int main(int argc, char **argv, char **envp)
 	/*
 	 *  Tidy up
 	 */
+	stress_lock_report(g_shared->net_port_map.lock, "net_port_map");
+	stress_lock_report(g_shared->warn_once.lock, "warn_once");
+#if defined(STRESS_PERF_STATS) && 	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	stress_lock_report(g_shared->perf.lock, "perf");
+#endif
 	(void)stress_lock_destroy(g_shared->net_port_map.lock);
 	(void)stress_lock_destroy(g_shared->warn_once.lock);
 #if defined(STRESS_PERF_STATS) && 	\
@@ -4351,6 +6656,7 @@ int main(int argc, char **argv, char **envp)
 	stress_stressors_deinit();
 	stress_stressors_free();
 	stress_cache_free();
+	stress_cpu_cache_deinit();
 	stress_shared_unmap();
 	stress_settings_free();
 	stress_temp_path_free();
@@ -4361,10 +6667,13 @@ int main(int argc, char **argv, char **envp)
 	shim_closelog();
 	pr_closelog();
 	stress_yaml_close(yaml);
+	stress_cluster_agent_finish();
 
 	/*
 	 *  Done!
 	 */
+	if (stress_anomaly_aborted())
+		exit(EXIT_THROUGHPUT_ANOMALY);
 	if (!success)
 		exit(EXIT_NOT_SUCCESS);
 	if (!resource_success)
@@ -4390,6 +6699,7 @@ exit_logging_close:
 	pr_closelog();
 
 exit_stressors_free:
+	stress_reproduce_free();
 	stress_stressors_free();
 
 exit_settings_free:
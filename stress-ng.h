@@ -209,6 +209,7 @@ typedef unsigned long int __kernel_ulong_t;
 #define EXIT_SIGNALED			(5)
 #define EXIT_BY_SYS_EXIT		(6)
 #define EXIT_METRICS_UNTRUSTWORTHY	(7)
+#define EXIT_THROUGHPUT_ANOMALY		(8)
 
 /*
  *  Stressor run states
@@ -329,6 +330,19 @@ typedef unsigned long int __kernel_ulong_t;
 #define OPT_FLAGS_TZ_INFO	 STRESS_BIT_ULL(47)	/* Require thermal zone info */
 #define OPT_FLAGS_LOG_LOCKLESS	 STRESS_BIT_ULL(48)	/* --log-lockless */
 #define OPT_FLAGS_SN		 STRESS_BIT_ULL(49)	/* --sn scientific notation */
+#define OPT_FLAGS_LATENCY_HIST	 STRESS_BIT_ULL(50)	/* --latency-hist */
+#define OPT_FLAGS_PREFORK	 STRESS_BIT_ULL(51)	/* --prefork */
+#define OPT_FLAGS_SYNC_START	 STRESS_BIT_ULL(52)	/* --sync-start */
+#define OPT_FLAGS_PERF_TOPDOWN	 STRESS_BIT_ULL(53)	/* --perf-topdown */
+#define OPT_FLAGS_ARENA		 STRESS_BIT_ULL(54)	/* --arena */
+#define OPT_FLAGS_PERF_SAMPLE	 STRESS_BIT_ULL(55)	/* --perf-sample */
+#define OPT_FLAGS_OFFCPU	 STRESS_BIT_ULL(56)	/* --offcpu */
+#define OPT_FLAGS_SCHEDSTAT	 STRESS_BIT_ULL(57)	/* --schedstat */
+#define OPT_FLAGS_POWER		 STRESS_BIT_ULL(58)	/* --power */
+#define OPT_FLAGS_THROTTLE	 STRESS_BIT_ULL(59)	/* --throttle */
+#define OPT_FLAGS_MITIGATIONS	 STRESS_BIT_ULL(60)	/* --mitigations */
+#define OPT_FLAGS_LOG_ASYNC	 STRESS_BIT_ULL(61)	/* --log-async */
+#define OPT_FLAGS_METRICS_INSTANCES STRESS_BIT_ULL(62)	/* --metrics-instances */
 
 #define OPT_FLAGS_MINMAX_MASK		\
 	(OPT_FLAGS_MINIMIZE | OPT_FLAGS_MAXIMIZE)
@@ -414,8 +428,10 @@ typedef struct {
 /* settings for storing opt arg parsed data */
 typedef struct stress_setting {
 	struct stress_setting *next;	/* next setting in list */
+	struct stress_setting *hash_next; /* previous setting in hash bucket */
 	struct stress_stressor_info *proc;
 	char *name;			/* name of setting */
+	uint32_t index;			/* order the setting was made */
 	stress_type_id_t type_id;	/* setting type */
 	bool		global;		/* true if global */
 	union {				/* setting value */
@@ -462,7 +478,15 @@ typedef struct {
 	void *page_wo;			/* mmap'd PROT_WO page */
 } stress_mapped_t;
 
-#define STRESS_MISC_METRICS_MAX	(28)
+#define STRESS_MISC_METRICS_MAX	(96)
+
+/* atomic stressor word, accessed as 8, 16, 32 or 64 bit values */
+typedef union {
+	uint64_t val64[1];
+	uint32_t val32[2];
+	uint16_t val16[4];
+	uint8_t	 val8[8];
+} stress_atomic_word_t;
 
 typedef struct {
 	void *lock;			/* optional lock */
@@ -476,6 +500,64 @@ typedef struct {
 	double value;			/* value of metric */
 } stress_metrics_data_t;
 
+/*
+ *  Log-linear latency histogram, values below STRESS_LATENCY_SUB_BUCKETS
+ *  nanoseconds are recorded exactly, larger values are split into
+ *  STRESS_LATENCY_SUB_BUCKETS linear buckets per power of 2 up to
+ *  2^STRESS_LATENCY_MAX_SHIFT nanoseconds (~18 minutes)
+ */
+#define STRESS_LATENCY_SUB_SHIFT	(4)
+#define STRESS_LATENCY_SUB_BUCKETS	(1U << STRESS_LATENCY_SUB_SHIFT)
+#define STRESS_LATENCY_MAX_SHIFT	(40)
+#define STRESS_LATENCY_BUCKETS		\
+	((STRESS_LATENCY_MAX_SHIFT - STRESS_LATENCY_SUB_SHIFT + 1) * STRESS_LATENCY_SUB_BUCKETS)
+
+/* per stressor instance latency histogram */
+typedef struct {
+	uint64_t count;			/* number of samples */
+	uint64_t total;			/* sum of samples, nanosecs */
+	uint64_t min;			/* minimum sample, nanosecs */
+	uint64_t max;			/* maximum sample, nanosecs */
+	uint64_t bucket[STRESS_LATENCY_BUCKETS]; /* histogram buckets */
+} stress_latency_t;
+
+/* per stressor instance off-CPU time accounting, see core-offcpu.c */
+typedef struct {
+	double wall;			/* wall clock time, secs */
+	double oncpu;			/* time running on a CPU, secs */
+	double runq;			/* time runnable waiting for a CPU, secs */
+	double io;			/* block I/O delay, secs */
+	double sleep;			/* remaining voluntary off-CPU time, secs */
+	uint64_t vcsw;			/* voluntary context switches */
+	uint64_t ivcsw;			/* involuntary context switches */
+	uint64_t majflt;		/* major page faults */
+	bool valid;			/* true if accounted */
+} stress_offcpu_t;
+
+/* per stressor instance scheduler statistics, see core-offcpu.c */
+typedef struct {
+	double wall;			/* wall clock time, secs */
+	double run;			/* time running on a CPU, secs */
+	double wait;			/* time waiting on a runqueue, secs */
+	uint64_t timeslices;		/* number of timeslices run */
+	uint64_t migrations;		/* CPU migrations */
+	bool valid;			/* true if accounted */
+} stress_schedstat_t;
+
+/* per stressor instance open loop pacing state, see core-rate.c */
+typedef struct {
+	double ops_rate;		/* offered bogo ops per second */
+	double period;			/* seconds between bogo ops */
+	double t_start;			/* time of first paced op, 0 = not started */
+	uint64_t base;			/* bogo op counter at t_start */
+	uint64_t counter;		/* bogo op counter at last pace */
+	uint64_t paced;			/* number of paced ops */
+	uint64_t dropped;		/* ops dropped as too far behind */
+	double late_total;		/* total lateness of paced ops */
+	double late_max;		/* maximum lateness of paced ops */
+	uint64_t due_ns;		/* latency clock time released op was due, 0 = none */
+} stress_rate_t;
+
 /* stressor args */
 typedef struct {
 	stress_counter_info_t *ci;	/* counter info struct */
@@ -487,6 +569,8 @@ typedef struct {
 	size_t page_size;		/* page size */
 	stress_mapped_t *mapped;	/* mmap'd pages, addr of g_shared mapped */
 	stress_metrics_data_t *metrics;	/* misc per stressor metrics */
+	stress_latency_t *latency;	/* latency histogram, NULL = disabled */
+	stress_rate_t *rate;		/* open loop pacing, NULL = disabled */
 	const struct stressor_info *info; /* stressor info */
 } stress_args_t;
 
@@ -507,6 +591,7 @@ typedef struct stressor_info {
 	int (*supported)(const char *name);	/* return 0 = supported, -1, not */
 	void (*init)(void);		/* stressor init, NULL = ignore */
 	void (*deinit)(void);		/* stressor de-init, NULL = ignore */
+	void (*yaml)(FILE *yaml);	/* stressor specific yaml metrics, NULL = ignore */
 	void (*set_default)(void);	/* default set-up */
 	void (*set_limit)(uint64_t max);/* set limits */
 	const stress_opt_set_func_t *opt_set_funcs;	/* option functions */
@@ -663,6 +748,13 @@ typedef struct stressor_info {
 #define HOT
 #endif
 
+/* thread local storage */
+#if defined(HAVE_THREAD_LOCAL)
+#define THREAD_LOCAL	__thread
+#else
+#define THREAD_LOCAL
+#endif
+
 /* GCC mlocked data and data section attribute */
 #if ((defined(__GNUC__) && NEED_GNUC(4, 6, 0) ||	\
      (defined(__clang__) && NEED_CLANG(3, 0, 0)))) &&	\
@@ -732,6 +824,8 @@ extern void pr_lock_init(void);
 extern void pr_lock(void);
 extern void pr_unlock(void);
 extern void pr_lock_exited(const pid_t pid);
+extern void pr_async_start(const uint32_t num_instances);
+extern void pr_async_stop(void);
 
 /* Memory size constants */
 #define KB			(1ULL << 10)
@@ -820,6 +914,7 @@ extern WARN_UNUSED void *stress_lock_create(void);
 extern int stress_lock_destroy(void *lock_handle);
 extern int stress_lock_acquire(void *lock_handle);
 extern int stress_lock_release(void *lock_handle);
+extern void stress_lock_report(void *lock_handle, const char *name);
 
 /* stress process prototype */
 typedef int (*stress_func_t)(const stress_args_t *args);
@@ -836,7 +931,7 @@ typedef int (*stress_func_t)(const stress_args_t *args);
 typedef struct {
 	uint64_t counter;		/* perf counter */
 	int	 fd;			/* perf per counter fd */
-	uint8_t	 padding[4];		/* padding */
+	uint32_t running_ppm;		/* time running / time enabled, ppm */
 } stress_perf_stat_t;
 
 /* per stressor perf info */
@@ -870,20 +965,33 @@ typedef struct {
 } stress_tz_t;
 #endif
 
-/* Per stressor statistics and accounting info */
+/*
+ *  Per stressor statistics and accounting info, the bogo-op
+ *  counter info is updated on every bogo-op so it is kept in
+ *  its own cache line away from the colder stats fields and
+ *  the counters of neighbouring stressor instances
+ */
 typedef struct {
-	stress_counter_info_t ci;	/* counter info */
-	double start;			/* wall clock start time */
+	stress_counter_info_t ci ALIGN_CACHELINE; /* counter info */
+	double start ALIGN_CACHELINE;	/* wall clock start time */
 	double finish;			/* wall clock stop time */
 	pid_t pid;			/* stressor pid */
+	int pidfd;			/* parent's pidfd of stressor, -1 = none */
 	bool signalled;			/* set true if signalled with a kill */
 #if defined(STRESS_PERF_STATS)
-	stress_perf_t sp;		/* perf counters */
+	stress_perf_t *sp;		/* perf counters, NULL = disabled */
 #endif
 #if defined(STRESS_THERMAL_ZONES)
-	stress_tz_t tz;			/* thermal zones */
+	stress_tz_t *tz;		/* thermal zones, NULL = disabled */
 #endif
 	stress_checksum_t *checksum;	/* pointer to checksum data */
+	stress_latency_t *latency;	/* latency histogram, NULL = disabled */
+	stress_offcpu_t offcpu;		/* off-CPU time accounting */
+	stress_schedstat_t schedstat;	/* scheduler statistics */
+	int32_t cpu_begin;		/* CPU instance started on */
+	int32_t cpu_end;		/* CPU instance finished on */
+	uint32_t seed_w;		/* mwc w seed at the stressor start */
+	uint32_t seed_z;		/* mwc z seed at the stressor start */
 	stress_metrics_data_t metrics[STRESS_MISC_METRICS_MAX];
 #if defined(HAVE_GETRUSAGE)
 	double rusage_utime;		/* rusage user time */
@@ -892,10 +1000,19 @@ typedef struct {
 #else
 	struct tms tms;			/* run time stats of process */
 #endif
+	struct {
+		double begin;		/* start of --warmup/--cooldown window */
+		double end;		/* end of measurement window */
+		uint64_t counter_begin;	/* bogo-ops at start of window */
+		uint64_t counter_end;	/* bogo-ops at end of window */
+	} window;
 	uint8_t padding[6];		/* padding */
 } stress_stats_t;
 
 #define	STRESS_WARN_HASH_MAX		(128)
+#define STRESS_MEMLAT_STEPS		(8)
+
+#define STRESS_SHARED_HEAP_CLASSES	(9)	/* 16 .. 4096 byte size classes */
 
 typedef struct shared_heap {
 	void *str_list_head;		/* list of heap strings */
@@ -903,6 +1020,8 @@ typedef struct shared_heap {
 	void *heap;			/* mmap'd heap */
 	size_t heap_size;		/* heap size */
 	size_t offset;			/* next free offset in current slap */
+	void *free_list[STRESS_SHARED_HEAP_CLASSES]; /* per size class free blocks */
+	void *large_list;		/* free blocks larger than the size classes */
 	bool out_of_memory;		/* true if allocation failed */
 } shared_heap_t;
 
@@ -934,16 +1053,11 @@ typedef struct {
 		void *lock;				/* protection lock */
 	} warn_once;
 	uint32_t warn_once_flags;			/* Warn once flags */
-	union {
-		uint64_t val64[1] ALIGN64;
-		uint32_t val32[2] ALIGN64;
-		uint16_t val16[4] ALIGN64;
-		uint8_t	 val8[8] ALIGN64;
-	} atomic;					/* Shared atomic temp vars */
+	stress_atomic_word_t atomic[8] ALIGN64;		/* Shared atomic temp vars, one cache line */
 	struct {
-		/* futexes must be aligned to avoid -EINVAL */
-		uint32_t futex[STRESS_PROCS_MAX] ALIGNED(4);/* Shared futexes */
-		uint64_t timeout[STRESS_PROCS_MAX];	/* Shared futex timeouts */
+		uint32_t *futex;			/* Shared futexes, one per instance */
+		uint64_t *timeout;			/* Shared futex timeouts */
+		size_t length;				/* size of futex mapping */
 	} futex;
 #if defined(HAVE_SEM_SYSV) && 	\
     defined(HAVE_KEY_T)
@@ -974,6 +1088,16 @@ typedef struct {
 	uint8_t  str_shared[STR_SHARED_SIZE];		/* str copying buffer */
 	stress_checksum_t *checksums;			/* per stressor counter checksum */
 	size_t	checksums_length;			/* size of checksums mapping */
+	stress_latency_t *latencies;			/* per stressor latency histograms */
+	size_t	latencies_length;			/* size of latencies mapping */
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t *perfs;				/* per stressor perf counters */
+	size_t	perfs_length;				/* size of perfs mapping */
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	stress_tz_t *tzs;				/* per stressor thermal zones */
+	size_t	tzs_length;				/* size of tzs mapping */
+#endif
 	struct {
 		uint8_t allocated[65536 / sizeof(uint8_t)];	/* allocation bitmap */
 		void *lock;				/* lock for allocator */
@@ -981,6 +1105,14 @@ typedef struct {
 	struct {
 		uint32_t ready;				/* incremented when rawsock stressor is ready */
 	} rawsock;
+	struct {
+		/* futexes must be aligned to avoid -EINVAL */
+		uint32_t released ALIGNED(4);		/* non-zero when instances may start */
+	} start_barrier;
+	struct {
+		double start_time ALIGNED(8);		/* loaded latency step time base */
+		uint64_t bytes[STRESS_MEMLAT_STEPS];	/* bytes moved by load generators per step */
+	} memlat;
 	stress_stats_t stats[];				/* Shared statistics */
 } stress_shared_t;
 
@@ -1032,6 +1164,9 @@ typedef enum {
 	OPT_access,
 	OPT_access_ops,
 
+	OPT_adaptive,
+	OPT_adaptive_min,
+
 	OPT_affinity,
 	OPT_affinity_delay,
 	OPT_affinity_ops,
@@ -1056,11 +1191,21 @@ typedef enum {
 	OPT_alarm,
 	OPT_alarm_ops,
 
+	OPT_anomaly_abort,
+	OPT_anomaly_ms,
+	OPT_anomaly_sigma,
+	OPT_autotune,
+	OPT_autotune_profile,
+
 	OPT_apparmor,
 	OPT_apparmor_ops,
 
+	OPT_arena,
+
 	OPT_atomic,
 	OPT_atomic_ops,
+	OPT_atomic_contention,
+	OPT_atomic_procs,
 
 	OPT_bad_altstack,
 	OPT_bad_altstack_ops,
@@ -1069,6 +1214,7 @@ typedef enum {
 	OPT_bad_ioctl_ops,
 
 	OPT_branch,
+	OPT_branch_method,
 	OPT_branch_ops,
 
 	OPT_brk,
@@ -1077,6 +1223,7 @@ typedef enum {
 	OPT_brk_notouch,
 
 	OPT_bsearch,
+	OPT_bsearch_method,
 	OPT_bsearch_ops,
 	OPT_bsearch_size,
 
@@ -1089,8 +1236,19 @@ typedef enum {
 	OPT_binderfs,
 	OPT_binderfs_ops,
 
+	OPT_cgroup,
+	OPT_cgroup_cpu_max,
+	OPT_cgroup_cpuset,
+	OPT_cgroup_io_max,
+	OPT_cgroup_memory_high,
+	OPT_cgroup_memory_max,
+
 	OPT_class,
 
+	OPT_cluster,
+	OPT_cluster_agent,
+	OPT_cluster_key,
+
 	OPT_cache_ops,
 	OPT_cache_clflushopt,
 	OPT_cache_cldemote,
@@ -1099,6 +1257,7 @@ typedef enum {
 	OPT_cache_flush,
 	OPT_cache_fence,
 	OPT_cache_level,
+	OPT_cache_probe,
 	OPT_cache_sfence,
 	OPT_cache_no_affinity,
 	OPT_cache_prefetch,
@@ -1107,6 +1266,7 @@ typedef enum {
 	OPT_cacheline,
 	OPT_cacheline_ops,
 	OPT_cacheline_affinity,
+	OPT_cacheline_matrix,
 	OPT_cacheline_method,
 
 	OPT_cap,
@@ -1135,20 +1295,38 @@ typedef enum {
 	OPT_clone_ops,
 	OPT_clone_max,
 
+	OPT_cmap,
+	OPT_cmap_ops,
+	OPT_cmap_keys,
+	OPT_cmap_method,
+	OPT_cmap_reads,
+	OPT_cmap_threads,
+
 	OPT_close,
 	OPT_close_ops,
 
 	OPT_context,
 	OPT_context_ops,
+	OPT_context_coroutines,
+	OPT_context_method,
+
+	OPT_compare,
+	OPT_compare_threshold,
+
+	OPT_cooldown,
+	OPT_core_type,
 
 	OPT_copy_file,
 	OPT_copy_file_ops,
 	OPT_copy_file_bytes,
+	OPT_copy_file_method,
 
 	OPT_cpu_ops,
 	OPT_cpu_method,
 	OPT_cpu_load_slice,
 	OPT_cpu_old_metrics,
+	OPT_cpu_calibrate,
+	OPT_cpu_isa,
 
 	OPT_cpu_online,
 	OPT_cpu_online_ops,
@@ -1157,10 +1335,17 @@ typedef enum {
 	OPT_crypt,
 	OPT_crypt_ops,
 
+	OPT_cryptobench,
+	OPT_cryptobench_ops,
+	OPT_cryptobench_alg,
+	OPT_cryptobench_backend,
+
 	OPT_cyclic,
 	OPT_cyclic_ops,
 	OPT_cyclic_dist,
+	OPT_cyclic_load,
 	OPT_cyclic_method,
+	OPT_cyclic_percpu,
 	OPT_cyclic_policy,
 	OPT_cyclic_prio,
 	OPT_cyclic_samples,
@@ -1189,6 +1374,7 @@ typedef enum {
 
 	OPT_dev_shm,
 	OPT_dev_shm_ops,
+	OPT_dev_shm_bench,
 
 	OPT_dir,
 	OPT_dir_ops,
@@ -1204,6 +1390,15 @@ typedef enum {
 	OPT_dirmany,
 	OPT_dirmany_ops,
 	OPT_dirmany_bytes,
+	OPT_dirmany_max,
+	OPT_dirmany_mdtest,
+	OPT_dirmany_threads,
+
+	OPT_dirty,
+	OPT_dirty_ops,
+	OPT_dirty_bytes,
+	OPT_dirty_method,
+	OPT_dirty_rate,
 
 	OPT_dnotify,
 	OPT_dnotify_ops,
@@ -1225,9 +1420,14 @@ typedef enum {
 
 	OPT_epoll,
 	OPT_epoll_ops,
+	OPT_epoll_acceptor,
+	OPT_epoll_conns,
 	OPT_epoll_port,
 	OPT_epoll_domain,
+	OPT_epoll_req_size,
+	OPT_epoll_resp_size,
 	OPT_epoll_sockets,
+	OPT_epoll_trigger,
 
 	OPT_eventfd,
 	OPT_eventfd_ops,
@@ -1248,16 +1448,30 @@ typedef enum {
 
 	OPT_fanotify,
 	OPT_fanotify_ops,
+	OPT_fanotify_dirs,
+	OPT_fanotify_scale,
+	OPT_fanotify_writers,
 
 	OPT_far_branch,
 	OPT_far_branch_ops,
+	OPT_far_branch_sweep,
 
 	OPT_fault,
 	OPT_fault_ops,
 
+	OPT_fault_scale,
+	OPT_fault_scale_backing,
+	OPT_fault_scale_ops,
+	OPT_fault_scale_populate,
+	OPT_fault_scale_thp,
+	OPT_fault_scale_threads,
+
 	OPT_fcntl,
 	OPT_fcntl_ops,
 
+	OPT_fence,
+	OPT_fence_ops,
+
 	OPT_fiemap,
 	OPT_fiemap_ops,
 	OPT_fiemap_bytes,
@@ -1274,8 +1488,18 @@ typedef enum {
 	OPT_filename_ops,
 	OPT_filename_opts,
 
+	OPT_filescan,
+	OPT_filescan_ops,
+	OPT_filescan_bytes,
+	OPT_filescan_chunk,
+	OPT_filescan_method,
+	OPT_filescan_threads,
+
 	OPT_flock,
 	OPT_flock_ops,
+	OPT_flock_files,
+	OPT_flock_procs,
+	OPT_flock_scale,
 
 	OPT_flushcache,
 	OPT_flushcache_ops,
@@ -1290,6 +1514,7 @@ typedef enum {
 	OPT_forkheavy_allocs,
 
 	OPT_fp,
+	OPT_fp_bench,
 	OPT_fp_method,
 	OPT_fp_ops,
 
@@ -1307,6 +1532,8 @@ typedef enum {
 	OPT_fstat_dir,
 
 	OPT_ftrace,
+	OPT_ftrace_pid,
+	OPT_ftrace_top,
 
 	OPT_full,
 	OPT_full_ops,
@@ -1321,6 +1548,8 @@ typedef enum {
 
 	OPT_futex,
 	OPT_futex_ops,
+	OPT_futex_bench,
+	OPT_futex_waiters,
 
 	OPT_get,
 	OPT_get_ops,
@@ -1343,21 +1572,32 @@ typedef enum {
 	OPT_gpu_size,
 	OPT_gpu_xsize,
 	OPT_gpu_ysize,
+	OPT_gpu_compute_bytes,
+	OPT_gpu_fma,
+	OPT_gpu_mode,
 
 	OPT_handle,
 	OPT_handle_ops,
 
 	OPT_hash,
 	OPT_hash_ops,
+	OPT_hash_bulk,
 	OPT_hash_method,
 
+	OPT_hashtable,
+	OPT_hashtable_ops,
+	OPT_hashtable_method,
+	OPT_hashtable_size,
+
 	OPT_hdd_bytes,
 	OPT_hdd_write_size,
 	OPT_hdd_ops,
 	OPT_hdd_opts,
+	OPT_hdd_qd_sweep,
 
 	OPT_heapsort,
 	OPT_heapsort_ops,
+	OPT_heapsort_dists,
 	OPT_heapsort_integers,
 
 	OPT_hrtimers,
@@ -1384,10 +1624,16 @@ typedef enum {
 
 	OPT_inotify,
 	OPT_inotify_ops,
+	OPT_inotify_dirs,
+	OPT_inotify_scale,
+	OPT_inotify_writers,
+
+	OPT_interference,
 
 	OPT_iomix,
 	OPT_iomix_bytes,
 	OPT_iomix_ops,
+	OPT_iomix_profile,
 
 	OPT_ioport,
 	OPT_ioport_ops,
@@ -1397,6 +1643,7 @@ typedef enum {
 	OPT_ionice_level,
 
 	OPT_ioprio,
+	OPT_ioprio_bench,
 	OPT_ioprio_ops,
 
 	OPT_iostat,
@@ -1404,7 +1651,12 @@ typedef enum {
 	OPT_io_ops,
 
 	OPT_io_uring,
+	OPT_io_uring_depth,
+	OPT_io_uring_fixed,
+	OPT_io_uring_iopoll,
 	OPT_io_uring_ops,
+	OPT_io_uring_rw,
+	OPT_io_uring_sqpoll,
 
 	OPT_ipsec_mb,
 	OPT_ipsec_mb_ops,
@@ -1412,6 +1664,9 @@ typedef enum {
 	OPT_ipsec_mb_jobs,
 	OPT_ipsec_mb_method,
 
+	OPT_irq_dev,
+	OPT_irq_placement,
+
 	OPT_itimer,
 	OPT_itimer_ops,
 	OPT_itimer_freq,
@@ -1423,10 +1678,15 @@ typedef enum {
 	OPT_jpeg_image,
 	OPT_jpeg_width,
 	OPT_jpeg_quality,
+	OPT_jpeg_bench,
+	OPT_jpeg_nosimd,
 
 	OPT_judy,
 	OPT_judy_ops,
 	OPT_judy_size,
+	OPT_judy_bench,
+	OPT_judy_dist,
+	OPT_judy_threads,
 
 	OPT_kcmp,
 	OPT_kcmp_ops,
@@ -1436,6 +1696,12 @@ typedef enum {
 	OPT_key,
 	OPT_key_ops,
 
+	OPT_keysort,
+	OPT_keysort_ops,
+	OPT_keysort_method,
+	OPT_keysort_size,
+	OPT_keysort_threads,
+
 	OPT_kill,
 	OPT_kill_ops,
 
@@ -1444,8 +1710,14 @@ typedef enum {
 
 	OPT_klog_check,
 
+	OPT_ktls,
+	OPT_ktls_ops,
+	OPT_ktls_bytes,
+	OPT_ktls_mode,
+
 	OPT_kvm,
 	OPT_kvm_ops,
+	OPT_kvm_method,
 
 	OPT_l1cache,
 	OPT_l1cache_line_size,
@@ -1458,6 +1730,8 @@ typedef enum {
 	OPT_landlock,
 	OPT_landlock_ops,
 
+	OPT_latency_hist,
+
 	OPT_lease,
 	OPT_lease_ops,
 	OPT_lease_breakers,
@@ -1470,6 +1744,7 @@ typedef enum {
 	OPT_list_ops,
 	OPT_list_method,
 	OPT_list_size,
+	OPT_list_bench,
 
 	OPT_llc_affinity,
 	OPT_llc_affinity_ops,
@@ -1488,10 +1763,19 @@ typedef enum {
 	OPT_lockf,
 	OPT_lockf_ops,
 	OPT_lockf_nonblock,
+	OPT_lockf_files,
+	OPT_lockf_overlap,
+	OPT_lockf_procs,
+	OPT_lockf_scale,
 
 	OPT_lockofd,
 	OPT_lockofd_ops,
+	OPT_lockofd_files,
+	OPT_lockofd_overlap,
+	OPT_lockofd_procs,
+	OPT_lockofd_scale,
 
+	OPT_log_async,
 	OPT_log_brief,
 	OPT_log_file,
 	OPT_log_lockless,
@@ -1508,6 +1792,8 @@ typedef enum {
 
 	OPT_madvise,
 	OPT_madvise_ops,
+	OPT_madvise_bench,
+	OPT_madvise_bench_bytes,
 
 	OPT_mbind,
 
@@ -1516,14 +1802,17 @@ typedef enum {
 	OPT_malloc_bytes,
 	OPT_malloc_max,
 	OPT_malloc_pthreads,
+	OPT_malloc_sizes,
 	OPT_malloc_threshold,
 	OPT_malloc_touch,
+	OPT_malloc_workload,
 	OPT_malloc_zerofree,
 
 	OPT_matrix,
 	OPT_matrix_ops,
 	OPT_matrix_size,
 	OPT_matrix_method,
+	OPT_matrix_threads,
 	OPT_matrix_yx,
 
 	OPT_matrix_3d,
@@ -1544,6 +1833,7 @@ typedef enum {
 	OPT_memcpy,
 	OPT_memcpy_ops,
 	OPT_memcpy_method,
+	OPT_memcpy_sweep,
 
 	OPT_memfd,
 	OPT_memfd_ops,
@@ -1553,22 +1843,41 @@ typedef enum {
 	OPT_memhotplug,
 	OPT_memhotplug_ops,
 
+	OPT_memlat,
+	OPT_memlat_loaded,
+	OPT_memlat_max_size,
+	OPT_memlat_ops,
+	OPT_memlat_step_ms,
+
 	OPT_memrate,
+	OPT_memrate_backing,
 	OPT_memrate_bytes,
 	OPT_memrate_flush,
 	OPT_memrate_ops,
 	OPT_memrate_rd_mbs,
+	OPT_memrate_target_mbs,
+	OPT_memrate_target_op,
 	OPT_memrate_wr_mbs,
 
 	OPT_memthrash,
 	OPT_memthrash_ops,
 	OPT_memthrash_method,
 
+	OPT_memtier,
+	OPT_memtier_ops,
+	OPT_memtier_bytes,
+	OPT_memtier_hot,
+
 	OPT_mergesort,
 	OPT_mergesort_ops,
+	OPT_mergesort_dists,
 	OPT_mergesort_integers,
 
 	OPT_metrics_brief,
+	OPT_metrics_instances,
+	OPT_metrics_stream,
+	OPT_metrics_stream_format,
+	OPT_metrics_stream_ms,
 
 	OPT_mincore,
 	OPT_mincore_ops,
@@ -1578,6 +1887,8 @@ typedef enum {
 	OPT_misaligned_ops,
 	OPT_misaligned_method,
 
+	OPT_mitigations,
+
 	OPT_mknod,
 	OPT_mknod_ops,
 
@@ -1615,6 +1926,8 @@ typedef enum {
 
 	OPT_mmapmany,
 	OPT_mmapmany_ops,
+	OPT_mmapmany_bench,
+	OPT_mmapmany_bench_threads,
 
 	OPT_module,
 	OPT_module_name,
@@ -1632,6 +1945,7 @@ typedef enum {
 
 	OPT_mremap,
 	OPT_mremap_ops,
+	OPT_mremap_bench,
 	OPT_mremap_bytes,
 	OPT_mremap_mlock,
 
@@ -1685,6 +1999,8 @@ typedef enum {
 	OPT_numa,
 	OPT_numa_ops,
 
+	OPT_offcpu,
+
 	OPT_oomable,
 	OPT_oom_avoid,
 	OPT_oom_avoid_bytes,
@@ -1706,14 +2022,25 @@ typedef enum {
 	OPT_pagemove,
 	OPT_pagemove_ops,
 	OPT_pagemove_bytes,
+	OPT_pagemove_bench,
 
 	OPT_pageswap,
 	OPT_pageswap_ops,
 
+	OPT_pathwalk,
+	OPT_pathwalk_depth,
+	OPT_pathwalk_method,
+	OPT_pathwalk_ops,
+	OPT_pathwalk_threads,
+
 	OPT_pci,
 	OPT_pci_ops,
 
 	OPT_perf_stats,
+	OPT_perf_events,
+	OPT_perf_sample,
+	OPT_perf_sample_top,
+	OPT_perf_topdown,
 
 	OPT_personality,
 	OPT_personality_ops,
@@ -1733,6 +2060,7 @@ typedef enum {
 	OPT_pipe_ops,
 	OPT_pipe_size,
 	OPT_pipe_data_size,
+	OPT_pipe_sweep,
 
 	OPT_pipeherd,
 	OPT_pipeherd_ops,
@@ -1741,18 +2069,31 @@ typedef enum {
 	OPT_pkey,
 	OPT_pkey_ops,
 
+	OPT_pktring,
+	OPT_pktring_ops,
+	OPT_pktring_if,
+	OPT_pktring_size,
+
+	OPT_placement,
+
 	OPT_plugin,
 	OPT_plugin_ops,
+	OPT_plugin_batch,
 	OPT_plugin_method,
 	OPT_plugin_so,
 
 	OPT_poll_ops,
 	OPT_poll_fds,
 
+	OPT_power,
+
+	OPT_prefork,
+
 	OPT_prefetch,
 	OPT_prefetch_l3_size,
 	OPT_prefetch_method,
 	OPT_prefetch_ops,
+	OPT_prefetch_sweep,
 
 	OPT_prctl,
 	OPT_prctl_ops,
@@ -1760,9 +2101,16 @@ typedef enum {
 	OPT_priv_instr,
 	OPT_priv_instr_ops,
 
+	OPT_proc_create,
+	OPT_proc_create_method,
+	OPT_proc_create_ops,
+	OPT_proc_create_rss_max,
+
 	OPT_procfs,
 	OPT_procfs_ops,
 
+	OPT_psistat,
+
 	OPT_pthread,
 	OPT_pthread_ops,
 	OPT_pthread_max,
@@ -1776,6 +2124,7 @@ typedef enum {
 
 	OPT_qsort,
 	OPT_qsort_ops,
+	OPT_qsort_dists,
 	OPT_qsort_integers,
 	OPT_qsort_method,
 
@@ -1798,11 +2147,13 @@ typedef enum {
 
 	OPT_ramfs,
 	OPT_ramfs_ops,
+	OPT_ramfs_bench,
 	OPT_ramfs_fill,
 	OPT_ramfs_size,
 
 	OPT_rawdev,
 	OPT_rawdev_method,
+	OPT_rawdev_qd_sweep,
 	OPT_rawdev_ops,
 
 	OPT_rawpkt,
@@ -1826,10 +2177,15 @@ typedef enum {
 	OPT_readahead,
 	OPT_readahead_ops,
 	OPT_readahead_bytes,
+	OPT_readahead_sweep,
 
 	OPT_reboot,
 	OPT_reboot_ops,
 
+	OPT_reclaim,
+	OPT_reclaim_bytes,
+	OPT_reclaim_ops,
+
 	OPT_regs,
 	OPT_regs_ops,
 
@@ -1838,6 +2194,23 @@ typedef enum {
 
 	OPT_rename_ops,
 
+	OPT_replay,
+	OPT_replay_ops,
+	OPT_replay_file,
+	OPT_replay_mode,
+	OPT_replay_port,
+	OPT_replay_speed,
+	OPT_replay_threads,
+
+	OPT_rate,
+	OPT_repeat,
+	OPT_reproduce,
+	OPT_resctrl,
+	OPT_resctrl_cat,
+	OPT_resctrl_sweep,
+	OPT_resctrl_victim,
+	OPT_results_bin,
+
 	OPT_resched,
 	OPT_resched_ops,
 
@@ -1867,10 +2240,13 @@ typedef enum {
 
 	OPT_rseq,
 	OPT_rseq_ops,
+	OPT_rseq_percpu,
 
 	OPT_rtc,
 	OPT_rtc_ops,
 
+	OPT_scaling,
+
 	OPT_sched,
 	OPT_sched_prio,
 
@@ -1882,6 +2258,10 @@ typedef enum {
 	OPT_sched_deadline,
 	OPT_sched_reclaim,
 
+	OPT_schedstat,
+
+	OPT_score,
+
 	OPT_sctp,
 	OPT_sctp_ops,
 	OPT_sctp_domain,
@@ -1898,6 +2278,12 @@ typedef enum {
 	OPT_secretmem,
 	OPT_secretmem_ops,
 
+	OPT_search,
+	OPT_search_ghz_drop,
+	OPT_search_max,
+	OPT_search_p99,
+	OPT_search_temp,
+
 	OPT_seed,
 
 	OPT_seek,
@@ -1925,17 +2311,28 @@ typedef enum {
 
 	OPT_shellsort,
 	OPT_shellsort_ops,
+	OPT_shellsort_dists,
 	OPT_shellsort_size,
 
 	OPT_shm,
 	OPT_shm_ops,
 	OPT_shm_bytes,
 	OPT_shm_objects,
+	OPT_shm_scale,
+	OPT_shm_scale_procs,
 
 	OPT_shm_sysv,
 	OPT_shm_sysv_ops,
 	OPT_shm_sysv_bytes,
 	OPT_shm_sysv_segments,
+	OPT_shm_sysv_scale,
+	OPT_shm_sysv_scale_procs,
+
+	OPT_shmring,
+	OPT_shmring_ops,
+	OPT_shmring_mode,
+	OPT_shmring_procs,
+	OPT_shmring_slots,
 
 	OPT_sequential,
 
@@ -1956,6 +2353,7 @@ typedef enum {
 
 	OPT_signal,
 	OPT_signal_ops,
+	OPT_signal_bench,
 
 	OPT_signest,
 	OPT_signest_ops,
@@ -1984,6 +2382,9 @@ typedef enum {
 	OPT_skiplist,
 	OPT_skiplist_ops,
 	OPT_skiplist_size,
+	OPT_skiplist_bench,
+	OPT_skiplist_dist,
+	OPT_skiplist_threads,
 
 	OPT_skip_silent,
 
@@ -1996,15 +2397,22 @@ typedef enum {
 	OPT_smi,
 	OPT_smi_ops,
 
+	OPT_smt_interference,
+
 	OPT_sn,
 
 	OPT_sock_ops,
 	OPT_sock_domain,
 	OPT_sock_if,
+	OPT_sock_mptcp_bench,
+	OPT_sock_mptcp_subflows,
 	OPT_sock_nodelay,
 	OPT_sock_opts,
+	OPT_sock_peer,
+	OPT_sock_peers,
 	OPT_sock_port,
 	OPT_sock_protocol,
+	OPT_sock_server,
 	OPT_sock_type,
 	OPT_sock_zerocopy,
 
@@ -2020,9 +2428,12 @@ typedef enum {
 	OPT_sockfd_port,
 
 	OPT_sockmany,
+	OPT_sockmany_acceptors,
+	OPT_sockmany_conns,
 	OPT_sockmany_if,
 	OPT_sockmany_ops,
 	OPT_sockmany_port,
+	OPT_sockmany_scale,
 
 	OPT_sockpair,
 	OPT_sockpair_ops,
@@ -2031,6 +2442,9 @@ typedef enum {
 	OPT_softlockup_ops,
 
 	OPT_swap,
+	OPT_swap_bench,
+	OPT_swap_bench_bytes,
+	OPT_swap_bench_fill,
 	OPT_swap_ops,
 
 	OPT_switch_ops,
@@ -2046,10 +2460,25 @@ typedef enum {
 	OPT_sparsematrix_method,
 	OPT_sparsematrix_size,
 
+	OPT_spinlock,
+	OPT_spinlock_ops,
+	OPT_spinlock_cs,
+	OPT_spinlock_method,
+	OPT_spinlock_sweep,
+	OPT_spinlock_threads,
+
 	OPT_splice,
 	OPT_splice_ops,
 	OPT_splice_bytes,
 
+	OPT_spmv,
+	OPT_spmv_ops,
+	OPT_spmv_method,
+	OPT_spmv_nnz,
+	OPT_spmv_pattern,
+	OPT_spmv_size,
+	OPT_spmv_threads,
+
 	OPT_stack,
 	OPT_stack_ops,
 	OPT_stack_fill,
@@ -2064,13 +2493,20 @@ typedef enum {
 
 	OPT_str,
 	OPT_str_ops,
+	OPT_str_bench,
+	OPT_str_lengths,
 	OPT_str_method,
 
 	OPT_stream,
 	OPT_stream_ops,
+	OPT_stream_backing,
 	OPT_stream_index,
 	OPT_stream_l3_size,
 	OPT_stream_madvise,
+	OPT_stream_numa,
+	OPT_stream_roofline,
+	OPT_stream_store,
+	OPT_stream_threads,
 
 	OPT_stressors,
 
@@ -2082,6 +2518,8 @@ typedef enum {
 	OPT_sync_file_ops,
 	OPT_sync_file_bytes,
 
+	OPT_sync_start,
+
 	OPT_syncload,
 	OPT_syncload_ops,
 	OPT_syncload_msbusy,
@@ -2090,9 +2528,15 @@ typedef enum {
 	OPT_sysbadaddr,
 	OPT_sysbadaddr_ops,
 
+	OPT_sysbatch,
+	OPT_sysbatch_ops,
+	OPT_sysbatch_op,
+
 	OPT_syscall,
 	OPT_syscall_ops,
+	OPT_syscall_baseline,
 	OPT_syscall_method,
+	OPT_syscall_table,
 
 	OPT_sysinfo,
 	OPT_sysinfo_ops,
@@ -2116,6 +2560,7 @@ typedef enum {
 	OPT_thermal_zones,
 
 	OPT_thrash,
+	OPT_throttle,
 
 	OPT_timer_slack,
 
@@ -2128,6 +2573,7 @@ typedef enum {
 	OPT_timerfd_fds,
 	OPT_timerfd_freq,
 	OPT_timerfd_rand,
+	OPT_timerfd_scale,
 
 	OPT_times,
 
@@ -2138,6 +2584,7 @@ typedef enum {
 
 	OPT_tmpfs,
 	OPT_tmpfs_ops,
+	OPT_tmpfs_bench,
 	OPT_tmpfs_mmap_async,
 	OPT_tmpfs_mmap_file,
 
@@ -2149,7 +2596,9 @@ typedef enum {
 	OPT_tree,
 	OPT_tree_ops,
 	OPT_tree_method,
+	OPT_tree_node_size,
 	OPT_tree_size,
+	OPT_tree_sweep,
 
 	OPT_tsc,
 	OPT_tsc_ops,
@@ -2160,7 +2609,11 @@ typedef enum {
 	OPT_tsearch_size,
 
 	OPT_tun,
+	OPT_tun_batch,
+	OPT_tun_bench,
+	OPT_tun_bench_size,
 	OPT_tun_ops,
+	OPT_tun_queues,
 	OPT_tun_tap,
 
 	OPT_udp,
@@ -2170,6 +2623,8 @@ typedef enum {
 	OPT_udp_lite,
 	OPT_udp_gro,
 	OPT_udp_if,
+	OPT_udp_mode,
+	OPT_udp_busy_poll,
 
 	OPT_udp_flood,
 	OPT_udp_flood_ops,
@@ -2190,6 +2645,9 @@ typedef enum {
 	OPT_userfaultfd,
 	OPT_userfaultfd_ops,
 	OPT_userfaultfd_bytes,
+	OPT_userfaultfd_handlers,
+	OPT_userfaultfd_mode,
+	OPT_userfaultfd_threads,
 
 	OPT_usersyscall,
 	OPT_usersyscall_ops,
@@ -2203,13 +2661,19 @@ typedef enum {
 	OPT_vdso_func,
 
 	OPT_vecfp,
+	OPT_vecfp_bench,
 	OPT_vecfp_ops,
 	OPT_vecfp_method,
 
+	OPT_vecfreq,
+	OPT_vecfreq_ms,
+	OPT_vecfreq_ops,
+
 	OPT_vecmath,
 	OPT_vecmath_ops,
 
 	OPT_vecshuf,
+	OPT_vecshuf_isa,
 	OPT_vecshuf_ops,
 	OPT_vecshuf_method,
 
@@ -2230,6 +2694,7 @@ typedef enum {
 	OPT_vforkmany_ops,
 	OPT_vforkmany_vm,
 
+	OPT_vm_backing,
 	OPT_vm_bytes,
 	OPT_vm_hang,
 	OPT_vm_keep,
@@ -2238,6 +2703,7 @@ typedef enum {
 	OPT_vm_ops,
 	OPT_vm_madvise,
 	OPT_vm_method,
+	OPT_vm_threads,
 
 	OPT_vm_addr,
 	OPT_vm_addr_method,
@@ -2262,6 +2728,20 @@ typedef enum {
 	OPT_waitcpu,
 	OPT_waitcpu_ops,
 
+	OPT_wakelat,
+	OPT_wakelat_ops,
+	OPT_wakelat_distance,
+	OPT_wakelat_method,
+	OPT_wakelat_policy,
+
+	OPT_wal,
+	OPT_wal_ops,
+	OPT_wal_method,
+	OPT_wal_record,
+	OPT_wal_threads,
+
+	OPT_warmup,
+
 	OPT_watchdog,
 	OPT_watchdog_ops,
 
@@ -2269,6 +2749,12 @@ typedef enum {
 	OPT_wcs_ops,
 	OPT_wcs_method,
 
+	OPT_worksteal,
+	OPT_worksteal_ops,
+	OPT_worksteal_method,
+	OPT_worksteal_sweep,
+	OPT_worksteal_threads,
+
 	OPT_x86cpuid,
 	OPT_x86cpuid_ops,
 
@@ -2278,6 +2764,12 @@ typedef enum {
 
 	OPT_xattr,
 	OPT_xattr_ops,
+	OPT_xattr_count,
+	OPT_xattr_namespace,
+	OPT_xattr_readers,
+	OPT_xattr_scale,
+	OPT_xattr_size,
+	OPT_xattr_writers,
 
 	OPT_yield_ops,
 
@@ -2286,12 +2778,14 @@ typedef enum {
 
 	OPT_zlib,
 	OPT_zlib_ops,
+	OPT_zlib_codec,
 	OPT_zlib_level,
 	OPT_zlib_mem_level,
 	OPT_zlib_method,
 	OPT_zlib_window_bits,
 	OPT_zlib_stream_bytes,
 	OPT_zlib_strategy,
+	OPT_zlib_threads,
 
 	OPT_zombie,
 	OPT_zombie_ops,
@@ -2316,6 +2810,7 @@ typedef struct stress_stressor_info {
 	int32_t started_instances;	/* count of started instances */
 	int32_t num_instances;		/* number of instances per stressor */
 	uint64_t bogo_ops;		/* number of bogo ops */
+	double ops_rate;		/* --rate bogo ops per second, 0 = flat out */
 } stress_stressor_t;
 
 /* Pointer to current running stressor proc info */
@@ -2412,6 +2907,8 @@ static inline void ALWAYS_INLINE OPTIMIZE3 set_counter(const stress_args_t *args
 	ci->counter_ready = true;
 }
 
+extern bool stress_rate_pace(const stress_args_t *args);
+
 /*
  *  keep_stressing()
  *      returns true if we can keep on running a stressor
@@ -2420,6 +2917,8 @@ static inline bool ALWAYS_INLINE OPTIMIZE3 keep_stressing(const stress_args_t *a
 {
 	if (UNLIKELY(!g_keep_stressing_flag))
 		return false;
+	if (UNLIKELY(args->rate != NULL) && !stress_rate_pace(args))
+		return false;
 	if (LIKELY(args->max_ops == 0))
 		return true;
 	return get_counter(args) < args->max_ops;
@@ -2475,6 +2974,8 @@ extern int stress_set_setting(const char *name, const stress_type_id_t type_id,
 extern int stress_set_setting_true(const char *name, const char *opt);
 extern int stress_set_setting_global(const char *name, const stress_type_id_t type_id,
 	const void *value);
+extern int stress_set_setting_default(const char *name, const stress_type_id_t type_id,
+	const void *value);
 extern bool stress_get_setting(const char *name, void *value);
 extern void stress_settings_free(void);
 
@@ -2512,6 +3013,7 @@ extern uint8_t stress_mwc8(void);
 extern uint16_t stress_mwc16(void);
 extern uint32_t stress_mwc32(void);
 extern uint64_t stress_mwc64(void);
+extern void stress_mwc_fill(void *buf, const size_t len);
 /* Fast random numbers 1..max inclusive  */
 extern uint8_t stress_mwc8modn(const uint8_t max);
 extern uint16_t stress_mwc16modn(const uint16_t max);
@@ -2588,6 +3090,10 @@ extern void stress_check_range(const char *const opt, const uint64_t val,
 extern void stress_check_range_bytes(const char *const opt,
 	const uint64_t val, const uint64_t lo, const uint64_t hi);
 extern WARN_UNUSED int stress_set_cpu_affinity(const char *arg);
+extern WARN_UNUSED int stress_set_placement(const char *arg);
+extern void stress_placement_init(void);
+extern void stress_placement_free(void);
+extern void stress_placement_apply(const char *name, const uint32_t instance);
 extern WARN_UNUSED int stress_set_mbind(const char *arg);
 extern int stress_numa_count_mem_nodes(unsigned long *max_node);
 extern WARN_UNUSED uint32_t stress_get_uint32(const char *const str);
@@ -2652,7 +3158,11 @@ extern WARN_UNUSED size_t stress_get_max_file_limit(void);
 extern WARN_UNUSED int stress_get_bad_fd(void);
 extern void stress_vmstat_start(void);
 extern void stress_vmstat_stop(void);
+extern void stress_get_cpu_ghz(double *avg_ghz, double *min_ghz, double *max_ghz);
+extern void stress_psi_start(void);
+extern void stress_psi_dump(FILE *yaml);
 extern WARN_UNUSED char *stress_find_mount_dev(const char *name);
+extern int stress_get_interrupts(const char *name, uint64_t *count);
 extern WARN_UNUSED int stress_sigaltstack_no_check(void *stack, const size_t size);
 extern WARN_UNUSED int stress_sigaltstack(void *stack, const size_t size);
 extern void stress_sigaltstack_disable(void);
@@ -2672,6 +3182,11 @@ extern void stress_mmap_set(uint8_t *buf, const size_t sz,
 	const size_t page_size);
 extern WARN_UNUSED int stress_mmap_check(uint8_t *buf, const size_t sz,
 	const size_t page_size);
+extern int stress_set_mmap_backing(const char *name, const char *opt);
+extern WARN_UNUSED const char *stress_mmap_backing_name(const size_t backing);
+extern WARN_UNUSED size_t stress_mmap_backing_page_size(const size_t backing);
+extern WARN_UNUSED void *stress_mmap_backing(const size_t backing, size_t *sz,
+	const int prot, const int flags);
 extern WARN_UNUSED uint64_t stress_get_phys_mem_size(void);
 extern WARN_UNUSED uint64_t stress_get_filesystem_size(void);
 extern WARN_UNUSED ssize_t stress_read_buffer(int, void*, ssize_t, bool);
@@ -2694,6 +3209,8 @@ extern WARN_UNUSED char *stress_proc_self_exe(void);
 extern WARN_UNUSED void *stress_shared_heap_init(void);
 extern void stress_shared_heap_deinit(void);
 extern WARN_UNUSED void *stress_shared_heap_malloc(const size_t size);
+extern void stress_shared_heap_free(void *ptr);
+extern void stress_shared_heap_flush(void);
 extern WARN_UNUSED char *stress_shared_heap_dup_const(const char *str);
 #if defined(__FreeBSD__) ||	\
     defined(__NetBSD__) ||	\
@@ -2717,6 +3234,7 @@ extern WARN_UNUSED pid_t stress_get_unused_pid_racy(const bool fork_test);
 extern WARN_UNUSED size_t stress_hostname_length(void);
 extern WARN_UNUSED int32_t stress_set_vmstat(const char *const str);
 extern WARN_UNUSED int32_t stress_set_thermalstat(const char *const str);
+extern WARN_UNUSED int32_t stress_set_psistat(const char *const str);
 extern WARN_UNUSED int32_t stress_set_iostat(const char *const str);
 extern void stress_metrics_set_const_check(const stress_args_t *args,
 	const size_t idx, char *description, const bool const_description, const double value);
@@ -2727,6 +3245,9 @@ extern void stress_metrics_set_const_check(const stress_args_t *args,
 #define stress_metrics_set(args, idx, description, value)	\
 	stress_metrics_set_const_check(args, idx, description, false, value)
 #endif
+extern WARN_UNUSED double stress_bogo_rate_real_time(const stress_stressor_t *ss,
+	double *r_time);
+extern const char *stress_get_class_name(const stress_class_t class);
 extern WARN_UNUSED int stress_tty_width(void);
 extern WARN_UNUSED size_t stress_get_extents(const int fd);
 extern WARN_UNUSED bool stress_redo_fork(const int err);
@@ -22,8 +22,12 @@
 #define MIN_PAGE_MOVE_BYTES		(64 * KB)
 #define MAX_PAGE_MOVE_BYTES		(MAX_MEM_LIMIT)
 
+#define PAGE_MOVE_BENCH_ALIGN		(2 * MB)	/* PMD size on most systems */
+#define PAGE_MOVE_BENCH_MIN_BYTES	(16 * MB)
+
 static const stress_help_t help[] = {
 	{ NULL,	"pagemove N",	  	"start N workers that shuffle move pages" },
+	{ NULL,	"pagemove-bench",	"measure GB/s of moving 4K, 64K and 2M chunks of 4K and THP pages" },
 	{ NULL,	"pagemove-bytes N",	"size of mmap'd region to exercise page moving in bytes" },
 	{ NULL,	"pagemove-ops N",	"stop after N page move bogo operations" },
 	{ NULL,	NULL,			NULL }
@@ -44,7 +48,13 @@ static int stress_set_pagemove_bytes(const char *opt)
 	return stress_set_setting("pagemove-bytes", TYPE_ID_SIZE_T, &pagemove_bytes);
 }
 
+static int stress_set_pagemove_bench(const char *opt)
+{
+	return stress_set_setting_true("pagemove-bench", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_pagemove_bench,	stress_set_pagemove_bench },
 	{ OPT_pagemove_bytes,	stress_set_pagemove_bytes },
 	{ 0,			NULL }
 };
@@ -66,6 +76,173 @@ static void stress_pagemove_remap_fail(
 		args->name, from, to, errno, strerror(errno));
 }
 
+static const size_t pagemove_bench_chunks[] = {
+	4 * KB, 64 * KB, 2 * MB,
+};
+
+static const char * const pagemove_bench_backings[] = {
+	"4K", "THP",
+};
+
+typedef struct {
+	double bytes;		/* bytes moved */
+	double duration;	/* time taken */
+} stress_pagemove_bench_t;
+
+/*
+ *  stress_pagemove_bench_pass()
+ *	rotate the region down by one chunk by swapping each pair of
+ *	adjacent chunks through the unmapped hole at the end of the
+ *	region, page p then holds the data of page p + chunk pages
+ */
+static int stress_pagemove_bench_pass(
+	const stress_args_t *args,
+	uint8_t *buf,
+	const size_t sz,
+	const size_t chunk,
+	stress_pagemove_bench_t *bench)
+{
+	uint8_t *ptr, *hole = buf + sz;
+	const uint8_t *end = buf + sz - chunk;
+	double t;
+
+	t = stress_time_now();
+	for (ptr = buf; ptr < end; ptr += chunk) {
+		if (UNLIKELY(mremap((void *)ptr, chunk, chunk,
+				    MREMAP_FIXED | MREMAP_MAYMOVE, hole) == MAP_FAILED)) {
+			stress_pagemove_remap_fail(args, ptr, hole);
+			return -1;
+		}
+		if (UNLIKELY(mremap((void *)(ptr + chunk), chunk, chunk,
+				    MREMAP_FIXED | MREMAP_MAYMOVE, ptr) == MAP_FAILED)) {
+			stress_pagemove_remap_fail(args, ptr + chunk, ptr);
+			return -1;
+		}
+		if (UNLIKELY(mremap((void *)hole, chunk, chunk,
+				    MREMAP_FIXED | MREMAP_MAYMOVE, ptr + chunk) == MAP_FAILED)) {
+			stress_pagemove_remap_fail(args, hole, ptr + chunk);
+			return -1;
+		}
+	}
+	bench->duration += stress_time_now() - t;
+	bench->bytes += 3.0 * (double)(sz - chunk);
+	return 0;
+}
+
+/*
+ *  stress_pagemove_bench()
+ *	measure the throughput of moving 4K, 64K and 2M chunks of 4K
+ *	and THP backed regions, 2M aligned chunks can be moved by the
+ *	kernel at the PMD level
+ */
+static int stress_pagemove_bench(const stress_args_t *args, size_t sz)
+{
+	stress_pagemove_bench_t bench[SIZEOF_ARRAY(pagemove_bench_backings)][SIZEOF_ARRAY(pagemove_bench_chunks)];
+	const size_t page_size = args->page_size;
+	uint8_t *mapping, *buf = NULL;
+	size_t backing, chunk, pages, len, idx = 0;
+	int rc = EXIT_SUCCESS;
+
+	sz = STRESS_MAXIMUM(sz, PAGE_MOVE_BENCH_MIN_BYTES) & ~(size_t)(PAGE_MOVE_BENCH_ALIGN - 1);
+	pages = sz / page_size;
+	len = sz + (2 * PAGE_MOVE_BENCH_ALIGN);
+	(void)memset(bench, 0, sizeof(bench));
+
+	/* reserve the region and a chunk sized hole after it, 2M aligned */
+	mapping = (uint8_t *)mmap(NULL, len, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mapping == MAP_FAILED) {
+		pr_inf_skip("%s: failed to mmap %zu bytes (errno=%d) %s, skipping stressor\n",
+			args->name, len, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (uint8_t *)(((uintptr_t)mapping + PAGE_MOVE_BENCH_ALIGN - 1) &
+		~(uintptr_t)(PAGE_MOVE_BENCH_ALIGN - 1));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (backing = 0; backing < SIZEOF_ARRAY(pagemove_bench_backings); backing++) {
+			size_t page_num;
+			uint8_t *ptr;
+
+			if (mmap((void *)buf, sz, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+				pr_inf_skip("%s: failed to mmap %zu bytes (errno=%d) %s, skipping stressor\n",
+					args->name, sz, errno, strerror(errno));
+				rc = EXIT_NO_RESOURCE;
+				goto deinit;
+			}
+			/* the hole after the region must be unmapped */
+			(void)munmap((void *)(buf + sz), PAGE_MOVE_BENCH_ALIGN);
+#if defined(HAVE_MADVISE)
+#if defined(MADV_NOHUGEPAGE)
+			if (backing == 0)
+				(void)madvise((void *)buf, sz, MADV_NOHUGEPAGE);
+#endif
+#if defined(MADV_HUGEPAGE)
+			if (backing == 1)
+				(void)madvise((void *)buf, sz, MADV_HUGEPAGE);
+#endif
+#endif
+			for (page_num = 0, ptr = buf; ptr < buf + sz; ptr += page_size, page_num++)
+				((page_info_t *)ptr)->page_num = page_num;
+
+			for (chunk = 0; chunk < SIZEOF_ARRAY(pagemove_bench_chunks); chunk++) {
+				const size_t chunk_pages = pagemove_bench_chunks[chunk] / page_size;
+
+				if (stress_pagemove_bench_pass(args, buf, sz, pagemove_bench_chunks[chunk],
+							       &bench[backing][chunk]) < 0) {
+					rc = EXIT_FAILURE;
+					goto deinit;
+				}
+				for (page_num = 0, ptr = buf; ptr < buf + sz; ptr += page_size, page_num++) {
+					page_info_t *p = (page_info_t *)ptr;
+
+					if (UNLIKELY(p->page_num != ((page_num + chunk_pages) % pages))) {
+						pr_fail("%s: page move of %zu byte chunks failed for page %zu, mismatch on contents\n",
+							args->name, pagemove_bench_chunks[chunk], page_num);
+						rc = EXIT_FAILURE;
+						goto deinit;
+					}
+					p->page_num = page_num;
+				}
+				if (!keep_stressing(args))
+					goto deinit;
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+deinit:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	(void)munmap((void *)mapping, len);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: moving %zu MB regions, GB/s by chunk size:\n", args->name, (size_t)(sz / MB));
+		pr_inf("%s: %-8s %10s %10s %10s\n", args->name, "backing", "4K", "64K", "2M");
+	}
+	for (backing = 0; backing < SIZEOF_ARRAY(pagemove_bench_backings); backing++) {
+		double rate[SIZEOF_ARRAY(pagemove_bench_chunks)];
+
+		for (chunk = 0; chunk < SIZEOF_ARRAY(pagemove_bench_chunks); chunk++) {
+			const stress_pagemove_bench_t *b = &bench[backing][chunk];
+			char desc[64];
+
+			rate[chunk] = (b->duration > 0.0) ? b->bytes / b->duration / (double)GB : 0.0;
+			(void)snprintf(desc, sizeof(desc), "%s %zuK chunk GB per sec",
+				pagemove_bench_backings[backing], (size_t)(pagemove_bench_chunks[chunk] / KB));
+			stress_metrics_set(args, idx++, desc, rate[chunk]);
+		}
+		if (args->instance == 0)
+			pr_inf("%s: %-8s %10.2f %10.2f %10.2f\n", args->name,
+				pagemove_bench_backings[backing], rate[0], rate[1], rate[2]);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+	return rc;
+}
+
 static int stress_pagemove_child(const stress_args_t *args, void *context)
 {
 	size_t sz, pages, pagemove_bytes = DEFAULT_PAGE_MOVE_BYTES;
@@ -76,6 +253,7 @@ static int stress_pagemove_child(const stress_args_t *args, void *context)
 	int rc = EXIT_FAILURE;
 	double duration = 0.0, count = 0.0, rate;
 	int metrics_count = 0;
+	bool pagemove_bench = false;
 
 	(void)context;
 
@@ -94,6 +272,10 @@ static int stress_pagemove_child(const stress_args_t *args, void *context)
 	sz = pagemove_bytes & ~(page_size - 1);
 	pages = sz / page_size;
 
+	(void)stress_get_setting("pagemove-bench", &pagemove_bench);
+	if (pagemove_bench)
+		return stress_pagemove_bench(args, sz);
+
 	buf = (uint8_t *)mmap(NULL, sz + page_size, PROT_READ | PROT_WRITE, flags, -1, 0);
 	if (buf == MAP_FAILED) {
 		pr_inf_skip("%s: failed to mmap %zu bytes (errno=%d) %s, skipping stressor\n",
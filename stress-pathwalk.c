@@ -0,0 +1,545 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#define MIN_PATHWALK_DEPTH		(1)
+#define MAX_PATHWALK_DEPTH		(256)
+#define DEFAULT_PATHWALK_DEPTH		(64)
+
+#define MIN_PATHWALK_THREADS		(1)
+#define MAX_PATHWALK_THREADS		(64)
+#define DEFAULT_PATHWALK_THREADS	(4)
+
+#define PATHWALK_SYMLINK_DEPTH		(32)		/* keep under the 40 symlink lookup limit */
+#define PATHWALK_PHASE_USEC		(50000)		/* duration of each depth and thread count */
+#define PATHWALK_DEPTHS_MAX		(10)		/* 1, 2, 4 .. 256 and the maximum */
+#define PATHWALK_THREADS_MAX		(8)		/* 1, 2, 4 .. 64 and the maximum */
+
+#define PATHWALK_METHOD_STAT		(0)
+#define PATHWALK_METHOD_OPEN		(1)
+#define PATHWALK_METHOD_NEGATIVE	(2)
+#define PATHWALK_METHOD_SYMLINK		(3)
+#define PATHWALK_METHOD_MAX		(4)
+#define PATHWALK_METHOD_ALL		(PATHWALK_METHOD_MAX)
+
+static const stress_help_t help[] = {
+	{ NULL,	"pathwalk N",		"start N workers measuring path lookup scaling" },
+	{ NULL,	"pathwalk-depth N",	"sweep path depths from 1 up to N directories" },
+	{ NULL,	"pathwalk-method M",	"select lookup method: stat, open, negative, symlink, all" },
+	{ NULL,	"pathwalk-ops N",	"stop after N pathwalk depth and thread sweep bogo operations" },
+	{ NULL,	"pathwalk-threads N",	"sweep from 1 up to N lookup threads" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const pathwalk_methods[] = {
+	"stat",
+	"open",
+	"negative",
+	"symlink",
+	"all",
+};
+
+static int stress_set_pathwalk_depth(const char *opt)
+{
+	uint32_t pathwalk_depth;
+
+	pathwalk_depth = stress_get_uint32(opt);
+	stress_check_range("pathwalk-depth", (uint64_t)pathwalk_depth,
+		MIN_PATHWALK_DEPTH, MAX_PATHWALK_DEPTH);
+	return stress_set_setting("pathwalk-depth", TYPE_ID_UINT32, &pathwalk_depth);
+}
+
+static int stress_set_pathwalk_method(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(pathwalk_methods); i++) {
+		if (!strcmp(opt, pathwalk_methods[i]))
+			return stress_set_setting("pathwalk-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "pathwalk-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(pathwalk_methods); i++)
+		(void)fprintf(stderr, " %s", pathwalk_methods[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_pathwalk_threads(const char *opt)
+{
+	uint32_t pathwalk_threads;
+
+	pathwalk_threads = stress_get_uint32(opt);
+	stress_check_range("pathwalk-threads", (uint64_t)pathwalk_threads,
+		MIN_PATHWALK_THREADS, MAX_PATHWALK_THREADS);
+	return stress_set_setting("pathwalk-threads", TYPE_ID_UINT32, &pathwalk_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_pathwalk_depth,	stress_set_pathwalk_depth },
+	{ OPT_pathwalk_method,	stress_set_pathwalk_method },
+	{ OPT_pathwalk_threads,	stress_set_pathwalk_threads },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_FSTATAT) &&		\
+    defined(HAVE_OPENAT)
+
+/* state shared by the lookup threads */
+typedef struct {
+	int dir_fd;			/* top of the tree, lookups start here */
+	bool use_statx;			/* statx rather than fstatat */
+	size_t method;			/* lookup method */
+	const char *path;		/* path to look up */
+	volatile bool start;		/* threads start looking up */
+	volatile bool stop;		/* threads stop looking up */
+} stress_pathwalk_ctxt_t;
+
+/* per thread state and results */
+typedef struct {
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	stress_pathwalk_ctxt_t *ctxt;	/* shared state */
+	uint64_t lookups;		/* successful lookups */
+	int err;			/* errno of an unexpected lookup result */
+} stress_pathwalk_thread_t;
+
+/* accumulated results for a depth and thread count */
+typedef struct {
+	double wall;			/* seconds of phases */
+	double lookups;			/* lookups of all threads */
+} stress_pathwalk_stats_t;
+
+/*
+ *  stress_pathwalk_lookup()
+ *	look up path relative to the top of the tree, returns
+ *	0 if the lookup ended the way the method expects,
+ *	otherwise the errno of the lookup
+ */
+static int stress_pathwalk_lookup(const stress_pathwalk_ctxt_t *ctxt)
+{
+	struct stat statbuf;
+	int fd;
+
+	switch (ctxt->method) {
+	case PATHWALK_METHOD_OPEN:
+		fd = openat(ctxt->dir_fd, ctxt->path, O_RDONLY);
+		if (fd < 0)
+			return errno;
+		(void)close(fd);
+		return 0;
+	case PATHWALK_METHOD_NEGATIVE:
+		if (fstatat(ctxt->dir_fd, ctxt->path, &statbuf, 0) == 0)
+			return EEXIST;
+		return (errno == ENOENT) ? 0 : errno;
+	default:
+		break;
+	}
+#if defined(STATX_BASIC_STATS)
+	if (ctxt->use_statx) {
+		shim_statx_t statxbuf;
+
+		return (shim_statx(ctxt->dir_fd, ctxt->path, 0, STATX_BASIC_STATS, &statxbuf) < 0) ? errno : 0;
+	}
+#endif
+	return (fstatat(ctxt->dir_fd, ctxt->path, &statbuf, 0) < 0) ? errno : 0;
+}
+
+/*
+ *  stress_pathwalk_thread()
+ *	look up the shared path until told to stop
+ */
+static void *stress_pathwalk_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_pathwalk_thread_t *thread = (stress_pathwalk_thread_t *)arg;
+	const stress_pathwalk_ctxt_t *ctxt = thread->ctxt;
+	uint64_t lookups = 0;
+
+	while (!ctxt->start && !ctxt->stop)
+		shim_sched_yield();
+
+	while (!ctxt->stop) {
+		const int err = stress_pathwalk_lookup(ctxt);
+
+		if (UNLIKELY(err != 0)) {
+			thread->err = err;
+			break;
+		}
+		lookups++;
+	}
+	thread->lookups = lookups;
+
+	return &nowt;
+}
+
+/*
+ *  stress_pathwalk_phase()
+ *	run n threads looking up path for PATHWALK_PHASE_USEC and
+ *	add the results to stats, returns the errno of an unexpected
+ *	lookup result or 0
+ */
+static int stress_pathwalk_phase(
+	stress_pathwalk_ctxt_t *ctxt,
+	stress_pathwalk_thread_t *threads,
+	const uint32_t n,
+	stress_pathwalk_stats_t *stats)
+{
+	uint32_t i, started = 0;
+	int err = 0;
+	double t;
+
+	ctxt->start = false;
+	ctxt->stop = false;
+	for (i = 0; i < n; i++) {
+		threads[i].ctxt = ctxt;
+		threads[i].lookups = 0;
+		threads[i].err = 0;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_pathwalk_thread, (void *)&threads[i]);
+		if (threads[i].ret == 0)
+			started++;
+	}
+	if (started == n) {
+		t = stress_time_now();
+		ctxt->start = true;
+		(void)shim_usleep(PATHWALK_PHASE_USEC);
+		ctxt->stop = true;
+		t = stress_time_now() - t;
+	} else {
+		ctxt->stop = true;
+		t = 0.0;
+	}
+	for (i = 0; i < n; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	if (started != n)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if (threads[i].err)
+			err = threads[i].err;
+		stats->lookups += (double)threads[i].lookups;
+	}
+	stats->wall += t;
+
+	return err;
+}
+
+/*
+ *  stress_pathwalk_path()
+ *	fill path with depth components of name followed by leaf
+ */
+static void stress_pathwalk_path(
+	char *path,
+	const char *name,
+	const uint32_t depth,
+	const char *leaf)
+{
+	uint32_t i;
+
+	for (i = 0; i < depth; i++) {
+		*path++ = *name;
+		*path++ = '/';
+	}
+	(void)strcpy(path, leaf);
+}
+
+/*
+ *  stress_pathwalk_tree_rm()
+ *	remove the tree from the deepest level up to the top
+ */
+static void stress_pathwalk_tree_rm(
+	const int dir_fd,
+	char *path,
+	const uint32_t depth)
+{
+	uint32_t i;
+
+	for (i = depth + 1; i > 0; i--) {
+		stress_pathwalk_path(path, "0", i - 1, "f");
+		(void)unlinkat(dir_fd, path, 0);
+		stress_pathwalk_path(path, "0", i - 1, "s");
+		(void)unlinkat(dir_fd, path, 0);
+		if (i > 1) {
+			/* drop the trailing / to name the directory */
+			stress_pathwalk_path(path, "0", i - 1, "");
+			path[strlen(path) - 1] = '\0';
+			(void)unlinkat(dir_fd, path, AT_REMOVEDIR);
+		}
+	}
+}
+
+/*
+ *  stress_pathwalk_tree_mk()
+ *	make a chain of depth directories named 0, each level has
+ *	a file f and (apart from the deepest) a symlink s to the
+ *	next level down, returns 0 or the errno of the failure
+ */
+static int stress_pathwalk_tree_mk(
+	const stress_args_t *args,
+	const int dir_fd,
+	char *path,
+	const uint32_t depth)
+{
+	uint32_t i;
+
+	for (i = 0; i <= depth; i++) {
+		int fd;
+
+		if (!keep_stressing(args))
+			return EINTR;
+		stress_pathwalk_path(path, "0", i, "f");
+		fd = openat(dir_fd, path, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+		if (fd < 0)
+			return errno;
+		(void)close(fd);
+		if (i == depth)
+			break;
+		stress_pathwalk_path(path, "0", i, "s");
+		if (symlinkat("0", dir_fd, path) < 0)
+			return errno;
+		stress_pathwalk_path(path, "0", i, "0");
+		if (mkdirat(dir_fd, path, S_IRWXU) < 0)
+			return errno;
+	}
+	return 0;
+}
+
+/*
+ *  stress_pathwalk_report()
+ *	print lookups per second over the depths and thread counts
+ */
+static void stress_pathwalk_report(
+	const stress_args_t *args,
+	const char *method,
+	stress_pathwalk_stats_t stats[PATHWALK_DEPTHS_MAX][PATHWALK_THREADS_MAX],
+	const uint32_t *depths,
+	const size_t n_depths,
+	const uint32_t *threads,
+	const size_t n_threads)
+{
+	char buf[256];
+	size_t i, j, len;
+
+	pr_lock();
+	pr_inf("%s: %s lookups per second over path depth and threads\n", args->name, method);
+	len = 0;
+	buf[0] = '\0';
+	for (j = 0; (j < n_threads) && (len < sizeof(buf)); j++)
+		len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %9" PRIu32 "T", threads[j]);
+	pr_inf("%s: %7s%s\n", args->name, "depth", buf);
+	for (i = 0; i < n_depths; i++) {
+		len = 0;
+		buf[0] = '\0';
+		for (j = 0; (j < n_threads) && (len < sizeof(buf)); j++) {
+			const stress_pathwalk_stats_t *s = &stats[i][j];
+
+			if (s->wall > 0.0)
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %10.0f", s->lookups / s->wall);
+			else
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %10s", "-");
+		}
+		pr_inf("%s: %7" PRIu32 "%s\n", args->name, depths[i], buf);
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_pathwalk()
+ *	measure path lookup rates as the path depth and the number
+ *	of threads looking up paths with a shared prefix grows
+ */
+static int stress_pathwalk(const stress_args_t *args)
+{
+	static stress_pathwalk_stats_t stats[PATHWALK_METHOD_MAX][PATHWALK_DEPTHS_MAX][PATHWALK_THREADS_MAX];
+	uint32_t depths[PATHWALK_DEPTHS_MAX], thread_counts[PATHWALK_THREADS_MAX];
+	stress_pathwalk_thread_t *threads;
+	stress_pathwalk_ctxt_t context, *ctxt = &context;
+	uint32_t pathwalk_depth = DEFAULT_PATHWALK_DEPTH;
+	uint32_t pathwalk_threads = DEFAULT_PATHWALK_THREADS;
+	uint32_t n;
+	size_t pathwalk_method = PATHWALK_METHOD_ALL;
+	size_t i, j, m, n_depths = 0, n_threads = 0, idx = 0;
+	char pathname[PATH_MAX], path[(2 * MAX_PATHWALK_DEPTH) + 2];
+	int ret, rc = EXIT_SUCCESS;
+
+	if (!stress_get_setting("pathwalk-depth", &pathwalk_depth)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			pathwalk_depth = MAX_PATHWALK_DEPTH;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			pathwalk_depth = MIN_PATHWALK_DEPTH;
+	}
+	if (!stress_get_setting("pathwalk-threads", &pathwalk_threads)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			pathwalk_threads = MAX_PATHWALK_THREADS;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			pathwalk_threads = MIN_PATHWALK_THREADS;
+	}
+	(void)stress_get_setting("pathwalk-method", &pathwalk_method);
+
+	for (n = 1; (n < pathwalk_depth) && (n_depths < PATHWALK_DEPTHS_MAX - 1); n <<= 1)
+		depths[n_depths++] = n;
+	depths[n_depths++] = pathwalk_depth;
+	for (n = 1; (n < pathwalk_threads) && (n_threads < PATHWALK_THREADS_MAX - 1); n <<= 1)
+		thread_counts[n_threads++] = n;
+	thread_counts[n_threads++] = pathwalk_threads;
+
+	threads = (stress_pathwalk_thread_t *)calloc(pathwalk_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " threads, skipping stressor\n",
+			args->name, pathwalk_threads);
+		return EXIT_NO_RESOURCE;
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto free_threads;
+	}
+	(void)stress_temp_dir_args(args, pathname, sizeof(pathname));
+
+	(void)memset(ctxt, 0, sizeof(*ctxt));
+	ctxt->dir_fd = open(pathname, O_RDONLY | O_DIRECTORY);
+	if (ctxt->dir_fd < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, pathname, errno, strerror(errno));
+		goto rm_dir;
+	}
+	ctxt->path = path;
+
+	ret = stress_pathwalk_tree_mk(args, ctxt->dir_fd, path, pathwalk_depth);
+	if (ret != 0) {
+		if (ret != EINTR) {
+			pr_inf_skip("%s: cannot create a %" PRIu32 " level deep tree, errno=%d (%s)%s, "
+				"skipping stressor\n", args->name, pathwalk_depth,
+				ret, strerror(ret), stress_fs_type(pathname));
+			rc = EXIT_NO_RESOURCE;
+		}
+		goto rm_tree;
+	}
+
+#if defined(STATX_BASIC_STATS)
+	{
+		shim_statx_t statxbuf;
+
+		ctxt->use_statx = (shim_statx(ctxt->dir_fd, "f", 0, STATX_BASIC_STATS, &statxbuf) == 0);
+	}
+#endif
+
+	(void)memset(stats, 0, sizeof(stats));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; (rc == EXIT_SUCCESS) && (m < PATHWALK_METHOD_MAX); m++) {
+			const char *leaf = (m == PATHWALK_METHOD_NEGATIVE) ? "n" : "f";
+
+			if ((pathwalk_method != PATHWALK_METHOD_ALL) && (pathwalk_method != m))
+				continue;
+			ctxt->method = m;
+			for (i = 0; (rc == EXIT_SUCCESS) && (i < n_depths); i++) {
+				if ((m == PATHWALK_METHOD_SYMLINK) && (depths[i] > PATHWALK_SYMLINK_DEPTH))
+					break;
+				stress_pathwalk_path(path, (m == PATHWALK_METHOD_SYMLINK) ? "s" : "0",
+					depths[i], leaf);
+				for (j = 0; keep_stressing(args) && (j < n_threads); j++) {
+					stress_pathwalk_stats_t *s = &stats[m][i][j];
+					const double lookups = s->lookups;
+
+					ret = stress_pathwalk_phase(ctxt, threads, thread_counts[j], s);
+					add_counter(args, (uint64_t)(s->lookups - lookups));
+					if (ret != 0) {
+						pr_fail("%s: %s lookup of %" PRIu32 " level deep path failed, "
+							"errno=%d (%s)%s\n", args->name, pathwalk_methods[m],
+							depths[i], ret, strerror(ret), stress_fs_type(pathname));
+						rc = EXIT_FAILURE;
+						break;
+					}
+				}
+			}
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (m = 0; m < PATHWALK_METHOD_MAX; m++) {
+		const size_t jmax = n_threads - 1;
+		size_t imax = n_depths - 1;
+
+		if ((pathwalk_method != PATHWALK_METHOD_ALL) && (pathwalk_method != m))
+			continue;
+		if (args->instance == 0)
+			stress_pathwalk_report(args, pathwalk_methods[m], stats[m],
+				depths, n_depths, thread_counts, n_threads);
+
+		/* lookup rate over the depths with the most threads */
+		for (i = 0; i < n_depths; i++) {
+			const stress_pathwalk_stats_t *s = &stats[m][i][jmax];
+			char str[64];
+
+			if ((s->wall <= 0.0) || (s->lookups <= 0.0))
+				continue;
+			imax = i;
+			(void)snprintf(str, sizeof(str), "%s lookups per sec (depth %" PRIu32 ")",
+				pathwalk_methods[m], depths[i]);
+			stress_metrics_set(args, idx++, str, s->lookups / s->wall);
+		}
+		/* lookup rate over the thread counts at the deepest depth */
+		for (j = 0; j < n_threads; j++) {
+			const stress_pathwalk_stats_t *s = &stats[m][imax][j];
+			char str[64];
+
+			if ((s->wall <= 0.0) || (s->lookups <= 0.0))
+				continue;
+			(void)snprintf(str, sizeof(str), "%s lookups per sec (%" PRIu32 " threads)",
+				pathwalk_methods[m], thread_counts[j]);
+			stress_metrics_set(args, idx++, str, s->lookups / s->wall);
+		}
+	}
+
+rm_tree:
+	stress_pathwalk_tree_rm(ctxt->dir_fd, path, pathwalk_depth);
+	(void)close(ctxt->dir_fd);
+rm_dir:
+	(void)stress_temp_dir_rm_args(args);
+free_threads:
+	free(threads);
+
+	return rc;
+}
+
+stressor_info_t stress_pathwalk_info = {
+	.stressor = stress_pathwalk,
+	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_pathwalk_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without pthread, fstatat or openat support"
+};
+#endif
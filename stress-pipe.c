@@ -18,6 +18,32 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
+
+#define PIPE_SWEEP_METHOD_WRITE		(0)
+#define PIPE_SWEEP_METHOD_VMSPLICE	(1)
+#define PIPE_SWEEP_METHODS		(2)
+
+#define PIPE_SWEEP_MIN_SECS		(0.05)
+#define PIPE_SWEEP_MAX_SECS		(1.0)
+
+/*
+ *  pipe sweep results of one method, message size
+ *  and pipe size point
+ */
+typedef struct {
+	uint64_t bytes;		/* bytes transferred */
+	uint64_t syscalls;	/* writer and reader system calls */
+	double duration;	/* seconds, including the reader draining */
+	bool unsupported;	/* pipe size could not be set */
+} stress_pipe_sweep_point_t;
+
+/*
+ *  pipe sweep reader results, shared with the reader child
+ */
+typedef struct {
+	uint64_t reads;		/* read system calls */
+} stress_pipe_sweep_reader_t;
 
 static const stress_help_t help[] = {
 	{ "p N", "pipe N",		"start N workers exercising pipe I/O" },
@@ -25,10 +51,31 @@ static const stress_help_t help[] = {
 	{ NULL,	"pipe-ops N",		"stop after N pipe I/O bogo operations" },
 #if defined(F_SETPIPE_SZ)
 	{ NULL,	"pipe-size N",		"set pipe size to N bytes" },
+	{ NULL,	"pipe-sweep",		"sweep message and pipe sizes using write and vmsplice" },
 #endif
 	{ NULL,	NULL,			NULL }
 };
 
+#if defined(F_SETPIPE_SZ)
+static const char * const pipe_sweep_methods[PIPE_SWEEP_METHODS] = {
+	"write",
+	"vmsplice",
+};
+
+static const size_t pipe_sweep_msg_sizes[] = {
+	512, 4 * KB, 16 * KB, 64 * KB, 256 * KB
+};
+
+static const size_t pipe_sweep_pipe_sizes[] = {
+	4 * KB, 64 * KB, 256 * KB, 1024 * KB
+};
+
+#define PIPE_SWEEP_MAX_MSG_SIZE		(256 * KB)
+#define PIPE_SWEEP_POINTS		(PIPE_SWEEP_METHODS * \
+					 SIZEOF_ARRAY(pipe_sweep_msg_sizes) * \
+					 SIZEOF_ARRAY(pipe_sweep_pipe_sizes))
+#endif
+
 #if defined(F_SETPIPE_SZ)
 /*
  *  stress_set_pipe_size()
@@ -44,6 +91,13 @@ static int stress_set_pipe_size(const char *opt)
 }
 #endif
 
+#if defined(F_SETPIPE_SZ)
+static int stress_set_pipe_sweep(const char *opt)
+{
+	return stress_set_setting_true("pipe-sweep", opt);
+}
+#endif
+
 /*
  *  stress_set_pipe_size()
  *	set pipe data write size in bytes
@@ -100,6 +154,279 @@ static void pipe_change_size(
 }
 #endif
 
+#if defined(F_SETPIPE_SZ)
+/*
+ *  stress_pipe_sweep_continue()
+ *	keep_stressing() without --rate pacing, the sweep points
+ *	are time sliced so pacing would skew the measurements
+ */
+static inline bool stress_pipe_sweep_continue(const stress_args_t *args)
+{
+	if (!keep_stressing_flag())
+		return false;
+	return !(args->max_ops && (get_counter(args) >= args->max_ops));
+}
+
+/*
+ *  stress_pipe_sweep_size_str()
+ *	human readable sweep size
+ */
+static void stress_pipe_sweep_size_str(char *str, const size_t len, const size_t size)
+{
+	if (size >= MB)
+		(void)snprintf(str, len, "%zuM", size / (size_t)MB);
+	else if (size >= KB)
+		(void)snprintf(str, len, "%zuK", size / (size_t)KB);
+	else
+		(void)snprintf(str, len, "%zu", size);
+}
+
+/*
+ *  stress_pipe_sweep_point()
+ *	transfer msg_size messages over a pipe of pipe_size bytes for
+ *	secs seconds using the given method, a child reads the data
+ */
+static int stress_pipe_sweep_point(
+	const stress_args_t *args,
+	const int method,
+	const size_t msg_size,
+	const size_t pipe_size,
+	const double secs,
+	char *wbuf,
+	char *rbuf,
+	stress_pipe_sweep_reader_t *reader,
+	stress_pipe_sweep_point_t *point)
+{
+	int fds[2], status;
+	uint64_t bytes = 0, writes = 0;
+	double t_start, t_end;
+	pid_t pid;
+
+	if (pipe(fds) < 0) {
+		pr_fail("%s: pipe failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (fcntl(fds[1], F_SETPIPE_SZ, pipe_size) < 0) {
+		/* pipe sizes above /proc/sys/fs/pipe-max-size need CAP_SYS_RESOURCE */
+		point->unsupported = true;
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		return EXIT_SUCCESS;
+	}
+	reader->reads = 0;
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(errno))
+			goto again;
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		if (!keep_stressing_flag())
+			return EXIT_SUCCESS;
+		pr_fail("%s: fork failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return EXIT_FAILURE;
+	} else if (pid == 0) {
+		uint64_t reads = 0;
+
+		stress_parent_died_alarm();
+		(void)close(fds[1]);
+		for (;;) {
+			const ssize_t n = read(fds[0], rbuf, msg_size);
+
+			if (n == 0)
+				break;
+			if (UNLIKELY(n < 0)) {
+				if ((errno == EAGAIN) || (errno == EINTR))
+					continue;
+				break;
+			}
+			reads++;
+		}
+		reader->reads = reads;
+		(void)close(fds[0]);
+		_exit(EXIT_SUCCESS);
+	}
+
+	(void)close(fds[0]);
+	t_start = stress_time_now();
+	t_end = t_start + secs;
+	do {
+		ssize_t ret;
+
+#if defined(HAVE_VMSPLICE)
+		if (method == PIPE_SWEEP_METHOD_VMSPLICE) {
+			struct iovec iov;
+
+			/* the pipe references wbuf, the data is never modified */
+			iov.iov_base = wbuf;
+			iov.iov_len = msg_size;
+			ret = vmsplice(fds[1], &iov, 1, 0);
+		} else {
+			ret = write(fds[1], wbuf, msg_size);
+		}
+#else
+		(void)method;
+		ret = write(fds[1], wbuf, msg_size);
+#endif
+		if (UNLIKELY(ret < 0)) {
+			if (errno == EAGAIN)
+				continue;
+			if (errno != EINTR)
+				pr_fail("%s: %s failed, errno=%d (%s)\n",
+					args->name, pipe_sweep_methods[method],
+					errno, strerror(errno));
+			break;
+		}
+		bytes += (uint64_t)ret;
+		writes++;
+	} while (stress_pipe_sweep_continue(args) && (stress_time_now() < t_end));
+
+	(void)close(fds[1]);
+	(void)shim_waitpid(pid, &status, 0);
+
+	point->duration += stress_time_now() - t_start;
+	point->bytes += bytes;
+	point->syscalls += writes + reader->reads;
+	add_counter(args, writes);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_pipe_sweep_report()
+ *	log the sweep grid and report the GB per sec and system
+ *	calls per MB of each point as metrics
+ */
+static void stress_pipe_sweep_report(
+	const stress_args_t *args,
+	const double secs,
+	const stress_pipe_sweep_point_t *points)
+{
+	size_t i, j, k, n = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: pipe sweep, %.2f seconds per point\n", args->name, secs);
+		pr_inf("%s: method     msg  pipe    GB/sec  syscalls/MB\n", args->name);
+	}
+
+	for (i = 0; i < PIPE_SWEEP_METHODS; i++) {
+		for (j = 0; j < SIZEOF_ARRAY(pipe_sweep_msg_sizes); j++) {
+			char msg_str[16];
+
+			stress_pipe_sweep_size_str(msg_str, sizeof(msg_str), pipe_sweep_msg_sizes[j]);
+			for (k = 0; k < SIZEOF_ARRAY(pipe_sweep_pipe_sizes); k++, n++) {
+				const stress_pipe_sweep_point_t *point = &points[n];
+				char pipe_str[16], str[64];
+				double rate, calls;
+
+				if (point->unsupported || (point->duration <= 0.0) || (point->bytes == 0))
+					continue;
+
+				stress_pipe_sweep_size_str(pipe_str, sizeof(pipe_str), pipe_sweep_pipe_sizes[k]);
+				rate = ((double)point->bytes / point->duration) / (double)GB;
+				calls = (double)point->syscalls / ((double)point->bytes / (double)MB);
+
+				if (args->instance == 0)
+					pr_inf("%s: %-8s %5s %5s %9.3f %12.2f\n",
+						args->name, pipe_sweep_methods[i],
+						msg_str, pipe_str, rate, calls);
+
+				(void)snprintf(str, sizeof(str), "%s %s in %s pipe GB per sec",
+					pipe_sweep_methods[i], msg_str, pipe_str);
+				stress_metrics_set(args, n * 2, str, rate);
+				(void)snprintf(str, sizeof(str), "%s %s in %s pipe calls per MB",
+					pipe_sweep_methods[i], msg_str, pipe_str);
+				stress_metrics_set(args, (n * 2) + 1, str, calls);
+			}
+		}
+	}
+
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_pipe_sweep()
+ *	sweep the transfer methods, message sizes and pipe sizes,
+ *	each point runs for a slice of the run time and the sweep
+ *	repeats, accumulating results, until the run ends
+ */
+static int stress_pipe_sweep(const stress_args_t *args)
+{
+	stress_pipe_sweep_point_t *points;
+	stress_pipe_sweep_reader_t *reader;
+	char *wbuf, *rbuf;
+	double secs;
+	size_t i, j, k;
+	int rc = EXIT_SUCCESS;
+
+	secs = (double)g_opt_timeout / (double)PIPE_SWEEP_POINTS;
+	if (secs < PIPE_SWEEP_MIN_SECS)
+		secs = PIPE_SWEEP_MIN_SECS;
+	if (secs > PIPE_SWEEP_MAX_SECS)
+		secs = PIPE_SWEEP_MAX_SECS;
+
+	points = calloc(PIPE_SWEEP_POINTS, sizeof(*points));
+	if (!points) {
+		pr_inf_skip("%s: cannot allocate sweep results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	reader = (stress_pipe_sweep_reader_t *)mmap(NULL, sizeof(*reader),
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (reader == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap sweep reader results, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_points;
+	}
+	wbuf = (char *)mmap(NULL, PIPE_SWEEP_MAX_MSG_SIZE * 2, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (wbuf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap sweep buffers, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto unmap_reader;
+	}
+	rbuf = wbuf + PIPE_SWEEP_MAX_MSG_SIZE;
+	stress_rndbuf(wbuf, PIPE_SWEEP_MAX_MSG_SIZE);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		stress_pipe_sweep_point_t *point = points;
+
+		for (i = 0; i < PIPE_SWEEP_METHODS; i++) {
+			for (j = 0; j < SIZEOF_ARRAY(pipe_sweep_msg_sizes); j++) {
+				for (k = 0; k < SIZEOF_ARRAY(pipe_sweep_pipe_sizes); k++, point++) {
+					rc = stress_pipe_sweep_point(args, (int)i,
+						pipe_sweep_msg_sizes[j], pipe_sweep_pipe_sizes[k],
+						secs, wbuf, rbuf, reader, point);
+					if (rc != EXIT_SUCCESS)
+						goto unmap_bufs;
+					if (!stress_pipe_sweep_continue(args))
+						goto report;
+				}
+			}
+		}
+	} while (stress_pipe_sweep_continue(args));
+report:
+	stress_pipe_sweep_report(args, secs, points);
+unmap_bufs:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	(void)munmap((void *)wbuf, PIPE_SWEEP_MAX_MSG_SIZE * 2);
+unmap_reader:
+	(void)munmap((void *)reader, sizeof(*reader));
+free_points:
+	free(points);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_pipe
  *	stress by heavy pipe I/O
@@ -116,6 +443,15 @@ static int stress_pipe(const stress_args_t *args)
 	if (stress_sig_stop_stressing(args->name, SIGPIPE) < 0)
 		return EXIT_FAILURE;
 
+#if defined(F_SETPIPE_SZ)
+	{
+		bool pipe_sweep = false;
+
+		(void)stress_get_setting("pipe-sweep", &pipe_sweep);
+		if (pipe_sweep)
+			return stress_pipe_sweep(args);
+	}
+#endif
 	(void)stress_get_setting("pipe-data-size", &pipe_data_size);
 
 	buf = (char *)mmap(NULL, pipe_data_size, PROT_READ | PROT_WRITE,
@@ -242,8 +578,10 @@ again:
 		t = stress_time_now();
 		do {
 			register ssize_t ret;
+			uint64_t t_lat;
 
 			*buf32 = val++;
+			t_lat = stress_latency_begin(args);
 			ret = write(fd, buf, pipe_data_size);
 			if (UNLIKELY(ret <= 0)) {
 				if ((errno == EAGAIN) || (errno == EINTR))
@@ -257,6 +595,7 @@ again:
 				}
 				continue;
 			} else {
+				stress_latency_end(args, t_lat);
 				bytes += (double)ret;
 			}
 			inc_counter(args);
@@ -279,6 +618,7 @@ finish:
 static const stress_opt_set_func_t opt_set_funcs[] = {
 #if defined(F_SETPIPE_SZ)
 	{ OPT_pipe_size,	stress_set_pipe_size },
+	{ OPT_pipe_sweep,	stress_set_pipe_sweep },
 #endif
 	{ OPT_pipe_data_size,	stress_set_pipe_data_size },
 	{ 0,			NULL }
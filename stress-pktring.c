@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2023 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-capabilities.h"
+#include "core-net.h"
+
+#if defined(HAVE_LINUX_IF_ETHER_H)
+#include <linux/if_ether.h>
+#endif
+
+#if defined(HAVE_LINUX_IF_PACKET_H)
+#include <linux/if_packet.h>
+#endif
+
+#if defined(HAVE_LINUX_FILTER_H)
+#include <linux/filter.h>
+#endif
+
+#if defined(HAVE_NET_IF_H)
+#include <net/if.h>
+#endif
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
+#include <arpa/inet.h>
+
+#define MIN_PKTRING_SIZE	(64)
+#define MAX_PKTRING_SIZE	(1500)
+#define DEFAULT_PKTRING_SIZE	(64)
+
+#define PKTRING_FRAME_SIZE	(2048)		/* TX ring frame size */
+#define PKTRING_TX_BLOCK_SIZE	(64 * KB)
+#define PKTRING_TX_BLOCK_NR	(16)
+#define PKTRING_RX_BLOCK_SIZE	(256 * KB)
+#define PKTRING_RX_BLOCK_NR	(32)
+#define PKTRING_RX_RETIRE_MS	(10)		/* RX block retire timeout */
+#define PKTRING_TX_BATCH	(64)		/* frames queued per send */
+
+/* IEEE 802 local experimental ethertype, not handled by the stack */
+#define PKTRING_ETH_P		(0x88b5)
+
+/*
+ *  payload following the ethernet header, the instance
+ *  is used to filter out frames from other instances
+ */
+typedef struct {
+	uint16_t instance;	/* stressor instance, network order */
+	uint16_t pad;
+	uint32_t seq;		/* frame sequence number */
+} stress_pktring_hdr_t;
+
+typedef struct {
+	uint64_t sent;		/* frames queued to the TX ring */
+	double duration;	/* sender run time in seconds */
+} stress_pktring_stats_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"pktring N",		"start N workers exercising mmap'd packet TX and RX rings" },
+	{ NULL,	"pktring-if I",		"use network interface I, default is lo" },
+	{ NULL,	"pktring-ops N",	"stop after N packets are received" },
+	{ NULL,	"pktring-size N",	"ethernet frame size in bytes, default is 64" },
+	{ NULL,	NULL,			NULL }
+};
+
+/*
+ *  stress_pktring_supported()
+ *      check if we can run this with CAP_NET_RAW
+ */
+static int stress_pktring_supported(const char *name)
+{
+	if (!stress_check_capability(SHIM_CAP_NET_RAW)) {
+		pr_inf_skip("%s stressor will be skipped, "
+			"need to be running with CAP_NET_RAW "
+			"rights for this stressor\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+static int stress_set_pktring_if(const char *name)
+{
+	return stress_set_setting("pktring-if", TYPE_ID_STR, name);
+}
+
+static int stress_set_pktring_size(const char *opt)
+{
+	int pktring_size;
+
+	pktring_size = (int)stress_get_uint32(opt);
+	stress_check_range("pktring-size", (uint64_t)pktring_size,
+		MIN_PKTRING_SIZE, MAX_PKTRING_SIZE);
+	return stress_set_setting("pktring-size", TYPE_ID_INT, &pktring_size);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_pktring_if,	stress_set_pktring_if },
+	{ OPT_pktring_size,	stress_set_pktring_size },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LINUX_IF_ETHER_H) &&	\
+    defined(HAVE_LINUX_IF_PACKET_H) &&	\
+    defined(HAVE_NET_IF_H) &&		\
+    defined(HAVE_POLL_H) &&		\
+    defined(PACKET_VERSION) &&		\
+    defined(PACKET_RX_RING) &&		\
+    defined(PACKET_TX_RING) &&		\
+    defined(TPACKET3_HDRLEN)
+
+/*
+ *  stress_pktring_attach_filter()
+ *	only accept frames for this instance so that the
+ *	other instances' frames are dropped in the kernel
+ */
+static void stress_pktring_attach_filter(const int fd, const uint32_t instance)
+{
+#if defined(HAVE_LINUX_FILTER_H) &&	\
+    defined(SO_ATTACH_FILTER)
+	struct sock_filter code[] = {
+		/* A = instance field after the ethernet header */
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, sizeof(struct ethhdr)),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, instance, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, 0xffff),
+		BPF_STMT(BPF_RET | BPF_K, 0),
+	};
+	struct sock_fprog prog;
+
+	prog.len = SIZEOF_ARRAY(code);
+	prog.filter = code;
+	VOID_RET(int, setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)));
+#else
+	(void)fd;
+	(void)instance;
+#endif
+}
+
+/*
+ *  stress_pktring_sender()
+ *	fill TPACKET_V2 TX ring frames and kick the kernel
+ *	to transmit them in batches
+ */
+static void NORETURN OPTIMIZE3 stress_pktring_sender(
+	const stress_args_t *args,
+	const struct ifreq *hwaddr,
+	const int ifindex,
+	const int pktring_size,
+	stress_pktring_stats_t *stats)
+{
+	const size_t frame_nr = (PKTRING_TX_BLOCK_SIZE / PKTRING_FRAME_SIZE) * PKTRING_TX_BLOCK_NR;
+	const size_t ring_size = PKTRING_TX_BLOCK_SIZE * PKTRING_TX_BLOCK_NR;
+	const size_t data_offset = TPACKET_ALIGN(sizeof(struct tpacket2_hdr));
+	struct tpacket_req req;
+	struct sockaddr_ll sll;
+	uint8_t *ring = MAP_FAILED;
+	size_t frame = 0;
+	uint32_t seq = 0;
+	int fd, val, rc = EXIT_FAILURE;
+	double t_start;
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	/* protocol 0, the sender does not receive any frames */
+	if ((fd = socket(AF_PACKET, SOCK_RAW, 0)) < 0) {
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err;
+	}
+	val = TPACKET_V2;
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &val, sizeof(val)) < 0) {
+		pr_fail("%s: setsockopt PACKET_VERSION failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_close;
+	}
+#if defined(PACKET_QDISC_BYPASS)
+	val = 1;
+	VOID_RET(int, setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &val, sizeof(val)));
+#endif
+	(void)memset(&req, 0, sizeof(req));
+	req.tp_block_size = PKTRING_TX_BLOCK_SIZE;
+	req.tp_block_nr = PKTRING_TX_BLOCK_NR;
+	req.tp_frame_size = PKTRING_FRAME_SIZE;
+	req.tp_frame_nr = (unsigned int)frame_nr;
+	if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+		pr_fail("%s: setsockopt PACKET_TX_RING failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_close;
+	}
+	ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		pr_fail("%s: mmap of %zd byte TX ring failed, errno=%d (%s)\n",
+			args->name, ring_size, errno, strerror(errno));
+		goto err_close;
+	}
+
+	(void)memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = 0;
+	sll.sll_ifindex = ifindex;
+	if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+		pr_fail("%s: bind failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_unmap;
+	}
+
+	/* pre-fill the constant part of all the frames */
+	for (frame = 0; frame < frame_nr; frame++) {
+		uint8_t *data = ring + (frame * PKTRING_FRAME_SIZE) + data_offset;
+		struct ethhdr *eth = (struct ethhdr *)data;
+		stress_pktring_hdr_t *hdr = (stress_pktring_hdr_t *)(data + sizeof(*eth));
+
+		(void)memset(data, 0, (size_t)pktring_size);
+		(void)memcpy(eth->h_dest, hwaddr->ifr_addr.sa_data, sizeof(eth->h_dest));
+		(void)memcpy(eth->h_source, hwaddr->ifr_addr.sa_data, sizeof(eth->h_source));
+		eth->h_proto = htons(PKTRING_ETH_P);
+		hdr->instance = htons((uint16_t)args->instance);
+	}
+	frame = 0;
+
+	t_start = stress_time_now();
+	while (keep_stressing_flag()) {
+		size_t queued = 0;
+
+		while (queued < PKTRING_TX_BATCH) {
+			uint8_t *ptr = ring + (frame * PKTRING_FRAME_SIZE);
+			volatile struct tpacket2_hdr *tp = (volatile struct tpacket2_hdr *)ptr;
+			stress_pktring_hdr_t *hdr = (stress_pktring_hdr_t *)
+				(ptr + data_offset + sizeof(struct ethhdr));
+
+			if (tp->tp_status != TP_STATUS_AVAILABLE)
+				break;
+			hdr->seq = htonl(seq++);
+			tp->tp_len = (uint32_t)pktring_size;
+			shim_mb();
+			tp->tp_status = TP_STATUS_SEND_REQUEST;
+			queued++;
+			frame++;
+			if (frame >= frame_nr)
+				frame = 0;
+		}
+		if (queued) {
+			stats->sent += queued;
+		} else {
+			struct pollfd pfd;
+
+			/* ring full, wait for the kernel to free frames */
+			pfd.fd = fd;
+			pfd.events = POLLOUT;
+			pfd.revents = 0;
+			(void)poll(&pfd, 1, 10);
+		}
+		if (UNLIKELY(send(fd, NULL, 0, MSG_DONTWAIT) < 0)) {
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+			    (errno != ENOBUFS) && (errno != EINTR)) {
+				pr_fail("%s: send failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				break;
+			}
+		}
+	}
+	stats->duration = stress_time_now() - t_start;
+	rc = EXIT_SUCCESS;
+
+err_unmap:
+	(void)munmap((void *)ring, ring_size);
+err_close:
+	(void)close(fd);
+err:
+	_exit(rc);
+}
+
+/*
+ *  stress_pktring_receiver()
+ *	consume frames from the TPACKET_V3 RX ring block by block,
+ *	each frame received is a bogo op
+ */
+static int OPTIMIZE3 stress_pktring_receiver(
+	const stress_args_t *args,
+	const int fd,
+	uint8_t *ring,
+	uint64_t *lost)
+{
+	const uint16_t instance = htons((uint16_t)args->instance);
+	uint32_t expected = 0;
+	size_t block = 0;
+
+	*lost = 0;
+	do {
+		struct tpacket_block_desc *bd = (struct tpacket_block_desc *)
+			(ring + (block * PKTRING_RX_BLOCK_SIZE));
+		struct tpacket3_hdr *tp;
+		uint32_t i, num_pkts;
+		uint64_t n = 0;
+
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)) {
+			struct pollfd pfd;
+
+			pfd.fd = fd;
+			pfd.events = POLLIN | POLLERR;
+			pfd.revents = 0;
+			(void)poll(&pfd, 1, 100);
+			continue;
+		}
+
+		num_pkts = bd->hdr.bh1.num_pkts;
+		tp = (struct tpacket3_hdr *)((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+		for (i = 0; i < num_pkts; i++) {
+			const uint8_t *data = (uint8_t *)tp + tp->tp_mac;
+			const stress_pktring_hdr_t *hdr =
+				(const stress_pktring_hdr_t *)(data + sizeof(struct ethhdr));
+
+			/* the filter may not be attached, check the instance */
+			if (LIKELY(hdr->instance == instance)) {
+				const uint32_t seq = ntohl(hdr->seq);
+
+				if (seq > expected)
+					*lost += seq - expected;
+				expected = seq + 1;
+				n++;
+			}
+			tp = (struct tpacket3_hdr *)((uint8_t *)tp + tp->tp_next_offset);
+		}
+		add_counter(args, n);
+
+		shim_mb();
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		block++;
+		if (block >= PKTRING_RX_BLOCK_NR)
+			block = 0;
+	} while (keep_stressing(args));
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_pktring
+ *	stress mmap'd AF_PACKET TX and RX rings
+ */
+static int stress_pktring(const stress_args_t *args)
+{
+	const size_t ring_size = PKTRING_RX_BLOCK_SIZE * PKTRING_RX_BLOCK_NR;
+	char *pktring_if = "lo";
+	int pktring_size = DEFAULT_PKTRING_SIZE;
+	int fd, val, rc = EXIT_FAILURE;
+	struct ifreq hwaddr, idx;
+	struct tpacket_req3 req;
+	struct sockaddr_ll sll;
+	stress_pktring_stats_t *stats;
+	uint8_t *ring;
+	uint64_t lost = 0;
+	double t_start, duration, rate;
+	pid_t pid;
+
+	(void)stress_get_setting("pktring-if", &pktring_if);
+	(void)stress_get_setting("pktring-size", &pktring_size);
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	(void)memset(&hwaddr, 0, sizeof(hwaddr));
+	(void)shim_strlcpy(hwaddr.ifr_name, pktring_if, sizeof(hwaddr.ifr_name));
+	(void)memset(&idx, 0, sizeof(idx));
+	(void)shim_strlcpy(idx.ifr_name, pktring_if, sizeof(idx.ifr_name));
+	if ((ioctl(fd, SIOCGIFHWADDR, &hwaddr) < 0) ||
+	    (ioctl(fd, SIOCGIFINDEX, &idx) < 0)) {
+		pr_inf_skip("%s: cannot get details of interface '%s', errno=%d (%s), "
+			"skipping stressor\n", args->name, pktring_if,
+			errno, strerror(errno));
+		(void)close(fd);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)close(fd);
+
+	stats = (stress_pktring_stats_t *)mmap(NULL, sizeof(*stats),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zd bytes for statistics, skipping stressor\n",
+			args->name, sizeof(*stats));
+		return EXIT_NO_RESOURCE;
+	}
+
+	if ((fd = socket(AF_PACKET, SOCK_RAW, htons(PKTRING_ETH_P))) < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_stats;
+	}
+	val = TPACKET_V3;
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &val, sizeof(val)) < 0) {
+		pr_inf_skip("%s: TPACKET_V3 is not supported, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto err_close;
+	}
+	(void)memset(&req, 0, sizeof(req));
+	req.tp_block_size = PKTRING_RX_BLOCK_SIZE;
+	req.tp_block_nr = PKTRING_RX_BLOCK_NR;
+	req.tp_frame_size = PKTRING_FRAME_SIZE;
+	req.tp_frame_nr = (PKTRING_RX_BLOCK_SIZE / PKTRING_FRAME_SIZE) * PKTRING_RX_BLOCK_NR;
+	req.tp_retire_blk_tov = PKTRING_RX_RETIRE_MS;
+	if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: setsockopt PACKET_RX_RING failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_close;
+	}
+	ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zd byte RX ring, errno=%d (%s), "
+			"skipping stressor\n", args->name, ring_size,
+			errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto err_close;
+	}
+	stress_pktring_attach_filter(fd, (uint32_t)args->instance);
+
+	(void)memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(PKTRING_ETH_P);
+	sll.sll_ifindex = idx.ifr_ifindex;
+	if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+		pr_fail("%s: bind failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_unmap;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(errno))
+			goto again;
+		if (!keep_stressing(args)) {
+			rc = EXIT_SUCCESS;
+			goto err_unmap;
+		}
+		pr_fail("%s: fork failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_unmap;
+	} else if (pid == 0) {
+		(void)munmap((void *)ring, ring_size);
+		(void)close(fd);
+		stress_pktring_sender(args, &hwaddr, idx.ifr_ifindex, pktring_size, stats);
+	} else {
+		int status;
+
+		t_start = stress_time_now();
+		rc = stress_pktring_receiver(args, fd, ring, &lost);
+		duration = stress_time_now() - t_start;
+
+		/* stop the sender, it reports its send count on exit */
+		(void)kill(pid, SIGALRM);
+		(void)shim_waitpid(pid, &status, 0);
+
+		rate = (duration > 0.0) ? (double)get_counter(args) / duration : 0.0;
+		stress_metrics_set(args, 0, "Mpps received", rate / 1000000.0);
+		rate = (stats->duration > 0.0) ? (double)stats->sent / stats->duration : 0.0;
+		stress_metrics_set(args, 1, "Mpps sent", rate / 1000000.0);
+		stress_metrics_set(args, 2, "frames lost", (double)lost);
+#if defined(PACKET_STATISTICS)
+		{
+			struct tpacket_stats_v3 tp_stats;
+			socklen_t len = sizeof(tp_stats);
+
+			(void)memset(&tp_stats, 0, sizeof(tp_stats));
+			if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &tp_stats, &len) == 0)
+				stress_metrics_set(args, 3, "frames dropped by RX ring",
+					(double)tp_stats.tp_drops);
+		}
+#endif
+	}
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+err_unmap:
+	(void)munmap((void *)ring, ring_size);
+err_close:
+	(void)close(fd);
+err_stats:
+	(void)munmap((void *)stats, sizeof(*stats));
+
+	return rc;
+}
+
+stressor_info_t stress_pktring_info = {
+	.stressor = stress_pktring,
+	.class = CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.supported = stress_pktring_supported,
+	.help = help
+};
+#else
+stressor_info_t stress_pktring_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.supported = stress_pktring_supported,
+	.help = help,
+	.unimplemented_reason = "built without linux/if_ether.h, linux/if_packet.h, net/if.h, poll.h or TPACKET_V3 ring support"
+};
+#endif
@@ -17,6 +17,8 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
+#include "stress-plugin.h"
 
 #if defined(HAVE_LINK_H)
 #include <link.h>
@@ -27,12 +29,33 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"plugin N",	   "start N workers exercising random plugins" },
+	{ NULL,	"plugin-batch N",  "operations per plugin run call (version 2 plugins)" },
 	{ NULL,	"plugin-method M", "set plugin stress method" },
 	{ NULL,	"plugin-ops N",	   "stop after N plugin bogo operations" },
 	{ NULL, "plugin-so file",  "specify plugin shared object file" },
 	{ NULL, NULL,		   NULL }
 };
 
+#define MIN_PLUGIN_BATCH	(1)
+#define MAX_PLUGIN_BATCH	(1000000000ULL)
+#define DEFAULT_PLUGIN_BATCH	(1024)
+
+#define STRESS_PLUGIN_METRICS_MAX	(32)
+
+/*
+ *  stress_set_plugin_batch()
+ *	set number of operations per version 2 plugin run call
+ */
+static int stress_set_plugin_batch(const char *opt)
+{
+	uint64_t plugin_batch;
+
+	plugin_batch = stress_get_uint64(opt);
+	stress_check_range("plugin-batch", plugin_batch,
+		MIN_PLUGIN_BATCH, MAX_PLUGIN_BATCH);
+	return stress_set_setting("plugin-batch", TYPE_ID_UINT64, &plugin_batch);
+}
+
 #if defined(HAVE_LINK_H) &&	\
     defined(HAVE_LIB_DL) &&	\
     !defined(BUILD_STATIC)
@@ -41,12 +64,38 @@ typedef int (*stress_plugin_func)(void);
 
 typedef struct {
 	const char *name;
-	stress_plugin_func func;
+	stress_plugin_func func;		/* version 1 method */
+	const stress_plugin_method_t *method;	/* version 2 method */
 } stress_plugin_method_info_t;
 
+/* metric set by a version 2 plugin */
+typedef struct {
+	char description[64];
+	double value;
+} stress_plugin_metric_t;
+
+/* per method version 2 run statistics */
+typedef struct {
+	uint64_t ops;			/* operations completed by run */
+	double duration;		/* seconds spent in run */
+} stress_plugin_method_stats_t;
+
+/* version 2 state shared between the stressor and its child */
+typedef struct {
+	bool failed;			/* a method init or run failed */
+	size_t metrics_num;
+	stress_plugin_metric_t metrics[STRESS_PLUGIN_METRICS_MAX];
+	stress_plugin_method_stats_t stats[];	/* indexed as stress_plugin_methods */
+} stress_plugin_shared_t;
+
 static stress_plugin_method_info_t *stress_plugin_methods;
 static size_t stress_plugin_methods_num;
 static void *stress_plugin_so;
+static const stress_plugin_v2_t *stress_plugin_v2;
+
+/* host API state, only valid in the child running the plugin */
+static const stress_args_t *stress_plugin_args;
+static stress_plugin_shared_t *stress_plugin_shared;
 
 typedef struct {
 	const int signum;	/* Signal number */
@@ -140,6 +189,102 @@ static int stress_plugin_method_all(void)
 	return ret;
 }
 
+static bool stress_plugin_api_keep_running(void)
+{
+	return keep_stressing(stress_plugin_args);
+}
+
+static uint64_t stress_plugin_api_counter(void)
+{
+	return get_counter(stress_plugin_args);
+}
+
+static uint64_t stress_plugin_api_now_ns(void)
+{
+	return stress_latency_now();
+}
+
+static void stress_plugin_api_latency(const uint64_t nsec)
+{
+	if (stress_plugin_args->latency)
+		stress_latency_add(stress_plugin_args->latency, nsec);
+}
+
+/*
+ *  stress_plugin_api_metric()
+ *	set a named plugin metric, the first STRESS_PLUGIN_METRICS_MAX
+ *	distinct descriptions are kept
+ */
+static int stress_plugin_api_metric(const char *description, const double value)
+{
+	stress_plugin_metric_t *metrics = stress_plugin_shared->metrics;
+	size_t i;
+
+	if (!description)
+		return -1;
+	for (i = 0; i < stress_plugin_shared->metrics_num; i++) {
+		if (!strncmp(metrics[i].description, description, sizeof(metrics[i].description) - 1)) {
+			metrics[i].value = value;
+			return 0;
+		}
+	}
+	if (i >= STRESS_PLUGIN_METRICS_MAX)
+		return -1;
+	(void)shim_strlcpy(metrics[i].description, description, sizeof(metrics[i].description));
+	metrics[i].value = value;
+	stress_plugin_shared->metrics_num++;
+
+	return 0;
+}
+
+/*
+ *  stress_set_plugin_so_v2()
+ *	load the methods of a version 2 plugin, returns 1 if the
+ *	plugin has no version 2 descriptor, 0 on success or -1
+ *	on failure
+ */
+static int stress_set_plugin_so_v2(const char *opt)
+{
+	size_t i;
+
+	stress_plugin_v2 = (const stress_plugin_v2_t *)dlsym(stress_plugin_so, STRESS_PLUGIN_V2_SYMBOL);
+	if (!stress_plugin_v2)
+		return 1;
+
+	if (stress_plugin_v2->version != STRESS_PLUGIN_API_VERSION) {
+		fprintf(stderr, "plugin-so: file %s uses plugin API version %" PRIu32
+			", expecting version %d\n", opt, stress_plugin_v2->version,
+			STRESS_PLUGIN_API_VERSION);
+		return -1;
+	}
+	if (!stress_plugin_v2->methods || !stress_plugin_v2->methods_num) {
+		fprintf(stderr, "plugin-so: cannot find any methods in file %s\n", opt);
+		return -1;
+	}
+
+	stress_plugin_methods = calloc((size_t)stress_plugin_v2->methods_num + 1, sizeof(*stress_plugin_methods));
+	if (!stress_plugin_methods) {
+		fprintf(stderr, "plugin-so: cannot allocate %" PRIu32 " plugin methods\n",
+			stress_plugin_v2->methods_num);
+		return -1;
+	}
+	stress_plugin_methods[0].name = "all";
+
+	for (i = 0; i < stress_plugin_v2->methods_num; i++) {
+		const stress_plugin_method_t *method = &stress_plugin_v2->methods[i];
+
+		if (!method->name || !method->run) {
+			fprintf(stderr, "plugin-so: method %zd in file %s has no name or run function\n", i, opt);
+			return -1;
+		}
+		stress_plugin_methods[i + 1].name = method->name;
+		stress_plugin_methods[i + 1].method = method;
+	}
+	stress_plugin_methods_num = (size_t)stress_plugin_v2->methods_num + 1;
+
+	return 0;
+}
+
 /*
  *  stress_set_plugin_so()
  *     set default plugin shared object file
@@ -152,6 +297,7 @@ static int stress_set_plugin_so(const char *opt)
 	char * strtab = NULL;
 	unsigned long symentries = 0;
 	size_t i, size, n_funcs;
+	int ret;
 
 	stress_plugin_methods = NULL;
 	stress_plugin_methods_num = 0;
@@ -162,6 +308,10 @@ static int stress_set_plugin_so(const char *opt)
 		return -1;
 	}
 
+	ret = stress_set_plugin_so_v2(opt);
+	if (ret <= 0)
+		return ret;
+
 	dlinfo(stress_plugin_so, RTLD_DI_LINKMAP, &map);
 
 	for (section = map->l_ld; section->d_tag != DT_NULL; ++section) {
@@ -271,17 +421,129 @@ static int stress_set_plugin_method(const char *name)
 	return -1;
 }
 
+/*
+ *  stress_plugin_run_v2()
+ *	run a version 2 plugin method, or all the methods round-robin,
+ *	in batches of batch operations until the stressor stops
+ */
+static int stress_plugin_run_v2(
+	const stress_args_t *args,
+	const size_t plugin_method,
+	const uint64_t batch)
+{
+	stress_plugin_api_t api;
+	void **ctx;
+	const size_t first = plugin_method ? plugin_method : 1;
+	const size_t last = plugin_method ? plugin_method : stress_plugin_methods_num - 1;
+	size_t i, n_init;
+	int rc = EXIT_SUCCESS;
+
+	stress_plugin_args = args;
+
+	(void)memset(&api, 0, sizeof(api));
+	api.version = STRESS_PLUGIN_API_VERSION;
+	api.size = (uint32_t)sizeof(api);
+	api.name = args->name;
+	api.instance = args->instance;
+	api.num_instances = args->num_instances;
+	api.max_ops = args->max_ops;
+	api.batch = batch;
+	api.keep_running = stress_plugin_api_keep_running;
+	api.counter = stress_plugin_api_counter;
+	api.now_ns = stress_plugin_api_now_ns;
+	api.latency = stress_plugin_api_latency;
+	api.metric = stress_plugin_api_metric;
+
+	ctx = calloc(stress_plugin_methods_num, sizeof(*ctx));
+	if (!ctx) {
+		pr_inf("%s: cannot allocate %zd plugin contexts\n",
+			args->name, stress_plugin_methods_num);
+		return EXIT_NO_RESOURCE;
+	}
+
+	for (n_init = first; n_init <= last; n_init++) {
+		const stress_plugin_method_t *method = stress_plugin_methods[n_init].method;
+
+		if (method->init && method->init(&api, &ctx[n_init])) {
+			pr_fail("%s: plugin method '%s' init failed\n",
+				args->name, method->name);
+			stress_plugin_shared->failed = true;
+			rc = EXIT_FAILURE;
+			goto deinit;
+		}
+	}
+
+	do {
+		for (i = first; (i <= last) && keep_stressing(args); i++) {
+			const stress_plugin_method_t *method = stress_plugin_methods[i].method;
+			uint64_t n = batch;
+			int64_t done;
+			double t;
+
+			if (args->max_ops)
+				n = STRESS_MINIMUM(n, args->max_ops - get_counter(args));
+			t = stress_time_now();
+			done = method->run(ctx[i], n);
+			if (done < 0) {
+				pr_fail("%s: plugin method '%s' failed\n",
+					args->name, method->name);
+				stress_plugin_shared->failed = true;
+				rc = EXIT_FAILURE;
+				goto deinit;
+			}
+			stress_plugin_shared->stats[i].duration += stress_time_now() - t;
+			stress_plugin_shared->stats[i].ops += (uint64_t)done;
+			add_counter(args, (uint64_t)done);
+		}
+	} while (keep_stressing(args));
+
+deinit:
+	for (i = first; i < n_init; i++) {
+		const stress_plugin_method_t *method = stress_plugin_methods[i].method;
+
+		if (method->deinit)
+			method->deinit(ctx[i]);
+	}
+	free(ctx);
+
+	return rc;
+}
+
+/*
+ *  stress_plugin_metrics_v2()
+ *	report per method operation rates and the plugin metrics
+ */
+static void stress_plugin_metrics_v2(const stress_args_t *args)
+{
+	size_t i, idx = 0;
+
+	for (i = 1; i < stress_plugin_methods_num; i++) {
+		const stress_plugin_method_stats_t *stats = &stress_plugin_shared->stats[i];
+		char str[64];
+
+		if (stats->duration <= 0.0)
+			continue;
+		(void)snprintf(str, sizeof(str), "%s ops per sec", stress_plugin_methods[i].name);
+		stress_metrics_set(args, idx++, str, (double)stats->ops / stats->duration);
+	}
+	for (i = 0; i < stress_plugin_shared->metrics_num; i++)
+		stress_metrics_set(args, idx++, stress_plugin_shared->metrics[i].description,
+			stress_plugin_shared->metrics[i].value);
+}
+
 /*
  *  stress_plugin
  *	stress with random plugins
  */
 static int stress_plugin(const stress_args_t *args)
 {
-	int rc;
+	int rc = EXIT_SUCCESS;
 	size_t i;
 	size_t plugin_method = 0;
+	uint64_t plugin_batch = DEFAULT_PLUGIN_BATCH;
 	stress_plugin_func func;
 	const size_t sig_count_size = MAX_SIGS * sizeof(*sig_count);
+	size_t shared_size = 0;
 	bool report_sigs;
 
 	if (!stress_plugin_so) {
@@ -291,6 +553,7 @@ static int stress_plugin(const stress_args_t *args)
 	}
 
 	(void)stress_get_setting("plugin-method", &plugin_method);
+	(void)stress_get_setting("plugin-batch", &plugin_batch);
 	if (!stress_plugin_methods) {
 		if (args->instance == 0)
 			pr_inf("%s: no plugin methods found, need to specify a valid shared library with --plug-so\n",
@@ -315,6 +578,20 @@ static int stress_plugin(const stress_args_t *args)
 		return EXIT_NO_RESOURCE;
 	}
 
+	if (stress_plugin_v2) {
+		shared_size = sizeof(*stress_plugin_shared) +
+			(stress_plugin_methods_num * sizeof(stress_plugin_shared->stats[0]));
+		stress_plugin_shared = (stress_plugin_shared_t *)mmap(NULL, shared_size,
+			PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+		if (stress_plugin_shared == MAP_FAILED) {
+			pr_fail("%s: mmap failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			(void)munmap(sig_count, sig_count_size);
+			(void)dlclose(stress_plugin_so);
+			return EXIT_NO_RESOURCE;
+		}
+	}
+
 	func = stress_plugin_methods[plugin_method].func;
 	if (args->instance == 0)
 		pr_dbg("%s: exercising plugin method '%s'\n", args->name, stress_plugin_methods[plugin_method].name);
@@ -354,6 +631,9 @@ again:
 			/* Disable stack smashing messages */
 			stress_set_stack_smash_check_flag(false);
 
+			if (stress_plugin_v2)
+				_exit(stress_plugin_run_v2(args, plugin_method, plugin_batch));
+
 			do {
 				if (func())
 					break;
@@ -372,12 +652,16 @@ again:
 				(void)kill(pid, SIGTERM);
 				(void)kill(pid, SIGKILL);
 				(void)shim_waitpid(pid, &status, 0);
+			} else if (stress_plugin_v2 && stress_plugin_shared->failed) {
+				rc = EXIT_FAILURE;
+				break;
 			}
 		}
 	} while (keep_stressing(args));
 
 finish:
-	rc = EXIT_SUCCESS;
+	if (stress_plugin_v2)
+		stress_plugin_metrics_v2(args);
 
 	for (report_sigs = false, i = 0; i < MAX_SIGS; i++) {
 		if (sig_count[i] && stress_plugin_report_signum((int)i)) {
@@ -400,11 +684,14 @@ err:
 
 	free(stress_plugin_methods);
 	(void)dlclose(stress_plugin_so);
+	if (stress_plugin_v2)
+		(void)munmap((void *)stress_plugin_shared, shared_size);
 	(void)munmap(sig_count, sig_count_size);
 	return rc;
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_plugin_batch,	stress_set_plugin_batch },
 	{ OPT_plugin_method,	stress_set_plugin_method },
 	{ OPT_plugin_so,	stress_set_plugin_so },
 	{ 0,			NULL }
@@ -428,6 +715,7 @@ static int stress_set_plugin_ignored(const char *opt)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_plugin_batch,	stress_set_plugin_batch },
 	{ OPT_plugin_method,	stress_set_plugin_ignored },
 	{ OPT_plugin_so,	stress_set_plugin_ignored },
 	{ 0,			NULL }
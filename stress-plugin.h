@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef STRESS_PLUGIN_H
+#define STRESS_PLUGIN_H
+
+/*
+ *  stress-ng plugin ABI version 2
+ *
+ *  A plugin shared object exports a stress_plugin_v2 descriptor that
+ *  lists its methods. Each method has optional init and deinit
+ *  hooks and a run hook that performs a batch of operations per call,
+ *  so the call overhead is amortized for tiny kernels. The host API
+ *  passed to init allows plugins to set named metrics, add latency
+ *  samples and read the bogo-op counter. This header only depends
+ *  on the C standard headers so it can be included by plugins.
+ *
+ *  Plugins without a stress_plugin_v2 descriptor are loaded with the
+ *  version 1 ABI, where every exported int stress_*(void) function is
+ *  a method that performs one bogo-op per call.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STRESS_PLUGIN_API_VERSION	(2)
+
+/* host services, valid from init until deinit returns */
+typedef struct stress_plugin_api {
+	uint32_t version;		/* STRESS_PLUGIN_API_VERSION of the host */
+	uint32_t size;			/* sizeof(stress_plugin_api_t) of the host */
+	const char *name;		/* stressor name */
+	uint32_t instance;		/* stressor instance number */
+	uint32_t num_instances;		/* number of stressor instances */
+	uint64_t max_ops;		/* bogo-op limit, 0 for no limit */
+	uint64_t batch;			/* operations requested per run call */
+
+	/* false when the plugin should stop and return from run */
+	bool (*keep_running)(void);
+	/* current bogo-op counter of this instance */
+	uint64_t (*counter)(void);
+	/* monotonic time in nanoseconds */
+	uint64_t (*now_ns)(void);
+	/* add a latency sample to the --latency-hist histogram */
+	void (*latency)(const uint64_t nsec);
+	/* set a named metric, returns 0 or -1 if the metrics table is full */
+	int (*metric)(const char *description, const double value);
+} stress_plugin_api_t;
+
+typedef struct stress_plugin_method {
+	const char *name;		/* method name for --plugin-method */
+	/* optional, set *ctx for run and deinit, return 0 on success */
+	int (*init)(const stress_plugin_api_t *api, void **ctx);
+	/* perform up to batch operations, return the number done or -1 on failure */
+	int64_t (*run)(void *ctx, const uint64_t batch);
+	/* optional, release resources allocated by init */
+	void (*deinit)(void *ctx);
+} stress_plugin_method_t;
+
+typedef struct stress_plugin_v2 {
+	uint32_t version;		/* STRESS_PLUGIN_API_VERSION of the plugin */
+	uint32_t methods_num;		/* number of entries in methods */
+	const stress_plugin_method_t *methods;
+} stress_plugin_v2_t;
+
+/* name of the descriptor symbol exported by a version 2 plugin */
+#define STRESS_PLUGIN_V2_SYMBOL		"stress_plugin_v2"
+
+#endif
@@ -31,12 +31,18 @@
 #define STRESS_PREFETCH_OFFSETS	(128)
 #define STRESS_CACHE_LINE_SIZE	(64)
 
+/* sweep buffer is this multiple of the L3 size to defeat the cache */
+#define STRESS_PREFETCH_SWEEP_SCALE	(4)
+#define STRESS_PREFETCH_SWEEP_MAX	(256 * MB)
+/* maximum number of random cache lines read per gather pass */
+#define STRESS_PREFETCH_GATHER_MAX	(64 * 1024)
 
 static const stress_help_t help[] = {
 	{ NULL,	"prefetch N" ,		"start N workers exercising memory prefetching " },
 	{ NULL,	"prefetch-l3-size N",	"specify the L3 cache size of the CPU" },
 	{ NULL, "prefetch-method M",	"specify the prefetch method" },
 	{ NULL,	"prefetch-ops N",	"stop after N bogo prefetching operations" },
+	{ NULL,	"prefetch-sweep",	"sweep prefetch distance for stream and gather reads" },
 	{ NULL,	NULL,                   NULL }
 };
 
@@ -63,6 +69,20 @@ typedef struct {
 #define STRESS_PREFETCH_X86_PREFETCHNTA	(6)
 #define STRESS_PREFETCH_PPC64_DCBT	(7)
 #define STRESS_PREFETCH_PPC64_DCBTST	(8)
+#define STRESS_PREFETCH_X86_PREFETCHW	(9)
+
+#define STRESS_PREFETCH_PATTERN_STREAM	(0)
+#define STRESS_PREFETCH_PATTERN_GATHER	(1)
+
+static const char * const prefetch_patterns[] = {
+	"stream",
+	"gather",
+};
+
+/* prefetch distances in cache lines, 0 = no prefetching */
+static const size_t prefetch_distances[] = {
+	0, 1, 2, 4, 8, 16, 32, 64, 128
+};
 
 static inline bool stress_prefetch_true(void)
 {
@@ -85,6 +105,9 @@ stress_prefetch_method_t prefetch_methods[] = {
 #if defined(HAVE_ASM_X86_PREFETCHNTA)
 	{ "prefetchnta",	STRESS_PREFETCH_X86_PREFETCHNTA, stress_cpu_x86_has_sse },
 #endif
+#if defined(HAVE_ASM_X86_PREFETCHW)
+	{ "prefetchw",		STRESS_PREFETCH_X86_PREFETCHW,	stress_cpu_x86_has_prefetchw },
+#endif
 #if defined(HAVE_ASM_PPC64_DCBT)
 	{ "dcbt",		STRESS_PREFETCH_PPC64_DCBT,	stress_prefetch_true },
 #endif
@@ -106,6 +129,14 @@ static int stress_set_prefetch_L3_size(const char *opt)
 	return stress_set_setting("prefetch-L3-size", TYPE_ID_SIZE_T, &sz);
 }
 
+static int stress_set_prefetch_sweep(const char *opt)
+{
+	bool prefetch_sweep = true;
+
+	(void)opt;
+	return stress_set_setting("prefetch-sweep", TYPE_ID_BOOL, &prefetch_sweep);
+}
+
 static int stress_set_prefetch_method(const char *opt)
 {
 	size_t i;
@@ -281,6 +312,11 @@ static inline void OPTIMIZE3 stress_prefetch_benchmark(
 			STRESS_PREFETCH_LOOP(stress_asm_x86_prefetchnta);
 			break;
 #endif
+#if defined(HAVE_ASM_X86_PREFETCHW)
+		case STRESS_PREFETCH_X86_PREFETCHW:
+			STRESS_PREFETCH_LOOP(stress_asm_x86_prefetchw);
+			break;
+#endif
 #if defined(HAVE_ASM_PPC64_DCBT)
 		case STRESS_PREFETCH_PPC64_DCBT:
 			STRESS_PREFETCH_LOOP(stress_asm_ppc64_dcbt);
@@ -303,6 +339,254 @@ static inline void OPTIMIZE3 stress_prefetch_benchmark(
 	(*total_count)++;
 }
 
+#define STRESS_PREFETCH_GATHER_LOOP(func)		\
+	for (k = 0; k < n_idx; k++) {			\
+		func((void *)(data + idx[k + dist]));	\
+		sum += data[idx[k]];			\
+	}
+
+/*
+ *  stress_prefetch_gather_benchmark()
+ *	read random cache lines via an index array, prefetching
+ *	the line dist index entries ahead
+ */
+static inline void OPTIMIZE3 stress_prefetch_gather_benchmark(
+	stress_prefetch_info_t *info,
+	const size_t prefetch_method,
+	volatile uint64_t *RESTRICT data,
+	const size_t data_size,
+	const size_t *RESTRICT idx,
+	const size_t n_idx,
+	const size_t dist)
+{
+	double t1, t2;
+	register size_t k;
+	uint64_t sum = 0;
+
+	shim_cacheflush((char *)data, (int)data_size, SHIM_DCACHE);
+#if defined(HAVE_BUILTIN___CLEAR_CACHE)
+	__builtin___clear_cache((void *)data, (void *)((uintptr_t)data + data_size));
+#endif
+
+	t1 = stress_time_now();
+	if (dist == 0) {
+		STRESS_PREFETCH_GATHER_LOOP(stress_prefetch_none);
+	} else {
+		switch (prefetch_method) {
+		default:
+		case STRESS_PREFETCH_BUILTIN:
+			STRESS_PREFETCH_GATHER_LOOP(stress_prefetch_builtin);
+			break;
+		case STRESS_PREFETCH_BUILTIN_L0:
+			STRESS_PREFETCH_GATHER_LOOP(stress_prefetch_builtin_locality0);
+			break;
+		case STRESS_PREFETCH_BUILTIN_L3:
+			STRESS_PREFETCH_GATHER_LOOP(stress_prefetch_builtin_locality3);
+			break;
+#if defined(HAVE_ASM_X86_PREFETCHT0)
+		case STRESS_PREFETCH_X86_PREFETCHT0:
+			STRESS_PREFETCH_GATHER_LOOP(stress_asm_x86_prefetcht0);
+			break;
+#endif
+#if defined(HAVE_ASM_X86_PREFETCHT1)
+		case STRESS_PREFETCH_X86_PREFETCHT1:
+			STRESS_PREFETCH_GATHER_LOOP(stress_asm_x86_prefetcht1);
+			break;
+#endif
+#if defined(HAVE_ASM_X86_PREFETCHT2)
+		case STRESS_PREFETCH_X86_PREFETCHT2:
+			STRESS_PREFETCH_GATHER_LOOP(stress_asm_x86_prefetcht2);
+			break;
+#endif
+#if defined(HAVE_ASM_X86_PREFETCHNTA)
+		case STRESS_PREFETCH_X86_PREFETCHNTA:
+			STRESS_PREFETCH_GATHER_LOOP(stress_asm_x86_prefetchnta);
+			break;
+#endif
+#if defined(HAVE_ASM_X86_PREFETCHW)
+		case STRESS_PREFETCH_X86_PREFETCHW:
+			STRESS_PREFETCH_GATHER_LOOP(stress_asm_x86_prefetchw);
+			break;
+#endif
+#if defined(HAVE_ASM_PPC64_DCBT)
+		case STRESS_PREFETCH_PPC64_DCBT:
+			STRESS_PREFETCH_GATHER_LOOP(stress_asm_ppc64_dcbt);
+			break;
+#endif
+#if defined(HAVE_ASM_PPC64_DCBTST)
+		case STRESS_PREFETCH_PPC64_DCBTST:
+			STRESS_PREFETCH_GATHER_LOOP(stress_asm_ppc64_dcbtst);
+			break;
+#endif
+		}
+	}
+	t2 = stress_time_now();
+	stress_uint64_put(sum);
+
+	info->bytes += (double)(n_idx * STRESS_CACHE_LINE_SIZE);
+	info->duration += t2 - t1;
+	info->count++;
+}
+
+/*
+ *  stress_prefetch_sweep_report()
+ *	report read rate per prefetch distance for each available
+ *	method, the best distance of each method is marked with a *
+ */
+static void stress_prefetch_sweep_report(
+	const stress_args_t *args,
+	stress_prefetch_info_t sweep[][SIZEOF_ARRAY(prefetch_methods)][SIZEOF_ARRAY(prefetch_distances)],
+	const size_t sweep_size)
+{
+	size_t p, m, d, idx = 0;
+
+	if (args->instance == 0)
+		pr_inf("%s: prefetch sweep read rates in GB per sec, %zu KB buffer, * = best distance\n",
+			args->name, sweep_size >> 10);
+
+	for (p = 0; p < SIZEOF_ARRAY(prefetch_patterns); p++) {
+		size_t best[SIZEOF_ARRAY(prefetch_methods)];
+		char buf[256], *ptr;
+
+		for (m = 0; m < SIZEOF_ARRAY(prefetch_methods); m++) {
+			double best_rate = 0.0;
+
+			best[m] = 0;
+			for (d = 0; d < SIZEOF_ARRAY(prefetch_distances); d++) {
+				stress_prefetch_info_t *info = &sweep[p][m][d];
+
+				info->rate = (info->duration > 0.0) ?
+					info->bytes / info->duration : 0.0;
+				if (info->rate > best_rate) {
+					best_rate = info->rate;
+					best[m] = d;
+				}
+			}
+		}
+
+		if (args->instance == 0) {
+			ptr = buf;
+			ptr += snprintf(ptr, sizeof(buf), "%s: %-6s lines", args->name, prefetch_patterns[p]);
+			for (m = 0; m < SIZEOF_ARRAY(prefetch_methods); m++) {
+				if (prefetch_methods[m].available())
+					ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), " %12s", prefetch_methods[m].name);
+			}
+			pr_inf("%s\n", buf);
+
+			for (d = 0; d < SIZEOF_ARRAY(prefetch_distances); d++) {
+				ptr = buf;
+				ptr += snprintf(ptr, sizeof(buf), "%s: %12zu", args->name, prefetch_distances[d]);
+				for (m = 0; m < SIZEOF_ARRAY(prefetch_methods); m++) {
+					if (prefetch_methods[m].available())
+						ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), " %11.2f%c",
+							sweep[p][m][d].rate / (double)GB,
+							(best[m] == d) ? '*' : ' ');
+				}
+				pr_inf("%s\n", buf);
+			}
+		}
+
+		stress_metrics_set(args, idx++, p == STRESS_PREFETCH_PATTERN_STREAM ?
+			"GB per sec stream non-prefetch read rate" :
+			"GB per sec gather non-prefetch read rate",
+			sweep[p][0][0].rate / (double)GB);
+		for (m = 0; m < SIZEOF_ARRAY(prefetch_methods); m++) {
+			char desc[64];
+
+			if (!prefetch_methods[m].available())
+				continue;
+			(void)snprintf(desc, sizeof(desc), "GB per sec %s %s best read rate",
+				prefetch_patterns[p], prefetch_methods[m].name);
+			stress_metrics_set(args, idx++, desc, sweep[p][m][best[m]].rate / (double)GB);
+			(void)snprintf(desc, sizeof(desc), "%s %s best prefetch distance (cache lines)",
+				prefetch_patterns[p], prefetch_methods[m].name);
+			stress_metrics_set(args, idx++, desc, (double)prefetch_distances[best[m]]);
+		}
+	}
+}
+
+/*
+ *  stress_prefetch_sweep()
+ *	sweep prefetch distance for each available method with
+ *	streaming and random gather read patterns
+ */
+static int stress_prefetch_sweep(const stress_args_t *args, const size_t l3_data_size)
+{
+	static stress_prefetch_info_t sweep[SIZEOF_ARRAY(prefetch_patterns)]
+		[SIZEOF_ARRAY(prefetch_methods)][SIZEOF_ARRAY(prefetch_distances)];
+	const size_t sweep_size = STRESS_MAXIMUM(l3_data_size,
+		STRESS_MINIMUM(l3_data_size * STRESS_PREFETCH_SWEEP_SCALE, STRESS_PREFETCH_SWEEP_MAX));
+	const size_t mmap_size = sweep_size + (STRESS_PREFETCH_OFFSETS * STRESS_CACHE_LINE_SIZE);
+	const size_t lines = sweep_size / STRESS_CACHE_LINE_SIZE;
+	const size_t n_idx = STRESS_MINIMUM(lines, STRESS_PREFETCH_GATHER_MAX);
+	const size_t max_dist = prefetch_distances[SIZEOF_ARRAY(prefetch_distances) - 1];
+	uint64_t *data, *data_end, total_count = 0;
+	size_t *idx;
+	size_t k;
+
+	data = (uint64_t *)mmap(NULL, mmap_size, PROT_READ | PROT_WRITE,
+#if defined(MAP_POPULATE)
+		MAP_POPULATE |
+#endif
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {
+		pr_inf_skip("%s: cannot allocate %zu bytes, skipping stressor\n",
+			args->name, mmap_size);
+		return EXIT_NO_RESOURCE;
+	}
+	idx = (size_t *)calloc(n_idx + max_dist, sizeof(*idx));
+	if (!idx) {
+		pr_inf_skip("%s: cannot allocate gather index array, skipping stressor\n",
+			args->name);
+		(void)munmap((void *)data, mmap_size);
+		return EXIT_NO_RESOURCE;
+	}
+	data_end = (uint64_t *)((uintptr_t)data + sweep_size);
+	(void)memset(data, 0xa5, mmap_size);
+	(void)memset(sweep, 0, sizeof(sweep));
+
+	/* random cache line offsets, padded so prefetches stay in range */
+	for (k = 0; k < n_idx; k++)
+		idx[k] = (size_t)stress_mwc32modn((uint32_t)lines) * (STRESS_CACHE_LINE_SIZE / sizeof(uint64_t));
+	for (k = 0; k < max_dist; k++)
+		idx[n_idx + k] = idx[k];
+
+	if (args->instance == 0)
+		pr_inf("%s: sweeping prefetch distances 0..%zu cache lines over a %zu KB buffer\n",
+			args->name, max_dist, sweep_size >> 10);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		size_t m, d;
+
+		for (m = 0; m < SIZEOF_ARRAY(prefetch_methods); m++) {
+			if (!prefetch_methods[m].available())
+				continue;
+			for (d = 0; keep_stressing_flag() && (d < SIZEOF_ARRAY(prefetch_distances)); d++) {
+				stress_prefetch_info_t *info = sweep[STRESS_PREFETCH_PATTERN_STREAM][m];
+
+				info[d].offset = prefetch_distances[d] * (STRESS_CACHE_LINE_SIZE / sizeof(uint64_t));
+				stress_prefetch_benchmark(info, (size_t)prefetch_methods[m].method,
+					d, data, data_end, &total_count);
+				stress_prefetch_gather_benchmark(&sweep[STRESS_PREFETCH_PATTERN_GATHER][m][d],
+					(size_t)prefetch_methods[m].method, data, sweep_size,
+					idx, n_idx, prefetch_distances[d]);
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_prefetch_sweep_report(args, sweep, sweep_size);
+
+	free(idx);
+	(void)munmap((void *)data, mmap_size);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_prefetch()
  *	stress cache/memory/CPU with stream stressors
@@ -315,8 +599,10 @@ static int stress_prefetch(const stress_args_t *args)
 	size_t i, best;
 	size_t prefetch_method = STRESS_PREFETCH_BUILTIN;
 	double best_rate, ns, rate;
+	bool prefetch_sweep = false;
 
 	(void)stress_get_setting("prefetch-method", &prefetch_method);
+	(void)stress_get_setting("prefetch-sweep", &prefetch_sweep);
 
 	if (!prefetch_methods[prefetch_method].available()) {
 		(void)pr_inf("%s: prefetch-method '%s' is not available on this CPU, skipping stressor\n",
@@ -326,6 +612,8 @@ static int stress_prefetch(const stress_args_t *args)
 	(void)stress_get_setting("prefetch-L3-size", &l3_data_size);
 	if (l3_data_size == 0)
 		l3_data_size = get_prefetch_L3_size(args);
+	if (prefetch_sweep)
+		return stress_prefetch_sweep(args, l3_data_size);
 
 	l3_data_mmap_size = l3_data_size + (STRESS_PREFETCH_OFFSETS * STRESS_CACHE_LINE_SIZE);
 
@@ -407,6 +695,7 @@ static int stress_prefetch(const stress_args_t *args)
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_prefetch_l3_size,	stress_set_prefetch_L3_size },
 	{ OPT_prefetch_method,	stress_set_prefetch_method  },
+	{ OPT_prefetch_sweep,	stress_set_prefetch_sweep },
 	{ 0,			NULL }
 };
 
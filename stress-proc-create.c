@@ -0,0 +1,643 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#if defined(HAVE_SPAWN_H)
+#include <spawn.h>
+#endif
+
+#define MIN_PROC_CREATE_RSS_MAX		(1 * MB)
+#define MAX_PROC_CREATE_RSS_MAX		(256ULL * GB)
+#define DEFAULT_PROC_CREATE_RSS_MAX	(256 * MB)
+
+#define PROC_CREATE_RSS_MIN		(1 * MB)	/* first parent RSS size */
+#define PROC_CREATE_RSS_SIZES		(16)		/* RSS sizes, x4 each step */
+#define PROC_CREATE_SAMPLES		(16)		/* creations per measurement */
+#define PROC_CREATE_STACK_SIZE		(64 * KB)	/* clone child stack */
+#define PROC_CREATE_HUGE_SIZE		(2 * MB)	/* huge page alignment */
+
+#define PROC_CREATE_PAGES_SMALL		(0)
+#define PROC_CREATE_PAGES_HUGE		(1)
+#define PROC_CREATE_PAGES		(2)
+
+static const stress_help_t help[] = {
+	{ NULL,	"proc-create N",	  "start N workers measuring process creation costs" },
+	{ NULL,	"proc-create-method M",	  "select creation method: all, fork, vfork, clone, clone-vm, fork-exec, posix-spawn" },
+	{ NULL,	"proc-create-ops N",	  "stop after N process creation sweep bogo operations" },
+	{ NULL,	"proc-create-rss-max N",  "sweep parent RSS from 1MB up to N bytes" },
+	{ NULL,	NULL,			  NULL }
+};
+
+/* data written by the child, shared with the parent */
+typedef struct {
+	double t_running;	/* time the child started running */
+} stress_proc_create_shared_t;
+
+/* per method creation context */
+typedef struct {
+	stress_proc_create_shared_t *shared;	/* child start time */
+	void *stack;				/* clone child stack */
+	char *path;				/* stress-ng executable */
+} stress_proc_create_ctxt_t;
+
+/*
+ *  create a child, set the time it started running and the
+ *  time it was reaped, returns -1 if the child could not be
+ *  created, 1 if it did not exit cleanly and 0 if all ok
+ */
+typedef int (*stress_proc_create_func_t)(stress_proc_create_ctxt_t *ctxt,
+	double *t_running, double *t_reaped);
+
+typedef struct {
+	const char *name;			/* method name */
+	const stress_proc_create_func_t func;	/* creation function */
+	const bool exec;			/* method execs stress-ng */
+} stress_proc_create_method_t;
+
+/* accumulated times from a sweep point */
+typedef struct {
+	double running;		/* total seconds to child running */
+	double reaped;		/* total seconds to child reaped */
+	double count;		/* number of children */
+} stress_proc_create_stats_t;
+
+static char *argv_new[] = { NULL, "--exec-exit", NULL };
+static char *env_new[] = { NULL };
+
+/*
+ *  stress_proc_create_reap()
+ *	wait for the child and set the reaped time, returns 1 if
+ *	the child did not exit cleanly
+ */
+static int stress_proc_create_reap(const pid_t pid, double *t_reaped)
+{
+	int status;
+
+	if (shim_waitpid(pid, &status, 0) < 0) {
+		*t_reaped = stress_time_now();
+		return 1;
+	}
+	*t_reaped = stress_time_now();
+	return (WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS)) ? 0 : 1;
+}
+
+/*
+ *  stress_proc_create_fork()
+ *	fork, copies the parent page tables
+ */
+static int stress_proc_create_fork(
+	stress_proc_create_ctxt_t *ctxt,
+	double *t_running,
+	double *t_reaped)
+{
+	pid_t pid;
+	int ret;
+
+	pid = fork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		ctxt->shared->t_running = stress_time_now();
+		_exit(EXIT_SUCCESS);
+	}
+	ret = stress_proc_create_reap(pid, t_reaped);
+	*t_running = ctxt->shared->t_running;
+
+	return ret;
+}
+
+#if defined(HAVE_VFORK)
+/*
+ *  stress_proc_create_vfork()
+ *	vfork, the child borrows the parent address space
+ */
+static int stress_proc_create_vfork(
+	stress_proc_create_ctxt_t *ctxt,
+	double *t_running,
+	double *t_reaped)
+{
+	pid_t pid;
+	int ret;
+
+	pid = shim_vfork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		ctxt->shared->t_running = stress_time_now();
+		_exit(EXIT_SUCCESS);
+	}
+	ret = stress_proc_create_reap(pid, t_reaped);
+	*t_running = ctxt->shared->t_running;
+
+	return ret;
+}
+#endif
+
+#if defined(HAVE_CLONE)
+static int stress_proc_create_clone_child(void *arg)
+{
+	stress_proc_create_ctxt_t *ctxt = (stress_proc_create_ctxt_t *)arg;
+
+	ctxt->shared->t_running = stress_time_now();
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_proc_create_clone_flags()
+ *	clone a child with the given clone flags
+ */
+static int stress_proc_create_clone_flags(
+	stress_proc_create_ctxt_t *ctxt,
+	const int flags,
+	double *t_running,
+	double *t_reaped)
+{
+	char *stack_top = (char *)stress_get_stack_top(ctxt->stack, PROC_CREATE_STACK_SIZE);
+	pid_t pid;
+	int ret;
+
+	pid = clone(stress_proc_create_clone_child, stress_align_stack(stack_top),
+		flags | SIGCHLD, (void *)ctxt);
+	if (pid < 0)
+		return -1;
+	ret = stress_proc_create_reap(pid, t_reaped);
+	*t_running = ctxt->shared->t_running;
+
+	return ret;
+}
+
+/*
+ *  stress_proc_create_clone()
+ *	clone without sharing the address space, the fork equivalent
+ */
+static int stress_proc_create_clone(
+	stress_proc_create_ctxt_t *ctxt,
+	double *t_running,
+	double *t_reaped)
+{
+	return stress_proc_create_clone_flags(ctxt, 0, t_running, t_reaped);
+}
+
+/*
+ *  stress_proc_create_clone_vm()
+ *	clone sharing the address space, the parent is suspended
+ *	until the child exits, as used by posix_spawn
+ */
+static int stress_proc_create_clone_vm(
+	stress_proc_create_ctxt_t *ctxt,
+	double *t_running,
+	double *t_reaped)
+{
+	return stress_proc_create_clone_flags(ctxt, CLONE_VM | CLONE_VFORK, t_running, t_reaped);
+}
+#endif
+
+#if defined(HAVE_PIPE2) &&	\
+    defined(O_CLOEXEC)
+/*
+ *  stress_proc_create_exec_wait()
+ *	the child is running once its close-on-exec end of the pipe
+ *	is closed by the exec, the child writes a byte if exec fails
+ */
+static int stress_proc_create_exec_wait(
+	const pid_t pid,
+	int fds[2],
+	double *t_running,
+	double *t_reaped)
+{
+	char ch;
+	ssize_t n;
+	int ret;
+
+	(void)close(fds[1]);
+	do {
+		n = read(fds[0], &ch, sizeof(ch));
+	} while ((n < 0) && (errno == EINTR));
+	*t_running = stress_time_now();
+	(void)close(fds[0]);
+
+	ret = stress_proc_create_reap(pid, t_reaped);
+	return (n != 0) ? 1 : ret;
+}
+
+/*
+ *  stress_proc_create_fork_exec()
+ *	fork and then exec stress-ng
+ */
+static int stress_proc_create_fork_exec(
+	stress_proc_create_ctxt_t *ctxt,
+	double *t_running,
+	double *t_reaped)
+{
+	pid_t pid;
+	int fds[2];
+
+	if (pipe2(fds, O_CLOEXEC) < 0)
+		return -1;
+	pid = fork();
+	if (pid < 0) {
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		return -1;
+	}
+	if (pid == 0) {
+		const char ch = 'x';
+
+		(void)execve(ctxt->path, argv_new, env_new);
+		VOID_RET(ssize_t, write(fds[1], &ch, sizeof(ch)));
+		_exit(EXIT_FAILURE);
+	}
+	return stress_proc_create_exec_wait(pid, fds, t_running, t_reaped);
+}
+#endif
+
+#if defined(HAVE_SPAWN_H) &&	\
+    defined(HAVE_POSIX_SPAWN) &&\
+    defined(HAVE_PIPE2) &&	\
+    defined(O_CLOEXEC)
+/*
+ *  stress_proc_create_posix_spawn()
+ *	posix_spawn stress-ng
+ */
+static int stress_proc_create_posix_spawn(
+	stress_proc_create_ctxt_t *ctxt,
+	double *t_running,
+	double *t_reaped)
+{
+	pid_t pid;
+	int fds[2];
+
+	if (pipe2(fds, O_CLOEXEC) < 0)
+		return -1;
+	if (posix_spawn(&pid, ctxt->path, NULL, NULL, argv_new, env_new) != 0) {
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		return -1;
+	}
+	return stress_proc_create_exec_wait(pid, fds, t_running, t_reaped);
+}
+#endif
+
+static const stress_proc_create_method_t proc_create_methods[] = {
+	{ "fork",	 stress_proc_create_fork,	 false },
+#if defined(HAVE_VFORK)
+	{ "vfork",	 stress_proc_create_vfork,	 false },
+#endif
+#if defined(HAVE_CLONE)
+	{ "clone",	 stress_proc_create_clone,	 false },
+	{ "clone-vm",	 stress_proc_create_clone_vm,	 false },
+#endif
+#if defined(HAVE_PIPE2) &&	\
+    defined(O_CLOEXEC)
+	{ "fork-exec",	 stress_proc_create_fork_exec,	 true },
+#endif
+#if defined(HAVE_SPAWN_H) &&	\
+    defined(HAVE_POSIX_SPAWN) &&\
+    defined(HAVE_PIPE2) &&	\
+    defined(O_CLOEXEC)
+	{ "posix-spawn", stress_proc_create_posix_spawn, true },
+#endif
+};
+
+#define PROC_CREATE_METHODS	(SIZEOF_ARRAY(proc_create_methods))
+
+static const char * const proc_create_pages[PROC_CREATE_PAGES] = {
+	"small",
+	"huge",
+};
+
+/*
+ *  stress_set_proc_create_method()
+ *	set the creation method, "all" uses every method
+ */
+static int stress_set_proc_create_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = PROC_CREATE_METHODS;
+		return stress_set_setting("proc-create-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < PROC_CREATE_METHODS; i++) {
+		if (!strcmp(opt, proc_create_methods[i].name))
+			return stress_set_setting("proc-create-method", TYPE_ID_SIZE_T, &i);
+	}
+
+	(void)fprintf(stderr, "proc-create-method must be one of: all");
+	for (i = 0; i < PROC_CREATE_METHODS; i++)
+		(void)fprintf(stderr, " %s", proc_create_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_set_proc_create_rss_max()
+ *	set the largest parent RSS size to sweep to
+ */
+static int stress_set_proc_create_rss_max(const char *opt)
+{
+	uint64_t proc_create_rss_max;
+
+	proc_create_rss_max = stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("proc-create-rss-max", proc_create_rss_max,
+		MIN_PROC_CREATE_RSS_MAX, MAX_PROC_CREATE_RSS_MAX);
+	return stress_set_setting("proc-create-rss-max", TYPE_ID_UINT64, &proc_create_rss_max);
+}
+
+/*
+ *  stress_proc_create_rss_map()
+ *	map and populate size bytes of parent RSS, huge pages are
+ *	requested with transparent huge pages and small pages by
+ *	disallowing them
+ */
+static void *stress_proc_create_rss_map(
+	const size_t size,
+	const int pages,
+	void **map,
+	size_t *map_size)
+{
+	uint8_t *ptr;
+
+	*map_size = size + PROC_CREATE_HUGE_SIZE;
+	*map = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (*map == MAP_FAILED)
+		return NULL;
+	ptr = (uint8_t *)(((uintptr_t)*map + PROC_CREATE_HUGE_SIZE - 1) & ~(uintptr_t)(PROC_CREATE_HUGE_SIZE - 1));
+	stress_set_vma_anon_name(ptr, size, "proc-create-rss");
+#if defined(MADV_HUGEPAGE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	(void)shim_madvise((void *)ptr, size,
+		(pages == PROC_CREATE_PAGES_HUGE) ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#else
+	(void)pages;
+#endif
+	(void)memset(ptr, 0x5a, size);
+
+	return (void *)ptr;
+}
+
+/*
+ *  stress_proc_create_report()
+ *	print the mean microseconds to child running and to child
+ *	reaped for each method over the parent RSS sizes
+ */
+static void stress_proc_create_report(
+	const stress_args_t *args,
+	stress_proc_create_stats_t stats[PROC_CREATE_METHODS][PROC_CREATE_PAGES][PROC_CREATE_RSS_SIZES],
+	const size_t n_sizes,
+	const int n_pages,
+	const size_t proc_create_method,
+	const bool exec_ok)
+{
+	size_t m, s;
+	int p;
+	char buf[256], str[32];
+
+	pr_lock();
+	for (p = 0; p < n_pages; p++) {
+		size_t len;
+
+		pr_inf("%s: microseconds to child running / child reaped, %s pages\n",
+			args->name, proc_create_pages[p]);
+		len = (size_t)snprintf(buf, sizeof(buf), "%-11s", "parent RSS");
+		for (s = 0; (s < n_sizes) && (len < sizeof(buf)); s++) {
+			len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %15s",
+				stress_uint64_to_str(str, sizeof(str), PROC_CREATE_RSS_MIN << (2 * s)));
+		}
+		pr_inf("%s: %s\n", args->name, buf);
+
+		for (m = 0; m < PROC_CREATE_METHODS; m++) {
+			if ((proc_create_method < PROC_CREATE_METHODS) && (proc_create_method != m))
+				continue;
+			if (proc_create_methods[m].exec && !exec_ok)
+				continue;
+			len = (size_t)snprintf(buf, sizeof(buf), "%-11s", proc_create_methods[m].name);
+			for (s = 0; (s < n_sizes) && (len < sizeof(buf)); s++) {
+				const stress_proc_create_stats_t *st = &stats[m][p][s];
+
+				if (st->count > 0.0) {
+					(void)snprintf(str, sizeof(str), "%.1f/%.1f",
+						STRESS_DBL_MICROSECOND * st->running / st->count,
+						STRESS_DBL_MICROSECOND * st->reaped / st->count);
+				} else {
+					shim_strlcpy(str, "-", sizeof(str));
+				}
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %15s", str);
+			}
+			pr_inf("%s: %s\n", args->name, buf);
+		}
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_proc_create()
+ *	measure time to child running and time to child reaped for
+ *	each process creation method as the parent RSS grows
+ */
+static int stress_proc_create(const stress_args_t *args)
+{
+	static stress_proc_create_stats_t stats[PROC_CREATE_METHODS][PROC_CREATE_PAGES][PROC_CREATE_RSS_SIZES];
+	stress_proc_create_ctxt_t ctxt;
+	uint64_t proc_create_rss_max = DEFAULT_PROC_CREATE_RSS_MAX;
+	size_t proc_create_method = PROC_CREATE_METHODS;
+	size_t shmall, freemem, totalmem, freeswap, totalswap;
+	size_t m, s, n_sizes, idx = 0;
+	int p, n_pages = PROC_CREATE_PAGES;
+	uint64_t failures = 0;
+	bool exec_ok;
+	char str[64], sz[32];
+
+	(void)stress_get_setting("proc-create-method", &proc_create_method);
+	if (!stress_get_setting("proc-create-rss-max", &proc_create_rss_max)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			proc_create_rss_max = 4ULL * GB;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			proc_create_rss_max = MIN_PROC_CREATE_RSS_MAX;
+	}
+
+	/* keep the parent RSS within half of the free memory per instance */
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap, &totalswap);
+	if ((freemem > 0) && (proc_create_rss_max > (freemem / 2) / args->num_instances)) {
+		proc_create_rss_max = STRESS_MAXIMUM((freemem / 2) / args->num_instances, PROC_CREATE_RSS_MIN);
+		if (args->instance == 0)
+			pr_inf("%s: limiting parent RSS to %s to fit in free memory\n",
+				args->name, stress_uint64_to_str(sz, sizeof(sz), proc_create_rss_max));
+	}
+	for (n_sizes = 0; n_sizes < PROC_CREATE_RSS_SIZES; n_sizes++) {
+		if ((PROC_CREATE_RSS_MIN << (2 * n_sizes)) > proc_create_rss_max)
+			break;
+	}
+#if !defined(MADV_HUGEPAGE) ||	\
+    !defined(MADV_NOHUGEPAGE)
+	n_pages = 1;
+#endif
+
+	/*
+	 *  Don't exec stress-ng when running as root as this could
+	 *  allow somebody to try and run another executable as root
+	 */
+	ctxt.path = NULL;
+	exec_ok = false;
+	if (geteuid() == 0) {
+		if (args->instance == 0)
+			pr_inf("%s: running as root, skipping the exec methods\n", args->name);
+	} else {
+		ctxt.path = stress_proc_self_exe();
+		if (ctxt.path) {
+			argv_new[0] = ctxt.path;
+			exec_ok = true;
+		} else if (args->instance == 0) {
+			pr_inf("%s: can't determine stress-ng executable name, "
+				"skipping the exec methods\n", args->name);
+		}
+	}
+	if ((proc_create_method < PROC_CREATE_METHODS) &&
+	    proc_create_methods[proc_create_method].exec && !exec_ok) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: cannot use the %s method, skipping stressor\n",
+				args->name, proc_create_methods[proc_create_method].name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	ctxt.shared = (stress_proc_create_shared_t *)mmap(NULL, sizeof(*ctxt.shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ctxt.shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap shared data, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	ctxt.stack = mmap(NULL, PROC_CREATE_STACK_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ctxt.stack == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap child stack, skipping stressor\n", args->name);
+		(void)munmap((void *)ctxt.shared, sizeof(*ctxt.shared));
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(stats, 0, sizeof(stats));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (s = 0; keep_stressing(args) && (s < n_sizes); s++) {
+			const size_t size = (size_t)(PROC_CREATE_RSS_MIN << (2 * s));
+
+			for (p = 0; keep_stressing(args) && (p < n_pages); p++) {
+				void *map;
+				size_t map_size;
+
+				if (!stress_proc_create_rss_map(size, p, &map, &map_size))
+					continue;
+
+				for (m = 0; m < PROC_CREATE_METHODS; m++) {
+					stress_proc_create_stats_t *st = &stats[m][p][s];
+					int i;
+
+					if ((proc_create_method < PROC_CREATE_METHODS) && (proc_create_method != m))
+						continue;
+					if (proc_create_methods[m].exec && !exec_ok)
+						continue;
+
+					for (i = 0; keep_stressing(args) && (i < PROC_CREATE_SAMPLES); i++) {
+						double t_start, t_running, t_reaped;
+						int ret;
+
+						ctxt.shared->t_running = 0.0;
+						t_start = stress_time_now();
+						ret = proc_create_methods[m].func(&ctxt, &t_running, &t_reaped);
+						if (ret < 0) {
+							if ((errno != EAGAIN) && (errno != ENOMEM) &&
+							    (errno != EINTR) && keep_stressing_flag()) {
+								pr_fail("%s: %s failed, errno=%d (%s)\n",
+									args->name, proc_create_methods[m].name,
+									errno, strerror(errno));
+								failures++;
+							}
+							continue;
+						}
+						if (ret > 0) {
+							/* children may be killed when the run ends */
+							if (keep_stressing_flag())
+								failures++;
+							continue;
+						}
+						if (t_running >= t_start) {
+							st->running += t_running - t_start;
+							st->reaped += t_reaped - t_start;
+							st->count += 1.0;
+						}
+					}
+				}
+				(void)munmap(map, map_size);
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_proc_create_report(args, stats, n_sizes, n_pages, proc_create_method, exec_ok);
+
+	/* metrics at the largest parent RSS */
+	if (n_sizes > 0) {
+		(void)stress_uint64_to_str(sz, sizeof(sz), PROC_CREATE_RSS_MIN << (2 * (n_sizes - 1)));
+		for (m = 0; m < PROC_CREATE_METHODS; m++) {
+			for (p = 0; p < n_pages; p++) {
+				const stress_proc_create_stats_t *st = &stats[m][p][n_sizes - 1];
+
+				if (st->count <= 0.0)
+					continue;
+				(void)snprintf(str, sizeof(str), "%s usecs to running (%s %s)",
+					proc_create_methods[m].name, sz, proc_create_pages[p]);
+				stress_metrics_set(args, idx++, str,
+					STRESS_DBL_MICROSECOND * st->running / st->count);
+				(void)snprintf(str, sizeof(str), "%s usecs to reaped (%s %s)",
+					proc_create_methods[m].name, sz, proc_create_pages[p]);
+				stress_metrics_set(args, idx++, str,
+					STRESS_DBL_MICROSECOND * st->reaped / st->count);
+			}
+		}
+	}
+
+	if ((failures > 0) && (g_opt_flags & OPT_FLAGS_VERIFY)) {
+		pr_fail("%s: %" PRIu64 " children failed to be created or did not exit cleanly\n",
+			args->name, failures);
+	}
+
+	(void)munmap(ctxt.stack, PROC_CREATE_STACK_SIZE);
+	(void)munmap((void *)ctxt.shared, sizeof(*ctxt.shared));
+
+	return ((failures > 0) && (g_opt_flags & OPT_FLAGS_VERIFY)) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_proc_create_method,	stress_set_proc_create_method },
+	{ OPT_proc_create_rss_max,	stress_set_proc_create_rss_max },
+	{ 0,				NULL }
+};
+
+stressor_info_t stress_proc_create_info = {
+	.stressor = stress_proc_create,
+	.class = CLASS_SCHEDULER | CLASS_OS | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
@@ -36,6 +36,7 @@ typedef void (*qsort_func_t)(void *base, size_t nmemb, size_t size, comp_func_t
 
 static const stress_help_t help[] = {
 	{ "Q N", "qsort N",	"start N workers qsorting 32 bit random integers" },
+	{ NULL,	"qsort-dists",	"qsort int32, uint64, record and string keys in 7 input distributions" },
 	{ NULL,	"qsort-ops N",	"stop after N qsort bogo operations" },
 	{ NULL,	"qsort-size N",	"number of 32 bit integers to sort" },
 	{ NULL,	NULL,		NULL }
@@ -74,6 +75,11 @@ static int stress_set_qsort_size(const char *opt)
 	return stress_set_setting("qsort-size", TYPE_ID_UINT64, &qsort_size);
 }
 
+static int stress_set_qsort_dists(const char *opt)
+{
+	return stress_set_setting_true("qsort-dists", opt);
+}
+
 typedef uint32_t qsort_swap_type_t;
 
 static inline size_t qsort_bm_minimum(const size_t x, const size_t y)
@@ -313,8 +319,10 @@ static int OPTIMIZE3 stress_qsort(const stress_args_t *args)
 	NOCLOBBER double duration = 0.0, count = 0.0, sorted = 0.0;
 	int mmap_flags = MAP_ANONYMOUS | MAP_PRIVATE;
 	qsort_func_t qsort_func;
+	bool qsort_dists = false;
 
 	(void)stress_get_setting("qsort-method", &qsort_method);
+	(void)stress_get_setting("qsort-dists", &qsort_dists);
 	if (!stress_get_setting("qsort-size", &qsort_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
 			qsort_size = MAX_QSORT_SIZE;
@@ -324,6 +332,10 @@ static int OPTIMIZE3 stress_qsort(const stress_args_t *args)
 	n = (size_t)qsort_size;
 	data_size = n * sizeof(*data);
 
+	if (qsort_dists)
+		return stress_sort_dists(args, stress_qsort_methods[qsort_method].name,
+			stress_qsort_methods[qsort_method].qsort_func, n);
+
 #if defined(MAP_POPULATE)
 	mmap_flags |= MAP_POPULATE;
 #endif
@@ -427,6 +439,7 @@ tidy:
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_qsort_dists,	stress_set_qsort_dists },
 	{ OPT_qsort_integers,	stress_set_qsort_size },
 	{ OPT_qsort_method,	stress_set_qsort_method },
 	{ 0,			NULL }
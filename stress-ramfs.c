@@ -19,6 +19,7 @@
  */
 #include "stress-ng.h"
 #include "core-capabilities.h"
+#include "core-memfs-bench.h"
 
 #if defined(HAVE_SYS_MOUNT_H)
 #include <sys/mount.h>
@@ -26,6 +27,7 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"ramfs N",	 "start N workers exercising ramfs mounts" },
+	{ NULL,	"ramfs-bench",	 "measure ramfs and tmpfs bandwidth and fault rates" },
 	{ NULL, "ramfs-size N",  "set the ramfs size in bytes, e.g. 2M is 2MB" },
 	{ NULL,	"ramfs-fill",	 "attempt to fill ramfs" },
 	{ NULL,	"ramfs-ops N",	 "stop after N bogo ramfs mount operations" },
@@ -77,7 +79,17 @@ static int stress_set_ramfs_fill(const char *opt)
 	return stress_set_setting_true("ramfs-fill", opt);
 }
 
+/*
+ *  stress_set_ramfs_bench()
+ *      set flag to benchmark ramfs
+ */
+static int stress_set_ramfs_bench(const char *opt)
+{
+	return stress_set_setting_true("ramfs-bench", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_ramfs_bench,	stress_set_ramfs_bench },
 	{ OPT_ramfs_size,	stress_set_ramfs_size },
 	{ OPT_ramfs_fill,	stress_set_ramfs_fill },
 	{ 0,                    NULL }
@@ -408,6 +420,52 @@ cleanup:
 	return rc;
 }
 
+/*
+ *  stress_ramfs_bench()
+ *	compare the read, write, page fault and mmap bandwidth of
+ *	private ramfs and tmpfs mounts
+ */
+static int stress_ramfs_bench(const stress_args_t *args)
+{
+	static const char * const fs[] = {
+		"ramfs",
+		"tmpfs",
+	};
+	static stress_memfs_bench_t bench[SIZEOF_ARRAY(fs)];
+	const size_t size = stress_memfs_bench_size(args);
+	size_t i;
+	int ret;
+
+	(void)memset(bench, 0, sizeof(bench));
+	for (i = 0; i < SIZEOF_ARRAY(fs); i++)
+		(void)shim_strlcpy(bench[i].label, fs[i], sizeof(bench[i].label));
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0)
+		return stress_exit_status(-ret);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; keep_stressing(args) && (i < SIZEOF_ARRAY(fs)); i++) {
+			char opts[32];
+
+			if (bench[i].err)
+				continue;
+			(void)snprintf(opts, sizeof(opts), "size=%zu", size * 2);
+			bench[i].err = stress_memfs_bench_mount(args, fs[i], opts, size, &bench[i]);
+			inc_counter(args);
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_memfs_bench_report(args, bench, SIZEOF_ARRAY(fs));
+	(void)stress_temp_dir_rm_args(args);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_ramfs_mount()
  *      stress ramfs mounting
@@ -415,6 +473,11 @@ cleanup:
 static int stress_ramfs_mount(const stress_args_t *args)
 {
 	int pid;
+	bool ramfs_bench = false;
+
+	(void)stress_get_setting("ramfs-bench", &ramfs_bench);
+	if (ramfs_bench)
+		return stress_ramfs_bench(args);
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-io-sweep.h"
 
 #if defined(HAVE_SYS_SYSMACROS_H)
 #include <sys/sysmacros.h>
@@ -31,6 +32,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"rawdev N",	   "start N workers that read a raw device" },
 	{ NULL,	"rawdev-method M", "specify the rawdev read method to use" },
 	{ NULL,	"rawdev-ops N",	   "stop after N rawdev read operations" },
+	{ NULL,	"rawdev-qd-sweep M", "io_uring read sweep of block sizes and queue depths" },
 	{ NULL,	NULL,		   NULL }
 };
 
@@ -353,8 +355,18 @@ static int stress_set_rawdev_method(const char *name)
 }
 #endif
 
+/*
+ *  stress_set_rawdev_qd_sweep()
+ *	set the read only sweep pattern, the device is never written
+ */
+static int stress_set_rawdev_qd_sweep(const char *opt)
+{
+	return stress_set_io_sweep("rawdev-qd-sweep", opt, false);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_rawdev_method,	stress_set_rawdev_method },
+	{ OPT_rawdev_qd_sweep,	stress_set_rawdev_qd_sweep },
 	{ 0,			NULL }
 };
 
@@ -369,6 +381,7 @@ static int stress_rawdev(const stress_args_t *args)
 	const char *path = stress_get_temp_path();
 	size_t blks, blksz = 0, mmapsz;
 	size_t i, j, rawdev_method = 0;
+	size_t rawdev_qd_sweep = STRESS_IO_SWEEP_NONE;
 	const size_t page_size = args->page_size;
 	stress_rawdev_func func;
 	stress_metrics_t *metrics;
@@ -400,6 +413,7 @@ static int stress_rawdev(const stress_args_t *args)
 	}
 
 	(void)stress_get_setting("rawdev-method", &rawdev_method);
+	(void)stress_get_setting("rawdev-qd-sweep", &rawdev_qd_sweep);
 	func = rawdev_methods[rawdev_method].func;
 
 	fd = open(devpath, O_RDONLY | O_NONBLOCK);
@@ -457,6 +471,16 @@ static int stress_rawdev(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
+	if (rawdev_qd_sweep != STRESS_IO_SWEEP_NONE) {
+		/* BLKGETSIZE is in 512 byte sectors */
+		ret = stress_io_sweep(args, fd, (uint64_t)blks * 512, rawdev_qd_sweep);
+		stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+		(void)munmap((void *)buffer, mmapsz);
+		(void)close(fd);
+		free(metrics);
+		return ret;
+	}
+
 	do {
 		func(args, fd, buffer, blks, blksz, &metrics[rawdev_method]);
 	} while (keep_stressing(args));
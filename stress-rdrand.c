@@ -19,16 +19,21 @@
  */
 #include "stress-ng.h"
 #include "core-arch.h"
+#include "core-asm-arm.h"
 #include "core-asm-x86.h"
 #include "core-asm-ppc64.h"
 #include "core-cpu.h"
 
+#if defined(HAVE_SYS_AUXV_H)
+#include <sys/auxv.h>
+#endif
+
 #if defined(HAVE_SYS_CAPABILITY_H)
 #include <sys/capability.h>
 #endif
 
 static const stress_help_t help[] = {
-	{ NULL,	"rdrand N",	"start N workers exercising rdrand (x86 only)" },
+	{ NULL,	"rdrand N",	"start N workers exercising rdrand (x86), darn (power9) or rndr (arm64)" },
 	{ NULL,	"rdrand-ops N",	"stop after N rdrand bogo operations" },
 	{ NULL, "rdrand-seed",	"use rdseed instead of rdrand" },
 	{ NULL,	NULL,		NULL }
@@ -37,6 +42,9 @@ static const stress_help_t help[] = {
 #define STRESS_SANE_LOOPS_QUICK	16
 #define STRESS_SANE_LOOPS	65536
 
+/* time spent on each latency and throughput comparison */
+#define STRESS_RDRAND_BENCH_TIME	(0.01)
+
 static int stress_set_rdrand_seed(const char *opt)
 {
 	(void)opt;
@@ -64,6 +72,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 #if defined(HAVE_ASM_X86_RDSEED)
 #define HAVE_SEED_CAPABILITY
 #endif
+#define RAND_NAME	"rdrand"
 
 static bool rdrand_supported = false;
 
@@ -112,6 +121,7 @@ static inline uint64_t seed64(void)
     defined(HAVE_ASM_PPC64_DARN)
 
 #define HAVE_RAND_CAPABILITY
+#define RAND_NAME	"darn"
 
 static bool rdrand_supported = false;
 static volatile uint64_t v;
@@ -139,6 +149,42 @@ static inline uint64_t rand64(void)
 }
 #endif
 
+#if defined(STRESS_ARCH_ARM) &&		\
+    defined(HAVE_ASM_ARM_RNDR) &&	\
+    defined(HAVE_SYS_AUXV_H) &&		\
+    defined(HAVE_GETAUXVAL) &&		\
+    defined(AT_HWCAP2)
+
+#define HAVE_RAND_CAPABILITY
+#define RAND_NAME	"rndr"
+
+#if !defined(HWCAP2_RNG)
+#define HWCAP2_RNG	(1 << 16)
+#endif
+
+static bool rdrand_supported = false;
+
+/*
+ *  stress_rdrand_supported()
+ *	check if the ARMv8.5 rndr instruction is supported
+ */
+static int stress_rdrand_supported(const char *name)
+{
+	if (getauxval(AT_HWCAP2) & HWCAP2_RNG) {
+		rdrand_supported = true;
+		return 0;
+	}
+	pr_inf_skip("%s stressor will be skipped, CPU "
+		"does not support the rndr instruction\n", name);
+	return -1;
+}
+
+static inline uint64_t rand64(void)
+{
+	return stress_asm_arm_rndr();
+}
+#endif
+
 #if defined(HAVE_RAND_CAPABILITY)
 
 /*
@@ -264,6 +310,143 @@ static int stress_rdrand_sane(const stress_args_t *args)
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_rdrand_latency()
+ *	nanoseconds per call of a hardware random number function
+ */
+static double stress_rdrand_latency(uint64_t (*func)(void))
+{
+	const double time_start = stress_time_now();
+	double duration;
+	uint64_t n = 0;
+
+	do {
+		register int i;
+
+		for (i = 0; i < 256; i++)
+			(void)func();
+		n += 256;
+		duration = stress_time_now() - time_start;
+	} while (duration < STRESS_RDRAND_BENCH_TIME);
+
+	return (duration * STRESS_DBL_NANOSECOND) / (double)n;
+}
+
+/*
+ *  stress_rdrand_fill_hw()
+ *	fill buffer with hardware random numbers
+ */
+static ssize_t stress_rdrand_fill_hw(uint8_t *buf, const size_t len, const int fd)
+{
+	size_t i;
+
+	(void)fd;
+
+	for (i = 0; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		const uint64_t val = rand64();
+
+		(void)memcpy(buf + i, &val, sizeof(val));
+	}
+	return (ssize_t)i;
+}
+
+/*
+ *  stress_rdrand_fill_getrandom()
+ *	fill buffer using the getrandom system call
+ */
+static ssize_t stress_rdrand_fill_getrandom(uint8_t *buf, const size_t len, const int fd)
+{
+	(void)fd;
+
+	return (ssize_t)shim_getrandom(buf, len, 0);
+}
+
+/*
+ *  stress_rdrand_fill_urandom()
+ *	fill buffer by reading /dev/urandom
+ */
+static ssize_t stress_rdrand_fill_urandom(uint8_t *buf, const size_t len, const int fd)
+{
+	return read(fd, buf, len);
+}
+
+/*
+ *  stress_rdrand_throughput()
+ *	MB per second filling a buffer of len bytes at a time,
+ *	returns a negative value if the source is not available
+ */
+static double stress_rdrand_throughput(
+	ssize_t (*fill)(uint8_t *buf, const size_t len, const int fd),
+	uint8_t *buf,
+	const size_t len,
+	const int fd)
+{
+	const double time_start = stress_time_now();
+	double duration;
+	uint64_t bytes = 0;
+
+	do {
+		register int i;
+
+		for (i = 0; i < 16; i++) {
+			const ssize_t ret = fill(buf, len, fd);
+
+			if (ret <= 0)
+				return -1.0;
+			bytes += (uint64_t)ret;
+		}
+		duration = stress_time_now() - time_start;
+	} while (duration < STRESS_RDRAND_BENCH_TIME);
+
+	return ((double)bytes / duration) / (double)MB;
+}
+
+/*
+ *  stress_rdrand_compare()
+ *	compare the latency of the random number instructions and
+ *	the throughput of the instruction against getrandom() and
+ *	/dev/urandom for small, medium and large request sizes
+ */
+static void stress_rdrand_compare(const stress_args_t *args, size_t idx)
+{
+	static const size_t sizes[] = { 16, 256, 4096 };
+	uint8_t buf[4096];
+	char desc[64];
+	size_t i;
+	int fd;
+
+	stress_metrics_set(args, idx++, RAND_NAME " nanosecs per instruction",
+		stress_rdrand_latency(rand64));
+#if defined(HAVE_SEED_CAPABILITY)
+	if (stress_cpu_x86_has_rdseed())
+		stress_metrics_set(args, idx++, "rdseed nanosecs per instruction",
+			stress_rdrand_latency(seed64));
+#endif
+	fd = open("/dev/urandom", O_RDONLY);
+	for (i = 0; (i < SIZEOF_ARRAY(sizes)) && keep_stressing_flag(); i++) {
+		double rate;
+
+		rate = stress_rdrand_throughput(stress_rdrand_fill_hw, buf, sizes[i], -1);
+		(void)snprintf(desc, sizeof(desc), RAND_NAME " MB per sec (%zu byte requests)", sizes[i]);
+		stress_metrics_set(args, idx++, desc, rate);
+
+		rate = stress_rdrand_throughput(stress_rdrand_fill_getrandom, buf, sizes[i], -1);
+		if (rate >= 0.0) {
+			(void)snprintf(desc, sizeof(desc), "getrandom MB per sec (%zu byte requests)", sizes[i]);
+			stress_metrics_set(args, idx++, desc, rate);
+		}
+		if (fd >= 0) {
+			rate = stress_rdrand_throughput(stress_rdrand_fill_urandom, buf, sizes[i], fd);
+			if (rate >= 0.0) {
+				(void)snprintf(desc, sizeof(desc), "/dev/urandom MB per sec (%zu byte requests)", sizes[i]);
+				stress_metrics_set(args, idx++, desc, rate);
+			}
+		}
+	}
+	if (fd >= 0)
+		(void)close(fd);
+}
+
 /*
  *  stress_rdrand()
  *      stress Intel rdrand instruction
@@ -286,6 +469,9 @@ static int stress_rdrand(const stress_args_t *args)
 
 		rc = stress_rdrand_sane(args);
 
+		/* hardware vs kernel random number sources */
+		stress_rdrand_compare(args, 4);
+
 		time_start = stress_time_now();
 
 #if defined(HAVE_SEED_CAPABILITY)
@@ -327,6 +513,10 @@ static int stress_rdrand(const stress_args_t *args)
 		rate = (duration > 0.0) ? million_bits / duration : 0.0;
 		stress_metrics_set(args, 0, "million random bits read", million_bits);
 		stress_metrics_set(args, 1, "million random bits per sec", rate);
+		rate = (duration > 0.0) ? ((double)c * 256.0 * sizeof(uint64_t)) / duration : 0.0;
+		stress_metrics_set(args, 2, "MB per sec", rate / (double)MB);
+		stress_metrics_set(args, 3, "nanosecs per random 64 bit read", (c > 0) ?
+			(duration * STRESS_DBL_NANOSECOND) / ((double)c * 256.0) : 0.0);
 	}
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-thrash.h"
 
 #define MIN_READAHEAD_BYTES	(1 * MB)
 #define MAX_READAHEAD_BYTES	(MAX_FILE_LIMIT)
@@ -27,10 +28,18 @@
 #define BUF_SIZE		(4096)
 #define MAX_OFFSETS		(16)
 
+#define SWEEP_BUF_SIZE		(128 * KB)	/* sweep read size */
+
+#define SWEEP_READ		(0)	/* plain read, no hints */
+#define SWEEP_FADVISE		(1)	/* posix_fadvise() hint */
+#define SWEEP_READAHEAD		(2)	/* explicit readahead() window */
+#define SWEEP_MMAP		(3)	/* mmap'd with madvise() hint */
+
 static const stress_help_t help[] = {
 	{ NULL,	"readahead N",		"start N workers exercising file readahead" },
 	{ NULL,	"readahead-bytes N",	"size of file to readahead on (default is 1GB)" },
 	{ NULL,	"readahead-ops N",	"stop after N readahead bogo operations" },
+	{ NULL,	"readahead-sweep",	"sweep readahead hints and report cold and warm read bandwidth" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -44,8 +53,14 @@ static int stress_set_readahead_bytes(const char *opt)
 	return stress_set_setting("readahead-bytes", TYPE_ID_UINT64, &readahead_bytes);
 }
 
+static int stress_set_readahead_sweep(const char *opt)
+{
+	return stress_set_setting_true("readahead-sweep", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_readahead_bytes,	stress_set_readahead_bytes },
+	{ OPT_readahead_sweep,	stress_set_readahead_sweep },
 	{ 0,			NULL }
 };
 
@@ -54,6 +69,63 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 
 typedef uint64_t	buffer_t;
 
+typedef struct {
+	const char *name;	/* hint name */
+	const int type;		/* SWEEP_* */
+	const int advice;	/* fadvise or madvise advice */
+	const size_t window;	/* readahead() window size */
+} stress_readahead_hint_t;
+
+typedef struct {
+	double duration;	/* total read time in seconds */
+	double bytes;		/* total bytes read */
+	bool unsupported;	/* hint not available */
+} stress_readahead_result_t;
+
+/*
+ *  sweep hints, one cold and one warm cache pass is made
+ *  for each hint; advice of -1 is not available at build time
+ */
+static const stress_readahead_hint_t readahead_hints[] = {
+	{ "read",	SWEEP_READ,		0,	0 },
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_SEQUENTIAL)
+	{ "fadv-seq",	SWEEP_FADVISE,		POSIX_FADV_SEQUENTIAL, 0 },
+#else
+	{ "fadv-seq",	SWEEP_FADVISE,		-1,	0 },
+#endif
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_RANDOM)
+	{ "fadv-rnd",	SWEEP_FADVISE,		POSIX_FADV_RANDOM, 0 },
+#else
+	{ "fadv-rnd",	SWEEP_FADVISE,		-1,	0 },
+#endif
+	{ "ra-128K",	SWEEP_READAHEAD,	0,	128 * KB },
+	{ "ra-512K",	SWEEP_READAHEAD,	0,	512 * KB },
+	{ "ra-2M",	SWEEP_READAHEAD,	0,	2 * MB },
+	{ "ra-8M",	SWEEP_READAHEAD,	0,	8 * MB },
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_NORMAL)
+	{ "mmap",	SWEEP_MMAP,		MADV_NORMAL, 0 },
+#else
+	{ "mmap",	SWEEP_MMAP,		-1,	0 },
+#endif
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_SEQUENTIAL)
+	{ "mmap-seq",	SWEEP_MMAP,		MADV_SEQUENTIAL, 0 },
+#else
+	{ "mmap-seq",	SWEEP_MMAP,		-1,	0 },
+#endif
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_RANDOM)
+	{ "mmap-rnd",	SWEEP_MMAP,		MADV_RANDOM, 0 },
+#else
+	{ "mmap-rnd",	SWEEP_MMAP,		-1,	0 },
+#endif
+};
+
+#define SWEEP_HINTS		(SIZEOF_ARRAY(readahead_hints))
+
 static void OPTIMIZE3 stress_readahead_generate_offsets(
 	off_t *offsets,
 	const uint64_t rounded_readahead_bytes)
@@ -90,6 +162,251 @@ static int do_readahead(
 	return 0;
 }
 
+/*
+ *  stress_readahead_sweep_continue()
+ *	keep_stressing() without --rate pacing, pacing the
+ *	reads would skew the bandwidth measurements
+ */
+static inline bool stress_readahead_sweep_continue(const stress_args_t *args)
+{
+	if (!keep_stressing_flag())
+		return false;
+	return !(args->max_ops && (get_counter(args) >= args->max_ops));
+}
+
+/*
+ *  stress_readahead_sweep_fadvise()
+ *	set the file readahead advice, ignoring failures
+ */
+static inline void stress_readahead_sweep_fadvise(const int fd, const int advice)
+{
+#if defined(HAVE_POSIX_FADVISE)
+	VOID_RET(int, posix_fadvise(fd, 0, 0, advice));
+#else
+	(void)fd;
+	(void)advice;
+#endif
+}
+
+/*
+ *  stress_readahead_sweep_evict()
+ *	write back and evict the file from the page cache, also
+ *	drop the system wide page cache when permitted so that
+ *	filesystem metadata is cold too
+ */
+static void stress_readahead_sweep_evict(const int fd, const uint64_t size)
+{
+	(void)shim_fdatasync(fd);
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_DONTNEED)
+	VOID_RET(int, posix_fadvise(fd, 0, (off_t)size, POSIX_FADV_DONTNEED));
+#else
+	(void)size;
+#endif
+	VOID_RET(int, stress_drop_page_cache());
+}
+
+/*
+ *  stress_readahead_sweep_pass()
+ *	read the whole file sequentially using the given hint,
+ *	returns bytes read or -1 on failure
+ */
+static ssize_t stress_readahead_sweep_pass(
+	const stress_args_t *args,
+	const int fd,
+	const char *fs_type,
+	const uint64_t size,
+	const stress_readahead_hint_t *hint,
+	uint8_t *buf)
+{
+	uint64_t off, ra_off = 0;
+	ssize_t total = 0;
+
+	if (hint->type == SWEEP_MMAP) {
+		uint8_t *ptr;
+
+		ptr = (uint8_t *)mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+		if (ptr == MAP_FAILED) {
+			pr_fail("%s: mmap failed, errno=%d (%s)%s\n",
+				args->name, errno, strerror(errno), fs_type);
+			return -1;
+		}
+#if defined(HAVE_MADVISE)
+		VOID_RET(int, madvise((void *)ptr, (size_t)size, hint->advice));
+#endif
+		for (off = 0; off < size; off += SWEEP_BUF_SIZE) {
+			const size_t len = ((size - off) < SWEEP_BUF_SIZE) ?
+				(size_t)(size - off) : SWEEP_BUF_SIZE;
+
+			if (!keep_stressing_flag())
+				break;
+			(void)memcpy(buf, ptr + off, len);
+			total += (ssize_t)len;
+			inc_counter(args);
+		}
+		(void)munmap((void *)ptr, (size_t)size);
+		return total;
+	}
+
+	for (off = 0; off < size; ) {
+		ssize_t ret;
+
+		if (!keep_stressing_flag())
+			break;
+
+		/* keep up to two explicit readahead windows ahead of the reads */
+		if (hint->type == SWEEP_READAHEAD) {
+			while ((ra_off < size) && (ra_off < off + (2 * hint->window))) {
+				VOID_RET(ssize_t, readahead(fd, (off64_t)ra_off, hint->window));
+				ra_off += hint->window;
+			}
+		}
+
+		ret = pread(fd, buf, SWEEP_BUF_SIZE, (off_t)off);
+		if (UNLIKELY(ret < 0)) {
+			if ((errno == EAGAIN) || (errno == EINTR))
+				continue;
+			pr_fail("%s: read failed, errno=%d (%s)%s\n",
+				args->name, errno, strerror(errno), fs_type);
+			return -1;
+		}
+		if (ret == 0)
+			break;
+		off += (uint64_t)ret;
+		total += ret;
+		inc_counter(args);
+	}
+	return total;
+}
+
+/*
+ *  stress_readahead_sweep_report()
+ *	log the sweep results and report the cold and warm
+ *	cache read bandwidth of each hint as metrics
+ */
+static void stress_readahead_sweep_report(
+	const stress_args_t *args,
+	const uint64_t size,
+	const bool dropped,
+	stress_readahead_result_t results[][2])
+{
+	size_t i;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: readahead sweep, %" PRIu64 " MB file, %s page cache drop\n",
+			args->name, size / (uint64_t)MB, dropped ? "system wide" : "per file");
+		pr_inf("%s: hint       cold MB/sec  warm MB/sec\n", args->name);
+	}
+
+	for (i = 0; i < SWEEP_HINTS; i++) {
+		double rate[2];
+		char str[64];
+		int j;
+
+		if (results[i][0].unsupported)
+			continue;
+
+		for (j = 0; j < 2; j++) {
+			const stress_readahead_result_t *result = &results[i][j];
+
+			rate[j] = (result->duration > 0.0) ?
+				(result->bytes / result->duration) / (double)MB : 0.0;
+		}
+		if (args->instance == 0)
+			pr_inf("%s: %-9s %12.2f %12.2f\n", args->name,
+				readahead_hints[i].name, rate[0], rate[1]);
+
+		(void)snprintf(str, sizeof(str), "%s cold cache MB per sec", readahead_hints[i].name);
+		stress_metrics_set(args, i * 2, str, rate[0]);
+		(void)snprintf(str, sizeof(str), "%s warm cache MB per sec", readahead_hints[i].name);
+		stress_metrics_set(args, (i * 2) + 1, str, rate[1]);
+	}
+
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_readahead_sweep()
+ *	for each readahead hint evict the file from the page cache,
+ *	time a cold sequential read and then a warm re-read, repeating
+ *	the sweep and accumulating the results until the run ends
+ */
+static int stress_readahead_sweep(
+	const stress_args_t *args,
+	const int fd,
+	const char *fs_type,
+	const uint64_t size)
+{
+	stress_readahead_result_t results[SWEEP_HINTS][2];
+	uint8_t *buf;
+	bool dropped;
+	int rc = EXIT_SUCCESS;
+
+	(void)memset(results, 0, sizeof(results));
+	buf = (uint8_t *)mmap(NULL, SWEEP_BUF_SIZE, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte sweep buffer, skipping stressor\n",
+			args->name, (size_t)SWEEP_BUF_SIZE);
+		return EXIT_NO_RESOURCE;
+	}
+	dropped = (stress_drop_page_cache() == 0);
+
+	do {
+		size_t i;
+
+		for (i = 0; i < SWEEP_HINTS; i++) {
+			const stress_readahead_hint_t *hint = &readahead_hints[i];
+			int j;
+
+			if (hint->advice < 0) {
+				results[i][0].unsupported = true;
+				continue;
+			}
+
+			/*
+			 *  explicit readahead() windows are measured with the
+			 *  kernel's heuristic readahead disabled
+			 */
+#if defined(POSIX_FADV_RANDOM)
+			if (hint->type == SWEEP_READAHEAD)
+				stress_readahead_sweep_fadvise(fd, POSIX_FADV_RANDOM);
+#endif
+			if (hint->type == SWEEP_FADVISE)
+				stress_readahead_sweep_fadvise(fd, hint->advice);
+
+			stress_readahead_sweep_evict(fd, size);
+			for (j = 0; j < 2; j++) {
+				const double t_start = stress_time_now();
+				const ssize_t ret = stress_readahead_sweep_pass(args,
+					fd, fs_type, size, hint, buf);
+
+				if (ret < 0) {
+					rc = EXIT_FAILURE;
+					goto unmap_buf;
+				}
+				if (!keep_stressing_flag())
+					goto report;
+				results[i][j].duration += stress_time_now() - t_start;
+				results[i][j].bytes += (double)ret;
+			}
+#if defined(POSIX_FADV_NORMAL)
+			stress_readahead_sweep_fadvise(fd, POSIX_FADV_NORMAL);
+#endif
+			if (!stress_readahead_sweep_continue(args))
+				goto report;
+		}
+	} while (stress_readahead_sweep_continue(args));
+report:
+	stress_readahead_sweep_report(args, size, dropped, results);
+unmap_buf:
+	(void)munmap((void *)buf, SWEEP_BUF_SIZE);
+
+	return rc;
+}
+
 /*
  *  stress_readahead
  *	stress file system cache via readahead calls
@@ -110,6 +427,7 @@ static int stress_readahead(const stress_args_t *args)
 	off_t offsets[MAX_OFFSETS] ALIGN64;
 	int generate_offsets = 0;
 	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	bool readahead_sweep = false;
 
 	if (!stress_get_setting("readahead-bytes", &readahead_bytes)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -117,6 +435,7 @@ static int stress_readahead(const stress_args_t *args)
 		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
 			readahead_bytes = MIN_READAHEAD_BYTES;
 	}
+	(void)stress_get_setting("readahead-sweep", &readahead_sweep);
 	readahead_bytes /= args->num_instances;
 	if (readahead_bytes < MIN_READAHEAD_BYTES)
 		readahead_bytes = MIN_READAHEAD_BYTES;
@@ -213,6 +532,11 @@ seq_wr_retry:
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
+	if (readahead_sweep) {
+		rc = stress_readahead_sweep(args, fd, fs_type, rounded_readahead_bytes);
+		goto close_finish;
+	}
+
 	stress_readahead_generate_offsets(offsets, rounded_readahead_bytes);
 
 	do {
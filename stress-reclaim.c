@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) 2023 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+
+#define MIN_RECLAIM_BYTES	(4 * MB)
+#define MAX_RECLAIM_BYTES	(MAX_MEM_LIMIT)
+
+#define RECLAIM_HUGE_SIZE	(2 * MB)	/* THP and hugetlb allocation size */
+#define RECLAIM_HOLE_SHIFT	(3)		/* punch 1 in 8 pages per pressure pass */
+#define RECLAIM_HUGETLB_TRIES	(16)		/* give up on hugetlb if all these fail */
+
+static const stress_help_t help[] = {
+	{ NULL,	"reclaim N",		"start N workers measuring allocation latency under memory pressure" },
+	{ NULL,	"reclaim-bytes N",	"keep N bytes of background allocation pressure" },
+	{ NULL,	"reclaim-ops N",	"stop after N reclaim measurement bogo operations" },
+	{ NULL,	NULL,			NULL }
+};
+
+/* system wide reclaim and compaction counters */
+typedef struct {
+	uint64_t allocstall;		/* direct reclaim stalls */
+	uint64_t compact_stall;		/* direct compaction stalls */
+	uint64_t compact_fail;		/* failed direct compactions */
+	uint64_t compact_success;	/* successful direct compactions */
+	uint64_t thp_fault_alloc;	/* THP allocated at fault */
+	uint64_t thp_fault_fallback;	/* THP fault fell back to small pages */
+	uint64_t psi_some;		/* usecs some tasks stalled on memory */
+	uint64_t psi_full;		/* usecs all tasks stalled on memory */
+	bool vmstat;			/* /proc/vmstat was read */
+	bool psi;			/* /proc/pressure/memory was read */
+} stress_reclaim_stat_t;
+
+static int stress_set_reclaim_bytes(const char *opt)
+{
+	size_t reclaim_bytes;
+
+	reclaim_bytes = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("reclaim-bytes", reclaim_bytes,
+		MIN_RECLAIM_BYTES, MAX_RECLAIM_BYTES);
+	return stress_set_setting("reclaim-bytes", TYPE_ID_SIZE_T, &reclaim_bytes);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_reclaim_bytes,	stress_set_reclaim_bytes },
+	{ 0,			NULL }
+};
+
+#if defined(__linux__)
+
+/*
+ *  stress_reclaim_read_stat()
+ *	read the reclaim, compaction and THP counters from /proc/vmstat
+ *	and the memory stall times from /proc/pressure/memory
+ */
+static void stress_reclaim_read_stat(stress_reclaim_stat_t *stat)
+{
+	FILE *fp;
+	char buffer[256];
+
+	(void)memset(stat, 0, sizeof(*stat));
+
+	fp = fopen("/proc/vmstat", "r");
+	if (fp) {
+		while (fgets(buffer, sizeof(buffer), fp)) {
+			char name[64];
+			uint64_t val;
+
+			if (sscanf(buffer, "%63s %" SCNu64, name, &val) != 2)
+				continue;
+			/* allocstall is per zone on newer kernels */
+			if (!strncmp(name, "allocstall", 10))
+				stat->allocstall += val;
+			else if (!strcmp(name, "compact_stall"))
+				stat->compact_stall = val;
+			else if (!strcmp(name, "compact_fail"))
+				stat->compact_fail = val;
+			else if (!strcmp(name, "compact_success"))
+				stat->compact_success = val;
+			else if (!strcmp(name, "thp_fault_alloc"))
+				stat->thp_fault_alloc = val;
+			else if (!strcmp(name, "thp_fault_fallback"))
+				stat->thp_fault_fallback = val;
+		}
+		(void)fclose(fp);
+		stat->vmstat = true;
+	}
+
+	/* some avg10=0.00 avg60=0.00 avg300=0.00 total=0 */
+	fp = fopen("/proc/pressure/memory", "r");
+	if (fp) {
+		while (fgets(buffer, sizeof(buffer), fp)) {
+			const char *ptr = strstr(buffer, "total=");
+			uint64_t val;
+
+			if (!ptr || (sscanf(ptr + 6, "%" SCNu64, &val) != 1))
+				continue;
+			if (!strncmp(buffer, "some", 4))
+				stat->psi_some = val;
+			else if (!strncmp(buffer, "full", 4))
+				stat->psi_full = val;
+		}
+		(void)fclose(fp);
+		stat->psi = true;
+	}
+}
+
+/*
+ *  stress_reclaim_pressure()
+ *	background allocation pressure, keep bytes of small pages dirty
+ *	and punch scattered holes in them on each pass so that the free
+ *	memory stays fragmented and high order allocations have to
+ *	reclaim and compact
+ */
+static void NORETURN stress_reclaim_pressure(const stress_args_t *args, const size_t bytes)
+{
+	const size_t page_size = args->page_size;
+	const size_t pages = bytes / page_size;
+	uint8_t *buf;
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	/* the pressure should be the first thing the OOM killer picks */
+	stress_set_oom_adjustment(args->name, true);
+
+	buf = (uint8_t *)mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		_exit(EXIT_NO_RESOURCE);
+	stress_set_vma_anon_name(buf, pages * page_size, "reclaim-pressure");
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	(void)shim_madvise(buf, pages * page_size, MADV_NOHUGEPAGE);
+#endif
+
+	while (keep_stressing_flag()) {
+		size_t i;
+		uint8_t val = stress_mwc8();
+
+		for (i = 0; keep_stressing_flag() && (i < pages); i++)
+			buf[i * page_size] = val;
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_DONTNEED)
+		for (i = 0; keep_stressing_flag() && (i < pages >> RECLAIM_HOLE_SHIFT); i++) {
+			const size_t page = stress_mwc32modn((uint32_t)pages);
+
+			(void)shim_madvise(buf + (page * page_size), page_size, MADV_DONTNEED);
+		}
+#endif
+	}
+	_exit(0);
+}
+
+/*
+ *  stress_reclaim_pressure_start()
+ *	fork the background allocation pressure process
+ */
+static pid_t stress_reclaim_pressure_start(const stress_args_t *args, const size_t bytes)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid == 0)
+		stress_reclaim_pressure(args, bytes);
+	return pid;
+}
+
+/*
+ *  stress_reclaim_thp()
+ *	time a fault on a 2MB aligned region that may be backed by
+ *	a transparent huge page, the fault has to find a free 2MB
+ *	block, directly reclaiming and compacting memory if there is
+ *	none. Returns false if the region could not be mapped
+ */
+static bool stress_reclaim_thp(stress_latency_t *latency)
+{
+	uint8_t *buf, *huge;
+	uint64_t t;
+
+	buf = (uint8_t *)mmap(NULL, RECLAIM_HUGE_SIZE * 2, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return false;
+
+	huge = (uint8_t *)(((uintptr_t)buf + RECLAIM_HUGE_SIZE - 1) & ~(uintptr_t)(RECLAIM_HUGE_SIZE - 1));
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+	(void)shim_madvise(huge, RECLAIM_HUGE_SIZE, MADV_HUGEPAGE);
+#endif
+	t = stress_latency_now();
+	*(volatile uint8_t *)huge = 0xff;
+	stress_latency_add(latency, stress_latency_now() - t);
+
+	(void)munmap((void *)buf, RECLAIM_HUGE_SIZE * 2);
+	return true;
+}
+
+/*
+ *  stress_reclaim_hugetlb()
+ *	time the allocation of a hugetlb page, with no free persistent
+ *	huge pages this succeeds only if surplus pages can be allocated
+ *	via /proc/sys/vm/nr_overcommit_hugepages. Returns false if the
+ *	allocation failed
+ */
+static bool stress_reclaim_hugetlb(stress_latency_t *latency)
+{
+#if defined(MAP_HUGETLB)
+	uint8_t *buf;
+	uint64_t t;
+
+	t = stress_latency_now();
+	buf = (uint8_t *)mmap(NULL, RECLAIM_HUGE_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (buf == MAP_FAILED)
+		return false;
+	*(volatile uint8_t *)buf = 0xff;
+	stress_latency_add(latency, stress_latency_now() - t);
+
+	(void)munmap((void *)buf, RECLAIM_HUGE_SIZE);
+	return true;
+#else
+	(void)latency;
+
+	return false;
+#endif
+}
+
+/*
+ *  stress_reclaim_percent()
+ *	n as a percentage of n + m
+ */
+static inline double stress_reclaim_percent(const uint64_t n, const uint64_t m)
+{
+	return (n + m) ? 100.0 * (double)n / (double)(n + m) : 0.0;
+}
+
+/*
+ *  stress_reclaim_latency_metrics()
+ *	add mean, p50, p99 and max latency metrics
+ */
+static void stress_reclaim_latency_metrics(
+	const stress_args_t *args,
+	size_t *idx,
+	const char *what,
+	const stress_latency_t *latency)
+{
+	char str[64];
+
+	(void)snprintf(str, sizeof(str), "%s mean latency (ns)", what);
+	stress_metrics_set(args, (*idx)++, str, (double)latency->total / (double)latency->count);
+	(void)snprintf(str, sizeof(str), "%s p50 latency (ns)", what);
+	stress_metrics_set(args, (*idx)++, str, (double)stress_latency_percentile(latency, 50.0));
+	(void)snprintf(str, sizeof(str), "%s p99 latency (ns)", what);
+	stress_metrics_set(args, (*idx)++, str, (double)stress_latency_percentile(latency, 99.0));
+	(void)snprintf(str, sizeof(str), "%s max latency (ns)", what);
+	stress_metrics_set(args, (*idx)++, str, (double)latency->max);
+}
+
+/*
+ *  stress_reclaim()
+ *	measure high order allocation latency, direct reclaim stalls
+ *	and compaction success while background allocations keep
+ *	memory under pressure
+ */
+static int stress_reclaim(const stress_args_t *args)
+{
+	stress_latency_t *latencies, *thp_latency, *hugetlb_latency;
+	stress_reclaim_stat_t begin, end;
+	size_t reclaim_bytes = (size_t)(stress_get_phys_mem_size() / 2);
+	size_t idx = 0;
+	uint64_t hugetlb_tries = 0, hugetlb_fails = 0, restarts = 0;
+	pid_t pid;
+	double t, duration;
+	int rc = EXIT_SUCCESS;
+	char str[32];
+
+	if (!stress_get_setting("reclaim-bytes", &reclaim_bytes)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			reclaim_bytes = (size_t)((stress_get_phys_mem_size() * 9) / 10);
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			reclaim_bytes = MIN_RECLAIM_BYTES;
+	}
+	reclaim_bytes /= args->num_instances;
+	if (reclaim_bytes < MIN_RECLAIM_BYTES)
+		reclaim_bytes = MIN_RECLAIM_BYTES;
+	if (args->instance == 0)
+		pr_dbg("%s: %s of background allocation pressure per instance\n",
+			args->name, stress_uint64_to_str(str, sizeof(str), (uint64_t)reclaim_bytes));
+
+	latencies = (stress_latency_t *)calloc(2, sizeof(*latencies));
+	if (!latencies) {
+		pr_inf_skip("%s: cannot allocate latency histograms, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	thp_latency = &latencies[0];
+	hugetlb_latency = &latencies[1];
+	stress_latency_reset(thp_latency);
+	stress_latency_reset(hugetlb_latency);
+
+	pid = stress_reclaim_pressure_start(args, reclaim_bytes);
+	if (pid < 0) {
+		pr_inf_skip("%s: fork failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		free(latencies);
+		return EXIT_NO_RESOURCE;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	stress_reclaim_read_stat(&begin);
+	t = stress_time_now();
+	do {
+		int status;
+
+		/* the OOM killer may have reaped the pressure, restart it */
+		if ((pid < 0) || (waitpid(pid, &status, WNOHANG) == pid)) {
+			pid = stress_reclaim_pressure_start(args, reclaim_bytes);
+			restarts++;
+		}
+
+		if (!stress_reclaim_thp(thp_latency) && (errno != ENOMEM)) {
+			pr_fail("%s: mmap of %zu bytes failed, errno=%d (%s)\n",
+				args->name, (size_t)RECLAIM_HUGE_SIZE * 2, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if ((hugetlb_tries < RECLAIM_HUGETLB_TRIES) || (hugetlb_fails < hugetlb_tries)) {
+			hugetlb_tries++;
+			if (!stress_reclaim_hugetlb(hugetlb_latency))
+				hugetlb_fails++;
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+	duration = stress_time_now() - t;
+	stress_reclaim_read_stat(&end);
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (pid > 0) {
+		int status;
+
+		(void)stress_killpid(pid);
+		(void)shim_waitpid(pid, &status, 0);
+	}
+
+	if (restarts > 0)
+		pr_dbg("%s: background pressure was restarted %" PRIu64 " times\n",
+			args->name, restarts);
+
+	if (thp_latency->count > 0)
+		stress_reclaim_latency_metrics(args, &idx, "THP fault", thp_latency);
+	if (hugetlb_latency->count > 0)
+		stress_reclaim_latency_metrics(args, &idx, "hugetlb alloc", hugetlb_latency);
+	if (hugetlb_tries > 0)
+		stress_metrics_set(args, idx++, "hugetlb alloc success %",
+			stress_reclaim_percent(hugetlb_tries - hugetlb_fails, hugetlb_fails));
+
+	if (end.vmstat && (duration > 0.0)) {
+		stress_metrics_set(args, idx++, "THP fault success % (system wide)",
+			stress_reclaim_percent(end.thp_fault_alloc - begin.thp_fault_alloc,
+				end.thp_fault_fallback - begin.thp_fault_fallback));
+		stress_metrics_set(args, idx++, "direct reclaim stalls per sec (system wide)",
+			(double)(end.allocstall - begin.allocstall) / duration);
+		stress_metrics_set(args, idx++, "compaction stalls per sec (system wide)",
+			(double)(end.compact_stall - begin.compact_stall) / duration);
+		stress_metrics_set(args, idx++, "compaction success % (system wide)",
+			stress_reclaim_percent(end.compact_success - begin.compact_success,
+				end.compact_fail - begin.compact_fail));
+	}
+	if (end.psi && (duration > 0.0)) {
+		stress_metrics_set(args, idx++, "memory stall some % (PSI)",
+			100.0 * (double)(end.psi_some - begin.psi_some) / (duration * STRESS_DBL_MICROSECOND));
+		stress_metrics_set(args, idx++, "memory stall full % (PSI)",
+			100.0 * (double)(end.psi_full - begin.psi_full) / (duration * STRESS_DBL_MICROSECOND));
+	}
+
+	if (args->latency)
+		stress_latency_merge(args->latency, thp_latency);
+	free(latencies);
+
+	return rc;
+}
+
+stressor_info_t stress_reclaim_info = {
+	.stressor = stress_reclaim,
+	.class = CLASS_VM | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_NONE,
+	.help = help
+};
+#else
+stressor_info_t stress_reclaim_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_VM | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_NONE,
+	.help = help,
+	.unimplemented_reason = "only supported on Linux"
+};
+#endif
@@ -0,0 +1,985 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-net.h"
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
+#include <netinet/in.h>
+
+/*
+ *  Trace file format, all fields are little endian:
+ *
+ *  header, 16 bytes:
+ *	char	 magic[8];	"SNGRPLAY"
+ *	uint32_t version;	REPLAY_VERSION
+ *	uint32_t record_size;	at least REPLAY_RECORD_SIZE, larger
+ *				records are allowed and the extra
+ *				bytes are ignored
+ *  followed by records, in time order for each thread:
+ *	uint64_t time_ns;	issue time from the start of the trace
+ *	uint64_t offset;	file offset
+ *	uint32_t size;		bytes to transfer
+ *	uint16_t slot;		file or socket slot of the thread
+ *	uint8_t  thread;	thread issuing the operation
+ *	uint8_t  op;		REPLAY_OP_*
+ *
+ *  Each thread has its own file and socket slots. Read, write, mmap,
+ *  sync and send operations on a slot that is not open implicitly
+ *  open it so traces do not need to start with an open or connect.
+ */
+#define REPLAY_MAGIC		"SNGRPLAY"
+#define REPLAY_VERSION		(1)
+#define REPLAY_HEADER_SIZE	(16)
+#define REPLAY_RECORD_SIZE	(32)
+
+#define REPLAY_OP_OPEN		(0)	/* open or create the slot file */
+#define REPLAY_OP_CLOSE		(1)	/* close the slot file */
+#define REPLAY_OP_READ		(2)	/* pread size bytes at offset */
+#define REPLAY_OP_WRITE		(3)	/* pwrite size bytes at offset */
+#define REPLAY_OP_FSYNC		(4)	/* fsync the slot file */
+#define REPLAY_OP_FDATASYNC	(5)	/* fdatasync the slot file */
+#define REPLAY_OP_MMAP		(6)	/* mmap size bytes at offset, read each page, munmap */
+#define REPLAY_OP_CONNECT	(7)	/* connect the slot socket */
+#define REPLAY_OP_SEND		(8)	/* send size bytes on the slot socket */
+#define REPLAY_OP_SHUTDOWN	(9)	/* close the slot socket */
+#define REPLAY_OP_MAX		(10)
+
+#define REPLAY_MODE_TIMED	(0)	/* original inter-arrival times */
+#define REPLAY_MODE_FAST	(1)	/* as fast as possible */
+
+#define MIN_REPLAY_PORT		(1024)
+#define MAX_REPLAY_PORT		(65535)
+#define DEFAULT_REPLAY_PORT	(15000)
+
+#define MIN_REPLAY_SPEED	(1)
+#define MAX_REPLAY_SPEED	(100000)
+#define DEFAULT_REPLAY_SPEED	(100)
+
+#define MIN_REPLAY_THREADS	(1)
+#define MAX_REPLAY_THREADS	(64)
+
+#define REPLAY_SLOTS		(64)		/* file and socket slots per thread */
+#define REPLAY_BUF_SIZE		(1 * MB)	/* per thread I/O buffer */
+#define REPLAY_FILE_MAX		(256 * MB)	/* offsets wrap at this file size */
+#define REPLAY_RECORDS_MAX	(16 * 1024 * 1024)
+
+/* synthetic trace used when no trace file is specified */
+#define REPLAY_SYNTH_THREADS	(4)
+#define REPLAY_SYNTH_RECORDS	(2048)		/* per thread */
+#define REPLAY_SYNTH_DURATION	(1000000000ULL)	/* 1 second */
+#define REPLAY_SYNTH_FILE_SIZE	(16 * MB)
+
+static const stress_help_t help[] = {
+	{ NULL,	"replay N",		"start N workers replaying a file, socket and mmap trace" },
+	{ NULL,	"replay-file F",	"replay trace file F, default is a synthetic trace" },
+	{ NULL,	"replay-mode M",	"select mode [ timed | fast ]" },
+	{ NULL,	"replay-ops N",		"stop after N replayed operations" },
+	{ NULL,	"replay-port P",	"use socket ports P to P + number of workers - 1" },
+	{ NULL,	"replay-speed P",	"replay timed traces at P percent of the original speed" },
+	{ NULL,	"replay-threads N",	"number of replay threads, default is the trace thread count" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const replay_modes[] = {
+	"timed",
+	"fast",
+};
+
+static int stress_set_replay_file(const char *opt)
+{
+	return stress_set_setting("replay-file", TYPE_ID_STR, opt);
+}
+
+static int stress_set_replay_mode(const char *opt)
+{
+	int i;
+
+	for (i = 0; i < (int)SIZEOF_ARRAY(replay_modes); i++) {
+		if (!strcmp(opt, replay_modes[i]))
+			return stress_set_setting("replay-mode", TYPE_ID_INT, &i);
+	}
+	(void)fprintf(stderr, "replay-mode must be one of:");
+	for (i = 0; i < (int)SIZEOF_ARRAY(replay_modes); i++)
+		(void)fprintf(stderr, " %s", replay_modes[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_replay_port(const char *opt)
+{
+	int replay_port;
+
+	stress_set_net_port("replay-port", opt,
+		MIN_REPLAY_PORT, MAX_REPLAY_PORT, &replay_port);
+	return stress_set_setting("replay-port", TYPE_ID_INT, &replay_port);
+}
+
+static int stress_set_replay_speed(const char *opt)
+{
+	uint32_t replay_speed;
+
+	replay_speed = stress_get_uint32(opt);
+	stress_check_range("replay-speed", (uint64_t)replay_speed,
+		MIN_REPLAY_SPEED, MAX_REPLAY_SPEED);
+	return stress_set_setting("replay-speed", TYPE_ID_UINT32, &replay_speed);
+}
+
+static int stress_set_replay_threads(const char *opt)
+{
+	uint32_t replay_threads;
+
+	replay_threads = stress_get_uint32(opt);
+	stress_check_range("replay-threads", (uint64_t)replay_threads,
+		MIN_REPLAY_THREADS, MAX_REPLAY_THREADS);
+	return stress_set_setting("replay-threads", TYPE_ID_UINT32, &replay_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_replay_file,	stress_set_replay_file },
+	{ OPT_replay_mode,	stress_set_replay_mode },
+	{ OPT_replay_port,	stress_set_replay_port },
+	{ OPT_replay_speed,	stress_set_replay_speed },
+	{ OPT_replay_threads,	stress_set_replay_threads },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_POLL_H)
+
+static const char * const replay_ops[REPLAY_OP_MAX] = {
+	"open",
+	"close",
+	"read",
+	"write",
+	"fsync",
+	"fdatasync",
+	"mmap",
+	"connect",
+	"send",
+	"shutdown",
+};
+
+/* a decoded trace record */
+typedef struct {
+	uint64_t time_ns;		/* issue time from the start of the trace */
+	uint64_t offset;		/* file offset */
+	uint32_t size;			/* bytes to transfer */
+	uint16_t slot;			/* file or socket slot */
+	uint8_t thread;			/* trace thread */
+	uint8_t op;			/* REPLAY_OP_* */
+} stress_replay_rec_t;
+
+/* state shared by the replay and sink threads */
+typedef struct {
+	const stress_args_t *args;
+	struct sockaddr *addr;		/* sink server address */
+	socklen_t addr_len;
+	int listen_fd;			/* sink server socket */
+	int mode;			/* REPLAY_MODE_* */
+	uint32_t speed;			/* percent of the original speed */
+	uint64_t start_ns;		/* start time of the current pass */
+	volatile bool sink_stop;	/* tell the sink thread to stop */
+	uint64_t sink_bytes;		/* bytes drained by the sink */
+} stress_replay_ctx_t;
+
+/* per replay thread state, kept across passes of the trace */
+typedef struct {
+	stress_replay_ctx_t *ctx;
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	uint32_t index;			/* replay thread number */
+	const stress_replay_rec_t **recs; /* records replayed by this thread */
+	size_t n_recs;
+	int fds[REPLAY_SLOTS];		/* slot files */
+	int socks[REPLAY_SLOTS];	/* slot sockets */
+	bool created[REPLAY_SLOTS];	/* slot file was created */
+	uint8_t *buf;			/* I/O buffer */
+	stress_latency_t *latency;	/* per operation latency histograms */
+	uint64_t ops;			/* operations replayed */
+	uint64_t bytes;			/* bytes transferred */
+	uint64_t errors;		/* operations that failed */
+	uint64_t lag_ns;		/* total lateness of timed operations */
+} stress_replay_thread_t;
+
+static inline uint64_t stress_replay_le(const uint8_t *ptr, const size_t n)
+{
+	uint64_t val = 0;
+	size_t i;
+
+	for (i = n; i > 0; i--)
+		val = (val << 8) | ptr[i - 1];
+	return val;
+}
+
+/*
+ *  stress_replay_load()
+ *	load and decode a trace file, returns NULL on failure
+ */
+static stress_replay_rec_t *stress_replay_load(
+	const stress_args_t *args,
+	const char *filename,
+	size_t *n_recs)
+{
+	struct stat statbuf;
+	stress_replay_rec_t *recs = NULL;
+	uint8_t header[REPLAY_HEADER_SIZE], *raw = NULL;
+	size_t record_size, i, n;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		pr_fail("%s: cannot open trace file %s, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		return NULL;
+	}
+	if ((fstat(fd, &statbuf) < 0) ||
+	    (read(fd, header, sizeof(header)) != (ssize_t)sizeof(header)) ||
+	    memcmp(header, REPLAY_MAGIC, 8)) {
+		pr_fail("%s: %s is not a replay trace file\n", args->name, filename);
+		goto err;
+	}
+	if (stress_replay_le(header + 8, 4) != REPLAY_VERSION) {
+		pr_fail("%s: %s is trace version %" PRIu64 ", expecting version %d\n",
+			args->name, filename, stress_replay_le(header + 8, 4), REPLAY_VERSION);
+		goto err;
+	}
+	record_size = (size_t)stress_replay_le(header + 12, 4);
+	if ((record_size < REPLAY_RECORD_SIZE) ||
+	    ((statbuf.st_size - REPLAY_HEADER_SIZE) % (off_t)record_size)) {
+		pr_fail("%s: %s has a bad record size of %zd bytes\n",
+			args->name, filename, record_size);
+		goto err;
+	}
+	n = (size_t)((statbuf.st_size - REPLAY_HEADER_SIZE) / (off_t)record_size);
+	if ((n == 0) || (n > REPLAY_RECORDS_MAX)) {
+		pr_fail("%s: %s has %zd records, expecting 1 to %d records\n",
+			args->name, filename, n, REPLAY_RECORDS_MAX);
+		goto err;
+	}
+
+	raw = (uint8_t *)malloc(n * record_size);
+	recs = (stress_replay_rec_t *)calloc(n, sizeof(*recs));
+	if (!raw || !recs) {
+		pr_inf_skip("%s: cannot allocate %zd trace records, skipping stressor\n",
+			args->name, n);
+		goto err;
+	}
+	if (read(fd, raw, n * record_size) != (ssize_t)(n * record_size)) {
+		pr_fail("%s: cannot read trace file %s, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		const uint8_t *ptr = raw + (i * record_size);
+
+		recs[i].time_ns = stress_replay_le(ptr, 8);
+		recs[i].offset = stress_replay_le(ptr + 8, 8);
+		recs[i].size = (uint32_t)stress_replay_le(ptr + 16, 4);
+		recs[i].slot = (uint16_t)stress_replay_le(ptr + 20, 2);
+		recs[i].thread = ptr[22];
+		recs[i].op = ptr[23];
+		if (recs[i].op >= REPLAY_OP_MAX) {
+			pr_fail("%s: %s record %zd has unknown operation %u\n",
+				args->name, filename, i, (unsigned int)recs[i].op);
+			goto err;
+		}
+	}
+	free(raw);
+	(void)close(fd);
+	*n_recs = n;
+
+	return recs;
+err:
+	free(recs);
+	free(raw);
+	(void)close(fd);
+	return NULL;
+}
+
+/*
+ *  stress_replay_synth()
+ *	generate a trace of REPLAY_SYNTH_THREADS threads each doing
+ *	a mix of file reads, writes, syncs, mmaps and socket sends
+ *	with random inter-arrival times over REPLAY_SYNTH_DURATION
+ */
+static stress_replay_rec_t *stress_replay_synth(size_t *n_recs)
+{
+	const size_t n = REPLAY_SYNTH_THREADS * REPLAY_SYNTH_RECORDS;
+	const uint32_t mean_ns = (uint32_t)(REPLAY_SYNTH_DURATION / REPLAY_SYNTH_RECORDS);
+	stress_replay_rec_t *recs, *rec;
+	uint8_t t;
+
+	recs = (stress_replay_rec_t *)calloc(n, sizeof(*recs));
+	if (!recs)
+		return NULL;
+
+	for (rec = recs, t = 0; t < REPLAY_SYNTH_THREADS; t++) {
+		uint64_t time_ns = 0;
+		size_t i;
+
+		for (i = 0; i < REPLAY_SYNTH_RECORDS; i++, rec++) {
+			const uint32_t r = stress_mwc32modn(100);
+
+			rec->thread = t;
+			rec->time_ns = time_ns;
+			rec->offset = (uint64_t)stress_mwc32modn(REPLAY_SYNTH_FILE_SIZE / 4096) * 4096;
+			rec->size = 4096U << stress_mwc8modn(5);	/* 4K..64K */
+			if (i == 0) {
+				rec->op = REPLAY_OP_OPEN;
+			} else if (i == 1) {
+				rec->op = REPLAY_OP_CONNECT;
+				rec->slot = 1;
+			} else if (i == REPLAY_SYNTH_RECORDS - 2) {
+				rec->op = REPLAY_OP_CLOSE;
+			} else if (i == REPLAY_SYNTH_RECORDS - 1) {
+				rec->op = REPLAY_OP_SHUTDOWN;
+				rec->slot = 1;
+			} else if (r < 40) {
+				rec->op = REPLAY_OP_READ;
+			} else if (r < 70) {
+				rec->op = REPLAY_OP_WRITE;
+			} else if (r < 85) {
+				rec->op = REPLAY_OP_SEND;
+				rec->slot = 1;
+			} else if (r < 92) {
+				rec->op = REPLAY_OP_MMAP;
+			} else if (r < 97) {
+				rec->op = REPLAY_OP_FDATASYNC;
+			} else {
+				rec->op = REPLAY_OP_FSYNC;
+			}
+			time_ns += stress_mwc32modn(2 * mean_ns);
+		}
+	}
+	*n_recs = n;
+
+	return recs;
+}
+
+/*
+ *  stress_replay_file()
+ *	return the file descriptor of a slot, opening it if required
+ */
+static int stress_replay_file(stress_replay_thread_t *thread, const uint16_t slot)
+{
+	if (thread->fds[slot] < 0) {
+		char filename[PATH_MAX];
+
+		(void)stress_temp_filename_args(thread->ctx->args, filename, sizeof(filename),
+			((uint64_t)thread->index << 16) | slot);
+		thread->fds[slot] = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+		if (thread->fds[slot] >= 0)
+			thread->created[slot] = true;
+	}
+	return thread->fds[slot];
+}
+
+/*
+ *  stress_replay_sock()
+ *	return the socket of a slot, connecting it if required
+ */
+static int stress_replay_sock(stress_replay_thread_t *thread, const uint16_t slot)
+{
+	if (thread->socks[slot] < 0) {
+		const stress_replay_ctx_t *ctx = thread->ctx;
+		int fd;
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		if (connect(fd, ctx->addr, ctx->addr_len) < 0) {
+			(void)close(fd);
+			return -1;
+		}
+		thread->socks[slot] = fd;
+	}
+	return thread->socks[slot];
+}
+
+/*
+ *  stress_replay_io()
+ *	pread or pwrite size bytes at offset in REPLAY_BUF_SIZE chunks,
+ *	returns the bytes transferred or -1 on failure
+ */
+static int64_t stress_replay_io(
+	stress_replay_thread_t *thread,
+	const int fd,
+	const bool write_op,
+	uint64_t offset,
+	uint64_t size)
+{
+	int64_t total = 0;
+
+	offset %= REPLAY_FILE_MAX;
+	while (size > 0) {
+		const size_t len = (size_t)STRESS_MINIMUM(size, REPLAY_BUF_SIZE);
+		const ssize_t ret = write_op ?
+			pwrite(fd, thread->buf, len, (off_t)offset) :
+			pread(fd, thread->buf, len, (off_t)offset);
+
+		if (ret < 0)
+			return -1;
+		if (ret == 0)
+			break;
+		total += ret;
+		offset += (uint64_t)ret;
+		size -= (uint64_t)ret;
+	}
+	return total;
+}
+
+/*
+ *  stress_replay_mmap()
+ *	map size bytes of the file at offset, read each page and
+ *	unmap it, the file is extended if required to avoid SIGBUS
+ */
+static int64_t stress_replay_mmap(const int fd, const uint64_t offset, const uint64_t size)
+{
+	const size_t page_size = stress_get_page_size();
+	const off_t off = (off_t)((offset % REPLAY_FILE_MAX) & ~(uint64_t)(page_size - 1));
+	const size_t len = (size_t)STRESS_MINIMUM(size, REPLAY_FILE_MAX);
+	struct stat statbuf;
+	volatile uint8_t *ptr;
+	size_t i;
+
+	if (len == 0)
+		return 0;
+	if (fstat(fd, &statbuf) < 0)
+		return -1;
+	if ((statbuf.st_size < off + (off_t)len) &&
+	    (ftruncate(fd, off + (off_t)len) < 0))
+		return -1;
+	ptr = (volatile uint8_t *)mmap(NULL, len, PROT_READ, MAP_SHARED, fd, off);
+	if (ptr == MAP_FAILED)
+		return -1;
+	for (i = 0; i < len; i += page_size)
+		(void)ptr[i];
+	(void)munmap((void *)ptr, len);
+
+	return (int64_t)len;
+}
+
+/*
+ *  stress_replay_op()
+ *	replay one trace record, returns the bytes transferred
+ *	or -1 on failure
+ */
+static int64_t stress_replay_op(stress_replay_thread_t *thread, const stress_replay_rec_t *rec)
+{
+	const uint16_t slot = rec->slot % REPLAY_SLOTS;
+	int fd;
+
+	switch (rec->op) {
+	case REPLAY_OP_OPEN:
+		return (stress_replay_file(thread, slot) < 0) ? -1 : 0;
+	case REPLAY_OP_CLOSE:
+		if (thread->fds[slot] >= 0) {
+			(void)close(thread->fds[slot]);
+			thread->fds[slot] = -1;
+		}
+		return 0;
+	case REPLAY_OP_READ:
+	case REPLAY_OP_WRITE:
+		fd = stress_replay_file(thread, slot);
+		if (fd < 0)
+			return -1;
+		return stress_replay_io(thread, fd, rec->op == REPLAY_OP_WRITE,
+			rec->offset, rec->size);
+	case REPLAY_OP_FSYNC:
+		fd = stress_replay_file(thread, slot);
+		if (fd < 0)
+			return -1;
+		return (shim_fsync(fd) < 0) ? -1 : 0;
+	case REPLAY_OP_FDATASYNC:
+		fd = stress_replay_file(thread, slot);
+		if (fd < 0)
+			return -1;
+		return (shim_fdatasync(fd) < 0) ? -1 : 0;
+	case REPLAY_OP_MMAP:
+		fd = stress_replay_file(thread, slot);
+		if (fd < 0)
+			return -1;
+		return stress_replay_mmap(fd, rec->offset, rec->size);
+	case REPLAY_OP_CONNECT:
+		return (stress_replay_sock(thread, slot) < 0) ? -1 : 0;
+	case REPLAY_OP_SEND: {
+		uint64_t size = rec->size;
+		int64_t total = 0;
+
+		fd = stress_replay_sock(thread, slot);
+		if (fd < 0)
+			return -1;
+		while (size > 0) {
+			const size_t len = (size_t)STRESS_MINIMUM(size, REPLAY_BUF_SIZE);
+			const ssize_t ret = send(fd, thread->buf, len, MSG_NOSIGNAL);
+
+			if (ret <= 0)
+				return -1;
+			total += ret;
+			size -= (uint64_t)ret;
+		}
+		return total;
+	}
+	case REPLAY_OP_SHUTDOWN:
+		if (thread->socks[slot] >= 0) {
+			(void)close(thread->socks[slot]);
+			thread->socks[slot] = -1;
+		}
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+/*
+ *  stress_replay_thread()
+ *	replay the records of one thread for one pass of the trace,
+ *	in timed mode each record is issued at its scaled trace time
+ */
+static void *stress_replay_thread(void *arg)
+{
+	stress_replay_thread_t *thread = (stress_replay_thread_t *)arg;
+	const stress_replay_ctx_t *ctx = thread->ctx;
+	size_t i, j;
+
+	for (i = 0; (i < thread->n_recs) && keep_stressing_flag(); i++) {
+		const stress_replay_rec_t *rec = thread->recs[i];
+		uint64_t t_begin;
+		int64_t ret;
+
+		if (ctx->mode == REPLAY_MODE_TIMED) {
+			const uint64_t due_ns = ctx->start_ns +
+				(uint64_t)((double)rec->time_ns * 100.0 / (double)ctx->speed);
+			uint64_t now_ns;
+
+			/* sleep in short naps so a stop request is not missed */
+			while (((now_ns = stress_latency_now()) < due_ns) && keep_stressing_flag())
+				(void)shim_nanosleep_uint64(STRESS_MINIMUM(due_ns - now_ns, 100000000ULL));
+			t_begin = stress_latency_now();
+			if (t_begin > due_ns)
+				thread->lag_ns += t_begin - due_ns;
+		} else {
+			t_begin = stress_latency_now();
+		}
+		ret = stress_replay_op(thread, rec);
+		stress_latency_add(&thread->latency[rec->op], stress_latency_now() - t_begin);
+		if (ret < 0)
+			thread->errors++;
+		else
+			thread->bytes += (uint64_t)ret;
+		thread->ops++;
+	}
+
+	/* each pass starts with closed files and sockets */
+	for (j = 0; j < REPLAY_SLOTS; j++) {
+		if (thread->fds[j] >= 0) {
+			(void)close(thread->fds[j]);
+			thread->fds[j] = -1;
+		}
+		if (thread->socks[j] >= 0) {
+			(void)close(thread->socks[j]);
+			thread->socks[j] = -1;
+		}
+	}
+	return NULL;
+}
+
+/*
+ *  stress_replay_sink()
+ *	accept connections and drain the data sent by the replay threads
+ */
+static void *stress_replay_sink(void *arg)
+{
+	stress_replay_ctx_t *ctx = (stress_replay_ctx_t *)arg;
+	const size_t max_fds = (MAX_REPLAY_THREADS * REPLAY_SLOTS) + 1;
+	struct pollfd *pfds;
+	size_t n_fds = 1;
+	static uint8_t buf[64 * KB];
+
+	pfds = (struct pollfd *)calloc(max_fds, sizeof(*pfds));
+	if (!pfds)
+		return NULL;
+	pfds[0].fd = ctx->listen_fd;
+	pfds[0].events = POLLIN;
+
+	while (!ctx->sink_stop) {
+		size_t i;
+
+		if (poll(pfds, (nfds_t)n_fds, 100) <= 0)
+			continue;
+		if ((pfds[0].revents & POLLIN) && (n_fds < max_fds)) {
+			const int fd = accept(ctx->listen_fd, NULL, NULL);
+
+			if (fd >= 0) {
+				pfds[n_fds].fd = fd;
+				pfds[n_fds].events = POLLIN;
+				pfds[n_fds].revents = 0;
+				n_fds++;
+			}
+		}
+		for (i = 1; i < n_fds; i++) {
+			ssize_t ret;
+
+			if (!pfds[i].revents)
+				continue;
+			ret = recv(pfds[i].fd, buf, sizeof(buf), MSG_DONTWAIT);
+			if (ret > 0) {
+				ctx->sink_bytes += (uint64_t)ret;
+			} else if ((ret == 0) || ((errno != EAGAIN) && (errno != EINTR))) {
+				(void)close(pfds[i].fd);
+				pfds[i] = pfds[--n_fds];
+				i--;
+			}
+		}
+	}
+	for (n_fds--; n_fds > 0; n_fds--)
+		(void)close(pfds[n_fds].fd);
+	free(pfds);
+
+	return NULL;
+}
+
+/*
+ *  stress_replay_sink_start()
+ *	listen on the reserved loopback port and start the sink
+ *	thread, returns 0 on success
+ */
+static int stress_replay_sink_start(
+	const stress_args_t *args,
+	stress_replay_ctx_t *ctx,
+	pthread_t *pthread,
+	const int port)
+{
+	int so_reuseaddr = 1, ret;
+
+	if (stress_set_sockaddr(args->name, args->instance, args->pid,
+			AF_INET, port, &ctx->addr, &ctx->addr_len, NET_ADDR_LOOPBACK) < 0)
+		return -1;
+	ctx->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (ctx->listen_fd < 0)
+		return -1;
+	(void)setsockopt(ctx->listen_fd, SOL_SOCKET, SO_REUSEADDR,
+		&so_reuseaddr, sizeof(so_reuseaddr));
+	if ((bind(ctx->listen_fd, ctx->addr, ctx->addr_len) < 0) ||
+	    (listen(ctx->listen_fd, SOMAXCONN) < 0))
+		goto err;
+	ret = pthread_create(pthread, NULL, stress_replay_sink, ctx);
+	if (ret) {
+		errno = ret;
+		goto err;
+	}
+	return 0;
+err:
+	(void)close(ctx->listen_fd);
+	ctx->listen_fd = -1;
+	return -1;
+}
+
+/*
+ *  stress_replay_report()
+ *	set the captured vs achieved throughput and per operation
+ *	latency metrics
+ */
+static void stress_replay_report(
+	const stress_args_t *args,
+	const stress_replay_ctx_t *ctx,
+	const stress_replay_thread_t *threads,
+	const uint32_t n_threads,
+	const stress_replay_rec_t *recs,
+	const size_t n_recs,
+	const double duration)
+{
+	stress_latency_t *latency;
+	uint64_t min_ns = UINT64_MAX, max_ns = 0, trace_bytes = 0;
+	uint64_t ops = 0, bytes = 0, errors = 0, lag_ns = 0;
+	double trace_duration;
+	size_t i, idx = 0;
+	int op;
+
+	for (i = 0; i < n_recs; i++) {
+		if (recs[i].time_ns < min_ns)
+			min_ns = recs[i].time_ns;
+		if (recs[i].time_ns > max_ns)
+			max_ns = recs[i].time_ns;
+		if ((recs[i].op == REPLAY_OP_READ) || (recs[i].op == REPLAY_OP_WRITE) ||
+		    (recs[i].op == REPLAY_OP_MMAP) || (recs[i].op == REPLAY_OP_SEND))
+			trace_bytes += recs[i].size;
+	}
+	trace_duration = (double)(max_ns - min_ns) / STRESS_DBL_NANOSECOND;
+
+	for (i = 0; i < n_threads; i++) {
+		ops += threads[i].ops;
+		bytes += threads[i].bytes;
+		errors += threads[i].errors;
+		lag_ns += threads[i].lag_ns;
+	}
+
+	if (trace_duration > 0.0) {
+		stress_metrics_set(args, idx++, "captured ops per sec", (double)n_recs / trace_duration);
+		stress_metrics_set(args, idx++, "captured MB per sec",
+			(double)trace_bytes / trace_duration / (double)MB);
+	}
+	if (duration > 0.0) {
+		stress_metrics_set(args, idx++, "achieved ops per sec", (double)ops / duration);
+		stress_metrics_set(args, idx++, "achieved MB per sec",
+			(double)bytes / duration / (double)MB);
+	}
+	if ((ctx->mode == REPLAY_MODE_TIMED) && (ops > 0))
+		stress_metrics_set(args, idx++, "mean schedule lag usecs",
+			(double)lag_ns / (double)ops / 1000.0);
+	stress_metrics_set(args, idx++, "failed ops", (double)errors);
+
+	latency = (stress_latency_t *)malloc(sizeof(*latency));
+	if (!latency)
+		return;
+	for (op = 0; op < REPLAY_OP_MAX; op++) {
+		char str[64];
+
+		stress_latency_reset(latency);
+		for (i = 0; i < n_threads; i++)
+			stress_latency_merge(latency, &threads[i].latency[op]);
+		if (args->latency)
+			stress_latency_merge(args->latency, latency);
+		if (latency->count == 0)
+			continue;
+		(void)snprintf(str, sizeof(str), "%s mean latency usecs", replay_ops[op]);
+		stress_metrics_set(args, idx++, str,
+			(double)latency->total / (double)latency->count / 1000.0);
+		(void)snprintf(str, sizeof(str), "%s p99 latency usecs", replay_ops[op]);
+		stress_metrics_set(args, idx++, str,
+			(double)stress_latency_percentile(latency, 99.0) / 1000.0);
+	}
+	free(latency);
+}
+
+/*
+ *  stress_replay
+ *	replay a trace of file I/O, socket and mmap operations
+ *	across multiple threads
+ */
+static int stress_replay(const stress_args_t *args)
+{
+	const char *replay_file = NULL;
+	int replay_port = DEFAULT_REPLAY_PORT, reserved_port = -1, rc = EXIT_SUCCESS;
+	uint32_t replay_threads = 0, n_threads = 1, t;
+	stress_replay_rec_t *recs;
+	stress_replay_thread_t *threads = NULL;
+	const stress_replay_rec_t **rec_ptrs = NULL;
+	stress_replay_ctx_t ctx;
+	pthread_t sink_pthread;
+	bool sink = false, sockets = false;
+	double duration = 0.0;
+	size_t i, n_recs = 0, n;
+	int ret;
+
+	(void)memset(&ctx, 0, sizeof(ctx));
+	ctx.args = args;
+	ctx.listen_fd = -1;
+	ctx.mode = REPLAY_MODE_TIMED;
+	ctx.speed = DEFAULT_REPLAY_SPEED;
+	(void)stress_get_setting("replay-file", &replay_file);
+	(void)stress_get_setting("replay-mode", &ctx.mode);
+	(void)stress_get_setting("replay-port", &replay_port);
+	(void)stress_get_setting("replay-speed", &ctx.speed);
+	(void)stress_get_setting("replay-threads", &replay_threads);
+
+	if (replay_file) {
+		recs = stress_replay_load(args, replay_file, &n_recs);
+		if (!recs)
+			return EXIT_FAILURE;
+	} else {
+		recs = stress_replay_synth(&n_recs);
+		if (!recs) {
+			pr_inf_skip("%s: cannot allocate synthetic trace, skipping stressor\n",
+				args->name);
+			return EXIT_NO_RESOURCE;
+		}
+	}
+
+	/* one replay thread per trace thread unless overridden */
+	for (i = 0; i < n_recs; i++) {
+		if ((uint32_t)recs[i].thread + 1 > n_threads)
+			n_threads = (uint32_t)recs[i].thread + 1;
+		if ((recs[i].op == REPLAY_OP_CONNECT) || (recs[i].op == REPLAY_OP_SEND))
+			sockets = true;
+	}
+	if (replay_threads)
+		n_threads = replay_threads;
+	n_threads = STRESS_MINIMUM(n_threads, MAX_REPLAY_THREADS);
+	if (args->instance == 0)
+		pr_dbg("%s: replaying %s trace of %zd operations with %" PRIu32 " threads\n",
+			args->name, replay_file ? replay_file : "synthetic", n_recs, n_threads);
+
+	threads = (stress_replay_thread_t *)calloc(n_threads, sizeof(*threads));
+	rec_ptrs = (const stress_replay_rec_t **)calloc(n_recs, sizeof(*rec_ptrs));
+	if (!threads || !rec_ptrs) {
+		pr_inf_skip("%s: cannot allocate replay threads, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+
+	/* partition the records by replay thread, keeping the trace order */
+	for (t = 0; t < n_threads; t++) {
+		for (i = 0; i < n_recs; i++) {
+			if (recs[i].thread % n_threads == t)
+				threads[t].n_recs++;
+		}
+	}
+	for (n = 0, t = 0; t < n_threads; t++) {
+		stress_replay_thread_t *thread = &threads[t];
+		size_t j;
+
+		thread->ctx = &ctx;
+		thread->index = t;
+		thread->recs = rec_ptrs + n;
+		n += thread->n_recs;
+		for (j = 0, i = 0; i < n_recs; i++) {
+			if (recs[i].thread % n_threads == t)
+				thread->recs[j++] = &recs[i];
+		}
+		for (j = 0; j < REPLAY_SLOTS; j++) {
+			thread->fds[j] = -1;
+			thread->socks[j] = -1;
+		}
+		thread->buf = (uint8_t *)malloc(REPLAY_BUF_SIZE);
+		thread->latency = (stress_latency_t *)calloc(REPLAY_OP_MAX, sizeof(*thread->latency));
+		if (!thread->buf || !thread->latency) {
+			pr_inf_skip("%s: cannot allocate replay thread buffers, skipping stressor\n",
+				args->name);
+			rc = EXIT_NO_RESOURCE;
+			goto tidy;
+		}
+		stress_rndbuf(thread->buf, REPLAY_BUF_SIZE);
+		for (j = 0; j < REPLAY_OP_MAX; j++)
+			stress_latency_reset(&thread->latency[j]);
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto tidy;
+	}
+
+	if (sockets) {
+		replay_port += args->instance;
+		reserved_port = stress_net_reserve_ports(replay_port, replay_port);
+		if (reserved_port < 0) {
+			pr_inf_skip("%s: cannot reserve port %d, skipping stressor\n",
+				args->name, replay_port);
+			rc = EXIT_NO_RESOURCE;
+			goto tidy_dir;
+		}
+		if (stress_replay_sink_start(args, &ctx, &sink_pthread, reserved_port) < 0) {
+			pr_inf_skip("%s: cannot start socket sink on port %d, errno=%d (%s), "
+				"skipping stressor\n", args->name, reserved_port,
+				errno, strerror(errno));
+			rc = EXIT_NO_RESOURCE;
+			goto tidy_port;
+		}
+		sink = true;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		uint64_t ops = 0;
+		double t_start;
+
+		for (t = 0; t < n_threads; t++)
+			ops -= threads[t].ops;
+		ctx.start_ns = stress_latency_now();
+		t_start = stress_time_now();
+		for (t = 0; t < n_threads; t++)
+			threads[t].ret = pthread_create(&threads[t].pthread, NULL,
+				stress_replay_thread, &threads[t]);
+		for (t = 0; t < n_threads; t++) {
+			if (threads[t].ret == 0)
+				(void)pthread_join(threads[t].pthread, NULL);
+			else
+				pr_dbg("%s: pthread_create failed, errno=%d (%s)\n",
+					args->name, threads[t].ret, strerror(threads[t].ret));
+		}
+		duration += stress_time_now() - t_start;
+		for (t = 0; t < n_threads; t++)
+			ops += threads[t].ops;
+		add_counter(args, ops);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_replay_report(args, &ctx, threads, n_threads, recs, n_recs, duration);
+
+	if (sink) {
+		ctx.sink_stop = true;
+		(void)pthread_join(sink_pthread, NULL);
+		(void)close(ctx.listen_fd);
+	}
+tidy_port:
+	if (reserved_port >= 0)
+		stress_net_release_ports(reserved_port, reserved_port);
+tidy_dir:
+	for (t = 0; t < n_threads; t++) {
+		size_t j;
+
+		for (j = 0; j < REPLAY_SLOTS; j++) {
+			char filename[PATH_MAX];
+
+			if (!threads[t].created[j])
+				continue;
+			(void)stress_temp_filename_args(args, filename, sizeof(filename),
+				((uint64_t)t << 16) | j);
+			(void)shim_unlink(filename);
+		}
+	}
+	(void)stress_temp_dir_rm_args(args);
+tidy:
+	if (threads) {
+		for (t = 0; t < n_threads; t++) {
+			free(threads[t].latency);
+			free(threads[t].buf);
+		}
+	}
+	free(threads);
+	free(rec_ptrs);
+	free(recs);
+
+	return rc;
+}
+
+stressor_info_t stress_replay_info = {
+	.stressor = stress_replay,
+	.class = CLASS_IO | CLASS_FILESYSTEM | CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_replay_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_IO | CLASS_FILESYSTEM | CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without pthread or poll.h support"
+};
+#endif
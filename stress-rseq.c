@@ -24,12 +24,27 @@
 #include <linux/rseq.h>
 #endif
 
+#if defined(HAVE_SYS_RSEQ_H)
+#include <sys/rseq.h>
+#endif
+
 static const stress_help_t help[] = {
 	{ NULL,	"rseq N",	"start N workers that exercise restartable sequences" },
 	{ NULL,	"rseq-ops N",	"stop after N bogo restartable sequence operations" },
+	{ NULL,	"rseq-percpu",	"benchmark rseq per-cpu counters and freelists" },
 	{ NULL,	NULL,		NULL }
 };
 
+static int stress_set_rseq_percpu(const char *opt)
+{
+	return stress_set_setting_true("rseq-percpu", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_rseq_percpu,	stress_set_rseq_percpu },
+	{ 0,			NULL },
+};
+
 #if defined(HAVE_LINUX_RSEQ_H) &&	\
     defined(HAVE_ASM_NOP) &&		\
     defined(__NR_rseq) &&		\
@@ -207,12 +222,439 @@ static void sigsegv_handler(int sig)
 	rseq_info->segv_count++;
 }
 
+#if defined(STRESS_ARCH_X86_64)
+#define HAVE_RSEQ_PERCPU
+
+#if !defined(RSEQ_SIG)
+#define RSEQ_SIG			(0x53053053)
+#endif
+
+#define STRESS_RSEQ_PERCPU_BATCH	(4096)
+#define STRESS_RSEQ_PERCPU_NODES	(16)
+
+/*
+ *  per-cpu data, each on its own cache line, only
+ *  ever modified inside a rseq critical section that
+ *  has checked it is running on the owning cpu
+ */
+typedef struct {
+	uint64_t count;			/* per-cpu counter */
+	uintptr_t head;			/* per-cpu freelist head */
+} ALIGN64 stress_rseq_percpu_t;
+
+typedef struct {
+	uintptr_t next;			/* must be first, popped via offset 0 */
+	uint64_t data;
+} stress_rseq_node_t;
+
+typedef struct {
+	uint64_t atomic_count ALIGN64;	/* shared atomic counter */
+	uint64_t rseq_incs ALIGN64;	/* successful per-cpu increments */
+	uint32_t n_cpus;		/* number of per-cpu slots */
+	size_t n_nodes;			/* total freelist nodes */
+	size_t size;			/* size of mapping */
+	stress_rseq_percpu_t *percpu;	/* per-cpu slots */
+	stress_rseq_node_t *nodes;	/* freelist nodes */
+} stress_rseq_shared_t;
+
+static stress_rseq_shared_t *rseq_shared;
+static volatile uint64_t rseq_local_count;
+
+/*
+ *  x86-64 rseq critical section scaffolding, the rseq_cs
+ *  descriptor and abort handler are emitted into their own
+ *  sections and the abort handler is preceded by the rseq
+ *  signature encoded as an ud1 instruction
+ */
+#define STRESS_RSEQ_ASM_TABLE(label, start_ip, post_commit_ip, abort_ip) \
+	".pushsection __rseq_cs, \"aw\"\n\t"				\
+	".balign 32\n\t"						\
+	#label ":\n\t"							\
+	".long 0x0, 0x0\n\t"						\
+	".quad " #start_ip ", (" #post_commit_ip " - " #start_ip "), "	\
+		#abort_ip "\n\t"					\
+	".popsection\n\t"
+
+#define STRESS_RSEQ_ASM_STORE_CS(label, cs_label)			\
+	"leaq " #cs_label "(%%rip), %%rax\n\t"				\
+	"movq %%rax, %[rseq_cs]\n\t"					\
+	#label ":\n\t"
+
+#define STRESS_RSEQ_ASM_CMP_CPU_ID(label)				\
+	"cmpl %[cpu_id], %[current_cpu_id]\n\t"				\
+	"jnz " #label "\n\t"
+
+#define STRESS_RSEQ_ASM_ABORT(label, abort_label)			\
+	".pushsection __rseq_failure, \"ax\"\n\t"			\
+	".byte 0x0f, 0xb9, 0x3d\n\t"					\
+	".long 0x53053053\n\t"						\
+	#label ":\n\t"							\
+	"jmp %l[" #abort_label "]\n\t"					\
+	".popsection\n\t"
+
+/*
+ *  stress_rseq_addv()
+ *	*v += count on the given cpu, returns 0 on success,
+ *	-1 if aborted or not running on the given cpu
+ */
+static inline int stress_rseq_addv(
+	struct rseq *rs,
+	uint64_t *v,
+	const uint64_t count,
+	const uint32_t cpu)
+{
+	__asm__ __volatile__ goto(
+		STRESS_RSEQ_ASM_TABLE(3, 1f, 2f, 4f)
+		STRESS_RSEQ_ASM_STORE_CS(1, 3b)
+		STRESS_RSEQ_ASM_CMP_CPU_ID(4f)
+		/* final store commits */
+		"addq %[count], %[v]\n\t"
+		"2:\n\t"
+		STRESS_RSEQ_ASM_ABORT(4, abort)
+		:
+		: [cpu_id] "r" (cpu),
+		  [current_cpu_id] "m" (rs->cpu_id),
+		  [rseq_cs] "m" (rs->rseq_cs),
+		  [v] "m" (*v),
+		  [count] "er" (count)
+		: "memory", "cc", "rax"
+		: abort);
+	return 0;
+abort:
+	return -1;
+}
+
+/*
+ *  stress_rseq_cmpeqv_storev()
+ *	if *v == expect then *v = newv on the given cpu, returns
+ *	0 on success, 1 on compare failure, -1 if aborted
+ */
+static inline int stress_rseq_cmpeqv_storev(
+	struct rseq *rs,
+	uintptr_t *v,
+	const uintptr_t expect,
+	const uintptr_t newv,
+	const uint32_t cpu)
+{
+	__asm__ __volatile__ goto(
+		STRESS_RSEQ_ASM_TABLE(3, 1f, 2f, 4f)
+		STRESS_RSEQ_ASM_STORE_CS(1, 3b)
+		STRESS_RSEQ_ASM_CMP_CPU_ID(4f)
+		"cmpq %[v], %[expect]\n\t"
+		"jnz %l[cmpfail]\n\t"
+		/* final store commits */
+		"movq %[newv], %[v]\n\t"
+		"2:\n\t"
+		STRESS_RSEQ_ASM_ABORT(4, abort)
+		:
+		: [cpu_id] "r" (cpu),
+		  [current_cpu_id] "m" (rs->cpu_id),
+		  [rseq_cs] "m" (rs->rseq_cs),
+		  [v] "m" (*v),
+		  [expect] "r" (expect),
+		  [newv] "r" (newv)
+		: "memory", "cc", "rax"
+		: abort, cmpfail);
+	return 0;
+abort:
+	return -1;
+cmpfail:
+	return 1;
+}
+
+/*
+ *  stress_rseq_list_pop()
+ *	pop the head of a per-cpu freelist on the given cpu
+ *	into *node, returns 0 on success, 1 if the list is empty
+ *	and -1 if aborted
+ */
+static inline int stress_rseq_list_pop(
+	struct rseq *rs,
+	uintptr_t *head,
+	uintptr_t *node,
+	const uint32_t cpu)
+{
+	__asm__ __volatile__ goto(
+		STRESS_RSEQ_ASM_TABLE(3, 1f, 2f, 4f)
+		STRESS_RSEQ_ASM_STORE_CS(1, 3b)
+		STRESS_RSEQ_ASM_CMP_CPU_ID(4f)
+		"movq %[head], %%rbx\n\t"
+		"testq %%rbx, %%rbx\n\t"
+		"jz %l[empty]\n\t"
+		"movq %%rbx, %[node]\n\t"
+		"movq (%%rbx), %%rbx\n\t"
+		/* final store commits */
+		"movq %%rbx, %[head]\n\t"
+		"2:\n\t"
+		STRESS_RSEQ_ASM_ABORT(4, abort)
+		:
+		: [cpu_id] "r" (cpu),
+		  [current_cpu_id] "m" (rs->cpu_id),
+		  [rseq_cs] "m" (rs->rseq_cs),
+		  [head] "m" (*head),
+		  [node] "m" (*node)
+		: "memory", "cc", "rax", "rbx"
+		: abort, empty);
+	return 0;
+abort:
+	return -1;
+empty:
+	return 1;
+}
+
+/*
+ *  stress_rseq_percpu_area()
+ *	find the rseq area for this thread, use the one glibc
+ *	registered if there is one, otherwise register our own
+ */
+static struct rseq *stress_rseq_percpu_area(void)
+{
+#if defined(HAVE_SYS_RSEQ_H) &&		\
+    NEED_GNUC(11, 0, 0)
+	if (__rseq_size > 0)
+		return (struct rseq *)((uintptr_t)__builtin_thread_pointer() + (uintptr_t)__rseq_offset);
+#endif
+	set_rseq_zero();
+	if (shim_rseq(&restartable_seq, sizeof(restartable_seq), 0, RSEQ_SIG) == 0)
+		return &restartable_seq;
+	return NULL;
+}
+
+/*
+ *  stress_rseq_percpu_release()
+ *	unregister our own rseq area, leave a glibc one alone
+ */
+static void stress_rseq_percpu_release(struct rseq *rs)
+{
+	if (rs == &restartable_seq)
+		(void)rseq_unregister(&restartable_seq, RSEQ_SIG);
+}
+
+static void stress_rseq_init(void)
+{
+	bool rseq_percpu = false;
+	uint32_t n_cpus;
+	size_t i, n_nodes;
+	size_t size;
+	uint8_t *ptr;
+
+	(void)stress_get_setting("rseq-percpu", &rseq_percpu);
+	if (!rseq_percpu)
+		return;
+
+	n_cpus = (uint32_t)stress_get_processors_configured();
+	if (n_cpus < 1)
+		n_cpus = 1;
+	n_nodes = (size_t)n_cpus * STRESS_RSEQ_PERCPU_NODES;
+	size = sizeof(*rseq_shared) +
+	       ((size_t)n_cpus * sizeof(stress_rseq_percpu_t)) +
+	       (n_nodes * sizeof(stress_rseq_node_t));
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (ptr == MAP_FAILED) {
+		rseq_shared = NULL;
+		return;
+	}
+	rseq_shared = (stress_rseq_shared_t *)ptr;
+	rseq_shared->n_cpus = n_cpus;
+	rseq_shared->n_nodes = n_nodes;
+	rseq_shared->size = size;
+	rseq_shared->percpu = (stress_rseq_percpu_t *)(ptr + sizeof(*rseq_shared));
+	rseq_shared->nodes = (stress_rseq_node_t *)(rseq_shared->percpu + n_cpus);
+
+	/* Spread the nodes evenly over the per-cpu freelists */
+	for (i = 0; i < n_nodes; i++) {
+		stress_rseq_percpu_t *percpu = &rseq_shared->percpu[i % n_cpus];
+		stress_rseq_node_t *node = &rseq_shared->nodes[i];
+
+		node->next = percpu->head;
+		percpu->head = (uintptr_t)node;
+	}
+}
+
+static void stress_rseq_deinit(void)
+{
+	if (!rseq_shared)
+		return;
+
+	if (g_opt_flags & OPT_FLAGS_VERIFY) {
+		uint64_t sum = 0;
+		size_t nodes = 0;
+		uint32_t i;
+
+		for (i = 0; i < rseq_shared->n_cpus; i++) {
+			uintptr_t ptr;
+
+			sum += rseq_shared->percpu[i].count;
+			for (ptr = rseq_shared->percpu[i].head;
+			     ptr && (nodes <= rseq_shared->n_nodes);
+			     ptr = ((stress_rseq_node_t *)ptr)->next)
+				nodes++;
+		}
+		if (sum != rseq_shared->rseq_incs)
+			pr_fail("rseq: per-cpu counters sum to %" PRIu64
+				", expected %" PRIu64 "\n",
+				sum, rseq_shared->rseq_incs);
+		if (nodes != rseq_shared->n_nodes)
+			pr_fail("rseq: per-cpu freelists hold %zu nodes, expected %zu\n",
+				nodes, rseq_shared->n_nodes);
+	}
+	(void)munmap((void *)rseq_shared, rseq_shared->size);
+	rseq_shared = NULL;
+}
+
+/*
+ *  stress_rseq_percpu_oomable()
+ *	compare per-cpu counter increments and freelist pop/push
+ *	using rseq critical sections against atomic increments
+ *	on a shared counter and plain process local increments
+ */
+static int stress_rseq_percpu_oomable(const stress_args_t *args, void *context)
+{
+	stress_rseq_percpu_t *percpu = rseq_shared->percpu;
+	const uint32_t n_cpus = rseq_shared->n_cpus;
+	struct rseq *rs;
+	double rseq_dur = 0.0, atomic_dur = 0.0, local_dur = 0.0, list_dur = 0.0;
+	uint64_t rounds = 0, aborts = 0, list_ops = 0, incs = 0;
+	double rate, ops;
+	int rc = EXIT_SUCCESS;
+
+	(void)context;
+
+	rs = stress_rseq_percpu_area();
+	if (!rs) {
+		pr_inf_skip("%s: cannot find or register a rseq area, "
+			"errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+
+	do {
+		register int i;
+		double t;
+
+		t = stress_time_now();
+		for (i = 0; i < STRESS_RSEQ_PERCPU_BATCH; i++) {
+			for (;;) {
+				const uint32_t cpu = STRESS_ACCESS_ONCE(rs->cpu_id_start);
+
+				if (UNLIKELY(cpu >= n_cpus))
+					goto bad_cpu;
+				if (LIKELY(stress_rseq_addv(rs, &percpu[cpu].count, 1, cpu) == 0))
+					break;
+				aborts++;
+			}
+			incs++;
+		}
+		rseq_dur += stress_time_now() - t;
+
+		t = stress_time_now();
+		for (i = 0; i < STRESS_RSEQ_PERCPU_BATCH; i++)
+			(void)__atomic_fetch_add(&rseq_shared->atomic_count, 1, __ATOMIC_SEQ_CST);
+		atomic_dur += stress_time_now() - t;
+
+		t = stress_time_now();
+		for (i = 0; i < STRESS_RSEQ_PERCPU_BATCH; i++)
+			rseq_local_count++;
+		local_dur += stress_time_now() - t;
+
+		t = stress_time_now();
+		for (i = 0; i < STRESS_RSEQ_PERCPU_BATCH; i++) {
+			uintptr_t node = 0;
+			int ret;
+
+			for (;;) {
+				const uint32_t cpu = STRESS_ACCESS_ONCE(rs->cpu_id_start);
+
+				if (UNLIKELY(cpu >= n_cpus))
+					goto bad_cpu;
+				ret = stress_rseq_list_pop(rs, &percpu[cpu].head, &node, cpu);
+				if (LIKELY(ret >= 0))
+					break;
+				aborts++;
+			}
+			/* per-cpu list is empty, all its nodes migrated away */
+			if (ret > 0)
+				continue;
+
+			((stress_rseq_node_t *)node)->data++;
+			for (;;) {
+				const uint32_t cpu = STRESS_ACCESS_ONCE(rs->cpu_id_start);
+				uintptr_t head;
+
+				if (UNLIKELY(cpu >= n_cpus))
+					goto bad_cpu;
+				head = STRESS_ACCESS_ONCE(percpu[cpu].head);
+				((stress_rseq_node_t *)node)->next = head;
+				ret = stress_rseq_cmpeqv_storev(rs, &percpu[cpu].head, head, node, cpu);
+				if (LIKELY(ret == 0))
+					break;
+				if (ret < 0)
+					aborts++;
+			}
+			list_ops++;
+		}
+		list_dur += stress_time_now() - t;
+
+		rounds++;
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	ops = (double)rounds * STRESS_RSEQ_PERCPU_BATCH;
+	rate = (rseq_dur > 0.0) ? ops / rseq_dur : 0.0;
+	stress_metrics_set(args, 0, "rseq per-cpu counter increments per sec", rate);
+	rate = (atomic_dur > 0.0) ? ops / atomic_dur : 0.0;
+	stress_metrics_set(args, 1, "atomic shared counter increments per sec", rate);
+	rate = (local_dur > 0.0) ? ops / local_dur : 0.0;
+	stress_metrics_set(args, 2, "process local counter increments per sec", rate);
+	rate = (list_dur > 0.0) ? (double)list_ops / list_dur : 0.0;
+	stress_metrics_set(args, 3, "rseq per-cpu freelist pop+push per sec", rate);
+	ops += (double)list_ops * 2.0;
+	rate = (ops > 0.0) ? ((double)aborts * 1000000.0) / ops : 0.0;
+	stress_metrics_set(args, 4, "rseq aborts per million critical sections", rate);
+
+done:
+	(void)__atomic_fetch_add(&rseq_shared->rseq_incs, incs, __ATOMIC_RELAXED);
+	stress_rseq_percpu_release(rs);
+	return rc;
+
+bad_cpu:
+	pr_inf_skip("%s: rseq cpu id out of range of %" PRIu32
+		" configured cpus, skipping stressor\n", args->name, n_cpus);
+	rc = EXIT_NO_RESOURCE;
+	goto done;
+}
+#endif
+
 /*
  *  Sanity check of the rseq system call is available
  */
 static int stress_rseq_supported(const char *name)
 {
 	uint32_t signature;
+	bool rseq_percpu = false;
+
+	(void)stress_get_setting("rseq-percpu", &rseq_percpu);
+	if (rseq_percpu) {
+#if defined(HAVE_RSEQ_PERCPU)
+		struct rseq *rs;
+
+		rs = stress_rseq_percpu_area();
+		if (!rs) {
+			pr_inf_skip("%s stressor will be skipped, cannot find or register "
+				"a rseq area, errno=%d (%s)\n",
+				name, errno, strerror(errno));
+			return -1;
+		}
+		stress_rseq_percpu_release(rs);
+		return 0;
+#else
+		pr_inf_skip("%s stressor will be skipped, --rseq-percpu is not "
+			"implemented for this architecture\n", name);
+		return -1;
+#endif
+	}
 
 	rseq_test(-1, &signature);
 	if (rseq_register(&restartable_seq, signature) < 0) {
@@ -323,6 +765,9 @@ unreg:
 static int stress_rseq(const stress_args_t *args)
 {
 	int ret;
+#if defined(HAVE_RSEQ_PERCPU)
+	bool rseq_percpu = false;
+#endif
 
 	/*
 	 *  rseq_info is in a shared page to avoid losing the
@@ -343,6 +788,21 @@ static int stress_rseq(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
+#if defined(HAVE_RSEQ_PERCPU)
+	(void)stress_get_setting("rseq-percpu", &rseq_percpu);
+	if (rseq_percpu) {
+		if (!rseq_shared) {
+			pr_inf_skip("%s: cannot allocate per-cpu data, skipping stressor\n",
+				args->name);
+			(void)munmap(rseq_info, args->page_size);
+			return EXIT_NO_RESOURCE;
+		}
+		ret = stress_oomable_child(args, NULL, stress_rseq_percpu_oomable, STRESS_OOMABLE_QUIET);
+		stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+		(void)munmap(rseq_info, args->page_size);
+		return ret;
+	}
+#endif
 	ret = stress_oomable_child(args, NULL, stress_rseq_oomable, STRESS_OOMABLE_QUIET);
 	pr_inf("%s: %" PRIu64 " critical section interruptions, %" PRIu64
 	       " flag mismatches of %" PRIu64 " restartable sequences\n",
@@ -359,13 +819,19 @@ static int stress_rseq(const stress_args_t *args)
 stressor_info_t stress_rseq_info = {
 	.stressor = stress_rseq,
 	.supported = stress_rseq_supported,
+#if defined(HAVE_RSEQ_PERCPU)
+	.init = stress_rseq_init,
+	.deinit = stress_rseq_deinit,
+#endif
 	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_rseq_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without Linux restartable sequences support"
 };
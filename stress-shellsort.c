@@ -29,6 +29,7 @@ static sigjmp_buf jmp_env;
 
 static const stress_help_t help[] = {
 	{ NULL,	"shellsort N",	   "start N workers shell sorting 32 bit random integers" },
+	{ NULL,	"shellsort-dists",  "shell sort int32, uint64, record and string keys in 7 input distributions" },
 	{ NULL,	"shellsort-ops N",  "stop after N shell sort bogo operations" },
 	{ NULL,	"shellsort-size N", "number of 32 bit integers to sort" },
 	{ NULL,	NULL,		   NULL }
@@ -48,7 +49,13 @@ static int stress_set_shellsort_size(const char *opt)
 	return stress_set_setting("shellsort-size", TYPE_ID_UINT64, &shellsort_size);
 }
 
+static int stress_set_shellsort_dists(const char *opt)
+{
+	return stress_set_setting_true("shellsort-dists", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_shellsort_dists,		stress_set_shellsort_dists },
 	{ OPT_shellsort_size,		stress_set_shellsort_size },
 	{ 0,				NULL }
 };
@@ -89,6 +96,57 @@ static int shellsort32(void *base, size_t nmemb,
 	return 0;
 }
 
+static int shellsort64(void *base, size_t nmemb,
+	int (*compar)(const void *, const void *))
+{
+	register size_t gap;
+	uint64_t *array = (uint64_t *)base;
+
+	for (gap = nmemb >> 1; gap > 0; gap >>= 1) {
+		register size_t i;
+
+		for (i = gap; i < nmemb; i++) {
+			register size_t j;
+			const uint64_t temp = array[i];
+
+			for (j = i; j >= gap && compar(&array[j - gap], &temp) > 0; j -= gap) {
+				array[j] = array[j - gap];
+			}
+			array[j] = temp;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  shellsort_any()
+ *	shell sort elements of any size up to 64 bytes
+ */
+static int shellsort_any(void *base, size_t nmemb, size_t size,
+	int (*compar)(const void *, const void *))
+{
+	register size_t gap;
+	uint8_t *array = (uint8_t *)base;
+	uint8_t temp[64];
+
+	if (size > sizeof(temp))
+		return -1;
+	for (gap = nmemb >> 1; gap > 0; gap >>= 1) {
+		register size_t i;
+
+		for (i = gap; i < nmemb; i++) {
+			register size_t j;
+
+			(void)memcpy(temp, &array[i * size], size);
+			for (j = i; j >= gap && compar(&array[(j - gap) * size], temp) > 0; j -= gap) {
+				(void)memcpy(&array[j * size], &array[(j - gap) * size], size);
+			}
+			(void)memcpy(&array[j * size], temp, size);
+		}
+	}
+	return 0;
+}
+
 static int shellsort8(void *base, size_t nmemb,
 	int (*compar)(const void *, const void *))
 {
@@ -116,9 +174,18 @@ static int shellsort(void *base, size_t nmemb, size_t size,
 {
 	if (size == sizeof(uint32_t))
 		return shellsort32(base, nmemb, compar);
+	else if (size == sizeof(uint64_t))
+		return shellsort64(base, nmemb, compar);
 	else if (size == sizeof(uint8_t))
 		return shellsort8(base, nmemb, compar);
-	else return -1;
+	else
+		return shellsort_any(base, nmemb, size, compar);
+}
+
+static void stress_shellsort_func(void *base, size_t nmemb, size_t size,
+	int (*cmp)(const void *p1, const void *p2))
+{
+	(void)shellsort(base, nmemb, size, cmp);
 }
 
 /*
@@ -134,7 +201,9 @@ static int stress_shellsort(const stress_args_t *args)
 	int ret;
 	double rate;
 	NOCLOBBER double duration = 0.0, count = 0.0, sorted = 0.0;
+	bool shellsort_dists = false;
 
+	(void)stress_get_setting("shellsort-dists", &shellsort_dists);
 	if (!stress_get_setting("shellsort-size", &shellsort_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
 			shellsort_size = MAX_SHELLSORT_SIZE;
@@ -143,6 +212,9 @@ static int stress_shellsort(const stress_args_t *args)
 	}
 	n = (size_t)shellsort_size;
 
+	if (shellsort_dists)
+		return stress_sort_dists(args, "shellsort", stress_shellsort_func, n);
+
 	if ((data = calloc(n, sizeof(*data))) == NULL) {
 		pr_inf_skip("%s: malloc failed to allocate %zu integers, "
 			"skipping stressor\n", args->name, n);
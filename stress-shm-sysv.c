@@ -20,6 +20,7 @@
 #include "stress-ng.h"
 #include "core-arch.h"
 #include "core-capabilities.h"
+#include "core-shm-scale.h"
 
 #if defined(HAVE_LINUX_MEMPOLICY_H)
 #include <linux/mempolicy.h>
@@ -61,6 +62,8 @@ static const stress_help_t help[] = {
 	{ NULL,	"shm-sysv N",		"start N workers that exercise System V shared memory" },
 	{ NULL,	"shm-sysv-bytes N",	"allocate and free N bytes of shared memory per loop" },
 	{ NULL,	"shm-sysv-ops N",	"stop after N shared memory bogo operations" },
+	{ NULL,	"shm-sysv-scale",	"measure attach, fault and page table scaling over processes" },
+	{ NULL,	"shm-sysv-scale-procs N", "scale up to N processes attaching a segment" },
 	{ NULL,	"shm-sysv-segs N",	"allocate N shared memory segments per iteration" },
 	{ NULL,	NULL,			NULL }
 };
@@ -142,9 +145,26 @@ static int stress_set_shm_sysv_segments(const char *opt)
 	return stress_set_setting("shm-sysv-segs", TYPE_ID_SIZE_T, &shm_sysv_segments);
 }
 
+static int stress_set_shm_sysv_scale(const char *opt)
+{
+	return stress_set_setting_true("shm-sysv-scale", opt);
+}
+
+static int stress_set_shm_sysv_scale_procs(const char *opt)
+{
+	uint32_t shm_sysv_scale_procs;
+
+	shm_sysv_scale_procs = stress_get_uint32(opt);
+	stress_check_range("shm-sysv-scale-procs", (uint64_t)shm_sysv_scale_procs,
+		MIN_SHM_SCALE_PROCS, MAX_SHM_SCALE_PROCS);
+	return stress_set_setting("shm-sysv-scale-procs", TYPE_ID_UINT32, &shm_sysv_scale_procs);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_shm_sysv_bytes,		stress_set_shm_sysv_bytes },
 	{ OPT_shm_sysv_segments,	stress_set_shm_sysv_segments },
+	{ OPT_shm_sysv_scale,		stress_set_shm_sysv_scale },
+	{ OPT_shm_sysv_scale_procs,	stress_set_shm_sysv_scale_procs },
 	{ 0,				NULL }
 };
 
@@ -937,6 +957,72 @@ reap:
 }
 
 
+static int stress_shm_sysv_scale_create(const size_t sz)
+{
+	return shmget(IPC_PRIVATE, sz, IPC_CREAT | SHM_R | SHM_W);
+}
+
+#if defined(SHM_HUGETLB)
+static int stress_shm_sysv_scale_create_hugetlb(const size_t sz)
+{
+	return shmget(IPC_PRIVATE, sz, IPC_CREAT | SHM_R | SHM_W | SHM_HUGETLB);
+}
+#endif
+
+static void *stress_shm_sysv_scale_attach(const int shm_id, const size_t sz)
+{
+	void *addr;
+
+	(void)sz;
+	addr = shmat(shm_id, NULL, 0);
+	return (addr == (void *)-1) ? NULL : addr;
+}
+
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+/*
+ *  stress_shm_sysv_scale_attach_thp()
+ *	attach with transparent huge pages, shmem THP depends
+ *	on /sys/kernel/mm/transparent_hugepage/shmem_enabled
+ */
+static void *stress_shm_sysv_scale_attach_thp(const int shm_id, const size_t sz)
+{
+	void *addr;
+
+	addr = stress_shm_sysv_scale_attach(shm_id, sz);
+	if (addr)
+		(void)madvise(addr, sz, MADV_HUGEPAGE);
+	return addr;
+}
+#endif
+
+static void stress_shm_sysv_scale_detach(const int shm_id, void *addr, const size_t sz)
+{
+	(void)shm_id;
+	(void)sz;
+	(void)shmdt(addr);
+}
+
+static void stress_shm_sysv_scale_destroy(const int shm_id, const size_t sz)
+{
+	(void)sz;
+	(void)shmctl(shm_id, IPC_RMID, NULL);
+}
+
+static const stress_shm_scale_backing_t shm_sysv_scale_backings[] = {
+	{ "4K",	stress_shm_sysv_scale_create, stress_shm_sysv_scale_attach,
+		stress_shm_sysv_scale_detach, stress_shm_sysv_scale_destroy },
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+	{ "THP", stress_shm_sysv_scale_create, stress_shm_sysv_scale_attach_thp,
+		stress_shm_sysv_scale_detach, stress_shm_sysv_scale_destroy },
+#endif
+#if defined(SHM_HUGETLB)
+	{ "hugetlb", stress_shm_sysv_scale_create_hugetlb, stress_shm_sysv_scale_attach,
+		stress_shm_sysv_scale_detach, stress_shm_sysv_scale_destroy },
+#endif
+};
+
 /*
  *  stress_shm_sysv()
  *	stress SYSTEM V shared memory
@@ -953,6 +1039,8 @@ static int stress_shm_sysv(const stress_args_t *args)
 	uint32_t restarts = 0;
 	size_t shm_sysv_bytes = DEFAULT_SHM_SYSV_BYTES;
 	size_t shm_sysv_segments = DEFAULT_SHM_SYSV_SEGMENTS;
+	uint32_t shm_sysv_scale_procs = DEFAULT_SHM_SCALE_PROCS;
+	bool shm_sysv_scale = false;
 
 	if (!stress_get_setting("shm-sysv-bytes", &shm_sysv_bytes)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -975,6 +1063,15 @@ static int stress_shm_sysv(const stress_args_t *args)
 
 	orig_sz = sz = shm_sysv_bytes & ~(page_size - 1);
 
+	(void)stress_get_setting("shm-sysv-scale", &shm_sysv_scale);
+	if (shm_sysv_scale) {
+		(void)stress_get_setting("shm-sysv-scale-procs", &shm_sysv_scale_procs);
+		/* whole 2MB huge pages so every backing maps the same size */
+		sz = (sz + (2 * MB) - 1) & ~((2 * MB) - 1);
+		return stress_shm_scale(args, shm_sysv_scale_backings,
+			SIZEOF_ARRAY(shm_sysv_scale_backings), sz, shm_sysv_scale_procs);
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	while (keep_stressing_flag() && retry) {
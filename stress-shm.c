@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-shm-scale.h"
 
 #define MIN_SHM_POSIX_BYTES	(1 * MB)
 #define MAX_SHM_POSIX_BYTES	(1 * GB)
@@ -38,6 +39,8 @@ static const stress_help_t help[] = {
 	{ NULL,	"shm N",	"start N workers that exercise POSIX shared memory" },
 	{ NULL,	"shm-bytes N",	"allocate/free N bytes of POSIX shared memory" },
 	{ NULL,	"shm-ops N",	"stop after N POSIX shared memory bogo operations" },
+	{ NULL,	"shm-scale",	"measure attach, fault and page table scaling over processes" },
+	{ NULL,	"shm-scale-procs N", "scale up to N processes attaching a segment" },
 	{ NULL,	"shm-segs N",	"allocate N POSIX shared memory segments per iteration" },
 	{ NULL,	NULL,		NULL }
 };
@@ -62,9 +65,26 @@ static int stress_set_shm_posix_objects(const char *opt)
 	return stress_set_setting("shm-objs", TYPE_ID_SIZE_T, &shm_posix_objects);
 }
 
+static int stress_set_shm_scale(const char *opt)
+{
+	return stress_set_setting_true("shm-scale", opt);
+}
+
+static int stress_set_shm_scale_procs(const char *opt)
+{
+	uint32_t shm_scale_procs;
+
+	shm_scale_procs = stress_get_uint32(opt);
+	stress_check_range("shm-scale-procs", (uint64_t)shm_scale_procs,
+		MIN_SHM_SCALE_PROCS, MAX_SHM_SCALE_PROCS);
+	return stress_set_setting("shm-scale-procs", TYPE_ID_UINT32, &shm_scale_procs);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_shm_bytes,	stress_set_shm_posix_bytes },
 	{ OPT_shm_objects,	stress_set_shm_posix_objects },
+	{ OPT_shm_scale,	stress_set_shm_scale },
+	{ OPT_shm_scale_procs,	stress_set_shm_scale_procs },
 	{ 0,			NULL }
 };
 
@@ -335,6 +355,108 @@ reap:
 	return rc;
 }
 
+/*
+ *  stress_shm_scale_create()
+ *	create an unlinked POSIX shared memory object, the fd
+ *	is inherited by the attaching processes
+ */
+static int stress_shm_scale_create(const size_t sz)
+{
+	static uint32_t counter;
+	char name[SHM_NAME_LEN];
+	int fd;
+
+	(void)snprintf(name, sizeof(name), "/stress-ng-scale-%" PRIdMAX "-%" PRIu32,
+		(intmax_t)getpid(), counter++);
+	fd = shm_open(name, O_CREAT | O_RDWR | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return -1;
+	(void)shm_unlink(name);
+	if (ftruncate(fd, (off_t)sz) < 0) {
+		const int saved_errno = errno;
+
+		(void)close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+	return fd;
+}
+
+static void *stress_shm_scale_attach(const int fd, const size_t sz)
+{
+	void *addr;
+
+	addr = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	return (addr == MAP_FAILED) ? NULL : addr;
+}
+
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+/*
+ *  stress_shm_scale_attach_thp()
+ *	map the object with transparent huge pages, shmem THP
+ *	depends on /sys/kernel/mm/transparent_hugepage/shmem_enabled
+ */
+static void *stress_shm_scale_attach_thp(const int fd, const size_t sz)
+{
+	void *addr;
+
+	addr = stress_shm_scale_attach(fd, sz);
+	if (addr)
+		(void)madvise(addr, sz, MADV_HUGEPAGE);
+	return addr;
+}
+#endif
+
+#if defined(MFD_HUGETLB)
+/*
+ *  stress_shm_scale_create_hugetlb()
+ *	shm_open cannot use hugetlbfs, use a hugetlb memfd instead
+ */
+static int stress_shm_scale_create_hugetlb(const size_t sz)
+{
+	int fd;
+
+	fd = shim_memfd_create("stress-ng-scale", MFD_HUGETLB);
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, (off_t)sz) < 0) {
+		const int saved_errno = errno;
+
+		(void)close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+	return fd;
+}
+#endif
+
+static void stress_shm_scale_detach(const int fd, void *addr, const size_t sz)
+{
+	(void)fd;
+	(void)munmap(addr, sz);
+}
+
+static void stress_shm_scale_destroy(const int fd, const size_t sz)
+{
+	(void)sz;
+	(void)close(fd);
+}
+
+static const stress_shm_scale_backing_t shm_scale_backings[] = {
+	{ "4K",	stress_shm_scale_create, stress_shm_scale_attach,
+		stress_shm_scale_detach, stress_shm_scale_destroy },
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+	{ "THP", stress_shm_scale_create, stress_shm_scale_attach_thp,
+		stress_shm_scale_detach, stress_shm_scale_destroy },
+#endif
+#if defined(MFD_HUGETLB)
+	{ "hugetlb", stress_shm_scale_create_hugetlb, stress_shm_scale_attach,
+		stress_shm_scale_detach, stress_shm_scale_destroy },
+#endif
+};
+
 /*
  *  stress_shm()
  *	stress POSIX shared memory
@@ -351,6 +473,8 @@ static int stress_shm(const stress_args_t *args)
 	uint32_t restarts = 0;
 	size_t shm_posix_bytes = DEFAULT_SHM_POSIX_BYTES;
 	size_t shm_posix_objects = DEFAULT_SHM_POSIX_OBJECTS;
+	uint32_t shm_scale_procs = DEFAULT_SHM_SCALE_PROCS;
+	bool shm_scale = false;
 
 	if (!stress_get_setting("shm-bytes", &shm_posix_bytes)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -383,6 +507,15 @@ static int stress_shm(const stress_args_t *args)
 		return EXIT_NO_RESOURCE;
 	}
 #endif
+	(void)stress_get_setting("shm-scale", &shm_scale);
+	if (shm_scale) {
+		(void)stress_get_setting("shm-scale-procs", &shm_scale_procs);
+		/* whole 2MB huge pages so every backing maps the same size */
+		sz = (sz + (2 * MB) - 1) & ~((2 * MB) - 1);
+		return stress_shm_scale(args, shm_scale_backings,
+			SIZEOF_ARRAY(shm_scale_backings), sz, shm_scale_procs);
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	while (keep_stressing_flag() && retry) {
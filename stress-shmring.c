@@ -0,0 +1,641 @@
+/*
+ * Copyright (C) 2023 Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+
+#define SHMRING_MODE_SPSC	(0)	/* single producer, single consumer */
+#define SHMRING_MODE_MPMC	(1)	/* multiple producers and consumers */
+#define SHMRING_MODE_PIPE	(2)	/* kernel pipe baseline */
+
+#define MIN_SHMRING_PROCS	(1)
+#define MAX_SHMRING_PROCS	(64)
+#define DEFAULT_SHMRING_PROCS	(2)
+
+#define MIN_SHMRING_SLOTS	(2)
+#define MAX_SHMRING_SLOTS	(1024 * 1024)
+#define DEFAULT_SHMRING_SLOTS	(1024)
+
+#define SHMRING_SPINS		(128)	/* retries before sleeping on a futex */
+#define SHMRING_WAIT_NS		(100000000)	/* futex wait timeout */
+
+typedef struct {
+	const char *name;
+	const int mode;
+} stress_shmring_mode_t;
+
+/*
+ *  one cache line sized message, turn is only used by the
+ *  MPMC ring to hand the slot between producers and consumers
+ */
+typedef struct {
+	uint64_t turn;		/* MPMC slot sequence */
+	uint64_t seq;		/* per producer message sequence number */
+	uint64_t t_send;	/* stress_latency_now() when sent */
+	uint32_t producer;	/* producer index */
+	uint32_t check;		/* seq ^ producer check value */
+	uint8_t pad[32];
+} ALIGN64 stress_shmring_msg_t;
+
+/*
+ *  per process results, written only by the owning process
+ */
+typedef struct {
+	uint64_t msgs;		/* messages sent or received */
+	uint64_t sleeps;	/* futex waits */
+	uint64_t errors;	/* out of sequence or corrupt messages */
+	stress_latency_t latency; /* consumer one-way latencies */
+} ALIGN64 stress_shmring_proc_t;
+
+/*
+ *  shared ring control, the indexes and futex words are on
+ *  separate cache lines to avoid false sharing
+ */
+typedef struct {
+	uint64_t head ALIGN64;		/* producer index or MPMC enqueue position */
+	uint64_t tail ALIGN64;		/* consumer index or MPMC dequeue position */
+	uint32_t not_empty ALIGN64;	/* futex, bumped when data is added */
+	uint32_t empty_waiters;		/* consumers waiting on not_empty */
+	uint32_t not_full ALIGN64;	/* futex, bumped when space is freed */
+	uint32_t full_waiters;		/* producers waiting on not_full */
+	volatile bool stop ALIGN64;	/* set by the parent to end the run */
+} stress_shmring_ctl_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"shmring N",		"start N workers passing messages over lock-free shared memory rings" },
+	{ NULL,	"shmring-mode M",	"ring mode [spsc|mpmc|pipe]" },
+	{ NULL,	"shmring-ops N",	"stop after N messages are received" },
+	{ NULL,	"shmring-procs N",	"number of producers and of consumers in mpmc mode" },
+	{ NULL,	"shmring-slots N",	"number of ring slots, power of 2" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const stress_shmring_mode_t shmring_modes[] = {
+	{ "spsc",	SHMRING_MODE_SPSC },
+	{ "mpmc",	SHMRING_MODE_MPMC },
+	{ "pipe",	SHMRING_MODE_PIPE },
+};
+
+/*
+ *  stress_set_shmring_mode()
+ *	set the ring mode
+ */
+static int stress_set_shmring_mode(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(shmring_modes); i++) {
+		if (!strcmp(opt, shmring_modes[i].name))
+			return stress_set_setting("shmring-mode", TYPE_ID_INT, &shmring_modes[i].mode);
+	}
+	(void)fprintf(stderr, "shmring-mode must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(shmring_modes); i++)
+		(void)fprintf(stderr, " %s", shmring_modes[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_shmring_procs(const char *opt)
+{
+	int shmring_procs;
+
+	shmring_procs = (int)stress_get_uint32(opt);
+	stress_check_range("shmring-procs", (uint64_t)shmring_procs,
+		MIN_SHMRING_PROCS, MAX_SHMRING_PROCS);
+	return stress_set_setting("shmring-procs", TYPE_ID_INT, &shmring_procs);
+}
+
+static int stress_set_shmring_slots(const char *opt)
+{
+	uint64_t shmring_slots;
+
+	shmring_slots = stress_get_uint64(opt);
+	stress_check_power_of_2("shmring-slots", shmring_slots,
+		MIN_SHMRING_SLOTS, MAX_SHMRING_SLOTS);
+	return stress_set_setting("shmring-slots", TYPE_ID_UINT64, &shmring_slots);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_shmring_mode,	stress_set_shmring_mode },
+	{ OPT_shmring_procs,	stress_set_shmring_procs },
+	{ OPT_shmring_slots,	stress_set_shmring_slots },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE) &&		\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&		\
+    defined(HAVE_ATOMIC_FETCH_SUB) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(__ATOMIC_SEQ_CST)
+
+/*
+ *  stress_shmring_t
+ *	everything a ring process needs, set up before forking
+ */
+typedef struct {
+	const stress_args_t *args;
+	stress_shmring_ctl_t *ctl;	/* shared ring control */
+	stress_shmring_msg_t *slots;	/* shared ring slots */
+	stress_shmring_proc_t *procs;	/* shared per process results */
+	uint64_t size;			/* number of slots */
+	uint64_t mask;			/* size - 1 */
+	int mode;			/* SHMRING_MODE_* */
+	int producers;			/* number of producers */
+	int pipefds[2];			/* pipe mode pipe */
+} stress_shmring_t;
+
+static inline bool stress_shmring_running(const stress_shmring_t *ring)
+{
+	return keep_stressing_flag() && !ring->ctl->stop;
+}
+
+/*
+ *  stress_shmring_can_put()
+ *	approximate check for free space, used to recheck
+ *	the ring state before sleeping
+ */
+static inline bool stress_shmring_can_put(const stress_shmring_t *ring)
+{
+	const uint64_t head = __atomic_load_n(&ring->ctl->head, __ATOMIC_SEQ_CST);
+	const uint64_t tail = __atomic_load_n(&ring->ctl->tail, __ATOMIC_SEQ_CST);
+
+	return (head - tail) < ring->size;
+}
+
+/*
+ *  stress_shmring_can_get()
+ *	approximate check for data, used to recheck the
+ *	ring state before sleeping
+ */
+static inline bool stress_shmring_can_get(const stress_shmring_t *ring)
+{
+	const uint64_t head = __atomic_load_n(&ring->ctl->head, __ATOMIC_SEQ_CST);
+	const uint64_t tail = __atomic_load_n(&ring->ctl->tail, __ATOMIC_SEQ_CST);
+
+	return head != tail;
+}
+
+/*
+ *  stress_shmring_wait()
+ *	sleep on futex until it is bumped, announcing the waiter
+ *	first and rechecking the ring so wakeups are not lost
+ */
+static void stress_shmring_wait(
+	const stress_shmring_t *ring,
+	uint32_t *futex,
+	uint32_t *waiters,
+	const bool put,
+	stress_shmring_proc_t *proc)
+{
+	const uint32_t val = __atomic_load_n(futex, __ATOMIC_SEQ_CST);
+
+	(void)__atomic_fetch_add(waiters, 1, __ATOMIC_SEQ_CST);
+	if (!(put ? stress_shmring_can_put(ring) : stress_shmring_can_get(ring)) &&
+	    stress_shmring_running(ring)) {
+		struct timespec ts;
+
+		ts.tv_sec = 0;
+		ts.tv_nsec = SHMRING_WAIT_NS;
+		if (shim_futex_wait((const void *)futex, (int)val, &ts) < 0) {
+			if (errno == ENOSYS)
+				(void)shim_sched_yield();
+		}
+		proc->sleeps++;
+	}
+	(void)__atomic_fetch_sub(waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ *  stress_shmring_notify()
+ *	wake a waiter if there are any, the fast path is just
+ *	a fence and a load of the waiter count
+ */
+static inline void stress_shmring_notify(uint32_t *futex, uint32_t *waiters)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (UNLIKELY(__atomic_load_n(waiters, __ATOMIC_RELAXED) > 0)) {
+		(void)__atomic_fetch_add(futex, 1, __ATOMIC_SEQ_CST);
+		(void)shim_futex_wake((const void *)futex, 1);
+	}
+}
+
+static inline void stress_shmring_fill(
+	stress_shmring_msg_t *msg,
+	const uint64_t seq,
+	const uint32_t producer)
+{
+	msg->seq = seq;
+	msg->producer = producer;
+	msg->check = (uint32_t)seq ^ producer;
+	msg->t_send = stress_latency_now();
+}
+
+/*
+ *  stress_shmring_put()
+ *	add a message to the ring, returns false if the run ended
+ *	while waiting for space
+ */
+static bool OPTIMIZE3 stress_shmring_put(
+	stress_shmring_t *ring,
+	const uint64_t seq,
+	const uint32_t producer,
+	stress_shmring_proc_t *proc)
+{
+	stress_shmring_ctl_t *ctl = ring->ctl;
+	int spins = 0;
+
+	for (;;) {
+		if (ring->mode == SHMRING_MODE_SPSC) {
+			/* only this process writes head */
+			const uint64_t head = ctl->head;
+			const uint64_t tail = __atomic_load_n(&ctl->tail, __ATOMIC_ACQUIRE);
+
+			if ((head - tail) < ring->size) {
+				stress_shmring_fill(&ring->slots[head & ring->mask], seq, producer);
+				__atomic_store_n(&ctl->head, head + 1, __ATOMIC_RELEASE);
+				break;
+			}
+		} else {
+			uint64_t pos = __atomic_load_n(&ctl->head, __ATOMIC_RELAXED);
+			stress_shmring_msg_t *msg = &ring->slots[pos & ring->mask];
+			const uint64_t turn = __atomic_load_n(&msg->turn, __ATOMIC_ACQUIRE);
+			const int64_t diff = (int64_t)(turn - pos);
+
+			if (diff == 0) {
+				if (__atomic_compare_exchange_n(&ctl->head, &pos, pos + 1,
+						false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+					stress_shmring_fill(msg, seq, producer);
+					__atomic_store_n(&msg->turn, pos + 1, __ATOMIC_RELEASE);
+					break;
+				}
+				continue;
+			} else if (diff > 0) {
+				/* another producer claimed pos, reload */
+				continue;
+			}
+		}
+		/* ring is full */
+		if (UNLIKELY(!stress_shmring_running(ring)))
+			return false;
+		if (++spins > SHMRING_SPINS) {
+			stress_shmring_wait(ring, &ctl->not_full, &ctl->full_waiters, true, proc);
+			spins = 0;
+		}
+	}
+	stress_shmring_notify(&ctl->not_empty, &ctl->empty_waiters);
+
+	return true;
+}
+
+/*
+ *  stress_shmring_get()
+ *	remove a message from the ring into msg, returns false
+ *	if the run ended while waiting for data
+ */
+static bool OPTIMIZE3 stress_shmring_get(
+	stress_shmring_t *ring,
+	stress_shmring_msg_t *msg,
+	stress_shmring_proc_t *proc)
+{
+	stress_shmring_ctl_t *ctl = ring->ctl;
+	int spins = 0;
+
+	for (;;) {
+		if (ring->mode == SHMRING_MODE_SPSC) {
+			/* only this process writes tail */
+			const uint64_t tail = ctl->tail;
+			const uint64_t head = __atomic_load_n(&ctl->head, __ATOMIC_ACQUIRE);
+
+			if (head != tail) {
+				*msg = ring->slots[tail & ring->mask];
+				__atomic_store_n(&ctl->tail, tail + 1, __ATOMIC_RELEASE);
+				break;
+			}
+		} else {
+			uint64_t pos = __atomic_load_n(&ctl->tail, __ATOMIC_RELAXED);
+			stress_shmring_msg_t *slot = &ring->slots[pos & ring->mask];
+			const uint64_t turn = __atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE);
+			const int64_t diff = (int64_t)(turn - (pos + 1));
+
+			if (diff == 0) {
+				if (__atomic_compare_exchange_n(&ctl->tail, &pos, pos + 1,
+						false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+					*msg = *slot;
+					__atomic_store_n(&slot->turn, pos + ring->size, __ATOMIC_RELEASE);
+					break;
+				}
+				continue;
+			} else if (diff > 0) {
+				/* another consumer claimed pos, reload */
+				continue;
+			}
+		}
+		/* ring is empty */
+		if (UNLIKELY(!stress_shmring_running(ring)))
+			return false;
+		if (++spins > SHMRING_SPINS) {
+			stress_shmring_wait(ring, &ctl->not_empty, &ctl->empty_waiters, false, proc);
+			spins = 0;
+		}
+	}
+	stress_shmring_notify(&ctl->not_full, &ctl->full_waiters);
+
+	return true;
+}
+
+/*
+ *  stress_shmring_producer()
+ *	send sequence numbered, time stamped messages
+ */
+static void NORETURN OPTIMIZE3 stress_shmring_producer(
+	stress_shmring_t *ring,
+	const uint32_t producer)
+{
+	stress_shmring_proc_t *proc = &ring->procs[producer];
+	uint64_t seq;
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	if (ring->mode == SHMRING_MODE_PIPE)
+		(void)close(ring->pipefds[0]);
+
+	for (seq = 0; stress_shmring_running(ring); seq++) {
+		if (ring->mode == SHMRING_MODE_PIPE) {
+			stress_shmring_msg_t msg;
+
+			stress_shmring_fill(&msg, seq, producer);
+			if (write(ring->pipefds[1], &msg, sizeof(msg)) != (ssize_t)sizeof(msg))
+				break;
+		} else if (!stress_shmring_put(ring, seq, producer, proc)) {
+			break;
+		}
+		proc->msgs++;
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_shmring_consumer()
+ *	receive messages, check they are in sequence for each
+ *	producer and account the one-way latency
+ */
+static void NORETURN OPTIMIZE3 stress_shmring_consumer(
+	stress_shmring_t *ring,
+	const uint32_t consumer)
+{
+	stress_shmring_proc_t *proc = &ring->procs[ring->producers + (int)consumer];
+	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	uint64_t next_seq[MAX_SHMRING_PROCS];
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	(void)memset(next_seq, 0, sizeof(next_seq));
+	stress_latency_reset(&proc->latency);
+	if (ring->mode == SHMRING_MODE_PIPE)
+		(void)close(ring->pipefds[1]);
+
+	while (stress_shmring_running(ring)) {
+		stress_shmring_msg_t msg;
+
+		if (ring->mode == SHMRING_MODE_PIPE) {
+			if (read(ring->pipefds[0], &msg, sizeof(msg)) != (ssize_t)sizeof(msg))
+				break;
+		} else if (!stress_shmring_get(ring, &msg, proc)) {
+			break;
+		}
+		stress_latency_add(&proc->latency, stress_latency_now() - msg.t_send);
+		proc->msgs++;
+
+		if (UNLIKELY(verify)) {
+			/*
+			 *  messages from one producer are received in order,
+			 *  with multiple consumers some go to the others
+			 */
+			if ((msg.producer >= (uint32_t)ring->producers) ||
+			    (msg.check != ((uint32_t)msg.seq ^ msg.producer)) ||
+			    (msg.seq < next_seq[msg.producer]) ||
+			    ((ring->mode != SHMRING_MODE_MPMC) && (msg.seq != next_seq[msg.producer]))) {
+				proc->errors++;
+			} else {
+				next_seq[msg.producer] = msg.seq + 1;
+			}
+		}
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_shmring_stop()
+ *	stop, wake and reap all the ring processes
+ */
+static void stress_shmring_stop(stress_shmring_t *ring, const pid_t *pids, const int n)
+{
+	int i;
+
+	ring->ctl->stop = true;
+	shim_mb();
+	(void)__atomic_fetch_add(&ring->ctl->not_empty, 1, __ATOMIC_SEQ_CST);
+	(void)__atomic_fetch_add(&ring->ctl->not_full, 1, __ATOMIC_SEQ_CST);
+	(void)shim_futex_wake((const void *)&ring->ctl->not_empty, INT_MAX);
+	(void)shim_futex_wake((const void *)&ring->ctl->not_full, INT_MAX);
+
+	for (i = 0; i < n; i++) {
+		if (pids[i] > 0)
+			(void)kill(pids[i], SIGALRM);
+	}
+	for (i = 0; i < n; i++) {
+		if (pids[i] > 0) {
+			int status;
+
+			(void)shim_waitpid(pids[i], &status, 0);
+		}
+	}
+}
+
+/*
+ *  stress_shmring
+ *	pass messages between processes over lock-free rings
+ *	in shared memory, each message received is a bogo op
+ */
+static int stress_shmring(const stress_args_t *args)
+{
+	int shmring_mode = SHMRING_MODE_SPSC;
+	int shmring_procs = DEFAULT_SHMRING_PROCS;
+	uint64_t shmring_slots = DEFAULT_SHMRING_SLOTS;
+	stress_shmring_t ring;
+	stress_latency_t *latency;
+	pid_t pids[MAX_SHMRING_PROCS * 2];
+	size_t shared_size, slots_size, procs_size;
+	uint8_t *shared;
+	uint64_t received, sent, sleeps, errors;
+	double t_start, duration, rate;
+	int i, n_procs = 0, consumers, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("shmring-mode", &shmring_mode);
+	(void)stress_get_setting("shmring-procs", &shmring_procs);
+	(void)stress_get_setting("shmring-slots", &shmring_slots);
+
+	(void)memset(&ring, 0, sizeof(ring));
+	ring.args = args;
+	ring.mode = shmring_mode;
+	ring.size = shmring_slots;
+	ring.mask = shmring_slots - 1;
+	ring.producers = (shmring_mode == SHMRING_MODE_MPMC) ? shmring_procs : 1;
+	ring.pipefds[0] = -1;
+	ring.pipefds[1] = -1;
+	consumers = ring.producers;
+
+	slots_size = (size_t)shmring_slots * sizeof(stress_shmring_msg_t);
+	procs_size = (size_t)(ring.producers + consumers) * sizeof(stress_shmring_proc_t);
+	shared_size = sizeof(stress_shmring_ctl_t) + slots_size + procs_size;
+	shared = (uint8_t *)mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes for the ring, skipping stressor\n",
+			args->name, shared_size);
+		return EXIT_NO_RESOURCE;
+	}
+	latency = malloc(sizeof(*latency));
+	if (!latency) {
+		pr_inf_skip("%s: cannot allocate latency statistics, skipping stressor\n",
+			args->name);
+		(void)munmap((void *)shared, shared_size);
+		return EXIT_NO_RESOURCE;
+	}
+	ring.ctl = (stress_shmring_ctl_t *)shared;
+	ring.slots = (stress_shmring_msg_t *)(shared + sizeof(stress_shmring_ctl_t));
+	ring.procs = (stress_shmring_proc_t *)(shared + sizeof(stress_shmring_ctl_t) + slots_size);
+	for (i = 0; i < (int)shmring_slots; i++)
+		ring.slots[i].turn = (uint64_t)i;
+
+	if ((shmring_mode == SHMRING_MODE_PIPE) && (pipe(ring.pipefds) < 0)) {
+		pr_fail("%s: pipe failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto tidy;
+	}
+
+	(void)memset(pids, 0, sizeof(pids));
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	t_start = stress_time_now();
+	for (i = 0; i < ring.producers + consumers; i++) {
+again:
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			if (stress_redo_fork(errno))
+				goto again;
+			if (!keep_stressing_flag())
+				break;
+			pr_fail("%s: fork failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		} else if (pids[i] == 0) {
+			if (i < ring.producers)
+				stress_shmring_producer(&ring, (uint32_t)i);
+			stress_shmring_consumer(&ring, (uint32_t)(i - ring.producers));
+		}
+		n_procs++;
+	}
+	if (ring.pipefds[0] >= 0) {
+		(void)close(ring.pipefds[0]);
+		(void)close(ring.pipefds[1]);
+	}
+
+	/* the consumers' message counts are the bogo ops */
+	while ((rc == EXIT_SUCCESS) && keep_stressing(args)) {
+		received = 0;
+		for (i = 0; i < consumers; i++)
+			received += ring.procs[ring.producers + i].msgs;
+		set_counter(args, received);
+		(void)shim_usleep_interruptible(50000);
+	}
+	stress_shmring_stop(&ring, pids, n_procs);
+	duration = stress_time_now() - t_start;
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	received = 0;
+	sent = 0;
+	sleeps = 0;
+	errors = 0;
+	stress_latency_reset(latency);
+	for (i = 0; i < ring.producers + consumers; i++) {
+		const stress_shmring_proc_t *proc = &ring.procs[i];
+
+		sleeps += proc->sleeps;
+		errors += proc->errors;
+		if (i < ring.producers) {
+			sent += proc->msgs;
+		} else {
+			received += proc->msgs;
+			stress_latency_merge(latency, &proc->latency);
+		}
+	}
+	set_counter(args, received);
+	pr_dbg("%s: %" PRIu64 " messages sent, %" PRIu64 " received\n",
+		args->name, sent, received);
+
+	if (errors) {
+		pr_fail("%s: %" PRIu64 " messages were corrupt or out of sequence\n",
+			args->name, errors);
+		rc = EXIT_FAILURE;
+	}
+
+	rate = (duration > 0.0) ? (double)received / duration : 0.0;
+	stress_metrics_set(args, 0, "messages per sec", rate);
+	if (latency->count) {
+		stress_metrics_set(args, 1, "mean one-way latency (ns)",
+			(double)latency->total / (double)latency->count);
+		stress_metrics_set(args, 2, "p50 one-way latency (ns)",
+			(double)stress_latency_percentile(latency, 50.0));
+		stress_metrics_set(args, 3, "p99 one-way latency (ns)",
+			(double)stress_latency_percentile(latency, 99.0));
+		if (args->latency)
+			stress_latency_merge(args->latency, latency);
+	}
+	if (shmring_mode != SHMRING_MODE_PIPE)
+		stress_metrics_set(args, 4, "futex sleeps per 1000 msgs",
+			received ? ((double)sleeps * 1000.0) / (double)received : 0.0);
+tidy:
+	free(latency);
+	(void)munmap((void *)shared, shared_size);
+
+	return rc;
+}
+
+stressor_info_t stress_shmring_info = {
+	.stressor = stress_shmring,
+	.class = CLASS_CPU_CACHE | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
+#else
+stressor_info_t stress_shmring_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_CPU_CACHE | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help,
+	.unimplemented_reason = "built without gcc __atomic builtins"
+};
+#endif
@@ -18,13 +18,88 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
+
+#if defined(HAVE_SYS_SIGNALFD_H)
+#include <sys/signalfd.h>
+#endif
+
+#define SIGNAL_BENCH_SLICE	(0.25)	/* seconds per benchmark configuration */
+
+/* ways of sending the benchmark signal */
+#define SIGNAL_SEND_KILL	(0)
+#define SIGNAL_SEND_TGKILL	(1)
+#define SIGNAL_SEND_SIGQUEUE	(2)
+#define SIGNAL_SEND_PIDFD	(3)
+#define SIGNAL_SENDERS		(4)
+
+/* ways of receiving the benchmark signal */
+#define SIGNAL_RECV_HANDLER	(0)
+#define SIGNAL_RECV_SIGNALFD	(1)
+#define SIGNAL_RECV_SIGWAITINFO	(2)
+#define SIGNAL_RECEIVERS	(3)
+
+/* sender and receiver on the same or on different CPUs */
+#define SIGNAL_PLACE_SAME	(0)
+#define SIGNAL_PLACE_CROSS	(1)
+#define SIGNAL_PLACES		(2)
+
+#define SIGNAL_BENCH_CONFIGS	(SIGNAL_PLACES * SIGNAL_SENDERS * SIGNAL_RECEIVERS)
 
 static const stress_help_t help[] = {
 	{ NULL,	"signal N",	"start N workers that exercise signal" },
+	{ NULL,	"signal-bench",	"compare signal delivery latency of send and receive methods" },
 	{ NULL,	"signal-ops N",	"stop after N bogo signals" },
 	{ NULL,	NULL,		 NULL }
 };
 
+static int stress_set_signal_bench(const char *opt)
+{
+	return stress_set_setting_true("signal-bench", opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_signal_bench,	stress_set_signal_bench },
+	{ 0,			NULL }
+};
+
+#if defined(SIGRTMIN) &&		\
+    defined(HAVE_SCHED_GETAFFINITY) &&	\
+    defined(HAVE_SCHED_SETAFFINITY)
+#define STRESS_SIGNAL_BENCH
+
+/* accumulated results of a send, receive and placement configuration */
+typedef struct {
+	int err;			/* errno if the configuration cannot be used */
+	uint64_t signals;		/* signals sent and acknowledged */
+	double secs;			/* seconds sending */
+	stress_latency_t latency;	/* send to receive latencies, from the receiver */
+} stress_signal_bench_t;
+
+/* shared between the sender and receiver processes */
+typedef struct {
+	volatile uint64_t stamp;	/* time just before the signal was sent */
+	stress_signal_bench_t results[SIGNAL_BENCH_CONFIGS];
+} stress_signal_bench_shared_t;
+
+static const char * const stress_signal_senders[SIGNAL_SENDERS] = {
+	"kill", "tgkill", "sigqueue", "pidfd",
+};
+
+static const char * const stress_signal_receivers[SIGNAL_RECEIVERS] = {
+	"handler", "signalfd", "sigwaitinfo",
+};
+
+static const char * const stress_signal_places[SIGNAL_PLACES] = {
+	"same cpu", "cross cpu",
+};
+
+/* receiver process state, used by the signal handler */
+static stress_signal_bench_shared_t *bench_shared;
+static stress_latency_t *bench_latency;
+static int bench_ack_fd = -1;
+#endif
+
 static volatile uint64_t counter;
 
 static void MLOCKED_TEXT stress_signal_handler(int signum)
@@ -61,6 +136,351 @@ static inline shim_sighandler_t shim_signal(int signum, shim_sighandler_t handle
 #endif
 }
 
+#if defined(STRESS_SIGNAL_BENCH)
+/*
+ *  stress_signal_bench_now()
+ *	CLOCK_MONOTONIC time in nanoseconds, comparable between the
+ *	sender and receiver processes and async signal safe
+ */
+static inline uint64_t stress_signal_bench_now(void)
+{
+	struct timespec ts;
+
+	if (UNLIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) < 0))
+		return 0;
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_signal_bench_received()
+ *	add the latency of a received signal and acknowledge it
+ */
+static void stress_signal_bench_received(void)
+{
+	const uint64_t now = stress_signal_bench_now();
+	const uint64_t stamp = bench_shared->stamp;
+	const char ack = 'A';
+
+	if (LIKELY(now > stamp))
+		stress_latency_add(bench_latency, now - stamp);
+	VOID_RET(ssize_t, write(bench_ack_fd, &ack, sizeof(ack)));
+}
+
+static void MLOCKED_TEXT stress_signal_bench_handler(int signum)
+{
+	(void)signum;
+
+	stress_signal_bench_received();
+}
+
+/*
+ *  stress_signal_bench_pin()
+ *	pin the calling process to a CPU
+ */
+static int stress_signal_bench_pin(const int cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_signal_bench_receiver()
+ *	receive benchmark signals with a handler, signalfd reads or
+ *	sigwaitinfo until killed, the ready byte tells the sender the
+ *	receiver is set up
+ */
+static void NORETURN stress_signal_bench_receiver(const int receiver, const int cpu)
+{
+	struct sigaction action;
+	sigset_t mask;
+	const char ready = 'R';
+
+	stress_parent_died_alarm();
+	(void)stress_signal_bench_pin(cpu);
+
+	(void)sigemptyset(&mask);
+	(void)sigaddset(&mask, SIGRTMIN);
+	switch (receiver) {
+	case SIGNAL_RECV_HANDLER:
+		(void)memset(&action, 0, sizeof(action));
+		action.sa_handler = stress_signal_bench_handler;
+		(void)sigemptyset(&action.sa_mask);
+		if (sigaction(SIGRTMIN, &action, NULL) < 0)
+			break;
+		VOID_RET(ssize_t, write(bench_ack_fd, &ready, sizeof(ready)));
+		for (;;)
+			(void)pause();
+#if defined(HAVE_SYS_SIGNALFD_H) &&	\
+    defined(HAVE_SIGNALFD)
+	case SIGNAL_RECV_SIGNALFD: {
+			struct signalfd_siginfo info;
+			int sfd;
+
+			if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+				break;
+			sfd = signalfd(-1, &mask, 0);
+			if (sfd < 0)
+				break;
+			VOID_RET(ssize_t, write(bench_ack_fd, &ready, sizeof(ready)));
+			for (;;) {
+				if (read(sfd, &info, sizeof(info)) == (ssize_t)sizeof(info))
+					stress_signal_bench_received();
+				else if (errno != EINTR)
+					break;
+			}
+		}
+		break;
+#endif
+#if defined(HAVE_SIGWAITINFO)
+	case SIGNAL_RECV_SIGWAITINFO: {
+			siginfo_t info;
+
+			if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+				break;
+			VOID_RET(ssize_t, write(bench_ack_fd, &ready, sizeof(ready)));
+			for (;;) {
+				if (sigwaitinfo(&mask, &info) == SIGRTMIN)
+					stress_signal_bench_received();
+			}
+		}
+		break;
+#endif
+	default:
+		break;
+	}
+	_exit(EXIT_FAILURE);
+}
+
+/*
+ *  stress_signal_bench_send()
+ *	send the benchmark signal to the receiver
+ */
+static inline int stress_signal_bench_send(
+	const int sender,
+	const pid_t pid,
+	const int pidfd)
+{
+	switch (sender) {
+	case SIGNAL_SEND_KILL:
+		return kill(pid, SIGRTMIN);
+	case SIGNAL_SEND_TGKILL:
+		return shim_tgkill(pid, pid, SIGRTMIN);
+#if defined(HAVE_SIGQUEUE)
+	case SIGNAL_SEND_SIGQUEUE: {
+			union sigval value;
+
+			(void)memset(&value, 0, sizeof(value));
+			return sigqueue(pid, SIGRTMIN, value);
+		}
+#endif
+	case SIGNAL_SEND_PIDFD:
+		return shim_pidfd_send_signal(pidfd, SIGRTMIN, NULL, 0);
+	default:
+		break;
+	}
+	errno = ENOSYS;
+	return -1;
+}
+
+/*
+ *  stress_signal_bench_run()
+ *	ping-pong signals to a receiver process for secs seconds, the
+ *	sender time stamps each signal and waits for the receiver to
+ *	acknowledge it over a pipe before sending the next one
+ */
+static void stress_signal_bench_run(
+	const stress_args_t *args,
+	const int sender,
+	const int receiver,
+	const int sender_cpu,
+	const int receiver_cpu,
+	const double secs,
+	stress_signal_bench_t *result)
+{
+	int fds[2], pidfd = -1, status;
+	pid_t pid;
+	char ack;
+	double t_start, t_now;
+	uint64_t signals = 0;
+
+	if (pipe(fds) < 0) {
+		result->err = errno;
+		return;
+	}
+	pid = fork();
+	if (pid < 0) {
+		result->err = errno;
+		goto close_fds;
+	} else if (pid == 0) {
+		(void)close(fds[0]);
+		bench_ack_fd = fds[1];
+		bench_latency = &result->latency;
+		stress_signal_bench_receiver(receiver, receiver_cpu);
+	}
+	(void)close(fds[1]);
+	fds[1] = -1;
+	(void)stress_signal_bench_pin(sender_cpu);
+
+	if (read(fds[0], &ack, sizeof(ack)) != (ssize_t)sizeof(ack)) {
+		/* receiver could not be set up */
+		result->err = ENOTSUP;
+		goto reap;
+	}
+	if (sender == SIGNAL_SEND_PIDFD) {
+		pidfd = shim_pidfd_open(pid, 0);
+		if (pidfd < 0) {
+			result->err = errno;
+			goto reap;
+		}
+	}
+
+	t_start = stress_time_now();
+	t_now = t_start;
+	while (keep_stressing(args) && (t_now < t_start + secs)) {
+		bench_shared->stamp = stress_signal_bench_now();
+		if (UNLIKELY(stress_signal_bench_send(sender, pid, pidfd) < 0)) {
+			result->err = errno;
+			break;
+		}
+		while (read(fds[0], &ack, sizeof(ack)) != (ssize_t)sizeof(ack)) {
+			if ((errno != EINTR) || !keep_stressing_flag())
+				goto done;
+		}
+		signals++;
+		t_now = stress_time_now();
+	}
+done:
+	result->secs += stress_time_now() - t_start;
+	result->signals += signals;
+	add_counter(args, signals);
+	if (pidfd >= 0)
+		(void)close(pidfd);
+reap:
+	(void)kill(pid, SIGKILL);
+	(void)shim_waitpid(pid, &status, 0);
+close_fds:
+	(void)close(fds[0]);
+	if (fds[1] >= 0)
+		(void)close(fds[1]);
+}
+
+/*
+ *  stress_signal_bench_report()
+ *	print and set the metrics of each configuration
+ */
+static void stress_signal_bench_report(const stress_args_t *args, const int cpus)
+{
+	size_t i, idx = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		if (cpus < 2)
+			pr_inf("%s: cross cpu delivery needs 2 cpus, only same cpu delivery measured\n",
+				args->name);
+		pr_inf("%s: %-9s %-12s %-10s %12s %10s %10s %10s\n", args->name,
+			"sender", "receiver", "placement", "signals/sec",
+			"p50 usec", "p99 usec", "max usec");
+	}
+	for (i = 0; i < SIGNAL_BENCH_CONFIGS; i++) {
+		const stress_signal_bench_t *r = &bench_shared->results[i];
+		const char *sender = stress_signal_senders[i % SIGNAL_SENDERS];
+		const char *receiver = stress_signal_receivers[(i / SIGNAL_SENDERS) % SIGNAL_RECEIVERS];
+		const char *place = stress_signal_places[i / (SIGNAL_SENDERS * SIGNAL_RECEIVERS)];
+		double rate, p50, p99, max;
+		char str[64];
+
+		if (r->err) {
+			if (args->instance == 0)
+				pr_inf("%s: %-9s %-12s %-10s not available, errno=%d (%s)\n",
+					args->name, sender, receiver, place, r->err, strerror(r->err));
+			continue;
+		}
+		if ((r->secs <= 0.0) || (r->latency.count == 0))
+			continue;
+		rate = (double)r->signals / r->secs;
+		p50 = (double)stress_latency_percentile(&r->latency, 50.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		p99 = (double)stress_latency_percentile(&r->latency, 99.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		max = (double)r->latency.max / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		if (args->instance == 0)
+			pr_inf("%s: %-9s %-12s %-10s %12.1f %10.2f %10.2f %10.2f\n",
+				args->name, sender, receiver, place, rate, p50, p99, max);
+
+		(void)snprintf(str, sizeof(str), "%s %s %s signals per sec", sender, receiver, place);
+		stress_metrics_set(args, idx++, str, rate);
+		(void)snprintf(str, sizeof(str), "%s %s %s p50 usec", sender, receiver, place);
+		stress_metrics_set(args, idx++, str, p50);
+		(void)snprintf(str, sizeof(str), "%s %s %s p99 usec", sender, receiver, place);
+		stress_metrics_set(args, idx++, str, p99);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_signal_bench()
+ *	compare the delivery latency from just before sending to the
+ *	receiver of kill, tgkill, sigqueue and pidfd_send_signal with
+ *	a handler, signalfd and sigwaitinfo receiver on the same and
+ *	on different CPUs, each configuration runs for a slice of time
+ *	in turn so all see the same system conditions
+ */
+static int stress_signal_bench(const stress_args_t *args)
+{
+	cpu_set_t orig_mask;
+	int cpus[2] = { 0, 0 }, n_cpus = 0, cpu;
+	size_t i;
+	bool ran;
+
+	if (sched_getaffinity(0, sizeof(orig_mask), &orig_mask) < 0) {
+		pr_inf_skip("%s: sched_getaffinity failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	/* the first two CPUs the stressor may run on */
+	for (cpu = 0; (cpu < CPU_SETSIZE) && (n_cpus < 2); cpu++) {
+		if (CPU_ISSET(cpu, &orig_mask))
+			cpus[n_cpus++] = cpu;
+	}
+
+	bench_shared = (stress_signal_bench_shared_t *)mmap(NULL, sizeof(*bench_shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (bench_shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap benchmark results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < SIGNAL_BENCH_CONFIGS; i++)
+		stress_latency_reset(&bench_shared->results[i].latency);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		for (i = 0; (i < SIGNAL_BENCH_CONFIGS) && keep_stressing(args); i++) {
+			stress_signal_bench_t *r = &bench_shared->results[i];
+			const int sender = (int)(i % SIGNAL_SENDERS);
+			const int receiver = (int)((i / SIGNAL_SENDERS) % SIGNAL_RECEIVERS);
+			const int place = (int)(i / (SIGNAL_SENDERS * SIGNAL_RECEIVERS));
+
+			if (r->err || ((place == SIGNAL_PLACE_CROSS) && (n_cpus < 2)))
+				continue;
+			stress_signal_bench_run(args, sender, receiver, cpus[0],
+				cpus[place == SIGNAL_PLACE_CROSS ? 1 : 0], SIGNAL_BENCH_SLICE, r);
+			ran = true;
+		}
+	} while (ran && keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	(void)sched_setaffinity(0, sizeof(orig_mask), &orig_mask);
+	stress_signal_bench_report(args, n_cpus);
+	(void)munmap((void *)bench_shared, sizeof(*bench_shared));
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_signal
  *	stress by generating SIGCHLD signals on exiting
@@ -70,6 +490,18 @@ static int stress_signal(const stress_args_t *args)
 {
 	int rc = EXIT_SUCCESS;
 	const pid_t pid = getpid();
+	bool signal_bench = false;
+
+	(void)stress_get_setting("signal-bench", &signal_bench);
+	if (signal_bench) {
+#if defined(STRESS_SIGNAL_BENCH)
+		return stress_signal_bench(args);
+#else
+		pr_inf_skip("%s: --signal-bench needs real time signals and "
+			"sched_setaffinity, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
 
 	counter = 0;
 
@@ -132,5 +564,6 @@ static int stress_signal(const stress_args_t *args)
 stressor_info_t stress_signal_info = {
 	.stressor = stress_signal,
 	.class = CLASS_INTERRUPT | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
@@ -18,10 +18,28 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arena.h"
 
 #define MIN_SKIPLIST_SIZE	(1 * KB)
 #define MAX_SKIPLIST_SIZE	(4 * MB)
 #define DEFAULT_SKIPLIST_SIZE	(1 * KB)
+#define DEFAULT_SKIPLIST_BENCH_SIZE	(64 * KB)
+
+#define MIN_SKIPLIST_THREADS	(1)
+#define MAX_SKIPLIST_THREADS	(64)
+#define DEFAULT_SKIPLIST_THREADS (4)
+
+/* --skiplist-bench key distributions */
+#define SKIPLIST_DIST_ALL	(0)
+#define SKIPLIST_DIST_UNIFORM	(1)
+#define SKIPLIST_DIST_ZIPF	(2)
+#define SKIPLIST_DIST_MAX	(3)
+
+static const char * const skiplist_dists[SKIPLIST_DIST_MAX] = {
+	"all",
+	"uniform",
+	"zipf",
+};
 
 typedef struct skip_node {
 	unsigned long value;
@@ -32,12 +50,17 @@ typedef struct {
 	size_t level;
 	size_t max_level;
 	skip_node_t *head;
+	stress_arena_t *arena;	/* arena allocator, NULL for libc */
+	skip_node_t **update;	/* arena insert skip node array */
 } skip_list_t;
 
 static const stress_help_t help[] = {
 	{ NULL,	"skiplist N",	  "start N workers that exercise a skiplist search" },
+	{ NULL,	"skiplist-bench", "measure lock free skiplist scaling over threads" },
+	{ NULL,	"skiplist-dist D", "skiplist-bench key distribution: all, uniform, zipf" },
 	{ NULL,	"skiplist-ops N", "stop after N skiplist search bogo operations" },
 	{ NULL,	"skiplist-size N", "number of 32 bit integers to add to skiplist" },
+	{ NULL,	"skiplist-threads N", "maximum threads for skiplist-bench" },
 	{ NULL,	NULL,		  NULL }
 };
 
@@ -55,6 +78,45 @@ static int stress_set_skiplist_size(const char *opt)
 	return stress_set_setting("skiplist-size", TYPE_ID_UINT64, &skiplist_size);
 }
 
+static int stress_set_skiplist_bench(const char *opt)
+{
+	return stress_set_setting_true("skiplist-bench", opt);
+}
+
+/*
+ *  stress_set_skiplist_threads()
+ *	set maximum number of skiplist-bench threads
+ */
+static int stress_set_skiplist_threads(const char *opt)
+{
+	size_t skiplist_threads;
+
+	skiplist_threads = (size_t)stress_get_uint32(opt);
+	stress_check_range("skiplist-threads", (uint64_t)skiplist_threads,
+		MIN_SKIPLIST_THREADS, MAX_SKIPLIST_THREADS);
+	return stress_set_setting("skiplist-threads", TYPE_ID_SIZE_T, &skiplist_threads);
+}
+
+/*
+ *  stress_set_skiplist_dist()
+ *	set skiplist-bench key distribution
+ */
+static int stress_set_skiplist_dist(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(skiplist_dists); i++) {
+		if (!strcmp(skiplist_dists[i], opt))
+			return stress_set_setting("skiplist-dist", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "skiplist-dist must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(skiplist_dists); i++)
+		(void)fprintf(stderr, " %s", skiplist_dists[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 /*
  *  skip_list_random_level()
  *	generate a quasi-random skip list level
@@ -76,10 +138,12 @@ static inline size_t OPTIMIZE3 skip_list_random_level(const size_t max_level)
  *  skip_node_alloc()
  *	allocate a skip list node
  */
-static inline skip_node_t *skip_node_alloc(const size_t levels)
+static inline skip_node_t *skip_node_alloc(stress_arena_t *arena, const size_t levels)
 {
 	const size_t sz = sizeof(skip_node_t) + (levels * sizeof(skip_node_t *));
 
+	if (arena)
+		return (skip_node_t *)stress_arena_calloc(arena, 1, sz);
 	return (skip_node_t *)calloc(1, sz);
 }
 
@@ -87,17 +151,27 @@ static inline skip_node_t *skip_node_alloc(const size_t levels)
  *  skip_list_init
  *	initialize the skip list, return NULL if failed
  */
-static skip_list_t *skip_list_init(skip_list_t *list, const size_t max_level)
+static skip_list_t *skip_list_init(
+	skip_list_t *list,
+	stress_arena_t *arena,
+	const size_t max_level)
 {
 	register size_t i;
 	register skip_node_t *head;
 
-	head = skip_node_alloc(max_level);
+	head = skip_node_alloc(arena, max_level);
 	if (UNLIKELY(!head))
 		return NULL;
 	list->level = 1;
 	list->max_level = max_level;
 	list->head = head;
+	list->arena = arena;
+	list->update = NULL;
+	if (arena) {
+		list->update = stress_arena_calloc(arena, max_level + 1, sizeof(*list->update));
+		if (UNLIKELY(!list->update))
+			return NULL;
+	}
 	head->value = INT_MAX;
 
 	for (i = 0; i <= max_level; i++)
@@ -106,6 +180,17 @@ static skip_list_t *skip_list_init(skip_list_t *list, const size_t max_level)
 	return list;
 }
 
+/*
+ *  skip_nodes_free()
+ *	free the insert skip node array, the arena one is
+ *	re-used for every insert
+ */
+static inline void skip_nodes_free(skip_list_t *list, skip_node_t **skip_nodes)
+{
+	if (!list->arena)
+		free(skip_nodes);
+}
+
 /*
  *  skip_list_insert()
  *	insert a value into the skiplist
@@ -116,7 +201,10 @@ static skip_node_t OPTIMIZE3 *skip_list_insert(skip_list_t *list, const unsigned
 	skip_node_t *skip_node = list->head;
 	register size_t i, level;
 
-	skip_nodes = calloc(list->max_level + 1, sizeof(*skip_nodes));
+	if (list->arena)
+		skip_nodes = list->update;
+	else
+		skip_nodes = calloc(list->max_level + 1, sizeof(*skip_nodes));
 	if (UNLIKELY(!skip_nodes))
 		return NULL;
 
@@ -130,7 +218,7 @@ static skip_node_t OPTIMIZE3 *skip_list_insert(skip_list_t *list, const unsigned
 
 	if (value == skip_node->value) {
 		skip_node->value = value;
-		free(skip_nodes);
+		skip_nodes_free(list, skip_nodes);
 		return skip_node;
 	}
 
@@ -143,12 +231,12 @@ static skip_node_t OPTIMIZE3 *skip_list_insert(skip_list_t *list, const unsigned
 	}
 
 	if (UNLIKELY(level < 1)) {
-		free(skip_nodes);
+		skip_nodes_free(list, skip_nodes);
 		return NULL;
 	}
-	skip_node = skip_node_alloc(level);
+	skip_node = skip_node_alloc(list->arena, level);
 	if (UNLIKELY(!skip_node)) {
-		free(skip_nodes);
+		skip_nodes_free(list, skip_nodes);
 		return NULL;
 	}
 	skip_node->value = value;
@@ -156,7 +244,7 @@ static skip_node_t OPTIMIZE3 *skip_list_insert(skip_list_t *list, const unsigned
 		skip_node->skip_nodes[i] = skip_nodes[i]->skip_nodes[i];
 		skip_nodes[i]->skip_nodes[i] = skip_node;
 	}
-	free(skip_nodes);
+	skip_nodes_free(list, skip_nodes);
 	return skip_node;
 }
 
@@ -200,6 +288,10 @@ static void skip_list_free(skip_list_t *list)
 	skip_node_t *head = list->head;
 	skip_node_t *skip_node = head;
 
+	if (list->arena) {
+		stress_arena_reset(list->arena);
+		return;
+	}
 	while (skip_node && skip_node->skip_nodes[1] != head) {
 		skip_node_t *next = skip_node->skip_nodes[1];
 
@@ -210,6 +302,457 @@ static void skip_list_free(skip_list_t *list)
 		free(skip_node);
 }
 
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+#define STRESS_SKIPLIST_BENCH
+
+#define SKIPLIST_BENCH_SLICE		(0.25)	/* seconds per benchmark configuration */
+#define SKIPLIST_BENCH_MAX_LEVEL	(24)
+#define SKIPLIST_BENCH_MAX_THREADS	(64)
+#define SKIPLIST_BENCH_INSERT_PCT	(10)	/* percentage of insert operations */
+
+/* a lock free skip list node, next has levels entries */
+typedef struct skip_bench_node {
+	uint32_t key;
+	uint32_t levels;
+	struct skip_bench_node *next[1];
+} skip_bench_node_t;
+
+/* a lock free insert and lookup skip list shared by the threads */
+typedef struct {
+	skip_bench_node_t *head;	/* all levels, key 0, NULL ends a level */
+	size_t max_level;
+	uint8_t *pool;			/* node pool, nodes are never freed */
+	size_t pool_size;
+	size_t pool_used;		/* bytes allocated, atomically updated */
+	uint32_t n;			/* keys are ranks 0..n-1 */
+	int dist;			/* SKIPLIST_DIST_* key distribution */
+	bool start;			/* threads start when set */
+	bool stop;			/* threads stop when set */
+	uint64_t inserted;		/* keys inserted while running */
+} skip_bench_t;
+
+/* a benchmark thread and its counts */
+typedef struct {
+	skip_bench_t *list;
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	uint64_t rnd;			/* per thread xorshift state */
+	uint64_t ops;			/* lookups and inserts */
+	uint64_t lookups;
+	uint64_t hops;			/* pointers followed by lookups */
+} skip_bench_thread_t;
+
+/* accumulated results of a thread count and key distribution */
+typedef struct {
+	double ops;
+	double lookups;
+	double hops;
+	double secs;
+} skip_bench_result_t;
+
+/*
+ *  skip_bench_rand()
+ *	per thread xorshift64, a shared generator would be a
+ *	contended cache line and skew the scaling measured
+ */
+static inline uint64_t skip_bench_rand(uint64_t *state)
+{
+	register uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+/*
+ *  skip_bench_key()
+ *	key of a rank, a bijection so keys are unique, non-zero
+ *	and the popular zipf ranks are spread over the list
+ */
+static inline uint32_t skip_bench_key(const uint32_t rank)
+{
+	return (rank + 1) * 0x9e3779b1U;
+}
+
+/*
+ *  skip_bench_rank()
+ *	random rank 0..n-1, uniform or zipf where rank r has a
+ *	probability of ~ 1 / (r + 1)
+ */
+static inline uint32_t skip_bench_rank(uint64_t *state, const uint32_t n, const int dist)
+{
+	const uint64_t r = skip_bench_rand(state);
+	uint32_t rank;
+
+	if (dist == SKIPLIST_DIST_UNIFORM)
+		return (uint32_t)((r >> 32) % n);
+	rank = (uint32_t)(exp(((double)(r >> 11) / 9007199254740992.0) * log((double)n + 1.0)) - 1.0);
+	return rank >= n ? n - 1 : rank;
+}
+
+/*
+ *  skip_bench_alloc()
+ *	allocate a node from the pool, NULL if the pool is used up
+ */
+static skip_bench_node_t *skip_bench_alloc(skip_bench_t *list, const size_t levels)
+{
+	const size_t sz = (sizeof(skip_bench_node_t) + (levels * sizeof(skip_bench_node_t *)) + 7) & ~(size_t)7;
+	const size_t offset = __atomic_fetch_add(&list->pool_used, sz, __ATOMIC_RELAXED);
+
+	if (offset + sz > list->pool_size)
+		return NULL;
+	return (skip_bench_node_t *)(list->pool + offset);
+}
+
+/*
+ *  skip_bench_find()
+ *	find the predecessors and successors of key on every level,
+ *	returns true if the key is in the list
+ */
+static bool OPTIMIZE3 skip_bench_find(
+	skip_bench_t *list,
+	const uint32_t key,
+	skip_bench_node_t **preds,
+	skip_bench_node_t **succs)
+{
+	skip_bench_node_t *pred = list->head;
+	size_t i = list->max_level;
+
+	while (i-- > 0) {
+		skip_bench_node_t *cur = __atomic_load_n(&pred->next[i], __ATOMIC_ACQUIRE);
+
+		while (cur && (cur->key < key)) {
+			pred = cur;
+			cur = __atomic_load_n(&cur->next[i], __ATOMIC_ACQUIRE);
+		}
+		preds[i] = pred;
+		succs[i] = cur;
+	}
+	return succs[0] && (succs[0]->key == key);
+}
+
+/*
+ *  skip_bench_lookup()
+ *	lock free lookup, counts the pointers followed
+ */
+static bool OPTIMIZE3 skip_bench_lookup(skip_bench_t *list, const uint32_t key, uint64_t *hops)
+{
+	skip_bench_node_t *pred = list->head;
+	size_t i = list->max_level;
+	uint64_t h = 0;
+
+	while (i-- > 0) {
+		skip_bench_node_t *cur = __atomic_load_n(&pred->next[i], __ATOMIC_ACQUIRE);
+
+		h++;
+		while (cur && (cur->key < key)) {
+			pred = cur;
+			cur = __atomic_load_n(&cur->next[i], __ATOMIC_ACQUIRE);
+			h++;
+		}
+		if (cur && (cur->key == key)) {
+			*hops += h;
+			return true;
+		}
+	}
+	*hops += h;
+	return false;
+}
+
+/*
+ *  skip_bench_insert()
+ *	lock free insert, the node is linked into level 0 with a CAS
+ *	which makes it present, the upper levels are then linked with
+ *	a CAS each, re-finding the predecessors when a CAS loses a race.
+ *	Returns true if the key was inserted
+ */
+static bool OPTIMIZE3 skip_bench_insert(skip_bench_t *list, const uint32_t key, uint64_t *rnd)
+{
+	skip_bench_node_t *preds[SKIPLIST_BENCH_MAX_LEVEL], *succs[SKIPLIST_BENCH_MAX_LEVEL];
+	skip_bench_node_t *node;
+	uint64_t r = skip_bench_rand(rnd);
+	size_t i, levels = 1;
+
+	if (skip_bench_find(list, key, preds, succs))
+		return false;
+
+	while ((r & 1) && (levels < list->max_level)) {
+		r >>= 1;
+		levels++;
+	}
+	node = skip_bench_alloc(list, levels);
+	if (UNLIKELY(!node))
+		return false;
+	node->key = key;
+	node->levels = (uint32_t)levels;
+	for (i = 0; i < levels; i++)
+		node->next[i] = succs[i];
+
+	while (!__atomic_compare_exchange_n(&preds[0]->next[0], &succs[0], node,
+					    false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+		if (skip_bench_find(list, key, preds, succs))
+			return false;	/* another thread inserted it, the node is wasted */
+		for (i = 0; i < levels; i++)
+			node->next[i] = succs[i];
+	}
+	for (i = 1; i < levels; i++) {
+		while (!__atomic_compare_exchange_n(&preds[i]->next[i], &succs[i], node,
+						    false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			(void)skip_bench_find(list, key, preds, succs);
+			__atomic_store_n(&node->next[i], succs[i], __ATOMIC_RELAXED);
+		}
+	}
+	return true;
+}
+
+/*
+ *  skip_bench_thread()
+ *	mixed lookups and inserts until stopped
+ */
+static void *skip_bench_thread(void *arg)
+{
+	static void *nowt = NULL;
+	skip_bench_thread_t *thread = (skip_bench_thread_t *)arg;
+	skip_bench_t *list = thread->list;
+	uint64_t inserted = 0;
+
+	while (!__atomic_load_n(&list->start, __ATOMIC_ACQUIRE)) {
+		if (__atomic_load_n(&list->stop, __ATOMIC_ACQUIRE))
+			return &nowt;
+		shim_sched_yield();
+	}
+	while (!__atomic_load_n(&list->stop, __ATOMIC_RELAXED)) {
+		register int i;
+
+		for (i = 0; i < 64; i++) {
+			const uint32_t key = skip_bench_key(skip_bench_rank(&thread->rnd, list->n, list->dist));
+
+			if ((skip_bench_rand(&thread->rnd) % 100) < SKIPLIST_BENCH_INSERT_PCT) {
+				inserted += skip_bench_insert(list, key, &thread->rnd);
+			} else {
+				(void)skip_bench_lookup(list, key, &thread->hops);
+				thread->lookups++;
+			}
+		}
+		thread->ops += 64;
+	}
+	(void)__atomic_fetch_add(&list->inserted, inserted, __ATOMIC_RELAXED);
+	return &nowt;
+}
+
+/*
+ *  skip_bench_verify()
+ *	check level 0 is in key order and holds the expected number of keys
+ */
+static void skip_bench_verify(const stress_args_t *args, skip_bench_t *list, const uint64_t expected)
+{
+	const skip_bench_node_t *node;
+	uint64_t count = 0;
+	uint32_t prev = 0;
+
+	for (node = list->head->next[0]; node; node = node->next[0], count++) {
+		if (UNLIKELY(node->key <= prev)) {
+			pr_fail("%s: skip list key 0x%" PRIx32 " follows key 0x%" PRIx32 "\n",
+				args->name, node->key, prev);
+			return;
+		}
+		prev = node->key;
+	}
+	if (UNLIKELY(count != expected))
+		pr_fail("%s: skip list has %" PRIu64 " keys, expected %" PRIu64 "\n",
+			args->name, count, expected);
+}
+
+/*
+ *  skip_bench_run()
+ *	fill a new skip list with the even ranks and run nthreads threads
+ *	on it for secs seconds
+ */
+static int skip_bench_run(
+	const stress_args_t *args,
+	skip_bench_t *list,
+	skip_bench_thread_t *threads,
+	const size_t nthreads,
+	const int dist,
+	const double secs,
+	skip_bench_result_t *result)
+{
+	const size_t head_size = sizeof(skip_bench_node_t) + (list->max_level * sizeof(skip_bench_node_t *));
+	uint64_t rnd = stress_mwc64() | 1, prefilled = 0;
+	uint32_t rank;
+	size_t i;
+	double t_start;
+
+	list->pool_used = 0;
+	list->head = skip_bench_alloc(list, list->max_level);
+	if (!list->head)
+		return -1;
+	(void)memset(list->head, 0, head_size);
+	list->head->levels = (uint32_t)list->max_level;
+	list->dist = dist;
+	list->start = false;
+	list->stop = false;
+	list->inserted = 0;
+	for (rank = 0; rank < list->n; rank += 2)
+		prefilled += skip_bench_insert(list, skip_bench_key(rank), &rnd);
+
+	for (i = 0; i < nthreads; i++) {
+		threads[i].list = list;
+		threads[i].rnd = stress_mwc64() | 1;
+		threads[i].ops = 0;
+		threads[i].lookups = 0;
+		threads[i].hops = 0;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL, skip_bench_thread, &threads[i]);
+		if (threads[i].ret) {
+			__atomic_store_n(&list->stop, true, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+	t_start = stress_time_now();
+	__atomic_store_n(&list->start, true, __ATOMIC_RELEASE);
+	while (keep_stressing(args) && !__atomic_load_n(&list->stop, __ATOMIC_ACQUIRE) &&
+	       (stress_time_now() < t_start + secs))
+		(void)shim_usleep(10000);
+	__atomic_store_n(&list->stop, true, __ATOMIC_RELEASE);
+
+	for (i = 0; i < nthreads; i++) {
+		if (threads[i].ret)
+			break;
+		(void)pthread_join(threads[i].pthread, NULL);
+		result->ops += (double)threads[i].ops;
+		result->lookups += (double)threads[i].lookups;
+		result->hops += (double)threads[i].hops;
+		add_counter(args, threads[i].ops);
+	}
+	result->secs += stress_time_now() - t_start;
+	if (i < nthreads)
+		return -1;
+	skip_bench_verify(args, list, prefilled + list->inserted);
+	return 0;
+}
+
+/*
+ *  stress_skiplist_bench()
+ *	lookup and insert throughput and pointer hops per lookup of a
+ *	lock free skip list with 1, 2, 4 .. max_threads threads and
+ *	uniform and/or zipf key distributions, the configurations take
+ *	turns for a slice of time so all see the same system conditions
+ */
+static int stress_skiplist_bench(
+	const stress_args_t *args,
+	const uint32_t n,
+	const size_t max_threads,
+	const size_t skiplist_dist)
+{
+	static skip_bench_result_t results[SKIPLIST_DIST_MAX][8];
+	skip_bench_thread_t *threads;
+	skip_bench_t list;
+	size_t nthreads[8], n_nthreads = 0, i, d, idx = 0;
+	const size_t threads_size = sizeof(*threads) * max_threads;
+	bool ran;
+	int rc = EXIT_SUCCESS;
+
+	for (i = 1; (i <= max_threads) && (n_nthreads < SIZEOF_ARRAY(nthreads)); i *= 2)
+		nthreads[n_nthreads++] = i;
+	if (nthreads[n_nthreads - 1] != max_threads) {
+		if (n_nthreads == SIZEOF_ARRAY(nthreads))
+			n_nthreads--;
+		nthreads[n_nthreads++] = max_threads;
+	}
+
+	(void)memset(&list, 0, sizeof(list));
+	list.n = n;
+	list.max_level = STRESS_MINIMUM((size_t)skip_list_ln2(n), (size_t)SKIPLIST_BENCH_MAX_LEVEL);
+	/*
+	 *  at most n nodes of 2 levels on average are inserted, allow for
+	 *  nodes lost to insert races, inserts fail when the pool is used up
+	 */
+	list.pool_size = (size_t)n * (sizeof(skip_bench_node_t) + (4 * sizeof(skip_bench_node_t *)));
+	list.pool = (uint8_t *)mmap(NULL, list.pool_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (list.pool == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte skip list node pool, skipping stressor\n",
+			args->name, list.pool_size);
+		return EXIT_NO_RESOURCE;
+	}
+	threads = (skip_bench_thread_t *)calloc(max_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %zu bytes for threads, skipping stressor\n",
+			args->name, threads_size);
+		(void)munmap((void *)list.pool, list.pool_size);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(results, 0, sizeof(results));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		for (d = SKIPLIST_DIST_UNIFORM; d < SKIPLIST_DIST_MAX; d++) {
+			if ((skiplist_dist != SKIPLIST_DIST_ALL) && (skiplist_dist != d))
+				continue;
+			for (i = 0; (i < n_nthreads) && keep_stressing(args); i++) {
+				if (skip_bench_run(args, &list, threads, nthreads[i], (int)d,
+						   SKIPLIST_BENCH_SLICE, &results[d][i]) < 0) {
+					pr_inf_skip("%s: cannot create %zu threads, skipping stressor\n",
+						args->name, nthreads[i]);
+					rc = EXIT_NO_RESOURCE;
+					goto tidy;
+				}
+				ran = true;
+			}
+		}
+	} while (ran && keep_stressing(args));
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %" PRIu32 " keys, %d%% inserts, %d%% lookups\n", args->name,
+			n, SKIPLIST_BENCH_INSERT_PCT, 100 - SKIPLIST_BENCH_INSERT_PCT);
+		pr_inf("%s: %-8s %7s %12s %8s %12s\n", args->name,
+			"keys", "threads", "ops/sec", "scaling", "hops/lookup");
+	}
+	for (d = SKIPLIST_DIST_UNIFORM; d < SKIPLIST_DIST_MAX; d++) {
+		double rate1 = 0.0;
+
+		for (i = 0; i < n_nthreads; i++) {
+			const skip_bench_result_t *r = &results[d][i];
+			double rate, hops;
+			char str[64];
+
+			if ((r->secs <= 0.0) || (r->ops <= 0.0))
+				continue;
+			rate = r->ops / r->secs;
+			hops = (r->lookups > 0.0) ? r->hops / r->lookups : 0.0;
+			if (i == 0)
+				rate1 = rate;
+			if (args->instance == 0)
+				pr_inf("%s: %-8s %7zu %12.1f %7.2fx %12.2f\n", args->name,
+					skiplist_dists[d], nthreads[i], rate,
+					rate1 > 0.0 ? rate / rate1 : 0.0, hops);
+			(void)snprintf(str, sizeof(str), "%s keys %zu threads ops per sec",
+				skiplist_dists[d], nthreads[i]);
+			stress_metrics_set(args, idx++, str, rate);
+			(void)snprintf(str, sizeof(str), "%s keys %zu threads hops per lookup",
+				skiplist_dists[d], nthreads[i]);
+			stress_metrics_set(args, idx++, str, hops);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+tidy:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	free(threads);
+	(void)munmap((void *)list.pool, list.pool_size);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_skiplist()
  *	stress skiplist
@@ -218,6 +761,27 @@ static int OPTIMIZE3 stress_skiplist(const stress_args_t *args)
 {
 	unsigned long n, i, ln2n;
 	uint64_t skiplist_size = DEFAULT_SKIPLIST_SIZE;
+	stress_arena_t *arena = NULL;
+	bool skiplist_bench = false;
+
+	(void)stress_get_setting("skiplist-bench", &skiplist_bench);
+	if (skiplist_bench) {
+#if defined(STRESS_SKIPLIST_BENCH)
+		size_t skiplist_threads = DEFAULT_SKIPLIST_THREADS;
+		size_t skiplist_dist = SKIPLIST_DIST_ALL;
+
+		skiplist_size = DEFAULT_SKIPLIST_BENCH_SIZE;
+		(void)stress_get_setting("skiplist-size", &skiplist_size);
+		(void)stress_get_setting("skiplist-threads", &skiplist_threads);
+		(void)stress_get_setting("skiplist-dist", &skiplist_dist);
+		return stress_skiplist_bench(args, (uint32_t)skiplist_size,
+			skiplist_threads, skiplist_dist);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --skiplist-bench is not supported on this system, "
+				"defaulting to skiplist stressing\n", args->name);
+#endif
+	}
 
 	if (!stress_get_setting("skiplist-size", &skiplist_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -228,14 +792,24 @@ static int OPTIMIZE3 stress_skiplist(const stress_args_t *args)
 	n = (unsigned long)skiplist_size;
 	ln2n = skip_list_ln2(n);
 
+	if (g_opt_flags & OPT_FLAGS_ARENA) {
+		arena = stress_arena_create(0);
+		if (!arena) {
+			pr_inf_skip("%s: cannot allocate arena, skipping stressor\n",
+				args->name);
+			return EXIT_NO_RESOURCE;
+		}
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
 		skip_list_t list;
 
-		if (!skip_list_init(&list, ln2n)) {
+		if (!skip_list_init(&list, arena, ln2n)) {
 			pr_inf("%s: out of memory initializing the skip list\n",
 				args->name);
+			stress_arena_destroy(arena);
 			return EXIT_NO_RESOURCE;
 		}
 
@@ -246,6 +820,7 @@ static int OPTIMIZE3 stress_skiplist(const stress_args_t *args)
 				pr_inf("%s: out of memory initializing the skip list\n",
 					args->name);
 				skip_list_free(&list);
+				stress_arena_destroy(arena);
 				return EXIT_NO_RESOURCE;
 			}
 		}
@@ -263,12 +838,16 @@ static int OPTIMIZE3 stress_skiplist(const stress_args_t *args)
 	} while (keep_stressing(args));
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_arena_destroy(arena);
 
 	return EXIT_SUCCESS;
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_skiplist_bench,	stress_set_skiplist_bench },
+	{ OPT_skiplist_dist,	stress_set_skiplist_dist },
 	{ OPT_skiplist_size,	stress_set_skiplist_size },
+	{ OPT_skiplist_threads,	stress_set_skiplist_threads },
 	{ 0,			NULL },
 };
 
@@ -18,7 +18,21 @@
  *
  */
 #include "stress-ng.h"
+#include "core-capabilities.h"
+#include "core-latency.h"
 #include "core-net.h"
+#include "core-net-bench.h"
+#include "core-perf.h"
+#include "core-uring.h"
+#include "io-uring.h"
+
+#if defined(HAVE_LINUX_ERRQUEUE_H)
+#include <linux/errqueue.h>
+#endif
+
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
 
 #if defined(HAVE_LINUX_SOCKIOS_H)
 #include <linux/sockios.h>
@@ -53,6 +67,18 @@ UNEXPECTED
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#if defined(HAVE_LINUX_MPTCP_H)
+#include <linux/mptcp.h>
+#endif
+
+#if defined(HAVE_LINUX_NETLINK_H)
+#include <linux/netlink.h>
+#endif
+
+#if defined(HAVE_LINUX_GENETLINK_H)
+#include <linux/genetlink.h>
+#endif
+
 #define MIN_SOCKET_PORT		(1024)
 #define MAX_SOCKET_PORT		(65535)
 #define DEFAULT_SOCKET_PORT	(5000)
@@ -64,6 +90,10 @@ UNEXPECTED
 #define SOCKET_OPT_SENDMSG	(0x01)
 #define SOCKET_OPT_SENDMMSG	(0x02)
 #define SOCKET_OPT_RANDOM	(0x03)
+#define SOCKET_OPT_BULK		(0x04)
+#define SOCKET_OPT_ZEROCOPY	(0x05)
+#define SOCKET_OPT_SPLICE	(0x06)
+#define SOCKET_OPT_URING_ZC	(0x07)
 
 #define SOCKET_OPT_RECV		(SOCKET_OPT_SEND)
 #define SOCKET_OPT_RECVMSG	(SOCKET_OPT_SENDMSG)
@@ -75,22 +105,150 @@ UNEXPECTED
 
 #define MSGVEC_SIZE		(4)
 
+#define SOCK_BULK_CHUNKS	(256)	/* MMAP_BUF_SIZE sends per connection */
+#define SOCK_ZC_MAX_PENDING	(64)	/* outstanding MSG_ZEROCOPY sends */
+#define SOCK_URING_ZC_DEPTH	(8)	/* io_uring SEND_ZC sends in flight */
+
+#if defined(MSG_ZEROCOPY) &&		\
+    defined(SO_ZEROCOPY) &&		\
+    defined(MSG_ERRQUEUE) &&		\
+    defined(HAVE_LINUX_ERRQUEUE_H) &&	\
+    defined(SO_EE_ORIGIN_ZEROCOPY) &&	\
+    defined(SO_EE_CODE_ZEROCOPY_COPIED) && \
+    defined(HAVE_POLL_H)
+#define STRESS_SOCK_MSG_ZEROCOPY
+#endif
+
+#if defined(HAVE_VMSPLICE) &&		\
+    defined(HAVE_SPLICE) &&		\
+    defined(SPLICE_F_MOVE)
+#define STRESS_SOCK_SPLICE
+#endif
+
+#if defined(STRESS_URING) &&		\
+    defined(HAVE_IORING_OP_SEND_ZC) &&	\
+    defined(IORING_CQE_F_MORE) &&	\
+    defined(IORING_CQE_F_NOTIF)
+#define STRESS_SOCK_URING_ZC
+#endif
+
 #define PROC_CONG_CTRLS		"/proc/sys/net/ipv4/tcp_allowed_congestion_control"
 
+#if defined(HAVE_POLL_H)
+#define STRESS_SOCK_PEER
+#endif
+
+#if defined(MSG_NOSIGNAL)
+#define SOCK_PEER_SEND_FLAGS	(MSG_NOSIGNAL)
+#else
+#define SOCK_PEER_SEND_FLAGS	(0)
+#endif
+
+#if !defined(SOL_MPTCP)
+#define SOL_MPTCP		(284)
+#endif
+
+#if defined(IPPROTO_MPTCP)
+#define STRESS_SOCK_MPTCP_BENCH
+#endif
+
+#if defined(STRESS_SOCK_MPTCP_BENCH) &&	\
+    defined(HAVE_LINUX_MPTCP_H) &&	\
+    defined(HAVE_LINUX_NETLINK_H) &&	\
+    defined(HAVE_LINUX_GENETLINK_H) &&	\
+    defined(MPTCP_PM_NAME) &&		\
+    defined(MPTCP_PM_ADDR_FLAG_SUBFLOW)
+#define STRESS_SOCK_MPTCP_PM
+#endif
+
+#define MIN_SOCK_MPTCP_SUBFLOWS	(1)
+#define MAX_SOCK_MPTCP_SUBFLOWS	(8)
+#define DEFAULT_SOCK_MPTCP_SUBFLOWS (2)
+
+#define SOCK_MPTCP_ENDPOINT_ID	(200)	/* id of the first endpoint added */
+#define SOCK_BENCH_SLICE	(1.0)	/* seconds per transport and message size */
+
+#if defined(STRESS_SOCK_MPTCP_PM)
+/* generic netlink request or reply */
+typedef struct {
+	struct nlmsghdr n;
+	struct genlmsghdr g;
+	char data[512];		/* cppcheck-suppress unusedStructMember */
+} stress_sock_nlmsg_t;
+
+/* path manager state saved while endpoints are added */
+typedef struct {
+	int fd;			/* generic netlink socket */
+	uint16_t family;	/* mptcp_pm family id */
+	uint32_t subflows;	/* subflow limit before the benchmark */
+	uint32_t add_addrs;	/* add address limit before the benchmark */
+	uint32_t endpoints;	/* endpoints added */
+} stress_sock_mptcp_pm_t;
+
+/* endpoints added by the parent for all the instances */
+static stress_sock_mptcp_pm_t sock_mptcp_pm = { .fd = -1 };
+#endif
+
+#define MIN_SOCK_PEERS		(1)
+#define MAX_SOCK_PEERS		(4096)
+#define DEFAULT_SOCK_PEERS	(1)
+
+#define SOCK_PEER_POLL_MSEC	(100)	/* control connection poll timeout */
+#define SOCK_PEER_LINE_LEN	(128)	/* control message line length */
+
 typedef struct {
 	const char *optname;
 	const int   optval;
 } stress_sock_options_t;
 
+/*
+ *  bulk send state and sender side costs
+ */
+typedef struct {
+	uint64_t bytes;		/* bytes sent */
+	double duration;	/* time spent sending */
+	double cpu_time;	/* sender CPU time */
+	uint64_t cycles;	/* sender CPU cycles */
+	uint64_t zc_sends;	/* zero copy send completions */
+	uint64_t zc_copied;	/* zero copy sends the kernel copied */
+	int perf_fd;		/* CPU cycles counter, -1 if none */
+	int pipefd[2];		/* splice pipe */
+#if defined(STRESS_SOCK_URING_ZC)
+	stress_uring_t ring;	/* io_uring for SEND_ZC */
+#endif
+} stress_sock_bulk_t;
+
+/*
+ *  remote peer client state, the client results are reported
+ *  to the --sock-server over the control connection
+ */
+typedef struct {
+	char host[64];		/* peer host name */
+	char line[SOCK_PEER_LINE_LEN];	/* partial control message */
+	size_t line_len;	/* bytes in line */
+	int fd;			/* control connection, -1 if closed */
+	uint32_t instance;	/* peer stressor instance */
+	uint64_t bytes;		/* bytes received */
+	uint64_t connections;	/* connections made */
+	double duration;	/* seconds receiving */
+	bool joined;		/* HELLO received */
+	bool reported;		/* STATS received */
+} stress_sock_peer_t;
+
 static const stress_help_t help[] = {
 	{ "S N", "sock N",		"start N workers exercising socket I/O" },
 	{ NULL,	"sock-domain D",	"specify socket domain, default is ipv4" },
 	{ NULL,	"sock-if I",		"use network interface I, e.g. lo, eth0, etc." },
+	{ NULL,	"sock-mptcp-bench",	"compare tcp and mptcp throughput and latency on loopback" },
+	{ NULL,	"sock-mptcp-subflows N", "use N mptcp subflows in the mptcp benchmark" },
 	{ NULL,	"sock-nodelay",		"disable Nagle algorithm, send data immediately" },
 	{ NULL,	"sock-ops N",		"stop after N socket bogo operations" },
-	{ NULL,	"sock-opts option", 	"socket options [send|sendmsg|sendmmsg]" },
+	{ NULL,	"sock-opts option", 	"socket options [send|sendmsg|sendmmsg|bulk|zerocopy|splice|uring-zc]" },
+	{ NULL,	"sock-peer H",		"receive from a --sock-server on remote host H" },
+	{ NULL,	"sock-peers N",		"server waits for N remote peer instances before starting" },
 	{ NULL,	"sock-port P",		"use socket ports P to P + number of workers - 1" },
 	{ NULL, "sock-protocol",	"use socket protocol P, default is tcp, can be mptcp" },
+	{ NULL,	"sock-server",		"serve remote --sock-peer clients instead of a local client" },
 	{ NULL,	"sock-type T",		"socket type (stream, seqpacket)" },
 	{ NULL, "sock-zerocopy",	"enable zero copy sends" },
 	{ NULL,	NULL,			NULL }
@@ -138,6 +296,16 @@ static int stress_set_sock_opts(const char *opt)
 		{ "sendmmsg",	SOCKET_OPT_SENDMMSG },
 #else
 		UNEXPECTED
+#endif
+		{ "bulk",	SOCKET_OPT_BULK },
+#if defined(STRESS_SOCK_MSG_ZEROCOPY)
+		{ "zerocopy",	SOCKET_OPT_ZEROCOPY },
+#endif
+#if defined(STRESS_SOCK_SPLICE)
+		{ "splice",	SOCKET_OPT_SPLICE },
+#endif
+#if defined(STRESS_SOCK_URING_ZC)
+		{ "uring-zc",	SOCKET_OPT_URING_ZC },
 #endif
 		{ NULL,		0 }
 	};
@@ -182,6 +350,41 @@ static int stress_set_sock_if(const char *name)
 	return stress_set_setting("sock-if", TYPE_ID_STR, name);
 }
 
+static int stress_set_sock_peer(const char *host)
+{
+	return stress_set_setting("sock-peer", TYPE_ID_STR, host);
+}
+
+static int stress_set_sock_peers(const char *opt)
+{
+	uint32_t sock_peers;
+
+	sock_peers = stress_get_uint32(opt);
+	stress_check_range("sock-peers", (uint64_t)sock_peers,
+		MIN_SOCK_PEERS, MAX_SOCK_PEERS);
+	return stress_set_setting("sock-peers", TYPE_ID_UINT32, &sock_peers);
+}
+
+static int stress_set_sock_mptcp_bench(const char *opt)
+{
+	return stress_set_setting_true("sock-mptcp-bench", opt);
+}
+
+static int stress_set_sock_mptcp_subflows(const char *opt)
+{
+	uint32_t sock_mptcp_subflows;
+
+	sock_mptcp_subflows = stress_get_uint32(opt);
+	stress_check_range("sock-mptcp-subflows", (uint64_t)sock_mptcp_subflows,
+		MIN_SOCK_MPTCP_SUBFLOWS, MAX_SOCK_MPTCP_SUBFLOWS);
+	return stress_set_setting("sock-mptcp-subflows", TYPE_ID_UINT32, &sock_mptcp_subflows);
+}
+
+static int stress_set_sock_server(const char *opt)
+{
+	return stress_set_setting_true("sock-server", opt);
+}
+
 /*
  *  stress_set_sock_protocol()
  *	parse --sock-protocol
@@ -451,7 +654,10 @@ static int OPTIMIZE3 stress_sock_client(
 	const int sock_port,
 	const char *sock_if,
 	const bool rt,
-	const bool sock_zerocopy)
+	const bool sock_zerocopy,
+	const struct sockaddr_storage *peer_addr,
+	const socklen_t peer_addr_len,
+	stress_sock_peer_t *peer)
 {
 	struct sockaddr *addr;
 	size_t n_ctrls;
@@ -500,7 +706,10 @@ retry:
 			goto free_controls;
 		}
 
-		if (stress_set_sockaddr_if(args->name, args->instance, mypid,
+		if (peer_addr) {
+			addr = (struct sockaddr *)(uintptr_t)peer_addr;
+			addr_len = peer_addr_len;
+		} else if (stress_set_sockaddr_if(args->name, args->instance, mypid,
 				sock_domain, sock_port, sock_if,
 				&addr, &addr_len, NET_ADDR_ANY) < 0) {
 			(void)close(fd);
@@ -514,8 +723,15 @@ retry:
 			retries++;
 			if (retries > 100) {
 				/* Give up.. */
-				pr_fail("%s: connect failed, errno=%d (%s)\n",
-					args->name, errno_tmp, strerror(errno_tmp));
+				if (peer) {
+					/* the remote server has stopped */
+					pr_inf("%s: connect to peer failed, errno=%d (%s), stopping\n",
+						args->name, errno_tmp, strerror(errno_tmp));
+					rc = EXIT_SUCCESS;
+				} else {
+					pr_fail("%s: connect failed, errno=%d (%s)\n",
+						args->name, errno_tmp, strerror(errno_tmp));
+				}
 				goto free_controls;
 			}
 			goto retry;
@@ -771,6 +987,13 @@ retry:
 				recvfunc = "recv";
 				n = recv(fd, buf, MMAP_IO_SIZE, recvflag);
 				break;
+			case SOCKET_OPT_BULK:
+			case SOCKET_OPT_ZEROCOPY:
+			case SOCKET_OPT_SPLICE:
+			case SOCKET_OPT_URING_ZC:
+				recvfunc = "recv";
+				n = recv(fd, buf, MMAP_BUF_SIZE, 0);
+				break;
 			case SOCKET_OPT_RECVMSG:
 				recvfunc = "recvmsg";
 				for (j = 0, i = 16; i < MMAP_IO_SIZE; i += 16, j++) {
@@ -811,9 +1034,15 @@ retry:
 						errno, strerror(errno));
 				break;
 			}
+			if (peer)
+				peer->bytes += (uint64_t)n;
 			count++;
 		} while (keep_stressing(args));
 
+		if (peer) {
+			peer->connections++;
+			inc_counter(args);
+		}
 		stress_sock_ioctl(fd, sock_domain, rt);
 #if defined(AF_INET) && 	\
     defined(IPPROTO_IP)	&&	\
@@ -854,6 +1083,475 @@ static bool stress_send_error(const int err)
 		(err != ECONNRESET));
 }
 
+/*
+ *  stress_sock_bulk_mode()
+ *	true if opt is one of the MMAP_BUF_SIZE bulk send modes
+ */
+static inline bool stress_sock_bulk_mode(const int opt)
+{
+	return (opt >= SOCKET_OPT_BULK) && (opt <= SOCKET_OPT_URING_ZC);
+}
+
+/*
+ *  stress_sock_cpu_time()
+ *	user and system time of the sender
+ */
+static double stress_sock_cpu_time(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return stress_timeval_to_double(&usage.ru_utime) +
+	       stress_timeval_to_double(&usage.ru_stime);
+}
+
+/*
+ *  stress_sock_bulk_init()
+ *	set up the cycle counter, splice pipe or io_uring
+ *	for a bulk send mode
+ */
+static int stress_sock_bulk_init(
+	const stress_args_t *args,
+	stress_sock_bulk_t *bulk,
+	const int opt)
+{
+	(void)memset(bulk, 0, sizeof(*bulk));
+	bulk->perf_fd = -1;
+	bulk->pipefd[0] = -1;
+	bulk->pipefd[1] = -1;
+#if defined(STRESS_SOCK_URING_ZC)
+	bulk->ring.fd = -1;
+#endif
+	if (!stress_sock_bulk_mode(opt))
+		return EXIT_SUCCESS;
+
+	bulk->perf_fd = stress_perf_cycles_open();
+	if ((bulk->perf_fd < 0) && (args->instance == 0))
+		pr_dbg("%s: CPU cycles counter not available, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+
+	switch (opt) {
+#if defined(STRESS_SOCK_SPLICE)
+	case SOCKET_OPT_SPLICE:
+		if (pipe(bulk->pipefd) < 0) {
+			pr_inf_skip("%s: pipe failed, errno=%d (%s), skipping stressor\n",
+				args->name, errno, strerror(errno));
+			bulk->pipefd[0] = -1;
+			bulk->pipefd[1] = -1;
+			return EXIT_NO_RESOURCE;
+		}
+#if defined(F_SETPIPE_SZ)
+		VOID_RET(int, fcntl(bulk->pipefd[1], F_SETPIPE_SZ, MMAP_BUF_SIZE));
+#endif
+		break;
+#endif
+#if defined(STRESS_SOCK_URING_ZC)
+	case SOCKET_OPT_URING_ZC:
+		return stress_uring_setup(args, &bulk->ring, SOCK_URING_ZC_DEPTH * 2);
+#endif
+	default:
+		break;
+	}
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_sock_bulk_free()
+ *	free resources from stress_sock_bulk_init()
+ */
+static void stress_sock_bulk_free(stress_sock_bulk_t *bulk)
+{
+	if (bulk->perf_fd >= 0)
+		(void)close(bulk->perf_fd);
+	if (bulk->pipefd[0] >= 0)
+		(void)close(bulk->pipefd[0]);
+	if (bulk->pipefd[1] >= 0)
+		(void)close(bulk->pipefd[1]);
+#if defined(STRESS_SOCK_URING_ZC)
+	if (bulk->ring.fd >= 0)
+		stress_uring_close(&bulk->ring);
+#endif
+}
+
+#if defined(STRESS_SOCK_MSG_ZEROCOPY)
+/*
+ *  stress_sock_zerocopy_reap()
+ *	reap MSG_ZEROCOPY completion notifications from the socket
+ *	error queue, returns the number of sends completed
+ */
+static uint32_t stress_sock_zerocopy_reap(const int fd, stress_sock_bulk_t *bulk)
+{
+	uint32_t completed = 0;
+
+	for (;;) {
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+		char ALIGN64 control[128];
+
+		(void)memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			const struct sock_extended_err *serr =
+				(const struct sock_extended_err *)CMSG_DATA(cmsg);
+			uint32_t n;
+
+			if (cmsg->cmsg_len < CMSG_LEN(sizeof(*serr)))
+				continue;
+			if ((serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) || serr->ee_errno)
+				continue;
+			/* ee_info..ee_data is the range of completed sends */
+			n = serr->ee_data - serr->ee_info + 1;
+			completed += n;
+			bulk->zc_sends += n;
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				bulk->zc_copied += n;
+		}
+	}
+	return completed;
+}
+
+/*
+ *  stress_sock_zerocopy_wait()
+ *	wait a while for the error queue to become readable
+ *	and reap the completions
+ */
+static uint32_t stress_sock_zerocopy_wait(const int fd, stress_sock_bulk_t *bulk)
+{
+	struct pollfd pfd;
+
+	/* POLLERR is always reported, no events need to be requested */
+	pfd.fd = fd;
+	pfd.events = 0;
+	pfd.revents = 0;
+	(void)poll(&pfd, 1, 100);
+
+	return stress_sock_zerocopy_reap(fd, bulk);
+}
+
+/*
+ *  stress_sock_send_zerocopy()
+ *	MSG_ZEROCOPY sends, the buffer pages are pinned until the
+ *	completion is reaped from the error queue so the number
+ *	of outstanding sends is bounded and all are reaped before
+ *	the buffer is reused
+ */
+static int stress_sock_send_zerocopy(
+	const stress_args_t *args,
+	const int sfd,
+	char *buf,
+	stress_sock_bulk_t *bulk)
+{
+	const int one = 1;
+	uint32_t sent = 0, completed = 0;
+	int i = 0, tries, rc = EXIT_SUCCESS;
+
+	if (setsockopt(sfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+		pr_inf_skip("%s: cannot enable SO_ZEROCOPY, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+
+	while ((i < SOCK_BULK_CHUNKS) && keep_stressing_flag()) {
+		ssize_t ret;
+
+		if (sent - completed >= SOCK_ZC_MAX_PENDING)
+			completed += stress_sock_zerocopy_wait(sfd, bulk);
+
+		ret = send(sfd, buf, MMAP_BUF_SIZE, MSG_ZEROCOPY);
+		if (UNLIKELY(ret < 0)) {
+			/* out of optmem for pinned pages, reap and retry */
+			if (errno == ENOBUFS) {
+				completed += stress_sock_zerocopy_wait(sfd, bulk);
+				continue;
+			}
+			if (stress_send_error(errno)) {
+				pr_fail("%s: send MSG_ZEROCOPY failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_FAILURE;
+			}
+			break;
+		}
+		sent++;
+		i++;
+		bulk->bytes += (uint64_t)ret;
+		completed += stress_sock_zerocopy_reap(sfd, bulk);
+	}
+
+	for (tries = 0; (completed < sent) && (tries < 100); tries++)
+		completed += stress_sock_zerocopy_wait(sfd, bulk);
+
+	return rc;
+}
+#endif
+
+#if defined(STRESS_SOCK_SPLICE)
+/*
+ *  stress_sock_send_splice()
+ *	vmsplice the buffer pages into a pipe and splice them
+ *	from the pipe to the socket
+ */
+static int stress_sock_send_splice(
+	const stress_args_t *args,
+	const int sfd,
+	char *buf,
+	stress_sock_bulk_t *bulk)
+{
+	int i;
+
+	for (i = 0; (i < SOCK_BULK_CHUNKS) && keep_stressing_flag(); i++) {
+		size_t offset = 0;
+
+		while (offset < MMAP_BUF_SIZE) {
+			struct iovec iov;
+			ssize_t n;
+
+			iov.iov_base = buf + offset;
+			iov.iov_len = MMAP_BUF_SIZE - offset;
+			n = vmsplice(bulk->pipefd[1], &iov, 1, 0);
+			if (UNLIKELY(n < 0)) {
+				if (errno == EINTR)
+					return EXIT_SUCCESS;
+				pr_fail("%s: vmsplice failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				return EXIT_FAILURE;
+			}
+			offset += (size_t)n;
+
+			while (n > 0) {
+				const ssize_t ret = splice(bulk->pipefd[0], NULL,
+					sfd, NULL, (size_t)n, SPLICE_F_MOVE);
+
+				if (UNLIKELY(ret <= 0)) {
+					if ((ret < 0) && stress_send_error(errno)) {
+						pr_fail("%s: splice failed, errno=%d (%s)\n",
+							args->name, errno, strerror(errno));
+						return EXIT_FAILURE;
+					}
+					/*
+					 *  peer has gone, discard what is left in
+					 *  the pipe by replacing it
+					 */
+					(void)close(bulk->pipefd[0]);
+					(void)close(bulk->pipefd[1]);
+					if (pipe(bulk->pipefd) < 0) {
+						bulk->pipefd[0] = -1;
+						bulk->pipefd[1] = -1;
+						pr_fail("%s: pipe failed, errno=%d (%s)\n",
+							args->name, errno, strerror(errno));
+						return EXIT_FAILURE;
+					}
+					return EXIT_SUCCESS;
+				}
+				n -= ret;
+				bulk->bytes += (uint64_t)ret;
+			}
+		}
+	}
+	return EXIT_SUCCESS;
+}
+#endif
+
+#if defined(STRESS_SOCK_URING_ZC)
+/*
+ *  stress_sock_send_uring_zc()
+ *	io_uring SEND_ZC sends, each send completes with a result
+ *	cqe flagged IORING_CQE_F_MORE followed by a notification
+ *	cqe when the kernel has released the buffer pages
+ */
+static int stress_sock_send_uring_zc(
+	const stress_args_t *args,
+	const int sfd,
+	char *buf,
+	stress_sock_bulk_t *bulk)
+{
+	stress_uring_t *ring = &bulk->ring;
+	unsigned int queued = 0, sends = 0, notifs = 0, pending = 0;
+	bool running = true;
+	int rc = EXIT_SUCCESS;
+
+	for (;;) {
+		unsigned tail = *ring->sq_tail;
+		unsigned head;
+		int ret;
+
+		while (running && (sends < SOCK_URING_ZC_DEPTH) &&
+		       (queued < SOCK_BULK_CHUNKS)) {
+			const unsigned idx = tail & *ring->sq_mask;
+			struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+			(void)memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_SEND_ZC;
+			sqe->fd = sfd;
+			sqe->addr = (uintptr_t)buf;
+			sqe->len = MMAP_BUF_SIZE;
+#if defined(IORING_SEND_ZC_REPORT_USAGE)
+			sqe->ioprio = IORING_SEND_ZC_REPORT_USAGE;
+#endif
+			ring->sq_array[idx] = idx;
+			tail++;
+			pending++;
+			sends++;
+			queued++;
+		}
+		shim_mb();
+		*ring->sq_tail = tail;
+		shim_mb();
+
+		if (!sends && !notifs)
+			break;
+		ret = stress_uring_enter(ring, pending, 1);
+		if (ret < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+				continue;
+			pr_fail("%s: io_uring_enter failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		pending -= ((unsigned int)ret > pending) ? pending : (unsigned int)ret;
+
+		head = *ring->cq_head;
+		for (;;) {
+			const struct io_uring_cqe *cqe;
+
+			shim_mb();
+			if (head == *ring->cq_tail)
+				break;
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			if (cqe->flags & IORING_CQE_F_NOTIF) {
+				notifs--;
+				bulk->zc_sends++;
+#if defined(IORING_NOTIF_USAGE_ZC_COPIED)
+				if ((uint32_t)cqe->res & IORING_NOTIF_USAGE_ZC_COPIED)
+					bulk->zc_copied++;
+#endif
+			} else {
+				sends--;
+				if (cqe->flags & IORING_CQE_F_MORE)
+					notifs++;
+				if (cqe->res < 0) {
+					const int err = -cqe->res;
+
+					if ((err == EOPNOTSUPP) || (err == EINVAL)) {
+						if (rc == EXIT_SUCCESS)
+							pr_inf_skip("%s: io_uring SEND_ZC not supported, "
+								"errno=%d (%s), skipping stressor\n",
+								args->name, err, strerror(err));
+						rc = EXIT_NOT_IMPLEMENTED;
+					} else if (stress_send_error(err) && (rc == EXIT_SUCCESS)) {
+						pr_fail("%s: io_uring SEND_ZC failed, errno=%d (%s)\n",
+							args->name, err, strerror(err));
+						rc = EXIT_FAILURE;
+					}
+					running = false;
+				} else {
+					bulk->bytes += (uint64_t)cqe->res;
+				}
+			}
+			head++;
+		}
+		*ring->cq_head = head;
+		shim_mb();
+
+		if (!keep_stressing_flag())
+			running = false;
+	}
+	return rc;
+}
+#endif
+
+/*
+ *  stress_sock_send_bulk()
+ *	send SOCK_BULK_CHUNKS buffers of MMAP_BUF_SIZE bytes with
+ *	the given bulk mode, accounting the time and sender CPU cost
+ */
+static int stress_sock_send_bulk(
+	const stress_args_t *args,
+	const int sfd,
+	char *buf,
+	const int opt,
+	stress_sock_bulk_t *bulk)
+{
+	uint64_t c_start = 0, c_end = 0;
+	const bool cycles = stress_perf_counter_read(bulk->perf_fd, &c_start);
+	const double cpu_start = stress_sock_cpu_time();
+	const double t_start = stress_time_now();
+	int i, rc = EXIT_SUCCESS;
+
+	switch (opt) {
+	case SOCKET_OPT_BULK:
+		for (i = 0; (i < SOCK_BULK_CHUNKS) && keep_stressing_flag(); i++) {
+			const ssize_t ret = send(sfd, buf, MMAP_BUF_SIZE, 0);
+
+			if (UNLIKELY(ret < 0)) {
+				if (stress_send_error(errno)) {
+					pr_fail("%s: send failed, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+					rc = EXIT_FAILURE;
+				}
+				break;
+			}
+			bulk->bytes += (uint64_t)ret;
+		}
+		break;
+#if defined(STRESS_SOCK_MSG_ZEROCOPY)
+	case SOCKET_OPT_ZEROCOPY:
+		rc = stress_sock_send_zerocopy(args, sfd, buf, bulk);
+		break;
+#endif
+#if defined(STRESS_SOCK_SPLICE)
+	case SOCKET_OPT_SPLICE:
+		rc = stress_sock_send_splice(args, sfd, buf, bulk);
+		break;
+#endif
+#if defined(STRESS_SOCK_URING_ZC)
+	case SOCKET_OPT_URING_ZC:
+		rc = stress_sock_send_uring_zc(args, sfd, buf, bulk);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	bulk->duration += stress_time_now() - t_start;
+	bulk->cpu_time += stress_sock_cpu_time() - cpu_start;
+	if (cycles && stress_perf_counter_read(bulk->perf_fd, &c_end))
+		bulk->cycles += c_end - c_start;
+
+	return rc;
+}
+
+/*
+ *  stress_sock_bulk_metrics()
+ *	report bulk mode throughput and sender CPU cost per byte
+ */
+static void stress_sock_bulk_metrics(
+	const stress_args_t *args,
+	const stress_sock_bulk_t *bulk)
+{
+	const double bytes = (double)bulk->bytes;
+	size_t idx = 0;
+
+	if ((bulk->bytes == 0) || (bulk->duration <= 0.0))
+		return;
+
+	stress_metrics_set(args, idx++, "MB per sec sent",
+		(bytes / bulk->duration) / (double)MB);
+	stress_metrics_set(args, idx++, "sender CPU nanosecs per KB",
+		(bulk->cpu_time * STRESS_DBL_NANOSECOND * (double)KB) / bytes);
+	if (bulk->perf_fd >= 0)
+		stress_metrics_set(args, idx++, "sender CPU cycles per byte",
+			(double)bulk->cycles / bytes);
+	if (bulk->zc_sends)
+		stress_metrics_set(args, idx++, "percent of zero copy sends copied",
+			100.0 * (double)bulk->zc_copied / (double)bulk->zc_sends);
+}
+
 /*
  *  stress_sock_server()
  *	server writer
@@ -882,6 +1580,7 @@ static int OPTIMIZE3 stress_sock_server(
 	void *ptr = MAP_FAILED;
 	const pid_t self = getpid();
 	int sendflag = 0;
+	stress_sock_bulk_t bulk;
 
 #if defined(MSG_ZEROCOPY)
 	if (sock_zerocopy)
@@ -889,6 +1588,10 @@ static int OPTIMIZE3 stress_sock_server(
 #else
 	(void)sock_zerocopy;
 #endif
+	rc = stress_sock_bulk_init(args, &bulk, sock_opts);
+	if (rc != EXIT_SUCCESS)
+		goto die;
+
 	if (stress_sig_stop_stressing(args->name, SIGALRM) < 0) {
 		rc = EXIT_FAILURE;
 		goto die;
@@ -965,6 +1668,7 @@ static int OPTIMIZE3 stress_sock_server(
 			struct sockaddr saddr;
 			socklen_t len;
 			int sndbuf, opt;
+			uint64_t t_lat;
 			struct msghdr ALIGN64 msg;
 			struct iovec ALIGN64 vec[MMAP_IO_SIZE / 16];
 #if defined(HAVE_SENDMMSG)
@@ -1038,6 +1742,7 @@ static int OPTIMIZE3 stress_sock_server(
 			else
 				opt = sock_opts;
 
+			t_lat = stress_latency_begin(args);
 			switch (opt) {
 			case SOCKET_OPT_SEND:
 				for (i = 16; i < MMAP_IO_SIZE; i += 16) {
@@ -1084,12 +1789,24 @@ static int OPTIMIZE3 stress_sock_server(
 					msgs += (MSGVEC_SIZE * j);
 				break;
 #endif
+			case SOCKET_OPT_BULK:
+			case SOCKET_OPT_ZEROCOPY:
+			case SOCKET_OPT_SPLICE:
+			case SOCKET_OPT_URING_ZC:
+				rc = stress_sock_send_bulk(args, sfd, buf, opt, &bulk);
+				if (rc != EXIT_SUCCESS) {
+					(void)close(sfd);
+					goto die_close;
+				}
+				break;
 			default:
 				/* Should never happen */
 				pr_err("%s: bad option %d\n", args->name, sock_opts);
 				(void)close(sfd);
 				goto die_close;
 			}
+			stress_latency_end(args, t_lat);
+
 			if (UNLIKELY(getpeername(sfd, &saddr, &len) < 0)) {
 				if (errno != ENOTCONN)
 					pr_fail("%s: getpeername failed, errno=%d (%s)\n",
@@ -1137,10 +1854,345 @@ die:
 		(void)shim_waitpid(pid, &status, 0);
 	}
 	pr_dbg("%s: %" PRIu64 " messages sent\n", args->name, msgs);
+	if (rc == EXIT_SUCCESS)
+		stress_sock_bulk_metrics(args, &bulk);
+	stress_sock_bulk_free(&bulk);
+
+	return rc;
+}
+
+#if defined(STRESS_SOCK_PEER)
+/*
+ *  stress_sock_peer_send()
+ *	send a control message, returns -1 if failed
+ */
+static int stress_sock_peer_send(const int fd, const char *msg)
+{
+	const size_t len = strlen(msg);
 
+	return (send(fd, msg, len, SOCK_PEER_SEND_FLAGS) == (ssize_t)len) ? 0 : -1;
+}
+
+/*
+ *  stress_sock_peer_line()
+ *	read control data into the peer line buffer, returns a pointer
+ *	to the next complete line or NULL if there is none yet, *closed
+ *	is set to true if the connection has closed
+ */
+static char *stress_sock_peer_line(stress_sock_peer_t *peer, bool *closed)
+{
+	char *nl;
+	ssize_t n;
+
+	nl = memchr(peer->line, '\n', peer->line_len);
+	if (!nl) {
+		if (peer->line_len >= sizeof(peer->line) - 1)
+			peer->line_len = 0;	/* overlong, drop it */
+		n = recv(peer->fd, peer->line + peer->line_len,
+			sizeof(peer->line) - 1 - peer->line_len, MSG_DONTWAIT);
+		if (n == 0) {
+			*closed = true;
+			return NULL;
+		}
+		if (n < 0) {
+			if ((errno != EAGAIN) && (errno != EINTR))
+				*closed = true;
+			return NULL;
+		}
+		peer->line_len += (size_t)n;
+		nl = memchr(peer->line, '\n', peer->line_len);
+		if (!nl)
+			return NULL;
+	}
+	*nl = '\0';
+	return peer->line;
+}
+
+/*
+ *  stress_sock_peer_consume()
+ *	drop the line returned by stress_sock_peer_line()
+ */
+static void stress_sock_peer_consume(stress_sock_peer_t *peer)
+{
+	const size_t len = strlen(peer->line) + 1;
+
+	peer->line_len -= len;
+	(void)memmove(peer->line, peer->line + len, peer->line_len);
+}
+
+/*
+ *  stress_sock_peer_control()
+ *	--sock-server control connection handler, wait for sock_peers
+ *	remote client instances to send HELLO, send them all START, then
+ *	collect their STATS and stop the run once all have reported
+ */
+static void stress_sock_peer_control(
+	const stress_args_t *args,
+	const int sock_domain,
+	const int ctrl_port,
+	const char *sock_if,
+	const uint32_t sock_peers,
+	stress_sock_peer_t *peers,
+	const pid_t stress_ng_pid)
+{
+	struct pollfd *pfds;
+	struct sockaddr *addr;
+	socklen_t addr_len;
+	int fd, so_reuseaddr = 1;
+	uint32_t i, n = 0, joined = 0, done = 0;
+	bool started = false;
+
+	stress_parent_died_alarm();
+	if (stress_sig_stop_stressing(args->name, SIGALRM) < 0)
+		return;
+
+	pfds = calloc((size_t)sock_peers + 1, sizeof(*pfds));
+	if (!pfds)
+		return;
+	fd = socket(sock_domain, SOCK_STREAM, 0);
+	if (fd < 0) {
+		pr_fail("%s: control socket failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto free_pfds;
+	}
+	(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &so_reuseaddr, sizeof(so_reuseaddr));
+	if ((stress_set_sockaddr_if(args->name, args->instance, getppid(),
+			sock_domain, ctrl_port, sock_if, &addr, &addr_len, NET_ADDR_ANY) < 0) ||
+	    (bind(fd, addr, addr_len) < 0) ||
+	    (listen(fd, SOMAXCONN) < 0)) {
+		pr_fail("%s: cannot listen on control port %d, errno=%d (%s)\n",
+			args->name, ctrl_port, errno, strerror(errno));
+		goto close_fd;
+	}
+	pr_inf("%s: waiting for %" PRIu32 " remote peer instance%s on control port %d\n",
+		args->name, sock_peers, sock_peers == 1 ? "" : "s", ctrl_port);
+
+	while (keep_stressing_flag() && (done < sock_peers)) {
+		nfds_t nfds = 0;
+
+		if (n < sock_peers) {
+			pfds[nfds].fd = fd;
+			pfds[nfds++].events = POLLIN;
+		}
+		for (i = 0; i < n; i++) {
+			pfds[nfds].fd = peers[i].fd;
+			pfds[nfds++].events = POLLIN;
+		}
+		if (poll(pfds, nfds, SOCK_PEER_POLL_MSEC) <= 0)
+			continue;
+
+		if ((n < sock_peers) && (pfds[0].revents & POLLIN)) {
+			const int sfd = accept(fd, NULL, NULL);
+
+			if (sfd >= 0) {
+				(void)memset(&peers[n], 0, sizeof(peers[n]));
+				peers[n].fd = sfd;
+				n++;
+			}
+		}
+
+		for (i = 0; i < n; i++) {
+			stress_sock_peer_t *peer = &peers[i];
+			bool closed = false;
+			const char *line;
+
+			if (peer->fd < 0)
+				continue;
+			while ((line = stress_sock_peer_line(peer, &closed)) != NULL) {
+				if (sscanf(line, "HELLO %" SCNu32 " %63s",
+					   &peer->instance, peer->host) == 2) {
+					peer->joined = true;
+					joined++;
+					pr_inf("%s: peer %s instance %" PRIu32 " joined, %" PRIu32 " of %" PRIu32 "\n",
+						args->name, peer->host, peer->instance, joined, sock_peers);
+				} else if (sscanf(line, "STATS %" SCNu64 " %" SCNu64 " %lf",
+					   &peer->bytes, &peer->connections, &peer->duration) == 3) {
+					peer->reported = true;
+				}
+				stress_sock_peer_consume(peer);
+			}
+			if (closed || peer->reported) {
+				(void)close(peer->fd);
+				peer->fd = -1;
+				done++;
+			}
+		}
+
+		if (!started && (joined == sock_peers)) {
+			pr_inf("%s: all peers joined, starting\n", args->name);
+			for (i = 0; i < n; i++) {
+				if (peers[i].fd >= 0)
+					(void)stress_sock_peer_send(peers[i].fd, "START\n");
+			}
+			started = true;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		if (peers[i].fd >= 0)
+			(void)close(peers[i].fd);
+	}
+	/*
+	 *  all peers have finished, stop the run as if it was interrupted
+	 *  so every server instance stops with the remote clients
+	 */
+	if (done == sock_peers) {
+		int32_t j;
+
+		pr_inf("%s: all peers finished, stopping\n", args->name);
+		for (j = 0; j < g_stressor_current->num_instances; j++) {
+			const pid_t pid = g_stressor_current->stats[j]->pid;
+
+			if (pid > 0)
+				(void)kill(pid, SIGINT);
+		}
+		(void)kill(stress_ng_pid, SIGINT);
+	}
+close_fd:
+	(void)close(fd);
+free_pfds:
+	free(pfds);
+}
+
+/*
+ *  stress_sock_peer_report()
+ *	report the results of the remote peers
+ */
+static void stress_sock_peer_report(
+	const stress_args_t *args,
+	const stress_sock_peer_t *peers,
+	const uint32_t sock_peers)
+{
+	double rate = 0.0;
+	uint64_t connections = 0;
+	uint32_t i, reported = 0;
+
+	for (i = 0; i < sock_peers; i++) {
+		const stress_sock_peer_t *peer = &peers[i];
+
+		if (!peer->reported || (peer->duration <= 0.0))
+			continue;
+		pr_inf("%s: peer %s instance %" PRIu32 ": %.2f MB/s received, %" PRIu64 " connections\n",
+			args->name, peer->host, peer->instance,
+			((double)peer->bytes / peer->duration) / (double)MB, peer->connections);
+		rate += ((double)peer->bytes / peer->duration) / (double)MB;
+		connections += peer->connections;
+		reported++;
+	}
+	pr_inf("%s: %" PRIu32 " of %" PRIu32 " peers reported, %.2f MB/s aggregate, %" PRIu64 " connections\n",
+		args->name, reported, sock_peers, rate, connections);
+	stress_metrics_set(args, 0, "peers reported", (double)reported);
+	stress_metrics_set(args, 1, "peer aggregate MB per sec received", rate);
+}
+
+/*
+ *  stress_sock_peer()
+ *	--sock-peer client, join the remote server over the control
+ *	connection, wait for all the peers to join, receive from the
+ *	server and report the results back to it
+ */
+static int stress_sock_peer(
+	const stress_args_t *args,
+	char *buf,
+	const pid_t mypid,
+	const int sock_opts,
+	const int sock_domain,
+	const int sock_type,
+	const int sock_protocol,
+	const int sock_port,
+	const int ctrl_port,
+	const char *sock_peer,
+	const bool rt,
+	const bool sock_zerocopy)
+{
+	struct sockaddr_storage ctrl_addr, peer_addr;
+	socklen_t ctrl_addr_len, peer_addr_len;
+	stress_sock_peer_t peer;
+	char msg[SOCK_PEER_LINE_LEN], host[64];
+	double t;
+	int rc;
+
+	if ((stress_net_peer_addr(args->name, sock_peer, sock_domain, ctrl_port,
+				  &ctrl_addr, &ctrl_addr_len) < 0) ||
+	    (stress_net_peer_addr(args->name, sock_peer, sock_domain, sock_port,
+				  &peer_addr, &peer_addr_len) < 0))
+		return EXIT_NO_RESOURCE;
+
+	(void)memset(&peer, 0, sizeof(peer));
+	peer.fd = -1;
+	while (keep_stressing_flag()) {
+		peer.fd = socket(sock_domain, SOCK_STREAM, 0);
+		if (peer.fd < 0) {
+			pr_fail("%s: control socket failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		if (connect(peer.fd, (struct sockaddr *)&ctrl_addr, ctrl_addr_len) == 0)
+			break;
+		(void)close(peer.fd);
+		peer.fd = -1;
+		(void)shim_usleep(SOCK_PEER_POLL_MSEC * 1000);
+	}
+	if (peer.fd < 0)
+		return EXIT_SUCCESS;
+
+	if (gethostname(host, sizeof(host)) < 0)
+		(void)shim_strlcpy(host, "unknown", sizeof(host));
+	host[sizeof(host) - 1] = '\0';
+	(void)snprintf(msg, sizeof(msg), "HELLO %" PRIu32 " %s\n", args->instance, host);
+	if (stress_sock_peer_send(peer.fd, msg) < 0) {
+		pr_fail("%s: control send to peer %s failed, errno=%d (%s)\n",
+			args->name, sock_peer, errno, strerror(errno));
+		(void)close(peer.fd);
+		return EXIT_FAILURE;
+	}
+
+	/* wait for all the peers to join */
+	for (;;) {
+		struct pollfd pfd;
+		bool closed = false;
+		const char *line;
+
+		if (!keep_stressing_flag()) {
+			(void)close(peer.fd);
+			return EXIT_SUCCESS;
+		}
+		pfd.fd = peer.fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, SOCK_PEER_POLL_MSEC) <= 0)
+			continue;
+		line = stress_sock_peer_line(&peer, &closed);
+		if (line && !strcmp(line, "START"))
+			break;
+		if (line)
+			stress_sock_peer_consume(&peer);
+		if (closed) {
+			pr_inf("%s: peer %s closed the control connection before starting\n",
+				args->name, sock_peer);
+			(void)close(peer.fd);
+			return EXIT_NO_RESOURCE;
+		}
+	}
+
+	t = stress_time_now();
+	rc = stress_sock_client(args, buf, mypid, sock_opts, sock_domain,
+		sock_type, sock_protocol, sock_port, NULL, rt, sock_zerocopy,
+		&peer_addr, peer_addr_len, &peer);
+	peer.duration = stress_time_now() - t;
+
+	(void)snprintf(msg, sizeof(msg), "STATS %" PRIu64 " %" PRIu64 " %.6f\n",
+		peer.bytes, peer.connections, peer.duration);
+	(void)stress_sock_peer_send(peer.fd, msg);
+	(void)close(peer.fd);
+
+	if (peer.duration > 0.0)
+		stress_metrics_set(args, 0, "MB per sec received",
+			((double)peer.bytes / peer.duration) / (double)MB);
 	return rc;
 }
 
+#endif
+
 static void stress_sock_sigpipe_handler(int signum)
 {
 	(void)signum;
@@ -1172,6 +2224,424 @@ static bool stress_sock_kernel_rt(void)
 #endif
 }
 
+#if defined(STRESS_SOCK_MPTCP_PM)
+/*
+ *  stress_sock_nla_put()
+ *	append a netlink attribute to a generic netlink message
+ */
+static struct nlattr *stress_sock_nla_put(
+	stress_sock_nlmsg_t *msg,
+	const uint16_t type,
+	const void *data,
+	const uint16_t len)
+{
+	struct nlattr *na = (struct nlattr *)((char *)msg + NLMSG_ALIGN(msg->n.nlmsg_len));
+
+	na->nla_type = type;
+	na->nla_len = (uint16_t)(NLA_HDRLEN + len);
+	if (len)
+		(void)memcpy((char *)na + NLA_HDRLEN, data, (size_t)len);
+	msg->n.nlmsg_len = NLMSG_ALIGN(msg->n.nlmsg_len) + NLA_ALIGN(na->nla_len);
+	return na;
+}
+
+/*
+ *  stress_sock_nla_end()
+ *	close a nested attribute started with stress_sock_nla_put()
+ */
+static void stress_sock_nla_end(stress_sock_nlmsg_t *msg, struct nlattr *na)
+{
+	na->nla_len = (uint16_t)(((char *)msg + msg->n.nlmsg_len) - (char *)na);
+}
+
+/*
+ *  stress_sock_nla_find()
+ *	find a top level attribute in a generic netlink reply
+ */
+static const struct nlattr *stress_sock_nla_find(
+	const stress_sock_nlmsg_t *msg,
+	const uint16_t type)
+{
+	const char *ptr = (const char *)msg + NLMSG_LENGTH(GENL_HDRLEN);
+	const char *end = (const char *)msg + msg->n.nlmsg_len;
+
+	while (ptr + NLA_HDRLEN <= end) {
+		const struct nlattr *na = (const struct nlattr *)ptr;
+
+		if ((na->nla_len < NLA_HDRLEN) || (ptr + na->nla_len > end))
+			break;
+		if ((na->nla_type & NLA_TYPE_MASK) == type)
+			return na;
+		ptr += NLA_ALIGN(na->nla_len);
+	}
+	return NULL;
+}
+
+/*
+ *  stress_sock_nl_init()
+ *	start a generic netlink request
+ */
+static void stress_sock_nl_init(
+	stress_sock_nlmsg_t *msg,
+	const uint16_t family,
+	const uint8_t cmd,
+	const uint8_t version)
+{
+	(void)memset(msg, 0, sizeof(*msg));
+	msg->n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+	msg->n.nlmsg_type = family;
+	msg->n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+	msg->g.cmd = cmd;
+	msg->g.version = version;
+}
+
+/*
+ *  stress_sock_nl_request()
+ *	send a generic netlink request and wait for the reply, a data
+ *	reply is copied to reply and is followed by the acknowledgement,
+ *	returns 0 or a negative errno
+ */
+static int stress_sock_nl_request(
+	const int fd,
+	stress_sock_nlmsg_t *msg,
+	stress_sock_nlmsg_t *reply)
+{
+	struct sockaddr_nl addr;
+	stress_sock_nlmsg_t buf ALIGN64;
+	static uint32_t seq;
+
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	msg->n.nlmsg_seq = ++seq;
+	if (sendto(fd, msg, msg->n.nlmsg_len, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -errno;
+
+	for (;;) {
+		const ssize_t len = recv(fd, &buf, sizeof(buf), 0);
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!NLMSG_OK(&buf.n, (unsigned int)len))
+			return -EBADMSG;
+		if (buf.n.nlmsg_seq != seq)
+			continue;
+		if (buf.n.nlmsg_type == NLMSG_ERROR) {
+			const struct nlmsgerr *err = (const struct nlmsgerr *)NLMSG_DATA(&buf.n);
+
+			return err->error;
+		}
+		if (reply)
+			(void)memcpy(reply, &buf, STRESS_MINIMUM((size_t)len, sizeof(*reply)));
+	}
+}
+
+/*
+ *  stress_sock_mptcp_limits()
+ *	get the path manager subflow and add address limits
+ */
+static int stress_sock_mptcp_limits(
+	stress_sock_mptcp_pm_t *pm,
+	uint32_t *subflows,
+	uint32_t *add_addrs)
+{
+	stress_sock_nlmsg_t msg ALIGN64, reply ALIGN64;
+	const struct nlattr *na;
+	int ret;
+
+	stress_sock_nl_init(&msg, pm->family, MPTCP_PM_CMD_GET_LIMITS, MPTCP_PM_VER);
+	(void)memset(&reply, 0, sizeof(reply));
+	ret = stress_sock_nl_request(pm->fd, &msg, &reply);
+	if (ret < 0)
+		return ret;
+	na = stress_sock_nla_find(&reply, MPTCP_PM_ATTR_SUBFLOWS);
+	if (!na)
+		return -ENODATA;
+	(void)memcpy(subflows, (const char *)na + NLA_HDRLEN, sizeof(*subflows));
+	na = stress_sock_nla_find(&reply, MPTCP_PM_ATTR_RCV_ADD_ADDRS);
+	if (!na)
+		return -ENODATA;
+	(void)memcpy(add_addrs, (const char *)na + NLA_HDRLEN, sizeof(*add_addrs));
+	return 0;
+}
+
+/*
+ *  stress_sock_mptcp_set_limits()
+ *	set the path manager subflow and add address limits
+ */
+static int stress_sock_mptcp_set_limits(
+	stress_sock_mptcp_pm_t *pm,
+	const uint32_t subflows,
+	const uint32_t add_addrs)
+{
+	stress_sock_nlmsg_t msg ALIGN64;
+
+	stress_sock_nl_init(&msg, pm->family, MPTCP_PM_CMD_SET_LIMITS, MPTCP_PM_VER);
+	(void)stress_sock_nla_put(&msg, MPTCP_PM_ATTR_RCV_ADD_ADDRS, &add_addrs, sizeof(add_addrs));
+	(void)stress_sock_nla_put(&msg, MPTCP_PM_ATTR_SUBFLOWS, &subflows, sizeof(subflows));
+	return stress_sock_nl_request(pm->fd, &msg, NULL);
+}
+
+/*
+ *  stress_sock_mptcp_endpoint()
+ *	add or delete a subflow endpoint on a loopback address
+ */
+static int stress_sock_mptcp_endpoint(
+	stress_sock_mptcp_pm_t *pm,
+	const uint8_t cmd,
+	const uint8_t id)
+{
+	stress_sock_nlmsg_t msg ALIGN64;
+	struct nlattr *na;
+	const uint16_t family = AF_INET;
+	const uint32_t flags = MPTCP_PM_ADDR_FLAG_SUBFLOW;
+	struct in_addr addr;
+
+	/* endpoint n is 127.0.0.n+2, the connections use 127.0.0.1 */
+	addr.s_addr = htonl(INADDR_LOOPBACK + 1 + (uint32_t)(id - SOCK_MPTCP_ENDPOINT_ID));
+
+	stress_sock_nl_init(&msg, pm->family, cmd, MPTCP_PM_VER);
+	na = stress_sock_nla_put(&msg, MPTCP_PM_ATTR_ADDR | NLA_F_NESTED, NULL, 0);
+	(void)stress_sock_nla_put(&msg, MPTCP_PM_ADDR_ATTR_ID, &id, sizeof(id));
+	/* endpoints are deleted by id alone */
+	if (cmd == MPTCP_PM_CMD_ADD_ADDR) {
+		(void)stress_sock_nla_put(&msg, MPTCP_PM_ADDR_ATTR_FAMILY, &family, sizeof(family));
+		(void)stress_sock_nla_put(&msg, MPTCP_PM_ADDR_ATTR_ADDR4, &addr, sizeof(addr));
+		(void)stress_sock_nla_put(&msg, MPTCP_PM_ADDR_ATTR_FLAGS, &flags, sizeof(flags));
+	}
+	stress_sock_nla_end(&msg, na);
+	return stress_sock_nl_request(pm->fd, &msg, NULL);
+}
+
+/*
+ *  stress_sock_mptcp_pm_setup()
+ *	configure the in-kernel path manager so that loopback connections
+ *	open subflows - 1 additional subflows from 127.0.0.2 onwards, the
+ *	limits and endpoints are network namespace wide and are restored
+ *	by stress_sock_mptcp_pm_restore(), returns 0 or a negative errno
+ */
+static int stress_sock_mptcp_pm_setup(
+	stress_sock_mptcp_pm_t *pm,
+	const uint32_t subflows)
+{
+	stress_sock_nlmsg_t msg ALIGN64, reply ALIGN64;
+	const struct nlattr *na;
+	struct sockaddr_nl addr;
+	struct timeval tv;
+	uint32_t i;
+	int ret;
+
+	(void)memset(pm, 0, sizeof(*pm));
+	pm->fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+	if (pm->fd < 0)
+		return -errno;
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	if ((bind(pm->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+	    (setsockopt(pm->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)) {
+		ret = -errno;
+		goto close_fd;
+	}
+
+	/* find the mptcp_pm generic netlink family */
+	stress_sock_nl_init(&msg, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1);
+	(void)stress_sock_nla_put(&msg, CTRL_ATTR_FAMILY_NAME, MPTCP_PM_NAME, sizeof(MPTCP_PM_NAME));
+	(void)memset(&reply, 0, sizeof(reply));
+	ret = stress_sock_nl_request(pm->fd, &msg, &reply);
+	if (ret < 0)
+		goto close_fd;
+	na = stress_sock_nla_find(&reply, CTRL_ATTR_FAMILY_ID);
+	if (!na) {
+		ret = -ENOENT;
+		goto close_fd;
+	}
+	(void)memcpy(&pm->family, (const char *)na + NLA_HDRLEN, sizeof(pm->family));
+
+	ret = stress_sock_mptcp_limits(pm, &pm->subflows, &pm->add_addrs);
+	if (ret < 0)
+		goto close_fd;
+	ret = stress_sock_mptcp_set_limits(pm,
+		STRESS_MAXIMUM(pm->subflows, subflows - 1), pm->add_addrs);
+	if (ret < 0)
+		goto close_fd;
+
+	for (i = 0; i < subflows - 1; i++) {
+		ret = stress_sock_mptcp_endpoint(pm, MPTCP_PM_CMD_ADD_ADDR,
+			(uint8_t)(SOCK_MPTCP_ENDPOINT_ID + i));
+		if (ret < 0)
+			break;
+		pm->endpoints++;
+	}
+	return pm->endpoints ? 0 : ret;
+
+close_fd:
+	(void)close(pm->fd);
+	pm->fd = -1;
+	return ret;
+}
+
+/*
+ *  stress_sock_mptcp_pm_restore()
+ *	remove the endpoints added and restore the path manager limits
+ */
+static void stress_sock_mptcp_pm_restore(stress_sock_mptcp_pm_t *pm)
+{
+	uint32_t i;
+
+	if (pm->fd < 0)
+		return;
+	for (i = 0; i < pm->endpoints; i++)
+		(void)stress_sock_mptcp_endpoint(pm, MPTCP_PM_CMD_DEL_ADDR,
+			(uint8_t)(SOCK_MPTCP_ENDPOINT_ID + i));
+	(void)stress_sock_mptcp_set_limits(pm, pm->subflows, pm->add_addrs);
+	(void)close(pm->fd);
+	pm->fd = -1;
+}
+#endif
+
+#if defined(STRESS_SOCK_MPTCP_BENCH)
+/*
+ *  stress_sock_mptcp_subflows()
+ *	number of subflows of an MPTCP connection, 0 if unknown
+ */
+static uint32_t stress_sock_mptcp_subflows(const int fd)
+{
+#if defined(HAVE_LINUX_MPTCP_H) &&	\
+    defined(MPTCP_INFO)
+	struct mptcp_info info;
+	socklen_t len = sizeof(info);
+
+	(void)memset(&info, 0, sizeof(info));
+	if (getsockopt(fd, SOL_MPTCP, MPTCP_INFO, &info, &len) < 0)
+		return 0;
+	return 1 + (uint32_t)info.mptcpi_subflows;
+#else
+	(void)fd;
+	return 0;
+#endif
+}
+
+/*
+ *  stress_sock_mptcp_bench()
+ *	compare TCP with MPTCP over subflows subflows on loopback, the
+ *	transports take turns at each message size for a slice of time
+ *	so both see the same system conditions
+ */
+static int stress_sock_mptcp_bench(
+	const stress_args_t *args,
+	const int port,
+	const uint32_t subflows)
+{
+	char label[NET_BENCH_LABEL_LEN];
+	stress_net_bench_transport_t transports[2];
+	stress_net_bench_result_t *results;
+	const size_t n = SIZEOF_ARRAY(transports) * NET_BENCH_SIZES;
+	const size_t results_size = sizeof(*results) * n;
+	size_t i, j;
+	bool ran;
+
+	results = (stress_net_bench_result_t *)mmap(NULL, results_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (results == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap benchmark results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < n; i++)
+		stress_latency_reset(&results[i].latency);
+
+	(void)snprintf(label, sizeof(label), "mptcp %" PRIu32 " subflow%s",
+		subflows, subflows > 1 ? "s" : "");
+	(void)memset(transports, 0, sizeof(transports));
+	transports[0].name = "tcp";
+	transports[0].protocol = IPPROTO_TCP;
+	transports[1].name = label;
+	transports[1].protocol = IPPROTO_MPTCP;
+	transports[1].subflows = stress_sock_mptcp_subflows;
+
+	do {
+		ran = false;
+		for (i = 0; i < SIZEOF_ARRAY(transports); i++) {
+			for (j = 0; j < NET_BENCH_SIZES; j++) {
+				stress_net_bench_result_t *r = &results[(i * NET_BENCH_SIZES) + j];
+
+				if (!keep_stressing(args))
+					break;
+				if (r->err)
+					continue;
+				stress_net_bench_run(args, &transports[i], port,
+					stress_net_bench_sizes[j], SOCK_BENCH_SLICE, r);
+				ran = true;
+			}
+		}
+	} while (ran && keep_stressing(args));
+
+	stress_net_bench_report(args, results, n);
+	(void)munmap((void *)results, results_size);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
+/*
+ *  stress_sock_init()
+ *	with --sock-mptcp-bench the parent adds the MPTCP subflow
+ *	endpoints used by all the instances, they are network namespace
+ *	wide so stress_sock_deinit() removes them however the instances
+ *	end, even if they are killed
+ */
+static void stress_sock_init(void)
+{
+#if defined(STRESS_SOCK_MPTCP_BENCH)
+	bool sock_mptcp_bench = false;
+	bool sock_server = false;
+	char *sock_peer = NULL;
+	uint32_t subflows = DEFAULT_SOCK_MPTCP_SUBFLOWS;
+
+	(void)stress_get_setting("sock-mptcp-bench", &sock_mptcp_bench);
+	(void)stress_get_setting("sock-mptcp-subflows", &subflows);
+	(void)stress_get_setting("sock-server", &sock_server);
+	(void)stress_get_setting("sock-peer", &sock_peer);
+	if (!sock_mptcp_bench || (subflows < 2) || sock_server || sock_peer)
+		return;
+
+#if defined(STRESS_SOCK_MPTCP_PM)
+	if (stress_check_capability(SHIM_CAP_NET_ADMIN)) {
+		const int ret = stress_sock_mptcp_pm_setup(&sock_mptcp_pm, subflows);
+
+		if (ret < 0)
+			pr_inf("sock: cannot add MPTCP subflow endpoints, errno=%d (%s), "
+				"using the configured endpoints\n",
+				-ret, strerror(-ret));
+		else if (sock_mptcp_pm.endpoints < subflows - 1)
+			pr_inf("sock: added %" PRIu32 " of %" PRIu32 " MPTCP subflow endpoints\n",
+				sock_mptcp_pm.endpoints, subflows - 1);
+	} else {
+		pr_inf("sock: need CAP_NET_ADMIN to add MPTCP subflow endpoints, "
+			"using the configured endpoints\n");
+	}
+#else
+	pr_inf("sock: cannot add MPTCP subflow endpoints, linux/mptcp.h is not "
+		"available, using the configured endpoints\n");
+#endif
+#endif
+}
+
+/*
+ *  stress_sock_deinit()
+ *	remove the MPTCP subflow endpoints added by stress_sock_init()
+ */
+static void stress_sock_deinit(void)
+{
+#if defined(STRESS_SOCK_MPTCP_PM)
+	stress_sock_mptcp_pm_restore(&sock_mptcp_pm);
+#endif
+}
+
 /*
  *  stress_sock
  *	stress by heavy socket I/O
@@ -1189,10 +2659,19 @@ static int stress_sock(const stress_args_t *args)
 	int sock_protocol = 0;
 #endif
 	int sock_zerocopy = false;
-	int rc = EXIT_SUCCESS, reserved_port;
+	int rc = EXIT_SUCCESS, reserved_port = -1, ctrl_port;
 	const bool rt = stress_sock_kernel_rt();
 	char *mmap_buffer;
 	char *sock_if = NULL;
+	char *sock_peer = NULL;
+	bool sock_server = false;
+	uint32_t sock_peers = DEFAULT_SOCK_PEERS;
+	bool sock_mptcp_bench = false;
+	uint32_t sock_mptcp_subflows = DEFAULT_SOCK_MPTCP_SUBFLOWS;
+#if defined(STRESS_SOCK_PEER)
+	stress_sock_peer_t *peers = MAP_FAILED;
+	pid_t ctrl_pid = -1;
+#endif
 
 	(void)stress_get_setting("sock-if", &sock_if);
 	(void)stress_get_setting("sock-domain", &sock_domain);
@@ -1201,6 +2680,46 @@ static int stress_sock(const stress_args_t *args)
 	(void)stress_get_setting("sock-port", &sock_port);
 	(void)stress_get_setting("sock-opts", &sock_opts);
 	(void)stress_get_setting("sock-zerocopy", &sock_zerocopy);
+	(void)stress_get_setting("sock-peer", &sock_peer);
+	(void)stress_get_setting("sock-peers", &sock_peers);
+	(void)stress_get_setting("sock-server", &sock_server);
+	(void)stress_get_setting("sock-mptcp-bench", &sock_mptcp_bench);
+	(void)stress_get_setting("sock-mptcp-subflows", &sock_mptcp_subflows);
+
+	if (sock_mptcp_bench) {
+#if defined(STRESS_SOCK_MPTCP_BENCH)
+		if (sock_server || sock_peer) {
+			pr_inf_skip("%s: --sock-mptcp-bench cannot be used with remote peers, "
+				"skipping stressor\n", args->name);
+			return EXIT_NO_RESOURCE;
+		}
+#else
+		pr_inf_skip("%s: --sock-mptcp-bench is not supported, IPPROTO_MPTCP "
+			"is not defined, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
+
+	if (sock_server || sock_peer) {
+#if defined(STRESS_SOCK_PEER)
+		if (sock_server && sock_peer) {
+			pr_inf_skip("%s: --sock-server and --sock-peer cannot be used together, "
+				"skipping stressor\n", args->name);
+			return EXIT_NO_RESOURCE;
+		}
+		if (sock_domain == AF_UNIX) {
+			pr_inf_skip("%s: remote peers need the ipv4 or ipv6 domain, "
+				"skipping stressor\n", args->name);
+			return EXIT_NO_RESOURCE;
+		}
+#else
+		pr_inf_skip("%s: remote peers are not supported, poll.h is not available, "
+			"skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
+	/* the control connection uses the port below the first data port */
+	ctrl_port = sock_port - 1;
 
 	if (sock_if) {
 		int ret;
@@ -1214,29 +2733,89 @@ static int stress_sock(const stress_args_t *args)
 		}
 	}
 	sock_port += args->instance;
-	reserved_port = stress_net_reserve_ports(sock_port, sock_port);
-	if (reserved_port < 0) {
-		pr_inf_skip("%s: cannot reserve port %d, skipping stressor\n",
-			args->name, sock_port);
-		return EXIT_NO_RESOURCE;
+	/* a remote peer's ports are not used on this host */
+	if (!sock_peer) {
+		reserved_port = stress_net_reserve_ports(sock_port, sock_port);
+		if (reserved_port < 0) {
+			pr_inf_skip("%s: cannot reserve port %d, skipping stressor\n",
+				args->name, sock_port);
+			return EXIT_NO_RESOURCE;
+		}
+		sock_port = reserved_port;
 	}
-	sock_port = reserved_port;
 
 	pr_dbg("%s: process [%d] using socket port %d\n",
 		args->name, (int)args->pid, sock_port);
 
-	if (stress_sighandler(args->name, SIGPIPE, stress_sock_sigpipe_handler, NULL) < 0)
-		return EXIT_NO_RESOURCE;
+	if (stress_sighandler(args->name, SIGPIPE, stress_sock_sigpipe_handler, NULL) < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto finish;
+	}
 
 	mmap_buffer = (char *)mmap(NULL, MMAP_BUF_SIZE, PROT_READ | PROT_WRITE,
 				MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
 	if (mmap_buffer == MAP_FAILED) {
 		pr_inf("%s: cannot mmap I/O buffer, errno=%d (%s)\n",
 			args->name, errno, strerror(errno));
-		return EXIT_NO_RESOURCE;
+		rc = EXIT_NO_RESOURCE;
+		goto finish;
 	}
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+#if defined(STRESS_SOCK_MPTCP_BENCH)
+	if (sock_mptcp_bench) {
+		rc = stress_sock_mptcp_bench(args, sock_port, sock_mptcp_subflows);
+		(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+		goto finish;
+	}
+#endif
+#if defined(STRESS_SOCK_PEER)
+	if (sock_peer) {
+		rc = stress_sock_peer(args, mmap_buffer, mypid, sock_opts,
+			sock_domain, sock_type, sock_protocol, sock_port,
+			ctrl_port, sock_peer, rt, sock_zerocopy);
+		(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+		goto finish;
+	}
+	if (sock_server) {
+		/* instance 0 coordinates the remote peers */
+		if (args->instance == 0) {
+			const pid_t stress_ng_pid = getppid();
+
+			peers = (stress_sock_peer_t *)mmap(NULL, sizeof(*peers) * sock_peers,
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+			if (peers == MAP_FAILED) {
+				pr_inf_skip("%s: cannot mmap %" PRIu32 " peer records, skipping stressor\n",
+					args->name, sock_peers);
+				(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+				rc = EXIT_NO_RESOURCE;
+				goto finish;
+			}
+			ctrl_pid = fork();
+			if (ctrl_pid == 0) {
+				stress_sock_peer_control(args, sock_domain, ctrl_port,
+					sock_if, sock_peers, peers, stress_ng_pid);
+				_exit(EXIT_SUCCESS);
+			}
+		}
+		rc = stress_sock_server(args, mmap_buffer, 0, mypid, sock_opts,
+			sock_domain, sock_type, sock_protocol,
+			sock_port, sock_if, rt, sock_zerocopy);
+		(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+		if (ctrl_pid > 0) {
+			int status;
+
+			(void)kill(ctrl_pid, SIGALRM);
+			(void)shim_waitpid(ctrl_pid, &status, 0);
+		}
+		if (peers != MAP_FAILED) {
+			stress_sock_peer_report(args, peers, sock_peers);
+			(void)munmap((void *)peers, sizeof(*peers) * sock_peers);
+		}
+		goto finish;
+	}
+#endif
 again:
 	pid = fork();
 	if (pid < 0) {
@@ -1248,11 +2827,12 @@ again:
 		}
 		pr_err("%s: fork failed, errno=%d (%s)\n",
 			args->name, errno, strerror(errno));
-		return EXIT_FAILURE;
+		rc = EXIT_FAILURE;
+		goto finish;
 	} else if (pid == 0) {
 		rc = stress_sock_client(args, mmap_buffer, mypid, sock_opts,
 			sock_domain, sock_type, sock_protocol,
-			sock_port, sock_if, rt, sock_zerocopy);
+			sock_port, sock_if, rt, sock_zerocopy, NULL, 0, NULL);
 		(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
 
 		/* Inform parent we're all done */
@@ -1267,7 +2847,8 @@ again:
 	}
 finish:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
-	stress_net_release_ports(sock_port, sock_port);
+	if (reserved_port >= 0)
+		stress_net_release_ports(sock_port, sock_port);
 
 	return rc;
 }
@@ -1275,16 +2856,23 @@ finish:
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_sock_domain,	stress_set_sock_domain },
 	{ OPT_sock_if,		stress_set_sock_if },
+	{ OPT_sock_mptcp_bench,	stress_set_sock_mptcp_bench },
+	{ OPT_sock_mptcp_subflows, stress_set_sock_mptcp_subflows },
 	{ OPT_sock_opts,	stress_set_sock_opts },
+	{ OPT_sock_peer,	stress_set_sock_peer },
+	{ OPT_sock_peers,	stress_set_sock_peers },
 	{ OPT_sock_type,	stress_set_sock_type },
 	{ OPT_sock_port,	stress_set_sock_port },
 	{ OPT_sock_protocol,	stress_set_sock_protocol },
+	{ OPT_sock_server,	stress_set_sock_server },
 	{ OPT_sock_zerocopy,	stress_set_sock_zerocopy },
 	{ 0,			NULL }
 };
 
 stressor_info_t stress_sock_info = {
 	.stressor = stress_sock,
+	.init = stress_sock_init,
+	.deinit = stress_sock_deinit,
 	.class = CLASS_NETWORK | CLASS_OS,
 	.opt_set_funcs = opt_set_funcs,
 	.verify = VERIFY_ALWAYS,
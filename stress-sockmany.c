@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
 #include "core-net.h"
 
 #if defined(HAVE_NETINET_TCP_H)
@@ -26,6 +27,13 @@
 UNEXPECTED
 #endif
 
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
 #define MIN_SOCKMANY_PORT	(1024)
 #define MAX_SOCKMANY_PORT	(65535)
 #define DEFAULT_SOCKET_MANY_PORT (11000)
@@ -33,6 +41,19 @@ UNEXPECTED
 #define SOCKET_MANY_BUF		(8)
 #define SOCKET_MANY_FDS		(100000)
 
+#define MIN_SOCKMANY_CONNS	(1024)
+#define MAX_SOCKMANY_CONNS	(64 * 1024 * 1024)
+#define DEFAULT_SOCKMANY_CONNS	(64 * 1024)
+
+#define MIN_SOCKMANY_ACCEPTORS	(1)
+#define MAX_SOCKMANY_ACCEPTORS	(64)
+#define DEFAULT_SOCKMANY_ACCEPTORS (1)
+
+#define SOCKET_MANY_MAX_STEPS	(32)	/* doubling steps from MIN_SOCKMANY_CONNS */
+#define SOCKET_MANY_SLABS	(512)	/* slab caches tracked from /proc/slabinfo */
+#define SOCKET_MANY_TOP_SLABS	(5)	/* largest slab cache increases reported */
+#define SOCKET_MANY_FD_SLACK	(64)	/* file descriptors kept for everything else */
+
 typedef struct {
 	int max_fd;
 	int fds[SOCKET_MANY_FDS];
@@ -40,9 +61,12 @@ typedef struct {
 
 static const stress_help_t help[] = {
 	{ NULL, "sockmany N",		"start N workers exercising many socket connections" },
+	{ NULL,	"sockmany-acceptors N",	"use N SO_REUSEPORT acceptor processes in scale mode" },
+	{ NULL,	"sockmany-conns N",	"hold up to N established connections in scale mode" },
 	{ NULL,	"sockmany-if I",	"use network interface I, e.g. lo, eth0, etc." },
 	{ NULL,	"sockmany-ops N",	"stop after N sockmany bogo operations" },
 	{ NULL,	"sockmany-port",	"use socket ports P to P + number of workers - 1" },
+	{ NULL,	"sockmany-scale",	"report setup rate, kernel memory and accept latency as connections grow" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -64,6 +88,39 @@ static int stress_set_sockmany_if(const char *name)
 	return stress_set_setting("sockmany-if", TYPE_ID_STR, name);
 }
 
+static int stress_set_sockmany_scale(const char *opt)
+{
+	return stress_set_setting_true("sockmany-scale", opt);
+}
+
+/*
+ *  stress_set_sockmany_conns()
+ *	set number of connections the scale mode grows to
+ */
+static int stress_set_sockmany_conns(const char *opt)
+{
+	uint32_t sockmany_conns;
+
+	sockmany_conns = stress_get_uint32(opt);
+	stress_check_range("sockmany-conns", (uint64_t)sockmany_conns,
+		MIN_SOCKMANY_CONNS, MAX_SOCKMANY_CONNS);
+	return stress_set_setting("sockmany-conns", TYPE_ID_UINT32, &sockmany_conns);
+}
+
+/*
+ *  stress_set_sockmany_acceptors()
+ *	set number of SO_REUSEPORT acceptors in scale mode
+ */
+static int stress_set_sockmany_acceptors(const char *opt)
+{
+	uint32_t sockmany_acceptors;
+
+	sockmany_acceptors = stress_get_uint32(opt);
+	stress_check_range("sockmany-acceptors", (uint64_t)sockmany_acceptors,
+		MIN_SOCKMANY_ACCEPTORS, MAX_SOCKMANY_ACCEPTORS);
+	return stress_set_setting("sockmany-acceptors", TYPE_ID_UINT32, &sockmany_acceptors);
+}
+
 /*
  *  stress_sockmany_cleanup()
  *	close sockets
@@ -295,6 +352,669 @@ die:
 	return rc;
 }
 
+#if defined(__linux__) &&	\
+    defined(HAVE_POLL_H)
+
+#define STRESS_SOCKMANY_SCALE
+
+/* state shared between the scale mode client and its acceptors */
+typedef struct {
+	volatile uint64_t accepted[MAX_SOCKMANY_ACCEPTORS];	/* accepted in the current sweep */
+	volatile int err[MAX_SOCKMANY_ACCEPTORS];	/* errno of an acceptor that cannot accept */
+	volatile uint32_t ready[MAX_SOCKMANY_ACCEPTORS];	/* sweep each acceptor is ready for */
+	volatile uint32_t sweep;	/* acceptors close their connections when this changes */
+	volatile uint32_t step;		/* step the accept latencies are added to */
+	volatile bool stop;		/* acceptors exit when set */
+} stress_sockmany_shared_t;
+
+/* connections and kernel memory at the end of a doubling step */
+typedef struct {
+	uint64_t conns;			/* established connections at the end of the step */
+	uint64_t step_conns;		/* connections established in the step, all sweeps */
+	double step_secs;		/* seconds establishing them, all sweeps */
+	double slab;			/* first sweep Slab: bytes over the baseline */
+	double tcp_mem;			/* first sweep TCP buffer bytes over the baseline */
+} stress_sockmany_step_t;
+
+/* bytes used by a slab cache */
+typedef struct {
+	char name[32];
+	double bytes;
+} stress_sockmany_slab_t;
+
+static stress_sockmany_slab_t slabs_begin[SOCKET_MANY_SLABS];
+static stress_sockmany_slab_t slabs_end[SOCKET_MANY_SLABS];
+static size_t n_slabs_begin, n_slabs_end;
+
+/*
+ *  stress_sockmany_now()
+ *	monotonic time in nanoseconds that is comparable between
+ *	the client and acceptor processes
+ */
+static inline uint64_t stress_sockmany_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_sockmany_latency()
+ *	connect to accept latency histogram of an acceptor for a step,
+ *	the histograms follow the shared state in the shared mapping
+ */
+static inline stress_latency_t *stress_sockmany_latency(
+	stress_sockmany_shared_t *shared,
+	const uint32_t acceptor,
+	const uint32_t step)
+{
+	stress_latency_t *latency = (stress_latency_t *)(shared + 1);
+
+	return &latency[(acceptor * SOCKET_MANY_MAX_STEPS) + step];
+}
+
+/*
+ *  stress_sockmany_slab()
+ *	Slab: bytes from /proc/meminfo, this includes the socket,
+ *	inode, dentry and file objects of each connection
+ */
+static double stress_sockmany_slab(void)
+{
+	FILE *fp;
+	char buffer[256];
+	double bytes = 0.0;
+
+	fp = fopen("/proc/meminfo", "r");
+	if (!fp)
+		return 0.0;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		uint64_t kb;
+
+		if (sscanf(buffer, "Slab: %" SCNu64, &kb) == 1) {
+			bytes = (double)kb * 1024.0;
+			break;
+		}
+	}
+	(void)fclose(fp);
+
+	return bytes;
+}
+
+/*
+ *  stress_sockmany_tcp_mem()
+ *	bytes of TCP socket buffers from /proc/net/sockstat
+ */
+static double stress_sockmany_tcp_mem(const stress_args_t *args)
+{
+	FILE *fp;
+	char buffer[256];
+	double bytes = 0.0;
+
+	fp = fopen("/proc/net/sockstat", "r");
+	if (!fp)
+		return 0.0;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		uint64_t pages;
+
+		if (sscanf(buffer, "TCP: inuse %*d orphan %*d tw %*d alloc %*d mem %" SCNu64, &pages) == 1) {
+			bytes = (double)pages * (double)args->page_size;
+			break;
+		}
+	}
+	(void)fclose(fp);
+
+	return bytes;
+}
+
+/*
+ *  stress_sockmany_slabinfo()
+ *	bytes used by each slab cache from /proc/slabinfo, this is
+ *	only readable by root, returns the number of caches
+ */
+static size_t stress_sockmany_slabinfo(stress_sockmany_slab_t *slabs)
+{
+	FILE *fp;
+	char buffer[512];
+	size_t n = 0;
+
+	fp = fopen("/proc/slabinfo", "r");
+	if (!fp)
+		return 0;
+	while ((n < SOCKET_MANY_SLABS) && fgets(buffer, sizeof(buffer), fp)) {
+		uint64_t objs, size;
+
+		if (sscanf(buffer, "%31s %" SCNu64 " %*u %" SCNu64,
+			   slabs[n].name, &objs, &size) != 3)
+			continue;
+		slabs[n].bytes = (double)objs * (double)size;
+		n++;
+	}
+	(void)fclose(fp);
+
+	return n;
+}
+
+/*
+ *  stress_sockmany_close_fds()
+ *	close connections, aborting them with a reset so that no
+ *	TIME_WAIT sockets are left to use up ephemeral ports
+ */
+static void stress_sockmany_close_fds(int *fds, const size_t n)
+{
+	const struct linger linger = { 1, 0 };
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		(void)setsockopt(fds[i], SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+		(void)close(fds[i]);
+	}
+}
+
+/*
+ *  stress_sockmany_acceptor()
+ *	accept and hold connections on a SO_REUSEPORT listening socket,
+ *	the kernel shards the incoming connections between the acceptors.
+ *	The client sends its connect completion time on each connection
+ *	so the time spent in the accept queue is measured
+ */
+static void stress_sockmany_acceptor(
+	stress_sockmany_shared_t *shared,
+	const uint32_t acceptor,
+	const struct sockaddr *addr,
+	const socklen_t addr_len,
+	const size_t max_fds)
+{
+	int lfd, one = 1, *fds;
+	size_t n = 0;
+	uint32_t sweep = 0;
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	fds = (int *)mmap(NULL, max_fds * sizeof(*fds), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (fds == MAP_FAILED) {
+		shared->err[acceptor] = ENOMEM;
+		return;
+	}
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		shared->err[acceptor] = errno;
+		goto unmap;
+	}
+	if ((setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) ||
+#if defined(SO_REUSEPORT)
+	    (setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) ||
+#endif
+	    (bind(lfd, addr, addr_len) < 0) ||
+	    (listen(lfd, SOMAXCONN) < 0) ||
+	    (fcntl(lfd, F_SETFL, O_NONBLOCK) < 0)) {
+		shared->err[acceptor] = errno;
+		goto close_lfd;
+	}
+
+	while (!shared->stop) {
+		struct pollfd pfd;
+
+		if (shared->sweep != sweep) {
+			stress_sockmany_close_fds(fds, n);
+			n = 0;
+			sweep = shared->sweep;
+			shared->accepted[acceptor] = 0;
+			shared->err[acceptor] = 0;
+			shared->ready[acceptor] = sweep;
+		}
+
+		pfd.fd = lfd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 10) <= 0)
+			continue;
+
+		while (!shared->stop) {
+			uint64_t stamp;
+			int sfd;
+
+			if (n >= max_fds) {
+				shared->err[acceptor] = EMFILE;
+				(void)shim_usleep(10000);
+				break;
+			}
+			sfd = accept(lfd, NULL, NULL);
+			if (sfd < 0) {
+				if ((errno == EMFILE) || (errno == ENFILE) ||
+				    (errno == ENOBUFS) || (errno == ENOMEM)) {
+					shared->err[acceptor] = errno;
+					(void)shim_usleep(10000);
+				}
+				break;
+			}
+			if (recv(sfd, &stamp, sizeof(stamp), MSG_WAITALL) == (ssize_t)sizeof(stamp)) {
+				const uint64_t now = stress_sockmany_now();
+
+				if (now > stamp)
+					stress_latency_add(stress_sockmany_latency(shared,
+						acceptor, shared->step), now - stamp);
+			}
+			fds[n++] = sfd;
+			shared->accepted[acceptor]++;
+		}
+	}
+	stress_sockmany_close_fds(fds, n);
+close_lfd:
+	(void)close(lfd);
+unmap:
+	(void)munmap((void *)fds, max_fds * sizeof(*fds));
+}
+
+/*
+ *  stress_sockmany_accepted()
+ *	wait for up to 5 seconds for the acceptors to accept conns
+ *	connections, returns the errno of a failed acceptor, ETIMEDOUT
+ *	or 0 when all have been accepted
+ */
+static int stress_sockmany_accepted(
+	stress_sockmany_shared_t *shared,
+	const uint32_t acceptors,
+	const uint64_t conns)
+{
+	int i;
+
+	for (i = 0; i < 5000; i++) {
+		uint64_t accepted = 0;
+		uint32_t j;
+
+		for (j = 0; j < acceptors; j++) {
+			accepted += shared->accepted[j];
+			if (shared->err[j])
+				return shared->err[j];
+		}
+		if (accepted >= conns)
+			return 0;
+		(void)shim_usleep(1000);
+	}
+	return ETIMEDOUT;
+}
+
+/*
+ *  stress_sockmany_sweep()
+ *	establish connections to the acceptors until target connections
+ *	are held or a resource runs out, recording the setup rate and
+ *	on the first sweep the kernel memory at each doubling step,
+ *	returns the number of connections established
+ */
+static uint64_t stress_sockmany_sweep(
+	const stress_args_t *args,
+	stress_sockmany_shared_t *shared,
+	const uint32_t sweep,
+	const uint32_t acceptors,
+	const uint64_t target,
+	int *fds,
+	const struct sockaddr_in *addr,
+	const bool loopback,
+	stress_sockmany_step_t *steps,
+	uint32_t *n_steps,
+	const char **reason)
+{
+	const struct timeval tv = { 1, 0 };
+	struct sockaddr_in dst = *addr;
+	uint64_t conns = 0, milestone = STRESS_MINIMUM(MIN_SOCKMANY_CONNS, target);
+	uint64_t prev_conns = 0;
+	double slab, tcp_mem, t, prev_t;
+	uint32_t i, step = 0;
+	int err;
+
+	shared->step = 0;
+	shared->sweep = sweep;
+	for (i = 0; i < 5000; i++) {
+		uint32_t j, ready = 0;
+
+		for (j = 0; j < acceptors; j++)
+			ready += (shared->ready[j] == sweep);
+		if (ready == acceptors)
+			break;
+		(void)shim_usleep(1000);
+	}
+	if (i == 5000) {
+		*reason = "acceptors did not start";
+		return 0;
+	}
+
+	slab = stress_sockmany_slab();
+	tcp_mem = stress_sockmany_tcp_mem(args);
+	if ((sweep == 1) && (args->instance == 0))
+		n_slabs_begin = stress_sockmany_slabinfo(slabs_begin);
+	*reason = "target reached";
+	prev_t = stress_time_now();
+
+	while (conns < target) {
+		uint64_t stamp;
+		int fd;
+
+		if (!keep_stressing(args)) {
+			*reason = "run time or bogo-ops reached";
+			break;
+		}
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) {
+			*reason = ((errno == EMFILE) || (errno == ENFILE)) ?
+				"out of file descriptors" : "out of socket memory";
+			break;
+		}
+		/* a full accept queue makes connect time out rather than block */
+		(void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		if (connect(fd, (struct sockaddr *)&dst, sizeof(dst)) < 0) {
+			err = errno;
+			(void)close(fd);
+			/* ephemeral ports are per destination, so move on to the next loopback address */
+			if ((err == EADDRNOTAVAIL) && loopback &&
+			    ((ntohl(dst.sin_addr.s_addr) & 0xffffff) < 0xfffffe)) {
+				dst.sin_addr.s_addr = htonl(ntohl(dst.sin_addr.s_addr) + 1);
+				continue;
+			}
+			*reason = (err == EADDRNOTAVAIL) ? "out of ephemeral ports" :
+				  ((err == EINPROGRESS) || (err == EAGAIN) || (err == ETIMEDOUT)) ?
+				  "connect timed out" : "connect failed";
+			break;
+		}
+		stamp = stress_sockmany_now();
+		(void)send(fd, &stamp, sizeof(stamp), MSG_NOSIGNAL);
+		fds[conns++] = fd;
+		inc_counter(args);
+
+		if ((conns < milestone) && (conns < target))
+			continue;
+
+		err = stress_sockmany_accepted(shared, acceptors, conns);
+		if (err) {
+			*reason = (err == ETIMEDOUT) ? "acceptors stalled" :
+				  "acceptors out of file descriptors or memory";
+			break;
+		}
+		t = stress_time_now();
+		if (sweep == 1) {
+			steps[step].conns = conns;
+			steps[step].slab = stress_sockmany_slab() - slab;
+			steps[step].tcp_mem = stress_sockmany_tcp_mem(args) - tcp_mem;
+			*n_steps = step + 1;
+		}
+		if (steps[step].conns == conns) {
+			steps[step].step_conns += conns - prev_conns;
+			steps[step].step_secs += t - prev_t;
+		}
+		prev_conns = conns;
+		prev_t = t;
+		if (step + 1 >= SOCKET_MANY_MAX_STEPS)
+			break;
+		shared->step = ++step;
+		milestone = STRESS_MINIMUM(milestone * 2, target);
+	}
+
+	if ((sweep == 1) && (args->instance == 0))
+		n_slabs_end = stress_sockmany_slabinfo(slabs_end);
+	stress_sockmany_close_fds(fds, (size_t)conns);
+
+	return conns;
+}
+
+/*
+ *  stress_sockmany_slab_report()
+ *	print the slab caches that grew the most per socket
+ *	during the first sweep
+ */
+static void stress_sockmany_slab_report(
+	const stress_args_t *args,
+	const double sockets)
+{
+	double delta[SOCKET_MANY_SLABS];
+	char buf[256];
+	size_t i, j, len = 0;
+
+	for (i = 0; i < n_slabs_end; i++) {
+		delta[i] = slabs_end[i].bytes;
+		for (j = 0; j < n_slabs_begin; j++) {
+			if (!strcmp(slabs_end[i].name, slabs_begin[j].name)) {
+				delta[i] -= slabs_begin[j].bytes;
+				break;
+			}
+		}
+	}
+
+	*buf = '\0';
+	for (j = 0; j < SOCKET_MANY_TOP_SLABS; j++) {
+		size_t top = 0;
+
+		for (i = 1; i < n_slabs_end; i++) {
+			if (delta[i] > delta[top])
+				top = i;
+		}
+		if ((n_slabs_end == 0) || (delta[top] <= 0.0))
+			break;
+		(void)snprintf(buf + len, sizeof(buf) - len, "%s%s %.0f",
+			j ? ", " : "", slabs_end[top].name, delta[top] / sockets);
+		len = strlen(buf);
+		delta[top] = 0.0;
+	}
+	if (*buf)
+		pr_inf("%s: largest slab cache growth, bytes per socket: %s\n",
+			args->name, buf);
+}
+
+/*
+ *  stress_sockmany_scale_report()
+ *	print the setup rate, kernel memory per socket and accept
+ *	latency at each doubling step and set the metrics, each
+ *	connection has both of its sockets on this host so the
+ *	memory is per socket rather than per connection
+ */
+static void stress_sockmany_scale_report(
+	const stress_args_t *args,
+	stress_sockmany_shared_t *shared,
+	const uint32_t acceptors,
+	const stress_sockmany_step_t *steps,
+	const uint32_t n_steps,
+	const uint32_t sweeps,
+	const char *reason)
+{
+	stress_latency_t latency, total;
+	uint64_t conns = 0;
+	double secs = 0.0, sockets = 0.0, bytes = 0.0;
+	uint32_t i, j;
+
+	stress_latency_reset(&total);
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %" PRIu32 " sweep%s with %" PRIu32 " SO_REUSEPORT acceptor%s, "
+			"first sweep stopped at %" PRIu64 " connections: %s\n",
+			args->name, sweeps, (sweeps == 1) ? "" : "s",
+			acceptors, (acceptors == 1) ? "" : "s",
+			n_steps ? steps[n_steps - 1].conns : 0, reason);
+		pr_inf("%s: %11s %11s %12s %12s %12s %12s %12s\n", args->name,
+			"connections", "conns/sec", "slab B/sock", "tcp B/sock",
+			"accept p50us", "accept p99us", "accept maxus");
+	}
+	for (i = 0; i < n_steps; i++) {
+		const stress_sockmany_step_t *s = &steps[i];
+
+		stress_latency_reset(&latency);
+		for (j = 0; j < acceptors; j++)
+			stress_latency_merge(&latency, stress_sockmany_latency(shared, j, i));
+		stress_latency_merge(&total, &latency);
+		conns += s->step_conns;
+		secs += s->step_secs;
+		sockets = (double)s->conns * 2.0;
+		bytes = s->slab + s->tcp_mem;
+
+		if (args->instance != 0)
+			continue;
+		pr_inf("%s: %11" PRIu64 " %11.0f %12.0f %12.0f %12.1f %12.1f %12.1f\n",
+			args->name, s->conns,
+			(s->step_secs > 0.0) ? (double)s->step_conns / s->step_secs : 0.0,
+			s->slab / sockets, s->tcp_mem / sockets,
+			(double)stress_latency_percentile(&latency, 50.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND,
+			(double)stress_latency_percentile(&latency, 99.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND,
+			latency.count ? (double)latency.max / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND : 0.0);
+	}
+	if (args->instance == 0) {
+		if (sockets > 0.0)
+			stress_sockmany_slab_report(args, sockets);
+		pr_unlock();
+	}
+
+	if (n_steps == 0)
+		return;
+	stress_metrics_set(args, 0, "connections per sec",
+		(secs > 0.0) ? (double)conns / secs : 0.0);
+	stress_metrics_set(args, 1, "connections established",
+		(double)steps[n_steps - 1].conns);
+	stress_metrics_set(args, 2, "kernel bytes per socket",
+		(sockets > 0.0) ? bytes / sockets : 0.0);
+	stress_metrics_set(args, 3, "accept latency p50 usec",
+		(double)stress_latency_percentile(&total, 50.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND);
+	stress_metrics_set(args, 4, "accept latency p99 usec",
+		(double)stress_latency_percentile(&total, 99.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND);
+}
+
+/*
+ *  stress_sockmany_scale()
+ *	hold a growing number of established connections accepted by
+ *	SO_REUSEPORT acceptor processes, measuring the connection setup
+ *	rate, the kernel memory per established socket from the Slab:
+ *	and sockstat TCP memory growth and the accept queue latency at
+ *	each doubling of the connection count, then drop them all and
+ *	sweep again until the run ends
+ */
+static int stress_sockmany_scale(
+	const stress_args_t *args,
+	const int sockmany_port,
+	const char *sockmany_if)
+{
+	stress_sockmany_step_t steps[SOCKET_MANY_MAX_STEPS];
+	stress_sockmany_shared_t *shared;
+	pid_t pids[MAX_SOCKMANY_ACCEPTORS];
+	struct sockaddr_in listen_addr, addr;
+	struct sockaddr *sa = NULL;
+	struct rlimit rlim;
+	socklen_t sa_len = 0;
+	uint32_t sockmany_conns = DEFAULT_SOCKMANY_CONNS;
+	uint32_t sockmany_acceptors = DEFAULT_SOCKMANY_ACCEPTORS;
+	uint32_t i, sweep, sweeps = 0, n_steps = 0;
+	const char *reason = "no sweep completed";
+	const bool loopback = (sockmany_if == NULL);
+	size_t shared_size, max_fds;
+	uint64_t target;
+	int *fds, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("sockmany-conns", &sockmany_conns);
+	(void)stress_get_setting("sockmany-acceptors", &sockmany_acceptors);
+#if !defined(SO_REUSEPORT)
+	sockmany_acceptors = 1;
+#endif
+
+	/* each connection needs a client fd here and an fd in an acceptor */
+	if (getrlimit(RLIMIT_NOFILE, &rlim) == 0) {
+		rlim.rlim_cur = rlim.rlim_max;
+		(void)setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+	max_fds = stress_get_max_file_limit();
+	target = sockmany_conns;
+	if (max_fds < target + SOCKET_MANY_FD_SLACK) {
+		target = (max_fds > MIN_SOCKMANY_CONNS + SOCKET_MANY_FD_SLACK) ?
+			max_fds - SOCKET_MANY_FD_SLACK : MIN_SOCKMANY_CONNS;
+		if (args->instance == 0)
+			pr_inf("%s: file descriptor limit of %zu limits connections to %" PRIu64 "\n",
+				args->name, max_fds, target);
+	}
+	(void)memset(steps, 0, sizeof(steps));
+
+	if (stress_set_sockaddr_if(args->name, args->instance, args->pid,
+			AF_INET, sockmany_port, sockmany_if,
+			&sa, &sa_len, NET_ADDR_ANY) < 0)
+		return EXIT_FAILURE;
+	(void)memcpy(&listen_addr, sa, sizeof(listen_addr));
+	addr = listen_addr;
+	if (loopback)
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	shared_size = sizeof(*shared) + (MAX_SOCKMANY_ACCEPTORS * SOCKET_MANY_MAX_STEPS * sizeof(stress_latency_t));
+	shared = (stress_sockmany_shared_t *)mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap shared state, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	fds = (int *)mmap(NULL, (size_t)target * sizeof(*fds), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (fds == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %" PRIu64 " file descriptors, errno=%d (%s), skipping stressor\n",
+			args->name, target, errno, strerror(errno));
+		(void)munmap((void *)shared, shared_size);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < sockmany_acceptors; i++) {
+		uint32_t j;
+
+		for (j = 0; j < SOCKET_MANY_MAX_STEPS; j++)
+			stress_latency_reset(stress_sockmany_latency(shared, i, j));
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	for (i = 0; i < sockmany_acceptors; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			pr_inf("%s: fork failed, errno=%d (%s), using %" PRIu32 " acceptors\n",
+				args->name, errno, strerror(errno), i);
+			break;
+		} else if (pids[i] == 0) {
+			stress_sockmany_acceptor(shared, i, (struct sockaddr *)&listen_addr,
+				sizeof(listen_addr), (size_t)target);
+			_exit(0);
+		}
+	}
+	sockmany_acceptors = i;
+
+	for (sweep = 1; (sockmany_acceptors > 0) && keep_stressing(args); sweep++) {
+		const char *sweep_reason;
+		const uint64_t conns = stress_sockmany_sweep(args, shared, sweep,
+			sockmany_acceptors, target, fds, &addr, loopback,
+			steps, &n_steps, &sweep_reason);
+
+		if (sweep == 1)
+			reason = sweep_reason;
+		if (conns > 0)
+			sweeps++;
+		else {
+			if (sweep == 1) {
+				pr_fail("%s: no connections established: %s\n",
+					args->name, sweep_reason);
+				rc = EXIT_FAILURE;
+			}
+			break;
+		}
+	}
+
+	shared->stop = true;
+	for (i = 0; i < sockmany_acceptors; i++) {
+		int status;
+
+		(void)kill(pids[i], SIGKILL);
+		(void)shim_waitpid(pids[i], &status, 0);
+	}
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_sockmany_scale_report(args, shared, sockmany_acceptors,
+		steps, n_steps, sweeps, reason);
+
+	(void)munmap((void *)fds, (size_t)target * sizeof(*fds));
+	(void)munmap((void *)shared, shared_size);
+
+	return rc;
+}
+#endif
+
 static void stress_sockmany_sigpipe_handler(int signum)
 {
 	(void)signum;
@@ -313,9 +1033,20 @@ static int stress_sockmany(const stress_args_t *args)
 	int sockmany_port = DEFAULT_SOCKET_MANY_PORT;
 	int rc = EXIT_SUCCESS, reserved_port;
 	char *sockmany_if = NULL;
+	bool sockmany_scale = false;
 
 	(void)stress_get_setting("sockmany-if", &sockmany_if);
 	(void)stress_get_setting("sockmany-port", &sockmany_port);
+	(void)stress_get_setting("sockmany-scale", &sockmany_scale);
+
+#if !defined(STRESS_SOCKMANY_SCALE)
+	if (sockmany_scale) {
+		if (args->instance == 0)
+			pr_inf("%s: --sockmany-scale is not supported on this system, "
+				"running the default mode\n", args->name);
+		sockmany_scale = false;
+	}
+#endif
 
 	if (sockmany_if) {
 		int ret;
@@ -341,6 +1072,17 @@ static int stress_sockmany(const stress_args_t *args)
 	pr_dbg("%s: process [%d] using socket port %d\n",
 		args->name, (int)args->pid, sockmany_port);
 
+	if (stress_sighandler(args->name, SIGPIPE, stress_sockmany_sigpipe_handler, NULL) < 0)
+		return EXIT_NO_RESOURCE;
+
+#if defined(STRESS_SOCKMANY_SCALE)
+	if (sockmany_scale) {
+		rc = stress_sockmany_scale(args, sockmany_port, sockmany_if);
+		stress_net_release_ports(sockmany_port, sockmany_port);
+		return rc;
+	}
+#endif
+
 	sock_fds = (stress_sock_fds_t *)mmap(NULL, sizeof(*sock_fds), PROT_READ | PROT_WRITE,
 		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
 	if (sock_fds == MAP_FAILED) {
@@ -349,9 +1091,6 @@ static int stress_sockmany(const stress_args_t *args)
 		return EXIT_NO_RESOURCE;
 	}
 
-	if (stress_sighandler(args->name, SIGPIPE, stress_sockmany_sigpipe_handler, NULL) < 0)
-		return EXIT_NO_RESOURCE;
-
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 again:
 	pid = fork();
@@ -386,8 +1125,11 @@ finish:
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_sockmany_acceptors,	stress_set_sockmany_acceptors },
+	{ OPT_sockmany_conns,	stress_set_sockmany_conns },
 	{ OPT_sockmany_if,	stress_set_sockmany_if },
 	{ OPT_sockmany_port,	stress_set_sockmany_port },
+	{ OPT_sockmany_scale,	stress_set_sockmany_scale },
 	{ 0,			NULL },
 };
 
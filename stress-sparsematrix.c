@@ -17,6 +17,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arena.h"
 #include "core-pragma.h"
 
 #if defined(HAVE_SYS_TREE_H)
@@ -231,11 +232,46 @@ static int stress_set_sparsematrix_size(const char *opt)
 	return stress_set_setting("sparsematrix-size", TYPE_ID_UINT32, &sparsematrix_size);
 }
 
+static stress_arena_t *sparse_arena;	/* --arena node arena */
+
 static inline uint32_t value_map(const uint32_t x, register uint32_t y)
 {
 	return x ^ ~y;
 }
 
+/*
+ *  sparse_node_alloc()
+ *	allocate a matrix node from the arena or libc
+ */
+static inline void *sparse_node_alloc(const size_t size)
+{
+	if (sparse_arena)
+		return stress_arena_alloc(sparse_arena, size);
+	return malloc(size);
+}
+
+/*
+ *  sparse_node_calloc()
+ *	allocate a zero'd matrix node from the arena or libc
+ */
+static inline void *sparse_node_calloc(const size_t size)
+{
+	if (sparse_arena)
+		return stress_arena_calloc(sparse_arena, 1, size);
+	return calloc(1, size);
+}
+
+/*
+ *  sparse_node_free()
+ *	free a matrix node, arena nodes are freed in bulk
+ *	once each method test completes
+ */
+static inline void sparse_node_free(void *ptr)
+{
+	if (!sparse_arena)
+		free(ptr);
+}
+
 /*
  *  hash_create()
  *	create a hash table based sparse matrix
@@ -282,7 +318,7 @@ static void hash_destroy(void *handle, size_t *objmem)
 
 		while (node) {
 			next = node->next;
-			free(node);
+			sparse_node_free(node);
 			*objmem += sizeof(*node);
 			node = next;
 		}
@@ -320,7 +356,7 @@ static int OPTIMIZE3 hash_put(void *handle, const uint32_t x, const uint32_t y,
 	}
 
 	/* Not found, allocate and add */
-	node = malloc(sizeof(*node));
+	node = sparse_node_alloc(sizeof(*node));
 	if (!node)
 		return -1;
 	node->value = value;
@@ -666,13 +702,13 @@ static int OPTIMIZE3 rb_put(void *handle, const uint32_t x, const uint32_t y, co
 	if (!found) {
 		sparse_rb_t *new_node;
 
-		new_node = malloc(sizeof(*new_node));
+		new_node = sparse_node_alloc(sizeof(*new_node));
 		if (!new_node)
 			return -1;
 		new_node->value = value;
 		new_node->xy = node.xy;
 		if (RB_INSERT(sparse_rb_tree, handle, new_node) != NULL)
-			free(new_node);
+			sparse_node_free(new_node);
 		rb_objmem += sizeof(sparse_rb_t);
 	} else {
 		found->value = value;
@@ -694,7 +730,7 @@ static void OPTIMIZE3 rb_del(void *handle, const uint32_t x, const uint32_t y)
 		return;
 
 	RB_REMOVE(sparse_rb_tree, handle, found);
-	free(found);
+	sparse_node_free(found);
 }
 
 /*
@@ -788,13 +824,13 @@ static int OPTIMIZE3 splay_put(void *handle, const uint32_t x, const uint32_t y,
 	if (!found) {
 		sparse_splay_t *new_node;
 
-		new_node = malloc(sizeof(*new_node));
+		new_node = sparse_node_alloc(sizeof(*new_node));
 		if (!new_node)
 			return -1;
 		new_node->value = value;
 		new_node->xy = node.xy;
 		if (SPLAY_INSERT(sparse_splay_tree, handle, new_node) != NULL)
-			free(new_node);
+			sparse_node_free(new_node);
 		splay_objmem += sizeof(sparse_splay_t);
 	} else {
 		found->value = value;
@@ -816,7 +852,7 @@ static void OPTIMIZE3 splay_del(void *handle, const uint32_t x, const uint32_t y
 		return;
 
 	SPLAY_REMOVE(sparse_splay_tree, handle, found);
-	free(found);
+	sparse_node_free(found);
 }
 
 /*
@@ -874,11 +910,11 @@ static void list_destroy(void *handle, size_t *objmem)
 
 			CIRCLEQ_REMOVE(x_head, x_node, sparse_x_list);
 			*objmem += sizeof(*x_node);
-			free(x_node);
+			sparse_node_free(x_node);
 		}
 		CIRCLEQ_REMOVE(y_head, y_node, sparse_y_list);
 		*objmem += sizeof(*y_node);
-		free(y_node);
+		sparse_node_free(y_node);
 	}
 }
 
@@ -900,7 +936,7 @@ static int OPTIMIZE3 list_put(void *handle, const uint32_t x, const uint32_t y,
 			goto find_x;
 		}
 		if (y_node->y > y) {
-			new_y_node = malloc(sizeof(*new_y_node));
+			new_y_node = sparse_node_alloc(sizeof(*new_y_node));
 			if (!new_y_node)
 				return -1;
 			new_y_node->y = y;
@@ -911,7 +947,7 @@ static int OPTIMIZE3 list_put(void *handle, const uint32_t x, const uint32_t y,
 		}
 	}
 
-	new_y_node = malloc(sizeof(*new_y_node));
+	new_y_node = sparse_node_alloc(sizeof(*new_y_node));
 	if (!new_y_node)
 		return -1;
 	new_y_node->y = y;
@@ -926,7 +962,7 @@ find_x:
 			return 0;
 		}
 		if (x_node->x > x) {
-			new_x_node = malloc(sizeof(*new_x_node));
+			new_x_node = sparse_node_alloc(sizeof(*new_x_node));
 			if (!new_x_node)
 				return -1;  /* Leaves new_y_node allocated */
 			new_x_node->x = x;
@@ -935,7 +971,7 @@ find_x:
 			return 0;
 		}
 	}
-	new_x_node = calloc(1, sizeof(*new_x_node));
+	new_x_node = sparse_node_calloc(sizeof(*new_x_node));
 	if (!new_x_node)
 		return -1;  /* Leaves new_y_node allocated */
 	new_x_node->x = x;
@@ -1196,6 +1232,7 @@ static int stress_sparse_method_test(
 	}
 err:
 	info->destroy(handle, &objmem);
+	stress_arena_reset(sparse_arena);
 	if (objmem > test_info->max_objmem)
 		test_info->max_objmem = objmem;
 
@@ -1434,6 +1471,15 @@ static int stress_sparsematrix(const stress_args_t *args)
 			percent_full);
 	}
 
+	if (g_opt_flags & OPT_FLAGS_ARENA) {
+		sparse_arena = stress_arena_create(0);
+		if (!sparse_arena) {
+			pr_inf_skip("%s: cannot allocate arena, skipping stressor\n",
+				args->name);
+			return EXIT_NO_RESOURCE;
+		}
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
@@ -1498,6 +1544,8 @@ static int stress_sparsematrix(const stress_args_t *args)
 	rc = EXIT_SUCCESS;
 err:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_arena_destroy(sparse_arena);
+	sparse_arena = NULL;
 
 	return rc;
 }
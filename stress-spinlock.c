@@ -0,0 +1,701 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-asm-x86.h"
+
+#define MIN_SPINLOCK_THREADS	(1)
+#define MAX_SPINLOCK_THREADS	(1024)
+
+#define MIN_SPINLOCK_CS		(0)
+#define MAX_SPINLOCK_CS		(1000000)
+#define DEFAULT_SPINLOCK_CS	(100)
+
+#define SPINLOCK_PHASE_USEC	(100000)	/* duration of each measurement */
+#define SPINLOCK_YIELD		(1000)		/* spins before a waiter yields */
+#define SPINLOCK_SWEEP_CS	(4)		/* critical section lengths swept */
+#define SPINLOCK_SWEEP_THREADS	(12)		/* max thread counts swept, 1, 2, 4, .. */
+
+static const stress_help_t help[] = {
+	{ NULL,	"spinlock N",		"start N workers exercising user space lock algorithms" },
+	{ NULL,	"spinlock-cs N",	"critical section length in shared data updates" },
+	{ NULL,	"spinlock-method M",	"select lock, one of all, tas, ttas, ticket, mcs, clh, qspinlock or mutex" },
+	{ NULL,	"spinlock-ops N",	"stop after N spinlock bogo operations" },
+	{ NULL,	"spinlock-sweep",	"sweep thread counts and critical section lengths" },
+	{ NULL,	"spinlock-threads N",	"number of threads contending for the lock" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_spinlock_cs(const char *opt)
+{
+	uint32_t spinlock_cs;
+
+	spinlock_cs = stress_get_uint32(opt);
+	stress_check_range("spinlock-cs", (uint64_t)spinlock_cs,
+		MIN_SPINLOCK_CS, MAX_SPINLOCK_CS);
+	return stress_set_setting("spinlock-cs", TYPE_ID_UINT32, &spinlock_cs);
+}
+
+static int stress_set_spinlock_threads(const char *opt)
+{
+	uint32_t spinlock_threads;
+
+	spinlock_threads = stress_get_uint32(opt);
+	stress_check_range("spinlock-threads", (uint64_t)spinlock_threads,
+		MIN_SPINLOCK_THREADS, MAX_SPINLOCK_THREADS);
+	return stress_set_setting("spinlock-threads", TYPE_ID_UINT32, &spinlock_threads);
+}
+
+static int stress_set_spinlock_sweep(const char *opt)
+{
+	return stress_set_setting_true("spinlock-sweep", opt);
+}
+
+static int stress_set_spinlock_method(const char *opt);
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_spinlock_cs,	stress_set_spinlock_cs },
+	{ OPT_spinlock_method,	stress_set_spinlock_method },
+	{ OPT_spinlock_sweep,	stress_set_spinlock_sweep },
+	{ OPT_spinlock_threads,	stress_set_spinlock_threads },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_ATOMIC) &&			\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&		\
+    defined(HAVE_ATOMIC_FETCH_AND) &&		\
+    defined(HAVE_ATOMIC_FETCH_OR) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+
+#define SPINLOCK_Q_LOCKED	(1ULL)		/* qspinlock locked bit */
+#define SPINLOCK_Q_TAIL_SHIFT	(32)		/* qspinlock tail thread id */
+
+/*
+ *  MCS and qspinlock waiters spin on their own queue node, CLH
+ *  waiters spin on their predecessor's node
+ */
+typedef struct stress_spinlock_node {
+	struct stress_spinlock_node *next;	/* MCS successor */
+	int locked;				/* non-zero while waiting or held */
+} ALIGN64 stress_spinlock_node_t;
+
+struct stress_spinlock_thread;
+
+/*
+ *  All the locks, each on its own cache line
+ */
+typedef struct {
+	int tas ALIGN64;				/* tas and ttas lock */
+	uint32_t ticket_next ALIGN64;			/* next ticket to hand out */
+	uint32_t ticket_serving ALIGN64;		/* ticket holding the lock */
+	stress_spinlock_node_t *mcs_tail ALIGN64;	/* MCS queue tail */
+	stress_spinlock_node_t *clh_tail ALIGN64;	/* CLH queue tail */
+	uint64_t qword ALIGN64;				/* qspinlock locked bit and tail */
+	pthread_mutex_t mutex ALIGN64;			/* baseline libc mutex */
+	stress_spinlock_node_t clh_dummy;		/* initial CLH tail */
+	struct stress_spinlock_thread *threads;		/* qspinlock tail id to node */
+	uint64_t counter ALIGN64;			/* protected by the lock */
+	uint64_t work[8];				/* critical section data */
+	bool start ALIGN64;				/* threads start contending */
+	bool stop;					/* threads stop contending */
+} stress_spinlock_shared_t;
+
+typedef struct stress_spinlock_thread {
+	stress_spinlock_shared_t *shared;		/* the locks */
+	const struct stress_spinlock_method *method;	/* lock being measured */
+	uint32_t cs;					/* critical section length */
+	uint32_t id;					/* 1 based thread id */
+	pthread_t pthread;				/* thread handle */
+	int ret;					/* pthread_create return */
+	uint64_t count;					/* acquisitions */
+	stress_spinlock_node_t node;			/* MCS and qspinlock node */
+	stress_spinlock_node_t clh_own;			/* CLH node owned at start */
+	stress_spinlock_node_t *clh_node;		/* CLH node currently owned */
+	stress_spinlock_node_t *clh_pred;		/* CLH predecessor node */
+} ALIGN64 stress_spinlock_thread_t;
+
+typedef struct stress_spinlock_method {
+	const char *name;
+	void (*acquire)(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread);
+	void (*release)(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread);
+} stress_spinlock_method_t;
+
+typedef struct {
+	double acquires;	/* total acquisitions */
+	double duration;	/* total contention time */
+	double jain;		/* sum of Jain's fairness index of each phase */
+	double cov;		/* sum of per thread acquisitions coefficient of variation */
+	double phases;		/* phases measured */
+} stress_spinlock_stats_t;
+
+/*
+ *  stress_spinlock_relax()
+ *	pause while spinning, yield the CPU after SPINLOCK_YIELD spins
+ *	so that preempted lock holders and queue heads can run when the
+ *	CPUs are oversubscribed
+ */
+static inline void stress_spinlock_relax(uint32_t *spins)
+{
+	if (++(*spins) >= SPINLOCK_YIELD) {
+		*spins = 0;
+		(void)shim_sched_yield();
+		return;
+	}
+#if defined(HAVE_ASM_X86_PAUSE)
+	stress_asm_x86_pause();
+#endif
+}
+
+/*
+ *  tas: test and set, every waiter writes the lock line
+ */
+static void stress_spinlock_tas_acquire(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	uint32_t spins = 0;
+
+	(void)thread;
+	while (__atomic_exchange_n(&shared->tas, 1, __ATOMIC_ACQUIRE))
+		stress_spinlock_relax(&spins);
+}
+
+static void stress_spinlock_tas_release(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	(void)thread;
+	__atomic_store_n(&shared->tas, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ *  ttas: test and test and set, waiters spin reading the lock
+ *  line and only write it when the lock looks free
+ */
+static void stress_spinlock_ttas_acquire(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	uint32_t spins = 0;
+
+	(void)thread;
+	for (;;) {
+		while (__atomic_load_n(&shared->tas, __ATOMIC_RELAXED))
+			stress_spinlock_relax(&spins);
+		if (!__atomic_exchange_n(&shared->tas, 1, __ATOMIC_ACQUIRE))
+			return;
+	}
+}
+
+/*
+ *  ticket: FIFO, waiters take a ticket and spin until it is served,
+ *  all waiters spin on the one serving line
+ */
+static void stress_spinlock_ticket_acquire(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	const uint32_t ticket = __atomic_fetch_add(&shared->ticket_next, 1, __ATOMIC_RELAXED);
+	uint32_t spins = 0;
+
+	(void)thread;
+	while (__atomic_load_n(&shared->ticket_serving, __ATOMIC_ACQUIRE) != ticket)
+		stress_spinlock_relax(&spins);
+}
+
+static void stress_spinlock_ticket_release(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	const uint32_t serving = __atomic_load_n(&shared->ticket_serving, __ATOMIC_RELAXED);
+
+	(void)thread;
+	__atomic_store_n(&shared->ticket_serving, serving + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *  mcs: FIFO queue of waiter nodes, each waiter spins on its own
+ *  node and the releaser hands the lock to its successor
+ */
+static void stress_spinlock_mcs_acquire(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	stress_spinlock_node_t *node = &thread->node, *prev;
+	uint32_t spins = 0;
+
+	__atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&node->locked, 1, __ATOMIC_RELAXED);
+	prev = __atomic_exchange_n(&shared->mcs_tail, node, __ATOMIC_ACQ_REL);
+	if (prev) {
+		__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+		while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+			stress_spinlock_relax(&spins);
+	}
+}
+
+static void stress_spinlock_mcs_release(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	stress_spinlock_node_t *node = &thread->node, *next;
+	uint32_t spins = 0;
+
+	next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+	if (!next) {
+		stress_spinlock_node_t *expected = node;
+
+		if (__atomic_compare_exchange_n(&shared->mcs_tail, &expected, NULL,
+				false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			return;
+		/* a waiter has swapped the tail but not yet linked in */
+		while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+			stress_spinlock_relax(&spins);
+	}
+	__atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ *  clh: FIFO implicit queue, each waiter spins on its predecessor's
+ *  node and takes over that node when it releases the lock
+ */
+static void stress_spinlock_clh_acquire(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	stress_spinlock_node_t *node = thread->clh_node, *pred;
+	uint32_t spins = 0;
+
+	__atomic_store_n(&node->locked, 1, __ATOMIC_RELAXED);
+	pred = __atomic_exchange_n(&shared->clh_tail, node, __ATOMIC_ACQ_REL);
+	while (__atomic_load_n(&pred->locked, __ATOMIC_ACQUIRE))
+		stress_spinlock_relax(&spins);
+	thread->clh_pred = pred;
+}
+
+static void stress_spinlock_clh_release(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	(void)shared;
+	__atomic_store_n(&thread->clh_node->locked, 0, __ATOMIC_RELEASE);
+	thread->clh_node = thread->clh_pred;
+}
+
+/*
+ *  qspinlock: modelled on the Linux queued spinlock, one 64 bit word
+ *  holds a locked bit and the thread id of the MCS queue tail, an
+ *  uncontended acquire is one compare and swap of 0 to locked, waiters
+ *  queue MCS style and only the queue head spins on the lock word,
+ *  the pending bit optimisation is not implemented
+ */
+static void stress_spinlock_qspinlock_acquire(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	stress_spinlock_node_t *node = &thread->node, *next;
+	const uint64_t tail = (uint64_t)thread->id << SPINLOCK_Q_TAIL_SHIFT;
+	uint64_t word = 0, prev;
+	uint32_t spins = 0;
+
+	if (__atomic_compare_exchange_n(&shared->qword, &word, SPINLOCK_Q_LOCKED,
+			false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	__atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&node->locked, 1, __ATOMIC_RELAXED);
+	word = __atomic_load_n(&shared->qword, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&shared->qword, &word,
+			(word & SPINLOCK_Q_LOCKED) | tail,
+			true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		;
+	prev = word >> SPINLOCK_Q_TAIL_SHIFT;
+	if (prev) {
+		stress_spinlock_node_t *prev_node = &shared->threads[prev - 1].node;
+
+		__atomic_store_n(&prev_node->next, node, __ATOMIC_RELEASE);
+		while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+			stress_spinlock_relax(&spins);
+	}
+
+	/* queue head, wait for the owner to release */
+	while ((word = __atomic_load_n(&shared->qword, __ATOMIC_ACQUIRE)) & SPINLOCK_Q_LOCKED)
+		stress_spinlock_relax(&spins);
+
+	/* last in the queue, take the lock and empty the queue */
+	if (word == tail) {
+		if (__atomic_compare_exchange_n(&shared->qword, &word, SPINLOCK_Q_LOCKED,
+				false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return;
+	}
+	/* the non-zero tail stops fast path acquires, so just set locked */
+	(void)__atomic_fetch_or(&shared->qword, SPINLOCK_Q_LOCKED, __ATOMIC_ACQUIRE);
+	while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+		stress_spinlock_relax(&spins);
+	__atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+static void stress_spinlock_qspinlock_release(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	(void)thread;
+	(void)__atomic_fetch_and(&shared->qword, ~SPINLOCK_Q_LOCKED, __ATOMIC_RELEASE);
+}
+
+static void stress_spinlock_mutex_acquire(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	(void)thread;
+	(void)pthread_mutex_lock(&shared->mutex);
+}
+
+static void stress_spinlock_mutex_release(stress_spinlock_shared_t *shared, stress_spinlock_thread_t *thread)
+{
+	(void)thread;
+	(void)pthread_mutex_unlock(&shared->mutex);
+}
+
+static const stress_spinlock_method_t spinlock_methods[] = {
+	{ "tas",	stress_spinlock_tas_acquire,		stress_spinlock_tas_release },
+	{ "ttas",	stress_spinlock_ttas_acquire,		stress_spinlock_tas_release },
+	{ "ticket",	stress_spinlock_ticket_acquire,		stress_spinlock_ticket_release },
+	{ "mcs",	stress_spinlock_mcs_acquire,		stress_spinlock_mcs_release },
+	{ "clh",	stress_spinlock_clh_acquire,		stress_spinlock_clh_release },
+	{ "qspinlock",	stress_spinlock_qspinlock_acquire,	stress_spinlock_qspinlock_release },
+	{ "mutex",	stress_spinlock_mutex_acquire,		stress_spinlock_mutex_release },
+};
+
+#define SPINLOCK_METHODS	(SIZEOF_ARRAY(spinlock_methods))
+
+static int stress_set_spinlock_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = SPINLOCK_METHODS;
+		return stress_set_setting("spinlock-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < SPINLOCK_METHODS; i++) {
+		if (!strcmp(opt, spinlock_methods[i].name))
+			return stress_set_setting("spinlock-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "spinlock-method must be one of: all");
+	for (i = 0; i < SPINLOCK_METHODS; i++)
+		(void)fprintf(stderr, " %s", spinlock_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_spinlock_func()
+ *	acquire the lock, update the shared data cs times and release
+ *	the lock as often as possible until told to stop
+ */
+static void *stress_spinlock_func(void *arg)
+{
+	static void *nowt = NULL;
+	stress_spinlock_thread_t *thread = (stress_spinlock_thread_t *)arg;
+	stress_spinlock_shared_t *shared = thread->shared;
+	const stress_spinlock_method_t *method = thread->method;
+	const uint32_t cs = thread->cs;
+	uint32_t spins = 0;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	while (!__atomic_load_n(&shared->start, __ATOMIC_ACQUIRE))
+		stress_spinlock_relax(&spins);
+
+	while (!__atomic_load_n(&shared->stop, __ATOMIC_RELAXED)) {
+		register uint32_t i;
+
+		method->acquire(shared, thread);
+		shared->counter++;
+		for (i = 0; i < cs; i++)
+			shared->work[i & 7] += i;
+		method->release(shared, thread);
+		thread->count++;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_spinlock_phase()
+ *	contend for one lock with n threads for SPINLOCK_PHASE_USEC
+ *	and add the throughput and fairness to stats, returns false
+ *	if the lock failed to provide mutual exclusion
+ */
+static bool stress_spinlock_phase(
+	const stress_args_t *args,
+	stress_spinlock_shared_t *shared,
+	stress_spinlock_thread_t *threads,
+	const uint32_t n,
+	const stress_spinlock_method_t *method,
+	const uint32_t cs,
+	stress_spinlock_stats_t *stats)
+{
+	uint32_t i, started = 0;
+	uint64_t total = 0;
+	double t, duration, sum = 0.0, sum_sq = 0.0, mean, var;
+
+	shared->tas = 0;
+	shared->ticket_next = 0;
+	shared->ticket_serving = 0;
+	shared->mcs_tail = NULL;
+	shared->clh_dummy.locked = 0;
+	shared->clh_tail = &shared->clh_dummy;
+	shared->qword = 0;
+	shared->counter = 0;
+	shared->start = false;
+	shared->stop = false;
+	shared->threads = threads;
+
+	for (i = 0; i < n; i++) {
+		stress_spinlock_thread_t *thread = &threads[i];
+
+		thread->shared = shared;
+		thread->method = method;
+		thread->cs = cs;
+		thread->id = i + 1;
+		thread->count = 0;
+		thread->clh_own.locked = 0;
+		thread->clh_node = &thread->clh_own;
+		thread->ret = pthread_create(&thread->pthread, NULL,
+			stress_spinlock_func, (void *)thread);
+		if (!thread->ret)
+			started++;
+	}
+
+	t = stress_time_now();
+	__atomic_store_n(&shared->start, true, __ATOMIC_RELEASE);
+	if (started)
+		(void)shim_usleep(SPINLOCK_PHASE_USEC);
+	__atomic_store_n(&shared->stop, true, __ATOMIC_RELAXED);
+	for (i = 0; i < n; i++) {
+		if (!threads[i].ret)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	duration = stress_time_now() - t;
+	if (!started)
+		return true;
+
+	for (i = 0; i < n; i++) {
+		const double count = (double)threads[i].count;
+
+		if (threads[i].ret)
+			continue;
+		total += threads[i].count;
+		sum += count;
+		sum_sq += count * count;
+	}
+	if (total != shared->counter) {
+		pr_fail("%s: %s lock did not provide mutual exclusion, %" PRIu64
+			" acquisitions but the protected counter is %" PRIu64 "\n",
+			args->name, method->name, total, shared->counter);
+		return false;
+	}
+
+	mean = sum / (double)started;
+	var = (sum_sq / (double)started) - (mean * mean);
+	stats->acquires += sum;
+	stats->duration += duration;
+	stats->jain += (sum_sq > 0.0) ? (sum * sum) / ((double)started * sum_sq) : 1.0;
+	stats->cov += (mean > 0.0) ? sqrt(STRESS_MAXIMUM(var, 0.0)) / mean : 0.0;
+	stats->phases += 1.0;
+
+	return true;
+}
+
+static inline double stress_spinlock_rate(const stress_spinlock_stats_t *stats)
+{
+	return (stats->duration > 0.0) ? stats->acquires / stats->duration : 0.0;
+}
+
+/*
+ *  stress_spinlock_sweep_report()
+ *	print tables of throughput and fairness of each lock over
+ *	the thread counts and critical section lengths
+ */
+static void stress_spinlock_sweep_report(
+	const stress_args_t *args,
+	stress_spinlock_stats_t stats[SPINLOCK_METHODS][SPINLOCK_SWEEP_THREADS][SPINLOCK_SWEEP_CS],
+	const uint32_t *thread_counts,
+	const size_t n_threads,
+	const uint32_t *cs_lens,
+	const size_t spinlock_method)
+{
+	size_t m, t, c;
+	int table;
+
+	pr_lock();
+	for (table = 0; table < 2; table++) {
+		pr_inf("%s: %-10s %7s %9" PRIu32 " %9" PRIu32 " %9" PRIu32 " %9" PRIu32 "  (%s, by critical section length)\n",
+			args->name, "lock", "threads", cs_lens[0], cs_lens[1], cs_lens[2], cs_lens[3],
+			table ? "Jain's fairness index" : "M acquires per sec");
+		for (m = 0; m < SPINLOCK_METHODS; m++) {
+			if ((spinlock_method < SPINLOCK_METHODS) && (spinlock_method != m))
+				continue;
+			for (t = 0; t < n_threads; t++) {
+				char val[SPINLOCK_SWEEP_CS][16];
+
+				for (c = 0; c < SPINLOCK_SWEEP_CS; c++) {
+					const stress_spinlock_stats_t *s = &stats[m][t][c];
+
+					if (s->phases <= 0.0)
+						(void)shim_strlcpy(val[c], "-", sizeof(val[c]));
+					else if (table)
+						(void)snprintf(val[c], sizeof(val[c]), "%.3f", s->jain / s->phases);
+					else
+						(void)snprintf(val[c], sizeof(val[c]), "%.3f",
+							stress_spinlock_rate(s) / 1.0E6);
+				}
+				pr_inf("%s: %-10s %7" PRIu32 " %9s %9s %9s %9s\n", args->name,
+					spinlock_methods[m].name, thread_counts[t],
+					val[0], val[1], val[2], val[3]);
+			}
+		}
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_spinlock()
+ *	measure the throughput and fairness of each lock
+ */
+static int stress_spinlock(const stress_args_t *args)
+{
+	static stress_spinlock_stats_t sweep[SPINLOCK_METHODS][SPINLOCK_SWEEP_THREADS][SPINLOCK_SWEEP_CS];
+	static const uint32_t cs_lens[SPINLOCK_SWEEP_CS] = { 0, 16, 256, 4096 };
+	stress_spinlock_stats_t stats[SPINLOCK_METHODS];
+	uint32_t spinlock_threads = (uint32_t)STRESS_MAXIMUM(2, stress_get_processors_online());
+	uint32_t spinlock_cs = DEFAULT_SPINLOCK_CS;
+	uint32_t thread_counts[SPINLOCK_SWEEP_THREADS];
+	size_t spinlock_method = SPINLOCK_METHODS;
+	size_t n_threads = 0, m, t, c, i;
+	bool spinlock_sweep = false;
+	stress_spinlock_shared_t *shared;
+	stress_spinlock_thread_t *threads;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("spinlock-cs", &spinlock_cs);
+	(void)stress_get_setting("spinlock-method", &spinlock_method);
+	(void)stress_get_setting("spinlock-sweep", &spinlock_sweep);
+	(void)stress_get_setting("spinlock-threads", &spinlock_threads);
+	if (spinlock_threads < MIN_SPINLOCK_THREADS)
+		spinlock_threads = MIN_SPINLOCK_THREADS;
+	if (spinlock_threads > MAX_SPINLOCK_THREADS)
+		spinlock_threads = MAX_SPINLOCK_THREADS;
+
+	/* thread counts 1, 2, 4 .. and spinlock-threads */
+	for (t = 1; (t < spinlock_threads) && (n_threads < SPINLOCK_SWEEP_THREADS - 1); t <<= 1)
+		thread_counts[n_threads++] = (uint32_t)t;
+	thread_counts[n_threads++] = spinlock_threads;
+
+	shared = calloc(1, sizeof(*shared));
+	threads = calloc(spinlock_threads, sizeof(*threads));
+	if (!shared || !threads) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " threads, skipping stressor\n",
+			args->name, spinlock_threads);
+		free(threads);
+		free(shared);
+		return EXIT_NO_RESOURCE;
+	}
+	if (pthread_mutex_init(&shared->mutex, NULL)) {
+		pr_inf_skip("%s: cannot initialize mutex, skipping stressor\n", args->name);
+		free(threads);
+		free(shared);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(stats, 0, sizeof(stats));
+	(void)memset(sweep, 0, sizeof(sweep));
+
+	if ((args->instance == 0) && (args->num_instances > 1) &&
+	    (spinlock_threads > 1))
+		pr_inf("%s: %" PRIu32 " instances each running %" PRIu32
+			" threads contend for separate locks, try 1 instance\n",
+			args->name, args->num_instances, spinlock_threads);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; (rc == EXIT_SUCCESS) && (m < SPINLOCK_METHODS); m++) {
+			if ((spinlock_method < SPINLOCK_METHODS) && (spinlock_method != m))
+				continue;
+			if (!spinlock_sweep) {
+				if (!stress_spinlock_phase(args, shared, threads, spinlock_threads,
+						&spinlock_methods[m], spinlock_cs, &stats[m]))
+					rc = EXIT_FAILURE;
+				inc_counter(args);
+				continue;
+			}
+			for (t = 0; (rc == EXIT_SUCCESS) && (t < n_threads); t++) {
+				for (c = 0; c < SPINLOCK_SWEEP_CS; c++) {
+					if (!stress_spinlock_phase(args, shared, threads, thread_counts[t],
+							&spinlock_methods[m], cs_lens[c], &sweep[m][t][c])) {
+						rc = EXIT_FAILURE;
+						break;
+					}
+					inc_counter(args);
+					if (!keep_stressing(args))
+						break;
+				}
+				if (!keep_stressing(args))
+					break;
+			}
+			if (!keep_stressing(args))
+				break;
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (spinlock_sweep) {
+		if (args->instance == 0)
+			stress_spinlock_sweep_report(args, sweep, thread_counts, n_threads,
+				cs_lens, spinlock_method);
+	} else {
+		for (i = 0, m = 0; m < SPINLOCK_METHODS; m++) {
+			char str[64];
+
+			if (stats[m].phases <= 0.0)
+				continue;
+			(void)snprintf(str, sizeof(str), "%s acquires per sec", spinlock_methods[m].name);
+			stress_metrics_set(args, i++, str, stress_spinlock_rate(&stats[m]));
+			(void)snprintf(str, sizeof(str), "%s Jain's fairness index", spinlock_methods[m].name);
+			stress_metrics_set(args, i++, str, stats[m].jain / stats[m].phases);
+			(void)snprintf(str, sizeof(str), "%s per thread acquires CoV", spinlock_methods[m].name);
+			stress_metrics_set(args, i++, str, stats[m].cov / stats[m].phases);
+		}
+	}
+
+	(void)pthread_mutex_destroy(&shared->mutex);
+	free(threads);
+	free(shared);
+
+	return rc;
+}
+
+stressor_info_t stress_spinlock_info = {
+	.stressor = stress_spinlock,
+	.class = CLASS_CPU | CLASS_SCHEDULER,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
+#else
+
+static int stress_set_spinlock_method(const char *opt)
+{
+	(void)opt;
+
+	(void)pr_inf("warning: --spinlock-method not available on this system\n");
+	return 0;
+}
+
+stressor_info_t stress_spinlock_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_CPU | CLASS_SCHEDULER,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help,
+	.unimplemented_reason = "built without pthread support or gcc __atomic builtins"
+};
+#endif
@@ -0,0 +1,885 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-sort.h"
+
+#define MIN_SPMV_SIZE		(1 * KB)
+#define MAX_SPMV_SIZE		(4 * MB)
+#define DEFAULT_SPMV_SIZE	(64 * KB)
+
+#define MIN_SPMV_NNZ		(1)
+#define MAX_SPMV_NNZ		(256)
+#define DEFAULT_SPMV_NNZ	(16)
+
+#define MIN_SPMV_THREADS	(1)
+#define MAX_SPMV_THREADS	(1024)
+
+#define SPMV_LOOPS		(8)	/* multiplies per method per bogo op */
+#define SPMV_BLOCK		(4)	/* blocked CSR blocks are 4 x 4 */
+#define SPMV_MAX_FILL		(4)	/* max stored values per non-zero for ELL and BCSR */
+#define SPMV_POWERLAW_CAP	(64)	/* max powerlaw row length in mean row lengths */
+
+#define SPMV_PATTERN_RANDOM	(0)
+#define SPMV_PATTERN_BANDED	(1)
+#define SPMV_PATTERN_POWERLAW	(2)
+#define SPMV_PATTERN_BLOCK	(3)
+
+static const stress_help_t help[] = {
+	{ NULL,	"spmv N",		"start N workers exercising sparse matrix-vector multiplies" },
+	{ NULL,	"spmv-method M",	"select format, one of all, coo, csr, ell or bcsr" },
+	{ NULL,	"spmv-nnz N",		"mean number of non-zeros per matrix row" },
+	{ NULL,	"spmv-ops N",		"stop after N spmv bogo operations" },
+	{ NULL,	"spmv-pattern P",	"select sparsity pattern, one of random, banded, powerlaw or block" },
+	{ NULL,	"spmv-size N",		"number of matrix rows and columns" },
+	{ NULL,	"spmv-threads N",	"number of threads per multiply, default is 1" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const spmv_patterns[] = {
+	"random",
+	"banded",
+	"powerlaw",
+	"block",
+};
+
+static int stress_set_spmv_size(const char *opt)
+{
+	uint64_t spmv_size;
+
+	spmv_size = stress_get_uint64_byte(opt);
+	stress_check_range("spmv-size", spmv_size,
+		MIN_SPMV_SIZE, MAX_SPMV_SIZE);
+	return stress_set_setting("spmv-size", TYPE_ID_UINT64, &spmv_size);
+}
+
+static int stress_set_spmv_nnz(const char *opt)
+{
+	uint32_t spmv_nnz;
+
+	spmv_nnz = stress_get_uint32(opt);
+	stress_check_range("spmv-nnz", (uint64_t)spmv_nnz,
+		MIN_SPMV_NNZ, MAX_SPMV_NNZ);
+	return stress_set_setting("spmv-nnz", TYPE_ID_UINT32, &spmv_nnz);
+}
+
+static int stress_set_spmv_threads(const char *opt)
+{
+	uint32_t spmv_threads;
+
+	spmv_threads = stress_get_uint32(opt);
+	stress_check_range("spmv-threads", (uint64_t)spmv_threads,
+		MIN_SPMV_THREADS, MAX_SPMV_THREADS);
+	return stress_set_setting("spmv-threads", TYPE_ID_UINT32, &spmv_threads);
+}
+
+static int stress_set_spmv_pattern(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(spmv_patterns); i++) {
+		if (!strcmp(opt, spmv_patterns[i]))
+			return stress_set_setting("spmv-pattern", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "spmv-pattern must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(spmv_patterns); i++)
+		(void)fprintf(stderr, " %s", spmv_patterns[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_spmv_method(const char *opt);
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_spmv_method,	stress_set_spmv_method },
+	{ OPT_spmv_nnz,		stress_set_spmv_nnz },
+	{ OPT_spmv_pattern,	stress_set_spmv_pattern },
+	{ OPT_spmv_size,	stress_set_spmv_size },
+	{ OPT_spmv_threads,	stress_set_spmv_threads },
+	{ 0,			NULL }
+};
+
+/*
+ *  The n x n matrix is held in all the formats at once, COO shares
+ *  the CSR column indices and values and adds a row index per
+ *  non-zero, ELL pads every row to the longest row, BCSR stores
+ *  dense 4 x 4 blocks, x and y are padded to a multiple of 4
+ */
+typedef struct {
+	size_t n;		/* rows and columns */
+	size_t n_pad;		/* n rounded up to a multiple of SPMV_BLOCK */
+	size_t nnz;		/* non-zeros */
+	uint32_t threads;	/* threads per multiply */
+	uint32_t *csr_ptr;	/* CSR row starts, n + 1 */
+	uint32_t *col;		/* CSR and COO column indices, nnz */
+	double *val;		/* CSR and COO values, nnz */
+	uint32_t *coo_row;	/* COO row indices, nnz */
+	size_t ell_width;	/* ELL row width, 0 if not built */
+	uint32_t *ell_col;	/* ELL column indices, n * ell_width */
+	double *ell_val;	/* ELL values, n * ell_width */
+	size_t bcsr_rows;	/* BCSR block rows */
+	size_t bcsr_blocks;	/* BCSR blocks, 0 if not built */
+	uint32_t *bcsr_ptr;	/* BCSR block row starts, bcsr_rows + 1 */
+	uint32_t *bcsr_col;	/* BCSR block column indices, bcsr_blocks */
+	double *bcsr_val;	/* BCSR block values, row major, 16 per block */
+	double *x;		/* input vector, n_pad */
+	double *y;		/* output vector, n_pad */
+	double *yref;		/* reference output vector, n */
+} stress_spmv_context_t;
+
+typedef struct {
+	const char *name;	/* method name */
+	void (*spmv)(const stress_spmv_context_t *ctxt, const uint32_t id, const uint32_t threads);
+	size_t (*bytes)(const stress_spmv_context_t *ctxt);	/* matrix bytes read, 0 if not built */
+} stress_spmv_method_t;
+
+/*
+ *  stress_spmv_split()
+ *	first row of part id of threads parts of ptr[0..n], the
+ *	parts are split so each holds about the same number of entries
+ */
+static size_t stress_spmv_split(const uint32_t *ptr, const size_t n, const uint32_t id, const uint32_t threads)
+{
+	const uint64_t target = ((uint64_t)ptr[n] * id) / threads;
+	size_t lo = 0, hi = n;
+
+	if (id >= threads)
+		return n;
+	while (lo < hi) {
+		const size_t mid = lo + ((hi - lo) >> 1);
+
+		if ((uint64_t)ptr[mid] < target)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ *  stress_spmv_coo()
+ *	y = Ax, A in row sorted coordinate format, each thread zeros
+ *	and then accumulates into the rows of its share of the triplets
+ */
+static void OPTIMIZE3 stress_spmv_coo(const stress_spmv_context_t *ctxt, const uint32_t id, const uint32_t threads)
+{
+	const size_t lo = stress_spmv_split(ctxt->csr_ptr, ctxt->n, id, threads);
+	const size_t hi = stress_spmv_split(ctxt->csr_ptr, ctxt->n, id + 1, threads);
+	const uint32_t *row = ctxt->coo_row, *col = ctxt->col;
+	const double *val = ctxt->val, *x = ctxt->x;
+	double *y = ctxt->y;
+	register size_t k;
+	const size_t end = ctxt->csr_ptr[hi];
+
+	for (k = lo; k < hi; k++)
+		y[k] = 0.0;
+	for (k = ctxt->csr_ptr[lo]; k < end; k++)
+		y[row[k]] += val[k] * x[col[k]];
+}
+
+static size_t stress_spmv_coo_bytes(const stress_spmv_context_t *ctxt)
+{
+	return ctxt->nnz * (sizeof(*ctxt->coo_row) + sizeof(*ctxt->col) + sizeof(*ctxt->val));
+}
+
+/*
+ *  stress_spmv_csr()
+ *	y = Ax, A in compressed sparse row format
+ */
+static void OPTIMIZE3 stress_spmv_csr(const stress_spmv_context_t *ctxt, const uint32_t id, const uint32_t threads)
+{
+	const size_t lo = stress_spmv_split(ctxt->csr_ptr, ctxt->n, id, threads);
+	const size_t hi = stress_spmv_split(ctxt->csr_ptr, ctxt->n, id + 1, threads);
+	const uint32_t *ptr = ctxt->csr_ptr, *col = ctxt->col;
+	const double *val = ctxt->val, *x = ctxt->x;
+	double *y = ctxt->y;
+	register size_t r;
+
+	for (r = lo; r < hi; r++) {
+		register size_t k;
+		register const size_t end = ptr[r + 1];
+		register double sum = 0.0;
+
+		for (k = ptr[r]; k < end; k++)
+			sum += val[k] * x[col[k]];
+		y[r] = sum;
+	}
+}
+
+static size_t stress_spmv_csr_bytes(const stress_spmv_context_t *ctxt)
+{
+	return ((ctxt->n + 1) * sizeof(*ctxt->csr_ptr)) +
+		(ctxt->nnz * (sizeof(*ctxt->col) + sizeof(*ctxt->val)));
+}
+
+/*
+ *  stress_spmv_ell()
+ *	y = Ax, A in ELLPACK format, rows are padded to the same width
+ *	with zeros so the inner loop has a fixed trip count and no row
+ *	pointers, the rows are laid out one after the other
+ */
+static void OPTIMIZE3 stress_spmv_ell(const stress_spmv_context_t *ctxt, const uint32_t id, const uint32_t threads)
+{
+	const size_t lo = (ctxt->n * id) / threads, hi = (ctxt->n * (id + 1)) / threads;
+	const size_t w = ctxt->ell_width;
+	const uint32_t *col = ctxt->ell_col + (lo * w);
+	const double *val = ctxt->ell_val + (lo * w), *x = ctxt->x;
+	double *y = ctxt->y;
+	register size_t r;
+
+	for (r = lo; r < hi; r++, col += w, val += w) {
+		register size_t j;
+		register double sum = 0.0;
+
+		for (j = 0; j < w; j++)
+			sum += val[j] * x[col[j]];
+		y[r] = sum;
+	}
+}
+
+static size_t stress_spmv_ell_bytes(const stress_spmv_context_t *ctxt)
+{
+	return ctxt->n * ctxt->ell_width * (sizeof(*ctxt->ell_col) + sizeof(*ctxt->ell_val));
+}
+
+/*
+ *  stress_spmv_bcsr()
+ *	y = Ax, A in 4 x 4 blocked compressed sparse row format, one
+ *	column index per block and 4 contiguous x values per block
+ */
+static void OPTIMIZE3 stress_spmv_bcsr(const stress_spmv_context_t *ctxt, const uint32_t id, const uint32_t threads)
+{
+	const size_t lo = stress_spmv_split(ctxt->bcsr_ptr, ctxt->bcsr_rows, id, threads);
+	const size_t hi = stress_spmv_split(ctxt->bcsr_ptr, ctxt->bcsr_rows, id + 1, threads);
+	const uint32_t *ptr = ctxt->bcsr_ptr, *col = ctxt->bcsr_col;
+	const double *x = ctxt->x;
+	double *y = ctxt->y;
+	register size_t br;
+
+	for (br = lo; br < hi; br++) {
+		register size_t b;
+		const size_t end = ptr[br + 1];
+		double y0 = 0.0, y1 = 0.0, y2 = 0.0, y3 = 0.0;
+
+		for (b = ptr[br]; b < end; b++) {
+			const double *v = ctxt->bcsr_val + (b * SPMV_BLOCK * SPMV_BLOCK);
+			const double *xb = x + ((size_t)col[b] * SPMV_BLOCK);
+			const double x0 = xb[0], x1 = xb[1], x2 = xb[2], x3 = xb[3];
+
+			y0 += (v[0] * x0) + (v[1] * x1) + (v[2] * x2) + (v[3] * x3);
+			y1 += (v[4] * x0) + (v[5] * x1) + (v[6] * x2) + (v[7] * x3);
+			y2 += (v[8] * x0) + (v[9] * x1) + (v[10] * x2) + (v[11] * x3);
+			y3 += (v[12] * x0) + (v[13] * x1) + (v[14] * x2) + (v[15] * x3);
+		}
+		y[(br * SPMV_BLOCK) + 0] = y0;
+		y[(br * SPMV_BLOCK) + 1] = y1;
+		y[(br * SPMV_BLOCK) + 2] = y2;
+		y[(br * SPMV_BLOCK) + 3] = y3;
+	}
+}
+
+static size_t stress_spmv_bcsr_bytes(const stress_spmv_context_t *ctxt)
+{
+	if (!ctxt->bcsr_blocks)
+		return 0;
+	return ((ctxt->bcsr_rows + 1) * sizeof(*ctxt->bcsr_ptr)) +
+		(ctxt->bcsr_blocks * (sizeof(*ctxt->bcsr_col) +
+		 (SPMV_BLOCK * SPMV_BLOCK * sizeof(*ctxt->bcsr_val))));
+}
+
+static const stress_spmv_method_t spmv_methods[] = {
+	{ "coo",	stress_spmv_coo,	stress_spmv_coo_bytes },
+	{ "csr",	stress_spmv_csr,	stress_spmv_csr_bytes },
+	{ "ell",	stress_spmv_ell,	stress_spmv_ell_bytes },
+	{ "bcsr",	stress_spmv_bcsr,	stress_spmv_bcsr_bytes },
+};
+
+#define SPMV_METHODS	(SIZEOF_ARRAY(spmv_methods))
+
+static int stress_set_spmv_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = SPMV_METHODS;
+		return stress_set_setting("spmv-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < SPMV_METHODS; i++) {
+		if (!strcmp(opt, spmv_methods[i].name))
+			return stress_set_setting("spmv-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "spmv-method must be one of: all");
+	for (i = 0; i < SPMV_METHODS; i++)
+		(void)fprintf(stderr, " %s", spmv_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+typedef struct {
+	const stress_spmv_context_t *ctxt;	/* shared context */
+	const stress_spmv_method_t *method;	/* multiply to run */
+	pthread_t pthread;			/* thread handle */
+	int ret;				/* pthread_create return */
+	uint32_t id;				/* share of the rows */
+} stress_spmv_thread_t;
+
+static void *stress_spmv_func(void *arg)
+{
+	static void *nowt = NULL;
+	const stress_spmv_thread_t *thread = (const stress_spmv_thread_t *)arg;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+	thread->method->spmv(thread->ctxt, thread->id, thread->ctxt->threads);
+
+	return &nowt;
+}
+#endif
+
+/*
+ *  stress_spmv_run()
+ *	one multiply, split over the threads, a thread that cannot
+ *	be created has its share run inline
+ */
+static void stress_spmv_run(const stress_spmv_context_t *ctxt, const stress_spmv_method_t *method)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	stress_spmv_thread_t threads[MAX_SPMV_THREADS];
+	uint32_t i;
+
+	if (ctxt->threads < 2) {
+		method->spmv(ctxt, 0, 1);
+		return;
+	}
+	for (i = 0; i < ctxt->threads; i++) {
+		threads[i].ctxt = ctxt;
+		threads[i].method = method;
+		threads[i].id = i;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_spmv_func, (void *)&threads[i]);
+		if (threads[i].ret)
+			method->spmv(ctxt, i, ctxt->threads);
+	}
+	for (i = 0; i < ctxt->threads; i++) {
+		if (!threads[i].ret)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+#else
+	method->spmv(ctxt, 0, 1);
+#endif
+}
+
+/*
+ *  stress_spmv_value()
+ *	random value in the range -1.0 .. 1.0
+ */
+static inline double stress_spmv_value(void)
+{
+	return ((double)stress_mwc32() / 2147483648.0) - 1.0;
+}
+
+/*
+ *  stress_spmv_row_len()
+ *	number of columns to pick for row r, powerlaw rows are pareto
+ *	distributed with alpha 2 to give about the requested mean, block rows
+ *	have 4 columns for each of their blocks
+ */
+static size_t stress_spmv_row_len(const size_t pattern, const size_t n, const size_t nnz)
+{
+	size_t len;
+
+	switch (pattern) {
+	case SPMV_PATTERN_POWERLAW: {
+			const double u = ((double)stress_mwc32() + 1.0) / 4294967296.0;
+
+			len = (size_t)((double)nnz / (2.0 * sqrt(u))) + 1;
+			len = STRESS_MINIMUM(len, nnz * SPMV_POWERLAW_CAP);
+		}
+		break;
+	case SPMV_PATTERN_BLOCK:
+		len = ((nnz + SPMV_BLOCK - 1) / SPMV_BLOCK) * SPMV_BLOCK;
+		break;
+	default:
+		len = nnz;
+		break;
+	}
+	return STRESS_MINIMUM(len, n);
+}
+
+/*
+ *  stress_spmv_row()
+ *	pick the columns of row r into cols, blocks holds the block
+ *	columns of the block row for the block pattern and is updated
+ *	on the first row of each block row, returns the number of
+ *	unique columns picked, in ascending order
+ */
+static size_t stress_spmv_row(
+	const size_t pattern,
+	const size_t n,
+	const size_t nnz,
+	const size_t r,
+	const size_t len,
+	uint32_t *cols,
+	uint32_t *blocks,
+	size_t *n_blocks)
+{
+	size_t i, j, k;
+
+	switch (pattern) {
+	case SPMV_PATTERN_BANDED: {
+			const size_t lo = (r > nnz) ? r - nnz : 0;
+			const size_t hi = STRESS_MINIMUM(n, r + nnz + 1);
+
+			for (i = 0; i < len; i++)
+				cols[i] = (uint32_t)(lo + stress_mwc32modn((uint32_t)(hi - lo)));
+		}
+		break;
+	case SPMV_PATTERN_BLOCK:
+		if ((r % SPMV_BLOCK) == 0) {
+			const uint32_t n_bcols = (uint32_t)((n + SPMV_BLOCK - 1) / SPMV_BLOCK);
+
+			k = len / SPMV_BLOCK;
+			for (i = 0; i < k; i++)
+				blocks[i] = stress_mwc32modn(n_bcols);
+			qsort(blocks, k, sizeof(*blocks), stress_sort_cmp_fwd_int32);
+			for (*n_blocks = 0, i = 0; i < k; i++) {
+				if (!*n_blocks || (blocks[i] != blocks[*n_blocks - 1]))
+					blocks[(*n_blocks)++] = blocks[i];
+			}
+		}
+		for (k = 0, i = 0; i < *n_blocks; i++) {
+			for (j = 0; j < SPMV_BLOCK; j++) {
+				const size_t c = ((size_t)blocks[i] * SPMV_BLOCK) + j;
+
+				if (c < n)
+					cols[k++] = (uint32_t)c;
+			}
+		}
+		goto dedup;
+	default:
+		for (i = 0; i < len; i++)
+			cols[i] = stress_mwc32modn((uint32_t)n);
+		break;
+	}
+	qsort(cols, len, sizeof(*cols), stress_sort_cmp_fwd_int32);
+	k = len;
+dedup:
+	if (!k)
+		return 0;
+	for (j = 1, i = 1; i < k; i++) {
+		if (cols[i] != cols[j - 1])
+			cols[j++] = cols[i];
+	}
+	return j;
+}
+
+/*
+ *  stress_spmv_build_csr()
+ *	generate the matrix in CSR and COO formats
+ */
+static bool stress_spmv_build_csr(
+	stress_spmv_context_t *ctxt,
+	const size_t pattern,
+	const size_t nnz_per_row)
+{
+	const size_t n = ctxt->n;
+	uint32_t *cols, *blocks;
+	uint64_t cap = 0;
+	size_t r, max_len = 0, n_blocks = 0, pos = 0;
+
+	ctxt->csr_ptr = calloc(n + 1, sizeof(*ctxt->csr_ptr));
+	if (!ctxt->csr_ptr)
+		return false;
+
+	/* row lengths are held in csr_ptr until the rows are filled */
+	for (r = 0; r < n; r++) {
+		size_t len;
+
+		if ((pattern == SPMV_PATTERN_BLOCK) && (r % SPMV_BLOCK))
+			len = ctxt->csr_ptr[r];
+		else
+			len = stress_spmv_row_len(pattern, n, nnz_per_row);
+		ctxt->csr_ptr[r + 1] = (uint32_t)len;
+		max_len = STRESS_MAXIMUM(max_len, len);
+		cap += len;
+	}
+	if (cap > UINT32_MAX)
+		return false;
+
+	cols = calloc(max_len + 1, sizeof(*cols));
+	blocks = calloc(max_len + 1, sizeof(*blocks));
+	ctxt->col = calloc((size_t)cap + 1, sizeof(*ctxt->col));
+	ctxt->val = calloc((size_t)cap + 1, sizeof(*ctxt->val));
+	if (!cols || !blocks || !ctxt->col || !ctxt->val) {
+		free(blocks);
+		free(cols);
+		return false;
+	}
+
+	ctxt->csr_ptr[0] = 0;
+	for (r = 0; r < n; r++) {
+		const size_t len = ctxt->csr_ptr[r + 1];
+		const size_t k = stress_spmv_row(pattern, n, nnz_per_row, r, len, cols, blocks, &n_blocks);
+		size_t i;
+
+		for (i = 0; i < k; i++, pos++) {
+			ctxt->col[pos] = cols[i];
+			ctxt->val[pos] = stress_spmv_value();
+		}
+		ctxt->csr_ptr[r + 1] = (uint32_t)pos;
+	}
+	free(blocks);
+	free(cols);
+	ctxt->nnz = pos;
+
+	ctxt->coo_row = calloc(pos + 1, sizeof(*ctxt->coo_row));
+	if (!ctxt->coo_row)
+		return false;
+	for (r = 0; r < n; r++) {
+		size_t k;
+
+		for (k = ctxt->csr_ptr[r]; k < ctxt->csr_ptr[r + 1]; k++)
+			ctxt->coo_row[k] = (uint32_t)r;
+	}
+	return true;
+}
+
+/*
+ *  stress_spmv_build_ell()
+ *	convert the CSR matrix to ELL, short rows are padded with zeros
+ *	that reuse the last column of the row, the ELL matrix is not
+ *	built if it would store more than SPMV_MAX_FILL values per non-zero
+ */
+static void stress_spmv_build_ell(stress_spmv_context_t *ctxt)
+{
+	const size_t n = ctxt->n;
+	size_t r, w = 0;
+
+	for (r = 0; r < n; r++)
+		w = STRESS_MAXIMUM(w, (size_t)(ctxt->csr_ptr[r + 1] - ctxt->csr_ptr[r]));
+	if (!w || ((uint64_t)w * n > (uint64_t)SPMV_MAX_FILL * ctxt->nnz))
+		return;
+
+	ctxt->ell_col = calloc(n * w, sizeof(*ctxt->ell_col));
+	ctxt->ell_val = calloc(n * w, sizeof(*ctxt->ell_val));
+	if (!ctxt->ell_col || !ctxt->ell_val)
+		return;
+	for (r = 0; r < n; r++) {
+		const size_t lo = ctxt->csr_ptr[r], hi = ctxt->csr_ptr[r + 1];
+		uint32_t *col = ctxt->ell_col + (r * w);
+		double *val = ctxt->ell_val + (r * w);
+		size_t j;
+
+		for (j = 0; j < w; j++) {
+			if (lo + j < hi) {
+				col[j] = ctxt->col[lo + j];
+				val[j] = ctxt->val[lo + j];
+			} else {
+				col[j] = (hi > lo) ? ctxt->col[hi - 1] : (uint32_t)r;
+				val[j] = 0.0;
+			}
+		}
+	}
+	ctxt->ell_width = w;
+}
+
+/*
+ *  stress_spmv_build_bcsr()
+ *	convert the CSR matrix to 4 x 4 BCSR, the BCSR matrix is not
+ *	built if it would store more than SPMV_MAX_FILL values per non-zero
+ */
+static void stress_spmv_build_bcsr(stress_spmv_context_t *ctxt)
+{
+	const size_t n = ctxt->n;
+	const size_t n_brows = ctxt->n_pad / SPMV_BLOCK;
+	uint32_t *mark, *slot;
+	size_t br, blocks = 0;
+
+	mark = calloc(n_brows, sizeof(*mark));
+	slot = calloc(n_brows, sizeof(*slot));
+	ctxt->bcsr_ptr = calloc(n_brows + 1, sizeof(*ctxt->bcsr_ptr));
+	if (!mark || !slot || !ctxt->bcsr_ptr)
+		goto tidy;
+
+	/* count the distinct block columns of each block row */
+	for (br = 0; br < n_brows; br++) {
+		const size_t lo = ctxt->csr_ptr[br * SPMV_BLOCK];
+		const size_t hi = ctxt->csr_ptr[STRESS_MINIMUM(n, (br + 1) * SPMV_BLOCK)];
+		size_t k;
+
+		for (k = lo; k < hi; k++) {
+			const size_t bc = ctxt->col[k] / SPMV_BLOCK;
+
+			if (mark[bc] != br + 1) {
+				mark[bc] = (uint32_t)(br + 1);
+				blocks++;
+			}
+		}
+		ctxt->bcsr_ptr[br + 1] = (uint32_t)blocks;
+	}
+	if (!blocks || (blocks * SPMV_BLOCK * SPMV_BLOCK > SPMV_MAX_FILL * ctxt->nnz))
+		goto tidy;
+
+	ctxt->bcsr_col = calloc(blocks, sizeof(*ctxt->bcsr_col));
+	ctxt->bcsr_val = calloc(blocks * SPMV_BLOCK * SPMV_BLOCK, sizeof(*ctxt->bcsr_val));
+	if (!ctxt->bcsr_col || !ctxt->bcsr_val)
+		goto tidy;
+
+	(void)memset(mark, 0, n_brows * sizeof(*mark));
+	for (br = 0; br < n_brows; br++) {
+		const size_t r_lo = br * SPMV_BLOCK, r_hi = STRESS_MINIMUM(n, (br + 1) * SPMV_BLOCK);
+		const size_t b_lo = ctxt->bcsr_ptr[br], b_hi = ctxt->bcsr_ptr[br + 1];
+		uint32_t *bcols = ctxt->bcsr_col + b_lo;
+		size_t r, k, b = 0;
+
+		for (k = ctxt->csr_ptr[r_lo]; k < ctxt->csr_ptr[r_hi]; k++) {
+			const uint32_t bc = ctxt->col[k] / SPMV_BLOCK;
+
+			if (mark[bc] != br + 1) {
+				mark[bc] = (uint32_t)(br + 1);
+				bcols[b++] = bc;
+			}
+		}
+		/* ascending block columns keep the x accesses in order */
+		qsort(bcols, b_hi - b_lo, sizeof(*bcols), stress_sort_cmp_fwd_int32);
+		for (b = 0; b < b_hi - b_lo; b++)
+			slot[bcols[b]] = (uint32_t)(b_lo + b);
+
+		for (r = r_lo; r < r_hi; r++) {
+			for (k = ctxt->csr_ptr[r]; k < ctxt->csr_ptr[r + 1]; k++) {
+				const uint32_t c = ctxt->col[k];
+				const size_t idx = ((size_t)slot[c / SPMV_BLOCK] * SPMV_BLOCK * SPMV_BLOCK) +
+					((r - r_lo) * SPMV_BLOCK) + (c % SPMV_BLOCK);
+
+				ctxt->bcsr_val[idx] = ctxt->val[k];
+			}
+		}
+	}
+	ctxt->bcsr_rows = n_brows;
+	ctxt->bcsr_blocks = blocks;
+tidy:
+	free(slot);
+	free(mark);
+}
+
+/*
+ *  stress_spmv_verify()
+ *	check y against the reference multiply, the methods sum in
+ *	different orders so allow for rounding
+ */
+static bool stress_spmv_verify(
+	const stress_args_t *args,
+	const stress_spmv_method_t *method,
+	const stress_spmv_context_t *ctxt)
+{
+	size_t r;
+
+	for (r = 0; r < ctxt->n; r++) {
+		const double diff = fabs(ctxt->y[r] - ctxt->yref[r]);
+
+		if (!(diff <= 1.0E-9 * (1.0 + fabs(ctxt->yref[r])))) {
+			pr_fail("%s: %s multiply error detected, row %zu is %f, expected %f\n",
+				args->name, method->name, r, ctxt->y[r], ctxt->yref[r]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void stress_spmv_free(stress_spmv_context_t *ctxt)
+{
+	free(ctxt->yref);
+	free(ctxt->y);
+	free(ctxt->x);
+	free(ctxt->bcsr_val);
+	free(ctxt->bcsr_col);
+	free(ctxt->bcsr_ptr);
+	free(ctxt->ell_val);
+	free(ctxt->ell_col);
+	free(ctxt->coo_row);
+	free(ctxt->val);
+	free(ctxt->col);
+	free(ctxt->csr_ptr);
+}
+
+/*
+ *  stress_spmv()
+ *	multiply a synthetic sparse matrix held in each format by a
+ *	dense vector and report the GFLOP and effective bandwidth rates
+ */
+static int stress_spmv(const stress_args_t *args)
+{
+	uint64_t spmv_size = DEFAULT_SPMV_SIZE;
+	uint32_t spmv_nnz = DEFAULT_SPMV_NNZ;
+	uint32_t spmv_threads = 1;
+	size_t spmv_method = SPMV_METHODS;
+	size_t spmv_pattern = SPMV_PATTERN_BANDED;
+	stress_spmv_context_t ctxt;
+	double durations[SPMV_METHODS], flops[SPMV_METHODS], bytes[SPMV_METHODS];
+	size_t i, m;
+	int rc = EXIT_SUCCESS;
+
+	if (!stress_get_setting("spmv-size", &spmv_size)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			spmv_size = MAX_SPMV_SIZE;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			spmv_size = MIN_SPMV_SIZE;
+	}
+	(void)stress_get_setting("spmv-nnz", &spmv_nnz);
+	(void)stress_get_setting("spmv-method", &spmv_method);
+	(void)stress_get_setting("spmv-pattern", &spmv_pattern);
+	(void)stress_get_setting("spmv-threads", &spmv_threads);
+	if (spmv_threads < MIN_SPMV_THREADS)
+		spmv_threads = MIN_SPMV_THREADS;
+	if (spmv_threads > MAX_SPMV_THREADS)
+		spmv_threads = MAX_SPMV_THREADS;
+
+	(void)memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.n = (size_t)spmv_size;
+	ctxt.n_pad = (ctxt.n + SPMV_BLOCK - 1) & ~(size_t)(SPMV_BLOCK - 1);
+#if defined(HAVE_LIB_PTHREAD)
+	ctxt.threads = spmv_threads;
+#else
+	ctxt.threads = 1;
+#endif
+
+	if (!stress_spmv_build_csr(&ctxt, spmv_pattern, (size_t)spmv_nnz)) {
+		pr_inf_skip("%s: cannot allocate a %zu x %zu matrix with %" PRIu32
+			" non-zeros per row, skipping stressor\n",
+			args->name, ctxt.n, ctxt.n, spmv_nnz);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	stress_spmv_build_ell(&ctxt);
+	stress_spmv_build_bcsr(&ctxt);
+
+	ctxt.x = calloc(ctxt.n_pad, sizeof(*ctxt.x));
+	ctxt.y = calloc(ctxt.n_pad, sizeof(*ctxt.y));
+	ctxt.yref = calloc(ctxt.n, sizeof(*ctxt.yref));
+	if (!ctxt.x || !ctxt.y || !ctxt.yref) {
+		pr_inf_skip("%s: cannot allocate %zu element vectors, skipping stressor\n",
+			args->name, ctxt.n);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	for (i = 0; i < ctxt.n; i++)
+		ctxt.x[i] = stress_spmv_value();
+	/* the reference is a single threaded CSR multiply */
+	stress_spmv_csr(&ctxt, 0, 1);
+	(void)memcpy(ctxt.yref, ctxt.y, ctxt.n * sizeof(*ctxt.yref));
+
+	if (args->instance == 0) {
+		pr_inf("%s: %zu x %zu %s matrix, %zu non-zeros, %.2f per row\n",
+			args->name, ctxt.n, ctxt.n, spmv_patterns[spmv_pattern],
+			ctxt.nnz, (double)ctxt.nnz / (double)ctxt.n);
+		if (ctxt.ell_width)
+			pr_inf("%s: ell width %zu, %.2f values stored per non-zero\n",
+				args->name, ctxt.ell_width,
+				(double)(ctxt.ell_width * ctxt.n) / (double)ctxt.nnz);
+		else
+			pr_inf("%s: ell would store over %d values per non-zero, not using ell\n",
+				args->name, SPMV_MAX_FILL);
+		if (ctxt.bcsr_blocks)
+			pr_inf("%s: bcsr %zu blocks, %.2f values stored per non-zero\n",
+				args->name, ctxt.bcsr_blocks,
+				(double)(ctxt.bcsr_blocks * SPMV_BLOCK * SPMV_BLOCK) / (double)ctxt.nnz);
+		else
+			pr_inf("%s: bcsr would store over %d values per non-zero, not using bcsr\n",
+				args->name, SPMV_MAX_FILL);
+	}
+	if ((spmv_method < SPMV_METHODS) && !spmv_methods[spmv_method].bytes(&ctxt)) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s cannot be used with the %s pattern, skipping stressor\n",
+				args->name, spmv_methods[spmv_method].name,
+				spmv_patterns[spmv_pattern]);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+
+	for (m = 0; m < SPMV_METHODS; m++) {
+		durations[m] = 0.0;
+		flops[m] = 0.0;
+		bytes[m] = 0.0;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; m < SPMV_METHODS; m++) {
+			const stress_spmv_method_t *method = &spmv_methods[m];
+			const size_t matrix_bytes = method->bytes(&ctxt);
+			double t;
+
+			if ((spmv_method < SPMV_METHODS) && (spmv_method != m))
+				continue;
+			if (!matrix_bytes)
+				continue;
+
+			/* poison y so rows that are not written are caught */
+			if (g_opt_flags & OPT_FLAGS_VERIFY)
+				(void)memset(ctxt.y, 0xff, ctxt.n_pad * sizeof(*ctxt.y));
+			t = stress_time_now();
+			for (i = 0; i < SPMV_LOOPS; i++)
+				stress_spmv_run(&ctxt, method);
+			durations[m] += stress_time_now() - t;
+			flops[m] += 2.0 * (double)ctxt.nnz * (double)SPMV_LOOPS;
+			/* compulsory traffic, the matrix, x read and y written once */
+			bytes[m] += (double)(matrix_bytes + (2 * ctxt.n * sizeof(double))) *
+				(double)SPMV_LOOPS;
+
+			if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+			    !stress_spmv_verify(args, method, &ctxt)) {
+				rc = EXIT_FAILURE;
+				break;
+			}
+			if (!keep_stressing(args))
+				break;
+		}
+		inc_counter(args);
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (m = 0, i = 0; m < SPMV_METHODS; m++) {
+		char str[64];
+
+		if (durations[m] <= 0.0)
+			continue;
+		(void)snprintf(str, sizeof(str), "%s GFLOP per sec", spmv_methods[m].name);
+		stress_metrics_set(args, i++, str, flops[m] / (durations[m] * 1.0E9));
+		(void)snprintf(str, sizeof(str), "%s GB per sec effective bandwidth", spmv_methods[m].name);
+		stress_metrics_set(args, i++, str, bytes[m] / (durations[m] * 1.0E9));
+	}
+
+tidy:
+	stress_spmv_free(&ctxt);
+
+	return rc;
+}
+
+stressor_info_t stress_spmv_info = {
+	.stressor = stress_spmv,
+	.class = CLASS_CPU_CACHE | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_OPTIONAL,
+	.help = help
+};
@@ -18,6 +18,11 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arch.h"
+
+#if defined(HAVE_IMMINTRIN_H)
+#include <immintrin.h>
+#endif
 
 #define STR1LEN 256
 #define STR2LEN 128
@@ -48,6 +53,8 @@ typedef struct {
 
 static const stress_help_t help[] = {
 	{ NULL,	"str N",	   "start N workers exercising lib C string functions" },
+	{ NULL,	"str-bench",	   "time libc and SIMD strlen, strchr, strcmp and memchr per length bucket" },
+	{ NULL,	"str-lengths file", "string length distribution for str-bench, one length [count] per line" },
 	{ NULL,	"str-method func", "specify the string function to stress" },
 	{ NULL,	"str-ops N",	   "stop after N bogo string operations" },
 	{ NULL,	NULL,		   NULL }
@@ -641,6 +648,616 @@ static int stress_set_str_method(const char *name)
 	return -1;
 }
 
+#define STR_BENCH_STRINGS	(1024)		/* strings in the benchmark pool */
+#define STR_BENCH_MAX_LEN	(64 * KB)	/* longest string */
+#define STR_BENCH_DEFAULT_MAX	(4 * KB)	/* longest default length */
+#define STR_BENCH_MIN_CALLS	(1024)		/* calls per point per round */
+#define STR_BENCH_ALIGN		(64)		/* strings start at random offsets within */
+
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    defined(HAVE_BUILTIN_CTZ) &&	\
+    !defined(__ICC) &&			\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_STR_HAVE_X86_VEC
+#endif
+
+typedef size_t (*str_bench_strlen_t)(const char *s);
+typedef char * (*str_bench_strchr_t)(const char *s, int c);
+typedef int (*str_bench_strcmp_t)(const char *s1, const char *s2);
+typedef void * (*str_bench_memchr_t)(const void *s, int c, size_t n);
+
+typedef struct {
+	const char *name;
+	bool (*supported)(void);
+	const str_bench_strlen_t strlen_func;
+	const str_bench_strchr_t strchr_func;
+	const str_bench_strcmp_t strcmp_func;
+	const str_bench_memchr_t memchr_func;
+} stress_str_bench_variant_t;
+
+#if defined(STRESS_STR_HAVE_X86_VEC)
+/*
+ *  Hand written SIMD string kernels. strlen and strchr use aligned
+ *  loads so they never read across a page boundary past the string,
+ *  strcmp drops to a byte compare when either unaligned load would
+ *  cross a page and memchr never reads past n bytes.
+ */
+#define STRESS_STR_BENCH_VEC(sfx, isa, vtype, load, loadu, set1, setzero, cmpeq, or, movemask, full)	\
+static size_t OPTIMIZE3 __attribute__((target(isa))) stress_str_bench_strlen_ ## sfx(const char *s)	\
+{									\
+	const size_t vlen = sizeof(vtype);				\
+	const uintptr_t addr = (uintptr_t)s;				\
+	register const char *p = (const char *)(addr & ~(uintptr_t)(vlen - 1));	\
+	const vtype zero = setzero();					\
+	register uint32_t mask;						\
+									\
+	mask = (uint32_t)movemask(cmpeq(load((const vtype *)p), zero));	\
+	mask >>= (addr & (vlen - 1));					\
+	if (mask)							\
+		return (size_t)__builtin_ctz(mask);			\
+	for (;;) {							\
+		p += vlen;						\
+		mask = (uint32_t)movemask(cmpeq(load((const vtype *)p), zero));	\
+		if (mask)						\
+			return (size_t)(p - s) + (size_t)__builtin_ctz(mask);	\
+	}								\
+}									\
+									\
+static char * OPTIMIZE3 __attribute__((target(isa))) stress_str_bench_strchr_ ## sfx(const char *s, int c)	\
+{									\
+	const size_t vlen = sizeof(vtype);				\
+	const uintptr_t addr = (uintptr_t)s;				\
+	register const char *p = (const char *)(addr & ~(uintptr_t)(vlen - 1));	\
+	const vtype zero = setzero();					\
+	const vtype vc = set1((char)c);					\
+	register uint32_t mask;						\
+	vtype v;							\
+									\
+	v = load((const vtype *)p);					\
+	mask = (uint32_t)movemask(or(cmpeq(v, zero), cmpeq(v, vc)));	\
+	mask >>= (addr & (vlen - 1));					\
+	if (mask) {							\
+		p = s + __builtin_ctz(mask);				\
+		return (*p == (char)c) ? (char *)p : NULL;		\
+	}								\
+	for (;;) {							\
+		p += vlen;						\
+		v = load((const vtype *)p);				\
+		mask = (uint32_t)movemask(or(cmpeq(v, zero), cmpeq(v, vc)));	\
+		if (mask) {						\
+			p += __builtin_ctz(mask);			\
+			return (*p == (char)c) ? (char *)p : NULL;	\
+		}							\
+	}								\
+}									\
+									\
+static int OPTIMIZE3 __attribute__((target(isa))) stress_str_bench_strcmp_ ## sfx(const char *s1, const char *s2)	\
+{									\
+	const size_t vlen = sizeof(vtype);				\
+	const vtype zero = setzero();					\
+	register const unsigned char *p1 = (const unsigned char *)s1;	\
+	register const unsigned char *p2 = (const unsigned char *)s2;	\
+									\
+	for (;;) {							\
+		if ((((uintptr_t)p1 & 4095) <= (4096 - vlen)) &&	\
+		    (((uintptr_t)p2 & 4095) <= (4096 - vlen))) {	\
+			const vtype v1 = loadu((const vtype *)p1);	\
+			const vtype v2 = loadu((const vtype *)p2);	\
+			const uint32_t eq = (uint32_t)movemask(cmpeq(v1, v2));	\
+			const uint32_t nul = (uint32_t)movemask(cmpeq(v1, zero));	\
+			const uint32_t mask = (~eq & (full)) | nul;	\
+									\
+			if (mask) {					\
+				const int i = __builtin_ctz(mask);	\
+									\
+				return (int)p1[i] - (int)p2[i];		\
+			}						\
+			p1 += vlen;					\
+			p2 += vlen;					\
+		} else {						\
+			if ((*p1 != *p2) || (*p1 == '\0'))		\
+				return (int)*p1 - (int)*p2;		\
+			p1++;						\
+			p2++;						\
+		}							\
+	}								\
+}									\
+									\
+static void * OPTIMIZE3 __attribute__((target(isa))) stress_str_bench_memchr_ ## sfx(const void *s, int c, size_t n)	\
+{									\
+	const size_t vlen = sizeof(vtype);				\
+	const vtype vc = set1((char)c);					\
+	register const unsigned char *p = (const unsigned char *)s;	\
+									\
+	while (n >= vlen) {						\
+		const uint32_t mask = (uint32_t)movemask(cmpeq(loadu((const vtype *)p), vc));	\
+									\
+		if (mask)						\
+			return (void *)(p + __builtin_ctz(mask));	\
+		p += vlen;						\
+		n -= vlen;						\
+	}								\
+	while (n--) {							\
+		if (*p == (unsigned char)c)				\
+			return (void *)p;				\
+		p++;							\
+	}								\
+	return NULL;							\
+}
+
+STRESS_STR_BENCH_VEC(sse2, "sse2", __m128i, _mm_load_si128, _mm_loadu_si128, _mm_set1_epi8,
+	_mm_setzero_si128, _mm_cmpeq_epi8, _mm_or_si128, _mm_movemask_epi8, 0xffffU)
+STRESS_STR_BENCH_VEC(avx2, "avx2", __m256i, _mm256_load_si256, _mm256_loadu_si256, _mm256_set1_epi8,
+	_mm256_setzero_si256, _mm256_cmpeq_epi8, _mm256_or_si256, _mm256_movemask_epi8, 0xffffffffU)
+
+static bool stress_str_bench_has_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool stress_str_bench_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+static bool stress_str_bench_has_libc(void)
+{
+	return true;
+}
+
+static const stress_str_bench_variant_t str_bench_variants[] = {
+	{ "libc",	stress_str_bench_has_libc,
+	  strlen, strchr, strcmp, memchr },
+#if defined(STRESS_STR_HAVE_X86_VEC)
+	{ "sse2",	stress_str_bench_has_sse2,
+	  stress_str_bench_strlen_sse2, stress_str_bench_strchr_sse2,
+	  stress_str_bench_strcmp_sse2, stress_str_bench_memchr_sse2 },
+	{ "avx2",	stress_str_bench_has_avx2,
+	  stress_str_bench_strlen_avx2, stress_str_bench_strchr_avx2,
+	  stress_str_bench_strcmp_avx2, stress_str_bench_memchr_avx2 },
+#endif
+};
+
+static const char * const str_bench_funcs[] = {
+	"strlen", "strchr", "strcmp", "memchr"
+};
+
+/* length buckets, each bucket holds lengths up to its limit - 1 */
+static const size_t str_bench_buckets[] = {
+	16, 64, 256, 1 * KB, 4 * KB, 16 * KB, STR_BENCH_MAX_LEN + 1
+};
+
+static const char * const str_bench_bucket_names[] = {
+	"0-15", "16-63", "64-255", "256-1K", "1K-4K", "4K-16K", "16K-64K"
+};
+
+#define STR_BENCH_VARIANTS	(SIZEOF_ARRAY(str_bench_variants))
+#define STR_BENCH_FUNCS		(SIZEOF_ARRAY(str_bench_funcs))
+#define STR_BENCH_BUCKETS	(SIZEOF_ARRAY(str_bench_buckets))
+
+typedef struct {
+	double duration;	/* time spent in calls */
+	double calls;		/* number of calls */
+} stress_str_bench_point_t;
+
+typedef struct {
+	size_t *lengths;	/* sample lengths */
+	uint64_t *weights;	/* cumulative sample weights */
+	size_t n;		/* number of samples */
+} stress_str_bench_dist_t;
+
+typedef struct {
+	char *str1[STR_BENCH_STRINGS];	/* strings */
+	char *str2[STR_BENCH_STRINGS];	/* copies of the strings for strcmp */
+	size_t len[STR_BENCH_STRINGS];	/* string lengths */
+	size_t bucket_start[STR_BENCH_BUCKETS + 1]; /* strings sorted into buckets */
+} stress_str_bench_pool_t;
+
+static stress_str_bench_point_t str_bench_points[STR_BENCH_VARIANTS][STR_BENCH_FUNCS][STR_BENCH_BUCKETS];
+static volatile uintptr_t str_bench_sink;
+
+/*
+ *  stress_str_bench_load()
+ *	load an empirical length distribution, each line holds a string
+ *	length and an optional count, blank lines and # comments are
+ *	ignored, lengths are clamped to STR_BENCH_MAX_LEN
+ */
+static int stress_str_bench_load(
+	const stress_args_t *args,
+	const char *filename,
+	stress_str_bench_dist_t *dist)
+{
+	FILE *fp;
+	char buf[256];
+	size_t n = 0, max = 0, line = 0;
+	uint64_t total = 0;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		pr_inf_skip("%s: cannot open str-lengths file %s, errno=%d (%s), "
+			"skipping stressor\n", args->name, filename, errno, strerror(errno));
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), fp)) {
+		unsigned long int len, count = 1;
+		char *ptr = buf;
+		int ret;
+
+		line++;
+		while (isspace((int)*ptr))
+			ptr++;
+		if ((*ptr == '\0') || (*ptr == '#'))
+			continue;
+		ret = sscanf(ptr, "%lu %lu", &len, &count);
+		if (ret < 1) {
+			pr_inf_skip("%s: str-lengths file %s line %zu is not a length, "
+				"skipping stressor\n", args->name, filename, line);
+			goto err;
+		}
+		if (count == 0)
+			continue;
+		if (n >= max) {
+			size_t *lengths;
+			uint64_t *weights;
+
+			max = max ? max * 2 : 1024;
+			lengths = realloc(dist->lengths, max * sizeof(*lengths));
+			if (!lengths)
+				goto err_nomem;
+			dist->lengths = lengths;
+			weights = realloc(dist->weights, max * sizeof(*weights));
+			if (!weights)
+				goto err_nomem;
+			dist->weights = weights;
+		}
+		total += count;
+		dist->lengths[n] = (len > STR_BENCH_MAX_LEN) ? STR_BENCH_MAX_LEN : (size_t)len;
+		dist->weights[n] = total;
+		n++;
+	}
+	(void)fclose(fp);
+	if (n == 0) {
+		pr_inf_skip("%s: str-lengths file %s contains no lengths, "
+			"skipping stressor\n", args->name, filename);
+		return -1;
+	}
+	dist->n = n;
+	return 0;
+
+err_nomem:
+	pr_inf_skip("%s: cannot allocate str-lengths distribution, skipping stressor\n",
+		args->name);
+err:
+	(void)fclose(fp);
+	return -1;
+}
+
+/*
+ *  stress_str_bench_length()
+ *	draw a length from the distribution, the default without
+ *	a distribution is log uniform from 0 to STR_BENCH_DEFAULT_MAX
+ */
+static size_t stress_str_bench_length(const stress_str_bench_dist_t *dist)
+{
+	uint64_t w;
+	size_t lo, hi;
+
+	if (!dist->n) {
+		const uint32_t shift = stress_mwc32modn(13);	/* 2^12 = 4K */
+		const size_t base = (size_t)1 << shift;
+
+		return (base - 1) + (size_t)stress_mwc32modn((uint32_t)base);
+	}
+
+	w = stress_mwc64modn(dist->weights[dist->n - 1]);
+	lo = 0;
+	hi = dist->n - 1;
+	while (lo < hi) {
+		const size_t mid = (lo + hi) / 2;
+
+		if (dist->weights[mid] > w)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return dist->lengths[lo];
+}
+
+static int stress_str_bench_len_cmp(const void *p1, const void *p2)
+{
+	const size_t l1 = *(const size_t *)p1;
+	const size_t l2 = *(const size_t *)p2;
+
+	return (l1 > l2) - (l1 < l2);
+}
+
+/*
+ *  stress_str_bench_fill()
+ *	fill a string of 'a'..'y' so 'z' is never found
+ */
+static void stress_str_bench_fill(char *str, const size_t len)
+{
+	register size_t i;
+
+	for (i = 0; i < len; i++)
+		str[i] = (char)('a' + stress_mwc8modn(25));
+	str[len] = '\0';
+}
+
+/*
+ *  stress_str_bench_verify()
+ *	check the SIMD kernels against libc on every pool string
+ */
+static bool stress_str_bench_verify(
+	const stress_args_t *args,
+	const stress_str_bench_pool_t *pool,
+	const bool *supported)
+{
+	const stress_str_bench_variant_t *libc = &str_bench_variants[0];
+	bool ok = true;
+	size_t i, v;
+
+	for (v = 1; v < STR_BENCH_VARIANTS; v++) {
+		const stress_str_bench_variant_t *variant = &str_bench_variants[v];
+
+		if (!supported[v])
+			continue;
+		for (i = 0; i < STR_BENCH_STRINGS; i++) {
+			const char *s1 = pool->str1[i];
+			const char *s2 = pool->str2[i];
+			const size_t len = pool->len[i];
+			const int c = len ? s1[len / 2] : 'a';
+
+			if (variant->strlen_func(s1) != len) {
+				pr_fail("%s: %s strlen returned wrong length for a %zu byte string\n",
+					args->name, variant->name, len);
+				ok = false;
+			}
+			if ((variant->strchr_func(s1, c) != libc->strchr_func(s1, c)) ||
+			    (variant->strchr_func(s1, 'z') != NULL) ||
+			    (variant->strchr_func(s1, '\0') != s1 + len)) {
+				pr_fail("%s: %s strchr returned wrong result for a %zu byte string\n",
+					args->name, variant->name, len);
+				ok = false;
+			}
+			if ((variant->strcmp_func(s1, s2) != 0) ||
+			    ((variant->strcmp_func(s1, "z") < 0) != (libc->strcmp_func(s1, "z") < 0)) ||
+			    ((variant->strcmp_func(s1, "") > 0) != (libc->strcmp_func(s1, "") > 0))) {
+				pr_fail("%s: %s strcmp returned wrong result for a %zu byte string\n",
+					args->name, variant->name, len);
+				ok = false;
+			}
+			if ((variant->memchr_func(s1, c, len) != libc->memchr_func(s1, c, len)) ||
+			    (variant->memchr_func(s1, 'z', len) != NULL)) {
+				pr_fail("%s: %s memchr returned wrong result for a %zu byte string\n",
+					args->name, variant->name, len);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+/*
+ *  stress_str_bench_point()
+ *	call one function of one variant on the strings of a bucket,
+ *	the strings are scanned to the end so each call covers the
+ *	whole string length
+ */
+static void OPTIMIZE3 stress_str_bench_point(
+	const stress_args_t *args,
+	const stress_str_bench_pool_t *pool,
+	const stress_str_bench_variant_t *variant,
+	const size_t func,
+	const size_t bucket,
+	stress_str_bench_point_t *point)
+{
+	const size_t start = pool->bucket_start[bucket];
+	const size_t n = pool->bucket_start[bucket + 1] - start;
+	const size_t calls = (n < STR_BENCH_MIN_CALLS) ?
+		((STR_BENCH_MIN_CALLS + n - 1) / n) * n : n;
+	register uintptr_t sink = 0;
+	register size_t c, i = start;
+	double t;
+
+	t = stress_time_now();
+	switch (func) {
+	case 0:
+		for (c = 0; c < calls; c++) {
+			sink += variant->strlen_func(pool->str1[i]);
+			i = (i + 1 >= start + n) ? start : i + 1;
+		}
+		break;
+	case 1:
+		for (c = 0; c < calls; c++) {
+			sink += (uintptr_t)variant->strchr_func(pool->str1[i], 'z');
+			i = (i + 1 >= start + n) ? start : i + 1;
+		}
+		break;
+	case 2:
+		for (c = 0; c < calls; c++) {
+			sink += (uintptr_t)variant->strcmp_func(pool->str1[i], pool->str2[i]);
+			i = (i + 1 >= start + n) ? start : i + 1;
+		}
+		break;
+	default:
+		for (c = 0; c < calls; c++) {
+			sink += (uintptr_t)variant->memchr_func(pool->str1[i], 'z', pool->len[i]);
+			i = (i + 1 >= start + n) ? start : i + 1;
+		}
+		break;
+	}
+	point->duration += stress_time_now() - t;
+	point->calls += (double)calls;
+	str_bench_sink = sink;
+	add_counter(args, calls);
+}
+
+/*
+ *  stress_str_bench_report()
+ *	log the ns per call of each function, variant and length
+ *	bucket and report them and the distribution weighted ns
+ *	per call as metrics
+ */
+static void stress_str_bench_report(
+	const stress_args_t *args,
+	const stress_str_bench_pool_t *pool,
+	const bool *supported)
+{
+	size_t f, v, b, n = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: ns per call by string length bucket and distribution weighted mean\n",
+			args->name);
+		pr_inf("%s: func   variant    0-15   16-63  64-255  256-1K   1K-4K  4K-16K 16K-64K    mean\n",
+			args->name);
+	}
+
+	for (f = 0; f < STR_BENCH_FUNCS; f++) {
+		for (v = 0; v < STR_BENCH_VARIANTS; v++) {
+			double ns[STR_BENCH_BUCKETS], mean = 0.0;
+			char str[64];
+
+			if (!supported[v])
+				continue;
+			for (b = 0; b < STR_BENCH_BUCKETS; b++) {
+				const stress_str_bench_point_t *point = &str_bench_points[v][f][b];
+				const size_t count = pool->bucket_start[b + 1] - pool->bucket_start[b];
+
+				ns[b] = 0.0;
+				if ((point->calls <= 0.0) || (point->duration <= 0.0))
+					continue;
+				ns[b] = (point->duration * STRESS_DBL_NANOSECOND) / point->calls;
+				mean += ns[b] * ((double)count / (double)STR_BENCH_STRINGS);
+
+				(void)snprintf(str, sizeof(str), "%s %s %s ns per call",
+					str_bench_funcs[f], str_bench_variants[v].name,
+					str_bench_bucket_names[b]);
+				stress_metrics_set(args, n++, str, ns[b]);
+			}
+			if (args->instance == 0)
+				pr_inf("%s: %-6s %-6s %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f\n",
+					args->name, str_bench_funcs[f], str_bench_variants[v].name,
+					ns[0], ns[1], ns[2], ns[3], ns[4], ns[5], ns[6], mean);
+			(void)snprintf(str, sizeof(str), "%s %s mean ns per call",
+				str_bench_funcs[f], str_bench_variants[v].name);
+			stress_metrics_set(args, n++, str, mean);
+		}
+	}
+
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_str_bench()
+ *	build a pool of strings with lengths drawn from the length
+ *	distribution, sort them into length buckets and repeatedly
+ *	time each function and variant on each bucket
+ */
+static int stress_str_bench(const stress_args_t *args)
+{
+	stress_str_bench_dist_t dist;
+	stress_str_bench_pool_t *pool;
+	const char *str_lengths = NULL;
+	bool supported[STR_BENCH_VARIANTS];
+	size_t i, b, f, v, pool_size = 0;
+	char *pool_buf, *ptr;
+	int rc = EXIT_SUCCESS;
+
+	(void)memset(&dist, 0, sizeof(dist));
+	(void)memset(str_bench_points, 0, sizeof(str_bench_points));
+	(void)stress_get_setting("str-lengths", &str_lengths);
+	if (str_lengths && (stress_str_bench_load(args, str_lengths, &dist) < 0)) {
+		rc = EXIT_NO_RESOURCE;
+		goto free_dist;
+	}
+
+	pool = (stress_str_bench_pool_t *)calloc(1, sizeof(*pool));
+	if (!pool) {
+		pr_inf_skip("%s: cannot allocate string pool, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_dist;
+	}
+	for (i = 0; i < STR_BENCH_STRINGS; i++) {
+		pool->len[i] = stress_str_bench_length(&dist);
+		pool_size += 2 * (pool->len[i] + 1 + STR_BENCH_ALIGN);
+	}
+	qsort(pool->len, STR_BENCH_STRINGS, sizeof(pool->len[0]), stress_str_bench_len_cmp);
+
+	/* page of slack so the aligned vector loads stay in the mapping */
+	pool_size += args->page_size;
+	pool_buf = (char *)mmap(NULL, pool_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (pool_buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte string pool, skipping stressor\n",
+			args->name, pool_size);
+		rc = EXIT_NO_RESOURCE;
+		goto free_pool;
+	}
+	ptr = pool_buf;
+	for (i = 0; i < STR_BENCH_STRINGS; i++) {
+		ptr += stress_mwc8modn(STR_BENCH_ALIGN);
+		pool->str1[i] = ptr;
+		stress_str_bench_fill(ptr, pool->len[i]);
+		ptr += pool->len[i] + 1;
+	}
+	for (i = 0; i < STR_BENCH_STRINGS; i++) {
+		ptr += stress_mwc8modn(STR_BENCH_ALIGN);
+		pool->str2[i] = ptr;
+		(void)memcpy(ptr, pool->str1[i], pool->len[i] + 1);
+		ptr += pool->len[i] + 1;
+	}
+	for (i = 0, b = 0; b < STR_BENCH_BUCKETS; b++) {
+		pool->bucket_start[b] = i;
+		while ((i < STR_BENCH_STRINGS) && (pool->len[i] < str_bench_buckets[b]))
+			i++;
+	}
+	pool->bucket_start[STR_BENCH_BUCKETS] = STR_BENCH_STRINGS;
+
+	for (v = 0; v < STR_BENCH_VARIANTS; v++)
+		supported[v] = str_bench_variants[v].supported();
+
+	if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+	    !stress_str_bench_verify(args, pool, supported))
+		rc = EXIT_FAILURE;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (f = 0; f < STR_BENCH_FUNCS; f++) {
+			for (v = 0; v < STR_BENCH_VARIANTS; v++) {
+				if (!supported[v])
+					continue;
+				for (b = 0; b < STR_BENCH_BUCKETS; b++) {
+					if (pool->bucket_start[b] == pool->bucket_start[b + 1])
+						continue;
+					stress_str_bench_point(args, pool, &str_bench_variants[v],
+						f, b, &str_bench_points[v][f][b]);
+				}
+				if (!keep_stressing_flag())
+					goto report;
+			}
+		}
+	} while (keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_str_bench_report(args, pool, supported);
+
+	(void)munmap((void *)pool_buf, pool_size);
+free_pool:
+	free(pool);
+free_dist:
+	free(dist.lengths);
+	free(dist.weights);
+
+	return rc;
+}
+
 /*
  *  stress_str()
  *	stress CPU by doing various string operations
@@ -652,6 +1269,13 @@ static int stress_str(const stress_args_t *args)
 	stress_str_args_t info;
 	const stress_str_method_info_t *str_method_info;
 	size_t i, j, str_method = 0;
+	bool str_bench = false;
+	const char *str_lengths = NULL;
+
+	(void)stress_get_setting("str-bench", &str_bench);
+	(void)stress_get_setting("str-lengths", &str_lengths);
+	if (str_bench || str_lengths)
+		return stress_str_bench(args);
 
 	(void)stress_get_setting("str-method", &str_method);
 	str_method_info = &str_methods[str_method];
@@ -717,7 +1341,19 @@ static void stress_str_set_default(void)
 	stress_set_str_method("all");
 }
 
+static int stress_set_str_bench(const char *opt)
+{
+	return stress_set_setting_true("str-bench", opt);
+}
+
+static int stress_set_str_lengths(const char *opt)
+{
+	return stress_set_setting("str-lengths", TYPE_ID_STR, opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_str_bench,	stress_set_str_bench },
+	{ OPT_str_lengths,	stress_set_str_lengths },
 	{ OPT_str_method,	stress_set_str_method },
 	{ 0,			NULL }
 };
@@ -32,6 +32,14 @@
 #include "core-cpu.h"
 #include "core-cpu-cache.h"
 #include "core-nt-store.h"
+#include "core-perf.h"
+#include "core-pthread.h"
+#include "core-put.h"
+#include "core-target-clones.h"
+
+#if defined(HAVE_LINUX_MEMPOLICY_H)
+#include <linux/mempolicy.h>
+#endif
 
 #define MIN_STREAM_L3_SIZE	(4 * KB)
 #define MAX_STREAM_L3_SIZE	(MAX_MEM_LIMIT)
@@ -43,17 +51,73 @@
 
 #define STORE(dst, src)			dst = src
 
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    !defined(__ICC) &&			\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_STREAM_HAVE_NT_VEC
+#endif
+
+#if defined(MAP_POPULATE)
+#define STREAM_MAP_POPULATE	MAP_POPULATE
+#else
+#define STREAM_MAP_POPULATE	(0)
+#endif
+
+#define MIN_STREAM_THREADS	(1)
+#define MAX_STREAM_THREADS	(1024)
+
+#define STREAM_PREFETCH_DIST	(64)	/* doubles to prefetch ahead of use */
+
+#define STREAM_ROOFLINE_BLOCK	(64)	/* doubles kept in registers per block */
+#define STREAM_ROOFLINE_CHUNK	(64 * 1024)	/* doubles processed per kernel call */
+#define STREAM_ROOFLINE_SLICE	(0.01)	/* minimum seconds per roofline point */
+#define STREAM_ROOFLINE_LEVELS	(4)	/* L1, L2, L3 and DRAM */
+
+#define STREAM_NUMA_NODES_MAX	(64)	/* maximum nodes in NUMA matrix */
+#define STREAM_NUMA_NODE_ID_MAX	(1024)	/* NUMA node numbers 0..1023 */
+#define STREAM_NUMA_SLICE	(0.25)	/* seconds per NUMA measurement */
+#define STREAM_NUMA_LINE	(64)	/* pointer chase node size in bytes */
+#define STREAM_NUMA_LINE_PTRS	(STREAM_NUMA_LINE / sizeof(uintptr_t))
+
 typedef struct {
 	const char *name;
 	const int advice;
 } stress_stream_madvise_info_t;
 
+typedef void (*stress_stream_copy_func_t)(double *RESTRICT c, const double *RESTRICT a,
+	const uint64_t n, double *rd_bytes, double *wr_bytes, double *fp_ops);
+typedef void (*stress_stream_scale_func_t)(double *RESTRICT b, const double *RESTRICT c,
+	const double q, const uint64_t n, double *rd_bytes, double *wr_bytes, double *fp_ops);
+typedef void (*stress_stream_add_func_t)(const double *RESTRICT a, const double *RESTRICT b,
+	double *RESTRICT c, const uint64_t n, double *rd_bytes, double *wr_bytes, double *fp_ops);
+typedef void (*stress_stream_triad_func_t)(double *RESTRICT a, const double *RESTRICT b,
+	const double *RESTRICT c, const double q, const uint64_t n, double *rd_bytes,
+	double *wr_bytes, double *fp_ops);
+
+typedef struct {
+	const char *name;			/* --stream-store name */
+	const bool nt;				/* true = non-temporal stores */
+	bool (*supported)(void);		/* true = CPU supports variant */
+	const stress_stream_copy_func_t copy;	/* copy kernel */
+	const stress_stream_scale_func_t scale;	/* scale kernel */
+	const stress_stream_add_func_t add;	/* add kernel */
+	const stress_stream_triad_func_t triad;	/* triad kernel */
+} stress_stream_store_t;
+
 static const stress_help_t help[] = {
 	{ NULL,	"stream N",		"start N workers exercising memory bandwidth" },
+	{ NULL,	"stream-backing B",	"specify array backing, 4k, thp, 2m or 1g pages" },
 	{ NULL,	"stream-index",		"specify number of indices into the data (0..3)" },
 	{ NULL,	"stream-l3-size N",	"specify the L3 cache size of the CPU" },
 	{ NULL,	"stream-madvise M",	"specify mmap'd stream buffer madvise advice" },
 	{ NULL,	"stream-ops N",		"stop after N bogo stream operations" },
+	{ NULL,	"stream-numa",		"measure triad bandwidth and latency of each CPU and memory node pair" },
+	{ NULL,	"stream-roofline",	"sweep arithmetic intensity over L1 to DRAM working sets" },
+	{ NULL,	"stream-store S",	"specify index 0 kernel store variant, default auto" },
+	{ NULL,	"stream-threads N",	"run index 0 kernels with N pthreads over shared arrays" },
 	{ NULL,	NULL,                   NULL }
 };
 
@@ -103,6 +167,11 @@ static int stress_set_stream_madvise(const char *opt)
 	return -1;
 }
 
+static int stress_set_stream_backing(const char *opt)
+{
+	return stress_set_mmap_backing("stream-backing", opt);
+}
+
 static int stress_set_stream_index(const char *opt)
 {
 	uint32_t stream_index;
@@ -112,6 +181,26 @@ static int stress_set_stream_index(const char *opt)
 	return stress_set_setting("stream-index", TYPE_ID_UINT32, &stream_index);
 }
 
+static int stress_set_stream_numa(const char *opt)
+{
+	return stress_set_setting_true("stream-numa", opt);
+}
+
+static int stress_set_stream_roofline(const char *opt)
+{
+	return stress_set_setting_true("stream-roofline", opt);
+}
+
+static int stress_set_stream_threads(const char *opt)
+{
+	uint32_t stream_threads;
+
+	stream_threads = stress_get_uint32(opt);
+	stress_check_range("stream-threads", (uint64_t)stream_threads,
+		MIN_STREAM_THREADS, MAX_STREAM_THREADS);
+	return stress_set_setting("stream-threads", TYPE_ID_UINT32, &stream_threads);
+}
+
 static inline void OPTIMIZE3 stress_stream_copy_index0(
 	double *RESTRICT c,
 	const double *RESTRICT a,
@@ -589,6 +678,276 @@ static inline void OPTIMIZE3 stress_stream_triad_index3(
 	*fp_ops += (double)n * 2.0;
 }
 
+/*
+ *  Cached store variants with software prefetching of the source
+ *  arrays, the stores are not volatile so the compiler can
+ *  vectorize these for the best width the CPU supports
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_stream_copy_index0_prefetch(
+	double *RESTRICT c,
+	const double *RESTRICT a,
+	const uint64_t n,
+	double *rd_bytes,
+	double *wr_bytes,
+	double *fp_ops)
+{
+	register uint64_t i, j;
+
+	for (i = 0; i < n; i += 8) {
+		shim_builtin_prefetch(&a[i + STREAM_PREFETCH_DIST]);
+		for (j = i; j < i + 8; j++)
+			c[j] = a[j];
+	}
+
+	*rd_bytes += (double)n * (double)(sizeof(*a));
+	*wr_bytes += (double)n * (double)(sizeof(*c));
+	*fp_ops += 0.0;
+}
+
+static void OPTIMIZE3 TARGET_CLONES stress_stream_scale_index0_prefetch(
+	double *RESTRICT b,
+	const double *RESTRICT c,
+	const double q,
+	const uint64_t n,
+	double *rd_bytes,
+	double *wr_bytes,
+	double *fp_ops)
+{
+	register uint64_t i, j;
+
+	for (i = 0; i < n; i += 8) {
+		shim_builtin_prefetch(&c[i + STREAM_PREFETCH_DIST]);
+		for (j = i; j < i + 8; j++)
+			b[j] = q * c[j];
+	}
+
+	*rd_bytes += (double)n * (double)(sizeof(*c));
+	*wr_bytes += (double)n * (double)(sizeof(*b));
+	*fp_ops += (double)n;
+}
+
+static void OPTIMIZE3 TARGET_CLONES stress_stream_add_index0_prefetch(
+	const double *RESTRICT a,
+	const double *RESTRICT b,
+	double *RESTRICT c,
+	const uint64_t n,
+	double *rd_bytes,
+	double *wr_bytes,
+	double *fp_ops)
+{
+	register uint64_t i, j;
+
+	for (i = 0; i < n; i += 8) {
+		shim_builtin_prefetch(&a[i + STREAM_PREFETCH_DIST]);
+		shim_builtin_prefetch(&b[i + STREAM_PREFETCH_DIST]);
+		for (j = i; j < i + 8; j++)
+			c[j] = a[j] + b[j];
+	}
+
+	*rd_bytes += (double)n * (double)(sizeof(*a) + sizeof(*b));
+	*wr_bytes += (double)n * (double)(sizeof(*c));
+	*fp_ops += (double)n;
+}
+
+static void OPTIMIZE3 TARGET_CLONES stress_stream_triad_index0_prefetch(
+	double *RESTRICT a,
+	const double *RESTRICT b,
+	const double *RESTRICT c,
+	const double q,
+	const uint64_t n,
+	double *rd_bytes,
+	double *wr_bytes,
+	double *fp_ops)
+{
+	register uint64_t i, j;
+
+	for (i = 0; i < n; i += 8) {
+		shim_builtin_prefetch(&b[i + STREAM_PREFETCH_DIST]);
+		shim_builtin_prefetch(&c[i + STREAM_PREFETCH_DIST]);
+		for (j = i; j < i + 8; j++)
+			a[j] = b[j] + (c[j] * q);
+	}
+
+	*rd_bytes += (double)n * (double)(sizeof(*b) + sizeof(*c));
+	*wr_bytes += (double)n * (double)(sizeof(*a));
+	*fp_ops += (double)n * 2.0;
+}
+
+/*
+ *  Vector non-temporal store variants, 128, 256 and 512 bits wide,
+ *  the arrays are page aligned and n is a multiple of 8 so all
+ *  the vector loads and stores are aligned
+ */
+#if defined(STRESS_STREAM_HAVE_NT_VEC)
+#define STRESS_STREAM_NT_VEC(width, isa, vtype, vlen, load, stream, set1, add, mul)	\
+static void OPTIMIZE3 __attribute__((target(isa))) stress_stream_copy_index0_nt ## width(\
+	double *RESTRICT c,						\
+	const double *RESTRICT a,					\
+	const uint64_t n,						\
+	double *rd_bytes,						\
+	double *wr_bytes,						\
+	double *fp_ops)							\
+{									\
+	register uint64_t i;						\
+									\
+	for (i = 0; i < n; i += vlen)					\
+		stream(&c[i], load(&a[i]));				\
+	_mm_sfence();							\
+									\
+	*rd_bytes += (double)n * (double)(sizeof(*a));			\
+	*wr_bytes += (double)n * (double)(sizeof(*c));			\
+	*fp_ops += 0.0;							\
+}									\
+									\
+static void OPTIMIZE3 __attribute__((target(isa))) stress_stream_scale_index0_nt ## width(\
+	double *RESTRICT b,						\
+	const double *RESTRICT c,					\
+	const double q,							\
+	const uint64_t n,						\
+	double *rd_bytes,						\
+	double *wr_bytes,						\
+	double *fp_ops)							\
+{									\
+	register uint64_t i;						\
+	const vtype vq = set1(q);					\
+									\
+	for (i = 0; i < n; i += vlen)					\
+		stream(&b[i], mul(vq, load(&c[i])));			\
+	_mm_sfence();							\
+									\
+	*rd_bytes += (double)n * (double)(sizeof(*c));			\
+	*wr_bytes += (double)n * (double)(sizeof(*b));			\
+	*fp_ops += (double)n;						\
+}									\
+									\
+static void OPTIMIZE3 __attribute__((target(isa))) stress_stream_add_index0_nt ## width(\
+	const double *RESTRICT a,					\
+	const double *RESTRICT b,					\
+	double *RESTRICT c,						\
+	const uint64_t n,						\
+	double *rd_bytes,						\
+	double *wr_bytes,						\
+	double *fp_ops)							\
+{									\
+	register uint64_t i;						\
+									\
+	for (i = 0; i < n; i += vlen)					\
+		stream(&c[i], add(load(&a[i]), load(&b[i])));		\
+	_mm_sfence();							\
+									\
+	*rd_bytes += (double)n * (double)(sizeof(*a) + sizeof(*b));	\
+	*wr_bytes += (double)n * (double)(sizeof(*c));			\
+	*fp_ops += (double)n;						\
+}									\
+									\
+static void OPTIMIZE3 __attribute__((target(isa))) stress_stream_triad_index0_nt ## width(\
+	double *RESTRICT a,						\
+	const double *RESTRICT b,					\
+	const double *RESTRICT c,					\
+	const double q,							\
+	const uint64_t n,						\
+	double *rd_bytes,						\
+	double *wr_bytes,						\
+	double *fp_ops)							\
+{									\
+	register uint64_t i;						\
+	const vtype vq = set1(q);					\
+									\
+	for (i = 0; i < n; i += vlen)					\
+		stream(&a[i], add(load(&b[i]), mul(load(&c[i]), vq)));	\
+	_mm_sfence();							\
+									\
+	*rd_bytes += (double)n * (double)(sizeof(*b) + sizeof(*c));	\
+	*wr_bytes += (double)n * (double)(sizeof(*a));			\
+	*fp_ops += (double)n * 2.0;					\
+}
+
+STRESS_STREAM_NT_VEC(128, "sse2", __m128d, 2, _mm_load_pd, _mm_stream_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd)
+STRESS_STREAM_NT_VEC(256, "avx", __m256d, 4, _mm256_load_pd, _mm256_stream_pd, _mm256_set1_pd, _mm256_add_pd, _mm256_mul_pd)
+STRESS_STREAM_NT_VEC(512, "avx512f", __m512d, 8, _mm512_load_pd, _mm512_stream_pd, _mm512_set1_pd, _mm512_add_pd, _mm512_mul_pd)
+
+static bool stress_stream_has_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool stress_stream_has_avx(void)
+{
+	return __builtin_cpu_supports("avx");
+}
+
+static bool stress_stream_has_avx512f(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+static bool stress_stream_store_supported(void)
+{
+	return true;
+}
+
+#if defined(HAVE_NT_STORE_DOUBLE)
+static bool stress_stream_store_nt64_supported(void)
+{
+	return stress_cpu_x86_has_sse2();
+}
+#endif
+
+/*
+ *  Store variants of the index0 kernels, cached stores, cached
+ *  stores with source prefetching and non-temporal stores of
+ *  various widths, --stream-store auto trials all the supported
+ *  variants and picks the fastest
+ */
+static const stress_stream_store_t stream_stores[] = {
+	{ "cached",	false,	stress_stream_store_supported,
+	  stress_stream_copy_index0, stress_stream_scale_index0,
+	  stress_stream_add_index0, stress_stream_triad_index0 },
+	{ "prefetch",	false,	stress_stream_store_supported,
+	  stress_stream_copy_index0_prefetch, stress_stream_scale_index0_prefetch,
+	  stress_stream_add_index0_prefetch, stress_stream_triad_index0_prefetch },
+#if defined(HAVE_NT_STORE_DOUBLE)
+	{ "nt64",	true,	stress_stream_store_nt64_supported,
+	  stress_stream_copy_index0_nt, stress_stream_scale_index0_nt,
+	  stress_stream_add_index0_nt, stress_stream_triad_index0_nt },
+#endif
+#if defined(STRESS_STREAM_HAVE_NT_VEC)
+	{ "nt128",	true,	stress_stream_has_sse2,
+	  stress_stream_copy_index0_nt128, stress_stream_scale_index0_nt128,
+	  stress_stream_add_index0_nt128, stress_stream_triad_index0_nt128 },
+	{ "nt256",	true,	stress_stream_has_avx,
+	  stress_stream_copy_index0_nt256, stress_stream_scale_index0_nt256,
+	  stress_stream_add_index0_nt256, stress_stream_triad_index0_nt256 },
+	{ "nt512",	true,	stress_stream_has_avx512f,
+	  stress_stream_copy_index0_nt512, stress_stream_scale_index0_nt512,
+	  stress_stream_add_index0_nt512, stress_stream_triad_index0_nt512 },
+#endif
+};
+
+/*
+ *  stress_set_stream_store()
+ *	set the index0 kernel store variant, auto trials them all
+ */
+static int stress_set_stream_store(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "auto")) {
+		i = SIZEOF_ARRAY(stream_stores);
+		return stress_set_setting("stream-store", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < SIZEOF_ARRAY(stream_stores); i++) {
+		if (!strcmp(opt, stream_stores[i].name))
+			return stress_set_setting("stream-store", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "stream-store must be one of: auto");
+	for (i = 0; i < SIZEOF_ARRAY(stream_stores); i++)
+		(void)fprintf(stderr, " %s", stream_stores[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
 static void stress_stream_init_data(
 	double *RESTRICT data,
 	const uint64_t n)
@@ -604,14 +963,14 @@ static void stress_stream_init_data(
 	}
 }
 
-static inline void *stress_stream_mmap(const stress_args_t *args, uint64_t sz)
+static inline void *stress_stream_mmap_flags(
+	const stress_args_t *args,
+	const uint64_t sz,
+	const int flags)
 {
 	void *ptr;
 
-	ptr = mmap(NULL, (size_t)sz, PROT_READ | PROT_WRITE,
-#if defined(MAP_POPULATE)
-		MAP_POPULATE |
-#endif
+	ptr = mmap(NULL, (size_t)sz, PROT_READ | PROT_WRITE, flags |
 #if defined(HAVE_MADVISE)
 		MAP_PRIVATE |
 #else
@@ -637,6 +996,37 @@ static inline void *stress_stream_mmap(const stress_args_t *args, uint64_t sz)
 	return ptr;
 }
 
+static inline void *stress_stream_mmap(const stress_args_t *args, uint64_t sz)
+{
+	return stress_stream_mmap_flags(args, sz, STREAM_MAP_POPULATE);
+}
+
+/*
+ *  stress_stream_mmap_array()
+ *	mmap a stream array with the --stream-backing backing, sz
+ *	must be a multiple of the backing page size
+ */
+static void *stress_stream_mmap_array(
+	const stress_args_t *args,
+	const uint64_t sz,
+	const int flags)
+{
+	size_t backing, len = (size_t)sz;
+	void *ptr;
+
+	if (!stress_get_setting("stream-backing", &backing))
+		return stress_stream_mmap_flags(args, sz, flags);
+
+	ptr = stress_mmap_backing(backing, &len, PROT_READ | PROT_WRITE,
+		flags | MAP_PRIVATE | MAP_ANONYMOUS);
+	if ((ptr == MAP_FAILED) && !args->instance) {
+		pr_inf_skip("%s: cannot allocate %" PRIu64 " bytes with %s backing, "
+			"errno=%d (%s), skipping stressor\n", args->name, sz,
+			stress_mmap_backing_name(backing), errno, strerror(errno));
+	}
+	return ptr;
+}
+
 static inline uint64_t get_stream_L3_size(const stress_args_t *args)
 {
 	uint64_t cache_size = MEM_CACHE_SIZE;
@@ -701,6 +1091,855 @@ static void stress_stream_init_index(
 	}
 }
 
+/*
+ *  Roofline kernels, each element is loaded, has fmas dependent
+ *  multiply-adds applied and is stored back, so the arithmetic
+ *  intensity is 2 x fmas flops per 16 bytes of memory traffic.
+ *  Elements are processed in blocks so that the multiply-adds of
+ *  a block are independent and can fill the FP pipelines.
+ */
+#define STRESS_STREAM_ROOFLINE(fmas)					\
+static void OPTIMIZE3 TARGET_CLONES stress_stream_roofline_fma ## fmas(	\
+	double *RESTRICT data,						\
+	const uint64_t n)						\
+{									\
+	register uint64_t i;						\
+	const double q = 0.5, r = 0.25;					\
+									\
+	for (i = 0; i < n; i += STREAM_ROOFLINE_BLOCK) {		\
+		double v[STREAM_ROOFLINE_BLOCK];			\
+		register int j, k;					\
+									\
+		for (k = 0; k < STREAM_ROOFLINE_BLOCK; k++)		\
+			v[k] = data[i + (uint64_t)k];			\
+		for (j = 0; j < fmas; j++) {				\
+			for (k = 0; k < STREAM_ROOFLINE_BLOCK; k++)	\
+				v[k] = (v[k] * q) + r;			\
+		}							\
+		for (k = 0; k < STREAM_ROOFLINE_BLOCK; k++)		\
+			data[i + (uint64_t)k] = v[k];			\
+	}								\
+}
+
+STRESS_STREAM_ROOFLINE(1)
+STRESS_STREAM_ROOFLINE(2)
+STRESS_STREAM_ROOFLINE(4)
+STRESS_STREAM_ROOFLINE(8)
+STRESS_STREAM_ROOFLINE(16)
+STRESS_STREAM_ROOFLINE(32)
+STRESS_STREAM_ROOFLINE(64)
+STRESS_STREAM_ROOFLINE(128)
+STRESS_STREAM_ROOFLINE(256)
+
+typedef void (*stress_stream_roofline_func_t)(double *RESTRICT data, const uint64_t n);
+
+typedef struct {
+	const stress_stream_roofline_func_t func;	/* roofline kernel */
+	const uint32_t fmas;				/* multiply-adds per element */
+} stress_stream_roofline_kernel_t;
+
+static const stress_stream_roofline_kernel_t stream_roofline_kernels[] = {
+	{ stress_stream_roofline_fma1,		1 },
+	{ stress_stream_roofline_fma2,		2 },
+	{ stress_stream_roofline_fma4,		4 },
+	{ stress_stream_roofline_fma8,		8 },
+	{ stress_stream_roofline_fma16,		16 },
+	{ stress_stream_roofline_fma32,		32 },
+	{ stress_stream_roofline_fma64,		64 },
+	{ stress_stream_roofline_fma128,	128 },
+	{ stress_stream_roofline_fma256,	256 },
+};
+
+typedef struct {
+	const char *name;		/* memory level name */
+	uint64_t sz;			/* working set size in bytes */
+	uint64_t offset;		/* next chunk to process, in doubles */
+	double flops[SIZEOF_ARRAY(stream_roofline_kernels)];	/* flops performed */
+	double duration[SIZEOF_ARRAY(stream_roofline_kernels)];	/* time taken */
+} stress_stream_roofline_level_t;
+
+/*
+ *  stress_stream_roofline_add_level()
+ *	add a memory level with a working set of sz bytes
+ */
+static void stress_stream_roofline_add_level(
+	stress_stream_roofline_level_t *levels,
+	size_t *num_levels,
+	const char *name,
+	uint64_t sz)
+{
+	stress_stream_roofline_level_t *level;
+
+	sz &= ~(uint64_t)((STREAM_ROOFLINE_BLOCK * sizeof(double)) - 1);
+	if (!sz)
+		return;
+
+	level = &levels[*num_levels];
+	(void)memset(level, 0, sizeof(*level));
+	level->name = name;
+	level->sz = sz;
+	(*num_levels)++;
+}
+
+/*
+ *  stress_stream_roofline()
+ *	sweep the arithmetic intensity of the roofline kernels over
+ *	working sets that fit in each cache level and one that spills
+ *	out to DRAM, L3 is this instance's share of the L3 cache
+ */
+static int stress_stream_roofline(
+	const stress_args_t *args,
+	const uint64_t L3,
+	const bool has_L3)
+{
+	stress_stream_roofline_level_t levels[STREAM_ROOFLINE_LEVELS];
+	size_t i, j, num_levels = 0, idx = 0;
+	size_t cache_size, cache_line_size;
+	uint64_t sz = 0;
+	double *data;
+
+	/*
+	 *  Use half of each cache level to leave room for the
+	 *  stack and other data, DRAM uses 4 x the L3 size just
+	 *  like the STREAM kernels
+	 */
+	stress_cpu_cache_get_level_size(1, &cache_size, &cache_line_size);
+	stress_stream_roofline_add_level(levels, &num_levels, "L1", (uint64_t)cache_size / 2);
+	stress_cpu_cache_get_level_size(2, &cache_size, &cache_line_size);
+	stress_stream_roofline_add_level(levels, &num_levels, "L2", (uint64_t)cache_size / 2);
+	if (has_L3)
+		stress_stream_roofline_add_level(levels, &num_levels, "L3", L3 / 2);
+	stress_stream_roofline_add_level(levels, &num_levels, "DRAM", L3 * 4);
+
+	for (i = 0; i < num_levels; i++)
+		sz = STRESS_MAXIMUM(sz, levels[i].sz);
+
+	data = stress_stream_mmap(args, sz);
+	if (data == MAP_FAILED)
+		return EXIT_NO_RESOURCE;
+	stress_stream_init_data(data, sz / sizeof(*data));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; i < num_levels; i++) {
+			const uint64_t n = levels[i].sz / sizeof(*data);
+
+			for (j = 0; j < SIZEOF_ARRAY(stream_roofline_kernels); j++) {
+				const stress_stream_roofline_kernel_t *kernel = &stream_roofline_kernels[j];
+				const double t1 = stress_time_now();
+				double t2;
+				uint64_t elements = 0;
+
+				/*
+				 *  large working sets are processed in chunks so
+				 *  that each point takes about the same time
+				 */
+				do {
+					const uint64_t count = STRESS_MINIMUM(n - levels[i].offset,
+									      STREAM_ROOFLINE_CHUNK);
+
+					kernel->func(data + levels[i].offset, count);
+					elements += count;
+					levels[i].offset += count;
+					if (levels[i].offset >= n)
+						levels[i].offset = 0;
+					t2 = stress_time_now();
+				} while ((t2 - t1) < STREAM_ROOFLINE_SLICE);
+
+				levels[i].flops[j] += (double)elements * 2.0 * (double)kernel->fmas;
+				levels[i].duration[j] += t2 - t1;
+				if (!keep_stressing(args))
+					goto done;
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (!args->instance)
+		pr_inf("%s: roofline GFLOP/s, arithmetic intensity 0.125 to 32 flop/byte:\n", args->name);
+	for (i = 0; i < num_levels; i++) {
+		const stress_stream_roofline_level_t *level = &levels[i];
+		char buf[256], desc[64], *ptr = buf;
+		double gflops;
+
+		*ptr = '\0';
+		for (j = 0; j < SIZEOF_ARRAY(stream_roofline_kernels); j++) {
+			const uint32_t fmas = stream_roofline_kernels[j].fmas;
+
+			if (level->duration[j] <= 0.0)
+				break;
+			gflops = (level->flops[j] / level->duration[j]) / 1.0E9;
+			ptr += snprintf(ptr, sizeof(buf) - (size_t)(ptr - buf), " %8.2f", gflops);
+
+			/* 2 x fmas flops per 16 bytes, expressed as flops per KB */
+			(void)snprintf(desc, sizeof(desc), "%s GFLOP/s at %" PRIu32 " flop/KB",
+				level->name, fmas * 128);
+			stress_metrics_set(args, idx++, desc, gflops);
+		}
+		if (level->duration[0] <= 0.0)
+			continue;
+
+		/* memory bandwidth ceiling is measured at the lowest intensity */
+		(void)snprintf(desc, sizeof(desc), "%s bandwidth (GB per sec)", level->name);
+		stress_metrics_set(args, idx++, desc,
+			((level->flops[0] * 8.0) / level->duration[0]) / 1.0E9);
+		(void)snprintf(desc, sizeof(desc), "%s working set (KB)", level->name);
+		stress_metrics_set(args, idx++, desc, (double)level->sz / (double)KB);
+
+		if (!args->instance)
+			pr_inf("%s: %-4s %8" PRIu64 "K:%s\n", args->name,
+				level->name, level->sz / (uint64_t)KB, buf);
+	}
+
+	(void)munmap((void *)data, sz);
+
+	return EXIT_SUCCESS;
+}
+
+#if defined(__linux__) &&		\
+    defined(HAVE_SCHED_SETAFFINITY) &&	\
+    defined(__NR_mbind) &&		\
+    defined(HAVE_LINUX_MEMPOLICY_H)
+#define STRESS_STREAM_NUMA	(1)
+
+typedef struct {
+	double bytes;			/* triad bytes read and written */
+	double bytes_duration;		/* time taken for triad */
+	double loads;			/* pointer chase loads */
+	double loads_duration;		/* time taken for pointer chase */
+} stress_stream_numa_pair_t;
+
+/*
+ *  stress_stream_numa_nodes()
+ *	parse a sysfs node list such as 0-1,4 into an array of
+ *	node numbers, returns the number of nodes
+ */
+static size_t stress_stream_numa_nodes(const char *path, int32_t *nodes)
+{
+	char buf[4096], *ptr, *token;
+	size_t n = 0;
+
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return 0;
+
+	for (ptr = buf; (token = strtok(ptr, ",\n")) != NULL; ptr = NULL) {
+		int lo, hi, i;
+
+		if (sscanf(token, "%d-%d", &lo, &hi) != 2) {
+			if (sscanf(token, "%d", &lo) != 1)
+				continue;
+			hi = lo;
+		}
+		for (i = lo; (i <= hi) && (n < STREAM_NUMA_NODES_MAX); i++) {
+			if ((i >= 0) && (i < STREAM_NUMA_NODE_ID_MAX))
+				nodes[n++] = (int32_t)i;
+		}
+	}
+	return n;
+}
+
+/*
+ *  stress_stream_numa_cpuset()
+ *	get the cpus of a NUMA node that are also in the
+ *	allowed cpu set, returns false if there are none
+ */
+static bool stress_stream_numa_cpuset(
+	const int32_t node,
+	const cpu_set_t *allowed,
+	cpu_set_t *set)
+{
+	char path[PATH_MAX], buf[4096], *ptr, *token;
+	bool found = false;
+
+	CPU_ZERO(set);
+	(void)snprintf(path, sizeof(path),
+		"/sys/devices/system/node/node%" PRId32 "/cpulist", node);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+
+	for (ptr = buf; (token = strtok(ptr, ",\n")) != NULL; ptr = NULL) {
+		int lo, hi, i;
+
+		if (sscanf(token, "%d-%d", &lo, &hi) != 2) {
+			if (sscanf(token, "%d", &lo) != 1)
+				continue;
+			hi = lo;
+		}
+		for (i = lo; (i <= hi) && (i < CPU_SETSIZE); i++) {
+			if ((i >= 0) && CPU_ISSET(i, allowed)) {
+				CPU_SET(i, set);
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+/*
+ *  stress_stream_numa_mmap()
+ *	mmap a buffer and bind it to a NUMA memory node before
+ *	the pages are touched so they are all faulted in on that node
+ */
+static void *stress_stream_numa_mmap(
+	const stress_args_t *args,
+	const uint64_t sz,
+	const int32_t node)
+{
+	unsigned long nodemask[STREAM_NUMA_NODE_ID_MAX / (sizeof(unsigned long) * 8)];
+	void *ptr;
+
+	ptr = mmap(NULL, (size_t)sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		pr_dbg("%s: cannot allocate %" PRIu64 " bytes on node %" PRId32 "\n",
+			args->name, sz, node);
+		return MAP_FAILED;
+	}
+	(void)memset(nodemask, 0, sizeof(nodemask));
+	STRESS_SETBIT(nodemask, node);
+	if (shim_mbind(ptr, (unsigned long)sz, MPOL_BIND, nodemask,
+		       STREAM_NUMA_NODE_ID_MAX, MPOL_MF_STRICT) < 0) {
+		pr_dbg("%s: cannot bind memory to node %" PRId32 ", errno=%d (%s)\n",
+			args->name, node, errno, strerror(errno));
+		(void)munmap(ptr, (size_t)sz);
+		return MAP_FAILED;
+	}
+	return ptr;
+}
+
+/*
+ *  stress_stream_numa_chain()
+ *	turn a buffer into a randomly ordered cyclic chain of cache
+ *	line sized nodes using Sattolo's algorithm, returns the head
+ */
+static void *stress_stream_numa_chain(void *buf, const uint64_t sz)
+{
+	const uint32_t lines = (uint32_t)STRESS_MINIMUM(sz / STREAM_NUMA_LINE, 0xffffffffULL);
+	uintptr_t *ptr = (uintptr_t *)buf;
+	uint32_t i;
+
+	for (i = 0; i < lines; i++)
+		ptr[i * STREAM_NUMA_LINE_PTRS] = (uintptr_t)i;
+	for (i = lines - 1; i > 0; i--) {
+		const uint32_t j = stress_mwc32modn(i);
+		const uintptr_t tmp = ptr[i * STREAM_NUMA_LINE_PTRS];
+
+		ptr[i * STREAM_NUMA_LINE_PTRS] = ptr[j * STREAM_NUMA_LINE_PTRS];
+		ptr[j * STREAM_NUMA_LINE_PTRS] = tmp;
+	}
+	for (i = 0; i < lines; i++)
+		ptr[i * STREAM_NUMA_LINE_PTRS] = (uintptr_t)&ptr[ptr[i * STREAM_NUMA_LINE_PTRS] * STREAM_NUMA_LINE_PTRS];
+
+	return buf;
+}
+
+/*
+ *  stress_stream_numa_chase()
+ *	follow the pointer chain for about STREAM_NUMA_SLICE seconds,
+ *	each load depends on the previous one so the time per load
+ *	is the load-to-use latency
+ */
+static void OPTIMIZE3 stress_stream_numa_chase(
+	void *head,
+	stress_stream_numa_pair_t *pair)
+{
+	register void **ptr = (void **)head;
+	const double t1 = stress_time_now();
+	double t2;
+	uint64_t loads = 0;
+
+	do {
+		register int i;
+
+		for (i = 0; i < 1024; i++)
+			ptr = (void **)*ptr;
+		loads += 1024;
+		t2 = stress_time_now();
+	} while ((t2 - t1) < STREAM_NUMA_SLICE);
+
+	stress_void_ptr_put((void *)ptr);
+	pair->loads += (double)loads;
+	pair->loads_duration += t2 - t1;
+}
+
+/*
+ *  stress_stream_numa_value()
+ *	triad bandwidth in MB per sec or pointer chase latency
+ *	in ns of a cpu node and memory node pair, -1 if not measured
+ */
+static double stress_stream_numa_value(
+	const stress_stream_numa_pair_t *pair,
+	const bool latency)
+{
+	if (latency)
+		return (pair->loads_duration > 0.0) ?
+			(pair->loads_duration * STRESS_DBL_NANOSECOND) / pair->loads : -1.0;
+	return (pair->bytes_duration > 0.0) ?
+		(pair->bytes / (double)MB) / pair->bytes_duration : -1.0;
+}
+
+/*
+ *  stress_stream_numa_table()
+ *	print a cpu node (rows) by memory node (columns) matrix
+ */
+static void stress_stream_numa_table(
+	const stress_args_t *args,
+	const char *title,
+	const stress_stream_numa_pair_t *pairs,
+	const bool latency,
+	const int32_t *cpu_nodes,
+	const size_t num_cpu_nodes,
+	const int32_t *mem_nodes,
+	const size_t num_mem_nodes)
+{
+	char buf[1024];
+	size_t c, m, len;
+
+	len = (size_t)snprintf(buf, sizeof(buf), "%-18s", title);
+	for (m = 0; (m < num_mem_nodes) && (len < sizeof(buf)); m++) {
+		char node[16];
+
+		(void)snprintf(node, sizeof(node), "mem node %" PRId32, mem_nodes[m]);
+		len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %11s", node);
+	}
+	pr_inf("%s: %s\n", args->name, buf);
+
+	for (c = 0; c < num_cpu_nodes; c++) {
+		len = (size_t)snprintf(buf, sizeof(buf), "cpu node %-9" PRId32, cpu_nodes[c]);
+		for (m = 0; (m < num_mem_nodes) && (len < sizeof(buf)); m++) {
+			const double value = stress_stream_numa_value(&pairs[(c * num_mem_nodes) + m], latency);
+
+			if (value < 0.0)
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %11s", "-");
+			else
+				len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %11.1f", value);
+		}
+		pr_inf("%s: %s\n", args->name, buf);
+	}
+}
+
+/*
+ *  stress_stream_numa()
+ *	for every memory node bind the a, b, c arrays to that node
+ *	and run the triad kernel and a pointer chase from the cpus
+ *	of every cpu node, reporting a bandwidth and latency matrix
+ */
+static int stress_stream_numa(const stress_args_t *args, const uint64_t L3)
+{
+	int32_t cpu_nodes[STREAM_NUMA_NODES_MAX], mem_nodes[STREAM_NUMA_NODES_MAX];
+	size_t num_cpu_nodes, num_mem_nodes, c, m, idx = 0;
+	stress_stream_numa_pair_t *pairs;
+	cpu_set_t allowed;
+	const double q = 3.0;
+	const uint64_t sz = (L3 * 4) & ~(uint64_t)63;
+	const uint64_t n = sz / sizeof(double);
+	int rc = EXIT_SUCCESS;
+
+	num_cpu_nodes = stress_stream_numa_nodes("/sys/devices/system/node/has_cpu", cpu_nodes);
+	num_mem_nodes = stress_stream_numa_nodes("/sys/devices/system/node/has_memory", mem_nodes);
+	if (!num_cpu_nodes || !num_mem_nodes) {
+		if (!args->instance)
+			pr_inf_skip("%s: cannot determine NUMA topology, skipping stressor\n",
+				args->name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_inf_skip("%s: cannot get CPU affinity, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	pairs = calloc(num_cpu_nodes * num_mem_nodes, sizeof(*pairs));
+	if (!pairs) {
+		pr_inf_skip("%s: cannot allocate NUMA results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	if (!args->instance)
+		pr_inf("%s: measuring %zu CPU node%s x %zu memory node%s using %" PRIu64 "K arrays\n",
+			args->name, num_cpu_nodes, num_cpu_nodes == 1 ? "" : "s",
+			num_mem_nodes, num_mem_nodes == 1 ? "" : "s", sz / (uint64_t)KB);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; m < num_mem_nodes; m++) {
+			double *a, *b, *cc;
+			double rd_bytes = 0.0, wr_bytes = 0.0, fp_ops = 0.0;
+			void *head;
+
+			a = stress_stream_numa_mmap(args, sz, mem_nodes[m]);
+			if (a == MAP_FAILED)
+				continue;
+			b = stress_stream_numa_mmap(args, sz, mem_nodes[m]);
+			if (b == MAP_FAILED) {
+				(void)munmap((void *)a, sz);
+				continue;
+			}
+			cc = stress_stream_numa_mmap(args, sz, mem_nodes[m]);
+			if (cc == MAP_FAILED) {
+				(void)munmap((void *)b, sz);
+				(void)munmap((void *)a, sz);
+				continue;
+			}
+			stress_stream_init_data(a, n);
+			stress_stream_init_data(b, n);
+			stress_stream_init_data(cc, n);
+
+			for (c = 0; c < num_cpu_nodes; c++) {
+				stress_stream_numa_pair_t *pair = &pairs[(c * num_mem_nodes) + m];
+				cpu_set_t set;
+				double t1, t2;
+
+				if (!stress_stream_numa_cpuset(cpu_nodes[c], &allowed, &set))
+					continue;
+				if (sched_setaffinity(0, sizeof(set), &set) < 0)
+					continue;
+
+				rd_bytes = 0.0;
+				wr_bytes = 0.0;
+				t1 = stress_time_now();
+				do {
+					stress_stream_triad_index0(a, b, cc, q, n, &rd_bytes, &wr_bytes, &fp_ops);
+					t2 = stress_time_now();
+				} while ((t2 - t1) < STREAM_NUMA_SLICE);
+				pair->bytes += rd_bytes + wr_bytes;
+				pair->bytes_duration += t2 - t1;
+			}
+
+			/* the chain overwrites the triad data in a */
+			head = stress_stream_numa_chain((void *)a, sz);
+			for (c = 0; c < num_cpu_nodes; c++) {
+				cpu_set_t set;
+
+				if (!stress_stream_numa_cpuset(cpu_nodes[c], &allowed, &set))
+					continue;
+				if (sched_setaffinity(0, sizeof(set), &set) < 0)
+					continue;
+				stress_stream_numa_chase(head, &pairs[(c * num_mem_nodes) + m]);
+				inc_counter(args);
+			}
+
+			(void)munmap((void *)cc, sz);
+			(void)munmap((void *)b, sz);
+			(void)munmap((void *)a, sz);
+			(void)sched_setaffinity(0, sizeof(allowed), &allowed);
+
+			if (!keep_stressing(args))
+				break;
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (!args->instance) {
+		stress_stream_numa_table(args, "triad MB per sec", pairs, false,
+			cpu_nodes, num_cpu_nodes, mem_nodes, num_mem_nodes);
+		stress_stream_numa_table(args, "latency ns", pairs, true,
+			cpu_nodes, num_cpu_nodes, mem_nodes, num_mem_nodes);
+	}
+	for (c = 0; c < num_cpu_nodes; c++) {
+		for (m = 0; m < num_mem_nodes; m++) {
+			const stress_stream_numa_pair_t *pair = &pairs[(c * num_mem_nodes) + m];
+			char desc[64];
+
+			if (pair->bytes_duration > 0.0) {
+				(void)snprintf(desc, sizeof(desc), "node %" PRId32 " to %" PRId32 " triad (MB per sec)",
+					cpu_nodes[c], mem_nodes[m]);
+				stress_metrics_set(args, idx++, desc, stress_stream_numa_value(pair, false));
+			}
+			if (pair->loads_duration > 0.0) {
+				(void)snprintf(desc, sizeof(desc), "node %" PRId32 " to %" PRId32 " latency (ns)",
+					cpu_nodes[c], mem_nodes[m]);
+				stress_metrics_set(args, idx++, desc, stress_stream_numa_value(pair, true));
+			}
+		}
+	}
+	free(pairs);
+
+	return rc;
+}
+#endif
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  Threaded mode, N pthreads cooperatively run the index 0 kernels
+ *  over one shared set of arrays. Each thread owns a contiguous
+ *  partition of the arrays that it first touches so that the pages
+ *  are placed on the thread's NUMA node and each kernel is followed
+ *  by a barrier so that all threads run the same kernel at a time.
+ */
+typedef struct {
+	pthread_mutex_t mutex;		/* protects the fields below */
+	pthread_cond_t cond;		/* signalled when all threads arrive */
+	size_t count;			/* threads waiting at the barrier */
+	size_t num;			/* threads to wait for */
+	uint64_t generation;		/* barrier cycle */
+} stress_stream_barrier_t;
+
+struct stress_stream_threads;
+
+typedef struct {
+	pthread_t pthread;		/* pthread handle */
+	int ret;			/* pthread create return value */
+	size_t id;			/* thread and partition index */
+	struct stress_stream_threads *st; /* shared state */
+	double rd_bytes;		/* bytes read */
+	double wr_bytes;		/* bytes written */
+	double fp_ops;			/* floating point ops */
+	double duration;		/* kernel run time, stressor thread only */
+} stress_stream_thread_t;
+
+typedef struct stress_stream_threads {
+	double *a;			/* shared array a */
+	double *b;			/* shared array b */
+	double *c;			/* shared array c */
+	uint64_t n;			/* doubles per array */
+	const stress_stream_store_t *store; /* store variant kernels */
+	size_t num_threads;		/* threads including the stressor */
+	stress_stream_thread_t *threads; /* per thread info */
+	stress_stream_barrier_t barrier; /* per kernel barrier */
+	pthread_mutex_t mutex;		/* protects go */
+	pthread_cond_t go_cond;		/* signalled when threads may start */
+	bool go;			/* num_threads is final */
+	bool terminate;			/* tell threads to exit */
+} stress_stream_threads_t;
+
+/*
+ *  stress_stream_barrier()
+ *	wait until all the threads have reached the barrier
+ */
+static void stress_stream_barrier(stress_stream_barrier_t *barrier)
+{
+	uint64_t generation;
+
+	(void)pthread_mutex_lock(&barrier->mutex);
+	generation = barrier->generation;
+	if (++barrier->count == barrier->num) {
+		barrier->count = 0;
+		barrier->generation++;
+		(void)pthread_cond_broadcast(&barrier->cond);
+	} else {
+		while (generation == barrier->generation)
+			(void)pthread_cond_wait(&barrier->cond, &barrier->mutex);
+	}
+	(void)pthread_mutex_unlock(&barrier->mutex);
+}
+
+/*
+ *  stress_stream_thread_run()
+ *	first touch the thread's partition and run the kernels
+ *	over it until the stressor thread sets terminate, the
+ *	partitions are multiples of 64 bytes to keep the vector
+ *	non-temporal stores aligned. args is only set for the
+ *	stressor thread, this times the kernels and decides
+ *	when to stop
+ */
+static void stress_stream_thread_run(
+	const stress_args_t *args,
+	stress_stream_thread_t *thread)
+{
+	stress_stream_threads_t *st = thread->st;
+	const stress_stream_store_t *store = st->store;
+	const uint64_t lines = st->n / 8;
+	const uint64_t lo = ((lines * thread->id) / st->num_threads) * 8;
+	const uint64_t hi = ((lines * (thread->id + 1)) / st->num_threads) * 8;
+	const uint64_t n = hi - lo;
+	double *a = st->a + lo;
+	double *b = st->b + lo;
+	double *c = st->c + lo;
+	const double q = 3.0;
+
+	stress_stream_init_data(a, n);
+	stress_stream_init_data(b, n);
+	stress_stream_init_data(c, n);
+
+	for (;;) {
+		double t;
+
+		stress_stream_barrier(&st->barrier);
+		if (st->terminate)
+			break;
+		t = stress_time_now();
+		store->copy(c, a, n, &thread->rd_bytes, &thread->wr_bytes, &thread->fp_ops);
+		stress_stream_barrier(&st->barrier);
+		store->scale(b, c, q, n, &thread->rd_bytes, &thread->wr_bytes, &thread->fp_ops);
+		stress_stream_barrier(&st->barrier);
+		store->add(c, b, a, n, &thread->rd_bytes, &thread->wr_bytes, &thread->fp_ops);
+		stress_stream_barrier(&st->barrier);
+		store->triad(a, b, c, q, n, &thread->rd_bytes, &thread->wr_bytes, &thread->fp_ops);
+		stress_stream_barrier(&st->barrier);
+
+		if (args) {
+			thread->duration += stress_time_now() - t;
+			inc_counter(args);
+			if (!keep_stressing(args))
+				st->terminate = true;
+		}
+	}
+}
+
+/*
+ *  stress_stream_thread()
+ *	pthread that waits for the go signal and runs the kernels
+ */
+static void *stress_stream_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_stream_thread_t *thread = (stress_stream_thread_t *)arg;
+	stress_stream_threads_t *st = thread->st;
+
+	(void)pthread_mutex_lock(&st->mutex);
+	while (!st->go)
+		(void)pthread_cond_wait(&st->go_cond, &st->mutex);
+	(void)pthread_mutex_unlock(&st->mutex);
+
+	if (thread->id < st->num_threads)
+		stress_stream_thread_run(NULL, thread);
+	return &nowt;
+}
+
+/*
+ *  stress_stream_threads()
+ *	run the index 0 kernels with num_threads threads, the stressor
+ *	itself is thread 0 and times each iteration of the kernels
+ */
+static int stress_stream_threads(
+	const stress_args_t *args,
+	const uint64_t sz,
+	const stress_stream_store_t *store,
+	const size_t num_threads)
+{
+	stress_stream_threads_t st;
+	size_t i, started = 1;
+	double duration = 0.0, rd_bytes = 0.0, wr_bytes = 0.0, fp_ops = 0.0;
+	uint64_t dtlb_begin = 0, dtlb_end = 0;
+	int ret = EXIT_NO_RESOURCE, dtlb_fd;
+
+	(void)memset(&st, 0, sizeof(st));
+	st.n = sz / sizeof(double);
+	st.store = store;
+	st.num_threads = num_threads;
+
+	/* no MAP_POPULATE, pages are placed by the first touching thread */
+	st.a = stress_stream_mmap_array(args, sz, 0);
+	if (st.a == MAP_FAILED)
+		return EXIT_NO_RESOURCE;
+	st.b = stress_stream_mmap_array(args, sz, 0);
+	if (st.b == MAP_FAILED)
+		goto tidy_a;
+	st.c = stress_stream_mmap_array(args, sz, 0);
+	if (st.c == MAP_FAILED)
+		goto tidy_b;
+
+	st.threads = calloc(num_threads, sizeof(*st.threads));
+	if (!st.threads) {
+		pr_inf_skip("%s: failed to allocate %zd pthread information elements, skipping stressor\n",
+			args->name, num_threads);
+		goto tidy_c;
+	}
+	(void)pthread_mutex_init(&st.mutex, NULL);
+	(void)pthread_cond_init(&st.go_cond, NULL);
+	(void)pthread_mutex_init(&st.barrier.mutex, NULL);
+	(void)pthread_cond_init(&st.barrier.cond, NULL);
+
+	for (i = 0; i < num_threads; i++) {
+		st.threads[i].id = i;
+		st.threads[i].st = &st;
+	}
+	/* counter is opened first so it is inherited by the threads */
+	dtlb_fd = stress_perf_dtlb_open();
+	(void)stress_perf_counter_read(dtlb_fd, &dtlb_begin);
+
+	for (i = 1; i < num_threads; i++) {
+		st.threads[i].ret = pthread_create(&st.threads[i].pthread, NULL,
+						   stress_stream_thread, &st.threads[i]);
+		if (st.threads[i].ret) {
+			pr_inf("%s: pthread create failed, errno=%d (%s), using %zd threads\n",
+				args->name, st.threads[i].ret, strerror(st.threads[i].ret), started);
+			break;
+		}
+		started++;
+	}
+
+	/* arrays are only partitioned over the threads that started */
+	(void)pthread_mutex_lock(&st.mutex);
+	st.num_threads = started;
+	st.barrier.num = started;
+	st.go = true;
+	(void)pthread_cond_broadcast(&st.go_cond);
+	(void)pthread_mutex_unlock(&st.mutex);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	stress_stream_thread_run(args, &st.threads[0]);
+	duration = st.threads[0].duration;
+
+	for (i = 1; i < started; i++)
+		(void)pthread_join(st.threads[i].pthread, NULL);
+	for (i = 0; i < started; i++) {
+		rd_bytes += st.threads[i].rd_bytes;
+		wr_bytes += st.threads[i].wr_bytes;
+		fp_ops += st.threads[i].fp_ops;
+	}
+
+	if (duration > 0.0) {
+		const double rd_rate = rd_bytes / duration / STRESS_DBL_NANOSECOND;
+		const double wr_rate = wr_bytes / duration / STRESS_DBL_NANOSECOND;
+
+		pr_dbg("%s: %zd threads, %.2f GB read/sec, %.2f GB write/sec (instance %" PRIu32 ")\n",
+			args->name, started, rd_rate, wr_rate, args->instance);
+		stress_metrics_set(args, 0, "aggregate memory rate (GB per sec)", rd_rate + wr_rate);
+		stress_metrics_set(args, 1, "aggregate read rate (GB per sec)", rd_rate);
+		stress_metrics_set(args, 2, "aggregate write rate (GB per sec)", wr_rate);
+		stress_metrics_set(args, 3, "memory rate (Mflop per sec)", fp_ops / duration / 1000000.0);
+		if (stress_perf_counter_read(dtlb_fd, &dtlb_end) && (rd_bytes + wr_bytes > 0.0))
+			stress_metrics_set(args, 4, "dTLB read misses per MB",
+				(double)(dtlb_end - dtlb_begin) / ((rd_bytes + wr_bytes) / (double)MB));
+	} else {
+		if (args->instance == 0)
+			pr_inf("%s: run duration too short to determine memory rate\n", args->name);
+	}
+	ret = EXIT_SUCCESS;
+
+	if (dtlb_fd >= 0)
+		(void)close(dtlb_fd);
+	(void)pthread_cond_destroy(&st.barrier.cond);
+	(void)pthread_mutex_destroy(&st.barrier.mutex);
+	(void)pthread_cond_destroy(&st.go_cond);
+	(void)pthread_mutex_destroy(&st.mutex);
+	free(st.threads);
+tidy_c:
+	(void)munmap((void *)st.c, sz);
+tidy_b:
+	(void)munmap((void *)st.b, sz);
+tidy_a:
+	(void)munmap((void *)st.a, sz);
+
+	return ret;
+}
+#endif
+
+/*
+ *  stress_stream_store_best()
+ *	return the stream_stores index of the fastest of the trials
+ */
+static size_t stress_stream_store_best(
+	const size_t *trials,
+	const double *trial_rates,
+	const size_t num_trials)
+{
+	size_t i, best = 0;
+
+	for (i = 1; i < num_trials; i++) {
+		if (trial_rates[i] > trial_rates[best])
+			best = i;
+	}
+	return trials[best];
+}
+
 /*
  *  stress_stream()
  *	stress cache/memory/CPU with stream stressors
@@ -712,21 +1951,48 @@ static int stress_stream(const stress_args_t *args)
 	size_t *idx1 = NULL, *idx2 = NULL, *idx3 = NULL;
 	const double q = 3.0;
 	double fp_ops = 0.0, t1, t2, dt;
-	uint32_t stream_index = 0;
+	uint32_t stream_index = 0, stream_threads = 1;
 	uint64_t L3, sz, n, sz_idx;
 	uint64_t stream_L3_size = DEFAULT_STREAM_L3_SIZE;
-	bool guess = false;
-#if defined(HAVE_NT_STORE_DOUBLE)
-	const bool has_sse2 = stress_cpu_x86_has_sse2();
-#endif
+	uint64_t L3_cache;
+	bool guess = false, has_L3 = false, stream_roofline = false, stream_numa = false;
 	double rd_bytes = 0.0, wr_bytes = 0.0;
+	uint64_t dtlb_begin = 0, dtlb_end = 0;
+	int dtlb_fd;
+	size_t stream_backing, stream_store = SIZEOF_ARRAY(stream_stores);
+	size_t i, trial = 0, num_trials = 0, trials[SIZEOF_ARRAY(stream_stores)];
+	double trial_rates[SIZEOF_ARRAY(stream_stores)];
+
+	if (stress_get_setting("stream-L3-size", &stream_L3_size)) {
+		size_t cache_size, cache_line_size;
 
-	if (stress_get_setting("stream-L3-size", &stream_L3_size))
 		L3 = stream_L3_size;
-	else
+		has_L3 = true;
+		stress_cpu_cache_get_level_size(3, &cache_size, &cache_line_size);
+		L3_cache = (uint64_t)cache_size;
+	} else {
+		size_t cache_size, cache_line_size;
+
 		L3 = get_stream_L3_size(args);
+		L3_cache = L3;
+		stress_cpu_cache_get_level_size(3, &cache_size, &cache_line_size);
+		has_L3 = (cache_size > 0);
+	}
 
 	(void)stress_get_setting("stream-index", &stream_index);
+	(void)stress_get_setting("stream-numa", &stream_numa);
+	(void)stress_get_setting("stream-roofline", &stream_roofline);
+	(void)stress_get_setting("stream-store", &stream_store);
+	(void)stress_get_setting("stream-threads", &stream_threads);
+
+	if ((stream_store < SIZEOF_ARRAY(stream_stores)) &&
+	    !stream_stores[stream_store].supported()) {
+		if (!args->instance)
+			pr_inf_skip("%s: stream-store '%s' is not supported by this "
+				"CPU, skipping stressor\n", args->name,
+				stream_stores[stream_store].name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
 
 	/* Have to take a hunch and badly guess size */
 	if (!L3) {
@@ -754,21 +2020,70 @@ static int stress_stream(const stress_args_t *args)
 	if (L3 < args->page_size)
 		L3 = args->page_size;
 
+	if (stream_roofline)
+		return stress_stream_roofline(args, L3, has_L3);
+	if (stream_numa) {
+#if defined(STRESS_STREAM_NUMA)
+		return stress_stream_numa(args, L3);
+#else
+		if (!args->instance)
+			pr_inf_skip("%s: NUMA matrix mode not supported on this system, "
+				"skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
+
 	/*
 	 *  Each array must be at least 4 x the
 	 *  size of the L3 cache
 	 */
 	sz = (L3 * 4);
-	n = sz / sizeof(*a);
 	sz &= ~(uint64_t)63;
+	if (stress_get_setting("stream-backing", &stream_backing)) {
+		const uint64_t backing_page_size = (uint64_t)stress_mmap_backing_page_size(stream_backing);
+
+		sz = (sz + backing_page_size - 1) & ~(backing_page_size - 1);
+		/* failing to get huge pages is a lack of resources */
+		rc = EXIT_NO_RESOURCE;
+	}
+	n = sz / sizeof(*a);
 
-	a = stress_stream_mmap(args, sz);
+	/*
+	 *  Auto store selection trials each supported variant for
+	 *  one bogo loop and then uses the fastest, non-temporal
+	 *  stores are only tried if the arrays do not fit in the cache
+	 */
+	if (stream_store >= SIZEOF_ARRAY(stream_stores)) {
+		const bool fits = (sz * 3 * args->num_instances) <= L3_cache;
+
+		for (i = 0; i < SIZEOF_ARRAY(stream_stores); i++) {
+			if (stream_stores[i].nt && fits)
+				continue;
+			if (stream_stores[i].supported())
+				trials[num_trials++] = i;
+		}
+		stream_store = trials[0];
+	}
+
+	if (stream_threads > 1) {
+#if defined(HAVE_LIB_PTHREAD)
+		return stress_stream_threads(args, sz, &stream_stores[stream_store],
+			(size_t)stream_threads);
+#else
+		if (!args->instance)
+			pr_inf_skip("%s: pthreads not supported on this system, "
+				"skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
+
+	a = stress_stream_mmap_array(args, sz, STREAM_MAP_POPULATE);
 	if (a == MAP_FAILED)
 		goto err_a;
-	b = stress_stream_mmap(args, sz);
+	b = stress_stream_mmap_array(args, sz, STREAM_MAP_POPULATE);
 	if (b == MAP_FAILED)
 		goto err_b;
-	c = stress_stream_mmap(args, sz);
+	c = stress_stream_mmap_array(args, sz, STREAM_MAP_POPULATE);
 	if (c == MAP_FAILED)
 		goto err_c;
 
@@ -803,6 +2118,8 @@ static int stress_stream(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
+	dtlb_fd = stress_perf_dtlb_open();
+	(void)stress_perf_counter_read(dtlb_fd, &dtlb_begin);
 	t1 = stress_time_now();
 	do {
 		switch (stream_index) {
@@ -826,19 +2143,24 @@ static int stress_stream(const stress_args_t *args)
 			break;
 		case 0:
 		default:
-#if defined(HAVE_NT_STORE_DOUBLE)
-			if (has_sse2) {
-				stress_stream_copy_index0_nt(c, a, n, &rd_bytes, &wr_bytes, &fp_ops);
-				stress_stream_scale_index0_nt(b, c, q, n, &rd_bytes, &wr_bytes, &fp_ops);
-				stress_stream_add_index0_nt(c, b, a, n,  &rd_bytes, &wr_bytes, &fp_ops);
-				stress_stream_triad_index0_nt(a, b, c, q, n, &rd_bytes, &wr_bytes, &fp_ops);
-				break;
+			{
+				const stress_stream_store_t *store = &stream_stores[stream_store];
+				const double bytes = rd_bytes + wr_bytes;
+				const double t = stress_time_now();
+
+				store->copy(c, a, n, &rd_bytes, &wr_bytes, &fp_ops);
+				store->scale(b, c, q, n, &rd_bytes, &wr_bytes, &fp_ops);
+				store->add(c, b, a, n, &rd_bytes, &wr_bytes, &fp_ops);
+				store->triad(a, b, c, q, n, &rd_bytes, &wr_bytes, &fp_ops);
+
+				if (trial < num_trials) {
+					trial_rates[trial] = ((rd_bytes + wr_bytes - bytes) / (double)MB) /
+							     (stress_time_now() - t);
+					trial++;
+					stream_store = (trial < num_trials) ? trials[trial] :
+						stress_stream_store_best(trials, trial_rates, trial);
+				}
 			}
-#endif
-			stress_stream_copy_index0(c, a, n, &rd_bytes, &wr_bytes, &fp_ops);
-			stress_stream_scale_index0(b, c, q, n, &rd_bytes, &wr_bytes, &fp_ops);
-			stress_stream_add_index0(c, b, a, n, &rd_bytes, &wr_bytes, &fp_ops);
-			stress_stream_triad_index0(a, b, c, q, n, &rd_bytes, &wr_bytes, &fp_ops);
 			break;
 		}
 		inc_counter(args);
@@ -856,11 +2178,35 @@ static int stress_stream(const stress_args_t *args)
 		stress_metrics_set(args, 0, "memory read rate (MB per sec)", mb_rd_rate);
 		stress_metrics_set(args, 1, "memory write rate (MB per sec)", mb_wr_rate);
 		stress_metrics_set(args, 2, "memory rate (Mflop per sec)", fp_rate);
+		if (stress_perf_counter_read(dtlb_fd, &dtlb_end))
+			stress_metrics_set(args, 3 + SIZEOF_ARRAY(stream_stores),
+				"dTLB read misses per MB",
+				(double)(dtlb_end - dtlb_begin) / ((rd_bytes + wr_bytes) / (double)MB));
 	} else {
 		if (args->instance == 0)
 			pr_inf("%s: run duration too short to determine memory rate\n", args->name);
 	}
 
+	if (num_trials > 0) {
+		const size_t best = stress_stream_store_best(trials, trial_rates, trial);
+
+		for (i = 0; i < trial; i++) {
+			char desc[64];
+
+			(void)snprintf(desc, sizeof(desc), "%s stores trial rate (MB per sec)",
+				stream_stores[trials[i]].name);
+			stress_metrics_set(args, 3 + i, desc, trial_rates[i]);
+			if (args->instance == 0)
+				pr_dbg("%s: %-8s stores %10.2f MB per sec\n", args->name,
+					stream_stores[trials[i]].name, trial_rates[i]);
+		}
+		if ((args->instance == 0) && (trial > 0))
+			pr_inf("%s: auto selected %s stores out of %zu trialled variant%s\n",
+				args->name, stream_stores[best].name, trial, trial == 1 ? "" : "s");
+	}
+
+	if (dtlb_fd >= 0)
+		(void)close(dtlb_fd);
 	rc = EXIT_SUCCESS;
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
@@ -891,9 +2237,14 @@ err_a:
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_stream_backing,	stress_set_stream_backing },
 	{ OPT_stream_index,	stress_set_stream_index },
 	{ OPT_stream_l3_size,	stress_set_stream_L3_size },
 	{ OPT_stream_madvise,	stress_set_stream_madvise },
+	{ OPT_stream_numa,	stress_set_stream_numa },
+	{ OPT_stream_roofline,	stress_set_stream_roofline },
+	{ OPT_stream_store,	stress_set_stream_store },
+	{ OPT_stream_threads,	stress_set_stream_threads },
 	{ 0,			NULL }
 };
 
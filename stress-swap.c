@@ -19,6 +19,8 @@
  */
 #include "stress-ng.h"
 #include "core-capabilities.h"
+#include "core-cgroup.h"
+#include "core-latency.h"
 
 #if defined(__sun__)
 /* Disable for SunOs/Solaris because */
@@ -32,10 +34,69 @@
 #define SHIM_EXT2_IOC_SETFLAGS		_IOW('f', 2, long)
 #define SHIM_FS_NOCOW_FL		0x00800000 /* No Copy-on-Write file */
 
+#define MIN_SWAP_BENCH_BYTES		(4 * MB)
+#define MAX_SWAP_BENCH_BYTES		(MAX_MEM_LIMIT)
+#define DEFAULT_SWAP_BENCH_BYTES	(64 * MB)
+#define SWAP_BENCH_WRITEBACK_POLLS	(1000)
+#define SWAP_BENCH_WRITEBACK_USEC	(1000)
+
+#define SWAP_BENCH_FILL_RANDOM		(0)	/* incompressible */
+#define SWAP_BENCH_FILL_MIXED		(1)	/* quarter random, rest text */
+#define SWAP_BENCH_FILL_TEXT		(2)	/* repeated words */
+#define SWAP_BENCH_FILL_ZERO		(3)	/* zero apart from a check stamp */
+
 static const stress_help_t help[] = {
-	{ NULL,	"swap N",	"start N workers exercising swapon/swapoff" },
-	{ NULL,	"swap-ops N",	"stop after N swapon/swapoff operations" },
-	{ NULL,	NULL,		NULL }
+	{ NULL,	"swap N",		"start N workers exercising swapon/swapoff" },
+	{ NULL,	"swap-bench",		"measure swap out and swap in bandwidth and fault latency" },
+	{ NULL,	"swap-bench-bytes N",	"swap a working set of N bytes, default is 2 x memory.max" },
+	{ NULL,	"swap-bench-fill F",	"fill pages with [random|mixed|text|zero] data" },
+	{ NULL,	"swap-ops N",		"stop after N swapon/swapoff operations" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const swap_bench_fills[] = {
+	"random",
+	"mixed",
+	"text",
+	"zero",
+};
+
+static int stress_set_swap_bench(const char *opt)
+{
+	return stress_set_setting_true("swap-bench", opt);
+}
+
+static int stress_set_swap_bench_bytes(const char *opt)
+{
+	uint64_t swap_bench_bytes;
+
+	swap_bench_bytes = stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("swap-bench-bytes", swap_bench_bytes,
+		MIN_SWAP_BENCH_BYTES, MAX_SWAP_BENCH_BYTES);
+	return stress_set_setting("swap-bench-bytes", TYPE_ID_UINT64, &swap_bench_bytes);
+}
+
+static int stress_set_swap_bench_fill(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(swap_bench_fills); i++) {
+		if (!strcmp(opt, swap_bench_fills[i]))
+			return stress_set_setting("swap-bench-fill", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "swap-bench-fill must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(swap_bench_fills); i++)
+		(void)fprintf(stderr, " %s", swap_bench_fills[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_swap_bench,	stress_set_swap_bench },
+	{ OPT_swap_bench_bytes,	stress_set_swap_bench_bytes },
+	{ OPT_swap_bench_fill,	stress_set_swap_bench_fill },
+	{ 0,			NULL }
 };
 
 #if defined(HAVE_SYS_SWAP_H) &&	\
@@ -234,6 +295,488 @@ static void stress_swap_check_swapped(
 	free(vec);
 }
 
+/* swap counters from /proc/vmstat, in pages */
+typedef struct {
+	uint64_t pswpin;		/* pages read from swap devices */
+	uint64_t pswpout;		/* pages written to swap devices */
+	uint64_t zswpin;		/* pages loaded from zswap */
+	uint64_t zswpout;		/* pages stored in zswap */
+	uint64_t nr_writeback;		/* pages under writeback now */
+} stress_swap_vmstat_t;
+
+/* accumulated swap benchmark results */
+typedef struct {
+	double out_secs;		/* seconds dirtying and paging out */
+	double out_pages;		/* pages swapped out */
+	double out_zswap;		/* pages of out_pages stored in zswap */
+	double out_sys;			/* system cpu seconds swapping out */
+	double in_secs;			/* seconds reading back the working set */
+	double in_pages;		/* pages swapped in */
+	double in_sys;			/* system cpu seconds swapping in */
+	double zswap_orig;		/* zswap uncompressed and compressed bytes */
+	double zswap_compr;
+	double zram_orig;		/* zram uncompressed and compressed bytes */
+	double zram_compr;
+	stress_latency_t latency;	/* first touch latency of swapped out pages */
+} stress_swap_bench_t;
+
+/*
+ *  stress_swap_vmstat()
+ *	read the swap in, swap out and writeback counters from /proc/vmstat
+ */
+static void stress_swap_vmstat(stress_swap_vmstat_t *vmstat)
+{
+	FILE *fp;
+	char buffer[256];
+
+	(void)memset(vmstat, 0, sizeof(*vmstat));
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char name[64];
+		uint64_t val;
+
+		if (sscanf(buffer, "%63s %" SCNu64, name, &val) != 2)
+			continue;
+		if (!strcmp(name, "pswpin"))
+			vmstat->pswpin = val;
+		else if (!strcmp(name, "pswpout"))
+			vmstat->pswpout = val;
+		else if (!strcmp(name, "zswpin"))
+			vmstat->zswpin = val;
+		else if (!strcmp(name, "zswpout"))
+			vmstat->zswpout = val;
+		else if (!strcmp(name, "nr_writeback"))
+			vmstat->nr_writeback = val;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_swap_compressed()
+ *	add the uncompressed and compressed bytes held by zswap
+ *	(/proc/meminfo Zswapped and Zswap) and by zram swap devices
+ *	(mm_stat orig_data_size and compr_data_size)
+ */
+static void stress_swap_compressed(stress_swap_bench_t *bench)
+{
+	FILE *fp;
+	char buffer[512];
+	uint64_t kb;
+
+	fp = fopen("/proc/meminfo", "r");
+	if (fp) {
+		while (fgets(buffer, sizeof(buffer), fp)) {
+			if (sscanf(buffer, "Zswapped: %" SCNu64, &kb) == 1)
+				bench->zswap_orig += (double)kb * 1024.0;
+			else if (sscanf(buffer, "Zswap: %" SCNu64, &kb) == 1)
+				bench->zswap_compr += (double)kb * 1024.0;
+		}
+		(void)fclose(fp);
+	}
+
+	fp = fopen("/proc/swaps", "r");
+	if (!fp)
+		return;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char dev[64], path[PATH_MAX], stat[256];
+		uint64_t orig, compr;
+
+		if (sscanf(buffer, "/dev/%63s", dev) != 1)
+			continue;
+		if (strncmp(dev, "zram", 4))
+			continue;
+		(void)snprintf(path, sizeof(path), "/sys/block/%s/mm_stat", dev);
+		if (system_read(path, stat, sizeof(stat)) <= 0)
+			continue;
+		if (sscanf(stat, "%" SCNu64 " %" SCNu64, &orig, &compr) != 2)
+			continue;
+		bench->zram_orig += (double)orig;
+		bench->zram_compr += (double)compr;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_swap_bench_info()
+ *	report the active swap devices and the zswap settings
+ */
+static void stress_swap_bench_info(
+	const stress_args_t *args,
+	const size_t bytes,
+	const uint64_t memory_max,
+	const bool limited)
+{
+	FILE *fp;
+	char buffer[512], enabled[16], compressor[32];
+
+	fp = fopen("/proc/swaps", "r");
+	if (fp) {
+		while (fgets(buffer, sizeof(buffer), fp)) {
+			char name[PATH_MAX], type[32];
+			uint64_t size, used;
+			int prio;
+
+			if (sscanf(buffer, "%4095s %31s %" SCNu64 " %" SCNu64 " %d",
+				   name, type, &size, &used, &prio) != 5)
+				continue;
+			pr_inf("%s: swap %s %s, %.1f MB, priority %d\n",
+				args->name, type, name, (double)size / 1024.0, prio);
+		}
+		(void)fclose(fp);
+	}
+
+	if ((system_read("/sys/module/zswap/parameters/enabled", enabled, sizeof(enabled)) > 0) &&
+	    (*enabled == 'Y')) {
+		if (system_read("/sys/module/zswap/parameters/compressor", compressor, sizeof(compressor)) <= 0)
+			(void)shim_strlcpy(compressor, "unknown", sizeof(compressor));
+		compressor[strcspn(compressor, "\n")] = '\0';
+		pr_inf("%s: zswap enabled, %s compressor\n", args->name, compressor);
+	} else {
+		pr_inf("%s: zswap not enabled\n", args->name);
+	}
+
+	if (limited) {
+		pr_inf("%s: working set %.1f MB, cgroup memory.max %.1f MB\n",
+			args->name, (double)bytes / (double)MB, (double)memory_max / (double)MB);
+	} else {
+		pr_inf("%s: working set %.1f MB, no cgroup memory.max, paging out with madvise\n",
+			args->name, (double)bytes / (double)MB);
+	}
+}
+
+/*
+ *  stress_swap_bench_template()
+ *	fill a page sized template with the fill pattern
+ */
+static void stress_swap_bench_template(uint8_t *template, const size_t page_size, const size_t fill)
+{
+	static const char words[] =
+		"the quick brown fox jumps over the lazy dog while swap pages are "
+		"compressed and written out then faulted back in again, ";
+	size_t i;
+
+	switch (fill) {
+	case SWAP_BENCH_FILL_RANDOM:
+		stress_uint8rnd4(template, page_size);
+		break;
+	case SWAP_BENCH_FILL_MIXED:
+		for (i = 0; i < page_size; i++)
+			template[i] = (uint8_t)words[i % (sizeof(words) - 1)];
+		stress_uint8rnd4(template, page_size / 4);
+		break;
+	case SWAP_BENCH_FILL_TEXT:
+		for (i = 0; i < page_size; i++)
+			template[i] = (uint8_t)words[i % (sizeof(words) - 1)];
+		break;
+	default:
+		(void)memset(template, 0, page_size);
+		break;
+	}
+}
+
+/*
+ *  stress_swap_bench_pass()
+ *	dirty the working set so it is pushed out by the cgroup memory.max
+ *	limit or madvise MADV_PAGEOUT, then read it back timing the first
+ *	touch of each page that was not resident
+ */
+static int stress_swap_bench_pass(
+	const stress_args_t *args,
+	uint8_t *ptr,
+	const size_t npages,
+	const uint8_t *template,
+	unsigned char *vec,
+	const bool limited,
+	const uint64_t pass,
+	stress_swap_bench_t *bench)
+{
+	const size_t page_size = args->page_size;
+	const size_t bytes = npages * page_size;
+	stress_swap_vmstat_t v0, v1;
+	struct rusage r0, r1;
+	double t;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	/* swap out */
+	stress_swap_vmstat(&v0);
+	(void)getrusage(RUSAGE_SELF, &r0);
+	t = stress_time_now();
+	for (i = 0; i < npages; i++) {
+		uint8_t *p = ptr + (i * page_size);
+
+		(void)memcpy(p, template, page_size);
+		*(uint64_t *)p = (uint64_t)(uintptr_t)p ^ pass;
+	}
+#if defined(MADV_PAGEOUT)
+	if (!limited) {
+		(void)shim_madvise(ptr, bytes, MADV_PAGEOUT);
+		/* the page out is asynchronous, include the writeback time */
+		for (i = 0; i < SWAP_BENCH_WRITEBACK_POLLS; i++) {
+			stress_swap_vmstat(&v1);
+			if (!v1.nr_writeback)
+				break;
+			(void)shim_usleep(SWAP_BENCH_WRITEBACK_USEC);
+		}
+	}
+#endif
+	bench->out_secs += stress_time_now() - t;
+	(void)getrusage(RUSAGE_SELF, &r1);
+	stress_swap_vmstat(&v1);
+	bench->out_pages += (double)((v1.pswpout - v0.pswpout) + (v1.zswpout - v0.zswpout));
+	bench->out_zswap += (double)(v1.zswpout - v0.zswpout);
+	bench->out_sys += stress_timeval_to_double(&r1.ru_stime) - stress_timeval_to_double(&r0.ru_stime);
+	stress_swap_compressed(bench);
+
+	/* swap in */
+	if (shim_mincore(ptr, bytes, vec) < 0)
+		(void)memset(vec, 0, npages);
+	stress_swap_vmstat(&v0);
+	(void)getrusage(RUSAGE_SELF, &r0);
+	t = stress_time_now();
+	for (i = 0; i < npages; i++) {
+		uint64_t *p = (uint64_t *)(ptr + (i * page_size));
+		uint64_t val;
+
+		if (vec[i] & 1) {
+			val = *(volatile uint64_t *)p;
+		} else {
+			const uint64_t t_begin = stress_latency_now();
+
+			val = *(volatile uint64_t *)p;
+			stress_latency_add(&bench->latency, stress_latency_now() - t_begin);
+		}
+		if (val != ((uint64_t)(uintptr_t)p ^ pass)) {
+			pr_fail("%s: swapped in page at %p contains 0x%" PRIx64 " and not 0x%" PRIx64 "\n",
+				args->name, (void *)p, val, (uint64_t)(uintptr_t)p ^ pass);
+			rc = EXIT_FAILURE;
+			break;
+		}
+	}
+	bench->in_secs += stress_time_now() - t;
+	(void)getrusage(RUSAGE_SELF, &r1);
+	stress_swap_vmstat(&v1);
+	bench->in_pages += (double)((v1.pswpin - v0.pswpin) + (v1.zswpin - v0.zswpin));
+	bench->in_sys += stress_timeval_to_double(&r1.ru_stime) - stress_timeval_to_double(&r0.ru_stime);
+
+	return rc;
+}
+
+/*
+ *  stress_swap_bench_report()
+ *	report bandwidths, cpu cost per page, compression ratios
+ *	and the swapped out page first touch latency histogram
+ */
+static void stress_swap_bench_report(
+	const stress_args_t *args,
+	const stress_swap_bench_t *bench,
+	const size_t page_size)
+{
+	const stress_latency_t *l = &bench->latency;
+	const double mb = (double)page_size / (double)MB;
+	const double out_rate = (bench->out_secs > 0.0) ? bench->out_pages * mb / bench->out_secs : 0.0;
+	const double in_rate = (bench->in_secs > 0.0) ? bench->in_pages * mb / bench->in_secs : 0.0;
+	const double out_cpu = (bench->out_pages > 0.0) ? STRESS_DBL_MICROSECOND * bench->out_sys / bench->out_pages : 0.0;
+	const double in_cpu = (bench->in_pages > 0.0) ? STRESS_DBL_MICROSECOND * bench->in_sys / bench->in_pages : 0.0;
+	const double zswap_ratio = (bench->zswap_compr > 0.0) ? bench->zswap_orig / bench->zswap_compr : 0.0;
+	const double zram_ratio = (bench->zram_compr > 0.0) ? bench->zram_orig / bench->zram_compr : 0.0;
+	const double p50 = (double)stress_latency_percentile(l, 50.0) / 1000.0;
+	const double p99 = (double)stress_latency_percentile(l, 99.0) / 1000.0;
+	size_t i;
+
+	if (args->instance == 0) {
+		uint64_t hist[12];
+		uint64_t lo = 0;
+
+		pr_lock();
+		pr_inf("%s: swap out %.1f MB/s, %.2f sys us per page, %.1f%% to zswap\n",
+			args->name, out_rate, out_cpu,
+			(bench->out_pages > 0.0) ? 100.0 * bench->out_zswap / bench->out_pages : 0.0);
+		pr_inf("%s: swap in  %.1f MB/s, %.2f sys us per page\n",
+			args->name, in_rate, in_cpu);
+		if (zswap_ratio > 0.0)
+			pr_inf("%s: zswap compression ratio %.2f:1\n", args->name, zswap_ratio);
+		if (zram_ratio > 0.0)
+			pr_inf("%s: zram compression ratio %.2f:1\n", args->name, zram_ratio);
+
+		/* power of 2 microsecond buckets from the log-linear histogram */
+		(void)memset(hist, 0, sizeof(hist));
+		for (i = 0; i < STRESS_LATENCY_BUCKETS; i++) {
+			const uint64_t usec = stress_latency_bucket_max(i) / 1000;
+			size_t b = 0;
+
+			while ((b < SIZEOF_ARRAY(hist) - 1) && (usec >= (1ULL << b)))
+				b++;
+			hist[b] += l->bucket[i];
+		}
+		pr_inf("%s: first touch latency of %" PRIu64 " swapped out pages, "
+			"p50 %.1f us, p99 %.1f us, max %.1f us\n",
+			args->name, l->count, p50, p99, (double)l->max / 1000.0);
+		for (i = 0; i < SIZEOF_ARRAY(hist); i++) {
+			const uint64_t hi = 1ULL << i;
+
+			if (hist[i]) {
+				if (i == SIZEOF_ARRAY(hist) - 1)
+					pr_inf("%s: %6" PRIu64 " us and over %10" PRIu64 " %6.2f%%\n",
+						args->name, lo, hist[i], 100.0 * (double)hist[i] / (double)l->count);
+				else
+					pr_inf("%s: %6" PRIu64 " - %4" PRIu64 " us %10" PRIu64 " %6.2f%%\n",
+						args->name, lo, hi, hist[i], 100.0 * (double)hist[i] / (double)l->count);
+			}
+			lo = hi;
+		}
+		pr_unlock();
+	}
+
+	stress_metrics_set(args, 0, "swap out MB per sec", out_rate);
+	stress_metrics_set(args, 1, "swap in MB per sec", in_rate);
+	stress_metrics_set(args, 2, "swap out sys usec per page", out_cpu);
+	stress_metrics_set(args, 3, "swap in sys usec per page", in_cpu);
+	stress_metrics_set(args, 4, "swapped out page touch p50 usec", p50);
+	stress_metrics_set(args, 5, "swapped out page touch p99 usec", p99);
+	stress_metrics_set(args, 6, "zswap compression ratio", zswap_ratio);
+	stress_metrics_set(args, 7, "zram compression ratio", zram_ratio);
+}
+
+/*
+ *  stress_swap_bench()
+ *	enable a swap file and measure swap out and swap in bandwidth,
+ *	the system cpu cost per page and first touch latencies of a
+ *	working set larger than the cgroup memory.max limit
+ */
+static int stress_swap_bench(const stress_args_t *args)
+{
+	const size_t page_size = args->page_size;
+	char filename[PATH_MAX];
+	stress_swap_bench_t *bench;
+	uint64_t swap_bench_bytes = 0, memory_max = 0, pass = 0;
+	size_t swap_bench_fill = SWAP_BENCH_FILL_MIXED;
+	size_t bytes, npages;
+	uint32_t swap_pages;
+	uint8_t *page, *template, *ptr;
+	unsigned char *vec;
+	bool limited;
+	int fd, ret;
+
+	(void)stress_get_setting("swap-bench-bytes", &swap_bench_bytes);
+	(void)stress_get_setting("swap-bench-fill", &swap_bench_fill);
+
+	limited = (stress_cgroup_memory_max(&memory_max) == 0);
+	if (!swap_bench_bytes)
+		swap_bench_bytes = limited ? memory_max * 2 : DEFAULT_SWAP_BENCH_BYTES;
+#if !defined(MADV_PAGEOUT)
+	if (!limited) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: no cgroup memory.max limit and madvise MADV_PAGEOUT "
+				"is not available, use --cgroup-memory-max, skipping stressor\n",
+				args->name);
+		return EXIT_NO_RESOURCE;
+	}
+#endif
+	npages = (size_t)(swap_bench_bytes / page_size);
+	bytes = npages * page_size;
+	/* room for the working set, the header and pages of other processes */
+	swap_pages = (uint32_t)(npages + (npages / 4) + MAX_SWAP_PAGES);
+
+	bench = (stress_swap_bench_t *)mmap(NULL, sizeof(*bench), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (bench == MAP_FAILED) {
+		pr_inf_skip("%s: cannot allocate benchmark results, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_latency_reset(&bench->latency);
+	page = mmap(NULL, page_size * 2, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (page == MAP_FAILED) {
+		pr_inf_skip("%s: failed to allocate 2 pages: errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		ret = EXIT_NO_RESOURCE;
+		goto tidy_bench;
+	}
+	template = page + page_size;
+	stress_swap_bench_template(template, page_size, swap_bench_fill);
+	vec = calloc(npages, sizeof(*vec));
+	if (!vec) {
+		pr_inf_skip("%s: cannot allocate %zu byte mincore vector, skipping stressor\n",
+			args->name, npages);
+		ret = EXIT_NO_RESOURCE;
+		goto tidy_page;
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		ret = stress_exit_status(-ret);
+		goto tidy_vec;
+	}
+	(void)stress_temp_filename_args(args,
+		filename, sizeof(filename), stress_mwc32());
+	fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		ret = stress_exit_status(errno);
+		pr_fail("%s: open swap file %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto tidy_rm;
+	}
+	if ((stress_swap_zero(args, fd, swap_pages, page) < 0) ||
+	    (stress_swap_set_size(args, fd, swap_pages, SWAP_HDR_SANE) < 0)) {
+		ret = EXIT_NO_RESOURCE;
+		goto tidy_close;
+	}
+	(void)fsync(fd);
+	if (swapon(filename, 0) < 0) {
+		pr_inf_skip("%s: cannot enable swap file on the filesystem, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		ret = EXIT_NO_RESOURCE;
+		goto tidy_close;
+	}
+
+	ptr = (uint8_t *)mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte working set, errno=%d (%s), "
+			"skipping stressor\n", args->name, bytes, errno, strerror(errno));
+		ret = EXIT_NO_RESOURCE;
+		goto tidy_swapoff;
+	}
+	if (args->instance == 0)
+		stress_swap_bench_info(args, bytes, memory_max, limited);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	ret = EXIT_SUCCESS;
+	do {
+		ret = stress_swap_bench_pass(args, ptr, npages, template,
+			vec, limited, pass++, bench);
+		inc_counter(args);
+	} while ((ret == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_swap_bench_report(args, bench, page_size);
+
+	(void)munmap((void *)ptr, bytes);
+tidy_swapoff:
+	if (stress_swapoff(filename) < 0) {
+		pr_fail("%s: swapoff failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		ret = EXIT_FAILURE;
+	}
+tidy_close:
+	(void)close(fd);
+tidy_rm:
+	(void)shim_unlink(filename);
+	(void)stress_temp_dir_rm_args(args);
+tidy_vec:
+	free(vec);
+tidy_page:
+	(void)munmap((void *)page, page_size * 2);
+tidy_bench:
+	(void)munmap((void *)bench, sizeof(*bench));
+
+	return ret;
+}
+
 /*
  *  stress_swap()
  *	stress swap operations
@@ -247,6 +790,11 @@ static int stress_swap(const stress_args_t *args)
 	uint64_t swapped_total = 0;
 	const size_t page_size = args->page_size;
 	double swapped_percent;
+	bool swap_bench = false;
+
+	(void)stress_get_setting("swap-bench", &swap_bench);
+	if (swap_bench)
+		return stress_swap_bench(args);
 
 	page = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
 			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
@@ -435,12 +983,14 @@ stressor_info_t stress_swap_info = {
 	.supported = stress_swap_supported,
 	.class = CLASS_VM | CLASS_OS,
 	.verify = VERIFY_ALWAYS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_swap_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_VM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without sys/swap.h or swap() system call"
 };
@@ -0,0 +1,664 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-clocksource.h"
+#include "core-uring.h"
+#include "io-uring.h"
+
+#if defined(HAVE_SYS_UIO_H)
+#include <sys/uio.h>
+#endif
+
+#include <netinet/in.h>
+
+#define SYSBATCH_OPS		(256)	/* logical ops per measurement */
+#define SYSBATCH_BATCH_MAX	(256)	/* largest batch, SYSBATCH_OPS must be a multiple */
+#define SYSBATCH_BATCHES	(9)	/* batch sizes 1, 2, 4 .. 256 */
+#define SYSBATCH_MSG_SIZE	(64)	/* bytes per read or datagram */
+#define SYSBATCH_FILE_SIZE	(64 * KB)
+#define SYSBATCH_RCVBUF		(4 * MB)
+
+#define SYSBATCH_OP_NOP		(0)
+#define SYSBATCH_OP_READ	(1)
+#define SYSBATCH_OP_STAT	(2)
+#define SYSBATCH_OP_SEND	(3)
+#define SYSBATCH_OP_MAX		(4)
+#define SYSBATCH_OP_ALL		(-1)
+
+#define SYSBATCH_MODE_SYSCALL	(0)	/* one system call per op */
+#define SYSBATCH_MODE_VECTOR	(1)	/* preadv, sendmmsg */
+#define SYSBATCH_MODE_URING	(2)	/* io_uring batches */
+#define SYSBATCH_MODE_MAX	(3)
+
+typedef struct {
+	const char *name;
+	const int op;
+} stress_sysbatch_op_t;
+
+/* time taken for the logical ops of one op, mode and batch size */
+typedef struct {
+	double duration;	/* total time, nanoseconds */
+	uint64_t ops;		/* logical ops timed */
+	bool unsupported;	/* op can't be done this way */
+} stress_sysbatch_result_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"sysbatch N",		"start N workers comparing single, vectored and io_uring batched system calls" },
+	{ NULL,	"sysbatch-op OP",	"logical operation [all|nop|read|stat|send]" },
+	{ NULL,	"sysbatch-ops N",	"stop after N batch measurements" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const stress_sysbatch_op_t sysbatch_ops[] = {
+	{ "all",	SYSBATCH_OP_ALL },
+	{ "nop",	SYSBATCH_OP_NOP },
+	{ "read",	SYSBATCH_OP_READ },
+	{ "stat",	SYSBATCH_OP_STAT },
+	{ "send",	SYSBATCH_OP_SEND },
+};
+
+/*
+ *  stress_set_sysbatch_op()
+ *	set the logical operation to batch
+ */
+static int stress_set_sysbatch_op(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(sysbatch_ops); i++) {
+		if (!strcmp(opt, sysbatch_ops[i].name))
+			return stress_set_setting("sysbatch-op", TYPE_ID_INT, &sysbatch_ops[i].op);
+	}
+	(void)fprintf(stderr, "sysbatch-op must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(sysbatch_ops); i++)
+		(void)fprintf(stderr, " %s", sysbatch_ops[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_sysbatch_op,	stress_set_sysbatch_op },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_SYS_UIO_H)
+
+#if defined(STRESS_URING) &&		\
+    defined(HAVE_IORING_OP_NOP) &&	\
+    defined(HAVE_IORING_OP_READ) &&	\
+    defined(HAVE_IORING_OP_STATX) &&	\
+    defined(HAVE_IORING_OP_SEND)
+#define SYSBATCH_URING
+#endif
+
+static const char * const sysbatch_op_names[] = {
+	"nop",
+	"read",
+	"stat",
+	"send",
+};
+
+static const char * const sysbatch_mode_names[] = {
+	"syscall",
+	"vector",
+	"io_uring",
+};
+
+typedef struct {
+	const stress_args_t *args;
+	char filename[PATH_MAX];	/* file to read and stat */
+	int fd;				/* file to read */
+	int sock_tx;			/* UDP datagram sender */
+	int sock_rx;			/* UDP datagram receiver */
+	uint8_t *buf;			/* SYSBATCH_BATCH_MAX messages */
+	off_t offset;			/* next read offset */
+	struct iovec iov[SYSBATCH_BATCH_MAX];
+#if defined(HAVE_SENDMMSG)
+	struct mmsghdr msgs[SYSBATCH_BATCH_MAX];
+#endif
+	shim_statx_t statxbuf;
+#if defined(SYSBATCH_URING)
+	stress_uring_t ring;
+#endif
+} stress_sysbatch_ctx_t;
+
+/*
+ *  stress_sysbatch_batch()
+ *	batch size of batch index bi
+ */
+static inline unsigned int stress_sysbatch_batch(const size_t bi)
+{
+	return 1U << bi;
+}
+
+/*
+ *  stress_sysbatch_next_offset()
+ *	advance the read offset by n messages, wrapping at the end
+ */
+static inline off_t stress_sysbatch_next_offset(stress_sysbatch_ctx_t *ctx, const size_t n)
+{
+	const off_t offset = ctx->offset;
+
+	ctx->offset += (off_t)(n * SYSBATCH_MSG_SIZE);
+	if (ctx->offset + (off_t)(SYSBATCH_BATCH_MAX * SYSBATCH_MSG_SIZE) > (off_t)SYSBATCH_FILE_SIZE)
+		ctx->offset = 0;
+	return offset;
+}
+
+/*
+ *  stress_sysbatch_drain()
+ *	receive all the queued datagrams
+ */
+static void stress_sysbatch_drain(stress_sysbatch_ctx_t *ctx)
+{
+	char buf[SYSBATCH_MSG_SIZE];
+
+	while (recv(ctx->sock_rx, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		;
+}
+
+/*
+ *  stress_sysbatch_syscall()
+ *	do n logical ops, one system call per op,
+ *	returns 0 or an errno value on failure
+ */
+static int stress_sysbatch_syscall(
+	stress_sysbatch_ctx_t *ctx,
+	const int op,
+	const unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		switch (op) {
+		case SYSBATCH_OP_NOP:
+			(void)getppid();
+			break;
+		case SYSBATCH_OP_READ:
+			if (pread(ctx->fd, ctx->buf, SYSBATCH_MSG_SIZE,
+				  stress_sysbatch_next_offset(ctx, 1)) != SYSBATCH_MSG_SIZE)
+				return errno ? errno : EIO;
+			break;
+		case SYSBATCH_OP_STAT:
+			if (shim_statx(AT_FDCWD, ctx->filename, 0,
+				       SHIM_STATX_BASIC_STATS, &ctx->statxbuf) < 0)
+				return errno;
+			break;
+		case SYSBATCH_OP_SEND:
+			if (send(ctx->sock_tx, ctx->buf, SYSBATCH_MSG_SIZE, 0) != SYSBATCH_MSG_SIZE)
+				return errno ? errno : EIO;
+			break;
+		default:
+			return EINVAL;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_sysbatch_vector()
+ *	do n logical ops with one vectored system call
+ */
+static int stress_sysbatch_vector(
+	stress_sysbatch_ctx_t *ctx,
+	const int op,
+	const unsigned int n)
+{
+	switch (op) {
+#if defined(HAVE_PREADV)
+	case SYSBATCH_OP_READ:
+		if (preadv(ctx->fd, ctx->iov, (int)n,
+			   stress_sysbatch_next_offset(ctx, n)) != (ssize_t)(n * SYSBATCH_MSG_SIZE))
+			return errno ? errno : EIO;
+		return 0;
+#endif
+#if defined(HAVE_SENDMMSG)
+	case SYSBATCH_OP_SEND:
+		if (sendmmsg(ctx->sock_tx, ctx->msgs, n, 0) != (int)n)
+			return errno ? errno : EIO;
+		return 0;
+#endif
+	default:
+		break;
+	}
+	(void)ctx;
+	(void)n;
+
+	return EOPNOTSUPP;
+}
+
+#if defined(SYSBATCH_URING)
+/*
+ *  stress_sysbatch_uring()
+ *	do n logical ops with one io_uring submit and wait
+ */
+static int stress_sysbatch_uring(
+	stress_sysbatch_ctx_t *ctx,
+	const int op,
+	const unsigned int n)
+{
+	stress_uring_t *ring = &ctx->ring;
+	unsigned int i, tail, head, reaped = 0, submitted = 0;
+	int err = 0;
+
+	tail = *ring->sq_tail;
+	for (i = 0; i < n; i++) {
+		const unsigned idx = tail & *ring->sq_mask;
+		struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+		(void)memset(sqe, 0, sizeof(*sqe));
+		switch (op) {
+		case SYSBATCH_OP_NOP:
+			sqe->opcode = IORING_OP_NOP;
+			break;
+		case SYSBATCH_OP_READ:
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = ctx->fd;
+			sqe->addr = (uintptr_t)(ctx->buf + (i * SYSBATCH_MSG_SIZE));
+			sqe->len = SYSBATCH_MSG_SIZE;
+			sqe->off = (uint64_t)stress_sysbatch_next_offset(ctx, 1);
+			break;
+		case SYSBATCH_OP_STAT:
+			sqe->opcode = IORING_OP_STATX;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = (uintptr_t)ctx->filename;
+			sqe->len = SHIM_STATX_BASIC_STATS;
+			sqe->off = (uintptr_t)&ctx->statxbuf;
+			break;
+		case SYSBATCH_OP_SEND:
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = ctx->sock_tx;
+			sqe->addr = (uintptr_t)(ctx->buf + (i * SYSBATCH_MSG_SIZE));
+			sqe->len = SYSBATCH_MSG_SIZE;
+			break;
+		default:
+			return EINVAL;
+		}
+		sqe->user_data = (uint64_t)i;
+		ring->sq_array[idx] = idx;
+		tail++;
+	}
+	shim_mb();
+	*ring->sq_tail = tail;
+	shim_mb();
+
+	while (reaped < n) {
+		const int ret = stress_uring_enter(ring, n - submitted, n - reaped);
+
+		if (ret < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+				continue;
+			return errno;
+		}
+		submitted += (unsigned int)ret;
+
+		head = *ring->cq_head;
+		for (;;) {
+			const struct io_uring_cqe *cqe;
+
+			shim_mb();
+			if (head == *ring->cq_tail)
+				break;
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			if ((cqe->res < 0) && !err)
+				err = -cqe->res;
+			else if ((op != SYSBATCH_OP_NOP) && (op != SYSBATCH_OP_STAT) &&
+				 (cqe->res != SYSBATCH_MSG_SIZE) && !err)
+				err = EIO;
+			head++;
+			reaped++;
+		}
+		*ring->cq_head = head;
+		shim_mb();
+	}
+	return err;
+}
+#endif
+
+/*
+ *  stress_sysbatch_measure()
+ *	time SYSBATCH_OPS logical ops done in batches of the
+ *	batch size of batch index bi using the given mode
+ */
+static int stress_sysbatch_measure(
+	stress_sysbatch_ctx_t *ctx,
+	const int op,
+	const int mode,
+	const size_t bi,
+	stress_sysbatch_result_t *result)
+{
+	const unsigned int batch = stress_sysbatch_batch(bi);
+	unsigned int i;
+	uint64_t t1, t2;
+	int err = 0;
+
+	t1 = stress_clocksource_ns();
+	for (i = 0; (i < SYSBATCH_OPS) && !err; i += batch) {
+		switch (mode) {
+		case SYSBATCH_MODE_SYSCALL:
+			err = stress_sysbatch_syscall(ctx, op, batch);
+			break;
+		case SYSBATCH_MODE_VECTOR:
+			err = stress_sysbatch_vector(ctx, op, batch);
+			break;
+#if defined(SYSBATCH_URING)
+		case SYSBATCH_MODE_URING:
+			err = stress_sysbatch_uring(ctx, op, batch);
+			break;
+#endif
+		default:
+			err = EOPNOTSUPP;
+			break;
+		}
+	}
+	t2 = stress_clocksource_ns();
+
+	if (op == SYSBATCH_OP_SEND)
+		stress_sysbatch_drain(ctx);
+	if (err)
+		return err;
+
+	result->duration += (double)(t2 - t1);
+	result->ops += SYSBATCH_OPS;
+	return 0;
+}
+
+/*
+ *  stress_sysbatch_probe()
+ *	try each op, mode and batch size once and mark the
+ *	ones that are not supported
+ */
+static void stress_sysbatch_probe(
+	stress_sysbatch_ctx_t *ctx,
+	stress_sysbatch_result_t results[SYSBATCH_OP_MAX][SYSBATCH_MODE_MAX][SYSBATCH_BATCHES])
+{
+	int op, mode;
+	size_t bi;
+
+	for (op = 0; op < SYSBATCH_OP_MAX; op++) {
+		for (mode = 0; mode < SYSBATCH_MODE_MAX; mode++) {
+			for (bi = 0; bi < SYSBATCH_BATCHES; bi++) {
+				stress_sysbatch_result_t *result = &results[op][mode][bi];
+				stress_sysbatch_result_t probe;
+				int err;
+
+				/* single system calls are batch size 1, vectors 2 or more */
+				if (((mode == SYSBATCH_MODE_SYSCALL) && (bi > 0)) ||
+				    ((mode == SYSBATCH_MODE_VECTOR) && (bi == 0))) {
+					result->unsupported = true;
+					continue;
+				}
+				if ((op == SYSBATCH_OP_SEND) && (ctx->sock_tx < 0)) {
+					result->unsupported = true;
+					continue;
+				}
+#if defined(SYSBATCH_URING)
+				if ((mode == SYSBATCH_MODE_URING) && (ctx->ring.fd < 0)) {
+#else
+				if (mode == SYSBATCH_MODE_URING) {
+#endif
+					result->unsupported = true;
+					continue;
+				}
+				(void)memset(&probe, 0, sizeof(probe));
+				err = stress_sysbatch_measure(ctx, op, mode, bi, &probe);
+				if (err) {
+					if (err != EOPNOTSUPP)
+						pr_dbg("%s: %s %s batch %u failed, errno=%d (%s), skipping it\n",
+							ctx->args->name, sysbatch_op_names[op],
+							sysbatch_mode_names[mode], stress_sysbatch_batch(bi),
+							err, strerror(err));
+					result->unsupported = true;
+				}
+			}
+		}
+	}
+}
+
+/*
+ *  stress_sysbatch_report()
+ *	report the nanoseconds per logical op of each op,
+ *	mode and batch size as metrics
+ */
+static void stress_sysbatch_report(
+	const stress_args_t *args,
+	stress_sysbatch_result_t results[SYSBATCH_OP_MAX][SYSBATCH_MODE_MAX][SYSBATCH_BATCHES])
+{
+	static const char * const vector_names[] = { "-", "preadv", "-", "sendmmsg" };
+	int op, mode;
+	size_t bi, idx = 0;
+
+	for (op = 0; op < SYSBATCH_OP_MAX; op++) {
+		for (mode = 0; mode < SYSBATCH_MODE_MAX; mode++) {
+			for (bi = 0; bi < SYSBATCH_BATCHES; bi++) {
+				const stress_sysbatch_result_t *result = &results[op][mode][bi];
+				char str[64];
+
+				if (result->unsupported || !result->ops)
+					continue;
+				if (mode == SYSBATCH_MODE_SYSCALL) {
+					(void)snprintf(str, sizeof(str), "nanosecs per %s (syscall)",
+						sysbatch_op_names[op]);
+				} else {
+					(void)snprintf(str, sizeof(str), "nanosecs per %s (%s batch %u)",
+						sysbatch_op_names[op],
+						(mode == SYSBATCH_MODE_VECTOR) ? vector_names[op] : "io_uring",
+						stress_sysbatch_batch(bi));
+				}
+				stress_metrics_set(args, idx++, str, result->duration / (double)result->ops);
+			}
+		}
+	}
+}
+
+/*
+ *  stress_sysbatch_socket()
+ *	create a connected pair of UDP loopback sockets,
+ *	returns -1 if they can't be created
+ */
+static int stress_sysbatch_socket(stress_sysbatch_ctx_t *ctx)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int rcvbuf = SYSBATCH_RCVBUF;
+
+	ctx->sock_rx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (ctx->sock_rx < 0)
+		return -1;
+	(void)setsockopt(ctx->sock_rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if ((bind(ctx->sock_rx, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+	    (getsockname(ctx->sock_rx, (struct sockaddr *)&addr, &len) < 0))
+		goto err_rx;
+	ctx->sock_tx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (ctx->sock_tx < 0)
+		goto err_rx;
+	if (connect(ctx->sock_tx, (struct sockaddr *)&addr, len) < 0)
+		goto err_tx;
+	return 0;
+
+err_tx:
+	(void)close(ctx->sock_tx);
+	ctx->sock_tx = -1;
+err_rx:
+	(void)close(ctx->sock_rx);
+	ctx->sock_rx = -1;
+	return -1;
+}
+
+/*
+ *  stress_sysbatch
+ *	stress the cost of single, vectored and io_uring
+ *	batched system calls doing the same logical ops
+ */
+static int stress_sysbatch(const stress_args_t *args)
+{
+	static stress_sysbatch_result_t results[SYSBATCH_OP_MAX][SYSBATCH_MODE_MAX][SYSBATCH_BATCHES];
+	stress_sysbatch_ctx_t *ctx;
+	int sysbatch_op = SYSBATCH_OP_ALL;
+	int ret, rc = EXIT_SUCCESS, op, mode;
+	size_t i, bi;
+	bool any = false;
+
+	(void)stress_get_setting("sysbatch-op", &sysbatch_op);
+
+	ctx = (stress_sysbatch_ctx_t *)calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		pr_inf_skip("%s: cannot allocate context, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	ctx->args = args;
+	ctx->fd = -1;
+	ctx->sock_tx = -1;
+	ctx->sock_rx = -1;
+#if defined(SYSBATCH_URING)
+	ctx->ring.fd = -1;
+#endif
+
+	ctx->buf = (uint8_t *)mmap(NULL, SYSBATCH_FILE_SIZE, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ctx->buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte buffer, skipping stressor\n",
+			args->name, (size_t)SYSBATCH_FILE_SIZE);
+		free(ctx);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_uint8rnd4(ctx->buf, SYSBATCH_FILE_SIZE);
+	for (i = 0; i < SYSBATCH_BATCH_MAX; i++) {
+		ctx->iov[i].iov_base = (void *)(ctx->buf + (i * SYSBATCH_MSG_SIZE));
+		ctx->iov[i].iov_len = SYSBATCH_MSG_SIZE;
+#if defined(HAVE_SENDMMSG)
+		ctx->msgs[i].msg_hdr.msg_iov = &ctx->iov[i];
+		ctx->msgs[i].msg_hdr.msg_iovlen = 1;
+#endif
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto free_buf;
+	}
+	(void)stress_temp_filename_args(args, ctx->filename, sizeof(ctx->filename), stress_mwc32());
+	ctx->fd = open(ctx->filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (ctx->fd < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, ctx->filename, errno, strerror(errno));
+		goto rm_dir;
+	}
+	if (write(ctx->fd, ctx->buf, SYSBATCH_FILE_SIZE) != (ssize_t)SYSBATCH_FILE_SIZE) {
+		pr_inf_skip("%s: cannot write %zu byte file, skipping stressor\n",
+			args->name, (size_t)SYSBATCH_FILE_SIZE);
+		rc = EXIT_NO_RESOURCE;
+		goto close_fd;
+	}
+
+	if (stress_sysbatch_socket(ctx) < 0)
+		pr_dbg("%s: cannot create UDP loopback sockets, skipping send\n", args->name);
+#if defined(SYSBATCH_URING)
+	if (stress_uring_setup(args, &ctx->ring, SYSBATCH_BATCH_MAX) != EXIT_SUCCESS)
+		ctx->ring.fd = -1;
+#endif
+
+	(void)memset(results, 0, sizeof(results));
+	stress_sysbatch_probe(ctx, results);
+	for (op = 0; op < SYSBATCH_OP_MAX; op++) {
+		if ((sysbatch_op != SYSBATCH_OP_ALL) && (sysbatch_op != op))
+			continue;
+		for (mode = 0; mode < SYSBATCH_MODE_MAX; mode++) {
+			for (bi = 0; bi < SYSBATCH_BATCHES; bi++)
+				any |= !results[op][mode][bi].unsupported;
+		}
+	}
+	if (!any) {
+		pr_inf_skip("%s: no supported system call batching methods, skipping stressor\n",
+			args->name);
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto close_all;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (op = 0; op < SYSBATCH_OP_MAX; op++) {
+			if ((sysbatch_op != SYSBATCH_OP_ALL) && (sysbatch_op != op))
+				continue;
+			for (mode = 0; mode < SYSBATCH_MODE_MAX; mode++) {
+				for (bi = 0; bi < SYSBATCH_BATCHES; bi++) {
+					stress_sysbatch_result_t *result = &results[op][mode][bi];
+
+					if (result->unsupported)
+						continue;
+					ret = stress_sysbatch_measure(ctx, op, mode, bi, result);
+					if (ret) {
+						pr_fail("%s: %s %s batch %u failed, errno=%d (%s)\n",
+							args->name, sysbatch_op_names[op],
+							sysbatch_mode_names[mode],
+							stress_sysbatch_batch(bi), ret, strerror(ret));
+						rc = EXIT_FAILURE;
+						goto report;
+					}
+					inc_counter(args);
+				}
+			}
+		}
+	} while (keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_sysbatch_report(args, results);
+
+close_all:
+#if defined(SYSBATCH_URING)
+	if (ctx->ring.fd >= 0)
+		stress_uring_close(&ctx->ring);
+#endif
+	if (ctx->sock_tx >= 0)
+		(void)close(ctx->sock_tx);
+	if (ctx->sock_rx >= 0)
+		(void)close(ctx->sock_rx);
+close_fd:
+	(void)close(ctx->fd);
+	(void)shim_unlink(ctx->filename);
+rm_dir:
+	(void)stress_temp_dir_rm_args(args);
+free_buf:
+	(void)munmap((void *)ctx->buf, SYSBATCH_FILE_SIZE);
+	free(ctx);
+
+	return rc;
+}
+
+stressor_info_t stress_sysbatch_info = {
+	.stressor = stress_sysbatch,
+	.class = CLASS_OS | CLASS_IO,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_sysbatch_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_OS | CLASS_IO,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without sys/uio.h support"
+};
+#endif
@@ -18,7 +18,9 @@
  */
 #include "stress-ng.h"
 #include "core-arch.h"
+#include "core-clocksource.h"
 #include "core-io-priority.h"
+#include "core-latency.h"
 
 #define SYSCALL_METHOD_ALL	(0)
 #define SYSCALL_METHOD_FAST10	(1)
@@ -493,32 +495,22 @@ static void syscall_shared_error(const int ret)
 }
 
 /*
- *  syscall_shared_error()
- *	get nanosecond time delta since the first call
- *	this allows 18446744073 days of run time, or ~584 years
- *	of run time before overflow occurs.
+ *  syscall_time_now()
+ *	get monotonic time in nanoseconds, this uses the cycle
+ *	counter when it is usable to keep the timing overhead low
+ *	and is comparable between the parent and child processes
  */
 static uint64_t syscall_time_now(void)
 {
-	static struct timespec base_ts = { 0, 0 };
-	struct timespec ts;
-	uint64_t sec, ns;
-
 	syscall_errno = errno;
-	if (UNLIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) < 0))
-		return 0.0;
-	if (base_ts.tv_sec == 0)
-		base_ts = ts;	/* first call, save the baseline time */
-
-	/* now return time delta since baseline time */
-	ns = ts.tv_nsec - base_ts.tv_nsec;
-	sec = (ts.tv_sec - base_ts.tv_sec) * 1000000000;
-	return sec + ns;
+	return stress_clocksource_ns();
 }
 
 static const stress_help_t help[] = {
 	{ NULL,	"syscall N",		"start N workers that exercise a wide range of system calls" },
 	{ NULL,	"syscall-ops N",	"stop after N syscall bogo operations" },
+	{ NULL,	"syscall-baseline F",	"compare per-syscall median latencies with table file F" },
+	{ NULL,	"syscall-table F",	"write per-syscall latency table to YAML file F" },
 	{ NULL,	NULL,		NULL }
 };
 
@@ -558,6 +550,24 @@ static int stress_set_syscall_method(const char *opt)
 	return -1;
 }
 
+/*
+ *  stress_set_syscall_baseline()
+ *	set the per-syscall latency table file to compare against
+ */
+static int stress_set_syscall_baseline(const char *opt)
+{
+	return stress_set_setting("syscall-baseline", TYPE_ID_STR, opt);
+}
+
+/*
+ *  stress_set_syscall_table()
+ *	set the file to write the per-syscall latency table to
+ */
+static int stress_set_syscall_table(const char *opt)
+{
+	return stress_set_setting("syscall-table", TYPE_ID_STR, opt);
+}
+
 #if defined(HAVE_SYS_UN_H) &&	\
     defined(AF_UNIX)
 
@@ -8208,6 +8218,7 @@ static const syscall_t syscalls[] = {
 
 static syscall_stats_t syscall_stats[STRESS_SYSCALLS_MAX];	/* stats */
 static size_t stress_syscall_index[STRESS_SYSCALLS_MAX];	/* shuffle index */
+static stress_latency_t *syscall_latency = MAP_FAILED;		/* per-syscall histograms */
 
 /*
  *  stress_syscall_reset_index()
@@ -8496,11 +8507,185 @@ static void stress_syscall_benchmark_calls(const stress_args_t *args)
 			ss->total_duration += (double)d;
 			ss->succeed = true;
 			ss->count++;
+			if (syscall_latency != MAP_FAILED)
+				stress_latency_add(&syscall_latency[j], d);
 		}
 		inc_counter(args);
 	}
 }
 
+#define SYSCALL_REGRESS_PERCENT	(10.0)	/* baseline median slow down threshold */
+
+/*
+ *  stress_syscall_baseline_load()
+ *	load the median latencies from a per-syscall latency table
+ *	previously written by --syscall-table, medians of syscalls
+ *	not found in the table are left as zero
+ */
+static int stress_syscall_baseline_load(
+	const stress_args_t *args,
+	const char *filename,
+	uint64_t *baseline)
+{
+	FILE *fp;
+	char buf[256];
+	size_t i, idx = STRESS_SYSCALLS_MAX, loaded = 0;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		pr_inf("%s: cannot open syscall baseline file '%s', errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), fp)) {
+		char name[64];
+		uint64_t median;
+
+		if (sscanf(buf, " - syscall: %63s", name) == 1) {
+			idx = STRESS_SYSCALLS_MAX;
+			for (i = 0; i < STRESS_SYSCALLS_MAX; i++) {
+				if (!strcmp(syscalls[i].name, name)) {
+					idx = i;
+					break;
+				}
+			}
+		} else if ((sscanf(buf, " median-ns: %" SCNu64, &median) == 1) &&
+			   (idx < STRESS_SYSCALLS_MAX)) {
+			baseline[idx] = median;
+			idx = STRESS_SYSCALLS_MAX;
+			loaded++;
+		}
+	}
+	(void)fclose(fp);
+
+	if (!loaded) {
+		pr_inf("%s: no syscall latencies found in baseline file '%s'\n",
+			args->name, filename);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_syscall_latency_report()
+ *	export the per-syscall min/median/p99 latencies as metrics,
+ *	optionally as a YAML table file and compare the medians
+ *	against a previously saved table
+ */
+static void stress_syscall_latency_report(const stress_args_t *args)
+{
+	const char *table_file = NULL, *baseline_file = NULL;
+	uint64_t *baseline = NULL;
+	FILE *fp = NULL;
+	size_t i, timed = 0, compared = 0, regressed = 0;
+	double log_median = 0.0, log_p99 = 0.0, log_ratio = 0.0;
+	size_t idx = 0;
+
+	if (syscall_latency == MAP_FAILED)
+		return;
+
+	(void)stress_get_setting("syscall-table", &table_file);
+	(void)stress_get_setting("syscall-baseline", &baseline_file);
+
+	if (baseline_file) {
+		baseline = (uint64_t *)calloc(STRESS_SYSCALLS_MAX, sizeof(*baseline));
+		if (baseline &&
+		    (stress_syscall_baseline_load(args, baseline_file, baseline) < 0)) {
+			free(baseline);
+			baseline = NULL;
+		}
+	}
+
+	if (table_file && (args->instance == 0)) {
+		fp = fopen(table_file, "w");
+		if (fp) {
+#if defined(HAVE_SYSCALL_UNAME)
+			struct utsname uts;
+#endif
+
+			(void)fprintf(fp, "---\n");
+#if defined(HAVE_SYSCALL_UNAME)
+			if (uname(&uts) == 0)
+				(void)fprintf(fp, "kernel-release: %s\n", uts.release);
+#endif
+			(void)fprintf(fp, "syscall-latency:\n");
+		} else {
+			pr_inf("%s: cannot create syscall table file '%s', errno=%d (%s)\n",
+				args->name, table_file, errno, strerror(errno));
+		}
+	}
+
+	if (baseline && (args->instance == 0)) {
+		pr_lock();
+		pr_inf("%s: system calls more than %.0f%% slower than baseline '%s':\n",
+			args->name, SYSCALL_REGRESS_PERCENT, baseline_file);
+		pr_inf("%s: %25s %12s %12s %8s\n", args->name,
+			"System Call", "Median (ns)", "Base (ns)", "Change");
+	}
+
+	for (i = 0; i < STRESS_SYSCALLS_MAX; i++) {
+		const stress_latency_t *latency = &syscall_latency[i];
+		uint64_t median, p99;
+
+		if (!latency->count)
+			continue;
+
+		median = stress_latency_percentile(latency, 50.0);
+		p99 = stress_latency_percentile(latency, 99.0);
+		timed++;
+		log_median += log((double)STRESS_MAXIMUM(median, 1));
+		log_p99 += log((double)STRESS_MAXIMUM(p99, 1));
+
+		if (fp) {
+			(void)fprintf(fp, "  - syscall: %s\n", syscalls[i].name);
+			(void)fprintf(fp, "    calls: %" PRIu64 "\n", latency->count);
+			(void)fprintf(fp, "    min-ns: %" PRIu64 "\n", latency->min);
+			(void)fprintf(fp, "    median-ns: %" PRIu64 "\n", median);
+			(void)fprintf(fp, "    p99-ns: %" PRIu64 "\n", p99);
+			if (baseline && baseline[i])
+				(void)fprintf(fp, "    baseline-median-ns: %" PRIu64 "\n", baseline[i]);
+		}
+
+		if (baseline && baseline[i]) {
+			const double ratio = (double)STRESS_MAXIMUM(median, 1) / (double)baseline[i];
+
+			compared++;
+			log_ratio += log(ratio);
+			if (ratio > 1.0 + (SYSCALL_REGRESS_PERCENT / 100.0)) {
+				regressed++;
+				if (args->instance == 0) {
+					pr_inf("%s: %25s %12" PRIu64 " %12" PRIu64 " %+7.1f%%\n",
+						args->name, syscalls[i].name, median,
+						baseline[i], (ratio - 1.0) * 100.0);
+				}
+			}
+		}
+	}
+
+	if (baseline && (args->instance == 0)) {
+		if (!regressed)
+			pr_inf("%s: %25s\n", args->name, "none");
+		pr_unlock();
+	}
+	if (fp)
+		(void)fclose(fp);
+
+	if (timed) {
+		stress_metrics_set(args, idx++, "syscalls timed", (double)timed);
+		stress_metrics_set(args, idx++, "geomean median syscall latency (ns)",
+			exp(log_median / (double)timed));
+		stress_metrics_set(args, idx++, "geomean p99 syscall latency (ns)",
+			exp(log_p99 / (double)timed));
+	}
+	if (compared) {
+		stress_metrics_set(args, idx++, "geomean median latency vs baseline (%)",
+			exp(log_ratio / (double)compared) * 100.0);
+		stress_metrics_set(args, idx++, "syscalls regressed vs baseline",
+			(double)regressed);
+	}
+	free(baseline);
+}
+
 /*
  *  stress_syscall
  *	stress system calls
@@ -8604,6 +8789,15 @@ static int stress_syscall(const stress_args_t *args)
 		ss->ignore = false;
 	}
 
+	syscall_latency = (stress_latency_t *)mmap(NULL,
+				sizeof(*syscall_latency) * STRESS_SYSCALLS_MAX,
+				PROT_READ | PROT_WRITE,
+				MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (syscall_latency != MAP_FAILED) {
+		for (i = 0; i < STRESS_SYSCALLS_MAX; i++)
+			stress_latency_reset(&syscall_latency[i]);
+	}
+
 	syscall_brk_addr = shim_sbrk(0);
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
@@ -8643,10 +8837,13 @@ static int stress_syscall(const stress_args_t *args)
 			(double)exercised * 100.0 / (double)STRESS_SYSCALLS_MAX);
 		stress_syscall_report_syscall_top10(args);
 	}
+	stress_syscall_latency_report(args);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 	rc = EXIT_SUCCESS;
 
+	if (syscall_latency != MAP_FAILED)
+		(void)munmap((void *)syscall_latency, sizeof(*syscall_latency) * STRESS_SYSCALLS_MAX);
 	if (syscall_mmap_page != MAP_FAILED)
 		(void)munmap(syscall_mmap_page, syscall_page_size);
 	(void)close(syscall_fd);
@@ -8670,7 +8867,9 @@ err_close_dir_fd:
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_syscall_baseline,	stress_set_syscall_baseline },
 	{ OPT_syscall_method, 	stress_set_syscall_method },
+	{ OPT_syscall_table,	stress_set_syscall_table },
 	{ 0,			NULL },
 };
 
@@ -19,6 +19,9 @@
  */
 #include "stress-ng.h"
 #include "core-capabilities.h"
+#include "core-latency.h"
+#include "core-uring.h"
+#include "io-uring.h"
 
 #if defined(HAVE_SYS_TIMERFD_H)
 #include <sys/timerfd.h>
@@ -32,10 +35,24 @@ UNEXPECTED
 UNEXPECTED
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H)
+#include <sys/epoll.h>
+#endif
+
 #define MIN_TIMERFD_FREQ	(1)
 #define MAX_TIMERFD_FREQ	(100000000)
 #define DEFAULT_TIMERFD_FREQ	(1000000)
 
+#define MIN_TIMERFD_SCALE	(1024)
+#define MAX_TIMERFD_SCALE	(4 * 1024 * 1024)
+#define DEFAULT_TIMERFD_SCALE_FREQ (1)	/* Hz per timer in scale mode */
+
+#define TIMERFD_SCALE_SLICE	(2.0)	/* seconds per wait method */
+#define TIMERFD_SCALE_EVENTS	(1024)	/* epoll events reaped per wait */
+#define TIMERFD_SCALE_URING_ENTRIES (4096) /* io_uring sq entries */
+#define TIMERFD_SCALE_FD_SLACK	(64)	/* fds kept free for other uses */
+#define TIMERFD_SCALE_START_NS	(100000000ULL)	/* delay before the first expiry */
+
 #if !defined(TFD_IOC_SET_TICKS) &&	\
     defined(_IOW) &&			\
     defined(__linux__)
@@ -48,6 +65,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"timerfd-freq F", "run timer(s) at F Hz, range 1 to 1000000000" },
 	{ NULL,	"timerfd-ops N",  "stop after N timerfd bogo events" },
 	{ NULL,	"timerfd-rand",	  "enable random timerfd frequency" },
+	{ NULL,	"timerfd-scale N", "arm N timers with spread expiries and measure wakeup latency" },
 	{ NULL,	NULL,		  NULL }
 };
 
@@ -95,10 +113,25 @@ static int stress_set_timerfd_rand(const char *opt)
 	return stress_set_setting_true("timerfd-rand", opt);
 }
 
+/*
+ *  stress_set_timerfd_scale()
+ *	set number of timers to arm in the timer scalability mode
+ */
+static int stress_set_timerfd_scale(const char *opt)
+{
+	uint32_t timerfd_scale;
+
+	timerfd_scale = stress_get_uint32(opt);
+	stress_check_range("timerfd-scale", (uint64_t)timerfd_scale,
+		MIN_TIMERFD_SCALE, MAX_TIMERFD_SCALE);
+	return stress_set_setting("timerfd-scale", TYPE_ID_UINT32, &timerfd_scale);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_timerfd_fds,	stress_set_timerfd_fds },
 	{ OPT_timerfd_freq,	stress_set_timerfd_freq },
 	{ OPT_timerfd_rand,	stress_set_timerfd_rand },
+	{ OPT_timerfd_scale,	stress_set_timerfd_scale },
 	{ 0,			NULL }
 };
 
@@ -108,6 +141,46 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
     defined(HAVE_TIMERFD_SETTIME) &&	\
     (defined(USE_SELECT) || defined(USE_POLL))
 
+#if defined(HAVE_SYS_EPOLL_H) &&	\
+    defined(HAVE_EPOLL_CREATE1) &&	\
+    defined(CLOCK_MONOTONIC) &&		\
+    defined(TFD_NONBLOCK) &&		\
+    defined(TFD_TIMER_ABSTIME)
+#define STRESS_TIMERFD_SCALE
+#endif
+
+#if defined(STRESS_TIMERFD_SCALE) &&	\
+    defined(STRESS_URING) &&		\
+    defined(HAVE_IORING_OP_POLL_ADD) &&	\
+    defined(IORING_POLL_ADD_MULTI) &&	\
+    defined(IORING_CQE_F_MORE) &&	\
+    defined(HAVE_POLL_H)
+#define STRESS_TIMERFD_SCALE_URING
+#endif
+
+#if defined(STRESS_TIMERFD_SCALE)
+/* timers of the scalability mode, timer i first expires at
+   base_ns + i * period_ns / n and then every period_ns */
+typedef struct {
+	int *fds;		/* timer file descriptors */
+	uint32_t n;		/* timers the expiries are spread over */
+	uint32_t created;	/* timers created, fds[0..created - 1] */
+	uint64_t period_ns;	/* timer period */
+	uint64_t base_ns;	/* CLOCK_MONOTONIC first expiry of timer 0 */
+} stress_timerfd_scale_timers_t;
+
+/* accumulated results of a wait method */
+typedef struct {
+	const char *name;	/* wait method */
+	int err;		/* errno if the method cannot be used */
+	uint64_t events;	/* timer reads */
+	uint64_t expiries;	/* expiries read, more than events on overruns */
+	double secs;		/* seconds waiting and reading */
+	double cpu_secs;	/* user and system CPU seconds */
+	stress_latency_t latency; /* expiry to wakeup latencies */
+} stress_timerfd_scale_t;
+#endif
+
 static double rate_ns;
 
 /*
@@ -139,6 +212,420 @@ static void stress_timerfd_set(
 	timer->it_interval.tv_nsec = timer->it_value.tv_nsec;
 }
 
+#if defined(STRESS_TIMERFD_SCALE)
+/*
+ *  stress_timerfd_scale_now()
+ *	CLOCK_MONOTONIC time in nanoseconds, the clock the timers use
+ */
+static inline uint64_t stress_timerfd_scale_now(void)
+{
+	struct timespec ts;
+
+	if (UNLIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) < 0))
+		return 0;
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_timerfd_scale_cpu()
+ *	user and system CPU time of the process in seconds
+ */
+static double stress_timerfd_scale_cpu(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return stress_timeval_to_double(&usage.ru_utime) +
+	       stress_timeval_to_double(&usage.ru_stime);
+}
+
+/*
+ *  stress_timerfd_scale_read()
+ *	read the expiries of timer i and add the latency from the
+ *	earliest unread expiry in this slice to the read, expiries
+ *	that were due before the slice started are not counted
+ */
+static inline void OPTIMIZE3 stress_timerfd_scale_read(
+	const stress_timerfd_scale_timers_t *timers,
+	const uint32_t i,
+	const uint64_t since,
+	stress_timerfd_scale_t *result)
+{
+	const uint64_t period = timers->period_ns;
+	const uint64_t first = timers->base_ns + (((uint64_t)i * period) / timers->n);
+	uint64_t expval, now, last, due;
+
+	if (UNLIKELY(read(timers->fds[i], &expval, sizeof(expval)) != (ssize_t)sizeof(expval)))
+		return;
+	now = stress_timerfd_scale_now();
+	result->events++;
+	result->expiries += expval;
+	if (UNLIKELY((now < first) || (expval == 0)))
+		return;
+	last = first + (((now - first) / period) * period);
+	if (last < since)
+		return;
+	due = ((expval - 1) <= ((last - first) / period)) ?
+		last - ((expval - 1) * period) : first;
+	if (due < since)
+		due = (since <= first) ? first :
+			first + (((since - first + period - 1) / period) * period);
+	stress_latency_add(&result->latency, now - due);
+}
+
+/*
+ *  stress_timerfd_scale_epoll()
+ *	wait for the timers with epoll_wait for secs seconds
+ */
+static void stress_timerfd_scale_epoll(
+	const stress_args_t *args,
+	const stress_timerfd_scale_timers_t *timers,
+	const int efd,
+	const double secs,
+	stress_timerfd_scale_t *result)
+{
+	static struct epoll_event events[TIMERFD_SCALE_EVENTS];
+	const uint64_t since = stress_timerfd_scale_now();
+	const double t_start = stress_time_now(), cpu_start = stress_timerfd_scale_cpu();
+	const uint64_t events_start = result->events;
+	double t_now = t_start;
+
+	while (keep_stressing(args) && (t_now < t_start + secs)) {
+		const int n = epoll_wait(efd, events, TIMERFD_SCALE_EVENTS, 100);
+		int j;
+
+		if (UNLIKELY(n < 0)) {
+			if (errno == EINTR)
+				continue;
+			result->err = errno;
+			break;
+		}
+		for (j = 0; j < n; j++)
+			stress_timerfd_scale_read(timers, events[j].data.u32, since, result);
+		t_now = stress_time_now();
+	}
+	result->secs += t_now - t_start;
+	result->cpu_secs += stress_timerfd_scale_cpu() - cpu_start;
+	add_counter(args, result->events - events_start);
+}
+
+#if defined(STRESS_TIMERFD_SCALE_URING)
+/*
+ *  stress_timerfd_scale_poll_add()
+ *	queue a multishot poll of timer i on the io_uring
+ */
+static inline void stress_timerfd_scale_poll_add(
+	stress_uring_t *ring,
+	const stress_timerfd_scale_timers_t *timers,
+	const uint32_t i)
+{
+	const unsigned tail = *ring->sq_tail;
+	const unsigned idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+	(void)memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = timers->fds[i];
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = (uint64_t)i;
+	ring->sq_array[idx] = idx;
+	shim_mb();
+	*ring->sq_tail = tail + 1;
+	shim_mb();
+}
+
+/*
+ *  stress_timerfd_scale_uring()
+ *	wait for the timers with multishot io_uring polls for secs seconds,
+ *	the polls are armed a ring full at a time and the ring is closed at
+ *	the end of the slice, cancelling them
+ */
+static void stress_timerfd_scale_uring(
+	const stress_args_t *args,
+	const stress_timerfd_scale_timers_t *timers,
+	const double secs,
+	stress_timerfd_scale_t *result)
+{
+	stress_uring_t ring;
+	uint64_t since;
+	const uint64_t events_start = result->events;
+	double t_start, t_now, cpu_start;
+	uint32_t armed = 0;
+	unsigned queued = 0;
+
+	if (stress_uring_setup(args, &ring, TIMERFD_SCALE_URING_ENTRIES) != EXIT_SUCCESS) {
+		result->err = ENOSYS;
+		return;
+	}
+	since = stress_timerfd_scale_now();
+	t_start = stress_time_now();
+	t_now = t_start;
+	cpu_start = stress_timerfd_scale_cpu();
+
+	while (keep_stressing(args) && (t_now < t_start + secs)) {
+		unsigned head, tail;
+		int ret;
+
+		/* arm the next batch of timers while there is room */
+		while ((armed < timers->created) && (queued < TIMERFD_SCALE_URING_ENTRIES)) {
+			stress_timerfd_scale_poll_add(&ring, timers, armed++);
+			queued++;
+		}
+		ret = stress_uring_enter(&ring, queued, armed < timers->created ? 0 : 1);
+		if (UNLIKELY(ret < 0)) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+				goto next;
+			result->err = errno;
+			break;
+		}
+		queued -= (unsigned)ret;
+
+		head = *ring.cq_head;
+		tail = *ring.cq_tail;
+		shim_mb();
+		/* re-arming needs sq room, leave later completions for the next pass */
+		while ((head != tail) && (queued < TIMERFD_SCALE_URING_ENTRIES)) {
+			const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+			const uint32_t i = (uint32_t)cqe->user_data;
+
+			if (UNLIKELY(cqe->res < 0)) {
+				/* e.g. no multishot poll support */
+				if (cqe->res != -ECANCELED)
+					result->err = -cqe->res;
+				head++;
+				continue;
+			}
+			stress_timerfd_scale_read(timers, i, since, result);
+			if (!(cqe->flags & IORING_CQE_F_MORE)) {
+				stress_timerfd_scale_poll_add(&ring, timers, i);
+				queued++;
+			}
+			head++;
+		}
+		*ring.cq_head = head;
+		shim_mb();
+		if (UNLIKELY(result->err))
+			break;
+next:
+		t_now = stress_time_now();
+	}
+	result->secs += t_now - t_start;
+	result->cpu_secs += stress_timerfd_scale_cpu() - cpu_start;
+	add_counter(args, result->events - events_start);
+	stress_uring_close(&ring);
+}
+#endif
+
+/*
+ *  stress_timerfd_scale_report()
+ *	print and set the metrics of the wait methods
+ */
+static void stress_timerfd_scale_report(
+	const stress_args_t *args,
+	const stress_timerfd_scale_timers_t *timers,
+	const stress_timerfd_scale_t *results,
+	const size_t n,
+	const double arm_usec)
+{
+	size_t i, idx = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %" PRIu32 " timers at %.1f Hz each, %.2f usec to create and arm a timer\n",
+			args->name, timers->created, (double)STRESS_NANOSECOND / (double)timers->period_ns, arm_usec);
+		pr_inf("%s: %-8s %12s %10s %10s %10s %10s %12s %10s\n", args->name,
+			"wait", "events/sec", "p50 usec", "p99 usec", "p99.9 usec",
+			"max usec", "cpu us/event", "overruns");
+	}
+	for (i = 0; i < n; i++) {
+		const stress_timerfd_scale_t *r = &results[i];
+		double rate, p50, p99, p999, max, cpu, overruns;
+		char str[64];
+
+		if (r->err) {
+			if (args->instance == 0)
+				pr_inf("%s: %-8s not available, errno=%d (%s)\n",
+					args->name, r->name, r->err, strerror(r->err));
+			continue;
+		}
+		if ((r->secs <= 0.0) || (r->events == 0))
+			continue;
+		rate = (double)r->events / r->secs;
+		p50 = (double)stress_latency_percentile(&r->latency, 50.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		p99 = (double)stress_latency_percentile(&r->latency, 99.0) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		p999 = (double)stress_latency_percentile(&r->latency, 99.9) / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		max = (double)r->latency.max / STRESS_DBL_NANOSECOND * STRESS_DBL_MICROSECOND;
+		cpu = r->cpu_secs * STRESS_DBL_MICROSECOND / (double)r->events;
+		overruns = (double)(r->expiries - r->events);
+		if (args->instance == 0)
+			pr_inf("%s: %-8s %12.1f %10.1f %10.1f %10.1f %10.1f %12.3f %10.0f\n",
+				args->name, r->name, rate, p50, p99, p999, max, cpu, overruns);
+
+		(void)snprintf(str, sizeof(str), "%s timer events per sec", r->name);
+		stress_metrics_set(args, idx++, str, rate);
+		(void)snprintf(str, sizeof(str), "%s expiry to wakeup p50 usec", r->name);
+		stress_metrics_set(args, idx++, str, p50);
+		(void)snprintf(str, sizeof(str), "%s expiry to wakeup p99 usec", r->name);
+		stress_metrics_set(args, idx++, str, p99);
+		(void)snprintf(str, sizeof(str), "%s expiry to wakeup p99.9 usec", r->name);
+		stress_metrics_set(args, idx++, str, p999);
+		(void)snprintf(str, sizeof(str), "%s cpu usec per timer event", r->name);
+		stress_metrics_set(args, idx++, str, cpu);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_timerfd_scale()
+ *	arm timerfd_scale periodic timerfds with expiries spread evenly
+ *	over the period, register them all with epoll and then take turns
+ *	waiting for them with epoll and with io_uring multishot polls,
+ *	measuring the expiry to wakeup latencies and the CPU time used
+ *	per timer event
+ */
+static int stress_timerfd_scale(
+	const stress_args_t *args,
+	const uint32_t timerfd_scale,
+	const uint64_t timerfd_freq)
+{
+	static stress_timerfd_scale_t results[2];
+	stress_timerfd_scale_timers_t timers;
+	struct rlimit rlim;
+	size_t n_results = 0, max_fds;
+	uint32_t i;
+	double t, arm_usec;
+	int efd, rc = EXIT_SUCCESS;
+	bool ran;
+
+	/* each timer is a file descriptor, raise the limit as far as allowed */
+	if (getrlimit(RLIMIT_NOFILE, &rlim) == 0) {
+		const rlim_t need = (rlim_t)timerfd_scale + TIMERFD_SCALE_FD_SLACK;
+
+		if (rlim.rlim_max < need) {
+			struct rlimit new_rlim;
+
+			new_rlim.rlim_cur = need;
+			new_rlim.rlim_max = need;
+			if (setrlimit(RLIMIT_NOFILE, &new_rlim) == 0)
+				rlim = new_rlim;
+		}
+		rlim.rlim_cur = rlim.rlim_max;
+		(void)setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+	max_fds = stress_get_max_file_limit();
+	if (max_fds < (size_t)timerfd_scale + TIMERFD_SCALE_FD_SLACK) {
+		const uint32_t scale = (max_fds > MIN_TIMERFD_SCALE + TIMERFD_SCALE_FD_SLACK) ?
+			(uint32_t)(max_fds - TIMERFD_SCALE_FD_SLACK) : MIN_TIMERFD_SCALE;
+
+		if (args->instance == 0)
+			pr_inf("%s: file descriptor limit of %zu limits timers to %" PRIu32 "\n",
+				args->name, max_fds, scale);
+		timers.n = scale;
+	} else {
+		timers.n = timerfd_scale;
+	}
+	timers.period_ns = (uint64_t)STRESS_NANOSECOND / timerfd_freq;
+	if (timers.period_ns < 1)
+		timers.period_ns = 1;
+
+	timers.fds = (int *)calloc((size_t)timers.n, sizeof(*timers.fds));
+	if (!timers.fds) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " timerfd file descriptors, "
+			"skipping stressor\n", args->name, timers.n);
+		return EXIT_NO_RESOURCE;
+	}
+	efd = epoll_create1(0);
+	if (efd < 0) {
+		pr_inf_skip("%s: epoll_create1 failed, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		free(timers.fds);
+		return EXIT_NO_RESOURCE;
+	}
+
+	/* first expiries are spread evenly over one period from base_ns */
+	timers.base_ns = stress_timerfd_scale_now() + TIMERFD_SCALE_START_NS;
+	t = stress_time_now();
+	for (i = 0; i < timers.n; i++) {
+		struct itimerspec timer;
+		struct epoll_event ev;
+		const uint64_t first = timers.base_ns + (((uint64_t)i * timers.period_ns) / timers.n);
+
+		timers.fds[i] = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+		if (timers.fds[i] < 0)
+			break;
+		timer.it_value.tv_sec = (time_t)(first / STRESS_NANOSECOND);
+		timer.it_value.tv_nsec = (long)(first % STRESS_NANOSECOND);
+		timer.it_interval.tv_sec = (time_t)(timers.period_ns / STRESS_NANOSECOND);
+		timer.it_interval.tv_nsec = (long)(timers.period_ns % STRESS_NANOSECOND);
+		if (timerfd_settime(timers.fds[i], TFD_TIMER_ABSTIME, &timer, NULL) < 0) {
+			pr_fail("%s: timerfd_settime failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			(void)close(timers.fds[i]);
+			rc = EXIT_FAILURE;
+			break;
+		}
+		(void)memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, timers.fds[i], &ev) < 0) {
+			(void)close(timers.fds[i]);
+			break;
+		}
+	}
+	arm_usec = i ? (stress_time_now() - t) * STRESS_DBL_MICROSECOND / (double)i : 0.0;
+	timers.created = i;
+	if (rc != EXIT_SUCCESS)
+		goto close_efd;
+	if (timers.created == 0) {
+		pr_inf_skip("%s: no timers could be created, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto close_efd;
+	}
+	/* the expiries stay spread over the period for n timers */
+	if ((timers.created < timers.n) && (args->instance == 0))
+		pr_inf("%s: only %" PRIu32 " of %" PRIu32 " timers could be created\n",
+			args->name, timers.created, timers.n);
+
+	(void)memset(results, 0, sizeof(results));
+	results[n_results++].name = "epoll";
+#if defined(STRESS_TIMERFD_SCALE_URING)
+	results[n_results++].name = "io_uring";
+#endif
+	for (i = 0; i < n_results; i++)
+		stress_latency_reset(&results[i].latency);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		if (!results[0].err) {
+			stress_timerfd_scale_epoll(args, &timers, efd, TIMERFD_SCALE_SLICE, &results[0]);
+			ran = true;
+		}
+#if defined(STRESS_TIMERFD_SCALE_URING)
+		if (!results[1].err && keep_stressing(args)) {
+			stress_timerfd_scale_uring(args, &timers, TIMERFD_SCALE_SLICE, &results[1]);
+			ran = true;
+		}
+#endif
+	} while (ran && keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_timerfd_scale_report(args, &timers, results, n_results, arm_usec);
+
+close_efd:
+	for (i = 0; i < timers.created; i++)
+		(void)close(timers.fds[i]);
+	(void)close(efd);
+	free(timers.fds);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_timerfd
  *	stress timerfd
@@ -150,6 +637,7 @@ static int stress_timerfd(const stress_args_t *args)
 	int timerfd_fds = TIMER_FDS_DEFAULT;
 	int count = 0, i, max_timerfd = -1;
 	bool timerfd_rand = false;
+	uint32_t timerfd_scale = 0;
 	int file_fd;
 	char file_fd_name[PATH_MAX];
 #if defined(CLOCK_BOOTTIME_ALARM)
@@ -166,6 +654,19 @@ static int stress_timerfd(const stress_args_t *args)
 	(void)stress_get_setting("timerfd-rand", &timerfd_rand);
 	(void)stress_get_setting("timerfd-fds", &timerfd_fds);
 
+	if (stress_get_setting("timerfd-scale", &timerfd_scale)) {
+#if defined(STRESS_TIMERFD_SCALE)
+		/* in scale mode --timerfd-freq is the frequency of each timer */
+		if (!stress_get_setting("timerfd-freq", &timerfd_freq))
+			timerfd_freq = DEFAULT_TIMERFD_SCALE_FREQ;
+		return stress_timerfd_scale(args, timerfd_scale, timerfd_freq);
+#else
+		pr_inf_skip("%s: --timerfd-scale needs epoll and CLOCK_MONOTONIC "
+			"timerfds, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
+
 	if (!stress_get_setting("timerfd-freq", &timerfd_freq)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
 			timerfd_freq = MAX_TIMERFD_FREQ;
@@ -101,6 +101,198 @@ static void *stress_tlb_shootdown_mmap(
 	return mem;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+#define TLB_SWEEP_PAGES		(64)	/* pages in the measured region */
+#define TLB_SWEEP_ROUNDS	(64)	/* measured rounds per cpu count */
+
+/* costs with a given number of cpus sharing the mm */
+typedef struct {
+	uint32_t cpus;			/* cpus sharing the mm */
+	uint64_t rounds;		/* measured rounds */
+	double mprotect_duration;	/* seconds in mprotect */
+	double munmap_duration;		/* seconds in munmap */
+	double madvise_duration;	/* seconds in madvise */
+	uint64_t tlb_irqs;		/* TLB shootdown interrupts */
+	uint64_t cal_irqs;		/* function call interrupts */
+} stress_tlb_sweep_t;
+
+/* state shared by the measuring thread and the sharers */
+typedef struct {
+	uint8_t *mem;			/* measured region */
+	size_t size;			/* size of region */
+	size_t page_size;		/* page size */
+	volatile uint32_t active;	/* number of sharers touching mem */
+	volatile bool stop;		/* sharers exit when true */
+} stress_tlb_sweep_ctxt_t;
+
+/* thread keeping the region in its TLB */
+typedef struct {
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	uint32_t index;			/* sharer index */
+	int32_t cpu;			/* cpu sharer is pinned to */
+	stress_tlb_sweep_ctxt_t *ctxt;	/* shared state */
+} stress_tlb_sharer_t;
+
+/*
+ *  stress_tlb_shootdown_sharer()
+ *	read a byte from each page of the region while this sharer
+ *	is active so the cpu it is pinned to caches the translations
+ */
+static void *stress_tlb_shootdown_sharer(void *arg)
+{
+	static void *nowt = NULL;
+	const stress_tlb_sharer_t *sharer = (const stress_tlb_sharer_t *)arg;
+	stress_tlb_sweep_ctxt_t *ctxt = sharer->ctxt;
+	cpu_set_t mask;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	CPU_ZERO(&mask);
+	CPU_SET(sharer->cpu, &mask);
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+
+	while (!ctxt->stop) {
+		if (sharer->index < ctxt->active) {
+			const volatile uint8_t *vmem;
+
+			for (vmem = ctxt->mem; vmem < ctxt->mem + ctxt->size; vmem += ctxt->page_size)
+				(void)*vmem;
+		} else {
+			(void)shim_sched_yield();
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_tlb_shootdown_sweep_round()
+ *	time one mprotect, madvise and munmap of the region, each
+ *	of which has to flush the translations cached by the sharers.
+ *	The munmap is done by mapping over the region with MAP_FIXED
+ *	so the sharers never see a hole in the address space
+ */
+static int stress_tlb_shootdown_sweep_round(
+	const stress_args_t *args,
+	stress_tlb_sweep_ctxt_t *ctxt,
+	stress_tlb_sweep_t *sweep)
+{
+	double t;
+	void *mem;
+
+	stress_tlb_shootdown_write_mem(ctxt->mem, ctxt->size, ctxt->page_size);
+	t = stress_time_now();
+	(void)mprotect(ctxt->mem, ctxt->size, PROT_READ);
+	sweep->mprotect_duration += stress_time_now() - t;
+	(void)mprotect(ctxt->mem, ctxt->size, PROT_READ | PROT_WRITE);
+
+	stress_tlb_shootdown_write_mem(ctxt->mem, ctxt->size, ctxt->page_size);
+	t = stress_time_now();
+	(void)madvise(ctxt->mem, ctxt->size, MADV_DONTNEED);
+	sweep->madvise_duration += stress_time_now() - t;
+
+	stress_tlb_shootdown_write_mem(ctxt->mem, ctxt->size, ctxt->page_size);
+	t = stress_time_now();
+	mem = mmap(ctxt->mem, ctxt->size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+	sweep->munmap_duration += stress_time_now() - t;
+	if (mem == MAP_FAILED) {
+		pr_fail("%s: mmap MAP_FIXED over the measured region failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return -1;
+	}
+	sweep->rounds++;
+
+	return 0;
+}
+
+/*
+ *  stress_tlb_shootdown_irqs()
+ *	read the TLB shootdown and function call interrupt counts,
+ *	returns false if there are no TLB shootdown interrupt counts
+ */
+static bool stress_tlb_shootdown_irqs(uint64_t *tlb_irqs, uint64_t *cal_irqs)
+{
+	(void)stress_get_interrupts("CAL", cal_irqs);
+	return stress_get_interrupts("TLB", tlb_irqs) == 0;
+}
+
+/*
+ *  stress_tlb_shootdown_report()
+ *	print the cost of the shootdowns over the cpu counts
+ */
+static void stress_tlb_shootdown_report(
+	const stress_args_t *args,
+	const stress_tlb_sweep_t *sweep,
+	const uint32_t n_sweep,
+	const bool irqs)
+{
+	uint32_t i;
+
+	pr_lock();
+	pr_inf("%s: %4s %12s %12s %12s %13s %13s\n", args->name,
+		"cpus", "mprotect ns", "munmap ns", "madvise ns",
+		"TLB IPIs/rnd", "CAL IPIs/rnd");
+	for (i = 0; i < n_sweep; i++) {
+		const stress_tlb_sweep_t *s = &sweep[i];
+		const double rounds = (double)s->rounds;
+		char tlb[16], cal[16];
+
+		if (s->rounds == 0)
+			continue;
+		if (irqs) {
+			(void)snprintf(tlb, sizeof(tlb), "%13.2f", (double)s->tlb_irqs / rounds);
+			(void)snprintf(cal, sizeof(cal), "%13.2f", (double)s->cal_irqs / rounds);
+		} else {
+			shim_strlcpy(tlb, "n/a", sizeof(tlb));
+			shim_strlcpy(cal, "n/a", sizeof(cal));
+		}
+		pr_inf("%s: %4" PRIu32 " %12.1f %12.1f %12.1f %13s %13s\n", args->name,
+			s->cpus,
+			STRESS_DBL_NANOSECOND * s->mprotect_duration / rounds,
+			STRESS_DBL_NANOSECOND * s->munmap_duration / rounds,
+			STRESS_DBL_NANOSECOND * s->madvise_duration / rounds,
+			tlb, cal);
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_tlb_shootdown_metrics()
+ *	add the per cpu count shootdown costs to the metrics
+ */
+static void stress_tlb_shootdown_metrics(
+	const stress_args_t *args,
+	const stress_tlb_sweep_t *sweep,
+	const uint32_t n_sweep,
+	const bool irqs)
+{
+	uint32_t i;
+	size_t idx = 0;
+
+	for (i = 0; i < n_sweep; i++) {
+		const stress_tlb_sweep_t *s = &sweep[i];
+		const double rounds = (double)s->rounds;
+		char str[64];
+
+		if (s->rounds == 0)
+			continue;
+		(void)snprintf(str, sizeof(str), "nanosecs per mprotect (%" PRIu32 " cpus)", s->cpus);
+		stress_metrics_set(args, idx++, str, STRESS_DBL_NANOSECOND * s->mprotect_duration / rounds);
+		(void)snprintf(str, sizeof(str), "nanosecs per munmap (%" PRIu32 " cpus)", s->cpus);
+		stress_metrics_set(args, idx++, str, STRESS_DBL_NANOSECOND * s->munmap_duration / rounds);
+		(void)snprintf(str, sizeof(str), "nanosecs per madvise (%" PRIu32 " cpus)", s->cpus);
+		stress_metrics_set(args, idx++, str, STRESS_DBL_NANOSECOND * s->madvise_duration / rounds);
+		if (irqs) {
+			(void)snprintf(str, sizeof(str), "TLB shootdown IPIs per round (%" PRIu32 " cpus)", s->cpus);
+			stress_metrics_set(args, idx++, str, (double)s->tlb_irqs / rounds);
+		}
+	}
+}
+#endif
+
 /*
  *  stress_tlb_shootdown()
  *	stress out TLB shootdowns
@@ -118,6 +310,15 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 	cpu_set_t proc_mask;
 	int32_t tlb_procs, i;
 	uint8_t *mem;
+#if defined(HAVE_LIB_PTHREAD)
+	stress_tlb_sweep_t sweep[MAX_TLB_PROCS];
+	stress_tlb_sharer_t sharers[MAX_TLB_PROCS - 1];
+	stress_tlb_sweep_ctxt_t sweep_ctxt;
+	int32_t cpus[MAX_TLB_PROCS];
+	uint32_t n_sweep = 0, sweep_idx = 0, n_cpus = 0;
+	uint64_t tlb_irqs = 0, cal_irqs = 0;
+	bool irqs = false;
+#endif
 #if defined(HAVE_MADVISE) &&	\
     defined(MADV_DONTNEED)
 	int fd, ret;
@@ -183,6 +384,29 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 	for (i = 0; i < tlb_procs; i++)
 		pids[i] = -1;
 
+#if defined(HAVE_LIB_PTHREAD)
+	/* cpus the sharers are pinned to, the first is left for this thread */
+	for (i = 0; (i < max_cpus) && (n_cpus < MAX_TLB_PROCS); i++) {
+		if (CPU_ISSET(i, &proc_mask_initial))
+			cpus[n_cpus++] = i;
+	}
+	if (n_cpus == 0)
+		cpus[n_cpus++] = 0;
+
+	(void)memset(&sweep_ctxt, 0, sizeof(sweep_ctxt));
+	(void)memset(sweep, 0, sizeof(sweep));
+	sweep_ctxt.page_size = page_size;
+	sweep_ctxt.size = page_size * TLB_SWEEP_PAGES;
+	sweep_ctxt.mem = stress_tlb_shootdown_mmap(args, NULL, sweep_ctxt.size,
+			PROT_WRITE | PROT_READ,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if ((void *)sweep_ctxt.mem == MAP_FAILED) {
+		rc = EXIT_NO_RESOURCE;
+		goto err_munmap_mem;
+	}
+	(void)memset(sweep_ctxt.mem, 0xff, sweep_ctxt.size);
+#endif
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	for (i = 0; i < tlb_procs; i++) {
@@ -247,6 +471,29 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 		}
 	}
 
+#if defined(HAVE_LIB_PTHREAD)
+	/*
+	 *  sweep over 1 to n_cpus cpus sharing the mm, one sharer
+	 *  thread per cpu besides this one, on a single cpu system
+	 *  the one sharer time-shares with this thread
+	 */
+	sweep[n_sweep++].cpus = 1;
+	for (i = 0; i < (int32_t)STRESS_MAXIMUM(n_cpus - 1, 1); i++) {
+		stress_tlb_sharer_t *sharer = &sharers[i];
+
+		sharer->index = (uint32_t)i;
+		sharer->cpu = cpus[(i + 1) % (int32_t)n_cpus];
+		sharer->ctxt = &sweep_ctxt;
+		sharer->ret = pthread_create(&sharer->pthread, NULL,
+				stress_tlb_shootdown_sharer, (void *)sharer);
+		if (sharer->ret)
+			break;
+		sweep[n_sweep].cpus = n_sweep + 1;
+		n_sweep++;
+	}
+	irqs = stress_tlb_shootdown_irqs(&tlb_irqs, &cal_irqs);
+#endif
+
 	do {
 #if defined(HAVE_MADVISE) &&	\
     defined(MADV_DONTNEED)
@@ -263,9 +510,33 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 		(void)madvise(mem, mmap_size, MADV_DONTNEED);
 		stress_tlb_shootdown_write_mem(mem, mmap_size, page_size);
 
+#if defined(HAVE_LIB_PTHREAD)
+		if (stress_tlb_shootdown_sweep_round(args, &sweep_ctxt, &sweep[sweep_idx]) < 0) {
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if ((sweep[sweep_idx].rounds % TLB_SWEEP_ROUNDS) == 0) {
+			uint64_t tlb_now = 0, cal_now = 0;
+
+			/* move on to the next cpu count */
+			(void)stress_tlb_shootdown_irqs(&tlb_now, &cal_now);
+			sweep[sweep_idx].tlb_irqs += tlb_now - tlb_irqs;
+			sweep[sweep_idx].cal_irqs += cal_now - cal_irqs;
+			tlb_irqs = tlb_now;
+			cal_irqs = cal_now;
+			sweep_idx = (sweep_idx + 1) % n_sweep;
+			sweep_ctxt.active = sweep_idx;
+		}
+#endif
 		inc_counter(args);
 	} while(keep_stressing(args));
 
+#if defined(HAVE_LIB_PTHREAD)
+	sweep_ctxt.stop = true;
+	for (i = 0; i < (int32_t)n_sweep - 1; i++)
+		(void)pthread_join(sharers[i].pthread, NULL);
+#endif
+
 	for (i = 0; i < tlb_procs; i++) {
 		int status;
 
@@ -295,6 +566,12 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
+#if defined(HAVE_LIB_PTHREAD)
+	if (args->instance == 0)
+		stress_tlb_shootdown_report(args, sweep, n_sweep, irqs);
+	stress_tlb_shootdown_metrics(args, sweep, n_sweep, irqs);
+	(void)munmap((void *)sweep_ctxt.mem, sweep_ctxt.size);
+#endif
 err_munmap_mem:
 	(void)munmap(mem, mmap_size);
 err_munmap_memfd:
@@ -18,6 +18,8 @@
  *
  */
 #include "stress-ng.h"
+#include "core-capabilities.h"
+#include "core-memfs-bench.h"
 
 #if defined(HAVE_SYS_STATFS_H)
 #include <sys/statfs.h>
@@ -47,12 +49,18 @@ typedef struct {
 
 static const stress_help_t help[] = {
 	{ NULL,	"tmpfs N",	    "start N workers mmap'ing a file on tmpfs" },
+	{ NULL,	"tmpfs-bench",	    "measure tmpfs bandwidth and fault rates over huge= mount options" },
 	{ NULL,	"tmpfs-mmap-async", "using asynchronous msyncs for tmpfs file based mmap" },
 	{ NULL,	"tmpfs-mmap-file",  "mmap onto a tmpfs file using synchronous msyncs" },
 	{ NULL,	"tmpfs-ops N",	    "stop after N tmpfs bogo ops" },
 	{ NULL,	NULL,		    NULL }
 };
 
+static int stress_set_tmpfs_bench(const char *opt)
+{
+	return stress_set_setting_true("tmpfs-bench", opt);
+}
+
 static int stress_set_tmpfs_mmap_file(const char *opt)
 {
 	return stress_set_setting_true("tmpfs-mmap-file", opt);
@@ -64,6 +72,7 @@ static int stress_set_tmpfs_mmap_async(const char *opt)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_tmpfs_bench,	stress_set_tmpfs_bench },
 	{ OPT_tmpfs_mmap_async,	stress_set_tmpfs_mmap_async },
 	{ OPT_tmpfs_mmap_file,	stress_set_tmpfs_mmap_file },
 	{ 0,			NULL }
@@ -111,9 +120,10 @@ typedef struct {
  *	attempts to find a writeable tmpfs file system and open
  *	a tmpfs temp file. The file is unlinked so the final close
  *	will enforce and automatic space reap if the child process
- *	exits prematurely.
+ *	exits prematurely. The mount point is copied to mnt if
+ *	it is non-NULL.
  */
-static int stress_tmpfs_open(const stress_args_t *args, off_t *len)
+static int stress_tmpfs_open(const stress_args_t *args, off_t *len, char *mnt, const size_t mnt_len)
 {
 	const uint32_t rnd = stress_mwc32();
 	char path[PATH_MAX];
@@ -185,6 +195,8 @@ static int stress_tmpfs_open(const stress_args_t *args, off_t *len)
 				continue;
 			}
 			*len = max_size;
+			if (mnt)
+				(void)shim_strlcpy(mnt, mnts[i], mnt_len);
 			break;
 		}
 	}
@@ -406,6 +418,86 @@ cleanup:
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_tmpfs_bench()
+ *	compare the read, write, page fault and mmap bandwidth of a
+ *	mounted tmpfs and, with CAP_SYS_ADMIN, private tmpfs mounts
+ *	with each of the huge= page policies
+ */
+static int stress_tmpfs_bench(const stress_args_t *args)
+{
+	static const char * const huge[] = {
+		"never",
+		"always",
+		"within_size",
+		"advise",
+	};
+	static stress_memfs_bench_t bench[1 + SIZEOF_ARRAY(huge)];
+	const size_t size = stress_memfs_bench_size(args);
+	char mnt[PATH_MAX], option[32];
+	size_t i, n = 1;
+	off_t len;
+	int fd, ret;
+
+	(void)memset(bench, 0, sizeof(bench));
+	fd = stress_tmpfs_open(args, &len, mnt, sizeof(mnt));
+	if (fd >= 0) {
+		stress_memfs_huge_option(mnt, option, sizeof(option));
+		(void)snprintf(bench[0].label, sizeof(bench[0].label), "%.24s (%.20s)", mnt, option);
+	} else {
+		(void)shim_strlcpy(bench[0].label, "mounted tmpfs", sizeof(bench[0].label));
+		bench[0].err = ENOENT;
+	}
+
+	if (stress_check_capability(SHIM_CAP_SYS_ADMIN)) {
+		ret = stress_temp_dir_mk_args(args);
+		if (ret < 0) {
+			if (fd >= 0)
+				(void)close(fd);
+			return stress_exit_status(-ret);
+		}
+		for (i = 0; i < SIZEOF_ARRAY(huge); i++, n++)
+			(void)snprintf(bench[n].label, sizeof(bench[n].label), "tmpfs (huge=%s)", huge[i]);
+	} else if (fd < 0) {
+		pr_inf_skip("%s: cannot find writeable free space on a tmpfs "
+			"filesystem or mount one without CAP_SYS_ADMIN, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	} else if (args->instance == 0) {
+		pr_inf("%s: huge= mount options need CAP_SYS_ADMIN, only using %s\n",
+			args->name, mnt);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; keep_stressing(args) && (i < n); i++) {
+			if (bench[i].err)
+				continue;
+			if (i == 0) {
+				bench[i].err = stress_memfs_bench_fd(args, fd, size, &bench[i]);
+			} else {
+				char opts[64];
+
+				(void)snprintf(opts, sizeof(opts), "size=%zu,huge=%s", size * 2, huge[i - 1]);
+				bench[i].err = stress_memfs_bench_mount(args, "tmpfs", opts, size, &bench[i]);
+			}
+			inc_counter(args);
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_memfs_bench_report(args, bench, n);
+
+	if (fd >= 0)
+		(void)close(fd);
+	if (n > 1)
+		(void)stress_temp_dir_rm_args(args);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_tmpfs()
  *	stress tmpfs
@@ -413,9 +505,14 @@ cleanup:
 static int stress_tmpfs(const stress_args_t *args)
 {
 	stress_tmpfs_context_t context;
+	bool tmpfs_bench = false;
 	int ret;
 
-	context.fd = stress_tmpfs_open(args, &context.sz);
+	(void)stress_get_setting("tmpfs-bench", &tmpfs_bench);
+	if (tmpfs_bench)
+		return stress_tmpfs_bench(args);
+
+	context.fd = stress_tmpfs_open(args, &context.sz, NULL, 0);
 	if (context.fd < 0) {
 		pr_err("%s: cannot find writeable free space on a "
 			"tmpfs filesystem\n", args->name);
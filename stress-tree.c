@@ -18,9 +18,16 @@
  *
  */
 #include "stress-ng.h"
+#include "core-arena.h"
+#include "core-cpu-cache.h"
 #include "core-pragma.h"
+#include "core-put.h"
 #include "core-target-clones.h"
 
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#include <linux/perf_event.h>
+#endif
+
 #if defined(HAVE_SYS_TREE_H)
 #include <sys/tree.h>
 #endif
@@ -64,12 +71,21 @@
 #define MAX_TREE_SIZE		(25000000)	/* Must be uint32_t sized or less */
 #define DEFAULT_TREE_SIZE	(250000)
 
+#define MIN_TREE_NODE_SIZE	(64)
+#define MAX_TREE_NODE_SIZE	(4096)
+#define DEFAULT_TREE_NODE_SIZE	(256)
+
+#define BPLUS_MAX_KEYS		(MAX_TREE_NODE_SIZE / sizeof(uint32_t))
+#define TREE_SCAN_LEN		(64)	/* keys per range scan */
+
 struct tree_node;
 
 typedef struct {
 	double insert;		/* total insert duration */
 	double find;		/* total find duration */
 	double remove;		/* total remove duration */
+	double scan;		/* total range scan duration */
+	double scans;		/* total range scans */
 	double count;		/* total nodes exercised */
 } stress_tree_metrics_t;
 
@@ -87,14 +103,18 @@ static const stress_tree_method_info_t stress_tree_methods[];
 
 static const stress_help_t help[] = {
 	{ NULL,	"tree N",	 "start N workers that exercise tree structures" },
-	{ NULL,	"tree-method M", "select tree method: all,avl,binary,btree,rb,splay" },
+	{ NULL,	"tree-method M", "select tree method: all,avl,binary,bplus,btree,eytzinger,rb,splay,veb" },
+	{ NULL,	"tree-node-size N", "B+tree node size in bytes, a power of 2 from 64 to 4096" },
 	{ NULL,	"tree-ops N",	 "stop after N bogo tree operations" },
 	{ NULL,	"tree-size N",	 "N is the number of items in the tree" },
+	{ NULL,	"tree-sweep",	 "sweep lookups over static layouts from L2 to 10 x LLC size" },
 	{ NULL,	NULL,		 NULL }
 };
 
 static volatile bool do_jmp = true;
 static sigjmp_buf jmp_env;
+static size_t tree_node_size = DEFAULT_TREE_NODE_SIZE;
+static stress_arena_t *btree_arena;	/* --arena btree node arena */
 
 struct binary_node {
 	struct tree_node *left;
@@ -121,6 +141,17 @@ typedef struct btree_node {
 	int count;
 } btree_node_t;
 
+/*
+ *  btree_node_alloc()
+ *	allocate a zero'd btree node from the arena or libc
+ */
+static inline btree_node_t *btree_node_alloc(void)
+{
+	if (btree_arena)
+		return (btree_node_t *)stress_arena_calloc(btree_arena, 1, sizeof(btree_node_t));
+	return (btree_node_t *)calloc(1, sizeof(btree_node_t));
+}
+
 struct tree_node {
 	uint32_t value;
 	union {
@@ -149,6 +180,25 @@ static int stress_set_tree_size(const char *opt)
 	return stress_set_setting("tree-size", TYPE_ID_UINT64, &tree_size);
 }
 
+/*
+ *  stress_set_tree_node_size()
+ *	set B+tree node size in bytes
+ */
+static int stress_set_tree_node_size(const char *opt)
+{
+	uint64_t tree_node_size_opt;
+
+	tree_node_size_opt = stress_get_uint64_byte(opt);
+	stress_check_power_of_2("tree-node-size", tree_node_size_opt,
+		MIN_TREE_NODE_SIZE, MAX_TREE_NODE_SIZE);
+	return stress_set_setting("tree-node-size", TYPE_ID_UINT64, &tree_node_size_opt);
+}
+
+static int stress_set_tree_sweep(const char *opt)
+{
+	return stress_set_setting_true("tree-sweep", opt);
+}
+
 /*
  *  stress_tree_handler()
  *	SIGALRM generic handler
@@ -639,7 +689,7 @@ static btree_node_t * OPTIMIZE3 btree_split_node(
 	register int j;
 	const int median = (pos > BTREE_MIN) ? BTREE_MIN + 1 : BTREE_MIN;
 
-	new_node = (btree_node_t *)calloc(1, sizeof(*new_node));
+	new_node = btree_node_alloc();
 	if (UNLIKELY(!new_node))
 		return NULL;
 
@@ -716,7 +766,7 @@ static bool OPTIMIZE3 btree_insert(btree_node_t **root, const uint32_t value)
 	if (flag) {
 		btree_node_t *node;
 
-		node = (btree_node_t *)calloc(1, sizeof(*node));
+		node = btree_node_alloc();
 		if (UNLIKELY(!node))
 			return false;
 		node->count = 1;
@@ -735,6 +785,11 @@ static void OPTIMIZE3 btree_remove_tree(btree_node_t **node)
 
 	if (!*node)
 		return;
+	if (btree_arena) {
+		stress_arena_reset(btree_arena);
+		*node = NULL;
+		return;
+	}
 
 PRAGMA_UNROLL_N(4)
 	for (i = 0; i <= (*node)->count; i++) {
@@ -829,6 +884,1094 @@ PRAGMA_UNROLL_N(4)
 	metrics->count += (double)n;
 }
 
+/*
+ *  B+tree, nodes are tree_node_size bytes (a power of 2 cache line
+ *  multiple) allocated from an aligned pool, all keys live in the
+ *  leaves and the leaves are linked for range scans
+ */
+typedef struct bplus_node {
+	uint16_t count;			/* number of keys */
+	uint16_t leaf;			/* true if a leaf node */
+	uint32_t pad;
+	struct bplus_node *next;	/* next leaf, leaves only */
+	uint32_t keys[];		/* keys, then children in inner nodes */
+} bplus_node_t;
+
+typedef struct {
+	bplus_node_t *root;		/* root node */
+	uint8_t *pool;			/* node pool */
+	size_t pool_size;		/* pool size in bytes */
+	size_t pool_used;		/* bytes of pool used */
+	size_t node_size;		/* bytes per node */
+	size_t inner_keys;		/* max keys in an inner node */
+	size_t leaf_keys;		/* max keys in a leaf node */
+	size_t children_offset;		/* offset of children in inner nodes */
+} bplus_tree_t;
+
+#define BPLUS_CHILDREN(tree, node)	\
+	((bplus_node_t **)((uint8_t *)(node) + (tree)->children_offset))
+
+static bplus_node_t *bplus_node_alloc(bplus_tree_t *tree, const bool leaf)
+{
+	bplus_node_t *node;
+
+	if (UNLIKELY(tree->pool_used + tree->node_size > tree->pool_size))
+		return NULL;
+	node = (bplus_node_t *)(tree->pool + tree->pool_used);
+	tree->pool_used += tree->node_size;
+	node->count = 0;
+	node->leaf = leaf;
+	node->next = NULL;
+
+	return node;
+}
+
+/*
+ *  bplus_pool_size()
+ *	bytes of node pool for n keys, split nodes are at least half
+ *	full so there are at most 2n / leaf_keys leaves and fewer
+ *	inner nodes than leaves
+ */
+static size_t bplus_pool_size(const size_t node_size, const size_t n)
+{
+	const size_t leaf_keys = (node_size - sizeof(bplus_node_t)) / sizeof(uint32_t);
+
+	return ((2 * ((2 * n) / leaf_keys + 2)) + 64) * node_size;
+}
+
+/*
+ *  bplus_init()
+ *	size the nodes and allocate a pool big enough for n keys
+ */
+static int bplus_init(bplus_tree_t *tree, const size_t node_size, const size_t n)
+{
+	const size_t header = sizeof(bplus_node_t);
+	size_t k;
+
+	(void)memset(tree, 0, sizeof(*tree));
+	tree->node_size = node_size;
+	tree->leaf_keys = (node_size - header) / sizeof(uint32_t);
+	for (k = tree->leaf_keys; k > 1; k--) {
+		const size_t offset = header + ((k * sizeof(uint32_t) + 7) & ~(size_t)7);
+
+		if (offset + ((k + 1) * sizeof(bplus_node_t *)) <= node_size)
+			break;
+	}
+	tree->inner_keys = k;
+	tree->children_offset = header + ((k * sizeof(uint32_t) + 7) & ~(size_t)7);
+	tree->pool_size = bplus_pool_size(node_size, n);
+	tree->pool = (uint8_t *)mmap(NULL, tree->pool_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (tree->pool == MAP_FAILED) {
+		tree->pool = NULL;
+		return -1;
+	}
+	tree->root = bplus_node_alloc(tree, true);
+
+	return 0;
+}
+
+static void bplus_deinit(bplus_tree_t *tree)
+{
+	if (tree->pool)
+		(void)munmap((void *)tree->pool, tree->pool_size);
+	tree->pool = NULL;
+	tree->root = NULL;
+}
+
+/*
+ *  bplus_upper()
+ *	number of keys <= key, large nodes are binary searched
+ *	down to 32 keys, then a linear count the compiler can vectorize
+ */
+static inline size_t OPTIMIZE3 bplus_upper(const uint32_t *keys, const size_t count, const uint32_t key)
+{
+	register size_t base = 0, len = count, i, n = 0;
+
+	/* keys before base are <= key, keys from base + len are > key */
+	while (len > 32) {
+		const size_t half = len >> 1;
+
+		if (keys[base + half - 1] <= key) {
+			base += half;
+			len -= half;
+		} else {
+			len = half;
+		}
+	}
+	for (i = 0; i < len; i++)
+		n += (keys[base + i] <= key);
+	return base + n;
+}
+
+/*
+ *  bplus_insert()
+ *	insert key, splitting full nodes on the way back up,
+ *	returns false if the node pool is exhausted
+ */
+static bool OPTIMIZE3 bplus_insert(bplus_tree_t *tree, const uint32_t key)
+{
+	bplus_node_t *path[64], *node = tree->root, *right, **children;
+	size_t idx[64], depth = 0, i, j, half;
+	uint32_t keys[BPLUS_MAX_KEYS + 1], sep;
+	bplus_node_t *ptrs[BPLUS_MAX_KEYS + 2];
+
+	while (!node->leaf) {
+		i = bplus_upper(node->keys, node->count, key);
+		path[depth] = node;
+		idx[depth] = i;
+		depth++;
+		node = BPLUS_CHILDREN(tree, node)[i];
+	}
+	i = bplus_upper(node->keys, node->count, key);
+	if ((i > 0) && (node->keys[i - 1] == key))
+		return true;
+	if (node->count < tree->leaf_keys) {
+		(void)memmove(&node->keys[i + 1], &node->keys[i], (node->count - i) * sizeof(uint32_t));
+		node->keys[i] = key;
+		node->count++;
+		return true;
+	}
+
+	/* split the full leaf, the right half's first key goes up */
+	right = bplus_node_alloc(tree, true);
+	if (UNLIKELY(!right))
+		return false;
+	(void)memcpy(keys, node->keys, i * sizeof(uint32_t));
+	keys[i] = key;
+	(void)memcpy(&keys[i + 1], &node->keys[i], (node->count - i) * sizeof(uint32_t));
+	half = (tree->leaf_keys + 1) >> 1;
+	(void)memcpy(node->keys, keys, half * sizeof(uint32_t));
+	node->count = (uint16_t)half;
+	(void)memcpy(right->keys, &keys[half], (tree->leaf_keys + 1 - half) * sizeof(uint32_t));
+	right->count = (uint16_t)(tree->leaf_keys + 1 - half);
+	right->next = node->next;
+	node->next = right;
+	sep = right->keys[0];
+
+	while (depth > 0) {
+		bplus_node_t *parent;
+		size_t count;
+
+		depth--;
+		parent = path[depth];
+		i = idx[depth];
+		count = parent->count;
+		children = BPLUS_CHILDREN(tree, parent);
+		if (count < tree->inner_keys) {
+			(void)memmove(&parent->keys[i + 1], &parent->keys[i], (count - i) * sizeof(uint32_t));
+			(void)memmove(&children[i + 2], &children[i + 1], (count - i) * sizeof(bplus_node_t *));
+			parent->keys[i] = sep;
+			children[i + 1] = right;
+			parent->count++;
+			return true;
+		}
+
+		/* split the full inner node, the middle key goes up */
+		for (j = 0; j < i; j++)
+			keys[j] = parent->keys[j];
+		keys[i] = sep;
+		for (j = i; j < count; j++)
+			keys[j + 1] = parent->keys[j];
+		for (j = 0; j <= i; j++)
+			ptrs[j] = children[j];
+		ptrs[i + 1] = right;
+		for (j = i + 1; j <= count; j++)
+			ptrs[j + 1] = children[j];
+
+		right = bplus_node_alloc(tree, false);
+		if (UNLIKELY(!right))
+			return false;
+		half = (count + 1) >> 1;
+		sep = keys[half];
+		(void)memcpy(parent->keys, keys, half * sizeof(uint32_t));
+		(void)memcpy(children, ptrs, (half + 1) * sizeof(bplus_node_t *));
+		parent->count = (uint16_t)half;
+		(void)memcpy(right->keys, &keys[half + 1], (count - half) * sizeof(uint32_t));
+		(void)memcpy(BPLUS_CHILDREN(tree, right), &ptrs[half + 1], (count - half + 1) * sizeof(bplus_node_t *));
+		right->count = (uint16_t)(count - half);
+	}
+
+	/* the root split, grow a new root */
+	node = bplus_node_alloc(tree, false);
+	if (UNLIKELY(!node))
+		return false;
+	node->keys[0] = sep;
+	node->count = 1;
+	children = BPLUS_CHILDREN(tree, node);
+	children[0] = tree->root;
+	children[1] = right;
+	tree->root = node;
+
+	return true;
+}
+
+/*
+ *  bplus_leaf()
+ *	find the leaf that would hold key
+ */
+static inline bplus_node_t * OPTIMIZE3 bplus_leaf(const bplus_tree_t *tree, const uint32_t key)
+{
+	register bplus_node_t *node = tree->root;
+
+	while (!node->leaf)
+		node = BPLUS_CHILDREN(tree, node)[bplus_upper(node->keys, node->count, key)];
+	return node;
+}
+
+static inline bool OPTIMIZE3 bplus_find(const bplus_tree_t *tree, const uint32_t key)
+{
+	const bplus_node_t *node = bplus_leaf(tree, key);
+	const size_t i = bplus_upper(node->keys, node->count, key);
+
+	return (i > 0) && (node->keys[i - 1] == key);
+}
+
+/*
+ *  bplus_scan()
+ *	sum up to len keys >= key along the leaf chain, returns
+ *	the number of keys scanned
+ */
+static size_t OPTIMIZE3 bplus_scan(const bplus_tree_t *tree, const uint32_t key, const size_t len, uint64_t *sum)
+{
+	const bplus_node_t *node = bplus_leaf(tree, key);
+	size_t i = bplus_upper(node->keys, node->count, key), n = 0;
+
+	if ((i > 0) && (node->keys[i - 1] == key))
+		i--;
+	while (node && (n < len)) {
+		for (; (i < node->count) && (n < len); i++, n++)
+			*sum += node->keys[i];
+		node = node->next;
+		i = 0;
+	}
+	return n;
+}
+
+/*
+ *  bplus_bulk_load()
+ *	build the tree bottom up from n sorted keys with full nodes
+ */
+static bool bplus_bulk_load(bplus_tree_t *tree, const uint32_t *sorted, const size_t n)
+{
+	const size_t n_leaves = (n + tree->leaf_keys - 1) / tree->leaf_keys;
+	bplus_node_t **level, *prev = NULL;
+	uint32_t *mins;
+	size_t i, count = 0;
+
+	level = calloc(n_leaves, sizeof(*level));
+	mins = calloc(n_leaves, sizeof(*mins));
+	if (!level || !mins) {
+		free(mins);
+		free(level);
+		return false;
+	}
+	tree->pool_used = 0;
+	for (i = 0; i < n; i += tree->leaf_keys) {
+		bplus_node_t *node = bplus_node_alloc(tree, true);
+		const size_t len = STRESS_MINIMUM(tree->leaf_keys, n - i);
+
+		if (!node)
+			goto fail;
+		(void)memcpy(node->keys, &sorted[i], len * sizeof(uint32_t));
+		node->count = (uint16_t)len;
+		if (prev)
+			prev->next = node;
+		prev = node;
+		mins[count] = sorted[i];
+		level[count++] = node;
+	}
+	while (count > 1) {
+		size_t up = 0;
+
+		for (i = 0; i < count; i += tree->inner_keys + 1) {
+			bplus_node_t *node = bplus_node_alloc(tree, false);
+			const size_t len = STRESS_MINIMUM(tree->inner_keys + 1, count - i);
+			size_t j;
+
+			if (!node)
+				goto fail;
+			for (j = 0; j < len; j++) {
+				BPLUS_CHILDREN(tree, node)[j] = level[i + j];
+				if (j)
+					node->keys[j - 1] = mins[i + j];
+			}
+			node->count = (uint16_t)(len - 1);
+			mins[up] = mins[i];
+			level[up++] = node;
+		}
+		count = up;
+	}
+	tree->root = count ? level[0] : bplus_node_alloc(tree, true);
+	free(mins);
+	free(level);
+	return tree->root != NULL;
+fail:
+	free(mins);
+	free(level);
+	return false;
+}
+
+static void stress_tree_bplus(
+	const stress_args_t *args,
+	const size_t n,
+	struct tree_node *nodes,
+	stress_tree_metrics_t *metrics)
+{
+	size_t i;
+	struct tree_node *node;
+	bplus_tree_t tree;
+	uint64_t sum = 0;
+	double t;
+
+	if (bplus_init(&tree, tree_node_size, n) < 0) {
+		pr_fail("%s: cannot allocate %zd byte B+tree node pool\n",
+			args->name, bplus_pool_size(tree_node_size, n));
+		return;
+	}
+
+	t = stress_time_now();
+PRAGMA_UNROLL_N(4)
+	for (node = nodes, i = 0; i < n; i++, node++) {
+		if (UNLIKELY(!bplus_insert(&tree, node->value))) {
+			pr_fail("%s: B+tree node pool exhausted\n", args->name);
+			break;
+		}
+	}
+	metrics->insert += stress_time_now() - t;
+
+	/* Manditory forward tree check */
+	t = stress_time_now();
+PRAGMA_UNROLL_N(4)
+	for (node = nodes, i = 0; i < n; i++, node++) {
+		if (!bplus_find(&tree, node->value))
+			pr_fail("%s: bplus tree node #%zd not found\n",
+				args->name, i);
+	}
+	metrics->find += stress_time_now() - t;
+
+	t = stress_time_now();
+	for (node = nodes, i = 0; i < n; i += TREE_SCAN_LEN, node += TREE_SCAN_LEN) {
+		const size_t len = bplus_scan(&tree, node->value, TREE_SCAN_LEN, &sum);
+
+		if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+		    (len != STRESS_MINIMUM(TREE_SCAN_LEN, n - node->value)))
+			pr_fail("%s: bplus tree range scan from %" PRIu32 " returned %zd keys\n",
+				args->name, node->value, len);
+		metrics->scans += 1.0;
+	}
+	metrics->scan += stress_time_now() - t;
+	stress_uint64_put(sum);
+
+	if (g_opt_flags & OPT_FLAGS_VERIFY) {
+		/* optional random find */
+		for (i = 0; i < n; i++) {
+			const size_t j = stress_mwc32modn(n);
+
+			if (!bplus_find(&tree, nodes[j].value))
+				pr_fail("%s: bplus tree node #%zd not found\n",
+					args->name, j);
+		}
+	}
+	t = stress_time_now();
+	bplus_deinit(&tree);
+	metrics->remove += stress_time_now() - t;
+	metrics->count += (double)n;
+}
+
+/*
+ *  Eytzinger layout, the sorted keys in breadth first order of
+ *  an implicit complete binary tree, 1 based, the children of
+ *  i are at 2i and 2i + 1 and the descent is branchless
+ */
+static void eytzinger_build(uint32_t *eyt, const uint32_t *sorted, const size_t n)
+{
+	size_t i = 1, j = 0;
+
+	/* iterative in-order walk of the implicit tree */
+	for (;;) {
+		while (i <= n)
+			i <<= 1;
+		i >>= 1;
+		/* visit i and the right spine back up */
+		for (;;) {
+			eyt[i] = sorted[j++];
+			if ((i << 1) + 1 <= n) {
+				i = (i << 1) + 1;
+				break;
+			}
+			while (i & 1)
+				i >>= 1;
+			i >>= 1;
+			if (!i)
+				return;
+		}
+	}
+}
+
+/*
+ *  eytzinger_lower()
+ *	index of the first key >= key, 0 if there is none, the
+ *	prefetch fetches the line holding the 16 descendants four
+ *	levels down
+ */
+static inline size_t OPTIMIZE3 eytzinger_lower(const uint32_t *eyt, const size_t n, const uint32_t key)
+{
+	register size_t i = 1;
+
+	while (i <= n) {
+		shim_builtin_prefetch(eyt + (i << 4));
+		i = (i << 1) + (eyt[i] < key);
+	}
+	/* strip the trailing right turns and the last left turn */
+	while (i & 1)
+		i >>= 1;
+	return i >> 1;
+}
+
+static inline size_t eytzinger_next(const size_t n, size_t i)
+{
+	if ((i << 1) + 1 <= n) {
+		i = (i << 1) + 1;
+		while ((i << 1) <= n)
+			i <<= 1;
+		return i;
+	}
+	while (i & 1)
+		i >>= 1;
+	return i >> 1;
+}
+
+static inline bool OPTIMIZE3 eytzinger_find(const uint32_t *eyt, const size_t n, const uint32_t key)
+{
+	const size_t i = eytzinger_lower(eyt, n, key);
+
+	return i && (eyt[i] == key);
+}
+
+static size_t OPTIMIZE3 eytzinger_scan(const uint32_t *eyt, const size_t n, const uint32_t key,
+	const size_t len, uint64_t *sum)
+{
+	size_t i, count = 0;
+
+	for (i = eytzinger_lower(eyt, n, key); i && (count < len); i = eytzinger_next(n, i), count++)
+		*sum += eyt[i];
+	return count;
+}
+
+/*
+ *  van Emde Boas layout, the Eytzinger tree is recursively cut at
+ *  half its height, the top tree is laid out then each bottom tree,
+ *  so any root to leaf path touches O(log_B n) cache lines for
+ *  every line size B, nodes have explicit child indexes, 0 is none
+ */
+typedef struct {
+	uint32_t key;
+	uint32_t left;
+	uint32_t right;
+} veb_node_t;
+
+static void veb_layout(const size_t n, const size_t root, const uint32_t height, uint32_t *pos, uint32_t *next)
+{
+	uint32_t top, bottom;
+	size_t first, j;
+
+	if (root > n)
+		return;
+	if (height == 1) {
+		pos[root] = ++(*next);
+		return;
+	}
+	top = height >> 1;
+	bottom = height - top;
+	veb_layout(n, root, top, pos, next);
+	if (root > (n >> top))
+		return;
+	first = root << top;
+	for (j = 0; (j < ((size_t)1 << top)) && (first + j <= n); j++)
+		veb_layout(n, first + j, bottom, pos, next);
+}
+
+/*
+ *  veb_build()
+ *	lay out the keys of the 1 based Eytzinger array eyt into
+ *	nodes[1..n], returns false if out of memory
+ */
+static bool veb_build(veb_node_t *nodes, const uint32_t *eyt, const size_t n)
+{
+	uint32_t *pos, next = 0, height = 0;
+	size_t i;
+
+	pos = calloc(n + 1, sizeof(*pos));
+	if (!pos)
+		return false;
+	for (i = n; i; i >>= 1)
+		height++;
+	veb_layout(n, 1, height, pos, &next);
+	for (i = 1; i <= n; i++) {
+		veb_node_t *node = &nodes[pos[i]];
+
+		node->key = eyt[i];
+		node->left = ((i << 1) <= n) ? pos[i << 1] : 0;
+		node->right = ((i << 1) + 1 <= n) ? pos[(i << 1) + 1] : 0;
+	}
+	free(pos);
+	return true;
+}
+
+static inline bool OPTIMIZE3 veb_find(const veb_node_t *nodes, const uint32_t key)
+{
+	register uint32_t i = 1;
+
+	while (i) {
+		const veb_node_t *node = &nodes[i];
+
+		if (node->key == key)
+			return true;
+		i = (key < node->key) ? node->left : node->right;
+	}
+	return false;
+}
+
+static size_t OPTIMIZE3 veb_scan(const veb_node_t *nodes, const uint32_t key, const size_t len, uint64_t *sum)
+{
+	uint32_t stack[64], i = 1;
+	size_t sp = 0, count = 0;
+
+	/* stack the nodes >= key on the search path */
+	while (i) {
+		const veb_node_t *node = &nodes[i];
+
+		if (node->key >= key) {
+			stack[sp++] = i;
+			if (node->key == key)
+				break;
+			i = node->left;
+		} else {
+			i = node->right;
+		}
+	}
+	/* in-order from there */
+	while (sp && (count < len)) {
+		i = stack[--sp];
+		*sum += nodes[i].key;
+		count++;
+		for (i = nodes[i].right; i; i = nodes[i].left)
+			stack[sp++] = i;
+	}
+	return count;
+}
+
+static int stress_tree_cmp_uint32(const void *p1, const void *p2)
+{
+	const uint32_t v1 = *(const uint32_t *)p1;
+	const uint32_t v2 = *(const uint32_t *)p2;
+
+	return (v1 > v2) - (v1 < v2);
+}
+
+/*
+ *  stress_tree_sorted_keys()
+ *	the tree keys in sorted order, the keys are a permutation
+ *	of 0..n-1 but sort them anyway so the build cost is honest
+ */
+static uint32_t *stress_tree_sorted_keys(const struct tree_node *nodes, const size_t n)
+{
+	uint32_t *sorted;
+	size_t i;
+
+	sorted = malloc(n * sizeof(*sorted));
+	if (!sorted)
+		return NULL;
+	for (i = 0; i < n; i++)
+		sorted[i] = nodes[i].value;
+	qsort(sorted, n, sizeof(*sorted), stress_tree_cmp_uint32);
+	return sorted;
+}
+
+static void stress_tree_eytzinger(
+	const stress_args_t *args,
+	const size_t n,
+	struct tree_node *nodes,
+	stress_tree_metrics_t *metrics)
+{
+	size_t i;
+	struct tree_node *node;
+	uint32_t *sorted, *eyt;
+	uint64_t sum = 0;
+	double t;
+
+	eyt = malloc((n + 1) * sizeof(*eyt));
+	if (!eyt) {
+		pr_fail("%s: cannot allocate %zd Eytzinger tree keys\n", args->name, n);
+		return;
+	}
+
+	t = stress_time_now();
+	sorted = stress_tree_sorted_keys(nodes, n);
+	if (!sorted) {
+		pr_fail("%s: cannot allocate %zd sorted keys\n", args->name, n);
+		free(eyt);
+		return;
+	}
+	eyt[0] = 0;
+	eytzinger_build(eyt, sorted, n);
+	metrics->insert += stress_time_now() - t;
+	free(sorted);
+
+	/* Manditory forward tree check */
+	t = stress_time_now();
+PRAGMA_UNROLL_N(4)
+	for (node = nodes, i = 0; i < n; i++, node++) {
+		if (!eytzinger_find(eyt, n, node->value))
+			pr_fail("%s: eytzinger tree node #%zd not found\n",
+				args->name, i);
+	}
+	metrics->find += stress_time_now() - t;
+
+	t = stress_time_now();
+	for (node = nodes, i = 0; i < n; i += TREE_SCAN_LEN, node += TREE_SCAN_LEN) {
+		const size_t len = eytzinger_scan(eyt, n, node->value, TREE_SCAN_LEN, &sum);
+
+		if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+		    (len != STRESS_MINIMUM(TREE_SCAN_LEN, n - node->value)))
+			pr_fail("%s: eytzinger tree range scan from %" PRIu32 " returned %zd keys\n",
+				args->name, node->value, len);
+		metrics->scans += 1.0;
+	}
+	metrics->scan += stress_time_now() - t;
+	stress_uint64_put(sum);
+
+	if (g_opt_flags & OPT_FLAGS_VERIFY) {
+		/* optional random find */
+		for (i = 0; i < n; i++) {
+			const size_t j = stress_mwc32modn(n);
+
+			if (!eytzinger_find(eyt, n, nodes[j].value))
+				pr_fail("%s: eytzinger tree node #%zd not found\n",
+					args->name, j);
+		}
+	}
+	t = stress_time_now();
+	free(eyt);
+	metrics->remove += stress_time_now() - t;
+	metrics->count += (double)n;
+}
+
+static void stress_tree_veb(
+	const stress_args_t *args,
+	const size_t n,
+	struct tree_node *nodes,
+	stress_tree_metrics_t *metrics)
+{
+	size_t i;
+	struct tree_node *node;
+	uint32_t *sorted, *eyt;
+	veb_node_t *veb;
+	uint64_t sum = 0;
+	double t;
+
+	eyt = malloc((n + 1) * sizeof(*eyt));
+	veb = malloc((n + 1) * sizeof(*veb));
+	if (!eyt || !veb) {
+		pr_fail("%s: cannot allocate %zd van Emde Boas tree nodes\n", args->name, n);
+		free(veb);
+		free(eyt);
+		return;
+	}
+
+	t = stress_time_now();
+	sorted = stress_tree_sorted_keys(nodes, n);
+	if (!sorted) {
+		pr_fail("%s: cannot allocate %zd sorted keys\n", args->name, n);
+		free(veb);
+		free(eyt);
+		return;
+	}
+	eytzinger_build(eyt, sorted, n);
+	free(sorted);
+	if (!veb_build(veb, eyt, n)) {
+		pr_fail("%s: cannot allocate van Emde Boas layout\n", args->name);
+		free(veb);
+		free(eyt);
+		return;
+	}
+	metrics->insert += stress_time_now() - t;
+	free(eyt);
+
+	/* Manditory forward tree check */
+	t = stress_time_now();
+PRAGMA_UNROLL_N(4)
+	for (node = nodes, i = 0; i < n; i++, node++) {
+		if (!veb_find(veb, node->value))
+			pr_fail("%s: veb tree node #%zd not found\n",
+				args->name, i);
+	}
+	metrics->find += stress_time_now() - t;
+
+	t = stress_time_now();
+	for (node = nodes, i = 0; i < n; i += TREE_SCAN_LEN, node += TREE_SCAN_LEN) {
+		const size_t len = veb_scan(veb, node->value, TREE_SCAN_LEN, &sum);
+
+		if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+		    (len != STRESS_MINIMUM(TREE_SCAN_LEN, n - node->value)))
+			pr_fail("%s: veb tree range scan from %" PRIu32 " returned %zd keys\n",
+				args->name, node->value, len);
+		metrics->scans += 1.0;
+	}
+	metrics->scan += stress_time_now() - t;
+	stress_uint64_put(sum);
+
+	if (g_opt_flags & OPT_FLAGS_VERIFY) {
+		/* optional random find */
+		for (i = 0; i < n; i++) {
+			const size_t j = stress_mwc32modn(n);
+
+			if (!veb_find(veb, nodes[j].value))
+				pr_fail("%s: veb tree node #%zd not found\n",
+					args->name, j);
+		}
+	}
+	t = stress_time_now();
+	free(veb);
+	metrics->remove += stress_time_now() - t;
+	metrics->count += (double)n;
+}
+
+/*
+ *  sorted_lower()
+ *	branchless binary search of a sorted array, index of the
+ *	first key >= key, n if there is none
+ */
+static inline size_t OPTIMIZE3 sorted_lower(const uint32_t *sorted, const size_t n, const uint32_t key)
+{
+	register const uint32_t *base = sorted;
+	register size_t len = n;
+
+	while (len > 1) {
+		const size_t half = len >> 1;
+
+		base = (base[half - 1] < key) ? base + half : base;
+		len -= half;
+	}
+	return (size_t)(base - sorted) + (*base < key);
+}
+
+#define TREE_SWEEP_LAYOUTS	(4)
+#define TREE_SWEEP_SIZES	(16)
+#define TREE_SWEEP_QUERIES	(1U << 18)
+
+static const char * const tree_sweep_layouts[TREE_SWEEP_LAYOUTS] = {
+	"sorted", "eytzinger", "veb", "bplus"
+};
+
+typedef struct {
+	double lookups;		/* total lookups */
+	double duration;	/* total lookup duration */
+	double misses;		/* total cache misses in lookups */
+	double scans;		/* total range scans */
+	double scan;		/* total range scan duration */
+} stress_tree_sweep_point_t;
+
+/*
+ *  stress_tree_perf_open()
+ *	open a user space cache miss counter for this process,
+ *	returns -1 if there is none
+ */
+static int stress_tree_perf_open(void)
+{
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open) &&	\
+    defined(HAVE_SYSCALL)
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static inline uint64_t stress_tree_perf_read(const int fd)
+{
+	uint64_t count = 0;
+
+	if ((fd < 0) || (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)))
+		return 0;
+	return count;
+}
+
+/*
+ *  stress_tree_sweep_lookup()
+ *	look up all the queries in one layout, returns the
+ *	number found
+ */
+static size_t OPTIMIZE3 stress_tree_sweep_lookup(
+	const int layout,
+	const size_t n,
+	const uint32_t *sorted,
+	const uint32_t *eyt,
+	const veb_node_t *veb,
+	const bplus_tree_t *bplus,
+	const uint32_t *queries)
+{
+	register size_t i, found = 0;
+
+	switch (layout) {
+	case 0:
+		for (i = 0; i < TREE_SWEEP_QUERIES; i++) {
+			const size_t j = sorted_lower(sorted, n, queries[i]);
+
+			found += (j < n) && (sorted[j] == queries[i]);
+		}
+		break;
+	case 1:
+		for (i = 0; i < TREE_SWEEP_QUERIES; i++)
+			found += eytzinger_find(eyt, n, queries[i]);
+		break;
+	case 2:
+		for (i = 0; i < TREE_SWEEP_QUERIES; i++)
+			found += veb_find(veb, queries[i]);
+		break;
+	default:
+		for (i = 0; i < TREE_SWEEP_QUERIES; i++)
+			found += bplus_find(bplus, queries[i]);
+		break;
+	}
+	return found;
+}
+
+/*
+ *  stress_tree_sweep_scan()
+ *	range scan from every 64th query in one layout, returns
+ *	the number of keys scanned
+ */
+static size_t OPTIMIZE3 stress_tree_sweep_scan(
+	const int layout,
+	const size_t n,
+	const uint32_t *sorted,
+	const uint32_t *eyt,
+	const veb_node_t *veb,
+	const bplus_tree_t *bplus,
+	const uint32_t *queries,
+	uint64_t *sum)
+{
+	size_t i, keys = 0;
+
+	for (i = 0; i < TREE_SWEEP_QUERIES; i += TREE_SCAN_LEN) {
+		size_t j, k;
+
+		switch (layout) {
+		case 0:
+			j = sorted_lower(sorted, n, queries[i]);
+			for (k = 0; (k < TREE_SCAN_LEN) && (j < n); k++, j++)
+				*sum += sorted[j];
+			keys += k;
+			break;
+		case 1:
+			keys += eytzinger_scan(eyt, n, queries[i], TREE_SCAN_LEN, sum);
+			break;
+		case 2:
+			keys += veb_scan(veb, queries[i], TREE_SCAN_LEN, sum);
+			break;
+		default:
+			keys += bplus_scan(bplus, queries[i], TREE_SCAN_LEN, sum);
+			break;
+		}
+	}
+	return keys;
+}
+
+/*
+ *  stress_tree_sweep_report()
+ *	log lookups/sec, cache misses per lookup and range scans/sec
+ *	of each layout and size, metrics are the lookups per second
+ *	of each layout and size
+ */
+static void stress_tree_sweep_report(
+	const stress_args_t *args,
+	stress_tree_sweep_point_t points[TREE_SWEEP_SIZES][TREE_SWEEP_LAYOUTS],
+	const size_t *sizes,
+	const size_t n_sizes,
+	const bool have_perf)
+{
+	size_t s, m = 0;
+	int l;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %9s %11s %11s %11s %11s  (Mlookups/sec%s, Mscans/sec)\n",
+			args->name, "keys", tree_sweep_layouts[0], tree_sweep_layouts[1],
+			tree_sweep_layouts[2], tree_sweep_layouts[3],
+			have_perf ? ", cache misses per lookup" : "");
+	}
+	for (s = 0; s < n_sizes; s++) {
+		char rates[TREE_SWEEP_LAYOUTS][16], misses[TREE_SWEEP_LAYOUTS][16];
+		char scans[TREE_SWEEP_LAYOUTS][16];
+		bool valid = false;
+
+		for (l = 0; l < TREE_SWEEP_LAYOUTS; l++) {
+			const stress_tree_sweep_point_t *point = &points[s][l];
+
+			(void)shim_strlcpy(rates[l], "-", sizeof(rates[l]));
+			(void)shim_strlcpy(misses[l], "-", sizeof(misses[l]));
+			(void)shim_strlcpy(scans[l], "-", sizeof(scans[l]));
+			if ((point->duration <= 0.0) || (point->lookups <= 0.0))
+				continue;
+			valid = true;
+			(void)snprintf(rates[l], sizeof(rates[l]), "%.2f",
+				(point->lookups / point->duration) / 1000000.0);
+			(void)snprintf(misses[l], sizeof(misses[l]), "%.3f",
+				point->misses / point->lookups);
+			if (point->scan > 0.0)
+				(void)snprintf(scans[l], sizeof(scans[l]), "%.3f",
+					(point->scans / point->scan) / 1000000.0);
+		}
+		if (!valid)
+			continue;
+		if (args->instance == 0) {
+			pr_inf("%s: %9zu %11s %11s %11s %11s\n", args->name, sizes[s],
+				rates[0], rates[1], rates[2], rates[3]);
+			if (have_perf)
+				pr_inf("%s: %9s %11s %11s %11s %11s\n", args->name, "",
+					misses[0], misses[1], misses[2], misses[3]);
+			pr_inf("%s: %9s %11s %11s %11s %11s\n", args->name, "",
+				scans[0], scans[1], scans[2], scans[3]);
+		}
+		for (l = 0; l < TREE_SWEEP_LAYOUTS; l++) {
+			const stress_tree_sweep_point_t *point = &points[s][l];
+			char str[64];
+
+			if (point->duration <= 0.0)
+				continue;
+			(void)snprintf(str, sizeof(str), "%s lookups per sec at %zu keys",
+				tree_sweep_layouts[l], sizes[s]);
+			stress_metrics_set(args, m++, str, point->lookups / point->duration);
+		}
+	}
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_tree_sweep()
+ *	build each static layout and a bulk loaded B+tree over key
+ *	counts from the L2 cache size up to 10 times the LLC size and
+ *	time random lookups and range scans, repeating until the run
+ *	ends, the keys are the even numbers so half the 32 bit space
+ *	misses
+ */
+static int stress_tree_sweep(const stress_args_t *args)
+{
+	stress_tree_sweep_point_t points[TREE_SWEEP_SIZES][TREE_SWEEP_LAYOUTS];
+	size_t sizes[TREE_SWEEP_SIZES], n_sizes = 0, s, i, l2_size = 0, llc_size = 0, line_size = 0;
+	uint32_t *queries;
+	uint64_t sum = 0;
+	int rc = EXIT_SUCCESS, fd;
+
+	stress_cpu_cache_get_level_size(2, &l2_size, &line_size);
+	stress_cpu_cache_get_llc_size(&llc_size, &line_size);
+	if (l2_size == 0)
+		l2_size = 256 * KB;
+	if (llc_size < l2_size)
+		llc_size = STRESS_MAXIMUM(l2_size, 8 * MB);
+	for (s = l2_size / sizeof(uint32_t);
+	     (s <= (10 * llc_size) / sizeof(uint32_t)) && (s <= MAX_TREE_SIZE) &&
+	     (n_sizes < TREE_SWEEP_SIZES); s <<= 1)
+		sizes[n_sizes++] = s;
+
+	queries = malloc(TREE_SWEEP_QUERIES * sizeof(*queries));
+	if (!queries) {
+		pr_inf_skip("%s: cannot allocate %u queries, skipping stressor\n",
+			args->name, TREE_SWEEP_QUERIES);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(points, 0, sizeof(points));
+
+	fd = stress_tree_perf_open();
+	if ((fd < 0) && (args->instance == 0))
+		pr_inf("%s: cannot open a hardware cache miss counter, "
+			"cache misses will not be reported\n", args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	while ((rc == EXIT_SUCCESS) && keep_stressing(args)) {
+		for (s = 0; (s < n_sizes) && keep_stressing(args); s++) {
+			const size_t n = sizes[s];
+			uint32_t *sorted, *eyt;
+			veb_node_t *veb;
+			bplus_tree_t bplus;
+			int l;
+
+			sorted = malloc(n * sizeof(*sorted));
+			eyt = malloc((n + 1) * sizeof(*eyt));
+			veb = malloc((n + 1) * sizeof(*veb));
+			if (!sorted || !eyt || !veb || (bplus_init(&bplus, tree_node_size, n) < 0)) {
+				if (args->instance == 0)
+					pr_inf("%s: cannot allocate layouts for %zu keys, "
+						"skipping larger sizes\n", args->name, n);
+				free(veb);
+				free(eyt);
+				free(sorted);
+				n_sizes = s;
+				break;
+			}
+			for (i = 0; i < n; i++)
+				sorted[i] = (uint32_t)(i << 1);
+			eyt[0] = 0;
+			eytzinger_build(eyt, sorted, n);
+			if (!veb_build(veb, eyt, n) || !bplus_bulk_load(&bplus, sorted, n)) {
+				pr_fail("%s: cannot build layouts for %zu keys\n", args->name, n);
+				rc = EXIT_FAILURE;
+			}
+			for (i = 0; i < TREE_SWEEP_QUERIES; i++)
+				queries[i] = (uint32_t)(stress_mwc32modn((uint32_t)n) << 1);
+
+			for (l = 0; (rc == EXIT_SUCCESS) && (l < TREE_SWEEP_LAYOUTS); l++) {
+				stress_tree_sweep_point_t *point = &points[s][l];
+				const uint64_t misses = stress_tree_perf_read(fd);
+				double t = stress_time_now();
+				size_t found;
+
+				found = stress_tree_sweep_lookup(l, n, sorted, eyt, veb, &bplus, queries);
+				point->duration += stress_time_now() - t;
+				point->misses += (double)(stress_tree_perf_read(fd) - misses);
+				point->lookups += (double)TREE_SWEEP_QUERIES;
+				if (found != TREE_SWEEP_QUERIES) {
+					pr_fail("%s: %s layout of %zu keys found %zu of %u keys\n",
+						args->name, tree_sweep_layouts[l], n,
+						found, TREE_SWEEP_QUERIES);
+					rc = EXIT_FAILURE;
+				}
+
+				t = stress_time_now();
+				(void)stress_tree_sweep_scan(l, n, sorted, eyt, veb, &bplus, queries, &sum);
+				point->scan += stress_time_now() - t;
+				point->scans += (double)(TREE_SWEEP_QUERIES / TREE_SCAN_LEN);
+				add_counter(args, 1);
+			}
+			bplus_deinit(&bplus);
+			free(veb);
+			free(eyt);
+			free(sorted);
+		}
+	}
+	stress_uint64_put(sum);
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_tree_sweep_report(args, points, sizes, n_sizes, fd >= 0);
+
+	if (fd >= 0)
+		(void)close(fd);
+	free(queries);
+
+	return rc;
+}
+
 static void stress_tree_all(
 	const stress_args_t *args,
 	const size_t n,
@@ -849,6 +1992,9 @@ static const stress_tree_method_info_t stress_tree_methods[] = {
 	{ "splay",	stress_tree_splay },
 #endif
 	{ "btree",	stress_tree_btree },
+	{ "bplus",	stress_tree_bplus },
+	{ "eytzinger",	stress_tree_eytzinger },
+	{ "veb",	stress_tree_veb },
 };
 
 static stress_tree_metrics_t stress_tree_metrics[SIZEOF_ARRAY(stress_tree_methods)];
@@ -894,7 +2040,9 @@ static int stress_set_tree_method(const char *name)
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_tree_method,	stress_set_tree_method },
+	{ OPT_tree_node_size,	stress_set_tree_node_size },
 	{ OPT_tree_size,	stress_set_tree_size },
+	{ OPT_tree_sweep,	stress_set_tree_sweep },
 	{ 0,			NULL }
 };
 
@@ -926,6 +2074,8 @@ PRAGMA_UNROLL_N(4)
 static int stress_tree(const stress_args_t *args)
 {
 	uint64_t tree_size = DEFAULT_TREE_SIZE;
+	uint64_t tree_node_size_opt = DEFAULT_TREE_NODE_SIZE;
+	bool tree_sweep = false;
 	struct tree_node *nodes;
 	size_t n, i, j, tree_method = 0;
 	struct sigaction old_action;
@@ -937,10 +2087,18 @@ static int stress_tree(const stress_args_t *args)
 		stress_tree_metrics[i].insert = 0.0;
 		stress_tree_metrics[i].find = 0.0;
 		stress_tree_metrics[i].remove = 0.0;
+		stress_tree_metrics[i].scan = 0.0;
+		stress_tree_metrics[i].scans = 0.0;
 		stress_tree_metrics[i].count = 0.0;
 	}
 
 	(void)stress_get_setting("tree-method", &tree_method);
+	(void)stress_get_setting("tree-node-size", &tree_node_size_opt);
+	(void)stress_get_setting("tree-sweep", &tree_sweep);
+	tree_node_size = (size_t)tree_node_size_opt;
+
+	if (tree_sweep)
+		return stress_tree_sweep(args);
 
 	func = stress_tree_methods[tree_method].func;
 	metrics = &stress_tree_metrics[tree_method];
@@ -958,6 +2116,15 @@ static int stress_tree(const stress_args_t *args)
 			"skipping stressor\n", args->name, n);
 		return EXIT_NO_RESOURCE;
 	}
+	if (g_opt_flags & OPT_FLAGS_ARENA) {
+		btree_arena = stress_arena_create(0);
+		if (!btree_arena) {
+			pr_inf_skip("%s: cannot allocate arena, skipping stressor\n",
+				args->name);
+			free(nodes);
+			return EXIT_NO_RESOURCE;
+		}
+	}
 
 	ret = sigsetjmp(jmp_env, 1);
 	if (ret) {
@@ -968,6 +2135,7 @@ static int stress_tree(const stress_args_t *args)
 		goto tidy;
 	}
 	if (stress_sighandler(args->name, SIGALRM, stress_tree_handler, &old_action) < 0) {
+		stress_arena_destroy(btree_arena);
 		free(nodes);
 		return EXIT_FAILURE;
 	}
@@ -1003,8 +2171,18 @@ tidy:
 			stress_metrics_set(args, j, msg, rate);
 			j++;
 		}
+		if ((stress_tree_metrics[i].scan > 0.0) && (stress_tree_metrics[i].scans > 0.0)) {
+			double rate = stress_tree_metrics[i].scans / stress_tree_metrics[i].scan;
+			char msg[64];
+
+			(void)snprintf(msg, sizeof(msg), "%s tree range scans per sec", stress_tree_methods[i].name);
+			stress_metrics_set(args, j, msg, rate);
+			j++;
+		}
 	}
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_arena_destroy(btree_arena);
+	btree_arena = NULL;
 	free(nodes);
 
 	return EXIT_SUCCESS;
@@ -25,6 +25,12 @@
 #include "core-asm-x86.h"
 #include "core-cpu.h"
 
+#define TSC_COST_READS		(65536)	/* reads per read cost sample */
+#define TSC_COST_SAMPLES	(3)	/* read cost samples, fastest is used */
+#define TSC_SKEW_CPUS		(64)	/* max cpus in skew check, more are sampled */
+#define TSC_SKEW_ROUNDS		(2000)	/* ping-pong round trips per cpu pair */
+#define TSC_SKEW_YIELD		(1U << 16)	/* spins before yielding */
+
 #if defined(HAVE_SYS_PLATFORM_PPC_H)
 #include <sys/platform/ppc.h>
 #endif
@@ -411,6 +417,284 @@ do {			\
 
 #endif
 
+#if defined(HAVE_STRESS_TSC_CAPABILITY) &&	\
+    defined(STRESS_ARCH_X86)
+#define HAVE_STRESS_TSC_READ_COST
+
+/*
+ *  stress_tsc_read_cost()
+ *	fastest of TSC_COST_SAMPLES of the nanoseconds per rdtsc,
+ *	rdtscp or lfence+rdtsc read
+ */
+static double stress_tsc_read_cost(const int method)
+{
+	double best = 0.0;
+	int i, j;
+
+	for (i = 0; i < TSC_COST_SAMPLES; i++) {
+		double t, ns;
+
+		t = stress_time_now();
+		switch (method) {
+		default:
+		case 0:
+			for (j = 0; j < TSC_COST_READS; j++)
+				(void)rdtsc();
+			break;
+#if defined(HAVE_ASM_X86_RDTSCP)
+		case 1:
+			for (j = 0; j < TSC_COST_READS; j++) {
+				uint32_t aux;
+
+				(void)stress_asm_x86_rdtscp(&aux);
+			}
+			break;
+#endif
+#if defined(HAVE_STRESS_TSC_LFENCE)
+		case 2:
+			for (j = 0; j < TSC_COST_READS; j++) {
+				lfence();
+				(void)rdtsc();
+			}
+			break;
+#endif
+		}
+		ns = (stress_time_now() - t) * STRESS_DBL_NANOSECOND / (double)TSC_COST_READS;
+		if ((best <= 0.0) || (ns < best))
+			best = ns;
+	}
+	return best;
+}
+
+/*
+ *  stress_tsc_read_costs()
+ *	set metrics of the cost of the rdtsc, rdtscp and
+ *	lfence+rdtsc ways of reading the TSC
+ */
+static void stress_tsc_read_costs(const stress_args_t *args, size_t *idx)
+{
+	const double ns_rdtsc = stress_tsc_read_cost(0);
+
+	stress_metrics_set(args, (*idx)++, "nanosecs per rdtsc", ns_rdtsc);
+#if defined(HAVE_ASM_X86_RDTSCP)
+	if (stress_cpu_x86_has_rdtscp())
+		stress_metrics_set(args, (*idx)++, "nanosecs per rdtscp", stress_tsc_read_cost(1));
+#endif
+#if defined(HAVE_STRESS_TSC_LFENCE)
+	stress_metrics_set(args, (*idx)++, "nanosecs per lfence+rdtsc", stress_tsc_read_cost(2));
+#endif
+}
+#endif
+
+#if defined(HAVE_STRESS_TSC_CAPABILITY) &&	\
+    defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_SCHED_GETAFFINITY) &&		\
+    defined(HAVE_SCHED_SETAFFINITY) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+#define HAVE_STRESS_TSC_SKEW
+
+/* handshake between a pair of threads on different cpus */
+typedef struct {
+	uint64_t line ALIGN64;		/* handshake sequence */
+	uint64_t tsc;			/* pong thread TSC at handshake */
+	bool stop ALIGN64;		/* tell the pong thread to stop */
+	int pinned;			/* 0 pinning, 1 pinned, -1 failed */
+	int32_t cpu;			/* pong thread cpu */
+} stress_tsc_pingpong_t;
+
+/*
+ *  rdtsc_ordered()
+ *	read the TSC after all earlier loads have completed
+ */
+static inline uint64_t rdtsc_ordered(void)
+{
+#if defined(HAVE_STRESS_TSC_LFENCE)
+	lfence();
+#endif
+	return rdtsc();
+}
+
+/*
+ *  stress_tsc_pin()
+ *	pin the calling thread to a cpu
+ */
+static int stress_tsc_pin(const int32_t cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET((int)cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_tsc_spin()
+ *	spin until the handshake line is val, returns false if
+ *	the spin has to be abandoned
+ */
+static inline bool stress_tsc_spin(stress_tsc_pingpong_t *pp, const uint64_t val)
+{
+	uint32_t spins = 0;
+
+	while (__atomic_load_n(&pp->line, __ATOMIC_ACQUIRE) != val) {
+		if (UNLIKELY(++spins >= TSC_SKEW_YIELD)) {
+			spins = 0;
+			if (__atomic_load_n(&pp->stop, __ATOMIC_RELAXED) ||
+			    !keep_stressing_flag())
+				return false;
+			(void)shim_sched_yield();
+		}
+	}
+	return true;
+}
+
+/*
+ *  stress_tsc_pong()
+ *	pong thread, read the TSC on each odd handshake value and
+ *	reply with the next even value
+ */
+static void *stress_tsc_pong(void *arg)
+{
+	static void *nowt = NULL;
+	stress_tsc_pingpong_t *pp = (stress_tsc_pingpong_t *)arg;
+	uint64_t val = 1;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	__atomic_store_n(&pp->pinned, stress_tsc_pin(pp->cpu) < 0 ? -1 : 1, __ATOMIC_RELEASE);
+
+	while (stress_tsc_spin(pp, val)) {
+		__atomic_store_n(&pp->tsc, rdtsc_ordered(), __ATOMIC_RELAXED);
+		__atomic_store_n(&pp->line, val + 1, __ATOMIC_RELEASE);
+		val += 2;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_tsc_pair()
+ *	estimate the TSC offset of cpu_b relative to cpu_a, a TSC read
+ *	on cpu_b between two reads on cpu_a bounds the offset, the
+ *	tightest bounds over TSC_SKEW_ROUNDS handshakes are used and
+ *	the offset is their midpoint, returns false if not measurable
+ */
+static bool stress_tsc_pair(
+	const int32_t cpu_a,
+	const int32_t cpu_b,
+	int64_t *offset,
+	int64_t *uncertainty)
+{
+	stress_tsc_pingpong_t *pp;
+	pthread_t pthread;
+	int64_t fwd = INT64_MAX, back = INT64_MAX;
+	uint64_t val = 0;
+	int i, ret;
+
+	if (stress_tsc_pin(cpu_a) < 0)
+		return false;
+	pp = (stress_tsc_pingpong_t *)mmap(NULL, sizeof(*pp), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pp == MAP_FAILED)
+		return false;
+	pp->line = 0;
+	pp->tsc = 0;
+	pp->stop = false;
+	pp->pinned = 0;
+	pp->cpu = cpu_b;
+
+	ret = pthread_create(&pthread, NULL, stress_tsc_pong, (void *)pp);
+	if (ret) {
+		(void)munmap((void *)pp, sizeof(*pp));
+		return false;
+	}
+	while (__atomic_load_n(&pp->pinned, __ATOMIC_ACQUIRE) == 0)
+		(void)shim_sched_yield();
+
+	if (pp->pinned > 0) {
+		for (i = 0; i < TSC_SKEW_ROUNDS; i++, val += 2) {
+			uint64_t t_a1, t_a2, t_b;
+
+			t_a1 = rdtsc_ordered();
+			__atomic_store_n(&pp->line, val + 1, __ATOMIC_RELEASE);
+			if (!stress_tsc_spin(pp, val + 2))
+				break;
+			t_a2 = rdtsc_ordered();
+			t_b = __atomic_load_n(&pp->tsc, __ATOMIC_RELAXED);
+
+			/* offset <= t_b - t_a1 and offset >= -(t_a2 - t_b) */
+			fwd = STRESS_MINIMUM(fwd, (int64_t)(t_b - t_a1));
+			back = STRESS_MINIMUM(back, (int64_t)(t_a2 - t_b));
+		}
+	}
+	__atomic_store_n(&pp->stop, true, __ATOMIC_RELAXED);
+	(void)pthread_join(pthread, NULL);
+	(void)munmap((void *)pp, sizeof(*pp));
+
+	if ((fwd == INT64_MAX) || (back == INT64_MAX))
+		return false;
+	*offset = (fwd - back) / 2;
+	*uncertainty = (fwd + back) / 2;
+	return true;
+}
+
+/*
+ *  stress_tsc_skew()
+ *	measure the TSC offset of each cpu relative to the first
+ *	allowed cpu, report the maximum pairwise skew
+ */
+static void stress_tsc_skew(const stress_args_t *args, size_t *idx)
+{
+	cpu_set_t allowed;
+	int32_t cpus[CPU_SETSIZE];
+	uint32_t i, n = 0, n_cpus;
+	int64_t min_offset = 0, max_offset = 0, max_uncertainty = 0;
+	uint32_t measured = 0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return;
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET((int)i, &allowed))
+			cpus[n++] = (int32_t)i;
+	}
+	if (n < 2) {
+		pr_inf("%s: cross-cpu TSC skew needs at least 2 cpus, skipping skew check\n", args->name);
+		return;
+	}
+	n_cpus = STRESS_MINIMUM(n, TSC_SKEW_CPUS);
+
+	for (i = 1; keep_stressing_flag() && (i < n_cpus); i++) {
+		const int32_t cpu = cpus[((uint64_t)i * n) / n_cpus];
+		int64_t offset, uncertainty;
+
+		if (!stress_tsc_pair(cpus[0], cpu, &offset, &uncertainty))
+			continue;
+		pr_dbg("%s: cpu %" PRId32 " TSC offset from cpu %" PRId32 ": %" PRId64
+			" ticks (+/- %" PRId64 ")\n", args->name, cpu, cpus[0], offset, uncertainty);
+		if ((offset > uncertainty) || (-offset > uncertainty))
+			pr_inf("%s: cpu %" PRId32 " TSC is offset by %" PRId64 " ticks "
+				"(+/- %" PRId64 ") from cpu %" PRId32 "\n",
+				args->name, cpu, offset, uncertainty, cpus[0]);
+		min_offset = STRESS_MINIMUM(min_offset, offset);
+		max_offset = STRESS_MAXIMUM(max_offset, offset);
+		max_uncertainty = STRESS_MAXIMUM(max_uncertainty, uncertainty);
+		measured++;
+	}
+	(void)sched_setaffinity(0, sizeof(allowed), &allowed);
+
+	if (measured) {
+		pr_inf("%s: max cross-cpu TSC skew %" PRId64 " ticks (+/- %" PRId64 ") over %" PRIu32 " cpus\n",
+			args->name, max_offset - min_offset, max_uncertainty, measured + 1);
+		stress_metrics_set(args, (*idx)++, "ticks max cross-cpu TSC skew",
+			(double)(max_offset - min_offset));
+		stress_metrics_set(args, (*idx)++, "ticks cross-cpu TSC skew uncertainty",
+			(double)max_uncertainty);
+	}
+}
+#endif
+
 /*
  *  stress_tsc()
  *      stress Intel tsc instruction
@@ -431,6 +715,16 @@ static int stress_tsc(const stress_args_t *args)
 	if (tsc_supported) {
 		const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
 		double duration = 0.0, count;
+		size_t idx = 1;
+
+#if defined(HAVE_STRESS_TSC_READ_COST)
+		stress_tsc_read_costs(args, &idx);
+#endif
+#if defined(HAVE_STRESS_TSC_SKEW)
+		if (args->instance == 0)
+			stress_tsc_skew(args, &idx);
+#endif
+		(void)idx;
 
 		if (tsc_lfence) {
 #if defined(HAVE_STRESS_TSC_LFENCE)
@@ -20,6 +20,8 @@
 #include "stress-ng.h"
 #include "core-capabilities.h"
 #include "core-net.h"
+#include "core-uring.h"
+#include "io-uring.h"
 
 #if defined(HAVE_LINUX_IF_TUN_H)
 #include <linux/if_tun.h>
@@ -39,15 +41,106 @@ UNEXPECTED
 UNEXPECTED
 #endif
 
+#if defined(HAVE_NET_IF_ARP_H)
+#include <net/if_arp.h>
+#endif
+
+#if defined(HAVE_LINUX_UDP_H)
+#include <linux/udp.h>
+#endif
+
+#if defined(HAVE_SYS_UIO_H)
+#include <sys/uio.h>
+#endif
+
 #include <arpa/inet.h>
 
 #define PACKETS_TO_SEND		(64)
 
+#define TUN_BENCH_QUEUES_MAX	(64)
+#define TUN_BENCH_QUEUES_DEFAULT (4)
+#define TUN_BENCH_BATCH_MIN	(1)
+#define TUN_BENCH_BATCH_MAX	(256)
+#define TUN_BENCH_BATCH_DEFAULT	(32)
+#define TUN_BENCH_SIZE_MIN	(64)
+#define TUN_BENCH_SIZE_MAX	(1472)
+#define TUN_BENCH_SIZE_DEFAULT	(1400)
+#define TUN_BENCH_SLICE		(1.0)		/* seconds per configuration per round */
+#define TUN_BENCH_GSO_MAX	(65000)		/* largest UDP GSO super packet payload */
+#define TUN_BENCH_BUF_SIZE	(64 * KB)	/* packet read and socket buffers */
+#define TUN_BENCH_ETH_HLEN	(14)
+
+/* tun and tap write configurations, in the order they are benchmarked */
+#define TUN_BENCH_WRITE		(0)	/* write per packet, checksums in software */
+#define TUN_BENCH_URING		(1)	/* batches of io_uring writes, checksums in software */
+#define TUN_BENCH_VNET_CSUM	(2)	/* writev per packet with checksum offload */
+#define TUN_BENCH_VNET_GSO	(3)	/* UDP GSO super packets with checksum offload */
+#define TUN_BENCH_MAX		(4)
+
+static const char * const tun_bench_names[TUN_BENCH_MAX] = {
+	"plain",
+	"io_uring",
+	"vnet csum",
+	"vnet gso",
+};
+
+/* struct virtio_net_hdr, the header preceding packets with IFF_VNET_HDR */
+typedef struct {
+	uint8_t flags;
+	uint8_t gso_type;
+	uint16_t hdr_len;
+	uint16_t gso_size;
+	uint16_t csum_start;
+	uint16_t csum_offset;
+} stress_vnet_hdr_t;
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM	(1)
+#define VIRTIO_NET_HDR_GSO_NONE		(0)
+#define VIRTIO_NET_HDR_GSO_UDP_L4	(5)
+
+/* USO offloads were added in Linux 6.2 */
+#if !defined(TUN_F_USO4)
+#define TUN_F_USO4		(0x20)
+#endif
+#if !defined(TUN_F_USO6)
+#define TUN_F_USO6		(0x40)
+#endif
+
+/* device and traffic of one configuration */
+typedef struct {
+	size_t config;			/* TUN_BENCH_* configuration */
+	bool tap;			/* layer 2 tap rather than layer 3 tun */
+	bool vnet;			/* IFF_VNET_HDR */
+	uint8_t mac[6];			/* tap device MAC address */
+	uint8_t peer_mac[6];		/* made up MAC address of the peer */
+	struct in_addr local;		/* device address, the UDP sockets bind to this */
+	struct in_addr peer;		/* address the written packets come from */
+	int port;			/* UDP port of queue 0 */
+	size_t payload;			/* UDP payload bytes per packet */
+	size_t batch;			/* packets per batch */
+	char ifname[IFNAMSIZ];		/* device name */
+} stress_tun_bench_t;
+
+/* per configuration per queue results */
+typedef struct {
+	uint64_t in_pkts;		/* packets written to the queue */
+	uint64_t in_bytes;		/* bytes written to the queue */
+	uint64_t in_rcvd;		/* written packets received by the UDP socket */
+	uint64_t out_pkts;		/* packets read from the queue */
+	uint64_t out_bytes;		/* bytes read from the queue */
+	double secs;			/* time spent */
+	int err;			/* errno if the configuration cannot be used */
+} stress_tun_bench_result_t;
+
 static const stress_help_t help[] = {
-	{ NULL,	"tun N",	"start N workers exercising tun interface" },
-	{ NULL,	"tun-ops N",	"stop after N tun bogo operations" },
-	{ NULL, "tun-tap",	"use TAP interface instead of TUN" },
-	{ NULL,	NULL,		NULL }
+	{ NULL,	"tun N",		"start N workers exercising tun interface" },
+	{ NULL,	"tun-batch N",		"write N packets per batch in benchmark mode" },
+	{ NULL,	"tun-bench",		"compare multi-queue write, io_uring, vnet checksum and GSO packet rates" },
+	{ NULL,	"tun-bench-size N",	"send N bytes of UDP payload per packet in benchmark mode" },
+	{ NULL,	"tun-ops N",		"stop after N tun bogo operations" },
+	{ NULL,	"tun-queues N",		"use N device queues, one process per queue, in benchmark mode" },
+	{ NULL, "tun-tap",		"use TAP interface instead of TUN" },
+	{ NULL,	NULL,			NULL }
 };
 
 #if defined(HAVE_LINUX_IF_TUN_H) &&	\
@@ -90,6 +183,766 @@ static int stress_set_tun_tap(const char *opt)
 	return stress_set_setting_true("tun-tap", opt);
 }
 
+static int stress_set_tun_bench(const char *opt)
+{
+	return stress_set_setting_true("tun-bench", opt);
+}
+
+/*
+ *  stress_set_tun_queues()
+ *	set number of device queues in benchmark mode
+ */
+static int stress_set_tun_queues(const char *opt)
+{
+	uint32_t tun_queues;
+
+	tun_queues = stress_get_uint32(opt);
+	stress_check_range("tun-queues", (uint64_t)tun_queues, 1, TUN_BENCH_QUEUES_MAX);
+	return stress_set_setting("tun-queues", TYPE_ID_UINT32, &tun_queues);
+}
+
+/*
+ *  stress_set_tun_batch()
+ *	set number of packets per batch in benchmark mode
+ */
+static int stress_set_tun_batch(const char *opt)
+{
+	uint32_t tun_batch;
+
+	tun_batch = stress_get_uint32(opt);
+	stress_check_range("tun-batch", (uint64_t)tun_batch,
+		TUN_BENCH_BATCH_MIN, TUN_BENCH_BATCH_MAX);
+	return stress_set_setting("tun-batch", TYPE_ID_UINT32, &tun_batch);
+}
+
+/*
+ *  stress_set_tun_bench_size()
+ *	set UDP payload size per packet in benchmark mode
+ */
+static int stress_set_tun_bench_size(const char *opt)
+{
+	uint32_t tun_bench_size;
+
+	tun_bench_size = stress_get_uint32(opt);
+	stress_check_range("tun-bench-size", (uint64_t)tun_bench_size,
+		TUN_BENCH_SIZE_MIN, TUN_BENCH_SIZE_MAX);
+	return stress_set_setting("tun-bench-size", TYPE_ID_UINT32, &tun_bench_size);
+}
+
+/*
+ *  stress_tun_bench_csum_add()
+ *	add 16 bit big endian words of buf to a ones complement sum
+ */
+static uint32_t OPTIMIZE3 stress_tun_bench_csum_add(
+	const uint8_t *buf,
+	const size_t len,
+	uint32_t sum)
+{
+	size_t i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		sum += ((uint32_t)buf[i] << 8) | (uint32_t)buf[i + 1];
+	if (len & 1)
+		sum += (uint32_t)buf[len - 1] << 8;
+	return sum;
+}
+
+/*
+ *  stress_tun_bench_csum_fold()
+ *	fold a ones complement sum to 16 bits
+ */
+static inline uint16_t stress_tun_bench_csum_fold(uint32_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return (uint16_t)sum;
+}
+
+static inline void stress_tun_bench_put16(uint8_t *buf, const uint16_t val)
+{
+	buf[0] = (uint8_t)(val >> 8);
+	buf[1] = (uint8_t)val;
+}
+
+/*
+ *  stress_tun_bench_frame()
+ *	fill in the Ethernet (tap only), IPv4 and UDP headers of a
+ *	packet from the peer to the local address carrying len bytes
+ *	of UDP payload, the UDP checksum is left zero
+ */
+static void stress_tun_bench_frame(
+	const stress_tun_bench_t *bench,
+	uint8_t *frame,
+	const uint16_t port,
+	const size_t len)
+{
+	const size_t l2 = bench->tap ? TUN_BENCH_ETH_HLEN : 0;
+	uint8_t *ip = frame + l2, *udp = ip + 20;
+
+	if (l2) {
+		(void)memcpy(frame, bench->mac, 6);
+		(void)memcpy(frame + 6, bench->peer_mac, 6);
+		frame[12] = 0x08;	/* ETH_P_IP */
+		frame[13] = 0x00;
+	}
+	(void)memset(ip, 0, 28);
+	ip[0] = 0x45;			/* IPv4, 20 byte header */
+	stress_tun_bench_put16(ip + 2, (uint16_t)(28 + len));
+	ip[6] = 0x40;			/* don't fragment */
+	ip[8] = 64;			/* TTL */
+	ip[9] = IPPROTO_UDP;
+	(void)memcpy(ip + 12, &bench->peer, 4);
+	(void)memcpy(ip + 16, &bench->local, 4);
+	stress_tun_bench_put16(ip + 10,
+		(uint16_t)~stress_tun_bench_csum_fold(stress_tun_bench_csum_add(ip, 20, 0)));
+	stress_tun_bench_put16(udp, port);
+	stress_tun_bench_put16(udp + 2, port);
+	stress_tun_bench_put16(udp + 4, (uint16_t)(8 + len));
+}
+
+/*
+ *  stress_tun_bench_csum()
+ *	stamp a sequence number in the first UDP payload of a frame and
+ *	set the UDP checksum, the full checksum is calculated in software
+ *	or with partial set only the pseudo header sum is filled in and
+ *	the kernel is told the checksum is still to be completed
+ */
+static inline void OPTIMIZE3 stress_tun_bench_csum(
+	const stress_tun_bench_t *bench,
+	uint8_t *frame,
+	const uint64_t seq,
+	const bool partial)
+{
+	uint8_t *ip = frame + (bench->tap ? TUN_BENCH_ETH_HLEN : 0), *udp = ip + 20;
+	const uint32_t udp_len = ((uint32_t)udp[4] << 8) | (uint32_t)udp[5];
+	uint32_t sum;
+
+	(void)memcpy(udp + 8, &seq, sizeof(seq));
+	sum = stress_tun_bench_csum_add(ip + 12, 8, IPPROTO_UDP + udp_len);
+	udp[6] = 0;
+	udp[7] = 0;
+	if (partial) {
+		stress_tun_bench_put16(udp + 6, stress_tun_bench_csum_fold(sum));
+	} else {
+		uint16_t csum = (uint16_t)~stress_tun_bench_csum_fold(
+			stress_tun_bench_csum_add(udp, udp_len, sum));
+
+		stress_tun_bench_put16(udp + 6, csum ? csum : 0xffff);
+	}
+}
+
+/*
+ *  stress_tun_bench_vnet_hdr()
+ *	fill in the virtio net header that precedes each packet
+ *	with IFF_VNET_HDR, segs > 1 makes a UDP GSO super packet
+ */
+static void stress_tun_bench_vnet_hdr(
+	const stress_tun_bench_t *bench,
+	stress_vnet_hdr_t *hdr,
+	const size_t segs)
+{
+	const uint16_t l2 = bench->tap ? TUN_BENCH_ETH_HLEN : 0;
+
+	(void)memset(hdr, 0, sizeof(*hdr));
+	hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+	hdr->csum_start = (uint16_t)(l2 + 20);
+	hdr->csum_offset = 6;
+	if (segs > 1) {
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_UDP_L4;
+		hdr->gso_size = (uint16_t)bench->payload;
+		hdr->hdr_len = (uint16_t)(l2 + 28);
+	}
+}
+
+#if defined(STRESS_URING) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+/*
+ *  stress_tun_bench_uring_write()
+ *	write n packets of len bytes from the slots of buf with one
+ *	io_uring_enter, returns the number of packets written or -1
+ */
+static int stress_tun_bench_uring_write(
+	stress_uring_t *ring,
+	const int fd,
+	uint8_t *buf,
+	const size_t slot_size,
+	const size_t len,
+	const size_t n)
+{
+	unsigned tail = *ring->sq_tail, head;
+	size_t i;
+	int ret, written = 0;
+
+	for (i = 0; i < n; i++) {
+		const unsigned idx = tail & *ring->sq_mask;
+		struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+		(void)memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = fd;
+		sqe->addr = (uintptr_t)(buf + (i * slot_size));
+		sqe->len = (uint32_t)len;
+		sqe->off = (uint64_t)-1;
+		ring->sq_array[idx] = idx;
+		tail++;
+	}
+	shim_mb();
+	*ring->sq_tail = tail;
+	shim_mb();
+
+	ret = stress_uring_enter(ring, (unsigned)n, (unsigned)n);
+	if (ret < 0)
+		return -1;
+
+	head = *ring->cq_head;
+	for (;;) {
+		shim_mb();
+		if (head == *ring->cq_tail)
+			break;
+		if (ring->cqes[head & *ring->cq_mask].res > 0)
+			written++;
+		head++;
+	}
+	*ring->cq_head = head;
+	shim_mb();
+
+	return written;
+}
+#endif
+
+/*
+ *  stress_tun_bench_queue()
+ *	for one time slice write batches of UDP packets into a queue of
+ *	the device for delivery to a local UDP socket and read back the
+ *	packets that socket sends to the peer, the flow is steered back
+ *	to the queue that wrote it
+ */
+static void stress_tun_bench_queue(
+	const stress_args_t *args,
+	const stress_tun_bench_t *bench,
+	const int fd,
+	const uint32_t queue,
+	stress_tun_bench_result_t *result)
+{
+	const size_t l2 = bench->tap ? TUN_BENCH_ETH_HLEN : 0;
+	const size_t vhdr = bench->vnet ? sizeof(stress_vnet_hdr_t) : 0;
+	const bool gso = (bench->config == TUN_BENCH_VNET_GSO);
+	const size_t segs = gso ? STRESS_MINIMUM(bench->batch, TUN_BENCH_GSO_MAX / bench->payload) : 1;
+	const size_t pkts = gso ? 1 : bench->batch;
+	const size_t len = l2 + 28 + (segs * bench->payload);
+	const size_t slot_size = (vhdr + len + 63) & ~(size_t)63;
+	const size_t buf_size = (pkts * slot_size) + (2 * TUN_BENCH_BUF_SIZE);
+	const uint16_t port = (uint16_t)(bench->port + (int)queue);
+	struct sockaddr_in addr;
+	uint8_t *buf, *rbuf, *sbuf;
+	uint64_t seq = 0;
+	size_t i;
+	double t_start, t_end;
+	int sfd, one = 1, rcvbuf = 4 * MB;
+#if defined(STRESS_URING) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+	stress_uring_t ring;
+#endif
+
+	stress_parent_died_alarm();
+	(void)sched_settings_apply(true);
+
+	buf = (uint8_t *)mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		result->err = ENOMEM;
+		return;
+	}
+	rbuf = buf + (pkts * slot_size);
+	sbuf = rbuf + TUN_BENCH_BUF_SIZE;
+
+	sfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sfd < 0) {
+		result->err = errno;
+		goto unmap;
+	}
+	(void)setsockopt(sfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr = bench->local;
+	if ((setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) ||
+	    (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+		result->err = errno;
+		goto close_sfd;
+	}
+	addr.sin_addr = bench->peer;
+	if (connect(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		result->err = errno;
+		goto close_sfd;
+	}
+#if defined(UDP_SEGMENT) &&	\
+    defined(UDP_GRO)
+	if (gso) {
+		const int gso_size = (int)bench->payload;
+
+		/* coalesce received segments and send segments as one super packet */
+		if ((setsockopt(sfd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0) ||
+		    (setsockopt(sfd, IPPROTO_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)) < 0)) {
+			result->err = errno;
+			goto close_sfd;
+		}
+	}
+#endif
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+		result->err = errno;
+		goto close_sfd;
+	}
+#if defined(STRESS_URING) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+	if (bench->config == TUN_BENCH_URING) {
+		if (stress_uring_setup(args, &ring, (unsigned)pkts) < 0) {
+			result->err = errno ? errno : ENOSYS;
+			goto close_sfd;
+		}
+	}
+#endif
+
+	for (i = 0; i < pkts; i++) {
+		uint8_t *slot = buf + (i * slot_size);
+
+		if (vhdr)
+			stress_tun_bench_vnet_hdr(bench, (stress_vnet_hdr_t *)slot, segs);
+		stress_tun_bench_frame(bench, slot + vhdr, port, segs * bench->payload);
+		stress_tun_bench_csum(bench, slot + vhdr, seq, bench->vnet);
+	}
+	(void)memset(sbuf, 0, TUN_BENCH_BUF_SIZE);
+
+	t_start = stress_time_now();
+	t_end = t_start + TUN_BENCH_SLICE;
+	do {
+		ssize_t n;
+		int written = 0;
+
+		/* ingress, packets written to the queue are received by the stack */
+		switch (bench->config) {
+		case TUN_BENCH_WRITE:
+			for (i = 0; i < pkts; i++) {
+				stress_tun_bench_csum(bench, buf, seq++, false);
+				if (write(fd, buf, len) == (ssize_t)len)
+					written++;
+			}
+			break;
+#if defined(STRESS_URING) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+		case TUN_BENCH_URING:
+			for (i = 0; i < pkts; i++)
+				stress_tun_bench_csum(bench, buf + (i * slot_size), seq++, false);
+			written = stress_tun_bench_uring_write(&ring, fd, buf, slot_size, len, pkts);
+			if (written < 0) {
+				result->err = errno;
+				goto close_uring;
+			}
+			break;
+#endif
+		case TUN_BENCH_VNET_CSUM:
+		case TUN_BENCH_VNET_GSO:
+			for (i = 0; i < pkts; i++) {
+#if defined(HAVE_SYS_UIO_H)
+				struct iovec iov[2];
+
+				iov[0].iov_base = (void *)buf;
+				iov[0].iov_len = vhdr;
+				iov[1].iov_base = (void *)(buf + vhdr);
+				iov[1].iov_len = len;
+#endif
+				(void)memcpy(buf + vhdr + l2 + 28, &seq, sizeof(seq));
+				seq++;
+#if defined(HAVE_SYS_UIO_H)
+				n = writev(fd, iov, 2);
+#else
+				n = write(fd, buf, vhdr + len);
+#endif
+				if (n == (ssize_t)(vhdr + len)) {
+					written++;
+				} else if ((n < 0) && (errno == EINVAL) && gso) {
+					/* kernel without UDP GSO on tun devices */
+					result->err = errno;
+					goto close_uring;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+		result->in_pkts += (uint64_t)written * segs;
+		result->in_bytes += (uint64_t)written * len;
+
+		/* drain the socket, GRO may coalesce segments */
+		while ((n = recv(sfd, rbuf, TUN_BENCH_BUF_SIZE, MSG_DONTWAIT)) > 0)
+			result->in_rcvd += ((uint64_t)n + bench->payload - 1) / bench->payload;
+
+		/* egress, the stack routes the socket's packets to the peer via the device */
+		for (i = 0; i < pkts; i++)
+			VOID_RET(ssize_t, send(sfd, sbuf, segs * bench->payload, MSG_NOSIGNAL));
+		while ((n = read(fd, rbuf, TUN_BENCH_BUF_SIZE)) > (ssize_t)vhdr) {
+			uint64_t out_segs = 1;
+
+			if (vhdr) {
+				stress_vnet_hdr_t hdr;
+
+				(void)memcpy(&hdr, rbuf, sizeof(hdr));
+				if ((hdr.gso_type != VIRTIO_NET_HDR_GSO_NONE) && hdr.gso_size &&
+				    ((size_t)n > vhdr + hdr.hdr_len))
+					out_segs = ((uint64_t)n - vhdr - hdr.hdr_len + hdr.gso_size - 1) / hdr.gso_size;
+			}
+			result->out_pkts += out_segs;
+			result->out_bytes += (uint64_t)n - vhdr;
+		}
+	} while (keep_stressing_flag() && (stress_time_now() < t_end));
+	result->secs += stress_time_now() - t_start;
+
+close_uring:
+#if defined(STRESS_URING) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+	if (bench->config == TUN_BENCH_URING)
+		stress_uring_close(&ring);
+#endif
+close_sfd:
+	(void)close(sfd);
+unmap:
+	(void)munmap((void *)buf, buf_size);
+}
+
+/*
+ *  stress_tun_bench_open()
+ *	create the device with a queue for each fd, give it a random
+ *	192.168.*.* address with a route to the peer next to it and
+ *	bring it up, returns 0 or an errno
+ */
+static int stress_tun_bench_open(
+	stress_tun_bench_t *bench,
+	int *fds,
+	const uint32_t queues)
+{
+	struct ifreq ifr;
+	struct sockaddr_in *sin = (struct sockaddr_in *)&ifr.ifr_addr;
+	char path[PATH_MAX];
+	uint32_t q;
+	int sfd, i, err = 0;
+
+	for (q = 0; q < queues; q++) {
+		fds[q] = open(tun_dev, O_RDWR);
+		if (fds[q] < 0)
+			return errno;
+		(void)memset(&ifr, 0, sizeof(ifr));
+		ifr.ifr_flags = (short)((bench->tap ? IFF_TAP : IFF_TUN) | IFF_NO_PI |
+			(bench->vnet ? IFF_VNET_HDR : 0));
+#if defined(IFF_MULTI_QUEUE)
+		ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#endif
+		if (q)
+			(void)shim_strlcpy(ifr.ifr_name, bench->ifname, sizeof(ifr.ifr_name));
+		if (ioctl(fds[q], TUNSETIFF, (void *)&ifr) < 0)
+			return errno;
+		if (q == 0)
+			(void)shim_strlcpy(bench->ifname, ifr.ifr_name, sizeof(bench->ifname));
+	}
+	if (bench->vnet) {
+		unsigned int offload = TUN_F_CSUM;
+
+		if (bench->config == TUN_BENCH_VNET_GSO)
+			offload |= TUN_F_USO4 | TUN_F_USO6;
+		if (ioctl(fds[0], TUNSETOFFLOAD, offload) < 0)
+			return errno;
+	}
+
+	/* keep IPv6 router solicitations out of the read queues */
+	(void)snprintf(path, sizeof(path), "/proc/sys/net/ipv6/conf/%s/disable_ipv6", bench->ifname);
+	VOID_RET(ssize_t, system_write(path, "1", 1));
+
+	sfd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sfd < 0)
+		return errno;
+
+	(void)memset(&ifr, 0, sizeof(ifr));
+	(void)shim_strlcpy(ifr.ifr_name, bench->ifname, sizeof(ifr.ifr_name));
+	sin->sin_family = AF_INET;
+	for (i = 0; i < 32; i++) {
+		const uint32_t host = (uint32_t)(stress_mwc8modn(126) + 1) * 2;
+
+		bench->local.s_addr = htonl((192U << 24) | (168U << 16) |
+			((uint32_t)(stress_mwc8modn(252) + 2) << 8) | host);
+		bench->peer.s_addr = htonl(ntohl(bench->local.s_addr) + 1);
+		sin->sin_addr = bench->local;
+		if (ioctl(sfd, SIOCSIFADDR, &ifr) == 0)
+			break;
+	}
+	if (i == 32) {
+		err = errno;
+		goto close_sfd;
+	}
+	sin->sin_addr.s_addr = htonl(0xffffff00);
+	if ((ioctl(sfd, SIOCSIFNETMASK, &ifr) < 0) ||
+	    (ioctl(sfd, SIOCGIFFLAGS, &ifr) < 0)) {
+		err = errno;
+		goto close_sfd;
+	}
+	ifr.ifr_flags |= IFF_UP;
+	if (ioctl(sfd, SIOCSIFFLAGS, &ifr) < 0) {
+		err = errno;
+		goto close_sfd;
+	}
+
+	if (bench->tap) {
+#if defined(SIOCGIFHWADDR) &&		\
+    defined(HAVE_NET_IF_ARP_H) &&	\
+    defined(SIOCSARP)
+		struct arpreq req;
+
+		if (ioctl(sfd, SIOCGIFHWADDR, &ifr) < 0) {
+			err = errno;
+			goto close_sfd;
+		}
+		(void)memcpy(bench->mac, ifr.ifr_hwaddr.sa_data, sizeof(bench->mac));
+
+		/* a permanent neighbour entry for the peer, nothing answers ARP */
+		(void)memset(&req, 0, sizeof(req));
+		sin = (struct sockaddr_in *)&req.arp_pa;
+		sin->sin_family = AF_INET;
+		sin->sin_addr = bench->peer;
+		req.arp_ha.sa_family = ARPHRD_ETHER;
+		(void)memcpy(req.arp_ha.sa_data, bench->peer_mac, sizeof(bench->peer_mac));
+		req.arp_flags = ATF_PERM | ATF_COM;
+		(void)shim_strlcpy(req.arp_dev, bench->ifname, sizeof(req.arp_dev));
+		if (ioctl(sfd, SIOCSARP, &req) < 0)
+			err = errno;
+#else
+		err = ENOSYS;
+#endif
+	}
+close_sfd:
+	(void)close(sfd);
+
+	return err;
+}
+
+/*
+ *  stress_tun_bench_config()
+ *	benchmark one configuration for a time slice with a
+ *	process per device queue
+ */
+static void stress_tun_bench_config(
+	const stress_args_t *args,
+	stress_tun_bench_t *bench,
+	const uint32_t queues,
+	stress_tun_bench_result_t *results)
+{
+	int fds[TUN_BENCH_QUEUES_MAX];
+	pid_t pids[TUN_BENCH_QUEUES_MAX];
+	uint32_t q;
+	int err;
+
+	for (q = 0; q < queues; q++) {
+		fds[q] = -1;
+		pids[q] = -1;
+	}
+	err = stress_tun_bench_open(bench, fds, queues);
+	if (err) {
+		results[0].err = err;
+		goto close_fds;
+	}
+
+	for (q = 0; q < queues; q++) {
+		pids[q] = fork();
+		if (pids[q] == 0) {
+			stress_tun_bench_queue(args, bench, fds[q], q, &results[q]);
+			_exit(0);
+		}
+	}
+	for (q = 0; q < queues; q++) {
+		int status;
+
+		if (pids[q] > 0)
+			(void)shim_waitpid(pids[q], &status, 0);
+	}
+
+close_fds:
+	for (q = 0; q < queues; q++) {
+		if (fds[q] >= 0)
+			(void)close(fds[q]);
+	}
+}
+
+/*
+ *  stress_tun_bench_report()
+ *	print the per queue packet and bit rates of each
+ *	configuration and set the total rates as metrics
+ */
+static void stress_tun_bench_report(
+	const stress_args_t *args,
+	const stress_tun_bench_result_t *results,
+	const uint32_t queues)
+{
+	size_t config, idx = 0;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %-10s %5s %12s %12s %7s %12s %12s\n", args->name,
+			"config", "queue", "write Kpkt/s", "write Gbit/s", "rcvd %",
+			"read Kpkt/s", "read Gbit/s");
+	}
+	for (config = 0; config < TUN_BENCH_MAX; config++) {
+		const stress_tun_bench_result_t *r = &results[config * queues];
+		stress_tun_bench_result_t total;
+		char str[64];
+		uint32_t q;
+		int err = 0;
+
+		(void)memset(&total, 0, sizeof(total));
+		for (q = 0; q < queues; q++) {
+			if (r[q].err)
+				err = r[q].err;
+			total.in_pkts += r[q].in_pkts;
+			total.in_bytes += r[q].in_bytes;
+			total.in_rcvd += r[q].in_rcvd;
+			total.out_pkts += r[q].out_pkts;
+			total.out_bytes += r[q].out_bytes;
+			/* the queues run concurrently */
+			if (r[q].secs > total.secs)
+				total.secs = r[q].secs;
+		}
+		if (err) {
+			if (args->instance == 0)
+				pr_inf("%s: %-10s not available, errno=%d (%s)\n",
+					args->name, tun_bench_names[config], err, strerror(err));
+			continue;
+		}
+		if (total.secs <= 0.0)
+			continue;
+
+		for (q = 0; args->instance == 0 && q <= queues; q++) {
+			const stress_tun_bench_result_t *s = (q < queues) ? &r[q] : &total;
+			char queue[16];
+
+			if ((queues == 1) && (q == 0))
+				continue;
+			if (s->secs <= 0.0)
+				continue;
+			if (q < queues)
+				(void)snprintf(queue, sizeof(queue), "%" PRIu32, q);
+			else
+				(void)shim_strlcpy(queue, "all", sizeof(queue));
+			pr_inf("%s: %-10s %5s %12.1f %12.2f %7.1f %12.1f %12.2f\n",
+				args->name, tun_bench_names[config], queue,
+				(double)s->in_pkts / s->secs / 1000.0,
+				(double)s->in_bytes * 8.0 / s->secs / 1.0E9,
+				s->in_pkts ? 100.0 * (double)s->in_rcvd / (double)s->in_pkts : 0.0,
+				(double)s->out_pkts / s->secs / 1000.0,
+				(double)s->out_bytes * 8.0 / s->secs / 1.0E9);
+		}
+
+		(void)snprintf(str, sizeof(str), "%s write Gbit per sec", tun_bench_names[config]);
+		stress_metrics_set(args, idx++, str, (double)total.in_bytes * 8.0 / total.secs / 1.0E9);
+		(void)snprintf(str, sizeof(str), "%s read Gbit per sec", tun_bench_names[config]);
+		stress_metrics_set(args, idx++, str, (double)total.out_bytes * 8.0 / total.secs / 1.0E9);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+}
+
+/*
+ *  stress_tun_bench()
+ *	compare the packet rates of multi-queue tun or tap devices with
+ *	plain writes, batched io_uring writes, virtio net header checksum
+ *	offload and UDP segmentation offload, one time slice of each
+ *	configuration per round until the run ends
+ */
+static int stress_tun_bench(const stress_args_t *args, const bool tun_tap)
+{
+	stress_tun_bench_result_t *results;
+	stress_tun_bench_t bench;
+	uint32_t tun_queues = TUN_BENCH_QUEUES_DEFAULT;
+	uint32_t tun_batch = TUN_BENCH_BATCH_DEFAULT;
+	uint32_t tun_bench_size = TUN_BENCH_SIZE_DEFAULT;
+	size_t results_size, config;
+	int port;
+
+	(void)stress_get_setting("tun-queues", &tun_queues);
+	(void)stress_get_setting("tun-batch", &tun_batch);
+	(void)stress_get_setting("tun-bench-size", &tun_bench_size);
+#if !defined(IFF_MULTI_QUEUE)
+	tun_queues = 1;
+#endif
+
+	results_size = sizeof(*results) * TUN_BENCH_MAX * tun_queues;
+	results = (stress_tun_bench_result_t *)mmap(NULL, results_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (results == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap results, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+#if !defined(STRESS_URING) ||	\
+    !defined(HAVE_IORING_OP_WRITE)
+	results[TUN_BENCH_URING * tun_queues].err = ENOSYS;
+#endif
+#if !defined(UDP_SEGMENT) ||	\
+    !defined(UDP_GRO)
+	results[TUN_BENCH_VNET_GSO * tun_queues].err = ENOSYS;
+#endif
+
+	(void)memset(&bench, 0, sizeof(bench));
+	bench.tap = tun_tap;
+	bench.payload = (size_t)tun_bench_size;
+	bench.batch = (size_t)tun_batch;
+	/* locally administered unicast address */
+	bench.peer_mac[0] = 0x02;
+	bench.peer_mac[5] = (uint8_t)args->instance;
+
+	port = 2000 + (stress_mwc16() & 0xfff);
+	port = stress_net_reserve_ports(port, port + (int)tun_queues - 1);
+	if (port < 0) {
+		pr_inf_skip("%s: cannot reserve %" PRIu32 " ports, skipping stressor\n",
+			args->name, tun_queues);
+		(void)munmap((void *)results, results_size);
+		return EXIT_NO_RESOURCE;
+	}
+	bench.port = port;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		bool ran = false;
+
+		for (config = 0; (config < TUN_BENCH_MAX) && keep_stressing(args); config++) {
+			stress_tun_bench_result_t *r = &results[config * tun_queues];
+			uint64_t pkts = 0;
+			uint32_t q;
+			bool err = false;
+
+			for (q = 0; q < tun_queues; q++) {
+				err |= (r[q].err != 0);
+				pkts -= r[q].in_pkts + r[q].out_pkts;
+			}
+			if (err)
+				continue;
+			bench.config = config;
+			bench.vnet = (config >= TUN_BENCH_VNET_CSUM);
+			stress_tun_bench_config(args, &bench, tun_queues, r);
+			ran = true;
+			for (q = 0; q < tun_queues; q++)
+				pkts += r[q].in_pkts + r[q].out_pkts;
+			add_counter(args, pkts);
+		}
+		if (!ran)
+			break;
+	} while (keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_tun_bench_report(args, results, tun_queues);
+
+	stress_net_release_ports(port, port + (int)tun_queues - 1);
+	(void)munmap((void *)results, results_size);
+
+	return EXIT_SUCCESS;
+}
+
+
 /*
  *  stress_tun
  *	stress tun interface
@@ -100,9 +953,12 @@ static int stress_tun(const stress_args_t *args)
 	const uid_t owner = geteuid();
 	const gid_t group = getegid();
 	char ip_addr[32];
-	bool tun_tap = false;
+	bool tun_tap = false, tun_bench = false;
 
 	(void)stress_get_setting("tun-tap", &tun_tap);
+	(void)stress_get_setting("tun-bench", &tun_bench);
+	if (tun_bench)
+		return stress_tun_bench(args, tun_tap);
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
@@ -390,6 +1246,10 @@ clean_up:
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_tun_batch,	stress_set_tun_batch },
+	{ OPT_tun_bench,	stress_set_tun_bench },
+	{ OPT_tun_bench_size,	stress_set_tun_bench_size },
+	{ OPT_tun_queues,	stress_set_tun_queues },
 	{ OPT_tun_tap,		stress_set_tun_tap },
 	{ 0,                    NULL }
 };
@@ -19,7 +19,9 @@
  */
 #include "stress-ng.h"
 #include "core-cpu.h"
+#include "core-latency.h"
 #include "core-net.h"
+#include "core-rate.h"
 
 #if defined(HAVE_LINUX_SOCKIOS_H)
 #include <linux/sockios.h>
@@ -47,6 +49,21 @@ UNEXPECTED
 
 #define UDP_BUF			(1024)	/* UDP I/O buffer size */
 
+#define UDP_MODE_LEGACY		(0)	/* varying size sendto, default */
+#define UDP_MODE_SENDTO		(1)	/* one datagram per sendto */
+#define UDP_MODE_SENDMMSG	(2)	/* batched sendmmsg/recvmmsg */
+#define UDP_MODE_GSO		(3)	/* UDP_SEGMENT segmentation offload */
+
+#define UDP_MMSG_BATCH		(32)	/* datagrams per sendmmsg/recvmmsg */
+#define UDP_MMSG_SLOT		(2048)	/* recvmmsg per datagram buffer size */
+#define UDP_GSO_SEGS		(64)	/* maximum segments per GSO send */
+#define UDP_GSO_BUF		(64 * KB)	/* GSO send and GRO receive buffer */
+#define UDP_GSO_PAYLOAD		(60 * KB)	/* maximum GSO send size */
+#define UDP_PHASE_SENDS		(4096)	/* datagrams sent per payload size phase */
+
+#define MIN_UDP_BUSY_POLL	(0)
+#define MAX_UDP_BUSY_POLL	(1000000)	/* 1 second */
+
 /* See bugs section of udplite(7) */
 #if !defined(SOL_UDPLITE)
 #define SOL_UDPLITE		(136)
@@ -58,17 +75,35 @@ UNEXPECTED
 #define UDPLITE_RECV_CSCOV	(11)
 #endif
 
+typedef struct {
+	const char *name;
+	const int mode;
+} stress_udp_mode_t;
+
 static const stress_help_t help[] = {
 	{ NULL,	"udp N",	"start N workers performing UDP send/receives " },
+	{ NULL,	"udp-busy-poll N", "set SO_BUSY_POLL to N microseconds" },
 	{ NULL,	"udp-domain D",	"specify domain, default is ipv4" },
 	{ NULL, "udp-gro",	"enable UDP-GRO" },
 	{ NULL,	"udp-if I",	"use network interface I, e.g. lo, eth0, etc." },
 	{ NULL,	"udp-lite",	"use the UDP-Lite (RFC 3828) protocol" },
+	{ NULL,	"udp-mode M",	"send mode [sendto|sendmmsg|gso], measures per payload size" },
 	{ NULL,	"udp-ops N",	"stop after N udp bogo operations" },
 	{ NULL,	"udp-port P",	"use ports P to P + number of workers - 1" },
 	{ NULL,	NULL,		NULL }
 };
 
+static const stress_udp_mode_t udp_modes[] = {
+	{ "sendto",	UDP_MODE_SENDTO },
+	{ "sendmmsg",	UDP_MODE_SENDMMSG },
+	{ "gso",	UDP_MODE_GSO },
+};
+
+/* payload sizes measured in the --udp-mode modes */
+static const size_t udp_payload_sizes[] = {
+	64, 256, 512, 1024, 1400
+};
+
 static int stress_set_udp_port(const char *opt)
 {
 	int udp_port;
@@ -107,6 +142,261 @@ static int stress_set_udp_if(const char *name)
 	return stress_set_setting("udp-if", TYPE_ID_STR, name);
 }
 
+/*
+ *  stress_set_udp_mode()
+ *	set the udp send mode
+ */
+static int stress_set_udp_mode(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(udp_modes); i++) {
+		if (!strcmp(opt, udp_modes[i].name))
+			return stress_set_setting("udp-mode", TYPE_ID_INT, &udp_modes[i].mode);
+	}
+	(void)fprintf(stderr, "udp-mode must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(udp_modes); i++)
+		(void)fprintf(stderr, " %s", udp_modes[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_udp_busy_poll(const char *opt)
+{
+	int udp_busy_poll;
+
+	udp_busy_poll = (int)stress_get_uint32(opt);
+	stress_check_range("udp-busy-poll", (uint64_t)udp_busy_poll,
+		MIN_UDP_BUSY_POLL, MAX_UDP_BUSY_POLL);
+	return stress_set_setting("udp-busy-poll", TYPE_ID_INT, &udp_busy_poll);
+}
+
+/*
+ *  stress_udp_busy_poll()
+ *	enable socket busy polling, setting a value larger than
+ *	net.core.busy_read requires CAP_NET_ADMIN
+ */
+static void stress_udp_busy_poll(
+	const stress_args_t *args,
+	const int fd,
+	const int udp_busy_poll)
+{
+#if defined(SO_BUSY_POLL)
+	if (udp_busy_poll <= 0)
+		return;
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &udp_busy_poll, sizeof(udp_busy_poll)) < 0) {
+		if (args->instance == 0)
+			pr_inf("%s: cannot set SO_BUSY_POLL to %d usecs, errno=%d (%s)\n",
+				args->name, udp_busy_poll, errno, strerror(errno));
+	}
+#else
+	(void)fd;
+	if ((udp_busy_poll > 0) && (args->instance == 0))
+		pr_inf("%s: SO_BUSY_POLL is not supported, ignoring --udp-busy-poll\n",
+			args->name);
+#endif
+}
+
+/*
+ *  stress_udp_client_keep_stressing()
+ *	the client does not count the bogo ops, so when paced
+ *	with --rate each datagram is paced on the number of
+ *	datagrams sent rather than on the server's bogo op counter
+ */
+static inline bool stress_udp_client_keep_stressing(const stress_args_t *args)
+{
+	if (!args->rate)
+		return keep_stressing(args);
+	if (!keep_stressing_flag())
+		return false;
+	return !args->max_ops || (get_counter(args) < args->max_ops);
+}
+
+/*
+ *  stress_udp_send_batch()
+ *	send one batch of size byte datagrams using the udp_mode,
+ *	returns the number of datagrams sent or -1 on error
+ */
+static ssize_t OPTIMIZE3 stress_udp_send_batch(
+	const int fd,
+	const int udp_mode,
+	char *buf,
+	const size_t size,
+	struct sockaddr *addr,
+	const socklen_t len)
+{
+	ssize_t ret;
+
+	switch (udp_mode) {
+#if defined(HAVE_SENDMMSG)
+	case UDP_MODE_SENDMMSG: {
+		struct mmsghdr msgs[UDP_MMSG_BATCH];
+		struct iovec iov[UDP_MMSG_BATCH];
+		register size_t i;
+
+		(void)memset(msgs, 0, sizeof(msgs));
+		for (i = 0; i < UDP_MMSG_BATCH; i++) {
+			iov[i].iov_base = buf;
+			iov[i].iov_len = size;
+			msgs[i].msg_hdr.msg_name = addr;
+			msgs[i].msg_hdr.msg_namelen = len;
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		return (ssize_t)sendmmsg(fd, msgs, UDP_MMSG_BATCH, 0);
+	}
+#endif
+#if defined(UDP_SEGMENT)
+	case UDP_MODE_GSO: {
+		const size_t segs = STRESS_MINIMUM(UDP_GSO_SEGS, UDP_GSO_PAYLOAD / size);
+
+		/* UDP_SEGMENT is already set to size, the kernel splits the send */
+		ret = sendto(fd, buf, size * segs, 0, addr, len);
+		return (ret < 0) ? ret : (ssize_t)((size_t)ret / size);
+	}
+#endif
+	default:
+		ret = sendto(fd, buf, size, 0, addr, len);
+		return (ret < 0) ? ret : 1;
+	}
+}
+
+/*
+ *  stress_udp_set_segment()
+ *	set the GSO segment size, 0 disables segmentation
+ */
+static int stress_udp_set_segment(const int fd, const int udp_proto, const int size)
+{
+#if defined(UDP_SEGMENT)
+	const int level = udp_proto ? udp_proto : IPPROTO_UDP;
+
+	return setsockopt(fd, level, UDP_SEGMENT, &size, sizeof(size));
+#else
+	(void)fd;
+	(void)udp_proto;
+	(void)size;
+
+	errno = ENOPROTOOPT;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_udp_client_sizes()
+ *	send datagrams of each of the udp_payload_sizes in turn
+ *	and report the send rate and cost per payload size
+ */
+static int OPTIMIZE3 stress_udp_client_sizes(
+	const stress_args_t *args,
+	const int fd,
+	int udp_mode,
+	const int udp_proto,
+	struct sockaddr *addr,
+	const socklen_t len)
+{
+	static const char * const mode_names[] = {
+		"legacy", "sendto", "sendmmsg", "gso"
+	};
+	uint64_t packets[SIZEOF_ARRAY(udp_payload_sizes)];
+	double durations[SIZEOF_ARRAY(udp_payload_sizes)];
+	uint64_t sent = 0;
+	size_t i, phase = 0;
+	char *buf;
+
+	buf = malloc(UDP_GSO_BUF);
+	if (!buf) {
+		pr_inf_skip("%s: cannot allocate send buffer, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(buf, 'A' + (args->instance % 26), UDP_GSO_BUF);
+	(void)memset(packets, 0, sizeof(packets));
+	(void)memset(durations, 0, sizeof(durations));
+
+#if !defined(HAVE_SENDMMSG)
+	if (udp_mode == UDP_MODE_SENDMMSG) {
+		if (args->instance == 0)
+			pr_inf("%s: sendmmsg is not supported, using sendto\n", args->name);
+		udp_mode = UDP_MODE_SENDTO;
+	}
+#endif
+
+	while (stress_udp_client_keep_stressing(args)) {
+		const size_t size = udp_payload_sizes[phase];
+		uint64_t phase_sent = 0;
+		double t;
+
+		if ((udp_mode == UDP_MODE_GSO) &&
+		    (stress_udp_set_segment(fd, udp_proto, (int)size) < 0)) {
+			if (args->instance == 0)
+				pr_inf("%s: cannot set UDP_SEGMENT, errno=%d (%s), "
+					"using sendmmsg\n",
+					args->name, errno, strerror(errno));
+			udp_mode = UDP_MODE_SENDMMSG;
+		}
+
+		t = stress_time_now();
+		while (phase_sent < UDP_PHASE_SENDS) {
+			ssize_t ret;
+			uint64_t t_lat;
+
+			if (args->rate && !stress_rate_pace_counter(args, sent + phase_sent))
+				break;
+			t_lat = stress_latency_begin(args);
+			ret = stress_udp_send_batch(fd, udp_mode, buf, size, addr, len);
+			stress_latency_end(args, t_lat);
+			if (UNLIKELY(ret < 0)) {
+				if ((errno == EINTR) || (errno == ENETUNREACH) ||
+				    (errno == ENOBUFS) || (errno == EAGAIN))
+					break;
+				/* GSO needs checksum offload and no UDP-Lite */
+				if ((udp_mode == UDP_MODE_GSO) &&
+				    ((errno == EIO) || (errno == EINVAL))) {
+					if (args->instance == 0)
+						pr_inf("%s: GSO send failed, errno=%d (%s), "
+							"using sendmmsg\n",
+							args->name, errno, strerror(errno));
+					(void)stress_udp_set_segment(fd, udp_proto, 0);
+					udp_mode = UDP_MODE_SENDMMSG;
+					continue;
+				}
+				pr_fail("%s: %s failed, errno=%d (%s)\n",
+					args->name, mode_names[udp_mode],
+					errno, strerror(errno));
+				break;
+			}
+			phase_sent += (uint64_t)ret;
+			if (UNLIKELY(!stress_udp_client_keep_stressing(args)))
+				break;
+		}
+		durations[phase] += stress_time_now() - t;
+		packets[phase] += phase_sent;
+		sent += phase_sent;
+		phase++;
+		if (phase >= SIZEOF_ARRAY(udp_payload_sizes))
+			phase = 0;
+	}
+
+	for (i = 0; i < SIZEOF_ARRAY(udp_payload_sizes); i++) {
+		char str[40];
+		const double rate = (durations[i] > 0.0) ?
+			(double)packets[i] / durations[i] : 0.0;
+		const double cost = (packets[i] > 0) ?
+			(durations[i] * STRESS_DBL_NANOSECOND) / (double)packets[i] : 0.0;
+
+		(void)snprintf(str, sizeof(str), "%zu byte packets sent per sec",
+			udp_payload_sizes[i]);
+		stress_metrics_set(args, i * 2, str, rate);
+		(void)snprintf(str, sizeof(str), "%zu byte nanosecs per packet",
+			udp_payload_sizes[i]);
+		stress_metrics_set(args, (i * 2) + 1, str, cost);
+	}
+	free(buf);
+
+	return EXIT_SUCCESS;
+}
+
 static int OPTIMIZE3 stress_udp_client(
 	const stress_args_t *args,
 	const pid_t mypid,
@@ -114,11 +404,14 @@ static int OPTIMIZE3 stress_udp_client(
 	const int udp_proto,
 	const int udp_port,
 	const bool udp_gro,
-	const char *udp_if)
+	const char *udp_if,
+	const int udp_mode,
+	const int udp_busy_poll)
 {
 	struct sockaddr *addr = NULL;
 	int rc = EXIT_FAILURE;
 	int index = 0;
+	uint64_t sent = 0;
 
 	stress_parent_died_alarm();
 	(void)sched_settings_apply(true);
@@ -248,6 +541,15 @@ static int OPTIMIZE3 stress_udp_client(
 #else
 		UNEXPECTED
 #endif
+		stress_udp_busy_poll(args, fd, udp_busy_poll);
+
+		if (udp_mode != UDP_MODE_LEGACY) {
+			rc = stress_udp_client_sizes(args, fd, udp_mode,
+				udp_proto, addr, len);
+			(void)close(fd);
+			goto child_die;
+		}
+
 		do {
 			char buf[UDP_BUF];
 			register size_t i;
@@ -257,9 +559,14 @@ static int OPTIMIZE3 stress_udp_client(
 					"ABCDEFGHIJKLMNOPQRSTUVWXYZ_+@:#!";
 				const int c = patterns[index++ & 0x1f];
 				ssize_t ret;
+				uint64_t t_lat;
 
+				if (args->rate && !stress_rate_pace_counter(args, sent))
+					break;
 				(void)memset(buf, c, sizeof(buf));
+				t_lat = stress_latency_begin(args);
 				ret = sendto(fd, buf, i, 0, addr, len);
+				stress_latency_end(args, t_lat);
 				if (UNLIKELY(ret < 0)) {
 					if ((errno == EINTR) || (errno == ENETUNREACH))
 						break;
@@ -267,6 +574,7 @@ static int OPTIMIZE3 stress_udp_client(
 						args->name, errno, strerror(errno));
 					break;
 				}
+				sent++;
 			}
 #if defined(SIOCOUTQ)
 			{
@@ -277,9 +585,9 @@ static int OPTIMIZE3 stress_udp_client(
 #else
 		UNEXPECTED
 #endif
-		} while (keep_stressing(args));
+		} while (stress_udp_client_keep_stressing(args));
 		(void)close(fd);
-	} while (keep_stressing(args));
+	} while (stress_udp_client_keep_stressing(args));
 
 	rc = EXIT_SUCCESS;
 child_die:
@@ -295,6 +603,113 @@ child_die:
 	return rc;
 }
 
+/*
+ *  stress_udp_segments()
+ *	number of datagrams in a received buffer, more than
+ *	one if GRO coalesced them
+ */
+static uint64_t stress_udp_segments(struct msghdr *msg, const ssize_t n)
+{
+#if defined(UDP_GRO)
+	struct cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if ((cmsg->cmsg_level == IPPROTO_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+			int gso_size;
+
+			(void)memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+			if (gso_size > 0)
+				return ((uint64_t)n + (uint64_t)gso_size - 1) / (uint64_t)gso_size;
+		}
+	}
+#else
+	(void)msg;
+	(void)n;
+#endif
+	return 1;
+}
+
+/*
+ *  stress_udp_server_batch()
+ *	receive datagrams for the --udp-mode modes, each
+ *	datagram is a bogo op
+ */
+static int OPTIMIZE3 stress_udp_server_batch(
+	const stress_args_t *args,
+	const int fd,
+	const int udp_mode)
+{
+	char *buf;
+	int rc = EXIT_SUCCESS;
+
+	buf = malloc(UDP_GSO_BUF);
+	if (!buf) {
+		pr_inf_skip("%s: cannot allocate receive buffer, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	do {
+		ssize_t n;
+
+#if defined(HAVE_RECVMMSG)
+		if (udp_mode == UDP_MODE_SENDMMSG) {
+			struct mmsghdr msgs[UDP_MMSG_BATCH];
+			struct iovec iov[UDP_MMSG_BATCH];
+			register size_t i;
+
+			(void)memset(msgs, 0, sizeof(msgs));
+			for (i = 0; i < UDP_MMSG_BATCH; i++) {
+				iov[i].iov_base = buf + (i * UDP_MMSG_SLOT);
+				iov[i].iov_len = UDP_MMSG_SLOT;
+				msgs[i].msg_hdr.msg_iov = &iov[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			n = (ssize_t)recvmmsg(fd, msgs, UDP_MMSG_BATCH, 0, NULL);
+			if (UNLIKELY(n < 0))
+				goto err;
+			add_counter(args, (uint64_t)n);
+			continue;
+		}
+#else
+		(void)udp_mode;
+#endif
+		{
+			struct msghdr msg;
+			struct iovec iov;
+			char control[CMSG_SPACE(sizeof(int))];
+
+			(void)memset(&msg, 0, sizeof(msg));
+			iov.iov_base = buf;
+			iov.iov_len = UDP_GSO_BUF;
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			n = recvmsg(fd, &msg, 0);
+			if (UNLIKELY(n <= 0)) {
+				if (n == 0)
+					break;
+				goto err;
+			}
+			add_counter(args, stress_udp_segments(&msg, n));
+		}
+		continue;
+err:
+		if (errno != EINTR) {
+			pr_fail("%s: recvmsg failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+		}
+		break;
+	} while (keep_stressing(args));
+
+	free(buf);
+
+	return rc;
+}
+
 static int OPTIMIZE3 stress_udp_server(
 	const stress_args_t *args,
 	const pid_t pid,
@@ -303,7 +718,9 @@ static int OPTIMIZE3 stress_udp_server(
 	const int udp_proto,
 	const int udp_port,
 	const bool udp_gro,
-	const char *udp_if)
+	const char *udp_if,
+	const int udp_mode,
+	const int udp_busy_poll)
 {
 	char buf[UDP_BUF];
 	int fd, status;
@@ -366,6 +783,13 @@ static int OPTIMIZE3 stress_udp_server(
 #else
 	(void)udp_gro;
 #endif
+	stress_udp_busy_poll(args, fd, udp_busy_poll);
+
+	if (udp_mode != UDP_MODE_LEGACY) {
+		rc = stress_udp_server_batch(args, fd, udp_mode);
+		goto die_close;
+	}
+
 	do {
 		socklen_t len = addr_len;
 		ssize_t n;
@@ -405,7 +829,8 @@ die:
 	}
 #endif
 	if (pid) {
-		(void)kill(pid, SIGKILL);
+		/* the --udp-mode client reports its metrics when stopped */
+		(void)kill(pid, (udp_mode == UDP_MODE_LEGACY) ? SIGKILL : SIGALRM);
 		(void)shim_waitpid(pid, &status, 0);
 	}
 	return rc;
@@ -427,8 +852,12 @@ static int stress_udp(const stress_args_t *args)
 #endif
 	bool udp_gro = false;
 	char *udp_if = NULL;
+	int udp_mode = UDP_MODE_LEGACY;
+	int udp_busy_poll = 0;
 
 	(void)stress_get_setting("udp-if", &udp_if);
+	(void)stress_get_setting("udp-mode", &udp_mode);
+	(void)stress_get_setting("udp-busy-poll", &udp_busy_poll);
 	(void)stress_get_setting("udp-port", &udp_port);
 	(void)stress_get_setting("udp-domain", &udp_domain);
 #if defined(IPPROTO_UDPLITE)
@@ -482,13 +911,15 @@ again:
 			args->name, errno, strerror(errno));
 		return EXIT_FAILURE;
 	} else if (pid == 0) {
-		rc = stress_udp_client(args, mypid, udp_domain, udp_proto, udp_port, udp_gro, udp_if);
+		rc = stress_udp_client(args, mypid, udp_domain, udp_proto,
+			udp_port, udp_gro, udp_if, udp_mode, udp_busy_poll);
 
 		/* Inform parent we're all done */
 		(void)kill(getppid(), SIGALRM);
 		_exit(rc);
 	} else {
-		rc = stress_udp_server(args, pid, mypid, udp_domain, udp_proto, udp_port, udp_gro, udp_if);
+		rc = stress_udp_server(args, pid, mypid, udp_domain, udp_proto,
+			udp_port, udp_gro, udp_if, udp_mode, udp_busy_poll);
 	}
 	return rc;
 }
@@ -499,6 +930,8 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_udp_lite,		stress_set_udp_lite },
 	{ OPT_udp_gro,		stress_set_udp_gro },
 	{ OPT_udp_if,		stress_set_udp_if },
+	{ OPT_udp_mode,		stress_set_udp_mode },
+	{ OPT_udp_busy_poll,	stress_set_udp_busy_poll },
 	{ 0,			NULL }
 };
 
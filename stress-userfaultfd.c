@@ -18,6 +18,7 @@
  *
  */
 #include "stress-ng.h"
+#include "core-latency.h"
 
 #if defined(__NR_userfaultfd)
 #define HAVE_USERFAULTFD
@@ -37,9 +38,26 @@ UNEXPECTED
 #define MAX_USERFAULT_BYTES	(MAX_MEM_LIMIT)
 #define DEFAULT_USERFAULT_BYTES	(256 * MB)
 
+#define USERFAULTFD_MODE_STRESS		(0)	/* default mixed copy/zeropage stressing */
+#define USERFAULTFD_MODE_COPY		(1)	/* benchmark, UFFDIO_COPY a page per fault */
+#define USERFAULTFD_MODE_BATCH		(2)	/* benchmark, UFFDIO_COPY a range per fault */
+#define USERFAULTFD_MODE_CONTINUE	(3)	/* benchmark, UFFDIO_CONTINUE shmem minor faults */
+#define USERFAULTFD_MODE_WP		(4)	/* benchmark, write-protect faults */
+
+#define MIN_USERFAULTFD_THREADS		(1)
+#define MAX_USERFAULTFD_THREADS		(256)
+#define DEFAULT_USERFAULTFD_THREADS	(4)
+#define DEFAULT_USERFAULTFD_HANDLERS	(2)
+
+#define USERFAULTFD_BATCH_PAGES		(16)	/* pages copied per batched fault */
+
 static const stress_help_t help[] = {
 	{ NULL,	"userfaultfd N",	"start N page faulting workers with userspace handling" },
+	{ NULL,	"userfaultfd-bytes N",	"size of mmap'd region to fault on" },
+	{ NULL,	"userfaultfd-handlers N", "number of fault handler threads in benchmark modes" },
+	{ NULL,	"userfaultfd-mode M",	"mode [stress|copy|batch|continue|wp]" },
 	{ NULL,	"userfaultfd-ops N",	"stop after N page faults have been handled" },
+	{ NULL,	"userfaultfd-threads N", "number of faulting threads in benchmark modes" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -72,8 +90,55 @@ static int stress_set_userfaultfd_bytes(const char *opt)
 	return stress_set_setting("userfaultfd-bytes", TYPE_ID_SIZE_T, &userfaultfd_bytes);
 }
 
+static int stress_set_userfaultfd_threads(const char *opt)
+{
+	uint32_t userfaultfd_threads;
+
+	userfaultfd_threads = stress_get_uint32(opt);
+	stress_check_range("userfaultfd-threads", (uint64_t)userfaultfd_threads,
+		MIN_USERFAULTFD_THREADS, MAX_USERFAULTFD_THREADS);
+	return stress_set_setting("userfaultfd-threads", TYPE_ID_UINT32, &userfaultfd_threads);
+}
+
+static int stress_set_userfaultfd_handlers(const char *opt)
+{
+	uint32_t userfaultfd_handlers;
+
+	userfaultfd_handlers = stress_get_uint32(opt);
+	stress_check_range("userfaultfd-handlers", (uint64_t)userfaultfd_handlers,
+		MIN_USERFAULTFD_THREADS, MAX_USERFAULTFD_THREADS);
+	return stress_set_setting("userfaultfd-handlers", TYPE_ID_UINT32, &userfaultfd_handlers);
+}
+
+static const char * const userfaultfd_modes[] = {
+	"stress",
+	"copy",
+	"batch",
+	"continue",
+	"wp",
+};
+
+static int stress_set_userfaultfd_mode(const char *opt)
+{
+	int i;
+
+	for (i = 0; i < (int)SIZEOF_ARRAY(userfaultfd_modes); i++) {
+		if (!strcmp(opt, userfaultfd_modes[i]))
+			return stress_set_setting("userfaultfd-mode", TYPE_ID_INT, &i);
+	}
+	(void)fprintf(stderr, "userfaultfd-mode must be one of:");
+	for (i = 0; i < (int)SIZEOF_ARRAY(userfaultfd_modes); i++)
+		(void)fprintf(stderr, " %s", userfaultfd_modes[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_userfaultfd_bytes,	stress_set_userfaultfd_bytes },
+	{ OPT_userfaultfd_handlers,	stress_set_userfaultfd_handlers },
+	{ OPT_userfaultfd_mode,		stress_set_userfaultfd_mode },
+	{ OPT_userfaultfd_threads,	stress_set_userfaultfd_threads },
 	{ 0,				NULL }
 };
 
@@ -232,6 +297,435 @@ static inline int handle_page_fault(
 	return 0;
 }
 
+#if defined(HAVE_LIB_PTHREAD) &&			\
+    defined(UFFDIO_WAKE) &&				\
+    defined(UFFDIO_CONTINUE) &&				\
+    defined(UFFDIO_REGISTER_MODE_MINOR) &&		\
+    defined(UFFD_FEATURE_MINOR_SHMEM) &&		\
+    defined(UFFDIO_WRITEPROTECT) &&			\
+    defined(UFFDIO_REGISTER_MODE_WP) &&			\
+    defined(UFFDIO_WRITEPROTECT_MODE_WP) &&		\
+    defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+#define STRESS_USERFAULTFD_BENCH
+
+/* state shared by the benchmark faulting and handler threads */
+typedef struct {
+	int fd;				/* userfaultfd */
+	int mode;			/* USERFAULTFD_MODE_* */
+	uint8_t *data;			/* registered region */
+	size_t sz;			/* size of registered region */
+	size_t page_size;		/* page size */
+	uint8_t *src;			/* source pages for UFFDIO_COPY */
+	volatile bool faulters_stop;	/* stop faulting */
+	volatile bool handlers_stop;	/* stop handling, faulters are done */
+} stress_uffd_bench_t;
+
+/* a thread faulting on its own stripe of the registered region */
+typedef struct {
+	pthread_t pthread;		/* thread handle */
+	stress_uffd_bench_t *bench;	/* shared state */
+	uint8_t *stripe;		/* start of stripe */
+	size_t stripe_sz;		/* size of stripe */
+	stress_latency_t *latency;	/* fault latencies */
+	int ret;			/* pthread_create return */
+} stress_uffd_faulter_t;
+
+/* a thread resolving the faults read from the userfaultfd */
+typedef struct {
+	pthread_t pthread;		/* thread handle */
+	stress_uffd_bench_t *bench;	/* shared state */
+	const stress_args_t *args;	/* stressor args */
+	uint64_t faults;		/* faults resolved */
+	uint64_t pages;			/* pages populated */
+	int ret;			/* pthread_create return */
+} stress_uffd_handler_t;
+
+/*
+ *  stress_userfaultfd_faulter()
+ *	zap (or write-protect) the stripe and write to each page,
+ *	timing each write as it waits on the fault being resolved
+ */
+static void *stress_userfaultfd_faulter(void *arg)
+{
+	stress_uffd_faulter_t *faulter = (stress_uffd_faulter_t *)arg;
+	stress_uffd_bench_t *bench = faulter->bench;
+	const size_t page_size = bench->page_size;
+	uint8_t *end = faulter->stripe + faulter->stripe_sz;
+	uint8_t val = 0;
+
+	while (!bench->faulters_stop && keep_stressing_flag()) {
+		volatile uint8_t *ptr;
+
+		if (bench->mode == USERFAULTFD_MODE_WP) {
+			struct uffdio_writeprotect wp;
+
+			wp.range.start = (uintptr_t)faulter->stripe;
+			wp.range.len = faulter->stripe_sz;
+			wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+			if (ioctl(bench->fd, UFFDIO_WRITEPROTECT, &wp) < 0)
+				break;
+		} else {
+			/* drop the pages, shmem keeps them in the page cache */
+			if (shim_madvise(faulter->stripe, faulter->stripe_sz, MADV_DONTNEED) < 0)
+				break;
+		}
+		val++;
+		for (ptr = faulter->stripe; ptr < end; ptr += page_size) {
+			const uint64_t t = stress_latency_now();
+
+			*ptr = val;
+			stress_latency_add(faulter->latency, stress_latency_now() - t);
+			if (UNLIKELY(bench->faulters_stop))
+				break;
+		}
+	}
+	return NULL;
+}
+
+/*
+ *  stress_userfaultfd_resolve()
+ *	resolve a fault at page address addr, returns the number of
+ *	pages populated or -1 on failure
+ */
+static ssize_t stress_userfaultfd_resolve(stress_uffd_bench_t *bench, const uintptr_t addr)
+{
+	const size_t page_size = bench->page_size;
+	struct uffdio_range wake;
+
+	switch (bench->mode) {
+	case USERFAULTFD_MODE_COPY:
+	case USERFAULTFD_MODE_BATCH: {
+		struct uffdio_copy copy;
+		const uintptr_t data = (uintptr_t)bench->data;
+		uintptr_t start = addr;
+		size_t len = page_size;
+
+		if (bench->mode == USERFAULTFD_MODE_BATCH) {
+			/* copy the whole aligned batch holding the fault */
+			const size_t batch_sz = page_size * USERFAULTFD_BATCH_PAGES;
+
+			start = data + (((addr - data) / batch_sz) * batch_sz);
+			len = batch_sz;
+			if (start + len > data + bench->sz)
+				len = (data + bench->sz) - start;
+		}
+		copy.dst = start;
+		copy.src = (uintptr_t)bench->src;
+		copy.len = len;
+		copy.mode = 0;
+		copy.copy = 0;
+		if (ioctl(bench->fd, UFFDIO_COPY, &copy) == 0)
+			return (ssize_t)(len / page_size);
+		if ((errno != EEXIST) && (errno != EAGAIN))
+			return -1;
+		/* part of the batch was already populated, just do the fault */
+		copy.dst = addr;
+		copy.len = page_size;
+		copy.copy = 0;
+		if (ioctl(bench->fd, UFFDIO_COPY, &copy) == 0)
+			return 1;
+		if ((errno != EEXIST) && (errno != EAGAIN))
+			return -1;
+		break;
+	}
+	case USERFAULTFD_MODE_CONTINUE: {
+		struct uffdio_continue cont;
+
+		cont.range.start = addr;
+		cont.range.len = page_size;
+		cont.mode = 0;
+		cont.mapped = 0;
+		if (ioctl(bench->fd, UFFDIO_CONTINUE, &cont) == 0)
+			return 1;
+		if ((errno != EEXIST) && (errno != EAGAIN))
+			return -1;
+		break;
+	}
+	case USERFAULTFD_MODE_WP: {
+		struct uffdio_writeprotect wp;
+
+		/* removing the protection wakes the faulting thread */
+		wp.range.start = addr;
+		wp.range.len = page_size;
+		wp.mode = 0;
+		if (ioctl(bench->fd, UFFDIO_WRITEPROTECT, &wp) == 0)
+			return 1;
+		if (errno != EAGAIN)
+			return -1;
+		break;
+	}
+	default:
+		return -1;
+	}
+
+	/* already resolved by a racing populate, wake the faulter */
+	wake.start = addr;
+	wake.len = page_size;
+	if (ioctl(bench->fd, UFFDIO_WAKE, &wake) < 0)
+		return -1;
+	return 0;
+}
+
+/*
+ *  stress_userfaultfd_handler()
+ *	read and resolve faults until the faulters are done
+ */
+static void *stress_userfaultfd_handler(void *arg)
+{
+	stress_uffd_handler_t *handler = (stress_uffd_handler_t *)arg;
+	stress_uffd_bench_t *bench = handler->bench;
+	const stress_args_t *args = handler->args;
+
+	while (!bench->handlers_stop) {
+		struct pollfd fds[1];
+		struct uffd_msg msg;
+		ssize_t ret;
+
+		(void)memset(fds, 0, sizeof fds);
+		fds[0].fd = bench->fd;
+		fds[0].events = POLLIN;
+		if (poll(fds, 1, 100) <= 0)
+			continue;
+		/* several handlers wake per message, the losers get EAGAIN */
+		ret = read(bench->fd, &msg, sizeof(msg));
+		if (ret < (ssize_t)sizeof(msg))
+			continue;
+		if (msg.event != UFFD_EVENT_PAGEFAULT)
+			continue;
+		ret = stress_userfaultfd_resolve(bench,
+			(uintptr_t)msg.arg.pagefault.address & ~(uintptr_t)(bench->page_size - 1));
+		if (ret < 0) {
+			pr_fail("%s: %s fault resolve failed, errno=%d (%s)\n",
+				args->name, userfaultfd_modes[bench->mode],
+				errno, strerror(errno));
+			break;
+		}
+		handler->faults++;
+		handler->pages += (uint64_t)ret;
+	}
+	return NULL;
+}
+
+/*
+ *  stress_userfaultfd_bench()
+ *	benchmark lazy page population with multiple faulting and
+ *	fault handling threads, reporting the faults resolved per
+ *	second and the fault latency distribution
+ */
+static int stress_userfaultfd_bench(const stress_args_t *args, size_t sz, const int mode)
+{
+	const size_t page_size = args->page_size;
+	const size_t batch_sz = (mode == USERFAULTFD_MODE_BATCH) ?
+		page_size * USERFAULTFD_BATCH_PAGES : page_size;
+	uint32_t n_faulters = DEFAULT_USERFAULTFD_THREADS;
+	uint32_t n_handlers = DEFAULT_USERFAULTFD_HANDLERS;
+	stress_uffd_bench_t bench;
+	stress_uffd_faulter_t *faulters = NULL;
+	stress_uffd_handler_t *handlers = NULL;
+	stress_latency_t *latency = NULL;
+	struct uffdio_api api;
+	struct uffdio_register reg;
+	uint8_t *backing = MAP_FAILED;
+	int memfd = -1, rc = EXIT_SUCCESS;
+	size_t stripe_sz;
+	uint32_t i;
+	uint64_t faults, pages;
+	double t_start, duration;
+
+	(void)stress_get_setting("userfaultfd-threads", &n_faulters);
+	(void)stress_get_setting("userfaultfd-handlers", &n_handlers);
+
+	/* stripes are whole batches so a batch never spans two faulters */
+	if (sz < batch_sz)
+		sz = batch_sz;
+	sz -= sz % batch_sz;
+	if (n_faulters > sz / batch_sz)
+		n_faulters = (uint32_t)(sz / batch_sz);
+	stripe_sz = ((sz / n_faulters) / batch_sz) * batch_sz;
+
+	(void)memset(&bench, 0, sizeof(bench));
+	bench.mode = mode;
+	bench.sz = sz;
+	bench.page_size = page_size;
+	bench.data = MAP_FAILED;
+	bench.src = MAP_FAILED;
+
+	bench.fd = shim_userfaultfd(0);
+	if (bench.fd < 0)
+		return stress_userfaultfd_error(args->name, errno,
+			args->instance ? 0 : STRESS_USERFAULT_REPORT_ALWAYS);
+	if (stress_set_nonblock(bench.fd) < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+
+	(void)memset(&api, 0, sizeof(api));
+	api.api = UFFD_API;
+	if (mode == USERFAULTFD_MODE_CONTINUE)
+		api.features = UFFD_FEATURE_MINOR_SHMEM;
+	else if (mode == USERFAULTFD_MODE_WP)
+		api.features = UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+	if (ioctl(bench.fd, UFFDIO_API, &api) < 0) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s mode not supported by the kernel, skipping stressor\n",
+				args->name, userfaultfd_modes[mode]);
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto tidy;
+	}
+
+	bench.src = (uint8_t *)mmap(NULL, batch_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (bench.src == MAP_FAILED) {
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	(void)memset(bench.src, 0xaa, batch_sz);
+
+	if (mode == USERFAULTFD_MODE_CONTINUE) {
+		/* shmem pages stay in the page cache, faults on them are minor */
+		memfd = shim_memfd_create("stress-userfaultfd", 0);
+		if (memfd < 0) {
+			if (args->instance == 0)
+				pr_inf_skip("%s: memfd_create failed, skipping stressor\n", args->name);
+			rc = EXIT_NO_RESOURCE;
+			goto tidy;
+		}
+		if (ftruncate(memfd, (off_t)sz) < 0) {
+			rc = EXIT_NO_RESOURCE;
+			goto tidy;
+		}
+		backing = (uint8_t *)mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+		if (backing == MAP_FAILED) {
+			rc = EXIT_NO_RESOURCE;
+			goto tidy;
+		}
+		(void)memset(backing, 0x55, sz);
+		bench.data = (uint8_t *)mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	} else {
+		bench.data = (uint8_t *)mmap(NULL, sz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if (bench.data == MAP_FAILED) {
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	/* write-protection only applies to present pages */
+	if (mode == USERFAULTFD_MODE_WP)
+		(void)memset(bench.data, 0x55, sz);
+
+	(void)memset(&reg, 0, sizeof(reg));
+	reg.range.start = (uintptr_t)bench.data;
+	reg.range.len = sz;
+	reg.mode = (mode == USERFAULTFD_MODE_CONTINUE) ? UFFDIO_REGISTER_MODE_MINOR :
+		   (mode == USERFAULTFD_MODE_WP) ? UFFDIO_REGISTER_MODE_WP :
+		   UFFDIO_REGISTER_MODE_MISSING;
+	if (ioctl(bench.fd, UFFDIO_REGISTER, &reg) < 0) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s mode register failed, errno=%d (%s), skipping stressor\n",
+				args->name, userfaultfd_modes[mode], errno, strerror(errno));
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto tidy;
+	}
+
+	faulters = (stress_uffd_faulter_t *)calloc(n_faulters, sizeof(*faulters));
+	handlers = (stress_uffd_handler_t *)calloc(n_handlers, sizeof(*handlers));
+	latency = (stress_latency_t *)calloc(n_faulters + 1, sizeof(*latency));
+	if (!faulters || !handlers || !latency) {
+		pr_inf_skip("%s: cannot allocate thread states, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto unreg;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_start = stress_time_now();
+	for (i = 0; i < n_handlers; i++) {
+		handlers[i].bench = &bench;
+		handlers[i].args = args;
+		handlers[i].ret = pthread_create(&handlers[i].pthread, NULL,
+			stress_userfaultfd_handler, &handlers[i]);
+	}
+	for (i = 0; i < n_faulters; i++) {
+		faulters[i].bench = &bench;
+		faulters[i].stripe = bench.data + (i * stripe_sz);
+		faulters[i].stripe_sz = (i == n_faulters - 1) ? sz - (i * stripe_sz) : stripe_sz;
+		faulters[i].latency = &latency[i + 1];
+		stress_latency_reset(faulters[i].latency);
+		faulters[i].ret = pthread_create(&faulters[i].pthread, NULL,
+			stress_userfaultfd_faulter, &faulters[i]);
+	}
+
+	do {
+		(void)shim_usleep(100000);
+		for (faults = 0, i = 0; i < n_handlers; i++)
+			faults += handlers[i].faults;
+		set_counter(args, faults);
+	} while (keep_stressing(args));
+
+	/* faulters may be blocked on a fault, keep handling until they exit */
+	bench.faulters_stop = true;
+	for (i = 0; i < n_faulters; i++) {
+		if (faulters[i].ret == 0)
+			(void)pthread_join(faulters[i].pthread, NULL);
+	}
+	duration = stress_time_now() - t_start;
+	bench.handlers_stop = true;
+	for (i = 0; i < n_handlers; i++) {
+		if (handlers[i].ret == 0)
+			(void)pthread_join(handlers[i].pthread, NULL);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (faults = 0, pages = 0, i = 0; i < n_handlers; i++) {
+		faults += handlers[i].faults;
+		pages += handlers[i].pages;
+	}
+	set_counter(args, faults);
+
+	stress_latency_reset(&latency[0]);
+	for (i = 0; i < n_faulters; i++)
+		stress_latency_merge(&latency[0], &latency[i + 1]);
+	if (args->latency)
+		stress_latency_merge(args->latency, &latency[0]);
+
+	if (duration > 0.0) {
+		stress_metrics_set(args, 0, "faults resolved per sec", (double)faults / duration);
+		stress_metrics_set(args, 1, "pages populated per sec", (double)pages / duration);
+	}
+	if (latency[0].count > 0) {
+		stress_metrics_set(args, 2, "nanosecs mean page write latency",
+			(double)latency[0].total / (double)latency[0].count);
+		stress_metrics_set(args, 3, "nanosecs p50 page write latency",
+			(double)stress_latency_percentile(&latency[0], 50.0));
+		stress_metrics_set(args, 4, "nanosecs p99 page write latency",
+			(double)stress_latency_percentile(&latency[0], 99.0));
+		stress_metrics_set(args, 5, "nanosecs p99.9 page write latency",
+			(double)stress_latency_percentile(&latency[0], 99.9));
+		stress_metrics_set(args, 6, "nanosecs max page write latency",
+			(double)latency[0].max);
+	}
+
+unreg:
+	(void)ioctl(bench.fd, UFFDIO_UNREGISTER, &reg.range);
+tidy:
+	free(latency);
+	free(handlers);
+	free(faulters);
+	if (bench.data != MAP_FAILED)
+		(void)munmap((void *)bench.data, sz);
+	if (backing != MAP_FAILED)
+		(void)munmap((void *)backing, sz);
+	if (memfd >= 0)
+		(void)close(memfd);
+	if (bench.src != MAP_FAILED)
+		(void)munmap((void *)bench.src, batch_sz);
+	(void)close(bench.fd);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_userfaultfd_oomable()
  *	stress userfaultfd system call, this
@@ -257,8 +751,10 @@ static int stress_userfaultfd_child(const stress_args_t *args, void *context)
 	uint8_t *stack_top = (uint8_t *)stress_get_stack_top((void *)stack, STACK_SIZE);
 	size_t userfaultfd_bytes = DEFAULT_USERFAULT_BYTES;
 	double t, duration = 0.0, rate;
+	int userfaultfd_mode = USERFAULTFD_MODE_STRESS;
 
 	(void)context;
+	(void)stress_get_setting("userfaultfd-mode", &userfaultfd_mode);
 
 	if (!stress_get_setting("userfaultfd-bytes", &userfaultfd_bytes)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -274,6 +770,17 @@ static int stress_userfaultfd_child(const stress_args_t *args, void *context)
 
 	sz = userfaultfd_bytes & ~(page_size - 1);
 
+	if (userfaultfd_mode != USERFAULTFD_MODE_STRESS) {
+#if defined(STRESS_USERFAULTFD_BENCH)
+		return stress_userfaultfd_bench(args, sz, userfaultfd_mode);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s mode requires pthreads and a newer linux/userfaultfd.h, "
+				"skipping stressor\n", args->name, userfaultfd_modes[userfaultfd_mode]);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
+
 	if (posix_memalign(&zero_page, page_size, page_size)) {
 		pr_err("%s: zero page allocation failed\n", args->name);
 		return EXIT_NO_RESOURCE;
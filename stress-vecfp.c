@@ -18,14 +18,18 @@
  */
 #include "stress-ng.h"
 #include "core-arch.h"
+#include "core-fp-bench.h"
 #include "core-put.h"
 #include "core-target-clones.h"
 #include "core-vecmath.h"
 
+#include <float.h>
+
 #define LOOPS_PER_CALL	(65536)
 
 static const stress_help_t help[] = {
 	{ NULL,	"vecfp N",	 "start N workers performing vector math ops" },
+	{ NULL,	"vecfp-bench",	 "characterise vector math op latency and throughput" },
 	{ NULL,	"vecfp-ops N",	"stop after N vector math bogo operations" },
 	{ NULL,	NULL,		 NULL }
 };
@@ -361,11 +365,146 @@ static int stress_set_vecfp_method(const char *name)
 	return -1;
 }
 
+/*
+ *  vector kernel operations, see stress_fp_bench_inputs()
+ */
+#define VECFP_BENCH_ADD1(x)	((x) + a)
+#define VECFP_BENCH_ADD2(x)	((x) - a)
+#define VECFP_BENCH_MUL1(x)	((x) * a)
+#define VECFP_BENCH_MUL2(x)	((x) * b)
+#define VECFP_BENCH_DIV1(x)	((x) / a)
+#define VECFP_BENCH_DIV2(x)	((x) / b)
+#define VECFP_BENCH_FMA1(x)	((x) * a + b)
+#define VECFP_BENCH_FMA2(x)	((x) * a + b)
+
+/*
+ *  STRESS_VECFP_BENCH()
+ *	latency kernel of 8 dependent vector operations per loop and
+ *	throughput kernel of FP_BENCH_CHAINS independent vector chains,
+ *	16 vector operations per loop, scalar inputs are broadcast
+ */
+#define STRESS_VECFP_BENCH(etype, elements, name, X1, X2, put)		\
+typedef etype name ## _t __attribute__ ((vector_size(sizeof(etype) * elements)));\
+									\
+static uint64_t TARGET_CLONES OPTIMIZE3 name ## _latency(		\
+	const long double r_init,					\
+	const long double a_init,					\
+	const long double b_init,					\
+	const uint32_t loops)						\
+{									\
+	register name ## _t r = (name ## _t){ 0 } + (etype)r_init;	\
+	const name ## _t a = (name ## _t){ 0 } + (etype)a_init;		\
+	const name ## _t b = (name ## _t){ 0 } + (etype)b_init;		\
+	register uint32_t i;						\
+									\
+	(void)a;							\
+	(void)b;							\
+	for (i = 0; i < loops; i++) {					\
+		r = X1(r);						\
+		r = X2(r);						\
+		r = X1(r);						\
+		r = X2(r);						\
+		r = X1(r);						\
+		r = X2(r);						\
+		r = X1(r);						\
+		r = X2(r);						\
+	}								\
+	for (i = 0; i < elements; i++)					\
+		put(r[i]);						\
+	return (uint64_t)loops * 8;					\
+}									\
+									\
+static uint64_t TARGET_CLONES OPTIMIZE3 name ## _throughput(		\
+	const long double r_init,					\
+	const long double a_init,					\
+	const long double b_init,					\
+	const uint32_t loops)						\
+{									\
+	volatile etype init = (etype)r_init;				\
+	name ## _t r0 = (name ## _t){ 0 } + init;			\
+	name ## _t r1 = (name ## _t){ 0 } + init;			\
+	name ## _t r2 = (name ## _t){ 0 } + init;			\
+	name ## _t r3 = (name ## _t){ 0 } + init;			\
+	name ## _t r4 = (name ## _t){ 0 } + init;			\
+	name ## _t r5 = (name ## _t){ 0 } + init;			\
+	name ## _t r6 = (name ## _t){ 0 } + init;			\
+	name ## _t r7 = (name ## _t){ 0 } + init;			\
+	const name ## _t a = (name ## _t){ 0 } + (etype)a_init;		\
+	const name ## _t b = (name ## _t){ 0 } + (etype)b_init;		\
+	register uint32_t i;						\
+									\
+	(void)a;							\
+	(void)b;							\
+	for (i = 0; i < loops; i++) {					\
+		r0 = X1(r0);						\
+		r1 = X1(r1);						\
+		r2 = X1(r2);						\
+		r3 = X1(r3);						\
+		r4 = X1(r4);						\
+		r5 = X1(r5);						\
+		r6 = X1(r6);						\
+		r7 = X1(r7);						\
+		r0 = X2(r0);						\
+		r1 = X2(r1);						\
+		r2 = X2(r2);						\
+		r3 = X2(r3);						\
+		r4 = X2(r4);						\
+		r5 = X2(r5);						\
+		r6 = X2(r6);						\
+		r7 = X2(r7);						\
+	}								\
+	r0 = r0 + r1 + r2 + r3 + r4 + r5 + r6 + r7;			\
+	for (i = 0; i < elements; i++)					\
+		put(r0[i]);						\
+	return (uint64_t)loops * 2 * FP_BENCH_CHAINS;			\
+}
+
+#define STRESS_VECFP_BENCH_OPS(etype, elements, name, put)		\
+	STRESS_VECFP_BENCH(etype, elements, name ## _add, VECFP_BENCH_ADD1, VECFP_BENCH_ADD2, put) \
+	STRESS_VECFP_BENCH(etype, elements, name ## _mul, VECFP_BENCH_MUL1, VECFP_BENCH_MUL2, put) \
+	STRESS_VECFP_BENCH(etype, elements, name ## _div, VECFP_BENCH_DIV1, VECFP_BENCH_DIV2, put) \
+	STRESS_VECFP_BENCH(etype, elements, name ## _fma, VECFP_BENCH_FMA1, VECFP_BENCH_FMA2, put)
+
+STRESS_VECFP_BENCH_OPS(float, 4, stress_vecfp_bench_float4, stress_float_put)
+STRESS_VECFP_BENCH_OPS(float, 8, stress_vecfp_bench_float8, stress_float_put)
+STRESS_VECFP_BENCH_OPS(float, 16, stress_vecfp_bench_float16, stress_float_put)
+STRESS_VECFP_BENCH_OPS(double, 2, stress_vecfp_bench_double2, stress_double_put)
+STRESS_VECFP_BENCH_OPS(double, 4, stress_vecfp_bench_double4, stress_double_put)
+STRESS_VECFP_BENCH_OPS(double, 8, stress_vecfp_bench_double8, stress_double_put)
+
+#define VECFP_BENCH(type, name, op, min)	\
+	{ type, op, min, name ## _latency, name ## _throughput }
+
+#define VECFP_BENCH_OPS(type, name, min)				\
+	VECFP_BENCH(type, name ## _add, FP_BENCH_OP_ADD, min),		\
+	VECFP_BENCH(type, name ## _mul, FP_BENCH_OP_MUL, min),		\
+	VECFP_BENCH(type, name ## _div, FP_BENCH_OP_DIV, min),		\
+	VECFP_BENCH(type, name ## _fma, FP_BENCH_OP_FMA, min)
+
+static const stress_fp_bench_t stress_vecfp_benches[] = {
+	VECFP_BENCH_OPS("float x4", stress_vecfp_bench_float4, FLT_MIN),
+	VECFP_BENCH_OPS("float x8", stress_vecfp_bench_float8, FLT_MIN),
+	VECFP_BENCH_OPS("float x16", stress_vecfp_bench_float16, FLT_MIN),
+	VECFP_BENCH_OPS("double x2", stress_vecfp_bench_double2, DBL_MIN),
+	VECFP_BENCH_OPS("double x4", stress_vecfp_bench_double4, DBL_MIN),
+	VECFP_BENCH_OPS("double x8", stress_vecfp_bench_double8, DBL_MIN),
+};
+
+static int stress_set_vecfp_bench(const char *opt)
+{
+	return stress_set_setting_true("vecfp-bench", opt);
+}
+
 static int stress_vecfp(const stress_args_t *args)
 {
 	size_t i, max_elements = 0, mmap_size;
 	stress_vecfp_init *vecfp_init;
 	size_t vecfp_method = 0;	/* "all" */
+	bool vecfp_bench = false;
+
+	(void)stress_get_setting("vecfp-bench", &vecfp_bench);
+	if (vecfp_bench)
+		return stress_fp_bench_run(args, stress_vecfp_benches, SIZEOF_ARRAY(stress_vecfp_benches));
 
 	for (i = 0; i < SIZEOF_ARRAY(stress_vecfp_funcs); i++) {
 		const size_t elements = stress_vecfp_funcs[i].elements;
@@ -444,7 +583,9 @@ static int stress_vecfp(const stress_args_t *args)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vecfp_bench,	stress_set_vecfp_bench },
         { OPT_vecfp_method,	stress_set_vecfp_method },
+	{ 0,			NULL }
 };
 
 stressor_info_t stress_vecfp_info = {
@@ -467,8 +608,22 @@ static int stress_set_vecfp_method(const char *name)
 	return 0;
 }
 
+/*
+ *  stress_set_vecfp_bench()
+ *	set the vector floating point benchmark mode, no-op
+ */
+static int stress_set_vecfp_bench(const char *opt)
+{
+	(void)opt;
+
+	fprintf(stderr, "option --vecfp-bench is not implemented, ignoring option\n");
+	return 0;
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vecfp_bench,	stress_set_vecfp_bench },
         { OPT_vecfp_method,	stress_set_vecfp_method },
+	{ 0,			NULL }
 };
 
 stressor_info_t stress_vecfp_info = {
@@ -0,0 +1,559 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-arch.h"
+#include "core-cpu.h"
+#include "core-put.h"
+#include "core-target-clones.h"
+#include "core-vecmath.h"
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#include <linux/perf_event.h>
+#endif
+
+#if defined(HAVE_ASM_PRCTL_H)
+#include <asm/prctl.h>
+#endif
+
+#define MIN_VECFREQ_MS		(10)
+#define MAX_VECFREQ_MS		(10000)
+#define DEFAULT_VECFREQ_MS	(250)
+
+#define VECFREQ_LOOPS		(1024)	/* loops per kernel call */
+#define VECFREQ_ACCUMULATORS	(8)	/* independent FMA chains */
+
+#define MSR_IA32_MPERF		(0x000000e7)
+#define MSR_IA32_APERF		(0x000000e8)
+
+#define XFEATURE_XTILEDATA	(18)
+
+static const stress_help_t help[] = {
+	{ NULL,	"vecfreq N",		"start N workers measuring CPU frequency under vector loads" },
+	{ NULL,	"vecfreq-ms N",		"run each vector phase for N milliseconds" },
+	{ NULL,	"vecfreq-ops N",	"stop after N vector phase bogo operations" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_vecfreq_ms(const char *opt)
+{
+	uint32_t vecfreq_ms;
+
+	vecfreq_ms = stress_get_uint32(opt);
+	stress_check_range("vecfreq-ms", (uint64_t)vecfreq_ms,
+		MIN_VECFREQ_MS, MAX_VECFREQ_MS);
+	return stress_set_setting("vecfreq-ms", TYPE_ID_UINT32, &vecfreq_ms);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vecfreq_ms,	stress_set_vecfreq_ms },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_VECMATH) &&	\
+    defined(__linux__)
+
+#if defined(__GNUC__) &&	\
+    !defined(__clang__) &&	\
+    !defined(__ICC)
+#define TARGET_SCALAR	__attribute__((optimize("-O3", "no-tree-vectorize", "no-tree-slp-vectorize")))
+#else
+#define TARGET_SCALAR
+#endif
+
+#if defined(STRESS_ARCH_X86) &&		\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    !defined(__ICC)
+#if defined(HAVE_TARGET_CLONES_AVX2) &&	\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_VECFREQ_AVX2
+#endif
+#if defined(HAVE_TARGET_CLONES_SKYLAKE_AVX512) &&	\
+    NEED_GNUC(8, 0, 0)
+#define STRESS_VECFREQ_AVX512
+#endif
+#endif
+
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_ASM_X86_AMX) &&	\
+    defined(HAVE_ASM_PRCTL_H) &&	\
+    defined(ARCH_REQ_XCOMP_PERM)
+#define STRESS_VECFREQ_AMX
+#endif
+
+typedef float stress_vecfreq_f32x8_t	__attribute__ ((vector_size(32)));
+typedef float stress_vecfreq_f32x16_t	__attribute__ ((vector_size(64)));
+
+/*
+ *  frequency counters, the perf cycles and ref-cycles counters are
+ *  used if available, otherwise the APERF/MPERF MSRs are read
+ */
+typedef struct {
+	int fd_cycles;		/* perf cycles counter fd */
+	int fd_ref_cycles;	/* perf ref-cycles counter fd */
+	bool use_msr;		/* use APERF/MPERF instead of perf */
+} stress_vecfreq_counters_t;
+
+typedef struct {
+	uint64_t cycles;	/* actual cycles, perf cycles or APERF */
+	uint64_t ref_cycles;	/* nominal frequency cycles, ref-cycles or MPERF */
+	unsigned int cpu;	/* CPU the counters were read on */
+} stress_vecfreq_sample_t;
+
+typedef double (*stress_vecfreq_func_t)(void);
+
+typedef struct {
+	const char *name;		/* phase name */
+	const char *units;		/* throughput units */
+	bool (*supported)(void);	/* true if phase can be run */
+	stress_vecfreq_func_t func;	/* phase kernel, returns ops per call */
+} stress_vecfreq_phase_t;
+
+typedef struct {
+	double duration;	/* total phase run time */
+	double ops;		/* total floating point / int8 operations */
+	double cycles;		/* total cycles while running phase */
+	double ref_cycles;	/* total nominal frequency cycles */
+	double freq_duration;	/* run time of phases with valid cycle counts */
+} stress_vecfreq_stats_t;
+
+/*
+ *  stress_vecfreq_scalar()
+ *	scalar multiply-add chains, vectorization disabled
+ */
+static double TARGET_SCALAR stress_vecfreq_scalar(void)
+{
+	float acc[VECFREQ_ACCUMULATORS];
+	const float m = 0.999999F, a = 0.000001F;
+	register int i, j;
+
+	for (j = 0; j < VECFREQ_ACCUMULATORS; j++)
+		acc[j] = (float)j;
+
+	for (i = 0; i < VECFREQ_LOOPS; i++) {
+		for (j = 0; j < VECFREQ_ACCUMULATORS; j++)
+			acc[j] = (acc[j] * m) + a;
+	}
+	for (j = 0; j < VECFREQ_ACCUMULATORS; j++)
+		stress_float_put(acc[j]);
+
+	return 2.0 * VECFREQ_LOOPS * VECFREQ_ACCUMULATORS;
+}
+
+static bool stress_vecfreq_scalar_supported(void)
+{
+	return true;
+}
+
+/*
+ *  STRESS_VECFREQ_VECTOR()
+ *	multiply-add chains on vectors of floats compiled for a given ISA
+ */
+#define STRESS_VECFREQ_VECTOR(name, type, isa)				\
+static double OPTIMIZE3 __attribute__((target(isa))) name(void)		\
+{									\
+	type acc[VECFREQ_ACCUMULATORS];					\
+	type m, a;							\
+	register int i, j;						\
+	size_t k;							\
+									\
+	for (k = 0; k < sizeof(type) / sizeof(float); k++) {		\
+		m[k] = 0.999999F;					\
+		a[k] = 0.000001F;					\
+	}								\
+	for (j = 0; j < VECFREQ_ACCUMULATORS; j++) {			\
+		for (k = 0; k < sizeof(type) / sizeof(float); k++)	\
+			acc[j][k] = (float)(j + k);			\
+	}								\
+									\
+	for (i = 0; i < VECFREQ_LOOPS; i++) {				\
+		for (j = 0; j < VECFREQ_ACCUMULATORS; j++)		\
+			acc[j] = (acc[j] * m) + a;			\
+	}								\
+	for (j = 0; j < VECFREQ_ACCUMULATORS; j++)			\
+		stress_float_put(acc[j][0]);				\
+									\
+	return 2.0 * VECFREQ_LOOPS * VECFREQ_ACCUMULATORS *		\
+		(double)(sizeof(type) / sizeof(float));			\
+}
+
+#if defined(STRESS_VECFREQ_AVX2)
+STRESS_VECFREQ_VECTOR(stress_vecfreq_avx2, stress_vecfreq_f32x8_t, "avx2,fma")
+
+static bool stress_vecfreq_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2") &&
+	       __builtin_cpu_supports("fma");
+}
+#endif
+
+#if defined(STRESS_VECFREQ_AVX512)
+STRESS_VECFREQ_VECTOR(stress_vecfreq_avx512, stress_vecfreq_f32x16_t, "avx512f,fma")
+
+static bool stress_vecfreq_avx512_supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+#if defined(STRESS_VECFREQ_AMX)
+/* 16 rows x 64 bytes for each of C (tmm0), A (tmm1) and B (tmm2) */
+#define AMX_ROWS	(16)
+#define AMX_COLSB	(64)
+
+typedef struct {
+	uint8_t palette_id;
+	uint8_t start_row;
+	uint8_t reserved[14];
+	uint16_t colsb[16];
+	uint8_t rows[16];
+} stress_vecfreq_tilecfg_t;
+
+static stress_vecfreq_tilecfg_t tilecfg ALIGN64;
+static int8_t amx_a[AMX_ROWS * AMX_COLSB] ALIGN64;
+static int8_t amx_b[AMX_ROWS * AMX_COLSB] ALIGN64;
+static int32_t amx_c[AMX_ROWS * (AMX_COLSB / sizeof(int32_t))] ALIGN64;
+
+/*
+ *  stress_vecfreq_amx()
+ *	int8 tile dot products, tmm0 += tmm1 * tmm2
+ */
+static double stress_vecfreq_amx(void)
+{
+	const unsigned long stride = AMX_COLSB;
+	register int i;
+
+	__asm__ __volatile__("ldtilecfg %0" : : "m" (tilecfg));
+	__asm__ __volatile__("tileloadd (%0,%1,1), %%tmm0" : : "r" (amx_c), "r" (stride));
+	__asm__ __volatile__("tileloadd (%0,%1,1), %%tmm1" : : "r" (amx_a), "r" (stride));
+	__asm__ __volatile__("tileloadd (%0,%1,1), %%tmm2" : : "r" (amx_b), "r" (stride));
+	for (i = 0; i < VECFREQ_LOOPS; i++)
+		__asm__ __volatile__("tdpbssd %tmm2, %tmm1, %tmm0");
+	__asm__ __volatile__("tilestored %%tmm0, (%0,%1,1)" : : "r" (amx_c), "r" (stride) : "memory");
+	__asm__ __volatile__("tilerelease");
+
+	/* 16 x 16 int32 results, each a dot product of 64 int8 pairs */
+	return 2.0 * VECFREQ_LOOPS * AMX_ROWS * (AMX_COLSB / sizeof(int32_t)) * 64;
+}
+
+/*
+ *  stress_vecfreq_amx_supported()
+ *	AMX needs CPU support and permission from the kernel
+ *	to use the tile data state
+ */
+static bool stress_vecfreq_amx_supported(void)
+{
+	static int supported = -1;
+	size_t i;
+
+	if (supported >= 0)
+		return (bool)supported;
+
+	supported = 0;
+	if (!stress_cpu_x86_has_amx())
+		return false;
+	if (shim_arch_prctl(ARCH_REQ_XCOMP_PERM, XFEATURE_XTILEDATA) < 0)
+		return false;
+
+	(void)memset(&tilecfg, 0, sizeof(tilecfg));
+	tilecfg.palette_id = 1;
+	for (i = 0; i < 3; i++) {
+		tilecfg.colsb[i] = AMX_COLSB;
+		tilecfg.rows[i] = AMX_ROWS;
+	}
+	for (i = 0; i < SIZEOF_ARRAY(amx_a); i++) {
+		amx_a[i] = (int8_t)stress_mwc8();
+		amx_b[i] = (int8_t)stress_mwc8();
+	}
+	(void)memset(amx_c, 0, sizeof(amx_c));
+	supported = 1;
+
+	return true;
+}
+#endif
+
+static const stress_vecfreq_phase_t phases[] = {
+	{ "scalar",	"GFLOP/s", stress_vecfreq_scalar_supported, stress_vecfreq_scalar },
+#if defined(STRESS_VECFREQ_AVX2)
+	{ "avx2",	"GFLOP/s", stress_vecfreq_avx2_supported, stress_vecfreq_avx2 },
+#endif
+#if defined(STRESS_VECFREQ_AVX512)
+	{ "avx512",	"GFLOP/s", stress_vecfreq_avx512_supported, stress_vecfreq_avx512 },
+#endif
+#if defined(STRESS_VECFREQ_AMX)
+	{ "amx",	"GOP/s",   stress_vecfreq_amx_supported, stress_vecfreq_amx },
+#endif
+};
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open) &&	\
+    defined(HAVE_SYSCALL)
+/*
+ *  stress_vecfreq_perf_open()
+ *	open a user space hardware counter for this process
+ */
+static int stress_vecfreq_perf_open(const uint64_t config)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/*
+ *  stress_vecfreq_msr_read()
+ *	read a 64 bit MSR on a given CPU
+ */
+static int stress_vecfreq_msr_read(const unsigned int cpu, const uint32_t reg, uint64_t *val)
+{
+	char path[PATH_MAX];
+	ssize_t ret;
+	int fd;
+
+	(void)snprintf(path, sizeof(path), "/dev/cpu/%u/msr", cpu);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ret = pread(fd, val, sizeof(*val), (off_t)reg);
+	(void)close(fd);
+
+	return (ret == (ssize_t)sizeof(*val)) ? 0 : -1;
+}
+
+/*
+ *  stress_vecfreq_counters_open()
+ *	find a way to count cycles, returns false if there is none
+ */
+static bool stress_vecfreq_counters_open(stress_vecfreq_counters_t *counters)
+{
+	unsigned int cpu, node;
+	uint64_t val;
+
+	counters->fd_cycles = -1;
+	counters->fd_ref_cycles = -1;
+	counters->use_msr = false;
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open) &&	\
+    defined(HAVE_SYSCALL)
+	counters->fd_cycles = stress_vecfreq_perf_open(PERF_COUNT_HW_CPU_CYCLES);
+	if (counters->fd_cycles >= 0) {
+		counters->fd_ref_cycles = stress_vecfreq_perf_open(PERF_COUNT_HW_REF_CPU_CYCLES);
+		return true;
+	}
+#endif
+	if (!stress_cpu_x86_has_msr())
+		return false;
+	if (shim_getcpu(&cpu, &node, NULL) < 0)
+		return false;
+	if (stress_vecfreq_msr_read(cpu, MSR_IA32_APERF, &val) < 0)
+		return false;
+	counters->use_msr = true;
+
+	return true;
+}
+
+static void stress_vecfreq_counters_close(stress_vecfreq_counters_t *counters)
+{
+	if (counters->fd_cycles >= 0)
+		(void)close(counters->fd_cycles);
+	if (counters->fd_ref_cycles >= 0)
+		(void)close(counters->fd_ref_cycles);
+}
+
+/*
+ *  stress_vecfreq_sample()
+ *	read the cycle counters, returns false if they cannot be read
+ */
+static bool stress_vecfreq_sample(
+	const stress_vecfreq_counters_t *counters,
+	stress_vecfreq_sample_t *sample)
+{
+	unsigned int node;
+
+	sample->cycles = 0;
+	sample->ref_cycles = 0;
+	sample->cpu = 0;
+
+	if (counters->use_msr) {
+		if (shim_getcpu(&sample->cpu, &node, NULL) < 0)
+			return false;
+		if (stress_vecfreq_msr_read(sample->cpu, MSR_IA32_APERF, &sample->cycles) < 0)
+			return false;
+		if (stress_vecfreq_msr_read(sample->cpu, MSR_IA32_MPERF, &sample->ref_cycles) < 0)
+			return false;
+		return true;
+	}
+	if (counters->fd_cycles < 0)
+		return false;
+	if (read(counters->fd_cycles, &sample->cycles, sizeof(sample->cycles)) != sizeof(sample->cycles))
+		return false;
+	if ((counters->fd_ref_cycles >= 0) &&
+	    (read(counters->fd_ref_cycles, &sample->ref_cycles, sizeof(sample->ref_cycles)) != sizeof(sample->ref_cycles)))
+		sample->ref_cycles = 0;
+	return true;
+}
+
+/*
+ *  stress_vecfreq_phase()
+ *	run a phase for phase_ms milliseconds and accumulate the
+ *	run time, operations and cycles used
+ */
+static void stress_vecfreq_phase(
+	const stress_args_t *args,
+	const stress_vecfreq_phase_t *phase,
+	const stress_vecfreq_counters_t *counters,
+	const uint32_t phase_ms,
+	stress_vecfreq_stats_t *stats)
+{
+	stress_vecfreq_sample_t s1, s2;
+	double t1, t2, t_end, ops = 0.0;
+	bool valid;
+
+	/* warm up so the frequency transition is not measured */
+	(void)phase->func();
+
+	valid = stress_vecfreq_sample(counters, &s1);
+	t1 = stress_time_now();
+	t_end = t1 + ((double)phase_ms / 1000.0);
+	do {
+		ops += phase->func();
+		inc_counter(args);
+		t2 = stress_time_now();
+	} while ((t2 < t_end) && keep_stressing(args));
+	valid &= stress_vecfreq_sample(counters, &s2);
+
+	stats->duration += t2 - t1;
+	stats->ops += ops;
+
+	/* discard samples where the process migrated or counters wrapped */
+	if (!valid || (s1.cpu != s2.cpu) || (s2.cycles < s1.cycles) ||
+	    (s2.ref_cycles < s1.ref_cycles))
+		return;
+	stats->cycles += (double)(s2.cycles - s1.cycles);
+	stats->ref_cycles += (double)(s2.ref_cycles - s1.ref_cycles);
+	stats->freq_duration += t2 - t1;
+}
+
+/*
+ *  stress_vecfreq()
+ *	stress CPU with alternating scalar and vector phases and
+ *	measure the effective CPU frequency of each phase
+ */
+static int stress_vecfreq(const stress_args_t *args)
+{
+	stress_vecfreq_stats_t stats[SIZEOF_ARRAY(phases)];
+	bool supported[SIZEOF_ARRAY(phases)];
+	stress_vecfreq_counters_t counters;
+	uint32_t vecfreq_ms = DEFAULT_VECFREQ_MS;
+	double scalar_ghz = 0.0;
+	bool have_counters;
+	size_t i, j;
+
+	(void)stress_get_setting("vecfreq-ms", &vecfreq_ms);
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (i = 0; i < SIZEOF_ARRAY(phases); i++)
+		supported[i] = phases[i].supported();
+
+	have_counters = stress_vecfreq_counters_open(&counters);
+	if (!have_counters && (args->instance == 0))
+		pr_inf("%s: cannot read perf cycle counters or APERF/MPERF MSRs, "
+			"only reporting throughput\n", args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; keep_stressing(args) && (i < SIZEOF_ARRAY(phases)); i++) {
+			if (supported[i])
+				stress_vecfreq_phase(args, &phases[i], &counters, vecfreq_ms, &stats[i]);
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_vecfreq_counters_close(&counters);
+
+	if (stats[0].freq_duration > 0.0)
+		scalar_ghz = stats[0].cycles / stats[0].freq_duration / STRESS_DBL_NANOSECOND;
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_dbg("%s: %-7s %10s %10s %10s %12s\n", args->name,
+			"phase", "GHz", "% scalar", "% nominal", "throughput");
+	}
+	for (i = 0, j = 0; i < SIZEOF_ARRAY(phases); i++) {
+		char str[64];
+		double ghz = 0.0, scalar_pc = 0.0, nominal_pc = 0.0, rate = 0.0;
+
+		if (!supported[i] || (stats[i].duration <= 0.0))
+			continue;
+
+		rate = stats[i].ops / stats[i].duration / STRESS_DBL_NANOSECOND;
+		if (stats[i].freq_duration > 0.0)
+			ghz = stats[i].cycles / stats[i].freq_duration / STRESS_DBL_NANOSECOND;
+		if (scalar_ghz > 0.0)
+			scalar_pc = 100.0 * ghz / scalar_ghz;
+		if (stats[i].ref_cycles > 0.0)
+			nominal_pc = 100.0 * stats[i].cycles / stats[i].ref_cycles;
+
+		if (args->instance == 0) {
+			pr_dbg("%s: %-7s %10.3f %10.2f %10.2f %8.2f %s\n", args->name,
+				phases[i].name, ghz, scalar_pc, nominal_pc,
+				rate, phases[i].units);
+		}
+
+		(void)snprintf(str, sizeof(str), "%s %s", phases[i].name, phases[i].units);
+		stress_metrics_set(args, j++, str, rate);
+		if (have_counters) {
+			(void)snprintf(str, sizeof(str), "%s GHz", phases[i].name);
+			stress_metrics_set(args, j++, str, ghz);
+		}
+	}
+	if (args->instance == 0) {
+		pr_dbg("%s: Key: GHz = effective frequency, %% scalar = frequency compared\n", args->name);
+		pr_dbg("%s: to scalar phase, %% nominal = actual vs nominal (ref) cycles\n", args->name);
+		pr_unlock();
+	}
+
+	return EXIT_SUCCESS;
+}
+
+stressor_info_t stress_vecfreq_info = {
+	.stressor = stress_vecfreq,
+	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_vecfreq_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without compiler support for vector data/operations or non-Linux"
+};
+#endif
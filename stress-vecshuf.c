@@ -18,17 +18,48 @@
  */
 #include "stress-ng.h"
 #include "core-arch.h"
+#include "core-perf.h"
 #include "core-pragma.h"
 #include "core-put.h"
 #include "core-target-clones.h"
 #include "core-vecmath.h"
 
+#if defined(STRESS_ARCH_X86_64) &&	\
+    defined(HAVE_IMMINTRIN_H) &&	\
+    defined(HAVE_TARGET_CLONES) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    !defined(__ICC) &&			\
+    NEED_GNUC(8, 0, 0)
+#include <immintrin.h>
+#define STRESS_VECSHUF_HAVE_X86
+#endif
+
+#if defined(STRESS_ARCH_ARM) &&		\
+    defined(__aarch64__) &&		\
+    defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STRESS_VECSHUF_HAVE_NEON
+#endif
+
+#if defined(STRESS_ARCH_ARM) &&		\
+    defined(__aarch64__) &&		\
+    defined(__ARM_FEATURE_SVE)
+#include <arm_sve.h>
+#define STRESS_VECSHUF_HAVE_SVE
+#endif
+
 #define VECTOR_SIZE_BYTES	(64)
 #define LOOPS_PER_CALL		(65536)
 #define SHUFFLES_PER_LOOP	(4)
 
+#define VECSHUF_ISA_CHAINS	(8)	/* independent vectors per ISA kernel */
+#define VECSHUF_ISA_MAX_BYTES	(256)	/* widest vector, 2048 bit SVE */
+#define VECSHUF_ISA_LOOPS	(4096)	/* ISA kernel loops per call */
+#define VECSHUF_ISA_SLICE	(0.05)	/* seconds per ISA benchmark turn */
+
 static const stress_help_t help[] = {
 	{ NULL,	"vecshuf N",		"start N workers performing vector shuffle ops" },
+	{ NULL,	"vecshuf-isa I",	"benchmark shuffle throughput of ISA specific shuffles" },
 	{ NULL,	"vecshuf-method M",	"select vector shuffling method" },
 	{ NULL,	"vecshuf-ops N",	"stop after N vector shuffle bogo operations" },
 	{ NULL,	NULL,			NULL }
@@ -311,12 +342,441 @@ static bool stress_vecshuf_check_data(
 	return fail;
 }
 
+/*
+ *  ISA specific shuffle kernels, each shuffles VECSHUF_ISA_CHAINS
+ *  independent vectors with mask1 and then back again with mask2 on
+ *  each loop, the data is restored at the end so it can be checked
+ */
+typedef uint64_t (*stress_vecshuf_isa_func_t)(uint8_t *data,
+	const uint8_t *mask1, const uint8_t *mask2, const uint32_t loops);
+
+typedef struct {
+	const char *name;		/* --vecshuf-isa name */
+	const char *insn;		/* shuffle instruction */
+	bool (*supported)(void);	/* CPU supports the instruction */
+	stress_vecshuf_isa_func_t func;	/* shuffle kernel */
+	size_t bytes;			/* vector size, 0 = SVE vector length */
+	size_t elem_bytes;		/* size of each shuffled element */
+	size_t lane_bytes;		/* elements only move within a lane */
+} stress_vecshuf_isa_t;
+
+#define STRESS_VECSHUF_ISA(name, attr, vtype, load, store, shuf)	\
+static uint64_t attr name(						\
+	uint8_t *data,							\
+	const uint8_t *mask1,						\
+	const uint8_t *mask2,						\
+	const uint32_t loops)						\
+{									\
+	const size_t n = sizeof(vtype);					\
+	const vtype m1 = load(mask1);					\
+	const vtype m2 = load(mask2);					\
+	vtype v0 = load(data + (n * 0));				\
+	vtype v1 = load(data + (n * 1));				\
+	vtype v2 = load(data + (n * 2));				\
+	vtype v3 = load(data + (n * 3));				\
+	vtype v4 = load(data + (n * 4));				\
+	vtype v5 = load(data + (n * 5));				\
+	vtype v6 = load(data + (n * 6));				\
+	vtype v7 = load(data + (n * 7));				\
+	register uint32_t i;						\
+									\
+	for (i = 0; i < loops; i++) {					\
+		v0 = shuf(v0, m1);					\
+		v1 = shuf(v1, m1);					\
+		v2 = shuf(v2, m1);					\
+		v3 = shuf(v3, m1);					\
+		v4 = shuf(v4, m1);					\
+		v5 = shuf(v5, m1);					\
+		v6 = shuf(v6, m1);					\
+		v7 = shuf(v7, m1);					\
+		v0 = shuf(v0, m2);					\
+		v1 = shuf(v1, m2);					\
+		v2 = shuf(v2, m2);					\
+		v3 = shuf(v3, m2);					\
+		v4 = shuf(v4, m2);					\
+		v5 = shuf(v5, m2);					\
+		v6 = shuf(v6, m2);					\
+		v7 = shuf(v7, m2);					\
+	}								\
+	store(data + (n * 0), v0);					\
+	store(data + (n * 1), v1);					\
+	store(data + (n * 2), v2);					\
+	store(data + (n * 3), v3);					\
+	store(data + (n * 4), v4);					\
+	store(data + (n * 5), v5);					\
+	store(data + (n * 6), v6);					\
+	store(data + (n * 7), v7);					\
+									\
+	return (uint64_t)loops * 2 * VECSHUF_ISA_CHAINS;		\
+}
+
+/* compiler chosen shuffle of 64 byte generic vectors */
+typedef uint8_t stress_vecshuf_generic_t __attribute__ ((vector_size(64)));
+
+#define VECSHUF_GENERIC_LOAD(p)		(*(const stress_vecshuf_generic_t *)(p))
+#define VECSHUF_GENERIC_STORE(p, v)	(*(stress_vecshuf_generic_t *)(p)) = (v)
+#define VECSHUF_GENERIC_SHUF(v, m)	__builtin_shuffle(v, m)
+
+STRESS_VECSHUF_ISA(stress_vecshuf_isa_generic, TARGET_CLONES OPTIMIZE3, stress_vecshuf_generic_t,
+	VECSHUF_GENERIC_LOAD, VECSHUF_GENERIC_STORE, VECSHUF_GENERIC_SHUF)
+
+static bool stress_vecshuf_isa_has_generic(void)
+{
+	return true;
+}
+
+#if defined(STRESS_VECSHUF_HAVE_X86)
+#define VECSHUF_SSE_LOAD(p)		_mm_loadu_si128((const __m128i *)(p))
+#define VECSHUF_SSE_STORE(p, v)		_mm_storeu_si128((__m128i *)(p), v)
+#define VECSHUF_AVX_LOAD(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define VECSHUF_AVX_STORE(p, v)		_mm256_storeu_si256((__m256i *)(p), v)
+#define VECSHUF_AVX512_LOAD(p)		_mm512_loadu_si512((const void *)(p))
+#define VECSHUF_AVX512_STORE(p, v)	_mm512_storeu_si512((void *)(p), v)
+#define VECSHUF_VPERMB(v, m)		_mm512_permutexvar_epi8(m, v)
+
+STRESS_VECSHUF_ISA(stress_vecshuf_isa_ssse3, OPTIMIZE3 __attribute__((target("ssse3"))),
+	__m128i, VECSHUF_SSE_LOAD, VECSHUF_SSE_STORE, _mm_shuffle_epi8)
+STRESS_VECSHUF_ISA(stress_vecshuf_isa_avx2_pshufb, OPTIMIZE3 __attribute__((target("avx2"))),
+	__m256i, VECSHUF_AVX_LOAD, VECSHUF_AVX_STORE, _mm256_shuffle_epi8)
+STRESS_VECSHUF_ISA(stress_vecshuf_isa_avx2_vpermd, OPTIMIZE3 __attribute__((target("avx2"))),
+	__m256i, VECSHUF_AVX_LOAD, VECSHUF_AVX_STORE, _mm256_permutevar8x32_epi32)
+STRESS_VECSHUF_ISA(stress_vecshuf_isa_avx512_vpermb, OPTIMIZE3 __attribute__((target("avx512f,avx512bw,avx512vbmi"))),
+	__m512i, VECSHUF_AVX512_LOAD, VECSHUF_AVX512_STORE, VECSHUF_VPERMB)
+
+static bool stress_vecshuf_isa_has_ssse3(void)
+{
+	return __builtin_cpu_supports("ssse3");
+}
+
+static bool stress_vecshuf_isa_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static bool stress_vecshuf_isa_has_avx512vbmi(void)
+{
+	return __builtin_cpu_supports("avx512vbmi");
+}
+#endif
+
+#if defined(STRESS_VECSHUF_HAVE_NEON)
+#define VECSHUF_NEON_STORE(p, v)	vst1q_u8(p, v)
+
+STRESS_VECSHUF_ISA(stress_vecshuf_isa_neon_tbl, OPTIMIZE3, uint8x16_t,
+	vld1q_u8, VECSHUF_NEON_STORE, vqtbl1q_u8)
+
+static bool stress_vecshuf_isa_has_neon(void)
+{
+	return true;
+}
+#endif
+
+#if defined(STRESS_VECSHUF_HAVE_SVE)
+/*
+ *  SVE vectors are sizeless so the generic kernel macro cannot use
+ *  sizeof, the vector length is only known at run time
+ */
+static uint64_t OPTIMIZE3 stress_vecshuf_isa_sve_tbl(
+	uint8_t *data,
+	const uint8_t *mask1,
+	const uint8_t *mask2,
+	const uint32_t loops)
+{
+	const size_t n = svcntb();
+	const svbool_t pg = svptrue_b8();
+	const svuint8_t m1 = svld1_u8(pg, mask1);
+	const svuint8_t m2 = svld1_u8(pg, mask2);
+	svuint8_t v0 = svld1_u8(pg, data + (n * 0));
+	svuint8_t v1 = svld1_u8(pg, data + (n * 1));
+	svuint8_t v2 = svld1_u8(pg, data + (n * 2));
+	svuint8_t v3 = svld1_u8(pg, data + (n * 3));
+	svuint8_t v4 = svld1_u8(pg, data + (n * 4));
+	svuint8_t v5 = svld1_u8(pg, data + (n * 5));
+	svuint8_t v6 = svld1_u8(pg, data + (n * 6));
+	svuint8_t v7 = svld1_u8(pg, data + (n * 7));
+	register uint32_t i;
+
+	for (i = 0; i < loops; i++) {
+		v0 = svtbl_u8(v0, m1);
+		v1 = svtbl_u8(v1, m1);
+		v2 = svtbl_u8(v2, m1);
+		v3 = svtbl_u8(v3, m1);
+		v4 = svtbl_u8(v4, m1);
+		v5 = svtbl_u8(v5, m1);
+		v6 = svtbl_u8(v6, m1);
+		v7 = svtbl_u8(v7, m1);
+		v0 = svtbl_u8(v0, m2);
+		v1 = svtbl_u8(v1, m2);
+		v2 = svtbl_u8(v2, m2);
+		v3 = svtbl_u8(v3, m2);
+		v4 = svtbl_u8(v4, m2);
+		v5 = svtbl_u8(v5, m2);
+		v6 = svtbl_u8(v6, m2);
+		v7 = svtbl_u8(v7, m2);
+	}
+	svst1_u8(pg, data + (n * 0), v0);
+	svst1_u8(pg, data + (n * 1), v1);
+	svst1_u8(pg, data + (n * 2), v2);
+	svst1_u8(pg, data + (n * 3), v3);
+	svst1_u8(pg, data + (n * 4), v4);
+	svst1_u8(pg, data + (n * 5), v5);
+	svst1_u8(pg, data + (n * 6), v6);
+	svst1_u8(pg, data + (n * 7), v7);
+
+	return (uint64_t)loops * 2 * VECSHUF_ISA_CHAINS;
+}
+
+static bool stress_vecshuf_isa_has_sve(void)
+{
+	return true;
+}
+#endif
+
+static const stress_vecshuf_isa_t stress_vecshuf_isas[] = {
+	{ "generic",		"__builtin_shuffle", stress_vecshuf_isa_has_generic,
+	  stress_vecshuf_isa_generic,		64, 1, 64 },
+#if defined(STRESS_VECSHUF_HAVE_X86)
+	{ "ssse3",		"pshufb",	stress_vecshuf_isa_has_ssse3,
+	  stress_vecshuf_isa_ssse3,		16, 1, 16 },
+	{ "avx2-pshufb",	"vpshufb",	stress_vecshuf_isa_has_avx2,
+	  stress_vecshuf_isa_avx2_pshufb,	32, 1, 16 },
+	{ "avx2-vpermd",	"vpermd",	stress_vecshuf_isa_has_avx2,
+	  stress_vecshuf_isa_avx2_vpermd,	32, 4, 32 },
+	{ "avx512-vpermb",	"vpermb",	stress_vecshuf_isa_has_avx512vbmi,
+	  stress_vecshuf_isa_avx512_vpermb,	64, 1, 64 },
+#endif
+#if defined(STRESS_VECSHUF_HAVE_NEON)
+	{ "neon-tbl",		"tbl",		stress_vecshuf_isa_has_neon,
+	  stress_vecshuf_isa_neon_tbl,		16, 1, 16 },
+#endif
+#if defined(STRESS_VECSHUF_HAVE_SVE)
+	{ "sve-tbl",		"tbl",		stress_vecshuf_isa_has_sve,
+	  stress_vecshuf_isa_sve_tbl,		0, 1, 0 },
+#endif
+};
+
+typedef struct {
+	uint8_t data[VECSHUF_ISA_CHAINS * VECSHUF_ISA_MAX_BYTES] ALIGNED(64);
+	uint8_t orig[VECSHUF_ISA_CHAINS * VECSHUF_ISA_MAX_BYTES] ALIGNED(64);
+	uint8_t mask1[VECSHUF_ISA_MAX_BYTES] ALIGNED(64);
+	uint8_t mask2[VECSHUF_ISA_MAX_BYTES] ALIGNED(64);
+} stress_vecshuf_isa_data_t;
+
+typedef struct {
+	uint64_t shuffles;		/* shuffle instructions executed */
+	uint64_t cycles;		/* CPU cycles taken */
+	double secs;			/* time taken */
+} stress_vecshuf_isa_result_t;
+
+/*
+ *  stress_vecshuf_isa_bytes()
+ *	vector size of an ISA shuffle in bytes
+ */
+static size_t stress_vecshuf_isa_bytes(const stress_vecshuf_isa_t *isa)
+{
+#if defined(STRESS_VECSHUF_HAVE_SVE)
+	if (isa->bytes == 0)
+		return STRESS_MINIMUM(svcntb(), VECSHUF_ISA_MAX_BYTES);
+#endif
+	return isa->bytes;
+}
+
+/*
+ *  stress_set_vecshuf_isa()
+ *	select the ISA shuffles to benchmark, "all" for all supported
+ */
+static int stress_set_vecshuf_isa(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		i = SIZEOF_ARRAY(stress_vecshuf_isas);
+		stress_set_setting("vecshuf-isa", TYPE_ID_SIZE_T, &i);
+		return 0;
+	}
+	for (i = 0; i < SIZEOF_ARRAY(stress_vecshuf_isas); i++) {
+		if (!strcmp(stress_vecshuf_isas[i].name, name)) {
+			stress_set_setting("vecshuf-isa", TYPE_ID_SIZE_T, &i);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "vecshuf-isa must be one of: all");
+	for (i = 0; i < SIZEOF_ARRAY(stress_vecshuf_isas); i++) {
+		(void)fprintf(stderr, " %s", stress_vecshuf_isas[i].name);
+	}
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_vecshuf_isa_set_mask()
+ *	rotate the elements of each lane by a random 1..N-1 positions with
+ *	mask1 and rotate them back with mask2, indices are little endian
+ *	elements, lane relative for in-lane shuffles such as pshufb
+ */
+static void stress_vecshuf_isa_set_mask(
+	const stress_vecshuf_isa_t *isa,
+	const size_t bytes,
+	stress_vecshuf_isa_data_t *data)
+{
+	const size_t lane_bytes = isa->lane_bytes ? isa->lane_bytes : bytes;
+	const size_t elems = lane_bytes / isa->elem_bytes;
+	const size_t shift = 1 + (size_t)stress_mwc32modn((uint32_t)(elems - 1));
+	size_t i;
+
+	(void)memset(data->mask1, 0, sizeof(data->mask1));
+	(void)memset(data->mask2, 0, sizeof(data->mask2));
+	for (i = 0; i < bytes / isa->elem_bytes; i++) {
+		const size_t lane_elem = i % elems;
+
+		data->mask1[i * isa->elem_bytes] = (uint8_t)((lane_elem + shift) % elems);
+		data->mask2[i * isa->elem_bytes] = (uint8_t)((lane_elem + elems - shift) % elems);
+	}
+}
+
+/*
+ *  stress_vecshuf_isa()
+ *	benchmark the throughput of ISA specific shuffles in shuffles
+ *	and bytes shuffled per cycle
+ */
+static int stress_vecshuf_isa(const stress_args_t *args, const size_t vecshuf_isa)
+{
+	stress_vecshuf_isa_result_t results[SIZEOF_ARRAY(stress_vecshuf_isas)];
+	stress_vecshuf_isa_data_t *data;
+	size_t i, idx = 0, n_supported = 0;
+	int perf_fd;
+	uint64_t c;
+	bool has_cycles, ran;
+
+	for (i = 0; i < SIZEOF_ARRAY(stress_vecshuf_isas); i++) {
+		if (((vecshuf_isa == SIZEOF_ARRAY(stress_vecshuf_isas)) || (vecshuf_isa == i)) &&
+		    stress_vecshuf_isas[i].supported())
+			n_supported++;
+	}
+	if (n_supported == 0) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s shuffles are not supported by this CPU, "
+				"skipping stressor\n", args->name,
+				stress_vecshuf_isas[vecshuf_isa].name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+
+	data = (stress_vecshuf_isa_data_t *)mmap(NULL, sizeof(*data), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {
+		pr_inf_skip("%s: failed to allocate %zd bytes for vectors, skipping stressor\n",
+			args->name, sizeof(*data));
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < sizeof(data->data); i++) {
+		data->data[i] = stress_mwc8();
+		data->orig[i] = data->data[i];
+	}
+	(void)memset(results, 0, sizeof(results));
+
+	perf_fd = stress_perf_cycles_open();
+	has_cycles = stress_perf_cycles_read(perf_fd, &c);
+	if ((args->instance == 0) && has_cycles && (perf_fd < 0))
+		pr_dbg("%s: CPU cycles counter not available, using the TSC\n", args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		ran = false;
+		for (i = 0; (i < SIZEOF_ARRAY(stress_vecshuf_isas)) && keep_stressing(args); i++) {
+			const stress_vecshuf_isa_t *isa = &stress_vecshuf_isas[i];
+			const size_t bytes = stress_vecshuf_isa_bytes(isa);
+			stress_vecshuf_isa_result_t *result = &results[i];
+			uint64_t c0 = 0, c1 = 0, shuffles = 0;
+			double t_start, t;
+
+			if ((vecshuf_isa != SIZEOF_ARRAY(stress_vecshuf_isas)) && (vecshuf_isa != i))
+				continue;
+			if (!isa->supported())
+				continue;
+
+			stress_vecshuf_isa_set_mask(isa, bytes, data);
+			t_start = stress_time_now();
+			(void)stress_perf_cycles_read(perf_fd, &c0);
+			do {
+				shuffles += isa->func(data->data, data->mask1, data->mask2, VECSHUF_ISA_LOOPS);
+				t = stress_time_now() - t_start;
+			} while ((t < VECSHUF_ISA_SLICE) && keep_stressing(args));
+			if (has_cycles && stress_perf_cycles_read(perf_fd, &c1) && (c1 > c0))
+				result->cycles += c1 - c0;
+			result->shuffles += shuffles;
+			result->secs += t;
+			inc_counter(args);
+
+			if (memcmp(data->data, data->orig, bytes * VECSHUF_ISA_CHAINS)) {
+				pr_fail("%s: shuffling error, %s shuffles did not restore the data\n",
+					args->name, isa->name);
+				(void)memcpy(data->data, data->orig, sizeof(data->data));
+			}
+			ran = true;
+		}
+	} while (ran && keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (perf_fd >= 0)
+		(void)close(perf_fd);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: throughput of %d independent shuffle chains%s\n",
+			args->name, VECSHUF_ISA_CHAINS,
+			has_cycles ? ((perf_fd < 0) ? ", cycles from the TSC" : "") :
+			", no cycle counter available");
+		pr_inf("%s: %-14s %-18s %5s %12s %12s %12s\n", args->name,
+			"isa", "instruction", "bits", "shuf/cycle", "bytes/cycle", "Mshuf/sec");
+	}
+	for (i = 0; i < SIZEOF_ARRAY(stress_vecshuf_isas); i++) {
+		const stress_vecshuf_isa_t *isa = &stress_vecshuf_isas[i];
+		const stress_vecshuf_isa_result_t *result = &results[i];
+		const size_t bytes = stress_vecshuf_isa_bytes(isa);
+		char shuf_cyc[16], bytes_cyc[16], str[64];
+		double rate;
+
+		if ((result->shuffles == 0) || (result->secs <= 0.0))
+			continue;
+
+		rate = ((double)result->shuffles / result->secs) / 1000000.0;
+		if (result->cycles) {
+			const double per_cycle = (double)result->shuffles / (double)result->cycles;
+
+			(void)snprintf(shuf_cyc, sizeof(shuf_cyc), "%.3f", per_cycle);
+			(void)snprintf(bytes_cyc, sizeof(bytes_cyc), "%.3f", per_cycle * (double)bytes);
+			(void)snprintf(str, sizeof(str), "%s shuffles per cycle", isa->name);
+			stress_metrics_set(args, idx++, str, per_cycle);
+		} else {
+			(void)shim_strlcpy(shuf_cyc, "-", sizeof(shuf_cyc));
+			(void)shim_strlcpy(bytes_cyc, "-", sizeof(bytes_cyc));
+			(void)snprintf(str, sizeof(str), "%s Mshuffles per sec", isa->name);
+			stress_metrics_set(args, idx++, str, rate);
+		}
+		if (args->instance == 0)
+			pr_inf("%s: %-14s %-18s %5zu %12s %12s %12.3f\n", args->name,
+				isa->name, isa->insn, bytes * 8, shuf_cyc, bytes_cyc, rate);
+	}
+	if (args->instance == 0)
+		pr_unlock();
+
+	(void)munmap((void *)data, sizeof(*data));
+
+	return EXIT_SUCCESS;
+}
+
 static int stress_vecshuf(const stress_args_t *args)
 {
 	stress_vec_data_t *data;
 	size_t vecshuf_method = 0;	/* "all" */
+	size_t vecshuf_isa;
 	size_t i;
 
+	if (stress_get_setting("vecshuf-isa", &vecshuf_isa))
+		return stress_vecshuf_isa(args, vecshuf_isa);
+
 	data = (stress_vec_data_t *)mmap(NULL, sizeof(*data), PROT_READ | PROT_WRITE,
 			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (data == MAP_FAILED) {
@@ -394,7 +854,9 @@ static int stress_vecshuf(const stress_args_t *args)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vecshuf_isa,	stress_set_vecshuf_isa },
         { OPT_vecshuf_method,	stress_set_vecshuf_method },
+	{ 0,			NULL }
 };
 
 stressor_info_t stress_vecshuf_info = {
@@ -417,8 +879,22 @@ static int stress_set_vecshuf_method(const char *name)
 	return 0;
 }
 
+/*
+ *  stress_set_vecshuf_isa()
+ *	set the ISA shuffles to benchmark, no-op
+ */
+static int stress_set_vecshuf_isa(const char *name)
+{
+	(void)name;
+
+	fprintf(stderr, "option --vecshuf-isa is not implemented, ignoring option '%s'\n", name);
+	return 0;
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vecshuf_isa,	stress_set_vecshuf_isa },
         { OPT_vecshuf_method,	stress_set_vecshuf_method },
+	{ 0,			NULL }
 };
 
 stressor_info_t stress_vecshuf_info = {
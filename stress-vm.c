@@ -20,15 +20,31 @@
 #include "stress-ng.h"
 #include "core-builtin.h"
 #include "core-cpu-cache.h"
+#include "core-edac.h"
 #include "core-target-clones.h"
 #include "core-nt-load.h"
 #include "core-nt-store.h"
+#include "core-perf.h"
 #include "core-vecmath.h"
 
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+/* threads need their own method and random number state */
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_THREAD_LOCAL)
+#define STRESS_VM_THREADS
+#endif
+
 #define MIN_VM_BYTES		(4 * KB)
 #define MAX_VM_BYTES		(MAX_MEM_LIMIT)
 #define DEFAULT_VM_BYTES	(256 * MB)
 
+#define MIN_VM_THREADS		(1)
+#define MAX_VM_THREADS		(256)
+#define DEFAULT_VM_THREADS	(1)
+
 #define MIN_VM_HANG		(0)
 #define MAX_VM_HANG		(3600)
 #define DEFAULT_VM_HANG		(~0ULL)
@@ -41,6 +57,8 @@
 
 #define NO_MEM_RETRIES_MAX	(100)
 
+#define VM_BURNIN_BLOCK		(4096 / sizeof(uint64_t))	/* words compared per block */
+
 static size_t stress_vm_cache_line_size;
 
 /*
@@ -52,6 +70,8 @@ typedef size_t (*stress_vm_func)(void *buf, void *buf_end, const size_t sz,
 typedef struct {
 	const char *name;
 	const stress_vm_func func;
+	const double rd_passes;		/* bytes read per pass / buffer size */
+	const double wr_passes;		/* bytes written per pass / buffer size */
 } stress_vm_method_info_t;
 
 typedef struct {
@@ -68,6 +88,7 @@ static const stress_vm_method_info_t vm_methods[];
 
 static const stress_help_t help[] = {
 	{ "m N", "vm N",	 "start N workers spinning on anonymous mmap" },
+	{ NULL,	 "vm-backing B", "specify vm buffer backing, 4k, thp, 2m or 1g pages" },
 	{ NULL,	 "vm-bytes N",	 "allocate N bytes per vm worker (default 256MB)" },
 	{ NULL,	 "vm-hang N",	 "sleep N seconds before freeing memory" },
 	{ NULL,	 "vm-keep",	 "redirty memory instead of reallocating" },
@@ -80,6 +101,7 @@ static const stress_help_t help[] = {
 #if defined(MAP_POPULATE)
 	{ NULL,	 "vm-populate",	 "populate (prefault) page tables for a mapping" },
 #endif
+	{ NULL,	 "vm-threads N", "run N threads per vm worker on stripes of one mapping" },
 	{ NULL,	 NULL,		 NULL }
 };
 
@@ -182,6 +204,11 @@ static int stress_set_vm_mmap_populate(const char *opt)
 #endif
 }
 
+static int stress_set_vm_backing(const char *opt)
+{
+	return stress_set_mmap_backing("vm-backing", opt);
+}
+
 static int stress_set_vm_madvise(const char *opt)
 {
 	const stress_vm_madvise_info_t *info;
@@ -205,6 +232,16 @@ static int stress_set_vm_keep(const char *opt)
 	return stress_set_setting_true("vm-keep", opt);
 }
 
+static int stress_set_vm_threads(const char *opt)
+{
+	uint32_t vm_threads;
+
+	vm_threads = stress_get_uint32(opt);
+	stress_check_range("vm-threads", (uint64_t)vm_threads,
+		MIN_VM_THREADS, MAX_VM_THREADS);
+	return stress_set_setting("vm-threads", TYPE_ID_UINT32, &vm_threads);
+}
+
 #define SET_AND_TEST(ptr, val, bit_errors)	\
 do {						\
 	*ptr = val;				\
@@ -712,7 +749,7 @@ static size_t TARGET_CLONES stress_vm_gray(
 	const stress_args_t *args,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static THREAD_LOCAL uint8_t val = 0;
 	uint8_t v;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
@@ -756,7 +793,7 @@ static size_t TARGET_CLONES stress_vm_grayflip(
 	const stress_args_t *args,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static THREAD_LOCAL uint8_t val = 0;
 	uint8_t v;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
@@ -817,7 +854,7 @@ static size_t TARGET_CLONES stress_vm_incdec(
 	const stress_args_t *args,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static THREAD_LOCAL uint8_t val = 0;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
 	uint64_t c = get_counter(args);
@@ -861,7 +898,7 @@ static size_t TARGET_CLONES stress_vm_prime_incdec(
 	const stress_args_t *args,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static THREAD_LOCAL uint8_t val = 0;
 	volatile uint8_t *ptr = buf;
 	size_t bit_errors = 0, i;
 	const uint64_t prime = stress_get_prime64(sz + 4096);
@@ -1471,7 +1508,7 @@ static size_t TARGET_CLONES stress_vm_inc_nybble(
 	const stress_args_t *args,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static THREAD_LOCAL uint8_t val = 0;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
 	uint64_t c = get_counter(args);
@@ -1881,7 +1918,7 @@ static size_t OPTIMIZE3 TARGET_CLONES stress_vm_write64(
 	const stress_args_t *args,
 	const uint64_t max_ops)
 {
-	static uint64_t val;
+	static THREAD_LOCAL uint64_t val;
 	uint64_t *ptr = (uint64_t *)buf;
 	register const uint64_t v = val;
 	register size_t i = 0;
@@ -1948,7 +1985,7 @@ static size_t TARGET_CLONES stress_vm_write64nt(
 	const uint64_t max_ops)
 {
 	if (stress_cpu_x86_has_sse2()) {
-		static uint64_t val;
+		static THREAD_LOCAL uint64_t val;
 		uint64_t *ptr = (uint64_t *)buf;
 		register const uint64_t v = val;
 		register size_t i = 0;
@@ -2093,7 +2130,7 @@ static size_t TARGET_CLONES stress_vm_write1024v(
 
 	stress_vint8w1024_t *ptr = (stress_vint8w1024_t *)buf;
 	stress_vint8w1024_t v;
-	static uint64_t val = 0;
+	static THREAD_LOCAL uint64_t val = 0;
 	uint64x16_t *vptr = (uint64x16_t *)&v;
 	register size_t i = 0;
 	register const size_t n = sz / sizeof(*ptr);
@@ -2144,7 +2181,7 @@ static size_t TARGET_CLONES stress_vm_rowhammer(
 {
 	size_t bit_errors = 0;
 	uint32_t *buf32 = (uint32_t *)buf;
-	static uint32_t val = 0xff5a00a5;
+	static THREAD_LOCAL uint32_t val = 0xff5a00a5;
 	register size_t j;
 	register volatile uint32_t *addr0, *addr1;
 	register size_t errors = 0;
@@ -2896,73 +2933,260 @@ static size_t TARGET_CLONES stress_vm_checkerboard(
 }
 
 /*
- *  stress_vm_all()
- *	work through all vm stressors sequentially
+ *  burn-in data patterns, each word is the pattern xor'd with its
+ *  own address so address line faults are caught too, and each
+ *  pattern is followed by its inverse to flip every bit
  */
-static size_t stress_vm_all(
+static const uint64_t vm_burnin_patterns[] = {
+	0x0000000000000000ULL,
+	0x5555555555555555ULL,
+	0x3333333333333333ULL,
+	0x0f0f0f0f0f0f0f0fULL,
+	0x00ff00ff00ff00ffULL,
+	0x0000ffff0000ffffULL,
+	0x00000000ffffffffULL,
+};
+
+/*
+ *  stress_vm_burnin_fill()
+ *	fill memory with the pattern xor'd with the address, using
+ *	non-temporal stores where possible to avoid the cache
+ *	read-for-ownership and to push the data out to the DIMMs
+ */
+static void OPTIMIZE3 stress_vm_burnin_fill(
+	uint64_t *buf,
+	const uint64_t *buf_end,
+	const uint64_t pattern)
+{
+	register uint64_t *ptr;
+
+#if defined(HAVE_NT_STORE64)
+	if (stress_cpu_x86_has_sse2()) {
+		for (ptr = buf; ptr < buf_end; ptr += 8) {
+			stress_nt_store64(ptr + 0, pattern ^ (uint64_t)(uintptr_t)(ptr + 0));
+			stress_nt_store64(ptr + 1, pattern ^ (uint64_t)(uintptr_t)(ptr + 1));
+			stress_nt_store64(ptr + 2, pattern ^ (uint64_t)(uintptr_t)(ptr + 2));
+			stress_nt_store64(ptr + 3, pattern ^ (uint64_t)(uintptr_t)(ptr + 3));
+			stress_nt_store64(ptr + 4, pattern ^ (uint64_t)(uintptr_t)(ptr + 4));
+			stress_nt_store64(ptr + 5, pattern ^ (uint64_t)(uintptr_t)(ptr + 5));
+			stress_nt_store64(ptr + 6, pattern ^ (uint64_t)(uintptr_t)(ptr + 6));
+			stress_nt_store64(ptr + 7, pattern ^ (uint64_t)(uintptr_t)(ptr + 7));
+		}
+		/* order the non-temporal stores before the checks */
+		shim_mfence();
+		return;
+	}
+#endif
+	for (ptr = buf; ptr < buf_end; ptr += 8) {
+		ptr[0] = pattern ^ (uint64_t)(uintptr_t)(ptr + 0);
+		ptr[1] = pattern ^ (uint64_t)(uintptr_t)(ptr + 1);
+		ptr[2] = pattern ^ (uint64_t)(uintptr_t)(ptr + 2);
+		ptr[3] = pattern ^ (uint64_t)(uintptr_t)(ptr + 3);
+		ptr[4] = pattern ^ (uint64_t)(uintptr_t)(ptr + 4);
+		ptr[5] = pattern ^ (uint64_t)(uintptr_t)(ptr + 5);
+		ptr[6] = pattern ^ (uint64_t)(uintptr_t)(ptr + 6);
+		ptr[7] = pattern ^ (uint64_t)(uintptr_t)(ptr + 7);
+	}
+}
+
+#if defined(HAVE_VECMATH)
+typedef uint64_t stress_vuint64w512_t	__attribute__ ((vector_size(512 / 8)));
+#endif
+
+/*
+ *  stress_vm_burnin_mismatch()
+ *	return true if any word in a block differs from the
+ *	expected pattern, compared 512 bits at a time where
+ *	vector maths is available
+ */
+static bool OPTIMIZE3 stress_vm_burnin_mismatch(
+	const uint64_t *buf,
+	const uint64_t *buf_end,
+	const uint64_t pattern)
+{
+#if defined(HAVE_VECMATH)
+	const stress_vuint64w512_t *vptr = (const stress_vuint64w512_t *)buf;
+	const stress_vuint64w512_t *vend = (const stress_vuint64w512_t *)buf_end;
+	const uint64_t addr = (uint64_t)(uintptr_t)buf;
+	const stress_vuint64w512_t vinc = {
+		64, 64, 64, 64, 64, 64, 64, 64,
+	};
+	stress_vuint64w512_t vexpected = {
+		addr + 0, addr + 8, addr + 16, addr + 24,
+		addr + 32, addr + 40, addr + 48, addr + 56,
+	};
+	const stress_vuint64w512_t vpattern = {
+		pattern, pattern, pattern, pattern,
+		pattern, pattern, pattern, pattern,
+	};
+	stress_vuint64w512_t vdiff = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	for (; vptr < vend; vptr++) {
+		vdiff |= *vptr ^ vexpected ^ vpattern;
+		vexpected += vinc;
+	}
+	return (vdiff[0] | vdiff[1] | vdiff[2] | vdiff[3] |
+		vdiff[4] | vdiff[5] | vdiff[6] | vdiff[7]) != 0;
+#else
+	register const uint64_t *ptr;
+	register uint64_t diff = 0;
+
+	for (ptr = buf; ptr < buf_end; ptr += 4) {
+		diff |= ptr[0] ^ pattern ^ (uint64_t)(uintptr_t)(ptr + 0);
+		diff |= ptr[1] ^ pattern ^ (uint64_t)(uintptr_t)(ptr + 1);
+		diff |= ptr[2] ^ pattern ^ (uint64_t)(uintptr_t)(ptr + 2);
+		diff |= ptr[3] ^ pattern ^ (uint64_t)(uintptr_t)(ptr + 3);
+	}
+	return diff != 0;
+#endif
+}
+
+/*
+ *  stress_vm_burnin_check()
+ *	check memory a block at a time with the fast compare and
+ *	only count the bad bits of the blocks that mismatch
+ */
+static size_t stress_vm_burnin_check(
+	const uint64_t *buf,
+	const uint64_t *buf_end,
+	const uint64_t pattern)
+{
+	const uint64_t *ptr;
+	size_t bit_errors = 0;
+
+	for (ptr = buf; ptr < buf_end; ptr += VM_BURNIN_BLOCK) {
+		const uint64_t *end = ptr + VM_BURNIN_BLOCK;
+		const uint64_t *word;
+
+		if (end > buf_end)
+			end = buf_end;
+		if (LIKELY(!stress_vm_burnin_mismatch(ptr, end, pattern)))
+			continue;
+		for (word = ptr; word < end; word++)
+			bit_errors += stress_vm_count_bits(*word ^ pattern ^ (uint64_t)(uintptr_t)word);
+	}
+	return bit_errors;
+}
+
+/*
+ *  stress_vm_burnin()
+ *	memory burn-in, maximise the verified bytes per second by
+ *	writing a pattern and its inverse with non-temporal stores
+ *	and checking each with a vectorised compare
+ */
+static size_t TARGET_CLONES stress_vm_burnin(
 	void *buf,
 	void *buf_end,
 	const size_t sz,
 	const stress_args_t *args,
 	const uint64_t max_ops)
 {
-	static int i = 1;
+	static THREAD_LOCAL size_t idx = 0;
+	uint64_t *buf64 = (uint64_t *)buf;
+	const uint64_t *buf_end64 = (const uint64_t *)buf_end;
+	uint64_t pattern = vm_burnin_patterns[idx];
+	uint64_t c = get_counter(args);
 	size_t bit_errors = 0;
+	int i;
 
-	bit_errors = vm_methods[i].func(buf, buf_end, sz, args, max_ops);
-	i++;
-	if (vm_methods[i].func == NULL)
-		i = 1;
+	for (i = 0; i < 2; i++, pattern = ~pattern) {
+		stress_vm_burnin_fill(buf64, buf_end64, pattern);
+		inject_random_bit_errors(buf, sz);
+		bit_errors += stress_vm_burnin_check(buf64, buf_end64, pattern);
+		c += sz / sizeof(*buf64);
+		if (UNLIKELY(max_ops && (c >= max_ops))) {
+			c = max_ops;
+			break;
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			break;
+	}
+	idx++;
+	if (idx >= SIZEOF_ARRAY(vm_burnin_patterns))
+		idx = 0;
+	stress_vm_check("burnin", bit_errors);
+	set_counter(args, c);
 
 	return bit_errors;
 }
 
+/*
+ *  stress_vm_all()
+ *	dummy function, not called, stress_vm_child works
+ *	through all vm stressors sequentially
+ */
+static size_t stress_vm_all(
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	(void)buf;
+	(void)buf_end;
+	(void)sz;
+	(void)args;
+	(void)max_ops;
+
+	return 0;
+}
+
+/*
+ *  rd_passes and wr_passes are the bytes each method reads and writes
+ *  in one complete pass, in units of the buffer size, so a full pass
+ *  over sz bytes moves (rd_passes + wr_passes) * sz bytes; methods
+ *  that touch one byte per cache line are counted as whole lines
+ */
 static const stress_vm_method_info_t vm_methods[] = {
-	{ "all",		stress_vm_all },
-	{ "cache-lines",	stress_vm_cache_lines },
-	{ "cache-stripe",	stress_vm_cache_stripe },
-	{ "checkerboard",	stress_vm_checkerboard },
-	{ "flip",		stress_vm_flip },
-	{ "fwdrev",		stress_vm_fwdrev },
-	{ "galpat-0",		stress_vm_galpat_zero },
-	{ "galpat-1",		stress_vm_galpat_one },
-	{ "gray",		stress_vm_gray },
-	{ "grayflip",		stress_vm_grayflip },
-	{ "rowhammer",		stress_vm_rowhammer },
-	{ "incdec",		stress_vm_incdec },
-	{ "inc-nybble",		stress_vm_inc_nybble },
-	{ "lfsr32",		stress_vm_lfsr32 },
-	{ "rand-set",		stress_vm_rand_set },
-	{ "rand-sum",		stress_vm_rand_sum },
-	{ "read64",		stress_vm_read64 },
-	{ "ror",		stress_vm_ror },
-	{ "swap",		stress_vm_swap },
-	{ "move-inv",		stress_vm_moving_inversion },
-	{ "modulo-x",		stress_vm_modulo_x },
-	{ "mscan",		stress_vm_mscan },
+	{ "all",		stress_vm_all, 0.0, 0.0 },
+	{ "burnin",		stress_vm_burnin, 2.0, 2.0 },
+	{ "cache-lines",	stress_vm_cache_lines, 1.0, 1.0 },
+	{ "cache-stripe",	stress_vm_cache_stripe, 1.0, 1.0 },
+	{ "checkerboard",	stress_vm_checkerboard, 2.0, 3.0 },
+	{ "flip",		stress_vm_flip, 9.0, 9.0 },
+	{ "fwdrev",		stress_vm_fwdrev, 1.0, 1.0 },
+	{ "galpat-0",		stress_vm_galpat_zero, 1.0, 1.0 },
+	{ "galpat-1",		stress_vm_galpat_one, 1.0, 1.0 },
+	{ "gray",		stress_vm_gray, 1.0, 1.0 },
+	{ "grayflip",		stress_vm_grayflip, 1.0, 1.0 },
+	{ "rowhammer",		stress_vm_rowhammer, 1.0, 1.0 },
+	{ "incdec",		stress_vm_incdec, 3.0, 2.0 },
+	{ "inc-nybble",		stress_vm_inc_nybble, 3.0, 3.0 },
+	{ "lfsr32",		stress_vm_lfsr32, 0.25, 0.25 },
+	{ "rand-set",		stress_vm_rand_set, 1.0, 1.0 },
+	{ "rand-sum",		stress_vm_rand_sum, 0.125, 0.125 },
+	{ "read64",		stress_vm_read64, 1.0, 0.0 },
+	{ "ror",		stress_vm_ror, 2.0, 2.0 },
+	{ "swap",		stress_vm_swap, 5.0, 5.0 },
+	{ "move-inv",		stress_vm_moving_inversion, 4.0, 4.0 },
+	{ "modulo-x",		stress_vm_modulo_x, 1.0, 23.0 },
+	{ "mscan",		stress_vm_mscan, 18.0, 16.0 },
 #if defined(HAVE_NT_STORE64)
-	{ "wrrd128nt",		stress_vm_wrrd128nt },
+	{ "wrrd128nt",		stress_vm_wrrd128nt, 4.0, 4.0 },
 #endif
-	{ "prime-0",		stress_vm_prime_zero },
-	{ "prime-1",		stress_vm_prime_one },
-	{ "prime-gray-0",	stress_vm_prime_gray_zero },
-	{ "prime-gray-1",	stress_vm_prime_gray_one },
-	{ "prime-incdec",	stress_vm_prime_incdec },
-	{ "walk-0d",		stress_vm_walking_zero_data },
-	{ "walk-1d",		stress_vm_walking_one_data },
-	{ "walk-0a",		stress_vm_walking_zero_addr },
-	{ "walk-1a",		stress_vm_walking_one_addr },
-	{ "write64",		stress_vm_write64 },
+	{ "prime-0",		stress_vm_prime_zero, 9.0, 9.0 },
+	{ "prime-1",		stress_vm_prime_one, 9.0, 9.0 },
+	{ "prime-gray-0",	stress_vm_prime_gray_zero, 3.0, 3.0 },
+	{ "prime-gray-1",	stress_vm_prime_gray_one, 3.0, 3.0 },
+	{ "prime-incdec",	stress_vm_prime_incdec, 3.0, 2.0 },
+	{ "walk-0d",		stress_vm_walking_zero_data, 8.0, 8.0 },
+	{ "walk-1d",		stress_vm_walking_one_data, 8.0, 8.0 },
+	{ "walk-0a",		stress_vm_walking_zero_addr, 0.0, 1.0 },
+	{ "walk-1a",		stress_vm_walking_one_addr, 0.0, 1.0 },
+	{ "write64",		stress_vm_write64, 0.0, 1.0 },
 #if defined(HAVE_NT_STORE64)
-	{ "write64nt",		stress_vm_write64nt },
+	{ "write64nt",		stress_vm_write64nt, 0.0, 1.0 },
 #endif
 #if defined(HAVE_VECMATH)
-	{ "write1024v",		stress_vm_write1024v },
+	{ "write1024v",		stress_vm_write1024v, 0.0, 1.0 },
 #endif
-	{ "zero-one",		stress_vm_zero_one },
-	{ NULL,		NULL  }
+	{ "zero-one",		stress_vm_zero_one, 2.0, 2.0 },
+	{ NULL,		NULL, 0.0, 0.0 }
 };
 
+static stress_metrics_t vm_metrics[SIZEOF_ARRAY(vm_methods)];
+static stress_metrics_t vm_bw_metrics[SIZEOF_ARRAY(vm_methods)];
+
 /*
  *  stress_set_vm_method()
  *      set default vm stress method
@@ -2987,6 +3211,194 @@ static int stress_set_vm_method(const char *name)
 	return -1;
 }
 
+/*
+ *  stress_vm_bandwidth_report()
+ *	set the GB per sec of the complete passes of each method and
+ *	for the 'all' method tabulate the read and write bandwidths
+ */
+static void stress_vm_bandwidth_report(const stress_args_t *args, const bool all)
+{
+	size_t i;
+	bool header = false;
+
+	for (i = 1; vm_methods[i].func; i++) {
+		const size_t idx = SIZEOF_ARRAY(vm_methods) + 1 + i;
+		const double passes = vm_methods[i].rd_passes + vm_methods[i].wr_passes;
+		double rate;
+		char msg[64];
+
+		if ((vm_bw_metrics[i].duration <= 0.0) || (passes <= 0.0))
+			continue;
+		rate = vm_bw_metrics[i].count / (vm_bw_metrics[i].duration * (double)GB);
+		if (idx < STRESS_MISC_METRICS_MAX) {
+			(void)snprintf(msg, sizeof(msg), "%s GB per sec", vm_methods[i].name);
+			stress_metrics_set(args, idx, msg, rate);
+		}
+		if (!all || (args->instance != 0))
+			continue;
+		if (!header) {
+			pr_inf("%s: %-14s %10s %10s %10s\n", args->name,
+				"method", "rd GB/s", "wr GB/s", "total GB/s");
+			header = true;
+		}
+		pr_inf("%s: %-14s %10.3f %10.3f %10.3f\n", args->name, vm_methods[i].name,
+			rate * vm_methods[i].rd_passes / passes,
+			rate * vm_methods[i].wr_passes / passes, rate);
+	}
+}
+
+/*
+ *  stress_vm_burnin_report()
+ *	report the verified GB per sec of the burn-in method and
+ *	the EDAC correctable and uncorrectable error counts of
+ *	each DIMM over the run
+ */
+static void stress_vm_burnin_report(
+	const stress_args_t *args,
+	const stress_edac_dimm_t *before,
+	const size_t n_before)
+{
+	const size_t idx = 2 * SIZEOF_ARRAY(vm_methods);
+	stress_edac_dimm_t after[STRESS_EDAC_DIMMS_MAX];
+	uint64_t ce_total = 0, ue_total = 0;
+	size_t i, j, n_after;
+
+	for (i = 1; vm_methods[i].func; i++) {
+		if (strcmp(vm_methods[i].name, "burnin"))
+			continue;
+		if ((vm_bw_metrics[i].duration > 0.0) && (idx + 2 < STRESS_MISC_METRICS_MAX)) {
+			const double verified = (double)vm_bw_metrics[i].count * vm_methods[i].rd_passes /
+				(vm_methods[i].rd_passes + vm_methods[i].wr_passes);
+
+			stress_metrics_set(args, idx + 2, "burnin verified GB per sec",
+				verified / (vm_bw_metrics[i].duration * (double)GB));
+		}
+		break;
+	}
+
+	if (args->instance != 0)
+		return;
+	if (n_before == 0) {
+		pr_inf("%s: no EDAC memory controllers found, memory error counts not available\n",
+			args->name);
+		return;
+	}
+	n_after = stress_edac_read(after, SIZEOF_ARRAY(after));
+	for (i = 0; i < n_after; i++) {
+		uint64_t ce = after[i].ce_count, ue = after[i].ue_count;
+
+		for (j = 0; j < n_before; j++) {
+			if (!strcmp(before[j].name, after[i].name)) {
+				ce -= before[j].ce_count;
+				ue -= before[j].ue_count;
+				break;
+			}
+		}
+		pr_inf("%s: EDAC %s: %" PRIu64 " correctable, %" PRIu64 " uncorrectable errors\n",
+			args->name, after[i].name, ce, ue);
+		ce_total += ce;
+		ue_total += ue;
+	}
+	if (idx + 1 < STRESS_MISC_METRICS_MAX) {
+		stress_metrics_set(args, idx, "EDAC correctable errors", (double)ce_total);
+		stress_metrics_set(args, idx + 1, "EDAC uncorrectable errors", (double)ue_total);
+	}
+}
+
+#if defined(STRESS_VM_THREADS)
+/* a thread running a vm method on its stripe of a shared mapping */
+typedef struct {
+	pthread_t pthread;		/* thread handle */
+	stress_args_t args;		/* copy of args with a private counter */
+	stress_counter_info_t ci;	/* per thread bogo-op counter */
+	uint8_t *buf;			/* start of stripe */
+	size_t sz;			/* size of stripe */
+	size_t method;			/* index into vm_methods */
+	uint64_t max_ops;		/* per thread bogo-op limit */
+	size_t bit_errors;		/* bit errors found */
+} stress_vm_thread_t;
+
+/*
+ *  stress_vm_thread()
+ *	fault in and run the vm method on a stripe of the mapping
+ */
+static void *stress_vm_thread(void *arg)
+{
+	stress_vm_thread_t *thread = (stress_vm_thread_t *)arg;
+
+	stress_mwc_reseed();
+	(void)stress_mincore_touch_pages(thread->buf, thread->sz);
+	thread->bit_errors = vm_methods[thread->method].func(thread->buf,
+		thread->buf + thread->sz, thread->sz, &thread->args, thread->max_ops);
+
+	return NULL;
+}
+
+/*
+ *  stress_vm_threads_run()
+ *	run a vm method with vm_threads threads, each on its own
+ *	contiguous page aligned stripe of the mapping, so all the
+ *	page faults and accesses happen concurrently in one mm
+ */
+static size_t stress_vm_threads_run(
+	const stress_args_t *args,
+	stress_vm_thread_t *threads,
+	const uint32_t vm_threads,
+	uint8_t *buf,
+	const size_t buf_sz,
+	const size_t method,
+	const uint64_t max_ops)
+{
+	const size_t stripe = (buf_sz / vm_threads) & ~(args->page_size - 1);
+	size_t bit_errors = 0;
+	uint64_t ops = 0;
+	uint32_t i, started = 0;
+
+	for (i = 0; i < vm_threads; i++) {
+		stress_vm_thread_t *thread = &threads[i];
+
+		(void)memset(&thread->ci, 0, sizeof(thread->ci));
+		(void)memcpy((void *)&thread->args, args, sizeof(thread->args));
+		thread->args.ci = &thread->ci;
+		thread->args.rate = NULL;
+		thread->buf = buf + (i * stripe);
+		thread->sz = (i == vm_threads - 1) ? buf_sz - (i * stripe) : stripe;
+		thread->method = method;
+		thread->max_ops = max_ops ? (max_ops / vm_threads) + 1 : 0;
+		thread->bit_errors = 0;
+		if (pthread_create(&thread->pthread, NULL, stress_vm_thread, thread) != 0)
+			break;
+		started++;
+	}
+	/* could not start any threads, run the method on the entire mapping */
+	if (!started) {
+		(void)stress_mincore_touch_pages(buf, buf_sz);
+		return vm_methods[method].func(buf, buf + buf_sz, buf_sz, args, max_ops);
+	}
+	for (i = 0; i < started; i++) {
+		(void)pthread_join(threads[i].pthread, NULL);
+		bit_errors += threads[i].bit_errors;
+		ops += threads[i].ci.counter;
+	}
+	add_counter(args, ops);
+
+	return bit_errors;
+}
+
+/*
+ *  stress_vm_faults()
+ *	page faults of the process so far
+ */
+static double stress_vm_faults(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return (double)usage.ru_minflt + (double)usage.ru_majflt;
+}
+#endif
+
 static int stress_vm_child(const stress_args_t *args, void *ctxt)
 {
 	int no_mem_retries = 0;
@@ -3001,7 +3413,19 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 	const size_t page_size = args->page_size;
 	bool vm_keep = false;
 	stress_vm_context_t *context = (stress_vm_context_t *)ctxt;
-	const stress_vm_func func = context->vm_method->func;
+	size_t i, method = (size_t)(context->vm_method - vm_methods), next = 1;
+	size_t vm_backing = 0;
+	uint64_t counter, dtlb_begin = 0, dtlb_end = 0;
+	double t, t_begin, duration;
+	bool has_backing, burnin;
+	stress_edac_dimm_t edac_before[STRESS_EDAC_DIMMS_MAX];
+	size_t edac_dimms = 0;
+	int dtlb_fd;
+	uint32_t vm_threads = DEFAULT_VM_THREADS;
+#if defined(STRESS_VM_THREADS)
+	stress_vm_thread_t *threads = NULL;
+	double threads_bytes = 0.0, threads_duration = 0.0, threads_faults = 0.0;
+#endif
 
 	(void)stress_get_setting("vm-hang", &vm_hang);
 	(void)stress_get_setting("vm-keep", &vm_keep);
@@ -3018,6 +3442,39 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 		vm_bytes = MIN_VM_BYTES;
 	buf_sz = vm_bytes & ~(page_size - 1);
 	(void)stress_get_setting("vm-madvise", &vm_madvise);
+	has_backing = stress_get_setting("vm-backing", &vm_backing);
+
+	(void)stress_get_setting("vm-threads", &vm_threads);
+	if (vm_threads > buf_sz / page_size)
+		vm_threads = (uint32_t)(buf_sz / page_size);
+#if defined(STRESS_VM_THREADS)
+	if (vm_threads > 1) {
+		threads = (stress_vm_thread_t *)calloc(vm_threads, sizeof(*threads));
+		if (!threads) {
+			pr_inf("%s: cannot allocate %" PRIu32 " thread states, "
+				"using 1 thread\n", args->name, vm_threads);
+			vm_threads = 1;
+		}
+	}
+#else
+	if ((vm_threads > 1) && (args->instance == 0))
+		pr_inf("%s: built without pthread or thread local storage support, "
+			"ignoring --vm-threads\n", args->name);
+	vm_threads = 1;
+#endif
+
+	dtlb_fd = stress_perf_dtlb_open();
+	if (!stress_perf_counter_read(dtlb_fd, &dtlb_begin)) {
+		if (dtlb_fd >= 0)
+			(void)close(dtlb_fd);
+		dtlb_fd = -1;
+	}
+	/* compare by name, target clones have per call site addresses */
+	burnin = !strcmp(vm_methods[method].name, "burnin") ||
+		 (context->vm_method == &vm_methods[0]);
+	if (burnin && (args->instance == 0))
+		edac_dimms = stress_edac_read(edac_before, SIZEOF_ARRAY(edac_before));
+	t_begin = stress_time_now();
 
 	do {
 		if (no_mem_retries >= NO_MEM_RETRIES_MAX) {
@@ -3028,9 +3485,20 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 		}
 		if (!vm_keep || (buf == NULL)) {
 			if (!keep_stressing_flag())
-				return EXIT_SUCCESS;
+				break;
 			if ((g_opt_flags & OPT_FLAGS_OOM_AVOID) && stress_low_memory(buf_sz)) {
 				buf = MAP_FAILED;
+			} else if (has_backing) {
+				buf = (uint8_t *)stress_mmap_backing(vm_backing, &buf_sz,
+					PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | vm_flags);
+				if ((buf == MAP_FAILED) && (errno == ENOTSUP)) {
+					pr_inf_skip("%s: %s backing is not supported, skipping stressor\n",
+						args->name, stress_mmap_backing_name(vm_backing));
+					buf = NULL;
+					rc = EXIT_NOT_IMPLEMENTED;
+					break;
+				}
 			} else {
 				buf = (uint8_t *)mmap(NULL, buf_sz,
 					PROT_READ | PROT_WRITE,
@@ -3044,15 +3512,56 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 				continue;	/* Try again */
 			}
 			buf_end = (void *)((uint8_t *)buf + buf_sz);
-			if (vm_madvise < 0)
-				(void)stress_madvise_random(buf, buf_sz);
-			else
-				(void)shim_madvise(buf, buf_sz, vm_madvise);
+			/* backed buffers keep the advice of the backing */
+			if (!has_backing) {
+				if (vm_madvise < 0)
+					(void)stress_madvise_random(buf, buf_sz);
+				else
+					(void)shim_madvise(buf, buf_sz, vm_madvise);
+			}
 		}
 
 		no_mem_retries = 0;
-		(void)stress_mincore_touch_pages(buf, buf_sz);
-		*(context->bit_error_count) += func(buf, buf_end, buf_sz, args, max_ops);
+
+		/* 'all' method, work through all the methods sequentially */
+		if (context->vm_method == &vm_methods[0]) {
+			method = next;
+			next++;
+			if (!vm_methods[next].func)
+				next = 1;
+		}
+#if defined(STRESS_VM_THREADS)
+		if (vm_threads > 1) {
+			/* each thread faults in its own stripe */
+			const double faults = stress_vm_faults();
+
+			t = stress_time_now();
+			counter = get_counter(args);
+			*(context->bit_error_count) += stress_vm_threads_run(args,
+				threads, vm_threads, buf, buf_sz, method, max_ops);
+			duration = stress_time_now() - t;
+			vm_metrics[method].duration += duration;
+			threads_duration += duration;
+			threads_bytes += (double)buf_sz;
+			threads_faults += stress_vm_faults() - faults;
+		} else
+#endif
+		{
+			(void)stress_mincore_touch_pages(buf, buf_sz);
+			t = stress_time_now();
+			counter = get_counter(args);
+			*(context->bit_error_count) += vm_methods[method].func(buf, buf_end, buf_sz, args, max_ops);
+			duration = stress_time_now() - t;
+			vm_metrics[method].duration += duration;
+		}
+		vm_metrics[method].count += (double)(get_counter(args) - counter) /
+					    (double)(1ULL << VM_BOGO_SHIFT);
+		/* only complete passes move a known number of bytes */
+		if (keep_stressing_flag() && (!max_ops || (get_counter(args) < max_ops))) {
+			vm_bw_metrics[method].duration += duration;
+			vm_bw_metrics[method].count += (double)buf_sz *
+				(vm_methods[method].rd_passes + vm_methods[method].wr_passes);
+		}
 
 		if (vm_hang == 0) {
 			while (keep_stressing_vm(args)) {
@@ -3063,7 +3572,8 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 		}
 
 		if (!vm_keep) {
-			(void)stress_madvise_random(buf, buf_sz);
+			if (!has_backing)
+				(void)stress_madvise_random(buf, buf_sz);
 			(void)munmap(buf, buf_sz);
 		}
 	} while (keep_stressing_vm(args));
@@ -3071,6 +3581,45 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 	if (vm_keep && buf != NULL)
 		(void)munmap((void *)buf, buf_sz);
 
+	/* dump metrics of methods except for first "all" method */
+	for (i = 1; vm_methods[i].func; i++) {
+		if (vm_metrics[i].duration > 0.0) {
+			char msg[64];
+			const double rate = vm_metrics[i].count / vm_metrics[i].duration;
+
+			(void)snprintf(msg, sizeof(msg), "%s vm ops per sec", vm_methods[i].name);
+			stress_metrics_set(args, i - 1, msg, rate);
+		}
+	}
+	stress_vm_bandwidth_report(args, context->vm_method == &vm_methods[0]);
+	if (burnin)
+		stress_vm_burnin_report(args, edac_before, edac_dimms);
+
+	if (dtlb_fd >= 0) {
+		const double duration = stress_time_now() - t_begin;
+
+		if (stress_perf_counter_read(dtlb_fd, &dtlb_end) && (duration > 0.0))
+			stress_metrics_set(args, SIZEOF_ARRAY(vm_methods) - 1,
+				"dTLB read misses per sec",
+				(double)(dtlb_end - dtlb_begin) / duration);
+		(void)close(dtlb_fd);
+	}
+
+#if defined(STRESS_VM_THREADS)
+	if (threads_duration > 0.0) {
+		char msg[64];
+
+		(void)snprintf(msg, sizeof(msg), "GB per sec over %" PRIu32 " thread mapping passes",
+			vm_threads);
+		stress_metrics_set(args, SIZEOF_ARRAY(vm_methods), msg,
+			threads_bytes / (threads_duration * (double)GB));
+		stress_metrics_set(args, SIZEOF_ARRAY(vm_methods) + 1,
+			"page faults per sec in threaded passes",
+			threads_faults / threads_duration);
+	}
+	free(threads);
+#endif
+
 	return rc;
 }
 
@@ -3171,6 +3720,7 @@ static void stress_vm_set_default(void)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vm_backing,	stress_set_vm_backing },
 	{ OPT_vm_bytes,		stress_set_vm_bytes },
 	{ OPT_vm_hang,		stress_set_vm_hang },
 	{ OPT_vm_keep,		stress_set_vm_keep },
@@ -3178,6 +3728,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_vm_method,	stress_set_vm_method },
 	{ OPT_vm_mmap_locked,	stress_set_vm_mmap_locked },
 	{ OPT_vm_mmap_populate,	stress_set_vm_mmap_populate },
+	{ OPT_vm_threads,	stress_set_vm_threads },
 	{ 0,			NULL }
 };
 
@@ -22,6 +22,15 @@
 #include "core-asm-ppc64.h"
 #include "core-asm-x86.h"
 #include "core-cpu.h"
+#include "core-power.h"
+
+#define WAITCPU_LATENCY_LOOPS	(10000)	/* wait ops per latency sample */
+#define WAITCPU_LATENCY_SAMPLES	(3)	/* latency samples, fastest is used */
+#define WAITCPU_POWER_TIME	(0.25)	/* seconds per method power measurement */
+#define WAITCPU_WAKE_ROUNDS	(1000)	/* wake round trips per sample */
+#define WAITCPU_WAKE_SAMPLES	(3)	/* wake samples, fastest is used */
+#define WAITCPU_WAKE_YIELD	(1U << 16)	/* spins before yielding */
+#define WAITCPU_UMWAIT_TICKS	(100000)	/* umwait deadline in TSC ticks */
 
 static const stress_help_t help[] = {
 	{ NULL,	"waitcpu N",		"start N workers exercising wait/pause/nop instructions" },
@@ -155,7 +164,7 @@ static void stress_waitcpu_x86_umwait1(void)
 
 	stress_asm_x86_umonitor(&delay);	/* Use dummy variable */
 	tsc = stress_asm_x86_rdtsc();
-	ret = stress_asm_x86_umwait(0, tsc + delay);
+	ret = stress_asm_x86_umwait(1, tsc + delay);
 	delay += (ret == 0) ? delay >> 6 : -(delay >> 6);
 }
 #endif
@@ -198,7 +207,7 @@ stress_waitcpu_method_t stress_waitcpu_method[] = {
 #if !defined(__PCC__) &&	\
     defined(HAVE_ARCH_X86_64)
 	{ "umwait0",	stress_waitcpu_x86_umwait0,	stress_waitcpu_x86_umwait_supported,	false, 0.0, 0.0 },
-	{ "umwait0",	stress_waitcpu_x86_umwait1,	stress_waitcpu_x86_umwait_supported,	false, 0.0, 0.0 },
+	{ "umwait1",	stress_waitcpu_x86_umwait1,	stress_waitcpu_x86_umwait_supported,	false, 0.0, 0.0 },
 #endif
 #endif
 #if defined(HAVE_ASM_ARM_YIELD)
@@ -211,6 +220,371 @@ stress_waitcpu_method_t stress_waitcpu_method[] = {
 #endif
 };
 
+/*
+ *  stress_waitcpu_latency()
+ *	fastest nanoseconds per wait op of a method
+ */
+static double stress_waitcpu_latency(const stress_waitcpu_method_t *method)
+{
+	double best = 0.0;
+	int i, j;
+
+	for (i = 0; i < WAITCPU_LATENCY_SAMPLES; i++) {
+		double t, ns;
+
+		t = stress_time_now();
+		for (j = 0; j < WAITCPU_LATENCY_LOOPS; j++)
+			method->waitfunc();
+		ns = (stress_time_now() - t) * STRESS_DBL_NANOSECOND / (double)WAITCPU_LATENCY_LOOPS;
+		if ((best <= 0.0) || (ns < best))
+			best = ns;
+	}
+	return best;
+}
+
+/*
+ *  stress_waitcpu_watts()
+ *	RAPL package power while running a method for
+ *	WAITCPU_POWER_TIME seconds, negative if not available
+ */
+static double stress_waitcpu_watts(const stress_waitcpu_method_t *method)
+{
+	double j_begin, j_end, t_begin, t_end;
+
+	j_begin = stress_power_rapl_joules();
+	if (j_begin < 0.0)
+		return -1.0;
+	t_begin = stress_time_now();
+	do {
+		int j;
+
+		for (j = 0; j < 1000; j++)
+			method->waitfunc();
+		t_end = stress_time_now();
+	} while (keep_stressing_flag() && (t_end - t_begin < WAITCPU_POWER_TIME));
+	j_end = stress_power_rapl_joules();
+
+	if ((j_end < j_begin) || (t_end <= t_begin))
+		return -1.0;
+	return (j_end - j_begin) / (t_end - t_begin);
+}
+
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_SCHED_GETAFFINITY) &&		\
+    defined(HAVE_SCHED_SETAFFINITY) &&		\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+#define HAVE_WAITCPU_WAKE
+
+/* wake up handshake between a pair of threads on different cpus */
+typedef struct {
+	uint64_t line ALIGN64;		/* handshake sequence, monitored by the waiter */
+	bool stop ALIGN64;		/* tell the waiter thread to stop */
+	int pinned;			/* 0 pinning, 1 pinned, -1 failed */
+	int32_t cpu;			/* waiter thread cpu */
+	size_t waiter;			/* index into stress_waitcpu_waiters */
+} stress_waitcpu_wake_t;
+
+typedef struct {
+	const char *name;
+	bool (*supported)(void);
+	bool (*wait)(stress_waitcpu_wake_t *wk, const uint64_t val);
+} stress_waitcpu_waiter_t;
+
+static bool stress_waitcpu_spin_supported(void)
+{
+	return true;
+}
+
+/*
+ *  stress_waitcpu_wait_spin()
+ *	spin with the architecture spin loop hint until the
+ *	handshake line is val, returns false if told to stop
+ */
+static bool stress_waitcpu_wait_spin(stress_waitcpu_wake_t *wk, const uint64_t val)
+{
+	while (__atomic_load_n(&wk->line, __ATOMIC_ACQUIRE) != val) {
+		if (__atomic_load_n(&wk->stop, __ATOMIC_RELAXED))
+			return false;
+#if defined(STRESS_ARCH_X86) &&	\
+    defined(HAVE_ASM_X86_PAUSE)
+		stress_asm_x86_pause();
+#elif defined(HAVE_ASM_ARM_YIELD)
+		stress_asm_arm_yield();
+#endif
+	}
+	return true;
+}
+
+#if defined(STRESS_ARCH_X86) &&	\
+    !defined(__PCC__) &&	\
+    defined(HAVE_ARCH_X86_64)
+/*
+ *  stress_waitcpu_wait_umwait()
+ *	monitor the handshake line and umwait in C0.2 (state 0)
+ *	or C0.1 (state 1) until it is val
+ */
+static inline bool stress_waitcpu_wait_umwait(
+	stress_waitcpu_wake_t *wk,
+	const uint64_t val,
+	const int state)
+{
+	for (;;) {
+		stress_asm_x86_umonitor(&wk->line);
+		if (__atomic_load_n(&wk->line, __ATOMIC_ACQUIRE) == val)
+			return true;
+		if (__atomic_load_n(&wk->stop, __ATOMIC_RELAXED))
+			return false;
+		(void)stress_asm_x86_umwait(state, stress_asm_x86_rdtsc() + WAITCPU_UMWAIT_TICKS);
+	}
+}
+
+static bool stress_waitcpu_wait_umwait0(stress_waitcpu_wake_t *wk, const uint64_t val)
+{
+	return stress_waitcpu_wait_umwait(wk, val, 0);
+}
+
+static bool stress_waitcpu_wait_umwait1(stress_waitcpu_wake_t *wk, const uint64_t val)
+{
+	return stress_waitcpu_wait_umwait(wk, val, 1);
+}
+#endif
+
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(__aarch64__)
+/*
+ *  stress_waitcpu_wait_wfe()
+ *	arm the exclusive monitor on the handshake line and wfe
+ *	until it is val, the store to the line wakes the wfe
+ */
+static bool stress_waitcpu_wait_wfe(stress_waitcpu_wake_t *wk, const uint64_t val)
+{
+	while (stress_asm_arm_ldaxr(&wk->line) != val) {
+		if (__atomic_load_n(&wk->stop, __ATOMIC_RELAXED))
+			return false;
+		stress_asm_arm_wfe();
+	}
+	return true;
+}
+#endif
+
+static const stress_waitcpu_waiter_t stress_waitcpu_waiters[] = {
+	{ "spin",	stress_waitcpu_spin_supported,		stress_waitcpu_wait_spin },
+#if defined(STRESS_ARCH_X86) &&	\
+    !defined(__PCC__) &&	\
+    defined(HAVE_ARCH_X86_64)
+	{ "umwait0",	stress_waitcpu_x86_umwait_supported,	stress_waitcpu_wait_umwait0 },
+	{ "umwait1",	stress_waitcpu_x86_umwait_supported,	stress_waitcpu_wait_umwait1 },
+#endif
+#if defined(STRESS_ARCH_ARM) &&	\
+    defined(__aarch64__)
+	{ "wfe",	stress_waitcpu_spin_supported,		stress_waitcpu_wait_wfe },
+#endif
+};
+
+/*
+ *  stress_waitcpu_pin()
+ *	pin the calling thread to a cpu
+ */
+static int stress_waitcpu_pin(const int32_t cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET((int)cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_waitcpu_waiter()
+ *	waiter thread, wait for each odd handshake value with the
+ *	waiter's method and reply with the next even value
+ */
+static void *stress_waitcpu_waiter(void *arg)
+{
+	static void *nowt = NULL;
+	stress_waitcpu_wake_t *wk = (stress_waitcpu_wake_t *)arg;
+	const stress_waitcpu_waiter_t *waiter = &stress_waitcpu_waiters[wk->waiter];
+	uint64_t val = 1;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	__atomic_store_n(&wk->pinned, stress_waitcpu_pin(wk->cpu) < 0 ? -1 : 1, __ATOMIC_RELEASE);
+
+	while (waiter->wait(wk, val)) {
+		__atomic_store_n(&wk->line, val + 1, __ATOMIC_RELEASE);
+		val += 2;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_waitcpu_wake_spin()
+ *	spin until the handshake line is val, returns false if
+ *	the spin has to be abandoned
+ */
+static inline bool stress_waitcpu_wake_spin(stress_waitcpu_wake_t *wk, const uint64_t val)
+{
+	uint32_t spins = 0;
+
+	while (__atomic_load_n(&wk->line, __ATOMIC_ACQUIRE) != val) {
+		if (UNLIKELY(++spins >= WAITCPU_WAKE_YIELD)) {
+			spins = 0;
+			if (!keep_stressing_flag())
+				return false;
+			(void)shim_sched_yield();
+		}
+	}
+	return true;
+}
+
+/*
+ *  stress_waitcpu_wake_rtt()
+ *	fastest round trip in nanoseconds of a store on cpu_a that
+ *	wakes a waiter on cpu_b and the waiter's reply that a spinning
+ *	cpu_a observes, 0.0 if it can't be measured
+ */
+static double stress_waitcpu_wake_rtt(
+	const size_t waiter,
+	const int32_t cpu_a,
+	const int32_t cpu_b)
+{
+	stress_waitcpu_wake_t *wk;
+	pthread_t pthread;
+	double best = 0.0;
+	uint64_t val = 1;
+	int i, ret;
+
+	if (stress_waitcpu_pin(cpu_a) < 0)
+		return 0.0;
+	wk = (stress_waitcpu_wake_t *)mmap(NULL, sizeof(*wk), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (wk == MAP_FAILED)
+		return 0.0;
+	wk->line = 0;
+	wk->stop = false;
+	wk->pinned = 0;
+	wk->cpu = cpu_b;
+	wk->waiter = waiter;
+
+	ret = pthread_create(&pthread, NULL, stress_waitcpu_waiter, (void *)wk);
+	if (ret) {
+		(void)munmap((void *)wk, sizeof(*wk));
+		return 0.0;
+	}
+	while (__atomic_load_n(&wk->pinned, __ATOMIC_ACQUIRE) == 0)
+		(void)shim_sched_yield();
+
+	if (wk->pinned > 0) {
+		for (i = 0; i < WAITCPU_WAKE_SAMPLES; i++) {
+			double t, ns;
+			int j;
+
+			t = stress_time_now();
+			for (j = 0; j < WAITCPU_WAKE_ROUNDS; j++, val += 2) {
+				__atomic_store_n(&wk->line, val, __ATOMIC_RELEASE);
+				if (!stress_waitcpu_wake_spin(wk, val + 1))
+					goto stop;
+			}
+			ns = (stress_time_now() - t) * STRESS_DBL_NANOSECOND / (double)WAITCPU_WAKE_ROUNDS;
+			if ((best <= 0.0) || (ns < best))
+				best = ns;
+		}
+	}
+stop:
+	__atomic_store_n(&wk->stop, true, __ATOMIC_RELAXED);
+	/* a store to the monitored line wakes waiters that are waiting */
+	__atomic_store_n(&wk->line, ~(uint64_t)0, __ATOMIC_RELEASE);
+	(void)pthread_join(pthread, NULL);
+	(void)munmap((void *)wk, sizeof(*wk));
+
+	return best;
+}
+
+/*
+ *  stress_waitcpu_wake()
+ *	measure the wake up latency of each waiter, the one way
+ *	latency is the round trip less half of the spin to spin
+ *	round trip for the reply
+ */
+static void stress_waitcpu_wake(const stress_args_t *args, size_t *idx)
+{
+	cpu_set_t allowed;
+	int32_t cpus[2];
+	uint32_t i, n = 0;
+	double rtt_spin = 0.0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return;
+	for (i = 0; (i < CPU_SETSIZE) && (n < SIZEOF_ARRAY(cpus)); i++) {
+		if (CPU_ISSET((int)i, &allowed))
+			cpus[n++] = (int32_t)i;
+	}
+	if (n < 2) {
+		pr_inf("%s: wake up latency needs at least 2 cpus, skipping wake up latency\n", args->name);
+		return;
+	}
+
+	for (i = 0; keep_stressing_flag() && (i < SIZEOF_ARRAY(stress_waitcpu_waiters)); i++) {
+		const stress_waitcpu_waiter_t *waiter = &stress_waitcpu_waiters[i];
+		double rtt, ns;
+		char msg[64];
+
+		if (!waiter->supported())
+			continue;
+		rtt = stress_waitcpu_wake_rtt(i, cpus[0], cpus[1]);
+		if (rtt <= 0.0)
+			continue;
+		if (i == 0)
+			rtt_spin = rtt;
+		ns = rtt - (rtt_spin / 2.0);
+		pr_inf("%s: %-8s waiter wake up round trip %8.1f ns, wake up latency %8.1f ns\n",
+			args->name, waiter->name, rtt, ns);
+		(void)snprintf(msg, sizeof(msg), "%s nanosecs wake up latency", waiter->name);
+		stress_metrics_set(args, (*idx)++, msg, ns);
+	}
+	(void)sched_setaffinity(0, sizeof(allowed), &allowed);
+}
+#endif
+
+/*
+ *  stress_waitcpu_characterise()
+ *	report the latency per op and package power of each method
+ *	and the wake up latency of spin and monitor based waits
+ */
+static void stress_waitcpu_characterise(const stress_args_t *args)
+{
+	size_t i, idx = SIZEOF_ARRAY(stress_waitcpu_method);
+
+	for (i = 0; keep_stressing_flag() && (i < SIZEOF_ARRAY(stress_waitcpu_method)); i++) {
+		const stress_waitcpu_method_t *method = &stress_waitcpu_method[i];
+		double ns, watts;
+		char msg[64];
+
+		if (!method->supported)
+			continue;
+		ns = stress_waitcpu_latency(method);
+		watts = stress_waitcpu_watts(method);
+		if (watts >= 0.0) {
+			pr_inf("%s: %-8s %8.2f ns per op, %7.2f package watts\n",
+				args->name, method->name, ns, watts);
+		} else {
+			pr_inf("%s: %-8s %8.2f ns per op\n", args->name, method->name, ns);
+		}
+		(void)snprintf(msg, sizeof(msg), "%s nanosecs per op", method->name);
+		stress_metrics_set(args, idx++, msg, ns);
+		if (watts >= 0.0) {
+			(void)snprintf(msg, sizeof(msg), "%s package watts", method->name);
+			stress_metrics_set(args, idx++, msg, watts);
+		}
+	}
+#if defined(HAVE_WAITCPU_WAKE)
+	stress_waitcpu_wake(args, &idx);
+#endif
+}
+
 /*
  *  stress_waitcpu()
  *     spin loop with cpu waiting
@@ -242,6 +616,7 @@ static int stress_waitcpu(const stress_args_t *args)
 	}
 	if (args->instance == 0) {
 		pr_inf("%s: exercising:%s\n", args->name, str);
+		stress_waitcpu_characterise(args);
 	}
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
@@ -0,0 +1,609 @@
+/*
+ * Copyright (C) 2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-cpu-cache.h"
+#include "core-latency.h"
+#include "core-pthread.h"
+
+#if defined(HAVE_SYS_EVENTFD_H)
+#include <sys/eventfd.h>
+#endif
+
+#define WAKELAT_ROUNDS		(256)	/* wake round trips per thread pair */
+
+#define WAKELAT_DISTANCE_CPU	(0)	/* both threads on same cpu */
+#define WAKELAT_DISTANCE_SMT	(1)	/* SMT siblings of one core */
+#define WAKELAT_DISTANCE_LLC	(2)	/* different cores sharing the LLC */
+#define WAKELAT_DISTANCE_SOCKET	(3)	/* different physical packages */
+#define WAKELAT_DISTANCE_MAX	(4)
+
+#define WAKELAT_METHOD_FUTEX	(0)
+#define WAKELAT_METHOD_EVENTFD	(1)
+#define WAKELAT_METHOD_PIPE	(2)
+#define WAKELAT_METHOD_YIELD	(3)
+
+#define WAKELAT_ALL		(~(size_t)0)
+
+typedef struct {
+	const char *name;	/* method name */
+	const int method;	/* WAKELAT_METHOD_* */
+} stress_wakelat_method_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"wakelat N",		"start N workers measuring cross cpu thread wakeup latency" },
+	{ NULL,	"wakelat-distance D",	"cpu topology distance: all, cpu, smt, llc or socket" },
+	{ NULL,	"wakelat-method M",	"wakeup method: all, futex, eventfd, pipe or yield" },
+	{ NULL,	"wakelat-ops N",	"stop after N wakeup round trip bogo operations" },
+	{ NULL,	"wakelat-policy P",	"scheduler policy of the threads, e.g. other, fifo or rr" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const wakelat_distances[WAKELAT_DISTANCE_MAX] = {
+	"cpu",
+	"smt",
+	"llc",
+	"socket",
+};
+
+static const stress_wakelat_method_t wakelat_methods[] = {
+#if defined(__linux__)
+	{ "futex",	WAKELAT_METHOD_FUTEX },
+#endif
+#if defined(HAVE_SYS_EVENTFD_H) &&	\
+    defined(HAVE_EVENTFD)
+	{ "eventfd",	WAKELAT_METHOD_EVENTFD },
+#endif
+	{ "pipe",	WAKELAT_METHOD_PIPE },
+	{ "yield",	WAKELAT_METHOD_YIELD },
+};
+
+/*
+ *  stress_wakelat_set_invalid()
+ *	report an invalid option and the valid choices
+ */
+static int stress_wakelat_set_invalid(
+	const char *setting,
+	const char *opt,
+	const char * const names[],
+	const size_t n)
+{
+	size_t i;
+
+	(void)fprintf(stderr, "invalid %s '%s', allowed are: all", setting, opt);
+	for (i = 0; i < n; i++)
+		(void)fprintf(stderr, " %s", names[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_wakelat_distance(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = WAKELAT_ALL;
+		return stress_set_setting("wakelat-distance", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < SIZEOF_ARRAY(wakelat_distances); i++) {
+		if (!strcmp(opt, wakelat_distances[i]))
+			return stress_set_setting("wakelat-distance", TYPE_ID_SIZE_T, &i);
+	}
+	return stress_wakelat_set_invalid("wakelat-distance", opt,
+		wakelat_distances, SIZEOF_ARRAY(wakelat_distances));
+}
+
+static int stress_set_wakelat_method(const char *opt)
+{
+	const char *names[SIZEOF_ARRAY(wakelat_methods)];
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = WAKELAT_ALL;
+		return stress_set_setting("wakelat-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < SIZEOF_ARRAY(wakelat_methods); i++) {
+		if (!strcmp(opt, wakelat_methods[i].name))
+			return stress_set_setting("wakelat-method", TYPE_ID_SIZE_T, &i);
+		names[i] = wakelat_methods[i].name;
+	}
+	return stress_wakelat_set_invalid("wakelat-method", opt,
+		names, SIZEOF_ARRAY(wakelat_methods));
+}
+
+static int stress_set_wakelat_policy(const char *opt)
+{
+	const int32_t policy = stress_get_opt_sched(opt);
+
+	return stress_set_setting("wakelat-policy", TYPE_ID_INT32, &policy);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_wakelat_distance,	stress_set_wakelat_distance },
+	{ OPT_wakelat_method,	stress_set_wakelat_method },
+	{ OPT_wakelat_policy,	stress_set_wakelat_policy },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_SCHED_GETAFFINITY) &&	\
+    defined(HAVE_SCHED_SETAFFINITY)
+
+/* one direction of a wakeup, waker to wakee */
+typedef struct {
+	volatile uint32_t seq;		/* wakeup sequence number, futex and yield */
+	uint32_t padding;
+	volatile uint64_t t_wake;	/* time the wakeup was issued */
+	int fds[2];			/* pipe, eventfd uses fds[0] only */
+} stress_wakelat_chan_t;
+
+/* a waker and wakee thread pair */
+typedef struct {
+	const stress_args_t *args;
+	int method;			/* WAKELAT_METHOD_* */
+	int32_t cpu;			/* cpu the wakee thread runs on */
+	int32_t policy;			/* scheduler policy of both threads */
+	volatile bool stop;		/* set to make the wakee thread exit */
+	stress_wakelat_chan_t chan[2];	/* ping (to wakee) and pong (to waker) */
+	stress_latency_t latency;	/* wakeup latencies seen by the wakee */
+} stress_wakelat_pair_t;
+
+/*
+ *  stress_wakelat_pin()
+ *	pin the calling thread to a cpu
+ */
+static int stress_wakelat_pin(const int32_t cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET((int)cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_wakelat_chan_open()
+ *	create the file descriptors a wakeup method needs
+ */
+static int stress_wakelat_chan_open(const int method, stress_wakelat_chan_t *chan)
+{
+	chan->seq = 0;
+	chan->t_wake = 0;
+	chan->fds[0] = -1;
+	chan->fds[1] = -1;
+
+	switch (method) {
+#if defined(HAVE_SYS_EVENTFD_H) &&	\
+    defined(HAVE_EVENTFD)
+	case WAKELAT_METHOD_EVENTFD:
+		chan->fds[0] = eventfd(0, 0);
+		return (chan->fds[0] < 0) ? -1 : 0;
+#endif
+	case WAKELAT_METHOD_PIPE:
+		return pipe(chan->fds);
+	default:
+		break;
+	}
+	return 0;
+}
+
+/*
+ *  stress_wakelat_chan_close()
+ *	close the file descriptors of a wakeup direction
+ */
+static void stress_wakelat_chan_close(stress_wakelat_chan_t *chan)
+{
+	if (chan->fds[0] >= 0)
+		(void)close(chan->fds[0]);
+	if (chan->fds[1] >= 0)
+		(void)close(chan->fds[1]);
+}
+
+/*
+ *  stress_wakelat_wake()
+ *	timestamp and issue wakeup seq to the thread waiting on chan
+ */
+static void stress_wakelat_wake(
+	const int method,
+	stress_wakelat_chan_t *chan,
+	const uint32_t seq)
+{
+	chan->t_wake = stress_latency_now();
+	shim_mb();
+
+	switch (method) {
+	case WAKELAT_METHOD_FUTEX:
+		chan->seq = seq;
+		(void)shim_futex_wake((const void *)&chan->seq, 1);
+		break;
+#if defined(HAVE_SYS_EVENTFD_H) &&	\
+    defined(HAVE_EVENTFD)
+	case WAKELAT_METHOD_EVENTFD: {
+			const uint64_t val = 1;
+
+			VOID_RET(ssize_t, write(chan->fds[0], &val, sizeof(val)));
+		}
+		break;
+#endif
+	case WAKELAT_METHOD_PIPE: {
+			const char ch = (char)seq;
+
+			VOID_RET(ssize_t, write(chan->fds[1], &ch, sizeof(ch)));
+		}
+		break;
+	default:
+		chan->seq = seq;
+		break;
+	}
+}
+
+/*
+ *  stress_wakelat_wait()
+ *	wait for the wakeup following prev on chan and return the
+ *	nanoseconds from the wakeup being issued to this thread
+ *	running again, returns 0 if the wait failed
+ */
+static uint64_t stress_wakelat_wait(
+	const int method,
+	stress_wakelat_chan_t *chan,
+	const uint32_t prev)
+{
+	switch (method) {
+	case WAKELAT_METHOD_FUTEX:
+		while (chan->seq == prev) {
+			if ((shim_futex_wait((const void *)&chan->seq, (int)prev, NULL) < 0) &&
+			    (errno != EAGAIN) && (errno != EINTR))
+				return 0;
+		}
+		break;
+#if defined(HAVE_SYS_EVENTFD_H) &&	\
+    defined(HAVE_EVENTFD)
+	case WAKELAT_METHOD_EVENTFD: {
+			uint64_t val;
+
+			while (read(chan->fds[0], &val, sizeof(val)) != (ssize_t)sizeof(val)) {
+				if (errno != EINTR)
+					return 0;
+			}
+		}
+		break;
+#endif
+	case WAKELAT_METHOD_PIPE: {
+			char ch;
+
+			while (read(chan->fds[0], &ch, sizeof(ch)) != (ssize_t)sizeof(ch)) {
+				if (errno != EINTR)
+					return 0;
+			}
+		}
+		break;
+	default:
+		while (chan->seq == prev)
+			(void)shim_sched_yield();
+		break;
+	}
+	shim_mb();
+	return stress_latency_now() - chan->t_wake;
+}
+
+/*
+ *  stress_wakelat_wakee()
+ *	wakee thread, wait for a ping, record how long it took
+ *	to get running and wake the waker with a pong
+ */
+static void *stress_wakelat_wakee(void *arg)
+{
+	static void *nowt = NULL;
+	stress_wakelat_pair_t *pair = (stress_wakelat_pair_t *)arg;
+	uint32_t seq = 0;
+
+	(void)stress_wakelat_pin(pair->cpu);
+	VOID_RET(int, stress_set_sched(0, (int)pair->policy, UNDEFINED, true));
+
+	for (;;) {
+		const uint64_t ns = stress_wakelat_wait(pair->method, &pair->chan[0], seq);
+
+		seq++;
+		if (pair->stop)
+			break;
+		if (ns)
+			stress_latency_add(&pair->latency, ns);
+		stress_wakelat_wake(pair->method, &pair->chan[1], seq);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_wakelat_cpu_pair()
+ *	find a pair of allowed online cpus that are the given
+ *	topology distance apart, the search starts at a cpu
+ *	chosen by the instance number so instances are spread out
+ */
+static bool stress_wakelat_cpu_pair(
+	const stress_cpu_cache_cpus_t *cpus,
+	const cpu_set_t *allowed,
+	const size_t distance,
+	const uint32_t instance,
+	int32_t *cpu_a,
+	int32_t *cpu_b)
+{
+	uint32_t i, j;
+
+	if (!cpus || !cpus->count)
+		return false;
+
+	for (i = 0; i < cpus->count; i++) {
+		const stress_cpu_cache_cpu_t *a = &cpus->cpus[(i + instance) % cpus->count];
+
+		if (!a->online || !CPU_ISSET((int)a->num, allowed))
+			continue;
+		for (j = 0; j < cpus->count; j++) {
+			const stress_cpu_cache_cpu_t *b = &cpus->cpus[j];
+			bool match;
+
+			if (!b->online || !CPU_ISSET((int)b->num, allowed))
+				continue;
+
+			switch (distance) {
+			case WAKELAT_DISTANCE_CPU:
+				match = (a == b);
+				break;
+			case WAKELAT_DISTANCE_SMT:
+				match = (a != b) && (a->core_id >= 0) &&
+					(a->package_id == b->package_id) &&
+					(a->core_id == b->core_id);
+				break;
+			case WAKELAT_DISTANCE_LLC:
+				match = (a->llc_id >= 0) &&
+					(a->llc_id == b->llc_id) &&
+					(a->package_id == b->package_id) &&
+					(a->core_id != b->core_id);
+				break;
+			case WAKELAT_DISTANCE_SOCKET:
+				match = (a->package_id >= 0) && (b->package_id >= 0) &&
+					(a->package_id != b->package_id);
+				break;
+			default:
+				match = false;
+				break;
+			}
+			if (match) {
+				*cpu_a = (int32_t)a->num;
+				*cpu_b = (int32_t)b->num;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ *  stress_wakelat_rounds()
+ *	run WAKELAT_ROUNDS ping-pong wakeups between the waker (this
+ *	thread, pinned on cpu_a) and a wakee thread on cpu_b, the
+ *	wakeup latencies of both directions are added to latency
+ */
+static int stress_wakelat_rounds(
+	const stress_args_t *args,
+	const stress_wakelat_method_t *wakelat_method,
+	const int32_t cpu_a,
+	const int32_t cpu_b,
+	const int32_t policy,
+	stress_latency_t *latency)
+{
+	const int method = wakelat_method->method;
+	stress_wakelat_pair_t *pair;
+	pthread_t pthread;
+	uint32_t seq;
+	int ret, rc = EXIT_SUCCESS;
+
+	pair = calloc(1, sizeof(*pair));
+	if (!pair) {
+		pr_inf_skip("%s: cannot allocate thread pair data, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	pair->args = args;
+	pair->method = method;
+	pair->cpu = cpu_b;
+	pair->policy = policy;
+	pair->stop = false;
+	stress_latency_reset(&pair->latency);
+
+	if ((stress_wakelat_chan_open(method, &pair->chan[0]) < 0) ||
+	    (stress_wakelat_chan_open(method, &pair->chan[1]) < 0)) {
+		pr_inf_skip("%s: cannot create %s wakeup channel, errno=%d (%s), "
+			"skipping stressor\n", args->name,
+			wakelat_method->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto close_chans;
+	}
+
+	if (stress_wakelat_pin(cpu_a) < 0) {
+		pr_fail("%s: cannot set affinity to cpu %" PRId32 ", errno=%d (%s)\n",
+			args->name, cpu_a, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto close_chans;
+	}
+
+	ret = pthread_create(&pthread, NULL, stress_wakelat_wakee, (void *)pair);
+	if (ret) {
+		pr_inf_skip("%s: pthread create failed, errno=%d (%s), skipping stressor\n",
+			args->name, ret, strerror(ret));
+		rc = EXIT_NO_RESOURCE;
+		goto close_chans;
+	}
+
+	for (seq = 0; seq < WAKELAT_ROUNDS; ) {
+		uint64_t ns;
+
+		if (!keep_stressing(args))
+			break;
+		seq++;
+		stress_wakelat_wake(method, &pair->chan[0], seq);
+		ns = stress_wakelat_wait(method, &pair->chan[1], seq - 1);
+		if (!ns) {
+			pr_fail("%s: %s wakeup wait failed, errno=%d (%s)\n",
+				args->name, wakelat_method->name,
+				errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+		stress_latency_add(latency, ns);
+		inc_counter(args);
+	}
+
+	pair->stop = true;
+	stress_wakelat_wake(method, &pair->chan[0], seq + 1);
+	(void)pthread_join(pthread, NULL);
+	stress_latency_merge(latency, &pair->latency);
+
+close_chans:
+	stress_wakelat_chan_close(&pair->chan[0]);
+	stress_wakelat_chan_close(&pair->chan[1]);
+	free(pair);
+
+	return rc;
+}
+
+/*
+ *  stress_wakelat()
+ *	stress cross cpu thread wakeup latency
+ */
+static int stress_wakelat(const stress_args_t *args)
+{
+	stress_cpu_cache_cpus_t *cpus;
+	cpu_set_t allowed;
+	size_t wakelat_distance = WAKELAT_ALL;
+	size_t wakelat_method = WAKELAT_ALL;
+	int32_t wakelat_policy = UNDEFINED;
+	int32_t cpu_a[WAKELAT_DISTANCE_MAX], cpu_b[WAKELAT_DISTANCE_MAX];
+	bool found[WAKELAT_DISTANCE_MAX];
+	stress_latency_t *latencies;
+	size_t d, m, idx;
+	const size_t n_methods = SIZEOF_ARRAY(wakelat_methods);
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("wakelat-distance", &wakelat_distance);
+	(void)stress_get_setting("wakelat-method", &wakelat_method);
+	(void)stress_get_setting("wakelat-policy", &wakelat_policy);
+
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_fail("%s: cannot get cpu affinity, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	cpus = stress_cpu_cache_get_all_details();
+	for (d = 0; d < WAKELAT_DISTANCE_MAX; d++) {
+		found[d] = ((wakelat_distance == WAKELAT_ALL) || (wakelat_distance == d)) &&
+			stress_wakelat_cpu_pair(cpus, &allowed, d, args->instance,
+				&cpu_a[d], &cpu_b[d]);
+		if (found[d]) {
+			pr_dbg("%s: %s distance using cpus %" PRId32 " and %" PRId32 "\n",
+				args->name, wakelat_distances[d], cpu_a[d], cpu_b[d]);
+		} else if (wakelat_distance == d) {
+			if (args->instance == 0)
+				pr_inf_skip("%s: no pair of cpus a %s distance apart, "
+					"skipping stressor\n", args->name,
+					wakelat_distances[d]);
+			stress_free_cpu_caches(cpus);
+			return EXIT_NO_RESOURCE;
+		}
+	}
+	stress_free_cpu_caches(cpus);
+
+	if (stress_set_sched(0, (int)wakelat_policy, UNDEFINED, true) < 0) {
+		if (args->instance == 0)
+			pr_inf("%s: cannot set scheduler policy '%s', using default policy\n",
+				args->name, stress_get_sched_name((int)wakelat_policy));
+		wakelat_policy = UNDEFINED;
+	}
+
+	latencies = calloc(WAKELAT_DISTANCE_MAX * n_methods, sizeof(*latencies));
+	if (!latencies) {
+		pr_inf_skip("%s: cannot allocate latency histograms, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (idx = 0; idx < WAKELAT_DISTANCE_MAX * n_methods; idx++)
+		stress_latency_reset(&latencies[idx]);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	while ((rc == EXIT_SUCCESS) && keep_stressing(args)) {
+		for (d = 0; (rc == EXIT_SUCCESS) && (d < WAKELAT_DISTANCE_MAX); d++) {
+			if (!found[d])
+				continue;
+			for (m = 0; (rc == EXIT_SUCCESS) && (m < n_methods); m++) {
+				if ((wakelat_method != WAKELAT_ALL) && (wakelat_method != m))
+					continue;
+				if (!keep_stressing(args))
+					break;
+				rc = stress_wakelat_rounds(args, &wakelat_methods[m],
+					cpu_a[d], cpu_b[d], wakelat_policy,
+					&latencies[(d * n_methods) + m]);
+			}
+		}
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	(void)sched_setaffinity(0, sizeof(allowed), &allowed);
+
+	for (idx = 0, d = 0; d < WAKELAT_DISTANCE_MAX; d++) {
+		for (m = 0; m < n_methods; m++) {
+			const stress_latency_t *latency = &latencies[(d * n_methods) + m];
+			char desc[64];
+
+			if (!latency->count)
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s %s wakeup p50 latency (ns)",
+				wakelat_distances[d], wakelat_methods[m].name);
+			stress_metrics_set(args, idx++, desc,
+				(double)stress_latency_percentile(latency, 50.0));
+			(void)snprintf(desc, sizeof(desc), "%s %s wakeup p99 latency (ns)",
+				wakelat_distances[d], wakelat_methods[m].name);
+			stress_metrics_set(args, idx++, desc,
+				(double)stress_latency_percentile(latency, 99.0));
+			(void)snprintf(desc, sizeof(desc), "%s %s wakeup max latency (ns)",
+				wakelat_distances[d], wakelat_methods[m].name);
+			stress_metrics_set(args, idx++, desc, (double)latency->max);
+			if (args->latency)
+				stress_latency_merge(args->latency, latency);
+		}
+	}
+	free(latencies);
+
+	return rc;
+}
+
+stressor_info_t stress_wakelat_info = {
+	.stressor = stress_wakelat,
+	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_wakelat_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without pthread support or sched_getaffinity() or sched_setaffinity()"
+};
+#endif
@@ -0,0 +1,723 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-latency.h"
+#include "core-uring.h"
+#include "io-uring.h"
+
+#define MIN_WAL_RECORD		(16)
+#define MAX_WAL_RECORD		(64 * KB)
+#define DEFAULT_WAL_RECORD	(128)
+
+#define MIN_WAL_THREADS		(1)
+#define MAX_WAL_THREADS		(64)
+#define DEFAULT_WAL_THREADS	(1)
+
+#define WAL_LOG_SIZE		(16 * MB)	/* log wraps back to the start at this size */
+#define WAL_DIRECT_ALIGN	(4 * KB)	/* O_DIRECT record alignment */
+#define WAL_PHASE_USEC		(250000)	/* duration of each method */
+
+#define WAL_METHOD_FDATASYNC	(0)
+#define WAL_METHOD_FSYNC	(1)
+#define WAL_METHOD_DSYNC	(2)
+#define WAL_METHOD_DIRECT	(3)
+#define WAL_METHOD_URING	(4)
+#define WAL_METHOD_MAX		(5)
+#define WAL_METHOD_ALL		(WAL_METHOD_MAX)
+
+static const stress_help_t help[] = {
+	{ NULL,	"wal N",		"start N workers measuring write ahead log commit latency" },
+	{ NULL,	"wal-method M",		"commit method [all|fdatasync|fsync|dsync|direct|uring]" },
+	{ NULL,	"wal-ops N",		"stop after N wal commits" },
+	{ NULL,	"wal-record N",		"append N byte records to the log per commit" },
+	{ NULL,	"wal-threads N",	"use N threads committing to the log" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const wal_methods[] = {
+	"fdatasync",
+	"fsync",
+	"dsync",
+	"direct",
+	"uring",
+	"all",
+};
+
+static int stress_set_wal_method(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(wal_methods); i++) {
+		if (!strcmp(opt, wal_methods[i]))
+			return stress_set_setting("wal-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "wal-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(wal_methods); i++)
+		(void)fprintf(stderr, " %s", wal_methods[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_wal_record(const char *opt)
+{
+	size_t wal_record;
+
+	wal_record = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("wal-record", (uint64_t)wal_record,
+		MIN_WAL_RECORD, MAX_WAL_RECORD);
+	return stress_set_setting("wal-record", TYPE_ID_SIZE_T, &wal_record);
+}
+
+static int stress_set_wal_threads(const char *opt)
+{
+	uint32_t wal_threads;
+
+	wal_threads = stress_get_uint32(opt);
+	stress_check_range("wal-threads", (uint64_t)wal_threads,
+		MIN_WAL_THREADS, MAX_WAL_THREADS);
+	return stress_set_setting("wal-threads", TYPE_ID_UINT32, &wal_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_wal_method,	stress_set_wal_method },
+	{ OPT_wal_record,	stress_set_wal_record },
+	{ OPT_wal_threads,	stress_set_wal_threads },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD)
+
+#if defined(STRESS_URING) &&		\
+    defined(HAVE_IORING_OP_WRITE) &&	\
+    defined(HAVE_IORING_OP_FSYNC) &&	\
+    defined(IOSQE_IO_LINK) &&		\
+    defined(IORING_FSYNC_DATASYNC)
+#define WAL_URING
+#endif
+
+/* state shared by the committing threads */
+typedef struct {
+	const stress_args_t *args;	/* stressor args */
+	size_t method;			/* commit method */
+	int fd;				/* log fd for the method */
+	size_t size;			/* bytes appended per commit */
+	pthread_mutex_t lock;		/* protects the log state below */
+	pthread_cond_t cond;		/* signalled when a sync completes */
+	off_t append;			/* log append offset, wraps at WAL_LOG_SIZE */
+	uint64_t written;		/* bytes appended to the log */
+	uint64_t synced;		/* bytes appended and made durable */
+	uint64_t syncs;			/* fsync or fdatasync calls */
+	bool syncing;			/* a thread is syncing for the group */
+	volatile bool start;		/* threads start committing */
+	volatile bool stop;		/* threads stop committing */
+} stress_wal_ctxt_t;
+
+/* per thread state and results */
+typedef struct {
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	stress_wal_ctxt_t *ctxt;	/* shared state */
+	uint8_t *buf;			/* page aligned record buffer */
+#if defined(WAL_URING)
+	stress_uring_t ring;		/* write and fsync ring */
+#endif
+	uint64_t commits;		/* commits made durable */
+	int err;			/* errno of a failed commit */
+	stress_latency_t latency;	/* commit latencies */
+} stress_wal_thread_t;
+
+/* accumulated results for a method */
+typedef struct {
+	double wall;			/* seconds of phases */
+	double commits;			/* commits of all threads */
+	double syncs;			/* fsync or fdatasync calls */
+	bool unsupported;		/* method can't be used */
+	stress_latency_t latency;	/* commit latencies of all threads */
+} stress_wal_stats_t;
+
+/*
+ *  stress_wal_reserve()
+ *	reserve space for a record at the log append offset
+ */
+static off_t stress_wal_reserve(stress_wal_ctxt_t *ctxt)
+{
+	off_t off = ctxt->append;
+
+	if (off + (off_t)ctxt->size > (off_t)WAL_LOG_SIZE)
+		off = 0;
+	ctxt->append = off + (off_t)ctxt->size;
+
+	return off;
+}
+
+/*
+ *  stress_wal_commit_group()
+ *	append a record then wait until it is durable, the first
+ *	thread to find no sync in progress syncs for every record
+ *	appended so far, the classic group commit
+ */
+static int stress_wal_commit_group(stress_wal_thread_t *thread)
+{
+	stress_wal_ctxt_t *ctxt = thread->ctxt;
+	uint64_t lsn;
+	ssize_t ret;
+	int err = 0;
+
+	(void)pthread_mutex_lock(&ctxt->lock);
+	ret = pwrite(ctxt->fd, thread->buf, ctxt->size, stress_wal_reserve(ctxt));
+	if (ret != (ssize_t)ctxt->size) {
+		err = (ret < 0) ? errno : EIO;
+		(void)pthread_mutex_unlock(&ctxt->lock);
+		return err;
+	}
+	ctxt->written += ctxt->size;
+	lsn = ctxt->written;
+
+	while (ctxt->synced < lsn) {
+		if (!ctxt->syncing) {
+			const uint64_t target = ctxt->written;
+
+			ctxt->syncing = true;
+			(void)pthread_mutex_unlock(&ctxt->lock);
+			ret = (ctxt->method == WAL_METHOD_FSYNC) ?
+				shim_fsync(ctxt->fd) : shim_fdatasync(ctxt->fd);
+			if (ret < 0)
+				err = errno;
+			(void)pthread_mutex_lock(&ctxt->lock);
+			ctxt->syncing = false;
+			ctxt->syncs++;
+			if (!err)
+				ctxt->synced = target;
+			(void)pthread_cond_broadcast(&ctxt->cond);
+			if (err)
+				break;
+		} else {
+			(void)pthread_cond_wait(&ctxt->cond, &ctxt->lock);
+		}
+	}
+	(void)pthread_mutex_unlock(&ctxt->lock);
+
+	return err;
+}
+
+/*
+ *  stress_wal_commit_write()
+ *	append a record with a write that is durable when it
+ *	returns, O_DSYNC or O_DIRECT | O_DSYNC
+ */
+static int stress_wal_commit_write(stress_wal_thread_t *thread)
+{
+	stress_wal_ctxt_t *ctxt = thread->ctxt;
+	ssize_t ret;
+	off_t off;
+
+	(void)pthread_mutex_lock(&ctxt->lock);
+	off = stress_wal_reserve(ctxt);
+	(void)pthread_mutex_unlock(&ctxt->lock);
+
+	ret = pwrite(ctxt->fd, thread->buf, ctxt->size, off);
+	if (ret != (ssize_t)ctxt->size)
+		return (ret < 0) ? errno : EIO;
+	return 0;
+}
+
+#if defined(WAL_URING)
+/*
+ *  stress_wal_commit_uring()
+ *	append a record with a write linked to a data sync,
+ *	both submitted with one io_uring_enter call
+ */
+static int stress_wal_commit_uring(stress_wal_thread_t *thread)
+{
+	stress_wal_ctxt_t *ctxt = thread->ctxt;
+	stress_uring_t *ring = &thread->ring;
+	struct io_uring_sqe *sqe;
+	unsigned tail = *ring->sq_tail;
+	unsigned idx, head, to_submit = 2, reaped = 0;
+	int err = 0;
+	off_t off;
+
+	(void)pthread_mutex_lock(&ctxt->lock);
+	off = stress_wal_reserve(ctxt);
+	(void)pthread_mutex_unlock(&ctxt->lock);
+
+	idx = tail & *ring->sq_mask;
+	sqe = &ring->sqes[idx];
+	(void)memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe->fd = ctxt->fd;
+	sqe->addr = (uintptr_t)thread->buf;
+	sqe->len = (uint32_t)ctxt->size;
+	sqe->off = (uint64_t)off;
+	sqe->user_data = (uint64_t)ctxt->size;
+	ring->sq_array[idx] = idx;
+	tail++;
+
+	idx = tail & *ring->sq_mask;
+	sqe = &ring->sqes[idx];
+	(void)memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = ctxt->fd;
+	sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	sqe->user_data = 0;
+	ring->sq_array[idx] = idx;
+	tail++;
+
+	shim_mb();
+	*ring->sq_tail = tail;
+	shim_mb();
+
+	while (reaped < 2) {
+		const int ret = stress_uring_enter(ring, to_submit, 2 - reaped);
+
+		if (ret < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+				continue;
+			return errno;
+		}
+		to_submit -= ((unsigned int)ret > to_submit) ? to_submit : (unsigned int)ret;
+
+		head = *ring->cq_head;
+		for (;;) {
+			const struct io_uring_cqe *cqe;
+
+			shim_mb();
+			if (head == *ring->cq_tail)
+				break;
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			/* a short write cancels the linked sync */
+			if (cqe->res < 0)
+				err = -cqe->res;
+			else if (cqe->user_data && ((uint64_t)cqe->res != cqe->user_data))
+				err = EIO;
+			reaped++;
+			head++;
+		}
+		*ring->cq_head = head;
+		shim_mb();
+	}
+	return err;
+}
+#endif
+
+/*
+ *  stress_wal_thread()
+ *	commit records until told to stop
+ */
+static void *stress_wal_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_wal_thread_t *thread = (stress_wal_thread_t *)arg;
+	const stress_wal_ctxt_t *ctxt = thread->ctxt;
+	uint64_t commits = 0;
+
+	while (!ctxt->start && !ctxt->stop)
+		shim_sched_yield();
+
+	while (!ctxt->stop) {
+		const uint64_t t = stress_latency_now();
+		int err;
+
+		switch (ctxt->method) {
+		case WAL_METHOD_DSYNC:
+		case WAL_METHOD_DIRECT:
+			err = stress_wal_commit_write(thread);
+			break;
+#if defined(WAL_URING)
+		case WAL_METHOD_URING:
+			err = stress_wal_commit_uring(thread);
+			break;
+#endif
+		default:
+			err = stress_wal_commit_group(thread);
+			break;
+		}
+		if (UNLIKELY(err != 0)) {
+			thread->err = err;
+			break;
+		}
+		stress_latency_add(&thread->latency, stress_latency_now() - t);
+		commits++;
+	}
+	thread->commits = commits;
+
+	return &nowt;
+}
+
+/*
+ *  stress_wal_phase()
+ *	run n threads committing for WAL_PHASE_USEC and add the
+ *	results to stats, returns the errno of a failed commit or 0
+ */
+static int stress_wal_phase(
+	stress_wal_ctxt_t *ctxt,
+	stress_wal_thread_t *threads,
+	const uint32_t n,
+	stress_wal_stats_t *stats)
+{
+	uint32_t i, started = 0;
+	int err = 0;
+	double t;
+
+	ctxt->start = false;
+	ctxt->stop = false;
+	ctxt->syncs = 0;
+	for (i = 0; i < n; i++) {
+		threads[i].ctxt = ctxt;
+		threads[i].commits = 0;
+		threads[i].err = 0;
+		stress_latency_reset(&threads[i].latency);
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_wal_thread, (void *)&threads[i]);
+		if (threads[i].ret == 0)
+			started++;
+	}
+	if (started == n) {
+		t = stress_time_now();
+		ctxt->start = true;
+		(void)shim_usleep(WAL_PHASE_USEC);
+		ctxt->stop = true;
+		t = stress_time_now() - t;
+	} else {
+		ctxt->stop = true;
+		t = 0.0;
+	}
+	for (i = 0; i < n; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	if (started != n)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if (threads[i].err)
+			err = threads[i].err;
+		stats->commits += (double)threads[i].commits;
+		stress_latency_merge(&stats->latency, &threads[i].latency);
+	}
+	stats->syncs += (double)ctxt->syncs;
+	stats->wall += t;
+
+	return err;
+}
+
+/*
+ *  stress_wal_report()
+ *	print the commit rates and latencies of the methods
+ */
+static void stress_wal_report(
+	const stress_args_t *args,
+	const stress_wal_stats_t *stats)
+{
+	size_t i;
+
+	pr_lock();
+	pr_inf("%s: %-9s %10s %10s %10s %10s %10s %10s %8s\n", args->name,
+		"method", "commits/s", "mean us", "p50 us", "p99 us",
+		"p99.9 us", "max us", "per sync");
+	for (i = 0; i < WAL_METHOD_MAX; i++) {
+		const stress_wal_stats_t *s = &stats[i];
+		const stress_latency_t *l = &s->latency;
+		char per_sync[16];
+
+		if ((s->wall <= 0.0) || (l->count == 0))
+			continue;
+		if (s->syncs > 0.0)
+			(void)snprintf(per_sync, sizeof(per_sync), "%8.2f", s->commits / s->syncs);
+		else
+			shim_strlcpy(per_sync, "n/a", sizeof(per_sync));
+		pr_inf("%s: %-9s %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f %8s\n", args->name,
+			wal_methods[i], s->commits / s->wall,
+			((double)l->total / (double)l->count) / 1000.0,
+			(double)stress_latency_percentile(l, 50.0) / 1000.0,
+			(double)stress_latency_percentile(l, 99.0) / 1000.0,
+			(double)stress_latency_percentile(l, 99.9) / 1000.0,
+			(double)l->max / 1000.0, per_sync);
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_wal_fill()
+ *	write the whole log so that commits overwrite allocated
+ *	blocks as a preallocated write ahead log does
+ */
+static int stress_wal_fill(const int fd, uint8_t *buf, const size_t buf_size)
+{
+	off_t off;
+
+	(void)memset(buf, 0, buf_size);
+	for (off = 0; off < (off_t)WAL_LOG_SIZE; off += (off_t)buf_size) {
+		const ssize_t ret = pwrite(fd, buf, buf_size, off);
+
+		if (ret != (ssize_t)buf_size)
+			return (ret < 0) ? errno : ENOSPC;
+		if (!keep_stressing_flag())
+			return EINTR;
+	}
+	return (shim_fsync(fd) < 0) ? errno : 0;
+}
+
+/*
+ *  stress_wal()
+ *	measure write ahead log style commit rates and latencies,
+ *	small record appends made durable per commit or per group
+ *	of commits across threads
+ */
+static int stress_wal(const stress_args_t *args)
+{
+	static stress_wal_stats_t stats[WAL_METHOD_MAX];
+	stress_wal_thread_t *threads;
+	stress_wal_ctxt_t context, *ctxt = &context;
+	int fds[WAL_METHOD_MAX];
+	uint32_t i, wal_threads = DEFAULT_WAL_THREADS;
+	size_t m, wal_method = WAL_METHOD_ALL, wal_record = DEFAULT_WAL_RECORD, idx = 0;
+	const size_t buf_size = MAX_WAL_RECORD;
+	char filename[PATH_MAX];
+	const char *fs_type;
+	int ret, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("wal-method", &wal_method);
+	if (!stress_get_setting("wal-record", &wal_record)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			wal_record = MAX_WAL_RECORD;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			wal_record = MIN_WAL_RECORD;
+	}
+	if (!stress_get_setting("wal-threads", &wal_threads)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			wal_threads = MAX_WAL_THREADS;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			wal_threads = MIN_WAL_THREADS;
+	}
+
+	threads = (stress_wal_thread_t *)calloc(wal_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " threads, skipping stressor\n",
+			args->name, wal_threads);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < wal_threads; i++) {
+		threads[i].buf = (uint8_t *)mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (threads[i].buf == MAP_FAILED) {
+			threads[i].buf = NULL;
+			pr_inf_skip("%s: cannot mmap %zu byte record buffer, skipping stressor\n",
+				args->name, buf_size);
+			rc = EXIT_NO_RESOURCE;
+			goto free_threads;
+		}
+		stress_uint8rnd4(threads[i].buf, buf_size);
+#if defined(WAL_URING)
+		threads[i].ring.fd = -1;
+#endif
+	}
+
+	(void)memset(ctxt, 0, sizeof(*ctxt));
+	ctxt->args = args;
+	if (pthread_mutex_init(&ctxt->lock, NULL) != 0) {
+		pr_inf_skip("%s: pthread_mutex_init failed, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_threads;
+	}
+	if (pthread_cond_init(&ctxt->cond, NULL) != 0) {
+		pr_inf_skip("%s: pthread_cond_init failed, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto destroy_mutex;
+	}
+
+	for (m = 0; m < WAL_METHOD_MAX; m++)
+		fds[m] = -1;
+	(void)memset(stats, 0, sizeof(stats));
+	for (m = 0; m < WAL_METHOD_MAX; m++)
+		stress_latency_reset(&stats[m].latency);
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto destroy_cond;
+	}
+	(void)stress_temp_filename_args(args, filename, sizeof(filename), stress_mwc32());
+	fds[WAL_METHOD_FDATASYNC] = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fds[WAL_METHOD_FDATASYNC] < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto rm_dir;
+	}
+	fs_type = stress_fs_type(filename);
+	fds[WAL_METHOD_FSYNC] = fds[WAL_METHOD_FDATASYNC];
+#if defined(O_DSYNC)
+	fds[WAL_METHOD_DSYNC] = open(filename, O_RDWR | O_DSYNC);
+#endif
+#if defined(O_DIRECT) &&	\
+    defined(O_DSYNC)
+	fds[WAL_METHOD_DIRECT] = open(filename, O_RDWR | O_DIRECT | O_DSYNC);
+#endif
+	fds[WAL_METHOD_URING] = fds[WAL_METHOD_FDATASYNC];
+	(void)shim_unlink(filename);
+
+	ret = stress_wal_fill(fds[WAL_METHOD_FDATASYNC], threads[0].buf, buf_size);
+	if (ret != 0) {
+		if (ret != EINTR) {
+			pr_inf_skip("%s: cannot write %zu MB log, errno=%d (%s)%s, skipping stressor\n",
+				args->name, (size_t)(WAL_LOG_SIZE / MB), ret, strerror(ret), fs_type);
+			rc = EXIT_NO_RESOURCE;
+		}
+		goto close_fds;
+	}
+	stress_uint8rnd4(threads[0].buf, buf_size);
+
+	/* some filesystems allow O_DIRECT opens but fail the writes */
+	if ((fds[WAL_METHOD_DIRECT] >= 0) &&
+	    (pwrite(fds[WAL_METHOD_DIRECT], threads[0].buf, WAL_DIRECT_ALIGN, 0) < 0)) {
+		pr_dbg("%s: O_DIRECT write failed, errno=%d (%s)%s, skipping direct method\n",
+			args->name, errno, strerror(errno), fs_type);
+		(void)close(fds[WAL_METHOD_DIRECT]);
+		fds[WAL_METHOD_DIRECT] = -1;
+	}
+	if (fds[WAL_METHOD_DSYNC] < 0)
+		stats[WAL_METHOD_DSYNC].unsupported = true;
+	if (fds[WAL_METHOD_DIRECT] < 0)
+		stats[WAL_METHOD_DIRECT].unsupported = true;
+#if defined(WAL_URING)
+	if ((wal_method == WAL_METHOD_ALL) || (wal_method == WAL_METHOD_URING)) {
+		for (i = 0; i < wal_threads; i++) {
+			if (stress_uring_setup(args, &threads[i].ring, 2) != EXIT_SUCCESS) {
+				stats[WAL_METHOD_URING].unsupported = true;
+				break;
+			}
+		}
+	}
+#else
+	stats[WAL_METHOD_URING].unsupported = true;
+#endif
+	if ((wal_method != WAL_METHOD_ALL) && stats[wal_method].unsupported) {
+		pr_inf_skip("%s: %s method not supported%s, skipping stressor\n",
+			args->name, wal_methods[wal_method], fs_type);
+		rc = EXIT_NOT_IMPLEMENTED;
+		goto close_fds;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; keep_stressing(args) && (m < WAL_METHOD_MAX); m++) {
+			stress_wal_stats_t *s = &stats[m];
+			const double commits = s->commits;
+
+			if ((wal_method != WAL_METHOD_ALL) && (wal_method != m))
+				continue;
+			if (s->unsupported)
+				continue;
+			ctxt->method = m;
+			ctxt->fd = fds[m];
+			/* O_DIRECT appends whole aligned blocks */
+			ctxt->size = (m == WAL_METHOD_DIRECT) ?
+				(wal_record + WAL_DIRECT_ALIGN - 1) & ~(size_t)(WAL_DIRECT_ALIGN - 1) :
+				wal_record;
+			ctxt->append = (ctxt->append + WAL_DIRECT_ALIGN - 1) & ~(off_t)(WAL_DIRECT_ALIGN - 1);
+			ret = stress_wal_phase(ctxt, threads, wal_threads, s);
+			add_counter(args, (uint64_t)(s->commits - commits));
+			if (ret != 0) {
+				pr_fail("%s: %s commit failed, errno=%d (%s)%s\n",
+					args->name, wal_methods[m], ret, strerror(ret), fs_type);
+				rc = EXIT_FAILURE;
+				break;
+			}
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_wal_report(args, stats);
+
+	for (m = 0; m < WAL_METHOD_MAX; m++) {
+		const stress_wal_stats_t *s = &stats[m];
+		const stress_latency_t *l = &s->latency;
+		char str[64];
+
+		if ((s->wall <= 0.0) || (l->count == 0))
+			continue;
+		(void)snprintf(str, sizeof(str), "%s commits per sec", wal_methods[m]);
+		stress_metrics_set(args, idx++, str, s->commits / s->wall);
+		(void)snprintf(str, sizeof(str), "%s mean commit latency (ns)", wal_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)l->total / (double)l->count);
+		(void)snprintf(str, sizeof(str), "%s p50 commit latency (ns)", wal_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 50.0));
+		(void)snprintf(str, sizeof(str), "%s p99 commit latency (ns)", wal_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 99.0));
+		(void)snprintf(str, sizeof(str), "%s p99.9 commit latency (ns)", wal_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)stress_latency_percentile(l, 99.9));
+		(void)snprintf(str, sizeof(str), "%s max commit latency (ns)", wal_methods[m]);
+		stress_metrics_set(args, idx++, str, (double)l->max);
+		if (s->syncs > 0.0) {
+			(void)snprintf(str, sizeof(str), "%s commits per sync", wal_methods[m]);
+			stress_metrics_set(args, idx++, str, s->commits / s->syncs);
+		}
+		if (args->latency)
+			stress_latency_merge(args->latency, l);
+	}
+
+close_fds:
+#if defined(WAL_URING)
+	for (i = 0; i < wal_threads; i++) {
+		if (threads[i].ring.fd >= 0)
+			stress_uring_close(&threads[i].ring);
+	}
+#endif
+	if (fds[WAL_METHOD_DIRECT] >= 0)
+		(void)close(fds[WAL_METHOD_DIRECT]);
+	if (fds[WAL_METHOD_DSYNC] >= 0)
+		(void)close(fds[WAL_METHOD_DSYNC]);
+	(void)close(fds[WAL_METHOD_FDATASYNC]);
+rm_dir:
+	(void)stress_temp_dir_rm_args(args);
+destroy_cond:
+	(void)pthread_cond_destroy(&ctxt->cond);
+destroy_mutex:
+	(void)pthread_mutex_destroy(&ctxt->lock);
+free_threads:
+	for (i = 0; i < wal_threads; i++) {
+		if (threads[i].buf)
+			(void)munmap((void *)threads[i].buf, buf_size);
+	}
+	free(threads);
+
+	return rc;
+}
+
+stressor_info_t stress_wal_info = {
+	.stressor = stress_wal,
+	.class = CLASS_FILESYSTEM | CLASS_IO | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_wal_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_FILESYSTEM | CLASS_IO | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.unimplemented_reason = "built without pthread support"
+};
+#endif
@@ -0,0 +1,792 @@
+/*
+ * Copyright (C) 2023      Colin Ian King.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "core-asm-x86.h"
+
+#define MIN_WORKSTEAL_THREADS	(1)
+#define MAX_WORKSTEAL_THREADS	(256)
+
+#define WORKSTEAL_PHASE_USEC	(100000)	/* duration of each measurement */
+#define WORKSTEAL_YIELD		(64)		/* failed steal sweeps before yielding */
+#define WORKSTEAL_DEQUE_SIZE	(4096)		/* tasks per deque, power of 2 */
+#define WORKSTEAL_SWEEP_THREADS	(10)		/* max thread counts swept, 1, 2, 4, .. */
+
+#define WORKSTEAL_FIB_N		(28)		/* parallel fib root */
+#define WORKSTEAL_FIB_CUTOFF	(10)		/* serial fib below this */
+#define WORKSTEAL_QSORT_N	(65536)		/* parallel quicksort elements */
+#define WORKSTEAL_QSORT_CUTOFF	(256)		/* serial sort below this */
+
+static const stress_help_t help[] = {
+	{ NULL,	"worksteal N",		"start N workers running fork-join tasks on work-stealing deques" },
+	{ NULL,	"worksteal-method M",	"select task tree, one of all, fib or qsort" },
+	{ NULL,	"worksteal-ops N",	"stop after N worksteal bogo operations" },
+	{ NULL,	"worksteal-sweep",	"sweep thread counts 1, 2, 4 .. worksteal-threads" },
+	{ NULL,	"worksteal-threads N",	"number of threads in the work-stealing pool" },
+	{ NULL,	NULL,			NULL }
+};
+
+static int stress_set_worksteal_threads(const char *opt)
+{
+	uint32_t worksteal_threads;
+
+	worksteal_threads = stress_get_uint32(opt);
+	stress_check_range("worksteal-threads", (uint64_t)worksteal_threads,
+		MIN_WORKSTEAL_THREADS, MAX_WORKSTEAL_THREADS);
+	return stress_set_setting("worksteal-threads", TYPE_ID_UINT32, &worksteal_threads);
+}
+
+static int stress_set_worksteal_sweep(const char *opt)
+{
+	return stress_set_setting_true("worksteal-sweep", opt);
+}
+
+static int stress_set_worksteal_method(const char *opt);
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_worksteal_method,		stress_set_worksteal_method },
+	{ OPT_worksteal_sweep,		stress_set_worksteal_sweep },
+	{ OPT_worksteal_threads,	stress_set_worksteal_threads },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&		\
+    defined(HAVE_ATOMIC) &&			\
+    defined(HAVE_ATOMIC_COMPARE_EXCHANGE) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&		\
+    defined(HAVE_ATOMIC_STORE)
+
+struct stress_worksteal_worker;
+
+/*
+ *  A task lives in the stack frame of the task that forked it,
+ *  the parent cannot return until done is set so it may be run
+ *  by any worker that steals it
+ */
+typedef struct stress_worksteal_task {
+	void (*func)(struct stress_worksteal_worker *worker, struct stress_worksteal_task *task);
+	uint32_t *data;		/* qsort elements */
+	size_t n;		/* fib n or qsort element count */
+	uint64_t result;	/* fib result */
+	int done;		/* set when the task has run */
+} stress_worksteal_task_t;
+
+/*
+ *  Chase-Lev work-stealing deque, the owner pushes and takes at
+ *  the bottom, thieves steal from the top. The buffer is fixed
+ *  size, a fork into a full deque runs the task inline
+ */
+typedef struct {
+	int64_t top ALIGN64;				/* thieves steal here */
+	int64_t bottom ALIGN64;				/* owner pushes and takes here */
+	stress_worksteal_task_t *buf[WORKSTEAL_DEQUE_SIZE] ALIGN64;
+} stress_worksteal_deque_t;
+
+typedef struct {
+	stress_worksteal_deque_t *deques;	/* one deque per worker */
+	uint32_t n;				/* workers in the pool */
+	bool start ALIGN64;			/* workers start looking for work */
+	bool stop;				/* workers exit */
+} stress_worksteal_shared_t;
+
+typedef struct stress_worksteal_worker {
+	stress_worksteal_shared_t *shared;	/* the pool */
+	stress_worksteal_deque_t *deque;	/* this worker's deque */
+	uint32_t id;				/* 0 based worker id */
+	uint32_t seed;				/* victim selection PRNG */
+	pthread_t pthread;			/* thread handle */
+	int ret;				/* pthread_create return */
+	uint64_t tasks;				/* tasks run */
+	uint64_t steals;			/* tasks stolen from other deques */
+	uint64_t steal_attempts;		/* steal attempts */
+	double idle;				/* time spent finding no work */
+	double idle_start;			/* start of current idle period */
+	uint32_t fails;				/* failed steal sweeps in a row */
+} ALIGN64 stress_worksteal_worker_t;
+
+typedef struct {
+	double tasks;		/* total tasks run */
+	double steals;		/* total tasks stolen */
+	double attempts;	/* total steal attempts */
+	double idle;		/* total worker idle time */
+	double busy;		/* total worker time, duration * workers */
+	double duration;	/* total measurement time */
+} stress_worksteal_stats_t;
+
+typedef struct stress_worksteal_method {
+	const char *name;
+	void (*prepare)(void);
+	void (*func)(stress_worksteal_worker_t *worker, stress_worksteal_task_t *task);
+	void (*setup)(stress_worksteal_task_t *task);
+	bool (*check)(const stress_worksteal_task_t *task);
+} stress_worksteal_method_t;
+
+static uint32_t *worksteal_data;	/* qsort elements */
+static uint64_t worksteal_fib;		/* expected fib result */
+
+/*
+ *  stress_worksteal_push()
+ *	owner pushes a task onto the bottom of its deque,
+ *	returns false if the deque is full
+ */
+static inline bool stress_worksteal_push(stress_worksteal_deque_t *deque, stress_worksteal_task_t *task)
+{
+	const int64_t b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+	const int64_t t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+	if (b - t >= WORKSTEAL_DEQUE_SIZE)
+		return false;
+	__atomic_store_n(&deque->buf[b & (WORKSTEAL_DEQUE_SIZE - 1)], task, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+/*
+ *  stress_worksteal_take()
+ *	owner takes the most recently pushed task from the bottom
+ *	of its deque, races with thieves for the last task
+ */
+static inline stress_worksteal_task_t *stress_worksteal_take(stress_worksteal_deque_t *deque)
+{
+	const int64_t b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+	stress_worksteal_task_t *task;
+	int64_t t;
+
+	__atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+	if (t > b) {
+		/* empty */
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	task = __atomic_load_n(&deque->buf[b & (WORKSTEAL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+	if (t == b) {
+		/* last task, race against thieves */
+		if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1,
+				false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			task = NULL;
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return task;
+}
+
+/*
+ *  stress_worksteal_steal()
+ *	thief steals the oldest task from the top of a deque,
+ *	returns NULL if the deque is empty or the steal lost a race
+ */
+static inline stress_worksteal_task_t *stress_worksteal_steal(stress_worksteal_deque_t *deque)
+{
+	int64_t t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	int64_t b;
+	stress_worksteal_task_t *task;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+	if (t >= b)
+		return NULL;
+	task = __atomic_load_n(&deque->buf[t & (WORKSTEAL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1,
+			false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return NULL;
+	return task;
+}
+
+static inline void stress_worksteal_run(stress_worksteal_worker_t *worker, stress_worksteal_task_t *task)
+{
+	task->func(worker, task);
+	worker->tasks++;
+	__atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *  stress_worksteal_fork()
+ *	make a task available for stealing, run it now if the
+ *	deque is full
+ */
+static inline void stress_worksteal_fork(stress_worksteal_worker_t *worker, stress_worksteal_task_t *task)
+{
+	task->done = 0;
+	if (!stress_worksteal_push(worker->deque, task))
+		stress_worksteal_run(worker, task);
+}
+
+/*
+ *  stress_worksteal_find()
+ *	take a task from our own deque or steal one from a randomly
+ *	chosen victim, idle time is accounted from the first failed
+ *	search until work is found again
+ */
+static stress_worksteal_task_t *stress_worksteal_find(stress_worksteal_worker_t *worker)
+{
+	stress_worksteal_shared_t *shared = worker->shared;
+	stress_worksteal_task_t *task;
+	const uint32_t n = shared->n;
+
+	task = stress_worksteal_take(worker->deque);
+	if (!task && (n > 1)) {
+		uint32_t i, victim;
+
+		/* xorshift32 */
+		worker->seed ^= worker->seed << 13;
+		worker->seed ^= worker->seed >> 17;
+		worker->seed ^= worker->seed << 5;
+		victim = worker->seed % n;
+
+		for (i = 0; i < n; i++, victim = (victim + 1 == n) ? 0 : victim + 1) {
+			if (victim == worker->id)
+				continue;
+			worker->steal_attempts++;
+			task = stress_worksteal_steal(&shared->deques[victim]);
+			if (task) {
+				worker->steals++;
+				break;
+			}
+		}
+	}
+
+	if (task) {
+		if (worker->idle_start > 0.0) {
+			worker->idle += stress_time_now() - worker->idle_start;
+			worker->idle_start = 0.0;
+		}
+		worker->fails = 0;
+		return task;
+	}
+
+	if (worker->idle_start <= 0.0)
+		worker->idle_start = stress_time_now();
+	if (++worker->fails >= WORKSTEAL_YIELD) {
+		worker->fails = 0;
+		(void)shim_sched_yield();
+	} else {
+#if defined(HAVE_ASM_X86_PAUSE)
+		stress_asm_x86_pause();
+#endif
+	}
+	return NULL;
+}
+
+/*
+ *  stress_worksteal_join()
+ *	wait for a forked task, run other tasks while waiting
+ */
+static void stress_worksteal_join(stress_worksteal_worker_t *worker, stress_worksteal_task_t *task)
+{
+	while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+		stress_worksteal_task_t *other = stress_worksteal_find(worker);
+
+		if (other)
+			stress_worksteal_run(worker, other);
+	}
+	if (worker->idle_start > 0.0) {
+		worker->idle += stress_time_now() - worker->idle_start;
+		worker->idle_start = 0.0;
+	}
+}
+
+static uint64_t stress_worksteal_fib_serial(const size_t n)
+{
+	return (n < 2) ? n : stress_worksteal_fib_serial(n - 1) + stress_worksteal_fib_serial(n - 2);
+}
+
+/*
+ *  fib: binary task tree, fork fib(n - 1) and compute fib(n - 2)
+ */
+static void stress_worksteal_fib_func(stress_worksteal_worker_t *worker, stress_worksteal_task_t *task)
+{
+	const size_t n = task->n;
+	stress_worksteal_task_t child, self;
+
+	if (n < WORKSTEAL_FIB_CUTOFF) {
+		task->result = stress_worksteal_fib_serial(n);
+		return;
+	}
+
+	child.func = stress_worksteal_fib_func;
+	child.n = n - 1;
+	stress_worksteal_fork(worker, &child);
+
+	self.n = n - 2;
+	stress_worksteal_fib_func(worker, &self);
+
+	stress_worksteal_join(worker, &child);
+	task->result = child.result + self.result;
+}
+
+static void stress_worksteal_fib_prepare(void)
+{
+	uint64_t a = 0, b = 1;
+	size_t i;
+
+	for (i = 0; i < WORKSTEAL_FIB_N; i++) {
+		const uint64_t c = a + b;
+
+		a = b;
+		b = c;
+	}
+	worksteal_fib = a;
+}
+
+static void stress_worksteal_fib_setup(stress_worksteal_task_t *task)
+{
+	task->n = WORKSTEAL_FIB_N;
+	task->result = 0;
+}
+
+static bool stress_worksteal_fib_check(const stress_worksteal_task_t *task)
+{
+	return task->result == worksteal_fib;
+}
+
+static void stress_worksteal_insertion_sort(uint32_t *data, const size_t n)
+{
+	size_t i;
+
+	for (i = 1; i < n; i++) {
+		const uint32_t v = data[i];
+		size_t j = i;
+
+		while ((j > 0) && (data[j - 1] > v)) {
+			data[j] = data[j - 1];
+			j--;
+		}
+		data[j] = v;
+	}
+}
+
+/*
+ *  qsort: unbalanced task tree, partition around the median of three,
+ *  fork the upper partition and sort the lower partition
+ */
+static void stress_worksteal_qsort_func(stress_worksteal_worker_t *worker, stress_worksteal_task_t *task)
+{
+	uint32_t *data = task->data;
+	size_t n = task->n;
+	stress_worksteal_task_t child;
+	size_t i, j;
+	uint32_t pivot, a, b, c;
+
+	if (n <= WORKSTEAL_QSORT_CUTOFF) {
+		stress_worksteal_insertion_sort(data, n);
+		return;
+	}
+
+	a = data[0];
+	b = data[n / 2];
+	c = data[n - 1];
+	pivot = (a < b) ? ((b < c) ? b : ((a < c) ? c : a)) :
+			  ((a < c) ? a : ((b < c) ? c : b));
+
+	/* Hoare partition */
+	i = 0;
+	j = n - 1;
+	for (;;) {
+		uint32_t tmp;
+
+		while (data[i] < pivot)
+			i++;
+		while (data[j] > pivot)
+			j--;
+		if (i >= j)
+			break;
+		tmp = data[i];
+		data[i] = data[j];
+		data[j] = tmp;
+		i++;
+		j--;
+	}
+
+	child.func = stress_worksteal_qsort_func;
+	child.data = data + j + 1;
+	child.n = n - (j + 1);
+	stress_worksteal_fork(worker, &child);
+
+	task->n = j + 1;
+	stress_worksteal_qsort_func(worker, task);
+	task->n = n;
+
+	stress_worksteal_join(worker, &child);
+}
+
+static void stress_worksteal_qsort_prepare(void)
+{
+	size_t i;
+
+	for (i = 0; i < WORKSTEAL_QSORT_N; i++)
+		worksteal_data[i] = stress_mwc32();
+}
+
+static void stress_worksteal_qsort_setup(stress_worksteal_task_t *task)
+{
+	size_t i;
+
+	/* scramble the sorted data so each sort does the same work */
+	for (i = 0; i < WORKSTEAL_QSORT_N; i++) {
+		const size_t j = (size_t)stress_mwc32modn(WORKSTEAL_QSORT_N);
+		const uint32_t tmp = worksteal_data[i];
+
+		worksteal_data[i] = worksteal_data[j];
+		worksteal_data[j] = tmp;
+	}
+	task->data = worksteal_data;
+	task->n = WORKSTEAL_QSORT_N;
+}
+
+static bool stress_worksteal_qsort_check(const stress_worksteal_task_t *task)
+{
+	size_t i;
+
+	for (i = 1; i < task->n; i++) {
+		if (task->data[i - 1] > task->data[i])
+			return false;
+	}
+	return true;
+}
+
+static const stress_worksteal_method_t worksteal_methods[] = {
+	{ "fib",	stress_worksteal_fib_prepare,	stress_worksteal_fib_func,
+			stress_worksteal_fib_setup,	stress_worksteal_fib_check },
+	{ "qsort",	stress_worksteal_qsort_prepare,	stress_worksteal_qsort_func,
+			stress_worksteal_qsort_setup,	stress_worksteal_qsort_check },
+};
+
+#define WORKSTEAL_METHODS	(SIZEOF_ARRAY(worksteal_methods))
+
+static int stress_set_worksteal_method(const char *opt)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		i = WORKSTEAL_METHODS;
+		return stress_set_setting("worksteal-method", TYPE_ID_SIZE_T, &i);
+	}
+	for (i = 0; i < WORKSTEAL_METHODS; i++) {
+		if (!strcmp(opt, worksteal_methods[i].name))
+			return stress_set_setting("worksteal-method", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "worksteal-method must be one of: all");
+	for (i = 0; i < WORKSTEAL_METHODS; i++)
+		(void)fprintf(stderr, " %s", worksteal_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_worksteal_func()
+ *	pool thread, run tasks found on any deque until told to stop
+ */
+static void *stress_worksteal_func(void *arg)
+{
+	static void *nowt = NULL;
+	stress_worksteal_worker_t *worker = (stress_worksteal_worker_t *)arg;
+	stress_worksteal_shared_t *shared = worker->shared;
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	while (!__atomic_load_n(&shared->start, __ATOMIC_ACQUIRE))
+		(void)shim_sched_yield();
+
+	while (!__atomic_load_n(&shared->stop, __ATOMIC_RELAXED)) {
+		stress_worksteal_task_t *task = stress_worksteal_find(worker);
+
+		if (task)
+			stress_worksteal_run(worker, task);
+	}
+	if (worker->idle_start > 0.0)
+		worker->idle += stress_time_now() - worker->idle_start;
+	return &nowt;
+}
+
+/*
+ *  stress_worksteal_phase()
+ *	run root tasks of a method on a pool of n workers for
+ *	WORKSTEAL_PHASE_USEC, the calling thread is worker 0 and
+ *	forks the root tasks, returns false if a result is wrong
+ */
+static bool stress_worksteal_phase(
+	const stress_args_t *args,
+	stress_worksteal_shared_t *shared,
+	stress_worksteal_worker_t *workers,
+	const uint32_t n,
+	const stress_worksteal_method_t *method,
+	stress_worksteal_stats_t *stats)
+{
+	uint32_t i, started = 1;
+	double t, t_end, duration;
+	bool ok = true;
+
+	shared->n = n;
+	shared->start = false;
+	shared->stop = false;
+	for (i = 0; i < n; i++) {
+		stress_worksteal_worker_t *worker = &workers[i];
+
+		shared->deques[i].top = 0;
+		shared->deques[i].bottom = 0;
+		worker->shared = shared;
+		worker->deque = &shared->deques[i];
+		worker->id = i;
+		worker->seed = stress_mwc32() | 1;
+		worker->tasks = 0;
+		worker->steals = 0;
+		worker->steal_attempts = 0;
+		worker->idle = 0.0;
+		worker->idle_start = 0.0;
+		worker->fails = 0;
+		worker->ret = -1;
+	}
+	for (i = 1; i < n; i++) {
+		stress_worksteal_worker_t *worker = &workers[i];
+
+		worker->ret = pthread_create(&worker->pthread, NULL,
+			stress_worksteal_func, (void *)worker);
+		if (!worker->ret)
+			started++;
+	}
+
+	t = stress_time_now();
+	t_end = t + ((double)WORKSTEAL_PHASE_USEC / STRESS_DBL_MICROSECOND);
+	__atomic_store_n(&shared->start, true, __ATOMIC_RELEASE);
+	do {
+		stress_worksteal_task_t root;
+
+		root.func = method->func;
+		method->setup(&root);
+		stress_worksteal_fork(&workers[0], &root);
+		stress_worksteal_join(&workers[0], &root);
+		if (!method->check(&root)) {
+			pr_fail("%s: %s task tree returned an incorrect result\n",
+				args->name, method->name);
+			ok = false;
+			break;
+		}
+	} while (stress_time_now() < t_end);
+	duration = stress_time_now() - t;
+
+	__atomic_store_n(&shared->stop, true, __ATOMIC_RELAXED);
+	for (i = 1; i < n; i++) {
+		if (!workers[i].ret)
+			(void)pthread_join(workers[i].pthread, NULL);
+	}
+
+	for (i = 0; i < n; i++) {
+		if ((i > 0) && workers[i].ret)
+			continue;
+		stats->tasks += (double)workers[i].tasks;
+		stats->steals += (double)workers[i].steals;
+		stats->attempts += (double)workers[i].steal_attempts;
+		stats->idle += workers[i].idle;
+	}
+	stats->busy += duration * (double)started;
+	stats->duration += duration;
+
+	return ok;
+}
+
+static inline double stress_worksteal_rate(const stress_worksteal_stats_t *stats)
+{
+	return (stats->duration > 0.0) ? stats->tasks / stats->duration : 0.0;
+}
+
+static inline double stress_worksteal_stolen(const stress_worksteal_stats_t *stats)
+{
+	return (stats->tasks > 0.0) ? 100.0 * stats->steals / stats->tasks : 0.0;
+}
+
+static inline double stress_worksteal_idle(const stress_worksteal_stats_t *stats)
+{
+	return (stats->busy > 0.0) ? 100.0 * stats->idle / stats->busy : 0.0;
+}
+
+/*
+ *  stress_worksteal_sweep_report()
+ *	print the task throughput, steal rate and idle time of
+ *	each method over the thread counts
+ */
+static void stress_worksteal_sweep_report(
+	const stress_args_t *args,
+	stress_worksteal_stats_t stats[WORKSTEAL_METHODS][WORKSTEAL_SWEEP_THREADS],
+	const uint32_t *thread_counts,
+	const size_t n_threads,
+	const size_t worksteal_method)
+{
+	size_t m, t;
+
+	pr_lock();
+	pr_inf("%s: %-6s %7s %12s %9s %12s %7s\n", args->name,
+		"tree", "threads", "M tasks/sec", "stolen %", "steal succ %", "idle %");
+	for (m = 0; m < WORKSTEAL_METHODS; m++) {
+		if ((worksteal_method < WORKSTEAL_METHODS) && (worksteal_method != m))
+			continue;
+		for (t = 0; t < n_threads; t++) {
+			const stress_worksteal_stats_t *s = &stats[m][t];
+
+			if (s->duration <= 0.0)
+				continue;
+			pr_inf("%s: %-6s %7" PRIu32 " %12.3f %9.3f %12.3f %7.2f\n", args->name,
+				worksteal_methods[m].name, thread_counts[t],
+				stress_worksteal_rate(s) / 1.0E6,
+				stress_worksteal_stolen(s),
+				(s->attempts > 0.0) ? 100.0 * s->steals / s->attempts : 0.0,
+				stress_worksteal_idle(s));
+		}
+	}
+	pr_unlock();
+}
+
+/*
+ *  stress_worksteal()
+ *	measure fork-join task throughput on a work-stealing pool
+ */
+static int stress_worksteal(const stress_args_t *args)
+{
+	static stress_worksteal_stats_t sweep[WORKSTEAL_METHODS][WORKSTEAL_SWEEP_THREADS];
+	stress_worksteal_stats_t stats[WORKSTEAL_METHODS];
+	uint32_t worksteal_threads = (uint32_t)STRESS_MAXIMUM(2, stress_get_processors_online());
+	uint32_t thread_counts[WORKSTEAL_SWEEP_THREADS];
+	size_t worksteal_method = WORKSTEAL_METHODS;
+	size_t n_threads = 0, m, t, i;
+	bool worksteal_sweep = false;
+	stress_worksteal_shared_t *shared;
+	stress_worksteal_worker_t *workers;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("worksteal-method", &worksteal_method);
+	(void)stress_get_setting("worksteal-sweep", &worksteal_sweep);
+	(void)stress_get_setting("worksteal-threads", &worksteal_threads);
+	if (worksteal_threads < MIN_WORKSTEAL_THREADS)
+		worksteal_threads = MIN_WORKSTEAL_THREADS;
+	if (worksteal_threads > MAX_WORKSTEAL_THREADS)
+		worksteal_threads = MAX_WORKSTEAL_THREADS;
+
+	/* thread counts 1, 2, 4 .. and worksteal-threads */
+	for (t = 1; (t < worksteal_threads) && (n_threads < WORKSTEAL_SWEEP_THREADS - 1); t <<= 1)
+		thread_counts[n_threads++] = (uint32_t)t;
+	thread_counts[n_threads++] = worksteal_threads;
+
+	shared = calloc(1, sizeof(*shared));
+	workers = calloc(worksteal_threads, sizeof(*workers));
+	worksteal_data = calloc(WORKSTEAL_QSORT_N, sizeof(*worksteal_data));
+	if (shared)
+		shared->deques = calloc(worksteal_threads, sizeof(*shared->deques));
+	if (!shared || !shared->deques || !workers || !worksteal_data) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " workers, skipping stressor\n",
+			args->name, worksteal_threads);
+		free(worksteal_data);
+		free(workers);
+		if (shared)
+			free(shared->deques);
+		free(shared);
+		return EXIT_NO_RESOURCE;
+	}
+	for (m = 0; m < WORKSTEAL_METHODS; m++)
+		worksteal_methods[m].prepare();
+	(void)memset(stats, 0, sizeof(stats));
+	(void)memset(sweep, 0, sizeof(sweep));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; (rc == EXIT_SUCCESS) && (m < WORKSTEAL_METHODS); m++) {
+			if ((worksteal_method < WORKSTEAL_METHODS) && (worksteal_method != m))
+				continue;
+			if (!worksteal_sweep) {
+				if (!stress_worksteal_phase(args, shared, workers, worksteal_threads,
+						&worksteal_methods[m], &stats[m]))
+					rc = EXIT_FAILURE;
+				inc_counter(args);
+				continue;
+			}
+			for (t = 0; t < n_threads; t++) {
+				if (!stress_worksteal_phase(args, shared, workers, thread_counts[t],
+						&worksteal_methods[m], &sweep[m][t])) {
+					rc = EXIT_FAILURE;
+					break;
+				}
+				inc_counter(args);
+				if (!keep_stressing(args))
+					break;
+			}
+			if (!keep_stressing(args))
+				break;
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (worksteal_sweep) {
+		if (args->instance == 0)
+			stress_worksteal_sweep_report(args, sweep, thread_counts, n_threads,
+				worksteal_method);
+	} else {
+		for (i = 0, m = 0; m < WORKSTEAL_METHODS; m++) {
+			char str[64];
+
+			if (stats[m].duration <= 0.0)
+				continue;
+			(void)snprintf(str, sizeof(str), "%s tasks per sec", worksteal_methods[m].name);
+			stress_metrics_set(args, i++, str, stress_worksteal_rate(&stats[m]));
+			(void)snprintf(str, sizeof(str), "%s tasks stolen %%", worksteal_methods[m].name);
+			stress_metrics_set(args, i++, str, stress_worksteal_stolen(&stats[m]));
+			(void)snprintf(str, sizeof(str), "%s steals per sec", worksteal_methods[m].name);
+			stress_metrics_set(args, i++, str, stats[m].steals / stats[m].duration);
+			(void)snprintf(str, sizeof(str), "%s worker idle time %%", worksteal_methods[m].name);
+			stress_metrics_set(args, i++, str, stress_worksteal_idle(&stats[m]));
+		}
+	}
+
+	free(worksteal_data);
+	free(workers);
+	free(shared->deques);
+	free(shared);
+
+	return rc;
+}
+
+stressor_info_t stress_worksteal_info = {
+	.stressor = stress_worksteal,
+	.class = CLASS_CPU | CLASS_SCHEDULER,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help
+};
+#else
+
+static int stress_set_worksteal_method(const char *opt)
+{
+	(void)opt;
+
+	(void)pr_inf("warning: --worksteal-method not available on this system\n");
+	return 0;
+}
+
+stressor_info_t stress_worksteal_info = {
+	.stressor = stress_unimplemented,
+	.class = CLASS_CPU | CLASS_SCHEDULER,
+	.opt_set_funcs = opt_set_funcs,
+	.verify = VERIFY_ALWAYS,
+	.help = help,
+	.unimplemented_reason = "built without pthread support or gcc __atomic builtins"
+};
+#endif
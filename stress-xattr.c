@@ -31,10 +31,111 @@
 #error cannot have both HAVE_SYS_XATTR_H and HAVE_ATTR_XATTR_H
 #endif
 
+#if defined(HAVE_LINUX_FS_H)
+#include <linux/fs.h>
+#endif
+
+#define MIN_XATTR_SCALE_COUNT		(1)
+#define MAX_XATTR_SCALE_COUNT		(4096)
+#define DEFAULT_XATTR_SCALE_COUNT	(64)
+
+#define MIN_XATTR_SCALE_SIZE		(16)
+#define MAX_XATTR_SCALE_SIZE		(64 * KB)
+#define DEFAULT_XATTR_SCALE_SIZE	(64 * KB)
+
+#define MIN_XATTR_SCALE_THREADS		(0)
+#define MAX_XATTR_SCALE_THREADS		(64)
+#define DEFAULT_XATTR_SCALE_READERS	(1)
+#define DEFAULT_XATTR_SCALE_WRITERS	(1)
+
 static const stress_help_t help[] = {
-	{ NULL,	"xattr N",	"start N workers stressing file extended attributes" },
-	{ NULL,	"xattr-ops N",	"stop after N bogo xattr operations" },
-	{ NULL,	NULL,		NULL }
+	{ NULL,	"xattr N",		"start N workers stressing file extended attributes" },
+	{ NULL,	"xattr-count N",	"sweep from 1 up to N attributes per file in scaling mode" },
+	{ NULL,	"xattr-namespace M",	"attribute namespace in scaling mode [all|user|security|trusted]" },
+	{ NULL,	"xattr-ops N",		"stop after N bogo xattr operations" },
+	{ NULL,	"xattr-readers N",	"N threads get attributes in scaling mode" },
+	{ NULL,	"xattr-scale",		"measure get and set throughput over value sizes and counts" },
+	{ NULL,	"xattr-size N",		"sweep from 16 up to N byte values in scaling mode" },
+	{ NULL,	"xattr-writers N",	"N threads set attributes in scaling mode" },
+	{ NULL,	NULL,			NULL }
+};
+
+static const char * const xattr_namespaces[] = {
+	"user",
+	"security",
+	"trusted",
+	"all",
+};
+
+static int stress_set_xattr_count(const char *opt)
+{
+	uint32_t xattr_count;
+
+	xattr_count = stress_get_uint32(opt);
+	stress_check_range("xattr-count", (uint64_t)xattr_count,
+		MIN_XATTR_SCALE_COUNT, MAX_XATTR_SCALE_COUNT);
+	return stress_set_setting("xattr-count", TYPE_ID_UINT32, &xattr_count);
+}
+
+static int stress_set_xattr_namespace(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(xattr_namespaces); i++) {
+		if (!strcmp(opt, xattr_namespaces[i]))
+			return stress_set_setting("xattr-namespace", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "xattr-namespace must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(xattr_namespaces); i++)
+		(void)fprintf(stderr, " %s", xattr_namespaces[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+static int stress_set_xattr_readers(const char *opt)
+{
+	uint32_t xattr_readers;
+
+	xattr_readers = stress_get_uint32(opt);
+	stress_check_range("xattr-readers", (uint64_t)xattr_readers,
+		MIN_XATTR_SCALE_THREADS, MAX_XATTR_SCALE_THREADS);
+	return stress_set_setting("xattr-readers", TYPE_ID_UINT32, &xattr_readers);
+}
+
+static int stress_set_xattr_scale(const char *opt)
+{
+	return stress_set_setting_true("xattr-scale", opt);
+}
+
+static int stress_set_xattr_size(const char *opt)
+{
+	uint64_t xattr_size;
+
+	xattr_size = stress_get_uint64_byte(opt);
+	stress_check_range_bytes("xattr-size", xattr_size,
+		MIN_XATTR_SCALE_SIZE, MAX_XATTR_SCALE_SIZE);
+	return stress_set_setting("xattr-size", TYPE_ID_UINT64, &xattr_size);
+}
+
+static int stress_set_xattr_writers(const char *opt)
+{
+	uint32_t xattr_writers;
+
+	xattr_writers = stress_get_uint32(opt);
+	stress_check_range("xattr-writers", (uint64_t)xattr_writers,
+		MIN_XATTR_SCALE_THREADS, MAX_XATTR_SCALE_THREADS);
+	return stress_set_setting("xattr-writers", TYPE_ID_UINT32, &xattr_writers);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_xattr_count,	stress_set_xattr_count },
+	{ OPT_xattr_namespace,	stress_set_xattr_namespace },
+	{ OPT_xattr_readers,	stress_set_xattr_readers },
+	{ OPT_xattr_scale,	stress_set_xattr_scale },
+	{ OPT_xattr_size,	stress_set_xattr_size },
+	{ OPT_xattr_writers,	stress_set_xattr_writers },
+	{ 0,			NULL }
 };
 
 #if (defined(HAVE_SYS_XATTR_H) ||	\
@@ -49,6 +150,456 @@ static const stress_help_t help[] = {
 
 #define MAX_XATTRS		(4096)
 
+#if defined(HAVE_LIB_PTHREAD)
+
+#define XATTR_SCALE_PHASE_USEC	(100000)	/* duration of each size and count */
+#define XATTR_SCALE_SIZES	(6)		/* 16, 256, 4K, 64K and the maximum */
+#define XATTR_SCALE_COUNTS	(7)		/* 1, 8, 64 .. 4096 and the maximum */
+#define XATTR_SCALE_NAMESPACES	(3)		/* user, security, trusted */
+#define XATTR_SCALE_NAME_LEN	(32)
+
+#define XATTR_SCALE_GETSET	(0)		/* get and set attribute values */
+#define XATTR_SCALE_FLAGS	(1)		/* get and set inode flags */
+
+/* state shared by the reader and writer threads */
+typedef struct {
+	int fd;				/* file of the attributes */
+	int method;			/* XATTR_SCALE_GETSET or XATTR_SCALE_FLAGS */
+	uint32_t count;			/* number of attributes */
+	size_t size;			/* attribute value size */
+	char (*names)[XATTR_SCALE_NAME_LEN];	/* attribute names */
+	volatile bool start;		/* threads start */
+	volatile bool stop;		/* threads stop */
+} stress_xattr_ctxt_t;
+
+/* per thread state and results */
+typedef struct {
+	pthread_t pthread;		/* thread */
+	int ret;			/* pthread_create return */
+	stress_xattr_ctxt_t *ctxt;	/* shared state */
+	uint32_t id;			/* thread number, first attribute used */
+	bool writer;			/* sets rather than gets */
+	uint8_t *buf;			/* value buffer */
+	uint64_t ops;			/* gets or sets */
+	int err;			/* errno of a failed get or set */
+} stress_xattr_thread_t;
+
+/* accumulated results for a value size and attribute count */
+typedef struct {
+	size_t size;			/* attribute value size */
+	uint32_t count;			/* number of attributes */
+	bool limit;			/* size or count exceeds the filesystem limit */
+	double wall;			/* seconds of phases */
+	double gets;			/* gets of all readers */
+	double sets;			/* sets of all writers */
+} stress_xattr_stats_t;
+
+/*
+ *  stress_xattr_scale_thread()
+ *	get or set attribute values or inode flags until told to stop,
+ *	each thread starts on a different attribute
+ */
+static void *stress_xattr_scale_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_xattr_thread_t *thread = (stress_xattr_thread_t *)arg;
+	const stress_xattr_ctxt_t *ctxt = thread->ctxt;
+	uint32_t i = thread->id % ctxt->count;
+	uint64_t ops = 0;
+
+	while (!ctxt->start && !ctxt->stop)
+		shim_sched_yield();
+
+	while (!ctxt->stop) {
+		int ret;
+
+		if (ctxt->method == XATTR_SCALE_FLAGS) {
+#if defined(FS_IOC_GETFLAGS) &&	\
+    defined(FS_IOC_SETFLAGS) &&	\
+    defined(FS_NODUMP_FL)
+			int flags = 0;
+
+			ret = ioctl(ctxt->fd, FS_IOC_GETFLAGS, &flags);
+			if ((ret == 0) && thread->writer) {
+				flags ^= FS_NODUMP_FL;
+				ret = ioctl(ctxt->fd, FS_IOC_SETFLAGS, &flags);
+			}
+#else
+			errno = ENOTSUP;
+			ret = -1;
+#endif
+		} else if (thread->writer) {
+			thread->buf[0]++;
+			ret = shim_fsetxattr(ctxt->fd, ctxt->names[i], thread->buf,
+				ctxt->size, XATTR_REPLACE);
+		} else {
+			ret = (shim_fgetxattr(ctxt->fd, ctxt->names[i], thread->buf,
+				ctxt->size) < 0) ? -1 : 0;
+		}
+		if (UNLIKELY(ret < 0)) {
+			if (errno == EINTR)
+				continue;
+			thread->err = errno;
+			break;
+		}
+		ops++;
+		i++;
+		if (i >= ctxt->count)
+			i = 0;
+	}
+	thread->ops = ops;
+
+	return &nowt;
+}
+
+/*
+ *  stress_xattr_scale_phase()
+ *	run the reader and writer threads for XATTR_SCALE_PHASE_USEC
+ *	and add the results to stats, returns the errno of a failed
+ *	get or set or 0
+ */
+static int stress_xattr_scale_phase(
+	stress_xattr_ctxt_t *ctxt,
+	stress_xattr_thread_t *threads,
+	const uint32_t n,
+	stress_xattr_stats_t *stats)
+{
+	uint32_t i, started = 0;
+	int err = 0;
+	double t;
+
+	ctxt->start = false;
+	ctxt->stop = false;
+	for (i = 0; i < n; i++) {
+		threads[i].ctxt = ctxt;
+		threads[i].ops = 0;
+		threads[i].err = 0;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_xattr_scale_thread, (void *)&threads[i]);
+		if (threads[i].ret == 0)
+			started++;
+	}
+	if (started == n) {
+		t = stress_time_now();
+		ctxt->start = true;
+		(void)shim_usleep(XATTR_SCALE_PHASE_USEC);
+		ctxt->stop = true;
+		t = stress_time_now() - t;
+	} else {
+		ctxt->stop = true;
+		t = 0.0;
+	}
+	for (i = 0; i < n; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	if (started != n)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if (threads[i].err)
+			err = threads[i].err;
+		if (threads[i].writer)
+			stats->sets += (double)threads[i].ops;
+		else
+			stats->gets += (double)threads[i].ops;
+	}
+	stats->wall += t;
+
+	return err;
+}
+
+/*
+ *  stress_xattr_scale_file()
+ *	create a file with count attributes of size bytes in the
+ *	namespace, returns the fd or -errno, -E2BIG if the filesystem
+ *	cannot hold that many attributes of that size
+ */
+static int stress_xattr_scale_file(
+	const char *filename,
+	stress_xattr_ctxt_t *ctxt,
+	const char *ns,
+	const uint8_t *value)
+{
+	uint32_t i;
+	int fd;
+
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return -errno;
+	for (i = 0; i < ctxt->count; i++) {
+		(void)snprintf(ctxt->names[i], sizeof(ctxt->names[i]),
+			"%s.stress_ng_%" PRIu32, ns, i);
+		if (shim_fsetxattr(fd, ctxt->names[i], value, ctxt->size, XATTR_CREATE) < 0) {
+			int err = errno;
+
+			(void)close(fd);
+			(void)shim_unlink(filename);
+			if ((err == ENOSPC) || (err == E2BIG) || (err == ERANGE) || (err == EDQUOT))
+				err = E2BIG;
+			return -err;
+		}
+	}
+	return fd;
+}
+
+/*
+ *  stress_xattr_scale_report()
+ *	print the get and set rates of a namespace over the value sizes
+ *	and attribute counts
+ */
+static void stress_xattr_scale_report(
+	const stress_args_t *args,
+	const char *ns,
+	const stress_xattr_stats_t *stats,
+	const size_t n_cells)
+{
+	size_t i;
+
+	pr_inf("%s: %s.* attributes\n", args->name, ns);
+	pr_inf("%s: %8s %6s %12s %12s %10s %10s\n", args->name,
+		"size", "count", "gets/sec", "sets/sec", "get MB/s", "set MB/s");
+	for (i = 0; i < n_cells; i++) {
+		const stress_xattr_stats_t *s = &stats[i];
+
+		if (s->limit) {
+			pr_inf("%s: %8zu %6" PRIu32 " %12s %12s %10s %10s\n", args->name,
+				s->size, s->count, "limit", "limit", "-", "-");
+			continue;
+		}
+		if (s->wall <= 0.0)
+			continue;
+		pr_inf("%s: %8zu %6" PRIu32 " %12.0f %12.0f %10.2f %10.2f\n", args->name,
+			s->size, s->count, s->gets / s->wall, s->sets / s->wall,
+			s->gets * (double)s->size / s->wall / (double)MB,
+			s->sets * (double)s->size / s->wall / (double)MB);
+	}
+}
+
+/*
+ *  stress_xattr_scale()
+ *	measure attribute get and set throughput of concurrent reader
+ *	and writer threads over value sizes and attributes per file in
+ *	one or all of the namespaces, and inode flag get and set
+ *	throughput for comparison
+ */
+static int stress_xattr_scale(const stress_args_t *args)
+{
+	static stress_xattr_stats_t stats[XATTR_SCALE_NAMESPACES][XATTR_SCALE_SIZES * XATTR_SCALE_COUNTS];
+	static stress_xattr_stats_t flag_stats;
+	stress_xattr_ctxt_t ctxt;
+	stress_xattr_thread_t *threads;
+	uint32_t xattr_count = DEFAULT_XATTR_SCALE_COUNT;
+	uint32_t xattr_readers = DEFAULT_XATTR_SCALE_READERS;
+	uint32_t xattr_writers = DEFAULT_XATTR_SCALE_WRITERS;
+	uint64_t xattr_size = DEFAULT_XATTR_SCALE_SIZE;
+	size_t xattr_namespace = 0, n_cells = 0, ns, j, idx = 0;
+	bool supported[XATTR_SCALE_NAMESPACES], flags = true;
+	char filename[PATH_MAX];
+	const char *fs_type;
+	uint8_t *value;
+	uint32_t i, n, n_threads;
+	size_t size;
+	int ret, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("xattr-count", &xattr_count);
+	(void)stress_get_setting("xattr-namespace", &xattr_namespace);
+	(void)stress_get_setting("xattr-readers", &xattr_readers);
+	(void)stress_get_setting("xattr-size", &xattr_size);
+	(void)stress_get_setting("xattr-writers", &xattr_writers);
+
+	n_threads = xattr_readers + xattr_writers;
+	if (n_threads == 0) {
+		pr_inf_skip("%s: no xattr readers or writers, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (size = MIN_XATTR_SCALE_SIZE; ; size *= 16) {
+		if (size > (size_t)xattr_size)
+			size = (size_t)xattr_size;
+		for (n = 1; ; n *= 8) {
+			if (n > xattr_count)
+				n = xattr_count;
+			stats[0][n_cells].size = size;
+			stats[0][n_cells].count = n;
+			n_cells++;
+			if (n == xattr_count)
+				break;
+		}
+		if (size == (size_t)xattr_size)
+			break;
+	}
+	for (ns = 0; ns < XATTR_SCALE_NAMESPACES; ns++) {
+		for (j = 0; j < n_cells; j++) {
+			stats[ns][j].size = stats[0][j].size;
+			stats[ns][j].count = stats[0][j].count;
+		}
+		supported[ns] = (xattr_namespace == ns) ||
+				(xattr_namespace == SIZEOF_ARRAY(xattr_namespaces) - 1);
+	}
+	(void)memset(&flag_stats, 0, sizeof(flag_stats));
+
+	(void)memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.names = calloc(xattr_count, sizeof(*ctxt.names));
+	if (!ctxt.names) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " attribute names, skipping stressor\n",
+			args->name, xattr_count);
+		return EXIT_NO_RESOURCE;
+	}
+	threads = calloc(n_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %" PRIu32 " threads, skipping stressor\n",
+			args->name, n_threads);
+		rc = EXIT_NO_RESOURCE;
+		goto free_names;
+	}
+	value = (uint8_t *)mmap(NULL, (size_t)xattr_size * (n_threads + 1),
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (value == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %" PRIu64 " byte value buffers, skipping stressor\n",
+			args->name, xattr_size * (n_threads + 1));
+		rc = EXIT_NO_RESOURCE;
+		goto free_threads;
+	}
+	stress_uint8rnd4(value, (size_t)xattr_size);
+	for (i = 0; i < n_threads; i++) {
+		threads[i].id = i;
+		threads[i].writer = (i < xattr_writers);
+		threads[i].buf = value + (size_t)xattr_size * (i + 1);
+		(void)memcpy(threads[i].buf, value, (size_t)xattr_size);
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = stress_exit_status(-ret);
+		goto unmap_value;
+	}
+	(void)stress_temp_filename_args(args, filename, sizeof(filename), stress_mwc32());
+	ret = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if (ret < 0) {
+		rc = stress_exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto rm_dir;
+	}
+	(void)close(ret);
+	fs_type = stress_fs_type(filename);
+	(void)shim_unlink(filename);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (ns = 0; (rc == EXIT_SUCCESS) && (ns < XATTR_SCALE_NAMESPACES); ns++) {
+			for (j = 0; supported[ns] && keep_stressing(args) && (j < n_cells); j++) {
+				stress_xattr_stats_t *s = &stats[ns][j];
+				const double ops = s->gets + s->sets;
+
+				if (s->limit)
+					continue;
+				ctxt.method = XATTR_SCALE_GETSET;
+				ctxt.count = s->count;
+				ctxt.size = s->size;
+				ctxt.fd = stress_xattr_scale_file(filename, &ctxt, xattr_namespaces[ns], value);
+				if (ctxt.fd == -E2BIG) {
+					s->limit = true;
+					continue;
+				}
+				if (ctxt.fd < 0) {
+					if (args->instance == 0)
+						pr_inf("%s: %s.* attributes cannot be set, errno=%d (%s)%s, "
+							"skipping them\n", args->name, xattr_namespaces[ns],
+							-ctxt.fd, strerror(-ctxt.fd), fs_type);
+					supported[ns] = false;
+					break;
+				}
+				ret = stress_xattr_scale_phase(&ctxt, threads, n_threads, s);
+				(void)close(ctxt.fd);
+				(void)shim_unlink(filename);
+				add_counter(args, (uint64_t)(s->gets + s->sets - ops));
+				if (ret != 0) {
+					pr_fail("%s: %s.* attribute get or set of %zu bytes failed, "
+						"errno=%d (%s)%s\n", args->name, xattr_namespaces[ns],
+						s->size, ret, strerror(ret), fs_type);
+					rc = EXIT_FAILURE;
+					break;
+				}
+			}
+		}
+		if ((rc == EXIT_SUCCESS) && flags && keep_stressing(args)) {
+			ctxt.method = XATTR_SCALE_FLAGS;
+			ctxt.count = 1;
+			ctxt.fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+			if (ctxt.fd < 0) {
+				flags = false;
+			} else {
+				ret = stress_xattr_scale_phase(&ctxt, threads, n_threads, &flag_stats);
+				(void)close(ctxt.fd);
+				(void)shim_unlink(filename);
+				/* inode flags are optional, some filesystems do not have them */
+				if (ret != 0) {
+					flags = false;
+					flag_stats.wall = 0.0;
+				}
+			}
+		}
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		pr_inf("%s: %" PRIu32 " readers, %" PRIu32 " writers%s\n",
+			args->name, xattr_readers, xattr_writers, fs_type);
+		for (ns = 0; ns < XATTR_SCALE_NAMESPACES; ns++) {
+			if (supported[ns])
+				stress_xattr_scale_report(args, xattr_namespaces[ns], stats[ns], n_cells);
+		}
+		if (flag_stats.wall > 0.0)
+			pr_inf("%s: inode flags %.0f gets/sec, %.0f sets/sec\n", args->name,
+				flag_stats.gets / flag_stats.wall, flag_stats.sets / flag_stats.wall);
+		pr_unlock();
+	}
+
+	for (ns = 0; ns < XATTR_SCALE_NAMESPACES; ns++) {
+		if (!supported[ns])
+			continue;
+		for (j = 0; j < n_cells; j++) {
+			const stress_xattr_stats_t *s = &stats[ns][j];
+			const stress_xattr_stats_t *next = (j + 1 < n_cells) ? &stats[ns][j + 1] : NULL;
+			char str[64];
+
+			/* each size at the largest attribute count that fits */
+			if (s->limit || (s->wall <= 0.0))
+				continue;
+			if (next && (next->size == s->size) && !next->limit)
+				continue;
+			(void)snprintf(str, sizeof(str), "%s.* %zu byte x %" PRIu32 " gets per sec",
+				xattr_namespaces[ns], s->size, s->count);
+			stress_metrics_set(args, idx++, str, s->gets / s->wall);
+			(void)snprintf(str, sizeof(str), "%s.* %zu byte x %" PRIu32 " sets per sec",
+				xattr_namespaces[ns], s->size, s->count);
+			stress_metrics_set(args, idx++, str, s->sets / s->wall);
+		}
+	}
+	if (flag_stats.wall > 0.0) {
+		stress_metrics_set(args, idx++, "inode flag gets per sec", flag_stats.gets / flag_stats.wall);
+		stress_metrics_set(args, idx++, "inode flag sets per sec", flag_stats.sets / flag_stats.wall);
+	}
+
+rm_dir:
+	(void)stress_temp_dir_rm_args(args);
+unmap_value:
+	(void)munmap((void *)value, (size_t)xattr_size * (n_threads + 1));
+free_threads:
+	free(threads);
+free_names:
+	free(ctxt.names);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_xattr
  *	stress the xattr operations
@@ -67,6 +618,18 @@ static int stress_xattr(const stress_args_t *args)
 #else
 	const size_t hugevalue_sz = 256 * KB;
 #endif
+	bool xattr_scale = false;
+
+	(void)stress_get_setting("xattr-scale", &xattr_scale);
+	if (xattr_scale) {
+#if defined(HAVE_LIB_PTHREAD)
+		return stress_xattr_scale(args);
+#else
+		pr_inf_skip("%s: xattr scaling needs pthread support, skipping stressor\n",
+			args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
 
 #if defined(XATTR_SIZE_MAX)
 	large_tmp = calloc(XATTR_SIZE_MAX + 2, sizeof(*large_tmp));
@@ -518,12 +1081,14 @@ stressor_info_t stress_xattr_info = {
 	.stressor = stress_xattr,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
 	.verify = VERIFY_ALWAYS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_xattr_info = {
 	.stressor = stress_unimplemented,
 	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help,
 	.unimplemented_reason = "built without sys/xattr.h or attr/xattr.h and xattr family of system calls"
 };
@@ -25,12 +25,14 @@
 
 static const stress_help_t help[] = {
 	{ NULL,	"zlib N",		"start N workers compressing data with zlib" },
+	{ NULL,	"zlib-codec C",		"benchmark codecs C on each data generator, C is all, zlib, zlib-ng, lz4 or zstd" },
 	{ NULL,	"zlib-level L",		"specify zlib compression level 0=fast, 9=best" },
 	{ NULL,	"zlib-mem-level L",	"specify zlib compression state memory usage 1=minimum, 9=maximum" },
 	{ NULL,	"zlib-method M",	"specify zlib random data generation method M" },
 	{ NULL,	"zlib-ops N",		"stop after N zlib bogo compression operations" },
 	{ NULL,	"zlib-strategy S",	"specify zlib strategy 0=default, 1=filtered, 2=huffman only, 3=rle, 4=fixed" },
 	{ NULL,	"zlib-stream-bytes S",	"specify the number of bytes to deflate until the current stream will be closed" },
+	{ NULL,	"zlib-threads N",	"compress 128K blocks with a pipeline of N compressor threads" },
 	{ NULL,	"zlib-window-bits W",	"specify zlib window bits -8-(-15) | 8-15 | 24-31 | 40-47" },
 	{ NULL,	NULL,			NULL }
 };
@@ -39,6 +41,26 @@ static const stress_help_t help[] = {
 
 #include "zlib.h"
 
+#if defined(HAVE_LIB_LZ4) &&	\
+    defined(HAVE_LZ4_H)
+#include <lz4.h>
+#include <lz4hc.h>
+#define STRESS_ZLIB_HAVE_LZ4
+#endif
+
+#if defined(HAVE_LIB_ZSTD) &&	\
+    defined(HAVE_ZSTD_H)
+#include <zstd.h>
+#include <zdict.h>
+#define STRESS_ZLIB_HAVE_ZSTD
+#endif
+
+#if defined(HAVE_LIB_Z_NG) &&	\
+    defined(HAVE_ZLIB_NG_H)
+#include <zlib-ng.h>
+#define STRESS_ZLIB_HAVE_ZLIB_NG
+#endif
+
 #define DATA_SIZE_64K 	(KB * 64)	/* Must be a multiple of 64 bytes */
 #define DATA_SIZE DATA_SIZE_64K
 
@@ -77,6 +99,20 @@ typedef struct morse {
 	char *str;
 } morse_t;
 
+static const char * const zlib_codec_names[] = {
+	"all",
+	"zlib",
+#if defined(STRESS_ZLIB_HAVE_ZLIB_NG)
+	"zlib-ng",
+#endif
+#if defined(STRESS_ZLIB_HAVE_LZ4)
+	"lz4",
+#endif
+#if defined(STRESS_ZLIB_HAVE_ZSTD)
+	"zstd",
+#endif
+};
+
 static const morse_t ALIGN64 morse[] = {
 	{ 'a', ".-" },
 	{ 'b', "-.." },
@@ -250,17 +286,9 @@ static void stress_rand_data_binary(
 	uint64_t *RESTRICT data,
 	uint64_t *RESTRICT data_end)
 {
-	register uint32_t *ptr = (uint32_t *)data;
-	register const uint32_t *end = (uint32_t *)data_end;
-
 	(void)args;
 
-	while (ptr < end) {
-		*(ptr++) = stress_mwc32();
-		*(ptr++) = stress_mwc32();
-		*(ptr++) = stress_mwc32();
-		*(ptr++) = stress_mwc32();
-	}
+	stress_mwc_fill(data, (size_t)((uintptr_t)data_end - (uintptr_t)data));
 }
 
 /*
@@ -1218,6 +1246,27 @@ static void stress_zlib_random_test(
 	zlib_rand_data_methods[idx].func(args, data, data_end);
 }
 
+/*
+ *  stress_set_zlib_codec()
+ *	select the codecs to benchmark, this enables the in memory
+ *	codec benchmark instead of the deflate to inflate pipe
+ */
+static int stress_set_zlib_codec(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(zlib_codec_names); i++) {
+		if (!strcmp(opt, zlib_codec_names[i]))
+			return stress_set_setting("zlib-codec", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "zlib-codec must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(zlib_codec_names); i++)
+		(void)fprintf(stderr, " %s", zlib_codec_names[i]);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
 /*
  *  stress_set_zlib_level
  *	set zlib compression level, 0..9,
@@ -1270,6 +1319,20 @@ static int stress_set_zlib_method(const char *opt)
 	return -1;
 }
 
+/*
+ *  stress_set_zlib_threads
+ *	set the number of compressor threads, this enables the
+ *	pipelined block compression mode
+ */
+static int stress_set_zlib_threads(const char *opt)
+{
+	uint32_t zlib_threads;
+
+	zlib_threads = stress_get_uint32(opt);
+	stress_check_range("zlib-threads", (uint64_t)zlib_threads, 1, 1024);
+	return stress_set_setting("zlib-threads", TYPE_ID_UINT32, &zlib_threads);
+}
+
 /*
  *  stress_set_zlib_window_bits
  *	specify the window bits used to allocate the history buffer size. The value is
@@ -1328,12 +1391,14 @@ static int stress_set_zlib_strategy(const char *opt)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_zlib_codec,		stress_set_zlib_codec },
 	{ OPT_zlib_level,		stress_set_zlib_level },
 	{ OPT_zlib_mem_level,		stress_set_zlib_mem_level },
 	{ OPT_zlib_method,		stress_set_zlib_method },
 	{ OPT_zlib_window_bits,		stress_set_zlib_window_bits },
 	{ OPT_zlib_stream_bytes,	stress_set_zlib_stream_bytes },
 	{ OPT_zlib_strategy,		stress_set_zlib_strategy },
+	{ OPT_zlib_threads,		stress_set_zlib_threads },
 	{ 0,				NULL }
 };
 
@@ -1683,6 +1748,768 @@ zlib_checksum_error:
 	return ret;
 }
 
+/*
+ *  Codec benchmark, enabled by --zlib-codec, the output of each data
+ *  generator is compressed and decompressed in memory with each codec
+ *  and level and the compress and decompress rates and the compression
+ *  ratios are reported per generator rather than streaming deflate
+ *  output down a pipe to inflate
+ */
+#define CODEC_DATA_SIZE		(DATA_SIZE * 4)		/* bytes generated per generator */
+#define CODEC_DST_SIZE		((CODEC_DATA_SIZE * 2) + (4 * KB))
+#define CODEC_RECORD_SIZE	(4 * KB)		/* record size of record variants */
+#define CODEC_RECORDS		(CODEC_DATA_SIZE / CODEC_RECORD_SIZE)
+#define CODEC_DICT_SIZE		(16 * KB)		/* trained dictionary size */
+
+typedef struct {
+	const stress_args_t *args;
+#if defined(STRESS_ZLIB_HAVE_ZSTD)
+	ZSTD_CCtx *cctx;	/* zstd compression context */
+	ZSTD_DCtx *dctx;	/* zstd decompression context */
+	ZSTD_CDict *cdict;	/* dictionary trained on the current generator */
+	ZSTD_DDict *ddict;	/* and its decompression form */
+#endif
+} stress_zlib_codec_ctxt_t;
+
+typedef size_t (*stress_zlib_codec_func_t)(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len);
+
+typedef struct {
+	const char *codec;			/* codec selected by --zlib-codec */
+	const char *name;			/* codec and level */
+	const int level;			/* compression level */
+	const size_t record;			/* record size, 0 to compress as one buffer */
+	const bool dict;			/* true if a trained dictionary is used */
+	stress_zlib_codec_func_t compress;	/* returns compressed size, 0 on error */
+	stress_zlib_codec_func_t decompress;	/* returns decompressed size, 0 on error */
+} stress_zlib_codec_t;
+
+typedef struct {
+	double bytes_in;	/* uncompressed bytes */
+	double bytes_out;	/* compressed bytes */
+	double compress;	/* compress time */
+	double decompress;	/* decompress time */
+} stress_zlib_codec_stats_t;
+
+static size_t stress_zlib_codec_zlib_compress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	uLongf len = (uLongf)dst_len;
+
+	(void)ctxt;
+	return (compress2(dst, &len, src, (uLong)src_len, level) == Z_OK) ? (size_t)len : 0;
+}
+
+static size_t stress_zlib_codec_zlib_decompress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	uLongf len = (uLongf)dst_len;
+
+	(void)ctxt;
+	(void)level;
+	return (uncompress(dst, &len, src, (uLong)src_len) == Z_OK) ? (size_t)len : 0;
+}
+
+#if defined(STRESS_ZLIB_HAVE_ZLIB_NG)
+static size_t stress_zlib_codec_zlib_ng_compress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	size_t len = dst_len;
+
+	(void)ctxt;
+	return (zng_compress2(dst, &len, src, src_len, level) == Z_OK) ? len : 0;
+}
+
+static size_t stress_zlib_codec_zlib_ng_decompress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	size_t len = dst_len;
+
+	(void)ctxt;
+	(void)level;
+	return (zng_uncompress(dst, &len, src, src_len) == Z_OK) ? len : 0;
+}
+#endif
+
+#if defined(STRESS_ZLIB_HAVE_LZ4)
+static size_t stress_zlib_codec_lz4_compress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	int ret;
+
+	(void)ctxt;
+	if (level > 1)
+		ret = LZ4_compress_HC((const char *)src, (char *)dst, (int)src_len, (int)dst_len, level);
+	else
+		ret = LZ4_compress_default((const char *)src, (char *)dst, (int)src_len, (int)dst_len);
+	return (ret > 0) ? (size_t)ret : 0;
+}
+
+static size_t stress_zlib_codec_lz4_decompress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	const int ret = LZ4_decompress_safe((const char *)src, (char *)dst, (int)src_len, (int)dst_len);
+
+	(void)ctxt;
+	(void)level;
+	return (ret > 0) ? (size_t)ret : 0;
+}
+#endif
+
+#if defined(STRESS_ZLIB_HAVE_ZSTD)
+static size_t stress_zlib_codec_zstd_compress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	const size_t ret = ZSTD_compressCCtx(ctxt->cctx, dst, dst_len, src, src_len, level);
+
+	return ZSTD_isError(ret) ? 0 : ret;
+}
+
+static size_t stress_zlib_codec_zstd_decompress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	const size_t ret = ZSTD_decompressDCtx(ctxt->dctx, dst, dst_len, src, src_len);
+
+	(void)level;
+	return ZSTD_isError(ret) ? 0 : ret;
+}
+
+static size_t stress_zlib_codec_zstd_dict_compress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	const size_t ret = ZSTD_compress_usingCDict(ctxt->cctx, dst, dst_len, src, src_len, ctxt->cdict);
+
+	(void)level;
+	return ZSTD_isError(ret) ? 0 : ret;
+}
+
+static size_t stress_zlib_codec_zstd_dict_decompress(stress_zlib_codec_ctxt_t *ctxt, const int level,
+	uint8_t *dst, const size_t dst_len, const uint8_t *src, const size_t src_len)
+{
+	const size_t ret = ZSTD_decompress_usingDDict(ctxt->dctx, dst, dst_len, src, src_len, ctxt->ddict);
+
+	(void)level;
+	return ZSTD_isError(ret) ? 0 : ret;
+}
+
+/*
+ *  stress_zlib_codec_zstd_dict()
+ *	train a dictionary on records of a second buffer of generated
+ *	data, data that zstd cannot train on, such as random data, has
+ *	the start of the buffer used as a raw content dictionary
+ */
+static bool stress_zlib_codec_zstd_dict(
+	stress_zlib_codec_ctxt_t *ctxt,
+	const int level,
+	const uint8_t *samples)
+{
+	static uint8_t dict[CODEC_DICT_SIZE];
+	size_t sizes[CODEC_RECORDS];
+	size_t i, len;
+
+	for (i = 0; i < CODEC_RECORDS; i++)
+		sizes[i] = CODEC_RECORD_SIZE;
+	len = ZDICT_trainFromBuffer(dict, sizeof(dict), samples, sizes, CODEC_RECORDS);
+	if (ZDICT_isError(len)) {
+		len = sizeof(dict);
+		(void)memcpy(dict, samples, len);
+	}
+	(void)ZSTD_freeCDict(ctxt->cdict);
+	(void)ZSTD_freeDDict(ctxt->ddict);
+	ctxt->cdict = ZSTD_createCDict(dict, len, level);
+	ctxt->ddict = ZSTD_createDDict(dict, len);
+
+	return ctxt->cdict && ctxt->ddict;
+}
+#endif
+
+static const stress_zlib_codec_t zlib_codecs[] = {
+	{ "zlib",	"zlib-1",	1,	0,	false,	stress_zlib_codec_zlib_compress,	stress_zlib_codec_zlib_decompress },
+	{ "zlib",	"zlib-6",	6,	0,	false,	stress_zlib_codec_zlib_compress,	stress_zlib_codec_zlib_decompress },
+	{ "zlib",	"zlib-9",	9,	0,	false,	stress_zlib_codec_zlib_compress,	stress_zlib_codec_zlib_decompress },
+#if defined(STRESS_ZLIB_HAVE_ZLIB_NG)
+	{ "zlib-ng",	"zlib-ng-1",	1,	0,	false,	stress_zlib_codec_zlib_ng_compress,	stress_zlib_codec_zlib_ng_decompress },
+	{ "zlib-ng",	"zlib-ng-6",	6,	0,	false,	stress_zlib_codec_zlib_ng_compress,	stress_zlib_codec_zlib_ng_decompress },
+	{ "zlib-ng",	"zlib-ng-9",	9,	0,	false,	stress_zlib_codec_zlib_ng_compress,	stress_zlib_codec_zlib_ng_decompress },
+#endif
+#if defined(STRESS_ZLIB_HAVE_LZ4)
+	{ "lz4",	"lz4",		1,	0,	false,	stress_zlib_codec_lz4_compress,		stress_zlib_codec_lz4_decompress },
+	{ "lz4",	"lz4hc-9",	9,	0,	false,	stress_zlib_codec_lz4_compress,		stress_zlib_codec_lz4_decompress },
+#endif
+#if defined(STRESS_ZLIB_HAVE_ZSTD)
+	{ "zstd",	"zstd-1",	1,	0,	false,	stress_zlib_codec_zstd_compress,	stress_zlib_codec_zstd_decompress },
+	{ "zstd",	"zstd-3",	3,	0,	false,	stress_zlib_codec_zstd_compress,	stress_zlib_codec_zstd_decompress },
+	{ "zstd",	"zstd-9",	9,	0,	false,	stress_zlib_codec_zstd_compress,	stress_zlib_codec_zstd_decompress },
+	{ "zstd",	"zstd-19",	19,	0,	false,	stress_zlib_codec_zstd_compress,	stress_zlib_codec_zstd_decompress },
+	{ "zstd",	"zstd-4k",	3,	CODEC_RECORD_SIZE, false, stress_zlib_codec_zstd_compress,	stress_zlib_codec_zstd_decompress },
+	{ "zstd",	"zstd-dict",	3,	CODEC_RECORD_SIZE, true, stress_zlib_codec_zstd_dict_compress,	stress_zlib_codec_zstd_dict_decompress },
+#endif
+};
+
+#define ZLIB_CODECS	(SIZEOF_ARRAY(zlib_codecs))
+
+/*
+ *  stress_zlib_codec_run()
+ *	compress and decompress src with a codec, records are compressed
+ *	independently, returns false if the codec failed or the data did
+ *	not round trip
+ */
+static bool stress_zlib_codec_run(
+	stress_zlib_codec_ctxt_t *ctxt,
+	const stress_zlib_codec_t *codec,
+	const stress_zlib_rand_data_info_t *info,
+	const uint8_t *src,
+	uint8_t *dst,
+	uint8_t *out,
+	stress_zlib_codec_stats_t *stats)
+{
+	const size_t record = codec->record ? codec->record : CODEC_DATA_SIZE;
+	const size_t records = CODEC_DATA_SIZE / record;
+	size_t sizes[CODEC_RECORDS];
+	size_t i, pos;
+	double t;
+
+	t = stress_time_now();
+	for (pos = 0, i = 0; i < records; i++) {
+		sizes[i] = codec->compress(ctxt, codec->level, dst + pos,
+			CODEC_DST_SIZE - pos, src + (i * record), record);
+		if (!sizes[i]) {
+			pr_fail("%s: %s compression of %s data failed\n",
+				ctxt->args->name, codec->name, info->name);
+			return false;
+		}
+		pos += sizes[i];
+	}
+	stats->compress += stress_time_now() - t;
+
+	t = stress_time_now();
+	for (pos = 0, i = 0; i < records; i++) {
+		if (codec->decompress(ctxt, codec->level, out + (i * record),
+				record, dst + pos, sizes[i]) != record) {
+			pr_fail("%s: %s decompression of %s data failed\n",
+				ctxt->args->name, codec->name, info->name);
+			return false;
+		}
+		pos += sizes[i];
+	}
+	stats->decompress += stress_time_now() - t;
+	stats->bytes_in += (double)CODEC_DATA_SIZE;
+	stats->bytes_out += (double)pos;
+
+	if ((g_opt_flags & OPT_FLAGS_VERIFY) && memcmp(src, out, CODEC_DATA_SIZE)) {
+		pr_fail("%s: %s decompressed %s data does not match the original data\n",
+			ctxt->args->name, codec->name, info->name);
+		return false;
+	}
+	return true;
+}
+
+/*
+ *  stress_zlib_codec_generate()
+ *	fill a CODEC_DATA_SIZE buffer with generated data
+ */
+static void stress_zlib_codec_generate(
+	const stress_args_t *args,
+	const stress_zlib_rand_data_info_t *info,
+	uint8_t *buf)
+{
+	size_t i;
+
+	for (i = 0; i < CODEC_DATA_SIZE; i += DATA_SIZE)
+		info->func(args, (uint64_t *)(buf + i), (uint64_t *)(buf + i + DATA_SIZE));
+}
+
+/*
+ *  stress_zlib_codec_table()
+ *	print a table of a per generator codec statistic
+ */
+static void stress_zlib_codec_table(
+	const stress_args_t *args,
+	const char *title,
+	const size_t codec_index,
+	const stress_zlib_codec_stats_t *stats,
+	const size_t gen_begin,
+	const size_t gen_end,
+	double (*value)(const stress_zlib_codec_stats_t *stats))
+{
+	char line[512];
+	size_t g, c, len;
+
+	len = (size_t)snprintf(line, sizeof(line), "%-12s", "generator");
+	for (c = 0; c < ZLIB_CODECS; c++) {
+		if (codec_index && strcmp(zlib_codecs[c].codec, zlib_codec_names[codec_index]))
+			continue;
+		len += (size_t)snprintf(line + len, sizeof(line) - len, " %9s", zlib_codecs[c].name);
+	}
+	pr_inf("%s: %s (%s)\n", args->name, line, title);
+
+	for (g = gen_begin; g < gen_end; g++) {
+		len = (size_t)snprintf(line, sizeof(line), "%-12s", zlib_rand_data_methods[g].name);
+		for (c = 0; c < ZLIB_CODECS; c++) {
+			const stress_zlib_codec_stats_t *s = &stats[(g * ZLIB_CODECS) + c];
+
+			if (codec_index && strcmp(zlib_codecs[c].codec, zlib_codec_names[codec_index]))
+				continue;
+			if (s->bytes_in > 0.0)
+				len += (size_t)snprintf(line + len, sizeof(line) - len, " %9.2f", value(s));
+			else
+				len += (size_t)snprintf(line + len, sizeof(line) - len, " %9s", "-");
+		}
+		pr_inf("%s: %s\n", args->name, line);
+	}
+}
+
+static double stress_zlib_codec_ratio(const stress_zlib_codec_stats_t *stats)
+{
+	return (stats->bytes_out > 0.0) ? stats->bytes_in / stats->bytes_out : 0.0;
+}
+
+static double stress_zlib_codec_compress_rate(const stress_zlib_codec_stats_t *stats)
+{
+	return (stats->compress > 0.0) ? stats->bytes_in / (stats->compress * (double)MB) : 0.0;
+}
+
+static double stress_zlib_codec_decompress_rate(const stress_zlib_codec_stats_t *stats)
+{
+	return (stats->decompress > 0.0) ? stats->bytes_in / (stats->decompress * (double)MB) : 0.0;
+}
+
+/*
+ *  stress_zlib_codec()
+ *	benchmark each codec on the output of each data generator, or of
+ *	the generator selected by --zlib-method
+ */
+static int stress_zlib_codec(const stress_args_t *args, const size_t codec_index)
+{
+	const size_t n_gens = SIZEOF_ARRAY(zlib_rand_data_methods) - 1;
+	const stress_zlib_rand_data_info_t *info = &zlib_rand_data_methods[0];
+	stress_zlib_codec_ctxt_t ctxt;
+	stress_zlib_codec_stats_t *stats;
+	uint8_t *src, *dst, *out, *samples;
+	size_t g, c, i, gen_begin, gen_end;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("zlib-method", &info);
+	if (info == &zlib_rand_data_methods[0]) {
+		/* random, so benchmark every generator */
+		gen_begin = 1;
+		gen_end = n_gens;
+	} else {
+		gen_begin = (size_t)(info - zlib_rand_data_methods);
+		gen_end = gen_begin + 1;
+	}
+
+	(void)memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.args = args;
+	src = calloc(CODEC_DATA_SIZE, 1);
+	samples = calloc(CODEC_DATA_SIZE, 1);
+	out = calloc(CODEC_DATA_SIZE, 1);
+	dst = calloc(CODEC_DST_SIZE, 1);
+	stats = calloc(n_gens * ZLIB_CODECS, sizeof(*stats));
+#if defined(STRESS_ZLIB_HAVE_ZSTD)
+	ctxt.cctx = ZSTD_createCCtx();
+	ctxt.dctx = ZSTD_createDCtx();
+	if (!ctxt.cctx || !ctxt.dctx) {
+		pr_inf_skip("%s: cannot create zstd contexts, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+#endif
+	if (!src || !samples || !out || !dst || !stats) {
+		pr_inf_skip("%s: cannot allocate codec buffers, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (g = gen_begin; g < gen_end; g++) {
+			const stress_zlib_rand_data_info_t *gen = &zlib_rand_data_methods[g];
+			bool dict = false;
+
+			stress_zlib_codec_generate(args, gen, src);
+			for (c = 0; c < ZLIB_CODECS; c++) {
+				const stress_zlib_codec_t *codec = &zlib_codecs[c];
+
+				if (codec_index && strcmp(codec->codec, zlib_codec_names[codec_index]))
+					continue;
+#if defined(STRESS_ZLIB_HAVE_ZSTD)
+				if (codec->dict && !dict) {
+					stress_zlib_codec_generate(args, gen, samples);
+					if (!stress_zlib_codec_zstd_dict(&ctxt, codec->level, samples)) {
+						pr_inf_skip("%s: cannot create zstd dictionary, skipping stressor\n",
+							args->name);
+						rc = EXIT_NO_RESOURCE;
+						break;
+					}
+					dict = true;
+				}
+#else
+				(void)dict;
+#endif
+				if (!stress_zlib_codec_run(&ctxt, codec, gen, src, dst, out,
+						&stats[(g * ZLIB_CODECS) + c])) {
+					rc = EXIT_FAILURE;
+					break;
+				}
+			}
+			if ((rc != EXIT_SUCCESS) || !keep_stressing(args))
+				break;
+		}
+		inc_counter(args);
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		pr_lock();
+		stress_zlib_codec_table(args, "compression ratio", codec_index,
+			stats, gen_begin, gen_end, stress_zlib_codec_ratio);
+		stress_zlib_codec_table(args, "compress MB per sec", codec_index,
+			stats, gen_begin, gen_end, stress_zlib_codec_compress_rate);
+		stress_zlib_codec_table(args, "decompress MB per sec", codec_index,
+			stats, gen_begin, gen_end, stress_zlib_codec_decompress_rate);
+		pr_unlock();
+	}
+
+	/* metrics are over all the generators */
+	for (i = 0, c = 0; c < ZLIB_CODECS; c++) {
+		stress_zlib_codec_stats_t total;
+		char str[64];
+
+		(void)memset(&total, 0, sizeof(total));
+		for (g = gen_begin; g < gen_end; g++) {
+			const stress_zlib_codec_stats_t *s = &stats[(g * ZLIB_CODECS) + c];
+
+			total.bytes_in += s->bytes_in;
+			total.bytes_out += s->bytes_out;
+			total.compress += s->compress;
+			total.decompress += s->decompress;
+		}
+		if (total.bytes_in <= 0.0)
+			continue;
+		(void)snprintf(str, sizeof(str), "%s compress MB per sec", zlib_codecs[c].name);
+		stress_metrics_set(args, i++, str, stress_zlib_codec_compress_rate(&total));
+		(void)snprintf(str, sizeof(str), "%s decompress MB per sec", zlib_codecs[c].name);
+		stress_metrics_set(args, i++, str, stress_zlib_codec_decompress_rate(&total));
+		(void)snprintf(str, sizeof(str), "%s compression ratio", zlib_codecs[c].name);
+		stress_metrics_set(args, i++, str, stress_zlib_codec_ratio(&total));
+	}
+
+tidy:
+#if defined(STRESS_ZLIB_HAVE_ZSTD)
+	(void)ZSTD_freeDDict(ctxt.ddict);
+	(void)ZSTD_freeCDict(ctxt.cdict);
+	(void)ZSTD_freeDCtx(ctxt.dctx);
+	(void)ZSTD_freeCCtx(ctxt.cctx);
+#endif
+	free(stats);
+	free(dst);
+	free(out);
+	free(samples);
+	free(src);
+
+	return rc;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  Pipelined block compression, enabled by --zlib-threads, a reader
+ *  thread fills chunks from the data generator, a pool of compressor
+ *  threads deflates the chunks as independent blocks and the stressor
+ *  writes the compressed blocks back in order. The stages share a ring
+ *  of chunk slots, chunk seq uses slot seq % depth, so the ring bounds
+ *  the reader to compressor queue and the compressor to writer queue
+ */
+#define PIPELINE_CHUNK		(DATA_SIZE * 2)		/* 128K blocks, as pigz */
+#define PIPELINE_DEPTH_SCALE	(2)			/* slots per compressor thread */
+
+#define PIPELINE_SLOT_FREE	(0)
+#define PIPELINE_SLOT_FILLED	(1)
+#define PIPELINE_SLOT_DONE	(2)
+
+typedef struct {
+	uint8_t *in;		/* uncompressed chunk */
+	uint8_t *out;		/* compressed block */
+	size_t out_len;		/* compressed length, 0 on error */
+	int state;		/* PIPELINE_SLOT_* */
+} stress_zlib_slot_t;
+
+typedef struct {
+	const stress_args_t *args;
+	stress_zlib_rand_data_info_t *info;	/* data generator */
+	int level;				/* compression level */
+	size_t out_size;			/* compressed block buffer size */
+	stress_zlib_slot_t *slots;		/* chunk ring */
+	size_t depth;				/* slots in the ring */
+	pthread_mutex_t lock;			/* protects all below */
+	pthread_cond_t free_cond;		/* reader waits for a free slot */
+	pthread_cond_t filled_cond;		/* compressors wait for a chunk */
+	pthread_cond_t done_cond;		/* writer waits for the next block */
+	uint64_t produced;			/* chunks filled by the reader */
+	uint64_t claimed;			/* chunks claimed by compressors */
+	uint64_t written;			/* blocks written */
+	bool stop;				/* tell the threads to exit */
+	double reader_busy;			/* reader time generating data */
+	double compress_busy;			/* compressor time deflating, all threads */
+} stress_zlib_pipeline_t;
+
+typedef struct {
+	pthread_t pthread;	/* thread handle */
+	int ret;		/* pthread_create return */
+} stress_zlib_pipeline_thread_t;
+
+static void stress_zlib_pipeline_block_signals(void)
+{
+	sigset_t set;
+
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+}
+
+/*
+ *  stress_zlib_pipeline_reader()
+ *	fill free slots with generated data in sequence order
+ */
+static void *stress_zlib_pipeline_reader(void *arg)
+{
+	static void *nowt = NULL;
+	stress_zlib_pipeline_t *pipeline = (stress_zlib_pipeline_t *)arg;
+
+	stress_zlib_pipeline_block_signals();
+	for (;;) {
+		stress_zlib_slot_t *slot;
+		size_t i;
+		double t;
+
+		(void)pthread_mutex_lock(&pipeline->lock);
+		slot = &pipeline->slots[pipeline->produced % pipeline->depth];
+		while (!pipeline->stop && (slot->state != PIPELINE_SLOT_FREE))
+			(void)pthread_cond_wait(&pipeline->free_cond, &pipeline->lock);
+		if (pipeline->stop) {
+			(void)pthread_mutex_unlock(&pipeline->lock);
+			break;
+		}
+		(void)pthread_mutex_unlock(&pipeline->lock);
+
+		/* a free slot is only touched by the reader */
+		t = stress_time_now();
+		for (i = 0; i < PIPELINE_CHUNK; i += DATA_SIZE)
+			pipeline->info->func(pipeline->args, (uint64_t *)(slot->in + i),
+				(uint64_t *)(slot->in + i + DATA_SIZE));
+		t = stress_time_now() - t;
+
+		(void)pthread_mutex_lock(&pipeline->lock);
+		pipeline->reader_busy += t;
+		slot->state = PIPELINE_SLOT_FILLED;
+		pipeline->produced++;
+		(void)pthread_cond_signal(&pipeline->filled_cond);
+		(void)pthread_mutex_unlock(&pipeline->lock);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_zlib_pipeline_compressor()
+ *	claim filled chunks in sequence order and deflate each one
+ *	as an independent block
+ */
+static void *stress_zlib_pipeline_compressor(void *arg)
+{
+	static void *nowt = NULL;
+	stress_zlib_pipeline_t *pipeline = (stress_zlib_pipeline_t *)arg;
+
+	stress_zlib_pipeline_block_signals();
+	for (;;) {
+		stress_zlib_slot_t *slot;
+		uLongf len = (uLongf)pipeline->out_size;
+		int ret;
+		double t;
+
+		(void)pthread_mutex_lock(&pipeline->lock);
+		while (!pipeline->stop && (pipeline->claimed >= pipeline->produced))
+			(void)pthread_cond_wait(&pipeline->filled_cond, &pipeline->lock);
+		if (pipeline->stop) {
+			(void)pthread_mutex_unlock(&pipeline->lock);
+			break;
+		}
+		slot = &pipeline->slots[pipeline->claimed % pipeline->depth];
+		pipeline->claimed++;
+		(void)pthread_mutex_unlock(&pipeline->lock);
+
+		t = stress_time_now();
+		ret = compress2(slot->out, &len, slot->in, (uLong)PIPELINE_CHUNK, pipeline->level);
+		t = stress_time_now() - t;
+
+		(void)pthread_mutex_lock(&pipeline->lock);
+		pipeline->compress_busy += t;
+		slot->out_len = (ret == Z_OK) ? (size_t)len : 0;
+		slot->state = PIPELINE_SLOT_DONE;
+		(void)pthread_cond_signal(&pipeline->done_cond);
+		(void)pthread_mutex_unlock(&pipeline->lock);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_zlib_pipeline()
+ *	run the reader and compressor threads and write the
+ *	compressed blocks in order, a bogo op is one block written
+ */
+static int stress_zlib_pipeline(const stress_args_t *args, const uint32_t threads)
+{
+	stress_zlib_pipeline_t pipeline;
+	stress_zlib_pipeline_thread_t reader, *compressors;
+	stress_zlib_args_t zlib_args;
+	uint8_t *check = NULL;
+	uint32_t i, started = 0;
+	uint64_t bytes_in = 0, bytes_out = 0;
+	double t_start, duration, writer_busy = 0.0;
+	int rc = EXIT_SUCCESS;
+
+	(void)memset(&zlib_args, 0, sizeof(zlib_args));
+	(void)stress_zlib_get_args(&zlib_args);
+
+	(void)memset(&pipeline, 0, sizeof(pipeline));
+	pipeline.args = args;
+	pipeline.info = zlib_args.info;
+	pipeline.level = (int)zlib_args.level;
+	pipeline.out_size = (size_t)compressBound((uLong)PIPELINE_CHUNK);
+	pipeline.depth = (size_t)threads * PIPELINE_DEPTH_SCALE;
+
+	compressors = calloc(threads, sizeof(*compressors));
+	pipeline.slots = calloc(pipeline.depth, sizeof(*pipeline.slots));
+	check = malloc(PIPELINE_CHUNK);
+	if (!compressors || !pipeline.slots || !check)
+		goto no_resource;
+	for (i = 0; i < pipeline.depth; i++) {
+		pipeline.slots[i].in = malloc(PIPELINE_CHUNK);
+		pipeline.slots[i].out = malloc(pipeline.out_size);
+		if (!pipeline.slots[i].in || !pipeline.slots[i].out)
+			goto no_resource;
+	}
+
+	(void)pthread_mutex_init(&pipeline.lock, NULL);
+	(void)pthread_cond_init(&pipeline.free_cond, NULL);
+	(void)pthread_cond_init(&pipeline.filled_cond, NULL);
+	(void)pthread_cond_init(&pipeline.done_cond, NULL);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_start = stress_time_now();
+	reader.ret = pthread_create(&reader.pthread, NULL,
+		stress_zlib_pipeline_reader, (void *)&pipeline);
+	for (i = 0; (reader.ret == 0) && (i < threads); i++) {
+		compressors[i].ret = pthread_create(&compressors[i].pthread, NULL,
+			stress_zlib_pipeline_compressor, (void *)&pipeline);
+		if (!compressors[i].ret)
+			started++;
+	}
+	if (reader.ret || !started) {
+		pr_inf_skip("%s: cannot create pipeline threads, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto stop;
+	}
+
+	while (keep_stressing(args)) {
+		stress_zlib_slot_t *slot;
+		double t;
+
+		(void)pthread_mutex_lock(&pipeline.lock);
+		slot = &pipeline.slots[pipeline.written % pipeline.depth];
+		while (slot->state != PIPELINE_SLOT_DONE)
+			(void)pthread_cond_wait(&pipeline.done_cond, &pipeline.lock);
+		(void)pthread_mutex_unlock(&pipeline.lock);
+
+		t = stress_time_now();
+		if (!slot->out_len) {
+			pr_fail("%s: compression of block %" PRIu64 " failed\n",
+				args->name, pipeline.written);
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (g_opt_flags & OPT_FLAGS_VERIFY) {
+			uLongf len = (uLongf)PIPELINE_CHUNK;
+
+			if ((uncompress(check, &len, slot->out, (uLong)slot->out_len) != Z_OK) ||
+			    (len != PIPELINE_CHUNK) || memcmp(check, slot->in, PIPELINE_CHUNK)) {
+				pr_fail("%s: block %" PRIu64 " does not decompress to the original data\n",
+					args->name, pipeline.written);
+				rc = EXIT_FAILURE;
+				break;
+			}
+		}
+		bytes_in += PIPELINE_CHUNK;
+		bytes_out += slot->out_len;
+		writer_busy += stress_time_now() - t;
+
+		(void)pthread_mutex_lock(&pipeline.lock);
+		slot->state = PIPELINE_SLOT_FREE;
+		pipeline.written++;
+		(void)pthread_cond_signal(&pipeline.free_cond);
+		(void)pthread_mutex_unlock(&pipeline.lock);
+		inc_counter(args);
+	}
+
+stop:
+	(void)pthread_mutex_lock(&pipeline.lock);
+	pipeline.stop = true;
+	(void)pthread_cond_broadcast(&pipeline.free_cond);
+	(void)pthread_cond_broadcast(&pipeline.filled_cond);
+	(void)pthread_mutex_unlock(&pipeline.lock);
+	if (!reader.ret)
+		(void)pthread_join(reader.pthread, NULL);
+	for (i = 0; (reader.ret == 0) && (i < threads); i++) {
+		if (!compressors[i].ret)
+			(void)pthread_join(compressors[i].pthread, NULL);
+	}
+	duration = stress_time_now() - t_start;
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if ((rc == EXIT_SUCCESS) && (duration > 0.0) && bytes_out) {
+		stress_metrics_set(args, 0, "pipeline MB per sec",
+			(double)bytes_in / (duration * (double)MB));
+		stress_metrics_set(args, 1, "pipeline compression ratio",
+			(double)bytes_in / (double)bytes_out);
+		stress_metrics_set(args, 2, "reader utilisation %",
+			100.0 * pipeline.reader_busy / duration);
+		stress_metrics_set(args, 3, "compressor utilisation %",
+			100.0 * pipeline.compress_busy / (duration * (double)started));
+		stress_metrics_set(args, 4, "writer utilisation %",
+			100.0 * writer_busy / duration);
+		if (pipeline.compress_busy > 0.0)
+			stress_metrics_set(args, 5, "compressor MB per sec per thread",
+				(double)pipeline.claimed * (double)PIPELINE_CHUNK /
+				(pipeline.compress_busy * (double)MB));
+	}
+
+	(void)pthread_cond_destroy(&pipeline.done_cond);
+	(void)pthread_cond_destroy(&pipeline.filled_cond);
+	(void)pthread_cond_destroy(&pipeline.free_cond);
+	(void)pthread_mutex_destroy(&pipeline.lock);
+	goto tidy;
+
+no_resource:
+	pr_inf_skip("%s: cannot allocate %zu pipeline slots, skipping stressor\n",
+		args->name, pipeline.depth);
+	rc = EXIT_NO_RESOURCE;
+tidy:
+	if (pipeline.slots) {
+		for (i = 0; i < pipeline.depth; i++) {
+			free(pipeline.slots[i].out);
+			free(pipeline.slots[i].in);
+		}
+	}
+	free(pipeline.slots);
+	free(check);
+	free(compressors);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_zlib()
  *	stress cpu with compression and decompression
@@ -1696,6 +2523,21 @@ static int stress_zlib(const stress_args_t *args)
 	bool error = false;
 	bool interrupted = false;
 	stress_zlib_shared_checksums_t *shared_checksums;
+	size_t zlib_codec;
+	uint32_t zlib_threads;
+
+	if (stress_get_setting("zlib-codec", &zlib_codec))
+		return stress_zlib_codec(args, zlib_codec);
+	if (stress_get_setting("zlib-threads", &zlib_threads)) {
+#if defined(HAVE_LIB_PTHREAD)
+		return stress_zlib_pipeline(args, zlib_threads);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: --zlib-threads requires pthread support, skipping stressor\n",
+				args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
 
 	if (stress_sighandler(args->name, SIGPIPE, stress_sigpipe_handler, NULL) < 0)
 		return EXIT_FAILURE;
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2023      Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include <stdint.h>
+
+static inline uint64_t rdtscp(uint32_t *aux)
+{
+	uint32_t lo, hi, id;
+
+	__asm__ __volatile__("rdtscp" : "=a" (lo), "=d" (hi), "=c" (id));
+	*aux = id;
+	return ((uint64_t)hi << 32) | lo;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t aux;
+
+	return (int)(rdtscp(&aux) & 1);
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2013-2021 Canonical, Ltd.
+ * Copyright (C) 2022-2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include <zlib-ng.h>
+
+int main(void)
+{
+	static const uint8_t src[] = "test123test123test123";
+	uint8_t dst[128], out[sizeof(src)];
+	size_t dst_len = sizeof(dst), out_len = sizeof(out);
+
+	(void)zng_compress2(dst, &dst_len, src, sizeof(src), 6);
+
+	return zng_uncompress(out, &out_len, dst, dst_len);
+}
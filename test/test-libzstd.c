@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2013-2021 Canonical, Ltd.
+ * Copyright (C) 2022-2023 Colin Ian King
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include <zstd.h>
+#include <zdict.h>
+
+int main(void)
+{
+	static const char src[] = "test123test123test123";
+	char dst[128], out[sizeof(src)], dict[1024];
+	ZSTD_CCtx *cctx = ZSTD_createCCtx();
+	ZSTD_DCtx *dctx = ZSTD_createDCtx();
+	ZSTD_CDict *cdict = ZSTD_createCDict(src, sizeof(src), 3);
+	size_t n, sizes[1] = { sizeof(src) };
+
+	n = ZSTD_compressCCtx(cctx, dst, sizeof(dst), src, sizeof(src), 3);
+	n = ZSTD_compress_usingCDict(cctx, dst, sizeof(dst), src, sizeof(src), cdict);
+	(void)ZSTD_decompressDCtx(dctx, out, sizeof(out), dst, n);
+	(void)ZDICT_trainFromBuffer(dict, sizeof(dict), src, sizes, 1);
+	(void)ZSTD_freeCDict(cdict);
+	(void)ZSTD_freeDCtx(dctx);
+	(void)ZSTD_freeCCtx(cctx);
+
+	return ZSTD_isError(n);
+}